@@ -0,0 +1,144 @@
+"""
+This script measures the throughput of the vision simulation by GLVisionSimulatorItem.
+The cameras and range sensors of the specified resolution are added to the robot in a task
+of WRS2018, and the simulation is repeated in each thread mode with the best effort mode
+turned on and off. The results of the trials are compared with the simulation without the
+vision simulation, and they are output when all the trials have been finished.
+"""
+
+import WRSUtil
+import time
+import math
+import numpy as np
+from cnoid.Util import *
+from cnoid.Base import *
+from cnoid.Body import *
+from cnoid.BodyPlugin import *
+
+task = "T1M"
+robotName = "AizuSpiderSS"
+simulatorName = "AISTSimulator"
+
+numCameras = 4
+cameraResolution = (640, 480)
+cameraFrameRate = 30.0
+numRangeCameras = 1
+rangeCameraResolution = (320, 240)
+numRangeSensors = 1
+# The yaw and pitch ranges [deg] and the step [deg] of the range sensors
+rangeSensorYawRange = 270.0
+rangeSensorPitchRange = 30.0
+rangeSensorStep = 0.25
+rangeSensorFrameRate = 20.0
+
+simulationTime = 10.0
+threadModes = [
+    ("Single", GLVisionSimulatorItem.SINGLE_THREAD_MODE),
+    ("Sensor", GLVisionSimulatorItem.SENSOR_THREAD_MODE),
+    ("Screen", GLVisionSimulatorItem.SCREEN_THREAD_MODE) ]
+bestEffortModes = [ False, True ]
+
+# The camera looks along the -Z axis with the Y axis up, and it is directed to the front of the robot
+T_camera = np.array([
+    [ 0.0, 0.0, -1.0, 0.0 ],
+    [ -1.0, 0.0, 0.0, 0.0 ],
+    [ 0.0, 1.0, 0.0, 0.3 ],
+    [ 0.0, 0.0, 0.0, 1.0 ]])
+
+def addSensors(body):
+    link = body.rootLink
+    for i in range(numCameras):
+        camera = Camera()
+        camera.name = "BenchmarkCamera{}".format(i)
+        camera.setImageType(Camera.COLOR_IMAGE)
+        camera.setResolution(*cameraResolution)
+        camera.setFrameRate(cameraFrameRate)
+        camera.T_local = T_camera
+        body.addDevice(camera, link)
+    for i in range(numRangeCameras):
+        camera = RangeCamera()
+        camera.name = "BenchmarkRangeCamera{}".format(i)
+        camera.setImageType(Camera.COLOR_IMAGE)
+        camera.setResolution(*rangeCameraResolution)
+        camera.setFrameRate(cameraFrameRate)
+        camera.T_local = T_camera
+        body.addDevice(camera, link)
+    for i in range(numRangeSensors):
+        sensor = RangeSensor()
+        sensor.name = "BenchmarkRangeSensor{}".format(i)
+        sensor.setYawRange(math.radians(rangeSensorYawRange))
+        sensor.setYawStep(math.radians(rangeSensorStep))
+        sensor.setPitchRange(math.radians(rangeSensorPitchRange))
+        sensor.setPitchStep(math.radians(rangeSensorStep))
+        sensor.setFrameRate(rangeSensorFrameRate)
+        sensor.T_local = T_camera
+        body.addDevice(sensor, link)
+
+WRSUtil.loadProject(
+    "SingleSceneView", task, simulatorName, robotName, enableVisionSimulation = True)
+
+robotItem = Item.find(robotName)
+addSensors(robotItem.body)
+
+simulatorItem = Item.find(simulatorName)
+simulatorItem.setRealtimeSyncMode(False)
+simulatorItem.setRecordingMode(SimulatorItem.NoRecording)
+simulatorItem.setTimeRangeMode(SimulatorItem.SpecifiedTime)
+simulatorItem.setTimeLength(simulationTime)
+visionSimulatorItem = simulatorItem.findItem(GLVisionSimulatorItem)
+
+# The first trial is the baseline without the vision simulation
+trials = [ (None, None, False) ] + [
+    (label, mode, bestEffort) for label, mode in threadModes for bestEffort in bestEffortModes ]
+results = []
+trialIndex = 0
+startTime = 0.0
+
+def startNextTrial():
+    global startTime
+    label, mode, bestEffort = trials[trialIndex]
+    if mode is None:
+        visionSimulatorItem.setEnabled(False)
+        print("Vision simulation benchmark: running the baseline simulation")
+    else:
+        visionSimulatorItem.setEnabled(True)
+        visionSimulatorItem.setThreadMode(mode)
+        visionSimulatorItem.setBestEffortMode(bestEffort)
+        print("Vision simulation benchmark: running in the {} thread mode{}".format(
+            label, " with the best effort mode" if bestEffort else ""))
+    RootItem.instance.selectItem(simulatorItem)
+    startTime = time.perf_counter()
+    simulatorItem.startSimulation()
+
+def printResults():
+    baselineTime = results[0][1]
+    print("\nVision simulation benchmark results ({:.1f} s simulated, {:.3f} s without the vision simulation)".format(
+        simulationTime, baselineTime))
+    for (label, mode, bestEffort), elapsedTime, report in results[1:]:
+        print("{} thread mode{}: {:.3f} s, {:.2f} times slower".format(
+            label, ", best effort" if bestEffort else "", elapsedTime, elapsedTime / baselineTime))
+        if report is None:
+            continue
+        sensors = report.findListing("sensors")
+        for i in range(sensors.size):
+            sensor = sensors[i].toMapping()
+            print("  {}: {:.1f} / {:.1f} fps, {} delayed, rendering {:.2f} ms, readback {:.2f} ms, conversion {:.2f} ms".format(
+                sensor.readString("sensor"), sensor.readFloat("frameRate"), sensor.readFloat("targetFrameRate"),
+                sensor.readInt("numDelayedFrames"), sensor.readFloat("renderingTime") * 1000.0,
+                sensor.readFloat("readbackTime") * 1000.0, sensor.readFloat("conversionTime") * 1000.0))
+
+def onSimulationFinished(isForced = False):
+    global trialIndex
+    elapsedTime = time.perf_counter() - startTime
+    label, mode, bestEffort = trials[trialIndex]
+    report = visionSimulatorItem.throughputReport() if mode is not None else None
+    results.append((trials[trialIndex], elapsedTime, report))
+    trialIndex += 1
+    if isForced or trialIndex >= len(trials):
+        connection.disconnect()
+        printResults()
+    else:
+        startNextTrial()
+
+connection = simulatorItem.sigSimulationFinished.connect(onSimulationFinished)
+startNextTrial()
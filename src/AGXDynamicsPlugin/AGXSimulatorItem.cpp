@@ -60,6 +60,16 @@ void AGXSimulatorItem::setNumThreads(unsigned int num)
     impl->setNumThreads(num);
 }
 
+void AGXSimulatorItem::setNumThreadsAutoTuningEnabled(bool on)
+{
+    impl->setNumThreadsAutoTuningEnabled(on);
+}
+
+void AGXSimulatorItem::setNumAutoTuningSteps(int n)
+{
+    impl->setNumAutoTuningSteps(n);
+}
+
 void AGXSimulatorItem::setEnableContactReduction(bool bOn)
 {
     impl->setEnableContactReduction(bOn);
@@ -20,6 +20,15 @@ public:
 
     virtual Vector3 getGravity() const override;
     void setNumThreads(unsigned int num);
+
+    /**
+       When the auto tuning is enabled, the number of threads is selected by measuring the step time
+       with several numbers of threads at the beginning of the simulation, and the NumThreads
+       property is not used.
+    */
+    void setNumThreadsAutoTuningEnabled(bool on);
+    //! \param n The number of the steps measured for each number of threads in the auto tuning
+    void setNumAutoTuningSteps(int n);
     void setEnableContactReduction(bool bOn);
     void setContactReductionBinResolution(int r);
     void setContactReductionThreshhold(int t);
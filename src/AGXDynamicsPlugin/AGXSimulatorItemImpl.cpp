@@ -8,6 +8,12 @@
 #include <cnoid/PutPropertyFunction>
 #include <cnoid/Archive>
 #include <cnoid/EigenArchive>
+#include <cnoid/SimulationStepProfiler>
+#include <cnoid/MessageView>
+#include <agx/Statistics.h>
+#include <fmt/format.h>
+#include <thread>
+#include <chrono>
 #include "gettext.h"
 
 using namespace std;
@@ -60,6 +66,13 @@ const std::unordered_map<std::string, agx::Notify::NotifyLevel> agxNotifyLevel{
     {"error", agx::Notify::NOTIFY_ERROR}
 };
 
+// The timing data of the agxSDK::Simulation module recorded in the step profiler
+const char* agxTimingNames[][2] = {
+    { "Collision-detection time", "AGX collision detection" },
+    { "Dynamics-system time", "AGX dynamics system" },
+    { "Step forward time", "AGX step forward" }
+};
+
 AGXSimulatorItemImpl::AGXSimulatorItemImpl(AGXSimulatorItem* self)
     : self(self)
 {
@@ -75,6 +88,8 @@ AGXSimulatorItemImpl::AGXSimulatorItemImpl(AGXSimulatorItem* self)
     m_p_enableAMOR = simDesc.enableAMOR;
     m_p_enableAutoSleep = simDesc.enableAutoSleep;
     m_p_saveToAGXFileOnStart = false;
+    m_p_enableNumThreadsAutoTuning = false;
+    m_p_numAutoTuningSteps = 100;
     m_p_debugMessageOnConsoleType = Selection(agxNotifyLevel.size(), CNOID_GETTEXT_DOMAIN_NAME);
     for(auto i : agxNotifyLevel){
         m_p_debugMessageOnConsoleType.setSymbol(i.second, N_(i.first));
@@ -96,6 +111,8 @@ AGXSimulatorItemImpl::AGXSimulatorItemImpl(AGXSimulatorItem* self, const AGXSimu
     m_p_enableAutoSleep               =  org.m_p_enableAutoSleep              ;
     m_p_saveToAGXFileOnStart          =  org.m_p_saveToAGXFileOnStart         ;
     m_p_debugMessageOnConsoleType     =  org.m_p_debugMessageOnConsoleType    ;
+    m_p_enableNumThreadsAutoTuning    =  org.m_p_enableNumThreadsAutoTuning   ;
+    m_p_numAutoTuningSteps            =  org.m_p_numAutoTuningSteps           ;
 }
 
 AGXSimulatorItemImpl::~AGXSimulatorItemImpl(){}
@@ -106,6 +123,9 @@ void AGXSimulatorItemImpl::doPutProperties(PutPropertyFunction & putProperty)
 {
     putProperty(_("Gravity"), str(m_p_gravity), [&](const string& value){ return toVector3(value, m_p_gravity); });
     putProperty(_("NumThreads"), m_p_numThreads, changeProperty(m_p_numThreads));
+    putProperty(_("NumThreadsAutoTuning"), m_p_enableNumThreadsAutoTuning, changeProperty(m_p_enableNumThreadsAutoTuning));
+    putProperty.reset().min(1)(_("NumAutoTuningSteps"), m_p_numAutoTuningSteps, changeProperty(m_p_numAutoTuningSteps));
+    putProperty.reset();
     putProperty(_("ContactReduction"), m_p_enableContactReduction, changeProperty(m_p_enableContactReduction));
     putProperty(_("ContactReductionBinResolution"), m_p_contactReductionBinResolution, changeProperty(m_p_contactReductionBinResolution));
     putProperty(_("ContactReductionThreshhold"), m_p_contactReductionThreshhold, changeProperty(m_p_contactReductionThreshhold));
@@ -121,6 +141,8 @@ bool AGXSimulatorItemImpl::store(Archive & archive)
 {
     write(archive, "Gravity", m_p_gravity);
     archive.write("NumThreads", m_p_numThreads);
+    archive.write("NumThreadsAutoTuning", m_p_enableNumThreadsAutoTuning);
+    archive.write("NumAutoTuningSteps", m_p_numAutoTuningSteps);
     archive.write("ContactReduction", m_p_enableContactReduction);
     archive.write("ContactReductionBinResolution", m_p_contactReductionBinResolution);
     archive.write("ContactReductionThreshhold", m_p_contactReductionThreshhold);
@@ -135,6 +157,10 @@ bool AGXSimulatorItemImpl::restore(const Archive & archive)
 {
     read(archive, "Gravity", m_p_gravity);
     archive.read("NumThreads", m_p_numThreads);
+    archive.read("NumThreadsAutoTuning", m_p_enableNumThreadsAutoTuning);
+    if(archive.read("NumAutoTuningSteps", m_p_numAutoTuningSteps)){
+        m_p_numAutoTuningSteps = std::max(m_p_numAutoTuningSteps, 1);
+    }
     archive.read("ContactReduction", m_p_enableContactReduction);
     archive.read("ContactReductionBinResolution", m_p_contactReductionBinResolution);
     archive.read("ContactReductionThreshhold", m_p_contactReductionThreshhold);
@@ -167,6 +193,10 @@ bool AGXSimulatorItemImpl::initializeSimulation(const std::vector<SimulationBody
     sd.simdesc.enableAMOR = m_p_enableAMOR;
     sd.simdesc.enableContactWarmstarting = m_p_enableContactWarmstarting;
     sd.simdesc.enableAutoSleep = m_p_enableAutoSleep;
+    initializeNumThreadsAutoTuning();
+    if(isTuningNumThreads){
+        sd.simdesc.numThreads = threadNumCandidates.front();
+    }
     agxScene = AGXScene::create(sd);
     const agx::Notify::NotifyLevel notifyLevel = agxNotifyLevel.at(m_p_debugMessageOnConsoleType.selectedSymbol());
     agx::Notify::instance()->setNotifyLevel(notifyLevel);
@@ -176,6 +206,8 @@ bool AGXSimulatorItemImpl::initializeSimulation(const std::vector<SimulationBody
     createAGXMaterialTable();
 
     doUpdateLinkContactPoints = false;
+    isFirstStep = true;
+    stepProfiler = nullptr;
     
     for(auto simBody : simBodies){
         AGXBody* agxBody = static_cast<AGXBody*>(simBody);
@@ -377,8 +409,27 @@ bool AGXSimulatorItemImpl::stepSimulation(const std::vector<SimulationBody*>& ac
         agxBody->setControlInputToAGX();
         agxBody->addForceTorqueToAGX();
     }
+    self->lapDynamicsStepPhase(SimulatorItem::StateInputPhase);
 
-    agxScene->stepSimulation();
+    if(isFirstStep){
+        // The step profiler is initialized after initializeSimulation
+        initializeAGXProfiling();
+        isFirstStep = false;
+    }
+
+    if(isTuningNumThreads){
+        auto time = std::chrono::steady_clock::now();
+        agxScene->stepSimulation();
+        updateNumThreadsAutoTuning(
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - time).count());
+    } else {
+        agxScene->stepSimulation();
+    }
+
+    if(stepProfiler){
+        recordAGXTimings();
+    }
+    self->lapDynamicsStepPhase(SimulatorItem::EngineStepPhase);
 
     for(auto simBody : activeSimBodies){
         auto const agxBody = static_cast<AGXBody*>(simBody);
@@ -392,10 +443,88 @@ bool AGXSimulatorItemImpl::stepSimulation(const std::vector<SimulationBody*>& ac
     if(doUpdateLinkContactPoints){
         updateLinkContactPoints();
     }
-    
+    self->lapDynamicsStepPhase(SimulatorItem::StateOutputPhase);
+
     return true;
 }
 
+/**
+   The candidates are the powers of two up to the number of the hardware threads and the number itself.
+   Each candidate is measured in the given number of steps after a warm-up step, and the fastest one is
+   used in the rest of the simulation.
+*/
+void AGXSimulatorItemImpl::initializeNumThreadsAutoTuning()
+{
+    isTuningNumThreads = false;
+    threadNumCandidates.clear();
+    if(!m_p_enableNumThreadsAutoTuning){
+        return;
+    }
+    const int maxNumThreads = std::max(1, (int)std::thread::hardware_concurrency());
+    for(int n = 1; n < maxNumThreads; n *= 2){
+        threadNumCandidates.push_back(n);
+    }
+    threadNumCandidates.push_back(maxNumThreads);
+
+    if(threadNumCandidates.size() >= 2){
+        isTuningNumThreads = true;
+        candidateIndex = 0;
+        tuningStepCounter = 0;
+        tuningTime = 0.0;
+        fastestNumThreads = -1;
+    }
+}
+
+void AGXSimulatorItemImpl::updateNumThreadsAutoTuning(double stepTime)
+{
+    // The first step after changing the number of threads is not measured
+    if(tuningStepCounter++ == 0){
+        return;
+    }
+    tuningTime += stepTime;
+    if(tuningStepCounter <= m_p_numAutoTuningSteps){
+        return;
+    }
+
+    if(fastestNumThreads < 0 || tuningTime < minTuningTime){
+        minTuningTime = tuningTime;
+        fastestNumThreads = threadNumCandidates[candidateIndex];
+    }
+    if(++candidateIndex < (int)threadNumCandidates.size()){
+        agx::setNumThreads(threadNumCandidates[candidateIndex]);
+        tuningStepCounter = 0;
+        tuningTime = 0.0;
+    } else {
+        agx::setNumThreads(fastestNumThreads);
+        isTuningNumThreads = false;
+        MessageView::instance()->putln(
+            fmt::format(_("The number of AGX threads has been tuned to {0} ({1:.3f} ms per step)."),
+                        fastestNumThreads, minTuningTime / m_p_numAutoTuningSteps * 1000.0));
+    }
+}
+
+void AGXSimulatorItemImpl::initializeAGXProfiling()
+{
+    stepProfiler = self->stepProfiler();
+    agxTimingPhaseIndices.clear();
+    if(stepProfiler){
+        agx::Statistics::instance()->setEnable(true);
+        for(auto& names : agxTimingNames){
+            agxTimingPhaseIndices.push_back(stepProfiler->addPhase(names[1]));
+        }
+    }
+}
+
+//! The timing data of AGX is given in milliseconds
+void AGXSimulatorItemImpl::recordAGXTimings()
+{
+    auto statistics = agx::Statistics::instance();
+    for(size_t i=0; i < agxTimingPhaseIndices.size(); ++i){
+        auto info = statistics->getTimingInfo("Simulation", agxTimingNames[i][0]);
+        stepProfiler->record(agxTimingPhaseIndices[i], info.current / 1000.0);
+    }
+}
+
 void AGXSimulatorItemImpl::updateLinkContactPoints()
 {
     for(auto& contact : agxScene->getSimulation()->getSpace()->getGeometryContacts()){
@@ -453,6 +582,16 @@ void AGXSimulatorItemImpl::setNumThreads(unsigned int num)
     m_p_numThreads = num;
 }
 
+void AGXSimulatorItemImpl::setNumThreadsAutoTuningEnabled(bool on)
+{
+    m_p_enableNumThreadsAutoTuning = on;
+}
+
+void AGXSimulatorItemImpl::setNumAutoTuningSteps(int n)
+{
+    m_p_numAutoTuningSteps = std::max(n, 1);
+}
+
 void AGXSimulatorItemImpl::setEnableContactReduction(bool bOn)
 {
     m_p_enableContactReduction = bOn;
@@ -40,6 +40,8 @@ public:
     void setGravity(const Vector3& g);
     Vector3 getGravity() const;
     void setNumThreads(unsigned int num);
+    void setNumThreadsAutoTuningEnabled(bool on);
+    void setNumAutoTuningSteps(int n);
     void setEnableContactReduction(bool bOn);
     void setContactReductionBinResolution(int r);
     void setContactReductionThreshhold(int t);
@@ -61,7 +63,27 @@ private:
     bool    m_p_enableAutoSleep;
     bool    m_p_saveToAGXFileOnStart;
     Selection m_p_debugMessageOnConsoleType;
+    bool    m_p_enableNumThreadsAutoTuning;
+    int     m_p_numAutoTuningSteps;
     AGXScene* getAGXScene();
+
+    // Variables used to tune the number of threads
+    bool isTuningNumThreads;
+    std::vector<int> threadNumCandidates;
+    int candidateIndex;
+    int tuningStepCounter;
+    double tuningTime;
+    double minTuningTime;
+    int fastestNumThreads;
+    void initializeNumThreadsAutoTuning();
+    void updateNumThreadsAutoTuning(double stepTime);
+
+    // Variables used to profile the AGX step
+    bool isFirstStep;
+    SimulationStepProfiler* stepProfiler;
+    std::vector<int> agxTimingPhaseIndices;
+    void initializeAGXProfiling();
+    void recordAGXTimings();
 };
 
 }
@@ -19,6 +19,8 @@ PYBIND11_MODULE(AGXDynamicsPlugin, m)
         .def(py::init<>())
         .def("getGravity", (Vector3 (AGXSimulatorItem::*)()) &AGXSimulatorItem::getGravity)
         .def("setNumThreads", &AGXSimulatorItem::setNumThreads)
+        .def("setNumThreadsAutoTuningEnabled", &AGXSimulatorItem::setNumThreadsAutoTuningEnabled)
+        .def("setNumAutoTuningSteps", &AGXSimulatorItem::setNumAutoTuningSteps)
         .def("setEnableContactReduction", &AGXSimulatorItem::setEnableContactReduction)
         .def("setContactReductionBinResolution", &AGXSimulatorItem::setContactReductionBinResolution)
         .def("setContactReductionThreshhold", &AGXSimulatorItem::setContactReductionThreshhold)
@@ -5,13 +5,19 @@
 
 #include "AISTCollisionDetector.h"
 #include "ColdetModelPair.h"
+#include "PrimitiveCollision.h"
 #include <cnoid/IdPair>
 #include <cnoid/SceneDrawables>
 #include <cnoid/MeshExtractor>
-#include <cnoid/ThreadPool>
+#include <cnoid/TaskScheduler>
+#include <cnoid/BoundingBox>
 #include <algorithm>
+#include <limits>
 #include <random>
 #include <set>
+#include <unordered_map>
+#include <mutex>
+#include <atomic>
 
 using namespace std;
 using namespace cnoid;
@@ -20,7 +26,27 @@ namespace {
 
 const bool ENABLE_SHUFFLE = false;
 
+// The bounding boxes of the broadphase are expanded by this margin to absorb the rounding
+// errors of the single precision transforms used in the narrowphase.
+const double BroadphaseMargin = 1.0e-4;
+
+// The candidate pairs are divided into this number of batches per thread in the multithread mode
+const int NumPairBatchesPerThread = 4;
+
+// The distance queries are processed in parallel in the chunks of this number of queries
+const int DistanceQueryChunkSize = 16;
+
+// The rays are processed in parallel in the chunks of this number of rays
+const int RayQueryChunkSize = 64;
+
+// The parameters of the continuous collision detection
+const double ContinuousCollisionTolerance = 1.0e-3;
+const int MaxNumConservativeAdvancements = 32;
+const int MaxNumContactSearches = 8;
+
 typedef CollisionDetector::GeometryHandle GeometryHandle;
+typedef CollisionDetectorDistanceAPI::DistanceQuery DistanceQuery;
+typedef CollisionDetectorRayCastAPI::RayQuery RayQuery;
 
 CollisionDetector* factory()
 {
@@ -44,10 +70,99 @@ public:
     bool isStatic;
     stdx::optional<Isometry3> localPosition;
     ColdetModelExPtr sibling;
+    BoundingBox localBoundingBox;
+    BoundingBox boundingBox; // in the world coordinate
+    CollisionPrimitive primitive;
+    Isometry3 localPrimitivePosition;
+    Isometry3 primitivePosition; // in the world coordinate
+
+    // index in the model array of the detector
+    int index;
+    // keys of the entries in the model pair index map that contain this model
+    vector<int64_t> pairKeys;
+    // geometries that make the ignored pairs with this model
+    vector<GeometryHandle> ignoredPartners;
+
+    // for the continuous collision detection
+    bool isContinuous;
+    bool hasPositionAtLastDetection;
+    Isometry3 position;
+    Isometry3 positionAtLastDetection;
+    BoundingBox boundingBoxAtLastDetection;
+    // radius of the sphere centered at the local origin that encloses the model
+    double localRadius;
     
-    ColdetModelEx() : isStatic(false) { }
+    ColdetModelEx() { initialize(); }
+    ColdetModelEx(const ColdetModel& org) : ColdetModel(org) { initialize(); }
+
+    void initialize(){
+        isStatic = false;
+        index = -1;
+        isContinuous = false;
+        hasPositionAtLastDetection = false;
+        position.setIdentity();
+        localRadius = 0.0;
+    }
+    void initializeBoundingBox();
+    void updatePositionAndBoundingBox(const Isometry3& T);
+    bool isUnbounded() const { return getPrimitiveType() == SP_PLANE; }
 };
 
+
+/**
+   This class keeps the built models so that the models of the same geometries are not built again
+   when the collision detector is re-created, as is done when a simulation is restarted.
+   The internal model of a cached model is shared with the models created from it.
+   A geometry is identified by the meshes extracted from it, the hashes of their vertices and
+   triangles, and their transforms. The cloned scene nodes share the meshes with the original ones,
+   so the geometries of an unchanged world are found in the cache even if their nodes are cloned
+   again, and a mesh modified in place is not identified with the model built before the change.
+*/
+class ColdetModelCache
+{
+public:
+    struct MeshKey
+    {
+        weak_ref_ptr<SgMesh> mesh;
+        const SgVertexArray* vertices;
+        int numVertices;
+        int numTriangles;
+        uint64_t contentHash;
+        Affine3 T;
+
+        void set(SgMesh* mesh, const Affine3& T);
+        bool matches(const MeshKey& key) const {
+            return vertices == key.vertices && numVertices == key.numVertices &&
+                numTriangles == key.numTriangles && contentHash == key.contentHash &&
+                T.matrix() == key.T.matrix() && mesh.lock() == key.mesh.lock();
+        }
+    };
+
+    static ColdetModelCache& instance(){
+        static ColdetModelCache cache;
+        return cache;
+    }
+
+    ref_ptr<ColdetModel> find(const vector<MeshKey>& keys);
+    void add(const vector<MeshKey>& keys, ColdetModel* model);
+    void clear();
+
+private:
+    struct Entry
+    {
+        vector<MeshKey> keys;
+        ref_ptr<ColdetModel> model;
+    };
+    unordered_map<const SgMesh*, vector<Entry>> entryMap;
+    int numEntries;
+    int numEntriesAfterLastPruning;
+    std::mutex mutex;
+
+    ColdetModelCache() : numEntries(0), numEntriesAfterLastPruning(0) { }
+    void pruneExpiredEntries();
+};
+
+
 class ColdetModelPairEx;
 typedef ref_ptr<ColdetModelPairEx> ColdetModelPairExPtr;
 
@@ -61,14 +176,49 @@ GeometryHandle getHandle(ColdetModelEx* model)
     return reinterpret_cast<GeometryHandle>(model);
 }
 
+void removeIgnoredPartner(ColdetModelEx* model, GeometryHandle partner)
+{
+    auto& partners = model->ignoredPartners;
+    auto p = std::find(partners.begin(), partners.end(), partner);
+    if(p != partners.end()){
+        *p = partners.back();
+        partners.pop_back();
+    }
+}
+
+inline int64_t getModelPairKey(int index1, int index2)
+{
+    return (static_cast<int64_t>(index1) << 32) | index2;
+}
+
+inline int getFirstModelIndex(int64_t key)
+{
+    return static_cast<int>(key >> 32);
+}
+
+inline int getSecondModelIndex(int64_t key)
+{
+    return static_cast<int>(key & 0xffffffff);
+}
+
 class ColdetModelPairEx : public ColdetModelPair
 {
-    ColdetModelPairEx(){ }
+    ColdetModelPairEx()
+        : numCollisionsOfLastDetection(0),
+          isPrimitivePair(false)
+    {
+        setCollisionCacheEnabled(true);
+    }
     
 public:
     ColdetModelPairEx(ColdetModelEx* model1, ColdetModelEx* model2)
-        : ColdetModelPair(model1, model2)
+        : ColdetModelPair(model1, model2),
+          numCollisionsOfLastDetection(0),
+          isPrimitivePair(false)
     {
+        // The geometries of the models are not modified after they are added
+        setCollisionCacheEnabled(true);
+
         ColdetModelPairEx* last = this;
         for(auto sibling1 = model1->sibling; sibling1; sibling1 = sibling1->sibling){
             for(auto sibling2 = model2->sibling; sibling2; sibling2 = sibling2->sibling){
@@ -84,22 +234,160 @@ public:
     }
 
     ColdetModelPairExPtr sibling;
+
+    // used as the cost estimate of the pair to make the batches of the multithread mode
+    int numCollisionsOfLastDetection;
+
+    // The collisions are detected by the closed-form routine of the primitives
+    bool isPrimitivePair;
+
+    // The pair of the copies of the models to detect the collisions in the motion of the models
+    ColdetModelPairPtr sweptModelPair;
 };
 
 
-bool copyCollisionPairCollisions(ColdetModelPairEx* srcPair, CollisionPair& destPair, bool doReserve = false)
+/**
+   The motion of a model between the last detection and the current detection. The translation
+   and the rotation about a fixed axis are linearly interpolated, so the displacement of the
+   points of the model per unit parameter is bounded by boundOfDisplacement.
+*/
+class ModelMotion
 {
-    vector<Collision>& collisions = destPair.collisions();
+public:
+    Isometry3 T0;
+    Vector3 translation;
+    AngleAxis rotation;
+    double boundOfDisplacement;
+
+    ModelMotion(ColdetModelEx* model){
+        if(model->isContinuous && model->hasPositionAtLastDetection){
+            T0 = model->positionAtLastDetection;
+            translation = model->position.translation() - T0.translation();
+            rotation = AngleAxis(Matrix3(T0.linear().transpose() * model->position.linear()));
+        } else {
+            T0 = model->position;
+            translation.setZero();
+            rotation = AngleAxis(0.0, Vector3::UnitX());
+        }
+        boundOfDisplacement = translation.norm() + rotation.angle() * model->localRadius;
+    }
 
-    if(collisions.empty()){
-        for(int i=0; i < 2; ++i){
-            auto model = srcPair->model(i);
-            destPair.object(i) = model->object;
-            destPair.geometry(i) = getHandle(model);
+    Isometry3 position(double t) const {
+        Isometry3 T;
+        T.linear() = T0.linear() * AngleAxis(t * rotation.angle(), rotation.axis()).toRotationMatrix();
+        T.translation() = T0.translation() + t * translation;
+        return T;
+    }
+};
+
+
+void ColdetModelEx::initializeBoundingBox()
+{
+    localBoundingBox.clear();
+    const int n = getNumVertices();
+    for(int i=0; i < n; ++i){
+        float x, y, z;
+        getVertex(i, x, y, z);
+        localBoundingBox.expandBy(x, y, z);
+    }
+
+    // The mesh of a round primitive is inscribed in its analytic shape
+    if(primitive.type != CollisionPrimitive::NoPrimitive &&
+       primitive.type != CollisionPrimitive::HeightField){
+        Vector3 h;
+        if(primitive.type == CollisionPrimitive::Box){
+            h = primitive.halfSize;
+        } else if(primitive.type == CollisionPrimitive::Sphere){
+            h.setConstant(primitive.radius);
+        } else {
+            h << primitive.radius, primitive.halfHeight + primitive.radius, primitive.radius;
+        }
+        const Vector3 center = localPrimitivePosition.translation();
+        const Vector3 halfSize = localPrimitivePosition.linear().cwiseAbs() * h;
+        localBoundingBox.expandBy(BoundingBox(center - halfSize, center + halfSize));
+    }
+    
+    boundingBox = localBoundingBox;
+
+    localRadius = 0.0;
+    if(!localBoundingBox.empty()){
+        const Vector3& min = localBoundingBox.min();
+        const Vector3& max = localBoundingBox.max();
+        const Vector3 farthestCorner = min.cwiseAbs().cwiseMax(max.cwiseAbs());
+        localRadius = farthestCorner.norm();
+    }
+}
+
+
+void ColdetModelEx::updatePositionAndBoundingBox(const Isometry3& T)
+{
+    setPosition(T);
+    position = T;
+    if(primitive.type != CollisionPrimitive::NoPrimitive){
+        primitivePosition = T * localPrimitivePosition;
+    }
+    if(!localBoundingBox.empty()){
+        const Vector3 center = T * localBoundingBox.center();
+        const Vector3 halfSize =
+            T.linear().cwiseAbs() * (0.5 * localBoundingBox.size()) + Vector3::Constant(BroadphaseMargin);
+        boundingBox.set(center - halfSize, center + halfSize);
+    }
+}
+
+
+double calcBoundingBoxDistance(const BoundingBox& bbox1, const BoundingBox& bbox2)
+{
+    Vector3 gap;
+    for(int i=0; i < 3; ++i){
+        gap[i] = std::max(0.0, std::max(bbox1.min()[i] - bbox2.max()[i], bbox2.min()[i] - bbox1.max()[i]));
+    }
+    return gap.norm();
+}
+
+
+/**
+   \return true if the ray enters the box before maxDistance. The entry distance is stored in out_distance.
+*/
+bool calcRayBoundingBoxEntry
+(const Vector3& origin, const Vector3& inverseDirection, double maxDistance, const BoundingBox& bbox,
+ double& out_distance)
+{
+    double tmin = 0.0;
+    double tmax = maxDistance;
+    for(int i=0; i < 3; ++i){
+        double t1 = (bbox.min()[i] - origin[i]) * inverseDirection[i];
+        double t2 = (bbox.max()[i] - origin[i]) * inverseDirection[i];
+        if(t1 > t2){
+            std::swap(t1, t2);
+        }
+        // The comparisons are false for NaN given by a zero direction component on the box surface
+        if(t1 > tmin){
+            tmin = t1;
+        }
+        if(t2 < tmax){
+            tmax = t2;
+        }
+        if(tmin > tmax){
+            return false;
         }
     }
+    out_distance = tmin;
+    return true;
+}
+
 
-    const std::vector<collision_data>& cdata = srcPair->collisions();
+void setCollisionPairModels(ColdetModelPairEx* srcPair, CollisionPair& destPair)
+{
+    for(int i=0; i < 2; ++i){
+        auto model = srcPair->model(i);
+        destPair.object(i) = model->object;
+        destPair.geometry(i) = getHandle(model);
+    }
+}
+
+
+void appendCollisions(const std::vector<collision_data>& cdata, vector<Collision>& collisions, bool doReserve)
+{
     const int n = cdata.size();
 
     if(doReserve){
@@ -110,7 +398,8 @@ bool copyCollisionPairCollisions(ColdetModelPairEx* srcPair, CollisionPair& dest
         const collision_data& cd = cdata[j];
         for(int k=0; k < cd.num_of_i_points; ++k){
             if(cd.i_point_new[k]){
-                Collision& collision = destPair.newCollision();
+                collisions.push_back(Collision());
+                Collision& collision = collisions.back();
                 collision.point = cd.i_points[k];
                 collision.normal = cd.n_vector;
                 collision.depth = cd.depth;
@@ -119,10 +408,164 @@ bool copyCollisionPairCollisions(ColdetModelPairEx* srcPair, CollisionPair& dest
             }
         }
     }
+}
+
+
+bool copyCollisionPairCollisions(ColdetModelPairEx* srcPair, CollisionPair& destPair, bool doReserve = false)
+{
+    vector<Collision>& collisions = destPair.collisions();
+
+    if(collisions.empty()){
+        setCollisionPairModels(srcPair, destPair);
+    }
+
+    appendCollisions(srcPair->collisions(), collisions, doReserve);
 
     return !collisions.empty();
 }
 
+
+void setPrimitive(SgMesh* mesh, CollisionPrimitive& out_primitive)
+{
+    switch(mesh->primitiveType()){
+    case SgMesh::MeshType:
+        if(auto heightField = mesh->sharedHeightField()){
+            out_primitive.type = CollisionPrimitive::HeightField;
+            out_primitive.heightField = heightField;
+        } else {
+            out_primitive.type = CollisionPrimitive::NoPrimitive;
+        }
+        break;
+    case SgMesh::BoxType:
+        out_primitive.type = CollisionPrimitive::Box;
+        out_primitive.halfSize = mesh->primitive<SgMesh::Box>().size / 2.0;
+        break;
+    case SgMesh::SphereType:
+        out_primitive.type = CollisionPrimitive::Sphere;
+        out_primitive.radius = mesh->primitive<SgMesh::Sphere>().radius;
+        break;
+    case SgMesh::CapsuleType:
+    {
+        auto& capsule = mesh->primitive<SgMesh::Capsule>();
+        out_primitive.type = CollisionPrimitive::Capsule;
+        out_primitive.radius = capsule.radius;
+        out_primitive.halfHeight = capsule.height / 2.0;
+        break;
+    }
+    default:
+        // The cylinders and the cones are detected as the meshes
+        out_primitive.type = CollisionPrimitive::NoPrimitive;
+        break;
+    }
+}
+
+
+void ColdetModelCache::MeshKey::set(SgMesh* mesh_, const Affine3& T_)
+{
+    mesh = mesh_;
+    vertices = mesh_->vertices();
+    numVertices = mesh_->hasVertices() ? vertices->size() : 0;
+    numTriangles = mesh_->numTriangles();
+    T = T_;
+
+    // FNV-1a hash of the vertices and the triangle indices
+    contentHash = 14695981039346656037ULL;
+    auto addBytes = [this](const void* data, size_t size){
+        auto bytes = static_cast<const unsigned char*>(data);
+        for(size_t i=0; i < size; ++i){
+            contentHash = (contentHash ^ bytes[i]) * 1099511628211ULL;
+        }
+    };
+    if(numVertices > 0){
+        addBytes(vertices->data(), numVertices * sizeof(SgVertexArray::value_type));
+    }
+    auto& indices = mesh_->triangleVertices();
+    if(!indices.empty()){
+        addBytes(indices.data(), indices.size() * sizeof(SgIndexArray::value_type));
+    }
+}
+
+
+ref_ptr<ColdetModel> ColdetModelCache::find(const vector<MeshKey>& keys)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    
+    auto p = entryMap.find(keys.front().mesh.lock());
+    if(p != entryMap.end()){
+        for(auto& entry : p->second){
+            if(entry.keys.size() == keys.size()){
+                bool matched = true;
+                for(size_t i=0; i < keys.size(); ++i){
+                    if(!entry.keys[i].matches(keys[i])){
+                        matched = false;
+                        break;
+                    }
+                }
+                if(matched){
+                    return entry.model;
+                }
+            }
+        }
+    }
+    return nullptr;
+}
+
+
+/**
+   The expired entries are removed when the number of the entries has doubled since the last
+   pruning so that the models of the released meshes are not kept until the cache is cleared.
+   The cost of the pruning is amortized over the additions.
+*/
+void ColdetModelCache::add(const vector<MeshKey>& keys, ColdetModel* model)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    Entry entry;
+    entry.keys = keys;
+    entry.model = new ColdetModel(*model);
+    entryMap[keys.front().mesh.lock()].push_back(entry);
+
+    const int minNumEntriesToPrune = 64;
+    if(++numEntries >= std::max(2 * numEntriesAfterLastPruning, minNumEntriesToPrune)){
+        pruneExpiredEntries();
+    }
+}
+
+
+void ColdetModelCache::clear()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    entryMap.clear();
+    numEntries = 0;
+    numEntriesAfterLastPruning = 0;
+}
+
+
+void ColdetModelCache::pruneExpiredEntries()
+{
+    auto isExpired = [](const Entry& entry){
+        for(auto& key : entry.keys){
+            if(key.mesh.expired()){
+                return true;
+            }
+        }
+        return false;
+    };
+    numEntries = 0;
+    auto p = entryMap.begin();
+    while(p != entryMap.end()){
+        auto& entries = p->second;
+        entries.erase(std::remove_if(entries.begin(), entries.end(), isExpired), entries.end());
+        if(entries.empty()){
+            p = entryMap.erase(p);
+        } else {
+            numEntries += entries.size();
+            ++p;
+        }
+    }
+    numEntriesAfterLastPruning = numEntries;
+}
+
 }
 
 namespace cnoid {
@@ -130,31 +573,89 @@ namespace cnoid {
 class AISTCollisionDetectorImpl
 {
 public:
+    /*
+       The element of a removed model is set to null and the index is reused by a model added
+       later so that the indices of the other models are not changed.
+    */
     vector<ColdetModelExPtr> models;
+    vector<int> freeModelIndices;
+    /*
+       The indices of the models removed after makeReady are kept here until they are removed
+       from sortedModelIndices by the next broadphase, and then they are moved to freeModelIndices.
+    */
+    vector<int> removedModelIndices;
     vector<ColdetModelPairExPtr> modelPairs;
+    vector<int> freeModelPairIndices;
     int maxNumThreads;
     set<IdPair<GeometryHandle>> ignoredPairs;
     MeshExtractor* meshExtractor;
     bool isReady;
+    bool isPrimitiveShapeCollisionEnabled;
+
+    /*
+       The model pairs are created when the bounding boxes of the models overlap for the first time.
+       The key is made of the model indices by getModelPairKey, and the value is the index of the
+       pair in modelPairs, or -1 for a pair that is not checked.
+    */
+    unordered_map<int64_t, int> modelPairIndexMap;
+
+    // for the broadphase
+    vector<BoundingBox> boundingBoxes;
+    vector<int> sortedModelIndices;
+    vector<int64_t> overlappingPairKeys;
+    vector<int> candidatePairIndices;
+    vector<ColdetModelEx*> continuousModels;
         
     AISTCollisionDetectorImpl();
     ~AISTCollisionDetectorImpl();
     stdx::optional<GeometryHandle> addGeometry(SgNode* geometry);
     void addMesh(ColdetModelEx* model);
+    bool removeGeometry(GeometryHandle geometry);
+    ColdetModelEx* findModel(GeometryHandle geometry);
+    void ignoreGeometryPair(GeometryHandle geometry1, GeometryHandle geometry2, bool ignore);
     void makeReady();
+    void extractCandidatePairs();
+    int findOrCreateModelPair(int index1, int index2);
+    void releaseModelPair(int64_t key);
+    void detectCollisionsOfModelPair(ColdetModelPairEx* modelPair, CollisionPair& collisionPair, bool doReserve);
+    void detectCollisionsInMotion(ColdetModelPairEx* modelPair, CollisionPair& collisionPair);
+    void updatePositionsAtLastDetection();
     void detectCollisions(std::function<void(const CollisionPair&)> callback);
     void detectCollisionsInParallel(std::function<void(const CollisionPair&)> callback);
 
     // for multithread version
     int numThreads;
-    unique_ptr<ThreadPool> threadPool;
-    vector<int> shuffledPairIndices;
+    TaskScheduler* taskScheduler;
     vector<vector<CollisionPair>> collisionPairArrays;
+    struct PairBatch
+    {
+        // range in candidatePairIndices
+        int pairIndexBegin;
+        int pairIndexEnd;
+        double cost;
+        // range of the collision pairs in the array of the thread that processed the batch
+        int threadIndex;
+        int collisionPairIndexBegin;
+        int collisionPairIndexEnd;
+    };
+    vector<PairBatch> pairBatches;
+    vector<int> pairBatchSchedule;
+    std::atomic<int> nextPairBatchScheduleIndex;
     mt19937 randomEngine;
-    
+
+    void makePairBatches();
+    void processPairBatches(int threadIndex);
     void extractCollisionsOfAssignedPairs(
         int pairIndexBegin, int pairIndexEnd, vector<CollisionPair>& collisionPairs);    
     void dispatchCollisionsInCollisionPairArrays(std::function<void(const CollisionPair&)> callback);    
+
+    void detectDistances(vector<DistanceQuery>& queries, double threshold);
+    void detectDistances(GeometryHandle geometry, double threshold, vector<DistanceQuery>& out_queries);
+    void detectDistance(DistanceQuery& query, double threshold);
+
+    vector<ColdetModelEx*> rayCastModels;
+    void castRays(vector<RayQuery>& queries);
+    void castRay(RayQuery& query, vector<pair<double, ColdetModelEx*>>& candidates);
 };
 
 }
@@ -169,8 +670,10 @@ AISTCollisionDetector::AISTCollisionDetector()
 AISTCollisionDetectorImpl::AISTCollisionDetectorImpl()
 {
     isReady = false;
+    isPrimitiveShapeCollisionEnabled = true;
     maxNumThreads = 0;
     numThreads = 0;
+    taskScheduler = TaskScheduler::instance();
     meshExtractor = new MeshExtractor;
 
     if(ENABLE_SHUFFLE){
@@ -210,11 +713,36 @@ void AISTCollisionDetector::setNumThreads(int n)
     impl->maxNumThreads = n;
 }
 
+
+void AISTCollisionDetector::setPrimitiveShapeCollisionEnabled(bool on)
+{
+    if(on != impl->isPrimitiveShapeCollisionEnabled){
+        impl->isPrimitiveShapeCollisionEnabled = on;
+        impl->isReady = false;
+    }
+}
+
+
+bool AISTCollisionDetector::isPrimitiveShapeCollisionEnabled() const
+{
+    return impl->isPrimitiveShapeCollisionEnabled;
+}
+
+
+void AISTCollisionDetector::clearGeometryCache()
+{
+    ColdetModelCache::instance().clear();
+}
+
         
 void AISTCollisionDetector::clearGeometries()
 {
     impl->models.clear();
+    impl->freeModelIndices.clear();
+    impl->removedModelIndices.clear();
     impl->modelPairs.clear();
+    impl->freeModelPairIndices.clear();
+    impl->modelPairIndexMap.clear();
     impl->ignoredPairs.clear();
     impl->isReady = false;
 }
@@ -222,7 +750,7 @@ void AISTCollisionDetector::clearGeometries()
 
 int AISTCollisionDetector::numGeometries() const
 {
-    return impl->models.size();
+    return impl->models.size() - impl->freeModelIndices.size() - impl->removedModelIndices.size();
 }
 
 
@@ -235,15 +763,58 @@ stdx::optional<GeometryHandle> AISTCollisionDetector::addGeometry(SgNode* geomet
 stdx::optional<GeometryHandle> AISTCollisionDetectorImpl::addGeometry(SgNode* geometry)
 {
     if(geometry){
-        ColdetModelExPtr model = new ColdetModelEx;
-        if(meshExtractor->extract(geometry, [&]() { addMesh(model); })){
-            model->setName(geometry->name());
+        vector<ColdetModelCache::MeshKey> meshKeys;
+        CollisionPrimitive primitive;
+        Isometry3 primitivePosition;
+        meshExtractor->extract(
+            geometry,
+            [&](){
+                SgMesh* mesh = meshExtractor->currentMesh();
+                if(meshKeys.empty() && !meshExtractor->isCurrentScaled()){
+                    setPrimitive(mesh, primitive);
+                    primitivePosition = meshExtractor->currentTransformWithoutScaling();
+                } else {
+                    // A geometry of multiple meshes is not a primitive
+                    primitive.type = CollisionPrimitive::NoPrimitive;
+                }
+                meshKeys.emplace_back();
+                meshKeys.back().set(mesh, meshExtractor->currentTransform());
+            });
+        if(meshKeys.empty()){
+            return stdx::nullopt;
+        }
+
+        auto& cache = ColdetModelCache::instance();
+        ColdetModelExPtr model;
+        if(auto cachedModel = cache.find(meshKeys)){
+            model = new ColdetModelEx(*cachedModel);
+        } else {
+            model = new ColdetModelEx;
+            meshExtractor->extract(geometry, [&]() { addMesh(model); });
             model->build();
             if(model->isValid()){
+                cache.add(meshKeys, model);
+            }
+        }
+        model->setName(geometry->name());
+        if(model->isValid()){
+            model->primitive = primitive;
+            model->localPrimitivePosition = primitivePosition;
+            model->primitivePosition = primitivePosition;
+            model->initializeBoundingBox();
+            if(freeModelIndices.empty()){
+                model->index = models.size();
                 models.push_back(model);
-                isReady = false;
-                return getHandle(model);
+            } else {
+                model->index = freeModelIndices.back();
+                freeModelIndices.pop_back();
+                models[model->index] = model;
+            }
+            // The pairs of the model are created by the broadphase, so the other pairs are kept
+            if(isReady){
+                sortedModelIndices.push_back(model->index);
             }
+            return getHandle(model);
         }
     }
     return stdx::nullopt;
@@ -275,6 +846,63 @@ void AISTCollisionDetectorImpl::addMesh(ColdetModelEx* model)
 }
 
 
+bool AISTCollisionDetector::removeGeometry(GeometryHandle geometry)
+{
+    return impl->removeGeometry(geometry);
+}
+
+
+/**
+   The pairs and the ignored pairs of the removed model are released and the other pairs are kept,
+   so the cost of the removal depends on the number of the pairs of the model instead of all the
+   pairs. The model is removed from the sorted model list in the next broadphase, which traverses
+   the list anyway.
+*/
+bool AISTCollisionDetectorImpl::removeGeometry(GeometryHandle geometry)
+{
+    auto model = findModel(geometry);
+    if(!model){
+        return false;
+    }
+
+    while(!model->pairKeys.empty()){
+        releaseModelPair(model->pairKeys.back());
+    }
+
+    for(auto partner : model->ignoredPartners){
+        ignoredPairs.erase(IdPair<GeometryHandle>(geometry, partner));
+        if(partner != geometry){
+            removeIgnoredPartner(getColdetModel(partner), geometry);
+        }
+    }
+    model->ignoredPartners.clear();
+
+    const int index = model->index;
+    model->index = -1;
+    models[index].reset();
+    if(isReady){
+        removedModelIndices.push_back(index);
+    } else {
+        freeModelIndices.push_back(index);
+    }
+
+    return true;
+}
+
+
+ColdetModelEx* AISTCollisionDetectorImpl::findModel(GeometryHandle geometry)
+{
+    auto model = getColdetModel(geometry);
+    if(model){
+        const int index = model->index;
+        if(index >= 0 && index < static_cast<int>(models.size()) && models[index] == model){
+            return model;
+        }
+    }
+    return nullptr;
+}
+
+
 void AISTCollisionDetector::setCustomObject(GeometryHandle geometry, Referenced* object)
 {
     getColdetModel(geometry)->object = object;
@@ -283,24 +911,66 @@ void AISTCollisionDetector::setCustomObject(GeometryHandle geometry, Referenced*
 
 void AISTCollisionDetector::setGeometryStatic(GeometryHandle geometry, bool isStatic)
 {
+    // The static pairs are skipped by the broadphase, so the pairs do not have to be rebuilt
     getColdetModel(geometry)->isStatic = isStatic;
-    impl->isReady = false;
+}
+
+
+bool AISTCollisionDetector::setContinuousCollisionDetectionEnabled(GeometryHandle geometry, bool on)
+{
+    auto model = getColdetModel(geometry);
+    if(on != model->isContinuous){
+        model->isContinuous = on;
+        model->hasPositionAtLastDetection = false;
+    }
+    return true;
 }
 
 
 void AISTCollisionDetector::ignoreGeometryPair(GeometryHandle geometry1, GeometryHandle geometry2, bool ignore)
+{
+    impl->ignoreGeometryPair(geometry1, geometry2, ignore);
+}
+
+
+void AISTCollisionDetectorImpl::ignoreGeometryPair(GeometryHandle geometry1, GeometryHandle geometry2, bool ignore)
 {
     IdPair<GeometryHandle> idPair(geometry1, geometry2);
+    bool changed = false;
     if(ignore){
-        auto result = impl->ignoredPairs.insert(idPair);
-        if(result.second){
-            impl->isReady = false;
+        changed = ignoredPairs.insert(idPair).second;
+        if(changed){
+            getColdetModel(geometry1)->ignoredPartners.push_back(geometry2);
+            if(geometry2 != geometry1){
+                getColdetModel(geometry2)->ignoredPartners.push_back(geometry1);
+            }
         }
     } else {
-        auto p = impl->ignoredPairs.find(idPair);
-        if(p != impl->ignoredPairs.end()){
-            impl->ignoredPairs.erase(p);
-            impl->isReady = false;
+        auto p = ignoredPairs.find(idPair);
+        if(p != ignoredPairs.end()){
+            ignoredPairs.erase(p);
+            removeIgnoredPartner(getColdetModel(geometry1), geometry2);
+            if(geometry2 != geometry1){
+                removeIgnoredPartner(getColdetModel(geometry2), geometry1);
+            }
+            changed = true;
+        }
+    }
+
+    // The pair is released to be examined again when the broadphase finds it next time
+    if(changed && isReady){
+        auto model1 = findModel(geometry1);
+        auto model2 = findModel(geometry2);
+        if(model1 && model2){
+            int index1 = model1->index;
+            int index2 = model2->index;
+            if(index1 > index2){
+                std::swap(index1, index2);
+            }
+            const int64_t key = getModelPairKey(index1, index2);
+            if(modelPairIndexMap.find(key) != modelPairIndexMap.end()){
+                releaseModelPair(key);
+            }
         }
     }
 }
@@ -316,35 +986,25 @@ bool AISTCollisionDetector::makeReady()
 void AISTCollisionDetectorImpl::makeReady()
 {
     modelPairs.clear();
-    const int n = models.size();
-    for(int i=0; i < n; ++i){
-        ColdetModelEx* model1 = models[i];
-        for(int j = i + 1; j < n; ++j){
-            ColdetModelEx* model2 = models[j];
-            if(!model1->isStatic || !model2->isStatic){
-                IdPair<GeometryHandle> handlePair(getHandle(model1), getHandle(model2));
-                if(ignoredPairs.find(handlePair) == ignoredPairs.end()){
-                    modelPairs.push_back(new ColdetModelPairEx(model1, model2));
-                }
-            }
+    freeModelPairIndices.clear();
+    modelPairIndexMap.clear();
+
+    freeModelIndices.insert(freeModelIndices.end(), removedModelIndices.begin(), removedModelIndices.end());
+    removedModelIndices.clear();
+    sortedModelIndices.clear();
+    for(auto& model : models){
+        if(model){
+            model->pairKeys.clear();
+            sortedModelIndices.push_back(model->index);
         }
     }
 
-    const int numPairs = modelPairs.size();
-
+    // The tasks are processed by the threads of the task scheduler shared in the process
     if(maxNumThreads <= 0){
         numThreads = 0;
-        threadPool.reset();
         collisionPairArrays.clear();
-    } else {
-        numThreads = (maxNumThreads > numPairs) ? numPairs : maxNumThreads;
-        threadPool.reset(new ThreadPool(numThreads));
-        if(ENABLE_SHUFFLE){
-            shuffledPairIndices.resize(modelPairs.size());
-            for(size_t i=0; i < shuffledPairIndices.size(); ++i){
-                shuffledPairIndices[i] = i;
-            }
-        }
+    } else if(maxNumThreads != numThreads){
+        numThreads = maxNumThreads;
         collisionPairArrays.resize(numThreads);
     }
 
@@ -358,9 +1018,9 @@ void AISTCollisionDetector::updatePosition(GeometryHandle geometry, const Isomet
     do {
         if(model->localPosition){
             Isometry3 T = position * (*model->localPosition);
-            model->setPosition(T);
+            model->updatePositionAndBoundingBox(T);
         } else {
-            model->setPosition(position);
+            model->updatePositionAndBoundingBox(position);
         }
         model = model->sibling;
     } while(model);
@@ -371,14 +1031,17 @@ void AISTCollisionDetector::updatePositions
 (std::function<void(Referenced* object, Isometry3*& out_Position)> positionQuery)
 {
     for(ColdetModelEx* model : impl->models){ // Do not use auto&
+        if(!model){
+            continue;
+        }
         do {
             Isometry3* T;
             positionQuery(model->object, T);
             if(model->localPosition){
                 Isometry3 T2 = (*T) * (*model->localPosition);
-                model->setPosition(T2);
+                model->updatePositionAndBoundingBox(T2);
             } else {
-                model->setPosition(*T);
+                model->updatePositionAndBoundingBox(*T);
             }
             model = model->sibling; // Elements in models are overridden here if auto& is used
         } while(model);
@@ -391,91 +1054,390 @@ void AISTCollisionDetector::detectCollisions(std::function<void(const CollisionP
     if(!impl->isReady){
         impl->makeReady();
     }
+    impl->extractCandidatePairs();
     if(impl->numThreads > 0){
         impl->detectCollisionsInParallel(callback);
     } else {
         impl->detectCollisions(callback);
     }
+    impl->updatePositionsAtLastDetection();
 } 
 
 
 /**
-   \todo Remeber which geometry positions are updated after the last collision detection
-   and do the actual collision detection only for the updated geometry pairs.
+   The broadphase to extract the model pairs whose bounding boxes overlap by sweep and prune
+   along the x axis. The sorted order of the previous step is kept and updated by the insertion
+   sort, which is almost linear when the models move little in a step. The candidate pairs are
+   sorted by the model indices so that the pairs are processed in the same order as the pairs
+   of all the combinations.
 */
+void AISTCollisionDetectorImpl::extractCandidatePairs()
+{
+    if(!removedModelIndices.empty()){
+        sortedModelIndices.erase(
+            std::remove_if(
+                sortedModelIndices.begin(), sortedModelIndices.end(),
+                [this](int index){ return !models[index]; }),
+            sortedModelIndices.end());
+        freeModelIndices.insert(freeModelIndices.end(), removedModelIndices.begin(), removedModelIndices.end());
+        removedModelIndices.clear();
+    }
+
+    const int n = models.size();
+    boundingBoxes.resize(n);
+    continuousModels.clear();
+    for(int i=0; i < n; ++i){
+        ColdetModelEx* model = models[i];
+        BoundingBox& bbox = boundingBoxes[i];
+        bbox.clear();
+        if(!model){
+            continue;
+        }
+        if(model->isContinuous){
+            // The box of a continuous model covers its motion from the last detection
+            continuousModels.push_back(model);
+            if(model->hasPositionAtLastDetection){
+                bbox.expandBy(model->boundingBoxAtLastDetection);
+            }
+        }
+        do {
+            if(model->isUnbounded()){
+                const double inf = std::numeric_limits<double>::infinity();
+                bbox.set(Vector3::Constant(-inf), Vector3::Constant(inf));
+                break;
+            }
+            bbox.expandBy(model->boundingBox);
+            model = model->sibling;
+        } while(model);
+    }
+
+    const int numSortedModels = sortedModelIndices.size();
+    for(int i=1; i < numSortedModels; ++i){
+        const int index = sortedModelIndices[i];
+        const double x = boundingBoxes[index].min().x();
+        int j = i - 1;
+        while(j >= 0 && boundingBoxes[sortedModelIndices[j]].min().x() > x){
+            sortedModelIndices[j + 1] = sortedModelIndices[j];
+            --j;
+        }
+        sortedModelIndices[j + 1] = index;
+    }
+
+    overlappingPairKeys.clear();
+    for(int i=0; i < numSortedModels; ++i){
+        const int index1 = sortedModelIndices[i];
+        const BoundingBox& bbox1 = boundingBoxes[index1];
+        const bool isStatic1 = models[index1]->isStatic;
+        for(int j = i + 1; j < numSortedModels; ++j){
+            const int index2 = sortedModelIndices[j];
+            const BoundingBox& bbox2 = boundingBoxes[index2];
+            if(bbox2.min().x() > bbox1.max().x()){
+                break;
+            }
+            if(isStatic1 && models[index2]->isStatic){
+                continue;
+            }
+            if(bbox1.min().y() <= bbox2.max().y() && bbox2.min().y() <= bbox1.max().y() &&
+               bbox1.min().z() <= bbox2.max().z() && bbox2.min().z() <= bbox1.max().z()){
+                if(index1 < index2){
+                    overlappingPairKeys.push_back(getModelPairKey(index1, index2));
+                } else {
+                    overlappingPairKeys.push_back(getModelPairKey(index2, index1));
+                }
+            }
+        }
+    }
+    std::sort(overlappingPairKeys.begin(), overlappingPairKeys.end());
+
+    candidatePairIndices.clear();
+    for(auto key : overlappingPairKeys){
+        int pairIndex = findOrCreateModelPair(getFirstModelIndex(key), getSecondModelIndex(key));
+        if(pairIndex >= 0){
+            candidatePairIndices.push_back(pairIndex);
+        }
+    }
+
+    if(ENABLE_SHUFFLE){
+        std::shuffle(candidatePairIndices.begin(), candidatePairIndices.end(), randomEngine);
+    }
+}
+
+
+int AISTCollisionDetectorImpl::findOrCreateModelPair(int index1, int index2)
+{
+    const int64_t key = getModelPairKey(index1, index2);
+    auto inserted = modelPairIndexMap.emplace(key, -1);
+    if(inserted.second){
+        ColdetModelEx* model1 = models[index1];
+        ColdetModelEx* model2 = models[index2];
+        model1->pairKeys.push_back(key);
+        model2->pairKeys.push_back(key);
+        IdPair<GeometryHandle> handlePair(getHandle(model1), getHandle(model2));
+        if(ignoredPairs.find(handlePair) == ignoredPairs.end()){
+            auto modelPair = new ColdetModelPairEx(model1, model2);
+            modelPair->isPrimitivePair =
+                isPrimitiveShapeCollisionEnabled && !model1->sibling && !model2->sibling &&
+                isPrimitivePairSupported(model1->primitive.type, model2->primitive.type);
+            if(freeModelPairIndices.empty()){
+                inserted.first->second = modelPairs.size();
+                modelPairs.push_back(modelPair);
+            } else {
+                inserted.first->second = freeModelPairIndices.back();
+                freeModelPairIndices.pop_back();
+                modelPairs[inserted.first->second] = modelPair;
+            }
+        }
+    }
+    return inserted.first->second;
+}
+
+
+void AISTCollisionDetectorImpl::releaseModelPair(int64_t key)
+{
+    auto p = modelPairIndexMap.find(key);
+    const int pairIndex = p->second;
+    modelPairIndexMap.erase(p);
+    if(pairIndex >= 0){
+        modelPairs[pairIndex].reset();
+        freeModelPairIndices.push_back(pairIndex);
+    }
+    for(auto index : { getFirstModelIndex(key), getSecondModelIndex(key) }){
+        auto& keys = models[index]->pairKeys;
+        auto q = std::find(keys.begin(), keys.end(), key);
+        *q = keys.back();
+        keys.pop_back();
+    }
+}
+
+
 void AISTCollisionDetectorImpl::detectCollisions(std::function<void(const CollisionPair&)> callback)
 {
     CollisionPair collisionPair;
     auto& collisions = collisionPair.collisions();
     
-    for(ColdetModelPairEx* modelPair : modelPairs){ // Do not use auto&
+    for(int pairIndex : candidatePairIndices){
         collisions.clear();
+        detectCollisionsOfModelPair(modelPairs[pairIndex], collisionPair, false);
+        if(!collisions.empty()){
+            callback(collisionPair);
+        }
+    }
+}
+
+
+void AISTCollisionDetectorImpl::detectCollisionsOfModelPair
+(ColdetModelPairEx* modelPair, CollisionPair& collisionPair, bool doReserve)
+{
+    ColdetModelPairEx* pairHead = modelPair;
+    
+    if(modelPair->isPrimitivePair){
+        auto model0 = modelPair->model(0);
+        auto model1 = modelPair->model(1);
+        if(detectPrimitiveCollisions(
+               model0->primitive, model0->primitivePosition, model1->primitive, model1->primitivePosition,
+               collisionPair.collisions())){
+            setCollisionPairModels(modelPair, collisionPair);
+        }
+    } else {
         do {
             if(!modelPair->detectCollisions().empty()){
-                copyCollisionPairCollisions(modelPair, collisionPair);
+                copyCollisionPairCollisions(modelPair, collisionPair, doReserve);
             }
-            modelPair = modelPair->sibling;  // Elements in models are overridden here if auto& is used
+            modelPair = modelPair->sibling;
         } while(modelPair);
+    }
 
-        if(!collisions.empty()){
-            callback(collisionPair);
+    if(collisionPair.collisions().empty()){
+        auto model0 = pairHead->model(0);
+        auto model1 = pairHead->model(1);
+        if((model0->isContinuous || model1->isContinuous) && !model0->sibling && !model1->sibling){
+            detectCollisionsInMotion(pairHead, collisionPair);
         }
     }
+
+    pairHead->numCollisionsOfLastDetection = collisionPair.collisions().size();
 }
 
 
-void AISTCollisionDetectorImpl::detectCollisionsInParallel(std::function<void(const CollisionPair&)> callback)
+/**
+   The first contact in the motion of the models from the last detection is found by the
+   conservative advancement, which advances the motion parameter by the distance divided by the
+   bound of the relative displacement so that the models do not pass through each other.
+   The collisions are then detected slightly after the contact, and they are moved to the positions
+   at the end of the motion with the depths increased by the penetration after the contact.
+*/
+void AISTCollisionDetectorImpl::detectCollisionsInMotion(ColdetModelPairEx* modelPair, CollisionPair& collisionPair)
 {
-    if(ENABLE_SHUFFLE){
-        std::shuffle(shuffledPairIndices.begin(), shuffledPairIndices.end(), randomEngine);
+    auto model0 = modelPair->model(0);
+    auto model1 = modelPair->model(1);
+    const ModelMotion motion0(model0);
+    const ModelMotion motion1(model1);
+    const double bound = motion0.boundOfDisplacement + motion1.boundOfDisplacement;
+    if(bound <= ContinuousCollisionTolerance){
+        return;
+    }
+
+    auto& sweptPair = modelPair->sweptModelPair;
+    if(!sweptPair){
+        sweptPair = new ColdetModelPair(new ColdetModel(*model0), new ColdetModel(*model1));
+    }
+    auto sweptModel0 = sweptPair->model(0);
+    auto sweptModel1 = sweptPair->model(1);
+
+    double t = 0.0;
+    bool isInContact = false;
+    for(int i=0; i < MaxNumConservativeAdvancements; ++i){
+        sweptModel0->setPosition(motion0.position(t));
+        sweptModel1->setPosition(motion1.position(t));
+        double point0[3], point1[3];
+        const double d = sweptPair->computeDistance(point0, point1);
+        if(d <= ContinuousCollisionTolerance){
+            isInContact = true;
+            break;
+        }
+        t += d / bound;
+        if(t >= 1.0){
+            break;
+        }
+    }
+    if(!isInContact){
+        return;
     }
 
-    const int numPairs = modelPairs.size();
-    const int minSize = numPairs / numThreads;
-    int remainder = numPairs % numThreads;
-    int index = 0;
-    for(int i=0; i < numThreads; ++i){
-        int size = minSize;
-        if(remainder > 0){
-            ++size;
-            --remainder;
+    vector<Collision>& collisions = collisionPair.collisions();
+    Isometry3 T0, T1;
+    double dt = ContinuousCollisionTolerance / bound;
+    for(int i=0; i < MaxNumContactSearches; ++i){
+        t = std::min(1.0, t + dt);
+        T0 = motion0.position(t);
+        T1 = motion1.position(t);
+        if(modelPair->isPrimitivePair){
+            detectPrimitiveCollisions(
+                model0->primitive, T0 * model0->localPrimitivePosition,
+                model1->primitive, T1 * model1->localPrimitivePosition, collisions);
+        } else {
+            sweptModel0->setPosition(T0);
+            sweptModel1->setPosition(T1);
+            appendCollisions(sweptPair->detectCollisions(), collisions, false);
         }
-        if(size == 0){
+        if(!collisions.empty() || t >= 1.0){
             break;
         }
-        threadPool->start([this, i, index, size](){
-                extractCollisionsOfAssignedPairs(index, index + size, collisionPairArrays[i]); });
-        index += size;
+        dt *= 2.0;
+    }
+    if(collisions.empty()){
+        return;
     }
-    threadPool->waitLoop();
-    //threadPool->wait();
+
+    const Isometry3 D0 = model0->position * T0.inverse();
+    const Isometry3 D1 = model1->position * T1.inverse();
+    for(auto& collision : collisions){
+        const Vector3 p0 = D0 * collision.point;
+        const Vector3 p1 = D1 * collision.point;
+        // The normal points from model 0 to model 1
+        const double penetration = collision.normal.dot(p0 - p1);
+        if(penetration > 0.0){
+            collision.depth += penetration;
+        }
+        collision.point = 0.5 * (p0 + p1);
+    }
+    setCollisionPairModels(modelPair, collisionPair);
+}
+
+
+void AISTCollisionDetectorImpl::updatePositionsAtLastDetection()
+{
+    for(auto& model : continuousModels){
+        model->positionAtLastDetection = model->position;
+        model->boundingBoxAtLastDetection = model->boundingBox;
+        model->hasPositionAtLastDetection = true;
+    }
+}
+
+
+/**
+   The candidate pairs are divided into the batches of consecutive pairs with similar estimated
+   costs, and each thread takes the next batch from the shared schedule when it finishes one,
+   so that an expensive pair does not make the other threads wait for a fixed chunk.
+   The batches are scheduled in the descending order of the costs, and the collisions are
+   dispatched in the order of the batches to keep the callback order deterministic.
+*/
+void AISTCollisionDetectorImpl::detectCollisionsInParallel(std::function<void(const CollisionPair&)> callback)
+{
+    makePairBatches();
+
+    nextPairBatchScheduleIndex = 0;
+    const int n = std::min(numThreads, static_cast<int>(pairBatches.size()));
+    taskScheduler->parallelFor(0, n, 1, [this](int i){ processPairBatches(i); });
 
     dispatchCollisionsInCollisionPairArrays(callback);
 }
 
 
-void AISTCollisionDetectorImpl::extractCollisionsOfAssignedPairs
-(int pairIndexBegin, int pairIndexEnd, vector<CollisionPair>& collisionPairs)
+void AISTCollisionDetectorImpl::makePairBatches()
+{
+    // The collisions detected in the previous step are used as the costs of the pairs
+    auto getCost = [this](int index){ return 1.0 + modelPairs[index]->numCollisionsOfLastDetection; };
+    
+    const int numPairs = candidatePairIndices.size();
+    double totalCost = 0.0;
+    for(int i=0; i < numPairs; ++i){
+        totalCost += getCost(candidatePairIndices[i]);
+    }
+    const double batchCost = totalCost / (numThreads * NumPairBatchesPerThread);
+
+    pairBatches.clear();
+    PairBatch batch;
+    batch.pairIndexBegin = 0;
+    batch.cost = 0.0;
+    for(int i=0; i < numPairs; ++i){
+        batch.cost += getCost(candidatePairIndices[i]);
+        if(batch.cost >= batchCost || i == numPairs - 1){
+            batch.pairIndexEnd = i + 1;
+            pairBatches.push_back(batch);
+            batch.pairIndexBegin = i + 1;
+            batch.cost = 0.0;
+        }
+    }
+
+    const int numBatches = pairBatches.size();
+    pairBatchSchedule.resize(numBatches);
+    for(int i=0; i < numBatches; ++i){
+        pairBatchSchedule[i] = i;
+    }
+    std::stable_sort(
+        pairBatchSchedule.begin(), pairBatchSchedule.end(),
+        [this](int i, int j){ return pairBatches[i].cost > pairBatches[j].cost; });
+}
+
+
+void AISTCollisionDetectorImpl::processPairBatches(int threadIndex)
 {
+    vector<CollisionPair>& collisionPairs = collisionPairArrays[threadIndex];
     collisionPairs.clear();
 
-    for(int i=pairIndexBegin; i < pairIndexEnd; ++i){
-        ColdetModelPairEx* modelPair;
-        if(ENABLE_SHUFFLE){
-            modelPair = modelPairs[shuffledPairIndices[i]];
-        } else {
-            modelPair = modelPairs[i];
+    const int numBatches = pairBatches.size();
+    while(true){
+        const int scheduleIndex = nextPairBatchScheduleIndex.fetch_add(1);
+        if(scheduleIndex >= numBatches){
+            break;
         }
+        PairBatch& batch = pairBatches[pairBatchSchedule[scheduleIndex]];
+        batch.threadIndex = threadIndex;
+        batch.collisionPairIndexBegin = collisionPairs.size();
+        extractCollisionsOfAssignedPairs(batch.pairIndexBegin, batch.pairIndexEnd, collisionPairs);
+        batch.collisionPairIndexEnd = collisionPairs.size();
+    }
+}
+
 
+void AISTCollisionDetectorImpl::extractCollisionsOfAssignedPairs
+(int pairIndexBegin, int pairIndexEnd, vector<CollisionPair>& collisionPairs)
+{
+    for(int i=pairIndexBegin; i < pairIndexEnd; ++i){
         collisionPairs.push_back(CollisionPair());
         CollisionPair& collisionPair = collisionPairs.back();
-        do {
-            if(!modelPair->detectCollisions().empty()){
-                copyCollisionPairCollisions(modelPair, collisionPair, true);
-            }
-            modelPair = modelPair->sibling;
-        } while(modelPair);
-
+        detectCollisionsOfModelPair(modelPairs[candidatePairIndices[i]], collisionPair, true);
         if(collisionPair.empty()){
             collisionPairs.pop_back();
         }
@@ -485,10 +1447,10 @@ void AISTCollisionDetectorImpl::extractCollisionsOfAssignedPairs
 void AISTCollisionDetectorImpl::dispatchCollisionsInCollisionPairArrays
 (std::function<void(const CollisionPair&)> callback)
 {
-    for(int i=0; i < numThreads; ++i){
-        const vector<CollisionPair>& collisionPairs = collisionPairArrays[i];
-        for(size_t j=0; j < collisionPairs.size(); ++j){
-            callback(collisionPairs[j]);
+    for(auto& batch : pairBatches){
+        const vector<CollisionPair>& collisionPairs = collisionPairArrays[batch.threadIndex];
+        for(int i = batch.collisionPairIndexBegin; i < batch.collisionPairIndexEnd; ++i){
+            callback(collisionPairs[i]);
         }
     }
 }
@@ -500,3 +1462,163 @@ double AISTCollisionDetector::detectDistance
     return ColdetModelPair::computeDistance(
         getColdetModel(geometry1), getColdetModel(geometry2), out_point1.data(), out_point2.data());
 }
+
+
+void AISTCollisionDetector::detectDistances(vector<DistanceQuery>& io_queries, double threshold)
+{
+    impl->detectDistances(io_queries, threshold);
+}
+
+
+void AISTCollisionDetectorImpl::detectDistances(vector<DistanceQuery>& queries, double threshold)
+{
+    if(!isReady){
+        makeReady();
+    }
+    
+    const int n = queries.size();
+    if(numThreads == 0 || n <= DistanceQueryChunkSize){
+        for(auto& query : queries){
+            detectDistance(query, threshold);
+        }
+    } else {
+        taskScheduler->parallelFor(
+            0, n, DistanceQueryChunkSize,
+            [this, &queries, threshold](int i){ detectDistance(queries[i], threshold); });
+    }
+}
+
+
+/**
+   The bounding boxes of the models are compared first. The distance between the boxes is used
+   as the lower bound of the distance when it is larger than the threshold.
+*/
+void AISTCollisionDetectorImpl::detectDistance(DistanceQuery& query, double threshold)
+{
+    auto model1 = getColdetModel(query.geometry1);
+    auto model2 = getColdetModel(query.geometry2);
+    if(!model1->isUnbounded() && !model2->isUnbounded()){
+        double d = calcBoundingBoxDistance(model1->boundingBox, model2->boundingBox);
+        if(d > threshold){
+            query.distance = d;
+            return;
+        }
+    }
+    query.distance = ColdetModelPair::computeDistance(
+        model1, model2, query.point1.data(), query.point2.data());
+}
+
+
+void AISTCollisionDetector::detectDistances
+(GeometryHandle geometry, double threshold, vector<DistanceQuery>& out_queries)
+{
+    impl->detectDistances(geometry, threshold, out_queries);
+}
+
+
+void AISTCollisionDetectorImpl::detectDistances
+(GeometryHandle geometry, double threshold, vector<DistanceQuery>& out_queries)
+{
+    out_queries.clear();
+
+    auto model = findModel(geometry);
+    if(!model){
+        return;
+    }
+    for(auto& other : models){
+        if(!other || other == model){
+            continue;
+        }
+        if(!model->isUnbounded() && !other->isUnbounded()){
+            if(calcBoundingBoxDistance(model->boundingBox, other->boundingBox) > threshold){
+                continue;
+            }
+        }
+        auto handle = getHandle(other);
+        if(ignoredPairs.find(IdPair<GeometryHandle>(geometry, handle)) == ignoredPairs.end()){
+            out_queries.emplace_back(geometry, handle);
+        }
+    }
+    
+    detectDistances(out_queries, threshold);
+
+    out_queries.erase(
+        std::remove_if(
+            out_queries.begin(), out_queries.end(),
+            [threshold](const DistanceQuery& query){ return query.distance > threshold; }),
+        out_queries.end());
+}
+
+
+void AISTCollisionDetector::castRays(vector<RayQuery>& io_queries)
+{
+    impl->castRays(io_queries);
+}
+
+
+void AISTCollisionDetectorImpl::castRays(vector<RayQuery>& queries)
+{
+    if(!isReady){
+        makeReady();
+    }
+
+    rayCastModels.clear();
+    for(auto& model : models){
+        if(model){
+            rayCastModels.push_back(model);
+        }
+    }
+
+    const int n = queries.size();
+    if(numThreads == 0 || n <= RayQueryChunkSize){
+        vector<pair<double, ColdetModelEx*>> candidates;
+        for(auto& query : queries){
+            castRay(query, candidates);
+        }
+    } else {
+        taskScheduler->parallelForRange(
+            0, n, RayQueryChunkSize,
+            [this, &queries](int begin, int end){
+                vector<pair<double, ColdetModelEx*>> candidates;
+                for(int i = begin; i < end; ++i){
+                    castRay(queries[i], candidates);
+                }
+            });
+    }
+}
+
+
+/**
+   The models whose bounding boxes are entered by the ray are checked in the order of the entry
+   distances, and the check finishes when the next entry is farther than the closest hit.
+*/
+void AISTCollisionDetectorImpl::castRay(RayQuery& query, vector<pair<double, ColdetModelEx*>>& candidates)
+{
+    const Vector3 inverseDirection = query.direction.cwiseInverse();
+    candidates.clear();
+    for(auto& model : rayCastModels){
+        double entry;
+        if(model->isUnbounded()){
+            candidates.emplace_back(0.0, model);
+        } else if(calcRayBoundingBoxEntry(
+                      query.origin, inverseDirection, query.maxDistance, model->boundingBox, entry)){
+            candidates.emplace_back(entry, model);
+        }
+    }
+    std::sort(candidates.begin(), candidates.end(),
+              [](const pair<double, ColdetModelEx*>& c1, const pair<double, ColdetModelEx*>& c2){
+                  return c1.first < c2.first; });
+
+    query.distance = std::numeric_limits<double>::infinity();
+    for(auto& candidate : candidates){
+        if(candidate.first >= query.distance){
+            break;
+        }
+        double maxDistance = std::min(query.distance, query.maxDistance);
+        double distance = candidate.second->castRay(query.origin, query.direction, maxDistance);
+        if(distance >= 0.0 && distance < query.distance){
+            query.distance = distance;
+            query.geometry = getHandle(candidate.second);
+        }
+    }
+}
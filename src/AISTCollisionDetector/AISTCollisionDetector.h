@@ -13,7 +13,8 @@ namespace cnoid {
 
 class AISTCollisionDetectorImpl;
 
-class CNOID_EXPORT AISTCollisionDetector : public CollisionDetector, public CollisionDetectorDistanceAPI
+class CNOID_EXPORT AISTCollisionDetector
+    : public CollisionDetector, public CollisionDetectorDistanceAPI, public CollisionDetectorRayCastAPI
 {
 public:
     AISTCollisionDetector();
@@ -23,8 +24,17 @@ public:
     virtual void clearGeometries() override;
     virtual int numGeometries() const override;
     virtual stdx::optional<GeometryHandle> addGeometry(SgNode* geometry) override;
+    virtual bool removeGeometry(GeometryHandle geometry) override;
     virtual void setCustomObject(GeometryHandle geometry, Referenced* object) override;
     virtual void setGeometryStatic(GeometryHandle geometry, bool isStatic = true) override;
+
+    /**
+       The continuous collision detection is done by the conservative advancement of the
+       distance between the models when no collision is detected at the current positions.
+       The collisions found in the motion are reported with the positions of the end of the motion,
+       and their depths include the penetration along the normals at the end of the motion.
+    */
+    virtual bool setContinuousCollisionDetectionEnabled(GeometryHandle geometry, bool on = true) override;
     virtual void ignoreGeometryPair(GeometryHandle geometry1, GeometryHandle geometry2, bool ignore = true) override;
     virtual bool makeReady() override;
     virtual void updatePosition(GeometryHandle geometry, const Isometry3& position) override;
@@ -33,10 +43,37 @@ public:
 
     // CollisionDetectorDistanceAPI
     virtual double detectDistance(GeometryHandle geometry1, GeometryHandle geometry2, Vector3& out_point1, Vector3& out_point2) override;
+    virtual void detectDistances(
+        std::vector<DistanceQuery>& io_queries, double threshold = std::numeric_limits<double>::max()) override;
+    virtual void detectDistances(
+        GeometryHandle geometry, double threshold, std::vector<DistanceQuery>& out_queries) override;
+
+    // CollisionDetectorRayCastAPI
+    virtual void castRays(std::vector<RayQuery>& io_queries) override;
 
-    // experimental
+    /**
+       The multithread mode is enabled when n is larger than zero. The pairs are divided into the
+       batches for n threads, and the batches are processed by the threads of the task scheduler
+       shared in the process.
+       \note The threads are also used to process the pairs given to detectDistances() and
+       the rays given to castRays().
+    */
     void setNumThreads(int n);
 
+    /**
+       The collisions between the boxes, spheres and capsules given as the primitives of SgMesh are
+       detected by the closed-form routines instead of their triangles when this is enabled, which is
+       the default. The other combinations, cylinders and cones are detected as the meshes.
+    */
+    void setPrimitiveShapeCollisionEnabled(bool on);
+    bool isPrimitiveShapeCollisionEnabled() const;
+
+    /**
+       The models built for the geometries are cached and reused by the detectors
+       created later. This function releases the cached models.
+    */
+    static void clearGeometryCache();
+
 private:
     AISTCollisionDetectorImpl* impl;
 };
@@ -378,6 +378,24 @@ double ColdetModel::computeDistanceWithRay(const double *point,
 }
 
 
+double ColdetModel::castRay(const Vector3& origin, const Vector3& direction, double maxDistance) const
+{
+    Opcode::RayCollider RC;
+    Ray world_ray(Point(origin[0], origin[1], origin[2]),
+                  Point(direction[0], direction[1], direction[2]));
+    Opcode::CollisionFace CF;
+    Opcode::SetupClosestHit(RC, CF);
+    // The back faces are culled so that the rays from the inside of the mesh go through it
+    RC.SetCulling(true);
+    RC.SetMaxDist(maxDistance);
+    RC.Collide(world_ray, internalModel->model, transform);
+    if(CF.mDistance == MAX_FLOAT){
+        return -1.0;
+    }
+    return CF.mDistance;
+}
+
+
 bool ColdetModel::checkCollisionWithPointCloud(const std::vector<Vector3> &i_cloud, double i_radius)
 {
     Opcode::SphereCollider SC;
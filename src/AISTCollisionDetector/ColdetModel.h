@@ -195,6 +195,16 @@ public:
      */
     double computeDistanceWithRay(const double *point, const double *dir);
 
+    /**
+     * @brief find the closest front face hit by a ray
+     * @param origin origin of the ray in the world coordinate
+     * @param direction normalized direction of the ray
+     * @param maxDistance the faces farther than this distance are not checked
+     * @return distance to the hit face, or a negative value if no face is hit
+     * @note This function can be called from multiple threads at the same time.
+     */
+    double castRay(const Vector3& origin, const Vector3& direction, double maxDistance) const;
+
     /**
      * @brief check collision between this triangle mesh and a point cloud
      * @param i_cloud points
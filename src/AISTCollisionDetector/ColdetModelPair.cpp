@@ -8,6 +8,7 @@
 #include "StdCollisionPairInserter.h"
 #include "Opcode/Opcode.h"
 #include "SSVTreeCollider.h"
+#include <algorithm>
 #include <iostream>
 
 using namespace std;
@@ -37,12 +38,15 @@ struct figStruct {
 ColdetModelPair::ColdetModelPair()
 {
     collisionPairInserter = new Opcode::StdCollisionPairInserter;
+    isCollisionCacheEnabled = false;
+    isCollisionCacheValid = false;
 }
 
 
 ColdetModelPair::ColdetModelPair(ColdetModel* model0, ColdetModel* model1, double tolerance)
 {
     collisionPairInserter = new Opcode::StdCollisionPairInserter;
+    isCollisionCacheEnabled = false;
     set(model0, model1);
     tolerance_ = tolerance;
 }
@@ -51,6 +55,7 @@ ColdetModelPair::ColdetModelPair(ColdetModel* model0, ColdetModel* model1, doubl
 ColdetModelPair::ColdetModelPair(const ColdetModelPair& org)
 {
     collisionPairInserter = new Opcode::StdCollisionPairInserter;
+    isCollisionCacheEnabled = org.isCollisionCacheEnabled;
     set(org.models[0], org.models[1]);
     tolerance_ = org.tolerance_;
 }
@@ -66,6 +71,7 @@ void ColdetModelPair::set(ColdetModel* model0, ColdetModel* model1)
 {
     models[0] = model0;
     models[1] = model1;
+    isCollisionCacheValid = false;
     // inverse order because of historical background
     // this should be fixed.(note that the direction of normal is inversed when the order inversed 
     if(model0 && model1){
@@ -74,8 +80,38 @@ void ColdetModelPair::set(ColdetModel* model0, ColdetModel* model1)
 }
 
 
+/**
+   Returns true if the collisions of the previous detection are valid for the current transforms,
+   and stores the current transforms for the next call otherwise.
+*/
+bool ColdetModelPair::checkCollisionCache(bool detectAllContacts)
+{
+    bool isValid = isCollisionCacheValid && (isCollisionCacheForAllContacts == detectAllContacts);
+    for(int i=0; i < 2; ++i){
+        const float* T = &models[i]->transform->m[0][0];
+        const float* pT = &models[i]->pTransform->m[0][0];
+        if(isValid){
+            isValid = std::equal(T, T + 16, cachedTransforms[i][0]) && std::equal(pT, pT + 16, cachedTransforms[i][1]);
+        }
+        if(!isValid){
+            std::copy(T, T + 16, cachedTransforms[i][0]);
+            std::copy(pT, pT + 16, cachedTransforms[i][1]);
+        }
+    }
+    if(!isValid){
+        isCollisionCacheValid = true;
+        isCollisionCacheForAllContacts = detectAllContacts;
+    }
+    return isValid;
+}
+
+
 std::vector<collision_data>& ColdetModelPair::detectCollisionsSub(bool detectAllContacts)
 {
+    if(isCollisionCacheEnabled && checkCollisionCache(detectAllContacts)){
+        return collisionPairInserter->collisions();
+    }
+    
     collisionPairInserter->clear();
 
     int pt0 = models[0]->getPrimitiveType();
@@ -671,6 +707,7 @@ bool ColdetModelPair::detectIntersection()
 
 void ColdetModelPair::setCollisionPairInserter(Opcode::CollisionPairInserter* inserter)
 {
+    isCollisionCacheValid = false;
     delete collisionPairInserter;
     collisionPairInserter = inserter;
     // inverse order because of historical background
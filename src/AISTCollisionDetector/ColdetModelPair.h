@@ -35,6 +35,7 @@ public:
 
     void clearCollisions(){
         collisionPairInserter->cdContact.clear();
+        isCollisionCacheValid = false;
     }
 
     bool checkCollision() {
@@ -56,6 +57,19 @@ public:
 
     void setTolerance(double tolerance){
         tolerance_ = tolerance;
+        isCollisionCacheValid = false;
+    }
+
+    /**
+       When this is enabled, detectCollisions() and checkCollision() return the collisions of the
+       previous call without detecting them again if the transforms of both models are exactly the
+       same as the previous call. The transforms are stored in single precision, so this is the
+       case for the models at rest as well as the unmoved models. Do not enable this for the
+       models whose vertices are modified after the collision detection.
+    */
+    void setCollisionCacheEnabled(bool on){
+        isCollisionCacheEnabled = on;
+        isCollisionCacheValid = false;
     }
 
     void setCollisionPairInserter(Opcode::CollisionPairInserter *inserter); 
@@ -77,6 +91,7 @@ public:
 private:
         
     std::vector<collision_data>& detectCollisionsSub(bool detectAllContacts);
+    bool checkCollisionCache(bool detectAllContacts);
     bool detectMeshMeshCollisions(bool detectAllContacts);
     bool detectSphereSphereCollisions(bool detectAllContacts);
     bool detectSphereMeshCollisions(bool detectAllContacts);
@@ -88,6 +103,12 @@ private:
     Opcode::CollisionPairInserter* collisionPairInserter;
     int boxTestsCount;
     int triTestsCount;
+
+    bool isCollisionCacheEnabled;
+    bool isCollisionCacheValid;
+    bool isCollisionCacheForAllContacts;
+    // transform and primitive transform of each model for the cached collisions
+    float cachedTransforms[2][2][16];
 };
 
 typedef ref_ptr<ColdetModelPair> ColdetModelPairPtr;
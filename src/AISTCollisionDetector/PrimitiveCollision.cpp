@@ -0,0 +1,644 @@
+#include "PrimitiveCollision.h"
+#include <algorithm>
+#include <limits>
+#include <cmath>
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+typedef CollisionPrimitive::Type Type;
+
+// The edge-edge axis of the box pair is chosen only if its overlap is clearly less than that of the face axes
+const double EdgeAxisOverlapRatio = 0.95;
+const double EdgeAxisOverlapTolerance = 1.0e-6;
+
+const double ParallelCapsuleSinThresh = 1.0e-3;
+
+
+Collision& newCollision(vector<Collision>& collisions)
+{
+    collisions.emplace_back();
+    Collision& collision = collisions.back();
+    collision.id1 = 0;
+    collision.id2 = 0;
+    return collision;
+}
+
+
+bool detectSphereSphereCollision
+(const Vector3& c0, double r0, const Vector3& c1, double r1, vector<Collision>& out_collisions)
+{
+    const Vector3 d = c1 - c0;
+    const double distance = d.norm();
+    if(distance > r0 + r1){
+        return false;
+    }
+    Collision& collision = newCollision(out_collisions);
+    if(distance > 1.0e-12){
+        collision.normal = d / distance;
+    } else {
+        collision.normal = Vector3::UnitZ();
+    }
+    collision.depth = r0 + r1 - distance;
+    collision.point = c0 + collision.normal * (r0 - collision.depth / 2.0);
+    return true;
+}
+
+
+// The normal points from the box to the sphere
+bool detectBoxSphereCollision
+(const Isometry3& boxT, const Vector3& h, const Vector3& center, double radius, vector<Collision>& out_collisions)
+{
+    const Vector3 c = boxT.inverse() * center;
+    const Vector3 q = c.cwiseMax(-h).cwiseMin(h);
+    Vector3 n;
+    double depth;
+    Vector3 surfacePoint;
+
+    if(q != c){
+        const Vector3 d = c - q;
+        const double distance = d.norm();
+        if(distance > radius){
+            return false;
+        }
+        n = d / distance;
+        depth = radius - distance;
+        surfacePoint = q;
+    } else {
+        // The center is inside the box
+        int axis = 0;
+        double minGap = h[0] - fabs(c[0]);
+        for(int i=1; i < 3; ++i){
+            double gap = h[i] - fabs(c[i]);
+            if(gap < minGap){
+                minGap = gap;
+                axis = i;
+            }
+        }
+        n = Vector3::Zero();
+        n[axis] = (c[axis] >= 0.0) ? 1.0 : -1.0;
+        depth = radius + minGap;
+        surfacePoint = c;
+        surfacePoint[axis] = n[axis] * h[axis];
+    }
+
+    Collision& collision = newCollision(out_collisions);
+    collision.normal = boxT.linear() * n;
+    collision.depth = depth;
+    collision.point = boxT * (surfacePoint - n * (depth / 2.0));
+    return true;
+}
+
+
+Vector3 closestPointOnSegment(const Vector3& p, const Vector3& center, const Vector3& axis, double halfLength)
+{
+    double t = std::max(-halfLength, std::min(halfLength, (p - center).dot(axis)));
+    return center + axis * t;
+}
+
+
+void getCapsuleSegment(const Isometry3& T, Vector3& out_center, Vector3& out_axis)
+{
+    out_center = T.translation();
+    out_axis = T.linear().col(1);
+}
+
+
+/**
+   The closest points between the segments c0 + s * a0 (|s| <= h0) and c1 + t * a1 (|t| <= h1)
+   with the unit vectors a0 and a1, which are calculated as in "Real-Time Collision Detection" by Ericson.
+*/
+void calcClosestPointsOfSegments
+(const Vector3& c0, const Vector3& a0, double h0, const Vector3& c1, const Vector3& a1, double h1,
+ Vector3& out_p0, Vector3& out_p1)
+{
+    const Vector3 r = c0 - c1;
+    const double b = a0.dot(a1);
+    const double c = a0.dot(r);
+    const double f = a1.dot(r);
+    const double denom = 1.0 - b * b;
+
+    double s = 0.0;
+    if(denom > 1.0e-12){
+        s = std::max(-h0, std::min(h0, (b * f - c) / denom));
+    }
+    double t = b * s + f;
+    if(t < -h1){
+        t = -h1;
+        s = std::max(-h0, std::min(h0, b * t - c));
+    } else if(t > h1){
+        t = h1;
+        s = std::max(-h0, std::min(h0, b * t - c));
+    }
+    out_p0 = c0 + a0 * s;
+    out_p1 = c1 + a1 * t;
+}
+
+
+bool detectCapsuleCapsuleCollisions
+(const Isometry3& T0, double r0, double h0, const Isometry3& T1, double r1, double h1, vector<Collision>& out_collisions)
+{
+    Vector3 c0, a0, c1, a1;
+    getCapsuleSegment(T0, c0, a0);
+    getCapsuleSegment(T1, c1, a1);
+
+    if(a0.cross(a1).norm() < ParallelCapsuleSinThresh){
+        // Two contacts at the ends of the overlapping interval keep the parallel capsules stable
+        const double t1 = (c1 - c0).dot(a0);
+        const double t1h = h1 * fabs(a0.dot(a1));
+        const double lower = std::max(-h0, t1 - t1h);
+        const double upper = std::min(h0, t1 + t1h);
+        if(upper - lower > 1.0e-9){
+            bool detected = false;
+            for(double t : { lower, upper }){
+                const Vector3 p0 = c0 + a0 * t;
+                const Vector3 p1 = closestPointOnSegment(p0, c1, a1, h1);
+                if(detectSphereSphereCollision(p0, r0, p1, r1, out_collisions)){
+                    detected = true;
+                }
+            }
+            return detected;
+        }
+    }
+
+    Vector3 p0, p1;
+    calcClosestPointsOfSegments(c0, a0, h0, c1, a1, h1, p0, p1);
+    return detectSphereSphereCollision(p0, r0, p1, r1, out_collisions);
+}
+
+
+double sign(double x)
+{
+    return (x >= 0.0) ? 1.0 : -1.0;
+}
+
+
+/**
+   Sutherland-Hodgman clipping of the polygon by the half space of axis * (p - center) <= h
+*/
+void clipPolygon(vector<Vector3>& polygon, vector<Vector3>& buf, const Vector3& center, const Vector3& axis, double h)
+{
+    buf.clear();
+    const int n = polygon.size();
+    for(int i=0; i < n; ++i){
+        const Vector3& p = polygon[i];
+        const Vector3& q = polygon[(i + 1) % n];
+        const double dp = axis.dot(p - center) - h;
+        const double dq = axis.dot(q - center) - h;
+        if(dp <= 0.0){
+            buf.push_back(p);
+        }
+        if((dp < 0.0 && dq > 0.0) || (dp > 0.0 && dq < 0.0)){
+            buf.push_back(p + (q - p) * (dp / (dp - dq)));
+        }
+    }
+    polygon.swap(buf);
+}
+
+
+/**
+   The box pair is tested by the separating axis theorem. The contacts of a face axis are the
+   vertices of the incident face clipped by the reference face, and that of an edge axis is the
+   point between the closest points of the two edges.
+*/
+bool detectBoxBoxCollisions
+(const Isometry3& TA, const Vector3& hA, const Isometry3& TB, const Vector3& hB, vector<Collision>& out_collisions)
+{
+    const Matrix3 RA = TA.linear();
+    const Matrix3 RB = TB.linear();
+    const Vector3 D = TB.translation() - TA.translation();
+
+    auto getOverlap = [&](const Vector3& L){
+        double rA = 0.0;
+        double rB = 0.0;
+        for(int k=0; k < 3; ++k){
+            rA += hA[k] * fabs(RA.col(k).dot(L));
+            rB += hB[k] * fabs(RB.col(k).dot(L));
+        }
+        return rA + rB - fabs(D.dot(L));
+    };
+
+    int faceAxis = -1;
+    double faceOverlap = std::numeric_limits<double>::max();
+    for(int i=0; i < 6; ++i){
+        const Vector3 L = (i < 3) ? Vector3(RA.col(i)) : Vector3(RB.col(i - 3));
+        const double overlap = getOverlap(L);
+        if(overlap < 0.0){
+            return false;
+        }
+        if(overlap < faceOverlap){
+            faceOverlap = overlap;
+            faceAxis = i;
+        }
+    }
+
+    int edgeA = -1;
+    int edgeB = -1;
+    double edgeOverlap = std::numeric_limits<double>::max();
+    Vector3 edgeL;
+    for(int i=0; i < 3; ++i){
+        for(int j=0; j < 3; ++j){
+            Vector3 L = RA.col(i).cross(RB.col(j));
+            const double len = L.norm();
+            if(len < 1.0e-6){
+                continue;
+            }
+            L /= len;
+            const double overlap = getOverlap(L);
+            if(overlap < 0.0){
+                return false;
+            }
+            if(overlap < edgeOverlap){
+                edgeOverlap = overlap;
+                edgeA = i;
+                edgeB = j;
+                edgeL = L;
+            }
+        }
+    }
+
+    if(edgeA >= 0 && edgeOverlap < EdgeAxisOverlapRatio * faceOverlap - EdgeAxisOverlapTolerance){
+        const Vector3 n = edgeL * sign(edgeL.dot(D));
+        Vector3 pA = TA.translation();
+        Vector3 pB = TB.translation();
+        for(int k=0; k < 3; ++k){
+            if(k != edgeA){
+                pA += RA.col(k) * (hA[k] * sign(RA.col(k).dot(n)));
+            }
+            if(k != edgeB){
+                pB -= RB.col(k) * (hB[k] * sign(RB.col(k).dot(n)));
+            }
+        }
+        Vector3 qA, qB;
+        calcClosestPointsOfSegments(pA, RA.col(edgeA), hA[edgeA], pB, RB.col(edgeB), hB[edgeB], qA, qB);
+        Collision& collision = newCollision(out_collisions);
+        collision.normal = n;
+        collision.depth = edgeOverlap;
+        collision.point = (qA + qB) / 2.0;
+        return true;
+    }
+
+    const bool isReferenceA = (faceAxis < 3);
+    const int refAxis = isReferenceA ? faceAxis : faceAxis - 3;
+    const Matrix3& Rref = isReferenceA ? RA : RB;
+    const Matrix3& Rinc = isReferenceA ? RB : RA;
+    const Vector3& href = isReferenceA ? hA : hB;
+    const Vector3& hinc = isReferenceA ? hB : hA;
+    const Vector3& cref = isReferenceA ? TA.translation() : TB.translation();
+    const Vector3& cinc = isReferenceA ? TB.translation() : TA.translation();
+
+    // The normal of the reference face points to the incident box
+    const Vector3 towardIncident = isReferenceA ? D : Vector3(-D);
+    const Vector3 nref = Rref.col(refAxis) * sign(Rref.col(refAxis).dot(towardIncident));
+    const Vector3 refFaceCenter = cref + nref * href[refAxis];
+
+    // The incident face is the one most anti-parallel to the reference face
+    int incAxis = 0;
+    double maxDot = 0.0;
+    for(int k=0; k < 3; ++k){
+        const double d = fabs(Rinc.col(k).dot(nref));
+        if(d > maxDot){
+            maxDot = d;
+            incAxis = k;
+        }
+    }
+    const Vector3 ninc = Rinc.col(incAxis) * -sign(Rinc.col(incAxis).dot(nref));
+    const Vector3 incFaceCenter = cinc + ninc * hinc[incAxis];
+    const int u = (incAxis + 1) % 3;
+    const int v = (incAxis + 2) % 3;
+    const Vector3 eu = Rinc.col(u) * hinc[u];
+    const Vector3 ev = Rinc.col(v) * hinc[v];
+
+    vector<Vector3> polygon = {
+        incFaceCenter + eu + ev, incFaceCenter - eu + ev, incFaceCenter - eu - ev, incFaceCenter + eu - ev };
+    vector<Vector3> buf;
+    buf.reserve(8);
+    for(int k=1; k < 3; ++k){
+        const int side = (refAxis + k) % 3;
+        const Vector3 axis = Rref.col(side);
+        clipPolygon(polygon, buf, refFaceCenter, axis, href[side]);
+        clipPolygon(polygon, buf, refFaceCenter, -axis, href[side]);
+    }
+
+    // The normals are from box A to box B
+    const Vector3 normal = isReferenceA ? nref : Vector3(-nref);
+    bool detected = false;
+    for(auto& p : polygon){
+        const double depth = -nref.dot(p - refFaceCenter);
+        if(depth >= 0.0){
+            Collision& collision = newCollision(out_collisions);
+            collision.normal = normal;
+            collision.depth = depth;
+            collision.point = p + nref * (depth / 2.0);
+            detected = true;
+        }
+    }
+    return detected;
+}
+
+
+Vector3 closestPointOnTriangle(const Vector3& p, const Vector3& a, const Vector3& b, const Vector3& c)
+{
+    const Vector3 ab = b - a;
+    const Vector3 ac = c - a;
+    const Vector3 ap = p - a;
+    const double d1 = ab.dot(ap);
+    const double d2 = ac.dot(ap);
+    if(d1 <= 0.0 && d2 <= 0.0){
+        return a;
+    }
+    const Vector3 bp = p - b;
+    const double d3 = ab.dot(bp);
+    const double d4 = ac.dot(bp);
+    if(d3 >= 0.0 && d4 <= d3){
+        return b;
+    }
+    const double vc = d1 * d4 - d3 * d2;
+    if(vc <= 0.0 && d1 >= 0.0 && d3 <= 0.0){
+        return a + ab * (d1 / (d1 - d3));
+    }
+    const Vector3 cp = p - c;
+    const double d5 = ab.dot(cp);
+    const double d6 = ac.dot(cp);
+    if(d6 >= 0.0 && d5 <= d6){
+        return c;
+    }
+    const double vb = d5 * d2 - d1 * d6;
+    if(vb <= 0.0 && d2 >= 0.0 && d6 <= 0.0){
+        return a + ac * (d2 / (d2 - d6));
+    }
+    const double va = d3 * d6 - d5 * d4;
+    if(va <= 0.0 && (d4 - d3) >= 0.0 && (d5 - d6) >= 0.0){
+        return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+    }
+    const double denom = 1.0 / (va + vb + vc);
+    return a + ab * (vb * denom) + ac * (vc * denom);
+}
+
+
+/**
+   The queries on the surface of a height field in its local coordinate. Each cell (x, z) is
+   divided into the triangles (x, z)-(x, z+1)-(x+1, z+1) and (x, z)-(x+1, z+1)-(x+1, z) as the
+   triangles generated by MeshGenerator, and the space below the surface is regarded as solid.
+*/
+class HeightFieldQuery
+{
+public:
+    const SgMesh::HeightField& field;
+
+    HeightFieldQuery(const SgMesh::HeightField& field) : field(field) { }
+
+    Vector3 vertex(int x, int z) const {
+        return Vector3(x * field.xSpacing, field.height(x, z), z * field.zSpacing);
+    }
+
+    //! \return false if the range does not overlap the grid
+    bool getCellRange(double xmin, double xmax, double zmin, double zmax, int& x0, int& x1, int& z0, int& z1) const {
+        if(xmax < 0.0 || zmax < 0.0 || xmin > field.xSize() || zmin > field.zSize()){
+            return false;
+        }
+        x0 = std::max(0, static_cast<int>(floor(xmin / field.xSpacing)));
+        x1 = std::min(field.xDimension - 2, static_cast<int>(floor(xmax / field.xSpacing)));
+        z0 = std::max(0, static_cast<int>(floor(zmin / field.zSpacing)));
+        z1 = std::min(field.zDimension - 2, static_cast<int>(floor(zmax / field.zSpacing)));
+        return x0 <= x1 && z0 <= z1;
+    }
+
+    //! \return false if the point is out of the grid
+    bool getSurface(const Vector3& p, double& out_height, Vector3& out_normal) const {
+        int x0, x1, z0, z1;
+        if(!getCellRange(p.x(), p.x(), p.z(), p.z(), x0, x1, z0, z1)){
+            return false;
+        }
+        const double u = std::min(1.0, std::max(0.0, p.x() / field.xSpacing - x0));
+        const double w = std::min(1.0, std::max(0.0, p.z() / field.zSpacing - z0));
+        const double h00 = field.height(x0, z0);
+        const double h01 = field.height(x0, z0 + 1);
+        const double h10 = field.height(x0 + 1, z0);
+        const double h11 = field.height(x0 + 1, z0 + 1);
+        double dhdu, dhdw;
+        if(w >= u){
+            dhdu = h11 - h01;
+            dhdw = h01 - h00;
+        } else {
+            dhdu = h10 - h00;
+            dhdw = h11 - h10;
+        }
+        out_height = h00 + u * dhdu + w * dhdw;
+        out_normal = Vector3(-dhdu / field.xSpacing, 1.0, -dhdw / field.zSpacing).normalized();
+        return true;
+    }
+};
+
+
+// The normal points from the sphere to the height field
+bool detectSphereHeightFieldCollision
+(const Vector3& center, double radius, const SgMesh::HeightField& field, const Isometry3& T,
+ vector<Collision>& out_collisions)
+{
+    HeightFieldQuery query(field);
+    const Vector3 c = T.inverse() * center;
+
+    double h;
+    Vector3 n;
+    if(query.getSurface(c, h, n) && c.y() < h){
+        // The center is under the surface
+        const double d = (h - c.y()) * n.y();
+        Collision& collision = newCollision(out_collisions);
+        collision.normal = T.linear() * -n;
+        collision.depth = radius + d;
+        collision.point = T * Vector3(c + n * d);
+        return true;
+    }
+
+    int x0, x1, z0, z1;
+    if(!query.getCellRange(c.x() - radius, c.x() + radius, c.z() - radius, c.z() + radius, x0, x1, z0, z1)){
+        return false;
+    }
+    double minSquaredDistance = radius * radius;
+    Vector3 nearest;
+    bool found = false;
+    for(int z = z0; z <= z1; ++z){
+        for(int x = x0; x <= x1; ++x){
+            const Vector3 v00 = query.vertex(x, z);
+            const Vector3 v11 = query.vertex(x + 1, z + 1);
+            for(int i=0; i < 2; ++i){
+                const Vector3 q = (i == 0) ?
+                    closestPointOnTriangle(c, v00, query.vertex(x, z + 1), v11) :
+                    closestPointOnTriangle(c, v00, v11, query.vertex(x + 1, z));
+                const double d2 = (q - c).squaredNorm();
+                if(d2 < minSquaredDistance){
+                    minSquaredDistance = d2;
+                    nearest = q;
+                    found = true;
+                }
+            }
+        }
+    }
+    if(!found){
+        return false;
+    }
+    const double distance = sqrt(minSquaredDistance);
+    Collision& collision = newCollision(out_collisions);
+    if(distance > 1.0e-12){
+        collision.normal = T.linear() * ((nearest - c) / distance);
+    } else {
+        collision.normal = T.linear() * -Vector3::UnitY();
+    }
+    collision.depth = radius - distance;
+    collision.point = T * nearest;
+    return true;
+}
+
+
+// The normal points from the box to the height field. Only the vertices of the box are tested.
+bool detectBoxHeightFieldCollisions
+(const Isometry3& boxT, const Vector3& h, const SgMesh::HeightField& field, const Isometry3& T,
+ vector<Collision>& out_collisions)
+{
+    HeightFieldQuery query(field);
+    const Isometry3 Tbox = T.inverse() * boxT;
+    bool detected = false;
+    for(int i=0; i < 8; ++i){
+        const Vector3 corner(
+            (i & 1) ? h.x() : -h.x(), (i & 2) ? h.y() : -h.y(), (i & 4) ? h.z() : -h.z());
+        const Vector3 p = Tbox * corner;
+        double height;
+        Vector3 n;
+        if(query.getSurface(p, height, n) && p.y() < height){
+            Collision& collision = newCollision(out_collisions);
+            collision.normal = T.linear() * -n;
+            collision.depth = (height - p.y()) * n.y();
+            collision.point = boxT * corner;
+            detected = true;
+        }
+    }
+    return detected;
+}
+
+
+/*
+   The capsule is approximated by the spheres placed along its segment at the intervals that are
+   not longer than its radius and the grid spacing.
+*/
+const int MaxNumCapsuleSpheres = 16;
+
+bool detectCapsuleHeightFieldCollisions
+(const Isometry3& capsuleT, double radius, double halfHeight, const SgMesh::HeightField& field,
+ const Isometry3& T, vector<Collision>& out_collisions)
+{
+    Vector3 center, axis;
+    getCapsuleSegment(capsuleT, center, axis);
+    const double interval = std::min(radius, std::min(field.xSpacing, field.zSpacing));
+    int n = 2;
+    if(interval > 0.0){
+        n = std::min(MaxNumCapsuleSpheres, std::max(2, static_cast<int>(ceil(2.0 * halfHeight / interval)) + 1));
+    }
+    bool detected = false;
+    for(int i=0; i < n; ++i){
+        const double s = -halfHeight + 2.0 * halfHeight * i / (n - 1);
+        if(detectSphereHeightFieldCollision(center + axis * s, radius, field, T, out_collisions)){
+            detected = true;
+        }
+    }
+    return detected;
+}
+
+}
+
+
+bool cnoid::isPrimitivePairSupported(Type type0, Type type1)
+{
+    if(type0 > type1){
+        std::swap(type0, type1);
+    }
+    switch(type0){
+    case CollisionPrimitive::Sphere:
+        return true;
+    case CollisionPrimitive::Box:
+        return type1 == CollisionPrimitive::Box || type1 == CollisionPrimitive::HeightField;
+    case CollisionPrimitive::Capsule:
+        return type1 == CollisionPrimitive::Capsule || type1 == CollisionPrimitive::HeightField;
+    default:
+        return false;
+    }
+}
+
+
+bool cnoid::detectPrimitiveCollisions
+(const CollisionPrimitive& primitive0, const Isometry3& T0,
+ const CollisionPrimitive& primitive1, const Isometry3& T1,
+ std::vector<Collision>& out_collisions)
+{
+    if(primitive0.type > primitive1.type){
+        // The pair is processed in the order of the types, and the normals are reversed
+        const int top = out_collisions.size();
+        bool detected = detectPrimitiveCollisions(primitive1, T1, primitive0, T0, out_collisions);
+        for(size_t i = top; i < out_collisions.size(); ++i){
+            out_collisions[i].normal = -out_collisions[i].normal;
+        }
+        return detected;
+    }
+
+    switch(primitive0.type){
+
+    case CollisionPrimitive::Sphere:
+        switch(primitive1.type){
+        case CollisionPrimitive::Sphere:
+            return detectSphereSphereCollision(
+                T0.translation(), primitive0.radius, T1.translation(), primitive1.radius, out_collisions);
+        case CollisionPrimitive::Box:
+        {
+            const int top = out_collisions.size();
+            bool detected = detectBoxSphereCollision(
+                T1, primitive1.halfSize, T0.translation(), primitive0.radius, out_collisions);
+            for(size_t i = top; i < out_collisions.size(); ++i){
+                out_collisions[i].normal = -out_collisions[i].normal;
+            }
+            return detected;
+        }
+        case CollisionPrimitive::Capsule:
+        {
+            Vector3 c1, a1;
+            getCapsuleSegment(T1, c1, a1);
+            const Vector3& c0 = T0.translation();
+            return detectSphereSphereCollision(
+                c0, primitive0.radius, closestPointOnSegment(c0, c1, a1, primitive1.halfHeight),
+                primitive1.radius, out_collisions);
+        }
+        case CollisionPrimitive::HeightField:
+            return detectSphereHeightFieldCollision(
+                T0.translation(), primitive0.radius, *primitive1.heightField, T1, out_collisions);
+        default:
+            break;
+        }
+        break;
+
+    case CollisionPrimitive::Box:
+        if(primitive1.type == CollisionPrimitive::Box){
+            return detectBoxBoxCollisions(T0, primitive0.halfSize, T1, primitive1.halfSize, out_collisions);
+        } else if(primitive1.type == CollisionPrimitive::HeightField){
+            return detectBoxHeightFieldCollisions(
+                T0, primitive0.halfSize, *primitive1.heightField, T1, out_collisions);
+        }
+        break;
+
+    case CollisionPrimitive::Capsule:
+        if(primitive1.type == CollisionPrimitive::Capsule){
+            return detectCapsuleCapsuleCollisions(
+                T0, primitive0.radius, primitive0.halfHeight, T1, primitive1.radius, primitive1.halfHeight,
+                out_collisions);
+        } else if(primitive1.type == CollisionPrimitive::HeightField){
+            return detectCapsuleHeightFieldCollisions(
+                T0, primitive0.radius, primitive0.halfHeight, *primitive1.heightField, T1, out_collisions);
+        }
+        break;
+
+    default:
+        break;
+    }
+
+    return false;
+}
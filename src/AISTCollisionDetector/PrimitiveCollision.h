@@ -0,0 +1,46 @@
+#ifndef CNOID_AIST_COLLISION_DETECTOR_PRIMITIVE_COLLISION_H
+#define CNOID_AIST_COLLISION_DETECTOR_PRIMITIVE_COLLISION_H
+
+#include <cnoid/Collision>
+#include <cnoid/SceneDrawables>
+#include <cnoid/EigenTypes>
+#include <memory>
+#include <vector>
+
+namespace cnoid {
+
+/**
+   Analytic shape of a geometry used to detect the collisions in the closed form instead of
+   the triangles of the mesh. The capsule axis is the y axis as in SgMesh::Capsule.
+   The height field is the grid given by SgMesh::heightField, and the collisions with it are
+   detected by looking up the cells under the other primitive.
+*/
+class CollisionPrimitive
+{
+public:
+    enum Type { NoPrimitive, Sphere, Box, Capsule, HeightField };
+
+    CollisionPrimitive() : type(NoPrimitive) { }
+
+    Type type;
+    Vector3 halfSize; // for Box
+    double radius;    // for Sphere and Capsule
+    double halfHeight; // for Capsule
+    std::shared_ptr<const SgMesh::HeightField> heightField; // for HeightField
+};
+
+bool isPrimitivePairSupported(CollisionPrimitive::Type type0, CollisionPrimitive::Type type1);
+
+/**
+   Detects the collisions between two primitives with the positions T0 and T1, and adds them to
+   out_collisions. The normals point from primitive 0 to primitive 1 as those of the mesh pairs.
+   \return true if the primitives collide
+*/
+bool detectPrimitiveCollisions(
+    const CollisionPrimitive& primitive0, const Isometry3& T0,
+    const CollisionPrimitive& primitive1, const Isometry3& T1,
+    std::vector<Collision>& out_collisions);
+
+}
+
+#endif
@@ -7,6 +7,7 @@
 #include <cnoid/SceneDrawables>
 #include <cnoid/MeshFilter>
 #include <cnoid/ImageIO>
+#include <cnoid/ImageCache>
 #include <cnoid/Exception>
 #include <cnoid/NullOut>
 #include <cnoid/UTF8>
@@ -142,6 +143,16 @@ SgNode* AssimpSceneLoader::load(const std::string& filename)
 }
 
 
+/**
+   The textures are the only external files referred by the loaded scene, and their
+   image files are set to the URIs of the images.
+*/
+bool AssimpSceneLoader::isCacheable() const
+{
+    return true;
+}
+
+
 SgNode* AssimpSceneLoaderImpl::load(const std::string& filename)
 {
     clear();
@@ -515,14 +526,10 @@ SgTexture* AssimpSceneLoaderImpl::convertAiTexture(unsigned int index)
             ImagePathToSgImageMap::iterator p = imagePathToSgImageMap.find(textureFile);
             if(p != imagePathToSgImageMap.end()){
                 image = p->second;
-            } else {
-                image = new SgImage;
-                if(imageIO.load(image->image(), textureFile, os())){
-                    image->setUri(path.data, textureFile);
-                    imagePathToSgImageMap[textureFile] = image;
-                } else {
-                    image.reset();
-                }
+            } else if(auto loaded = ImageCache::instance()->load(textureFile, imageIO, os())){
+                image = new SgImage(loaded);
+                image->setUri(path.data, textureFile);
+                imagePathToSgImageMap[textureFile] = image;
             }
             if(image){
                 texture = new SgTexture;
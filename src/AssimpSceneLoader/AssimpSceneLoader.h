@@ -22,6 +22,7 @@ public:
     ~AssimpSceneLoader();
     void setMessageSink(std::ostream& os) override;
     virtual SgNode* load(const std::string& filename) override;
+    virtual bool isCacheable() const override;
 
 private:
     AssimpSceneLoaderImpl* impl;
@@ -46,6 +46,7 @@ namespace {
         QCheckBox waistHeightRelaxationCheck;
         QDoubleSpinBox gravitySpin;
         QDoubleSpinBox dynamicsTimeRatioSpin;
+        QSpinBox numThreadsSpin;
 
         QWidget* panel() { return this; }
 
@@ -154,6 +155,15 @@ namespace {
             hbox->addWidget(&dynamicsTimeRatioSpin);
             hbox->addStretch();
 
+            hbox = newRow(vbox);
+            hbox->addWidget(new QLabel(_("Threads")));
+            numThreadsSpin.setToolTip(_("Number of threads used to calculate the dynamics of the frames"));
+            numThreadsSpin.setAlignment(Qt::AlignCenter);
+            numThreadsSpin.setRange(1, 256);
+            numThreadsSpin.setValue(1);
+            hbox->addWidget(&numThreadsSpin);
+            hbox->addStretch();
+
             setLayout(vbox);
         }
 
@@ -171,6 +181,7 @@ namespace {
             archive.write("waistHeightRelaxation", waistHeightRelaxationCheck.isChecked());
             archive.write("gravity", gravitySpin.value());
             archive.write("dynamicsTimeRatio", dynamicsTimeRatioSpin.value());
+            archive.write("balancerThreads", numThreadsSpin.value());
         }
 
         void restoreState(const Archive& archive){
@@ -192,6 +203,7 @@ namespace {
             waistHeightRelaxationCheck.setChecked(archive.get("waistHeightRelaxation", waistHeightRelaxationCheck.isChecked()));
             gravitySpin.setValue(archive.get("gravity", gravitySpin.value()));
             dynamicsTimeRatioSpin.setValue(archive.get("dynamicsTimeRatio", dynamicsTimeRatioSpin.value()));
+            numThreadsSpin.setValue(archive.get("balancerThreads", numThreadsSpin.value()));
         }
 
         bool apply(BodyPtr& body, PoseProvider* provider, BodyMotionItemPtr motionItem, bool putMessages) {
@@ -219,6 +231,7 @@ namespace {
             balancer->enableWaistHeightRelaxation(waistHeightRelaxationCheck.isChecked());
             balancer->setGravity(gravitySpin.value());
             balancer->setDynamicsTimeRatio(dynamicsTimeRatioSpin.value());
+            balancer->setNumThreads(numThreadsSpin.value());
             
             MessageView* mv = MessageView::mainInstance();
             if(putMessages){
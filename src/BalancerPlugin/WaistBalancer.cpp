@@ -9,6 +9,7 @@
 #include <cnoid/EigenUtil>
 #include <cnoid/NullOut>
 #include <cnoid/GaussianFilter>
+#include <cnoid/ThreadPool>
 #include <fmt/format.h>
 #include "gettext.h"
 
@@ -48,12 +49,19 @@ WaistBalancer::WaistBalancer()
     dynamicsTimeRatio = 1.0;
     isBoundaryCmAdjustmentEnabled = false;
     isWaistHeightRelaxationEnabled = false;
+    numThreads_ = 1;
 
     setBoundarySmoother(QUINTIC_SMOOTHER, 0.5);
     setFullTimeRange();
 }
 
 
+WaistBalancer::~WaistBalancer()
+{
+
+}
+
+
 void WaistBalancer::setBody(const BodyPtr& body)
 {
     body_ = body;
@@ -119,6 +127,18 @@ void WaistBalancer::setDynamicsTimeRatio(double r)
 }
 
 
+void WaistBalancer::setNumThreads(int n)
+{
+    numThreads_ = std::max(1, n);
+}
+
+
+int WaistBalancer::numThreads() const
+{
+    return numThreads_;
+}
+
+
 const char* WaistBalancer::boundaryConditionTypeNameOf(int type)
 {
     if(type == ZERO_VELOCITY){
@@ -234,6 +254,16 @@ bool WaistBalancer::apply(PoseProvider* provider_, BodyMotion& motion, bool putA
     p0 = rootLink->p();
     R0 = rootLink->R();
 
+    if(numThreads_ > 1){
+        if(!threadPool || threadPool->size() != numThreads_){
+            threadPool.reset(new ThreadPool(numThreads_));
+        }
+        threadBodies.resize(numThreads_);
+        for(auto& threadBody : threadBodies){
+            threadBody = body_->clone();
+        }
+    }
+
     bool result = apply2(motion, putAllLinkPositions);
 
     // restore the original body state
@@ -244,6 +274,8 @@ bool WaistBalancer::apply(PoseProvider* provider_, BodyMotion& motion, bool putA
     rootLink->R() = R0;
     body_->calcForwardKinematics();
 
+    threadBodies.clear();
+
     return result;
 }
 
@@ -480,46 +512,56 @@ void WaistBalancer::updateCmAndZmp(int frame)
     cm = body_->calcCenterOfMass();
 
     if(isCalculatingInitialWaistTrajectory){
-        Vector3& p = totalCmTranslations[frame];
-        p.x() = -waistLink->p().x();
-        p.y() = -waistLink->p().y();
-        p.z() = 0.0;
-        desiredZmp = *provider->ZMP();
-        zmpDiff = desiredZmp;
-
+        updateInitialWaistTranslation(frame, waistLink->p(), *provider->ZMP());
     } else {
         Vector3 P, L;
         body_->calcTotalMomentum(P, L);
+        updateZmp(frame, P, L, *provider->ZMP());
+    }
+}
 
-        dP = (P - P0) / dt;
-        dL = (L - L0) / dt;
 
-        P0 = P;
-        L0 = L;
+void WaistBalancer::updateInitialWaistTranslation(int frame, const Vector3& waistPosition, const Vector3& nextZmp)
+{
+    Vector3& p = totalCmTranslations[frame];
+    p.x() = -waistPosition.x();
+    p.y() = -waistPosition.y();
+    p.z() = 0.0;
+    desiredZmp = nextZmp;
+    zmpDiff = desiredZmp;
+}
+
+
+void WaistBalancer::updateZmp(int frame, const Vector3& P, const Vector3& L, const Vector3& nextZmp)
+{
+    dP = (P - P0) / dt;
+    dL = (L - L0) / dt;
+
+    P0 = P;
+    L0 = L;
 
-        const double inertial_g_thresh = 1.0;
-        double ddz = dP.z() / m;
-        inertial_g = g + ddz;
+    const double inertial_g_thresh = 1.0;
+    double ddz = dP.z() / m;
+    inertial_g = g + ddz;
         
-        if(inertial_g < inertial_g_thresh){
-            os() << fmt::format(
-                _("Warning: The body is floating at {0} (Vertical CM acceleration is {1})."),
-                (frame * timeStep), (ddz))
-                 << endl;
-
-            if(DoVerticalAccCompensation){
-                dP.z() = m * (inertial_g_thresh - g);
-                inertial_g = inertial_g_thresh;
-            }
+    if(inertial_g < inertial_g_thresh){
+        os() << fmt::format(
+            _("Warning: The body is floating at {0} (Vertical CM acceleration is {1})."),
+            (frame * timeStep), (ddz))
+             << endl;
+
+        if(DoVerticalAccCompensation){
+            dP.z() = m * (inertial_g_thresh - g);
+            inertial_g = inertial_g_thresh;
         }
+    }
 
-        zmp.x() = (dP.x() * desiredZmp.z() - dL.y() + mg * cm.x()) / (dP.z() + mg);
-        zmp.y() = (dP.y() * desiredZmp.z() + dL.x() + mg * cm.y()) / (dP.z() + mg);
-        zmp.z() = desiredZmp.z();
-        zmpDiff = desiredZmp - zmp;
+    zmp.x() = (dP.x() * desiredZmp.z() - dL.y() + mg * cm.x()) / (dP.z() + mg);
+    zmp.y() = (dP.y() * desiredZmp.z() + dL.x() + mg * cm.y()) / (dP.z() + mg);
+    zmp.z() = desiredZmp.z();
+    zmpDiff = desiredZmp - zmp;
 
-        desiredZmp = *provider->ZMP();
-    }
+    desiredZmp = nextZmp;
 }
 
 
@@ -586,43 +628,10 @@ void WaistBalancer::updateBodyKinematics2()
 
 bool WaistBalancer::calcCmTranslations()
 {
-    initBodyKinematics(frameToStartBalancer, totalCmTranslations[frameToStartBalancer]);
-
-    //const double gdt2 = g * dt2;
-    
-    for(int i = 0; i < numFilteredFrames; ++i){
-
-        updateBodyKinematics1(i + frameToStartBalancer);
-
-        if(doStoreOriginalWaistFeetPositionsForWaistHeightRelaxation){
-            // store waist and feet positions
-            WaistFeetPos& p = waistFeetPosSeq[i];
-            p.T_waist = waistLink->T();
-            for(int j=0; j < 2; ++j){
-                Link* footLink = waistFeetIK.baseLink(j);
-                p.T_foot[j] = footLink->T();
-            }
-        }
-
-        updateBodyKinematics2();
-
-        Coeff& c = coeffSeq[i];
-        /*
-        c.a = -cm.z();
-        c.b = 2.0 * cm.z() + gdt2;
-        c.d = gdt2 * zmpDiff;
-        */
-
-        if(DoVerticalAccCompensation){
-            const double gdt2 = inertial_g * dt2;
-            c.a = -cm.z() / gdt2;
-            c.b = 2.0 * cm.z() / gdt2 + 1.0;
-        } else {
-            const double gdt2 = g * dt2;        
-            c.a = -cm.z() / gdt2;
-            c.b = 2.0 * cm.z() / gdt2 + 1.0;
-        }
-        c.d = zmpDiff;
+    if(numThreads_ > 1){
+        calcCoeffSeqInParallel();
+    } else {
+        calcCoeffSeq();
     }
     
     double bet;
@@ -685,6 +694,205 @@ bool WaistBalancer::calcCmTranslations()
 }
 
 
+void WaistBalancer::calcCoeffSeq()
+{
+    initBodyKinematics(frameToStartBalancer, totalCmTranslations[frameToStartBalancer]);
+
+    for(int i = 0; i < numFilteredFrames; ++i){
+
+        updateBodyKinematics1(i + frameToStartBalancer);
+
+        if(doStoreOriginalWaistFeetPositionsForWaistHeightRelaxation){
+            // store waist and feet positions
+            WaistFeetPos& p = waistFeetPosSeq[i];
+            p.T_waist = waistLink->T();
+            for(int j=0; j < 2; ++j){
+                Link* footLink = waistFeetIK.baseLink(j);
+                p.T_foot[j] = footLink->T();
+            }
+        }
+
+        updateBodyKinematics2();
+
+        updateCoeff(i);
+    }
+}
+
+
+/**
+   The pose provider is only accessed in the sampling of the frame states because it is not
+   thread-safe. The kinematics and momenta of the frames are then calculated in parallel with
+   the body copies, and the ZMPs are calculated sequentially because they depend on the momenta
+   of the previous frames.
+*/
+void WaistBalancer::calcCoeffSeqInParallel()
+{
+    sampleFrameStates();
+
+    const int n = numFilteredFrames;
+    frameCms.resize(n);
+    frameMomenta.resize(n);
+    frameAngularMomenta.resize(n);
+    frameWaistPositions.resize(n);
+
+    const int numThreads = threadPool->size();
+    const int numFramesPerThread = (n + numThreads - 1) / numThreads;
+    for(int i=0; i < numThreads; ++i){
+        const int begin = i * numFramesPerThread;
+        const int end = std::min(begin + numFramesPerThread, n);
+        if(begin >= end){
+            break;
+        }
+        Body* body = threadBodies[i];
+        threadPool->start([this, body, begin, end](){ calcFrameDynamics(body, begin, end); });
+    }
+    threadPool->wait();
+
+    desiredZmp = frameZmps[0];
+    P0.setZero();
+    L0.setZero();
+
+    for(int i = 0; i < n; ++i){
+        const int frame = i + frameToStartBalancer;
+        const Vector3& nextZmp = frameZmps[std::min(i + 1, n - 1)];
+        cm = frameCms[i];
+        if(isCalculatingInitialWaistTrajectory){
+            updateInitialWaistTranslation(frame, frameWaistPositions[i], nextZmp);
+        } else {
+            updateZmp(frame, frameMomenta[i], frameAngularMomenta[i], nextZmp);
+        }
+        updateCoeff(i);
+    }
+}
+
+
+void WaistBalancer::sampleFrameStates()
+{
+    const int n = numFilteredFrames;
+    const int numJoints = body_->numJoints();
+
+    frameJointPositions.resize(numJoints, n);
+    frameBaseLinkIndices.resize(n);
+    frameBasePositions.resize(n);
+    frameZmps.resize(n);
+
+    VectorXd q = VectorXd::Zero(numJoints);
+    int baseLinkIndex = body_->rootLink()->index();
+    Isometry3 T_base = Isometry3::Identity();
+    Vector3 zmp = Vector3::Zero();
+
+    for(int i = 0; i < n; ++i){
+        const int frame = i + frameToStartBalancer;
+        provider->seek(timeOfFrame(frame), waistLinkIndex, totalCmTranslations[frame]);
+
+        // The previous values are kept for the elements which the provider does not give
+        if(provider->baseLinkIndex() >= 0){
+            baseLinkIndex = provider->baseLinkIndex();
+        }
+        provider->getBaseLinkPosition(T_base);
+        provider->getJointPositions(jointPositions);
+        for(int j=0; j < numJoints; ++j){
+            if(jointPositions[j]){
+                q[j] = *jointPositions[j];
+            }
+        }
+        if(auto p = provider->ZMP()){
+            zmp = *p;
+        }
+        frameJointPositions.col(i) = q;
+        frameBaseLinkIndices[i] = baseLinkIndex;
+        frameBasePositions[i] = T_base;
+        frameZmps[i] = zmp;
+    }
+}
+
+
+/**
+   The link velocities of a frame are given by the forward differences of the link positions,
+   and the backward differences are used for the last frame. The frames in the range are
+   processed in the reverse order so that the link positions of each frame are reused as
+   those of the next frame.
+*/
+void WaistBalancer::calcFrameDynamics(Body* body, int begin, int end)
+{
+    const int n = numFilteredFrames;
+    const int numLinks = body->numLinks();
+    const int numJoints = body->numJoints();
+    vector<Isometry3, Eigen::aligned_allocator<Isometry3>> T_adjacent(numLinks);
+    LinkTraverse traverse;
+    Link* baseLink = nullptr;
+
+    auto setFrameKinematics = [&](int index){
+        Link* link = body->link(frameBaseLinkIndices[index]);
+        if(link != baseLink){
+            baseLink = link;
+            traverse.find(baseLink);
+        }
+        baseLink->T() = frameBasePositions[index];
+        auto q = frameJointPositions.col(index);
+        for(int i=0; i < numJoints; ++i){
+            body->joint(i)->q() = q[i];
+        }
+        traverse.calcForwardKinematics();
+    };
+
+    auto storeLinkPositions = [&](){
+        for(int i=0; i < numLinks; ++i){
+            T_adjacent[i] = body->link(i)->T();
+        }
+    };
+
+    setFrameKinematics((end < n) ? end : n - 2);
+    storeLinkPositions();
+
+    for(int index = end - 1; index >= begin; --index){
+
+        setFrameKinematics(index);
+
+        const double s = (index < n - 1) ? (1.0 / dt) : (-1.0 / dt);
+        for(int i=0; i < numLinks; ++i){
+            Link* link = body->link(i);
+            const Isometry3& T = T_adjacent[i];
+            link->v() = s * (T.translation() - link->p());
+            link->w() = s * (link->R() * omegaFromRot(link->R().transpose() * T.linear()));
+        }
+
+        frameCms[index] = body->calcCenterOfMass();
+        body->calcTotalMomentum(frameMomenta[index], frameAngularMomenta[index]);
+
+        Link* waist = body->link(waistLinkIndex);
+        frameWaistPositions[index] = waist->p();
+
+        if(doStoreOriginalWaistFeetPositionsForWaistHeightRelaxation){
+            WaistFeetPos& p = waistFeetPosSeq[index];
+            p.T_waist = waist->T();
+            for(int j=0; j < 2; ++j){
+                p.T_foot[j] = body->link(waistFeetIK.baseLink(j)->index())->T();
+            }
+        }
+
+        storeLinkPositions();
+    }
+}
+
+
+void WaistBalancer::updateCoeff(int index)
+{
+    Coeff& c = coeffSeq[index];
+
+    if(DoVerticalAccCompensation){
+        const double gdt2 = inertial_g * dt2;
+        c.a = -cm.z() / gdt2;
+        c.b = 2.0 * cm.z() / gdt2 + 1.0;
+    } else {
+        const double gdt2 = g * dt2;        
+        c.a = -cm.z() / gdt2;
+        c.b = 2.0 * cm.z() / gdt2 + 1.0;
+    }
+    c.d = zmpDiff;
+}
+
+
 void WaistBalancer::initWaistHeightRelaxation()
 {
     LeggedBodyHelperPtr legged = getLeggedBodyHelper(body_);
@@ -12,15 +12,18 @@
 #include <cnoid/CompositeIK>
 #include <cnoid/stdx/optional>
 #include <vector>
+#include <memory>
 
 namespace cnoid {
 
     class PoseProvider;
+    class ThreadPool;
 
     class WaistBalancer
     {
       public:
         WaistBalancer();
+        ~WaistBalancer();
 
         void setMessageOutputStream(std::ostream& os) {
             os_ = &os;
@@ -38,6 +41,15 @@ namespace cnoid {
         void setGravity(double g);
         void setDynamicsTimeRatio(double r);
 
+        /**
+           When the number of threads is more than one, the kinematics and momenta of the frames
+           are calculated in parallel in each iteration. In that case the velocities are given by
+           the differences of the link positions between adjacent frames instead of the joint
+           velocities, so the result may slightly differ from the single thread calculation.
+        */
+        void setNumThreads(int n);
+        int numThreads() const;
+
         enum BoundaryConditionType {
             KEEP_POSITIONS = 0,
             ZERO_VELOCITY = 1,
@@ -155,6 +167,19 @@ namespace cnoid {
         Link* rightKneePitchJoint;
         Link* leftKneePitchJoint;
 
+        // for the parallel calculation of the frame dynamics
+        int numThreads_;
+        std::unique_ptr<ThreadPool> threadPool;
+        std::vector<BodyPtr> threadBodies;
+        Eigen::MatrixXd frameJointPositions;
+        std::vector<int> frameBaseLinkIndices;
+        std::vector<Isometry3, Eigen::aligned_allocator<Isometry3>> frameBasePositions;
+        std::vector<Vector3> frameZmps;
+        std::vector<Vector3> frameCms;
+        std::vector<Vector3> frameMomenta;
+        std::vector<Vector3> frameAngularMomenta;
+        std::vector<Vector3> frameWaistPositions;
+
         std::ostream* os_;
 
         std::ostream& os() { return *os_; }
@@ -166,9 +191,16 @@ namespace cnoid {
             int frame, const Vector3& zmp, Vector3& out_translation);
         void initBodyKinematics(int frame, const Vector3& cmTranslation);
         void updateCmAndZmp(int frame);
+        void updateInitialWaistTranslation(int frame, const Vector3& waistPosition, const Vector3& nextZmp);
+        void updateZmp(int frame, const Vector3& P, const Vector3& L, const Vector3& nextZmp);
         bool updateBodyKinematics1(int frame);
         void updateBodyKinematics2();
         bool calcCmTranslations();
+        void calcCoeffSeq();
+        void calcCoeffSeqInParallel();
+        void sampleFrameStates();
+        void calcFrameDynamics(Body* body, int begin, int end);
+        void updateCoeff(int index);
         void initWaistHeightRelaxation();
         void relaxWaistHeightTrajectory();
         void applyCubicBoundarySmoother(int begin, int direction);
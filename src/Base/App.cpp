@@ -57,17 +57,23 @@
 #include "TextEditView.h"
 #include "GeneralSliderView.h"
 #include "VirtualJoystickView.h"
+#include "MemoryTelemetryView.h"
+#include "Timer.h"
 #include "MainMenu.h"
 #include "GLSceneRenderer.h"
 #include "Licenses.h"
 #include "MovieRecorderBar.h"
 #include "LazyCaller.h"
 #include "LayoutSwitcher.h"
+#include "StartupProfiler.h"
 #include <cnoid/MessageManager>
 #include <cnoid/Config>
 #include <cnoid/ValueTree>
 #include <cnoid/FilePathVariableProcessor>
+#include <cnoid/SceneLoader>
 #include <cnoid/UTF8>
+#include <cnoid/Tracer>
+#include <cnoid/MemoryTelemetry>
 #include <fmt/format.h>
 #include <Eigen/Core>
 #include <QApplication>
@@ -79,6 +85,7 @@
 #include <QLibraryInfo>
 #include <iostream>
 #include <csignal>
+#include <memory>
 
 #ifdef Q_OS_WIN32
 #include <windows.h>
@@ -137,6 +144,10 @@ public:
     string pluginPathList;
     string iconFilename;
     string builtinProjectFile;
+    string traceFilename;
+    string memoryTelemetryFilename;
+    unique_ptr<MemoryTelemetry::Sampler> memoryTelemetrySampler;
+    Timer memoryTelemetryTimer;
     MessageManager* messageManager;
     PluginManager* pluginManager;
     ExtensionManager* ext;
@@ -157,6 +168,11 @@ public:
     void onMainWindowCloseEvent();
     void onSigOptionsParsed(boost::program_options::variables_map& v);
     void enableTestMode();
+    void finishStartupProfiling();
+    void finishTracing();
+    void startMemoryTelemetryOutput();
+    void outputMemoryTelemetry();
+    void finishMemoryTelemetryOutput();
     virtual bool eventFilter(QObject* watched, QEvent* event);
 };
 
@@ -216,10 +232,34 @@ App::Impl::Impl(App* self, int& argc, char** argv, const std::string& appName, c
     instance_ = self;
     isDoingInitialization_ = true;
 
+    if(auto traceFile = getenv("CNOID_STARTUP_TRACE")){
+        if(traceFile[0] != '\0'){
+            StartupProfiler::enable(toUTF8(traceFile));
+        }
+    }
+
+    // The zones of the whole session are recorded and written when the application exits
+    if(auto traceFile = getenv("CNOID_TRACE")){
+        if(traceFile[0] != '\0'){
+            traceFilename = toUTF8(traceFile);
+            Tracer::setThreadName("Main");
+            Tracer::start();
+        }
+    }
+
+    // The memory telemetry is written to the file periodically during the session
+    if(auto telemetryFile = getenv("CNOID_MEMORY_TELEMETRY")){
+        if(telemetryFile[0] != '\0'){
+            memoryTelemetryFilename = toUTF8(telemetryFile);
+        }
+    }
+
     messageManager = MessageManager::master();
     messageManager->setPendingMode(true);
-    
+
+    StartupProfiler::Scope appConfigStage("AppConfig initialization", "App");
     AppConfig::initialize(appName, organization);
+    appConfigStage.end();
     pluginManager = PluginManager::instance();
 
     ext = nullptr;
@@ -231,6 +271,8 @@ App::Impl::Impl(App* self, int& argc, char** argv, const std::string& appName, c
     doQuit = false;
 
 
+    StartupProfiler::Scope qtStage("Qt initialization", "App");
+
     // OpenGL settings
     GLSceneRenderer::initializeClass();
 
@@ -276,11 +318,15 @@ App::Impl::Impl(App* self, int& argc, char** argv, const std::string& appName, c
 #endif
 
     QTextCodec::setCodecForLocale(QTextCodec::codecForName("UTF-8"));
+
+    qtStage.end();
 }
 
 
 bool App::requirePluginToCustomizeApplication(const std::string& pluginName)
 {
+    StartupProfiler::Scope stage("Application customization", "App");
+    
     impl->pluginManager->loadPlugins(false);
     
     auto plugin = impl->pluginManager->findPlugin(pluginName);
@@ -331,6 +377,8 @@ void App::initialize()
 
 void App::Impl::initialize()
 {
+    StartupProfiler::Scope baseStage("Base module initialization", "App");
+    
     if(checkCurrentLocaleLanguageSupport()){
         translator.load(
             "qt_" + QLocale::system().name(),
@@ -344,11 +392,17 @@ void App::Impl::initialize()
     FilePathVariableProcessor::systemInstance()->setUserVariables(
         AppConfig::archive()->findMapping({ "path_variables", "pathVariables" }));
 
+    if(AppConfig::archive()->get("scene_file_cache", true)){
+        SceneLoader::setCacheDirectory(SceneLoader::defaultCacheDirectory());
+    }
+
     ext = new ExtensionManager("Base", false);
 
     setUTF8ToModuleTextDomain("Util");
 
+    StartupProfiler::Scope mainWindowStage("Main window initialization", "App");
     mainWindow = MainWindow::initialize(appName, ext);
+    mainWindowStage.end();
 
     ViewManager::initializeClass(ext);
 
@@ -390,6 +444,7 @@ void App::Impl::initialize()
     CoordinateFrameListView::initializeClass(ext);
     TaskView::initializeClass(ext);
     VirtualJoystickView::initializeClass(ext);
+    MemoryTelemetryView::initializeClass(ext);
 
     TimeSyncItemEngineManager::initializeClass(ext);
     
@@ -423,7 +478,11 @@ void App::Impl::initialize()
                     EIGEN_WORLD_VERSION, EIGEN_MAJOR_VERSION, EIGEN_MINOR_VERSION,
                     Eigen::SimdInstructionSetsInUse()));
 
+    baseStage.end();
+
+    StartupProfiler::Scope pluginStage("Plugin loading", "App");
     pluginManager->doStartupLoading();
+    pluginStage.end();
 
     mainWindow->installEventFilter(this);
 
@@ -498,6 +557,7 @@ int App::Impl::exec()
     }
 
     if(!doQuit){
+        StartupProfiler::Scope stage("Main window activation", "App");
         if(mainWindow->isVisible()){
             App::updateGui();
         } else {
@@ -509,8 +569,12 @@ int App::Impl::exec()
     if(!doQuit){
         callLater(
             [this](){
+                StartupProfiler::Scope stage("Command line processing", "App");
                 ext->optionManager().parseCommandLine2();
+                stage.end();
                 sigExecutionStarted_();
+                finishStartupProfiling();
+                startMemoryTelemetryOutput();
             });
         
         int result = qapplication->exec();
@@ -520,6 +584,10 @@ int App::Impl::exec()
         }
     }
 
+    finishStartupProfiling();
+    finishTracing();
+    finishMemoryTelemetryOutput();
+
     if(returnCode == 0 && messageView->hasErrorMessages()){
         returnCode = 1;
     }
@@ -542,6 +610,87 @@ int App::Impl::exec()
 }
 
 
+void App::Impl::finishStartupProfiling()
+{
+    if(StartupProfiler::isEnabled()){
+        string summary, errorMessage;
+        bool written = StartupProfiler::finish(summary, errorMessage);
+        messageView->put(summary);
+        if(!written){
+            messageView->putln(errorMessage, MessageView::Error);
+        }
+        std::cout << summary;
+        std::cout.flush();
+    }
+}
+
+
+void App::Impl::finishTracing()
+{
+    if(!traceFilename.empty()){
+        Tracer::stop();
+        string errorMessage;
+        if(Tracer::writeChromeTrace(traceFilename, errorMessage)){
+            std::cout << fmt::format(_("The trace has been written to \"{}\"."), traceFilename) << std::endl;
+            if(auto n = Tracer::numDroppedZones()){
+                std::cout << fmt::format(_("{} zones were not recorded because the trace buffer was full."), n)
+                          << std::endl;
+            }
+        } else {
+            std::cerr << errorMessage << std::endl;
+        }
+        traceFilename.clear();
+    }
+}
+
+
+/**
+   The interval of the output is given by CNOID_MEMORY_TELEMETRY_INTERVAL in seconds, and the
+   default interval is one minute.
+*/
+void App::Impl::startMemoryTelemetryOutput()
+{
+    if(memoryTelemetryFilename.empty()){
+        return;
+    }
+    double interval = 60.0;
+    if(auto intervalText = getenv("CNOID_MEMORY_TELEMETRY_INTERVAL")){
+        double value = atof(intervalText);
+        if(value > 0.0){
+            interval = value;
+        }
+    }
+    memoryTelemetrySampler.reset(new MemoryTelemetry::Sampler);
+    memoryTelemetryTimer.setInterval(static_cast<int>(interval * 1000.0));
+    memoryTelemetryTimer.sigTimeout().connect([this](){ outputMemoryTelemetry(); });
+    outputMemoryTelemetry();
+    memoryTelemetryTimer.start();
+}
+
+
+void App::Impl::outputMemoryTelemetry()
+{
+    memoryTelemetrySampler->sample();
+    string errorMessage;
+    if(!memoryTelemetrySampler->writeRecords(memoryTelemetryFilename, errorMessage)){
+        messageView->putln(errorMessage, MessageView::Error);
+        memoryTelemetryTimer.stop();
+        memoryTelemetrySampler.reset();
+    }
+}
+
+
+//! The final records are written before the items are released.
+void App::Impl::finishMemoryTelemetryOutput()
+{
+    if(memoryTelemetrySampler){
+        memoryTelemetryTimer.stop();
+        outputMemoryTelemetry();
+        memoryTelemetrySampler.reset();
+    }
+}
+
+
 App::ErrorCode App::error() const
 {
     return impl->error;
@@ -27,6 +27,18 @@ EditRecord* EditRecord::getFlipped() const
 }
 
 
+bool EditRecord::merge(const EditRecord* /* nextRecord */)
+{
+    return false;
+}
+
+
+size_t EditRecord::memoryUsage() const
+{
+    return sizeof(EditRecord);
+}
+
+
 EditRecordGroup::EditRecordGroup(const std::string& label, bool isValidForSingleRecord)
     : EditRecord(nullptr),
       label_(label),
@@ -60,6 +72,16 @@ std::string EditRecordGroup::label() const
 }
 
 
+size_t EditRecordGroup::memoryUsage() const
+{
+    size_t usage = sizeof(EditRecordGroup) + label_.capacity() + group_.capacity() * sizeof(EditRecordPtr);
+    for(auto& record : group_){
+        usage += record->memoryUsage();
+    }
+    return usage;
+}
+
+
 bool EditRecordGroup::undo()
 {
     bool done = false;
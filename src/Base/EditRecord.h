@@ -26,6 +26,17 @@ public:
     bool isReverse() const { return isReverse_; }
     EditRecord* getFlipped() const;
 
+    /**
+       This function is called to merge the record of the consecutive edit on the same target
+       object into this record so that a continuous operation such as dragging is stored as a
+       single record. The default implementation does not merge any record.
+       \return true if the record has been merged.
+    */
+    virtual bool merge(const EditRecord* nextRecord);
+
+    //! This function returns the approximate number of bytes used to store the record.
+    virtual size_t memoryUsage() const;
+
 protected:
     EditRecord(Referenced* targetObject);
     EditRecord(const EditRecord& org);
@@ -48,6 +59,7 @@ public:
 
     virtual EditRecord* clone() const override;
     virtual std::string label() const override;
+    virtual size_t memoryUsage() const override;
 
     bool isValidForSingleRecord() const { return isValidForSingleRecord_; }
 
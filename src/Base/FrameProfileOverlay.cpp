@@ -0,0 +1,123 @@
+#include "FrameProfileOverlay.h"
+#include "GLSLSceneRenderer.h"
+#include <cnoid/SceneNodeClassRegistry>
+#include <cnoid/MeshGenerator>
+#include <algorithm>
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+const double Margin = 10.0;
+const double BarHeight = 6.0;
+const double BarInterval = 9.0;
+const double MaxBarLength = 400.0;
+const double PixelsPerSecond = 1.0e4;
+const double PixelsPerDrawCall = 0.1;
+const double PixelsPerTriangle = 1.0e-4;
+const int NumTimeBars = 1 + GLSLSceneRenderer::NumProfilingPasses;
+const int NumBars = NumTimeBars + 2;
+
+struct NodeClassRegistration {
+    NodeClassRegistration() {
+        SceneNodeClassRegistry::instance().
+            registerClass<FrameProfileOverlay, SgViewportOverlay>();
+
+        GLSLSceneRenderer::addExtension(
+            [](GLSLSceneRenderer* renderer){
+                auto functions = renderer->renderingFunctions();
+                functions->setFunction<FrameProfileOverlay>(
+                    [=](SgNode* node){
+                        static_cast<FrameProfileOverlay*>(node)->render(renderer);
+                    });
+            });
+    }
+} registration;
+
+SgShape* createBarShape(SgMesh* mesh, const Vector3f& color)
+{
+    auto shape = new SgShape;
+    shape->setMesh(mesh);
+    auto material = shape->getOrCreateMaterial();
+    material->setDiffuseColor(color);
+    return shape;
+}
+
+}
+
+
+FrameProfileOverlay::FrameProfileOverlay()
+    : SgViewportOverlay(findClassId<FrameProfileOverlay>()),
+      superClassId(findClassId<SgViewportOverlay>())
+{
+    static const Vector3f colors[NumBars] = {
+        { 1.0f, 1.0f, 1.0f }, // traversal
+        { 0.5f, 0.5f, 0.5f }, // shadow map pass
+        { 0.2f, 0.8f, 0.2f }, // main pass
+        { 0.3f, 0.6f, 1.0f }, // transparent pass
+        { 1.0f, 0.8f, 0.2f }, // overlay pass
+        { 1.0f, 0.4f, 0.8f }, // outline pass
+        { 1.0f, 0.3f, 0.3f }, // draw calls
+        { 0.8f, 0.4f, 1.0f }  // triangles
+    };
+
+    MeshGenerator meshGenerator;
+    // The bar extends from the origin along the X axis
+    SgMeshPtr mesh = meshGenerator.generateBox(Vector3(1.0, 1.0, 1.0));
+    mesh->translate(Vector3f(0.5f, 0.5f, 0.0f));
+    mesh->updateBoundingBox();
+
+    bars.resize(NumBars);
+    for(int i=0; i < NumBars; ++i){
+        auto position = new SgPosTransform;
+        position->setTranslation(Vector3(0.0, -(i * BarInterval + BarHeight), 0.0));
+        auto& bar = bars[i];
+        bar = new SgScaleTransform;
+        bar->setScale(Vector3(0.0, BarHeight, 1.0));
+        bar->addChild(createBarShape(mesh, colors[i]));
+        position->addChild(bar);
+        addChild(position);
+    }
+
+    // The time of a 60 fps frame
+    auto frameTimeLine = new SgScaleTransform;
+    frameTimeLine->setScale(Vector3(1.0, NumTimeBars * BarInterval, 1.0));
+    frameTimeLine->addChild(createBarShape(mesh, Vector3f(1.0f, 0.0f, 0.0f)));
+    auto position = new SgPosTransform;
+    position->setTranslation(Vector3(PixelsPerSecond / 60.0, -NumTimeBars * BarInterval, 0.0));
+    position->addChild(frameTimeLine);
+    addChild(position);
+}
+
+
+void FrameProfileOverlay::calcViewVolume(double viewportWidth, double viewportHeight, ViewVolume& io_volume)
+{
+    io_volume.left = -Margin;
+    io_volume.right = viewportWidth - Margin;
+    io_volume.top = Margin;
+    io_volume.bottom = Margin - viewportHeight;
+    io_volume.zNear = -1.0;
+    io_volume.zFar = 1.0;
+}
+
+
+void FrameProfileOverlay::render(GLSLSceneRenderer* renderer)
+{
+    const auto& profile = renderer->frameProfile();
+
+    double lengths[NumBars];
+    lengths[0] = profile.traversalTime * PixelsPerSecond;
+    for(int i=0; i < GLSLSceneRenderer::NumProfilingPasses; ++i){
+        lengths[i + 1] = profile.gpuTimes[i] * PixelsPerSecond;
+    }
+    lengths[NumTimeBars] = profile.numDrawCalls * PixelsPerDrawCall;
+    lengths[NumTimeBars + 1] = profile.numTriangles * PixelsPerTriangle;
+
+    // The scales are updated without the notification because they are only used in this rendering
+    for(int i=0; i < NumBars; ++i){
+        bars[i]->setScale(Vector3(std::min(std::max(lengths[i], 1.0), MaxBarLength), BarHeight, 1.0));
+    }
+    
+    renderer->renderingFunctions()->dispatch(this, superClassId);
+}
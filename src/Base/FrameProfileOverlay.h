@@ -0,0 +1,37 @@
+#ifndef CNOID_BASE_FRAME_PROFILE_OVERLAY_H
+#define CNOID_BASE_FRAME_PROFILE_OVERLAY_H
+
+#include <cnoid/SceneDrawables>
+#include <vector>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+class GLSLSceneRenderer;
+
+/**
+   This overlay shows the frame profile of GLSLSceneRenderer as the horizontal bars at the
+   upper left corner of the viewport. The bars are the CPU time of the scene traversals, the
+   GPU time of the shadow map, main, transparent, overlay and outline passes, the number of
+   the draw calls and the number of the triangles from the top. A time bar of 10 pixels
+   corresponds to one millisecond, and the vertical line shows the time of a 60 fps frame.
+   A draw call bar of 10 pixels corresponds to 100 draw calls, and a triangle bar of 10 pixels
+   corresponds to 100,000 triangles. The frame profiling of the renderer must be enabled.
+*/
+class CNOID_EXPORT FrameProfileOverlay : public SgViewportOverlay
+{
+public:
+    FrameProfileOverlay();
+    virtual void calcViewVolume(double viewportWidth, double viewportHeight, ViewVolume& io_volume) override;
+    void render(GLSLSceneRenderer* renderer);
+
+private:
+    std::vector<SgScaleTransformPtr> bars;
+    int superClassId;
+};
+
+typedef ref_ptr<FrameProfileOverlay> FrameProfileOverlayPtr;
+
+}
+
+#endif
@@ -8,6 +8,7 @@
 #include <cnoid/SceneCameras>
 #include <cnoid/SceneLights>
 #include <cnoid/SceneEffects>
+#include <cnoid/MeshGenerator>
 #include <cnoid/EigenUtil>
 #include <cnoid/NullOut>
 #include <fmt/format.h>
@@ -63,28 +64,102 @@ typedef std::shared_ptr<TransparentShapeInfo> TransparentShapeInfoPtr;
 class VertexResource : public Referenced
 {
 public:
-    GLuint bufferNames[5];
+    enum BufferIndex {
+        VertexBuffer, NormalBuffer, ColorBuffer, TexCoordBuffer, NormalVisualizationVertexBuffer, NumBuffers
+    };
+    GLuint bufferNames[NumBuffers];
+    // The allocated sizes of the buffers, which may be larger than the written data
+    GLsizeiptr bufferCapacities[NumBuffers];
     GLuint numVertices;
     GLuint normalVisualizationSize;
+    bool isValid;
+    // The number of the times the buffers have been rewritten by the updates of the object
+    int numUpdates;
+    std::bitset<NumBuffers> writtenBuffers;
     ScopedConnection updateConnection;
 
-    VertexResource() {
-        for(int i=0; i < 5; ++i){
+    VertexResource(SgObject* object) {
+        for(int i=0; i < NumBuffers; ++i){
             bufferNames[i] = GL_INVALID_VALUE;
+            bufferCapacities[i] = 0;
         }
+        numVertices = 0;
+        normalVisualizationSize = 0;
+        isValid = false;
+        numUpdates = 0;
+        
+        updateConnection.reset(
+            object->sigUpdated().connect(
+                [this](const SgUpdate&){ isValid = false; }));
     }
     ~VertexResource() {
-        for(int i=0; i < 5; ++i){
-            if(bufferNames[i] != GL_INVALID_VALUE){
-                glDeleteBuffers(1, &bufferNames[i]);
+        for(int i=0; i < NumBuffers; ++i){
+            deleteBuffer(i);
+        }
+    }
+    GLuint& vertexBufferName() { return bufferNames[VertexBuffer]; }
+    GLuint& normalBufferName() { return bufferNames[NormalBuffer]; }
+    GLuint& colorBufferName() { return bufferNames[ColorBuffer]; }
+    GLuint& texCoordBufferName() { return bufferNames[TexCoordBuffer]; }
+    GLuint& normalVisualizationVertexBufferName(){ return bufferNames[NormalVisualizationVertexBuffer]; }
+
+    bool isDynamic() const { return numUpdates > 0; }
+
+    void deleteBuffer(int index){
+        if(bufferNames[index] != GL_INVALID_VALUE){
+            glDeleteBuffers(1, &bufferNames[index]);
+            bufferNames[index] = GL_INVALID_VALUE;
+            bufferCapacities[index] = 0;
+        }
+    }
+
+    /**
+       The existing buffers are rewritten when the object is updated so that the object updated
+       frequently such as a point cloud of a sensor does not reallocate the buffers.
+    */
+    void beginWriting(){
+        if(numVertices > 0){
+            ++numUpdates;
+        }
+        writtenBuffers.reset();
+        // The lines are generated again when they are rendered
+        deleteBuffer(NormalVisualizationVertexBuffer);
+    }
+
+    /**
+       The buffer of an updated object is allocated with some margin by GL_DYNAMIC_DRAW and
+       rewritten by glBufferSubData while the data fits in the buffer.
+    */
+    void writeBuffer(int index, GLsizeiptr size, const void* data){
+        auto& name = bufferNames[index];
+        if(name == GL_INVALID_VALUE){
+            glGenBuffers(1, &name);
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, name);
+        auto& capacity = bufferCapacities[index];
+        if(!isDynamic()){
+            glBufferData(GL_ARRAY_BUFFER, size, data, GL_STATIC_DRAW);
+            capacity = size;
+        } else {
+            if(size > capacity){
+                capacity = size + size / 2;
+                glBufferData(GL_ARRAY_BUFFER, capacity, nullptr, GL_DYNAMIC_DRAW);
+            }
+            glBufferSubData(GL_ARRAY_BUFFER, 0, size, data);
+        }
+        writtenBuffers.set(index);
+    }
+
+    //! The buffers of the attributes removed by the update are deleted.
+    void endWriting(){
+        for(int i=0; i < NormalVisualizationVertexBuffer; ++i){
+            if(!writtenBuffers[i]){
+                deleteBuffer(i);
             }
         }
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        isValid = true;
     }
-    GLuint& vertexBufferName() { return bufferNames[0]; }
-    GLuint& normalBufferName() { return bufferNames[1]; }
-    GLuint& colorBufferName() { return bufferNames[2]; }
-    GLuint& texCoordBufferName() { return bufferNames[3]; }
-    GLuint& normalVisualizationVertexBufferName(){ return bufferNames[4]; }
 };
 typedef ref_ptr<VertexResource> VertexResourcePtr;
 
@@ -160,7 +235,6 @@ public:
     ResourceMap resourceMaps[2];
     ResourceMap* currentResourceMap;
     ResourceMap* nextResourceMap;
-    vector<SgObject*> updatedSceneObjects;
 
     int currentResourceMapIndex;
 
@@ -282,6 +356,7 @@ public:
 
     void renderGroup(SgGroup* group);
     void renderSwitchableGroup(SgSwitchableGroup* group);
+    void renderLOD(SgLOD* lod);
     void renderTransform(SgTransform* transform);
     void renderShape(SgShape* shape);
     void renderUnpickableGroup(SgUnpickableGroup* group);
@@ -291,7 +366,7 @@ public:
     void putMeshData(SgMesh* mesh);
     VertexResource* findOrCreateVertexResource(SgObject* object, bool& out_found);
     void renderMesh(SgMesh* mesh, bool hasTexture);
-    void setupMeshResource(SgMesh* mesh, VertexResource* resource, bool hasTexture);
+    void setupMeshResource(const SgMesh* mesh, VertexResource* resource, bool hasTexture);
     void renderNormalVisualizationLines(SgMesh* mesh, VertexResource* resource);
     void renderPointSet(SgPointSet* pointSet);
     void setupPointSetResource(SgPointSet* lineSet, VertexResource* resource);
@@ -390,6 +465,8 @@ void GL1SceneRenderer::Impl::initialize()
         [&](SgTransform* node){ renderTransform(node); });
     renderingFunctions.setFunction<SgSwitchableGroup>(
         [&](SgSwitchableGroup* node){ renderSwitchableGroup(node); });
+    renderingFunctions.setFunction<SgLOD>(
+        [&](SgLOD* node){ renderLOD(node); });
     renderingFunctions.setFunction<SgUnpickableGroup>(
         [&](SgUnpickableGroup* node){ renderUnpickableGroup(node); });
     renderingFunctions.setFunction<SgShape>(
@@ -516,7 +593,6 @@ void GL1SceneRenderer::Impl::beginRendering()
     if(isResourceClearRequested){
         resourceMaps[0].clear();
         resourceMaps[1].clear();
-        updatedSceneObjects.clear();
         hasValidNextResourceMap = false;
         isCheckingUnusedResources = false;
         isResourceClearRequested = false;
@@ -524,12 +600,6 @@ void GL1SceneRenderer::Impl::beginRendering()
     if(hasValidNextResourceMap){
         currentResourceMapIndex = 1 - currentResourceMapIndex;
         currentResourceMap = &resourceMaps[currentResourceMapIndex];
-
-        for(auto& object : updatedSceneObjects){
-            currentResourceMap->erase(object);
-        }
-        updatedSceneObjects.clear();
-
         nextResourceMap = &resourceMaps[1 - currentResourceMapIndex];
         hasValidNextResourceMap = false;
     }
@@ -988,6 +1058,24 @@ void GL1SceneRenderer::Impl::renderSwitchableGroup(SgSwitchableGroup* group)
 }
 
 
+void GL1SceneRenderer::Impl::renderLOD(SgLOD* lod)
+{
+    int level;
+    const double scale = self->levelOfDetailDistanceScale();
+    if(scale == 0.0){
+        level = lod->empty() ? -1 : 0;
+    } else {
+        // The model view matrix gives the position in the view coordinate
+        level = lod->selectLevel(scale * (Vstack.back() * lod->center()).norm());
+    }
+    if(level >= 0){
+        pushPickNode(lod);
+        renderingFunctions.dispatch(lod->child(level));
+        popPickNode();
+    }
+}
+
+
 void GL1SceneRenderer::Impl::renderTransform(SgTransform* transform)
 {
     if(!transform->empty()){
@@ -1045,6 +1133,10 @@ void GL1SceneRenderer::Impl::renderShape(SgShape* shape)
 {
     SgMesh* mesh = shape->mesh();
     if(mesh){
+        if(mesh->isTessellationPending()){
+            // The mesh whose tessellation is deferred is tessellated when it is rendered first
+            MeshGenerator().tessellate(mesh);
+        }
         if(mesh->hasVertices()){
             if(!defaultLighting){
                 auto id = pushPickEndNode(shape, true);
@@ -1350,23 +1442,21 @@ void GL1SceneRenderer::Impl::putMeshData(SgMesh* mesh)
 }
 
 
+/**
+   \param out_found False is set if the buffers of the resource must be written, which is the case
+   of the resource created by this function or the resource of the object updated after it is written.
+*/
 VertexResource* GL1SceneRenderer::Impl::findOrCreateVertexResource(SgObject* object, bool& out_found)
 {
     VertexResource* resource;
     auto it = currentResourceMap->find(object);
     if(it != currentResourceMap->end()){
         resource = static_cast<VertexResource*>(it->second.get());
-        out_found = true;
     } else {
-        resource = new VertexResource;
+        resource = new VertexResource(object);
         it = currentResourceMap->insert(ResourceMap::value_type(object, resource)).first;
-        resource->updateConnection =
-            object->sigUpdated().connect(
-                [this, object](const SgUpdate& update){
-                    updatedSceneObjects.push_back(object);
-                });
-        out_found = false;
     }
+    out_found = resource->isValid;
     if(isCheckingUnusedResources){
         nextResourceMap->insert(*it);
     }
@@ -1465,13 +1555,13 @@ void GL1SceneRenderer::Impl::renderMesh(SgMesh* mesh, bool hasTexture)
 }
 
 
-void GL1SceneRenderer::Impl::setupMeshResource(SgMesh* mesh, VertexResource* resource, bool hasTexture)
+void GL1SceneRenderer::Impl::setupMeshResource(const SgMesh* mesh, VertexResource* resource, bool hasTexture)
 {
-    SgIndexArray& orgTriangleVertices = mesh->triangleVertices();
+    const SgIndexArray& orgTriangleVertices = mesh->triangleVertices();
     const size_t totalNumVertices = orgTriangleVertices.size();
 
-    SgVertexArray& orgVertices = *mesh->vertices();
-    auto vertices = tmpbuf->vertices;
+    const SgVertexArray& orgVertices = *mesh->vertices();
+    auto& vertices = tmpbuf->vertices;
     vertices.clear();
     vertices.reserve(totalNumVertices);
     
@@ -1524,28 +1614,24 @@ void GL1SceneRenderer::Impl::setupMeshResource(SgMesh* mesh, VertexResource* res
         }
     }
 
-    glGenBuffers(1, &resource->vertexBufferName());
-    glBindBuffer(GL_ARRAY_BUFFER, resource->vertexBufferName());
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vector3f), vertices.data(), GL_STATIC_DRAW);
+    resource->beginWriting();
+    resource->writeBuffer(VertexResource::VertexBuffer, vertices.size() * sizeof(Vector3f), vertices.data());
     resource->numVertices = vertices.size();
 
     if(pNormals){
-        glGenBuffers(1, &resource->normalBufferName());
-        glBindBuffer(GL_ARRAY_BUFFER, resource->normalBufferName());
-        glBufferData(GL_ARRAY_BUFFER, pNormals->size() * sizeof(Vector3f), pNormals->data(), GL_STATIC_DRAW);
+        resource->writeBuffer(
+            VertexResource::NormalBuffer, pNormals->size() * sizeof(Vector3f), pNormals->data());
     }
     if(pColors){
-        glGenBuffers(1, &resource->colorBufferName());
-        glBindBuffer(GL_ARRAY_BUFFER, resource->colorBufferName());
-        glBufferData(GL_ARRAY_BUFFER, pColors->size() * sizeof(ColorArray::value_type), pColors->data(), GL_STATIC_DRAW);
+        resource->writeBuffer(
+            VertexResource::ColorBuffer, pColors->size() * sizeof(ColorArray::value_type), pColors->data());
     }
     if(pTexCoords){
-        glGenBuffers(1, &resource->texCoordBufferName());
-        glBindBuffer(GL_ARRAY_BUFFER, resource->texCoordBufferName());
-        glBufferData(GL_ARRAY_BUFFER, pTexCoords->size() * sizeof(Vector2f), pTexCoords->data(), GL_STATIC_DRAW);
+        resource->writeBuffer(
+            VertexResource::TexCoordBuffer, pTexCoords->size() * sizeof(Vector2f), pTexCoords->data());
     }
 
-    glBindBuffer(GL_ARRAY_BUFFER, 0); // Unbind the buffer
+    resource->endWriting();
 }
 
 
@@ -1615,9 +1701,8 @@ void GL1SceneRenderer::Impl::renderPointSet(SgPointSet* pointSet)
 void GL1SceneRenderer::Impl::setupPointSetResource(SgPointSet* pointSet, VertexResource* resource)
 {
     const SgVertexArray& vertices = *pointSet->vertices();
-    glGenBuffers(1, &resource->vertexBufferName());
-    glBindBuffer(GL_ARRAY_BUFFER, resource->vertexBufferName());
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vector3f), vertices.data(), GL_STATIC_DRAW);
+    resource->beginWriting();
+    resource->writeBuffer(VertexResource::VertexBuffer, vertices.size() * sizeof(Vector3f), vertices.data());
     resource->numVertices = vertices.size();
     
     if(pointSet->hasNormals()){
@@ -1635,9 +1720,8 @@ void GL1SceneRenderer::Impl::setupPointSetResource(SgPointSet* pointSet, VertexR
                 pNormals->push_back(orgNormals[normalIndices[i]]);
             }
         }
-        glGenBuffers(1, &resource->normalBufferName());
-        glBindBuffer(GL_ARRAY_BUFFER, resource->normalBufferName());
-        glBufferData(GL_ARRAY_BUFFER, pNormals->size() * sizeof(Vector3f), pNormals->data(), GL_STATIC_DRAW);
+        resource->writeBuffer(
+            VertexResource::NormalBuffer, pNormals->size() * sizeof(Vector3f), pNormals->data());
     }
 
     if(pointSet->hasColors()){
@@ -1656,12 +1740,11 @@ void GL1SceneRenderer::Impl::setupPointSetResource(SgPointSet* pointSet, VertexR
                 colors.push_back(createColorWithAlpha(orgColors[colorIndices[i]]));
             }
         }
-        glGenBuffers(1, &resource->colorBufferName());
-        glBindBuffer(GL_ARRAY_BUFFER, resource->colorBufferName());
-        glBufferData(GL_ARRAY_BUFFER, colors.size() * sizeof(ColorArray::value_type), colors.data(), GL_STATIC_DRAW);
+        resource->writeBuffer(
+            VertexResource::ColorBuffer, colors.size() * sizeof(ColorArray::value_type), colors.data());
     }
     
-    glBindBuffer(GL_ARRAY_BUFFER, 0); // Unbind the buffer
+    resource->endWriting();
 }
 
 
@@ -1733,23 +1816,20 @@ void GL1SceneRenderer::Impl::setupLineSetResource(SgLineSet* lineSet, VertexReso
         }
     }
 
-    glGenBuffers(1, &resource->vertexBufferName());
-    glBindBuffer(GL_ARRAY_BUFFER, resource->vertexBufferName());
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vector3f), vertices.data(), GL_STATIC_DRAW);
+    resource->beginWriting();
+    resource->writeBuffer(VertexResource::VertexBuffer, vertices.size() * sizeof(Vector3f), vertices.data());
     resource->numVertices = vertices.size();
 
     if(pNormals){
-        glGenBuffers(1, &resource->normalBufferName());
-        glBindBuffer(GL_ARRAY_BUFFER, resource->normalBufferName());
-        glBufferData(GL_ARRAY_BUFFER, pNormals->size() * sizeof(Vector3f), pNormals->data(), GL_STATIC_DRAW);
+        resource->writeBuffer(
+            VertexResource::NormalBuffer, pNormals->size() * sizeof(Vector3f), pNormals->data());
     }
     if(pColors){
-        glGenBuffers(1, &resource->colorBufferName());
-        glBindBuffer(GL_ARRAY_BUFFER, resource->colorBufferName());
-        glBufferData(GL_ARRAY_BUFFER, pColors->size() * sizeof(ColorArray::value_type), pColors->data(), GL_STATIC_DRAW);
+        resource->writeBuffer(
+            VertexResource::ColorBuffer, pColors->size() * sizeof(ColorArray::value_type), pColors->data());
     }
     
-    glBindBuffer(GL_ARRAY_BUFFER, 0); // Unbind the buffer
+    resource->endWriting();
 }
 
 
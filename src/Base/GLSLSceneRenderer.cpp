@@ -9,13 +9,21 @@
 #include <cnoid/SceneCameras>
 #include <cnoid/SceneLights>
 #include <cnoid/SceneEffects>
+#include <cnoid/MeshGenerator>
 #include <cnoid/EigenUtil>
 #include <cnoid/NullOut>
+#include <cnoid/SceneNodeClassRegistry>
+#include <cnoid/ThreadPool>
+#include <cnoid/Tracer>
+#include <cnoid/MemoryTelemetry>
 #include <fmt/format.h>
-#include <GL/glu.h>
 #include <unordered_map>
+#include <unordered_set>
 #include <deque>
 #include <mutex>
+#include <atomic>
+#include <thread>
+#include <chrono>
 #include <regex>
 #include <stdexcept>
 #include <iostream>
@@ -36,6 +44,23 @@ constexpr bool USE_GL_FLUSH_FUNCTION_IN_SHADOW_MAP_RENDERING = false;
 constexpr int DepthTextureIndex = 0;
 constexpr int ImageTextureIndex = 1;
 constexpr int ShadowMapTextureIndex = 2;
+// The shadow maps use the four indices from ShadowMapTextureIndex
+constexpr int ImageTextureArrayIndex = 6;
+
+// The location of the instanceMatrix attribute, which occupies four locations for the columns
+constexpr GLuint InstanceMatrixAttributeLocation = 4;
+
+// The location of the instanceTextureLayer attribute used with the texture arrays
+constexpr GLuint InstanceTextureLayerAttributeLocation = 8;
+
+// A texture array first has this number of layers and the number is doubled when the array is full
+constexpr int InitialNumTextureArrayLayers = 4;
+
+// The queued shapes sharing the same mesh, material and texture are drawn by an instanced draw call at least this number
+constexpr int MinNumInstancesForInstancedDrawing = 2;
+
+// The deferred sub trees are collected by the worker threads if there are at least this number of them
+constexpr int MinNumSubTreesForParallelCollection = 4;
 
 typedef vector<Affine3, Eigen::aligned_allocator<Affine3>> Affine3Array;
 
@@ -60,11 +85,28 @@ struct LockVertexArrayAPI
         }
     }
 };
+
+std::mutex meshTessellationMutex;
+
+/*
+  The meshes whose tessellation is deferred are tessellated when they are rendered first.
+  The mutex is required because the shapes may be collected by the worker threads.
+*/
+void tessellatePendingMesh(SgMesh* mesh)
+{
+    std::lock_guard<std::mutex> lock(meshTessellationMutex);
+    if(mesh->isTessellationPending()){
+        MeshGenerator().tessellate(mesh);
+    }
+}
         
 class GLResource : public Referenced
 {
 public:
     virtual void discard() = 0;
+    int numReferences() const { return refCount(); }
+    //! The estimated size of the GPU memory held by the resource
+    virtual size_t memoryBytes() const { return 0; }
 };
 
 typedef ref_ptr<GLResource> GLResourcePtr;
@@ -78,16 +120,127 @@ struct SgObjectPtrHash {
 
 typedef std::unordered_map<SgObjectPtr, GLResourcePtr, SgObjectPtrHash> GLResourceMap;
 
+//! The indices of the attributes of a face vertex, which is merged with the same face vertices
+struct VertexAttributeIndices
+{
+    int vertex;
+    int normal;
+    int texCoord;
+    int color;
+    bool operator==(const VertexAttributeIndices& rhs) const {
+        return vertex == rhs.vertex && normal == rhs.normal && texCoord == rhs.texCoord && color == rhs.color;
+    }
+};
+
+struct VertexAttributeIndicesHash {
+    std::size_t operator()(const VertexAttributeIndices& indices) const {
+        std::size_t h = std::hash<int>()(indices.vertex);
+        h = h * 31 + std::hash<int>()(indices.normal);
+        h = h * 31 + std::hash<int>()(indices.texCoord);
+        return h * 31 + std::hash<int>()(indices.color);
+    }
+};
+
+/**
+   An opaque shape collected in the render queue. The items are sorted so that the shapes
+   sharing the same texture, material and mesh are rendered consecutively.
+*/
+/**
+   The textures whose images have the same size and the same number of components and whose
+   repeat modes are the same have the same key, and they can be stored in the same texture array.
+   Zero is returned if the texture cannot be stored in a texture array.
+*/
+uint64_t getTextureArrayKey(const SgTexture* texture)
+{
+    if(texture){
+        if(auto image = texture->image()){
+            int nc = image->numComponents();
+            if(!image->empty() && nc >= 1 && nc <= 4){
+                return (static_cast<uint64_t>(image->width()) << 32) |
+                    (static_cast<uint64_t>(image->height()) << 8) |
+                    (nc << 2) | (texture->repeatS() << 1) | texture->repeatT();
+            }
+        }
+    }
+    return 0;
+}
+
+struct RenderQueueItem
+{
+    SgShape* shape;
+    int modelMatrixIndex;
+    int pickIndex;
+
+    bool operator<(const RenderQueueItem& rhs) const {
+        auto texture = shape->texture();
+        auto rhsTexture = rhs.shape->texture();
+        if(texture != rhsTexture){
+            return texture < rhsTexture;
+        }
+        auto material = shape->material();
+        auto rhsMaterial = rhs.shape->material();
+        if(material != rhsMaterial){
+            return material < rhsMaterial;
+        }
+        return shape->mesh() < rhs.shape->mesh();
+    }
+    bool hasSameStatesAs(const RenderQueueItem& rhs) const {
+        return shape->mesh() == rhs.shape->mesh() && shape->material() == rhs.shape->material() &&
+            shape->texture() == rhs.shape->texture();
+    }
+    bool hasSameMeshAndMaterialAs(const RenderQueueItem& rhs) const {
+        return shape->mesh() == rhs.shape->mesh() && shape->material() == rhs.shape->material();
+    }
+
+    /**
+       The order used when the texture arrays are enabled. The shapes sharing the same mesh
+       and material are adjacent, and their textures stored in the same array are adjacent.
+    */
+    static bool isInTextureArrayOrder(const RenderQueueItem& lhs, const RenderQueueItem& rhs){
+        auto material = lhs.shape->material();
+        auto rhsMaterial = rhs.shape->material();
+        if(material != rhsMaterial){
+            return material < rhsMaterial;
+        }
+        auto mesh = lhs.shape->mesh();
+        auto rhsMesh = rhs.shape->mesh();
+        if(mesh != rhsMesh){
+            return mesh < rhsMesh;
+        }
+        auto texture = lhs.shape->texture();
+        auto rhsTexture = rhs.shape->texture();
+        if(texture != rhsTexture){
+            auto key = getTextureArrayKey(texture);
+            auto rhsKey = getTextureArrayKey(rhsTexture);
+            if(key != rhsKey){
+                return key < rhsKey;
+            }
+            return texture < rhsTexture;
+        }
+        return false;
+    }
+};
+
 class VertexResource : public GLResource
 {
 public:
     EIGEN_MAKE_ALIGNED_OPERATOR_NEW
     
-    static const int MAX_NUM_BUFFERS = 4;
+    static const int MAX_NUM_BUFFERS = 7;
     GLuint vao;
     GLuint vbos[MAX_NUM_BUFFERS];
+    // The allocated sizes of the buffers, which may be larger than the written data
+    GLsizeiptr bufferCapacities[MAX_NUM_BUFFERS];
+    // The number of the vertices to draw, which is the number of the indices if the vertices are indexed
     GLsizei numVertices;
     int numBuffers;
+    int numUsedBuffers;
+    // The number of the times the buffers have been rewritten by the updates of the object
+    int numUpdates;
+    // The type of the element indices, or zero if the vertices are not indexed
+    GLenum elementType;
+    GLuint instanceMatrixBuffer;
+    GLuint instanceTextureLayerBuffer;
     Matrix4* pLocalTransform;
     Matrix4 localTransform;
     SgLineSetPtr boundingBoxLines;
@@ -112,37 +265,99 @@ public:
         vao = 0;
         for(int i=0; i < MAX_NUM_BUFFERS; ++i){
             vbos[i] = 0;
+            bufferCapacities[i] = 0;
         }
         numBuffers = 0;
+        numUsedBuffers = 0;
+        numUpdates = 0;
         numVertices = 0;
+        elementType = 0;
+        instanceMatrixBuffer = 0;
+        instanceTextureLayerBuffer = 0;
     }
 
     virtual void discard() override { clearHandles(); }
 
+    virtual size_t memoryBytes() const override {
+        size_t bytes = 0;
+        for(int i=0; i < numBuffers; ++i){
+            bytes += bufferCapacities[i];
+        }
+        return bytes;
+    }
+
+    /**
+       The existing buffers are rewritten when the object is updated so that the object
+       updated frequently such as a point cloud of a sensor does not reallocate the buffers.
+    */
     bool isValid(){
         if(numVertices > 0){
             return true;
         } else if(numBuffers > 0){
-            deleteBuffers();
+            beginUpdate();
         }
         return false;
     }
 
+    void beginUpdate(){
+        LockVertexArrayAPI lock;
+        glBindVertexArray(vao);
+        // The attributes are enabled again by the attributes written in the update
+        for(GLuint i=0; i < 4; ++i){
+            glDisableVertexAttribArray(i);
+        }
+        numUsedBuffers = 0;
+        instanceMatrixBuffer = 0;
+        instanceTextureLayerBuffer = 0;
+        elementType = 0;
+        ++numUpdates;
+    }
+
     GLuint newBuffer(){
+        if(numUsedBuffers < numBuffers){
+            return vbos[numUsedBuffers++];
+        }
         GLuint buffer;
         glGenBuffers(1, &buffer);
         vbos[numBuffers++] = buffer;
+        numUsedBuffers = numBuffers;
         return buffer;
     }
 
+    bool isDynamic() const { return numUpdates > 0; }
+
+    /**
+       The data is written to the buffer given by the last newBuffer() call. The buffer of an
+       updated object is allocated with some margin by GL_DYNAMIC_DRAW and rewritten by
+       glBufferSubData while the data fits in the buffer.
+    */
+    void writeBuffer(GLenum target, GLsizeiptr size, const void* data){
+        auto& capacity = bufferCapacities[numUsedBuffers - 1];
+        if(!isDynamic()){
+            glBufferData(target, size, data, GL_STATIC_DRAW);
+            capacity = size;
+        } else {
+            if(size > capacity){
+                capacity = size + size / 2;
+                glBufferData(target, capacity, nullptr, GL_DYNAMIC_DRAW);
+            }
+            glBufferSubData(target, 0, size, data);
+        }
+    }
+
     void deleteBuffers(){
         if(numBuffers > 0){
             glDeleteBuffers(numBuffers, vbos);
             for(int i=0; i < numBuffers; ++i){
                 vbos[i] = 0;
+                bufferCapacities[i] = 0;
             }
             numBuffers = 0;
+            numUsedBuffers = 0;
         }
+        elementType = 0;
+        instanceMatrixBuffer = 0;
+        instanceTextureLayerBuffer = 0;
     }
 
     GLuint vbo(int index) {
@@ -159,39 +374,234 @@ public:
 
 typedef ref_ptr<VertexResource> VertexResourcePtr;
 
+/**
+   The images of the same size and format are stored in the layers of a 2D array texture so
+   that the queued shapes with different textures can be drawn by an instanced draw call.
+   The images keep their own textures for the other rendering.
+*/
+class TextureArrayResource : public GLResource
+{
+public:
+    GLuint textureId;
+    int width;
+    int height;
+    int numComponents;
+    GLenum format;
+    bool repeatS;
+    bool repeatT;
+    int numLayers;
+    int numUsedLayers;
+    // The image of each layer, which is null for the unused layer
+    vector<SgImage*> layerImages;
+    bool isMipmapUpdateNeeded;
+    // The renderer using the array
+    const void* owner;
+
+    TextureArrayResource(const SgTexture* texture, const void* owner)
+        : owner(owner)
+    {
+        textureId = 0;
+        auto image = texture->image();
+        width = image->width();
+        height = image->height();
+        numComponents = image->numComponents();
+        switch(numComponents){
+        case 1 : format = GL_RED; break;
+        case 2 : format = GL_RG; break;
+        case 3 : format = GL_RGB; break;
+        default: format = GL_RGBA; break;
+        }
+        repeatS = texture->repeatS();
+        repeatT = texture->repeatT();
+        numLayers = 0;
+        numUsedLayers = 0;
+        isMipmapUpdateNeeded = false;
+    }
+
+    ~TextureArrayResource(){
+        if(textureId){
+            glDeleteTextures(1, &textureId);
+        }
+    }
+
+    virtual void discard() override {
+        textureId = 0;
+        numLayers = 0;
+    }
+
+    virtual size_t memoryBytes() const override {
+        return static_cast<size_t>(width) * height * numComponents * numLayers;
+    }
+
+    void setUnpackAlignment(){
+        glPixelStorei(GL_UNPACK_ALIGNMENT, numComponents == 3 ? 1 : numComponents);
+    }
+
+    bool isStorable(const SgImage* image) const {
+        return (image->width() == width && image->height() == height && image->numComponents() == numComponents);
+    }
+
+    void writeLayer(int layer){
+        auto image = layerImages[layer];
+        // The image resized after it is stored is moved to another array when it is rendered next
+        if(isStorable(image)){
+            glTexSubImage3D(
+                GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, width, height, 1, format, GL_UNSIGNED_BYTE,
+                image->constPixels());
+            isMipmapUpdateNeeded = true;
+        }
+    }
+
+    //! The texture must be bound to GL_TEXTURE_2D_ARRAY before calling this function.
+    int addLayer(SgImage* image, int maxNumLayers){
+        int layer = -1;
+        for(size_t i=0; i < layerImages.size(); ++i){
+            if(!layerImages[i]){
+                layer = i;
+                break;
+            }
+        }
+        if(layer < 0){
+            layer = layerImages.size();
+            if(layer >= numLayers){
+                int newNumLayers = std::min(std::max(InitialNumTextureArrayLayers, numLayers * 2), maxNumLayers);
+                if(layer >= newNumLayers){
+                    return -1;
+                }
+                allocate(newNumLayers);
+            }
+            layerImages.push_back(nullptr);
+        }
+        layerImages[layer] = image;
+        ++numUsedLayers;
+        setUnpackAlignment();
+        writeLayer(layer);
+        return layer;
+    }
+
+    /**
+       The storage is reallocated with the new number of layers and the images of the existing
+       layers are written again. This is simpler than copying the layers between the textures
+       and the reallocation only happens a few times for each array.
+    */
+    void allocate(int newNumLayers){
+        if(!textureId){
+            glGenTextures(1, &textureId);
+            glBindTexture(GL_TEXTURE_2D_ARRAY, textureId);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, repeatS ? GL_REPEAT : GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, repeatT ? GL_REPEAT : GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        }
+        glTexImage3D(
+            GL_TEXTURE_2D_ARRAY, 0, format, width, height, newNumLayers, 0, format, GL_UNSIGNED_BYTE, nullptr);
+        numLayers = newNumLayers;
+        setUnpackAlignment();
+        for(size_t i=0; i < layerImages.size(); ++i){
+            if(layerImages[i]){
+                writeLayer(i);
+            }
+        }
+    }
+
+    void removeLayer(int layer){
+        layerImages[layer] = nullptr;
+        --numUsedLayers;
+    }
+};
+
+typedef ref_ptr<TextureArrayResource> TextureArrayResourcePtr;
+
+class TextureResource;
+
+/*
+  The texture resources which can be used by the renderers with the resource sharing enabled.
+  The resources are not owned by this map, and each resource removes itself from the map when
+  it is deleted.
+*/
+std::mutex sharedTextureResourceMutex;
+std::unordered_map<SgImage*, TextureResource*> sharedTextureResources;
+
 class TextureResource : public GLResource
 {
 public:
     bool isLoaded;
     bool isImageUpdateNeeded;
+    // The array which the image is also stored in, and the layer of the image in it
+    TextureArrayResourcePtr textureArray;
+    int textureArrayLayer;
+    bool isTextureArrayLayerUpdateNeeded;
     GLuint textureId;
     GLuint samplerId;
     int width;
     int height;
     int numComponents;
+    bool isCompressed;
+    // The image registered in the shared texture resource map, which is null if not registered
+    SgImage* sharedImage;
     ScopedConnection connection;
         
     TextureResource(SgImage* image)
     {
+        sharedImage = nullptr;
         isLoaded = false;
         isImageUpdateNeeded = false;
+        isCompressed = false;
         textureId = 0;
         samplerId = 0;
         width = 0;
         height = 0;
         numComponents = 0;
+        textureArrayLayer = -1;
+        isTextureArrayLayerUpdateNeeded = false;
 
         connection.reset(
             image->sigUpdated().connect(
-                [&](const SgUpdate&){ isImageUpdateNeeded = true; }));
+                [&](const SgUpdate&){
+                    isImageUpdateNeeded = true;
+                    isTextureArrayLayerUpdateNeeded = true;
+                }));
     }
 
     ~TextureResource(){
         clear();
+        removeTextureArrayLayer();
+        if(sharedImage){
+            std::lock_guard<std::mutex> lock(sharedTextureResourceMutex);
+            auto p = sharedTextureResources.find(sharedImage);
+            if(p != sharedTextureResources.end() && p->second == this){
+                sharedTextureResources.erase(p);
+            }
+        }
+    }
+
+    void registerAsSharedResource(SgImage* image){
+        std::lock_guard<std::mutex> lock(sharedTextureResourceMutex);
+        sharedTextureResources[image] = this;
+        sharedImage = image;
+    }
+
+    static TextureResource* findSharedResource(SgImage* image){
+        std::lock_guard<std::mutex> lock(sharedTextureResourceMutex);
+        auto p = sharedTextureResources.find(image);
+        return (p != sharedTextureResources.end()) ? p->second : nullptr;
+    }
+
+    void removeTextureArrayLayer(){
+        if(textureArray){
+            textureArray->removeLayer(textureArrayLayer);
+            textureArray.reset();
+            textureArrayLayer = -1;
+        }
     }
 
     virtual void discard() override { isLoaded = false; }
 
+    // The mipmaps and the compression are not considered
+    virtual size_t memoryBytes() const override {
+        return isLoaded ? static_cast<size_t>(width) * height * numComponents : 0;
+    }
+
     void clear() {
         if(isLoaded){
             if(textureId){
@@ -225,6 +635,111 @@ public:
 };
 
 
+bool isCullableSubTree(SgGroup* group)
+{
+    for(auto& node : *group){
+        if(node->hasAttribute(SgObject::Marker)){
+            // The bounding boxes do not include the markers
+            return false;
+        }
+        if(auto childGroup = node->toGroupNode()){
+            if(childGroup->isTransformNode() ||
+               dynamic_cast<SgFixedPixelSizeGroup*>(childGroup) || dynamic_cast<SgOverlay*>(childGroup)){
+                return false;
+            }
+            if(!isCullableSubTree(childGroup)){
+                return false;
+            }
+        } else if(!dynamic_cast<SgShape*>(node.get()) && !dynamic_cast<SgPlot*>(node.get()) &&
+                  !dynamic_cast<SgPreprocessed*>(node.get())){
+            return false;
+        }
+    }
+    return true;
+}
+
+
+/**
+   The transforms are culled by the bounds that do not depend on the transforms of the
+   descendant nodes, which may be updated without the notification.
+*/
+bool isCullableTransform(SgTransform* transform)
+{
+    if(!dynamic_cast<SgPosTransform*>(transform) && !dynamic_cast<SgScaleTransform*>(transform) &&
+       !dynamic_cast<SgAffineTransform*>(transform)){
+        return false;
+    }
+    return isCullableSubTree(transform);
+}
+
+
+/**
+   The bounds of the children of a transform node in its local coordinate. The bounds are
+   updated when the bounding box cache of the node is invalidated by the update notification.
+*/
+class BoundingVolumeResource : public GLResource
+{
+public:
+    BoundingBox bbox;
+    // False if the sub tree contains the nodes whose bounds may change without notification
+    bool isCullable;
+    // True if the sub tree only consists of the nodes that can be collected by a worker thread
+    bool isCollectable;
+    BoundingVolumeResource() : isCullable(false), isCollectable(false) { }
+    virtual void discard() override { }
+};
+
+
+/**
+   A transform node whose sub tree is collected into the render queue after the traversal
+   of the scene. The model matrix is the one multiplied by the transform of the node.
+*/
+struct SubTreeCollectionTask
+{
+    SgTransform* transform;
+    int modelMatrixIndex;
+    bool isInsideFrustum;
+    float minTransparency;
+};
+
+
+/**
+   The outputs of a thread collecting the sub trees. The outputs of a task whose sub tree
+   includes a node that cannot be collected by the thread are discarded, and the sub tree
+   is traversed in the GL thread instead.
+*/
+/**
+   The depth of the static shadow casters rendered into a shadow map with the view
+   projection matrix, which is kept by ShadowMapProgram::storeShadowMapCache.
+*/
+struct StaticShadowMapCache
+{
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+    Matrix4 PV;
+    bool isValid;
+    StaticShadowMapCache() : isValid(false) { }
+};
+
+
+struct SubTreeCollectionBuffer
+{
+    vector<RenderQueueItem> renderQueue;
+    Affine3Array modelMatrices;
+    // The pairs of a transparent shape and the index of its model matrix
+    vector<pair<SgShape*, int>> transparentShapes;
+    vector<int> failedTaskIndices;
+    bool hasCulledShapes;
+
+    void clear(){
+        renderQueue.clear();
+        modelMatrices.clear();
+        transparentShapes.clear();
+        failedTaskIndices.clear();
+        hasCulledShapes = false;
+    }
+};
+
+
 class ScopedShaderProgramActivator
 {
     GLSLSceneRenderer::Impl* renderer;
@@ -305,9 +820,38 @@ public:
     bool isRenderingVisibleImage;
     bool isRenderingPickingImage;
     bool isPickingImageOutputEnabled;
+
+    /*
+      The picking image of the whole viewport is kept and reused for the following picks
+      until the scene graph, the camera or the viewport is updated. Only the picked pixel
+      is rendered while the scene is updated between the picks.
+    */
+    bool isPickingImageCacheEnabled;
+    bool isPickingImageCached;
+    bool isSceneUpdatedAfterPicking;
+    Matrix4 PVForPickingImage;
+    ScopedConnection sceneRootConnection;
     bool isShadowCastingAvailable;
     bool isWorldLightShadowEnabled;
     bool isRenderingShadowMap;
+
+    // The shadow of the directional world light is split into the cascades by the view depth
+    int numWorldLightShadowCascades;
+    double worldLightShadowDistance;
+
+    /*
+      The depth of the shadow casters under the nodes with the Static attribute is cached for
+      each shadow map, and the other casters are rendered over the copy of the cached depth.
+      The caches are invalidated when the static nodes are updated or the nodes are added to
+      or removed from the scene.
+    */
+    bool isStaticShadowMapCacheEnabled;
+    bool isStaticNodeCheckEnabled;
+    bool hasStaticShadowCasters;
+    bool isShadowCasterFilterEnabled;
+    bool isRenderingStaticShadowCasters;
+    bool isInsideStaticNode;
+    vector<StaticShadowMapCache, Eigen::aligned_allocator<StaticShadowMapCache>> staticShadowMapCaches;
     bool isLightweightRenderingBeingProcessed;
     bool isLowMemoryConsumptionMode;
     bool isLowMemoryConsumptionRenderingBeingProcessed;
@@ -335,6 +879,83 @@ public:
         
     deque<function<void()>> transparentRenderingQueue;
     deque<function<void()>> overlayRenderingQueue;
+
+    // The shapes and transform nodes outside the view frustum are skipped in the traversal
+    bool isFrustumCullingEnabled;
+    bool isFrustumCullingBeingProcessed;
+    bool isCurrentNodeInsideFrustum;
+    Vector4 frustumPlanes[6];
+
+    /*
+      The opaque shapes rendered by the base program of a pass are collected in the render
+      queue during the scene traversal, and they are rendered after the traversal in the
+      sorted order. The queue collected in the first shadow map pass is reused in the other
+      shadow map passes of the same frame if the traversal only collected shapes.
+    */
+    bool isRenderQueueEnabled;
+    bool isRenderQueueBeingCollected;
+    bool isRenderQueueReusable;
+    ShaderProgram* renderQueueProgram;
+    vector<RenderQueueItem> renderQueue;
+    Affine3Array renderQueueModelMatrices;
+    bool isInstancedDrawingEnabled;
+    vector<Matrix4f, Eigen::aligned_allocator<Matrix4f>> instanceMatrices;
+    TextureResource* boundTextureResource;
+
+    /*
+      The queued shapes sharing the same mesh and material but having different textures are
+      drawn by an instanced draw call if their textures can be stored in the same texture
+      array. The arrays are identified by the keys given by getTextureArrayKey.
+    */
+    bool isTextureArrayEnabled;
+    unordered_map<uint64_t, TextureArrayResourcePtr> textureArrays;
+    vector<float> instanceTextureLayers;
+    GLint maxNumTextureArrayLayers;
+
+    /*
+      The sub trees of the transform nodes only consisting of the groups, transforms and shapes
+      rendered by the functions of this class are not traversed in the scene traversal, and
+      they are collected into the render queue by the worker threads after the traversal.
+    */
+    enum NodeCollectionType {
+        UncheckedNodeClass, NonCollectableNode, CollectableGroup, CollectableSwitchableGroup,
+        CollectableLOD, CollectableTransform, CollectableShape
+    };
+    int numSubTreeCollectionThreads;
+    bool isSubTreeCollectionBeingDeferred;
+    vector<char> nodeCollectionTypes; // indexed by the class ids of the nodes
+    vector<SubTreeCollectionTask> subTreeCollectionTasks;
+    Affine3Array subTreeCollectionModelMatrices;
+    vector<unique_ptr<SubTreeCollectionBuffer>> subTreeCollectionBuffers;
+    unique_ptr<ThreadPool> subTreeCollectionThreadPool;
+    std::atomic<int> nextSubTreeCollectionTaskIndex;
+
+    /*
+      The timer queries of the passes in a frame are stored in one of the query sets used in
+      turn, and the results of a set are read when the set is reused so that the rendering
+      does not wait for the GPU. A pass may be measured by several queries in a frame because
+      the timer queries cannot be nested.
+    */
+    struct FrameProfileQuerySet
+    {
+        vector<GLuint> queries;
+        vector<int> queryPasses;
+        int numUsedQueries = 0;
+        double traversalTime = 0.0;
+        int numDrawCalls = 0;
+        int64_t numTriangles = 0;
+    };
+    static constexpr int NumFrameProfileQuerySets = 3;
+    bool isFrameProfilingEnabled;
+    bool isFrameBeingProfiled;
+    int currentProfilingPass;
+    FrameProfileQuerySet frameProfileQuerySets[NumFrameProfileQuerySets];
+    int currentFrameProfileQuerySetIndex;
+    FrameProfile frameProfile;
+    std::chrono::steady_clock::time_point traversalStartTime;
+    double traversalTime;
+    int numDrawCalls;
+    int64_t numTriangles;
     
     GLuint defaultFBO;
     GLuint depthTexture;
@@ -359,13 +980,36 @@ public:
     GLResourceMap* nextResourceMap;
     int currentResourceMapIndex;
     bool doUnusedResourceCheck;
+    bool isResourceSharingEnabled;
     bool isCheckingUnusedResources;
     bool hasValidNextResourceMap;
     bool isResourceClearRequested;
+    ScopedConnection memoryTelemetryConnection;
+
+    /*
+      The resources are only accessed in the thread that renders the scene, so the memory usage is
+      measured in the rendering thread when it is requested and the last measured usage is reported.
+    */
+    struct MemoryUsage
+    {
+        int64_t resourceMapBytes;
+        int64_t numResourceMapEntries;
+        int64_t resourceBytes;
+        int64_t numResources;
+    };
+    std::atomic<std::thread::id> renderingThreadId;
+    std::atomic<bool> isMemoryUsageRequested;
+    std::mutex memoryUsageMutex;
+    MemoryUsage lastMemoryUsage;
 
-    vector<char> scaledImageBuf;
+
+    // The face vertices from which the vertices in the vertex buffers of a mesh are taken
+    vector<int> vertexSources;
+    vector<GLuint> elementIndices;
+    unordered_map<VertexAttributeIndices, int, VertexAttributeIndicesHash> vertexIndexMap;
 
     bool isTextureEnabled;
+    bool isTextureCompressionEnabled;
     bool isTextureBeingRendered;
     bool isCurrentFogUpdated;
     SgFogPtr prevFog;
@@ -428,21 +1072,31 @@ public:
     void initializeDepthTexture();
     void clearGL(bool isGLContextActive, bool isCalledFromConstructor, bool isCalledFromDestructor);
     void clearResourceMap();
+    void reportMemoryUsage();
+    MemoryUsage measureMemoryUsage();
     bool initializeGL();
     void checkGPU();
     bool initializeGLForRendering();
     void doRender();
     void setupFullLightingRendering();
     bool doPick(int x, int y);
-    bool renderShadowMap(int lightIndex);
-    bool renderShadowMap(SgLight* light, const Isometry3& T);
+    bool renderShadowMap(int shadowMapIndex, int lightIndex);
+    bool renderShadowMap(int shadowMapIndex, SgLight* light, const Isometry3& T);
+    int renderWorldLightShadowCascades(int shadowMapIndex, double aspectRatio);
+    void renderShadowMapMain(int shadowMapIndex);
+    void renderShadowCasters();
+    void onSceneUpdated(const SgUpdate& update);
+    void invalidateStaticShadowMapCaches();
     void beginRendering();
     void renderCamera(SgCamera* camera, const Isometry3& cameraPosition);
+    void renderViewProjection(const Matrix4& projection, const Isometry3& cameraPosition);
     void renderLights(LightingProgram* program);
     void renderFog(LightingProgram* program);
     void doPureWireframeRendering();
     void doVertexRendering();
     void renderTransparentObjects();
+    void renderPickingImage(SgCamera* camera, bool doRenderWholeImage, int x, int y);
+    void invalidatePickingImage();
     void renderOverlayObjects();    
     void endRendering();
     void pushProgram(ShaderProgram* program);
@@ -454,16 +1108,50 @@ public:
     int pushPickEndNode(SgNode* node, bool doSetPickColor);
     void popPickNode();
     void renderChildNodes(SgGroup* group);
+    void renderChildNode(SgGroup* group, SgNode* node);
     void renderChildNodesWithNodeDecorationCheck(SgGroup* group);
+    void renderChildNodeWithNodeDecorationCheck(SgGroup* group, SgNode* node);
+    void renderChildNodesWithStaticNodeCheck(SgGroup* group);
+    void renderChildNodeWithStaticNodeCheck(SgGroup* group, SgNode* node, bool hasNodeDecorations);
     void renderGroup(SgGroup* group);
     void renderTransform(SgTransform* transform);
     void renderFixedPixelSizeGroup(SgFixedPixelSizeGroup* fixedPixelSizeGroup);
     void renderSwitchableGroup(SgSwitchableGroup* group);
     void renderUnpickableGroup(SgUnpickableGroup* group);
+    int selectLevelOfDetail(SgLOD* lod, const Affine3& T) const;
+    void renderLOD(SgLOD* lod);
     VertexResource* getOrCreateVertexResource(SgObject* obj);
     void drawVertexResource(VertexResource* resource, GLenum primitiveMode, const Affine3& modelTransform);
     void drawBoundingBox(VertexResource* resource, const BoundingBox& bbox);
     void renderShape(SgShape* shape);
+    void beginFrameProfiling();
+    int switchProfilingPass(int pass);
+    void endFrameProfiling();
+    void beginSceneTraversal();
+    void endSceneTraversal();
+    int checkFrustum(const BoundingBox& bbox, const Affine3& T) const;
+    bool isOutsideFrustum(const BoundingBox& bbox);
+    BoundingVolumeResource* getBoundingVolumeResource(SgTransform* transform);
+    bool isTransformOutsideFrustum(SgTransform* transform);
+    int getNodeCollectionType(SgNode* node);
+    bool isCollectableSubTree(SgGroup* group);
+    bool deferSubTreeCollection(SgTransform* transform);
+    void collectDeferredSubTrees();
+    void collectSubTrees(SubTreeCollectionBuffer& buffer);
+    bool collectSubTree(
+        SgGroup* group, const Affine3& T, const SubTreeCollectionTask& task, SubTreeCollectionBuffer& buffer);
+    bool collectNode(
+        SgNode* node, const Affine3& T, const SubTreeCollectionTask& task, SubTreeCollectionBuffer& buffer);
+    void collectShape(
+        SgShape* shape, const Affine3& T, const SubTreeCollectionTask& task, SubTreeCollectionBuffer& buffer);
+    void addShapeToRenderQueue(SgShape* shape);
+    void renderQueuedShapes();
+    void clearRenderQueue();
+    void renderShapeInstances(SgShape* shape, const RenderQueueItem* items, int n, bool hasDifferentTextures);
+    TextureArrayResource* setupTextureArray(const RenderQueueItem* items, int n);
+    int getTextureArrayLayer(SgTexture* texture, TextureArrayResource* textureArray);
+    void resetInstanceMatrixAttribute();
+    VertexResource* setupShapeRendering(SgShape* shape, int pickIndex);
     void renderShapeMain(SgShape* shape, const Affine3& modelTransform, int pickIndex);
     void applyCullingMode(SgMesh* mesh);
     void renderShapeVertices(SgShape* shape);
@@ -490,24 +1178,26 @@ public:
     bool renderTexture(SgTexture* texture);
     bool loadTextureImage(TextureResource* resource, const Image& image);
     void makeVertexBufferObjects(SgShape* shape, VertexResource* resource);
+    void indexMeshVertices(SgShape* shape, bool doMergeVertices);
+    void writeMeshElementIndices(VertexResource* resource);
     void writeMeshVertices(SgMesh* mesh, VertexResource* resource, SgTexture* texResource);
     template<typename value_type, GLenum gltype, GLboolean normalized, class VertexArrayWrapper>
-    void writeMeshVerticesSub(SgMesh* mesh, VertexResource* resource, VertexArrayWrapper& normals);
+    void writeMeshVerticesSub(const SgMesh* mesh, VertexResource* resource, VertexArrayWrapper& normals);
     void writeMeshVerticesFloat(SgMesh* mesh, VertexResource* resource);
     void writeMeshVerticesNormalizedShort(SgMesh* mesh, VertexResource* resource);
     template<typename value_type, GLenum gltype, GLint glsize, GLboolean normalized, class NormalArrayWrapper>
-    bool writeMeshNormalsSub(SgMesh* mesh, VertexResource* resource, NormalArrayWrapper& normals);
+    bool writeMeshNormalsSub(const SgMesh* mesh, VertexResource* resource, NormalArrayWrapper& normals);
     void writeMeshNormalsFloat(SgMesh* mesh, VertexResource* resource);
     void writeMeshNormalsShort(SgMesh* mesh, VertexResource* resource);
     void writeMeshNormalsByte(SgMesh* mesh, VertexResource* resource);
     void writeMeshNormalsPacked(SgMesh* mesh, VertexResource* resource);
     template<typename value_type, GLenum gltype, GLboolean normalized, class TexCoordArrayWrapper>
     void writeMeshTexCoordsSub(
-        SgMesh* mesh, SgTexture* texture, VertexResource* resource, TexCoordArrayWrapper& texCoords);
+        const SgMesh* mesh, SgTexture* texture, VertexResource* resource, TexCoordArrayWrapper& texCoords);
     void writeMeshTexCoordsFloat(SgMesh* mesh, SgTexture* texture, VertexResource* resource);
     void writeMeshTexCoordsHalfFloat(SgMesh* mesh, SgTexture* texture, VertexResource* resource);
     void writeMeshTexCoordsUnsignedShort(SgMesh* mesh, SgTexture* texture, VertexResource* resource);
-    void writeMeshColors(SgMesh* mesh, VertexResource* resource);
+    void writeMeshColors(const SgMesh* mesh, VertexResource* resource);
     void clearGLState();
     void setPointSize(float size);
     void setGlLineWidth(float width);
@@ -590,6 +1280,10 @@ bool GLSLSceneRenderer::applyNewExtensions()
         impl->newExtendFunctions.clear();
         applied = true;
     }
+    if(applied){
+        // The extensions may replace the functions for the collectable nodes
+        impl->nodeCollectionTypes.clear();
+    }
 
     return applied;
 }
@@ -602,6 +1296,12 @@ void GLSLSceneRenderer::Impl::initialize()
         renderers.insert(self);
     }
 
+    isMemoryUsageRequested = false;
+    lastMemoryUsage = MemoryUsage{ 0, 0, 0, 0 };
+    memoryTelemetryConnection =
+        MemoryTelemetry::instance()->sigSampling().connect(
+            [this](){ reportMemoryUsage(); });
+
     os_ = &nullout();
 
     normalRenderingFunctions.setFunction<SgGroup>(
@@ -614,6 +1314,8 @@ void GLSLSceneRenderer::Impl::initialize()
         [&](SgSwitchableGroup* node){ renderSwitchableGroup(node); });
     normalRenderingFunctions.setFunction<SgUnpickableGroup>(
         [&](SgUnpickableGroup* node){ renderUnpickableGroup(node); });
+    normalRenderingFunctions.setFunction<SgLOD>(
+        [&](SgLOD* node){ renderLOD(node); });
     normalRenderingFunctions.setFunction<SgShape>(
         [&](SgShape* node){ renderShape(node); });
     normalRenderingFunctions.setFunction<SgPointSet>(
@@ -645,18 +1347,56 @@ void GLSLSceneRenderer::Impl::initialize()
     isRenderingVisibleImage = false;
     isRenderingPickingImage = false;
     isPickingImageOutputEnabled = false;
+    isPickingImageCacheEnabled = true;
+    isPickingImageCached = false;
+    isSceneUpdatedAfterPicking = true;
+    PVForPickingImage.setZero();
+    sceneRootConnection =
+        self->sceneRoot()->sigUpdated().connect(
+            [&](const SgUpdate& update){ onSceneUpdated(update); });
     isShadowCastingAvailable = true;
     isWorldLightShadowEnabled = false;
     isRenderingShadowMap = false;
+    numWorldLightShadowCascades = 1;
+    worldLightShadowDistance = 50.0;
+    isStaticShadowMapCacheEnabled = true;
+    isStaticNodeCheckEnabled = false;
+    hasStaticShadowCasters = false;
+    isShadowCasterFilterEnabled = false;
+    isRenderingStaticShadowCasters = false;
+    isInsideStaticNode = false;
     isLowMemoryConsumptionMode = false;
     isBoundingBoxRenderingMode = false;
     isBoundingBoxRenderingForLightweightRenderingGroupEnabled = false;
+    isFrustumCullingEnabled = true;
+    isFrustumCullingBeingProcessed = false;
+    isCurrentNodeInsideFrustum = false;
+    isRenderQueueEnabled = true;
+    isRenderQueueBeingCollected = false;
+    isRenderQueueReusable = false;
+    renderQueueProgram = nullptr;
+    isInstancedDrawingEnabled = true;
+    boundTextureResource = nullptr;
+    isTextureArrayEnabled = true;
+    maxNumTextureArrayLayers = 0;
+    numSubTreeCollectionThreads =
+        std::min(4, std::max(0, static_cast<int>(std::thread::hardware_concurrency()) - 1));
+    isSubTreeCollectionBeingDeferred = false;
+    isFrameProfilingEnabled = false;
+    isFrameBeingProfiled = false;
+    currentProfilingPass = -1;
+    currentFrameProfileQuerySetIndex = 0;
+    frameProfile = FrameProfile();
+    traversalTime = 0.0;
+    numDrawCalls = 0;
+    numTriangles = 0;
 
     defaultFBO = 0;
     
     lightingMode = NormalLighting;
     
     doUnusedResourceCheck = true;
+    isResourceSharingEnabled = false;
 
     modelMatrixStack.reserve(16);
     viewTransform.setIdentity();
@@ -668,6 +1408,7 @@ void GLSLSceneRenderer::Impl::initialize()
     defaultLineWidth = 1.0f;
     minTransparency = 0.0f;
     isTextureEnabled = true;
+    isTextureCompressionEnabled = false;
 
     isNormalVisualizationEnabled = false;
     normalVisualizationLength = 0.0f;
@@ -705,6 +1446,8 @@ void GLSLSceneRenderer::Impl::activateVertexRenderingFunctions()
             [&](SgFixedPixelSizeGroup* node){ renderFixedPixelSizeGroup(node); });
         vertexRenderingFunctions.setFunction<SgSwitchableGroup>(
             [&](SgSwitchableGroup* node){ renderSwitchableGroup(node); });
+        vertexRenderingFunctions.setFunction<SgLOD>(
+            [&](SgLOD* node){ renderLOD(node); });
         vertexRenderingFunctions.setFunction<SgShape>(
             [&](SgShape* node){ renderShapeVertices(node); });
         vertexRenderingFunctions.setFunction<SgOverlay>(
@@ -789,9 +1532,25 @@ void GLSLSceneRenderer::Impl::clearGL(bool isGLContextActive, bool isCalledFromC
             GLResourceMap& resourceMap = resourceMaps[i];
             for(GLResourceMap::iterator p = resourceMap.begin(); p != resourceMap.end(); ++p){
                 GLResource* resource = p->second;
+                if(isResourceSharingEnabled){
+                    // The resource used by another renderer is still valid in the share group
+                    int numOwnReferences = 0;
+                    for(int j=0; j < 2; ++j){
+                        auto q = resourceMaps[j].find(p->first);
+                        if(q != resourceMaps[j].end() && q->second == resource){
+                            ++numOwnReferences;
+                        }
+                    }
+                    if(resource->numReferences() > numOwnReferences){
+                        continue;
+                    }
+                }
                 resource->discard();
             }
         }
+        for(auto& kv : textureArrays){
+            kv.second->discard();
+        }
     }
 
     if(!isCalledFromDestructor){
@@ -820,8 +1579,20 @@ void GLSLSceneRenderer::Impl::clearGL(bool isGLContextActive, bool isCalledFromC
         if(depthBufferForOverlay){
             glDeleteRenderbuffers(1, &depthBufferForOverlay);
         }
+        for(auto& querySet : frameProfileQuerySets){
+            if(!querySet.queries.empty()){
+                glDeleteQueries(querySet.queries.size(), &querySet.queries[0]);
+            }
+        }
+    }
+
+    for(auto& querySet : frameProfileQuerySets){
+        querySet = FrameProfileQuerySet();
     }
 
+    // The cache textures are released with the shader programs
+    staticShadowMapCaches.clear();
+
     if(!isCalledFromDestructor){
         currentProgram = nullptr;
         currentSolidColorProgram = nullptr;
@@ -859,6 +1630,7 @@ void GLSLSceneRenderer::Impl::clearResourceMap()
 {
     resourceMaps[0].clear();
     resourceMaps[1].clear();
+    textureArrays.clear();
     currentResourceMapIndex = 0;
     hasValidNextResourceMap = false;
     isCheckingUnusedResources = false;
@@ -868,6 +1640,61 @@ void GLSLSceneRenderer::Impl::clearResourceMap()
 }
 
 
+/**
+   The resources in the two resource maps are reported as the GPU memory, and the entries of the
+   maps are reported separately because the entries of the unused objects may be kept in the maps
+   when the unused resource check is disabled. The resources shared by the renderers are reported
+   by each renderer.
+
+   The resources of a renderer used in another thread, such as a renderer of GLVisionSimulatorItem,
+   are measured at the end of the next rendering, so the usage of the previous request is reported.
+*/
+void GLSLSceneRenderer::Impl::reportMemoryUsage()
+{
+    MemoryUsage usage;
+    if(renderingThreadId.load() == std::this_thread::get_id()){
+        usage = measureMemoryUsage();
+    } else {
+        isMemoryUsageRequested = true;
+        std::lock_guard<std::mutex> lock(memoryUsageMutex);
+        usage = lastMemoryUsage;
+    }
+
+    auto telemetry = MemoryTelemetry::instance();
+    telemetry->report("GL resource maps", usage.resourceMapBytes, usage.numResourceMapEntries);
+    telemetry->report("GL resources", usage.resourceBytes, usage.numResources);
+}
+
+
+GLSLSceneRenderer::Impl::MemoryUsage GLSLSceneRenderer::Impl::measureMemoryUsage()
+{
+    MemoryUsage usage{ 0, 0, 0, 0 };
+
+    std::unordered_set<GLResource*> resources;
+    for(int i=0; i < 2; ++i){
+        auto& resourceMap = resourceMaps[i];
+        usage.numResourceMapEntries += resourceMap.size();
+        usage.resourceMapBytes += resourceMap.bucket_count() * sizeof(void*) +
+            resourceMap.size() * (sizeof(GLResourceMap::value_type) + 2 * sizeof(void*));
+        for(auto& kv : resourceMap){
+            resources.insert(kv.second);
+        }
+    }
+    for(auto& resource : resources){
+        usage.resourceBytes += resource->memoryBytes();
+    }
+    for(auto& kv : textureArrays){
+        usage.resourceBytes += kv.second->memoryBytes();
+    }
+    usage.numResources = resources.size() + textureArrays.size();
+
+    std::lock_guard<std::mutex> lock(memoryUsageMutex);
+    lastMemoryUsage = usage;
+
+    return usage;
+}
+
+
 bool GLSLSceneRenderer::initializeGL()
 {
     return impl->initializeGL();
@@ -970,6 +1797,7 @@ bool GLSLSceneRenderer::Impl::initializeGLForRendering()
         outlineProgram->initialize();
         minimumLightingProgram->initialize();
         fullLightingProgram->setColorTextureIndex(ImageTextureIndex);
+        fullLightingProgram->setColorTextureArrayIndex(ImageTextureArrayIndex);
         fullLightingProgram->setShadowMapTextureTopIndex(ShadowMapTextureIndex);
         fullLightingProgram->initialize();
     }
@@ -982,6 +1810,7 @@ bool GLSLSceneRenderer::Impl::initializeGLForRendering()
     glEnable(GL_DEPTH_TEST);
     glDisable(GL_DITHER);
     glEnable(GL_VERTEX_PROGRAM_POINT_SIZE);
+    resetInstanceMatrixAttribute();
 
     isResourceClearRequested = true;
     isCurrentFogUpdated = false;
@@ -1057,6 +1886,7 @@ void GLSLSceneRenderer::updateViewportInformation(int x, int y, int width, int h
 
     impl->needToUpdateDepthTexture = true;
     impl->needToUpdateOverlayDepthBufferSize = true;
+    impl->invalidatePickingImage();
     impl->fullLightingProgram->setViewportSize(width, height);
     impl->solidPointProgram->setViewportSize(width, height);
     impl->thickLineProgram->setViewportSize(width, height);
@@ -1168,6 +1998,10 @@ void GLSLSceneRenderer::doRender()
 
 void GLSLSceneRenderer::Impl::doRender()
 {
+    CNOID_TRACE_ZONE("Scene rendering", "Rendering");
+
+    renderingThreadId = std::this_thread::get_id();
+
     if(isGLCleared){
         initializeGLForRendering();
     }
@@ -1181,6 +2015,10 @@ void GLSLSceneRenderer::Impl::doRender()
 
     beginRendering();
 
+    if(isFrameProfilingEnabled){
+        beginFrameProfiling();
+    }
+
     isLightweightRenderingBeingProcessed = false;
     isLowMemoryConsumptionRenderingBeingProcessed = isLowMemoryConsumptionMode;
     isTextureBeingRendered = false;
@@ -1208,12 +2046,15 @@ void GLSLSceneRenderer::Impl::doRender()
     }
 
     isRenderingVisibleImage = true;
+    switchProfilingPass(MainPass);
     const Vector3f& c = self->backgroundColor();
     glClearColor(c[0], c[1], c[2], 1.0f);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
     if(auto camera = self->currentCamera()){
 
+        CNOID_TRACE_ZONE("Main pass", "Rendering");
+
         renderCamera(camera, self->currentCameraPosition());
 
         if(currentLightingProgram){
@@ -1223,7 +2064,10 @@ void GLSLSceneRenderer::Impl::doRender()
 
         glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
 
+        beginSceneTraversal();
         renderChildNodes(self->sceneRoot());
+        endSceneTraversal();
+        renderQueuedShapes();
         
         /*
           \todo Render transparent objects directly
@@ -1238,14 +2082,23 @@ void GLSLSceneRenderer::Impl::doRender()
 
         glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
         if(!transparentRenderingQueue.empty()){
+            switchProfilingPass(TransparentPass);
             renderTransparentObjects();
         }
         if(!overlayRenderingQueue.empty()){
+            switchProfilingPass(OverlayPass);
             renderOverlayObjects();
+            // The depth buffer for the overlays is shared with the picking image
+            invalidatePickingImage();
         }
     }
     
     popProgram();
+
+    if(isFrameBeingProfiled){
+        endFrameProfiling();
+    }
+    
     endRendering();
 }
 
@@ -1262,32 +2115,50 @@ void GLSLSceneRenderer::Impl::setupFullLightingRendering()
 
         isRenderingVisibleImage = false;
         isRenderingShadowMap = true;
+        switchProfilingPass(ShadowMapPass);
 
         int w, h;
         program->getShadowMapSize(w, h);
         Array4i vp = self->viewport();
+        const double aspectRatio = self->aspectRatio();
         glViewport(0, 0, w, h);
         self->GLSceneRenderer::updateViewportInformation(0, 0, w, h);
 
         pushProgram(program->shadowMapProgram());
+        clearRenderQueue();
+
+        const int maxNumShadows = program->maxNumShadows();
+        if(static_cast<int>(staticShadowMapCaches.size()) < maxNumShadows){
+            staticShadowMapCaches.resize(maxNumShadows);
+        }
+        isStaticNodeCheckEnabled = isStaticShadowMapCacheEnabled;
 
         if(isWorldLightShadowEnabled){
-            program->activateShadowMapGenerationPass(shadowMapIndex);
-            if(renderShadowMap(self->worldLight(), self->worldLightTransform()->T())){
-                ++shadowMapIndex;
+            int numCascades = 0;
+            if(numWorldLightShadowCascades > 1){
+                numCascades = renderWorldLightShadowCascades(shadowMapIndex, aspectRatio);
+            }
+            if(numCascades > 0){
+                shadowMapIndex += numCascades;
+            } else {
+                program->activateShadowMapGenerationPass(shadowMapIndex);
+                if(renderShadowMap(shadowMapIndex, self->worldLight(), self->worldLightTransform()->T())){
+                    ++shadowMapIndex;
+                }
             }
         }
-        const int maxNumShadows = program->maxNumShadows();
         for(auto& lightIndex : shadowLightIndices){
             if(shadowMapIndex == maxNumShadows){
                 break;
             }
             program->activateShadowMapGenerationPass(shadowMapIndex);
-            if(renderShadowMap(lightIndex)){
+            if(renderShadowMap(shadowMapIndex, lightIndex)){
                 ++shadowMapIndex;
             }
         }
         
+        isStaticNodeCheckEnabled = false;
+        clearRenderQueue();
         popProgram();
         isRenderingShadowMap = false;
 
@@ -1348,11 +2219,71 @@ bool GLSLSceneRenderer::Impl::doPick(int x, int y)
 
         pickingImageWidth = width;
         pickingImageHeight = height;
+        isPickingImageCached = false;
     }
 
-    if(!isPickingImageOutputEnabled){
-        glScissor(x, y, 1, 1);
-        glEnable(GL_SCISSOR_TEST);
+    // The camera position is updated before the view is compared with the cached image
+    self->extractPreprocessedNodes();
+    auto camera = self->currentCamera();
+    if(camera){
+        renderCamera(camera, self->currentCameraPosition());
+        if(PV != PVForPickingImage){
+            invalidatePickingImage();
+            PVForPickingImage = PV;
+        }
+    }
+
+    const bool doCachePickingImage = isPickingImageCacheEnabled && !isPickingImageOutputEnabled;
+    if(!isPickingImageCached || isSceneUpdatedAfterPicking || !doCachePickingImage){
+        // The whole image is rendered when the scene has not been updated since the last picking
+        const bool doRenderWholeImage =
+            isPickingImageOutputEnabled || (doCachePickingImage && !isSceneUpdatedAfterPicking);
+        renderPickingImage(camera, doRenderWholeImage, x, y);
+        isPickingImageCached = doCachePickingImage && doRenderWholeImage;
+        isSceneUpdatedAfterPicking = false;
+    }
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, fboForPicking);
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+
+    GLfloat color[4];
+    glReadPixels(x, y, 1, 1, GL_RGBA, GL_FLOAT, color);
+    if(isPickingImageOutputEnabled){
+        color[2] = 0.0f;
+    }
+    int pickIndex = (int)(color[0] * 255) + ((int)(color[1] * 255) << 8) + ((int)(color[2] * 255) << 16) - 1;
+
+    pickedNodePath.clear();
+
+    if(pickIndex >= 0 && pickIndex < static_cast<int>(pickingNodePathList.size())){
+        GLfloat depth;
+        if(pickIndex < overlayPickIndex0){
+            glReadPixels(x, y, 1, 1, GL_DEPTH_COMPONENT, GL_FLOAT, &depth);
+        } else {
+            glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthBufferForOverlay);
+            glReadPixels(x, y, 1, 1, GL_DEPTH_COMPONENT, GL_FLOAT, &depth);
+            glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthBufferForPicking);
+        }
+        Vector3 projected;
+        if(self->unproject(x, y, depth, pickedPoint)){
+            pickedNodePath = *pickingNodePathList[pickIndex];
+        }
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, defaultFBO);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, defaultFBO);
+
+    return !pickedNodePath.empty();
+}
+
+
+void GLSLSceneRenderer::Impl::renderPickingImage(SgCamera* camera, bool doRenderWholeImage, int x, int y)
+{
+    CNOID_TRACE_ZONE("Picking pass", "Rendering");
+
+    if(!doRenderWholeImage){
+        glScissor(x, y, 1, 1);
+        glEnable(GL_SCISSOR_TEST);
     }
 
     isRenderingPickingImage = true;
@@ -1368,13 +2299,13 @@ bool GLSLSceneRenderer::Impl::doPick(int x, int y)
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
 
-    if(auto camera = self->currentCamera()){
-
-        renderCamera(camera, self->currentCameraPosition());
-        
+    if(camera){
         transparentRenderingQueue.clear();
         overlayRenderingQueue.clear();
+        beginSceneTraversal();
         renderChildNodes(self->sceneRoot());
+        endSceneTraversal();
+        renderQueuedShapes();
 
         if(!transparentRenderingQueue.empty()){
             renderTransparentObjects();
@@ -1387,43 +2318,25 @@ bool GLSLSceneRenderer::Impl::doPick(int x, int y)
     popProgram();
     isRenderingPickingImage = false;
 
-    if(!isPickingImageOutputEnabled){
+    if(!doRenderWholeImage){
         glDisable(GL_SCISSOR_TEST);
     }
 
     endRendering();
+}
 
-    glBindFramebuffer(GL_READ_FRAMEBUFFER, fboForPicking);
-    glReadBuffer(GL_COLOR_ATTACHMENT0);
-
-    GLfloat color[4];
-    glReadPixels(x, y, 1, 1, GL_RGBA, GL_FLOAT, color);
-    if(isPickingImageOutputEnabled){
-        color[2] = 0.0f;
-    }
-    int pickIndex = (int)(color[0] * 255) + ((int)(color[1] * 255) << 8) + ((int)(color[2] * 255) << 16) - 1;
-
-    pickedNodePath.clear();
 
-    if(pickIndex >= 0 && pickIndex < static_cast<int>(pickingNodePathList.size())){
-        GLfloat depth;
-        if(pickIndex < overlayPickIndex0){
-            glReadPixels(x, y, 1, 1, GL_DEPTH_COMPONENT, GL_FLOAT, &depth);
-        } else {
-            glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthBufferForOverlay);
-            glReadPixels(x, y, 1, 1, GL_DEPTH_COMPONENT, GL_FLOAT, &depth);
-            glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthBufferForPicking);
-        }
-        Vector3 projected;
-        if(self->unproject(x, y, depth, pickedPoint)){
-            pickedNodePath = *pickingNodePathList[pickIndex];
-        }
-    }
+void GLSLSceneRenderer::Impl::invalidatePickingImage()
+{
+    isSceneUpdatedAfterPicking = true;
+    isPickingImageCached = false;
+}
 
-    glBindFramebuffer(GL_FRAMEBUFFER, defaultFBO);
-    glBindFramebuffer(GL_READ_FRAMEBUFFER, defaultFBO);
 
-    return !pickedNodePath.empty();
+void GLSLSceneRenderer::setPickingImageCacheEnabled(bool on)
+{
+    impl->isPickingImageCacheEnabled = on;
+    impl->invalidatePickingImage();
 }
 
 
@@ -1454,34 +2367,27 @@ bool GLSLSceneRenderer::getPickingImage(Image& out_image)
 }
 
 
-bool GLSLSceneRenderer::Impl::renderShadowMap(int lightIndex)
+bool GLSLSceneRenderer::Impl::renderShadowMap(int shadowMapIndex, int lightIndex)
 {
     SgLight* light;
     Isometry3 T;
     self->getLightInfo(lightIndex, light, T);
 
     if(light){
-        return renderShadowMap(light, T);
+        return renderShadowMap(shadowMapIndex, light, T);
     }
     return false;
 }
 
 
-bool GLSLSceneRenderer::Impl::renderShadowMap(SgLight* light, const Isometry3& T)
+bool GLSLSceneRenderer::Impl::renderShadowMap(int shadowMapIndex, SgLight* light, const Isometry3& T)
 {
     if(light->on()){
         Isometry3 Tc = T;
         SgCamera* shadowMapCamera = fullLightingProgram->getShadowMapCamera(light, Tc);
         if(shadowMapCamera){
             renderCamera(shadowMapCamera, Tc);
-            fullLightingProgram->setShadowMapViewProjection(PV);
-            fullLightingProgram->shadowMapProgram()->initializeShadowMapBuffer();
-            renderingFunctions->dispatch(self->sceneRoot());
-
-            if(USE_GL_FLUSH_FUNCTION_IN_SHADOW_MAP_RENDERING){
-                glFlush();
-            }
-            
+            renderShadowMapMain(shadowMapIndex);
             return true;
         }
     }
@@ -1489,6 +2395,163 @@ bool GLSLSceneRenderer::Impl::renderShadowMap(SgLight* light, const Isometry3& T
 }
 
 
+/**
+   The view depth range from the near clip distance of the current perspective camera to the
+   shadow distance is split into the cascades by the practical split scheme, and each cascade
+   is rendered with the orthographic projection covering the bounding sphere of its part of
+   the view frustum. The projection is moved by the texel size of the shadow map so that the
+   shadow edges and the static shadow map caches are stable while the camera moves.
+   \return The number of the rendered cascades, or zero if the cascades are not available
+*/
+int GLSLSceneRenderer::Impl::renderWorldLightShadowCascades(int shadowMapIndex, double aspectRatio)
+{
+    auto light = dynamic_cast<SgDirectionalLight*>(self->worldLight());
+    auto camera = dynamic_cast<SgPerspectiveCamera*>(self->currentCamera());
+    if(!light || !light->on() || !camera){
+        return 0;
+    }
+    const int numCascades =
+        std::min(numWorldLightShadowCascades, fullLightingProgram->maxNumShadows() - shadowMapIndex);
+    const double nearDistance = camera->nearClipDistance();
+    const double farDistance = std::min(camera->farClipDistance(), worldLightShadowDistance);
+    if(numCascades < 2 || nearDistance <= 0.0 || farDistance <= nearDistance){
+        return 0;
+    }
+
+    Quaternion rot;
+    rot.setFromTwoVectors(-Vector3::UnitZ(), light->direction());
+    Isometry3 Tl;
+    Tl.linear() = self->worldLightTransform()->T().linear() * rot;
+    Tl.translation().setZero();
+    const Matrix3 Rt = Tl.linear().transpose();
+    const Isometry3& Tc = self->currentCameraPosition();
+    const double t = tan(camera->fovy(aspectRatio) / 2.0);
+    int width, height;
+    fullLightingProgram->getShadowMapSize(width, height);
+
+    // The shadow casters between the light and the cascades are in the bounding box of the scene
+    double sceneMaxZ = -std::numeric_limits<double>::max();
+    const BoundingBox& bbox = self->sceneRoot()->boundingBox();
+    if(!bbox.empty()){
+        for(int i=0; i < 8; ++i){
+            Vector3 p((i & 1) ? bbox.max().x() : bbox.min().x(),
+                      (i & 2) ? bbox.max().y() : bbox.min().y(),
+                      (i & 4) ? bbox.max().z() : bbox.min().z());
+            sceneMaxZ = std::max(sceneMaxZ, Rt.row(2).dot(p));
+        }
+    }
+    
+    double d0 = nearDistance;
+    for(int i=0; i < numCascades; ++i){
+        const double ratio = (i + 1.0) / numCascades;
+        const double d1 =
+            0.5 * (nearDistance * pow(farDistance / nearDistance, ratio) +
+                   nearDistance + (farDistance - nearDistance) * ratio);
+        const double m = (d0 + d1) / 2.0;
+        const double r = std::max(
+            Vector3(d0 * t * aspectRatio, d0 * t, m - d0).norm(),
+            Vector3(d1 * t * aspectRatio, d1 * t, m - d1).norm());
+
+        Vector3 c = Rt * (Tc * Vector3(0.0, 0.0, -m));
+        const double texelSize = 2.0 * r / width;
+        c.x() = floor(c.x() / texelSize) * texelSize;
+        c.y() = floor(c.y() / texelSize) * texelSize;
+        // The depth range is also quantized for the stability
+        const double step = r;
+        double zNear = -std::max(c.z() + r, sceneMaxZ);
+        double zFar = -(c.z() - r);
+        zNear = floor(zNear / step) * step;
+        zFar = ceil(zFar / step) * step;
+        
+        Matrix4 P;
+        self->getOrthographicProjectionMatrix(c.x() - r, c.x() + r, c.y() - r, c.y() + r, zNear, zFar, P);
+        fullLightingProgram->activateShadowMapGenerationPass(shadowMapIndex + i);
+        fullLightingProgram->setShadowMapDepthRange((i == 0) ? 0.0 : d0, d1, i > 0);
+        renderViewProjection(P, Tl);
+        renderShadowMapMain(shadowMapIndex + i);
+        d0 = d1;
+    }
+
+    return numCascades;
+}
+
+
+void GLSLSceneRenderer::Impl::renderShadowMapMain(int shadowMapIndex)
+{
+    CNOID_TRACE_ZONE("Shadow map pass", "Rendering");
+
+    fullLightingProgram->setShadowMapViewProjection(PV);
+    auto shadowMapProgram = fullLightingProgram->shadowMapProgram();
+    shadowMapProgram->initializeShadowMapBuffer();
+
+    if(isStaticShadowMapCacheEnabled && hasStaticShadowCasters){
+        auto& cache = staticShadowMapCaches[shadowMapIndex];
+        isShadowCasterFilterEnabled = true;
+        if(cache.isValid && cache.PV == PV){
+            shadowMapProgram->restoreShadowMapCache();
+        } else {
+            isRenderingStaticShadowCasters = true;
+            renderShadowCasters();
+            isRenderingStaticShadowCasters = false;
+            cache.isValid = shadowMapProgram->storeShadowMapCache();
+            cache.PV = PV;
+        }
+        renderShadowCasters();
+        isShadowCasterFilterEnabled = false;
+    } else {
+        if(!isRenderQueueReusable){
+            renderShadowCasters();
+        } else {
+            renderQueuedShapes();
+        }
+    }
+
+    if(USE_GL_FLUSH_FUNCTION_IN_SHADOW_MAP_RENDERING){
+        glFlush();
+    }
+}
+
+
+void GLSLSceneRenderer::Impl::renderShadowCasters()
+{
+    clearRenderQueue();
+    beginSceneTraversal();
+    renderingFunctions->dispatch(self->sceneRoot());
+    endSceneTraversal();
+    renderQueuedShapes();
+}
+
+
+void GLSLSceneRenderer::Impl::onSceneUpdated(const SgUpdate& update)
+{
+    invalidatePickingImage();
+
+    if(staticShadowMapCaches.empty()){
+        return;
+    }
+    if(update.hasAction(SgUpdate::Added | SgUpdate::Removed)){
+        // The static nodes may be added or removed
+        hasStaticShadowCasters = false;
+        invalidateStaticShadowMapCaches();
+    } else if(update.hasAction(SgUpdate::GeometryModified)){
+        for(auto& object : update.path()){
+            if(object->hasAttribute(SgObject::Static)){
+                invalidateStaticShadowMapCaches();
+                break;
+            }
+        }
+    }
+}
+
+
+void GLSLSceneRenderer::Impl::invalidateStaticShadowMapCaches()
+{
+    for(auto& cache : staticShadowMapCaches){
+        cache.isValid = false;
+    }
+}
+
+
 void GLSLSceneRenderer::Impl::renderCamera(SgCamera* camera, const Isometry3& cameraPosition)
 {
     if(SgPerspectiveCamera* pers = dynamic_cast<SgPerspectiveCamera*>(camera)){
@@ -1512,10 +2575,17 @@ void GLSLSceneRenderer::Impl::renderCamera(SgCamera* camera, const Isometry3& ca
 
     if(isUpsideDownEnabled){
         Isometry3 T = cameraPosition * AngleAxis(PI, Vector3(0.0, 0.0, 1.0));
-        viewTransform = T.inverse(Eigen::Isometry);
+        renderViewProjection(projectionMatrix, T);
     } else {
-        viewTransform = cameraPosition.inverse(Eigen::Isometry);
+        renderViewProjection(projectionMatrix, cameraPosition);
     }
+}
+
+
+void GLSLSceneRenderer::Impl::renderViewProjection(const Matrix4& projection, const Isometry3& cameraPosition)
+{
+    projectionMatrix = projection;
+    viewTransform = cameraPosition.inverse(Eigen::Isometry);
     PV = projectionMatrix * viewTransform.matrix();
 
     modelMatrixStack.clear();
@@ -1533,6 +2603,7 @@ void GLSLSceneRenderer::Impl::beginRendering()
     
     self->extractPreprocessedNodes();
 
+    boundTextureResource = nullptr;
     isCheckingUnusedResources = isRenderingPickingImage ? false : doUnusedResourceCheck;
 
     if(isResourceClearRequested){
@@ -1552,6 +2623,20 @@ void GLSLSceneRenderer::Impl::endRendering()
     if(isCheckingUnusedResources){
         currentResourceMap->clear();
         hasValidNextResourceMap = true;
+
+        // The layers of the arrays are removed when the resources of the images are released
+        auto p = textureArrays.begin();
+        while(p != textureArrays.end()){
+            if(p->second->numUsedLayers == 0){
+                p = textureArrays.erase(p);
+            } else {
+                ++p;
+            }
+        }
+    }
+
+    if(isMemoryUsageRequested.exchange(false)){
+        measureMemoryUsage();
     }
 }
 
@@ -1701,6 +2786,8 @@ void GLSLSceneRenderer::dispatchToTransparentPhase
 
 void GLSLSceneRenderer::Impl::renderTransparentObjects()
 {
+    CNOID_TRACE_ZONE("Transparent pass", "Rendering");
+
     if(!isRenderingPickingImage){
         glEnable(GL_BLEND);
         glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
@@ -1722,6 +2809,8 @@ void GLSLSceneRenderer::Impl::renderTransparentObjects()
 
 void GLSLSceneRenderer::Impl::renderOverlayObjects()
 {
+    CNOID_TRACE_ZONE("Overlay pass", "Rendering");
+
     if(needToUpdateOverlayDepthBufferSize){
         if(depthBufferForOverlay){
             // The buffer seems to have to be regenerated when the buffer size is changed
@@ -1797,6 +2886,10 @@ Matrix4 GLSLSceneRenderer::modelViewProjectionMatrix() const
 
 double GLSLSceneRenderer::projectedPixelSizeRatio(const Vector3& position) const
 {
+    if(impl->isRenderQueueBeingCollected){
+        // The nodes depending on the view cannot be reproduced by the queue in another view
+        impl->isRenderQueueReusable = false;
+    }
     auto vp = viewport();
     Vector3 p2 = impl->viewTransform * position;
     Vector4 p3(1.0, 0.0, p2.z(), 1.0);
@@ -1884,7 +2977,9 @@ void GLSLSceneRenderer::renderNode(SgNode* node)
 
 void GLSLSceneRenderer::Impl::renderChildNodes(SgGroup* group)
 {
-    if(nodeDecorationInfoArrayMap.empty()){
+    if(isStaticNodeCheckEnabled){
+        renderChildNodesWithStaticNodeCheck(group);
+    } else if(nodeDecorationInfoArrayMap.empty()){
         for(auto p = group->cbegin(); p != group->cend(); ++p){
             renderingFunctions->dispatch(*p);
         }
@@ -1894,27 +2989,79 @@ void GLSLSceneRenderer::Impl::renderChildNodes(SgGroup* group)
 }
 
 
+void GLSLSceneRenderer::Impl::renderChildNode(SgGroup* group, SgNode* node)
+{
+    if(isStaticNodeCheckEnabled){
+        renderChildNodeWithStaticNodeCheck(group, node, !nodeDecorationInfoArrayMap.empty());
+    } else if(nodeDecorationInfoArrayMap.empty()){
+        renderingFunctions->dispatch(node);
+    } else {
+        renderChildNodeWithNodeDecorationCheck(group, node);
+    }
+}
+
+
 void GLSLSceneRenderer::Impl::renderChildNodesWithNodeDecorationCheck(SgGroup* group)
 {
     for(auto p = group->cbegin(); p != group->cend(); ++p){
-        auto node = *p;
-        if(!node->isDecoratedSomewhere() ||
-           group->hasAttribute(SgNode::NodeDecorationGroup)){
+        renderChildNodeWithNodeDecorationCheck(group, *p);
+    }
+}
+
+
+void GLSLSceneRenderer::Impl::renderChildNodeWithNodeDecorationCheck(SgGroup* group, SgNode* node)
+{
+    if(!node->isDecoratedSomewhere() ||
+       group->hasAttribute(SgNode::NodeDecorationGroup)){
+        renderingFunctions->dispatch(node);
+    } else {
+        auto q = nodeDecorationInfoArrayMap.find(node);
+        if(q == nodeDecorationInfoArrayMap.end()){
             renderingFunctions->dispatch(node);
         } else {
-            auto q = nodeDecorationInfoArrayMap.find(node);
-            if(q == nodeDecorationInfoArrayMap.end()){
-                renderingFunctions->dispatch(node);
-            } else {
-                SgNodePtr node2 = node;
-                auto& nodeDecorationInfos = *q->second;
-                for(auto& info : nodeDecorationInfos){
-                    node2 = info.func(node2);
-                    node2->setAttribute(SgNode::NodeDecorationGroup);
-                }
-                renderingFunctions->dispatch(node2);
+            SgNodePtr node2 = node;
+            auto& nodeDecorationInfos = *q->second;
+            for(auto& info : nodeDecorationInfos){
+                node2 = info.func(node2);
+                node2->setAttribute(SgNode::NodeDecorationGroup);
             }
+            renderingFunctions->dispatch(node2);
+        }
+    }
+}
+
+
+/**
+   The static nodes are only found in the child nodes traversed by this function, so the
+   static shadow casters and the others are separated in the same way in every pass.
+*/
+void GLSLSceneRenderer::Impl::renderChildNodesWithStaticNodeCheck(SgGroup* group)
+{
+    const bool hasNodeDecorations = !nodeDecorationInfoArrayMap.empty();
+    for(auto p = group->cbegin(); p != group->cend(); ++p){
+        renderChildNodeWithStaticNodeCheck(group, *p, hasNodeDecorations);
+    }
+}
+
+
+void GLSLSceneRenderer::Impl::renderChildNodeWithStaticNodeCheck
+(SgGroup* group, SgNode* node, bool hasNodeDecorations)
+{
+    bool isStaticNode = !isInsideStaticNode && node->hasAttribute(SgObject::Static);
+    if(isStaticNode){
+        hasStaticShadowCasters = true;
+        if(isShadowCasterFilterEnabled && !isRenderingStaticShadowCasters){
+            return;
         }
+        isInsideStaticNode = true;
+    }
+    if(hasNodeDecorations){
+        renderChildNodeWithNodeDecorationCheck(group, node);
+    } else {
+        renderingFunctions->dispatch(node);
+    }
+    if(isStaticNode){
+        isInsideStaticNode = false;
     }
 }
 
@@ -1935,161 +3082,947 @@ void GLSLSceneRenderer::renderCustomGroup(SgGroup* group, std::function<void()>
 }
 
 
-void GLSLSceneRenderer::Impl::renderSwitchableGroup(SgSwitchableGroup* group)
-{
-    if(group->isTurnedOn()){
-        renderGroup(group);
+void GLSLSceneRenderer::Impl::renderSwitchableGroup(SgSwitchableGroup* group)
+{
+    if(group->isTurnedOn()){
+        renderGroup(group);
+    }
+}
+
+
+void GLSLSceneRenderer::Impl::renderUnpickableGroup(SgUnpickableGroup* group)
+{
+    if(!isRenderingPickingImage){
+        renderGroup(group);
+    }
+}
+
+
+/**
+   The level is selected by the distance from the current camera even in the shadow map
+   passes so that the shadows are cast by the same level as the one rendered in the view.
+   This function is also called by the worker threads collecting the sub trees.
+*/
+int GLSLSceneRenderer::Impl::selectLevelOfDetail(SgLOD* lod, const Affine3& T) const
+{
+    const double scale = self->levelOfDetailDistanceScale();
+    if(scale == 0.0){
+        return lod->empty() ? -1 : 0;
+    }
+    const Vector3 p = T * lod->center();
+    return lod->selectLevel(scale * (p - self->currentCameraPosition().translation()).norm());
+}
+
+
+void GLSLSceneRenderer::Impl::renderLOD(SgLOD* lod)
+{
+    const int level = selectLevelOfDetail(lod, modelMatrixStack.back());
+    if(level >= 0){
+        pushPickNode(lod);
+        renderChildNode(lod, lod->child(level));
+        popPickNode();
+    }
+}
+
+
+void GLSLSceneRenderer::Impl::renderTransform(SgTransform* transform)
+{
+    if(!transform->empty()){
+        Affine3 T;
+        transform->getTransform(T);
+        modelMatrixStack.push_back(modelMatrixStack.back() * T);
+
+        bool wasInsideFrustum = isCurrentNodeInsideFrustum;
+        if(!isFrustumCullingBeingProcessed || isCurrentNodeInsideFrustum ||
+           !isTransformOutsideFrustum(transform)){
+            if(!isSubTreeCollectionBeingDeferred || !deferSubTreeCollection(transform)){
+                pushPickNode(transform);
+                renderChildNodes(transform);
+                popPickNode();
+            }
+        }
+        isCurrentNodeInsideFrustum = wasInsideFrustum;
+
+        modelMatrixStack.pop_back();
+    }
+}
+
+
+void GLSLSceneRenderer::renderCustomTransform(SgTransform* transform, std::function<void()> traverseFunction)
+{
+    Affine3 T;
+    transform->getTransform(T);
+    impl->modelMatrixStack.push_back(impl->modelMatrixStack.back() * T);
+    impl->pushPickNode(transform);
+
+    traverseFunction();
+
+    impl->popPickNode();
+    impl->modelMatrixStack.pop_back();
+}
+
+
+void GLSLSceneRenderer::Impl::renderFixedPixelSizeGroup(SgFixedPixelSizeGroup* fixedPixelSizeGroup)
+{
+    double r = self->projectedPixelSizeRatio(modelMatrixStack.back().translation());
+
+    if(r > 0.0){
+        double s = fixedPixelSizeGroup->pixelSizeRatio() / r;
+        Vector3 scale(s, s, s);
+        Affine3 S(scale.asDiagonal());
+    
+        modelMatrixStack.push_back(modelMatrixStack.back() * S);
+        renderGroup(fixedPixelSizeGroup);
+        modelMatrixStack.pop_back();
+    }
+}
+    
+
+VertexResource* GLSLSceneRenderer::Impl::getOrCreateVertexResource(SgObject* obj)
+{
+    VertexResource* resource;
+    auto p = currentResourceMap->find(obj);
+    if(p == currentResourceMap->end()){
+        resource = new VertexResource(obj);
+        p = currentResourceMap->insert(GLResourceMap::value_type(obj, resource)).first;
+    } else {
+        resource = static_cast<VertexResource*>(p->second.get());
+    }
+    if(isCheckingUnusedResources){
+        nextResourceMap->insert(*p);
+    }
+    return resource;
+}
+
+
+void GLSLSceneRenderer::Impl::drawVertexResource
+(VertexResource* resource, GLenum primitiveMode, const Affine3& modelTransform)
+{
+    if(isRenderQueueBeingCollected){
+        // The shapes drawn during the traversal are not reproduced by the queue
+        isRenderQueueReusable = false;
+    }
+    currentProgram->setTransform(PV, viewTransform, modelTransform, resource->pLocalTransform);
+    glBindVertexArray(resource->vao);
+    if(resource->elementType){
+        glDrawElements(primitiveMode, resource->numVertices, resource->elementType, nullptr);
+    } else {
+        glDrawArrays(primitiveMode, 0, resource->numVertices);
+    }
+    ++numDrawCalls;
+    if(primitiveMode == GL_TRIANGLES){
+        numTriangles += resource->numVertices / 3;
+    }
+}
+
+
+void GLSLSceneRenderer::Impl::drawBoundingBox(VertexResource* resource, const BoundingBox& bbox)
+{
+    if(!resource->boundingBoxLines){
+        auto lines = new SgLineSet;
+        auto& v = *lines->getOrCreateVertices(8);
+        const Vector3f min = bbox.min().cast<float>();
+        const Vector3f max = bbox.max().cast<float>();
+        v[0] << min.x(), min.y(), min.z();
+        v[1] << min.x(), min.y(), max.z();
+        v[2] << min.x(), max.y(), min.z();
+        v[3] << min.x(), max.y(), max.z();
+        v[4] << max.x(), min.y(), min.z();
+        v[5] << max.x(), min.y(), max.z();
+        v[6] << max.x(), max.y(), min.z();
+        v[7] << max.x(), max.y(), max.z();
+        lines->addLine(0, 1);
+        lines->addLine(0, 2);
+        lines->addLine(0, 4);
+        lines->addLine(1, 3);
+        lines->addLine(1, 5);
+        lines->addLine(2, 3);
+        lines->addLine(2, 6);
+        lines->addLine(3, 7);
+        lines->addLine(4, 5);
+        lines->addLine(4, 6);
+        lines->addLine(5, 7);
+        lines->addLine(6, 7);
+        lines->getOrCreateMaterial()->setDiffuseColor(Vector3f(1.0f, 1.0f, 1.0f));
+        resource->boundingBoxLines = lines;
+    }
+
+    renderLineSet(resource->boundingBoxLines);
+}
+        
+        
+void GLSLSceneRenderer::Impl::renderShape(SgShape* shape)
+{
+    if(isShadowCasterFilterEnabled && isInsideStaticNode != isRenderingStaticShadowCasters){
+        return;
+    }
+    SgMesh* mesh = shape->mesh();
+    if(mesh && mesh->isTessellationPending() && !isOutsideFrustum(mesh->boundingBox())){
+        tessellatePendingMesh(mesh);
+    }
+    if(mesh && mesh->hasVertices() && !isOutsideFrustum(mesh->boundingBox())){
+        SgMaterial* material = shape->material();
+        bool isTransparent = false;
+        if(currentProgram->hasCapability(ShaderProgram::Transparency)){
+            if(minTransparency > 0.0f || (material && material->transparency() > 0.0)){
+                isTransparent = true;
+            }
+        }
+        if(!isTransparent){
+            if(isRenderQueueBeingCollected && currentProgram == renderQueueProgram &&
+               solidWireframeStyleStack.empty() && !isBoundingBoxRenderingMode){
+                addShapeToRenderQueue(shape);
+            } else {
+                auto pickIndex = pushPickEndNode(shape, false);
+                renderShapeMain(shape, modelMatrixStack.back(), pickIndex);
+                popPickNode();
+            }
+        } else {
+            if(!isRenderingShadowMap){
+                SgShapePtr shapePtr = shape;
+                int matrixIndex = modelMatrixBuffer.size();
+                modelMatrixBuffer.push_back(modelMatrixStack.back());
+                auto pickIndex = pushPickEndNode(shape, false);
+                transparentRenderingQueue.emplace_back(
+                    [this, shapePtr, matrixIndex, pickIndex](){
+                        renderShapeMain(shapePtr, modelMatrixBuffer[matrixIndex], pickIndex); });
+                popPickNode();
+            }
+        }
+    }
+}
+
+
+void GLSLSceneRenderer::Impl::beginFrameProfiling()
+{
+    isFrameBeingProfiled = true;
+    currentProfilingPass = -1;
+    currentFrameProfileQuerySetIndex = (currentFrameProfileQuerySetIndex + 1) % NumFrameProfileQuerySets;
+    auto& querySet = frameProfileQuerySets[currentFrameProfileQuerySetIndex];
+
+    // The results of the oldest set are discarded if the GPU has not finished them yet
+    if(querySet.numUsedQueries > 0){
+        GLuint isAvailable = GL_FALSE;
+        glGetQueryObjectuiv(querySet.queries[querySet.numUsedQueries - 1], GL_QUERY_RESULT_AVAILABLE, &isAvailable);
+        if(isAvailable){
+            for(auto& time : frameProfile.gpuTimes){
+                time = 0.0;
+            }
+            for(int i=0; i < querySet.numUsedQueries; ++i){
+                GLuint64 elapsedTime = 0;
+                glGetQueryObjectui64v(querySet.queries[i], GL_QUERY_RESULT, &elapsedTime);
+                frameProfile.gpuTimes[querySet.queryPasses[i]] += elapsedTime * 1.0e-9;
+            }
+            frameProfile.traversalTime = querySet.traversalTime;
+            frameProfile.numDrawCalls = querySet.numDrawCalls;
+            frameProfile.numTriangles = querySet.numTriangles;
+        }
+    }
+    querySet.numUsedQueries = 0;
+
+    traversalTime = 0.0;
+    numDrawCalls = 0;
+    numTriangles = 0;
+}
+
+
+/**
+   \return The pass measured before the switch, or -1 if no pass was being measured
+*/
+int GLSLSceneRenderer::Impl::switchProfilingPass(int pass)
+{
+    const int prevPass = currentProfilingPass;
+    if(isFrameBeingProfiled && pass != prevPass){
+        if(prevPass >= 0){
+            glEndQuery(GL_TIME_ELAPSED);
+        }
+        if(pass >= 0){
+            auto& querySet = frameProfileQuerySets[currentFrameProfileQuerySetIndex];
+            if(querySet.numUsedQueries == static_cast<int>(querySet.queries.size())){
+                GLuint query;
+                glGenQueries(1, &query);
+                querySet.queries.push_back(query);
+                querySet.queryPasses.push_back(pass);
+            }
+            querySet.queryPasses[querySet.numUsedQueries] = pass;
+            glBeginQuery(GL_TIME_ELAPSED, querySet.queries[querySet.numUsedQueries++]);
+        }
+        currentProfilingPass = pass;
+    }
+    return prevPass;
+}
+
+
+void GLSLSceneRenderer::Impl::endFrameProfiling()
+{
+    switchProfilingPass(-1);
+    auto& querySet = frameProfileQuerySets[currentFrameProfileQuerySetIndex];
+    querySet.traversalTime = traversalTime;
+    querySet.numDrawCalls = numDrawCalls;
+    querySet.numTriangles = numTriangles;
+    isFrameBeingProfiled = false;
+}
+
+
+void GLSLSceneRenderer::Impl::beginSceneTraversal()
+{
+    if(isFrameBeingProfiled){
+        traversalStartTime = std::chrono::steady_clock::now();
+    }
+    if(isFrustumCullingEnabled){
+        // The planes are extracted from the view projection matrix with the normals inward
+        for(int i=0; i < 3; ++i){
+            frustumPlanes[i * 2] = PV.row(3) + PV.row(i);
+            frustumPlanes[i * 2 + 1] = PV.row(3) - PV.row(i);
+        }
+        isFrustumCullingBeingProcessed = true;
+        isCurrentNodeInsideFrustum = false;
+    }
+    if(isRenderQueueEnabled){
+        isRenderQueueBeingCollected = true;
+        // The render queue separating the static shadow casters is only used in its pass
+        isRenderQueueReusable = isRenderingShadowMap && !isShadowCasterFilterEnabled;
+        renderQueueProgram = currentProgram;
+
+        // The picking needs the node paths, which are given by the traversal
+        isSubTreeCollectionBeingDeferred =
+            numSubTreeCollectionThreads > 0 && !isRenderingPickingImage && !isStaticNodeCheckEnabled &&
+            renderingFunctions == &normalRenderingFunctions && nodeDecorationInfoArrayMap.empty();
+    }
+}
+
+
+void GLSLSceneRenderer::Impl::endSceneTraversal()
+{
+    if(isSubTreeCollectionBeingDeferred){
+        isSubTreeCollectionBeingDeferred = false;
+        if(!subTreeCollectionTasks.empty()){
+            collectDeferredSubTrees();
+        }
+    }
+    
+    isFrustumCullingBeingProcessed = false;
+    
+    if(isRenderQueueBeingCollected){
+        if(isTextureArrayEnabled){
+            std::stable_sort(renderQueue.begin(), renderQueue.end(), RenderQueueItem::isInTextureArrayOrder);
+        } else {
+            std::stable_sort(renderQueue.begin(), renderQueue.end());
+        }
+        isRenderQueueBeingCollected = false;
+    }
+
+    if(isFrameBeingProfiled){
+        traversalTime +=
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - traversalStartTime).count();
+    }
+}
+
+
+/**
+   \return -1 if the box is outside the frustum, 1 if the box is inside the frustum, or 0
+   if the box intersects the boundary of the frustum
+*/
+int GLSLSceneRenderer::Impl::checkFrustum(const BoundingBox& bbox, const Affine3& T) const
+{
+    const Vector3 center = T * bbox.center();
+    const Vector3 extent = T.linear().cwiseAbs() * (bbox.size() / 2.0);
+    int result = 1;
+    for(auto& plane : frustumPlanes){
+        const Vector3 n = plane.head<3>();
+        const double d = n.dot(center) + plane[3];
+        const double r = n.cwiseAbs().dot(extent);
+        if(d + r < 0.0){
+            return -1;
+        } else if(d - r < 0.0){
+            result = 0;
+        }
+    }
+    return result;
+}
+
+
+bool GLSLSceneRenderer::Impl::isOutsideFrustum(const BoundingBox& bbox)
+{
+    if(!isFrustumCullingBeingProcessed || isCurrentNodeInsideFrustum || bbox.empty()){
+        return false;
+    }
+    if(checkFrustum(bbox, modelMatrixStack.back()) < 0){
+        // The queue without the culled nodes cannot be used in another view
+        isRenderQueueReusable = false;
+        return true;
+    }
+    return false;
+}
+
+
+/**
+   The transform node is checked with the bounds of its children in the current model
+   coordinate, which has been multiplied by the transform of the node. The children of a
+   node found inside the frustum are not checked.
+*/
+bool GLSLSceneRenderer::Impl::isTransformOutsideFrustum(SgTransform* transform)
+{
+    auto resource = getBoundingVolumeResource(transform);
+    if(!resource->isCullable || resource->bbox.empty()){
+        return false;
+    }
+    int result = checkFrustum(resource->bbox, modelMatrixStack.back());
+    if(result < 0){
+        isRenderQueueReusable = false;
+        return true;
+    }
+    isCurrentNodeInsideFrustum = (result > 0);
+    return false;
+}
+
+
+BoundingVolumeResource* GLSLSceneRenderer::Impl::getBoundingVolumeResource(SgTransform* transform)
+{
+    BoundingVolumeResource* resource;
+    auto p = currentResourceMap->find(transform);
+    bool isValid = transform->hasValidBoundingBoxCache();
+    if(p != currentResourceMap->end()){
+        resource = static_cast<BoundingVolumeResource*>(p->second.get());
+    } else {
+        resource = new BoundingVolumeResource;
+        p = currentResourceMap->insert(GLResourceMap::value_type(transform, resource)).first;
+        isValid = false;
+    }
+    if(isCheckingUnusedResources){
+        nextResourceMap->insert(*p);
+    }
+    if(!isValid){
+        resource->isCullable = isCullableTransform(transform);
+        resource->isCollectable = isCollectableSubTree(transform);
+        resource->bbox = transform->untransformedBoundingBox();
+    }
+    return resource;
+}
+
+
+int GLSLSceneRenderer::Impl::getNodeCollectionType(SgNode* node)
+{
+    const int id = node->classId();
+    if(id >= static_cast<int>(nodeCollectionTypes.size())){
+        nodeCollectionTypes.resize(id + 1, UncheckedNodeClass);
+    }
+    auto& type = nodeCollectionTypes[id];
+    if(type == UncheckedNodeClass){
+        auto& registry = SceneNodeClassRegistry::instance();
+        const int functionClassId = normalRenderingFunctions.functionClassId(id);
+        if(functionClassId < 0){
+            type = NonCollectableNode;
+        } else if(functionClassId == registry.classId<SgGroup>()){
+            type = CollectableGroup;
+        } else if(functionClassId == registry.classId<SgSwitchableGroup>()){
+            type = CollectableSwitchableGroup;
+        } else if(functionClassId == registry.classId<SgLOD>()){
+            type = CollectableLOD;
+        } else if(functionClassId == registry.classId<SgTransform>()){
+            type = CollectableTransform;
+        } else if(functionClassId == registry.classId<SgShape>()){
+            type = CollectableShape;
+        } else {
+            type = NonCollectableNode;
+        }
+    }
+    return type;
+}
+
+
+bool GLSLSceneRenderer::Impl::isCollectableSubTree(SgGroup* group)
+{
+    for(auto& node : *group){
+        switch(getNodeCollectionType(node)){
+        case CollectableGroup:
+        case CollectableSwitchableGroup:
+        case CollectableLOD:
+        case CollectableTransform:
+            if(!isCollectableSubTree(static_cast<SgGroup*>(node.get()))){
+                return false;
+            }
+            break;
+        case CollectableShape:
+            break;
+        default:
+            return false;
+        }
+    }
+    return true;
+}
+
+
+/**
+   The transform node is deferred when it is collected into the render queue in the same
+   way as the traversal. The model matrix of the node is on the top of the stack.
+*/
+bool GLSLSceneRenderer::Impl::deferSubTreeCollection(SgTransform* transform)
+{
+    if(currentProgram != renderQueueProgram || !solidWireframeStyleStack.empty() ||
+       isBoundingBoxRenderingMode){
+        return false;
+    }
+    if(!getBoundingVolumeResource(transform)->isCollectable){
+        return false;
+    }
+    SubTreeCollectionTask task;
+    task.transform = transform;
+    task.modelMatrixIndex = subTreeCollectionModelMatrices.size();
+    task.isInsideFrustum = !isFrustumCullingBeingProcessed || isCurrentNodeInsideFrustum;
+    task.minTransparency =
+        currentProgram->hasCapability(ShaderProgram::Transparency) ? minTransparency : -1.0f;
+    subTreeCollectionModelMatrices.push_back(modelMatrixStack.back());
+    subTreeCollectionTasks.push_back(task);
+    return true;
+}
+
+
+/**
+   The tasks are processed by the worker threads, each of which writes its own outputs.
+   The outputs are merged into the render queue in the GL thread.
+*/
+void GLSLSceneRenderer::Impl::collectDeferredSubTrees()
+{
+    const int numTasks = subTreeCollectionTasks.size();
+    int numThreads = 1;
+    if(numTasks >= MinNumSubTreesForParallelCollection){
+        numThreads = std::min(numSubTreeCollectionThreads, numTasks);
+    }
+    while(static_cast<int>(subTreeCollectionBuffers.size()) < numThreads){
+        subTreeCollectionBuffers.emplace_back(new SubTreeCollectionBuffer);
+    }
+    nextSubTreeCollectionTaskIndex = 0;
+    
+    if(numThreads == 1){
+        collectSubTrees(*subTreeCollectionBuffers[0]);
+    } else {
+        if(!subTreeCollectionThreadPool){
+            subTreeCollectionThreadPool.reset(new ThreadPool(numSubTreeCollectionThreads));
+        }
+        for(int i=0; i < numThreads; ++i){
+            auto buffer = subTreeCollectionBuffers[i].get();
+            subTreeCollectionThreadPool->start([this, buffer](){ collectSubTrees(*buffer); });
+        }
+        subTreeCollectionThreadPool->wait();
+    }
+
+    for(int i=0; i < numThreads; ++i){
+        auto& buffer = *subTreeCollectionBuffers[i];
+        const int matrixIndexOffset = renderQueueModelMatrices.size();
+        renderQueueModelMatrices.insert(
+            renderQueueModelMatrices.end(), buffer.modelMatrices.begin(), buffer.modelMatrices.end());
+        for(auto& item : buffer.renderQueue){
+            renderQueue.push_back(item);
+            renderQueue.back().modelMatrixIndex += matrixIndexOffset;
+        }
+        for(auto& transparentShape : buffer.transparentShapes){
+            SgShapePtr shapePtr = transparentShape.first;
+            int matrixIndex = modelMatrixBuffer.size();
+            modelMatrixBuffer.push_back(buffer.modelMatrices[transparentShape.second]);
+            transparentRenderingQueue.emplace_back(
+                [this, shapePtr, matrixIndex](){
+                    renderShapeMain(shapePtr, modelMatrixBuffer[matrixIndex], 0); });
+        }
+        if(buffer.hasCulledShapes){
+            isRenderQueueReusable = false;
+        }
+        for(auto taskIndex : buffer.failedTaskIndices){
+            auto& task = subTreeCollectionTasks[taskIndex];
+            // The sub tree is not deferred again until its bounding box cache is invalidated
+            getBoundingVolumeResource(task.transform)->isCollectable = false;
+            modelMatrixStack.push_back(subTreeCollectionModelMatrices[task.modelMatrixIndex]);
+            isCurrentNodeInsideFrustum = task.isInsideFrustum;
+            float minTransparency0 = minTransparency;
+            if(task.minTransparency > 0.0f){
+                minTransparency = task.minTransparency;
+            }
+            renderChildNodes(task.transform);
+            minTransparency = minTransparency0;
+            isCurrentNodeInsideFrustum = false;
+            modelMatrixStack.pop_back();
+        }
+        buffer.clear();
+    }
+
+    subTreeCollectionTasks.clear();
+    subTreeCollectionModelMatrices.clear();
+}
+
+
+void GLSLSceneRenderer::Impl::collectSubTrees(SubTreeCollectionBuffer& buffer)
+{
+    const int numTasks = subTreeCollectionTasks.size();
+    while(true){
+        const int index = nextSubTreeCollectionTaskIndex.fetch_add(1);
+        if(index >= numTasks){
+            break;
+        }
+        auto& task = subTreeCollectionTasks[index];
+        const size_t queueSize = buffer.renderQueue.size();
+        const size_t numMatrices = buffer.modelMatrices.size();
+        const size_t numTransparentShapes = buffer.transparentShapes.size();
+        if(!collectSubTree(
+               task.transform, subTreeCollectionModelMatrices[task.modelMatrixIndex], task, buffer)){
+            buffer.renderQueue.resize(queueSize);
+            buffer.modelMatrices.resize(numMatrices);
+            buffer.transparentShapes.resize(numTransparentShapes);
+            buffer.failedTaskIndices.push_back(index);
+        }
+    }
+}
+
+
+/**
+   This function is executed by the worker threads, so it must not modify the nodes and
+   the renderer except the buffer. The node classes not checked in the GL thread are not
+   collected because the table of the class types is not updated here.
+*/
+bool GLSLSceneRenderer::Impl::collectSubTree
+(SgGroup* group, const Affine3& T, const SubTreeCollectionTask& task, SubTreeCollectionBuffer& buffer)
+{
+    for(auto& node : *group){
+        if(!collectNode(node, T, task, buffer)){
+            return false;
+        }
+    }
+    return true;
+}
+
+
+bool GLSLSceneRenderer::Impl::collectNode
+(SgNode* node, const Affine3& T, const SubTreeCollectionTask& task, SubTreeCollectionBuffer& buffer)
+{
+    const int id = node->classId();
+    const int type = (id < static_cast<int>(nodeCollectionTypes.size())) ? nodeCollectionTypes[id] : UncheckedNodeClass;
+    switch(type){
+    case CollectableGroup:
+        return collectSubTree(static_cast<SgGroup*>(node), T, task, buffer);
+    case CollectableSwitchableGroup: {
+        auto group = static_cast<SgSwitchableGroup*>(node);
+        return !group->isTurnedOn() || collectSubTree(group, T, task, buffer);
+    }
+    case CollectableLOD: {
+        auto lod = static_cast<SgLOD*>(node);
+        const int level = selectLevelOfDetail(lod, T);
+        return (level < 0) || collectNode(lod->child(level), T, task, buffer);
+    }
+    case CollectableTransform: {
+        auto transform = static_cast<SgTransform*>(node);
+        if(!transform->empty()){
+            Affine3 T_local;
+            transform->getTransform(T_local);
+            return collectSubTree(transform, T * T_local, task, buffer);
+        }
+        return true;
+    }
+    case CollectableShape:
+        collectShape(static_cast<SgShape*>(node), T, task, buffer);
+        return true;
+    default:
+        return false;
+    }
+}
+
+
+void GLSLSceneRenderer::Impl::collectShape
+(SgShape* shape, const Affine3& T, const SubTreeCollectionTask& task, SubTreeCollectionBuffer& buffer)
+{
+    SgMesh* mesh = shape->mesh();
+    if(!mesh || (!mesh->hasVertices() && !mesh->isTessellationPending())){
+        return;
+    }
+    if(!task.isInsideFrustum){
+        auto& bbox = mesh->boundingBox();
+        if(!bbox.empty() && checkFrustum(bbox, T) < 0){
+            buffer.hasCulledShapes = true;
+            return;
+        }
+    }
+    if(mesh->isTessellationPending()){
+        tessellatePendingMesh(mesh);
+        if(!mesh->hasVertices()){
+            return;
+        }
+    }
+    bool isTransparent = false;
+    if(task.minTransparency >= 0.0f){
+        SgMaterial* material = shape->material();
+        if(task.minTransparency > 0.0f || (material && material->transparency() > 0.0)){
+            isTransparent = true;
+        }
+    }
+    if(isTransparent && isRenderingShadowMap){
+        return;
+    }
+    const int matrixIndex = buffer.modelMatrices.size();
+    buffer.modelMatrices.push_back(T);
+    if(isTransparent){
+        buffer.transparentShapes.emplace_back(shape, matrixIndex);
+    } else {
+        RenderQueueItem item;
+        item.shape = shape;
+        item.modelMatrixIndex = matrixIndex;
+        item.pickIndex = 0;
+        buffer.renderQueue.push_back(item);
+    }
+}
+
+
+void GLSLSceneRenderer::Impl::addShapeToRenderQueue(SgShape* shape)
+{
+    RenderQueueItem item;
+    item.shape = shape;
+    item.modelMatrixIndex = renderQueueModelMatrices.size();
+    item.pickIndex = pushPickEndNode(shape, false);
+    popPickNode();
+    renderQueueModelMatrices.push_back(modelMatrixStack.back());
+    renderQueue.push_back(item);
+}
+
+
+/**
+   The shapes sharing the same mesh, material and texture are drawn by an instanced draw
+   call in the main pass of the full lighting program. The shapes only sharing the same mesh
+   and material are also drawn by an instanced draw call with a texture array if their
+   textures can be stored in the same array.
+*/
+void GLSLSceneRenderer::Impl::renderQueuedShapes()
+{
+    const bool doInstancing =
+        isInstancedDrawingEnabled && isRenderingVisibleImage &&
+        renderQueueProgram == fullLightingProgram.get() && !isNormalVisualizationEnabled;
+    const bool doUseTextureArrays = doInstancing && isTextureArrayEnabled && isTextureBeingRendered;
+    
+    const int n = renderQueue.size();
+    int i = 0;
+    while(i < n){
+        auto& item = renderQueue[i];
+        int j = i + 1;
+        bool hasDifferentTextures = false;
+        if(doInstancing){
+            while(j < n && renderQueue[j].hasSameStatesAs(item)){
+                ++j;
+            }
+            if(doUseTextureArrays){
+                if(auto key = getTextureArrayKey(item.shape->texture())){
+                    while(j < n && renderQueue[j].hasSameMeshAndMaterialAs(item) &&
+                          getTextureArrayKey(renderQueue[j].shape->texture()) == key){
+                        hasDifferentTextures = true;
+                        ++j;
+                    }
+                }
+            }
+        }
+        if(j - i >= MinNumInstancesForInstancedDrawing){
+            renderShapeInstances(item.shape, &item, j - i, hasDifferentTextures);
+        } else {
+            renderShapeMain(item.shape, renderQueueModelMatrices[item.modelMatrixIndex], item.pickIndex);
+        }
+        i = j;
+    }
+
+    if(!isRenderQueueReusable){
+        clearRenderQueue();
+    }
+}
+
+
+void GLSLSceneRenderer::Impl::clearRenderQueue()
+{
+    renderQueue.clear();
+    renderQueueModelMatrices.clear();
+    isRenderQueueReusable = false;
+}
+
+
+/**
+   The model matrices of the instances are given to the instanceMatrix attribute of the shader
+   and the uniform matrices are set with the identity model matrix. The layers of the texture
+   array are given to the instanceTextureLayer attribute if the instances have different textures.
+*/
+void GLSLSceneRenderer::Impl::renderShapeInstances
+(SgShape* shape, const RenderQueueItem* items, int n, bool hasDifferentTextures)
+{
+    VertexResource* resource = setupShapeRendering(shape, 0);
+    applyCullingMode(shape->mesh());
+
+    TextureArrayResource* textureArray = nullptr;
+    if(hasDifferentTextures && !resource->pLocalTransform){
+        textureArray = setupTextureArray(items, n);
+    }
+
+    /*
+      The vertex positions normalized in the low memory consumption mode need the local transform,
+      and the textures which cannot be stored in a texture array are bound for each shape.
+    */
+    if(resource->pLocalTransform || (hasDifferentTextures && !textureArray)){
+        for(int i=0; i < n; ++i){
+            auto& T = renderQueueModelMatrices[items[i].modelMatrixIndex];
+            if(hasDifferentTextures){
+                renderShapeMain(items[i].shape, T, items[i].pickIndex);
+            } else {
+                drawVertexResource(resource, GL_TRIANGLES, T);
+            }
+        }
+        return;
+    }
+
+    instanceMatrices.resize(n);
+    for(int i=0; i < n; ++i){
+        instanceMatrices[i] = renderQueueModelMatrices[items[i].modelMatrixIndex].matrix().cast<float>();
+    }
+
+    glBindVertexArray(resource->vao);
+    if(!resource->instanceMatrixBuffer){
+        LockVertexArrayAPI lock;
+        resource->instanceMatrixBuffer = resource->newBuffer();
+        glBindBuffer(GL_ARRAY_BUFFER, resource->instanceMatrixBuffer);
+        for(GLuint i=0; i < 4; ++i){
+            glVertexAttribPointer(
+                InstanceMatrixAttributeLocation + i, 4, GL_FLOAT, GL_FALSE, sizeof(Matrix4f),
+                ((GLubyte*)NULL + (i * 4 * sizeof(float))));
+            glVertexAttribDivisor(InstanceMatrixAttributeLocation + i, 1);
+        }
+    } else {
+        glBindBuffer(GL_ARRAY_BUFFER, resource->instanceMatrixBuffer);
+    }
+    glBufferData(GL_ARRAY_BUFFER, n * sizeof(Matrix4f), instanceMatrices.data(), GL_STREAM_DRAW);
+    for(GLuint i=0; i < 4; ++i){
+        glEnableVertexAttribArray(InstanceMatrixAttributeLocation + i);
+    }
+
+    if(textureArray){
+        if(!resource->instanceTextureLayerBuffer){
+            LockVertexArrayAPI lock;
+            resource->instanceTextureLayerBuffer = resource->newBuffer();
+            glBindBuffer(GL_ARRAY_BUFFER, resource->instanceTextureLayerBuffer);
+            glVertexAttribPointer(InstanceTextureLayerAttributeLocation, 1, GL_FLOAT, GL_FALSE, 0, nullptr);
+            glVertexAttribDivisor(InstanceTextureLayerAttributeLocation, 1);
+        } else {
+            glBindBuffer(GL_ARRAY_BUFFER, resource->instanceTextureLayerBuffer);
+        }
+        glBufferData(GL_ARRAY_BUFFER, n * sizeof(float), instanceTextureLayers.data(), GL_STREAM_DRAW);
+        glEnableVertexAttribArray(InstanceTextureLayerAttributeLocation);
+        currentMaterialLightingProgram->setTextureEnabled(true);
+        currentMaterialLightingProgram->setTextureArrayEnabled(true);
+    }
+
+    currentProgram->setTransform(PV, viewTransform, Affine3::Identity(), nullptr);
+    if(resource->elementType){
+        glDrawElementsInstanced(GL_TRIANGLES, resource->numVertices, resource->elementType, nullptr, n);
+    } else {
+        glDrawArraysInstanced(GL_TRIANGLES, 0, resource->numVertices, n);
     }
-}
+    ++numDrawCalls;
+    numTriangles += static_cast<int64_t>(resource->numVertices / 3) * n;
 
+    for(GLuint i=0; i < 4; ++i){
+        glDisableVertexAttribArray(InstanceMatrixAttributeLocation + i);
+    }
+    // The current attribute value is undefined after the array of the attribute is used
+    resetInstanceMatrixAttribute();
 
-void GLSLSceneRenderer::Impl::renderUnpickableGroup(SgUnpickableGroup* group)
-{
-    if(!isRenderingPickingImage){
-        renderGroup(group);
+    if(textureArray){
+        glDisableVertexAttribArray(InstanceTextureLayerAttributeLocation);
+        currentMaterialLightingProgram->setTextureArrayEnabled(false);
     }
 }
 
 
-void GLSLSceneRenderer::Impl::renderTransform(SgTransform* transform)
+/**
+   The images of the textures of the instances are stored in the texture array and their layers
+   are set to instanceTextureLayers. Null is returned if any of the images cannot be stored.
+*/
+TextureArrayResource* GLSLSceneRenderer::Impl::setupTextureArray(const RenderQueueItem* items, int n)
 {
-    if(!transform->empty()){
-        Affine3 T;
-        transform->getTransform(T);
-        modelMatrixStack.push_back(modelMatrixStack.back() * T);
-        pushPickNode(transform);
-
-        renderChildNodes(transform);
-
-        popPickNode();
-        modelMatrixStack.pop_back();
+    auto firstTexture = items[0].shape->texture();
+    auto& textureArray = textureArrays[getTextureArrayKey(firstTexture)];
+    if(!textureArray){
+        textureArray = new TextureArrayResource(firstTexture, this);
+    }
+    if(!maxNumTextureArrayLayers){
+        glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxNumTextureArrayLayers);
     }
-}
 
+    glActiveTexture(GL_TEXTURE0 + ImageTextureArrayIndex);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, textureArray->textureId);
 
-void GLSLSceneRenderer::renderCustomTransform(SgTransform* transform, std::function<void()> traverseFunction)
-{
-    Affine3 T;
-    transform->getTransform(T);
-    impl->modelMatrixStack.push_back(impl->modelMatrixStack.back() * T);
-    impl->pushPickNode(transform);
+    instanceTextureLayers.resize(n);
+    SgTexture* prevTexture = nullptr;
+    int layer = -1;
+    for(int i=0; i < n; ++i){
+        // The same textures are adjacent in the render queue
+        auto texture = items[i].shape->texture();
+        if(texture != prevTexture){
+            layer = getTextureArrayLayer(texture, textureArray);
+            if(layer < 0){
+                return nullptr;
+            }
+            prevTexture = texture;
+        }
+        instanceTextureLayers[i] = layer;
+    }
 
-    traverseFunction();
+    if(textureArray->isMipmapUpdateNeeded){
+        glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+        textureArray->isMipmapUpdateNeeded = false;
+    }
 
-    impl->popPickNode();
-    impl->modelMatrixStack.pop_back();
+    return textureArray;
 }
 
 
-void GLSLSceneRenderer::Impl::renderFixedPixelSizeGroup(SgFixedPixelSizeGroup* fixedPixelSizeGroup)
-{
-    double r = self->projectedPixelSizeRatio(modelMatrixStack.back().translation());
-
-    if(r > 0.0){
-        double s = fixedPixelSizeGroup->pixelSizeRatio() / r;
-        Vector3 scale(s, s, s);
-        Affine3 S(scale.asDiagonal());
-    
-        modelMatrixStack.push_back(modelMatrixStack.back() * S);
-        renderGroup(fixedPixelSizeGroup);
-        modelMatrixStack.pop_back();
-    }
-}
-    
-
-VertexResource* GLSLSceneRenderer::Impl::getOrCreateVertexResource(SgObject* obj)
+int GLSLSceneRenderer::Impl::getTextureArrayLayer(SgTexture* texture, TextureArrayResource* textureArray)
 {
-    VertexResource* resource;
-    auto p = currentResourceMap->find(obj);
+    SgImage* sgImage = texture->image();
+    auto p = currentResourceMap->find(sgImage);
     if(p == currentResourceMap->end()){
-        resource = new VertexResource(obj);
-        p = currentResourceMap->insert(GLResourceMap::value_type(obj, resource)).first;
-    } else {
-        resource = static_cast<VertexResource*>(p->second.get());
-    }
-    if(isCheckingUnusedResources){
+        // The resource of the image is created with its own texture for the other rendering
+        renderTexture(texture);
+        glActiveTexture(GL_TEXTURE0 + ImageTextureArrayIndex);
+        p = currentResourceMap->find(sgImage);
+    } else if(isCheckingUnusedResources){
         nextResourceMap->insert(*p);
     }
-    return resource;
-}
+    auto resource = static_cast<TextureResource*>(p->second.get());
 
+    if(resource->textureArray.get() != textureArray){
+        // The image stored in an array of another renderer sharing the texture resource is not moved
+        if(resource->textureArray && resource->textureArray->owner != textureArray->owner){
+            return -1;
+        }
+        resource->removeTextureArrayLayer();
+        int layer = textureArray->addLayer(sgImage, maxNumTextureArrayLayers);
+        if(layer < 0){
+            return -1;
+        }
+        resource->textureArray = textureArray;
+        resource->textureArrayLayer = layer;
+    } else if(resource->isTextureArrayLayerUpdateNeeded){
+        textureArray->setUnpackAlignment();
+        textureArray->writeLayer(resource->textureArrayLayer);
+    }
+    resource->isTextureArrayLayerUpdateNeeded = false;
 
-void GLSLSceneRenderer::Impl::drawVertexResource
-(VertexResource* resource, GLenum primitiveMode, const Affine3& modelTransform)
-{
-    currentProgram->setTransform(PV, viewTransform, modelTransform, resource->pLocalTransform);
-    glBindVertexArray(resource->vao);
-    glDrawArrays(primitiveMode, 0, resource->numVertices);
+    return resource->textureArrayLayer;
 }
 
 
-void GLSLSceneRenderer::Impl::drawBoundingBox(VertexResource* resource, const BoundingBox& bbox)
-{
-    if(!resource->boundingBoxLines){
-        auto lines = new SgLineSet;
-        auto& v = *lines->getOrCreateVertices(8);
-        const Vector3f min = bbox.min().cast<float>();
-        const Vector3f max = bbox.max().cast<float>();
-        v[0] << min.x(), min.y(), min.z();
-        v[1] << min.x(), min.y(), max.z();
-        v[2] << min.x(), max.y(), min.z();
-        v[3] << min.x(), max.y(), max.z();
-        v[4] << max.x(), min.y(), min.z();
-        v[5] << max.x(), min.y(), max.z();
-        v[6] << max.x(), max.y(), min.z();
-        v[7] << max.x(), max.y(), max.z();
-        lines->addLine(0, 1);
-        lines->addLine(0, 2);
-        lines->addLine(0, 4);
-        lines->addLine(1, 3);
-        lines->addLine(1, 5);
-        lines->addLine(2, 3);
-        lines->addLine(2, 6);
-        lines->addLine(3, 7);
-        lines->addLine(4, 5);
-        lines->addLine(4, 6);
-        lines->addLine(5, 7);
-        lines->addLine(6, 7);
-        lines->getOrCreateMaterial()->setDiffuseColor(Vector3f(1.0f, 1.0f, 1.0f));
-        resource->boundingBoxLines = lines;
-    }
-
-    renderLineSet(resource->boundingBoxLines);
-}
-        
-        
-void GLSLSceneRenderer::Impl::renderShape(SgShape* shape)
+/**
+   The shapes drawn without the instanced drawing use the identity matrix given as the
+   current value of the instanceMatrix attribute.
+*/
+void GLSLSceneRenderer::Impl::resetInstanceMatrixAttribute()
 {
-    SgMesh* mesh = shape->mesh();
-    if(mesh && mesh->hasVertices()){
-        SgMaterial* material = shape->material();
-        bool isTransparent = false;
-        if(currentProgram->hasCapability(ShaderProgram::Transparency)){
-            if(minTransparency > 0.0f || (material && material->transparency() > 0.0)){
-                isTransparent = true;
-            }
-        }
-        if(!isTransparent){
-            auto pickIndex = pushPickEndNode(shape, false);
-            renderShapeMain(shape, modelMatrixStack.back(), pickIndex);
-            popPickNode();
-        } else {
-            if(!isRenderingShadowMap){
-                SgShapePtr shapePtr = shape;
-                int matrixIndex = modelMatrixBuffer.size();
-                modelMatrixBuffer.push_back(modelMatrixStack.back());
-                auto pickIndex = pushPickEndNode(shape, false);
-                transparentRenderingQueue.emplace_back(
-                    [this, shapePtr, matrixIndex, pickIndex](){
-                        renderShapeMain(shapePtr, modelMatrixBuffer[matrixIndex], pickIndex); });
-                popPickNode();
-            }
-        }
-    }
+    glVertexAttrib4f(InstanceMatrixAttributeLocation,     1.0f, 0.0f, 0.0f, 0.0f);
+    glVertexAttrib4f(InstanceMatrixAttributeLocation + 1, 0.0f, 1.0f, 0.0f, 0.0f);
+    glVertexAttrib4f(InstanceMatrixAttributeLocation + 2, 0.0f, 0.0f, 1.0f, 0.0f);
+    glVertexAttrib4f(InstanceMatrixAttributeLocation + 3, 0.0f, 0.0f, 0.0f, 1.0f);
 }
 
 
-void GLSLSceneRenderer::Impl::renderShapeMain(SgShape* shape, const Affine3& modelTransform, int pickIndex)
+VertexResource* GLSLSceneRenderer::Impl::setupShapeRendering(SgShape* shape, int pickIndex)
 {
     auto mesh = shape->mesh();
     
@@ -2116,6 +4049,15 @@ void GLSLSceneRenderer::Impl::renderShapeMain(SgShape* shape, const Affine3& mod
     if(!resource->isValid()){
         makeVertexBufferObjects(shape, resource);
     }
+    return resource;
+}
+
+
+void GLSLSceneRenderer::Impl::renderShapeMain(SgShape* shape, const Affine3& modelTransform, int pickIndex)
+{
+    auto mesh = shape->mesh();
+    VertexResource* resource = setupShapeRendering(shape, pickIndex);
+
     if(isBoundingBoxRenderingMode){
         drawBoundingBox(resource, mesh->boundingBox());
     } else {
@@ -2185,20 +4127,34 @@ bool GLSLSceneRenderer::Impl::renderTexture(SgTexture* texture)
     }
 
     auto p = currentResourceMap->find(sgImage);
-    TextureResource* resource;
+    TextureResource* resource = nullptr;
     if(p != currentResourceMap->end()){
         resource = static_cast<TextureResource*>(p->second.get());
+    } else if(isResourceSharingEnabled){
+        resource = TextureResource::findSharedResource(sgImage);
+        if(resource){
+            currentResourceMap->insert(GLResourceMap::value_type(sgImage, resource));
+        }
+    }
+    if(resource){
         if(resource->isLoaded){
-            glActiveTexture(GL_TEXTURE0 + ImageTextureIndex);
-            glBindTexture(GL_TEXTURE_2D, resource->textureId);
-            glBindSampler(ImageTextureIndex, resource->samplerId);
-            if(resource->isImageUpdateNeeded){
-                loadTextureImage(resource, sgImage->constImage());
+            // The texture bound for the previous shape is used as it is
+            if(resource != boundTextureResource || resource->isImageUpdateNeeded){
+                glActiveTexture(GL_TEXTURE0 + ImageTextureIndex);
+                glBindTexture(GL_TEXTURE_2D, resource->textureId);
+                glBindSampler(ImageTextureIndex, resource->samplerId);
+                if(resource->isImageUpdateNeeded){
+                    loadTextureImage(resource, sgImage->constImage());
+                }
+                boundTextureResource = resource;
             }
         }
     } else {
         resource = new TextureResource(sgImage);
         currentResourceMap->insert(GLResourceMap::value_type(sgImage, resource));
+        if(isResourceSharingEnabled){
+            resource->registerAsSharedResource(sgImage);
+        }
 
         GLuint samplerId;
         glActiveTexture(GL_TEXTURE0 + ImageTextureIndex);
@@ -2214,6 +4170,7 @@ bool GLSLSceneRenderer::Impl::renderTexture(SgTexture* texture)
             glSamplerParameteri(samplerId, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
             resource->samplerId = samplerId;
         }
+        boundTextureResource = resource;
     }
 
     if(isCheckingUnusedResources){
@@ -2247,24 +4204,24 @@ bool GLSLSceneRenderer::Impl::loadTextureImage(TextureResource* resource, const
     const int width = image.width();
     const int height = image.height();
 
-    if(resource->isLoaded && resource->isSameSizeAs(image)){
+    // The image updated after it is loaded is not compressed because it may be updated frequently
+    if(resource->isLoaded && resource->isSameSizeAs(image) && !resource->isCompressed){
         glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, format, GL_UNSIGNED_BYTE, image.pixels());
 
     } else {
-        double w2 = log2(width);
-        double h2 = log2(height);
-        double pw = ceil(w2);
-        double ph = ceil(h2);
-        if((pw - w2 == 0.0) && (ph - h2 == 0.0)){
-            glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, image.pixels());
-        } else{
-            GLsizei potWidth = pow(2.0, pw);
-            GLsizei potHeight = pow(2.0, ph);
-            scaledImageBuf.resize(potWidth * potHeight * image.numComponents());
-            gluScaleImage(format, width, height, GL_UNSIGNED_BYTE, image.pixels(),
-                          potWidth, potHeight, GL_UNSIGNED_BYTE, &scaledImageBuf.front());
-            glTexImage2D(GL_TEXTURE_2D, 0, format, potWidth, potHeight, 0, format, GL_UNSIGNED_BYTE, &scaledImageBuf.front());
+        // The images of any sizes are uploaded as they are and the mipmaps are generated by GPU
+        GLenum internalFormat = format;
+        resource->isCompressed = false;
+        if((isTextureCompressionEnabled || isLowMemoryConsumptionMode) && !resource->isLoaded){
+            switch(format){
+            case GL_RED:  internalFormat = GL_COMPRESSED_RED;  break;
+            case GL_RG:   internalFormat = GL_COMPRESSED_RG;   break;
+            case GL_RGB:  internalFormat = GL_COMPRESSED_RGB;  break;
+            case GL_RGBA: internalFormat = GL_COMPRESSED_RGBA; break;
+            }
+            resource->isCompressed = true;
         }
+        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, GL_UNSIGNED_BYTE, image.pixels());
         resource->isLoaded = true;
         resource->width = width;
         resource->height = height;
@@ -2281,6 +4238,9 @@ void GLSLSceneRenderer::Impl::makeVertexBufferObjects(SgShape* shape, VertexReso
 {
     auto mesh = shape->mesh();
 
+    // Merging the vertices costs more than it saves for the mesh updated repeatedly
+    indexMeshVertices(shape, !resource->isDynamic());
+
     if(isLowMemoryConsumptionRenderingBeingProcessed){
         writeMeshVerticesNormalizedShort(mesh, resource);
     } else {
@@ -2308,28 +4268,102 @@ void GLSLSceneRenderer::Impl::makeVertexBufferObjects(SgShape* shape, VertexReso
     if(mesh->hasColors()){
         writeMeshColors(mesh, resource);
     }
+
+    writeMeshElementIndices(resource);
+}
+
+
+/**
+   The face vertices with the same position, normal, texture coordinate and color are merged
+   into a vertex so that the vertex buffers store each shared vertex only once. The vertices
+   are not merged in the flat shading, where each triangle has its own normal.
+*/
+void GLSLSceneRenderer::Impl::indexMeshVertices(SgShape* shape, bool doMergeVertices)
+{
+    // The mesh is read through the const pointer not to make its shared data unique
+    const SgMesh* mesh = shape->mesh();
+    const auto& triangleVertices = mesh->triangleVertices();
+    const int numFaceVertices = triangleVertices.size();
+
+    vertexSources.clear();
+    elementIndices.clear();
+
+    if(!defaultSmoothShading || !doMergeVertices){
+        vertexSources.resize(numFaceVertices);
+        for(int i=0; i < numFaceVertices; ++i){
+            vertexSources[i] = i;
+        }
+        return;
+    }
+
+    const bool hasNormals = mesh->normals() != nullptr;
+    const auto& normalIndices = mesh->normalIndices();
+    auto texture = shape->texture();
+    const bool hasTexCoords = texture && mesh->hasTexCoords() && isTextureBeingRendered;
+    const auto& texCoordIndices = mesh->texCoordIndices();
+    const bool hasColors = mesh->hasColors();
+    const auto& colorIndices = mesh->colorIndices();
+
+    vertexIndexMap.clear();
+    elementIndices.reserve(numFaceVertices);
+
+    for(int i=0; i < numFaceVertices; ++i){
+        VertexAttributeIndices indices;
+        indices.vertex = triangleVertices[i];
+        indices.normal = !hasNormals ? -1 : (normalIndices.empty() ? indices.vertex : normalIndices[i]);
+        indices.texCoord = !hasTexCoords ? -1 : (texCoordIndices.empty() ? indices.vertex : texCoordIndices[i]);
+        indices.color = !hasColors ? -1 : (colorIndices.empty() ? indices.vertex : colorIndices[i]);
+        auto inserted = vertexIndexMap.emplace(indices, vertexSources.size());
+        if(inserted.second){
+            vertexSources.push_back(i);
+        }
+        elementIndices.push_back(inserted.first->second);
+    }
+
+    if(static_cast<int>(vertexSources.size()) == numFaceVertices){
+        // The element indices are not necessary if no vertex is shared
+        elementIndices.clear();
+    }
+}
+
+
+void GLSLSceneRenderer::Impl::writeMeshElementIndices(VertexResource* resource)
+{
+    if(elementIndices.empty()){
+        resource->elementType = 0;
+        resource->numVertices = vertexSources.size();
+        return;
+    }
+    
+    {
+        LockVertexArrayAPI lock;
+        glBindVertexArray(resource->vao);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, resource->newBuffer());
+    }
+    if(vertexSources.size() <= 65536){
+        vector<GLushort> indices(elementIndices.begin(), elementIndices.end());
+        resource->writeBuffer(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLushort), indices.data());
+        resource->elementType = GL_UNSIGNED_SHORT;
+    } else {
+        resource->writeBuffer(
+            GL_ELEMENT_ARRAY_BUFFER, elementIndices.size() * sizeof(GLuint), elementIndices.data());
+        resource->elementType = GL_UNSIGNED_INT;
+    }
+    resource->numVertices = elementIndices.size();
 }
 
 
 template<typename value_type, GLenum gltype, GLboolean normalized, class VertexArrayWrapper>
 void GLSLSceneRenderer::Impl::writeMeshVerticesSub
-(SgMesh* mesh, VertexResource* resource, VertexArrayWrapper& vertices)
+(const SgMesh* mesh, VertexResource* resource, VertexArrayWrapper& vertices)
 {
     const auto& orgVertices = *mesh->vertices();
-    auto& triangleVertices = mesh->triangleVertices();
-    const int totalNumVertices = triangleVertices.size();
-    const int numTriangles = mesh->numTriangles();
-    resource->numVertices = totalNumVertices;
+    const auto& triangleVertices = mesh->triangleVertices();
 
-    int faceVertexIndex = 0;
-    
-    vertices.array.reserve(totalNumVertices);
+    vertices.array.reserve(vertexSources.size());
     
-    for(int i=0; i < numTriangles; ++i){
-        for(int j=0; j < 3; ++j){
-            const int orgVertexIndex = triangleVertices[faceVertexIndex++];
-            vertices.append(orgVertices[orgVertexIndex]);
-        }
+    for(auto& faceVertexIndex : vertexSources){
+        vertices.append(orgVertices[triangleVertices[faceVertexIndex]]);
     }
 
     {
@@ -2339,7 +4373,7 @@ void GLSLSceneRenderer::Impl::writeMeshVerticesSub
         glVertexAttribPointer((GLuint)0, 3, gltype, normalized, 0, ((GLubyte*)NULL + (0)));
     }
     auto size = vertices.array.size() * sizeof(value_type);
-    glBufferData(GL_ARRAY_BUFFER, size, vertices.array.data(), GL_STATIC_DRAW);
+    resource->writeBuffer(GL_ARRAY_BUFFER, size, vertices.array.data());
     glEnableVertexAttribArray(0);
 }
 
@@ -2403,47 +4437,43 @@ void GLSLSceneRenderer::Impl::writeMeshVerticesNormalizedShort(SgMesh* mesh, Ver
 
 template<typename value_type, GLenum gltype, GLint glsize, GLboolean normalized, class NormalArrayWrapper>
 bool GLSLSceneRenderer::Impl::writeMeshNormalsSub
-(SgMesh* mesh, VertexResource* resource, NormalArrayWrapper& normals)
+(const SgMesh* mesh, VertexResource* resource, NormalArrayWrapper& normals)
 {
     bool ready = false;
     
-    auto& triangleVertices = mesh->triangleVertices();
-    const int totalNumVertices = triangleVertices.size();
-    const int numTriangles = mesh->numTriangles();
+    const auto& triangleVertices = mesh->triangleVertices();
+    const int numVertices = vertexSources.size();
     
-    normals.array.reserve(totalNumVertices);
+    normals.array.reserve(numVertices);
 
     if(!defaultSmoothShading){
         // flat shading
         const auto& orgVertices = *mesh->vertices();
-        for(int i=0; i < numTriangles; ++i){
-            SgMesh::TriangleRef triangle = mesh->triangle(i);
-            const Vector3f e1 = orgVertices[triangle[1]] - orgVertices[triangle[0]];
-            const Vector3f e2 = orgVertices[triangle[2]] - orgVertices[triangle[0]];
-            const Vector3f normal = e1.cross(e2).normalized();
-            for(int j=0; j < 3; ++j){
-                normals.append(normal);
+        int prevTriangleIndex = -1;
+        Vector3f normal;
+        for(auto& faceVertexIndex : vertexSources){
+            const int triangleIndex = faceVertexIndex / 3;
+            if(triangleIndex != prevTriangleIndex){
+                auto triangle = mesh->triangle(triangleIndex);
+                const Vector3f e1 = orgVertices[triangle[1]] - orgVertices[triangle[0]];
+                const Vector3f e2 = orgVertices[triangle[2]] - orgVertices[triangle[0]];
+                normal = e1.cross(e2).normalized();
+                prevTriangleIndex = triangleIndex;
             }
+            normals.append(normal);
         }
         ready = true;
 
     } else if(mesh->normals()){
         const auto& orgNormals = *mesh->normals();
         const auto& normalIndices = mesh->normalIndices();
-        int faceVertexIndex = 0;
         if(normalIndices.empty()){
-            for(int i=0; i < numTriangles; ++i){
-                for(int j=0; j < 3; ++j){
-                    const int orgVertexIndex = triangleVertices[faceVertexIndex++];
-                    normals.append(orgNormals[orgVertexIndex]);
-                }
+            for(auto& faceVertexIndex : vertexSources){
+                normals.append(orgNormals[triangleVertices[faceVertexIndex]]);
             }
         } else {
-            for(int i=0; i < numTriangles; ++i){
-                for(int j=0; j < 3; ++j){
-                    const int normalIndex = normalIndices[faceVertexIndex++];
-                    normals.append(orgNormals[normalIndex]);
-                }
+            for(auto& faceVertexIndex : vertexSources){
+                normals.append(orgNormals[normalIndices[faceVertexIndex]]);
             }
         }
         ready = true;
@@ -2455,7 +4485,7 @@ bool GLSLSceneRenderer::Impl::writeMeshNormalsSub
             glBindBuffer(GL_ARRAY_BUFFER, resource->newBuffer());
             glVertexAttribPointer((GLuint)1, glsize, gltype, normalized, 0, ((GLubyte*)NULL + (0)));
         }
-        glBufferData(GL_ARRAY_BUFFER, normals.array.size() * sizeof(value_type), normals.array.data(), GL_STATIC_DRAW);
+        resource->writeBuffer(GL_ARRAY_BUFFER, normals.array.size() * sizeof(value_type), normals.array.data());
         glEnableVertexAttribArray(1);
     }
     
@@ -2463,16 +4493,11 @@ bool GLSLSceneRenderer::Impl::writeMeshNormalsSub
         auto lines = new SgLineSet;
         auto lineVertices = lines->getOrCreateVertices();
         const auto& orgVertices = *mesh->vertices();
-        int vertexIndex = 0;
-        for(int i=0; i < numTriangles; ++i){
-            for(int j=0; j < 3; ++j){
-                const int orgVertexIndex = triangleVertices[vertexIndex];
-                auto& v = orgVertices[orgVertexIndex];
-                lineVertices->push_back(v);
-                lineVertices->push_back(v + normals.get(vertexIndex) * normalVisualizationLength);
-                lines->addLine(vertexIndex * 2, vertexIndex * 2 + 1);
-                ++vertexIndex;
-            }
+        for(int i=0; i < numVertices; ++i){
+            auto& v = orgVertices[triangleVertices[vertexSources[i]]];
+            lineVertices->push_back(v);
+            lineVertices->push_back(v + normals.get(i) * normalVisualizationLength);
+            lines->addLine(i * 2, i * 2 + 1);
         }
         lines->setMaterial(normalVisualizationMaterial);
         resource->normalVisualization = lines;
@@ -2570,11 +4595,11 @@ void GLSLSceneRenderer::Impl::writeMeshNormalsPacked(SgMesh* mesh, VertexResourc
 
 template<typename value_type, GLenum gltype, GLboolean normalized, class TexCoordArrayWrapper>
 void GLSLSceneRenderer::Impl::writeMeshTexCoordsSub
-(SgMesh* mesh, SgTexture* texture, VertexResource* resource, TexCoordArrayWrapper& texCoords)
+(const SgMesh* mesh, SgTexture* texture, VertexResource* resource, TexCoordArrayWrapper& texCoords)
 {
-    auto& triangleVertices = mesh->triangleVertices();
-    const int totalNumVertices = triangleVertices.size();
-    SgTexCoordArrayPtr pOrgTexCoords;
+    const auto& triangleVertices = mesh->triangleVertices();
+    const SgTexCoordArray* pOrgTexCoords;
+    SgTexCoordArrayPtr transformedTexCoords;
     const auto& texCoordIndices = mesh->texCoordIndices();
 
     auto tt = texture->textureTransform();
@@ -2591,29 +4616,22 @@ void GLSLSceneRenderer::Impl::writeMeshTexCoordsSub
 
         const auto& orgTexCoords = *mesh->texCoords();
         const size_t n = orgTexCoords.size();
-        pOrgTexCoords = new SgTexCoordArray(n);
+        transformedTexCoords = new SgTexCoordArray(n);
         for(size_t i=0; i < n; ++i){
-            (*pOrgTexCoords)[i] = M * orgTexCoords[i];
+            (*transformedTexCoords)[i] = M * orgTexCoords[i];
         }
+        pOrgTexCoords = transformedTexCoords;
     }
 
-    texCoords.array.reserve(totalNumVertices);
-    const int numTriangles = mesh->numTriangles();
-    int faceVertexIndex = 0;
+    texCoords.array.reserve(vertexSources.size());
     
     if(texCoordIndices.empty()){
-        for(int i=0; i < numTriangles; ++i){
-            for(int j=0; j < 3; ++j){
-                const int orgVertexIndex = triangleVertices[faceVertexIndex++];
-                texCoords.append((*pOrgTexCoords)[orgVertexIndex]);
-            }
+        for(auto& faceVertexIndex : vertexSources){
+            texCoords.append((*pOrgTexCoords)[triangleVertices[faceVertexIndex]]);
         }
     } else {
-        for(int i=0; i < numTriangles; ++i){
-            for(int j=0; j < 3; ++j){
-                const int texCoordIndex = texCoordIndices[faceVertexIndex++];
-                texCoords.append((*pOrgTexCoords)[texCoordIndex]);
-            }
+        for(auto& faceVertexIndex : vertexSources){
+            texCoords.append((*pOrgTexCoords)[texCoordIndices[faceVertexIndex]]);
         }
     }
     {
@@ -2622,7 +4640,7 @@ void GLSLSceneRenderer::Impl::writeMeshTexCoordsSub
         glVertexAttribPointer((GLuint)2, 2, gltype, normalized, 0, 0);
     }
     auto size = texCoords.array.size() * sizeof(value_type);
-    glBufferData(GL_ARRAY_BUFFER, size, texCoords.array.data(), GL_STATIC_DRAW);
+    resource->writeBuffer(GL_ARRAY_BUFFER, size, texCoords.array.data());
     glEnableVertexAttribArray(2);
 }
 
@@ -2703,35 +4721,25 @@ void GLSLSceneRenderer::Impl::writeMeshTexCoordsUnsignedShort
 }
 
 
-void GLSLSceneRenderer::Impl::writeMeshColors(SgMesh* mesh, VertexResource* resource)
+void GLSLSceneRenderer::Impl::writeMeshColors(const SgMesh* mesh, VertexResource* resource)
 {
-    auto& triangleVertices = mesh->triangleVertices();
-    const int totalNumVertices = triangleVertices.size();
+    const auto& triangleVertices = mesh->triangleVertices();
     const auto& orgColors = *mesh->colors();
     const auto& colorIndices = mesh->colorIndices();
 
     typedef Eigen::Array<GLubyte,3,1> Color;
     vector<Color> colors;
-    colors.reserve(totalNumVertices);
+    colors.reserve(vertexSources.size());
     
-    const int numTriangles = mesh->numTriangles();
-    int faceVertexIndex = 0;
-
     if(colorIndices.empty()){
-        for(int i=0; i < numTriangles; ++i){
-            for(int j=0; j < 3; ++j){
-                const int orgVertexIndex = triangleVertices[faceVertexIndex++];
-                Vector3f c = 255.0f * orgColors[orgVertexIndex];
-                colors.emplace_back(c[0], c[1], c[2]);
-            }
+        for(auto& faceVertexIndex : vertexSources){
+            Vector3f c = 255.0f * orgColors[triangleVertices[faceVertexIndex]];
+            colors.emplace_back(c[0], c[1], c[2]);
         }
     } else {
-        for(int i=0; i < numTriangles; ++i){
-            for(int j=0; j < 3; ++j){
-                const int colorIndex = colorIndices[faceVertexIndex++];
-                Vector3f c = 255.0f * orgColors[colorIndex];
-                colors.emplace_back(c[0], c[1], c[2]);
-            }
+        for(auto& faceVertexIndex : vertexSources){
+            Vector3f c = 255.0f * orgColors[colorIndices[faceVertexIndex]];
+            colors.emplace_back(c[0], c[1], c[2]);
         }
     }
 
@@ -2740,7 +4748,7 @@ void GLSLSceneRenderer::Impl::writeMeshColors(SgMesh* mesh, VertexResource* reso
         glBindBuffer(GL_ARRAY_BUFFER, resource->newBuffer());
         glVertexAttribPointer((GLuint)3, 3, GL_UNSIGNED_BYTE, GL_TRUE, 0, ((GLubyte*)NULL + (0)));
     }
-    glBufferData(GL_ARRAY_BUFFER, colors.size() * sizeof(Color), colors.data(), GL_STATIC_DRAW);
+    resource->writeBuffer(GL_ARRAY_BUFFER, colors.size() * sizeof(Color), colors.data());
     glEnableVertexAttribArray(3);
 }
     
@@ -2758,7 +4766,8 @@ void GLSLSceneRenderer::Impl::renderShapeVertices(SgShape* shape)
                 glBindBuffer(GL_ARRAY_BUFFER, resource->newBuffer());
                 glVertexAttribPointer((GLuint)0, 3, GL_FLOAT, GL_FALSE, 0, ((GLubyte *)NULL + (0)));
             }
-            glBufferData(GL_ARRAY_BUFFER, vertices->size() * sizeof(Vector3f), vertices->data(), GL_STATIC_DRAW);
+            const SgVertexArray* constVertices = vertices;
+            resource->writeBuffer(GL_ARRAY_BUFFER, vertices->size() * sizeof(Vector3f), constVertices->data());
             glEnableVertexAttribArray(0);
             resource->numVertices = vertices->size();
         }
@@ -2783,17 +4792,19 @@ void GLSLSceneRenderer::Impl::renderPlot
             glBindBuffer(GL_ARRAY_BUFFER, resource->newBuffer());
             glVertexAttribPointer((GLuint)0, 3, GL_FLOAT, GL_FALSE, 0, ((GLubyte *)NULL + (0)));
         }
-        glBufferData(GL_ARRAY_BUFFER, vertices->size() * sizeof(Vector3f), vertices->data(), GL_STATIC_DRAW);
+        const SgVertexArray* constVertices = vertices;
+        resource->writeBuffer(GL_ARRAY_BUFFER, vertices->size() * sizeof(Vector3f), constVertices->data());
         glEnableVertexAttribArray(0);
 
         if(plot->hasColors()){
             typedef Eigen::Array<GLubyte,3,1> Color;
             vector<Color> colors;
             colors.reserve(n);
-            const SgColorArray& orgColors = *plot->colors();
-            const SgIndexArray& colorIndices = plot->colorIndices();
+            const SgPlot* constPlot = plot;
+            const SgColorArray& orgColors = *constPlot->colors();
+            const SgIndexArray& colorIndices = constPlot->colorIndices();
             size_t i = 0;
-            if(plot->colorIndices().empty()){
+            if(colorIndices.empty()){
                 const size_t m = std::min(n, orgColors.size());
                 while(i < m){
                     Vector3f c = 255.0f * orgColors[i];
@@ -2821,7 +4832,7 @@ void GLSLSceneRenderer::Impl::renderPlot
                 glBindBuffer(GL_ARRAY_BUFFER, resource->newBuffer());
                 glVertexAttribPointer((GLuint)3, 3, GL_UNSIGNED_BYTE, GL_TRUE, 0, ((GLubyte*)NULL +(0)));
             }
-            glBufferData(GL_ARRAY_BUFFER, n * sizeof(Color), colors.data(), GL_STATIC_DRAW);
+            resource->writeBuffer(GL_ARRAY_BUFFER, n * sizeof(Color), colors.data());
             glEnableVertexAttribArray(3);
         }
     }        
@@ -3095,6 +5106,7 @@ void GLSLSceneRenderer::Impl::renderOutline(SgOutline* outline)
 
 void GLSLSceneRenderer::Impl::renderOutlineEdge(SgOutline* outline, const Affine3& T)
 {
+    const int pass = switchProfilingPass(OutlinePass);
     modelMatrixStack.push_back(T);
 
     glClearStencil(0);
@@ -3126,6 +5138,7 @@ void GLSLSceneRenderer::Impl::renderOutlineEdge(SgOutline* outline, const Affine
     glEnable(GL_DEPTH_TEST);
 
     modelMatrixStack.pop_back();
+    switchProfilingPass(pass);
 }
 
 
@@ -3250,6 +5263,13 @@ bool GLSLSceneRenderer::isShadowCastingAvailable() const
 }
 
 
+bool GLSLSceneRenderer::isShadowCastingEnabled() const
+{
+    return impl->isShadowCastingAvailable && impl->lightingMode == NormalLighting &&
+        (impl->isWorldLightShadowEnabled || !impl->shadowLightIndices.empty());
+}
+
+
 void GLSLSceneRenderer::setWorldLightShadowEnabled(bool on)
 {
     impl->isWorldLightShadowEnabled = on;
@@ -3284,6 +5304,23 @@ void GLSLSceneRenderer::setShadowAntiAliasingEnabled(bool on)
 }
 
 
+void GLSLSceneRenderer::setWorldLightShadowCascades(int numCascades, double shadowDistance)
+{
+    impl->numWorldLightShadowCascades = std::max(1, numCascades);
+    impl->worldLightShadowDistance = shadowDistance;
+}
+
+
+void GLSLSceneRenderer::setStaticShadowMapCacheEnabled(bool on)
+{
+    if(on != impl->isStaticShadowMapCacheEnabled){
+        impl->isStaticShadowMapCacheEnabled = on;
+        impl->hasStaticShadowCasters = false;
+        impl->invalidateStaticShadowMapCaches();
+    }
+}
+
+
 void GLSLSceneRenderer::Impl::setPointSize(float size)
 {
     if(!stateFlag[POINT_SIZE] || pointSize != size){
@@ -3418,6 +5455,15 @@ void GLSLSceneRenderer::setBoundingBoxRenderingForLightweightRenderingGroupEnabl
 }
 
 
+void GLSLSceneRenderer::setResourceSharingEnabled(bool on)
+{
+    if(impl->isResourceSharingEnabled != on){
+        impl->isResourceSharingEnabled = on;
+        requestToClearResources();
+    }
+}
+
+
 void GLSLSceneRenderer::setLowMemoryConsumptionMode(bool on)
 {
     if(impl->isLowMemoryConsumptionMode != on){
@@ -3425,3 +5471,72 @@ void GLSLSceneRenderer::setLowMemoryConsumptionMode(bool on)
         requestToClearResources();
     }
 }
+
+
+void GLSLSceneRenderer::setTextureCompressionEnabled(bool on)
+{
+    if(impl->isTextureCompressionEnabled != on){
+        impl->isTextureCompressionEnabled = on;
+        requestToClearResources();
+    }
+}
+
+
+void GLSLSceneRenderer::setFrustumCullingEnabled(bool on)
+{
+    impl->isFrustumCullingEnabled = on;
+}
+
+
+void GLSLSceneRenderer::setRenderQueueEnabled(bool on)
+{
+    impl->isRenderQueueEnabled = on;
+}
+
+
+void GLSLSceneRenderer::setInstancedDrawingEnabled(bool on)
+{
+    impl->isInstancedDrawingEnabled = on;
+}
+
+
+void GLSLSceneRenderer::setTextureArrayEnabled(bool on)
+{
+    impl->isTextureArrayEnabled = on;
+}
+
+
+void GLSLSceneRenderer::setFrameProfilingEnabled(bool on)
+{
+    if(on != impl->isFrameProfilingEnabled){
+        impl->isFrameProfilingEnabled = on;
+        impl->frameProfile = FrameProfile();
+        for(auto& querySet : impl->frameProfileQuerySets){
+            querySet.numUsedQueries = 0;
+        }
+    }
+}
+
+
+bool GLSLSceneRenderer::isFrameProfilingEnabled() const
+{
+    return impl->isFrameProfilingEnabled;
+}
+
+
+const GLSLSceneRenderer::FrameProfile& GLSLSceneRenderer::frameProfile() const
+{
+    return impl->frameProfile;
+}
+
+
+void GLSLSceneRenderer::setNumSubTreeCollectionThreads(int n)
+{
+    if(n < 0){
+        n = 0;
+    }
+    if(n != impl->numSubTreeCollectionThreads){
+        impl->numSubTreeCollectionThreads = n;
+        impl->subTreeCollectionThreadPool.reset();
+    }
+}
@@ -7,6 +7,7 @@
 #define CNOID_BASE_GLSL_SCENE_RENDERER_H
 
 #include <cnoid/GLSceneRenderer>
+#include <cstdint>
 #include "exportdecl.h"
 
 namespace cnoid {
@@ -68,10 +69,25 @@ class CNOID_EXPORT GLSLSceneRenderer : public GLSceneRenderer
     virtual LightingMode lightingMode() const override;
 
     virtual bool isShadowCastingAvailable() const override;
+    virtual bool isShadowCastingEnabled() const override;
     virtual void setWorldLightShadowEnabled(bool on = true) override;
     virtual void setAdditionalLightShadowEnabled(int index, bool on = true) override;
     virtual void clearAdditionalLightShadows() override;
     virtual void setShadowAntiAliasingEnabled(bool on) override;
+
+    /**
+       The shadow of the world light is rendered into the given number of the shadow maps split
+       by the view depth up to the shadow distance if the world light is a directional light and
+       the current camera is a perspective camera. The number of the cascades is one by default.
+    */
+    void setWorldLightShadowCascades(int numCascades, double shadowDistance = 50.0);
+
+    /**
+       The depth of the shadow casters under the nodes with the Static attribute is cached and
+       only the other casters are rendered into each shadow map every frame if this is enabled,
+       which is the default.
+    */
+    void setStaticShadowMapCacheEnabled(bool on);
     
     virtual void setDefaultSmoothShading(bool on) override;
     virtual SgMaterial* defaultMaterial() override;
@@ -89,11 +105,86 @@ class CNOID_EXPORT GLSLSceneRenderer : public GLSceneRenderer
     virtual int backFaceCullingMode() const override;
     virtual void setBoundingBoxRenderingForLightweightRenderingGroupEnabled(bool on) override;
 
+    /**
+       The texture resources are shared with the other renderers with this option enabled if
+       this is enabled. The GL contexts of the renderers must be in the same share group.
+    */
+    void setResourceSharingEnabled(bool on);
+
     void setLowMemoryConsumptionMode(bool on);
 
+    /**
+       The textures are stored in the compressed formats chosen by the driver if this is
+       enabled or the low memory consumption mode is enabled. The images updated after they
+       are loaded are stored without the compression.
+    */
+    void setTextureCompressionEnabled(bool on);
+
+    /**
+       The shapes and the transform nodes whose bounding boxes are outside the view frustum
+       are not rendered if this is enabled, which is the default.
+    */
+    void setFrustumCullingEnabled(bool on);
+
+    /**
+       The opaque shapes are collected in a queue during the scene traversal and rendered in
+       the order sorted by their textures, materials and meshes if this is enabled, which is
+       the default.
+    */
+    void setRenderQueueEnabled(bool on);
+
+    /**
+       The queued shapes sharing the same mesh, material and texture are drawn by an instanced
+       draw call in the normal lighting mode if this is enabled, which is the default.
+    */
+    void setInstancedDrawingEnabled(bool on);
+
+    /**
+       The queued shapes sharing the same mesh and material but having different textures are
+       also drawn by an instanced draw call if this is enabled, which is the default. The images
+       of the same size and format are stored in the layers of a texture array for the draw call.
+    */
+    void setTextureArrayEnabled(bool on);
+
+    /**
+       The sub trees of the transform nodes only consisting of the groups, transforms and
+       shapes are collected into the render queue by this number of worker threads after the
+       scene traversal. Zero disables the worker threads.
+    */
+    void setNumSubTreeCollectionThreads(int n);
+
+    /**
+       The picking image of the whole viewport is kept and reused for the picks at the other
+       pixels until the scene or the view is updated if this is enabled, which is the default.
+    */
+    void setPickingImageCacheEnabled(bool on);
+
     virtual void setPickingImageOutputEnabled(bool on) override;
     virtual bool getPickingImage(Image& out_image) override;
 
+    enum ProfilingPass {
+        ShadowMapPass, MainPass, TransparentPass, OverlayPass, OutlinePass, NumProfilingPasses
+    };
+
+    struct FrameProfile {
+        //! The CPU time [s] of the scene traversals in the frame including the shadow map passes
+        double traversalTime;
+        //! The GPU time [s] of each pass given by the timer queries
+        double gpuTimes[NumProfilingPasses];
+        int numDrawCalls;
+        int64_t numTriangles;
+    };
+
+    /**
+       The GPU time of the passes, the CPU time of the scene traversals and the numbers of the
+       draw calls and the triangles are measured for each rendered frame if this is enabled.
+       The results of the timer queries are read without waiting for the GPU, so the profile
+       is the one of a frame a few frames before the last rendered frame.
+    */
+    void setFrameProfilingEnabled(bool on);
+    bool isFrameProfilingEnabled() const;
+    const FrameProfile& frameProfile() const;
+
     class Impl;
 
 protected:
@@ -10,6 +10,7 @@
 #include <cnoid/SceneDrawables>
 #include <cnoid/SceneCameras>
 #include <cnoid/NullOut>
+#include <algorithm>
 
 using namespace std;
 using namespace cnoid;
@@ -34,6 +35,7 @@ public:
     float aspectRatio; // width / height;
     Vector3f backgroundColor;
     Vector3f defaultColor;
+    double levelOfDetailDistanceScale;
     ostream* os_;
     ostream& os(){ return *os_; };
 
@@ -91,6 +93,7 @@ GLSceneRenderer::Impl::Impl(GLSceneRenderer* self, SgGroup* sceneRoot)
     aspectRatio = 1.0f;
     backgroundColor << 0.1f, 0.1f, 0.3f; // dark blue
     defaultColor << 1.0f, 1.0f, 1.0f;
+    levelOfDetailDistanceScale = 1.0;
 
     os_ = &nullout();
 }
@@ -162,6 +165,18 @@ void GLSceneRenderer::setDefaultColor(const Vector3f& color)
 }
 
 
+void GLSceneRenderer::setLevelOfDetailDistanceScale(double scale)
+{
+    impl->levelOfDetailDistanceScale = std::max(0.0, scale);
+}
+
+
+double GLSceneRenderer::levelOfDetailDistanceScale() const
+{
+    return impl->levelOfDetailDistanceScale;
+}
+
+
 void GLSceneRenderer::updateViewportInformation(int x, int y, int width, int height)
 {
     auto& vp = impl->viewport;
@@ -201,6 +216,12 @@ bool GLSceneRenderer::isShadowCastingAvailable() const
 }
 
 
+bool GLSceneRenderer::isShadowCastingEnabled() const
+{
+    return false;
+}
+
+
 void GLSceneRenderer::setWorldLightShadowEnabled(bool /* on */)
 {
 
@@ -71,6 +71,13 @@ public:
     const Vector3f& defaultColor() const;
     virtual void setDefaultColor(const Vector3f& color);
 
+    /**
+       The distance from the viewpoint to a SgLOD node is multiplied by this scale to select
+       the level of detail. The most detailed level is always selected when the scale is zero.
+    */
+    void setLevelOfDetailDistanceScale(double scale);
+    double levelOfDetailDistanceScale() const;
+
     enum LightingMode {
         NormalLighting,
         MinimumLighting,
@@ -82,6 +89,8 @@ public:
     virtual LightingMode lightingMode() const = 0;
 
     virtual bool isShadowCastingAvailable() const;
+    //! Returns true if the shadows are cast with the current settings
+    virtual bool isShadowCastingEnabled() const;
     virtual void setWorldLightShadowEnabled(bool on = true);
     virtual void setAdditionalLightShadowEnabled(int index, bool on = true);
     virtual void clearAdditionalLightShadows();
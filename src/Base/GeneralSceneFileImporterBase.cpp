@@ -70,7 +70,7 @@ GeneralSceneFileImporterBase::GeneralSceneFileImporterBase(int api)
 
 
 GeneralSceneFileImporterBase::GeneralSceneFileImporterBase()
-    : GeneralSceneFileImporterBase(Load | Options | OptionPanelForLoading)
+    : GeneralSceneFileImporterBase(Load | Options | OptionPanelForLoading | Prefetch)
 {
 
 }
@@ -116,22 +116,35 @@ SgNode* GeneralSceneFileImporterBase::loadScene(const std::string& filename)
 }
 
 
-SgNode* GeneralSceneFileImporterBase::Impl::loadScene(GeneralSceneFileImporterBase* self, const std::string& filename)
+ReferencedPtr GeneralSceneFileImporterBase::prefetch(const std::string& filename, std::ostream& os)
 {
-    if(!sceneLoader){
-        sceneLoader.reset(new SceneLoader);
-        sceneLoader->setMessageSink(self->os());
-    }
-
+    // The shared scene loader cannot be used in the worker thread
+    SceneLoader sceneLoader;
+    sceneLoader.setMessageSink(os);
     bool isSupported;
-    SgNode* scene = sceneLoader->load(filename, isSupported);
+    return sceneLoader.load(filename, isSupported);
+}
+
+
+SgNode* GeneralSceneFileImporterBase::Impl::loadScene(GeneralSceneFileImporterBase* self, const std::string& filename)
+{
+    SgNodePtr scene = dynamic_pointer_cast<SgNode>(self->takePrefetchedData(filename));
 
     if(!scene){
-        if(!isSupported){
-            auto fname = toUTF8(stdx::filesystem::path(fromUTF8(filename)).filename().string());
-            self->putError(format(_("The file format of \"{}\" is not supported.\n"), fname));
+        if(!sceneLoader){
+            sceneLoader.reset(new SceneLoader);
+            sceneLoader->setMessageSink(self->os());
+        }
+        bool isSupported;
+        scene = sceneLoader->load(filename, isSupported);
+
+        if(!scene){
+            if(!isSupported){
+                auto fname = toUTF8(stdx::filesystem::path(fromUTF8(filename)).filename().string());
+                self->putError(format(_("The file format of \"{}\" is not supported.\n"), fname));
+            }
+            return nullptr;
         }
-        return nullptr;
     }
 
     SgNodePtr topNode = scene;
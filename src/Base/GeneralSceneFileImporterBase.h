@@ -21,6 +21,12 @@ protected:
     //! This function has not been implemented yet
     bool saveScene(SgNode* scene, const std::string& filename);
     
+    /**
+       The scene is read without applying the import hints in the worker thread, and the
+       loadScene function takes it.
+    */
+    virtual ReferencedPtr prefetch(const std::string& filename, std::ostream& os) override;
+    
     virtual void resetOptions() override;
     virtual void storeOptions(Mapping* archive) override;
     virtual bool restoreOptions(const Mapping* archive) override;
@@ -37,6 +37,9 @@ const bool TRACE_FUNCTIONS = false;
         
 const size_t MAX_NUM_HISTORIES = 10;
 
+// The number of frames in a block of the lowest level of the min / max pyramid
+const int MIN_MAX_BASE_BLOCK_SIZE = 8;
+
 struct EditHistory
 {
     EditHistory() { frame = 0; }
@@ -66,6 +69,19 @@ public:
     */
     vector<double> values;
     int numFrames; // the actual number of frames (values.size() - 2)
+
+    /**
+       The minimum and maximum values of the frame blocks. The block size of level k is
+       MIN_MAX_BASE_BLOCK_SIZE * 2^k frames. The pyramid is used to draw the frames mapped
+       into a pixel without scanning all of them, and it is only updated for the modified
+       frames so that the values appended by a simulation can be drawn quickly.
+    */
+    vector<vector<double>> minValueLevels;
+    vector<vector<double>> maxValueLevels;
+    int numMinMaxFrames;
+
+    // The first frame of the values updated by GraphDataHandler::update
+    int updatedFrameBegin;
         
     int prevNumValues;
     double offset;
@@ -87,6 +103,9 @@ public:
 
     GraphDataHandler::DataRequestCallback dataRequestCallback;
     GraphDataHandler::DataModifiedCallback dataModifiedCallback;
+
+    void updateMinMaxPyramid(int frameBegin, int frameEnd);
+    void findMinMax(int frameBegin, int frameEnd, double& out_min, int& out_minFrame, double& out_max, int& out_maxFrame) const;
 };
 
 class GraphWidgetImpl
@@ -263,6 +282,10 @@ GraphDataHandlerImpl::GraphDataHandlerImpl()
 
     isControlPointUpdateNeeded = true;
 
+    numFrames = 0;
+    numMinMaxFrames = 0;
+    updatedFrameBegin = 0;
+
     currentHistory = 0;
 }
 
@@ -330,11 +353,24 @@ void GraphDataHandler::clearLines()
 
         
 void GraphDataHandler::update()
+{
+    update(0);
+}
+
+
+/**
+   This function only requests the values from the specified frame. The values of the previous
+   frames must not be changed since the last update. This is useful for updating the graph of the
+   frames appended to the data.
+*/
+void GraphDataHandler::update(int frameBegin)
 {
     if(TRACE_FUNCTIONS){
-        cout << "GraphDataHandler::update()" << endl;
+        cout << "GraphDataHandler::update(" << frameBegin << ")" << endl;
     }
+    impl->updatedFrameBegin = frameBegin;
     impl->sigDataUpdated();
+    impl->updatedFrameBegin = 0;
 }
 
 
@@ -534,12 +570,127 @@ void GraphWidgetImpl::updateData(GraphDataHandlerPtr handler)
     
     if(data->dataRequestCallback){
         vector<double>& values = data->values;
-        data->dataRequestCallback(0, data->numFrames, &(values[1]));
+        const int frameBegin = std::max(0, std::min(data->updatedFrameBegin, data->numFrames));
+        if(frameBegin < data->numFrames){
+            data->dataRequestCallback(frameBegin, data->numFrames - frameBegin, &(values[1 + frameBegin]));
+        }
+        // The last block of each level may include the frames that were removed
+        data->updateMinMaxPyramid(std::min(frameBegin, data->numMinMaxFrames), data->numFrames);
     }
     screen->update();
 }
 
 
+void GraphDataHandlerImpl::updateMinMaxPyramid(int frameBegin, int frameEnd)
+{
+    const double* frameValues = &values[1];
+    int numBlocks = (numFrames + MIN_MAX_BASE_BLOCK_SIZE - 1) / MIN_MAX_BASE_BLOCK_SIZE;
+    int blockBegin = frameBegin / MIN_MAX_BASE_BLOCK_SIZE;
+    int blockEnd = (frameEnd + MIN_MAX_BASE_BLOCK_SIZE - 1) / MIN_MAX_BASE_BLOCK_SIZE;
+    int level = 0;
+
+    while(numBlocks > 1){
+        if(level == static_cast<int>(minValueLevels.size())){
+            minValueLevels.emplace_back();
+            maxValueLevels.emplace_back();
+        }
+        auto& mins = minValueLevels[level];
+        auto& maxs = maxValueLevels[level];
+        mins.resize(numBlocks);
+        maxs.resize(numBlocks);
+        blockEnd = std::min(blockEnd, numBlocks);
+
+        for(int i = blockBegin; i < blockEnd; ++i){
+            double vmin, vmax;
+            if(level == 0){
+                int frame = i * MIN_MAX_BASE_BLOCK_SIZE;
+                const int end = std::min(frame + MIN_MAX_BASE_BLOCK_SIZE, numFrames);
+                vmin = vmax = frameValues[frame++];
+                while(frame < end){
+                    const double v = frameValues[frame++];
+                    if(v < vmin){
+                        vmin = v;
+                    } else if(v > vmax){
+                        vmax = v;
+                    }
+                }
+            } else {
+                auto& lowerMins = minValueLevels[level - 1];
+                auto& lowerMaxs = maxValueLevels[level - 1];
+                const int j = i * 2;
+                vmin = lowerMins[j];
+                vmax = lowerMaxs[j];
+                if(j + 1 < static_cast<int>(lowerMins.size())){
+                    vmin = std::min(vmin, lowerMins[j + 1]);
+                    vmax = std::max(vmax, lowerMaxs[j + 1]);
+                }
+            }
+            mins[i] = vmin;
+            maxs[i] = vmax;
+        }
+
+        blockBegin /= 2;
+        blockEnd = (blockEnd + 1) / 2;
+        numBlocks = (numBlocks + 1) / 2;
+        ++level;
+    }
+
+    minValueLevels.resize(level);
+    maxValueLevels.resize(level);
+    numMinMaxFrames = numFrames;
+}
+
+
+/**
+   The frames of the minimum and maximum values are approximated by the center frames of the
+   blocks containing them when the blocks are used.
+*/
+void GraphDataHandlerImpl::findMinMax
+(int frameBegin, int frameEnd, double& out_min, int& out_minFrame, double& out_max, int& out_maxFrame) const
+{
+    const double* frameValues = &values[1];
+    const int numLevels = minValueLevels.size();
+    
+    out_min = out_max = frameValues[frameBegin];
+    out_minFrame = out_maxFrame = frameBegin;
+
+    int frame = frameBegin;
+    while(frame < frameEnd){
+        // Find the largest block starting from the frame within the range
+        int level = -1;
+        int blockSize = MIN_MAX_BASE_BLOCK_SIZE;
+        while(level + 1 < numLevels && frame % blockSize == 0 && frame + blockSize <= frameEnd){
+            ++level;
+            blockSize *= 2;
+        }
+        if(level < 0){
+            const double v = frameValues[frame];
+            if(v < out_min){
+                out_min = v;
+                out_minFrame = frame;
+            } else if(v > out_max){
+                out_max = v;
+                out_maxFrame = frame;
+            }
+            ++frame;
+        } else {
+            blockSize /= 2;
+            const int index = frame / blockSize;
+            const int center = frame + blockSize / 2;
+            if(minValueLevels[level][index] < out_min){
+                out_min = minValueLevels[level][index];
+                out_minFrame = center;
+            }
+            if(maxValueLevels[level][index] > out_max){
+                out_max = maxValueLevels[level][index];
+                out_maxFrame = center;
+            }
+            frame += blockSize;
+        }
+    }
+}
+
+
 void GraphWidget::setRenderingTypes
 (bool showOriginalValues, bool showVelocities, bool showAccelerations)
 {
@@ -1402,6 +1553,7 @@ void GraphWidgetImpl::doTrajectoryEdit(int screenX, int screenY, Qt::KeyboardMod
     if(editMode == GraphWidget::LINE_MODE){
         EditHistoryPtr& history = editTarget->editHistories.back();
         std::copy(history->orgValues.begin(), history->orgValues.end(), &values[history->frame]);
+        editTarget->updateMinMaxPyramid(history->frame, history->frame + history->orgValues.size());
     }
 
     if(frameBegin < frameEnd){
@@ -1442,6 +1594,8 @@ void GraphWidgetImpl::doTrajectoryEdit(int screenX, int screenY, Qt::KeyboardMod
             }
         }
 
+        editTarget->updateMinMaxPyramid(frameBegin, frameEnd);
+
         editedFrameBegin = std::min(editedFrameBegin, frameBegin);
         editedFrameEnd = std::max(editedFrameEnd, frameEnd);
 
@@ -1502,6 +1656,7 @@ void GraphWidgetImpl::undoTrajectoryEdit()
             EditHistoryPtr history = editTarget->editHistories[currentHistory];
             std::copy(history->orgValues.begin(), history->orgValues.end(),
                       editTarget->values.begin() + history->frame + 1);
+            editTarget->updateMinMaxPyramid(history->frame, history->frame + history->orgValues.size());
             editTarget->dataModifiedCallback(history->frame, history->orgValues.size(), &history->orgValues[0]);
             screen->update();
         }
@@ -1518,6 +1673,7 @@ void GraphWidgetImpl::redoTrajectoryEdit()
             EditHistoryPtr history = editTarget->editHistories[currentHistory];
             std::copy(history->newValues.begin(), history->newValues.end(),
                       editTarget->values.begin() + history->frame + 1);
+            editTarget->updateMinMaxPyramid(history->frame, history->frame + history->newValues.size());
             editTarget->dataModifiedCallback(history->frame, history->newValues.size(), &history->newValues[0]);
             currentHistory++;
             screen->update();
@@ -1759,21 +1915,13 @@ void GraphWidgetImpl::drawTrajectory
                 const int n = ceil(double(frame_end - frame) / m);
                 polyline.resize(n * 2);
                 for(int i=0; i < n; ++i){
-                    double px_min = screenOffsetX + (frame - frame_begin) * xratio;
-                    double px_max = px_min;
                     const int next = std::min(frame + m, frame_end);
-                    double min = values[frame++];
-                    double max = min;
-                    while(frame < next){
-                        const double v = values[frame++];
-                        if(v > max){
-                            max = v;
-                            px_max = screenOffsetX + (frame - frame_begin) * xratio;
-                        } else if(v < min){
-                            min = v;
-                            px_min = screenOffsetX + (frame - frame_begin) * xratio;
-                        }
-                    }
+                    double min, max;
+                    int minFrame, maxFrame;
+                    data->findMinMax(frame, next, min, minFrame, max, maxFrame);
+                    frame = next;
+                    const double px_min = screenOffsetX + (minFrame - frame_begin) * xratio;
+                    const double px_max = screenOffsetX + (maxFrame - frame_begin) * xratio;
                     const double upper = screenCenterY - (max + centerY) * scaleY;
                     const double lower = screenCenterY - (min + centerY) * scaleY;
                     if(px_min <= px_max){
@@ -46,6 +46,7 @@ public:
     void clearLines();
         
     void update();
+    void update(int frameBegin);
 
     typedef std::function<void(int frame, int size, double* out_values)> DataRequestCallback;
     void setDataRequestCallback(DataRequestCallback callback);
@@ -16,6 +16,7 @@
 #include "EditRecord.h"
 #include <cnoid/ValueTree>
 #include <cnoid/UTF8>
+#include <cnoid/Tracer>
 #include <cnoid/stdx/filesystem>
 #include <fmt/format.h>
 #include <typeinfo>
@@ -47,6 +48,7 @@ vector<Item*> tmpItemArray;
 
 int recursiveTreeChangeCounter = 0;
 bool isAnyItemInSubTreesBeingAddedOrRemovedSelected = false;
+RootItem* rootItemToRequestSigSelectedItemsChanged = nullptr;
 
 std::map<ItemPtr, ItemPtr> replacementToOriginalItemMap;
 std::map<ItemPtr, ItemPtr> originalToReplacementItemMap;
@@ -119,6 +121,9 @@ public:
     Item* findItem(
         ItemPath::iterator iter, ItemPath::iterator end,  const std::function<bool(Item* item)>& pred,
         bool isRecursive) const;
+    bool findItemWithNameIndex(
+        RootItem* rootItem, ItemPath::iterator begin, ItemPath::iterator end,
+        const std::function<bool(Item* item)>& pred, Item*& out_found) const;
     void getDescendantItemsIter(
         const Item* parentItem, ItemList<>& io_items, const std::function<bool(Item* item)>& pred,
         bool isRecursive) const;
@@ -139,6 +144,7 @@ public:
         Item* topItem, Item* prevTopParentItem, Item* topPathChangedItem, bool isPathChanged = false);
     void addToItemsToEmitSigSubTreeChanged();
     static void emitSigSubTreeChanged();
+    static void finishTreeChange(RootItem* rootItem, bool doEmitSigSubTreeChanged);
     void emitSigDisconnectedFromRootForSubTree();
     bool traverse(Item* item, const std::function<bool(Item*)>& pred);
     void removeAddon(ItemAddon* addon, bool isMoving);
@@ -226,6 +232,9 @@ Item::~Item()
         child = prev;
     }
 
+    // The signal may be deferred by Item::beginTreeChanges
+    itemsToEmitSigSubTreeChanged.erase(this);
+
     delete impl;
 }
 
@@ -764,15 +773,7 @@ bool Item::Impl::doInsertChildItem(ItemPtr item, Item* newNextItem, bool isManua
 
     addToItemsToEmitSigSubTreeChanged();
 
-    --recursiveTreeChangeCounter;
-
-    if(recursiveTreeChangeCounter == 0){
-        emitSigSubTreeChanged();
-        if(rootItem && isAnyItemInSubTreesBeingAddedOrRemovedSelected){
-            rootItem->requestToEmitSigSelectedItemsChanged();
-        }
-        isAnyItemInSubTreesBeingAddedOrRemovedSelected = false;
-    }
+    finishTreeChange(rootItem, true);
 
     return true;
 }
@@ -953,17 +954,7 @@ void Item::Impl::doRemoveFromParentItem(bool isMoving, bool isParentBeingDeleted
         }
     }
 
-    --recursiveTreeChangeCounter;
-
-    if(recursiveTreeChangeCounter == 0){
-        if(!isMoving){
-            emitSigSubTreeChanged();
-        }
-        if(rootItem && isAnyItemInSubTreesBeingAddedOrRemovedSelected){
-            rootItem->requestToEmitSigSelectedItemsChanged();
-        }
-        isAnyItemInSubTreesBeingAddedOrRemovedSelected = false;
-    }
+    finishTreeChange(rootItem, !isMoving);
 }
 
 
@@ -1103,8 +1094,43 @@ void Item::Impl::addToItemsToEmitSigSubTreeChanged()
 }
 
 
+void Item::beginTreeChanges()
+{
+    ++recursiveTreeChangeCounter;
+}
+
+
+void Item::endTreeChanges()
+{
+    Impl::finishTreeChange(nullptr, true);
+}
+
+
+void Item::Impl::finishTreeChange(RootItem* rootItem, bool doEmitSigSubTreeChanged)
+{
+    if(rootItem && isAnyItemInSubTreesBeingAddedOrRemovedSelected){
+        rootItemToRequestSigSelectedItemsChanged = rootItem;
+    }
+    
+    --recursiveTreeChangeCounter;
+
+    if(recursiveTreeChangeCounter == 0){
+        if(doEmitSigSubTreeChanged){
+            emitSigSubTreeChanged();
+        }
+        if(rootItemToRequestSigSelectedItemsChanged){
+            rootItemToRequestSigSelectedItemsChanged->requestToEmitSigSelectedItemsChanged();
+        }
+        isAnyItemInSubTreesBeingAddedOrRemovedSelected = false;
+        rootItemToRequestSigSelectedItemsChanged = nullptr;
+    }
+}
+
+
 void Item::Impl::emitSigSubTreeChanged()
 {
+    CNOID_TRACE_ZONE("Item::sigSubTreeChanged", "Item");
+
     tmpItemArray.resize(itemsToEmitSigSubTreeChanged.size());
     std::copy(itemsToEmitSigSubTreeChanged.begin(), itemsToEmitSigSubTreeChanged.end(), tmpItemArray.begin());
     // Note that the comparison must be strict weak ordering
@@ -1209,10 +1235,53 @@ Item* Item::findItem
     if(ipath.begin() == ipath.end()){
         return impl->findItem(pred, isRecursive);
     }
+    if(isRecursive){
+        if(auto rootItem = findRootItem()){
+            Item* found;
+            if(impl->findItemWithNameIndex(rootItem, ipath.begin(), ipath.end(), pred, found)){
+                return found;
+            }
+        }
+    }
     return impl->findItem(ipath.begin(), ipath.end(), pred, isRecursive);
 }
 
 
+/**
+   The items that have the name at the end of the path are obtained from the index of the
+   root item, and the paths to them are checked from the end.
+   \return false if more than one item matches the path. In this case, the item tree must be
+   searched to find the item that comes first in the search order.
+*/
+bool Item::Impl::findItemWithNameIndex
+(RootItem* rootItem, ItemPath::iterator begin, ItemPath::iterator end,
+ const std::function<bool(Item* item)>& pred, Item*& out_found) const
+{
+    out_found = nullptr;
+    
+    for(auto& candidate : rootItem->itemsWithName(*(end - 1))){
+        Item* item = candidate;
+        auto iter = end - 1;
+        bool isMatched = true;
+        while(iter != begin){
+            --iter;
+            item = item->parentItem();
+            if(!item || item->name() != *iter){
+                isMatched = false;
+                break;
+            }
+        }
+        if(isMatched && item->isOwnedBy(self) && (!pred || pred(candidate))){
+            if(out_found){
+                return false;
+            }
+            out_found = candidate;
+        }
+    }
+    return true;
+}
+
+
 // Use the breadth-first search
 Item* Item::Impl::findItem(const std::function<bool(Item* item)>& pred, bool isRecursive) const
 {
@@ -1353,6 +1422,7 @@ bool Item::Impl::traverse(Item* item, const std::function<bool(Item*)>& pred)
 
 void Item::notifyUpdate()
 {
+    CNOID_TRACE_ZONE("Item::sigUpdated", "Item");
     impl->isConsistentWithArchive = false;
     impl->sigUpdated();
 }
@@ -1728,6 +1798,12 @@ void Item::putProperties(PutPropertyFunction& putProperty)
 }
 
 
+size_t Item::getMemoryUsage() const
+{
+    return 0;
+}
+
+
 void Item::doPutProperties(PutPropertyFunction& putProperty)
 {
 
@@ -382,6 +382,15 @@ public:
     */
     SignalProxy<void()> sigSubTreeChanged();
 
+    /**
+       The emissions of sigSubTreeChanged and RootItem::sigSelectedItemsChanged caused by the
+       tree changes between these functions are deferred until endTreeChanges is called, and
+       sigSubTreeChanged of each item is emitted only once. Use the functions for a bulk
+       operation on the item tree. The function calls can be nested.
+    */
+    static void beginTreeChanges();
+    static void endTreeChanges();
+
     SignalProxy<void()> sigDisconnectedFromRoot();
 
     [[deprecated("Use Item::sigDisconnectedFromRoot.")]]
@@ -471,6 +480,12 @@ public:
 
     void putProperties(PutPropertyFunction& putProperty);
 
+    /**
+       Override this function to report the size of the large data held by the item, such as the
+       elements of a sequence, to the memory telemetry. The default implementation returns zero.
+    */
+    virtual size_t getMemoryUsage() const;
+
     static void setUnifiedEditHistory(UnifiedEditHistory* history);
     void addEditRecordToUnifiedEditHistory(EditRecord* record);
 
@@ -37,6 +37,7 @@ public:
 
     virtual EditRecord* clone() const override;
     virtual std::string label() const override;
+    virtual size_t memoryUsage() const override;
     virtual bool undo() override;
     virtual bool redo() override;
     
@@ -62,6 +63,7 @@ public:
     ItemNameEditRecord(const ItemNameEditRecord& org);
     virtual EditRecord* clone() const override;
     virtual std::string label() const override;
+    virtual size_t memoryUsage() const override;
     virtual bool undo() override;
     virtual bool redo() override;
 };
@@ -372,6 +374,12 @@ std::string ItemTreeEditRecord::label() const
 }
 
 
+size_t ItemTreeEditRecord::memoryUsage() const
+{
+    return sizeof(ItemTreeEditRecord) + forwardLabel.capacity() + reverseLabel.capacity();
+}
+
+
 bool ItemTreeEditRecord::undo()
 {
     switch(action){
@@ -432,6 +440,12 @@ std::string ItemNameEditRecord::label() const
 }
 
 
+size_t ItemNameEditRecord::memoryUsage() const
+{
+    return sizeof(ItemNameEditRecord) + oldName.capacity() + newName.capacity();
+}
+
+
 bool ItemNameEditRecord::undo()
 {
     auto block = manager->itemConnectionSetMap[item].scopedBlock();
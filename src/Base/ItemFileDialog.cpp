@@ -7,6 +7,8 @@
 #include <cnoid/UTF8>
 #include <cnoid/stdx/filesystem>
 #include <QMessageBox>
+#include <QProgressDialog>
+#include <QTimer>
 #include <fmt/format.h>
 #include "gettext.h"
 
@@ -35,6 +37,7 @@ public:
     QWidget* optionPanel;
     bool isSingletonItem;
     bool isExportMode;
+    bool isAsyncLoadingEnabled;
     
     Impl(ItemFileDialog* self);
     ItemList<Item>  loadItems(Item* parentItem, bool doAddition, Item* nextItem);
@@ -87,6 +90,7 @@ ItemFileDialog::Impl::Impl(ItemFileDialog* self)
         [this](int result){ return onFileDialogAboutToFinish(result); });
 
     isExportMode = false;
+    isAsyncLoadingEnabled = false;
 }
 
 
@@ -115,6 +119,46 @@ void ItemFileDialog::clearFileIOs()
 }
 
 
+void ItemFileDialog::setAsyncLoadingEnabled(bool on)
+{
+    impl->isAsyncLoadingEnabled = on;
+}
+
+
+static void showAsyncLoadProgress(ItemFileIO* fileIO, ItemFileIO::AsyncLoadPtr asyncLoad)
+{
+    auto filename = toUTF8(filesystem::path(fromUTF8(asyncLoad->filename())).filename().string());
+    auto dialog = new QProgressDialog(MainWindow::instance());
+    dialog->setWindowTitle(_("Loading"));
+    dialog->setLabelText(format(_("Loading {0} \"{1}\""), fileIO->caption(), filename).c_str());
+    dialog->setCancelButtonText(_("Cancel"));
+    dialog->setAttribute(Qt::WA_DeleteOnClose);
+    dialog->setWindowModality(Qt::NonModal);
+    dialog->setAutoClose(false);
+    dialog->setAutoReset(false);
+    dialog->setMinimumDuration(500);
+    dialog->setRange(0, 0);
+    dialog->setValue(0);
+
+    auto timer = new QTimer(dialog);
+    QObject::connect(
+        timer, &QTimer::timeout,
+        [dialog, asyncLoad](){
+            double progress = asyncLoad->progress();
+            if(progress >= 0.0){
+                // The busy indicator is shown until the progress is reported
+                dialog->setRange(0, 100);
+                dialog->setValue(static_cast<int>(progress * 100.0));
+            }
+        });
+    timer->start(100);
+
+    QObject::connect(dialog, &QProgressDialog::canceled, [asyncLoad](){ asyncLoad->cancel(); });
+    
+    asyncLoad->sigFinished().connect([dialog](bool){ dialog->close(); });
+}
+
+
 ItemList<Item> ItemFileDialog::loadItems(Item* parentItem, bool doAddition, Item* nextItem)
 {
     return impl->loadItems(parentItem, doAddition, nextItem);
@@ -182,6 +226,15 @@ ItemList<Item> ItemFileDialog::Impl::loadItems(Item* parentItem, bool doAddition
             }
             if(item){
                 targetFileIO->setCurrentInvocationType(ItemFileIO::Dialog);
+                if(isAsyncLoadingEnabled && doAddition && !isSingleton &&
+                   targetFileIO->hasApi(ItemFileIO::Prefetch)){
+                    auto asyncLoad = targetFileIO->loadItemAsync(
+                        item, filenames[i].toStdString(), parentItem, doAddition, nextItem, nullptr);
+                    if(!asyncLoad->isFinished()){
+                        showAsyncLoadProgress(targetFileIO, asyncLoad);
+                    }
+                    continue;
+                }
                 bool loaded = targetFileIO->loadItem(
                     item, filenames[i].toStdString(), parentItem, doAddition, nextItem, nullptr);
                 if(loaded){
@@ -28,6 +28,14 @@ public:
         bool doAddition = true,
         Item* nextItem = nullptr);
 
+    /**
+       When this is enabled, the loadItems function loads the files asynchronously with the
+       file IO supporting the Prefetch API and shows the progress of the loading. The items
+       loaded in that way are added to the parent item after the loading is finished, and
+       they are not included in the list returned by the loadItems function.
+    */
+    void setAsyncLoadingEnabled(bool on = true);
+
     void setExportMode(bool on = true);
     bool saveItem(Item* item);
 
@@ -1,18 +1,76 @@
 #include "ItemFileIO.h"
 #include "ItemManager.h"
 #include "MessageView.h"
+#include "LazyCaller.h"
 #include <cnoid/NullOut>
 #include <cnoid/ValueTree>
 #include <cnoid/FilePathVariableProcessor>
 #include <cnoid/UTF8>
+#include <cnoid/ThreadPool>
 #include <cnoid/stdx/filesystem>
 #include <fmt/format.h>
+#include <future>
+#include <atomic>
+#include <sstream>
+#include <unordered_map>
+#include <algorithm>
 #include "gettext.h"
 
 using namespace std;
 using namespace cnoid;
 namespace filesystem = cnoid::stdx::filesystem;
 
+namespace {
+
+struct PrefetchResult
+{
+    ReferencedPtr data;
+    string message;
+};
+
+unique_ptr<ThreadPool> prefetchThreadPool;
+
+// The asynchronous loading whose prefetch function is running in the current thread
+thread_local ItemFileIO::AsyncLoad::Impl* currentAsyncLoad = nullptr;
+
+/*
+  An existing file is renamed to the backup file before it is overwritten so that the original
+  data is not lost when the saving fails or is interrupted. The backup file is in the same
+  directory because the rename function cannot move a file to another file system.
+*/
+filesystem::path moveFileToBackup(const string& filename)
+{
+    filesystem::path path(fromUTF8(filename));
+    filesystem::path backupPath;
+    std::error_code ec;
+    if(filesystem::is_regular_file(path, ec)){
+        filesystem::path backupFilename(".");
+        backupFilename += path.filename();
+        backupFilename += ".backup";
+        backupPath = path.parent_path() / backupFilename;
+        filesystem::rename(path, backupPath, ec);
+        if(ec){
+            backupPath.clear();
+        }
+    }
+    return backupPath;
+}
+
+
+void finishBackup(const filesystem::path& backupPath, const string& filename, bool saved)
+{
+    std::error_code ec;
+    if(saved){
+        filesystem::remove(backupPath, ec);
+    } else {
+        filesystem::path path(fromUTF8(filename));
+        filesystem::remove(path, ec);
+        filesystem::rename(backupPath, path, ec);
+    }
+}
+
+}
+
 namespace cnoid {
 
 class ItemFileIO::Impl
@@ -39,6 +97,8 @@ public:
     // This variable actualy points a instance of the ClassInfo class defined in ItemManager.cpp
     mutable weak_ref_ptr<Referenced> itemClassInfo;
 
+    unordered_map<string, shared_future<PrefetchResult>> prefetchResults;
+
     Impl(ItemFileIO* self, const std::string& format, int api);
     Impl(ItemFileIO* self, const Impl& org);
     bool preprocessLoadingOrSaving(Item* item, std::string& io_filename, const Mapping* options);
@@ -46,6 +106,30 @@ public:
         Item* item, std::string filename,
         Item* parentItem, bool doAddition, Item* nextItem, const Mapping* options);
     bool saveItem(Item* item, std::string filename, const Mapping* options);
+    void startPrefetch(const std::string& key, ItemFileIO::AsyncLoadPtr asyncLoad);
+};
+
+class ItemFileIO::AsyncLoad::Impl
+{
+public:
+    ItemFileIOPtr fileIO;
+    ItemPtr item;
+    string filename;
+    string key;
+    ItemPtr parentItem;
+    ItemPtr nextItem;
+    bool doAddition;
+    int invocationType;
+    MappingPtr options;
+    std::atomic<double> progress;
+    std::atomic<bool> isCanceled;
+    bool isFinished;
+    bool isSucceeded;
+    Signal<void(bool isSucceeded)> sigFinished;
+
+    Impl(ItemFileIO* fileIO, Item* item, const std::string& filename);
+    void attach();
+    void finish(bool succeeded);
 };
 
 }
@@ -414,6 +498,274 @@ bool ItemFileIO::load(Item* item, const std::string& filename)
 }
 
 
+void ItemFileIO::startPrefetch(const std::string& filename)
+{
+    if(!(impl->api & Prefetch)){
+        return;
+    }
+    // The file name is expanded in the same way as the loadItem function
+    string expanded = FilePathVariableProcessor::systemInstance()->expand(filename, true);
+    if(expanded.empty() || impl->prefetchResults.find(expanded) != impl->prefetchResults.end()){
+        return;
+    }
+    impl->startPrefetch(expanded, nullptr);
+}
+
+
+/**
+   \param key The file name given to the load function
+*/
+void ItemFileIO::Impl::startPrefetch(const std::string& key, ItemFileIO::AsyncLoadPtr asyncLoad)
+{
+    if(!prefetchThreadPool){
+        prefetchThreadPool.reset(new ThreadPool(std::max(1u, std::thread::hardware_concurrency())));
+    }
+    auto promise = make_shared<std::promise<PrefetchResult>>();
+    prefetchResults[key] = promise->get_future().share();
+    ItemFileIOPtr holder = self;
+    prefetchThreadPool->start(
+        [holder, key, promise, asyncLoad](){
+            PrefetchResult result;
+            ostringstream ss;
+            if(asyncLoad){
+                currentAsyncLoad = asyncLoad->impl;
+            }
+            try {
+                if(!(asyncLoad && asyncLoad->isCanceled())){
+                    result.data = holder->prefetch(key, ss);
+                }
+            }
+            catch(const std::exception& ex){
+                ss << ex.what() << endl;
+                result.data.reset();
+            }
+            currentAsyncLoad = nullptr;
+            result.message = ss.str();
+            promise->set_value(result);
+
+            if(asyncLoad){
+                callLater([asyncLoad](){ asyncLoad->impl->attach(); });
+            }
+        });
+}
+
+
+void ItemFileIO::clearPrefetchedData()
+{
+    impl->prefetchResults.clear();
+}
+
+
+ReferencedPtr ItemFileIO::prefetch(const std::string& /* filename */, std::ostream& /* os */)
+{
+    return nullptr;
+}
+
+
+ReferencedPtr ItemFileIO::takePrefetchedData(const std::string& filename)
+{
+    auto p = impl->prefetchResults.find(filename);
+    if(p == impl->prefetchResults.end()){
+        return nullptr;
+    }
+    auto result = p->second.get();
+    impl->prefetchResults.erase(p);
+    // The messages of a failed prefetch are discarded because the file is loaded again by the
+    // load function in that case
+    if(result.data && !result.message.empty()){
+        os() << result.message;
+    }
+    return result.data;
+}
+
+
+void ItemFileIO::setPrefetchProgress(double ratio)
+{
+    if(currentAsyncLoad){
+        currentAsyncLoad->progress = std::min(std::max(ratio, 0.0), 1.0);
+    }
+}
+
+
+bool ItemFileIO::isPrefetchCanceled()
+{
+    return currentAsyncLoad && currentAsyncLoad->isCanceled;
+}
+
+
+ItemFileIO::AsyncLoadPtr ItemFileIO::loadItemAsync
+(const std::string& filename,
+ Item* parentItem, bool doAddition, Item* nextItem, const Mapping* options)
+{
+    AsyncLoadPtr asyncLoad;
+    ItemPtr item = createItem();
+    if(item){
+        asyncLoad = loadItemAsync(item, filename, parentItem, doAddition, nextItem, options);
+    }
+    impl->currentInvocationType = Direct;
+    return asyncLoad;
+}
+
+
+ItemFileIO::AsyncLoadPtr ItemFileIO::loadItemAsync
+(Item* item, const std::string& filename,
+ Item* parentItem, bool doAddition, Item* nextItem, const Mapping* options)
+{
+    AsyncLoadPtr asyncLoad = new AsyncLoad(this, item, filename);
+    auto aimpl = asyncLoad->impl;
+
+    // The file name given to the load function is used as the key of the prefetched data
+    string key = filename;
+    if(impl->currentInvocationType == Direct){
+        key = FilePathVariableProcessor::systemInstance()->expand(filename, true);
+    }
+
+    if(!(impl->api & Prefetch) || key.empty() ||
+       impl->prefetchResults.find(key) != impl->prefetchResults.end()){
+        bool loaded = loadItem(item, filename, parentItem, doAddition, nextItem, options);
+        aimpl->finish(loaded);
+        return asyncLoad;
+    }
+
+    aimpl->key = key;
+    aimpl->parentItem = parentItem;
+    aimpl->nextItem = nextItem;
+    aimpl->doAddition = doAddition;
+    aimpl->invocationType = impl->currentInvocationType;
+    if(impl->api & Options){
+        // The current options are stored because the options may be changed by another
+        // loading before the attach stage
+        if(options){
+            aimpl->options = options->cloneMapping();
+        } else if(aimpl->invocationType != Direct){
+            aimpl->options = new Mapping;
+            storeOptions(aimpl->options);
+        }
+    }
+    impl->currentInvocationType = Direct;
+
+    impl->mv->putln(fmt::format(_("Loading {0} \"{1}\" in the background ..."), impl->caption, filename));
+    impl->startPrefetch(key, asyncLoad);
+
+    return asyncLoad;
+}
+
+
+ItemFileIO::AsyncLoad::AsyncLoad(ItemFileIO* fileIO, Item* item, const std::string& filename)
+{
+    impl = new Impl(fileIO, item, filename);
+}
+
+
+ItemFileIO::AsyncLoad::Impl::Impl(ItemFileIO* fileIO, Item* item, const std::string& filename)
+    : fileIO(fileIO),
+      item(item),
+      filename(filename),
+      progress(-1.0),
+      isCanceled(false)
+{
+    doAddition = false;
+    invocationType = Direct;
+    isFinished = false;
+    isSucceeded = false;
+}
+
+
+ItemFileIO::AsyncLoad::~AsyncLoad()
+{
+    delete impl;
+}
+
+
+// Attach stage executed in the main thread after the prefetch is finished
+void ItemFileIO::AsyncLoad::Impl::attach()
+{
+    if(isCanceled){
+        fileIO->impl->prefetchResults.erase(key);
+        fileIO->impl->mv->putln(
+            fmt::format(_("Loading {0} \"{1}\" has been canceled."), fileIO->impl->caption, filename));
+        finish(false);
+        return;
+    }
+    if(nextItem && nextItem->parentItem() != parentItem){
+        // The next item has been moved during the prefetch
+        nextItem.reset();
+    }
+    fileIO->setCurrentInvocationType(invocationType);
+    if(options && invocationType != Direct){
+        fileIO->resetOptions();
+        fileIO->restoreOptions(options);
+    }
+    // The load function takes the prefetched data and falls back to the normal loading
+    // if the prefetch failed
+    bool loaded = fileIO->loadItem(item, filename, parentItem, doAddition, nextItem, options);
+    // The data is left if the load function does not use it
+    fileIO->impl->prefetchResults.erase(key);
+    finish(loaded);
+}
+
+
+void ItemFileIO::AsyncLoad::Impl::finish(bool succeeded)
+{
+    isFinished = true;
+    isSucceeded = succeeded;
+    if(succeeded){
+        progress = 1.0;
+    }
+    parentItem.reset();
+    nextItem.reset();
+    sigFinished(succeeded);
+}
+
+
+const std::string& ItemFileIO::AsyncLoad::filename() const
+{
+    return impl->filename;
+}
+
+
+Item* ItemFileIO::AsyncLoad::item() const
+{
+    return impl->item;
+}
+
+
+double ItemFileIO::AsyncLoad::progress() const
+{
+    return impl->progress;
+}
+
+
+void ItemFileIO::AsyncLoad::cancel()
+{
+    impl->isCanceled = true;
+}
+
+
+bool ItemFileIO::AsyncLoad::isCanceled() const
+{
+    return impl->isCanceled;
+}
+
+
+bool ItemFileIO::AsyncLoad::isFinished() const
+{
+    return impl->isFinished;
+}
+
+
+bool ItemFileIO::AsyncLoad::isSucceeded() const
+{
+    return impl->isSucceeded;
+}
+
+
+SignalProxy<void(bool isSucceeded)> ItemFileIO::AsyncLoad::sigFinished()
+{
+    return impl->sigFinished;
+}
+
+
 Item* ItemFileIO::createItem()
 {
     return nullptr;
@@ -467,9 +819,18 @@ bool ItemFileIO::Impl::saveItem
     }
     mv->flush();
 
+    filesystem::path backupPath;
+    if(!isExport){
+        backupPath = moveFileToBackup(filename);
+    }
+
     bool saved = self->save(item, filename);
     mv->flush();
 
+    if(!backupPath.empty()){
+        finishBackup(backupPath, filename, saved);
+    }
+
     if(!saved){
         mv->put(_(" -> failed.\n"), MessageView::Highlight);
 
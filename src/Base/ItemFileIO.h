@@ -3,6 +3,7 @@
 
 #include "ItemList.h"
 #include <cnoid/Referenced>
+#include <cnoid/Signal>
 #include <string>
 #include <vector>
 #include <ctime>
@@ -26,6 +27,7 @@ public:
         OptionPanelForLoading = 1 << 2,
         Save = 1 << 3,
         OptionPanelForSaving = 1 << 4,
+        Prefetch = 1 << 5,
     };
     enum InterfaceLevel { Standard, Conversion, Internal };
     enum InvocationType { Direct, Dialog, DragAndDrop };
@@ -79,6 +81,66 @@ public:
 
     // Save API
     bool saveItem(Item* item, const std::string& filename, const Mapping* options = nullptr);
+
+    /**
+       Prefetch API. This function starts loading the file in a worker thread by calling the
+       prefetch function, and the load function receives the loaded data with the
+       takePrefetchedData function. This is used to load the independent files of a project
+       concurrently.
+    */
+    void startPrefetch(const std::string& filename);
+    //! The prefetched data which has not been taken is discarded.
+    void clearPrefetchedData();
+
+    /**
+       Handle of an asynchronous loading started by the loadItemAsync function.
+       The functions of this class except progress, cancel and isCanceled must be
+       called in the main thread.
+    */
+    class CNOID_EXPORT AsyncLoad : public Referenced
+    {
+    public:
+        ~AsyncLoad();
+        const std::string& filename() const;
+        Item* item() const;
+        //! \return The progress ratio from 0.0 to 1.0, or a negative value if it is not reported.
+        double progress() const;
+        /**
+           The item is not loaded if this function is called before the attach stage.
+           The prefetch function can stop reading the file by checking isPrefetchCanceled.
+        */
+        void cancel();
+        bool isCanceled() const;
+        bool isFinished() const;
+        bool isSucceeded() const;
+        //! This signal is emitted in the main thread when the loading is finished or canceled.
+        SignalProxy<void(bool isSucceeded)> sigFinished();
+
+        class Impl;
+
+    private:
+        AsyncLoad(ItemFileIO* fileIO, Item* item, const std::string& filename);
+        Impl* impl;
+        friend class ItemFileIO;
+    };
+    typedef ref_ptr<AsyncLoad> AsyncLoadPtr;
+
+    /**
+       Async load API. The file is read by the prefetch function in a worker thread, and the
+       item is loaded with the read data by the load function in the main thread after that.
+       The item is added to the parent item at that time if doAddition is true. If the file IO
+       does not support the Prefetch API, the item is loaded synchronously in this function.
+       The options are fixed at the time this function is called.
+    */
+    AsyncLoadPtr loadItemAsync(
+        const std::string& filename,
+        Item* parentItem = nullptr, bool doAddition = true, Item* nextItem = nullptr,
+        const Mapping* options = nullptr);
+
+    AsyncLoadPtr loadItemAsync(
+        Item* item, const std::string& filename,
+        Item* parentItem = nullptr, bool doAddition = true, Item* nextItem = nullptr,
+        const Mapping* options = nullptr);
     
     // Options API
     virtual void resetOptions();
@@ -140,6 +202,31 @@ protected:
     // Save API
     virtual bool save(Item* item, const std::string& filename);
     
+    /**
+       This function is called in a worker thread for the Prefetch API. It must be thread-safe
+       and must not access the GUI or the item tree. The messages must be output to the given
+       stream instead of the one returned by the os function.
+       \return The loaded data, or nullptr if the file cannot be loaded.
+    */
+    virtual ReferencedPtr prefetch(const std::string& filename, std::ostream& os);
+
+    /**
+       This function waits for the completion of the prefetch of the file and returns the
+       data loaded by it. The messages output in prefetching are put to the os stream.
+       \return nullptr if the file has not been prefetched or the prefetch failed. The load
+       function should load the file by itself in that case.
+    */
+    ReferencedPtr takePrefetchedData(const std::string& filename);
+
+    /**
+       The following functions can be called in the prefetch function to report the progress
+       of reading the file and to check if the asynchronous loading has been canceled.
+       They do nothing if the prefetch is not invoked by the loadItemAsync function.
+       \param ratio The progress ratio from 0.0 to 1.0
+    */
+    static void setPrefetchProgress(double ratio);
+    static bool isPrefetchCanceled();
+
     std::ostream& os();
     void putWarning(const std::string& message);
     void putError(const std::string& message);
@@ -348,17 +348,33 @@ Item* ItemFileIO::findSingletonItemInstance() const
 }
 
 
-static Item* createItem
-(const std::string& moduleName, const std::string& className, bool searchOtherModules)
+/**
+   If the module is an on-demand plugin that has not been loaded yet, the plugin is activated.
+*/
+static ModuleNameToItemManagerImplMap::iterator findItemManagerImpl(const std::string& moduleName)
 {
-    Item* item = nullptr;
-
     auto p = moduleNameToItemManagerImplMap.find(moduleName);
     if(p == moduleNameToItemManagerImplMap.end()){
-        if(auto alias = PluginManager::instance()->guessActualPluginName(moduleName)){
+        auto pluginManager = PluginManager::instance();
+        if(auto alias = pluginManager->guessActualPluginName(moduleName)){
             p = moduleNameToItemManagerImplMap.find(alias);
         }
+        if(p == moduleNameToItemManagerImplMap.end()){
+            if(pluginManager->activateOnDemandPlugin(moduleName)){
+                p = moduleNameToItemManagerImplMap.find(moduleName);
+            }
+        }
     }
+    return p;
+}
+
+
+static Item* createItem
+(const std::string& moduleName, const std::string& className, bool searchOtherModules)
+{
+    Item* item = nullptr;
+
+    auto p = findItemManagerImpl(moduleName);
     if(p != moduleNameToItemManagerImplMap.end()){
         auto& itemClassNameToInfoMap = p->second->itemClassNameToInfoMap;
         auto q = itemClassNameToInfoMap.find(className);
@@ -787,6 +803,25 @@ ItemFileIO* ItemManager::findFileIO(const std::type_info& type, const std::strin
 }
 
 
+ItemFileIO* ItemManager::findFileIO
+(const std::string& moduleName, const std::string& itemClassName, const std::string& format)
+{
+    auto p = findItemManagerImpl(moduleName);
+    if(p != moduleNameToItemManagerImplMap.end()){
+        auto& itemClassNameToInfoMap = p->second->itemClassNameToInfoMap;
+        auto q = itemClassNameToInfoMap.find(itemClassName);
+        if(q != itemClassNameToInfoMap.end()){
+            for(auto& fileIO : q->second->fileIOs){
+                if(format.empty() || fileIO->isFormat(format)){
+                    return fileIO;
+                }
+            }
+        }
+    }
+    return nullptr;
+}
+
+
 ItemFileIO* ItemManager::Impl::findMatchedFileIO
 (const type_info& type, const string& filename, const string& format, int ioTypeFlag)
 {
@@ -960,6 +995,7 @@ void ItemManager::Impl::onLoadOrImportItemsActivated(const vector<ItemFileIO*>&
     }
     ItemFileDialog dialog;
     dialog.setFileIOs(fileIOs);
+    dialog.setAsyncLoadingEnabled();
     dialog.loadItems(parentItem, true);
 }
 
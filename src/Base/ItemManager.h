@@ -169,6 +169,8 @@ public:
     static std::vector<ItemFileIO*> getFileIOs(
         Item* item, std::function<bool(ItemFileIO* fileIO)> pred, bool includeSuperClassIos);
     static ItemFileIO* findFileIO(const std::type_info& type, const std::string& format);
+    static ItemFileIO* findFileIO(
+        const std::string& moduleName, const std::string& itemClassName, const std::string& format);
 
     template <class ItemType>
     ItemManager& addLoader(
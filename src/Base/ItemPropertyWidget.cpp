@@ -2,6 +2,7 @@
 #include "PolymorphicItemFunctionSet.h"
 #include "PutPropertyFunction.h"
 #include "LazyCaller.h"
+#include "Timer.h"
 #include "MainWindow.h"
 #include "Buttons.h"
 #include "StringListComboBox.h"
@@ -22,6 +23,7 @@
 #include <QStandardItemEditorCreator>
 #include <QKeyEvent>
 #include <QApplication>
+#include <QElapsedTimer>
 #include <fmt/format.h>
 #include <regex>
 #include <cmath>
@@ -61,6 +63,9 @@ typedef stdx::variant<
 
 enum TypeId { TYPE_BOOL, TYPE_INT, TYPE_DOUBLE, TYPE_STRING, TYPE_SELECTION, TYPE_FILEPATH };
 
+// The properties are not updated more frequently than this interval for the item update notifications
+constexpr int MinUpdateInterval = 100;
+
 class PropertyItem : public QTableWidgetItem
 {
 public:
@@ -68,9 +73,11 @@ public:
     ValueVariant value;
     FunctionVariant func;
     bool hasValidFunction;
+    int revision;
 
     PropertyItem(ItemPropertyWidget::Impl* view, ValueVariant value);
     PropertyItem(ItemPropertyWidget::Impl* view, ValueVariant value, FunctionVariant func);
+    void updateValue(const ValueVariant& newValue, const FunctionVariant* newFunc);
     virtual QVariant data(int role) const;
     virtual void setData(int role, const QVariant& qvalue);
 };
@@ -97,6 +104,7 @@ class CustomizedTableWidget : public QTableWidget
 public:
     CustomizedTableWidget(QWidget* parent);
     PropertyItem* itemFromIndex(const QModelIndex& index) const;
+    bool isEditing() const { return state() == QAbstractItemView::EditingState; }
     bool isPointingBorder(int x);
     virtual void mouseMoveEvent(QMouseEvent* event) override;
     virtual void mousePressEvent(QMouseEvent* event) override;
@@ -145,12 +153,19 @@ public:
     bool isEditingProperty;
     bool updateRequestedDuringPropertyEditing;
 
+    int numPutProperties;
+    Timer updateTimer;
+    QElapsedTimer lastUpdateTime;
+
     Impl(ItemPropertyWidget* self);
 
     void setCurrentItem(Item* item);
     void clear();
+    void requestPropertyUpdate();
     void updateProperties(bool isItemChanged = false);
-    void addProperty(const std::string& name, PropertyItem* propertyItem);
+    void addProperty(const std::string& name, const ValueVariant& value);
+    void addProperty(const std::string& name, const ValueVariant& value, const FunctionVariant& func);
+    void putPropertyRow(const std::string& name, const ValueVariant& value, const FunctionVariant* func);
     void onTargetItemSpecified(Item* item);
     void zoomFontSize(int pointSizeDiff);
     
@@ -201,6 +216,7 @@ PropertyItem::PropertyItem(ItemPropertyWidget::Impl* view, ValueVariant value)
 {
     setFlags(Qt::ItemIsEnabled | Qt::ItemIsSelectable);
     hasValidFunction = false;
+    revision = 0;
 }
 
 
@@ -211,6 +227,39 @@ PropertyItem::PropertyItem(ItemPropertyWidget::Impl* view, ValueVariant value, F
 {
     setFlags(Qt::ItemIsEnabled | Qt::ItemIsSelectable | Qt::ItemIsEditable);
     hasValidFunction = true;
+    revision = 0;
+}
+
+
+/**
+   The view is only notified when the displayed contents are changed so that the rows
+   of the properties that are not changed are not repainted.
+*/
+void PropertyItem::updateValue(const ValueVariant& newValue, const FunctionVariant* newFunc)
+{
+    if(newFunc){
+        func = *newFunc;
+    }
+    
+    QVariant oldDisplayData = data(Qt::DisplayRole);
+    QVariant oldEditData = data(Qt::EditRole);
+    QVariant oldToolTip = data(Qt::ToolTipRole);
+    int oldType = stdx::get_variant_index(value);
+    int oldDecimals = (oldType == TYPE_DOUBLE) ? stdx::get<Double>(value).decimals : 0;
+
+    value = newValue;
+
+    int newType = stdx::get_variant_index(value);
+    int newDecimals = (newType == TYPE_DOUBLE) ? stdx::get<Double>(value).decimals : 0;
+
+    if(newType != oldType || newDecimals != oldDecimals ||
+       data(Qt::DisplayRole) != oldDisplayData ||
+       data(Qt::EditRole) != oldEditData ||
+       data(Qt::ToolTipRole) != oldToolTip){
+        // The function of the base class is used to notify the model of the change
+        // without executing the property function
+        QTableWidgetItem::setData(Qt::UserRole, ++revision);
+    }
 }
 
 
@@ -632,6 +681,11 @@ ItemPropertyWidget::Impl::Impl(ItemPropertyWidget* self)
     : self(self)
 {
     isEditingProperty = false;
+    numPutProperties = 0;
+
+    updateTimer.setSingleShot(true);
+    updateTimer.sigTimeout().connect([this](){ updateProperties(); });
+    lastUpdateTime.start();
     
     tableWidget = new CustomizedTableWidget(self);
     tableWidget->setFrameShape(QFrame::NoFrame);
@@ -709,10 +763,10 @@ void ItemPropertyWidget::Impl::setCurrentItem(Item* item)
         if(item){
             itemConnections.add(
                 item->sigUpdated().connect(
-                    [&](){ updateProperties(); }));
+                    [&](){ requestPropertyUpdate(); }));
             itemConnections.add(
                 item->sigNameChanged().connect(
-                    [&](const std::string& /* oldName */){ updateProperties(); }));
+                    [&](const std::string& /* oldName */){ requestPropertyUpdate(); }));
             itemConnections.add(
                 item->sigDisconnectedFromRoot().connect(
                     [&](){ setCurrentItem(nullptr); }));
@@ -729,27 +783,42 @@ void ItemPropertyWidget::updateProperties()
 }
 
 
+/**
+   The update notifications of the item such as the ones from a running simulator item
+   are merged into the update executed at intervals of MinUpdateInterval at the most.
+*/
+void ItemPropertyWidget::Impl::requestPropertyUpdate()
+{
+    if(!updateTimer.isActive()){
+        int interval = MinUpdateInterval - static_cast<int>(lastUpdateTime.elapsed());
+        updateTimer.start(std::max(0, interval));
+    }
+}
+
+
+/**
+   When the target item is not changed, the existing rows are reused and only the rows
+   whose contents are changed are updated.
+*/
 void ItemPropertyWidget::Impl::updateProperties(bool isItemChanged)
 {
     if(isEditingProperty){
         updateRequestedDuringPropertyEditing = true;
 
     } else {
-        int currentRow;
-        int currentColumn;
-        if(!isItemChanged){
-            currentRow = tableWidget->currentRow();
-            currentColumn = tableWidget->currentColumn();
+        updateTimer.stop();
+        lastUpdateTime.restart();
+        
+        if(isItemChanged){
+            tableWidget->setRowCount(0);
         }
-
-        tableWidget->setRowCount(0);
+        numPutProperties = 0;
         if(currentItem){
             reset();
             propertyFunctions.dispatch(currentItem);
         }
-
-        if(!isItemChanged){
-            tableWidget->setCurrentCell(currentRow, currentColumn);
+        if(tableWidget->rowCount() > numPutProperties){
+            tableWidget->setRowCount(numPutProperties);
         }
     }
 }
@@ -771,15 +840,54 @@ void ItemPropertyWidget::setOperationMenu(MenuManager& menuManager)
 }
 
 
-void ItemPropertyWidget::Impl::addProperty(const std::string& name, PropertyItem* propertyItem)
+void ItemPropertyWidget::Impl::addProperty(const std::string& name, const ValueVariant& value)
 {
-    int row = tableWidget->rowCount();
-    tableWidget->setRowCount(row + 1);
+    putPropertyRow(name, value, nullptr);
+}
+
+
+void ItemPropertyWidget::Impl::addProperty
+(const std::string& name, const ValueVariant& value, const FunctionVariant& func)
+{
+    putPropertyRow(name, value, &func);
+}
+
+
+void ItemPropertyWidget::Impl::putPropertyRow
+(const std::string& name, const ValueVariant& value, const FunctionVariant* func)
+{
+    int row = numPutProperties++;
+    QString qname(name.c_str());
+
+    if(row < tableWidget->rowCount()){
+        auto nameItem = tableWidget->item(row, 0);
+        auto propertyItem = dynamic_cast<PropertyItem*>(tableWidget->item(row, 1));
+        if(nameItem && propertyItem && nameItem->text() == qname &&
+           propertyItem->hasValidFunction == (func != nullptr)){
+            // The value being edited is not overwritten
+            if(tableWidget->isEditing() && row == tableWidget->currentRow()){
+                if(func){
+                    propertyItem->func = *func;
+                }
+            } else {
+                propertyItem->updateValue(value, func);
+            }
+            return;
+        }
+    } else {
+        tableWidget->setRowCount(row + 1);
+    }
 
-    QTableWidgetItem* nameItem = new QTableWidgetItem(name.c_str());
+    QTableWidgetItem* nameItem = new QTableWidgetItem(qname);
     nameItem->setFlags(Qt::ItemIsEnabled);
     tableWidget->setItem(row, 0, nameItem);
-    
+
+    PropertyItem* propertyItem;
+    if(func){
+        propertyItem = new PropertyItem(this, value, *func);
+    } else {
+        propertyItem = new PropertyItem(this, value);
+    }
     tableWidget->setItem(row, 1, propertyItem);
 }
 
@@ -823,79 +931,79 @@ PutPropertyFunction& ItemPropertyWidget::Impl::reset()
         
 void ItemPropertyWidget::Impl::operator()(const std::string& name, bool value)
 {
-    addProperty(name, new PropertyItem(this, value));
+    addProperty(name, value);
 }
 
 
 void ItemPropertyWidget::Impl::operator()
 (const std::string& name, bool value, const std::function<bool(bool)>& func)
 {
-    addProperty(name, new PropertyItem(this, value, func));
+    addProperty(name, value, func);
 }
 
 
 void ItemPropertyWidget::Impl::operator()(const std::string& name, int value)
 {
-    addProperty(name, new PropertyItem(this, Int(value)));
+    addProperty(name, Int(value));
 }
 
 
 void ItemPropertyWidget::Impl::operator()
 (const std::string& name, int value, const std::function<bool(int)>& func)
 {
-    addProperty(name, new PropertyItem(this, Int(value, minValue, maxValue), func));
+    addProperty(name, Int(value, minValue, maxValue), func);
 }
 
 
 void ItemPropertyWidget::Impl::operator()(const std::string& name, double value)
 {
-    addProperty(name, new PropertyItem(this, Double(value, decimals_)));
+    addProperty(name, Double(value, decimals_));
 }
 
 
 void ItemPropertyWidget::Impl::operator()
 (const std::string& name, double value, const std::function<bool(double)>& func)
 {
-    addProperty(name, new PropertyItem(this, Double(value, decimals_, minValue, maxValue), func));
+    addProperty(name, Double(value, decimals_, minValue, maxValue), func);
 }
 
 
 void ItemPropertyWidget::Impl::operator()(const std::string& name, const std::string& value)
 {
-    addProperty(name, new PropertyItem(this, value));
+    addProperty(name, value);
 }
 
 
 void ItemPropertyWidget::Impl::operator()
 (const std::string& name, const std::string& value, const std::function<bool(const std::string&)>& func)
 {
-    addProperty(name, new PropertyItem(this, value, func));
+    addProperty(name, value, func);
 }
 
 
 void ItemPropertyWidget::Impl::operator()(const std::string& name, const Selection& selection)
 {
-    addProperty(name, new PropertyItem(this, selection));
+    addProperty(name, selection);
 }
 
 
 void ItemPropertyWidget::Impl::operator()
 (const std::string& name, const Selection& selection, const std::function<bool(int which)>& func)
 {
-    addProperty(name, new PropertyItem(this, selection, func));
+    addProperty(name, selection, func);
 }
 
 
 void ItemPropertyWidget::Impl::operator()(const std::string& name, const FilePathProperty& filepath)
 {
-    addProperty(name, new PropertyItem(this, filepath) );
+    addProperty(name, filepath);
 }
 
 
 void ItemPropertyWidget::Impl::operator()
 (const std::string& name, const FilePathProperty& filepath, const std::function<bool(const std::string&)>& func)
 {
-    addProperty(name, new PropertyItem(this, filepath, func) );
+    addProperty(name, filepath, func);
 }
 
 
@@ -7,6 +7,7 @@
 #include "RootItem.h"
 #include "SubProjectItem.h"
 #include "ItemManager.h"
+#include "ItemFileIO.h"
 #include "MessageView.h"
 #include "Archive.h"
 #include <cnoid/YAMLReader>
@@ -28,6 +29,9 @@ public:
     int itemIdCounter;
     int numArchivedItems;
     int numRestoredItems;
+    int numItemsToRestore;
+    int itemCounter;
+    std::set<ItemFileIOPtr> prefetchingFileIOs;
     const std::set<std::string>* pOptionalPlugins;
 
     Impl();
@@ -35,6 +39,7 @@ public:
     ArchivePtr storeIter(Archive& parentArchive, Item* item, bool& isComplete);
     void storeAddons(Archive& archive, Item* item);
     ItemList<> restore(Archive& archive, Item* parentItem, const std::set<std::string>& optionalPlugins);
+    void prefetchItemFilesIter(Archive& archive);
     void restoreItemIter(Archive& archive, Item* parentItem, ItemList<>& io_topLevelItems, int level);
     ItemPtr restoreItem(
         Archive& archive, Item* parentItem, string& itemName, string& classame,
@@ -250,18 +255,71 @@ ItemList<> ItemTreeArchiver::Impl::restore
     pOptionalPlugins = &optionalPlugins;
     ItemList<> topLevelItems;
 
+    numItemsToRestore = 0;
+    itemCounter = 0;
+
     archive.setCurrentParentItem(nullptr);
     try {
+        prefetchItemFilesIter(archive);
         restoreItemIter(archive, parentItem, topLevelItems, 0);
     } catch (const ValueNode::Exception& ex){
         mv->putln(ex.message(), MessageView::Error);
     }
     archive.setCurrentParentItem(nullptr);
 
+    for(auto& fileIO : prefetchingFileIOs){
+        fileIO->clearPrefetchedData();
+    }
+    prefetchingFileIOs.clear();
+
     return topLevelItems;
 }
 
 
+/**
+   This function starts loading the files of the items whose file IOs support the Prefetch API
+   in worker threads before the items are restored in order. The files are independent of the
+   other items because they are loaded only with their file names, so the items are still
+   restored and added to the item tree in the original order in the main thread.
+*/
+void ItemTreeArchiver::Impl::prefetchItemFilesIter(Archive& archive)
+{
+    string pluginName, className;
+    if(!archive.get({ "is_sub_item", "isSubItem" }, false) &&
+       archive.read("plugin", pluginName) && archive.read("class", className)){
+        if(className != "RootItem"){
+            ++numItemsToRestore;
+        }
+        ValueNodePtr dataNode = archive.find("data");
+        if(dataNode->isValid() && dataNode->isMapping()){
+            Archive* dataArchive = static_cast<Archive*>(dataNode->toMapping());
+            dataArchive->inheritSharedInfoFrom(archive);
+            string filename, format;
+            if(dataArchive->read({ "file", "filename", "modelFile" }, filename) &&
+               dataArchive->read("format", format)){
+                auto fileIO = ItemManager::findFileIO(pluginName, className, format);
+                if(fileIO && fileIO->hasApi(ItemFileIO::Prefetch)){
+                    filename = dataArchive->resolveRelocatablePath(filename);
+                    if(!filename.empty()){
+                        fileIO->startPrefetch(filename);
+                        prefetchingFileIOs.insert(fileIO);
+                    }
+                }
+            }
+        }
+    }
+    ListingPtr children = archive.findListing("children");
+    if(children->isValid()){
+        for(int i=0; i < children->size(); ++i){
+            if(auto childArchive = dynamic_cast<Archive*>(children->at(i)->toMapping())){
+                childArchive->inheritSharedInfoFrom(archive);
+                prefetchItemFilesIter(*childArchive);
+            }
+        }
+    }
+}
+
+
 void ItemTreeArchiver::Impl::restoreItemIter
 (Archive& archive, Item* parentItem, ItemList<>& io_topLevelItems, int level)
 {
@@ -377,7 +435,13 @@ ItemPtr ItemTreeArchiver::Impl::restoreItem
             item->setAttribute(Item::Attached);
         }
         
-        mv->putln(format(_("Restoring {0} \"{1}\""), className, itemName));
+        ++itemCounter;
+        if(numItemsToRestore > 1){
+            mv->putln(format(_("Restoring {0} \"{1}\" ({2}/{3})"),
+                             className, itemName, itemCounter, numItemsToRestore));
+        } else {
+            mv->putln(format(_("Restoring {0} \"{1}\""), className, itemName));
+        }
         mv->flush();
 
         ValueNodePtr dataNode = archive.find("data");
@@ -59,6 +59,9 @@ public:
     bool isProcessingSlotOnlocalRootItemPositionChanged;
     std::function<Item*(bool doCreate)> localRootItemUpdateFunction;
     unordered_map<Item*, ItwItem*> itemToItwItemMap;
+    // The items selected in the tree widget, which is used to update the selection states of
+    // only the items whose selection is changed in the tree widget
+    unordered_set<Item*> itemsSelectedInTreeWidget;
     ItemPtr lastClickedItem;
     map<int, int> checkIdToColumnMap;
     unordered_set<Item*> itemsUnderTreeWidgetInternalOperation;
@@ -120,7 +123,7 @@ public:
     void updateCheckColumnIter(QTreeWidgetItem* twItem, int checkId, int column);
     void releaseCheckColumn(int checkId);
     void updateItemDisplay(ItwItem* itwItem);
-    void insertItem(QTreeWidgetItem* parentTwItem, Item* item, bool isTopLevelItemCandidate);
+    void insertItem(QTreeWidgetItem* parentTwItem, Item* item, bool isTopLevelItemCandidate, bool doAppend);
     ItwItem* findNextItwItem(Item* item, bool isTopLevelItem);
     ItwItem* findNextItwItemInSubTree(Item* item, bool doTraverse);
     bool isItemUnderTreeWidgetInternalOperation(Item* item);
@@ -146,7 +149,7 @@ public:
     void onTreeWidgetRowsInserted(const QModelIndex& parent, int start, int end);
     void revertItemPosition(Item* item);
     void onTreeWidgetSelectionChanged();
-    void updateItemSelectionIter(QTreeWidgetItem* twItem, unordered_set<Item*>& selectedItemSet);
+    void updateItemSelection(ItwItem* itwItem, bool on);
     void onTreeWidgetCurrentItemChanged(QTreeWidgetItem* current, QTreeWidgetItem* previous);
     void setItwItemSelected(ItwItem* itwItem, bool on);
     void toggleItwItemCheck(ItwItem* itwItem, int checkId, bool on);
@@ -298,6 +301,7 @@ ItwItem::ItwItem(Item* item, ItemTreeWidget::Impl* widgetImpl)
 ItwItem::~ItwItem()
 {
     widgetImpl->itemToItwItemMap.erase(item);
+    widgetImpl->itemsSelectedInTreeWidget.erase(item);
 
     if(widgetImpl->lastClickedItem == item){
         widgetImpl->lastClickedItem = nullptr;
@@ -691,6 +695,7 @@ void ItemTreeWidget::updateTreeWidgetItems()
 void ItemTreeWidget::Impl::clearTreeWidgetItems()
 {
     clear();
+    itemsSelectedInTreeWidget.clear();
 }
 
 
@@ -701,10 +706,10 @@ void ItemTreeWidget::Impl::updateTreeWidgetItems()
     if(localRootItem){
         isChangingTreeWidgetTreeStructure++;
         if(isRootItemVisible && localRootItem != projectRootItem){
-            insertItem(invisibleRootItem(), localRootItem, true);
+            insertItem(invisibleRootItem(), localRootItem, true, true);
         } else {
             for(auto item = localRootItem->childItem(); item; item = item->nextItem()){
-                insertItem(invisibleRootItem(), item, true);
+                insertItem(invisibleRootItem(), item, true, true);
             }
         }
         isChangingTreeWidgetTreeStructure--;
@@ -812,7 +817,13 @@ void ItemTreeWidget::Impl::updateItemDisplay(ItwItem* itwItem)
 }
 
 
-void ItemTreeWidget::Impl::insertItem(QTreeWidgetItem* parentTwItem, Item* item, bool isTopLevelItemCandidate)
+/**
+   \param doAppend True if the item is inserted in the order of the item tree after all the
+   existing child items of the parent. In this case, the position of the item is not searched
+   for, which makes the construction of a large tree linear in the number of items.
+*/
+void ItemTreeWidget::Impl::insertItem
+(QTreeWidgetItem* parentTwItem, Item* item, bool isTopLevelItemCandidate, bool doAppend)
 {
     if(!findOrCreateLocalRootItem(false)){
         return;
@@ -834,7 +845,7 @@ void ItemTreeWidget::Impl::insertItem(QTreeWidgetItem* parentTwItem, Item* item,
     } else {
         auto itwItem = findOrCreateItwItem(item);
         bool isFirstNewChildItem = parentTwItem->childCount() == 0;
-        auto nextItwItem = findNextItwItem(item, isTopLevelItemCandidate);
+        auto nextItwItem = doAppend ? nullptr : findNextItwItem(item, isTopLevelItemCandidate);
         if(nextItwItem){
             int index = parentTwItem->indexOfChild(nextItwItem);
             parentTwItem->insertChild(index, itwItem);
@@ -850,11 +861,13 @@ void ItemTreeWidget::Impl::insertItem(QTreeWidgetItem* parentTwItem, Item* item,
         }
         isTopLevelItemCandidate = false;
         parentTwItem = itwItem;
+        // The child items are inserted into the new tree widget item in order
+        doAppend = (itwItem->childCount() == 0);
     }
 
     if(parentTwItem){
         for(Item* child = item->childItem(); child; child = child->nextItem()){
-            insertItem(parentTwItem, child, isTopLevelItemCandidate);
+            insertItem(parentTwItem, child, isTopLevelItemCandidate, doAppend);
         }
     }
 }
@@ -924,7 +937,7 @@ void ItemTreeWidget::Impl::onSubTreeAddedOrMoved(Item* item)
 
     auto parentItem = item->parentItem();
     if(auto parentItwItem = findItwItem(parentItem)){
-        insertItem(parentItwItem, item, false);
+        insertItem(parentItwItem, item, false, false);
     } else {
         bool isUpperLevelItemInserted = false;
         parentItem = parentItem->parentItem();
@@ -936,7 +949,7 @@ void ItemTreeWidget::Impl::onSubTreeAddedOrMoved(Item* item)
             parentItem = parentItem->parentItem();
         }
         if(!isUpperLevelItemInserted){
-            insertItem(invisibleRootItem(), item, true);
+            insertItem(invisibleRootItem(), item, true, false);
         }
     }
 
@@ -1288,6 +1301,7 @@ void ItemTreeWidget::Impl::cutSelectedItems()
         editGroupCreated = true;
     }
     
+    Item::beginTreeChanges();
     forEachTopItems(
         selectedItems,
         [&](Item* item, unordered_set<Item*>&){
@@ -1295,6 +1309,7 @@ void ItemTreeWidget::Impl::cutSelectedItems()
             item->removeFromParentItem();
             return true;
         });
+    Item::endTreeChanges();
 
     if(editGroupCreated){
         unifiedEditHistory->endEditGroup();
@@ -1334,6 +1349,7 @@ bool ItemTreeWidget::Impl::pasteItems(bool doCheckPositionAcceptance)
                 unifiedEditHistory->beginEditGroup(format(_("Paste items in {0}"), getViewTitle()), false);
                 editGroupCreated = true;
             }
+            Item::beginTreeChanges();
             auto it = copiedItems.begin();
             while(it != copiedItems.end()){
                 auto& item = *it;
@@ -1346,6 +1362,7 @@ bool ItemTreeWidget::Impl::pasteItems(bool doCheckPositionAcceptance)
                 }
                 pasted = true;
             }
+            Item::endTreeChanges();
             if(editGroupCreated){
                 unifiedEditHistory->endEditGroup();
             }
@@ -1406,9 +1423,11 @@ void ItemTreeWidget::Impl::onTreeWidgetRowsAboutToBeRemoved(const QModelIndex& p
         }
     }
 
+    Item::beginTreeChanges();
     for(auto item : items){
         item->removeFromParentItem();
     }
+    Item::endTreeChanges();
 
     itemsUnderTreeWidgetInternalOperation.clear();
 }
@@ -1506,10 +1525,13 @@ void ItemTreeWidget::Impl::onTreeWidgetSelectionChanged()
     if(doEmitSignal){
         items.reserve(selectedTwItems.size());
     }
+    vector<ItwItem*> selectedItwItems;
+    selectedItwItems.reserve(selectedTwItems.size());
     unordered_set<Item*> selectedItemSet;
     for(auto& twItem : selectedTwItems){
         if(auto itwItem = dynamic_cast<ItwItem*>(twItem)){
             auto item = itwItem->item;
+            selectedItwItems.push_back(itwItem);
             selectedItemSet.insert(item);
             if(doEmitSignal){
                 items.push_back(item);
@@ -1523,7 +1545,26 @@ void ItemTreeWidget::Impl::onTreeWidgetSelectionChanged()
         unselectItemsInOtherWidgetsInSelectionSyncGroup();
     }
 
-    updateItemSelectionIter(invisibleRootItem(), selectedItemSet);
+    /*
+      Only the items that were selected before and the items that are selected now are
+      updated instead of traversing all the tree widget items.
+    */
+    vector<ItwItem*> unselectedItwItems;
+    for(auto& item : itemsSelectedInTreeWidget){
+        if(selectedItemSet.find(item) == selectedItemSet.end()){
+            if(auto itwItem = findItwItem(item)){
+                unselectedItwItems.push_back(itwItem);
+            }
+        }
+    }
+    itemsSelectedInTreeWidget = std::move(selectedItemSet);
+
+    for(auto& itwItem : unselectedItwItems){
+        updateItemSelection(itwItem, false);
+    }
+    for(auto& itwItem : selectedItwItems){
+        updateItemSelection(itwItem, true);
+    }
 
     if(!upOrDownKeyPressed){
         projectRootItem->endItemSelectionChanges();
@@ -1535,27 +1576,20 @@ void ItemTreeWidget::Impl::onTreeWidgetSelectionChanged()
 }
 
 
-void ItemTreeWidget::Impl::updateItemSelectionIter(QTreeWidgetItem* twItem, unordered_set<Item*>& selectedItemSet)
+void ItemTreeWidget::Impl::updateItemSelection(ItwItem* itwItem, bool on)
 {
-    if(auto itwItem = dynamic_cast<ItwItem*>(twItem)){
-        auto item = itwItem->item;
-        bool on = selectedItemSet.find(item) != selectedItemSet.end();
-        bool doUpdate = (on != item->isSelected());
-        bool isCurrent = (item == lastClickedItem) && on;
-        if(!doUpdate){
-            if(isCurrent && (item != projectRootItem->currentItem())){
-                doUpdate = true;
-            }
-        }
-        if(doUpdate){
-            itwItem->itemSelectionConnection.block();
-            item->setSelected(on, isCurrent);
-            itwItem->itemSelectionConnection.unblock();
+    auto item = itwItem->item;
+    bool doUpdate = (on != item->isSelected());
+    bool isCurrent = (item == lastClickedItem) && on;
+    if(!doUpdate){
+        if(isCurrent && (item != projectRootItem->currentItem())){
+            doUpdate = true;
         }
     }
-    int n = twItem->childCount();
-    for(int i=0; i < n; ++i){
-        updateItemSelectionIter(twItem->child(i), selectedItemSet);
+    if(doUpdate){
+        itwItem->itemSelectionConnection.block();
+        item->setSelected(on, isCurrent);
+        itwItem->itemSelectionConnection.unblock();
     }
 }
 
@@ -1589,6 +1623,12 @@ void ItemTreeWidget::Impl::setItwItemSelected(ItwItem* itwItem, bool on)
         itwItem->setSelected(on);
         treeWidgetSelectionChangeConnections.unblock();
 
+        if(on){
+            itemsSelectedInTreeWidget.insert(itwItem->item);
+        } else {
+            itemsSelectedInTreeWidget.erase(itwItem->item);
+        }
+
         if(sigSelectionChanged.hasConnections()){
             sigSelectionChanged(getSelectedItems());
         }
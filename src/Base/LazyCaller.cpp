@@ -9,10 +9,18 @@
 #include <QThread>
 #include <QSemaphore>
 #include <memory>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <climits>
 
 using namespace std;
 using namespace cnoid;
 
+namespace cnoid {
+class LazyCallerImpl;
+}
+
 namespace {
 
 inline int toQtPriority(int priority) {
@@ -85,6 +93,34 @@ public:
 };
     
 CallEventHandler callEventHandler;
+
+
+class LowPriorityCallScheduler : public QObject
+{
+public:
+    struct Entry
+    {
+        LazyCallerImpl* caller;
+        int numDeferredCycles;
+        unsigned int sequenceNumber;
+    };
+    vector<Entry> pendingEntries;
+    vector<Entry> entriesInCycle;
+    double timeBudget;
+    unsigned int sequenceCounter;
+    bool isDispatchEventPosted;
+    int dispatchEventPriority;
+
+    LowPriorityCallScheduler();
+    void request(LazyCallerImpl* caller);
+    void remove(LazyCallerImpl* caller);
+    void postDispatchEvent();
+    virtual bool event(QEvent* e);
+    void executeCycle();
+};
+
+LowPriorityCallScheduler lowPriorityCallScheduler;
+
 }
 
 namespace cnoid {
@@ -98,6 +134,8 @@ public:
     bool isConservative;
     LazyCallerImpl(LazyCaller* self);
     LazyCallerImpl(LazyCaller* self, const std::function<void(void)>& function, int priority);
+    bool isScheduled() const { return priority >= LazyCaller::LowPriority; }
+    void invoke();
     virtual bool event(QEvent* e);
 };
 
@@ -239,6 +277,8 @@ void LazyCaller::setConservative(bool on)
 void LazyCaller::cancel()
 {
     if(isPending_){
+        // The priority may have been changed after the request
+        lowPriorityCallScheduler.remove(impl);
         QCoreApplication::removePostedEvents(impl);
         isPending_ = false;
     }
@@ -247,18 +287,43 @@ void LazyCaller::cancel()
 
 void LazyCaller::flush()
 {
-    if(isPending_){
-        QCoreApplication::removePostedEvents(impl);
-        isPending_ = false;
-    }
+    cancel();
     impl->function();
 }
 
 
 void LazyCaller::postCallEvent()
 {
-    CallEvent* event = new CallEvent(impl->function);
-    QCoreApplication::postEvent(impl, event, toQtPriority(impl->priority));
+    if(impl->isScheduled()){
+        lowPriorityCallScheduler.request(impl);
+    } else {
+        CallEvent* event = new CallEvent(impl->function);
+        QCoreApplication::postEvent(impl, event, toQtPriority(impl->priority));
+    }
+}
+
+
+void LazyCaller::setTimeBudgetForLowPriorityCalls(double time)
+{
+    lowPriorityCallScheduler.timeBudget = time;
+}
+
+
+double LazyCaller::timeBudgetForLowPriorityCalls()
+{
+    return lowPriorityCallScheduler.timeBudget;
+}
+
+
+void LazyCallerImpl::invoke()
+{
+    if(isConservative){
+        function();
+        self->isPending_ = false;
+    } else {
+        self->isPending_ = false;
+        function();
+    }
 }
 
 
@@ -279,6 +344,140 @@ bool LazyCallerImpl::event(QEvent* e)
 }
 
 
+LowPriorityCallScheduler::LowPriorityCallScheduler()
+{
+    timeBudget = 0.008;
+    sequenceCounter = 0;
+    isDispatchEventPosted = false;
+    dispatchEventPriority = INT_MIN;
+}
+
+
+/**
+   A caller is requested only when it is not pending, so the same caller is never
+   contained in the pending entries twice.
+*/
+void LowPriorityCallScheduler::request(LazyCallerImpl* caller)
+{
+    Entry entry;
+    entry.caller = caller;
+    entry.numDeferredCycles = 0;
+    entry.sequenceNumber = sequenceCounter++;
+    pendingEntries.push_back(entry);
+
+    int qtPriority = toQtPriority(caller->priority);
+    if(!isDispatchEventPosted || qtPriority > dispatchEventPriority){
+        QCoreApplication::postEvent(this, new QEvent(QEvent::User), qtPriority);
+        isDispatchEventPosted = true;
+        dispatchEventPriority = qtPriority;
+    }
+}
+
+
+void LowPriorityCallScheduler::remove(LazyCallerImpl* caller)
+{
+    for(auto& entry : entriesInCycle){
+        if(entry.caller == caller){
+            entry.caller = nullptr;
+        }
+    }
+    pendingEntries.erase(
+        std::remove_if(pendingEntries.begin(), pendingEntries.end(),
+                       [caller](const Entry& entry){ return entry.caller == caller; }),
+        pendingEntries.end());
+}
+
+
+void LowPriorityCallScheduler::postDispatchEvent()
+{
+    int priority = LazyCaller::MinimumPriority;
+    for(auto& entry : pendingEntries){
+        priority = std::min(priority, entry.caller->priority - entry.numDeferredCycles);
+    }
+    int qtPriority = toQtPriority(std::max(priority, static_cast<int>(LazyCaller::LowPriority)));
+    if(isDispatchEventPosted && qtPriority <= dispatchEventPriority){
+        return;
+    }
+    QCoreApplication::postEvent(this, new QEvent(QEvent::User), qtPriority);
+    isDispatchEventPosted = true;
+    dispatchEventPriority = qtPriority;
+}
+
+
+bool LowPriorityCallScheduler::event(QEvent* e)
+{
+    if(e->type() == QEvent::User){
+        isDispatchEventPosted = false;
+        if(!pendingEntries.empty() && entriesInCycle.empty()){
+            executeCycle();
+        }
+        return true;
+    }
+    return QObject::event(e);
+}
+
+
+/**
+   The calls requested while executing a cycle are executed in the next cycle so that a
+   function requesting its own call again cannot occupy the event loop.
+*/
+void LowPriorityCallScheduler::executeCycle()
+{
+    entriesInCycle.swap(pendingEntries);
+
+    std::stable_sort(
+        entriesInCycle.begin(), entriesInCycle.end(),
+        [](const Entry& e1, const Entry& e2){
+            int p1 = e1.caller->priority - e1.numDeferredCycles;
+            int p2 = e2.caller->priority - e2.numDeferredCycles;
+            if(p1 != p2){
+                return p1 < p2;
+            }
+            return e1.sequenceNumber < e2.sequenceNumber;
+        });
+
+    auto startTime = std::chrono::steady_clock::now();
+    bool isTimeBudgetUsedUp = false;
+    size_t index = 0;
+    
+    while(index < entriesInCycle.size()){
+        // At least one call is executed in a cycle
+        if(index > 0){
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - startTime;
+            if(elapsed.count() >= timeBudget){
+                isTimeBudgetUsedUp = true;
+                break;
+            }
+        }
+        auto caller = entriesInCycle[index++].caller;
+        if(caller){
+            // The caller may be removed from the scheduler while executing the function
+            entriesInCycle[index - 1].caller = nullptr;
+            caller->invoke();
+        }
+    }
+
+    if(isTimeBudgetUsedUp){
+        vector<Entry> deferredEntries;
+        deferredEntries.reserve(entriesInCycle.size() - index + pendingEntries.size());
+        for(size_t i = index; i < entriesInCycle.size(); ++i){
+            auto& entry = entriesInCycle[i];
+            if(entry.caller){
+                ++entry.numDeferredCycles;
+                deferredEntries.push_back(entry);
+            }
+        }
+        deferredEntries.insert(deferredEntries.end(), pendingEntries.begin(), pendingEntries.end());
+        pendingEntries.swap(deferredEntries);
+    }
+    entriesInCycle.clear();
+
+    if(!pendingEntries.empty()){
+        postDispatchEvent();
+    }
+}
+
+
 QueuedCaller::QueuedCaller()
 {
     impl = new QueuedCallerImpl();
@@ -73,6 +73,18 @@ public:
 
     void cancel();
 
+    /**
+       The calls of the low and minimum priorities are executed by a scheduler so that
+       the GUI can keep processing the input events while the calls are requested at a high
+       rate. The scheduler executes the pending calls in the order of the priority until the
+       time budget of an event loop cycle is used up, and the remaining calls are deferred to
+       the next cycle. The priority of a deferred call is raised by one level in each cycle so
+       that the calls of the lower priority are not starved.
+       \param time The time budget in seconds. The default value is 0.008.
+    */
+    static void setTimeBudgetForLowPriorityCalls(double time);
+    static double timeBudgetForLowPriorityCalls();
+
 private:
     void postCallEvent();
 };
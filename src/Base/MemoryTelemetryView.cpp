@@ -0,0 +1,133 @@
+#include "MemoryTelemetryView.h"
+#include "ViewManager.h"
+#include "Timer.h"
+#include <cnoid/MemoryTelemetry>
+#include <QTableWidget>
+#include <QHeaderView>
+#include <QBoxLayout>
+#include "gettext.h"
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+enum ColumnId {
+    NameColumn, SizeColumn, ObjectColumn, AllocationColumn, SizeRateColumn, AllocationRateColumn,
+    NumColumns
+};
+
+}
+
+namespace cnoid {
+
+/**
+   The table shows the records of the memory telemetry, which are sampled periodically while the
+   view is active. The rates are the changes from the previous sampling of the view.
+*/
+class MemoryTelemetryView::Impl : public QTableWidget
+{
+public:
+    MemoryTelemetry::Sampler sampler;
+    Timer updateTimer;
+
+    Impl();
+    void updateTable();
+    void setText(int row, int column, const QString& text);
+};
+
+}
+
+
+void MemoryTelemetryView::initializeClass(ExtensionManager* ext)
+{
+    ext->viewManager().registerClass<MemoryTelemetryView>(
+        N_("MemoryTelemetryView"), N_("Memory Telemetry"));
+}
+
+
+MemoryTelemetryView::MemoryTelemetryView()
+{
+    impl = new Impl;
+
+    QVBoxLayout* vbox = new QVBoxLayout();
+    vbox->addWidget(impl);
+    setLayout(vbox);
+
+    setDefaultLayoutArea(BottomRightArea);
+}
+
+
+MemoryTelemetryView::Impl::Impl()
+{
+    setFrameShape(QFrame::NoFrame);
+    setColumnCount(NumColumns);
+    setSelectionMode(QAbstractItemView::NoSelection);
+    setHorizontalHeaderLabels(
+        { _("Subsystem"), _("Size [KiB]"), _("Objects"), _("Allocations"),
+          _("Growth [KiB/s]"), _("Allocations [1/s]") });
+
+    QHeaderView* hh = horizontalHeader();
+    hh->setSectionResizeMode(QHeaderView::ResizeToContents);
+    hh->setStretchLastSection(true);
+    verticalHeader()->hide();
+
+    updateTimer.setInterval(1000);
+    updateTimer.sigTimeout().connect([this](){ updateTable(); });
+}
+
+
+MemoryTelemetryView::~MemoryTelemetryView()
+{
+    delete impl;
+}
+
+
+void MemoryTelemetryView::onActivated()
+{
+    impl->updateTable();
+    impl->updateTimer.start();
+}
+
+
+void MemoryTelemetryView::onDeactivated()
+{
+    impl->updateTimer.stop();
+}
+
+
+void MemoryTelemetryView::Impl::updateTable()
+{
+    auto& records = sampler.sample();
+    setRowCount(records.size());
+    int row = 0;
+    for(auto& record : records){
+        setText(row, NameColumn, record.name.c_str());
+        setText(row, SizeColumn, QString::number(record.bytes / 1024.0, 'f', 1));
+        setText(row, ObjectColumn, (record.numObjects >= 0) ? QString::number(record.numObjects) : QString("-"));
+        setText(row, AllocationColumn,
+                (record.numAllocations >= 0) ? QString::number(record.numAllocations) : QString("-"));
+        setText(row, SizeRateColumn, QString::number(record.bytesPerSecond / 1024.0, 'f', 1));
+        setText(row, AllocationRateColumn,
+                (record.numAllocations >= 0) ? QString::number(record.allocationsPerSecond, 'f', 1) : QString("-"));
+        ++row;
+    }
+}
+
+
+//! The existing item is reused so that the table is updated without recreating the items.
+void MemoryTelemetryView::Impl::setText(int row, int column, const QString& text)
+{
+    if(auto tableItem = item(row, column)){
+        if(tableItem->text() != text){
+            tableItem->setText(text);
+        }
+    } else {
+        tableItem = new QTableWidgetItem(text);
+        tableItem->setFlags(Qt::ItemIsEnabled);
+        if(column != NameColumn){
+            tableItem->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
+        }
+        setItem(row, column, tableItem);
+    }
+}
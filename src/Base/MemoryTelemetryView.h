@@ -0,0 +1,27 @@
+#ifndef CNOID_BASE_MEMORY_TELEMETRY_VIEW_H
+#define CNOID_BASE_MEMORY_TELEMETRY_VIEW_H
+
+#include "View.h"
+
+namespace cnoid {
+
+class MemoryTelemetryView : public View
+{
+public:
+    static void initializeClass(ExtensionManager* ext);
+
+    MemoryTelemetryView();
+    ~MemoryTelemetryView();
+
+protected:
+    virtual void onActivated() override;
+    virtual void onDeactivated() override;
+
+private:
+    class Impl;
+    Impl* impl;
+};
+
+}
+
+#endif
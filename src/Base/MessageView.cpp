@@ -10,14 +10,19 @@
 #include "TextEdit.h"
 #include <cnoid/MessageManager>
 #include <cnoid/Tokenizer>
+#include <cnoid/MemoryTelemetry>
 #include <fmt/format.h>
 #include <QBoxLayout>
 #include <QMessageBox>
 #include <QCoreApplication>
 #include <QThread>
+#include <QTimer>
+#include <QTextDocument>
 #include <boost/iostreams/concepts.hpp>
 #include <boost/iostreams/stream_buffer.hpp>
 #include <stack>
+#include <deque>
+#include <mutex>
 #include <regex>
 #include <iostream>
 #include "gettext.h"
@@ -42,6 +47,12 @@ int flushingRef = 0;
 
 const bool PUT_COUT_TOO = false;
 
+// The interval of rendering the messages put from the threads other than the main thread
+const int queuedMessageRenderingInterval = 30; // ms
+
+// The maximum number of the queued messages rendered at a time. The older messages are omitted.
+const int maxNumQueuedMessagesToRender = 1000;
+
 class TextSink : public iostreams::sink
 {
 public:
@@ -52,46 +63,25 @@ public:
     bool doFlush;
 };
 
-enum MvCommand { MV_PUT, MV_CLEAR };
-
-
+/**
+   This event is posted to process the messages queued by the threads other than the main thread.
+*/
 class MessageViewEvent : public QEvent
 {
 public:
-    MessageViewEvent(const string& message, bool doLF, bool doNotify, bool doFlush)
-        : QEvent(QEvent::User),
-          command(MV_PUT),
-          message(message),
-          doLF(doLF),
-          doNotify(doNotify),
-          doFlush(doFlush)
-    {
-        
-    }
-
-    MessageViewEvent(string&& message, bool doLF, bool doNotify, bool doFlush)
-        : QEvent(QEvent::User),
-          command(MV_PUT),
-          message(message),
-          doLF(doLF),
-          doNotify(doNotify),
-          doFlush(doFlush)
-    {
-        
-    }
-    
-    MessageViewEvent(MvCommand command)
-        : QEvent(QEvent::User),
-          command(command)
-    {
+    MessageViewEvent() : QEvent(QEvent::User) { }
+};
 
-    }
-        
-    MvCommand command;
+struct QueuedMessage
+{
     string message;
     bool doLF;
     bool doNotify;
-    bool doFlush;
+    bool isClearCommand;
+    QueuedMessage(string&& message, bool doLF, bool doNotify)
+        : message(std::move(message)), doLF(doLF), doNotify(doNotify), isClearCommand(false) { }
+    QueuedMessage()
+        : doLF(false), doNotify(false), isClearCommand(true) { }
 };
 
 class TextEditEx : public TextEdit
@@ -136,15 +126,26 @@ public:
     bool exitEventLoopRequested;
     bool hasErrorMessages;
 
+    std::mutex queueMutex;
+    deque<QueuedMessage> messageQueue;
+    int messageQueueCapacity;
+    int numDroppedMessages;
+    bool isMessageQueueEventPosted;
+    QTimer queuedMessageTimer;
+
     Signal<void(const std::string& text)> sigMessage;
 
+    ScopedConnection memoryTelemetryConnection;
+
     Impl(MessageView* self);
     void createTextEdit();
 
     void put(const string& message, int type, bool doLF, bool doNotify, bool doFlush, bool isMovable);
     void put(const std::string& message, bool doLF, bool doNotify, bool doFlush, bool isMovable);
     void doPut(const string& message, bool doLF, bool doNotify, bool doFlush, bool isMovable);
-    void handleMessageViewEvent(MessageViewEvent* event);
+    void putText(const string& message, bool doLF, bool doNotify, bool isMovable);
+    void enqueue(QueuedMessage&& message);
+    void processQueuedMessages();
     void flush();
     void doClear();
     void clear();
@@ -154,6 +155,7 @@ public:
     void inttoColor(int n, QColor& col);
     void applySelectGraphicRenditionCommands(const vector<int>& commands);
     void extractEscapeSequence(string& txt);
+    void reportMemoryUsage();
 };
 
 }
@@ -284,10 +286,21 @@ MessageView::Impl::Impl(MessageView* self) :
 
     hasErrorMessages = false;
 
+    messageQueueCapacity = 100000;
+    numDroppedMessages = 0;
+    isMessageQueueEventPosted = false;
+    queuedMessageTimer.setSingleShot(true);
+    queuedMessageTimer.setInterval(queuedMessageRenderingInterval);
+    QObject::connect(&queuedMessageTimer, &QTimer::timeout, [this](){ processQueuedMessages(); });
+
     MessageManager::master()->addSink(
         [this](const std::string& message, int type){
             put(message, type, false, false, true);
         });
+
+    memoryTelemetryConnection =
+        MemoryTelemetry::instance()->sigSampling().connect(
+            [this](){ reportMemoryUsage(); });
 }
 
 
@@ -383,7 +396,7 @@ void MessageView::Impl::clear()
     if(QThread::currentThreadId() == mainThreadId){
         doClear();
     } else {
-        QCoreApplication::postEvent(self, new MessageViewEvent(MV_CLEAR), Qt::NormalEventPriority);
+        enqueue(QueuedMessage());
     }
 }
 
@@ -526,17 +539,126 @@ void MessageView::Impl::put(const std::string& message, bool doLF, bool doNotify
     if(QThread::currentThreadId() == mainThreadId){
         doPut(message, doLF, doNotify, doFlush, isMovable);
     } else {
-        MessageViewEvent* event;
-        if(isMovable){
-            event = new MessageViewEvent(std::move(message), doLF, doNotify, false);
-        } else {
-            event = new MessageViewEvent(message, doLF, doNotify, false);
+        string text(message);
+        enqueue(QueuedMessage(std::move(text), doLF, doNotify));
+    }
+}
+
+
+/**
+   The messages put from the other threads are queued and rendered together at a limited rate
+   so that the threads that put many messages do not block the main thread. When the queue is
+   full, the oldest message is dropped.
+*/
+void MessageView::Impl::enqueue(QueuedMessage&& message)
+{
+    bool doPostEvent = false;
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        if(static_cast<int>(messageQueue.size()) >= messageQueueCapacity){
+            messageQueue.pop_front();
+            ++numDroppedMessages;
         }
-        QCoreApplication::postEvent(self, event, Qt::NormalEventPriority);
+        messageQueue.push_back(std::move(message));
+        if(!isMessageQueueEventPosted){
+            isMessageQueueEventPosted = true;
+            doPostEvent = true;
+        }
+    }
+    if(doPostEvent){
+        QCoreApplication::postEvent(self, new MessageViewEvent, Qt::NormalEventPriority);
     }
 }
 
 
+/**
+   All the queued messages are passed to sigMessage so that MessageLogItem can record them,
+   but only the latest ones are rendered in the text edit.
+*/
+void MessageView::Impl::processQueuedMessages()
+{
+    deque<QueuedMessage> messages;
+    int numDropped;
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        messages.swap(messageQueue);
+        numDropped = numDroppedMessages;
+        numDroppedMessages = 0;
+        isMessageQueueEventPosted = false;
+    }
+    if(messages.empty()){
+        return;
+    }
+
+    int lastClearIndex = -1;
+    const int n = messages.size();
+    for(int i = n - 1; i >= 0; --i){
+        if(messages[i].isClearCommand){
+            lastClearIndex = i;
+            break;
+        }
+    }
+    if(lastClearIndex >= 0){
+        doClear();
+    }
+    const int renderingBeginIndex = std::max(lastClearIndex + 1, n - maxNumQueuedMessagesToRender);
+    
+    bool isLatestMessageVisible = textEdit->isLatestMessageVisible();
+    if(isLatestMessageVisible){
+        textEdit->moveCursor(QTextCursor::End);
+    }
+
+    if(numDropped > 0){
+        putText(format("\x1b[31m{0}\x1b[0m", format(_("{0} message(s) were dropped."), numDropped)),
+                true, false, true);
+    }
+
+    for(int i=0; i < n; ++i){
+        auto& m = messages[i];
+        if(m.isClearCommand){
+            continue;
+        }
+        if(i >= renderingBeginIndex){
+            if(i == renderingBeginIndex && i > lastClearIndex + 1){
+                int numOmitted = renderingBeginIndex - lastClearIndex - 1;
+                putText(format("\x1b[31m{0}\x1b[0m", format(_("{0} message(s) were omitted."), numOmitted)),
+                        true, false, true);
+            }
+            putText(m.message, m.doLF, m.doNotify, true);
+        } else if(sigMessage.hasConnections()){
+            sigMessage(m.doLF ? (m.message + "\n") : m.message);
+        }
+    }
+
+    if(isLatestMessageVisible){
+        textEdit->ensureCursorVisible();
+    }
+}
+
+
+//! The text of the document is counted as UTF-16, and the layout data of the document is not counted.
+void MessageView::Impl::reportMemoryUsage()
+{
+    auto telemetry = MemoryTelemetry::instance();
+
+    auto document = textEdit->document();
+    telemetry->report(
+        "Message view text", static_cast<int64_t>(document->characterCount()) * sizeof(QChar),
+        document->blockCount());
+
+    int64_t queueBytes = 0;
+    int64_t numQueuedMessages;
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        for(auto& message : messageQueue){
+            queueBytes += sizeof(QueuedMessage) + message.message.capacity();
+        }
+        numQueuedMessages = messageQueue.size();
+    }
+    telemetry->report("Message view queue", queueBytes, numQueuedMessages);
+}
+
+
 void MessageView::Impl::doPut(const string& message, bool doLF, bool doNotify, bool doFlush, bool isMovable)
 {
     bool isLatestMessageVisible = textEdit->isLatestMessageVisible();
@@ -544,6 +666,20 @@ void MessageView::Impl::doPut(const string& message, bool doLF, bool doNotify, b
         textEdit->moveCursor(QTextCursor::End);
     }
 
+    putText(message, doLF, doNotify, isMovable);
+
+    if(isLatestMessageVisible){
+        textEdit->ensureCursorVisible();
+    }
+    
+    if(doFlush){
+        flush();
+    }
+}
+
+
+void MessageView::Impl::putText(const string& message, bool doLF, bool doNotify, bool isMovable)
+{
     if(PUT_COUT_TOO){
         std::cout << message;
         if(doLF){
@@ -592,43 +728,21 @@ void MessageView::Impl::doPut(const string& message, bool doLF, bool doNotify, b
             insertPlainText(text, doLF);
         }
     }
-
-    if(isLatestMessageVisible){
-        textEdit->ensureCursorVisible();
-    }
-    
-    if(doFlush){
-        flush();
-    }
 }
 
 
 bool MessageView::event(QEvent* e)
 {
-    MessageViewEvent* event = dynamic_cast<MessageViewEvent*>(e);
-    if(event){
-        impl->handleMessageViewEvent(event);
+    if(dynamic_cast<MessageViewEvent*>(e)){
+        if(!impl->queuedMessageTimer.isActive()){
+            impl->queuedMessageTimer.start();
+        }
         return true;
     }
     return false;
 }
 
 
-void MessageView::Impl::handleMessageViewEvent(MessageViewEvent* event)
-{
-    switch(event->command){
-    case MV_PUT:
-        doPut(event->message, event->doLF, event->doNotify, event->doFlush, true);
-        break;
-    case MV_CLEAR:
-        doClear();
-        break;
-    default:
-        break;
-    }
-}
-
-
 int MessageView::currentColumn()
 {
     QTextCursor cursor = impl->textEdit->textCursor();
@@ -650,6 +764,11 @@ void MessageView::flush()
 void MessageView::Impl::flush()
 {
     ++flushingRef;
+
+    if(QThread::currentThreadId() == mainThreadId){
+        queuedMessageTimer.stop();
+        processQueuedMessages();
+    }
         
     QCoreApplication::processEvents(
         QEventLoop::ExcludeUserInputEvents | QEventLoop::ExcludeSocketNotifiers, 1.0);
@@ -676,6 +795,19 @@ bool MessageView::hasErrorMessages() const
 }
 
 
+void MessageView::setMessageQueueCapacity(int n)
+{
+    std::lock_guard<std::mutex> lock(impl->queueMutex);
+    impl->messageQueueCapacity = std::max(1, n);
+}
+
+
+int MessageView::messageQueueCapacity() const
+{
+    return impl->messageQueueCapacity;
+}
+
+
 std::string MessageView::messages() const
 {
     return impl->textEdit->toPlainText().toStdString();
@@ -83,6 +83,14 @@ public:
 
     bool hasErrorMessages() const;
 
+    /**
+       The messages put from the threads other than the main thread are queued and rendered
+       at a limited rate. When the number of the queued messages exceeds the capacity, the
+       oldest messages are dropped and the number of them is shown in the view.
+    */
+    void setMessageQueueCapacity(int n);
+    int messageQueueCapacity() const;
+
     std::string messages() const;
 
     class Impl;
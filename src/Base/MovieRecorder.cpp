@@ -113,6 +113,7 @@ public:
 
     deque<CapturedImagePtr> capturedImages;
     vector<quint32> tmpImageBuf;
+    SceneWidget* asyncCaptureSceneWidget;
     std::thread encoderThread;
     std::mutex imageQueueMutex;
     std::condition_variable imageQueueCondition;
@@ -144,6 +145,9 @@ public:
     void startDirectModeRecording();
     void onDirectModeTimerTimeout();
     void captureViewImage(bool waitForPrevOutput);
+    bool requestSceneImageCapture(SceneWidget* sceneWidget, bool waitForPrevOutput);
+    void pushCapturedImage(CapturedImage* captured, bool waitForPrevOutput);
+    bool getMouseCursorImage(QImage& out_image, QPoint& out_position);
     void drawMouseCursorImage(QPainter& painter);
     void captureSceneWidgets(QWidget* widget, QPixmap& pixmap);
     void startEncoding();
@@ -209,6 +213,7 @@ MovieRecorder::Impl::Impl(MovieRecorder* self)
     isStartingTimeSpecified = false;
     isFinishingTimeSpecified = false;
     isCapturingMouseCursorEnabled = false;
+    asyncCaptureSceneWidget = nullptr;
     isImageSizeSpecified = false;
     imageWidth = 640;
     imageHeight = 480;
@@ -842,10 +847,15 @@ void MovieRecorder::Impl::onDirectModeTimerTimeout()
 
 void MovieRecorder::Impl::captureViewImage(bool waitForPrevOutput)
 {
+    SceneView* sceneView = dynamic_cast<SceneView*>(targetView);
+    if(sceneView && requestSceneImageCapture(sceneView->sceneWidget(), waitForPrevOutput)){
+        return;
+    }
+    
     CapturedImagePtr captured = new CapturedImage;
     captured->frame = frame;
     
-    if(SceneView* sceneView = dynamic_cast<SceneView*>(targetView)){
+    if(sceneView){
         captured->image = sceneView->sceneWidget()->getImage();
         if(isCapturingMouseCursorEnabled){
             QPainter painter(&stdx::get<QImage>(captured->image));
@@ -862,6 +872,48 @@ void MovieRecorder::Impl::captureViewImage(bool waitForPrevOutput)
         }
     }
 
+    pushCapturedImage(captured, waitForPrevOutput);
+}
+
+
+/**
+   The image of the scene view is captured asynchronously so that the main thread does not wait
+   for the read back of the framebuffer. The mouse cursor is captured at the time of the request
+   so that its position corresponds to the frame, and it is only drawn on the region of the cursor
+   when the image is available. The captured image is passed to the encoder as it is.
+*/
+bool MovieRecorder::Impl::requestSceneImageCapture(SceneWidget* sceneWidget, bool waitForPrevOutput)
+{
+    QImage cursorImage;
+    QPoint cursorPosition;
+    if(isCapturingMouseCursorEnabled){
+        if(getMouseCursorImage(cursorImage, cursorPosition)){
+            cursorImage = cursorImage.copy();
+        }
+    }
+    int capturedFrame = frame;
+    
+    bool requested = sceneWidget->requestImageCapture(
+        [this, capturedFrame, cursorImage, cursorPosition, waitForPrevOutput](QImage& image){
+            if(!cursorImage.isNull()){
+                QPainter painter(&image);
+                painter.drawImage(cursorPosition, cursorImage);
+            }
+            CapturedImagePtr captured = new CapturedImage;
+            captured->frame = capturedFrame;
+            captured->image = std::move(image);
+            pushCapturedImage(captured, waitForPrevOutput);
+        });
+
+    if(requested){
+        asyncCaptureSceneWidget = sceneWidget;
+    }
+    return requested;
+}
+
+
+void MovieRecorder::Impl::pushCapturedImage(CapturedImage* captured, bool waitForPrevOutput)
+{
     {
         std::unique_lock<std::mutex> lock(imageQueueMutex);
         if(waitForPrevOutput){
@@ -875,33 +927,42 @@ void MovieRecorder::Impl::captureViewImage(bool waitForPrevOutput)
 }
 
 
-void MovieRecorder::Impl::drawMouseCursorImage(QPainter& painter)
+/**
+   \note The returned image may refer to the temporary buffer, so it must be copied to keep it
+   after the next call of this function.
+*/
+bool MovieRecorder::Impl::getMouseCursorImage(QImage& out_image, QPoint& out_position)
 {
+    bool result = false;
 #ifdef Q_OS_LINUX
     XFixesCursorImage* cursor = XFixesGetCursorImage(QX11Info::display());
     if(cursor){
         if(cursor->pixels){
-            QImage cursorImage;
-            if(sizeof(long) == 4){
-                cursorImage = QImage((uchar*)cursor->pixels,
-                                     cursor->width, cursor->height,
-                                     QImage::Format_ARGB32);
-            } else {
-                tmpImageBuf.resize(cursor->width * cursor->height);
-                for(size_t i=0; i < tmpImageBuf.size(); ++i){
-                    tmpImageBuf[i] = (quint32)cursor->pixels[i];
-                }
-                cursorImage = QImage((uchar*)(&tmpImageBuf.front()),
-                                     cursor->width, cursor->height,
-                                     QImage::Format_ARGB32);
+            tmpImageBuf.resize(cursor->width * cursor->height);
+            for(size_t i=0; i < tmpImageBuf.size(); ++i){
+                tmpImageBuf[i] = (quint32)cursor->pixels[i];
             }
-            QPoint mousePos = QCursor::pos() - targetView->mapToGlobal(QPoint(0, 0));
-            mousePos -= QPoint(cursor->xhot, cursor->yhot);
-            painter.drawImage(mousePos, cursorImage);
+            out_image = QImage((uchar*)(&tmpImageBuf.front()),
+                               cursor->width, cursor->height,
+                               QImage::Format_ARGB32);
+            out_position = QCursor::pos() - targetView->mapToGlobal(QPoint(0, 0));
+            out_position -= QPoint(cursor->xhot, cursor->yhot);
+            result = true;
         }
         XFree(cursor);
     }
 #endif
+    return result;
+}
+
+
+void MovieRecorder::Impl::drawMouseCursorImage(QPainter& painter)
+{
+    QImage cursorImage;
+    QPoint position;
+    if(getMouseCursorImage(cursorImage, position)){
+        painter.drawImage(position, cursorImage);
+    }
 }
 
 
@@ -994,6 +1055,11 @@ void MovieRecorder::Impl::stopRecording(bool isFinished)
     if(isRecording){
 
         stopBlinking();
+
+        if(asyncCaptureSceneWidget){
+            asyncCaptureSceneWidget->finishImageCaptures();
+            asyncCaptureSceneWidget = nullptr;
+        }
         
         int numRemainingImages = 0;
         {
@@ -890,7 +890,7 @@ bool MultiPointSetItem::Impl::outputPointSetItem(int index)
         string fullPathString = toUTF8((autoSaveFilePath.parent_path() / path).string());
 
         try {
-            cnoid::savePCD(item->pointSet(), fullPathString, item->offsetPosition());
+            cnoid::savePCD(item->pointSet(), fullPathString, item->offsetPosition(), PCD_BINARY);
 
             MappingPtr info = new Mapping();
             info->write("file", filename);
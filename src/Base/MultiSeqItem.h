@@ -33,6 +33,8 @@ public:
           seq_(std::make_shared<MultiSeqType>(*org.seq_)) { }
 
     virtual ~MultiSeqItem() { }
+
+    virtual size_t getMemoryUsage() const override { return seq_->allocatedBytes(); }
  
 protected:
     /**
@@ -10,12 +10,14 @@
 #include "AppConfig.h"
 #include "MainWindow.h"
 #include "Action.h"
+#include "StartupProfiler.h"
 #include <cnoid/MessageManager>
 #include <cnoid/ExecutablePath>
 #include <cnoid/Tokenizer>
 #include <cnoid/Config>
 #include <cnoid/FileUtil>
 #include <cnoid/UTF8>
+#include <cnoid/YAMLReader>
 #include <cnoid/stdx/filesystem>
 #include <QLibrary>
 #include <QRegExp>
@@ -24,6 +26,7 @@
 #include <map>
 #include <set>
 #include <list>
+#include <chrono>
 #include <fmt/format.h>
 
 #ifdef Q_OS_WIN32
@@ -72,6 +75,9 @@ struct PluginInfo
     int status;
     bool areAllRequisitiesResolved;
     bool doReloading;
+    bool isOnDemand;
+    double loadingTime;
+    double initializationTime;
     Action* aboutMenuItem;
     DescriptionDialog* aboutDialog;
     string lastErrorMessage;
@@ -81,11 +87,19 @@ struct PluginInfo
         status = PluginManager::NOT_LOADED;
         areAllRequisitiesResolved = false;
         doReloading = false;
+        isOnDemand = false;
+        loadingTime = 0.0;
+        initializationTime = 0.0;
         aboutMenuItem = nullptr;
         aboutDialog = nullptr;
     }
 };
 
+double getElapsedTime(const std::chrono::steady_clock::time_point& startTime)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+}
+
 }
 
 namespace cnoid {
@@ -127,9 +141,11 @@ public:
     void addPluginPath(const std::string& path);
     void loadPlugins(bool doActivation);
     void scanPluginFiles(const std::string& pathString, bool isUTF8, bool isRecursive);
+    void readPluginManifest(PluginInfo* info, const filesystem::path& pluginPath);
     void loadScannedPluginFiles(bool doActivation);
     bool loadPlugin(int index);
     bool activatePlugin(int index);
+    bool activateOnDemandPlugin(const std::string& name);
     bool unloadPlugin(int index);
     bool unloadPlugin(const std::string& name, bool doReloading);
     bool finalizePlugin(PluginInfoPtr info);
@@ -312,6 +328,7 @@ void PluginManager::Impl::scanPluginFiles(const std::string& pathString, bool is
                     // Set a tentative name extracted from the plugin file name
                     info->name = pluginNamePattern.cap(1).toStdString();
                     info->pathString = pathStringUtf8;
+                    readPluginManifest(info.get(), pluginPath);
                     allPluginInfos.push_back(info);
                     pathToPluginInfoMap[info->pathString] = info;
                 }
@@ -321,13 +338,45 @@ void PluginManager::Impl::scanPluginFiles(const std::string& pathString, bool is
 }
 
 
+/**
+   A plugin can have a manifest file, which is a YAML file that has the same base name as the
+   plugin file and is put in the same directory. If the manifest has "on_demand: true", the
+   plugin is not loaded at startup, and it is loaded and activated when it is required by
+   another plugin or when an item of the plugin is created by its plugin name, such as when
+   a project containing the item is loaded. The "name" key can be used to specify the plugin
+   name if it is different from the name extracted from the file name. A plugin that adds
+   menus, tool bars or views should not be an on-demand plugin because they are not available
+   until the plugin is loaded.
+*/
+void PluginManager::Impl::readPluginManifest(PluginInfo* info, const filesystem::path& pluginPath)
+{
+    filesystem::path manifestPath(pluginPath);
+    manifestPath.replace_extension(".yaml");
+    if(!filesystem::exists(manifestPath)){
+        return;
+    }
+    string manifestFile = toUTF8(manifestPath.string());
+    YAMLReader reader;
+    if(!reader.load(manifestFile) || reader.numDocuments() != 1 || !reader.document()->isMapping()){
+        msg->putErrorln(
+            format(_("The manifest file \"{0}\" of the plugin cannot be loaded.\n{1}"),
+                   manifestFile, reader.errorMessage()));
+        return;
+    }
+    auto manifest = reader.document()->toMapping();
+    manifest->read("name", info->name);
+    info->isOnDemand = manifest->get("on_demand", false);
+}
+
+
 void PluginManager::Impl::loadScannedPluginFiles(bool doActivation)
 {
     while(true){
         int numLoaded = 0;
         int numNotLoaded = 0;
         for(size_t i=0; i < allPluginInfos.size(); ++i){
-            if(allPluginInfos[i]->status == PluginManager::NOT_LOADED){
+            auto& info = allPluginInfos[i];
+            if(info->status == PluginManager::NOT_LOADED && !info->isOnDemand){
                 if(loadPlugin(i)){
                     ++numLoaded;
                 } else {
@@ -408,6 +457,8 @@ bool PluginManager::Impl::loadPlugin(int index)
             msg->put(fmt::format(_("Detecting plugin file \"{}\".\n"), info->pathString));
         }
 
+        auto startTime = std::chrono::steady_clock::now();
+
         info->dll.setFileName(info->pathString.c_str());
 
         /*
@@ -447,6 +498,12 @@ bool PluginManager::Impl::loadPlugin(int index)
 
                 } else {
                     info->status = PluginManager::LOADED;
+                    info->loadingTime = getElapsedTime(startTime);
+                    if(StartupProfiler::isEnabled()){
+                        StartupProfiler::addEvent(
+                            format("Loading {}", filesystem::path(info->pathString).filename().string()),
+                            "Plugin", startTime, std::chrono::steady_clock::now());
+                    }
                     info->name = plugin->name();
                     plugin->setFilePath(info->pathString.c_str());
 
@@ -527,6 +584,11 @@ bool PluginManager::Impl::activatePlugin(int index)
         for(size_t i=0; i < info->requisites.size(); ++i){
             const string& requisiteName = info->requisites[i];
             PluginMap::iterator q = nameToPluginInfoMap.find(requisiteName);
+            if(q == nameToPluginInfoMap.end()){
+                if(activateOnDemandPlugin(requisiteName)){
+                    q = nameToPluginInfoMap.find(requisiteName);
+                }
+            }
             if(q == nameToPluginInfoMap.end()){
                 requisitesActive = false;
                 break;
@@ -546,6 +608,8 @@ bool PluginManager::Impl::activatePlugin(int index)
         if(requisitesActive){
 
             info->areAllRequisitiesResolved = true;
+
+            auto startTime = std::chrono::steady_clock::now();
                 
             if(!info->plugin->initialize()){
                 info->status = PluginManager::INVALID;
@@ -554,6 +618,12 @@ bool PluginManager::Impl::activatePlugin(int index)
             } else {
                 info->status = PluginManager::ACTIVE;
                 info->plugin->isActive_ = true;
+                info->initializationTime = getElapsedTime(startTime);
+                if(StartupProfiler::isEnabled()){
+                    StartupProfiler::addEvent(
+                        format("Initializing {}Plugin", info->name),
+                        "Plugin", startTime, std::chrono::steady_clock::now());
+                }
                 
                 pluginsInDeactivationOrder.push_front(info);
 
@@ -586,7 +656,9 @@ bool PluginManager::Impl::activatePlugin(int index)
                         make_pair(info->plugin->oldName(i), info->name));
                 }
                 
-                msg->put(fmt::format(_("{}-plugin has been activated.\n"), info->name));
+                msg->put(
+                    fmt::format(_("{0}-plugin has been activated ({1:.0f} ms to load, {2:.0f} ms to initialize).\n"),
+                                info->name, info->loadingTime * 1000.0, info->initializationTime * 1000.0));
             }
         }
     }
@@ -599,6 +671,32 @@ bool PluginManager::Impl::activatePlugin(int index)
 }
 
 
+bool PluginManager::activateOnDemandPlugin(const std::string& name)
+{
+    return impl->activateOnDemandPlugin(name);
+}
+
+
+bool PluginManager::Impl::activateOnDemandPlugin(const std::string& name)
+{
+    for(size_t i=0; i < allPluginInfos.size(); ++i){
+        auto& info = allPluginInfos[i];
+        if(info->isOnDemand && info->name == name){
+            if(info->status == PluginManager::NOT_LOADED){
+                if(!loadPlugin(i)){
+                    return false;
+                }
+            }
+            if(info->status == PluginManager::LOADED){
+                activatePlugin(i);
+            }
+            return (info->status == PluginManager::ACTIVE);
+        }
+    }
+    return false;
+}
+
+
 bool PluginManager::reloadPlugin(const std::string& name)
 {
     return impl->unloadPlugin(name, true);
@@ -791,6 +889,13 @@ const std::string& PluginManager::pluginName(int index) const
 }
 
 
+double PluginManager::pluginLoadingTime(int index) const
+{
+    auto& info = impl->allPluginInfos[index];
+    return info->loadingTime + info->initializationTime;
+}
+
+
 int PluginManager::pluginStatus(int index) const
 {
     return impl->allPluginInfos[index]->status;
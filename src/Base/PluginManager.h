@@ -24,6 +24,14 @@ public:
     void doStartupLoading();
     void loadPlugins(bool doActivation);
     bool loadPlugin(int index);
+
+    /**
+       This function loads and activates a plugin that is specified as an on-demand plugin in
+       its manifest file and has not been loaded yet.
+       \return true if the plugin is active.
+    */
+    bool activateOnDemandPlugin(const std::string& name);
+    
     bool reloadPlugin(const std::string& name);
     bool unloadPlugin(int index);
     bool unloadPlugin(const std::string& name);
@@ -34,6 +42,8 @@ public:
     int numPlugins() const;
     const std::string& pluginPath(int index) const;
     const std::string& pluginName(int index) const;
+    //! The time in seconds taken to load and initialize the plugin
+    double pluginLoadingTime(int index) const;
 
     enum PluginStatus { NOT_LOADED, LOADED, ACTIVE, FINALIZED, UNLOADED, INVALID, CONFLICT };
     int pluginStatus(int index) const;
@@ -9,6 +9,7 @@
 #include "MenuManager.h"
 #include "PutPropertyFunction.h"
 #include "Archive.h"
+#include "LazyCaller.h"
 #include <cnoid/EigenArchive>
 #include <cnoid/SceneWidget>
 #include <cnoid/SceneWidgetEventHandler>
@@ -17,6 +18,9 @@
 #include <cnoid/PointSetUtil>
 #include <cnoid/PolyhedralRegion>
 #include <cnoid/Exception>
+#include <thread>
+#include <atomic>
+#include <memory>
 #include "gettext.h"
 
 using namespace std;
@@ -24,6 +28,12 @@ using namespace cnoid;
 
 namespace {
 
+// The octree is used for the point set having at least this number of points
+constexpr int MinNumPointsForOctreeRendering = 1000000;
+
+// The preview rendered while the octree is being built has at most this number of points
+constexpr int MaxNumOctreePreviewPoints = 1000000;
+
 class ScenePointSet;
 
 class ScenePointSet : public SgPosTransform, public SceneWidgetEventHandler
@@ -43,15 +53,26 @@ public:
     ScopedConnection eraserModeMenuItemConnection;
     bool isEditable_;
 
+    bool isOctreeRenderingEnabled_;
+    // The octree scene, or the preview point set while the octree is being built
+    SgNodePtr octreeScene;
+    std::thread octreeBuildThread;
+    std::atomic<bool> isOctreeBuildCanceled;
+    // The result of the build is discarded if the token has been released
+    std::shared_ptr<int> octreeBuildToken;
+
     Signal<void(const Isometry3& T)> sigOffsetPositionChanged;
     
     Signal<void()> sigAttentionPointsChanged;
     SgGroupPtr attentionPointMarkerGroup;
     
     ScenePointSet(PointSetItem::Impl* pointSetItem);
+    ~ScenePointSet();
 
     void setPointSize(double size);
     void setVoxelSize(double size);
+    void setOctreeRenderingEnabled(bool on);
+    bool isOctreeRenderingEnabled() const { return isOctreeRenderingEnabled_; }
     int numAttentionPoints() const;
     Vector3 attentionPoint(int index) const;
     void clearAttentionPoints(bool doNotify);
@@ -61,6 +82,10 @@ public:
     void notifyAttentionPointChange();
     void updateVisualization(bool updateContents);
     void updateVisiblePointSet();
+    void updateOctree();
+    SgPointSet* createOctreePreview();
+    void cancelOctreeBuild();
+    void onOctreeBuilt(SgNode* octree);
     void updateVoxels();
     bool isEditable() const { return isEditable_; }
     void setEditable(bool on) { isEditable_ = on; }
@@ -102,33 +127,73 @@ public:
 }
 
 
-static bool loadPCD(PointSetItem* item, const std::string& filename, std::ostream& os)
+namespace {
+
+class PCDFileIO : public ItemFileIoBase<PointSetItem>
 {
-    try {
-        cnoid::loadPCD(item->pointSet(), filename);
-        os << item->pointSet()->vertices()->size() << " points have been loaded.";
-        item->pointSet()->notifyUpdate();
-        return true;
-    } catch (boost::exception& ex) {
-        if(std::string const * message = boost::get_error_info<error_info_message>(ex)){
-            os << *message;
-        }
+public:
+    PCDFileIO()
+        : ItemFileIoBase<PointSetItem>("PCD-FILE", Load | Save | Prefetch)
+    {
+        setCaption(_("Point Cloud (PCD)"));
+        setExtension("pcd");
+        setInterfaceLevel(Conversion);
     }
-    return false;
-}
 
+    virtual ReferencedPtr prefetch(const std::string& filename, std::ostream& os) override
+    {
+        SgPointSetPtr pointSet = new SgPointSet;
+        try {
+            if(!cnoid::loadPCD(pointSet, filename, setPrefetchProgress, isPrefetchCanceled)){
+                return nullptr;
+            }
+        } catch (boost::exception& ex) {
+            if(std::string const * message = boost::get_error_info<error_info_message>(ex)){
+                os << *message;
+            }
+            return nullptr;
+        }
+        return pointSet;
+    }
 
-static bool saveAsPCD(PointSetItem* item, const std::string& filename, std::ostream& os)
-{
-    try {
-        cnoid::savePCD(item->pointSet(), filename, item->offsetPosition());
+    virtual bool load(PointSetItem* item, const std::string& filename) override
+    {
+        auto pointSet = item->pointSet();
+        if(auto prefetched = dynamic_pointer_cast<SgPointSet>(takePrefetchedData(filename))){
+            pointSet->setVertices(prefetched->vertices());
+            pointSet->setNormals(prefetched->normals());
+            pointSet->normalIndices().clear();
+            pointSet->setColors(prefetched->colors());
+            pointSet->colorIndices().clear();
+        } else {
+            try {
+                cnoid::loadPCD(pointSet, filename);
+            } catch (boost::exception& ex) {
+                if(std::string const * message = boost::get_error_info<error_info_message>(ex)){
+                    os() << *message;
+                }
+                return false;
+            }
+        }
+        os() << pointSet->vertices()->size() << " points have been loaded.";
+        pointSet->notifyUpdate();
         return true;
-    } catch (boost::exception& ex) {
-        if(std::string const * message = boost::get_error_info<error_info_message>(ex)){
-            os << *message;
+    }
+
+    virtual bool save(PointSetItem* item, const std::string& filename) override
+    {
+        try {
+            cnoid::savePCD(item->pointSet(), filename, item->offsetPosition(), PCD_BINARY);
+            return true;
+        } catch (boost::exception& ex) {
+            if(std::string const * message = boost::get_error_info<error_info_message>(ex)){
+                os() << *message;
+            }
         }
+        return false;
     }
-    return false;
+};
+
 }
 
 
@@ -139,13 +204,7 @@ void PointSetItem::initializeClass(ExtensionManager* ext)
         ItemManager& im = ext->itemManager();
         im.registerClass<PointSetItem>(N_("PointSetItem"));
         im.addCreationPanel<PointSetItem>();
-        im.addLoaderAndSaver<PointSetItem>(
-            _("Point Cloud (PCD)"), "PCD-FILE", "pcd",
-            [](PointSetItem* item, const std::string& filename, std::ostream& os, Item*){
-                return ::loadPCD(item, filename, os); },
-            [](PointSetItem* item, const std::string& filename, std::ostream& os, Item*){
-                return ::saveAsPCD(item, filename, os); },
-            ItemManager::PRIORITY_CONVERSION);
+        im.addFileIO<PointSetItem>(new PCDFileIO);
         
         initialized = true;
     }
@@ -182,6 +241,7 @@ PointSetItem::Impl::Impl(PointSetItem* self, const Impl& org)
     pointSet = new SgPointSet(*org.pointSet);
     scene = new ScenePointSet(this);
     scene->T() = org.scene->T();
+    scene->setOctreeRenderingEnabled(org.scene->isOctreeRenderingEnabled());
 
     initialize();
 }
@@ -334,6 +394,18 @@ void PointSetItem::setVoxelSize(double size)
 }
 
 
+void PointSetItem::setOctreeRenderingEnabled(bool on)
+{
+    impl->scene->setOctreeRenderingEnabled(on);
+}
+
+
+bool PointSetItem::isOctreeRenderingEnabled() const
+{
+    return impl->scene->isOctreeRenderingEnabled();
+}
+
+
 void PointSetItem::setEditable(bool on)
 {
     impl->scene->setEditable(on);
@@ -430,6 +502,9 @@ void PointSetItem::removePoints(const PolyhedralRegion& region)
 
 void PointSetItem::Impl::removePoints(const PolyhedralRegion& region)
 {
+    // The points being read by the octree building must not be modified
+    scene->cancelOctreeBuild();
+
     vector<int> indicesToRemove;
     const Isometry3 T = scene->T();
     SgVertexArray orgPoints(*pointSet->vertices());
@@ -537,6 +612,8 @@ void PointSetItem::doPutProperties(PutPropertyFunction& putProperty)
     putProperty.decimals(4)
         (_("Voxel size"), voxelSize(),
          [=](double size){ scene->setVoxelSize(size); return true; });
+    putProperty(_("Octree LOD"), isOctreeRenderingEnabled(),
+                [=](bool on){ scene->setOctreeRenderingEnabled(on); return true; });
     
     putProperty(_("Editable"), isEditable(), [&](bool on){ return impl->onEditableChanged(on); });
     const SgVertexArray* points = impl->pointSet->vertices();
@@ -585,6 +662,7 @@ bool PointSetItem::store(Archive& archive)
     archive.write("rendering_mode", scene->renderingMode.selectedSymbol());
     archive.write("point_size", pointSize());
     archive.write("voxel_size", scene->voxelSize);
+    archive.write("octree_lod", isOctreeRenderingEnabled());
     archive.write("is_editable", isEditable());
     
     return true;
@@ -617,6 +695,7 @@ bool PointSetItem::restore(const Archive& archive)
     }
     scene->setPointSize(archive.get({ "point_size", "pointSize" }, pointSize()));
     scene->setVoxelSize(archive.get({ "voxel_size", "voxelSize" }, voxelSize()));
+    scene->setOctreeRenderingEnabled(archive.get("octree_lod", isOctreeRenderingEnabled()));
     setEditable(archive.get({ "is_editable", "isEditable" }, isEditable()));
 
     std::string filename, formatId;
@@ -658,6 +737,26 @@ ScenePointSet::ScenePointSet(PointSetItem::Impl* pointSetItemImpl)
         [&](SceneWidgetEvent* event){ onContextMenuRequestInEraserMode(event); });
 
     isEditable_ = false;
+    isOctreeRenderingEnabled_ = true;
+    isOctreeBuildCanceled = false;
+}
+
+
+ScenePointSet::~ScenePointSet()
+{
+    cancelOctreeBuild();
+}
+
+
+void setPointSizeInSubTree(SgNode* node, double size)
+{
+    if(auto pointSet = dynamic_cast<SgPointSet*>(node)){
+        pointSet->setPointSize(size);
+    } else if(auto group = dynamic_cast<SgGroup*>(node)){
+        for(auto& child : *group){
+            setPointSizeInSubTree(child, size);
+        }
+    }
 }
 
 
@@ -665,6 +764,9 @@ void ScenePointSet::setPointSize(double size)
 {
     if(size != visiblePointSet->pointSize()){
         visiblePointSet->setPointSize(size);
+        if(octreeScene){
+            setPointSizeInSubTree(octreeScene, size);
+        }
         if(renderingMode.is(PointSetItem::POINT) && invariant){
             updateVisualization(false);
         }
@@ -682,6 +784,17 @@ void ScenePointSet::setVoxelSize(double size)
 }
 
 
+void ScenePointSet::setOctreeRenderingEnabled(bool on)
+{
+    if(on != isOctreeRenderingEnabled_){
+        isOctreeRenderingEnabled_ = on;
+        if(renderingMode.is(PointSetItem::POINT) && invariant){
+            updateVisualization(true);
+        }
+    }
+}
+
+
 int ScenePointSet::numAttentionPoints() const
 {
     return attentionPointMarkerGroup ? attentionPointMarkerGroup->numChildren() : 0;
@@ -775,19 +888,26 @@ void ScenePointSet::updateVisualization(bool updateContents)
 {
     if(invariant){
         removeChild(invariant);
-        invariant->removeChild(visiblePointSet);
-        invariant->removeChild(voxels);
+        invariant->clearChildren();
     }
     invariant = new SgInvariantGroup;
     
     if(renderingMode.is(PointSetItem::POINT)){
         if(updateContents){
             updateVisiblePointSet();
+            updateOctree();
+        }
+        if(octreeScene){
+            invariant->addChild(octreeScene);
+        } else {
+            invariant->addChild(visiblePointSet);
         }
-        invariant->addChild(visiblePointSet);
     } else {
         if(updateContents){
             updateVoxels();
+            // The octree is built again when the point rendering mode is updated
+            cancelOctreeBuild();
+            octreeScene.reset();
         }
         invariant->addChild(voxels);
     }
@@ -808,6 +928,103 @@ void ScenePointSet::updateVisiblePointSet()
 }
 
 
+void ScenePointSet::updateOctree()
+{
+    cancelOctreeBuild();
+    octreeScene.reset();
+
+    auto vertices = visiblePointSet->vertices();
+    if(!isOctreeRenderingEnabled_ || !vertices ||
+       static_cast<int>(vertices->size()) < MinNumPointsForOctreeRendering){
+        return;
+    }
+
+    octreeScene = createOctreePreview();
+
+    // The arrays are referred by another object because those of the visible point set may be replaced
+    SgPointSetPtr source = new SgPointSet;
+    source->setVertices(vertices);
+    source->setNormals(visiblePointSet->normals());
+    source->normalIndices() = visiblePointSet->normalIndices();
+    source->setColors(visiblePointSet->colors());
+    source->colorIndices() = visiblePointSet->colorIndices();
+    source->setPointSize(visiblePointSet->pointSize());
+
+    isOctreeBuildCanceled = false;
+    octreeBuildToken = std::make_shared<int>(0);
+    std::weak_ptr<int> token = octreeBuildToken;
+    
+    octreeBuildThread = std::thread(
+        [this, source, token](){
+            SgNodePtr octree = createOctreePointSetScene(
+                source, 2.0, 128, [this](){ return isOctreeBuildCanceled.load(); });
+            if(octree){
+                callFromMainThread([this, token, octree](){
+                    if(!token.expired()){
+                        onOctreeBuilt(octree);
+                    }
+                });
+            }
+        });
+}
+
+
+//! The points are thinned out at regular intervals to be rendered quickly
+SgPointSet* ScenePointSet::createOctreePreview()
+{
+    auto preview = new SgPointSet;
+    preview->setPointSize(visiblePointSet->pointSize());
+    
+    const SgVertexArray& orgVertices = *visiblePointSet->vertices();
+    const int n = orgVertices.size();
+    const int interval = n / MaxNumOctreePreviewPoints + 1;
+    const int m = (n + interval - 1) / interval;
+    auto& vertices = *preview->getOrCreateVertices(m);
+    for(int i=0; i < m; ++i){
+        vertices[i] = orgVertices[i * interval];
+    }
+    if(visiblePointSet->hasColors()){
+        const SgColorArray& orgColors = *visiblePointSet->colors();
+        const SgIndexArray& orgColorIndices = visiblePointSet->colorIndices();
+        auto& colors = *preview->getOrCreateColors(m);
+        for(int i=0; i < m; ++i){
+            const int index = i * interval;
+            colors[i] = orgColors[orgColorIndices.empty() ? index : orgColorIndices[index]];
+        }
+    }
+    return preview;
+}
+
+
+void ScenePointSet::cancelOctreeBuild()
+{
+    if(octreeBuildThread.joinable()){
+        isOctreeBuildCanceled = true;
+        octreeBuildThread.join();
+    }
+    octreeBuildToken.reset();
+}
+
+
+void ScenePointSet::onOctreeBuilt(SgNode* octree)
+{
+    octreeBuildThread.join();
+    octreeBuildToken.reset();
+
+    setPointSizeInSubTree(octree, visiblePointSet->pointSize());
+
+    // The invariant group is replaced without clearing the attention points
+    if(invariant && invariant->contains(octreeScene)){
+        removeChild(invariant);
+        invariant->clearChildren();
+        invariant = new SgInvariantGroup;
+        invariant->addChild(octree);
+        addChild(invariant, update);
+    }
+    octreeScene = octree;
+}
+
+
 void ScenePointSet::updateVoxels()
 {
     SgMeshPtr mesh;
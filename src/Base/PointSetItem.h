@@ -63,6 +63,14 @@ public:
     static double defaultVoxelSize();
     double voxelSize() const;
     void setVoxelSize(double size);
+
+    /**
+       A large point set is rendered with the levels of detail of an octree if this is enabled,
+       which is the default. The octree is built in a background thread and the thinned out
+       points are rendered until the building finishes.
+    */
+    void setOctreeRenderingEnabled(bool on);
+    bool isOctreeRenderingEnabled() const;
     
     void setEditable(bool on);
     bool isEditable() const;
@@ -174,6 +174,8 @@ public:
     OffsetEditRecord(const OffsetEditRecord& org);
     virtual EditRecord* clone() const override;
     virtual std::string label() const override;
+    virtual bool merge(const EditRecord* nextRecord) override;
+    virtual size_t memoryUsage() const override;
     virtual bool undo() override;
     virtual bool redo() override;
 };
@@ -196,6 +198,8 @@ public:
     void setTags(PositionTag* newTag0, PositionTag* oldTag0);
     virtual EditRecord* clone() const override;
     virtual std::string label() const override;
+    virtual bool merge(const EditRecord* nextRecord) override;
+    virtual size_t memoryUsage() const override;
     virtual bool undo() override;
     virtual bool redo() override;
 };
@@ -1629,6 +1633,22 @@ std::string OffsetEditRecord::label() const
 }
 
 
+bool OffsetEditRecord::merge(const EditRecord* nextRecord)
+{
+    if(auto next = dynamic_cast<const OffsetEditRecord*>(nextRecord)){
+        T_new = next->T_new;
+        return true;
+    }
+    return false;
+}
+
+
+size_t OffsetEditRecord::memoryUsage() const
+{
+    return sizeof(OffsetEditRecord);
+}
+
+
 bool OffsetEditRecord::undo()
 {
     static_cast<PositionTagGroupItem*>(targetObject())->setOriginOffset(T_old, true);
@@ -1706,6 +1726,33 @@ std::string TagEditRecord::label() const
 }
 
 
+//! The consecutive updates of the same tag such as dragging the tag are merged.
+bool TagEditRecord::merge(const EditRecord* nextRecord)
+{
+    if(action == UpdateAction){
+        auto next = dynamic_cast<const TagEditRecord*>(nextRecord);
+        if(next && next->action == UpdateAction && next->tagIndex == tagIndex){
+            *newTag = *next->newTag;
+            return true;
+        }
+    }
+    return false;
+}
+
+
+size_t TagEditRecord::memoryUsage() const
+{
+    size_t usage = sizeof(TagEditRecord);
+    if(newTag){
+        usage += sizeof(PositionTag);
+    }
+    if(oldTag){
+        usage += sizeof(PositionTag);
+    }
+    return usage;
+}
+
+
 bool TagEditRecord::undo()
 {
     bool done = false;
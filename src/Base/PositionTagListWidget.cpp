@@ -2,6 +2,7 @@
 #include "MenuManager.h"
 #include "PositionTagGroupItem.h"
 #include "DisplayValueFormat.h"
+#include "LazyCaller.h"
 #include <cnoid/PositionTagGroup>
 #include <cnoid/PositionTag>
 #include <cnoid/EigenUtil>
@@ -35,9 +36,19 @@ public:
     QFont monoFont;
     DisplayValueFormat* valueFormat;
     bool isProcessingInternalMove;
+
+    /*
+      The tags appended to the end of the group are notified to the view in a batch so that
+      loading a large number of tags does not cause the row insertion for each tag.
+      The view only knows the tags before the pending appended ones.
+    */
+    int numKnownTags;
+    int numPendingAppendedTags;
+    LazyCaller flushPendingAppendedTagsLater;
     
     TagGroupModel(PositionTagListWidget* widget);
     void setTagGroupItem(PositionTagGroupItem* tagGroupItem);
+    void flushPendingAppendedTags();
     int numTags() const;
     PositionTag* tagAt(const QModelIndex& index) const;
     
@@ -95,6 +106,9 @@ TagGroupModel::TagGroupModel(PositionTagListWidget* widget)
     monoFont.setStyleHint(QFont::TypeWriter);
     valueFormat = DisplayValueFormat::instance();
     isProcessingInternalMove = false;
+    numKnownTags = 0;
+    numPendingAppendedTags = 0;
+    flushPendingAppendedTagsLater.setFunction([this](){ flushPendingAppendedTags(); });
 }
 
 
@@ -103,6 +117,9 @@ void TagGroupModel::setTagGroupItem(PositionTagGroupItem* tagGroupItem)
     beginResetModel();
 
     this->tagGroupItem = tagGroupItem;
+    numKnownTags = tagGroupItem ? tagGroupItem->tagGroup()->numTags() : 0;
+    numPendingAppendedTags = 0;
+    flushPendingAppendedTagsLater.cancel();
 
     tagGroupConnections.disconnect();
     if(tagGroupItem){
@@ -122,12 +139,33 @@ void TagGroupModel::setTagGroupItem(PositionTagGroupItem* tagGroupItem)
 }
 
 
-int TagGroupModel::numTags() const
+void TagGroupModel::flushPendingAppendedTags()
 {
-    if(tagGroupItem){
-        return tagGroupItem->tagGroup()->numTags();
+    flushPendingAppendedTagsLater.cancel();
+    
+    if(numPendingAppendedTags > 0){
+        if(numKnownTags == 0){
+            // Replace the empty row
+            beginResetModel();
+            numKnownTags = numPendingAppendedTags;
+            numPendingAppendedTags = 0;
+            endResetModel();
+        } else {
+            beginInsertRows(QModelIndex(), numKnownTags, numKnownTags + numPendingAppendedTags - 1);
+            numKnownTags += numPendingAppendedTags;
+            numPendingAppendedTags = 0;
+            endInsertRows();
+        }
+#ifdef Q_OS_WIN32
+        widget->resizeColumnToContents(IndexColumn);
+#endif
     }
-    return 0;
+}
+
+
+int TagGroupModel::numTags() const
+{
+    return numKnownTags;
 }
 
 
@@ -321,12 +359,17 @@ bool TagGroupModel::dropMimeData
 
 void TagGroupModel::onTagAdded(int tagIndex)
 {
-    if(numTags() == 0){
-        // Remove the empty row first
-        beginRemoveRows(QModelIndex(), 0, 0);
-        endRemoveRows();
+    if(tagIndex == numKnownTags + numPendingAppendedTags){
+        ++numPendingAppendedTags;
+        flushPendingAppendedTagsLater();
+        return;
     }
+
+    // The tag is inserted before the end, so the view already has a row for a tag
+    flushPendingAppendedTags();
+
     beginInsertRows(QModelIndex(), tagIndex, tagIndex);
+    ++numKnownTags;
     endInsertRows();
 
     /*
@@ -343,9 +386,18 @@ void TagGroupModel::onTagAdded(int tagIndex)
 
 void TagGroupModel::onTagRemoved(int tagIndex)
 {
+    if(tagIndex >= numKnownTags){
+        // The tag has not been notified to the view yet
+        --numPendingAppendedTags;
+        return;
+    }
+    
+    flushPendingAppendedTags();
+    
     beginRemoveRows(QModelIndex(), tagIndex, tagIndex);
+    --numKnownTags;
     endRemoveRows();
-    if(numTags() == 0){
+    if(numKnownTags == 0){
         // This is necessary to show the empty row
         beginResetModel();
         endResetModel();
@@ -359,6 +411,9 @@ void TagGroupModel::onTagRemoved(int tagIndex)
 
 void TagGroupModel::onTagPositionChanged(int tagIndex)
 {
+    if(tagIndex >= numKnownTags){
+        return;
+    }
     auto modelIndex = index(tagIndex, PositionColumn, QModelIndex());
     Q_EMIT dataChanged(modelIndex, modelIndex, { Qt::EditRole });
 }
@@ -401,6 +456,8 @@ PositionTagListWidget::PositionTagListWidget(QWidget* parent)
     hheader->setMinimumSectionSize(24);
     hheader->setSectionResizeMode(IndexColumn, QHeaderView::ResizeToContents);
     hheader->setSectionResizeMode(PositionColumn, QHeaderView::Stretch);
+    // Only the visible rows are used to fit the column to the contents
+    hheader->setResizeContentsPrecision(0);
     verticalHeader()->hide();
 
     connect(this, &QTableView::pressed,
@@ -446,6 +503,7 @@ void PositionTagListWidget::setTagGroupItem(PositionTagGroupItem* item)
 
 int PositionTagListWidget::currentTagIndex() const
 {
+    impl->tagGroupModel->flushPendingAppendedTags();
     auto current = selectionModel()->currentIndex();
     return current.isValid() ? current.row() : impl->tagGroupModel->numTags();
 }
@@ -453,6 +511,7 @@ int PositionTagListWidget::currentTagIndex() const
 
 void PositionTagListWidget::setCurrentTagIndex(int tagIndex)
 {
+    impl->tagGroupModel->flushPendingAppendedTags();
     selectionModel()->setCurrentIndex(
         impl->tagGroupModel->index(tagIndex, 0, QModelIndex()),
         QItemSelectionModel::SelectCurrent | QItemSelectionModel::Rows | QItemSelectionModel::Clear);
@@ -482,13 +541,14 @@ void PositionTagListWidget::removeSelectedTags()
 {
     if(impl->tagGroupItem){
         auto tags = impl->tagGroupItem->tagGroup();
-        auto selected = selectionModel()->selectedRows();
-        std::sort(selected.begin(), selected.end());
-        int numRemoved = 0;
-        for(auto& index : selected){
-            int tagIndex = index.row() - numRemoved;
-            tags->removeAt(tagIndex);
-            ++numRemoved;
+        vector<int> rows;
+        for(auto& index : selectionModel()->selectedRows()){
+            rows.push_back(index.row());
+        }
+        // Removing the tags from the back does not change the indices of the remaining ones
+        std::sort(rows.begin(), rows.end(), std::greater<int>());
+        for(auto& row : rows){
+            tags->removeAt(row);
         }
     }
 }
@@ -572,10 +632,22 @@ void PositionTagListWidget::Impl::onTagSelectionChanged()
 {
     isSelectionBeingUpdatedByTagSelectionChange = true;
 
+    tagGroupModel->flushPendingAppendedTags();
+
+    // Merging each row into the selection is quadratic, so the contiguous rows are put as a range
+    vector<int> indices = tagGroupItem->selectedTagIndices();
+    std::sort(indices.begin(), indices.end());
     QItemSelection selection;
-    for(auto& index : tagGroupItem->selectedTagIndices()){
-        QItemSelection row(tagGroupModel->index(index, 0), tagGroupModel->index(index, LastColumn));
-        selection.merge(row, QItemSelectionModel::Select);
+    size_t i = 0;
+    while(i < indices.size()){
+        size_t j = i + 1;
+        while(j < indices.size() && indices[j] <= indices[j - 1] + 1){
+            ++j;
+        }
+        selection.append(
+            QItemSelectionRange(
+                tagGroupModel->index(indices[i], 0), tagGroupModel->index(indices[j - 1], LastColumn)));
+        i = j;
     }
     self->selectionModel()->select(selection, QItemSelectionModel::ClearAndSelect);
 
@@ -612,6 +684,7 @@ void PositionTagListWidget::dropEvent(QDropEvent *event)
 {
     if(event->source() == this &&
        (event->dropAction() == Qt::MoveAction || dragDropMode() == QAbstractItemView::InternalMove)){
+        impl->tagGroupModel->flushPendingAppendedTags();
         impl->tagGroupModel->isProcessingInternalMove = true;
         QTableView::dropEvent(event);
         impl->tagGroupModel->isProcessingInternalMove = false;
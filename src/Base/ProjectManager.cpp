@@ -16,11 +16,13 @@
 #include "AppUtil.h"
 #include "FileDialog.h"
 #include "MainWindow.h"
+#include "StartupProfiler.h"
 #include <cnoid/YAMLReader>
 #include <cnoid/YAMLWriter>
 #include <cnoid/FilePathVariableProcessor>
 #include <cnoid/ExecutablePath>
 #include <cnoid/UTF8>
+#include <cnoid/Tracer>
 #include <cnoid/stdx/filesystem>
 #include <QResource>
 #include <QMessageBox>
@@ -331,6 +333,8 @@ ItemList<> ProjectManager::Impl::loadProject
 (const std::string& filename, Item* parentItem,
  bool isInvokingApplication, bool isBuiltinProject, bool doClearExistingProject)
 {
+    CNOID_TRACE_ZONE("Project loading", "Loading");
+
     ItemList<> topLevelItems;
     
     if(doClearExistingProject){
@@ -343,6 +347,9 @@ ItemList<> ProjectManager::Impl::loadProject
     
     ++projectBeingLoadedCounter;
 
+    StartupProfiler::Scope projectStage(
+        isBuiltinProject ? string("Loading the builtin project") : format("Loading {}", filename), "Project");
+
     bool loaded = false;
     YAMLReader reader;
     reader.setMappingClass<Archive>();
@@ -398,10 +405,14 @@ ItemList<> ProjectManager::Impl::loadProject
                 }
             }
 
+            StartupProfiler::Scope viewStage("View restoration", "Project");
             ViewManager::ViewStateInfo viewStateInfo;
             if(ViewManager::restoreViews(archive, "views", viewStateInfo, optionalPlugins)){
                 loaded = true;
             }
+            viewStage.end();
+
+            StartupProfiler::Scope layoutStage("Layout restoration", "Project");
 
             MainWindow* mainWindow = MainWindow::instance();
             if(isInvokingApplication){
@@ -416,6 +427,7 @@ ItemList<> ProjectManager::Impl::loadProject
                     mainWindow->restoreLayout(archive);
                 }
             }
+            layoutStage.end();
 
             ArchiverMapMap::iterator p;
             for(p = archivers.begin(); p != archivers.end(); ++p){
@@ -461,7 +473,11 @@ ItemList<> ProjectManager::Impl::loadProject
             if(items->isValid()){
                 items->inheritSharedInfoFrom(*archive);
 
+                StartupProfiler::Scope itemStage("Item tree restoration", "Project");
+                Item::beginTreeChanges();
                 topLevelItems = itemTreeArchiver.restore(items, parentItem, optionalPlugins);
+                Item::endTreeChanges();
+                itemStage.end();
                 
                 numArchivedItems = itemTreeArchiver.numArchivedItems();
                 numRestoredItems = itemTreeArchiver.numRestoredItems();
@@ -602,7 +618,18 @@ bool ProjectManager::saveProject(const string& filename, Item* item)
 
 bool ProjectManager::Impl::saveProject(const string& filename, Item* item)
 {
-    YAMLWriter writer(filename);
+    /*
+      The project is written to a temporary file in the same directory, which replaces the
+      existing project file after the writing is finished. This prevents the project file from
+      being broken when the saving fails or is interrupted. Note that the data files of the items
+      are written by the store functions of the items, which only write the files of the items
+      whose data has been modified since the files were loaded or saved.
+    */
+    filesystem::path projectFilePath(fromUTF8(filename));
+    filesystem::path tmpFilePath(projectFilePath);
+    tmpFilePath += ".tmp";
+    
+    YAMLWriter writer(toUTF8(tmpFilePath.string()));
     if(!writer.isFileOpen()){
         mv->put(
             format(_("Can't open file \"{}\" for writing.\n"), filename),
@@ -682,14 +709,29 @@ bool ProjectManager::Impl::saveProject(const string& filename, Item* item)
         saved = true;
     }
 
+    std::error_code ec;
+    
     if(saved){
         writer.setKeyOrderPreservationMode(true);
         writer.putNode(archive);
+        writer.closeFile();
+        filesystem::rename(tmpFilePath, projectFilePath, ec);
+        if(ec){
+            mv->putln(
+                format(_("The project file \"{0}\" cannot be replaced: {1}"), filename, ec.message()),
+                MessageView::Error);
+            saved = false;
+        }
+    }
+
+    if(saved){
         mv->notify(_("Saving the project file has been finished."));
         if(!isSubProject){
             setCurrentProjectFile(filename);
         }
     } else {
+        writer.closeFile();
+        filesystem::remove(tmpFilePath, ec);
         mv->notify(_("Saving the project file failed."), MessageView::Error);
         clearCurrentProjectFile();
     }
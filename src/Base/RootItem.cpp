@@ -9,7 +9,11 @@
 #include "ProjectManager.h"
 #include "MenuManager.h"
 #include "Archive.h"
+#include <cnoid/Tracer>
+#include <cnoid/MemoryTelemetry>
 #include <fmt/format.h>
+#include <unordered_map>
+#include <unordered_set>
 #include <iostream>
 #include "gettext.h"
 
@@ -71,10 +75,18 @@ public:
     Signal<void(Item* assigned, const Item* srcItem)> sigItemAssigned;
     Signal<void(Item* item, const std::string& oldName)> sigItemNameChanged;
 
+    unordered_map<string, unordered_set<Item*>> nameToItemsMap;
+    unordered_map<int, unordered_set<Item*>> classIdToItemsMap;
+
+    ScopedConnection memoryTelemetryConnection;
+
     Impl(RootItem* self);
+    void addSubTreeToIndex(Item* item);
+    void removeSubTreeFromIndex(Item* item);
     void selectItemIter(Item* item, Item* itemToSelect);
     bool updateSelectedItemsIter(Item* item);
     void updateCheckedItemsIter(Item* item, int checkId, ItemList<>& checkedItems);
+    void reportMemoryUsage();
 };
 
 }
@@ -98,6 +110,19 @@ CheckEntry::CheckEntry(const CheckEntry& org)
 }
 
 
+template<class Key>
+void removeFromIndex(unordered_map<Key, unordered_set<Item*>>& indexMap, const Key& key, Item* item)
+{
+    auto p = indexMap.find(key);
+    if(p != indexMap.end()){
+        p->second.erase(item);
+        if(p->second.empty()){
+            indexMap.erase(p);
+        }
+    }
+}
+
+
 void putItemTreeWithPolymorphicIds()
 {
     auto& registry = ItemClassRegistry::instance();
@@ -170,6 +195,10 @@ RootItem::Impl::Impl(RootItem* self)
                 isProjectBeingLoaded = false;
             }
         });
+
+    memoryTelemetryConnection =
+        MemoryTelemetry::instance()->sigSampling().connect(
+            [this](){ reportMemoryUsage(); });
 }
 
 
@@ -281,6 +310,8 @@ void RootItem::notifyEventOnSubTreeAdded(Item* item, std::vector<Item*>& orgSubT
         }
     }
 
+    impl->addSubTreeToIndex(item);
+
     impl->sigSubTreeAdded(item);
 
     for(auto& item : orgSubTreeItems){
@@ -305,6 +336,9 @@ void RootItem::notifyEventOnSubTreeMoved(Item* item, std::vector<Item*>& orgSubT
 
 void RootItem::notifyEventOnSubTreeRemoving(Item* item, bool isMoving)
 {
+    if(!isMoving){
+        impl->removeSubTreeFromIndex(item);
+    }
     impl->sigSubTreeRemoving(item, isMoving);
 }
 
@@ -330,10 +364,67 @@ void RootItem::emitSigItemAssinged(Item* assigned, const Item* srcItem)
 
 void RootItem::emitSigItemNameChanged(Item* item, const std::string& oldName)
 {
+    if(item->name() != oldName){
+        removeFromIndex(impl->nameToItemsMap, oldName, item);
+        impl->nameToItemsMap[item->name()].insert(item);
+    }
     impl->sigItemNameChanged(item, oldName);
 }
 
 
+void RootItem::Impl::addSubTreeToIndex(Item* item)
+{
+    nameToItemsMap[item->name()].insert(item);
+    classIdToItemsMap[item->classId()].insert(item);
+    for(auto child = item->childItem(); child; child = child->nextItem()){
+        addSubTreeToIndex(child);
+    }
+}
+
+
+void RootItem::Impl::removeSubTreeFromIndex(Item* item)
+{
+    removeFromIndex(nameToItemsMap, item->name(), item);
+    removeFromIndex(classIdToItemsMap, item->classId(), item);
+    for(auto child = item->childItem(); child; child = child->nextItem()){
+        removeSubTreeFromIndex(child);
+    }
+}
+
+
+ItemList<> RootItem::itemsWithName(const std::string& name) const
+{
+    ItemList<> items;
+    auto p = impl->nameToItemsMap.find(name);
+    if(p != impl->nameToItemsMap.end()){
+        items.reserve(p->second.size());
+        for(auto& item : p->second){
+            items.push_back(item);
+        }
+    }
+    return items;
+}
+
+
+/**
+   The items of a class are matched to the type by checking one of the items because
+   all the items of the class give the same result.
+*/
+ItemList<> RootItem::getItemsOfType(const ItemPredicate& isTypeMatched) const
+{
+    ItemList<> items;
+    for(auto& kv : impl->classIdToItemsMap){
+        auto& classItems = kv.second;
+        if(isTypeMatched(*classItems.begin())){
+            for(auto& item : classItems){
+                items.push_back(item);
+            }
+        }
+    }
+    return items;
+}
+
+
 Item* RootItem::currentItem()
 {
     return impl->currentItem;
@@ -414,6 +505,7 @@ void RootItem::requestToEmitSigSelectedItemsChanged()
     impl->needToUpdateSelectedItems = true;
 
     if(impl->itemSelectionChangeBlockLevel == 0){
+        CNOID_TRACE_ZONE("RootItem::sigSelectedItemsChanged", "Item");
         impl->sigSelectedItemsChanged(getSelectedItems());
     }
 }
@@ -432,6 +524,7 @@ void RootItem::endItemSelectionChanges()
         impl->itemSelectionChangeBlockLevel = 0;
     }
     if(impl->itemSelectionChangeBlockLevel == 0){
+        CNOID_TRACE_ZONE("RootItem::sigSelectedItemsChanged", "Item");
         impl->sigSelectedItemsChanged(getSelectedItems());
     }
 }
@@ -635,3 +728,31 @@ bool RootItem::checkConsistencyWithArchive()
 {
     return Item::checkConsistencyWithArchive();
 }
+
+
+/**
+   The items are reported as a whole, and the items that report their memory usage are also
+   reported for each class so that the class of the growing items can be found.
+*/
+void RootItem::Impl::reportMemoryUsage()
+{
+    auto telemetry = MemoryTelemetry::instance();
+    int64_t numItems = 0;
+    int64_t totalBytes = 0;
+    string moduleName, className;
+
+    for(Item* item = self->childItem(); item; item = item->nextItem()){
+        item->traverse(
+            [&](Item* item){
+                ++numItems;
+                if(auto bytes = item->getMemoryUsage()){
+                    totalBytes += bytes;
+                    if(ItemManager::getClassIdentifier(item, moduleName, className)){
+                        telemetry->report("Items: " + className, bytes, 1);
+                    }
+                }
+                return false;
+            });
+    }
+    telemetry->report("Item tree", totalBytes, numItems);
+}
@@ -86,6 +86,17 @@ public:
 
     SignalProxy<void(Item* item, bool on)> sigCheckToggled(int checkId = PrimaryCheck);
 
+    /**
+       The items in the item tree are indexed by their names and classes, and the index is
+       updated when an item is added to or removed from the tree or an item is renamed.
+       The following functions return the indexed items without traversing the tree.
+       Note that the items are returned in no particular order.
+    */
+    ItemList<> itemsWithName(const std::string& name) const;
+    template <class ItemType> ItemList<ItemType> itemsOfType() const {
+        return getItemsOfType(getItemPredicate<ItemType>());
+    }
+
     virtual bool store(Archive& archive) override;
     virtual bool restore(const Archive& archive) override;
 
@@ -117,6 +128,7 @@ private:
     void emitSigCheckToggled(Item* item, int checkId, bool on);
 
     const ItemList<>& getSelectedItems();
+    ItemList<> getItemsOfType(const ItemPredicate& isTypeMatched) const;
     const ItemList<>& getCheckedItems(int checkId);
 };
 
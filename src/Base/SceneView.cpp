@@ -10,8 +10,11 @@
 #include "ProjectManager.h"
 #include "RootItem.h"
 #include "RenderableItem.h"
+#include "MainMenu.h"
+#include "MessageView.h"
 #include "App.h"
 #include <cnoid/SceneGraph>
+#include <cnoid/SceneUtil>
 #include <cnoid/ConnectionSet>
 #include <QBoxLayout>
 #include <list>
@@ -91,6 +94,16 @@ void SceneView::initializeClass(ExtensionManager* ext)
                         }
                     }
                 });
+
+        MainMenu::instance()->add_Tools_Item(
+            _("Report Scene Memory Usage"),
+            [](){
+                if(auto view = SceneView::instance()){
+                    SceneObjectMemoryCounter counter;
+                    counter.count(view->scene());
+                    counter.putReport(MessageView::instance()->cout());
+                }
+            });
     }
 }
 
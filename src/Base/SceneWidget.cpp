@@ -8,6 +8,7 @@
 #include "GLSLSceneRenderer.h"
 #include "SceneWidgetEventHandler.h"
 #include "InteractiveCameraTransform.h"
+#include "FrameProfileOverlay.h"
 #include "Archive.h"
 #include "MessageView.h"
 #include "ExtensionManager.h"
@@ -21,17 +22,25 @@
 #include <cnoid/SceneLights>
 #include <cnoid/SceneEffects>
 #include <cnoid/CoordinateAxesOverlay>
+#include <cnoid/SceneNodeExtractor>
 #include <cnoid/ConnectionSet>
 #include <QOpenGLWidget>
+#include <QOpenGLContext>
+#include <QOpenGLExtraFunctions>
 #include <QKeyEvent>
 #include <QMouseEvent>
 #include <QElapsedTimer>
 #include <QMessageBox>
 #include <QCoreApplication>
+#include <QGuiApplication>
+#include <QScreen>
+#include <QWindow>
 #include <QPainter>
 #include <fmt/format.h>
 #include <set>
+#include <unordered_map>
 #include <iostream>
+#include <cstring>
 #include "gettext.h"
 
 #ifdef _WIN32
@@ -48,6 +57,9 @@ const bool TRACE_FUNCTIONS = false;
 
 const int ThreashToStartPointerMoveEventForEditableNode = 0;
 
+// The number of the pixel buffer objects used for the asynchronous image capture
+const int NumImageCaptureSlots = 3;
+
 bool isVerticalSyncMode_ = false;
 bool isLowMemoryConsumptionMode_ = false;
 Signal<void(bool on)> sigLowMemoryConsumptionModeChanged;
@@ -135,6 +147,42 @@ public:
     bool needToClearGLOnFrameBufferChange;
     SgUpdate sgUpdate;
 
+    /*
+      The updates of the scene graph that do not change the rendered image are ignored,
+      and the redraws requested by the updates are coalesced to one per display refresh.
+      A node whose bounding box was outside the view volume when it was updated last time
+      is not redrawn while it stays outside. The states are cleared when the view volume
+      or the structure of the scene changes.
+    */
+    struct UpdatedNodeInfo
+    {
+        bool hasPreprocessedNodes;
+        bool wasOutsideViewVolume;
+    };
+    bool isSceneUpdateFilteringEnabled;
+    unordered_map<SgNode*, UpdatedNodeInfo> updatedNodeInfoMap;
+    Matrix4 lastViewProjectionMatrix;
+    bool isLastViewProjectionMatrixValid;
+    QElapsedTimer lastRenderingTimer;
+    Timer redrawTimer;
+
+    /*
+      The ring of the pixel buffer objects used for the asynchronous image capture.
+      The captures are completed in the order of the requests.
+    */
+    struct ImageCaptureSlot
+    {
+        GLuint pixelBuffer;
+        int bufferSize;
+        int width;
+        int height;
+        GLsync sync;
+        std::function<void(QImage& image)> callback;
+    };
+    vector<ImageCaptureSlot> imageCaptureSlots;
+    int oldestImageCaptureSlotIndex;
+    int numPendingImageCaptures;
+
     InteractiveCameraTransformPtr interactiveCameraTransform;
 
     bool hasActiveInteractiveCamera() const {
@@ -211,6 +259,7 @@ public:
     bool collisionLineVisibility;
 
     ref_ptr<CoordinateAxesOverlay> coordinateAxesOverlay;
+    FrameProfileOverlayPtr frameProfileOverlay;
 
     SgInvariantGroupPtr gridGroup;
 
@@ -253,6 +302,10 @@ public:
     SgLineSet* createGrid(int index);
 
     void onSceneGraphUpdated(const SgUpdate& update);
+    bool isSceneUpdateVisible(const SgUpdate& update);
+    bool isOutsideViewVolume(const BoundingBox& bbox) const;
+    void requestRedrawForSceneUpdate();
+    void updateViewProjectionMatrixForSceneUpdateFiltering();
     void extractEditablesInSubTree(SgNode* node, vector<EditableNodeInfo>& editables);
     void checkAddedEditableNodes(SgNode* node);
     void checkRemovedEditableNodes(SgNode* node);
@@ -261,6 +314,11 @@ public:
     virtual void initializeGL() override;
     virtual void resizeGL(int width, int height) override;
     virtual void paintGL() override;
+    bool isAsyncImageCaptureAvailable();
+    bool requestImageCapture(std::function<void(QImage& image)>& callback);
+    bool completeOldestImageCapture(QOpenGLExtraFunctions* gl, bool doWait);
+    void finishImageCaptures();
+    void releaseImageCaptureSlots();
 
     void showFPS(bool on);
     void doFpsTest(int iteration);
@@ -469,6 +527,8 @@ SceneWidget::Impl::Impl(SceneWidget* self)
     glslRenderer = dynamic_cast<GLSLSceneRenderer*>(renderer);
     if(glslRenderer){
         glslRenderer->setLowMemoryConsumptionMode(isLowMemoryConsumptionMode_);
+        // The contexts of the widgets are shared by the Qt::AA_ShareOpenGLContexts attribute
+        glslRenderer->setResourceSharingEnabled(true);
         gl1Renderer = nullptr;
     } else {
         gl1Renderer = dynamic_cast<GL1SceneRenderer*>(renderer);
@@ -493,6 +553,14 @@ SceneWidget::Impl::Impl(SceneWidget* self)
 
     needToClearGLOnFrameBufferChange = false;
 
+    isSceneUpdateFilteringEnabled = true;
+    isLastViewProjectionMatrixValid = false;
+    redrawTimer.setSingleShot(true);
+    redrawTimer.sigTimeout().connect([this](){ QOpenGLWidget::update(); });
+
+    oldestImageCaptureSlotIndex = 0;
+    numPendingImageCaptures = 0;
+
     setAutoFillBackground(false);
     setMouseTracking(true);
     
@@ -588,6 +656,8 @@ SceneWidget::~SceneWidget()
 
 SceneWidget::Impl::~Impl()
 {
+    releaseImageCaptureSlots();
+    
     delete renderer;
 
     if(lastMouseMoveEvent){
@@ -725,10 +795,134 @@ void SceneWidget::Impl::onSceneGraphUpdated(const SgUpdate& sgUpdate)
             }
         }
         needToUpdatePreprocessedNodeTree = true;        
+        updatedNodeInfoMap.clear();
     }
 
     if(!isRendering){
+        if(!isSceneUpdateFilteringEnabled){
+            QOpenGLWidget::update();
+        } else if(isSceneUpdateVisible(sgUpdate)){
+            requestRedrawForSceneUpdate();
+        }
+    }
+}
+
+
+bool SceneWidget::Impl::isSceneUpdateVisible(const SgUpdate& sgUpdate)
+{
+    auto& path = sgUpdate.path();
+    auto node = path.front()->toNode();
+    if(!node || sgUpdate.hasAction(SgUpdate::Added | SgUpdate::Removed)){
+        return true;
+    }
+
+    // The nodes under a turned off switchable group are not rendered
+    for(size_t i=1; i < path.size(); ++i){
+        if(auto group = dynamic_cast<SgSwitchableGroup*>(path[i])){
+            if(!group->isTurnedOn()){
+                return false;
+            }
+        }
+    }
+
+    // The nodes outside the view volume may cast the shadows into it
+    if(!isLastViewProjectionMatrixValid || renderer->isShadowCastingEnabled()){
+        return true;
+    }
+
+    auto inserted = updatedNodeInfoMap.emplace(node, UpdatedNodeInfo());
+    auto& info = inserted.first->second;
+    if(inserted.second){
+        // The cameras and the lights affect the image wherever they are
+        info.hasPreprocessedNodes = !SceneNodeExtractor().extractNodes<SgPreprocessed>(node).empty();
+        info.wasOutsideViewVolume = false;
+    }
+    if(info.hasPreprocessedNodes){
+        return true;
+    }
+
+    BoundingBox bbox = node->boundingBox();
+    if(bbox.empty()){
+        return true;
+    }
+    Affine3 T = Affine3::Identity();
+    for(auto p = path.rbegin(); p + 1 != path.rend(); ++p){
+        if(auto transform = dynamic_cast<SgTransform*>(*p)){
+            Affine3 T_local;
+            transform->getTransform(T_local);
+            T = T * T_local;
+        }
+    }
+    bbox.transform(T);
+
+    const bool isOutside = isOutsideViewVolume(bbox);
+    const bool wasOutside = info.wasOutsideViewVolume;
+    info.wasOutsideViewVolume = isOutside;
+
+    return !(isOutside && wasOutside);
+}
+
+
+bool SceneWidget::Impl::isOutsideViewVolume(const BoundingBox& bbox) const
+{
+    // The box is outside if all the corners are outside one of the clipping planes
+    int outsideCounts[6] = { 0, 0, 0, 0, 0, 0 };
+    const Vector3& p0 = bbox.min();
+    const Vector3& p1 = bbox.max();
+    for(int i=0; i < 8; ++i){
+        Vector4 p((i & 1) ? p1.x() : p0.x(), (i & 2) ? p1.y() : p0.y(), (i & 4) ? p1.z() : p0.z(), 1.0);
+        Vector4 c = lastViewProjectionMatrix * p;
+        for(int j=0; j < 3; ++j){
+            if(c[j] < -c[3]){
+                ++outsideCounts[j * 2];
+            }
+            if(c[j] > c[3]){
+                ++outsideCounts[j * 2 + 1];
+            }
+        }
+    }
+    for(int i=0; i < 6; ++i){
+        if(outsideCounts[i] == 8){
+            return true;
+        }
+    }
+    return false;
+}
+
+
+void SceneWidget::Impl::requestRedrawForSceneUpdate()
+{
+    if(redrawTimer.isActive()){
+        return;
+    }
+    double refreshRate = 60.0;
+    QScreen* screen = nullptr;
+    if(auto windowHandle = window()->windowHandle()){
+        screen = windowHandle->screen();
+    }
+    if(!screen){
+        screen = QGuiApplication::primaryScreen();
+    }
+    if(screen && screen->refreshRate() > 0.0){
+        refreshRate = screen->refreshRate();
+    }
+    const qint64 interval = static_cast<qint64>(1000.0 / refreshRate);
+    const qint64 elapsed = lastRenderingTimer.isValid() ? lastRenderingTimer.elapsed() : interval;
+    if(elapsed >= interval){
         QOpenGLWidget::update();
+    } else {
+        redrawTimer.start(interval - elapsed);
+    }
+}
+
+
+void SceneWidget::Impl::updateViewProjectionMatrixForSceneUpdateFiltering()
+{
+    Matrix4 VP = renderer->projectionMatrix() * renderer->currentCameraPosition().inverse(Eigen::Isometry).matrix();
+    if(!isLastViewProjectionMatrixValid || VP != lastViewProjectionMatrix){
+        lastViewProjectionMatrix = VP;
+        isLastViewProjectionMatrixValid = true;
+        updatedNodeInfoMap.clear();
     }
 }
 
@@ -906,6 +1100,14 @@ void SceneWidget::Impl::paintGL()
     renderer->render();
     isRendering = false;
 
+    lastRenderingTimer.start();
+    if(redrawTimer.isActive()){
+        redrawTimer.stop();
+    }
+    if(isSceneUpdateFilteringEnabled){
+        updateViewProjectionMatrixForSceneUpdateFiltering();
+    }
+
     if(fpsTimer.isActive()){
         renderFps();
     }
@@ -2682,6 +2884,38 @@ void SceneWidget::setCoordinateAxes(bool on)
 }
 
 
+void SceneWidget::setSceneUpdateFilteringEnabled(bool on)
+{
+    if(on != impl->isSceneUpdateFilteringEnabled){
+        impl->isSceneUpdateFilteringEnabled = on;
+        impl->isLastViewProjectionMatrixValid = false;
+        impl->updatedNodeInfoMap.clear();
+        impl->update();
+    }
+}
+
+
+bool SceneWidget::isSceneUpdateFilteringEnabled() const
+{
+    return impl->isSceneUpdateFilteringEnabled;
+}
+
+
+void SceneWidget::setFrameProfileOverlay(bool on)
+{
+    if(!impl->glslRenderer){
+        return;
+    }
+    if(on && !impl->frameProfileOverlay){
+        impl->frameProfileOverlay = new FrameProfileOverlay;
+    }
+    impl->glslRenderer->setFrameProfilingEnabled(on);
+    if(impl->frameProfileOverlay){
+        impl->activateSystemNode(impl->frameProfileOverlay, on);
+    }
+}
+
+
 void SceneWidget::setBackgroundColor(const Vector3& color)
 {
     impl->renderer->setBackgroundColor(color.cast<float>());
@@ -2781,6 +3015,162 @@ QImage SceneWidget::getImage()
 }
 
 
+bool SceneWidget::requestImageCapture(std::function<void(QImage& image)> callback)
+{
+    return impl->requestImageCapture(callback);
+}
+
+
+//! glMapBufferRange and the sync objects require OpenGL 3.0 or later
+bool SceneWidget::Impl::isAsyncImageCaptureAvailable()
+{
+    auto glContext = context();
+    if(!glContext || !isValid()){
+        return false;
+    }
+    auto format = glContext->format();
+    return !glContext->isOpenGLES() && format.version() >= qMakePair(3, 0) && format.samples() <= 0;
+}
+
+
+/**
+   The scene is rendered into the framebuffer of the widget in the same way as grabFramebuffer,
+   but the pixels are transferred to a pixel buffer object without waiting for the completion.
+*/
+bool SceneWidget::Impl::requestImageCapture(std::function<void(QImage& image)>& callback)
+{
+    if(!isAsyncImageCaptureAvailable()){
+        return false;
+    }
+
+    makeCurrent();
+    auto gl = context()->extraFunctions();
+
+    if(imageCaptureSlots.empty()){
+        imageCaptureSlots.resize(NumImageCaptureSlots);
+        for(auto& slot : imageCaptureSlots){
+            gl->glGenBuffers(1, &slot.pixelBuffer);
+            slot.bufferSize = 0;
+            slot.sync = nullptr;
+        }
+        oldestImageCaptureSlotIndex = 0;
+        numPendingImageCaptures = 0;
+    }
+    if(numPendingImageCaptures == NumImageCaptureSlots){
+        completeOldestImageCapture(gl, true);
+    }
+
+    const int r = devicePixelRatio();
+    auto& slot = imageCaptureSlots[
+        (oldestImageCaptureSlotIndex + numPendingImageCaptures) % NumImageCaptureSlots];
+    slot.width = width() * r;
+    slot.height = height() * r;
+
+    // The viewport is set as QOpenGLWidget does before calling paintGL
+    gl->glViewport(0, 0, slot.width, slot.height);
+    paintGL();
+    const int size = slot.width * slot.height * 4;
+
+    gl->glBindFramebuffer(GL_READ_FRAMEBUFFER, defaultFramebufferObject());
+    gl->glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pixelBuffer);
+    if(size > slot.bufferSize){
+        gl->glBufferData(GL_PIXEL_PACK_BUFFER, size, nullptr, GL_STREAM_READ);
+        slot.bufferSize = size;
+    }
+    gl->glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    gl->glReadPixels(0, 0, slot.width, slot.height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    gl->glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    slot.sync = gl->glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    gl->glFlush();
+    slot.callback = callback;
+    ++numPendingImageCaptures;
+
+    while(numPendingImageCaptures > 0){
+        if(!completeOldestImageCapture(gl, false)){
+            break;
+        }
+    }
+
+    return true;
+}
+
+
+//! \return false if doWait is false and the transfer has not been completed yet
+bool SceneWidget::Impl::completeOldestImageCapture(QOpenGLExtraFunctions* gl, bool doWait)
+{
+    auto& slot = imageCaptureSlots[oldestImageCaptureSlotIndex];
+
+    GLenum status =
+        gl->glClientWaitSync(slot.sync, doWait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0, doWait ? GL_TIMEOUT_IGNORED : 0);
+    if(status == GL_TIMEOUT_EXPIRED){
+        return false;
+    }
+    gl->glDeleteSync(slot.sync);
+    slot.sync = nullptr;
+
+    // The rows are flipped because the origin of the framebuffer is at the bottom left
+    QImage image(slot.width, slot.height, QImage::Format_RGBX8888);
+    gl->glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pixelBuffer);
+    auto data = static_cast<const uchar*>(
+        gl->glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, slot.width * slot.height * 4, GL_MAP_READ_BIT));
+    if(data){
+        const int rowSize = slot.width * 4;
+        for(int y=0; y < slot.height; ++y){
+            memcpy(image.scanLine(y), data + (slot.height - y - 1) * rowSize, rowSize);
+        }
+        gl->glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    gl->glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    oldestImageCaptureSlotIndex = (oldestImageCaptureSlotIndex + 1) % NumImageCaptureSlots;
+    --numPendingImageCaptures;
+
+    auto callback = std::move(slot.callback);
+    slot.callback = nullptr;
+    if(data){
+        callback(image);
+    }
+    
+    return true;
+}
+
+
+void SceneWidget::finishImageCaptures()
+{
+    impl->finishImageCaptures();
+}
+
+
+void SceneWidget::Impl::finishImageCaptures()
+{
+    if(numPendingImageCaptures > 0){
+        makeCurrent();
+        auto gl = context()->extraFunctions();
+        while(numPendingImageCaptures > 0){
+            completeOldestImageCapture(gl, true);
+        }
+    }
+}
+
+
+void SceneWidget::Impl::releaseImageCaptureSlots()
+{
+    if(!imageCaptureSlots.empty() && context()){
+        makeCurrent();
+        auto gl = context()->extraFunctions();
+        for(auto& slot : imageCaptureSlots){
+            if(slot.sync){
+                gl->glDeleteSync(slot.sync);
+            }
+            gl->glDeleteBuffers(1, &slot.pixelBuffer);
+        }
+        doneCurrent();
+    }
+    imageCaptureSlots.clear();
+    numPendingImageCaptures = 0;
+}
+
+
 void SceneWidget::setScreenSize(int width, int height)
 {
     impl->setScreenSize(width, height);
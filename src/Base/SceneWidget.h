@@ -127,6 +127,21 @@ public:
     void updateGrids();
 
     void setCoordinateAxes(bool on);
+
+    /**
+       The scene graph updates of the nodes that are hidden or stay outside the view volume
+       do not redraw the scene, and the redraws are limited to the refresh rate of the screen
+       if this is enabled. This is enabled by default.
+    */
+    void setSceneUpdateFilteringEnabled(bool on);
+    bool isSceneUpdateFilteringEnabled() const;
+
+    /**
+       Shows the frame profile of the renderer with FrameProfileOverlay.
+       This is only available with GLSLSceneRenderer.
+    */
+    void setFrameProfileOverlay(bool on);
+
     void setShowFPS(bool on);
 
     // Make the following three functions deprecated?
@@ -167,6 +182,17 @@ public:
 
     bool saveImage(const std::string& filename);
     QImage getImage();
+
+    /**
+       Capture the rendered image asynchronously using pixel buffer objects.
+       The callback function is called with the captured image when the transfer of the pixels
+       is completed, which is checked in the subsequent calls of requestImageCapture and in
+       finishImageCaptures. The callback functions are called in the order of the requests.
+       \return false if the OpenGL context does not support the asynchronous capture.
+       getImage must be used in that case.
+    */
+    bool requestImageCapture(std::function<void(QImage& image)> callback);
+    void finishImageCaptures();
     void setScreenSize(int width, int height);
 
     void updateIndicator(const std::string& text);
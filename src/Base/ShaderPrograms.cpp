@@ -11,6 +11,7 @@
 #include <cnoid/SceneEffects>
 #include <cnoid/EigenUtil>
 #include <fmt/format.h>
+#include <limits>
 #include "gettext.h"
 
 using namespace std;
@@ -178,6 +179,11 @@ public:
     GLint colorTextureLocation;
     bool isTextureEnabled;
 
+    int colorTextureArrayIndex;
+    GLint isTextureArrayEnabledLocation;
+    GLint colorTextureArrayLocation;
+    bool isTextureArrayEnabled;
+
     GLint isVertexColorEnabledLocation;
     bool isVertexColorEnabled;
 
@@ -230,7 +236,7 @@ public:
     GLint isShadowAntiAliasingEnabledLocation;
 
     // This value must be same as that of shader/phongshadow.[vert/flag]
-    static const int maxNumShadows = 2;
+    static const int maxNumShadows = 4;
     
     int currentShadowIndex;
 
@@ -240,9 +246,15 @@ public:
         GLint shadowMatrixLocation;
         GLint lightIndexLocation;
         GLint shadowMapLocation;
+        GLint depthRangeLocation;
         GLuint depthTexture;
         GLuint frameBuffer;
+        // The copy of the depth texture kept by ShadowMapProgram::storeShadowMapCache
+        GLuint cacheDepthTexture;
+        GLuint cacheFrameBuffer;
         Matrix4 BPV;
+        Vector2f depthRange;
+        bool isSameLightAsPreviousShadow;
     };
     std::vector<ShadowInfo, Eigen::aligned_allocator<ShadowInfo>> shadowInfos;
 
@@ -967,6 +979,7 @@ MaterialLightingProgram::MaterialLightingProgram(std::initializer_list<ShaderSou
     setCapability(Transparency);
     impl = new Impl;
     impl->colorTextureIndex = 1;
+    impl->colorTextureArrayIndex = 6;
 }
 
 
@@ -988,6 +1001,12 @@ int MaterialLightingProgram::colorTextureIndex() const
 }
 
 
+void MaterialLightingProgram::setColorTextureArrayIndex(int textureIndex)
+{
+    impl->colorTextureArrayIndex = textureIndex;
+}
+
+
 void MaterialLightingProgram::initialize()
 {
     BasicLightingProgram::initialize();
@@ -1012,6 +1031,10 @@ void MaterialLightingProgram::Impl::initialize(GLSLProgram& glsl)
     colorTextureLocation = glsl.getUniformLocation("colorTexture");
     isTextureEnabled = false;
 
+    isTextureArrayEnabledLocation = glsl.getUniformLocation("isTextureArrayEnabled");
+    colorTextureArrayLocation = glsl.getUniformLocation("colorTextureArray");
+    isTextureArrayEnabled = false;
+
     isVertexColorEnabledLocation = glsl.getUniformLocation("isVertexColorEnabled");
     isVertexColorEnabled = false;
 
@@ -1019,6 +1042,8 @@ void MaterialLightingProgram::Impl::initialize(GLSLProgram& glsl)
     glsl.use();
     glUniform1i(isTextureEnabledLocation, isTextureEnabled);
     glUniform1i(colorTextureLocation, colorTextureIndex);
+    glUniform1i(isTextureArrayEnabledLocation, isTextureArrayEnabled);
+    glUniform1i(colorTextureArrayLocation, colorTextureArrayIndex);
     glUniform1i(isVertexColorEnabledLocation, isVertexColorEnabled);
 }
     
@@ -1106,6 +1131,15 @@ void MaterialLightingProgram::setTextureEnabled(bool on)
 }
 
 
+void MaterialLightingProgram::setTextureArrayEnabled(bool on)
+{
+    if(on != impl->isTextureArrayEnabled){
+        glUniform1i(impl->isTextureArrayEnabledLocation, on);
+        impl->isTextureArrayEnabled = on;
+    }
+}
+
+
 void MaterialLightingProgram::setMinimumTransparency(float t)
 {
     impl->minTransparency = t;
@@ -1249,6 +1283,11 @@ void FullLightingProgram::Impl::initializeShadowInfo(GLSLProgram& glsl, int inde
     string prefix = format("shadows[{}].", index);
     shadow.lightIndexLocation = glsl.getUniformLocation(prefix + "lightIndex");
     shadow.shadowMapLocation = glsl.getUniformLocation(prefix + "shadowMap");
+    shadow.depthRangeLocation = glsl.getUniformLocation(prefix + "depthRange");
+    shadow.cacheDepthTexture = 0;
+    shadow.cacheFrameBuffer = 0;
+    shadow.depthRange << 0.0f, std::numeric_limits<float>::max();
+    shadow.isSameLightAsPreviousShadow = false;
 
     glGenFramebuffers(1, &shadow.frameBuffer);
     glBindFramebuffer(GL_FRAMEBUFFER, shadow.frameBuffer);
@@ -1285,6 +1324,10 @@ void FullLightingProgram::release()
         auto& shadow = impl->shadowInfos[i];
         glDeleteFramebuffers(1, &shadow.frameBuffer);
         glDeleteTextures(1, &shadow.depthTexture);
+        if(shadow.cacheFrameBuffer){
+            glDeleteFramebuffers(1, &shadow.cacheFrameBuffer);
+            glDeleteTextures(1, &shadow.cacheDepthTexture);
+        }
     }
     impl->shadowInfos.clear();
 
@@ -1319,11 +1362,16 @@ bool FullLightingProgram::setLight
     bool result = MaterialLightingProgram::setLight(index, light, T, view, shadowCasting);
 
     if(result && shadowCasting){
-        if(impl->currentShadowIndex < impl->numShadows){
+        // The cascaded shadow maps of the light follow the first one
+        do {
+            if(impl->currentShadowIndex >= impl->numShadows){
+                break;
+            }
             auto& shadow = impl->shadowInfos[impl->currentShadowIndex];
             glUniform1i(shadow.lightIndexLocation, index);
             ++impl->currentShadowIndex;
-        }
+        } while(impl->currentShadowIndex < impl->numShadows &&
+                impl->shadowInfos[impl->currentShadowIndex].isSameLightAsPreviousShadow);
     }
 
     return result;
@@ -1430,6 +1478,17 @@ void FullLightingProgram::activateShadowMapGenerationPass(int shadowIndex)
     } else {
         impl->currentShadowIndex = shadowIndex;
     }
+    auto& shadow = impl->shadowInfos[impl->currentShadowIndex];
+    shadow.depthRange << 0.0f, std::numeric_limits<float>::max();
+    shadow.isSameLightAsPreviousShadow = false;
+}
+
+
+void FullLightingProgram::setShadowMapDepthRange(double minDepth, double maxDepth, bool isSameLightAsPreviousShadow)
+{
+    auto& shadow = impl->shadowInfos[impl->currentShadowIndex];
+    shadow.depthRange << minDepth, maxDepth;
+    shadow.isSameLightAsPreviousShadow = isSameLightAsPreviousShadow;
 }
 
 
@@ -1440,6 +1499,10 @@ void FullLightingProgram::activateMainRenderingPass()
     glUniform1i(impl->numShadowsLocation, impl->numShadows);
     if(impl->numShadows > 0){
         glUniform1i(impl->isShadowAntiAliasingEnabledLocation, impl->isShadowAntiAliasingEnabled);
+        for(int i=0; i < impl->numShadows; ++i){
+            auto& shadow = impl->shadowInfos[i];
+            glUniform2fv(shadow.depthRangeLocation, 1, shadow.depthRange.data());
+        }
     }
 }
 
@@ -1543,6 +1606,69 @@ void ShadowMapProgram::initializeShadowMapBuffer()
 }
 
 
+/**
+   The depth texture of the current shadow map is copied to the cache texture, which is
+   created when it is first used.
+   \return false if the cache texture is not available
+*/
+bool ShadowMapProgram::storeShadowMapCache()
+{
+    auto& mainImpl = mainProgram->impl;
+    const int index = mainImpl->currentShadowIndex;
+    auto& shadow = mainImpl->shadowInfos[index];
+    const int w = mainImpl->shadowMapWidth;
+    const int h = mainImpl->shadowMapHeight;
+
+    if(!shadow.cacheFrameBuffer){
+        glGenTextures(1, &shadow.cacheDepthTexture);
+        // The texture unit of the shadow map is used not to change the bindings of the other units
+        glActiveTexture(GL_TEXTURE0 + mainImpl->shadowMapTextureTopIndex + index);
+        glBindTexture(GL_TEXTURE_2D, shadow.cacheDepthTexture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, w, h, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glBindTexture(GL_TEXTURE_2D, shadow.depthTexture);
+
+        glGenFramebuffers(1, &shadow.cacheFrameBuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, shadow.cacheFrameBuffer);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, shadow.cacheDepthTexture, 0);
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+        bool isComplete = (glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
+        glBindFramebuffer(GL_FRAMEBUFFER, shadow.frameBuffer);
+        if(!isComplete){
+            glDeleteFramebuffers(1, &shadow.cacheFrameBuffer);
+            glDeleteTextures(1, &shadow.cacheDepthTexture);
+            shadow.cacheFrameBuffer = 0;
+            shadow.cacheDepthTexture = 0;
+            return false;
+        }
+    }
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, shadow.frameBuffer);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, shadow.cacheFrameBuffer);
+    glBlitFramebuffer(0, 0, w, h, 0, 0, w, h, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_FRAMEBUFFER, shadow.frameBuffer);
+
+    return true;
+}
+
+
+void ShadowMapProgram::restoreShadowMapCache()
+{
+    auto& mainImpl = mainProgram->impl;
+    auto& shadow = mainImpl->shadowInfos[mainImpl->currentShadowIndex];
+    if(shadow.cacheFrameBuffer){
+        const int w = mainImpl->shadowMapWidth;
+        const int h = mainImpl->shadowMapHeight;
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, shadow.cacheFrameBuffer);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, shadow.frameBuffer);
+        glBlitFramebuffer(0, 0, w, h, 0, 0, w, h, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+        glBindFramebuffer(GL_FRAMEBUFFER, shadow.frameBuffer);
+    }
+}
+
+
 void ShadowMapProgram::activate()
 {
     NolightingProgram::activate();
@@ -281,6 +281,14 @@ public:
     void setColorTextureIndex(int textureIndex);
     int colorTextureIndex() const;
     void setTextureEnabled(bool on);
+
+    /**
+       The color texture is sampled from the layer of the 2D array texture given to each
+       instance by the instanceTextureLayer attribute if this is enabled.
+    */
+    void setColorTextureArrayIndex(int textureIndex);
+    void setTextureArrayEnabled(bool on);
+    
     void setMinimumTransparency(float t);
 
 private:
@@ -325,6 +333,13 @@ public:
     void getShadowMapSize(int& width, int& height) const;
     SgCamera* getShadowMapCamera(SgLight* light, Isometry3& io_T);
     void setShadowMapViewProjection(const Matrix4& PV);
+
+    /**
+       The current shadow map is only applied to the fragments in the depth range of the view
+       coordinate. The shadow maps of a light split by its depth ranges are given to consecutive
+       indices, and the second or later ones are specified by isSameLightAsPreviousShadow.
+    */
+    void setShadowMapDepthRange(double minDepth, double maxDepth, bool isSameLightAsPreviousShadow);
     void setShadowAntiAliasingEnabled(bool on);
     bool isShadowAntiAliasingEnabled() const;
 
@@ -344,6 +359,8 @@ public:
     virtual void initialize() override;
     virtual void activate() override;
     void initializeShadowMapBuffer();
+    bool storeShadowMapCache();
+    void restoreShadowMapCache();
     virtual void deactivate() override;
 
 private:
@@ -0,0 +1,209 @@
+#include "StartupProfiler.h"
+#include <cnoid/UTF8>
+#include <vector>
+#include <algorithm>
+#include <mutex>
+#include <thread>
+#include <fstream>
+#include <fmt/format.h>
+#include "gettext.h"
+
+using namespace std;
+using namespace cnoid;
+
+bool StartupProfiler::isEnabled_ = false;
+
+namespace {
+
+struct Event
+{
+    string name;
+    const char* category;
+    double startTime;
+    double duration;
+    int threadIndex;
+};
+
+string traceFilename;
+StartupProfiler::TimePoint originTime;
+vector<Event> events;
+vector<std::thread::id> threadIds;
+std::mutex eventMutex;
+
+double toMicroseconds(const StartupProfiler::TimePoint& time)
+{
+    return std::chrono::duration<double, std::micro>(time - originTime).count();
+}
+
+int getThreadIndex()
+{
+    auto id = std::this_thread::get_id();
+    auto p = std::find(threadIds.begin(), threadIds.end(), id);
+    if(p != threadIds.end()){
+        return p - threadIds.begin();
+    }
+    threadIds.push_back(id);
+    return threadIds.size() - 1;
+}
+
+string escapeJsonString(const string& s)
+{
+    string escaped;
+    escaped.reserve(s.size());
+    for(auto c : s){
+        switch(c){
+        case '"':  escaped += "\\\""; break;
+        case '\\': escaped += "\\\\"; break;
+        case '\n': escaped += "\\n";  break;
+        case '\t': escaped += "\\t";  break;
+        default:
+            if(static_cast<unsigned char>(c) < 0x20){
+                escaped += fmt::format("\\u{:04x}", static_cast<int>(c));
+            } else {
+                escaped += c;
+            }
+            break;
+        }
+    }
+    return escaped;
+}
+
+}
+
+
+void StartupProfiler::enable(const std::string& traceFilename)
+{
+    std::lock_guard<std::mutex> lock(eventMutex);
+    if(!isEnabled_){
+        ::traceFilename = traceFilename;
+        originTime = std::chrono::steady_clock::now();
+        events.clear();
+        threadIds.clear();
+        threadIds.push_back(std::this_thread::get_id());
+        isEnabled_ = true;
+    }
+}
+
+
+void StartupProfiler::addEvent
+(const std::string& name, const char* category, const TimePoint& startTime, const TimePoint& endTime)
+{
+    std::lock_guard<std::mutex> lock(eventMutex);
+    if(isEnabled_){
+        Event event;
+        event.name = name;
+        event.category = category;
+        event.startTime = toMicroseconds(startTime);
+        event.duration = std::chrono::duration<double, std::micro>(endTime - startTime).count();
+        event.threadIndex = getThreadIndex();
+        events.push_back(event);
+    }
+}
+
+
+bool StartupProfiler::finish(std::string& out_summary, std::string& out_errorMessage)
+{
+    std::lock_guard<std::mutex> lock(eventMutex);
+
+    out_summary.clear();
+    out_errorMessage.clear();
+
+    if(!isEnabled_){
+        return false;
+    }
+    isEnabled_ = false;
+
+    // The outer stages are put before the inner ones when they start at the same time
+    std::stable_sort(
+        events.begin(), events.end(),
+        [](const Event& e1, const Event& e2){
+            if(e1.startTime != e2.startTime){
+                return e1.startTime < e2.startTime;
+            }
+            return e1.duration > e2.duration;
+        });
+
+    double totalTime = std::chrono::duration<double, std::micro>(
+        std::chrono::steady_clock::now() - originTime).count();
+
+    out_summary = fmt::format(_("Startup time profile ({:.1f} ms in total):\n"), totalTime / 1000.0);
+    vector<double> endTimeStack;
+    for(auto& event : events){
+        if(event.threadIndex != 0){
+            continue;
+        }
+        double endTime = event.startTime + event.duration;
+        while(!endTimeStack.empty() && endTimeStack.back() < endTime){
+            endTimeStack.pop_back();
+        }
+        out_summary += fmt::format(
+            "{0:>10.1f} ms  {1:{2}}{3}\n",
+            event.duration / 1000.0, "", endTimeStack.size() * 2, event.name);
+        endTimeStack.push_back(endTime);
+    }
+
+    ofstream file(fromUTF8(traceFilename).c_str(), ios::out | ios::trunc);
+    if(!file){
+        out_errorMessage = fmt::format(_("The startup trace file \"{}\" cannot be opened."), traceFilename);
+        events.clear();
+        return false;
+    }
+    file << "{\"traceEvents\":[\n";
+    for(size_t i=0; i < events.size(); ++i){
+        auto& event = events[i];
+        file << fmt::format(
+            "{{\"name\":\"{0}\",\"cat\":\"{1}\",\"ph\":\"X\",\"ts\":{2:.3f},\"dur\":{3:.3f},\"pid\":1,\"tid\":{4}}}",
+            escapeJsonString(event.name), event.category, event.startTime, event.duration, event.threadIndex);
+        if(i + 1 < events.size()){
+            file << ",";
+        }
+        file << "\n";
+    }
+    file << "],\"displayTimeUnit\":\"ms\"}\n";
+
+    events.clear();
+
+    if(!file){
+        out_errorMessage = fmt::format(_("The startup trace cannot be written to \"{}\"."), traceFilename);
+        return false;
+    }
+    out_summary += fmt::format(_("The startup trace has been written to \"{}\".\n"), traceFilename);
+    return true;
+}
+
+
+StartupProfiler::Scope::Scope(const char* name, const char* category)
+    : category(category),
+      isActive(StartupProfiler::isEnabled())
+{
+    if(isActive){
+        this->name = name;
+        startTime = std::chrono::steady_clock::now();
+    }
+}
+
+
+StartupProfiler::Scope::Scope(const std::string& name, const char* category)
+    : category(category),
+      isActive(StartupProfiler::isEnabled())
+{
+    if(isActive){
+        this->name = name;
+        startTime = std::chrono::steady_clock::now();
+    }
+}
+
+
+StartupProfiler::Scope::~Scope()
+{
+    end();
+}
+
+
+void StartupProfiler::Scope::end()
+{
+    if(isActive){
+        StartupProfiler::addEvent(name, category, startTime, std::chrono::steady_clock::now());
+        isActive = false;
+    }
+}
@@ -0,0 +1,51 @@
+#ifndef CNOID_BASE_STARTUP_PROFILER_H
+#define CNOID_BASE_STARTUP_PROFILER_H
+
+#include <string>
+#include <chrono>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+/**
+   This class records the time spent in each stage of the application startup.
+   The recording is enabled by setting the file name of the trace output to the
+   CNOID_STARTUP_TRACE environment variable. The trace is written in the Chrome trace
+   event format, which can be viewed with chrome://tracing or Perfetto.
+*/
+class CNOID_EXPORT StartupProfiler
+{
+public:
+    typedef std::chrono::steady_clock::time_point TimePoint;
+
+    static void enable(const std::string& traceFilename);
+    static bool isEnabled() { return isEnabled_; }
+
+    static void addEvent(
+        const std::string& name, const char* category, const TimePoint& startTime, const TimePoint& endTime);
+
+    //! This function disables the recording and writes the trace file.
+    static bool finish(std::string& out_summary, std::string& out_errorMessage);
+
+    class CNOID_EXPORT Scope
+    {
+    public:
+        Scope(const char* name, const char* category);
+        Scope(const std::string& name, const char* category);
+        ~Scope();
+        //! This function can be used to record the stage before the scope ends.
+        void end();
+    private:
+        std::string name;
+        const char* category;
+        TimePoint startTime;
+        bool isActive;
+    };
+
+private:
+    static bool isEnabled_;
+};
+
+}
+
+#endif
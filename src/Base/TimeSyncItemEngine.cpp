@@ -9,8 +9,12 @@
 #include "TimeBar.h"
 #include "ExtensionManager.h"
 #include <cnoid/ConnectionSet>
+#include <cnoid/SceneGraph>
+#include <cnoid/ThreadPool>
 #include <vector>
 #include <unordered_map>
+#include <memory>
+#include <thread>
 
 using namespace std;
 using namespace cnoid;
@@ -20,6 +24,9 @@ namespace {
 TimeSyncItemEngineManager* manager = nullptr;
 TimeSyncItemEngineManager::Impl* managerImpl = nullptr;
 
+// The time change preparations are executed in parallel when this number of engines enable it
+const int minNumEnginesToPrepareInParallel = 8;
+
 typedef std::function<TimeSyncItemEngine*(Item* item, TimeSyncItemEngine* prevEngine)> Factory;
 typedef shared_ptr<Factory> FactoryPtr;
 
@@ -44,6 +51,9 @@ public:
     vector<TimeSyncItemEnginePtr> activeEngines;
     int numPreExistingActiveEngines;
 
+    vector<TimeSyncItemEngine*> enginesToPrepare;
+    unique_ptr<ThreadPool> preparationThreadPool;
+
     ScopedConnectionSet connections;
 
     Impl();
@@ -53,6 +63,7 @@ public:
     bool onPlaybackInitialized(double time);
     void onPlaybackStarted(double time);
     bool onTimeChanged(double time);
+    void prepareTimeChangeInParallel(double time);
     void onPlaybackStopped(double time, bool isStoppedManually);
     void refresh(TimeSyncItemEngine* engine);
 };
@@ -288,6 +299,12 @@ bool TimeSyncItemEngineManager::Impl::onTimeChanged(double time)
 {
     bool isActive = false;
     currentTime = time;
+
+    // The scene updates by the engines are coalesced and notified once for each frame
+    SgUpdateBatch sceneUpdateBatch;
+
+    prepareTimeChangeInParallel(time);
+    
     auto iter = activeEngines.begin();
     while(iter != activeEngines.end()){
         auto& engine = *iter;
@@ -308,6 +325,40 @@ bool TimeSyncItemEngineManager::Impl::onTimeChanged(double time)
 }
 
 
+void TimeSyncItemEngineManager::Impl::prepareTimeChangeInParallel(double time)
+{
+    enginesToPrepare.clear();
+    for(auto& engine : activeEngines){
+        if(engine->isTimeChangePreparationEnabled()){
+            enginesToPrepare.push_back(engine);
+        }
+    }
+    const int numEngines = enginesToPrepare.size();
+    if(numEngines < minNumEnginesToPrepareInParallel){
+        return;
+    }
+    if(!preparationThreadPool){
+        int numThreads = std::thread::hardware_concurrency();
+        if(numThreads <= 1){
+            return;
+        }
+        preparationThreadPool.reset(new ThreadPool(numThreads));
+    }
+    const int numThreads = preparationThreadPool->size();
+    for(int i=0; i < numThreads; ++i){
+        const int begin = numEngines * i / numThreads;
+        const int end = numEngines * (i + 1) / numThreads;
+        preparationThreadPool->start(
+            [this, begin, end, time](){
+                for(int j = begin; j < end; ++j){
+                    enginesToPrepare[j]->prepareTimeChange(time);
+                }
+            });
+    }
+    preparationThreadPool->wait();
+}
+
+
 void TimeSyncItemEngineManager::Impl::onPlaybackStopped(double time, bool isStoppedManually)
 {
     isDoingPlayback = false;
@@ -341,6 +392,7 @@ TimeSyncItemEngine::TimeSyncItemEngine(Item* item)
     isActive_ = false;
     isTimeSyncForcedToBeMaintained_ = false;
     isUpdatingOngoingTime_ = false;
+    isTimeChangePreparationEnabled_ = false;
 }
 
 
@@ -362,6 +414,12 @@ void TimeSyncItemEngine::onPlaybackStarted(double /* time */)
 }
 
 
+void TimeSyncItemEngine::prepareTimeChange(double /* time */)
+{
+
+}
+
+
 void TimeSyncItemEngine::onPlaybackStopped(double /* time */, bool /* isStoppedManually */)
 {
 
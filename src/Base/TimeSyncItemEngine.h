@@ -28,6 +28,17 @@ public:
     virtual bool onPlaybackInitialized(double time);
     virtual void onPlaybackStarted(double time);
     virtual bool onTimeChanged(double time) = 0;
+
+    /**
+       This function is called before onTimeChanged for the engines enabling the time change
+       preparation when many of them are active. The functions of the engines are executed in
+       parallel by worker threads, so the function must not modify the objects shared with other
+       engines and must not emit any signals. The onTimeChanged function must work even if this
+       function has not been called.
+    */
+    virtual void prepareTimeChange(double time);
+    bool isTimeChangePreparationEnabled() const { return isTimeChangePreparationEnabled_; }
+    
     virtual void onPlaybackStopped(double time, bool isStoppedManually);
     virtual bool isTimeSyncAlwaysMaintained() const;
 
@@ -39,6 +50,9 @@ public:
     void stopOngoingTimeUpdate();
     void refresh();
 
+protected:
+    void setTimeChangePreparationEnabled(bool on) { isTimeChangePreparationEnabled_ = on; }
+
 private:
     ItemPtr item_;
     int ongoingTimeId;
@@ -46,6 +60,7 @@ private:
     bool isActive_;
     bool isTimeSyncForcedToBeMaintained_;
     bool isUpdatingOngoingTime_;
+    bool isTimeChangePreparationEnabled_;
 
     friend class TimeSyncItemEngineManager;
 
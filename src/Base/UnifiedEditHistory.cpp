@@ -5,8 +5,12 @@
 #include "Action.h"
 #include "MessageView.h"
 #include "LazyCaller.h"
+#include "AppConfig.h"
+#include <cnoid/ValueTree>
 #include <fmt/format.h>
 #include <deque>
+#include <chrono>
+#include <algorithm>
 #include "gettext.h"
 
 using namespace std;
@@ -47,6 +51,11 @@ public:
     deque<EditRecordPtr> records;
     int currentPosition;
     size_t maxHistorySize;
+    size_t maxMemoryUsage;
+    size_t memoryUsage;
+    double recordMergeInterval;
+    std::chrono::steady_clock::time_point lastRecordTime;
+    bool isLatestRecordMergeable;
     EditRecordGroupPtr currentGroup;
     bool isProjectBeingLoaded;
     vector<EditRecordPtr> newRecordBuffer;
@@ -66,7 +75,10 @@ public:
     void removeRecordsAfter(int index);
     void addRecord(EditRecord* record);
     void flushNewRecordBuffer();
+    bool mergeRecord(EditRecord* record, EditRecord* nextRecord);
     void expandHistoryFromLatestToCurrentUndoPosition();
+    void removeOldRecordsExceedingLimits();
+    void updateMemoryUsage();
     bool undo();
     bool redo();    
     void cancelRedo(int position);
@@ -100,6 +112,23 @@ UnifiedEditHistory::Impl::Impl(ExtensionManager* ext)
 {
     currentPosition = 0;
     maxHistorySize = 100;
+    maxMemoryUsage = 64 * 1024 * 1024;
+    memoryUsage = 0;
+    recordMergeInterval = 0.5;
+    isLatestRecordMergeable = false;
+
+    auto& config = *AppConfig::archive()->findMapping("edit_history");
+    if(config.isValid()){
+        int maxNumRecords;
+        if(config.read("max_num_records", maxNumRecords) && maxNumRecords >= 1){
+            maxHistorySize = maxNumRecords;
+        }
+        double maxMemoryUsageMB;
+        if(config.read("max_memory_usage_mb", maxMemoryUsageMB) && maxMemoryUsageMB > 0.0){
+            maxMemoryUsage = maxMemoryUsageMB * 1024 * 1024;
+        }
+        config.read("record_merge_interval", recordMergeInterval);
+    }
 
     mv = MessageView::instance();
 
@@ -167,7 +196,9 @@ void UnifiedEditHistory::Impl::removeRecordsAfter(int index)
     auto size0 = static_cast<int>(records.size());
     records.resize(index == 0 ? 0 : (index - 1));
     auto size1 = static_cast<int>(records.size());
+    isLatestRecordMergeable = false;
     if(size1 != size0){
+        updateMemoryUsage();
         bool positionChanged = false;
         if(currentPosition > size1){
             currentPosition = size1;
@@ -221,6 +252,18 @@ void UnifiedEditHistory::Impl::flushNewRecordBuffer()
         return;
     }
 
+    // Merge the consecutive records on the same target in the buffer
+    size_t numRecords = 1;
+    for(size_t i=1; i < newRecordBuffer.size(); ++i){
+        auto& record = newRecordBuffer[i];
+        if(!mergeRecord(newRecordBuffer[numRecords - 1], record)){
+            newRecordBuffer[numRecords++] = record;
+        }
+    }
+    newRecordBuffer.resize(numRecords);
+
+    auto now = std::chrono::steady_clock::now();
+
     EditRecordPtr newRecord;
     if(newRecordBuffer.size() == 1){
         newRecord = newRecordBuffer.front();
@@ -231,17 +274,65 @@ void UnifiedEditHistory::Impl::flushNewRecordBuffer()
         }
         newRecord = group;
     }
-    if(currentPosition >= 1){
-        expandHistoryFromLatestToCurrentUndoPosition();
+    newRecordBuffer.clear();
+
+    bool merged = false;
+    if(currentPosition == 0 && !records.empty() && isLatestRecordMergeable && recordMergeInterval > 0.0){
+        double elapsed = std::chrono::duration<double>(now - lastRecordTime).count();
+        if(elapsed <= recordMergeInterval){
+            auto& latestRecord = records.front();
+            size_t latestRecordUsage = latestRecord->memoryUsage();
+            if(mergeRecord(latestRecord, newRecord)){
+                memoryUsage = memoryUsage - latestRecordUsage + latestRecord->memoryUsage();
+                merged = true;
+            }
+        }
     }
-    records.push_front(newRecord);
+    if(!merged){
+        if(currentPosition >= 1){
+            expandHistoryFromLatestToCurrentUndoPosition();
+        }
+        records.push_front(newRecord);
+        memoryUsage += newRecord->memoryUsage();
+        removeOldRecordsExceedingLimits();
+    }
+    lastRecordTime = now;
+    isLatestRecordMergeable = true;
     
-    while(records.size() > maxHistorySize &&
-          currentPosition < static_cast<int>(records.size())){
+    sigHistoryUpdated();
+}
+
+
+bool UnifiedEditHistory::Impl::mergeRecord(EditRecord* record, EditRecord* nextRecord)
+{
+    if(record->isReverse() || nextRecord->isReverse()){
+        return false;
+    }
+    auto target = record->targetObject();
+    if(!target || target != nextRecord->targetObject()){
+        return false;
+    }
+    return record->merge(nextRecord);
+}
+
+
+void UnifiedEditHistory::Impl::removeOldRecordsExceedingLimits()
+{
+    while(records.size() > 1 && currentPosition < static_cast<int>(records.size()) &&
+          (records.size() > maxHistorySize || memoryUsage > maxMemoryUsage)){
+        size_t usage = records.back()->memoryUsage();
+        memoryUsage = (usage < memoryUsage) ? (memoryUsage - usage) : 0;
         records.pop_back();
     }
-    newRecordBuffer.clear();
-    sigHistoryUpdated();
+}
+
+
+void UnifiedEditHistory::Impl::updateMemoryUsage()
+{
+    memoryUsage = 0;
+    for(auto& record : records){
+        memoryUsage += record->memoryUsage();
+    }
 }
 
 
@@ -253,6 +344,7 @@ void UnifiedEditHistory::Impl::expandHistoryFromLatestToCurrentUndoPosition()
     }
     for(auto& record : undoRecords){
         records.push_front(record);
+        memoryUsage += record->memoryUsage();
     }
     currentPosition = 0;
 }
@@ -336,6 +428,50 @@ void RecordBlockerImpl::finishBlocking()
 }
 
 
+void UnifiedEditHistory::setMaxNumRecords(int n)
+{
+    impl->maxHistorySize = std::max(n, 1);
+    impl->removeOldRecordsExceedingLimits();
+}
+
+
+int UnifiedEditHistory::maxNumRecords() const
+{
+    return impl->maxHistorySize;
+}
+
+
+void UnifiedEditHistory::setMaxMemoryUsage(size_t bytes)
+{
+    impl->maxMemoryUsage = bytes;
+    impl->removeOldRecordsExceedingLimits();
+}
+
+
+size_t UnifiedEditHistory::maxMemoryUsage() const
+{
+    return impl->maxMemoryUsage;
+}
+
+
+size_t UnifiedEditHistory::memoryUsage() const
+{
+    return impl->memoryUsage;
+}
+
+
+void UnifiedEditHistory::setRecordMergeInterval(double seconds)
+{
+    impl->recordMergeInterval = seconds;
+}
+
+
+double UnifiedEditHistory::recordMergeInterval() const
+{
+    return impl->recordMergeInterval;
+}
+
+
 int UnifiedEditHistory::currentPosition() const
 {
     return impl->currentPosition;
@@ -369,6 +505,7 @@ bool UnifiedEditHistory::Impl::undo()
         if(record->applyUndo()){
             mv->notify(format(_("Undo: {0}."), record->label()));
             ++currentPosition;
+            isLatestRecordMergeable = false;
             sigCurrentPositionChanged(currentPosition);
             done = true;
         } else {
@@ -397,6 +534,7 @@ bool UnifiedEditHistory::Impl::redo()
         if(record->applyRedo()){
             mv->notify(format(_("Redo: {0}."), record->label()));
             --currentPosition;
+            isLatestRecordMergeable = false;
             sigCurrentPositionChanged(currentPosition);
             done = true;
         } else {
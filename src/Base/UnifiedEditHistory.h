@@ -43,6 +43,25 @@ public:
 
     RecordBlockerHandle blockRecording(std::function<bool(EditRecord* record)> predicate);
 
+    void setMaxNumRecords(int n);
+    int maxNumRecords() const;
+
+    /**
+       The oldest records are removed when the total memory usage of the records exceeds this size.
+       The memory usage is estimated by EditRecord::memoryUsage.
+    */
+    void setMaxMemoryUsage(size_t bytes);
+    size_t maxMemoryUsage() const;
+    size_t memoryUsage() const;
+
+    /**
+       A new record is merged into the latest record by EditRecord::merge when the record is
+       on the same target object and it is added within this interval after the latest record.
+       Merging is disabled when the interval is zero.
+    */
+    void setRecordMergeInterval(double seconds);
+    double recordMergeInterval() const;
+
     int currentPosition() const;
     bool isUndoable() const;
     bool isRedoable() const;
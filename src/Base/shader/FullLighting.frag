@@ -5,7 +5,7 @@
 // #define USE_DOUBLE_PRECISION_IN_WIREFRAME_RENDERING 1
 
 #define MAX_NUM_LIGHTS 20
-#define MAX_NUM_SHADOWS 2
+#define MAX_NUM_SHADOWS 4
 
 #define USE_BLINN_PHONG_MODEL 1
 
@@ -14,6 +14,7 @@ in VertexData {
     vec3 normal;
     vec2 texCoord;
     vec3 colorV;
+    flat float textureLayer;
     vec4 shadowCoords[MAX_NUM_SHADOWS];
 
     flat int edgeSituation;
@@ -72,6 +73,8 @@ vec3 reflectionElements[MAX_NUM_LIGHTS];
 
 uniform bool isTextureEnabled;
 uniform sampler2D colorTexture;
+uniform bool isTextureArrayEnabled;
+uniform sampler2DArray colorTextureArray;
 uniform bool isVertexColorEnabled;
 uniform vec3 fogColor;
 uniform float maxFogDist;
@@ -84,9 +87,14 @@ uniform float wireframeWidth;
 
 uniform int numShadows;
 
+/*
+  The shadow map is only applied to the fragments whose depths in the view coordinate are
+  in depthRange. The cascaded shadow maps of a light use the consecutive ranges.
+*/
 struct ShadowInfo {
     int lightIndex;
     sampler2DShadow shadowMap;
+    vec2 depthRange;
 };
 
 /*
@@ -113,7 +121,12 @@ void main()
     float alpha2;
 
     if(isTextureEnabled){
-        vec4 texColor4 = texture(colorTexture, inData.texCoord);
+        vec4 texColor4;
+        if(isTextureArrayEnabled){
+            texColor4 = texture(colorTextureArray, vec3(inData.texCoord, inData.textureLayer));
+        } else {
+            texColor4 = texture(colorTexture, inData.texCoord);
+        }
         vec3 texColor = vec3(texColor4);
         alpha2 = alpha * texColor4.a;
         color = emissionColor * texColor;
@@ -136,7 +149,11 @@ void main()
         }
     }
 
+    float depth = -inData.position.z;
     for(int i=0; i < numShadows; ++i){
+        if(depth < shadows[i].depthRange.x || depth >= shadows[i].depthRange.y){
+            continue;
+        }
         float shadow;
         vec4 shadowCoord = inData.shadowCoords[i];
         if(isShadowAntiAliasingEnabled){
@@ -1,17 +1,28 @@
 #version 330
 
-#define MAX_NUM_SHADOWS 2
+#define MAX_NUM_SHADOWS 4
 
 layout (location = 0) in vec4 vertexPosition;
 layout (location = 1) in vec3 vertexNormal;
 layout (location = 2) in vec2 vertexTexCoord;
 layout (location = 3) in vec3 vertexColor;
 
+/*
+  The model matrix of each instance for the instanced drawing. The shapes drawn without
+  the instanced drawing give the identity matrix as the current value of the attribute,
+  and the other matrices include their model matrices in that case.
+*/
+layout (location = 4) in mat4 instanceMatrix;
+
+// The layer of the color texture array given to each instance when the texture array is enabled
+layout (location = 8) in float instanceTextureLayer;
+
 out VertexData {
     vec3 position;
     vec3 normal;
     vec2 texCoord;
     vec3 colorV;
+    flat float textureLayer;
     vec4 shadowCoords[MAX_NUM_SHADOWS];
 } outData;
 
@@ -38,15 +49,18 @@ uniform mat4 shadowMatrices[MAX_NUM_SHADOWS];
 
 void main()
 {
-    outData.normal = normalize(normalMatrix * vertexNormal);
-    outData.position = vec3(modelViewMatrix * vertexPosition);
+    vec4 position = instanceMatrix * vertexPosition;
+    
+    outData.normal = normalize(normalMatrix * (mat3(instanceMatrix) * vertexNormal));
+    outData.position = vec3(modelViewMatrix * position);
 
     outData.texCoord = vertexTexCoord;
     outData.colorV = vertexColor;
+    outData.textureLayer = instanceTextureLayer;
     
     for(int i=0; i < numShadows; ++i){
-        outData.shadowCoords[i] = shadowMatrices[i] * vertexPosition;
+        outData.shadowCoords[i] = shadowMatrices[i] * position;
     }
     
-    gl_Position = MVP * vertexPosition;
+    gl_Position = MVP * position;
 }
@@ -0,0 +1,263 @@
+#include "BatchCollisionChecker.h"
+#include "BodyCollisionDetector.h"
+#include "Body.h"
+#include "Link.h"
+#include <cnoid/ThreadPool>
+#include <atomic>
+#include <mutex>
+#include <memory>
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+const int ConfigurationChunkSize = 32;
+
+class Worker
+{
+public:
+    BodyPtr body;
+    vector<BodyPtr> environmentBodies;
+    BodyCollisionDetector detector;
+
+    Worker(Body* orgBody, bool isSelfCollisionDetectionEnabled, const vector<BodyPtr>& orgEnvironmentBodies,
+           CollisionDetector* orgCollisionDetector);
+    void setInitialPositions(const Body* orgBody, const vector<BodyPtr>& orgEnvironmentBodies);
+    bool checkCollision(const double* q, int qStride);
+};
+
+}
+
+namespace cnoid {
+
+class BatchCollisionChecker::Impl
+{
+public:
+    BodyPtr body;
+    bool isSelfCollisionDetectionEnabled;
+    vector<BodyPtr> environmentBodies;
+    CollisionDetectorPtr collisionDetector;
+    int numThreads;
+    unique_ptr<ThreadPool> threadPool;
+    vector<unique_ptr<Worker>> workers;
+    std::atomic<int> nextConfigurationIndex;
+    std::mutex resultMutex;
+
+    Impl();
+    bool prepareWorkers();
+    void checkConfigurations(Worker* worker, const MatrixXd& q, vector<bool>& out_collided);
+};
+
+}
+
+
+Worker::Worker
+(Body* orgBody, bool isSelfCollisionDetectionEnabled, const vector<BodyPtr>& orgEnvironmentBodies,
+ CollisionDetector* orgCollisionDetector)
+{
+    detector.setCollisionDetector(orgCollisionDetector->clone());
+    body = orgBody->clone();
+    detector.addBody(body, isSelfCollisionDetectionEnabled);
+    for(auto& orgEnvironmentBody : orgEnvironmentBodies){
+        BodyPtr environmentBody = orgEnvironmentBody->clone();
+        detector.addBody(environmentBody, false);
+        environmentBodies.push_back(environmentBody);
+    }
+    detector.makeReady();
+}
+
+
+void Worker::setInitialPositions(const Body* orgBody, const vector<BodyPtr>& orgEnvironmentBodies)
+{
+    body->rootLink()->setPosition(orgBody->rootLink()->position());
+    for(size_t i=0; i < environmentBodies.size(); ++i){
+        auto orgEnvironmentBody = orgEnvironmentBodies[i].get();
+        auto environmentBody = environmentBodies[i];
+        const int n = orgEnvironmentBody->numLinks();
+        for(int j=0; j < n; ++j){
+            environmentBody->link(j)->setPosition(orgEnvironmentBody->link(j)->position());
+        }
+    }
+}
+
+
+bool Worker::checkCollision(const double* q, int qStride)
+{
+    const int numJoints = body->numJoints();
+    for(int i=0; i < numJoints; ++i){
+        body->joint(i)->q() = q[i * qStride];
+    }
+    body->calcForwardKinematics();
+    detector.updatePositions();
+
+    bool collided = false;
+    Body* targetBody = body;
+    detector.detectCollisions(
+        [&collided, targetBody](const CollisionPair& collisionPair){
+            if(static_cast<Link*>(collisionPair.object(0))->body() == targetBody ||
+               static_cast<Link*>(collisionPair.object(1))->body() == targetBody){
+                collided = true;
+            }
+        });
+    return collided;
+}
+
+
+BatchCollisionChecker::BatchCollisionChecker()
+{
+    impl = new Impl;
+}
+
+
+BatchCollisionChecker::BatchCollisionChecker(Body* body, CollisionDetector* collisionDetector)
+{
+    impl = new Impl;
+    setCollisionDetector(collisionDetector);
+    setBody(body);
+}
+
+
+BatchCollisionChecker::Impl::Impl()
+{
+    isSelfCollisionDetectionEnabled = true;
+    numThreads = 0;
+}
+
+
+BatchCollisionChecker::~BatchCollisionChecker()
+{
+    delete impl;
+}
+
+
+void BatchCollisionChecker::setCollisionDetector(CollisionDetector* collisionDetector)
+{
+    impl->collisionDetector = collisionDetector;
+    impl->workers.clear();
+}
+
+
+void BatchCollisionChecker::setBody(Body* body, bool isSelfCollisionDetectionEnabled)
+{
+    impl->body = body;
+    impl->isSelfCollisionDetectionEnabled = isSelfCollisionDetectionEnabled;
+    impl->workers.clear();
+}
+
+
+Body* BatchCollisionChecker::body() const
+{
+    return impl->body;
+}
+
+
+void BatchCollisionChecker::addEnvironmentBody(Body* body)
+{
+    impl->environmentBodies.push_back(body);
+    impl->workers.clear();
+}
+
+
+void BatchCollisionChecker::clearEnvironmentBodies()
+{
+    impl->environmentBodies.clear();
+    impl->workers.clear();
+}
+
+
+void BatchCollisionChecker::setNumThreads(int n)
+{
+    if(n < 0){
+        n = 0;
+    }
+    if(n != impl->numThreads){
+        impl->numThreads = n;
+        impl->threadPool.reset();
+        impl->workers.clear();
+    }
+}
+
+
+int BatchCollisionChecker::numThreads() const
+{
+    return impl->numThreads;
+}
+
+
+bool BatchCollisionChecker::Impl::prepareWorkers()
+{
+    if(!body || !collisionDetector){
+        return false;
+    }
+    const int numWorkers = std::max(numThreads, 1);
+    if(workers.empty()){
+        for(int i=0; i < numWorkers; ++i){
+            workers.emplace_back(
+                new Worker(body, isSelfCollisionDetectionEnabled, environmentBodies, collisionDetector));
+        }
+    }
+    if(numThreads > 0 && !threadPool){
+        threadPool.reset(new ThreadPool(numThreads));
+    }
+    for(auto& worker : workers){
+        worker->setInitialPositions(body, environmentBodies);
+    }
+    return true;
+}
+
+
+int BatchCollisionChecker::check(const MatrixXd& jointDisplacements, std::vector<bool>& out_collided)
+{
+    const int numConfigurations = jointDisplacements.rows();
+    out_collided.assign(numConfigurations, false);
+
+    if(!impl->prepareWorkers() || jointDisplacements.cols() != impl->body->numJoints()){
+        return 0;
+    }
+
+    impl->nextConfigurationIndex = 0;
+    if(impl->numThreads == 0){
+        impl->checkConfigurations(impl->workers.front().get(), jointDisplacements, out_collided);
+    } else {
+        for(auto& worker : impl->workers){
+            auto w = worker.get();
+            impl->threadPool->start([this, w, &jointDisplacements, &out_collided](){
+                    impl->checkConfigurations(w, jointDisplacements, out_collided); });
+        }
+        impl->threadPool->wait();
+    }
+
+    int numCollided = 0;
+    for(int i=0; i < numConfigurations; ++i){
+        if(out_collided[i]){
+            ++numCollided;
+        }
+    }
+    return numCollided;
+}
+
+
+//! The results are written with a lock for the same reason as BatchInverseKinematics.
+void BatchCollisionChecker::Impl::checkConfigurations
+(Worker* worker, const MatrixXd& q, vector<bool>& out_collided)
+{
+    const int numConfigurations = q.rows();
+    const int qStride = q.outerStride();
+    bool collided[ConfigurationChunkSize];
+
+    while(true){
+        const int top = nextConfigurationIndex.fetch_add(ConfigurationChunkSize);
+        if(top >= numConfigurations){
+            break;
+        }
+        const int end = std::min(top + ConfigurationChunkSize, numConfigurations);
+        for(int i = top; i < end; ++i){
+            collided[i - top] = worker->checkCollision(&q(i, 0), qStride);
+        }
+        std::lock_guard<std::mutex> lock(resultMutex);
+        for(int i = top; i < end; ++i){
+            out_collided[i] = collided[i - top];
+        }
+    }
+}
@@ -0,0 +1,53 @@
+#ifndef CNOID_BODY_BATCH_COLLISION_CHECKER_H
+#define CNOID_BODY_BATCH_COLLISION_CHECKER_H
+
+#include <cnoid/EigenTypes>
+#include <vector>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+class Body;
+class CollisionDetector;
+
+/**
+   This class checks the collisions of a body for many joint configurations. The configurations
+   are divided into chunks processed by the threads, each of which has its own clones of the bodies
+   and the collision detector. The root link of the body and the links of the environment bodies
+   are fixed at their positions at the time of the check() call. The collisions between the
+   environment bodies are not reported.
+*/
+class CNOID_EXPORT BatchCollisionChecker
+{
+public:
+    BatchCollisionChecker();
+    BatchCollisionChecker(Body* body, CollisionDetector* collisionDetector);
+    ~BatchCollisionChecker();
+
+    //! The given detector is used as the prototype of the detectors of the threads.
+    void setCollisionDetector(CollisionDetector* collisionDetector);
+    void setBody(Body* body, bool isSelfCollisionDetectionEnabled = true);
+    Body* body() const;
+    void addEnvironmentBody(Body* body);
+    void clearEnvironmentBodies();
+
+    //! Zero means the main thread only, which is the default.
+    void setNumThreads(int n);
+    int numThreads() const;
+
+    /**
+       \param jointDisplacements The i-th row is the displacements of all the joints of the body
+       for the i-th configuration.
+       \param out_collided The i-th element is set to true if the i-th configuration collides.
+       \return The number of the configurations which collide
+    */
+    int check(const MatrixXd& jointDisplacements, std::vector<bool>& out_collided);
+
+private:
+    class Impl;
+    Impl* impl;
+};
+
+}
+
+#endif
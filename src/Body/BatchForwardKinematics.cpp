@@ -0,0 +1,324 @@
+/**
+   \file
+*/
+
+#include "BatchForwardKinematics.h"
+#include "Body.h"
+#include <cnoid/EigenUtil>
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+/*
+   The configurations are processed in the groups of this number, and the number of the
+   configurations is rounded up to it. The elements of a group are calculated together
+   as a fixed-size Eigen array so that the calculation is vectorized.
+*/
+const int ConfigurationAlignment = 4;
+
+typedef Eigen::Array<double, ConfigurationAlignment, 1> Lanes;
+
+inline Lanes load(const double* element, int k)
+{
+    return Eigen::Map<const Lanes>(element + k);
+}
+
+inline void store(double* element, int k, const Lanes& value)
+{
+    Eigen::Map<Lanes>(element + k) = value;
+}
+
+}
+
+
+BatchForwardKinematics::BatchForwardKinematics()
+{
+    numConfigurations_ = 0;
+    stride = 0;
+    isVelocityCalculated = false;
+}
+
+
+BatchForwardKinematics::BatchForwardKinematics(Body* body, int numConfigurations)
+    : BatchForwardKinematics()
+{
+    compile(body);
+    setNumConfigurations(numConfigurations);
+}
+
+
+void BatchForwardKinematics::compile(Body* body)
+{
+    const int n = body->numLinks();
+    links.resize(n);
+
+    for(int i=0; i < n; ++i){
+        auto link = body->link(i);
+        auto& info = links[i];
+        auto parent = link->parent();
+        info.parent = parent ? parent->index() : -1;
+        info.Rb = link->Rb();
+        info.b = link->b();
+        if(i == 0){
+            info.jointType = Link::FREE_JOINT;
+        } else if(link->isRevoluteJoint()){
+            info.jointType = Link::ROTATIONAL_JOINT;
+        } else if(link->isPrismaticJoint()){
+            info.jointType = Link::SLIDE_JOINT;
+        } else {
+            info.jointType = Link::FIXED_JOINT;
+        }
+        if(info.jointType == Link::ROTATIONAL_JOINT || info.jointType == Link::SLIDE_JOINT){
+            info.axis = link->a();
+        } else {
+            info.axis.setZero();
+        }
+        info.axisHat = hat(info.axis);
+        info.axisOuter = info.axis * info.axis.transpose();
+    }
+
+    setNumConfigurations(numConfigurations_);
+}
+
+
+void BatchForwardKinematics::setNumConfigurations(int n)
+{
+    numConfigurations_ = n;
+    stride = ((n + ConfigurationAlignment - 1) / ConfigurationAlignment) * ConfigurationAlignment;
+
+    const int numLinks = links.size();
+    q_.assign(numLinks * stride, 0.0);
+    dq_.assign(numLinks * stride, 0.0);
+    frames.assign(numLinks * NumFrameElements * stride, 0.0);
+    velocities.assign(numLinks * NumVelocityElements * stride, 0.0);
+    isVelocityCalculated = false;
+
+    if(numLinks > 0){
+        for(int k=0; k < n; ++k){
+            setRootPosition(k, Isometry3::Identity());
+        }
+    }
+}
+
+
+void BatchForwardKinematics::setRootPosition(int k, const Isometry3& T)
+{
+    for(int r=0; r < 3; ++r){
+        for(int c=0; c < 3; ++c){
+            frameElements(0, r * 3 + c)[k] = T.linear()(r, c);
+        }
+        frameElements(0, 9 + r)[k] = T.translation()[r];
+    }
+}
+
+
+void BatchForwardKinematics::setRootVelocity(int k, const Vector3& v, const Vector3& w)
+{
+    for(int r=0; r < 3; ++r){
+        velocityElements(0, r)[k] = v[r];
+        velocityElements(0, 3 + r)[k] = w[r];
+    }
+}
+
+
+void BatchForwardKinematics::readState(const Body* body, int k)
+{
+    auto rootLink = body->rootLink();
+    setRootPosition(k, rootLink->T());
+    setRootVelocity(k, rootLink->v(), rootLink->w());
+
+    const int n = links.size();
+    for(int i=1; i < n; ++i){
+        auto link = body->link(i);
+        q(i, k) = link->q();
+        dq(i, k) = link->dq();
+    }
+}
+
+
+void BatchForwardKinematics::calcForwardKinematics(bool calcVelocity)
+{
+    const int n = links.size();
+    for(int i=1; i < n; ++i){
+        calcLinkPositions(i);
+        if(calcVelocity){
+            calcLinkVelocities(i);
+        }
+    }
+    isVelocityCalculated = calcVelocity;
+}
+
+
+void BatchForwardKinematics::calcLinkPositions(int linkIndex)
+{
+    const auto& info = links[linkIndex];
+    const Matrix3& Rb = info.Rb;
+    const Vector3& b = info.b;
+    const double* parentFrame = frameElements(info.parent, 0);
+    double* frame = frameElements(linkIndex, 0);
+    const double* q = &q_[linkIndex * stride];
+
+    for(int k=0; k < stride; k += ConfigurationAlignment){
+        Lanes Rp[9];
+        for(int e=0; e < 9; ++e){
+            Rp[e] = load(parentFrame + e * stride, k);
+        }
+        Lanes M[9]; // Rp * Rb
+        for(int r=0; r < 3; ++r){
+            for(int c=0; c < 3; ++c){
+                M[r * 3 + c] = Rp[r * 3] * Rb(0, c) + Rp[r * 3 + 1] * Rb(1, c) + Rp[r * 3 + 2] * Rb(2, c);
+            }
+            const Lanes p = load(parentFrame + (9 + r) * stride, k)
+                + Rp[r * 3] * b[0] + Rp[r * 3 + 1] * b[1] + Rp[r * 3 + 2] * b[2];
+            store(frame + (9 + r) * stride, k, p);
+        }
+
+        if(info.jointType == Link::ROTATIONAL_JOINT){
+            // R = Rp * Rb * AngleAxis(q, a)
+            const Lanes qk = load(q, k);
+            const Lanes cs = qk.cos();
+            const Lanes sn = qk.sin();
+            const Lanes cs1 = 1.0 - cs;
+            const Matrix3& A = info.axisHat;
+            const Matrix3& AA = info.axisOuter;
+            Lanes Rj[9];
+            for(int r=0; r < 3; ++r){
+                for(int c=0; c < 3; ++c){
+                    Rj[r * 3 + c] = sn * A(r, c) + cs1 * AA(r, c);
+                }
+                Rj[r * 4] += cs;
+            }
+            for(int r=0; r < 3; ++r){
+                for(int c=0; c < 3; ++c){
+                    store(frame + (r * 3 + c) * stride, k,
+                          M[r * 3] * Rj[c] + M[r * 3 + 1] * Rj[3 + c] + M[r * 3 + 2] * Rj[6 + c]);
+                }
+            }
+        } else {
+            for(int e=0; e < 9; ++e){
+                store(frame + e * stride, k, M[e]);
+            }
+            if(info.jointType == Link::SLIDE_JOINT){
+                // p += q * R * d
+                const Lanes qk = load(q, k);
+                const Vector3& d = info.axis;
+                for(int r=0; r < 3; ++r){
+                    double* p = frame + (9 + r) * stride;
+                    store(p, k, load(p, k) + qk * (M[r * 3] * d[0] + M[r * 3 + 1] * d[1] + M[r * 3 + 2] * d[2]));
+                }
+            }
+        }
+    }
+}
+
+
+void BatchForwardKinematics::calcLinkVelocities(int linkIndex)
+{
+    const auto& info = links[linkIndex];
+    const Vector3& a = info.axis;
+    const double* parentFrame = frameElements(info.parent, 0);
+    const double* frame = frameElements(linkIndex, 0);
+    const double* parentVelocity = velocityElements(info.parent, 0);
+    double* velocity = velocityElements(linkIndex, 0);
+    const double* dq = &dq_[linkIndex * stride];
+
+    for(int k=0; k < stride; k += ConfigurationAlignment){
+        Lanes vp[3], wp[3];
+        for(int r=0; r < 3; ++r){
+            vp[r] = load(parentVelocity + r * stride, k);
+            wp[r] = load(parentVelocity + (3 + r) * stride, k);
+        }
+        Lanes v[3], w[3];
+
+        // v = vp + wp x (p - pp)
+        Lanes arm[3];
+        for(int r=0; r < 3; ++r){
+            arm[r] = load(frame + (9 + r) * stride, k) - load(parentFrame + (9 + r) * stride, k);
+        }
+        v[0] = vp[0] + wp[1] * arm[2] - wp[2] * arm[1];
+        v[1] = vp[1] + wp[2] * arm[0] - wp[0] * arm[2];
+        v[2] = vp[2] + wp[0] * arm[1] - wp[1] * arm[0];
+        for(int r=0; r < 3; ++r){
+            w[r] = wp[r];
+        }
+
+        if(info.jointType == Link::ROTATIONAL_JOINT || info.jointType == Link::SLIDE_JOINT){
+            // The joint axis in the world coordinate is R * a
+            const Lanes dqk = load(dq, k);
+            for(int r=0; r < 3; ++r){
+                const Lanes s =
+                    load(frame + (r * 3) * stride, k) * a[0] +
+                    load(frame + (r * 3 + 1) * stride, k) * a[1] +
+                    load(frame + (r * 3 + 2) * stride, k) * a[2];
+                if(info.jointType == Link::ROTATIONAL_JOINT){
+                    // w = wp + dq * R * a
+                    w[r] += dqk * s;
+                } else {
+                    // v += dq * R * d
+                    v[r] += dqk * s;
+                }
+            }
+        }
+
+        for(int r=0; r < 3; ++r){
+            store(velocity + r * stride, k, v[r]);
+            store(velocity + (3 + r) * stride, k, w[r]);
+        }
+    }
+}
+
+
+Vector3 BatchForwardKinematics::p(int linkIndex, int k) const
+{
+    return Vector3(frameElements(linkIndex, 9)[k], frameElements(linkIndex, 10)[k], frameElements(linkIndex, 11)[k]);
+}
+
+
+Matrix3 BatchForwardKinematics::R(int linkIndex, int k) const
+{
+    Matrix3 R;
+    for(int r=0; r < 3; ++r){
+        for(int c=0; c < 3; ++c){
+            R(r, c) = frameElements(linkIndex, r * 3 + c)[k];
+        }
+    }
+    return R;
+}
+
+
+Isometry3 BatchForwardKinematics::T(int linkIndex, int k) const
+{
+    Isometry3 T;
+    T.linear() = R(linkIndex, k);
+    T.translation() = p(linkIndex, k);
+    return T;
+}
+
+
+Vector3 BatchForwardKinematics::v(int linkIndex, int k) const
+{
+    return Vector3(velocityElements(linkIndex, 0)[k], velocityElements(linkIndex, 1)[k], velocityElements(linkIndex, 2)[k]);
+}
+
+
+Vector3 BatchForwardKinematics::w(int linkIndex, int k) const
+{
+    return Vector3(velocityElements(linkIndex, 3)[k], velocityElements(linkIndex, 4)[k], velocityElements(linkIndex, 5)[k]);
+}
+
+
+void BatchForwardKinematics::writeState(Body* body, int k) const
+{
+    const int n = links.size();
+    for(int i=0; i < n; ++i){
+        auto link = body->link(i);
+        link->setRotation(R(i, k));
+        link->setTranslation(p(i, k));
+        if(isVelocityCalculated){
+            link->v() = v(i, k);
+            link->w() = w(i, k);
+        }
+    }
+}
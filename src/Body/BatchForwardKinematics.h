@@ -0,0 +1,112 @@
+/**
+   \file
+   \brief The header file of the BatchForwardKinematics class
+*/
+
+#ifndef CNOID_BODY_BATCH_FORWARD_KINEMATICS_H
+#define CNOID_BODY_BATCH_FORWARD_KINEMATICS_H
+
+#include <cnoid/EigenTypes>
+#include <vector>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+class Body;
+
+/**
+   This class calculates the forward kinematics of multiple configurations of a body at once.
+   The link tree of the body is compiled into arrays of the parent indices, the joint axes and
+   the offsets, and the state of each link is stored as a structure of arrays over the
+   configurations so that the calculation for the configurations is vectorized.
+   The link indices are the same as those of the body, and index k specifies the configuration.
+   The configurations are processed in groups of four, so use Body::calcForwardKinematics()
+   for a single configuration. The positions and the velocities are the same as the ones given
+   by LinkTraverse::calcForwardKinematics() for all the joint types.
+*/
+class CNOID_EXPORT BatchForwardKinematics
+{
+public:
+    BatchForwardKinematics();
+    BatchForwardKinematics(Body* body, int numConfigurations = 1);
+
+    /**
+       The structure of the body is copied, so this must be called again when the joint types,
+       the axes or the offsets of the links are changed.
+    */
+    void compile(Body* body);
+
+    void setNumConfigurations(int n);
+    int numConfigurations() const { return numConfigurations_; }
+    int numLinks() const { return static_cast<int>(links.size()); }
+
+    double& q(int linkIndex, int k) { return q_[linkIndex * stride + k]; }
+    double q(int linkIndex, int k) const { return q_[linkIndex * stride + k]; }
+    double& dq(int linkIndex, int k) { return dq_[linkIndex * stride + k]; }
+    double dq(int linkIndex, int k) const { return dq_[linkIndex * stride + k]; }
+
+    void setRootPosition(int k, const Isometry3& T);
+    void setRootVelocity(int k, const Vector3& v, const Vector3& w);
+
+    //! Copy the joint displacements, the joint velocities and the root state of the body
+    void readState(const Body* body, int k = 0);
+
+    void calcForwardKinematics(bool calcVelocity = false);
+
+    Vector3 p(int linkIndex, int k) const;
+    Matrix3 R(int linkIndex, int k) const;
+    Isometry3 T(int linkIndex, int k) const;
+    Vector3 v(int linkIndex, int k) const;
+    Vector3 w(int linkIndex, int k) const;
+
+    //! Copy the calculated positions and velocities to the links of the body
+    void writeState(Body* body, int k = 0) const;
+
+private:
+    struct LinkInfo
+    {
+        int parent;
+        int jointType;
+        Matrix3 Rb;
+        Vector3 b;
+        Vector3 axis; // a for a rotational joint, d for a slide joint
+        Matrix3 axisHat;
+        Matrix3 axisOuter;
+    };
+    std::vector<LinkInfo> links;
+
+    int numConfigurations_;
+    int stride;
+    bool isVelocityCalculated;
+
+    std::vector<double> q_;
+    std::vector<double> dq_;
+
+    // 12 elements per link: R in the row-major order and p
+    enum { NumFrameElements = 12 };
+    std::vector<double> frames;
+
+    // 6 elements per link: v and w
+    enum { NumVelocityElements = 6 };
+    std::vector<double> velocities;
+
+    double* frameElements(int linkIndex, int element) {
+        return &frames[(linkIndex * NumFrameElements + element) * stride];
+    }
+    const double* frameElements(int linkIndex, int element) const {
+        return &frames[(linkIndex * NumFrameElements + element) * stride];
+    }
+    double* velocityElements(int linkIndex, int element) {
+        return &velocities[(linkIndex * NumVelocityElements + element) * stride];
+    }
+    const double* velocityElements(int linkIndex, int element) const {
+        return &velocities[(linkIndex * NumVelocityElements + element) * stride];
+    }
+
+    void calcLinkPositions(int linkIndex);
+    void calcLinkVelocities(int linkIndex);
+};
+
+}
+
+#endif
@@ -0,0 +1,304 @@
+#include "BatchInverseKinematics.h"
+#include "Body.h"
+#include "Link.h"
+#include "JointPath.h"
+#include "CompositeIK.h"
+#include <cnoid/ThreadPool>
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <cmath>
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+const int TargetChunkSize = 32;
+
+class Worker
+{
+public:
+    BodyPtr body;
+    shared_ptr<InverseKinematics> ik;
+    vector<shared_ptr<JointPath>> paths;
+
+    Worker(Body* orgBody, int endLinkIndex, const vector<int>& baseLinkIndices);
+    void setInitialPose(const Body* orgBody);
+    void restoreInitialPose(const Body* orgBody);
+};
+
+}
+
+namespace cnoid {
+
+class BatchInverseKinematics::Impl
+{
+public:
+    BodyPtr body;
+    int endLinkIndex;
+    vector<int> baseLinkIndices;
+    int numThreads;
+    unique_ptr<ThreadPool> threadPool;
+    vector<unique_ptr<Worker>> workers;
+    std::atomic<int> nextTargetIndex;
+    std::mutex resultMutex;
+
+    Impl();
+    bool prepareWorkers();
+    int solve(const PositionArray& targets, vector<bool>& out_solved, MatrixXd* out_q);
+    void solveTargets(Worker* worker, const PositionArray& targets, vector<bool>& out_solved, MatrixXd* out_q);
+};
+
+}
+
+
+Worker::Worker(Body* orgBody, int endLinkIndex, const vector<int>& baseLinkIndices)
+{
+    body = orgBody->clone();
+    Link* endLink = body->link(endLinkIndex);
+    if(baseLinkIndices.size() == 1){
+        auto path = JointPath::getCustomPath(body, body->link(baseLinkIndices.front()), endLink);
+        ik = path;
+        paths.push_back(path);
+    } else {
+        auto compositeIK = make_shared<CompositeIK>(body, endLink);
+        for(auto& index : baseLinkIndices){
+            compositeIK->addBaseLink(body->link(index));
+        }
+        for(int i=0; i < compositeIK->numJointPaths(); ++i){
+            paths.push_back(compositeIK->jointPath(i));
+        }
+        ik = compositeIK;
+    }
+}
+
+
+void Worker::setInitialPose(const Body* orgBody)
+{
+    const int n = orgBody->numLinks();
+    for(int i=0; i < n; ++i){
+        body->link(i)->q() = orgBody->link(i)->q();
+    }
+    body->rootLink()->setPosition(orgBody->rootLink()->position());
+    body->calcForwardKinematics();
+}
+
+
+//! Only the links of the joint paths are restored because the IK does not move the others.
+void Worker::restoreInitialPose(const Body* orgBody)
+{
+    for(auto& path : paths){
+        for(auto& joint : path->joints()){
+            joint->q() = orgBody->link(joint->index())->q();
+        }
+        path->calcForwardKinematics();
+    }
+}
+
+
+BatchInverseKinematics::BatchInverseKinematics()
+{
+    impl = new Impl;
+}
+
+
+BatchInverseKinematics::BatchInverseKinematics(Body* body, Link* baseLink, Link* endLink)
+{
+    impl = new Impl;
+    reset(body, endLink);
+    addBaseLink(baseLink);
+}
+
+
+BatchInverseKinematics::Impl::Impl()
+{
+    endLinkIndex = -1;
+    numThreads = 0;
+}
+
+
+BatchInverseKinematics::~BatchInverseKinematics()
+{
+    delete impl;
+}
+
+
+void BatchInverseKinematics::reset(Body* body, Link* endLink)
+{
+    impl->body = body;
+    impl->endLinkIndex = endLink ? endLink->index() : -1;
+    impl->baseLinkIndices.clear();
+    impl->workers.clear();
+}
+
+
+bool BatchInverseKinematics::addBaseLink(Link* baseLink)
+{
+    if(!impl->body || !baseLink || baseLink->body() != impl->body){
+        return false;
+    }
+    impl->baseLinkIndices.push_back(baseLink->index());
+    impl->workers.clear();
+    return true;
+}
+
+
+void BatchInverseKinematics::setNumThreads(int n)
+{
+    if(n < 0){
+        n = 0;
+    }
+    if(n != impl->numThreads){
+        impl->numThreads = n;
+        impl->threadPool.reset();
+        impl->workers.clear();
+    }
+}
+
+
+int BatchInverseKinematics::numThreads() const
+{
+    return impl->numThreads;
+}
+
+
+bool BatchInverseKinematics::Impl::prepareWorkers()
+{
+    if(!body || endLinkIndex < 0 || baseLinkIndices.empty()){
+        return false;
+    }
+    const int numWorkers = std::max(numThreads, 1);
+    if(workers.empty()){
+        for(int i=0; i < numWorkers; ++i){
+            workers.emplace_back(new Worker(body, endLinkIndex, baseLinkIndices));
+        }
+    }
+    if(numThreads > 0 && !threadPool){
+        threadPool.reset(new ThreadPool(numThreads));
+    }
+    for(auto& worker : workers){
+        worker->setInitialPose(body);
+    }
+    return true;
+}
+
+
+int BatchInverseKinematics::solve
+(const PositionArray& targets, std::vector<bool>& out_solved, MatrixXd& out_jointDisplacements)
+{
+    out_jointDisplacements.resize(targets.size(), impl->body ? impl->body->numJoints() : 0);
+    return impl->solve(targets, out_solved, &out_jointDisplacements);
+}
+
+
+int BatchInverseKinematics::solve(const PositionArray& targets, std::vector<bool>& out_solved)
+{
+    return impl->solve(targets, out_solved, nullptr);
+}
+
+
+int BatchInverseKinematics::Impl::solve(const PositionArray& targets, vector<bool>& out_solved, MatrixXd* out_q)
+{
+    const int numTargets = targets.size();
+    out_solved.assign(numTargets, false);
+
+    if(!prepareWorkers()){
+        return 0;
+    }
+
+    nextTargetIndex = 0;
+    if(numThreads == 0){
+        solveTargets(workers.front().get(), targets, out_solved, out_q);
+    } else {
+        for(auto& worker : workers){
+            auto w = worker.get();
+            threadPool->start([this, w, &targets, &out_solved, out_q](){
+                    solveTargets(w, targets, out_solved, out_q); });
+        }
+        threadPool->wait();
+    }
+
+    int numSolved = 0;
+    for(int i=0; i < numTargets; ++i){
+        if(out_solved[i]){
+            ++numSolved;
+        }
+    }
+    return numSolved;
+}
+
+
+/**
+   \note std::vector<bool> is a bit array, whose elements cannot be written by multiple threads
+   at the same time, so the results are written to it after each chunk is solved with a lock.
+*/
+void BatchInverseKinematics::Impl::solveTargets
+(Worker* worker, const PositionArray& targets, vector<bool>& out_solved, MatrixXd* out_q)
+{
+    const int numTargets = targets.size();
+    const int numJoints = worker->body->numJoints();
+    bool solved[TargetChunkSize];
+
+    while(true){
+        const int top = nextTargetIndex.fetch_add(TargetChunkSize);
+        if(top >= numTargets){
+            break;
+        }
+        const int end = std::min(top + TargetChunkSize, numTargets);
+        for(int i = top; i < end; ++i){
+            worker->restoreInitialPose(body);
+            solved[i - top] = worker->ik->calcInverseKinematics(targets[i]);
+            if(out_q){
+                for(int j=0; j < numJoints; ++j){
+                    (*out_q)(i, j) = worker->body->joint(j)->q();
+                }
+            }
+        }
+        std::lock_guard<std::mutex> lock(resultMutex);
+        for(int i = top; i < end; ++i){
+            out_solved[i] = solved[i - top];
+        }
+    }
+}
+
+
+void BatchInverseKinematics::calcReachabilityMap
+(const Vector3& lowerCorner, const Vector3& upperCorner, double resolution,
+ const std::vector<Matrix3>& orientations, Vector3i& out_gridSize, std::vector<float>& out_ratios)
+{
+    for(int i=0; i < 3; ++i){
+        out_gridSize[i] = std::max(0, static_cast<int>(std::floor((upperCorner[i] - lowerCorner[i]) / resolution)) + 1);
+    }
+    const int numPoints = out_gridSize.x() * out_gridSize.y() * out_gridSize.z();
+    const int numOrientations = orientations.size();
+
+    PositionArray targets;
+    targets.reserve(numPoints * numOrientations);
+    for(int z=0; z < out_gridSize.z(); ++z){
+        for(int y=0; y < out_gridSize.y(); ++y){
+            for(int x=0; x < out_gridSize.x(); ++x){
+                Isometry3 T;
+                T.translation() = lowerCorner + resolution * Vector3(x, y, z);
+                for(auto& R : orientations){
+                    T.linear() = R;
+                    targets.push_back(T);
+                }
+            }
+        }
+    }
+
+    vector<bool> solved;
+    impl->solve(targets, solved, nullptr);
+
+    out_ratios.resize(numPoints);
+    for(int i=0; i < numPoints; ++i){
+        int numSolved = 0;
+        for(int j=0; j < numOrientations; ++j){
+            if(solved[i * numOrientations + j]){
+                ++numSolved;
+            }
+        }
+        out_ratios[i] = numOrientations > 0 ? static_cast<float>(numSolved) / numOrientations : 0.0f;
+    }
+}
@@ -0,0 +1,65 @@
+#ifndef CNOID_BODY_BATCH_INVERSE_KINEMATICS_H
+#define CNOID_BODY_BATCH_INVERSE_KINEMATICS_H
+
+#include <cnoid/EigenTypes>
+#include <vector>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+class Body;
+class Link;
+
+/**
+   This class solves the inverse kinematics of a body for many target positions of a link.
+   The targets are divided into chunks processed by the threads, each of which has its own
+   clone of the body. The IK of each target is solved from the pose of the original body at
+   the time of the solve() call, so the solutions do not depend on the number of the threads.
+   The joint path given by JointPath::getCustomPath is used for a base link, and CompositeIK
+   is used for multiple base links.
+*/
+class CNOID_EXPORT BatchInverseKinematics
+{
+public:
+    typedef std::vector<Isometry3, Eigen::aligned_allocator<Isometry3>> PositionArray;
+
+    BatchInverseKinematics();
+    BatchInverseKinematics(Body* body, Link* baseLink, Link* endLink);
+    ~BatchInverseKinematics();
+
+    void reset(Body* body, Link* endLink);
+    bool addBaseLink(Link* baseLink);
+
+    //! Zero means the main thread only, which is the default.
+    void setNumThreads(int n);
+    int numThreads() const;
+
+    /**
+       \param out_jointDisplacements The i-th row is set to the displacements of all the joints
+       of the body for the i-th target. The row of an unsolved target is the initial pose.
+       \return The number of the solved targets
+    */
+    int solve(const PositionArray& targets, std::vector<bool>& out_solved, MatrixXd& out_jointDisplacements);
+
+    int solve(const PositionArray& targets, std::vector<bool>& out_solved);
+
+    /**
+       Calculates the reachability map of the end link in the box region given by the corners
+       with the grid points at intervals of the resolution. The map value of a point is the ratio
+       of the given orientations which the end link can take at the point.
+       \param out_ratios The ratios of the grid points, which are ordered with the x index
+       changing fastest and the z index changing slowest.
+    */
+    void calcReachabilityMap(
+        const Vector3& lowerCorner, const Vector3& upperCorner, double resolution,
+        const std::vector<Matrix3>& orientations,
+        Vector3i& out_gridSize, std::vector<float>& out_ratios);
+
+private:
+    class Impl;
+    Impl* impl;
+};
+
+}
+
+#endif
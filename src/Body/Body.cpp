@@ -6,6 +6,7 @@
 #include "Body.h"
 #include "BodyHandler.h"
 #include "BodyCustomizerInterface.h"
+#include "LinkArena.h"
 #include <cnoid/CloneMap>
 #include <cnoid/SceneGraph>
 #include <cnoid/EigenUtil>
@@ -52,6 +53,7 @@ public:
     double mass;
     std::string name;
     std::string modelName;
+    int linkTreeRevision;
 
     std::vector<BodyHandlerPtr> handlers;
 
@@ -95,6 +97,7 @@ Body::Body(Link* rootLink)
 
 Body::Impl::Impl(Body* self)
 {
+    linkTreeRevision = 0;
     customizerHandle = 0;
     customizerInterface = nullptr;
     bodyHandleEntity.body = self;
@@ -122,7 +125,11 @@ void Body::copyFrom(const Body* org, CloneMap* cloneMap)
     impl->modelName = org->impl->modelName;
     impl->info = org->impl->info;
 
-    setRootLink(cloneLinkTree(org->rootLink(), cloneMap));
+    {
+        // The links are placed contiguously in the order of the link indices
+        LinkArena arena(org->numLinks());
+        setRootLink(cloneLinkTree(org->rootLink(), cloneMap));
+    }
 
     if(cloneMap){
         // reference to the parent body
@@ -238,6 +245,7 @@ Link* Body::createEmptyJoint(int jointId)
 
 void Body::updateLinkTree()
 {
+    ++impl->linkTreeRevision;
     isStaticModel_ = true;
     
     impl->nameToLinkMap.clear();
@@ -299,6 +307,12 @@ void Body::updateLinkTree()
 }
 
 
+int Body::linkTreeRevision() const
+{
+    return impl->linkTreeRevision;
+}
+
+
 void Body::resetDefaultPosition(const Isometry3& T)
 {
     rootLink_->setOffsetPosition(T);
@@ -55,6 +55,12 @@ public:
     */
     void updateLinkTree();
 
+    /**
+       The number of the updates of the link tree, which can be used to check if the data
+       depending on the structure of the link tree is still valid.
+    */
+    int linkTreeRevision() const;
+
     void initializePosition();
     virtual void initializeState();
 
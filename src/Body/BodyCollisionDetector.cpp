@@ -33,6 +33,7 @@ public:
     funcToGetObjectAssociatedWithLink;
     vector<GeometryHandle> linkIndexToGeometryHandleMap;
     vector<bool> linkExclusionFlags;
+    vector<bool> linkContinuousFlags;
     unordered_set<IdPair<int>> ignoredLinkPairs;
     bool hasCustomObjectsAssociatedWithLinks;
     bool isGeometryHandleMapEnabled;
@@ -129,6 +130,8 @@ bool BodyCollisionDetector::Impl::addBody(Body* body, bool isSelfCollisionDetect
     linkIndexToGeometryHandleMap.resize(numLinks, 0);
     linkExclusionFlags.clear();
     linkExclusionFlags.resize(numLinks, false);
+    linkContinuousFlags.clear();
+    linkContinuousFlags.resize(numLinks, false);
     ignoredLinkPairs.clear();
 
     ListingPtr rules = body->info()->findListing("collision_detection_rules");
@@ -146,6 +149,21 @@ bool BodyCollisionDetector::Impl::addBody(Body* body, bool isSelfCollisionDetect
         }
     }
 
+    if(isSelfCollisionDetectionEnabled){
+        // The pairs found by SelfCollisionPairAnalyzer
+        auto& neverCollidingPairs = *body->info()->findListing("never_colliding_link_pairs");
+        for(auto& node : neverCollidingPairs){
+            auto& pairNode = *node->toListing();
+            if(pairNode.size() == 2){
+                auto link1 = body->link(pairNode[0].toString());
+                auto link2 = body->link(pairNode[1].toString());
+                if(link1 && link2){
+                    ignoredLinkPairs.emplace(link1->index(), link2->index());
+                }
+            }
+        }
+    }
+
     bool added = addLinkRecursively(body->rootLink(), true);
 
     if(isSelfCollisionDetectionEnabled){
@@ -243,6 +261,13 @@ void BodyCollisionDetector::Impl::checkCollisionDetectionTargets
                         }
                     }
                 }
+            } else if(rule == "continuous_links"){
+                // The collisions of the fast or thin links are detected along their motions
+                for(auto& node : *value->toListing()){
+                    if(auto link = body->link(node->toString())){
+                        linkContinuousFlags[link->index()] = true;
+                    }
+                }
             } else if(rule == "disabled_link_group"){
                 auto& disabledLinks = *value->toListing();
                 if(isSelfCollisionDetectionEnabled){
@@ -355,6 +380,9 @@ bool BodyCollisionDetector::Impl::addLinkRecursively(Link* link, bool isParentSt
             if(isStatic){
                 collisionDetector->setGeometryStatic(*handle, object);
             }
+            if(linkContinuousFlags[linkIndex]){
+                collisionDetector->setContinuousCollisionDetectionEnabled(*handle);
+            }
             linkIndexToGeometryHandleMap[linkIndex] = *handle;
             if(isGeometryHandleMapEnabled){
                 linkToGeometryHandleMap[link] = *handle;
@@ -6,12 +6,17 @@
 #include "BodyLoader.h"
 #include "StdBodyLoader.h"
 #include "VRMLBodyLoader.h"
+#include "SelfCollisionPairAnalyzer.h"
 #include "Body.h"
+#include "Link.h"
 #include <cnoid/SceneLoader>
+#include <cnoid/SceneGraph>
+#include <cnoid/ConvexDecomposition>
 #include <cnoid/ValueTree>
 #include <cnoid/Exception>
 #include <cnoid/NullOut>
 #include <cnoid/UTF8>
+#include <cnoid/Tracer>
 #include <cnoid/stdx/filesystem>
 #include <fmt/format.h>
 #include <mutex>
@@ -167,6 +172,7 @@ public:
     ~Impl();
     bool load(Body* body, const std::string& filename);
     void mergeExtraLinkInfos(Body* body, Mapping* info);
+    void convertCollisionShapes(Body* body);
 };
 
 }
@@ -258,6 +264,8 @@ Body* BodyLoader::load(const std::string& filename)
 
 bool BodyLoader::Impl::load(Body* body, const std::string& filename)
 {
+    CNOID_TRACE_ZONE("Body loading", "Loading");
+
     filesystem::path path(fromUTF8(filename));
     actualLoader = nullptr;
     string ext = path.extension().string();
@@ -305,12 +313,77 @@ bool BodyLoader::Impl::load(Body* body, const std::string& filename)
     } catch(const std::exception& ex){
         (*os) << ex.what();
     }
+
+    if(result){
+        if(isShapeLoadingEnabled){
+            convertCollisionShapes(body);
+        }
+        SelfCollisionPairAnalyzer::loadDefaultFileAndApply(body, filename, *os);
+    }
+    
     os->flush();
     
     return result;
 }
 
 
+/**
+   The collision shapes are replaced with the convex shapes when "collision_shape_mode" of the body
+   or the link is "convex_hull" or "convex_decomposition". The value of the link has priority.
+   The visual shapes are not changed.
+*/
+void BodyLoader::Impl::convertCollisionShapes(Body* body)
+{
+    auto bodyInfo = body->info();
+    string bodyMode = bodyInfo->get("collision_shape_mode", "mesh");
+    unique_ptr<ConvexDecomposition> decomposition;
+    
+    for(auto& link : body->links()){
+        string mode = link->info()->get("collision_shape_mode", bodyMode);
+        if(mode == "mesh"){
+            continue;
+        }
+        if(mode != "convex_hull" && mode != "convex_decomposition"){
+            (*os) << fmt::format(_("Collision shape mode \"{0}\" of link \"{1}\" is not supported."),
+                                 mode, link->name()) << endl;
+            continue;
+        }
+        if(!decomposition){
+            decomposition.reset(new ConvexDecomposition);
+            int n;
+            if(bodyInfo->read("max_num_convex_hulls", n)){
+                decomposition->setMaxNumHulls(n);
+            }
+            if(bodyInfo->read("max_num_convex_hull_vertices", n)){
+                decomposition->setMaxNumHullVertices(n);
+            }
+        }
+        int maxNumHulls = decomposition->maxNumHulls();
+        if(mode == "convex_hull"){
+            decomposition->setMaxNumHulls(1);
+        }
+        SgGroupPtr shapes = new SgGroup;
+        bool isConverted = false;
+        for(auto& node : *link->collisionShape()){
+            if(auto converted = decomposition->convertShape(node)){
+                shapes->addChild(converted);
+                isConverted = true;
+            } else {
+                shapes->addChild(node);
+            }
+        }
+        decomposition->setMaxNumHulls(maxNumHulls);
+
+        if(isConverted){
+            link->clearCollisionShapeNodes();
+            for(auto& node : *shapes){
+                link->addCollisionShapeNode(node);
+            }
+        }
+    }
+}
+
+
 AbstractBodyLoaderPtr BodyLoader::lastActualBodyLoader() const
 {
     return impl->actualLoader;
@@ -7,9 +7,11 @@
 #include "Body.h"
 #include "Link.h"
 #include "ZMPSeq.h"
+#include "BodyMotionPager.h"
 #include <cnoid/Vector3Seq>
 #include <cnoid/YAMLReader>
 #include <cnoid/YAMLWriter>
+#include <cnoid/BinarySeqFile>
 #include <fmt/format.h>
 #include "gettext.h"
 
@@ -19,6 +21,58 @@ using fmt::format;
 
 namespace {
 //bool TRACE_FUNCTIONS = false;
+
+const char* jointPosSeqName = "MultiJointDisplacementSeq";
+const char* linkPosSeqName = "MultiLinkPositionSeq";
+const char* relativeZMPSeqName = "RelativeZMPSeq";
+
+template<class SeqType, class PagedFrameFunction>
+void prependPagedFrames(SeqType& seq, int numPagedFrames, PagedFrameFunction pagedFrame)
+{
+    const int offset = static_cast<int>(std::lround(seq.offsetTime() * seq.frameRate()));
+    numPagedFrames = std::min(numPagedFrames, offset);
+    if(numPagedFrames <= 0){
+        return;
+    }
+    SeqType org(seq);
+    const int numParts = org.numParts();
+    // The frames that cannot be read from the pager are filled with the default values
+    seq.setDimension(0, numParts);
+    seq.setDimension(numPagedFrames + org.numFrames(), numParts, true);
+    seq.setOffsetTimeFrame(offset - numPagedFrames);
+    for(int i=0; i < numPagedFrames; ++i){
+        if(auto elements = pagedFrame(offset - numPagedFrames + i)){
+            std::copy(elements, elements + numParts, seq.frame(i).begin());
+        }
+    }
+    for(int i=0; i < org.numFrames(); ++i){
+        auto src = org.frame(i);
+        std::copy(src.begin(), src.end(), seq.frame(numPagedFrames + i).begin());
+    }
+}
+
+/**
+   The motion is copied with the frames stored in the pager so that the frames are not lost
+   in saving the motion.
+*/
+unique_ptr<BodyMotion> createMotionWithPagedFrames(const BodyMotion& motion)
+{
+    unique_ptr<BodyMotion> whole(new BodyMotion(motion));
+    whole->setPager(nullptr);
+    auto pager = motion.pager();
+    if(pager->numLinks() == whole->numLinks()){
+        prependPagedFrames(
+            *whole->linkPosSeq(), pager->numLinkPositionFrames(),
+            [&](int frame){ return pager->linkPositions(frame); });
+    }
+    if(pager->numJoints() == whole->numJoints()){
+        prependPagedFrames(
+            *whole->jointPosSeq(), pager->numJointDisplacementFrames(),
+            [&](int frame){ return pager->jointDisplacements(frame); });
+    }
+    return whole;
+}
+
 }
 
 
@@ -36,7 +90,8 @@ BodyMotion::BodyMotion()
 BodyMotion::BodyMotion(const BodyMotion& org)
     : AbstractSeq(org),
       linkPosSeq_(new MultiSE3Seq(*org.linkPosSeq_)),
-      jointPosSeq_(new MultiValueSeq(*org.jointPosSeq_))
+      jointPosSeq_(new MultiValueSeq(*org.jointPosSeq_)),
+      pager_(org.pager_)
 {
     for(ExtraSeqMap::const_iterator p = org.extraSeqs.begin(); p != org.extraSeqs.end(); ++p){
         extraSeqs.insert(ExtraSeqMap::value_type(p->first, p->second->cloneSeq()));
@@ -51,6 +106,7 @@ BodyMotion& BodyMotion::operator=(const BodyMotion& rhs)
     }
     *linkPosSeq_ = *rhs.linkPosSeq_;
     *jointPosSeq_ = *rhs.jointPosSeq_;
+    pager_ = rhs.pager_;
 
     //! \todo do copy instead of replacing the pointers to the cloned ones
     extraSeqs.clear();
@@ -286,6 +342,7 @@ bool BodyMotion::load(const std::string& filename, std::ostream& os)
 {
     YAMLReader reader;
     reader.expectRegularMultiListing();
+    reader.setCompactRowListingKey("frames");
     bool result = false;
 
     try {
@@ -471,6 +528,10 @@ bool BodyMotion::save(const std::string& filename, std::ostream& os)
 
 bool BodyMotion::save(const std::string& filename, double version, std::ostream& os)
 {
+    if(pager_){
+        return createMotionWithPagedFrames(*this)->save(filename, version, os);
+    }
+    
     YAMLWriter writer(filename);
     if(version > 0.0){
         writer.setInfo("formatVersion", version);
@@ -480,3 +541,72 @@ bool BodyMotion::save(const std::string& filename, double version, std::ostream&
 
     return writeSeq(writer);
 }
+
+
+bool BodyMotion::loadBinary(const std::string& filename, std::ostream& os)
+{
+    BinarySeqFile file;
+    file.setMessageSink(os);
+    if(!file.open(filename)){
+        return false;
+    }
+
+    setDimension(0, 1, 1);
+    bool loaded = true;
+    
+    for(int i=0; i < file.numSeqs(); ++i){
+        auto& name = file.seqName(i);
+        if(name == jointPosSeqName){
+            loaded = file.readSeq(i, jointPosSeq_.get());
+        } else if(name == linkPosSeqName){
+            loaded = file.readSeq(i, linkPosSeq_.get());
+        } else if(name == ZMPSeq::key() || name == relativeZMPSeqName){
+            auto zmpSeq = getOrCreateZMPSeq(*this);
+            loaded = file.readSeq(i, zmpSeq.get());
+            zmpSeq->setRootRelative(name == relativeZMPSeqName);
+        } else if(auto seq = file.readSeq(i)){
+            setExtraSeq(name, seq);
+        } else {
+            loaded = false;
+        }
+        if(!loaded){
+            break;
+        }
+    }
+
+    if(!loaded){
+        setDimension(0, 1, 1);
+    }
+
+    return loaded;
+}
+
+
+bool BodyMotion::saveBinary(const std::string& filename, bool doCompress, std::ostream& os)
+{
+    if(pager_){
+        return createMotionWithPagedFrames(*this)->saveBinary(filename, doCompress, os);
+    }
+    
+    BinarySeqFile file;
+    file.setMessageSink(os);
+    file.setCompressionEnabled(doCompress);
+    
+    if(linkPosSeq_->numFrames() > 0){
+        file.addSeq(linkPosSeqName, linkPosSeq_.get());
+    }
+    if(jointPosSeq_->numFrames() > 0){
+        file.addSeq(jointPosSeqName, jointPosSeq_.get());
+    }
+    for(auto& kv : extraSeqs){
+        auto& name = kv.first;
+        auto zmpSeq = dynamic_pointer_cast<ZMPSeq>(kv.second);
+        if(zmpSeq && zmpSeq->isRootRelative() && name == ZMPSeq::key()){
+            file.addSeq(relativeZMPSeqName, zmpSeq.get());
+        } else {
+            file.addSeq(name, kv.second.get());
+        }
+    }
+
+    return file.save(filename);
+}
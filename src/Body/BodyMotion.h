@@ -16,6 +16,7 @@
 namespace cnoid {
 
 class Body;
+class BodyMotionPager;
 
 class CNOID_EXPORT BodyMotion : public AbstractSeq
 {
@@ -99,6 +100,13 @@ public:
     bool save(const std::string& filename, std::ostream& os = nullout());
     bool save(const std::string& filename, double version, std::ostream& os = nullout());
 
+    /**
+       The binary format is read and written by BinarySeqFile. The extra sequences must be of the
+       types supported by BinarySeqFile to be saved in the binary format.
+    */
+    bool loadBinary(const std::string& filename, std::ostream& os = nullout());
+    bool saveBinary(const std::string& filename, bool doCompress = false, std::ostream& os = nullout());
+
     typedef std::map<std::string, std::shared_ptr<AbstractSeq>> ExtraSeqMap;
     typedef ExtraSeqMap::const_iterator ConstSeqIterator;
         
@@ -133,6 +141,14 @@ public:
 
     void clearExtraSeq(const std::string& name);
 
+    /**
+       The pager stores the frames before the offset time of this motion out of the memory.
+       The frames of the pager are not included in the frames of this motion, but they are
+       written with the frames of this motion by the save functions.
+    */
+    void setPager(std::shared_ptr<BodyMotionPager> pager) { pager_ = pager; }
+    std::shared_ptr<BodyMotionPager> pager() const { return pager_; }
+
     SignalProxy<void()> sigExtraSeqsChanged() {
         return sigExtraSeqsChanged_;
     }
@@ -162,6 +178,7 @@ private:
     std::shared_ptr<MultiSE3Seq> linkPosSeq_;
     std::shared_ptr<MultiValueSeq> jointPosSeq_;
     ExtraSeqMap extraSeqs;
+    std::shared_ptr<BodyMotionPager> pager_;
     Signal<void()> sigExtraSeqsChanged_;
 };
 
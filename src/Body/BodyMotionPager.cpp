@@ -0,0 +1,285 @@
+#include "BodyMotionPager.h"
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <algorithm>
+#include <iterator>
+#include <cstdio>
+#include <cstdint>
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+bool seekFile(FILE* file, int64_t pos)
+{
+#ifdef _WIN32
+    return _fseeki64(file, pos, SEEK_SET) == 0;
+#else
+    return fseeko(file, pos, SEEK_SET) == 0;
+#endif
+}
+
+/*
+  This class stores the frames of a fixed number of elements in a temporary file, which is
+  removed when it is closed. The frames of the last chunk are kept in the memory until the
+  chunk is completed.
+*/
+template<class ElementType, class Allocator = std::allocator<ElementType>>
+class PageStream
+{
+public:
+    typedef vector<ElementType, Allocator> Container;
+
+    FILE* file;
+    int frameSize;
+    int numChunkFrames;
+    int maxNumCachedChunks;
+    int numFrames;
+    int numWrittenChunks;
+    Container tailChunk;
+
+    struct CachedChunk {
+        int index;
+        Container data;
+    };
+    // The most recently used chunk is the first element
+    list<CachedChunk> cachedChunks;
+    unordered_map<int, typename list<CachedChunk>::iterator> chunkMap;
+
+    PageStream(){
+        file = nullptr;
+        frameSize = 0;
+        numFrames = 0;
+        numWrittenChunks = 0;
+    }
+
+    ~PageStream(){
+        close();
+    }
+
+    bool open(int frameSize, int numChunkFrames, int maxNumCachedChunks){
+        close();
+        file = std::tmpfile();
+        if(!file){
+            return false;
+        }
+        this->frameSize = frameSize;
+        this->numChunkFrames = numChunkFrames;
+        this->maxNumCachedChunks = maxNumCachedChunks;
+        tailChunk.reserve(frameSize * numChunkFrames);
+        return true;
+    }
+
+    void close(){
+        if(file){
+            std::fclose(file);
+            file = nullptr;
+        }
+        numFrames = 0;
+        numWrittenChunks = 0;
+        tailChunk.clear();
+        cachedChunks.clear();
+        chunkMap.clear();
+    }
+
+    int64_t chunkFilePosition(int chunkIndex) const {
+        return static_cast<int64_t>(chunkIndex) * numChunkFrames * frameSize * sizeof(ElementType);
+    }
+
+    bool append(const ElementType* frame){
+        if(!file){
+            return false;
+        }
+        tailChunk.insert(tailChunk.end(), frame, frame + frameSize);
+        ++numFrames;
+        if(static_cast<int>(tailChunk.size()) == numChunkFrames * frameSize){
+            if(!seekFile(file, chunkFilePosition(numWrittenChunks)) ||
+               std::fwrite(tailChunk.data(), sizeof(ElementType), tailChunk.size(), file) != tailChunk.size()){
+                tailChunk.resize(tailChunk.size() - frameSize);
+                --numFrames;
+                return false;
+            }
+            ++numWrittenChunks;
+            tailChunk.clear();
+        }
+        return true;
+    }
+
+    const ElementType* frame(int index){
+        if(index < 0 || index >= numFrames){
+            return nullptr;
+        }
+        int chunkIndex = index / numChunkFrames;
+        int offset = (index % numChunkFrames) * frameSize;
+        if(chunkIndex == numWrittenChunks){
+            return &tailChunk[offset];
+        }
+        auto p = chunkMap.find(chunkIndex);
+        if(p != chunkMap.end()){
+            cachedChunks.splice(cachedChunks.begin(), cachedChunks, p->second);
+            return &cachedChunks.front().data[offset];
+        }
+        if(static_cast<int>(cachedChunks.size()) >= maxNumCachedChunks){
+            // Reuse the least recently used chunk
+            chunkMap.erase(cachedChunks.back().index);
+            cachedChunks.splice(cachedChunks.begin(), cachedChunks, std::prev(cachedChunks.end()));
+        } else {
+            cachedChunks.emplace_front();
+        }
+        auto& chunk = cachedChunks.front();
+        chunk.data.resize(numChunkFrames * frameSize);
+        if(!seekFile(file, chunkFilePosition(chunkIndex)) ||
+           std::fread(chunk.data.data(), sizeof(ElementType), chunk.data.size(), file) != chunk.data.size()){
+            cachedChunks.pop_front();
+            return nullptr;
+        }
+        chunk.index = chunkIndex;
+        chunkMap[chunkIndex] = cachedChunks.begin();
+        return &chunk.data[offset];
+    }
+};
+
+}
+
+namespace cnoid {
+
+class BodyMotionPager::Impl
+{
+public:
+    int numChunkFrames;
+    int maxNumCachedChunks;
+    int numLinks;
+    int numJoints;
+    bool isOpen;
+    PageStream<SE3, Eigen::aligned_allocator<SE3>> linkPositionStream;
+    PageStream<double> jointDisplacementStream;
+
+    Impl();
+};
+
+}
+
+
+BodyMotionPager::BodyMotionPager()
+{
+    impl = new Impl;
+}
+
+
+BodyMotionPager::Impl::Impl()
+{
+    numChunkFrames = 256;
+    maxNumCachedChunks = 16;
+    numLinks = 0;
+    numJoints = 0;
+    isOpen = false;
+}
+
+
+BodyMotionPager::~BodyMotionPager()
+{
+    delete impl;
+}
+
+
+void BodyMotionPager::setNumChunkFrames(int n)
+{
+    impl->numChunkFrames = std::max(1, n);
+}
+
+
+void BodyMotionPager::setMaxNumCachedChunks(int n)
+{
+    impl->maxNumCachedChunks = std::max(1, n);
+}
+
+
+bool BodyMotionPager::open(int numLinks, int numJoints)
+{
+    close();
+
+    if(numLinks > 0){
+        if(!impl->linkPositionStream.open(numLinks, impl->numChunkFrames, impl->maxNumCachedChunks)){
+            return false;
+        }
+    }
+    if(numJoints > 0){
+        if(!impl->jointDisplacementStream.open(numJoints, impl->numChunkFrames, impl->maxNumCachedChunks)){
+            impl->linkPositionStream.close();
+            return false;
+        }
+    }
+    impl->numLinks = numLinks;
+    impl->numJoints = numJoints;
+    impl->isOpen = true;
+    return true;
+}
+
+
+void BodyMotionPager::close()
+{
+    impl->linkPositionStream.close();
+    impl->jointDisplacementStream.close();
+    impl->numLinks = 0;
+    impl->numJoints = 0;
+    impl->isOpen = false;
+}
+
+
+bool BodyMotionPager::isOpen() const
+{
+    return impl->isOpen;
+}
+
+
+int BodyMotionPager::numLinks() const
+{
+    return impl->numLinks;
+}
+
+
+int BodyMotionPager::numJoints() const
+{
+    return impl->numJoints;
+}
+
+
+int BodyMotionPager::numLinkPositionFrames() const
+{
+    return impl->linkPositionStream.numFrames;
+}
+
+
+int BodyMotionPager::numJointDisplacementFrames() const
+{
+    return impl->jointDisplacementStream.numFrames;
+}
+
+
+bool BodyMotionPager::appendLinkPositions(const SE3* positions)
+{
+    return impl->linkPositionStream.append(positions);
+}
+
+
+bool BodyMotionPager::appendJointDisplacements(const double* displacements)
+{
+    return impl->jointDisplacementStream.append(displacements);
+}
+
+
+/**
+   The returned pointer is valid until the frames are read or appended next time.
+*/
+const SE3* BodyMotionPager::linkPositions(int frame)
+{
+    return impl->linkPositionStream.frame(frame);
+}
+
+
+const double* BodyMotionPager::jointDisplacements(int frame)
+{
+    return impl->jointDisplacementStream.frame(frame);
+}
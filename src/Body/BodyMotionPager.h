@@ -0,0 +1,55 @@
+#ifndef CNOID_BODY_BODY_MOTION_PAGER_H
+#define CNOID_BODY_BODY_MOTION_PAGER_H
+
+#include <cnoid/EigenTypes>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+/**
+   This class stores the frames of link positions and joint displacements in temporary files
+   instead of the memory. The frames are appended to the end and are written to the files in
+   chunks of a fixed number of frames. In reading a frame, the chunk containing it is paged in,
+   and the chunks that have been read recently are kept in the memory up to the maximum number.
+
+   A BodyMotion object can have a pager that stores the frames before its offset time. The frame
+   index of a pager is counted from time zero with the frame rate of the motion.
+*/
+class CNOID_EXPORT BodyMotionPager
+{
+public:
+    BodyMotionPager();
+    ~BodyMotionPager();
+
+    BodyMotionPager(const BodyMotionPager&) = delete;
+    BodyMotionPager& operator=(const BodyMotionPager&) = delete;
+
+    //! These settings are applied by the open function
+    void setNumChunkFrames(int n);
+    void setMaxNumCachedChunks(int n);
+
+    //! The existing frames are cleared
+    bool open(int numLinks, int numJoints);
+    void close();
+    bool isOpen() const;
+
+    int numLinks() const;
+    int numJoints() const;
+    int numLinkPositionFrames() const;
+    int numJointDisplacementFrames() const;
+
+    bool appendLinkPositions(const SE3* positions);
+    bool appendJointDisplacements(const double* displacements);
+
+    //! \return nullptr if the frame is not stored or cannot be read
+    const SE3* linkPositions(int frame);
+    const double* jointDisplacements(int frame);
+
+private:
+    class Impl;
+    Impl* impl;
+};
+
+}
+
+#endif
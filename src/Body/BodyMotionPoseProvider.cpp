@@ -21,12 +21,13 @@ inline long lround(double x) {
 
 BodyMotionPoseProvider::BodyMotionPoseProvider()
 {
-
+    isFrameInterpolationEnabled = false;
 }
 
 
 BodyMotionPoseProvider::BodyMotionPoseProvider(Body* body_, std::shared_ptr<BodyMotion> motion)
 {
+    isFrameInterpolationEnabled = false;
     initialize(body_, motion);
 }
 
@@ -125,26 +126,47 @@ double BodyMotionPoseProvider::endingTime() const
 bool BodyMotionPoseProvider::seek
 (double time, int waistLinkIndex, const Vector3& waistTranslation, bool applyWaistTranslation)
 {
-    int frame = lround(time * motion->frameRate());
-    if(frame >= motion->numFrames()){
-        frame = motion->numFrames() - 1;
+    int frame;
+    double ratio = 0.0;
+    if(isFrameInterpolationEnabled){
+        frame = motion->jointPosSeq()->frameOfTime(time, ratio);
+    } else {
+        frame = lround(time * motion->frameRate());
+        if(frame >= motion->numFrames()){
+            frame = motion->numFrames() - 1;
+        }
     }
     const MultiValueSeq::Frame q = motion->jointPosSeq()->frame(frame);
-    for(int i=0; i < minNumJoints; ++i){
-        qTranslated[i] = q[i];
+    if(ratio > 0.0){
+        const MultiValueSeq::Frame q_next = motion->jointPosSeq()->frame(frame + 1);
+        for(int i=0; i < minNumJoints; ++i){
+            qTranslated[i] = q[i] + ratio * (q_next[i] - q[i]);
+        }
+    } else {
+        for(int i=0; i < minNumJoints; ++i){
+            qTranslated[i] = q[i];
+        }
     }
 
     if(waistLinkIndex != 0){
         return false;
     }
     
-    const SE3& waist = motion->linkPosSeq()->at(frame, 0);
+    SE3 waist = motion->linkPosSeq()->at(frame, 0);
+    if(ratio > 0.0){
+        waist = waist.interpolated(motion->linkPosSeq()->at(frame + 1, 0), ratio);
+    }
     T_waist.translation() = waist.translation();
     T_waist.linear() = Matrix3(waist.rotation());
     if(applyWaistTranslation){
         T_waist.translation() += waistTranslation;
         for(size_t i=0; i < footLinks.size(); ++i){
-            const Isometry3& foot = footLinkPositions->at(frame, i);
+            Isometry3 foot = footLinkPositions->at(frame, i);
+            if(ratio > 0.0){
+                SE3 interpolated = SE3(foot).interpolated(SE3(footLinkPositions->at(frame + 1, i)), ratio);
+                foot.translation() = interpolated.translation();
+                foot.linear() = interpolated.rotation().toRotationMatrix();
+            }
             auto ikPath = ikPaths[i];
             ikPath->setBaseLinkGoal(T_waist).calcInverseKinematics(foot);
             for(int j=0; j < ikPath->numJoints(); ++j){
@@ -155,10 +177,14 @@ bool BodyMotionPoseProvider::seek
     }
 
     if(zmpSeq){
+        Vector3 zmp = zmpSeq->at(frame);
+        if(ratio > 0.0 && frame + 1 < zmpSeq->numFrames()){
+            zmp += ratio * (zmpSeq->at(frame + 1) - zmp);
+        }
         if(zmpSeq->isRootRelative()){
-            ZMP_.noalias() = T_waist.linear() * zmpSeq->at(frame) + T_waist.translation();
+            ZMP_.noalias() = T_waist.linear() * zmp + T_waist.translation();
         } else {
-            ZMP_.noalias() = zmpSeq->at(frame);
+            ZMP_ = zmp;
         }
     }
     
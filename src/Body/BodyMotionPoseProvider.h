@@ -31,6 +31,12 @@ public:
 
     bool updateMotion();
 
+    /**
+       When the frame interpolation is enabled, the pose at a time between frames is interpolated
+       from the two frames around the time. Otherwise the nearest frame is used.
+    */
+    void setFrameInterpolationEnabled(bool on) { isFrameInterpolationEnabled = on; }
+
     virtual Body* body() const;
     virtual double beginningTime() const;
     virtual double endingTime() const;
@@ -52,6 +58,7 @@ private:
     std::vector<double> qTranslated;
     Isometry3 T_waist;
     Vector3 ZMP_;
+    bool isFrameInterpolationEnabled;
 
     bool seek(double time, int waistLinkIndex, const Vector3& waistTranslation, bool applyWaistTranslation);
 };
@@ -0,0 +1,166 @@
+#include "CollisionLog.h"
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+bool isSameCollision(const Collision& c1, const Collision& c2)
+{
+    return c1.point == c2.point && c1.normal == c2.normal && c1.depth == c2.depth && c1.id == c2.id;
+}
+
+}
+
+
+void CollisionLog::clear()
+{
+    frames.clear();
+    linkPairs.clear();
+    collisions_.clear();
+    bodies.clear();
+}
+
+
+int CollisionLog::findOrAddBody(Body* body)
+{
+    const int n = bodies.size();
+    for(int i=0; i < n; ++i){
+        if(bodies[i] == body){
+            return i;
+        }
+    }
+    bodies.push_back(body);
+    return n;
+}
+
+
+bool CollisionLog::isSameAsLastFrame(const CollisionLinkPairList& linkPairs) const
+{
+    if(frames.empty()){
+        return false;
+    }
+    const auto& last = frames.back();
+    if(static_cast<int>(linkPairs.size()) != last.numLinkPairs){
+        return false;
+    }
+    for(int i=0; i < last.numLinkPairs; ++i){
+        const auto& record = this->linkPairs[last.linkPairIndex + i];
+        const auto& linkPair = *linkPairs[i];
+        for(int j=0; j < 2; ++j){
+            if(bodies[record.bodyIndex[j]] != linkPair.body[j] || record.link[j] != linkPair.link[j]){
+                return false;
+            }
+        }
+        if(static_cast<int>(linkPair.collisions.size()) != record.numCollisions){
+            return false;
+        }
+        const Collision* recordedCollisions = collisions(record);
+        for(int j=0; j < record.numCollisions; ++j){
+            if(!isSameCollision(recordedCollisions[j], linkPair.collisions[j])){
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+
+void CollisionLog::appendFrame(const CollisionLinkPairList& linkPairs)
+{
+    if(isSameAsLastFrame(linkPairs)){
+        frames.push_back(frames.back());
+        return;
+    }
+
+    FrameRange range;
+    range.linkPairIndex = this->linkPairs.size();
+    range.numLinkPairs = linkPairs.size();
+
+    for(auto& linkPair : linkPairs){
+        LinkPairRecord record;
+        for(int i=0; i < 2; ++i){
+            record.bodyIndex[i] = findOrAddBody(linkPair->body[i]);
+            record.link[i] = linkPair->link[i];
+        }
+        record.collisionIndex = collisions_.size();
+        record.numCollisions = linkPair->collisions.size();
+        collisions_.insert(collisions_.end(), linkPair->collisions.begin(), linkPair->collisions.end());
+        this->linkPairs.push_back(record);
+    }
+
+    frames.push_back(range);
+}
+
+
+void CollisionLog::popFrontFrame()
+{
+    if(!frames.empty()){
+        frames.pop_front();
+        removeUnusedFrontElements();
+    }
+}
+
+
+/**
+   The elements of the front frames that have been popped are removed when the number of them
+   exceeds the number of the elements in use so that the cost of moving the remaining elements
+   is amortized.
+*/
+void CollisionLog::removeUnusedFrontElements()
+{
+    if(frames.empty()){
+        linkPairs.clear();
+        collisions_.clear();
+        return;
+    }
+
+    const int numUnusedLinkPairs = frames.front().linkPairIndex;
+    if(numUnusedLinkPairs == 0 || numUnusedLinkPairs < static_cast<int>(linkPairs.size()) - numUnusedLinkPairs){
+        return;
+    }
+    const int numUnusedCollisions =
+        (numUnusedLinkPairs < static_cast<int>(linkPairs.size())) ?
+        linkPairs[numUnusedLinkPairs].collisionIndex : collisions_.size();
+
+    linkPairs.erase(linkPairs.begin(), linkPairs.begin() + numUnusedLinkPairs);
+    collisions_.erase(collisions_.begin(), collisions_.begin() + numUnusedCollisions);
+
+    for(auto& range : frames){
+        range.linkPairIndex -= numUnusedLinkPairs;
+    }
+    for(auto& record : linkPairs){
+        record.collisionIndex -= numUnusedCollisions;
+    }
+}
+
+
+bool CollisionLog::isSameAsPreviousFrame(int frame) const
+{
+    if(frame <= 0 || frame >= numFrames()){
+        return false;
+    }
+    const auto& range = frames[frame];
+    const auto& prevRange = frames[frame - 1];
+    return range.linkPairIndex == prevRange.linkPairIndex && range.numLinkPairs == prevRange.numLinkPairs;
+}
+
+
+void CollisionLog::getLinkPairs(int frame, CollisionLinkPairList& out_linkPairs) const
+{
+    out_linkPairs.clear();
+
+    const int n = numLinkPairs(frame);
+    out_linkPairs.reserve(n);
+    for(int i=0; i < n; ++i){
+        const auto& record = linkPair(frame, i);
+        auto linkPair = std::make_shared<CollisionLinkPair>();
+        for(int j=0; j < 2; ++j){
+            linkPair->body[j] = bodies[record.bodyIndex[j]];
+            linkPair->link[j] = record.link[j];
+        }
+        const Collision* recordedCollisions = collisions(record);
+        linkPair->collisions.assign(recordedCollisions, recordedCollisions + record.numCollisions);
+        out_linkPairs.push_back(linkPair);
+    }
+}
@@ -0,0 +1,68 @@
+#ifndef CNOID_BODY_COLLISION_LOG_H
+#define CNOID_BODY_COLLISION_LOG_H
+
+#include "CollisionLinkPair.h"
+#include <deque>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+typedef std::vector<CollisionLinkPairPtr> CollisionLinkPairList;
+
+/**
+   This class stores the collisions of a sequence of frames in a compact form. The link pairs
+   and the collisions of all the frames are stored in the flat arrays, and each frame only has
+   the range of its link pairs in the array. A frame that has the same collisions as the previous
+   frame shares the range of the previous frame instead of storing the same data again.
+*/
+class CNOID_EXPORT CollisionLog
+{
+public:
+    struct LinkPairRecord
+    {
+        int bodyIndex[2];
+        Link* link[2];
+        int collisionIndex;
+        int numCollisions;
+    };
+
+    void clear();
+    int numFrames() const { return static_cast<int>(frames.size()); }
+
+    void appendFrame(const CollisionLinkPairList& linkPairs);
+    void popFrontFrame();
+
+    //! \return true if the frame shares the data of the previous frame
+    bool isSameAsPreviousFrame(int frame) const;
+
+    int numLinkPairs(int frame) const { return frames[frame].numLinkPairs; }
+    const LinkPairRecord& linkPair(int frame, int index) const {
+        return linkPairs[frames[frame].linkPairIndex + index];
+    }
+    Body* body(int bodyIndex) const { return bodies[bodyIndex]; }
+    const Collision* collisions(const LinkPairRecord& linkPair) const {
+        return &collisions_[linkPair.collisionIndex];
+    }
+
+    //! This function creates the link pair objects of a frame
+    void getLinkPairs(int frame, CollisionLinkPairList& out_linkPairs) const;
+
+private:
+    struct FrameRange
+    {
+        int linkPairIndex;
+        int numLinkPairs;
+    };
+    std::deque<FrameRange> frames;
+    std::vector<LinkPairRecord> linkPairs;
+    std::vector<Collision> collisions_;
+    std::vector<BodyPtr> bodies;
+
+    int findOrAddBody(Body* body);
+    bool isSameAsLastFrame(const CollisionLinkPairList& linkPairs) const;
+    void removeUnusedFrontElements();
+};
+
+}
+
+#endif
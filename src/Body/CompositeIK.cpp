@@ -64,6 +64,35 @@ void CompositeIK::setMaxIkError(double e)
 }
 
 
+bool CompositeIK::setCollisionAvoidance
+(BodyCollisionDetector* detector, double margin, double activationDistance)
+{
+    bool result = !paths.empty();
+    for(auto& path : paths){
+        result &= path->setCollisionAvoidance(detector, margin, activationDistance);
+    }
+    return result;
+}
+
+
+bool CompositeIK::addCollisionAvoidanceLinkPair(Link* link1, Link* link2)
+{
+    bool result = !paths.empty();
+    for(auto& path : paths){
+        result &= path->addCollisionAvoidanceLinkPair(link1, link2);
+    }
+    return result;
+}
+
+
+void CompositeIK::clearCollisionAvoidance()
+{
+    for(auto& path : paths){
+        path->clearCollisionAvoidance();
+    }
+}
+
+
 bool CompositeIK::calcInverseKinematics(const Isometry3& T)
 {
     const int n = body_->numJoints();
@@ -18,6 +18,7 @@ class Body;
 class Link;
 class LinkTraverse;
 class JointPath;
+class BodyCollisionDetector;
 
 class CNOID_EXPORT CompositeIK : public InverseKinematics
 {
@@ -37,6 +38,12 @@ public:
     void setMaxIkError(double e);
     bool hasCustomIK() const { return hasCustomIK_; }
 
+    //! \see JointPath::setCollisionAvoidance. The settings are applied to the joint paths added so far.
+    bool setCollisionAvoidance(
+        BodyCollisionDetector* detector, double margin = 0.005, double activationDistance = 0.05);
+    bool addCollisionAvoidanceLinkPair(Link* link1, Link* link2);
+    void clearCollisionAvoidance();
+
     virtual bool calcInverseKinematics(const Isometry3& T) override;
     virtual bool calcRemainingPartForwardKinematicsForInverseKinematics() override;
 
@@ -19,10 +19,13 @@
 #include <cnoid/EigenUtil>
 #include <cnoid/CloneMap>
 #include <cnoid/TimeMeasure>
+#include <cnoid/TaskScheduler>
 #include <fmt/format.h>
 #include <random>
 #include <unordered_map>
+#include <algorithm>
 #include <limits>
+#include <new>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
@@ -74,6 +77,16 @@ static const double THRESH_TO_SWITCH_REL_ERROR = 1.0e-8;
 
 static const bool USE_PREVIOUS_LCP_SOLUTION = true;
 
+// The types of the link pairs in the warm-start state of a snapshot
+enum WarmStartLinkPairType {
+    WarmStartContactLinkPair,
+    WarmStartExtraJointLinkPair,
+    WarmStart2dConstraintLinkPair,
+    NumWarmStartLinkPairTypes
+};
+
+static const bool DEFAULT_USE_VECTORIZED_GAUSS_SEIDEL = true;
+
 static const bool ENABLE_CONTACT_DEPTH_CORRECTION = true;
 
 // normal setting
@@ -85,6 +98,11 @@ static const double DEFAULT_CONTACT_CORRECTION_VELOCITY_RATIO = 5.0;
 static const double DEFAULT_CONTACT_CULLING_DISTANCE = 0.005;
 static const double DEFAULT_CONTACT_CULLING_DEPTH = 0.05;
 
+static const bool DEFAULT_USE_CONTACT_REDUCTION = false;
+static const int MAX_NUM_REDUCED_CONTACTS_PER_CLUSTER = 4;
+// cos(10 deg)
+static const double CONTACT_REDUCTION_NORMAL_COS_THRESH = 0.985;
+
 
 // test for mobile robots with wheels
 //static const double DEFAULT_CONTACT_CORRECTION_DEPTH = 0.005;
@@ -119,6 +137,41 @@ enum CollisionDetectionModeBit {
     SelfCollision = 2
 };
 
+/**
+   Buffer of an Eigen map which keeps the capacity of its high-water mark so that the matrix
+   is not reallocated when its size fluctuates with the number of the contacts.
+   The elements are not preserved by resize().
+*/
+template<class TMatrix>
+class HighWaterMarkBuffer
+{
+public:
+    typedef Eigen::Map<TMatrix> MapType;
+
+    HighWaterMarkBuffer() { }
+    HighWaterMarkBuffer(const HighWaterMarkBuffer&) = delete;
+
+    //! The map is re-seated on the buffer as the Eigen documentation recommends.
+    void resize(MapType& map, Eigen::Index rows, Eigen::Index cols){
+        reserve(rows * cols);
+        new (&map) MapType(buf.data(), rows, cols);
+    }
+    void resize(MapType& map, Eigen::Index size){
+        reserve(size);
+        new (&map) MapType(buf.data(), size);
+    }
+    size_t capacity() const { return buf.size(); }
+
+private:
+    std::vector<typename TMatrix::Scalar> buf;
+
+    void reserve(size_t size){
+        if(size > buf.size()){
+            buf.resize(size);
+        }
+    }
+};
+
 }
 
 namespace cnoid
@@ -193,6 +246,14 @@ public:
         vector<ConstraintPoint> constraintPoints;
         ContactMaterialExPtr contactMaterial;
         bool isNonContactConstraint;
+
+        // Impulses of the previous step used to warm-start the solver
+        struct StoredImpulse {
+            Vector3 localPoint; // position in the local coordinate of link[0]
+            double normalImpulse;
+            Vector3 frictionImpulse; // sum of the friction impulses applied to link[0]
+        };
+        vector<StoredImpulse> storedImpulses;
     };
 
     unordered_map<IdPair<GeometryHandle>, LinkPair> geometryPairToLinkPairMap;
@@ -203,6 +264,14 @@ public:
     double defaultContactCullingDepth;
     double defaultCoefficientOfRestitution;
 
+    bool isContactReductionEnabled;
+    // work buffers of the contact reduction
+    std::vector<int> candidateContactIndices;
+    std::vector<int> contactClusterIds;
+    std::vector<Vector3> contactClusterNormals;
+    std::vector<int> clusterContactIndices;
+    std::vector<int> reducedContactIndices;
+
     class ExtraJointLinkPair : public LinkPair
     {
     public:
@@ -224,6 +293,7 @@ public:
     vector<Constrain2dLinkPairPtr> constrain2dLinkPairs;
         
     std::vector<LinkPair*> constrainedLinkPairs;
+    std::vector<LinkPair*> linkPairsWithStoredImpulses;
 
     int globalNumConstraintVectors;
 
@@ -238,19 +308,30 @@ public:
 
     typedef Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> MatrixX;
     typedef VectorXd VectorX;
+    typedef HighWaterMarkBuffer<MatrixX>::MapType MatrixXMap;
+    typedef HighWaterMarkBuffer<VectorX>::MapType VectorXMap;
+    typedef Eigen::Block<MatrixXMap> MatrixXBlock;
         
     // Mlcp * solution + b   _|_  solution
-    MatrixX Mlcp;
+    MatrixXMap Mlcp { nullptr, 0, 0 };
+    HighWaterMarkBuffer<MatrixX> MlcpBuf;
 
     // constant acceleration term when no external force is applied
-    VectorX an0;
-    VectorX at0;
+    VectorXMap an0 { nullptr, 0 };
+    VectorXMap at0 { nullptr, 0 };
+    HighWaterMarkBuffer<VectorX> an0Buf;
+    HighWaterMarkBuffer<VectorX> at0Buf;
 
     // constant vector of LCP
-    VectorX b;
+    VectorXMap b { nullptr, 0 };
+    HighWaterMarkBuffer<VectorX> bBuf;
 
     // contact force solution: normal forces at contact points
-    VectorX solution;
+    VectorXMap solution { nullptr, 0 };
+    HighWaterMarkBuffer<VectorX> solutionBuf;
+    int peakLCPDimension;
+    int lastNumContactPoints;
+    int lastNumSolverIterations;
 
     // random number generator
     std::uniform_real_distribution<double> randomAngle;
@@ -258,12 +339,32 @@ public:
     
     // for special version of gauss sidel iterative solver
     std::vector<int> frictionIndexToContactIndex;
-    VectorX contactIndexToMu;
-    VectorX mcpHi;
-
+    VectorXMap contactIndexToMu { nullptr, 0 };
+    VectorXMap mcpHi { nullptr, 0 };
+    HighWaterMarkBuffer<VectorX> contactIndexToMuBuf;
+    HighWaterMarkBuffer<VectorX> mcpHiBuf;
+
+    // work vectors of the iterative solvers
+    VectorXMap prevSolution { nullptr, 0 };
+    VectorXMap nncgDirection { nullptr, 0 };
+    VectorXMap nncgResidual { nullptr, 0 };
+    HighWaterMarkBuffer<VectorX> prevSolutionBuf;
+    HighWaterMarkBuffer<VectorX> nncgDirectionBuf;
+    HighWaterMarkBuffer<VectorX> nncgResidualBuf;
+
+    // Column spans that can have non-zero elements in the rows of each constrained link pair
+    typedef std::pair<int, int> ColumnSpan;
+    std::vector<std::vector<ColumnSpan>> linkPairColumnSpans;
+    std::vector<std::vector<ColumnSpan>> ownColumnSpans;
+    std::unordered_map<DySubBody*, std::vector<int>> subBodyToLinkPairIndices;
+    std::vector<int> coupledLinkPairIndices;
+    std::vector<int> rowToLinkPairIndex;
+
+    int  mcpSolverType;
     int  maxNumGaussSeidelIteration;
     int  numGaussSeidelInitialIteration;
     double gaussSeidelErrorCriterion;
+    bool isGaussSeidelVectorizationEnabled;
     double contactCorrectionDepth;
     double contactCorrectionVelocityRatio;
 
@@ -271,6 +372,31 @@ public:
     int numGaussSeidelTotalCalls;
     int numGaussSeidelTotalLoopsMax;
 
+    int numThreadsForAccelerationMatrix;
+    TaskScheduler* taskScheduler;
+
+    // Accelerations of a sub-body under a test force calculated by a thread
+    struct TestForceAccels
+    {
+        int counter;
+        vector<Vector3> dvo;
+        vector<Vector3> dw;
+        vector<double> uu;
+        Vector3 dpf;
+        Vector3 dptau;
+    };
+
+    struct TestForceWorkspace
+    {
+        unordered_map<DySubBody*, TestForceAccels> accelsMap;
+        DySubBody* subBodies[2];
+        TestForceAccels* accels[2];
+    };
+
+    vector<TestForceWorkspace> testForceWorkspaces;
+    vector<std::pair<LinkPair*, ConstraintPoint*>> testForcePoints;
+    int accelerationMatrixCounter;
+
 
     Impl(DyWorldBase& world);
     ~Impl();
@@ -285,6 +411,9 @@ public:
     void solve();
     void setConstraintPoints();
     void extractConstraintPoints(const CollisionPair& collisionPair);
+    LinkPair* getOrCreateContactLinkPair(const IdPair<GeometryHandle>& idPair, DyLink* link0, DyLink* link1);
+    const std::vector<int>& reduceContacts(const LinkPair& linkPair, const vector<Collision>& collisions);
+    void selectContactsOfCluster(const vector<Collision>& collisions, const Vector3& normal);
     bool setContactConstraintPoint(LinkPair& linkPair, const Collision& collision);
     void setFrictionVectors(ConstraintPoint& constraintPoint);
     void setExtraJointConstraintPoints(const ExtraJointLinkPairPtr& linkPair);
@@ -295,37 +424,56 @@ public:
     void setAccelCalcSkipInformation();
     void setDefaultAccelerationVector();
     void setAccelerationMatrix();
+    bool canSetAccelerationMatrixInParallel();
+    void setAccelerationMatrixInParallel();
+    void setAccelerationMatrixColumns(TestForceWorkspace& workspace, LinkPair& linkPair, ConstraintPoint& constraint);
+    TestForceAccels& getTestForceAccels(TestForceWorkspace& workspace, DySubBody* subBody);
+    void applyTestForce(
+        TestForceWorkspace& workspace, LinkPair& linkPair, ConstraintPoint& constraint, int frictionIndex);
+    void calcABMForceElementsWithTestForce(
+        TestForceAccels& accels, DyLink* linkToApplyForce, const Vector3& f, const Vector3& tau);
+    void calcAccelsABM(DySubBody* subBody, TestForceAccels& accels);
+    void extractRelAccelsOfConstraintPoints(
+        TestForceWorkspace& workspace, MatrixXBlock& Kxn, MatrixXBlock& Kxt, int testForceIndex);
     void initABMForceElementsWithNoExtForce(DySubBody* subBody);
     void calcABMForceElementsWithTestForce(
         DySubBody* subBody, DyLink* linkToApplyForce, const Vector3& f, const Vector3& tau);
     void calcAccelsABM(DySubBody* subBody, int constraintIndex);
     void calcAccelsMM(DySubBody* bodyData, int constraintIndex);
     void extractRelAccelsOfConstraintPoints(
-        Eigen::Block<MatrixX>& Kxn, Eigen::Block<MatrixX>& Kxt, int testForceIndex, int constraintIndex);
+        MatrixXBlock& Kxn, MatrixXBlock& Kxt, int testForceIndex, int constraintIndex);
     void extractRelAccelsFromLinkPairCase1(
-        Eigen::Block<MatrixX>& Kxn, Eigen::Block<MatrixX>& Kxt,
+        MatrixXBlock& Kxn, MatrixXBlock& Kxt,
         LinkPair& linkPair, int testForceIndex, int constraintIndex);
     void extractRelAccelsFromLinkPairCase2(
-        Eigen::Block<MatrixX>& Kxn, Eigen::Block<MatrixX>& Kxt,
+        MatrixXBlock& Kxn, MatrixXBlock& Kxt,
         LinkPair& linkPair, int iTestForce, int iDefault, int testForceIndex, int constraintIndex);
     void extractRelAccelsFromLinkPairCase3(
-        Eigen::Block<MatrixX>& Kxn, Eigen::Block<MatrixX>& Kxt,
+        MatrixXBlock& Kxn, MatrixXBlock& Kxt,
         LinkPair& linkPair, int testForceIndex, int constraintIndex);
     void copySymmetricElementsOfAccelerationMatrix(
-        Eigen::Block<MatrixX>& Knn, Eigen::Block<MatrixX>& Ktn, Eigen::Block<MatrixX>& Knt, Eigen::Block<MatrixX>& Ktt);
+        MatrixXBlock& Knn, MatrixXBlock& Ktn, MatrixXBlock& Knt, MatrixXBlock& Ktt);
     void clearSingularPointConstraintsOfClosedLoopConnections();
     void setConstantVectorAndMuBlock();
+    void setLinkPairColumnSpans();
+    double calcRowProductExceptDiagonal(const MatrixXMap& M, const VectorXMap& x, int row) const;
     void addConstraintForceToLinks();
     void addConstraintForceToLink(LinkPair* linkPair, int ipair);
-    void solveMCPByProjectedGaussSeidel(const MatrixX& M, const VectorX& b, VectorX& x);
-    void solveMCPByProjectedGaussSeidelMainStep(const MatrixX& M, const VectorX& b, VectorX& x);
+    void setInitialSolutionFromStoredImpulses();
+    void storeImpulses();
+    void clearStoredImpulses();
+    void storeWarmStartState(std::vector<double>& out_state);
+    bool restoreWarmStartState(const std::vector<double>& state, size_t& io_position);
+    void solveMCPByProjectedGaussSeidel(const MatrixXMap& M, const VectorXMap& b, VectorXMap& x);
+    void solveMCPByProjectedGaussSeidelMainStep(const MatrixXMap& M, const VectorXMap& b, VectorXMap& x);
     void solveMCPByProjectedGaussSeidelInitial(
-        const MatrixX& M, const VectorX& b, VectorX& x, const int numIteration);
-    void checkLCPResult(MatrixX& M, VectorX& b, VectorX& x);
-    void checkMCPResult(MatrixX& M, VectorX& b, VectorX& x);
+        const MatrixXMap& M, const VectorXMap& b, VectorXMap& x, const int numIteration);
+    void solveMCPByNNCG(const MatrixXMap& M, const VectorXMap& b, VectorXMap& x);
+    void checkLCPResult(MatrixXMap& M, VectorXMap& b, VectorXMap& x);
+    void checkMCPResult(MatrixXMap& M, VectorXMap& b, VectorXMap& x);
 
 #ifdef USE_PIVOTING_LCP
-    bool callPathLCPSolver(MatrixX& Mlcp, VectorX& b, VectorX& solution);
+    bool callPathLCPSolver(MatrixXMap& Mlcp, VectorXMap& b, VectorXMap& solution);
 
     // for PATH solver
     std::vector<double> lb;
@@ -382,10 +530,19 @@ ConstraintForceSolver::Impl::Impl(DyWorldBase& world)
     defaultContactCullingDistance = DEFAULT_CONTACT_CULLING_DISTANCE;
     defaultContactCullingDepth = DEFAULT_CONTACT_CULLING_DEPTH;
     defaultCoefficientOfRestitution = 0.0;
+    isContactReductionEnabled = DEFAULT_USE_CONTACT_REDUCTION;
     
+    mcpSolverType = ConstraintForceSolver::GAUSS_SEIDEL_SOLVER;
     maxNumGaussSeidelIteration = DEFAULT_MAX_NUM_GAUSS_SEIDEL_ITERATION;
+    isGaussSeidelVectorizationEnabled = DEFAULT_USE_VECTORIZED_GAUSS_SEIDEL;
     numGaussSeidelInitialIteration = DEFAULT_NUM_GAUSS_SEIDEL_INITIAL_ITERATION;
     gaussSeidelErrorCriterion = DEFAULT_GAUSS_SEIDEL_ERROR_CRITERION;
+    numThreadsForAccelerationMatrix = 1;
+    taskScheduler = nullptr;
+    accelerationMatrixCounter = 0;
+    peakLCPDimension = 0;
+    lastNumContactPoints = 0;
+    lastNumSolverIterations = 0;
     contactCorrectionDepth = DEFAULT_CONTACT_CORRECTION_DEPTH;
     contactCorrectionVelocityRatio = DEFAULT_CONTACT_CORRECTION_VELOCITY_RATIO;
 
@@ -557,6 +714,7 @@ void ConstraintForceSolver::Impl::initialize(void)
     }
     geometryPairToLinkPairMap.clear();
     constrainedLinkPairs.clear();
+    linkPairsWithStoredImpulses.clear();
     extraJointLinkPairs.clear();
     constrain2dLinkPairs.clear();
 
@@ -584,6 +742,15 @@ void ConstraintForceSolver::Impl::initialize(void)
     if(ENABLE_RANDOM_STATIC_FRICTION_BASE){
         randomEngine.seed();
     }
+
+    // The columns are computed by the threads of the task scheduler shared in the process
+    testForceWorkspaces.clear();
+    if(numThreadsForAccelerationMatrix <= 1){
+        taskScheduler = nullptr;
+    } else {
+        taskScheduler = TaskScheduler::instance();
+        testForceWorkspaces.resize(numThreadsForAccelerationMatrix);
+    }
 }
 
 
@@ -668,6 +835,9 @@ void ConstraintForceSolver::Impl::solve()
 
     setConstraintPoints();
 
+    lastNumContactPoints = globalNumContactNormalVectors;
+    lastNumSolverIterations = 0;
+
     if(CFS_PUT_NUM_CONTACT_POINTS){
         cout << globalNumContactNormalVectors;
     }
@@ -713,10 +883,17 @@ void ConstraintForceSolver::Impl::solve()
 #ifdef USE_PIVOTING_LCP
         isConverged = callPathLCPSolver(Mlcp, b, solution);
 #else
-        if(!USE_PREVIOUS_LCP_SOLUTION || constraintsSizeChanged){
+        if(USE_PREVIOUS_LCP_SOLUTION){
+            setInitialSolutionFromStoredImpulses();
+        } else {
             solution.setZero();
         }
-        solveMCPByProjectedGaussSeidel(Mlcp, b, solution);
+        setLinkPairColumnSpans();
+        if(mcpSolverType == ConstraintForceSolver::NNCG_SOLVER){
+            solveMCPByNNCG(Mlcp, b, solution);
+        } else {
+            solveMCPByProjectedGaussSeidel(Mlcp, b, solution);
+        }
         isConverged = true;
 #endif
 
@@ -724,6 +901,7 @@ void ConstraintForceSolver::Impl::solve()
             ++numUnconverged;
             if(CFS_DEBUG)
                 os << "LCP didn't converge" << numUnconverged << std::endl;
+            clearStoredImpulses();
         } else {
             if(CFS_DEBUG)
                 os << "LCP converged" << std::endl;
@@ -733,7 +911,13 @@ void ConstraintForceSolver::Impl::solve()
             }
 
             addConstraintForceToLinks();
+
+            if(USE_PREVIOUS_LCP_SOLUTION){
+                storeImpulses();
+            }
         }
+    } else {
+        clearStoredImpulses();
     }
 
     prevGlobalNumConstraintVectors = globalNumConstraintVectors;
@@ -764,34 +948,11 @@ void ConstraintForceSolver::Impl::extractConstraintPoints(const CollisionPair& c
     LinkPair* pLinkPair;
     
     const IdPair<GeometryHandle> idPair(collisionPair.geometries());
-    auto p = geometryPairToLinkPairMap.find(idPair);
-
-    if(p != geometryPairToLinkPairMap.end()){
-        pLinkPair = &p->second;
-        pLinkPair->constraintPoints.clear();
-    } else {
-        LinkPair& linkPair = geometryPairToLinkPairMap.insert(make_pair(idPair, LinkPair())).first->second;
-        int material[2];
-        
-        for(int i=0; i < 2; ++i){
-            auto link = static_cast<DyLink*>(collisionPair.object(i));
-            linkPair.link[i] = link;
-            material[i] = link->materialId();
-        }
-        auto subBody0 = linkPair.link[0]->subBody();
-        auto subBody1 = linkPair.link[1]->subBody();
-        
-        linkPair.isBelongingToSameSubBody = (subBody0 == subBody1);
-        linkPair.isNonContactConstraint = false;
-
-        linkPair.contactMaterial =
-            static_cast<ContactMaterialEx*>(materialTable->contactMaterial(material[0], material[1]));
-        if(!linkPair.contactMaterial){
-            linkPair.contactMaterial = createContactMaterialFromMaterialPair(material[0], material[1]);
-        }
-        
-        pLinkPair = &linkPair;
-    }
+    pLinkPair = getOrCreateContactLinkPair(
+        idPair,
+        static_cast<DyLink*>(collisionPair.object(0)),
+        static_cast<DyLink*>(collisionPair.object(1)));
+    pLinkPair->constraintPoints.clear();
 
     const vector<Collision>& collisions = collisionPair.collisions();
 
@@ -806,8 +967,14 @@ void ConstraintForceSolver::Impl::extractConstraintPoints(const CollisionPair& c
     pLinkPair->link[0]->subBody()->hasConstrainedLinks = true;
     pLinkPair->link[1]->subBody()->hasConstrainedLinks = true;
     
-    for(auto& collision : collisions){
-        setContactConstraintPoint(*pLinkPair, collision);
+    if(isContactReductionEnabled && static_cast<int>(collisions.size()) > MAX_NUM_REDUCED_CONTACTS_PER_CLUSTER){
+        for(auto& index : reduceContacts(*pLinkPair, collisions)){
+            setContactConstraintPoint(*pLinkPair, collisions[index]);
+        }
+    } else {
+        for(auto& collision : collisions){
+            setContactConstraintPoint(*pLinkPair, collision);
+        }
     }
 
     if(!pLinkPair->constraintPoints.empty()){
@@ -816,6 +983,162 @@ void ConstraintForceSolver::Impl::extractConstraintPoints(const CollisionPair& c
 }
 
 
+//! The link pair is kept over the steps so that its warm-start impulses are available
+ConstraintForceSolver::Impl::LinkPair* ConstraintForceSolver::Impl::getOrCreateContactLinkPair
+(const IdPair<GeometryHandle>& idPair, DyLink* link0, DyLink* link1)
+{
+    auto p = geometryPairToLinkPairMap.find(idPair);
+    if(p != geometryPairToLinkPairMap.end()){
+        return &p->second;
+    }
+
+    LinkPair& linkPair = geometryPairToLinkPairMap.insert(make_pair(idPair, LinkPair())).first->second;
+    linkPair.link[0] = link0;
+    linkPair.link[1] = link1;
+    int material[2] = { link0->materialId(), link1->materialId() };
+    
+    linkPair.isBelongingToSameSubBody = (link0->subBody() == link1->subBody());
+    linkPair.isNonContactConstraint = false;
+
+    linkPair.contactMaterial =
+        static_cast<ContactMaterialEx*>(materialTable->contactMaterial(material[0], material[1]));
+    if(!linkPair.contactMaterial){
+        linkPair.contactMaterial = createContactMaterialFromMaterialPair(material[0], material[1]);
+    }
+    
+    return &linkPair;
+}
+
+
+/**
+   The collisions are grouped into the clusters of the similar normals, and at most four points
+   that span the max area on the contact plane are selected from each cluster.
+   @return the indices of the selected collisions in the original order
+*/
+const std::vector<int>& ConstraintForceSolver::Impl::reduceContacts
+(const LinkPair& linkPair, const vector<Collision>& collisions)
+{
+    candidateContactIndices.clear();
+    contactClusterIds.clear();
+    contactClusterNormals.clear();
+    reducedContactIndices.clear();
+
+    const double cullingDepth = linkPair.contactMaterial->cullingDepth;
+    const int n = collisions.size();
+    for(int i=0; i < n; ++i){
+        auto& collision = collisions[i];
+        if(collision.depth > cullingDepth){
+            continue;
+        }
+        int clusterId = 0;
+        const int numClusters = contactClusterNormals.size();
+        while(clusterId < numClusters){
+            if(contactClusterNormals[clusterId].dot(collision.normal) > CONTACT_REDUCTION_NORMAL_COS_THRESH){
+                break;
+            }
+            ++clusterId;
+        }
+        if(clusterId == numClusters){
+            contactClusterNormals.push_back(collision.normal);
+        }
+        candidateContactIndices.push_back(i);
+        contactClusterIds.push_back(clusterId);
+    }
+
+    const int numClusters = contactClusterNormals.size();
+    for(int clusterId = 0; clusterId < numClusters; ++clusterId){
+        clusterContactIndices.clear();
+        for(size_t i=0; i < candidateContactIndices.size(); ++i){
+            if(contactClusterIds[i] == clusterId){
+                clusterContactIndices.push_back(candidateContactIndices[i]);
+            }
+        }
+        if(static_cast<int>(clusterContactIndices.size()) <= MAX_NUM_REDUCED_CONTACTS_PER_CLUSTER){
+            reducedContactIndices.insert(
+                reducedContactIndices.end(), clusterContactIndices.begin(), clusterContactIndices.end());
+        } else {
+            selectContactsOfCluster(collisions, contactClusterNormals[clusterId]);
+        }
+    }
+
+    std::sort(reducedContactIndices.begin(), reducedContactIndices.end());
+
+    return reducedContactIndices;
+}
+
+
+void ConstraintForceSolver::Impl::selectContactsOfCluster(const vector<Collision>& collisions, const Vector3& normal)
+{
+    static const double areaThresh = 1.0e-12;
+
+    // The deepest point
+    int i0 = clusterContactIndices.front();
+    for(auto& index : clusterContactIndices){
+        if(collisions[index].depth > collisions[i0].depth){
+            i0 = index;
+        }
+    }
+    const Vector3& p0 = collisions[i0].point;
+    reducedContactIndices.push_back(i0);
+
+    // The farthest point from p0 on the contact plane
+    int i1 = -1;
+    double maxDistance2 = areaThresh;
+    for(auto& index : clusterContactIndices){
+        Vector3 d = collisions[index].point - p0;
+        d -= normal.dot(d) * normal;
+        double distance2 = d.squaredNorm();
+        if(distance2 > maxDistance2){
+            maxDistance2 = distance2;
+            i1 = index;
+        }
+    }
+    if(i1 < 0){
+        return;
+    }
+    const Vector3& p1 = collisions[i1].point;
+    reducedContactIndices.push_back(i1);
+
+    // The point that makes the max triangle with p0 and p1
+    int i2 = -1;
+    double signedArea2 = 0.0;
+    const Vector3 e01 = p1 - p0;
+    for(auto& index : clusterContactIndices){
+        double area = normal.dot(e01.cross(collisions[index].point - p0));
+        if(fabs(area) > fabs(signedArea2)){
+            signedArea2 = area;
+            i2 = index;
+        }
+    }
+    if(fabs(signedArea2) < areaThresh){
+        return;
+    }
+    const Vector3& p2 = collisions[i2].point;
+    reducedContactIndices.push_back(i2);
+
+    // The point that adds the max area outside the triangle
+    const double orientation = (signedArea2 > 0.0) ? 1.0 : -1.0;
+    const Vector3* vertices[3] = { &p0, &p1, &p2 };
+    int i3 = -1;
+    double maxArea = areaThresh;
+    for(auto& index : clusterContactIndices){
+        const Vector3& q = collisions[index].point;
+        for(int j=0; j < 3; ++j){
+            const Vector3& a = *vertices[j];
+            const Vector3& b = *vertices[(j + 1) % 3];
+            double area = -orientation * normal.dot((b - a).cross(q - a));
+            if(area > maxArea){
+                maxArea = area;
+                i3 = index;
+            }
+        }
+    }
+    if(i3 >= 0){
+        reducedContactIndices.push_back(i3);
+    }
+}
+
+
 /**
    @retuen true if the point is actually added to the constraints
 */
@@ -1093,9 +1416,10 @@ void ConstraintForceSolver::Impl::initMatrices()
 
     const int dimLCP = usePivotingLCP ? (n + m + m) : (n + m);
 
-    Mlcp.resize(dimLCP, dimLCP);
-    b.resize(dimLCP);
-    solution.resize(dimLCP);
+    MlcpBuf.resize(Mlcp, dimLCP, dimLCP);
+    bBuf.resize(b, dimLCP);
+    solutionBuf.resize(solution, dimLCP);
+    peakLCPDimension = std::max(peakLCPDimension, dimLCP);
 
     if(usePivotingLCP){
         Mlcp.block(0, n + m, n, m).setZero();
@@ -1107,12 +1431,12 @@ void ConstraintForceSolver::Impl::initMatrices()
 
     } else {
         frictionIndexToContactIndex.resize(m);
-        contactIndexToMu.resize(globalNumContactNormalVectors);
-        mcpHi.resize(globalNumContactNormalVectors);
+        contactIndexToMuBuf.resize(contactIndexToMu, globalNumContactNormalVectors);
+        mcpHiBuf.resize(mcpHi, globalNumContactNormalVectors);
     }
 
-    an0.resize(n);
-    at0.resize(m);
+    an0Buf.resize(an0, n);
+    at0Buf.resize(at0, m);
 }
 
 
@@ -1198,13 +1522,18 @@ void ConstraintForceSolver::Impl::setDefaultAccelerationVector()
 
 void ConstraintForceSolver::Impl::setAccelerationMatrix()
 {
+    if(taskScheduler && canSetAccelerationMatrixInParallel()){
+        setAccelerationMatrixInParallel();
+        return;
+    }
+
     const int n = globalNumConstraintVectors;
     const int m = globalNumFrictionVectors;
 
-    Eigen::Block<MatrixX> Knn = Mlcp.block(0, 0, n, n);
-    Eigen::Block<MatrixX> Ktn = Mlcp.block(0, n, n, m);
-    Eigen::Block<MatrixX> Knt = Mlcp.block(n, 0, m, n);
-    Eigen::Block<MatrixX> Ktt = Mlcp.block(n, n, m, m);
+    MatrixXBlock Knn = Mlcp.block(0, 0, n, n);
+    MatrixXBlock Ktn = Mlcp.block(0, n, n, m);
+    MatrixXBlock Knt = Mlcp.block(n, 0, m, n);
+    MatrixXBlock Ktt = Mlcp.block(n, n, m, m);
 
     for(size_t i=0; i < constrainedLinkPairs.size(); ++i){
 
@@ -1283,6 +1612,123 @@ void ConstraintForceSolver::Impl::setAccelerationMatrix()
 }
 
 
+/**
+   The columns of the acceleration matrix are independent of each other, but the serial
+   version keeps the intermediate accelerations of the test forces in the links. The
+   parallel version keeps them in the workspace of each thread instead. The sub-bodies
+   with the high-gain joints update the states of ForwardDynamicsCBM objects and their
+   links when the test forces are applied, so the matrix is set serially for them.
+*/
+bool ConstraintForceSolver::Impl::canSetAccelerationMatrixInParallel()
+{
+    if(ASSUME_SYMMETRIC_MATRIX){
+        return false;
+    }
+    for(auto& linkPair : constrainedLinkPairs){
+        for(int k=0; k < 2; ++k){
+            auto subBody = linkPair->link[k]->subBody();
+            if(!subBody->isStatic() && subBody->forwardDynamicsCBM()){
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+
+void ConstraintForceSolver::Impl::setAccelerationMatrixInParallel()
+{
+    ++accelerationMatrixCounter;
+
+    testForcePoints.clear();
+    for(auto& linkPair : constrainedLinkPairs){
+        for(auto& constraint : linkPair->constraintPoints){
+            testForcePoints.emplace_back(linkPair, &constraint);
+        }
+    }
+
+    const int numThreads = testForceWorkspaces.size();
+    const int numPoints = testForcePoints.size();
+    taskScheduler->parallelFor(
+        0, numThreads, 1,
+        [this, numThreads, numPoints](int i){
+            auto& workspace = testForceWorkspaces[i];
+            for(int j = i; j < numPoints; j += numThreads){
+                auto& point = testForcePoints[j];
+                setAccelerationMatrixColumns(workspace, *point.first, *point.second);
+            }
+        });
+}
+
+
+void ConstraintForceSolver::Impl::setAccelerationMatrixColumns
+(TestForceWorkspace& workspace, LinkPair& linkPair, ConstraintPoint& constraint)
+{
+    const int n = globalNumConstraintVectors;
+    const int m = globalNumFrictionVectors;
+
+    MatrixXBlock Knn = Mlcp.block(0, 0, n, n);
+    MatrixXBlock Ktn = Mlcp.block(0, n, n, m);
+    MatrixXBlock Knt = Mlcp.block(n, 0, m, n);
+    MatrixXBlock Ktt = Mlcp.block(n, n, m, m);
+
+    for(int k=0; k < 2; ++k){
+        auto subBody = linkPair.link[k]->subBody();
+        workspace.subBodies[k] = subBody;
+        workspace.accels[k] = subBody->isStatic() ? nullptr : &getTestForceAccels(workspace, subBody);
+    }
+
+    applyTestForce(workspace, linkPair, constraint, -1);
+    extractRelAccelsOfConstraintPoints(workspace, Knn, Knt, constraint.globalIndex);
+
+    for(int l=0; l < constraint.numFrictionVectors; ++l){
+        applyTestForce(workspace, linkPair, constraint, l);
+        extractRelAccelsOfConstraintPoints(workspace, Ktn, Ktt, constraint.globalFrictionIndex + l);
+    }
+}
+
+
+ConstraintForceSolver::Impl::TestForceAccels& ConstraintForceSolver::Impl::getTestForceAccels
+(TestForceWorkspace& workspace, DySubBody* subBody)
+{
+    auto& accels = workspace.accelsMap[subBody];
+    if(accels.counter != accelerationMatrixCounter){
+        const int numLinks = subBody->rootLink()->body()->numLinks();
+        accels.dvo.resize(numLinks);
+        accels.dw.resize(numLinks);
+        accels.uu.resize(numLinks);
+        for(auto& link : subBody->links()){
+            accels.uu[link->index()] = link->cfs.uu0;
+        }
+        accels.dpf.setZero();
+        accels.dptau.setZero();
+        accels.counter = accelerationMatrixCounter;
+    }
+    return accels;
+}
+
+
+/**
+   @param frictionIndex The index of the friction vector to apply. The normal force is applied if this is negative.
+*/
+void ConstraintForceSolver::Impl::applyTestForce
+(TestForceWorkspace& workspace, LinkPair& linkPair, ConstraintPoint& constraint, int frictionIndex)
+{
+    for(int k=0; k < 2; ++k){
+        if(auto accels = workspace.accels[k]){
+            auto link = linkPair.link[k];
+            const Vector3& f =
+                (frictionIndex < 0) ? constraint.normalTowardInside[k] : constraint.frictionVector[frictionIndex][k];
+            Vector3 tau = constraint.point.cross(f);
+            calcABMForceElementsWithTestForce(*accels, link, f, tau);
+            if(!linkPair.isBelongingToSameSubBody || (k > 0)){
+                calcAccelsABM(workspace.subBodies[k], *accels);
+            }
+        }
+    }
+}
+
+
 void ConstraintForceSolver::Impl::initABMForceElementsWithNoExtForce(DySubBody* subBody)
 {
     subBody->dpf.setZero();
@@ -1346,6 +1792,29 @@ void ConstraintForceSolver::Impl::calcABMForceElementsWithTestForce
 }
 
 
+void ConstraintForceSolver::Impl::calcABMForceElementsWithTestForce
+(TestForceAccels& accels, DyLink* linkToApplyForce, const Vector3& f, const Vector3& tau)
+{
+    Vector3 dpf   = -f;
+    Vector3 dptau = -tau;
+
+    DyLink* link = linkToApplyForce;
+    while(!link->isSubBodyRoot()){
+        if(!link->isFixedJoint()){
+            double duu = -(link->sv().dot(dpf) + link->sw().dot(dptau));
+            accels.uu[link->index()] += duu;
+            double duudd = duu / link->dd();
+            dpf   += duudd * link->hhv();
+            dptau += duudd * link->hhw();
+        }
+        link = link->parent();
+    }
+
+    accels.dpf   += dpf;
+    accels.dptau += dptau;
+}
+
+
 void ConstraintForceSolver::Impl::calcAccelsABM(DySubBody* subBody, int constraintIndex)
 {
     auto rootLink = subBody->rootLink();
@@ -1395,6 +1864,56 @@ void ConstraintForceSolver::Impl::calcAccelsABM(DySubBody* subBody, int constrai
 }
 
 
+void ConstraintForceSolver::Impl::calcAccelsABM(DySubBody* subBody, TestForceAccels& accels)
+{
+    auto rootLink = subBody->rootLink();
+    const int rootIndex = rootLink->index();
+
+    if(!rootLink->isFreeJoint()){
+        accels.dw [rootIndex].setZero();
+        accels.dvo[rootIndex].setZero();
+    } else {
+        Eigen::Matrix<double, 6, 6> M;
+        M << rootLink->Ivv(), rootLink->Iwv().transpose(),
+             rootLink->Iwv(), rootLink->Iww();
+
+        Eigen::Matrix<double, 6, 1> f;
+        f << (rootLink->cfs.pf0   + accels.dpf),
+             (rootLink->cfs.ptau0 + accels.dptau);
+        f *= -1.0;
+
+        Eigen::Matrix<double, 6, 1> a(M.colPivHouseholderQr().solve(f));
+
+        accels.dvo[rootIndex] = a.head<3>();
+        accels.dw [rootIndex] = a.tail<3>();
+    }
+
+    // reset
+    accels.dpf  .setZero();
+    accels.dptau.setZero();
+
+    const int skipCheckNumber = numeric_limits<int>::max() - 1;
+    const int n = subBody->numLinks();
+    for(int linkIndex = 1; linkIndex < n; ++linkIndex){
+        auto link = subBody->link(linkIndex);
+        if(!SKIP_REDUNDANT_ACCEL_CALC || link->cfs.numberToCheckAccelCalcSkip <= skipCheckNumber){
+            const int i = link->index();
+            const int p = link->parent()->index();
+            if(link->isFixedJoint()){
+                accels.dvo[i] = accels.dvo[p];
+                accels.dw [i] = accels.dw [p];
+            } else {
+                double ddq = (accels.uu[i] - (link->hhv().dot(accels.dvo[p]) + link->hhw().dot(accels.dw[p]))) / link->dd();
+                accels.dvo[i] = accels.dvo[p] + link->cv() + link->sv() * ddq;
+                accels.dw [i] = accels.dw [p] + link->cw() + link->sw() * ddq;
+            }
+            // reset
+            accels.uu[i] = link->cfs.uu0;
+        }
+    }
+}
+
+
 void ConstraintForceSolver::Impl::calcAccelsMM(DySubBody* subBody, int constraintIndex)
 {
     auto rootLink = subBody->rootLink();
@@ -1420,7 +1939,7 @@ void ConstraintForceSolver::Impl::calcAccelsMM(DySubBody* subBody, int constrain
 
 
 void ConstraintForceSolver::Impl::extractRelAccelsOfConstraintPoints
-(Eigen::Block<MatrixX>& Kxn, Eigen::Block<MatrixX>& Kxt, int testForceIndex, int constraintIndex)
+(MatrixXBlock& Kxn, MatrixXBlock& Kxt, int testForceIndex, int constraintIndex)
 {
     int maxConstraintIndexToExtract = ASSUME_SYMMETRIC_MATRIX ? constraintIndex : globalNumConstraintVectors;
 
@@ -1445,8 +1964,72 @@ void ConstraintForceSolver::Impl::extractRelAccelsOfConstraintPoints
 }
 
 
+/**
+   This is the version of the above function for the test forces calculated in a workspace.
+   The equations are the same as the ones of the functions for the three cases.
+*/
+void ConstraintForceSolver::Impl::extractRelAccelsOfConstraintPoints
+(TestForceWorkspace& workspace, MatrixXBlock& Kxn, MatrixXBlock& Kxt, int testForceIndex)
+{
+    auto findAccels = [&workspace](DySubBody* subBody) -> TestForceAccels* {
+        for(int k=0; k < 2; ++k){
+            if(workspace.subBodies[k] == subBody){
+                return workspace.accels[k];
+            }
+        }
+        return nullptr;
+    };
+
+    auto calcTestForceAccel = [](TestForceAccels* accels, DyLink* link, const ConstraintPoint& constraint){
+        const int index = link->index();
+        return Vector3(
+            accels->dvo[index] - constraint.point.cross(accels->dw[index]) +
+            link->w().cross(link->vo() + link->w().cross(constraint.point)));
+    };
+
+    for(auto& linkPair : constrainedLinkPairs){
+        auto link0 = linkPair->link[0];
+        auto link1 = linkPair->link[1];
+        auto accels0 = findAccels(link0->subBody());
+        auto accels1 = findAccels(link1->subBody());
+
+        for(auto& constraint : linkPair->constraintPoints){
+            const int constraintIndex = constraint.globalIndex;
+
+            if(!accels0 && !accels1){
+                Kxn(constraintIndex, testForceIndex) = 0.0;
+                for(int j=0; j < constraint.numFrictionVectors; ++j){
+                    Kxt(constraint.globalFrictionIndex + j, testForceIndex) = 0.0;
+                }
+                continue;
+            }
+
+            int iDefault;
+            Vector3 relAccel;
+            if(accels0 && accels1){
+                iDefault = 1;
+                relAccel = calcTestForceAccel(accels1, link1, constraint) - calcTestForceAccel(accels0, link0, constraint);
+            } else if(accels0){
+                iDefault = 1;
+                relAccel = constraint.defaultAccel[1] - calcTestForceAccel(accels0, link0, constraint);
+            } else {
+                iDefault = 0;
+                relAccel = constraint.defaultAccel[0] - calcTestForceAccel(accels1, link1, constraint);
+            }
+
+            Kxn(constraintIndex, testForceIndex) = constraint.normalTowardInside[iDefault].dot(relAccel) - an0(constraintIndex);
+
+            for(int j=0; j < constraint.numFrictionVectors; ++j){
+                const int index = constraint.globalFrictionIndex + j;
+                Kxt(index, testForceIndex) = constraint.frictionVector[j][iDefault].dot(relAccel) - at0(index);
+            }
+        }
+    }
+}
+
+
 void ConstraintForceSolver::Impl::extractRelAccelsFromLinkPairCase1
-(Eigen::Block<MatrixX>& Kxn, Eigen::Block<MatrixX>& Kxt,
+(MatrixXBlock& Kxn, MatrixXBlock& Kxt,
  LinkPair& linkPair, int testForceIndex, int maxConstraintIndexToExtract)
 {
     auto& constraintPoints = linkPair.constraintPoints;
@@ -1485,7 +2068,7 @@ void ConstraintForceSolver::Impl::extractRelAccelsFromLinkPairCase1
 
 
 void ConstraintForceSolver::Impl::extractRelAccelsFromLinkPairCase2
-(Eigen::Block<MatrixX>& Kxn, Eigen::Block<MatrixX>& Kxt,
+(MatrixXBlock& Kxn, MatrixXBlock& Kxt,
  LinkPair& linkPair, int iTestForce, int iDefault, int testForceIndex, int maxConstraintIndexToExtract)
 {
     auto& constraintPoints = linkPair.constraintPoints;
@@ -1521,7 +2104,7 @@ void ConstraintForceSolver::Impl::extractRelAccelsFromLinkPairCase2
 
 
 void ConstraintForceSolver::Impl::extractRelAccelsFromLinkPairCase3
-(Eigen::Block<MatrixX>& Kxn, Eigen::Block<MatrixX>& Kxt, LinkPair& linkPair, int testForceIndex, int maxConstraintIndexToExtract)
+(MatrixXBlock& Kxn, MatrixXBlock& Kxt, LinkPair& linkPair, int testForceIndex, int maxConstraintIndexToExtract)
 {
     auto& constraintPoints = linkPair.constraintPoints;
 
@@ -1544,7 +2127,7 @@ void ConstraintForceSolver::Impl::extractRelAccelsFromLinkPairCase3
 
 
 void ConstraintForceSolver::Impl::copySymmetricElementsOfAccelerationMatrix
-(Eigen::Block<MatrixX>& Knn, Eigen::Block<MatrixX>& Ktn, Eigen::Block<MatrixX>& Knt, Eigen::Block<MatrixX>& Ktt)
+(MatrixXBlock& Knn, MatrixXBlock& Ktn, MatrixXBlock& Knt, MatrixXBlock& Ktt)
 {
     for(size_t linkPairIndex=0; linkPairIndex < constrainedLinkPairs.size(); ++linkPairIndex){
 
@@ -1669,6 +2252,115 @@ void ConstraintForceSolver::Impl::setConstantVectorAndMuBlock()
 }
 
 
+/**
+   A test force applied to a sub-body does not change the accelerations of the other sub-bodies,
+   so the rows of a link pair only have non-zero elements in the columns of the link pairs that
+   share a non-static sub-body with it. The spans of those columns are collected here so that
+   the Gauss-Seidel iterations can skip the zero blocks of the acceleration matrix.
+*/
+void ConstraintForceSolver::Impl::setLinkPairColumnSpans()
+{
+    const int n = globalNumConstraintVectors;
+    const int numLinkPairs = constrainedLinkPairs.size();
+
+    rowToLinkPairIndex.resize(globalNumConstraintVectors + globalNumFrictionVectors);
+    if(static_cast<int>(ownColumnSpans.size()) < numLinkPairs){
+        ownColumnSpans.resize(numLinkPairs);
+    }
+    for(auto& kv : subBodyToLinkPairIndices){
+        kv.second.clear();
+    }
+
+    for(int i=0; i < numLinkPairs; ++i){
+        LinkPair& linkPair = *constrainedLinkPairs[i];
+        auto& spans = ownColumnSpans[i];
+        spans.clear();
+        for(auto& constraint : linkPair.constraintPoints){
+            rowToLinkPairIndex[constraint.globalIndex] = i;
+            spans.emplace_back(constraint.globalIndex, constraint.globalIndex + 1);
+            if(constraint.numFrictionVectors > 0){
+                const int top = n + constraint.globalFrictionIndex;
+                for(int j=0; j < constraint.numFrictionVectors; ++j){
+                    rowToLinkPairIndex[top + j] = i;
+                }
+                spans.emplace_back(top, top + constraint.numFrictionVectors);
+            }
+        }
+        for(int k=0; k < 2; ++k){
+            auto subBody = linkPair.link[k]->subBody();
+            if(!subBody->isStatic()){
+                auto& indices = subBodyToLinkPairIndices[subBody];
+                if(indices.empty() || indices.back() != i){
+                    indices.push_back(i);
+                }
+            }
+        }
+    }
+
+    if(static_cast<int>(linkPairColumnSpans.size()) < numLinkPairs){
+        linkPairColumnSpans.resize(numLinkPairs);
+    }
+
+    for(int i=0; i < numLinkPairs; ++i){
+        LinkPair& linkPair = *constrainedLinkPairs[i];
+        coupledLinkPairIndices.assign(1, i);
+        for(int k=0; k < 2; ++k){
+            auto subBody = linkPair.link[k]->subBody();
+            if(!subBody->isStatic()){
+                auto& indices = subBodyToLinkPairIndices[subBody];
+                coupledLinkPairIndices.insert(coupledLinkPairIndices.end(), indices.begin(), indices.end());
+            }
+        }
+        std::sort(coupledLinkPairIndices.begin(), coupledLinkPairIndices.end());
+        coupledLinkPairIndices.erase(
+            std::unique(coupledLinkPairIndices.begin(), coupledLinkPairIndices.end()),
+            coupledLinkPairIndices.end());
+
+        auto& spans = linkPairColumnSpans[i];
+        spans.clear();
+        for(auto index : coupledLinkPairIndices){
+            auto& ownSpans = ownColumnSpans[index];
+            spans.insert(spans.end(), ownSpans.begin(), ownSpans.end());
+        }
+        std::sort(spans.begin(), spans.end());
+
+        // merge the adjacent spans
+        size_t numMergedSpans = 0;
+        for(size_t j=0; j < spans.size(); ++j){
+            if(numMergedSpans > 0 && spans[j].first <= spans[numMergedSpans - 1].second){
+                auto& merged = spans[numMergedSpans - 1];
+                merged.second = std::max(merged.second, spans[j].second);
+            } else {
+                spans[numMergedSpans++] = spans[j];
+            }
+        }
+        spans.resize(numMergedSpans);
+    }
+}
+
+
+inline double ConstraintForceSolver::Impl::calcRowProductExceptDiagonal
+(const MatrixXMap& M, const VectorXMap& x, int row) const
+{
+    double sum = -M(row, row) * x(row);
+    auto& spans = linkPairColumnSpans[rowToLinkPairIndex[row]];
+    if(isGaussSeidelVectorizationEnabled){
+        // The rows of the row-major matrix are contiguous and Eigen uses the SIMD instructions for them
+        for(auto& span : spans){
+            const int length = span.second - span.first;
+            sum += M.row(row).segment(span.first, length).dot(x.segment(span.first, length));
+        }
+    } else {
+        for(auto& span : spans){
+            for(int k = span.first; k < span.second; ++k){
+                sum += M(row, k) * x(k);
+            }
+        }
+    }
+    return sum;
+}
+
+
 void ConstraintForceSolver::Impl::addConstraintForceToLinks()
 {
     int n = constrainedLinkPairs.size();
@@ -1725,7 +2417,264 @@ void ConstraintForceSolver::Impl::addConstraintForceToLink(LinkPair* linkPair, i
 }
 
 
-void ConstraintForceSolver::Impl::solveMCPByProjectedGaussSeidel(const MatrixX& M, const VectorX& b, VectorX& x)
+/**
+   The solution of the previous step cannot be used as it is because the constraint points
+   are detected again and the indices of them change in every step. The initial solution is
+   given by matching the new contact points to the previous ones of the same link pair which
+   are within the culling distance. The constraints which are not contacts keep their order
+   in a link pair, so the previous impulses are given to them by the indices.
+*/
+void ConstraintForceSolver::Impl::setInitialSolutionFromStoredImpulses()
+{
+    solution.setZero();
+
+    const int n = globalNumConstraintVectors;
+
+    for(auto& linkPair : constrainedLinkPairs){
+        auto& storedImpulses = linkPair->storedImpulses;
+        if(storedImpulses.empty()){
+            continue;
+        }
+        auto link0 = linkPair->link[0];
+        auto& constraintPoints = linkPair->constraintPoints;
+        const bool isMatchedByIndex = linkPair->isNonContactConstraint;
+        if(isMatchedByIndex && storedImpulses.size() != constraintPoints.size()){
+            continue;
+        }
+        double maxDistance2 = 0.0;
+        if(!isMatchedByIndex){
+            const double d = linkPair->contactMaterial->cullingDistance;
+            maxDistance2 = d * d;
+        }
+
+        for(size_t i=0; i < constraintPoints.size(); ++i){
+            auto& constraint = constraintPoints[i];
+            const LinkPair::StoredImpulse* matched = nullptr;
+            if(isMatchedByIndex){
+                matched = &storedImpulses[i];
+            } else {
+                const Vector3 localPoint = link0->R().transpose() * (constraint.point - link0->p());
+                double minDistance2 = maxDistance2;
+                for(auto& impulse : storedImpulses){
+                    double d2 = (impulse.localPoint - localPoint).squaredNorm();
+                    if(d2 < minDistance2){
+                        minDistance2 = d2;
+                        matched = &impulse;
+                    }
+                }
+            }
+            if(matched){
+                solution(constraint.globalIndex) = matched->normalImpulse;
+                const Vector3 frictionImpulse = link0->R() * matched->frictionImpulse;
+                for(int j=0; j < constraint.numFrictionVectors; ++j){
+                    double f = constraint.frictionVector[j][0].dot(frictionImpulse);
+                    if(!STATIC_FRICTION_BY_TWO_CONSTRAINTS && f < 0.0){
+                        f = 0.0;
+                    }
+                    solution(n + constraint.globalFrictionIndex + j) = f;
+                }
+            }
+        }
+    }
+}
+
+
+void ConstraintForceSolver::Impl::storeImpulses()
+{
+    clearStoredImpulses();
+
+    const int n = globalNumConstraintVectors;
+
+    for(auto& linkPair : constrainedLinkPairs){
+        auto link0 = linkPair->link[0];
+        auto& constraintPoints = linkPair->constraintPoints;
+        auto& storedImpulses = linkPair->storedImpulses;
+        storedImpulses.resize(constraintPoints.size());
+        for(size_t i=0; i < constraintPoints.size(); ++i){
+            auto& constraint = constraintPoints[i];
+            auto& impulse = storedImpulses[i];
+            impulse.localPoint = link0->R().transpose() * (constraint.point - link0->p());
+            impulse.normalImpulse = solution(constraint.globalIndex);
+            Vector3 f = Vector3::Zero();
+            for(int j=0; j < constraint.numFrictionVectors; ++j){
+                f += solution(n + constraint.globalFrictionIndex + j) * constraint.frictionVector[j][0];
+            }
+            impulse.frictionImpulse = link0->R().transpose() * f;
+        }
+    }
+    linkPairsWithStoredImpulses = constrainedLinkPairs;
+}
+
+
+void ConstraintForceSolver::Impl::clearStoredImpulses()
+{
+    for(auto& linkPair : linkPairsWithStoredImpulses){
+        linkPair->storedImpulses.clear();
+    }
+    linkPairsWithStoredImpulses.clear();
+}
+
+
+/**
+   The stored impulses are written to the state so that a simulation restored from a snapshot
+   starts the solver from the same solution as the original simulation. A contact link pair is
+   identified by the indices of the bodies and the links, and the other link pairs are identified
+   by their indices in the lists of the extra joints and the 2D constraints.
+*/
+void ConstraintForceSolver::Impl::storeWarmStartState(std::vector<double>& out_state)
+{
+    unordered_map<const Body*, int> bodyIndexMap;
+    for(int i=0; i < world.numBodies(); ++i){
+        bodyIndexMap[world.body(i)] = i;
+    }
+    auto findNonContactLinkPairIndex = [](auto& linkPairs, const LinkPair* linkPair){
+        for(size_t i=0; i < linkPairs.size(); ++i){
+            if(linkPairs[i].get() == linkPair){
+                return static_cast<int>(i);
+            }
+        }
+        return -1;
+    };
+
+    const size_t numLinkPairsPosition = out_state.size();
+    out_state.push_back(0.0);
+    int numLinkPairs = 0;
+    
+    for(auto& linkPair : linkPairsWithStoredImpulses){
+        auto& impulses = linkPair->storedImpulses;
+        if(impulses.empty()){
+            continue;
+        }
+        if(!linkPair->isNonContactConstraint){
+            out_state.push_back(WarmStartContactLinkPair);
+            for(int i=0; i < 2; ++i){
+                auto link = linkPair->link[i];
+                out_state.push_back(bodyIndexMap[link->body()]);
+                out_state.push_back(link->index());
+            }
+        } else {
+            int index = findNonContactLinkPairIndex(extraJointLinkPairs, linkPair);
+            if(index >= 0){
+                out_state.push_back(WarmStartExtraJointLinkPair);
+            } else {
+                index = findNonContactLinkPairIndex(constrain2dLinkPairs, linkPair);
+                if(index < 0){
+                    continue;
+                }
+                out_state.push_back(WarmStart2dConstraintLinkPair);
+            }
+            out_state.push_back(index);
+        }
+        out_state.push_back(impulses.size());
+        for(auto& impulse : impulses){
+            out_state.insert(out_state.end(), impulse.localPoint.data(), impulse.localPoint.data() + 3);
+            out_state.push_back(impulse.normalImpulse);
+            out_state.insert(out_state.end(), impulse.frictionImpulse.data(), impulse.frictionImpulse.data() + 3);
+        }
+        ++numLinkPairs;
+    }
+
+    out_state[numLinkPairsPosition] = numLinkPairs;
+}
+
+
+/**
+   The state is checked before it is applied, so the stored impulses are not changed when the
+   state is invalid.
+*/
+bool ConstraintForceSolver::Impl::restoreWarmStartState(const std::vector<double>& state, size_t& io_position)
+{
+    size_t pos = io_position;
+    auto read = [&](double& out_value){
+        if(pos >= state.size()){
+            return false;
+        }
+        out_value = state[pos++];
+        return true;
+    };
+    auto readIndex = [&](int size, int& out_index){
+        double value;
+        if(!read(value) || value < 0.0 || value >= size){
+            return false;
+        }
+        out_index = static_cast<int>(value);
+        return true;
+    };
+
+    double value;
+    if(!read(value) || value < 0.0){
+        return false;
+    }
+    const int numLinkPairs = static_cast<int>(value);
+
+    vector<std::pair<LinkPair*, vector<LinkPair::StoredImpulse>>> restoredLinkPairs;
+    for(int i=0; i < numLinkPairs; ++i){
+        int type;
+        if(!readIndex(NumWarmStartLinkPairTypes, type)){
+            return false;
+        }
+        LinkPair* linkPair = nullptr;
+        if(type == WarmStartContactLinkPair){
+            DyLink* links[2];
+            stdx::optional<GeometryHandle> handles[2];
+            for(int j=0; j < 2; ++j){
+                int bodyIndex, linkIndex;
+                if(!readIndex(world.numBodies(), bodyIndex) ||
+                   !readIndex(world.body(bodyIndex)->numLinks(), linkIndex)){
+                    return false;
+                }
+                links[j] = world.body(bodyIndex)->link(linkIndex);
+                handles[j] = bodyCollisionDetector.findGeometryHandle(links[j]);
+                if(!handles[j]){
+                    return false;
+                }
+            }
+            // The link pair is created before it is applied, but it does not affect the simulation
+            linkPair = getOrCreateContactLinkPair(
+                IdPair<GeometryHandle>(*handles[0], *handles[1]), links[0], links[1]);
+        } else {
+            int index;
+            if(type == WarmStartExtraJointLinkPair){
+                if(!readIndex(extraJointLinkPairs.size(), index)){
+                    return false;
+                }
+                linkPair = extraJointLinkPairs[index].get();
+            } else {
+                if(!readIndex(constrain2dLinkPairs.size(), index)){
+                    return false;
+                }
+                linkPair = constrain2dLinkPairs[index].get();
+            }
+        }
+        if(!read(value) || value < 0.0){
+            return false;
+        }
+        vector<LinkPair::StoredImpulse> impulses(static_cast<int>(value));
+        for(auto& impulse : impulses){
+            if(pos + 7 > state.size()){
+                return false;
+            }
+            impulse.localPoint = Vector3(state[pos], state[pos + 1], state[pos + 2]);
+            impulse.normalImpulse = state[pos + 3];
+            impulse.frictionImpulse = Vector3(state[pos + 4], state[pos + 5], state[pos + 6]);
+            pos += 7;
+        }
+        restoredLinkPairs.emplace_back(linkPair, std::move(impulses));
+    }
+
+    clearStoredImpulses();
+    for(auto& restored : restoredLinkPairs){
+        auto linkPair = restored.first;
+        linkPair->storedImpulses = std::move(restored.second);
+        linkPairsWithStoredImpulses.push_back(linkPair);
+    }
+    io_position = pos;
+    
+    return true;
+}
+
+
+void ConstraintForceSolver::Impl::solveMCPByProjectedGaussSeidel(const MatrixXMap& M, const VectorXMap& b, VectorXMap& x)
 {
     static const int loopBlockSize = DEFAULT_NUM_GAUSS_SEIDEL_ITERATION_BLOCK;
 
@@ -1743,7 +2692,8 @@ void ConstraintForceSolver::Impl::solveMCPByProjectedGaussSeidel(const MatrixX&
     }
 
     double error = 0.0;
-    VectorXd x0;
+    prevSolutionBuf.resize(prevSolution, x.size());
+    auto& x0 = prevSolution;
     int i = 0;
     while(i < numBlockLoops){
         i++;
@@ -1783,6 +2733,8 @@ void ConstraintForceSolver::Impl::solveMCPByProjectedGaussSeidel(const MatrixX&
         }
     }
 
+    lastNumSolverIterations = std::max(numGaussSeidelInitialIteration, 0) + loopBlockSize * i;
+
     if(CFS_MCP_DEBUG){
 
         if(i == numBlockLoops){
@@ -1800,7 +2752,7 @@ void ConstraintForceSolver::Impl::solveMCPByProjectedGaussSeidel(const MatrixX&
 }
 
 
-void ConstraintForceSolver::Impl::solveMCPByProjectedGaussSeidelMainStep(const MatrixX& M, const VectorX& b, VectorX& x)
+void ConstraintForceSolver::Impl::solveMCPByProjectedGaussSeidelMainStep(const MatrixXMap& M, const VectorXMap& b, VectorXMap& x)
 {
     const int size = globalNumConstraintVectors + globalNumFrictionVectors;
 
@@ -1810,10 +2762,7 @@ void ConstraintForceSolver::Impl::solveMCPByProjectedGaussSeidelMainStep(const M
         if(M(j,j) == numeric_limits<double>::max()){
             xx=0.0;
         } else {
-            double sum = -M(j, j) * x(j);
-            for(int k=0; k < size; ++k){
-                sum += M(j, k) * x(k);
-            }
+            double sum = calcRowProductExceptDiagonal(M, x, j);
             xx = (-b(j) - sum) / M(j, j);
         }
         if(xx < 0.0){
@@ -1829,10 +2778,7 @@ void ConstraintForceSolver::Impl::solveMCPByProjectedGaussSeidelMainStep(const M
         if(M(j,j) == numeric_limits<double>::max()){
             x(j)=0.0;
         } else {
-            double sum = -M(j, j) * x(j);
-            for(int k=0; k < size; ++k){
-                sum += M(j, k) * x(k);
-            }
+            double sum = calcRowProductExceptDiagonal(M, x, j);
             x(j) = (-b(j) - sum) / M(j, j);
         }
     }
@@ -1847,10 +2793,7 @@ void ConstraintForceSolver::Impl::solveMCPByProjectedGaussSeidelMainStep(const M
             if(M(j,j) == numeric_limits<double>::max()) {
                 fx0 = 0.0;
             } else {
-                double sum = -M(j, j) * x(j);
-                for(int k=0; k < size; ++k){
-                    sum += M(j, k) * x(k);
-                }
+                double sum = calcRowProductExceptDiagonal(M, x, j);
                 fx0 = (-b(j) - sum) / M(j, j);
             }
             double& fx = x(j);
@@ -1861,10 +2804,7 @@ void ConstraintForceSolver::Impl::solveMCPByProjectedGaussSeidelMainStep(const M
             if(M(j,j) == numeric_limits<double>::max()) {
                 fy0=0.0;
             } else {
-                double sum = -M(j, j) * x(j);
-                for(int k=0; k < size; ++k){
-                    sum += M(j, k) * x(k);
-                }
+                double sum = calcRowProductExceptDiagonal(M, x, j);
                 fy0 = (-b(j) - sum) / M(j, j);
             }
             double& fy = x(j);
@@ -1892,10 +2832,7 @@ void ConstraintForceSolver::Impl::solveMCPByProjectedGaussSeidelMainStep(const M
             if(M(j,j) == numeric_limits<double>::max()) {
                 xx=0.0;
             } else {
-                double sum = -M(j, j) * x(j);
-                for(int k=0; k < size; ++k){
-                    sum += M(j, k) * x(k);
-                }
+                double sum = calcRowProductExceptDiagonal(M, x, j);
                 xx = (-b(j) - sum) / M(j, j);
             }
             
@@ -1916,7 +2853,7 @@ void ConstraintForceSolver::Impl::solveMCPByProjectedGaussSeidelMainStep(const M
 
 
 void ConstraintForceSolver::Impl::solveMCPByProjectedGaussSeidelInitial
-(const MatrixX& M, const VectorX& b, VectorX& x, const int numIteration)
+(const MatrixXMap& M, const VectorXMap& b, VectorXMap& x, const int numIteration)
 {
     const int size = globalNumConstraintVectors + globalNumFrictionVectors;
 
@@ -1931,10 +2868,7 @@ void ConstraintForceSolver::Impl::solveMCPByProjectedGaussSeidelInitial
             if(M(j,j)==numeric_limits<double>::max()){
                 xx=0.0;
             } else {
-                double sum = -M(j, j) * x(j);
-                for(int k=0; k < size; ++k){
-                    sum += M(j, k) * x(k);
-                }
+                double sum = calcRowProductExceptDiagonal(M, x, j);
                 xx = (-b(j) - sum) / M(j, j);
             }
             if(xx < 0.0){
@@ -1951,10 +2885,7 @@ void ConstraintForceSolver::Impl::solveMCPByProjectedGaussSeidelInitial
             if(M(j,j)==numeric_limits<double>::max()){
                 x(j) = 0.0;
             } else {
-                double sum = -M(j, j) * x(j);
-                for(int k=0; k < size; ++k){
-                    sum += M(j, k) * x(k);
-                }
+                double sum = calcRowProductExceptDiagonal(M, x, j);
                 x(j) = r * (-b(j) - sum) / M(j, j);
             }
             r += rstep;
@@ -1969,10 +2900,7 @@ void ConstraintForceSolver::Impl::solveMCPByProjectedGaussSeidelInitial
                 if(M(j,j)==numeric_limits<double>::max())
                     fx0 = 0.0;
                 else{
-                    double sum = -M(j, j) * x(j);
-                    for(int k=0; k < size; ++k){
-                        sum += M(j, k) * x(k);
-                    }
+                    double sum = calcRowProductExceptDiagonal(M, x, j);
                     fx0 = (-b(j) - sum) / M(j, j);
                 }
                 double& fx = x(j);
@@ -1983,10 +2911,7 @@ void ConstraintForceSolver::Impl::solveMCPByProjectedGaussSeidelInitial
                 if(M(j,j)==numeric_limits<double>::max())
                     fy0 = 0.0;
                 else{
-                    double sum = -M(j, j) * x(j);
-                    for(int k=0; k < size; ++k){
-                        sum += M(j, k) * x(k);
-                    }
+                    double sum = calcRowProductExceptDiagonal(M, x, j);
                     fy0 = (-b(j) - sum) / M(j, j);
                 }
                 double& fy = x(j);
@@ -2015,10 +2940,7 @@ void ConstraintForceSolver::Impl::solveMCPByProjectedGaussSeidelInitial
                 if(M(j,j)==numeric_limits<double>::max())
                     xx = 0.0;
                 else{
-                    double sum = -M(j, j) * x(j);
-                    for(int k=0; k < size; ++k){
-                        sum += M(j, k) * x(k);
-                    }
+                    double sum = calcRowProductExceptDiagonal(M, x, j);
                     xx = (-b(j) - sum) / M(j, j);
                 }
 
@@ -2041,7 +2963,83 @@ void ConstraintForceSolver::Impl::solveMCPByProjectedGaussSeidelInitial
 }
 
 
-void ConstraintForceSolver::Impl::checkLCPResult(MatrixX& M, VectorX& b, VectorX& x)
+/**
+   Nonsmooth nonlinear conjugate gradient method (Silcowitz et al., 2010).
+   A sweep of the projected Gauss-Seidel method gives the negative gradient, and the
+   Fletcher-Reeves conjugate direction is added to the result of every sweep. The
+   iteration is restarted from the steepest descent when the gradient grows. This needs
+   far fewer iterations than the plain Gauss-Seidel method when the mass ratios of the
+   constrained bodies are high.
+*/
+void ConstraintForceSolver::Impl::solveMCPByNNCG(const MatrixXMap& M, const VectorXMap& b, VectorXMap& x)
+{
+    if(numGaussSeidelInitialIteration > 0){
+        solveMCPByProjectedGaussSeidelInitial(M, b, x, numGaussSeidelInitialIteration);
+    }
+
+    prevSolutionBuf.resize(prevSolution, x.size());
+    nncgDirectionBuf.resize(nncgDirection, x.size());
+    nncgResidualBuf.resize(nncgResidual, x.size());
+    auto& x0 = prevSolution;
+    auto& direction = nncgDirection;
+    auto& r = nncgResidual;
+
+    x0 = x;
+    solveMCPByProjectedGaussSeidelMainStep(M, b, x);
+    direction = x - x0;
+    double gradientNorm2 = direction.squaredNorm();
+    bool isDirectionAdded = false;
+
+    const int maxNumIterations = std::max(1, maxNumGaussSeidelIteration);
+    int i;
+    for(i=1; i < maxNumIterations; ++i){
+
+        x0 = x;
+        solveMCPByProjectedGaussSeidelMainStep(M, b, x);
+
+        const double prevGradientNorm2 = gradientNorm2;
+        r = x - x0;
+        gradientNorm2 = r.squaredNorm();
+
+        double n = x.norm();
+        double error = (n > THRESH_TO_SWITCH_REL_ERROR) ? (sqrt(gradientNorm2) / n) : sqrt(gradientNorm2);
+        if(error < gaussSeidelErrorCriterion){
+            isDirectionAdded = false;
+            break;
+        }
+
+        const double beta = (prevGradientNorm2 > 0.0) ? (gradientNorm2 / prevGradientNorm2) : 0.0;
+        if(beta > 1.0){
+            // restart from the steepest descent
+            direction = r;
+            isDirectionAdded = false;
+        } else {
+            x += beta * direction;
+            direction = r + beta * direction;
+            isDirectionAdded = true;
+        }
+    }
+
+    // The conjugate direction may move the solution out of the feasible region
+    if(isDirectionAdded){
+        solveMCPByProjectedGaussSeidelMainStep(M, b, x);
+    }
+
+    lastNumSolverIterations = std::max(numGaussSeidelInitialIteration, 0) + i;
+
+    if(CFS_MCP_DEBUG){
+        numGaussSeidelTotalLoops += i;
+        numGaussSeidelTotalCalls++;
+        numGaussSeidelTotalLoopsMax = std::max(numGaussSeidelTotalLoopsMax, i);
+        os << "NNCG iterations = " << i;
+        os << ", avarage = " << (numGaussSeidelTotalLoops / numGaussSeidelTotalCalls);
+        os << ", max = " << numGaussSeidelTotalLoopsMax;
+        os << endl;
+    }
+}
+
+
+void ConstraintForceSolver::Impl::checkLCPResult(MatrixXMap& M, VectorXMap& b, VectorXMap& x)
 {
     os << "check LCP result\n";
     os << "-------------------------------\n";
@@ -2071,7 +3069,7 @@ void ConstraintForceSolver::Impl::checkLCPResult(MatrixX& M, VectorX& b, VectorX
 }
 
 
-void ConstraintForceSolver::Impl::checkMCPResult(MatrixX& M, VectorX& b, VectorX& x)
+void ConstraintForceSolver::Impl::checkMCPResult(MatrixXMap& M, VectorXMap& b, VectorXMap& x)
 {
     os << "check MCP result\n";
     os << "-------------------------------\n";
@@ -2121,7 +3119,7 @@ void ConstraintForceSolver::Impl::checkMCPResult(MatrixX& M, VectorX& b, VectorX
 
 
 #ifdef USE_PIVOTING_LCP
-bool ConstraintForceSolver::Impl::callPathLCPSolver(MatrixX& Mlcp, VectorX& b, VectorX& solution)
+bool ConstraintForceSolver::Impl::callPathLCPSolver(MatrixXMap& Mlcp, VectorXMap& b, VectorXMap& solution)
 {
     int size = solution.size();
     int square = size * size;
@@ -2221,6 +3219,18 @@ bool ConstraintForceSolver::unregisterCollisionHandler(const std::string& name)
 }
 
 
+void ConstraintForceSolver::storeWarmStartState(std::vector<double>& out_state)
+{
+    impl->storeWarmStartState(out_state);
+}
+
+
+bool ConstraintForceSolver::restoreWarmStartState(const std::vector<double>& state, size_t& io_position)
+{
+    return impl->restoreWarmStartState(state, io_position);
+}
+
+
 void ConstraintForceSolver::setBodyCollisionDetectionMode
 (int bodyIndex, bool isBodyToBodyCollisionEnabled, bool isSelfCollisionEnabled)
 {
@@ -2298,6 +3308,72 @@ int ConstraintForceSolver::gaussSeidelMaxNumIterations()
 }
 
 
+void ConstraintForceSolver::setNumThreadsForAccelerationMatrix(int n)
+{
+    impl->numThreadsForAccelerationMatrix = std::max(1, n);
+}
+
+
+int ConstraintForceSolver::numThreadsForAccelerationMatrix() const
+{
+    return impl->numThreadsForAccelerationMatrix;
+}
+
+
+void ConstraintForceSolver::setMCPSolverType(int type)
+{
+    impl->mcpSolverType = type;
+}
+
+
+int ConstraintForceSolver::mcpSolverType() const
+{
+    return impl->mcpSolverType;
+}
+
+
+int ConstraintForceSolver::peakLCPDimension() const
+{
+    return impl->peakLCPDimension;
+}
+
+
+int ConstraintForceSolver::lastNumContactPoints() const
+{
+    return impl->lastNumContactPoints;
+}
+
+
+int ConstraintForceSolver::lastNumSolverIterations() const
+{
+    return impl->lastNumSolverIterations;
+}
+
+
+void ConstraintForceSolver::setContactReductionEnabled(bool on)
+{
+    impl->isContactReductionEnabled = on;
+}
+
+
+bool ConstraintForceSolver::isContactReductionEnabled() const
+{
+    return impl->isContactReductionEnabled;
+}
+
+
+void ConstraintForceSolver::setGaussSeidelVectorizationEnabled(bool on)
+{
+    impl->isGaussSeidelVectorizationEnabled = on;
+}
+
+
+bool ConstraintForceSolver::isGaussSeidelVectorizationEnabled() const
+{
+    return impl->isGaussSeidelVectorizationEnabled;
+}
+
+
 void ConstraintForceSolver::setContactDepthCorrection(double depth, double velocityRatio)
 {
     impl->contactCorrectionDepth = depth;
@@ -39,16 +39,65 @@ public:
     
     void setContactCullingDepth(double depth);
     double contactCullingDepth();
+
+    /**
+       When this is on, the contact points of each link pair are reduced to at most four points
+       per cluster of the similar normals so that the size of the LCP is bounded for the dense
+       contacts such as the mesh-to-mesh ones.
+    */
+    void setContactReductionEnabled(bool on);
+    bool isContactReductionEnabled() const;
     
     void setCoefficientOfRestitution(double epsilon);
     double coefficientOfRestitution() const;
 
+    enum MCPSolverType { GAUSS_SEIDEL_SOLVER = 0, NNCG_SOLVER, N_MCP_SOLVER_TYPES };
+
+    /**
+       The nonsmooth nonlinear conjugate gradient (NNCG) solver costs a little more per iteration
+       than the projected Gauss-Seidel solver, but it converges in far fewer iterations when the
+       mass ratios of the constrained bodies are high. The error criterion and the max number of
+       iterations are shared by the both solvers.
+    */
+    void setMCPSolverType(int type);
+    int mcpSolverType() const;
+
     void setGaussSeidelErrorCriterion(double e);
     double gaussSeidelErrorCriterion();
 
     void setGaussSeidelMaxNumIterations(int n);
     int gaussSeidelMaxNumIterations();
 
+    /**
+       The row products of the Gauss-Seidel iterations are calculated with the SIMD instructions
+       enabled for the build when this is on. Turn it off to reproduce the results of the scalar
+       summation exactly.
+    */
+    void setGaussSeidelVectorizationEnabled(bool on);
+    bool isGaussSeidelVectorizationEnabled() const;
+
+    /**
+       The columns of the acceleration matrix are calculated with the test forces in parallel
+       when the number is more than one. This must be set before initialize() is called.
+    */
+    void setNumThreadsForAccelerationMatrix(int n);
+    int numThreadsForAccelerationMatrix() const;
+
+    /**
+       The buffers of the LCP keep the capacity for this dimension, which is the peak
+       since the solver was created, so that they are not reallocated in every step.
+    */
+    int peakLCPDimension() const;
+
+    //! The number of the contact points found in the last call of solve()
+    int lastNumContactPoints() const;
+
+    /**
+       The number of the iterations of the MCP solver in the last call of solve(), which
+       is zero when there is no constraint.
+    */
+    int lastNumSolverIterations() const;
+
     void setContactDepthCorrection(double depth, double velocityRatio);
     double contactCorrectionDepth();
     double contactCorrectionVelocityRatio();
@@ -64,6 +113,19 @@ public:
 
     std::shared_ptr<CollisionLinkPairList> getCollisions();
 
+    /**
+       The impulses of the previous step, which are used to warm-start the solver, are appended to
+       the state of a simulation snapshot.
+    */
+    void storeWarmStartState(std::vector<double>& out_state);
+
+    /**
+       \param io_position The position of the state written by storeWarmStartState. The position
+       next to the state is set when the state is restored.
+       \return false if the state is invalid. The current impulses are kept in that case.
+    */
+    bool restoreWarmStartState(const std::vector<double>& state, size_t& io_position);
+
     // experimental functions
     typedef std::function<bool(Link* link1, Link* link2,
                                const CollisionArray& collisions,
@@ -0,0 +1,48 @@
+/**
+   @file
+   @author Shin'ichiro Nakaoka
+*/
+
+#include "DeviceStatePool.h"
+
+using namespace std;
+using namespace cnoid;
+
+
+DeviceStatePool::DeviceStatePool()
+{
+    numAllocations_ = 0;
+}
+
+
+void DeviceStatePool::clear()
+{
+    states.clear();
+    numAllocations_ = 0;
+}
+
+
+/**
+   When the front object is still referenced, it is moved to the back and the next object
+   is examined so that an object kept for a long time by another owner does not prevent
+   the objects behind it from being recycled.
+*/
+DeviceState* DeviceStatePool::getStateCopy(const DeviceState& state)
+{
+    if(states.size() >= 2 && states.front().use_count() > 1){
+        states.push_back(std::move(states.front()));
+        states.pop_front();
+    }
+    // The object is only referenced by this pool when the reference count is one
+    if(!states.empty() && states.front().use_count() == 1){
+        states.push_back(std::move(states.front()));
+        states.pop_front();
+        DeviceState* recycled = states.back();
+        recycled->copyStateFrom(state);
+        return recycled;
+    }
+    DeviceState* newState = state.cloneState();
+    states.push_back(newState);
+    ++numAllocations_;
+    return newState;
+}
@@ -0,0 +1,49 @@
+/**
+   @file
+   @author Shin'ichiro Nakaoka
+*/
+
+#ifndef CNOID_BODY_DEVICE_STATE_POOL_H
+#define CNOID_BODY_DEVICE_STATE_POOL_H
+
+#include "Device.h"
+#include <deque>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+/**
+   This class provides the state objects of a single device by recycling the objects
+   that are no longer referenced by any other object. The objects are examined in the
+   order of their last use, which corresponds to the order of releasing them when the
+   states are recorded in a sequence with a limited length. Only a few objects at the
+   front are examined for each request, and the examined objects are moved to the back.
+*/
+class CNOID_EXPORT DeviceStatePool
+{
+public:
+    DeviceStatePool();
+    DeviceStatePool(const DeviceStatePool& org) = delete;
+    DeviceStatePool& operator=(const DeviceStatePool& rhs) = delete;
+    DeviceStatePool(DeviceStatePool&& org) = default;
+    DeviceStatePool& operator=(DeviceStatePool&& rhs) = default;
+
+    void clear();
+
+    /**
+       @return A state object that has the same state as the given one.
+       The object is allocated only when no recycled object is available.
+    */
+    DeviceState* getStateCopy(const DeviceState& state);
+
+    int numStates() const { return states.size(); }
+    int numAllocations() const { return numAllocations_; }
+
+private:
+    std::deque<DeviceStatePtr> states;
+    int numAllocations_;
+};
+
+}
+
+#endif
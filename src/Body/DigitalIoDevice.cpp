@@ -142,7 +142,11 @@ void DigitalIoDevice::setOut(int index, bool on, bool doNotify)
     out_[index] = on;
 
     if(doNotify && impl){
-        impl->sigOutputMap[index](on);
+        // The map is not searched by operator[] so that an entry is not inserted for each signal
+        auto iter = impl->sigOutputMap.find(index);
+        if(iter != impl->sigOutputMap.end()){
+            iter->second(on);
+        }
         notifyStateChange();
     }
 }
@@ -166,7 +170,10 @@ void DigitalIoDevice::setIn(int index, bool on, bool doNotify)
     }
     
     if(doNotify && impl){
-        impl->sigInputMap[index](on);
+        auto iter = impl->sigInputMap.find(index);
+        if(iter != impl->sigInputMap.end()){
+            iter->second(on);
+        }
         notifyStateChange();
     }
 }
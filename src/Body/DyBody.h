@@ -79,8 +79,6 @@ typedef ref_ptr<DySubBody> DySubBodyPtr;
 class CNOID_EXPORT DyLink : public Link
 {
 public:
-    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
-
     DyLink();
     DyLink(const DyLink& org);
     DyLink(const Link& link);
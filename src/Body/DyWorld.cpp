@@ -3,6 +3,7 @@
 */
 
 #include "DyWorld.h"
+#include <cnoid/ThreadPool>
 
 using namespace std;
 using namespace cnoid;
@@ -21,6 +22,8 @@ DyWorldBase::DyWorldBase()
     hasHighGainDynamics_ = false;
     sensorsAreEnabled = false;
     isOldAccelSensorCalcMode = false;
+    articulatedInertiaReuseThreshold = -1.0;
+    numThreadsForIntegration_ = 1;
     numRegisteredLinkPairs = 0;
 }
 
@@ -71,6 +74,18 @@ void DyWorldBase::setOldAccelSensorCalcMode(bool on)
 }
 
 
+void DyWorldBase::setArticulatedInertiaReuseThreshold(double threshold)
+{
+    articulatedInertiaReuseThreshold = threshold;
+}
+
+
+void DyWorldBase::setNumThreadsForIntegration(int n)
+{
+    numThreadsForIntegration_ = std::max(1, n);
+}
+
+
 void DyWorldBase::initialize()
 {
     for(auto& subBody : subBodies_){
@@ -84,8 +99,16 @@ void DyWorldBase::initialize()
         forwardDynamics->setTimeStep(timeStep_);
         forwardDynamics->enableSensors(sensorsAreEnabled);
         forwardDynamics->setOldAccelSensorCalcMode(isOldAccelSensorCalcMode);
+        forwardDynamics->setArticulatedInertiaReuseThreshold(articulatedInertiaReuseThreshold);
         forwardDynamics->initialize();
     }
+
+    int numThreads = std::min(numThreadsForIntegration_, static_cast<int>(bodies_.size()));
+    if(numThreads <= 1){
+        threadPool.reset();
+    } else if(!threadPool || threadPool->size() != numThreads){
+        threadPool.reset(new ThreadPool(numThreads));
+    }
 }
 
 
@@ -99,13 +122,40 @@ void DyWorldBase::setVirtualJointForces()
 
 void DyWorldBase::calcNextState()
 {
-    for(auto& subBody : subBodies_){
-        subBody->forwardDynamics()->calcNextState();
+    if(threadPool){
+        integrateBodiesInParallel();
+    } else {
+        for(auto& subBody : subBodies_){
+            subBody->forwardDynamics()->calcNextState();
+        }
     }
     currentTime_ += timeStep_;
 }
 
 
+/**
+   The bodies are statically assigned to the threads in the order of the registration, and
+   all the sub bodies of a body are integrated in the same thread. The latter keeps the
+   state change notifications of the devices in a body from being issued concurrently.
+*/
+void DyWorldBase::integrateBodiesInParallel()
+{
+    const int numThreads = threadPool->size();
+    const int numBodies = bodies_.size();
+    for(int i=0; i < numThreads; ++i){
+        threadPool->start(
+            [this, i, numThreads, numBodies](){
+                for(int j = i; j < numBodies; j += numThreads){
+                    for(auto& subBody : bodies_[j]->subBodies()){
+                        subBody->forwardDynamics()->calcNextState();
+                    }
+                }
+            });
+    }
+    threadPool->wait();
+}
+
+
 void DyWorldBase::refreshState()
 {
     for(auto& subBody : subBodies_){
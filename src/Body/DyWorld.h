@@ -10,10 +10,13 @@
 #include "ExtraJoint.h"
 #include <string>
 #include <map>
+#include <memory>
 #include "exportdecl.h"
 
 namespace cnoid {
 
+class ThreadPool;
+
 class CNOID_EXPORT DyWorldBase
 {
 public:
@@ -64,6 +67,23 @@ public:
 
     void setOldAccelSensorCalcMode(bool on);
 
+    /**
+       \brief set the threshold to reuse the articulated inertias of the previous step
+       \note See ForwardDynamics::setArticulatedInertiaReuseThreshold().
+       This must be called before initialize() is called.
+    */
+    void setArticulatedInertiaReuseThreshold(double threshold);
+
+    /**
+       \brief set the number of threads to integrate the bodies in parallel
+       \param n The number of threads. The integration is done serially if n is one or less.
+       \note This must be called before initialize() is called.
+       The constraint forces are solved for all the bodies before the integration, so the
+       bodies are integrated independently and the results do not depend on the number of threads.
+    */
+    void setNumThreadsForIntegration(int n);
+    int numThreadsForIntegration() const { return numThreadsForIntegration_; }
+
     /**
        \brief Use the euler method for integration
     */
@@ -112,8 +132,11 @@ private:
     Vector3 g;
     bool sensorsAreEnabled;
     bool isOldAccelSensorCalcMode;
+    double articulatedInertiaReuseThreshold;
     bool isEulerMethod; // Euler or Runge Kutta ?
     bool hasHighGainDynamics_;
+    int numThreadsForIntegration_;
+    std::unique_ptr<ThreadPool> threadPool;
 
     struct LinkPairKey {
         DyLink* link1;
@@ -126,7 +149,8 @@ private:
 
     std::vector<ExtraJoint> extraJoints_;
 
-    void extractInternalBodies(Link* link);    
+    void extractInternalBodies(Link* link);
+    void integrateBodiesInParallel();
 };
 
 template <class TConstraintForceSolver> class DyWorld : public DyWorldBase
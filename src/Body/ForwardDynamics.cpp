@@ -17,6 +17,7 @@ ForwardDynamics::ForwardDynamics(DySubBody* subBody)
 
     integrationMode = RUNGEKUTTA_METHOD;
     sensorsEnabled = false;
+    articulatedInertiaReuseThreshold = -1.0;
 }
 
 
@@ -62,6 +63,12 @@ void ForwardDynamics::setOldAccelSensorCalcMode(bool on)
 }
 
 
+void ForwardDynamics::setArticulatedInertiaReuseThreshold(double threshold)
+{
+    articulatedInertiaReuseThreshold = threshold;
+}
+
+
 /// function from Murray, Li and Sastry p.42
 void ForwardDynamics::SE3exp
 (Isometry3& out_T, const Isometry3& T0, const Vector3& w, const Vector3& vo, double dt)
@@ -34,6 +34,15 @@ public:
     void enableSensors(bool on);
     void setOldAccelSensorCalcMode(bool on);
 
+    /**
+       The articulated inertias of the previous step are reused when the changes of the joint
+       displacements and the root position / attitude elements are within the threshold.
+       Zero means reusing them only for the unchanged configuration, and a negative value
+       disables the reuse. This is effective with the Euler method because the Runge-Kutta
+       method calculates the inertias for the intermediate states in each step.
+    */
+    void setArticulatedInertiaReuseThreshold(double threshold);
+
     virtual void initialize() = 0;
     virtual void calcNextState() = 0;
     virtual void refreshState() = 0;
@@ -55,6 +64,7 @@ protected:
     Vector3 g;
     double timeStep;
     bool sensorsEnabled;
+    double articulatedInertiaReuseThreshold;
     BasicSensorSimulationHelper sensorHelper;
 
     enum { EULER_METHOD, RUNGEKUTTA_METHOD } integrationMode;
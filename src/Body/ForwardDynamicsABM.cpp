@@ -6,6 +6,8 @@
 #include "ForwardDynamicsABM.h"
 #include "DyBody.h"
 #include <cnoid/EigenUtil>
+#include <unordered_map>
+#include <unordered_set>
 
 using namespace std;
 using namespace cnoid;
@@ -19,9 +21,11 @@ ForwardDynamicsABM::ForwardDynamicsABM(DySubBody* subBody) :
     q0(subBody->numLinks()),
     dq0(subBody->numLinks()),
     dq(subBody->numLinks()),
-    ddq(subBody->numLinks())
+    ddq(subBody->numLinks()),
+    qOfArticulatedInertia(subBody->numLinks())
 {
-
+    isArticulatedInertiaReusable = false;
+    isArticulatedInertiaValid = false;
 }
 
 
@@ -44,6 +48,12 @@ void ForwardDynamicsABM::initialize()
     root->uu() = 0.0;
     root->dd() = 0.0;
 
+    compileLinkProgram();
+
+    // The configuration of a sub body root that has a parent depends on the other sub body
+    isArticulatedInertiaReusable = (articulatedInertiaReuseThreshold >= 0.0) && (root->isFreeJoint() || !root->parent());
+    isArticulatedInertiaValid = false;
+
     initializeSensors();
     calcABMFirstHalf();
 }
@@ -51,8 +61,47 @@ void ForwardDynamicsABM::initialize()
 
 inline void ForwardDynamicsABM::calcABMFirstHalf()
 {
-    calcABMPhase1(true);
-    calcABMPhase2Part1();
+    if(canReuseArticulatedInertia()){
+        calcABMPhase1(true, false);
+        calcABMPhase2Part1(false);
+    } else {
+        calcABMPhase1(true);
+        calcABMPhase2Part1();
+        storeConfigurationOfArticulatedInertia();
+    }
+}
+
+
+bool ForwardDynamicsABM::canReuseArticulatedInertia() const
+{
+    if(!isArticulatedInertiaValid){
+        return false;
+    }
+    const double threshold = articulatedInertiaReuseThreshold;
+    auto root = subBody->rootLink();
+    if(((root->T().matrix() - rootTOfArticulatedInertia.matrix()).array().abs() > threshold).any()){
+        return false;
+    }
+    const int n = subBody->numLinks();
+    for(int i=1; i < n; ++i){
+        if(fabs(subBody->link(i)->q() - qOfArticulatedInertia[i]) > threshold){
+            return false;
+        }
+    }
+    return true;
+}
+
+
+void ForwardDynamicsABM::storeConfigurationOfArticulatedInertia()
+{
+    if(isArticulatedInertiaReusable){
+        rootTOfArticulatedInertia = subBody->rootLink()->T();
+        const int n = subBody->numLinks();
+        for(int i=1; i < n; ++i){
+            qOfArticulatedInertia[i] = subBody->link(i)->q();
+        }
+        isArticulatedInertiaValid = true;
+    }
 }
 
 
@@ -65,6 +114,7 @@ inline void ForwardDynamicsABM::calcABMLastHalf()
 
 void ForwardDynamicsABM::refreshState()
 {
+    isArticulatedInertiaValid = false;
     calcABMFirstHalf();
 }
 
@@ -158,6 +208,9 @@ void ForwardDynamicsABM::calcMotionWithRungeKuttaMethod()
 {
     auto root = subBody->rootLink();
 
+    // The articulated inertias are overwritten for the intermediate states
+    isArticulatedInertiaValid = false;
+
     if(!root->isFixedJoint()){
         T0 = root->T();
         vo0 = root->vo();
@@ -218,99 +271,226 @@ void ForwardDynamicsABM::calcMotionWithRungeKuttaMethod()
 
 
 /**
-   \note v, dv, dw are not used in the forward dynamics, but are calculated
-   for forward dynamics users.
+   The links except the root are compiled into the runs of the consecutive links of the same
+   kind so that the loops of the ABM phases are dispatched to the kernels specialized for each
+   kind by the run instead of branching on the joint type by the link. A fixed joint link without
+   a force sensor is fused into the nearest ancestor that is not fused, and the mass properties
+   of the ancestor include those of the fused links.
 */
-void ForwardDynamicsABM::calcABMPhase1(bool updateNonSpatialVariables)
+void ForwardDynamicsABM::compileLinkProgram()
 {
     const int n = subBody->numLinks();
 
+    std::unordered_map<const DyLink*, int> linkToIndexMap;
+    std::unordered_set<const Link*> linksWithForceSensors;
+    for(auto& sensor : subBody->forceSensors()){
+        linksWithForceSensors.insert(sensor->link());
+    }
+
+    massProperties.resize(n);
+    vector<int> fusionTargets(n);
+    vector<Isometry3, Eigen::aligned_allocator<Isometry3>> fusionTargetToLink(n);
+    vector<int> linkKinds(n);
+
     for(int i=0; i < n; ++i){
         auto link = subBody->link(i);
-        DyLink* parent;
-        if(i == 0 && link->isFreeJoint()){
-            parent = nullptr;
+        linkToIndexMap[link] = i;
+        auto& mp = massProperties[i];
+        mp.m = link->m();
+        mp.c = link->c();
+        mp.I = link->I();
+        mp.hasFusedLinks = false;
+        fusionTargets[i] = i;
+        fusionTargetToLink[i].setIdentity();
+
+        if(i == 0){
+            continue;
+        }
+        int& kind = linkKinds[i];
+        if(link->jointType() == Link::ROTATIONAL_JOINT){
+            kind = RotationalLink;
+        } else if(link->jointType() == Link::SLIDE_JOINT){
+            kind = SlideLink;
+        } else if(!link->isFixedJoint()){
+            kind = OtherLink;
+        } else if(linksWithForceSensors.find(link) != linksWithForceSensors.end()){
+            kind = FixedLink;
+        } else {
+            kind = FusedFixedLink;
+            const int parentIndex = linkToIndexMap[link->parent()];
+            const int target = fusionTargets[parentIndex];
+            fusionTargets[i] = target;
+            fusionTargetToLink[i] = fusionTargetToLink[parentIndex] * link->Tb();
+
+            // Combine the mass properties with the parallel axis theorem
+            auto& tp = massProperties[target];
+            const Isometry3& T = fusionTargetToLink[i];
+            const double m = link->m();
+            const double mt = tp.m + m;
+            if(mt > 0.0){
+                const Vector3 c = T * link->c();
+                const Vector3 ct = (tp.m * tp.c + m * c) / mt;
+                const Vector3 d0 = tp.c - ct;
+                const Vector3 d1 = c - ct;
+                tp.I = tp.I + tp.m * (d0.squaredNorm() * Matrix3::Identity() - d0 * d0.transpose())
+                    + T.linear() * link->I() * T.linear().transpose()
+                    + m * (d1.squaredNorm() * Matrix3::Identity() - d1 * d1.transpose());
+                tp.c = ct;
+                tp.m = mt;
+            }
+            tp.hasFusedLinks = true;
+        }
+    }
+
+    linkRuns.clear();
+    for(int i=1; i < n; ++i){
+        if(linkRuns.empty() || linkRuns.back().kind != linkKinds[i]){
+            linkRuns.push_back({ linkKinds[i], i, i + 1 });
         } else {
-            parent = link->parent();
+            linkRuns.back().end = i + 1;
         }
+    }
+}
+
+
+/**
+   \note v, dv, dw are not used in the forward dynamics, but are calculated
+   for forward dynamics users.
+   \param updateInertia The inertia elements of the links are not updated when this is false
+   so that the articulated inertias of the previous step are kept.
+*/
+void ForwardDynamicsABM::calcABMPhase1(bool updateNonSpatialVariables, bool updateInertia)
+{
+    auto root = subBody->rootLink();
+    if(updateNonSpatialVariables){
+        root->v().noalias() = root->vo() + root->w().cross(root->p());
+    }
+    calcABMPhase1MassElements(0, updateInertia);
+
+    for(auto& run : linkRuns){
+        switch(run.kind){
+        case RotationalLink:
+            calcABMPhase1Run<RotationalLink>(run, updateNonSpatialVariables, updateInertia);
+            break;
+        case SlideLink:
+            calcABMPhase1Run<SlideLink>(run, updateNonSpatialVariables, updateInertia);
+            break;
+        case FixedLink:
+            calcABMPhase1Run<FixedLink>(run, updateNonSpatialVariables, updateInertia);
+            break;
+        case FusedFixedLink:
+            calcABMPhase1Run<FusedFixedLink>(run, updateNonSpatialVariables, updateInertia);
+            break;
+        default:
+            calcABMPhase1Run<OtherLink>(run, updateNonSpatialVariables, updateInertia);
+            break;
+        }
+    }
+}
 
-        if(parent){
-            
-            switch(link->jointType()){
-                
-            case Link::ROTATIONAL_JOINT:
-            {
+
+template<int Kind>
+void ForwardDynamicsABM::calcABMPhase1Run(const LinkRun& run, bool updateNonSpatialVariables, bool updateInertia)
+{
+    for(int i = run.begin; i < run.end; ++i){
+        auto link = subBody->link(i);
+        const DyLink* parent = link->parent();
+
+        if(Kind == RotationalLink){
+            const Vector3 arm = parent->R() * link->b();
+            link->R().noalias() = parent->R() * link->Rb() * AngleAxisd(link->q(), link->a());
+            link->p().noalias() = arm + parent->p();
+            link->sw().noalias() = parent->R() * (link->Rb() * link->a());
+            link->sv().noalias() = link->p().cross(link->sw());
+            link->w().noalias() = link->dq() * link->sw() + parent->w();
+            if(updateNonSpatialVariables){
+                link->dw().noalias() =
+                    parent->dw() + link->dq() * parent->w().cross(link->sw()) + (link->ddq() * link->sw());
+                link->dv().noalias() =
+                    parent->dv() + parent->w().cross(parent->w().cross(arm)) + parent->dw().cross(arm);
+            }
+        } else if(Kind == SlideLink){
+            link->p().noalias() = parent->R() * (link->b() + link->Rb() * (link->q() * link->d())) + parent->p();
+            link->R().noalias() = parent->R() * link->Rb();
+            link->sw().setZero();
+            link->sv().noalias() = parent->R() * (link->Rb() * link->d());
+            link->w() = parent->w();
+            if(updateNonSpatialVariables){
+                link->dw() = parent->dw();
                 const Vector3 arm = parent->R() * link->b();
-                link->R().noalias() = parent->R() * link->Rb() * AngleAxisd(link->q(), link->a());
-                link->p().noalias() = arm + parent->p();
-                link->sw().noalias() = parent->R() * (link->Rb() * link->a());
-                link->sv().noalias() = link->p().cross(link->sw());
-                link->w().noalias() = link->dq() * link->sw() + parent->w();
-                if(updateNonSpatialVariables){
-                    link->dw().noalias() =
-                        parent->dw() + link->dq() * parent->w().cross(link->sw()) + (link->ddq() * link->sw());
-                    link->dv().noalias() =
-                        parent->dv() + parent->w().cross(parent->w().cross(arm)) + parent->dw().cross(arm);
-                }
-                break;
+                link->dv().noalias() =
+                    parent->dv() + parent->w().cross(parent->w().cross(arm)) + parent->dw().cross(arm)
+                    + 2.0 * link->dq() * parent->w().cross(link->sv()) + link->ddq() * link->sv();
             }
-                
-            case Link::SLIDE_JOINT:
-                link->p().noalias() = parent->R() * (link->b() + link->Rb() * (link->q() * link->d())) + parent->p();
-                link->R().noalias() = parent->R() * link->Rb();
-                link->sw().setZero();
-                link->sv().noalias() = parent->R() * (link->Rb() * link->d());
-                link->w() = parent->w();
-                if(updateNonSpatialVariables){
-                    link->dw() = parent->dw();
-                    const Vector3 arm = parent->R() * link->b();
-                    link->dv().noalias() =
-                        parent->dv() + parent->w().cross(parent->w().cross(arm)) + parent->dw().cross(arm)
-                        + 2.0 * link->dq() * parent->w().cross(link->sv()) + link->ddq() * link->sv();
-                }
-                break;
-                
-            case Link::FIXED_JOINT:
-            default:
-                link->p().noalias() = parent->R() * link->b() + parent->p();
-                link->R().noalias() = parent->R() * link->Rb();
-                link->w() = parent->w();
-                link->vo() = parent->vo();
-                link->sw().setZero();
-                link->sv().setZero();
-                link->cv().setZero();
-                link->cw().setZero();
-                if(updateNonSpatialVariables){
-                    link->dw() = parent->dw();
-                    const Vector3 arm = parent->R() * link->b();
-                    link->dv().noalias() = parent->dv() +
-                        parent->w().cross(parent->w().cross(arm)) + parent->dw().cross(arm);
-                }
-                
-                goto COMMON_CALCS_FOR_ALL_JOINT_TYPES;
+        } else {
+            link->p().noalias() = parent->R() * link->b() + parent->p();
+            link->R().noalias() = parent->R() * link->Rb();
+            link->w() = parent->w();
+            link->vo() = parent->vo();
+            link->sw().setZero();
+            link->sv().setZero();
+            link->cv().setZero();
+            link->cw().setZero();
+            if(updateNonSpatialVariables){
+                link->dw() = parent->dw();
+                const Vector3 arm = parent->R() * link->b();
+                link->dv().noalias() = parent->dv() +
+                    parent->w().cross(parent->w().cross(arm)) + parent->dw().cross(arm);
             }
-            
-            // Common for ROTATE and SLIDE
+        }
+
+        if(Kind == RotationalLink || Kind == SlideLink){
             link->vo().noalias() = link->dq() * link->sv() + parent->vo();
             const Vector3 dsv = parent->w().cross(link->sv()) + parent->vo().cross(link->sw());
             const Vector3 dsw = parent->w().cross(link->sw());
             link->cv().noalias() = link->dq() * dsv;
             link->cw().noalias() = link->dq() * dsw;
         }
-        
-COMMON_CALCS_FOR_ALL_JOINT_TYPES:
 
         if(updateNonSpatialVariables){
             link->v().noalias() = link->vo() + link->w().cross(link->p());
         }
-        link->wc().noalias() = link->R() * link->c() + link->p();
+
+        if(Kind == FusedFixedLink){
+            // The mass properties are included in the link that the link is fused into
+            link->wc().noalias() = link->R() * link->c() + link->p();
+            if(updateInertia){
+                link->Ivv().setZero();
+                link->Iwv().setZero();
+                link->Iww().setZero();
+            }
+            link->pf().setZero();
+            link->ptau().setZero();
+        } else {
+            calcABMPhase1MassElements(i, updateInertia);
+        }
+    }
+}
+
+
+void ForwardDynamicsABM::calcABMPhase1MassElements(int linkIndex, bool updateInertia)
+{
+    auto link = subBody->link(linkIndex);
+    const auto& mp = massProperties[linkIndex];
+
+    link->wc().noalias() = link->R() * link->c() + link->p();
+    Vector3 wc;
+    if(mp.hasFusedLinks){
+        wc.noalias() = link->R() * mp.c + link->p();
+    } else {
+        wc = link->wc();
+    }
         
-        // compute I^s (Eq.(6.24) of Kajita's textbook))
-        const Matrix3 Iw = link->R() * link->I() * link->R().transpose();
+    // compute I^s (Eq.(6.24) of Kajita's textbook))
+    const Matrix3 Iw = link->R() * mp.I * link->R().transpose();
         
-        const double m = link->m();
-        const Matrix3 c_hat = hat(link->wc());
-        link->Iww().noalias() = m * c_hat * c_hat.transpose() + Iw;
+    const double m = mp.m;
+    const Matrix3 c_hat = hat(wc);
+    Matrix3 Iww;
+    Iww.noalias() = m * c_hat * c_hat.transpose() + Iw;
+
+    if(updateInertia){
+        link->Iww() = Iww;
 
         link->Ivv() <<
             m,  0.0, 0.0,
@@ -318,107 +498,157 @@ COMMON_CALCS_FOR_ALL_JOINT_TYPES:
             0.0, 0.0,  m;
         
         link->Iwv() = m * c_hat;
+    }
         
-        // compute P and L (Eq.(6.25) of Kajita's textbook)
-        const Vector3 P = m * (link->vo() + link->w().cross(link->wc()));
-        const Vector3 L = link->Iww() * link->w() + m * link->wc().cross(link->vo());
+    // compute P and L (Eq.(6.25) of Kajita's textbook)
+    const Vector3 P = m * (link->vo() + link->w().cross(wc));
+    const Vector3 L = Iww * link->w() + m * wc.cross(link->vo());
         
-        link->pf().noalias() = link->w().cross(P);
-        link->ptau().noalias() = link->vo().cross(P) + link->w().cross(L);
+    link->pf().noalias() = link->w().cross(P);
+    link->ptau().noalias() = link->vo().cross(P) + link->w().cross(L);
         
-        const Vector3 fg = m * g;
-        const Vector3 tg = link->wc().cross(fg);
+    const Vector3 fg = m * g;
+    const Vector3 tg = wc.cross(fg);
         
-        link->pf() -= fg;
-        link->ptau() -= tg;
-    }
+    link->pf() -= fg;
+    link->ptau() -= tg;
 }
 
 
+/*
+   The inbound loops of phase 2 are processed in the reverse order of the links, and each link
+   adds its elements to its parent after its own elements are completed by its children.
+*/
+
 void ForwardDynamicsABM::calcABMPhase2()
 {
-    const int n = subBody->numLinks();
+    for(auto p = linkRuns.rbegin(); p != linkRuns.rend(); ++p){
+        switch(p->kind){
+        case RotationalLink: calcABMPhase2Run<RotationalLink>(*p); break;
+        case SlideLink: calcABMPhase2Run<SlideLink>(*p); break;
+        case FixedLink: calcABMPhase2Run<FixedLink>(*p); break;
+        case FusedFixedLink: calcABMPhase2Run<FusedFixedLink>(*p); break;
+        default: calcABMPhase2Run<OtherLink>(*p); break;
+        }
+    }
+    auto root = subBody->rootLink();
+    root->pf()   -= root->f_ext();
+    root->ptau() -= root->tau_ext();
+}
 
-    for(int i = n-1; i >= 0; --i){
+
+template<int Kind>
+void ForwardDynamicsABM::calcABMPhase2Run(const LinkRun& run)
+{
+    const bool isFixed = (Kind == FixedLink || Kind == FusedFixedLink);
+
+    for(int i = run.end - 1; i >= run.begin; --i){
         auto link = subBody->link(i);
+        auto parent = link->parent();
 
         link->pf()   -= link->f_ext();
         link->ptau() -= link->tau_ext();
 
+        if(!isFixed){
+            // hh = Ia * s
+            link->hhv().noalias() = link->Ivv() * link->sv() + link->Iwv().transpose() * link->sw();
+            link->hhw().noalias() = link->Iwv() * link->sv() + link->Iww() * link->sw();
+            // dd = Ia * s * s^T
+            link->dd() = link->sv().dot(link->hhv()) + link->sw().dot(link->hhw()) + link->Jm2();
+            // uu = u - hh^T*c + s^T*pp
+            link->uu() = link->u() -
+                (link->hhv().dot(link->cv()) + link->hhw().dot(link->cw()) +
+                 link->sv().dot(link->pf()) + link->sw().dot(link->ptau()));
+        }
+
         // compute articulated inertia (Eq.(6.48) of Kajita's textbook)
-        for(DyLink* child = link->child(); child; child = child->sibling()){
-            if(child->isFreeJoint()){
-                continue;
-            } else if(child->isFixedJoint()){
-                link->Ivv() += child->Ivv();
-                link->Iwv() += child->Iwv();
-                link->Iww() += child->Iww();
-
-            } else {
-                const Vector3 hhv_dd = child->hhv() / child->dd();
-                link->Ivv().noalias() += child->Ivv() - child->hhv() * hhv_dd.transpose();
-                link->Iwv().noalias() += child->Iwv() - child->hhw() * hhv_dd.transpose();
-                link->Iww().noalias() += child->Iww() - child->hhw() * (child->hhw() / child->dd()).transpose();
-            }
-            link->pf()  .noalias() += child->Ivv() * child->cv() + child->Iwv().transpose() * child->cw() + child->pf();
-            link->ptau().noalias() += child->Iwv() * child->cv() + child->Iww() * child->cw() + child->ptau();
+        addArticulatedInertiaToParent<Kind>(link, parent);
+        addBiasForceToParent<Kind>(link, parent);
+        parent->pf()   += link->pf();
+        parent->ptau() += link->ptau();
+        addJointForceToParent<Kind>(link, parent);
+    }
+}
 
-            if(!child->isFixedJoint()){
-                const double uu_dd = child->uu() / child->dd();
-                link->pf()   += uu_dd * child->hhv();
-                link->ptau() += uu_dd * child->hhw();
-            }
-        }
 
-        if(i > 0){
-            if(!link->isFixedJoint()){
-                // hh = Ia * s
-                link->hhv().noalias() = link->Ivv() * link->sv() + link->Iwv().transpose() * link->sw();
-                link->hhw().noalias() = link->Iwv() * link->sv() + link->Iww() * link->sw();
-                // dd = Ia * s * s^T
-                link->dd() = link->sv().dot(link->hhv()) + link->sw().dot(link->hhw()) + link->Jm2();
-                // uu = u - hh^T*c + s^T*pp
-                link->uu() = link->u() -
-                    (link->hhv().dot(link->cv()) + link->hhw().dot(link->cw()) +
-                     link->sv().dot(link->pf()) + link->sw().dot(link->ptau()));
-            }
+template<int Kind>
+inline void ForwardDynamicsABM::addArticulatedInertiaToParent(DyLink* link, DyLink* parent)
+{
+    if(Kind == FixedLink || Kind == FusedFixedLink){
+        parent->Ivv() += link->Ivv();
+        parent->Iwv() += link->Iwv();
+        parent->Iww() += link->Iww();
+    } else {
+        const Vector3 hhv_dd = link->hhv() / link->dd();
+        parent->Ivv().noalias() += link->Ivv() - link->hhv() * hhv_dd.transpose();
+        parent->Iwv().noalias() += link->Iwv() - link->hhw() * hhv_dd.transpose();
+        parent->Iww().noalias() += link->Iww() - link->hhw() * (link->hhw() / link->dd()).transpose();
+    }
+}
+
+
+// The bias force by the velocity product terms, which are zero for the links other than the joints with axes
+template<int Kind>
+inline void ForwardDynamicsABM::addBiasForceToParent(DyLink* link, DyLink* parent)
+{
+    if(Kind == RotationalLink || Kind == SlideLink){
+        parent->pf()  .noalias() += link->Ivv() * link->cv() + link->Iwv().transpose() * link->cw();
+        parent->ptau().noalias() += link->Iwv() * link->cv() + link->Iww() * link->cw();
+    }
+}
+
+
+template<int Kind>
+inline void ForwardDynamicsABM::addJointForceToParent(DyLink* link, DyLink* parent)
+{
+    if(Kind != FixedLink && Kind != FusedFixedLink){
+        const double uu_dd = link->uu() / link->dd();
+        parent->pf()   += uu_dd * link->hhv();
+        parent->ptau() += uu_dd * link->hhw();
+    }
+}
+
+
+/**
+   A part of phase 2 (inbound loop) that can be calculated before external forces are given
+   \param updateArticulatedInertia The articulated inertias of the previous step are used
+   when this is false.
+*/
+void ForwardDynamicsABM::calcABMPhase2Part1(bool updateArticulatedInertia)
+{
+    for(auto p = linkRuns.rbegin(); p != linkRuns.rend(); ++p){
+        switch(p->kind){
+        case RotationalLink: calcABMPhase2Part1Run<RotationalLink>(*p, updateArticulatedInertia); break;
+        case SlideLink: calcABMPhase2Part1Run<SlideLink>(*p, updateArticulatedInertia); break;
+        case FixedLink: calcABMPhase2Part1Run<FixedLink>(*p, updateArticulatedInertia); break;
+        case FusedFixedLink: calcABMPhase2Part1Run<FusedFixedLink>(*p, updateArticulatedInertia); break;
+        default: calcABMPhase2Part1Run<OtherLink>(*p, updateArticulatedInertia); break;
         }
     }
 }
 
 
-// A part of phase 2 (inbound loop) that can be calculated before external forces are given
-void ForwardDynamicsABM::calcABMPhase2Part1()
+template<int Kind>
+void ForwardDynamicsABM::calcABMPhase2Part1Run(const LinkRun& run, bool updateArticulatedInertia)
 {
-    const int n = subBody->numLinks();
+    const bool isFixed = (Kind == FixedLink || Kind == FusedFixedLink);
 
-    for(int i = n-1; i >= 0; --i){
+    for(int i = run.end - 1; i >= run.begin; --i){
         auto link = subBody->link(i);
-        for(DyLink* child = link->child(); child; child = child->sibling()){
-            if(child->isFreeJoint()){
-                continue;
-            } else if(child->isFixedJoint()){
-                link->Ivv() += child->Ivv();
-                link->Iwv() += child->Iwv();
-                link->Iww() += child->Iww();
-            } else {
-                const Vector3 hhv_dd = child->hhv() / child->dd();
-                link->Ivv().noalias() += child->Ivv() - child->hhv() * hhv_dd.transpose();
-                link->Iwv().noalias() += child->Iwv() - child->hhw() * hhv_dd.transpose();
-                link->Iww().noalias() += child->Iww() - child->hhw() * (child->hhw() / child->dd()).transpose();
-            }
-            link->pf()  .noalias() += child->Ivv() * child->cv() + child->Iwv().transpose() * child->cw();
-            link->ptau().noalias() += child->Iwv() * child->cv() + child->Iww() * child->cw();
-        }
+        auto parent = link->parent();
 
-        if(i > 0){
-            if(!link->isFixedJoint()){
+        if(!isFixed){
+            if(updateArticulatedInertia){
                 link->hhv().noalias() = link->Ivv() * link->sv() + link->Iwv().transpose() * link->sw();
                 link->hhw().noalias() = link->Iwv() * link->sv() + link->Iww() * link->sw();
                 link->dd() = link->sv().dot(link->hhv()) + link->sw().dot(link->hhw()) + link->Jm2();
-                link->uu() = -(link->hhv().dot(link->cv()) + link->hhw().dot(link->cw()));
             }
+            link->uu() = -(link->hhv().dot(link->cv()) + link->hhw().dot(link->cw()));
+        }
+        if(updateArticulatedInertia){
+            addArticulatedInertiaToParent<Kind>(link, parent);
         }
+        addBiasForceToParent<Kind>(link, parent);
     }
 }
 
@@ -426,33 +656,39 @@ void ForwardDynamicsABM::calcABMPhase2Part1()
 // A remaining part of phase 2 that requires external forces
 void ForwardDynamicsABM::calcABMPhase2Part2()
 {
-    const int n = subBody->numLinks();
+    for(auto p = linkRuns.rbegin(); p != linkRuns.rend(); ++p){
+        switch(p->kind){
+        case RotationalLink: calcABMPhase2Part2Run<RotationalLink>(*p); break;
+        case SlideLink: calcABMPhase2Part2Run<SlideLink>(*p); break;
+        case FixedLink: calcABMPhase2Part2Run<FixedLink>(*p); break;
+        case FusedFixedLink: calcABMPhase2Part2Run<FusedFixedLink>(*p); break;
+        default: calcABMPhase2Part2Run<OtherLink>(*p); break;
+        }
+    }
+    auto root = subBody->rootLink();
+    root->pf()   -= root->f_ext();
+    root->ptau() -= root->tau_ext();
+}
+
 
-    for(int i = n-1; i >= 0; --i){
+template<int Kind>
+void ForwardDynamicsABM::calcABMPhase2Part2Run(const LinkRun& run)
+{
+    const bool isFixed = (Kind == FixedLink || Kind == FusedFixedLink);
+
+    for(int i = run.end - 1; i >= run.begin; --i){
         auto link = subBody->link(i);
+        auto parent = link->parent();
 
         link->pf()   -= link->f_ext();
         link->ptau() -= link->tau_ext();
 
-        for(DyLink* child = link->child(); child; child = child->sibling()){
-            if(child->isFreeJoint()){
-                continue;
-            }
-            link->pf()   += child->pf();
-            link->ptau() += child->ptau();
-
-            if(!child->isFixedJoint()){
-                const double uu_dd = child->uu() / child->dd();
-                link->pf()   += uu_dd * child->hhv();
-                link->ptau() += uu_dd * child->hhw();
-            }
-        }
-
-        if(i > 0){
-            if(!link->isFixedJoint()){
-                link->uu() += link->u() - (link->sv().dot(link->pf()) + link->sw().dot(link->ptau()));
-            }
+        if(!isFixed){
+            link->uu() += link->u() - (link->sv().dot(link->pf()) + link->sw().dot(link->ptau()));
         }
+        parent->pf()   += link->pf();
+        parent->ptau() += link->ptau();
+        addJointForceToParent<Kind>(link, parent);
     }
 }
 
@@ -482,11 +718,23 @@ void ForwardDynamicsABM::calcABMPhase3()
         root->dw() = a.tail<3>();
     }
 
-    const int n = subBody->numLinks();
-    for(int i=1; i < n; ++i){
+    for(auto& run : linkRuns){
+        if(run.kind == FixedLink || run.kind == FusedFixedLink){
+            calcABMPhase3Run<FixedLink>(run);
+        } else {
+            calcABMPhase3Run<RotationalLink>(run);
+        }
+    }
+}
+
+
+template<int Kind>
+void ForwardDynamicsABM::calcABMPhase3Run(const LinkRun& run)
+{
+    for(int i = run.begin; i < run.end; ++i){
         auto link = subBody->link(i);
         auto parent = link->parent();
-        if(link->isFixedJoint()){
+        if(Kind == FixedLink){
             link->ddq() = 0.0;
             link->dvo() = parent->dvo();
             link->dw()  = parent->dw(); 
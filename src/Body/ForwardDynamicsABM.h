@@ -11,6 +11,9 @@
 
 namespace cnoid
 {
+
+class DyLink;
+
 /**
    Forward dynamics calculation using Featherstone's Articulated Body Method (ABM)
 */
@@ -27,6 +30,27 @@ public:
     virtual void refreshState();
     
 private:
+
+    enum LinkKind { RotationalLink, SlideLink, FixedLink, FusedFixedLink, OtherLink };
+
+    // Consecutive links of the same kind
+    struct LinkRun {
+        int kind;
+        int begin;
+        int end;
+    };
+    std::vector<LinkRun> linkRuns;
+
+    // Mass properties used in the calculation, which include those of the fused links
+    struct MassProperties {
+        double m;
+        Vector3 c;
+        Matrix3 I;
+        bool hasFusedLinks;
+    };
+    std::vector<MassProperties> massProperties;
+
+    void compileLinkProgram();
         
     void calcMotionWithEulerMethod();
     void integrateRungeKuttaOneStep(double r, double dt);
@@ -35,23 +59,35 @@ private:
     /**
        compute position/orientation/velocity
     */
-    void calcABMPhase1(bool updateNonSpatialVariables);
+    void calcABMPhase1(bool updateNonSpatialVariables, bool updateInertia = true);
+    template<int Kind> void calcABMPhase1Run(const LinkRun& run, bool updateNonSpatialVariables, bool updateInertia);
+    void calcABMPhase1MassElements(int linkIndex, bool updateInertia);
 
     /**
        compute articulated inertia
     */
     void calcABMPhase2();
-    void calcABMPhase2Part1();
+    void calcABMPhase2Part1(bool updateArticulatedInertia = true);
     void calcABMPhase2Part2();
+    template<int Kind> void calcABMPhase2Run(const LinkRun& run);
+    template<int Kind> void calcABMPhase2Part1Run(const LinkRun& run, bool updateArticulatedInertia);
+    template<int Kind> void calcABMPhase2Part2Run(const LinkRun& run);
+    template<int Kind> void addArticulatedInertiaToParent(DyLink* link, DyLink* parent);
+    template<int Kind> void addBiasForceToParent(DyLink* link, DyLink* parent);
+    template<int Kind> void addJointForceToParent(DyLink* link, DyLink* parent);
 
     /**
        compute joint acceleration/spatial acceleration
     */
     void calcABMPhase3();
+    template<int Kind> void calcABMPhase3Run(const LinkRun& run);
 
     inline void calcABMFirstHalf();
     inline void calcABMLastHalf();
 
+    bool canReuseArticulatedInertia() const;
+    void storeConfigurationOfArticulatedInertia();
+
     void updateForceSensors();
 
     // Buffers for the Runge Kutta Method
@@ -67,6 +103,12 @@ private:
     Vector3 dw;
     std::vector<double> dq;
     std::vector<double> ddq;
+
+    // Configuration for which the articulated inertias have been calculated
+    bool isArticulatedInertiaReusable;
+    bool isArticulatedInertiaValid;
+    Isometry3 rootTOfArticulatedInertia;
+    std::vector<double> qOfArticulatedInertia;
 };
 	
 }
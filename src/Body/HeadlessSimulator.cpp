@@ -0,0 +1,582 @@
+#include "HeadlessSimulator.h"
+#include "DyWorld.h"
+#include "DyBody.h"
+#include "ConstraintForceSolver.h"
+#include "MaterialTable.h"
+#include "BodyLoader.h"
+#include <cnoid/AISTCollisionDetector>
+#include <cnoid/YAMLReader>
+#include <cnoid/EigenArchive>
+#include <cnoid/FilePathVariableProcessor>
+#include <cnoid/ExecutablePath>
+#include <cnoid/CloneMap>
+#include <cnoid/NullOut>
+#include <cnoid/UTF8>
+#include <cnoid/stdx/filesystem>
+#include <vector>
+#include <fmt/format.h>
+#include "gettext.h"
+
+using namespace std;
+using namespace cnoid;
+using fmt::format;
+namespace filesystem = cnoid::stdx::filesystem;
+
+namespace {
+
+const double DEFAULT_GRAVITY_ACCELERATION = 9.80665;
+
+}
+
+namespace cnoid {
+
+class HeadlessSimulator::Impl
+{
+public:
+    DyWorld<ConstraintForceSolver> world;
+    struct BodyInfo
+    {
+        DyBodyPtr body;
+        bool isCollisionDetectionEnabled;
+        bool isSelfCollisionDetectionEnabled;
+    };
+    vector<BodyInfo> bodyInfos;
+    MaterialTablePtr materialTable;
+    double timeStep;
+    double timeLength;
+    Vector3 gravity;
+    bool isRungeKuttaMethodEnabled;
+    int numThreadsForIntegration;
+    vector<std::function<void()>> preDynamicsFunctions;
+    vector<std::function<void()>> postDynamicsFunctions;
+    bool isInitialized;
+    ostream* os_;
+
+    // Parameters of the constraint force solver
+    double minFrictionCoefficient;
+    double maxFrictionCoefficient;
+    double contactCullingDistance;
+    double contactCullingDepth;
+    double errorCriterion;
+    int maxNumIterations;
+    double contactCorrectionDepth;
+    double contactCorrectionVelocityRatio;
+    double epsilon;
+    bool isContactReductionEnabled;
+    bool isGaussSeidelVectorizationEnabled;
+    bool isNNCGSolverEnabled;
+    bool is2Dmode;
+
+    Impl();
+    ostream& os() { return *os_; }
+    int addBody(DyBody* body, bool isCollisionDetectionEnabled, bool isSelfCollisionDetectionEnabled);
+    bool loadProject(const std::string& filename);
+    bool loadItems(Mapping* itemNode, FilePathVariableProcessor* pathProcessor, bool& io_isWorldFound);
+    bool loadWorldItem(Mapping* itemNode, FilePathVariableProcessor* pathProcessor);
+    bool loadBodyItem(Mapping* data, FilePathVariableProcessor* pathProcessor);
+    void loadAISTSimulatorItem(Mapping* data);
+    bool initialize();
+};
+
+}
+
+
+HeadlessSimulator::HeadlessSimulator()
+{
+    impl = new Impl;
+}
+
+
+HeadlessSimulator::Impl::Impl()
+{
+    timeStep = 0.001;
+    timeLength = 0.0;
+    gravity << 0.0, 0.0, -DEFAULT_GRAVITY_ACCELERATION;
+    isRungeKuttaMethodEnabled = false;
+    numThreadsForIntegration = 1;
+    isInitialized = false;
+    os_ = &nullout();
+
+    ConstraintForceSolver& cfs = world.constraintForceSolver;
+    minFrictionCoefficient = cfs.minFrictionCoefficient();
+    maxFrictionCoefficient = cfs.maxFrictionCoefficient();
+    contactCullingDistance = cfs.contactCullingDistance();
+    contactCullingDepth = cfs.contactCullingDepth();
+    errorCriterion = cfs.gaussSeidelErrorCriterion();
+    maxNumIterations = cfs.gaussSeidelMaxNumIterations();
+    contactCorrectionDepth = cfs.contactCorrectionDepth();
+    contactCorrectionVelocityRatio = cfs.contactCorrectionVelocityRatio();
+    epsilon = cfs.coefficientOfRestitution();
+    isContactReductionEnabled = cfs.isContactReductionEnabled();
+    isGaussSeidelVectorizationEnabled = cfs.isGaussSeidelVectorizationEnabled();
+    isNNCGSolverEnabled = false;
+    is2Dmode = false;
+}
+
+
+HeadlessSimulator::~HeadlessSimulator()
+{
+    delete impl;
+}
+
+
+void HeadlessSimulator::setMessageOutput(std::ostream& os)
+{
+    impl->os_ = &os;
+}
+
+
+int HeadlessSimulator::addBody(Body* body, bool isCollisionDetectionEnabled, bool isSelfCollisionDetectionEnabled)
+{
+    DyBodyPtr dyBody = new DyBody;
+    CloneMap cloneMap;
+    cloneMap.setClone(body, dyBody);
+    dyBody->copyFrom(body, &cloneMap);
+    return impl->addBody(dyBody, isCollisionDetectionEnabled, isSelfCollisionDetectionEnabled);
+}
+
+
+int HeadlessSimulator::Impl::addBody
+(DyBody* body, bool isCollisionDetectionEnabled, bool isSelfCollisionDetectionEnabled)
+{
+    BodyInfo info;
+    info.body = body;
+    info.isCollisionDetectionEnabled = isCollisionDetectionEnabled;
+    info.isSelfCollisionDetectionEnabled = isSelfCollisionDetectionEnabled;
+    bodyInfos.push_back(info);
+    isInitialized = false;
+    return bodyInfos.size() - 1;
+}
+
+
+void HeadlessSimulator::clearBodies()
+{
+    impl->bodyInfos.clear();
+    impl->world.clearBodies();
+    impl->isInitialized = false;
+}
+
+
+int HeadlessSimulator::numBodies() const
+{
+    return impl->bodyInfos.size();
+}
+
+
+Body* HeadlessSimulator::body(int index)
+{
+    return impl->bodyInfos[index].body;
+}
+
+
+Body* HeadlessSimulator::body(const std::string& name)
+{
+    for(auto& info : impl->bodyInfos){
+        if(info.body->name() == name){
+            return info.body;
+        }
+    }
+    return nullptr;
+}
+
+
+void HeadlessSimulator::setTimeStep(double timeStep)
+{
+    impl->timeStep = timeStep;
+    impl->isInitialized = false;
+}
+
+
+double HeadlessSimulator::timeStep() const
+{
+    return impl->timeStep;
+}
+
+
+void HeadlessSimulator::setTimeLength(double length)
+{
+    impl->timeLength = length;
+}
+
+
+double HeadlessSimulator::timeLength() const
+{
+    return impl->timeLength;
+}
+
+
+void HeadlessSimulator::setGravity(const Vector3& g)
+{
+    impl->gravity = g;
+    impl->isInitialized = false;
+}
+
+
+void HeadlessSimulator::setMaterialTable(MaterialTable* table)
+{
+    impl->materialTable = table;
+    impl->isInitialized = false;
+}
+
+
+void HeadlessSimulator::setRungeKuttaMethodEnabled(bool on)
+{
+    impl->isRungeKuttaMethodEnabled = on;
+    impl->isInitialized = false;
+}
+
+
+void HeadlessSimulator::setNNCGSolverEnabled(bool on)
+{
+    impl->isNNCGSolverEnabled = on;
+    impl->isInitialized = false;
+}
+
+
+void HeadlessSimulator::setNumThreadsForIntegration(int n)
+{
+    impl->numThreadsForIntegration = n;
+    impl->isInitialized = false;
+}
+
+
+void HeadlessSimulator::addPreDynamicsFunction(std::function<void()> func)
+{
+    impl->preDynamicsFunctions.push_back(func);
+}
+
+
+void HeadlessSimulator::addPostDynamicsFunction(std::function<void()> func)
+{
+    impl->postDynamicsFunctions.push_back(func);
+}
+
+
+bool HeadlessSimulator::loadProject(const std::string& filename)
+{
+    return impl->loadProject(filename);
+}
+
+
+bool HeadlessSimulator::Impl::loadProject(const std::string& filename)
+{
+    YAMLReader reader;
+    if(!reader.load(filename)){
+        os() << reader.errorMessage() << endl;
+        return false;
+    }
+    if(reader.numDocuments() == 0){
+        os() << format(_("\"{}\" is empty."), filename) << endl;
+        return false;
+    }
+
+    auto projectDir = toUTF8(filesystem::absolute(fromUTF8(filename)).parent_path().string());
+    FilePathVariableProcessorPtr pathProcessor = new FilePathVariableProcessor;
+    pathProcessor->setSystemVariablesEnabled(true);
+    pathProcessor->setBaseDirectory(projectDir);
+    pathProcessor->setProjectDirectory(projectDir);
+
+    bool isWorldFound = false;
+    bool loaded = false;
+    try {
+        auto items = reader.document()->toMapping()->findMapping("items");
+        if(items->isValid()){
+            loaded = loadItems(items, pathProcessor, isWorldFound);
+        }
+    }
+    catch(const ValueNode::Exception& ex){
+        os() << ex.message() << endl;
+        return false;
+    }
+    if(!isWorldFound){
+        os() << format(_("\"{}\" does not contain a world item."), filename) << endl;
+        return false;
+    }
+
+    return loaded;
+}
+
+
+bool HeadlessSimulator::Impl::loadItems
+(Mapping* itemNode, FilePathVariableProcessor* pathProcessor, bool& io_isWorldFound)
+{
+    string className;
+    if(itemNode->read("class", className) && className == "WorldItem"){
+        if(io_isWorldFound){
+            os() << format(_("World item \"{}\" is ignored because only the first world item is simulated."),
+                           itemNode->get("name", "")) << endl;
+            return true;
+        }
+        io_isWorldFound = true;
+        return loadWorldItem(itemNode, pathProcessor);
+    }
+    auto children = itemNode->findListing("children");
+    if(children->isValid()){
+        for(auto& child : *children){
+            if(!loadItems(child->toMapping(), pathProcessor, io_isWorldFound)){
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+
+bool HeadlessSimulator::Impl::loadWorldItem(Mapping* worldItemNode, FilePathVariableProcessor* pathProcessor)
+{
+    auto worldData = worldItemNode->findMapping("data");
+
+    string materialTableFile = toUTF8((shareDirPath() / "default" / "materials.yaml").string());
+    string symbol;
+    if(worldData->read({ "default_material_table_file", "materialTableFile" }, symbol)){
+        symbol = pathProcessor->expand(symbol, true);
+        if(!symbol.empty()){
+            materialTableFile = symbol;
+        }
+    }
+    MaterialTablePtr table = new MaterialTable;
+    if(table->load(materialTableFile, os())){
+        materialTable = table;
+    }
+
+    bool isCollisionDetectionEnabled = worldData->get({ "collision_detection", "collisionDetection" }, false);
+    bool isAISTSimulatorItemFound = false;
+
+    auto children = worldItemNode->findListing("children");
+    if(children->isValid()){
+        for(auto& child : *children){
+            auto itemNode = child->toMapping();
+            auto data = itemNode->findMapping("data");
+            string className;
+            itemNode->read("class", className);
+            if(className == "BodyItem"){
+                if(data->isValid()){
+                    int index = bodyInfos.size();
+                    if(!loadBodyItem(data, pathProcessor)){
+                        return false;
+                    }
+                    if(!isCollisionDetectionEnabled){
+                        bodyInfos[index].isCollisionDetectionEnabled = false;
+                    }
+                }
+                if(itemNode->findListing("children")->isValid()){
+                    for(auto& grandChild : *itemNode->findListing("children")){
+                        string childClassName;
+                        if(grandChild->toMapping()->read("class", childClassName) && childClassName == "BodyItem"){
+                            os() << format(_("Body item \"{}\" attached to another body is not supported."),
+                                           grandChild->toMapping()->get("name", "")) << endl;
+                        }
+                    }
+                }
+            } else if(className == "AISTSimulatorItem"){
+                if(!isAISTSimulatorItemFound){
+                    if(data->isValid()){
+                        loadAISTSimulatorItem(data);
+                    }
+                    isAISTSimulatorItemFound = true;
+                }
+            } else if(className.find("SimulatorItem") != string::npos){
+                os() << format(_("{0} \"{1}\" is not supported and the AIST simulator is used instead."),
+                               className, itemNode->get("name", "")) << endl;
+            }
+        }
+    }
+    return true;
+}
+
+
+bool HeadlessSimulator::Impl::loadBodyItem(Mapping* data, FilePathVariableProcessor* pathProcessor)
+{
+    string filename;
+    if(!data->read({ "file", "modelFile" }, filename)){
+        return true;
+    }
+    filename = pathProcessor->expand(filename, true);
+    if(filename.empty()){
+        os() << pathProcessor->errorMessage() << endl;
+        return false;
+    }
+
+    DyBodyPtr body = new DyBody;
+    BodyLoader loader;
+    loader.setMessageSink(os());
+    if(!loader.load(body, filename)){
+        os() << format(_("\"{}\" cannot be loaded."), filename) << endl;
+        return false;
+    }
+
+    Vector3 p;
+    if(read(data, "rootPosition", p)){
+        body->rootLink()->p() = p;
+    }
+    Matrix3 R;
+    if(read(data, "rootAttitude", R)){
+        body->rootLink()->R() = R;
+    }
+    auto qs = data->findListing("jointDisplacements");
+    if(qs->isValid()){
+        int n = std::min(qs->size(), body->numAllJoints());
+        for(int i=0; i < n; ++i){
+            body->joint(i)->q() = radian((*qs)[i].toDouble());
+        }
+    } else {
+        qs = data->findListing("jointPositions");
+        if(qs->isValid()){
+            int n = std::min(qs->size(), body->numAllJoints());
+            for(int i=0; i < n; ++i){
+                body->joint(i)->q() = (*qs)[i].toDouble();
+            }
+        }
+    }
+    body->calcForwardKinematics();
+
+    bool isStatic;
+    if(data->read("staticModel", isStatic) && isStatic){
+        body->rootLink()->setJointType(Link::FixedJoint);
+        body->updateLinkTree();
+    }
+
+    addBody(body,
+            data->get("collisionDetection", true),
+            data->get("selfCollisionDetection", false));
+
+    return true;
+}
+
+
+void HeadlessSimulator::Impl::loadAISTSimulatorItem(Mapping* data)
+{
+    string symbol;
+    if(data->read({ "timeStep", "timestep" }, symbol)){
+        timeStep = std::stod(symbol);
+    } else {
+        double frameRate;
+        if(data->read({ "frameRate", "framerate" }, frameRate) && frameRate > 0.0){
+            timeStep = 1.0 / frameRate;
+        }
+    }
+    if(data->read("timeRangeMode", symbol) && symbol == "Specified time"){
+        data->read("timeLength", timeLength);
+    }
+    if(data->read("integrationMode", symbol)){
+        isRungeKuttaMethodEnabled = (symbol == "Runge Kutta");
+    }
+    if(data->read("constraintSolver", symbol)){
+        isNNCGSolverEnabled = (symbol == "NNCG");
+    }
+    read(data, "gravity", gravity);
+    data->read("min_friction_coefficient", minFrictionCoefficient);
+    data->read("max_friction_coefficient", maxFrictionCoefficient);
+    data->read("cullingThresh", contactCullingDistance);
+    data->read("contactCullingDepth", contactCullingDepth);
+    data->read("contactReduction", isContactReductionEnabled);
+    data->read("errorCriterion", errorCriterion);
+    data->read("maxNumIterations", maxNumIterations);
+    data->read("vectorizedSolver", isGaussSeidelVectorizationEnabled);
+    data->read("contactCorrectionDepth", contactCorrectionDepth);
+    data->read("contactCorrectionVelocityRatio", contactCorrectionVelocityRatio);
+    data->read("2Dmode", is2Dmode);
+    data->read("numThreadsForIntegration", numThreadsForIntegration);
+}
+
+
+bool HeadlessSimulator::initialize()
+{
+    return impl->initialize();
+}
+
+
+bool HeadlessSimulator::Impl::initialize()
+{
+    if(isRungeKuttaMethodEnabled){
+        world.setRungeKuttaMethod();
+    } else {
+        world.setEulerMethod();
+    }
+    world.setGravityAcceleration(gravity);
+    world.enableSensors(true);
+    world.setTimeStep(timeStep);
+    world.setCurrentTime(0.0);
+    world.setNumThreadsForIntegration(numThreadsForIntegration);
+
+    ConstraintForceSolver& cfs = world.constraintForceSolver;
+    if(!materialTable){
+        materialTable = new MaterialTable;
+        materialTable->load(toUTF8((shareDirPath() / "default" / "materials.yaml").string()), os());
+    }
+    cfs.setMaterialTable(materialTable);
+    cfs.setMCPSolverType(
+        isNNCGSolverEnabled ? ConstraintForceSolver::NNCG_SOLVER : ConstraintForceSolver::GAUSS_SEIDEL_SOLVER);
+    cfs.setGaussSeidelErrorCriterion(errorCriterion);
+    cfs.setGaussSeidelMaxNumIterations(maxNumIterations);
+    cfs.setGaussSeidelVectorizationEnabled(isGaussSeidelVectorizationEnabled);
+    cfs.setContactDepthCorrection(contactCorrectionDepth, contactCorrectionVelocityRatio);
+
+    world.clearBodies();
+    for(auto& info : bodyInfos){
+        int bodyIndex = world.addBody(info.body);
+        cfs.setBodyCollisionDetectionMode(
+            bodyIndex, info.isCollisionDetectionEnabled, info.isSelfCollisionDetectionEnabled);
+    }
+
+    cfs.setFrictionCoefficientRange(minFrictionCoefficient, maxFrictionCoefficient);
+    cfs.setContactCullingDistance(contactCullingDistance);
+    cfs.setContactCullingDepth(contactCullingDepth);
+    cfs.setContactReductionEnabled(isContactReductionEnabled);
+    cfs.setCoefficientOfRestitution(epsilon);
+    cfs.setCollisionDetector(new AISTCollisionDetector);
+    cfs.set2Dmode(is2Dmode);
+
+    world.initialize();
+    isInitialized = true;
+
+    return true;
+}
+
+
+void HeadlessSimulator::stepSimulation()
+{
+    for(auto& func : impl->preDynamicsFunctions){
+        func();
+    }
+    impl->world.calcNextState();
+    impl->world.constraintForceSolver.clearExternalForces();
+    for(auto& func : impl->postDynamicsFunctions){
+        func();
+    }
+}
+
+
+double HeadlessSimulator::currentTime() const
+{
+    return impl->world.currentTime();
+}
+
+
+ConstraintForceSolver* HeadlessSimulator::constraintForceSolver()
+{
+    return &impl->world.constraintForceSolver;
+}
+
+
+bool HeadlessSimulator::simulate(double timeLength)
+{
+    if(timeLength <= 0.0){
+        timeLength = impl->timeLength;
+        if(timeLength <= 0.0){
+            impl->os() << _("The time length of the simulation is not specified.") << endl;
+            return false;
+        }
+    }
+    if(!impl->isInitialized){
+        if(!initialize()){
+            return false;
+        }
+    }
+    // The half of the time step absorbs the accumulated rounding error of the current time
+    const double endTime = currentTime() + timeLength - impl->timeStep / 2.0;
+    while(currentTime() < endTime){
+        stepSimulation();
+    }
+    return true;
+}
@@ -0,0 +1,82 @@
+#ifndef CNOID_BODY_HEADLESS_SIMULATOR_H
+#define CNOID_BODY_HEADLESS_SIMULATOR_H
+
+#include <cnoid/EigenTypes>
+#include <string>
+#include <functional>
+#include <iosfwd>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+class Body;
+class MaterialTable;
+class ConstraintForceSolver;
+
+/**
+   This class runs the simulation of the AIST physics engine without the GUI modules.
+   The world can be constructed from the bodies added by the addBody function or loaded from
+   the world item, the body items and the AIST simulator item of a project file. Controller
+   items and the items of the other plugins in the project are not supported, and the
+   bodies can be controlled by the functions added by addPreDynamicsFunction.
+*/
+class CNOID_EXPORT HeadlessSimulator
+{
+public:
+    HeadlessSimulator();
+    ~HeadlessSimulator();
+
+    void setMessageOutput(std::ostream& os);
+
+    /**
+       The bodies and the simulation settings of the first world item in the project are loaded.
+       \note The current states of the body items are used as the initial states.
+    */
+    bool loadProject(const std::string& filename);
+
+    //! \return The index of the body. The body is copied and the copy is simulated.
+    int addBody(Body* body, bool isCollisionDetectionEnabled = true, bool isSelfCollisionDetectionEnabled = false);
+    void clearBodies();
+    int numBodies() const;
+    Body* body(int index);
+    Body* body(const std::string& name);
+
+    void setTimeStep(double timeStep);
+    double timeStep() const;
+
+    //! Zero means that the time length is not specified.
+    void setTimeLength(double length);
+    double timeLength() const;
+
+    void setGravity(const Vector3& g);
+    void setMaterialTable(MaterialTable* table);
+    void setRungeKuttaMethodEnabled(bool on);
+    void setNNCGSolverEnabled(bool on);
+    void setNumThreadsForIntegration(int n);
+
+    void addPreDynamicsFunction(std::function<void()> func);
+    void addPostDynamicsFunction(std::function<void()> func);
+
+    bool initialize();
+    void stepSimulation();
+    double currentTime() const;
+
+    //! The solver can be used to get the statistics of the last step.
+    ConstraintForceSolver* constraintForceSolver();
+
+    /**
+       The simulation is initialized if it has not been initialized and is stepped until the
+       current time reaches the time length.
+       \param timeLength The time length specified by setTimeLength or the project is used if
+       this is zero.
+    */
+    bool simulate(double timeLength = 0.0);
+
+private:
+    class Impl;
+    Impl* impl;
+};
+
+}
+
+#endif
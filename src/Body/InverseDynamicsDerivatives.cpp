@@ -0,0 +1,359 @@
+#include "InverseDynamicsDerivatives.h"
+#include "Body.h"
+#include "Link.h"
+#include <cnoid/EigenUtil>
+#include <cnoid/ThreadPool>
+#include <atomic>
+#include <memory>
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+typedef Eigen::Matrix<double, 6, 6> Matrix6;
+
+/**
+   The spatial vectors are expressed in the world frame at the world origin in the same way
+   as calcInverseDynamics(). A motion vector consists of (vo, w) and a force vector consists
+   of (f, tau), where vo is the velocity of the point at the origin and tau is the moment
+   around the origin.
+*/
+struct LinkData
+{
+    Vector6 S; // joint axis
+    Vector6 v;
+    Vector6 a;
+
+    // The following values are accumulated in the subtree of the link
+    Vector6 F;    // force including the external force
+    Vector6 Fext; // external force
+    Vector6 h;    // momentum
+    Matrix6 I;    // inertia
+    Matrix6 B;    // inertia derivative by the velocity, (v x*) I - I (v x)
+
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+};
+
+typedef vector<LinkData, Eigen::aligned_allocator<LinkData>> LinkDataArray;
+
+//! m1 x m2
+inline Vector6 crossMotion(const Vector6& m1, const Vector6& m2)
+{
+    Vector6 m;
+    m.head<3>() = m1.tail<3>().cross(m2.head<3>()) + m1.head<3>().cross(m2.tail<3>());
+    m.tail<3>() = m1.tail<3>().cross(m2.tail<3>());
+    return m;
+}
+
+//! m x* f
+inline Vector6 crossForce(const Vector6& m, const Vector6& f)
+{
+    Vector6 fm;
+    fm.head<3>() = m.tail<3>().cross(f.head<3>());
+    fm.tail<3>() = m.head<3>().cross(f.head<3>()) + m.tail<3>().cross(f.tail<3>());
+    return fm;
+}
+
+Matrix6 crossMotionMatrix(const Vector6& m)
+{
+    Matrix6 X;
+    const Matrix3 w_hat = hat(Vector3(m.tail<3>()));
+    X.topLeftCorner<3, 3>() = w_hat;
+    X.topRightCorner<3, 3>() = hat(Vector3(m.head<3>()));
+    X.bottomLeftCorner<3, 3>().setZero();
+    X.bottomRightCorner<3, 3>() = w_hat;
+    return X;
+}
+
+void calcDerivatives
+(Body* body, LinkDataArray& data, MatrixXd& out_dtau_dq, MatrixXd& out_dtau_ddq, MatrixXd& out_dtau_dddq)
+{
+    const int nj = body->numJoints();
+    const int numLinks = body->numLinks();
+
+    out_dtau_dq.setZero(nj, nj);
+    out_dtau_ddq.setZero(nj, nj);
+    out_dtau_dddq.setZero(nj, nj);
+
+    data.resize(numLinks);
+
+    // Forward pass. The links are in the order of the depth-first traversal from the root link.
+    for(int i=0; i < numLinks; ++i){
+        Link* link = body->link(i);
+        LinkData& d = data[i];
+        d.v.head<3>() = link->v() - link->w().cross(link->p());
+        d.v.tail<3>() = link->w();
+        Link* parent = link->parent();
+        if(!parent){
+            d.S.setZero();
+            d.a.head<3>() = link->dv() - link->dw().cross(link->p()) - link->w().cross(link->v());
+            d.a.tail<3>() = link->dw();
+        } else {
+            switch(link->jointType()){
+            case Link::ROTATIONAL_JOINT:
+                d.S.tail<3>() = link->R() * link->a();
+                d.S.head<3>() = link->p().cross(Vector3(d.S.tail<3>()));
+                break;
+            case Link::SLIDE_JOINT:
+                d.S.head<3>() = link->R() * link->d();
+                d.S.tail<3>().setZero();
+                break;
+            case Link::FIXED_JOINT:
+            default:
+                d.S.setZero();
+                break;
+            }
+            const LinkData& pd = data[parent->index()];
+            d.a = pd.a + crossMotion(pd.v, d.S) * link->dq() + d.S * link->ddq();
+        }
+
+        const double m = link->m();
+        const Vector3 c = link->R() * link->c() + link->p();
+        const Matrix3 c_hat = hat(c);
+        d.I.topLeftCorner<3, 3>() = m * Matrix3::Identity();
+        d.I.topRightCorner<3, 3>() = -m * c_hat;
+        d.I.bottomLeftCorner<3, 3>() = m * c_hat;
+        d.I.bottomRightCorner<3, 3>().noalias() = link->R() * link->I() * link->R().transpose();
+        d.I.bottomRightCorner<3, 3>().noalias() += m * c_hat * c_hat.transpose();
+
+        const Matrix6 vx = crossMotionMatrix(d.v);
+        d.B.noalias() = -vx.transpose() * d.I;
+        d.B.noalias() -= d.I * vx;
+        d.h.noalias() = d.I * d.v;
+        d.Fext = link->F_ext();
+        d.F.noalias() = d.I * d.a;
+        d.F += crossForce(d.v, d.h) - d.Fext;
+    }
+
+    // Backward pass to accumulate the values of the subtrees
+    for(int i = numLinks - 1; i > 0; --i){
+        const LinkData& d = data[i];
+        LinkData& pd = data[body->link(i)->parent()->index()];
+        pd.F += d.F;
+        pd.Fext += d.Fext;
+        pd.h += d.h;
+        pd.I += d.I;
+        pd.B += d.B;
+    }
+
+    /*
+      For joint j and joint i in the subtree of j, the derivatives of the force F_i of the
+      subtree of i are
+        dF_i/dq_j   = S_j x* (F_i + Fext_i) - I_i c_j - B_i u_j - u_j x* h_i
+        dF_i/ddq_j  = -2 I_i u_j + B_i S_j + S_j x* h_i
+        dF_i/dddq_j = I_i S_j
+      where u_j = S_j x v_p, c_j = S_j x a_p - u_j x v_p and p is the parent link of j.
+      The derivatives of tau_i = S_i^T F_i are obtained by dS_i/dq_j = S_j x S_i, and the
+      derivatives of the torque of an ancestor k of j are S_k^T dF_j.
+    */
+    for(int i=1; i < numLinks; ++i){
+        Link* link = body->link(i);
+        const int id = link->jointId();
+        if(id < 0 || id >= nj){
+            continue;
+        }
+        const LinkData& d = data[i];
+        const Vector6 IS = d.I * d.S;
+        const Vector6 BtS = d.B.transpose() * d.S;
+        const LinkData& pd = data[link->parent()->index()];
+        const Vector6 u = crossMotion(d.S, pd.v);
+        const Vector6 cj = crossMotion(d.S, pd.a) - crossMotion(u, pd.v);
+        const Vector6 dF_dq = crossForce(d.S, d.F + d.Fext) - d.I * cj - d.B * u - crossForce(u, d.h);
+        const Vector6 dF_ddq = -2.0 * d.I * u + d.B * d.S + crossForce(d.S, d.h);
+
+        for(Link* joint = link; joint->parent(); joint = joint->parent()){
+            const int jid = joint->jointId();
+            if(jid < 0 || jid >= nj){
+                continue;
+            }
+            const LinkData& jd = data[joint->index()];
+            if(jid == id){
+                out_dtau_dq(id, id) = d.S.dot(dF_dq);
+                out_dtau_ddq(id, id) = d.S.dot(dF_ddq);
+                out_dtau_dddq(id, id) = d.S.dot(IS) + link->Jm2();
+            } else {
+                // torque of joint i by the variables of the ancestor joint j
+                const LinkData& jpd = data[joint->parent()->index()];
+                const Vector6 uj = crossMotion(jd.S, jpd.v);
+                const Vector6 cj = crossMotion(jd.S, jpd.a) - crossMotion(uj, jpd.v);
+                out_dtau_dq(id, jid) =
+                    -crossMotion(jd.S, d.S).dot(d.Fext) - IS.dot(cj) - BtS.dot(uj) + crossMotion(uj, d.S).dot(d.h);
+                out_dtau_ddq(id, jid) =
+                    -2.0 * IS.dot(uj) + BtS.dot(jd.S) - crossMotion(jd.S, d.S).dot(d.h);
+                out_dtau_dddq(id, jid) = IS.dot(jd.S);
+
+                // torque of the ancestor joint j by the variables of joint i
+                out_dtau_dq(jid, id) = jd.S.dot(dF_dq);
+                out_dtau_ddq(jid, id) = jd.S.dot(dF_ddq);
+                out_dtau_dddq(jid, id) = jd.S.dot(IS);
+            }
+        }
+    }
+}
+
+class Worker
+{
+public:
+    BodyPtr body;
+    LinkDataArray data;
+};
+
+}
+
+namespace cnoid {
+
+void calcInverseDynamicsDerivatives
+(Body* body, MatrixXd& out_dtau_dq, MatrixXd& out_dtau_ddq, MatrixXd& out_dtau_dddq)
+{
+    LinkDataArray data;
+    calcDerivatives(body, data, out_dtau_dq, out_dtau_ddq, out_dtau_dddq);
+}
+
+
+class BatchInverseDynamicsDerivatives::Impl
+{
+public:
+    BodyPtr body;
+    int numThreads;
+    unique_ptr<ThreadPool> threadPool;
+    vector<unique_ptr<Worker>> workers;
+    std::atomic<int> nextKnotIndex;
+
+    Impl();
+    void calcKnots(
+        Worker* worker, const MatrixXd& q, const MatrixXd& dq, const MatrixXd& ddq,
+        vector<MatrixXd>& out_dtau_dq, vector<MatrixXd>& out_dtau_ddq, vector<MatrixXd>& out_dtau_dddq);
+};
+
+}
+
+
+BatchInverseDynamicsDerivatives::BatchInverseDynamicsDerivatives()
+{
+    impl = new Impl;
+}
+
+
+BatchInverseDynamicsDerivatives::BatchInverseDynamicsDerivatives(Body* body)
+{
+    impl = new Impl;
+    setBody(body);
+}
+
+
+BatchInverseDynamicsDerivatives::Impl::Impl()
+{
+    numThreads = 0;
+}
+
+
+BatchInverseDynamicsDerivatives::~BatchInverseDynamicsDerivatives()
+{
+    delete impl;
+}
+
+
+void BatchInverseDynamicsDerivatives::setBody(Body* body)
+{
+    impl->body = body;
+    impl->workers.clear();
+}
+
+
+void BatchInverseDynamicsDerivatives::setNumThreads(int n)
+{
+    if(n < 0){
+        n = 0;
+    }
+    if(n != impl->numThreads){
+        impl->numThreads = n;
+        impl->threadPool.reset();
+        impl->workers.clear();
+    }
+}
+
+
+int BatchInverseDynamicsDerivatives::numThreads() const
+{
+    return impl->numThreads;
+}
+
+
+bool BatchInverseDynamicsDerivatives::calc
+(const MatrixXd& q, const MatrixXd& dq, const MatrixXd& ddq,
+ std::vector<MatrixXd>& out_dtau_dq, std::vector<MatrixXd>& out_dtau_ddq, std::vector<MatrixXd>& out_dtau_dddq)
+{
+    auto& body = impl->body;
+    if(!body){
+        return false;
+    }
+    const int nj = body->numJoints();
+    const int numKnots = q.rows();
+    if(q.cols() != nj || dq.rows() != numKnots || dq.cols() != nj || ddq.rows() != numKnots || ddq.cols() != nj){
+        return false;
+    }
+    out_dtau_dq.resize(numKnots);
+    out_dtau_ddq.resize(numKnots);
+    out_dtau_dddq.resize(numKnots);
+
+    const int numWorkers = std::max(impl->numThreads, 1);
+    if(impl->workers.empty()){
+        for(int i=0; i < numWorkers; ++i){
+            auto worker = new Worker;
+            worker->body = body->clone();
+            impl->workers.emplace_back(worker);
+        }
+    }
+    Link* rootLink = body->rootLink();
+    for(auto& worker : impl->workers){
+        Link* root = worker->body->rootLink();
+        root->setPosition(rootLink->position());
+        root->v() = rootLink->v();
+        root->w() = rootLink->w();
+        root->dv() = rootLink->dv();
+        root->dw() = rootLink->dw();
+    }
+
+    impl->nextKnotIndex = 0;
+    if(impl->numThreads == 0){
+        impl->calcKnots(impl->workers.front().get(), q, dq, ddq, out_dtau_dq, out_dtau_ddq, out_dtau_dddq);
+    } else {
+        if(!impl->threadPool){
+            impl->threadPool.reset(new ThreadPool(impl->numThreads));
+        }
+        for(auto& worker : impl->workers){
+            auto w = worker.get();
+            impl->threadPool->start([this, w, &q, &dq, &ddq, &out_dtau_dq, &out_dtau_ddq, &out_dtau_dddq](){
+                    impl->calcKnots(w, q, dq, ddq, out_dtau_dq, out_dtau_ddq, out_dtau_dddq); });
+        }
+        impl->threadPool->wait();
+    }
+
+    return true;
+}
+
+
+void BatchInverseDynamicsDerivatives::Impl::calcKnots
+(Worker* worker, const MatrixXd& q, const MatrixXd& dq, const MatrixXd& ddq,
+ vector<MatrixXd>& out_dtau_dq, vector<MatrixXd>& out_dtau_ddq, vector<MatrixXd>& out_dtau_dddq)
+{
+    Body* body = worker->body;
+    const int nj = body->numJoints();
+    const int numKnots = q.rows();
+
+    while(true){
+        const int index = nextKnotIndex.fetch_add(1);
+        if(index >= numKnots){
+            break;
+        }
+        for(int i=0; i < nj; ++i){
+            Link* joint = body->joint(i);
+            joint->q() = q(index, i);
+            joint->dq() = dq(index, i);
+            joint->ddq() = ddq(index, i);
+        }
+        body->calcForwardKinematics(true);
+        calcDerivatives(body, worker->data, out_dtau_dq[index], out_dtau_ddq[index], out_dtau_dddq[index]);
+    }
+}
@@ -0,0 +1,61 @@
+#ifndef CNOID_BODY_INVERSE_DYNAMICS_DERIVATIVES_H
+#define CNOID_BODY_INVERSE_DYNAMICS_DERIVATIVES_H
+
+#include <cnoid/EigenTypes>
+#include <vector>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+class Body;
+
+/**
+   Calculates the partial derivatives of the joint torques given by calcInverseDynamics()
+   with respect to the joint displacements, velocities and accelerations by the analytical
+   differentiation of the recursive Newton-Euler algorithm.
+   The state of the body is used in the same way as calcInverseDynamics(), so the link
+   velocities must be updated by the forward kinematics. The motion of the root link and
+   the external forces are constant in the differentiation.
+   The (i, j) element of each matrix is the derivative of the torque of the i-th joint
+   with respect to the variable of the j-th joint.
+*/
+CNOID_EXPORT void calcInverseDynamicsDerivatives(
+    Body* body, MatrixXd& out_dtau_dq, MatrixXd& out_dtau_ddq, MatrixXd& out_dtau_dddq);
+
+/**
+   This class evaluates the derivatives of the inverse dynamics at the knots of a trajectory.
+   The knots are divided among the threads, each of which has its own clone of the body.
+   The position, velocity and acceleration of the root link are the ones of the original
+   body at the time of the calc() call.
+*/
+class CNOID_EXPORT BatchInverseDynamicsDerivatives
+{
+public:
+    BatchInverseDynamicsDerivatives();
+    BatchInverseDynamicsDerivatives(Body* body);
+    ~BatchInverseDynamicsDerivatives();
+
+    void setBody(Body* body);
+
+    //! Zero means the main thread only, which is the default.
+    void setNumThreads(int n);
+    int numThreads() const;
+
+    /**
+       \param q, dq, ddq The i-th row is the joint displacements, velocities and accelerations
+       of the i-th knot.
+       \return false when the sizes of the arguments do not match the body.
+    */
+    bool calc(const MatrixXd& q, const MatrixXd& dq, const MatrixXd& ddq,
+              std::vector<MatrixXd>& out_dtau_dq,
+              std::vector<MatrixXd>& out_dtau_ddq,
+              std::vector<MatrixXd>& out_dtau_dddq);
+
+private:
+    class Impl;
+    Impl* impl;
+};
+
+}
+
+#endif
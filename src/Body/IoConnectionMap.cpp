@@ -4,6 +4,7 @@
 #include <cnoid/CloneMap>
 #include <cnoid/ValueTree>
 #include <fmt/format.h>
+#include <unordered_map>
 #include <algorithm>
 #include "gettext.h"
 
@@ -211,6 +212,7 @@ void IoConnectionMap::remove(DigitalIoConnection* connection)
 
 void IoConnectionMap::establishConnections()
 {
+    routingSources.clear();
     for(auto& connection : connections_){
         connection->establishConnection();
     }
@@ -222,6 +224,85 @@ void IoConnectionMap::releaseConnections()
     for(auto& connection : connections_){
         connection->releaseConnection();
     }
+    routingSources.clear();
+}
+
+
+void IoConnectionMap::compileRoutingTable()
+{
+    releaseConnections();
+
+    // The sources are ordered by the first appearances of the output devices in the connections
+    unordered_map<DigitalIoDevice*, int> sourceIndexMap;
+    vector<vector<pair<int, SignalRoute>>> sourceRoutes;
+
+    for(auto& connection : connections_){
+        if(!connection->hasDeviceInstances()){
+            continue;
+        }
+        auto outDevice = connection->outDevice();
+        auto inDevice = connection->inDevice();
+        int outIndex = connection->outSignalIndex();
+        int inIndex = connection->inSignalIndex();
+        if(outIndex < 0 || outIndex >= outDevice->numSignalLines() ||
+           inIndex < 0 || inIndex >= inDevice->numSignalLines()){
+            continue;
+        }
+        auto inserted = sourceIndexMap.emplace(outDevice, routingSources.size());
+        if(inserted.second){
+            routingSources.emplace_back();
+            routingSources.back().outDevice = outDevice;
+            sourceRoutes.emplace_back();
+        }
+        sourceRoutes[inserted.first->second].emplace_back(outIndex, SignalRoute{ inDevice, inIndex });
+    }
+
+    for(size_t i=0; i < routingSources.size(); ++i){
+        auto& source = routingSources[i];
+        auto& routes = sourceRoutes[i];
+        std::stable_sort(
+            routes.begin(), routes.end(),
+            [](const pair<int, SignalRoute>& r1, const pair<int, SignalRoute>& r2){
+                return r1.first < r2.first; });
+        for(auto& route : routes){
+            if(source.outIndices.empty() || source.outIndices.back() != route.first){
+                source.outIndices.push_back(route.first);
+                source.routeOffsets.push_back(source.routes.size());
+            }
+            source.routes.push_back(route.second);
+        }
+        source.routeOffsets.push_back(source.routes.size());
+
+        const int numSignals = source.outIndices.size();
+        source.lastStates.assign((numSignals + 63) / 64, 0);
+        for(int j=0; j < numSignals; ++j){
+            if(source.outDevice->out(source.outIndices[j])){
+                source.lastStates[j / 64] |= (uint64_t(1) << (j % 64));
+            }
+        }
+    }
+}
+
+
+void IoConnectionMap::updateSignals()
+{
+    for(auto& source : routingSources){
+        auto outDevice = source.outDevice;
+        const int numSignals = source.outIndices.size();
+        for(int j=0; j < numSignals; ++j){
+            uint64_t& states = source.lastStates[j / 64];
+            const uint64_t bit = uint64_t(1) << (j % 64);
+            const bool on = outDevice->out(source.outIndices[j]);
+            if(on != ((states & bit) != 0)){
+                states ^= bit;
+                const int end = source.routeOffsets[j + 1];
+                for(int k = source.routeOffsets[j]; k < end; ++k){
+                    auto& route = source.routes[k];
+                    route.inDevice->setIn(route.inIndex, on, true);
+                }
+            }
+        }
+    }
 }
 
 
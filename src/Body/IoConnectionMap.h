@@ -4,6 +4,7 @@
 #include <cnoid/ClonableReferenced>
 #include <cnoid/Signal>
 #include <string>
+#include <cstdint>
 #include <vector>
 #include "exportdecl.h"
 
@@ -113,6 +114,18 @@ public:
     void establishConnections();
     void releaseConnections();
 
+    /**
+       This function compiles the connections with the device instances into a routing table,
+       which is used instead of the signals of the devices established by establishConnections().
+       The signals are propagated by updateSignals(), which should be called once per simulation
+       step. The current output states are the initial states of the propagation.
+    */
+    void compileRoutingTable();
+    bool hasRoutingTable() const { return !routingSources.empty(); }
+
+    //! Propagate the output signals changed since the last call to the connected input signals
+    void updateSignals();
+
     bool read(const Mapping& archive);
     bool write(Mapping& archive) const;
 
@@ -122,6 +135,27 @@ protected:
 
 private:
     std::vector<DigitalIoConnectionPtr> connections_;
+
+    struct SignalRoute
+    {
+        DigitalIoDevice* inDevice;
+        int inIndex;
+    };
+
+    /*
+      The routes from the signals of an output device. The routes of the j-th signal of outIndices
+      are routes[routeOffsets[j]] to routes[routeOffsets[j + 1] - 1], and its last state is the
+      j-th bit of lastStates.
+    */
+    struct RoutingSource
+    {
+        DigitalIoDevice* outDevice;
+        std::vector<int> outIndices;
+        std::vector<int> routeOffsets;
+        std::vector<SignalRoute> routes;
+        std::vector<uint64_t> lastStates;
+    };
+    std::vector<RoutingSource> routingSources;
 };
 
 typedef ref_ptr<IoConnectionMap> IoConnectionMapPtr;
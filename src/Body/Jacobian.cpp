@@ -2,6 +2,7 @@
 #include "Jacobian.h"
 #include "Link.h"
 #include "JointPath.h"
+#include <cnoid/EigenUtil>
 #include <iostream>
 
 using namespace std;
@@ -230,4 +231,261 @@ void calcAngularMomentumJacobian(Body* body, Link* base, Eigen::MatrixXd& H)
     
 }
 
+
+class CMJacobianCalculator::Impl
+{
+public:
+    // The inertia is around the world origin so that the values can be summed up and subtracted
+    struct SubMass
+    {
+        double m;
+        Vector3 mwc;
+        Matrix3 Io;
+    };
+
+    BodyPtr body;
+    Link* base;
+    vector<SubMass> subMasses;
+    vector<char> isOnBasePath;
+    vector<char> isDirty;
+    vector<char> isCMJacobianColumnDirty;
+    vector<double> prevJointDisplacements;
+    Vector3 prev_p_root;
+    Matrix3 prev_R_root;
+    bool isValid;
+    bool isCMJacobianValid;
+    Matrix3X J;
+    Matrix3X H;
+
+    Impl(Body* body, Link* base);
+    void setBaseLink(Link* base);
+    void updateSubMasses();
+    void getMovingPart(Link* joint, double& out_m, Vector3& out_mwc, Matrix3& out_Io, double& out_sign) const;
+    const Matrix3X& calcCMJacobian();
+    const Matrix3X& calcAngularMomentumJacobian();
+};
+
+}
+
+
+CMJacobianCalculator::CMJacobianCalculator(Body* body, Link* base)
+{
+    impl = new Impl(body, base);
+}
+
+
+CMJacobianCalculator::Impl::Impl(Body* body, Link* base)
+    : body(body)
+{
+    const int n = body->numLinks();
+    subMasses.resize(n);
+    isOnBasePath.resize(n);
+    isDirty.resize(n);
+    isCMJacobianColumnDirty.resize(n);
+    prevJointDisplacements.resize(n);
+    setBaseLink(base);
+}
+
+
+CMJacobianCalculator::~CMJacobianCalculator()
+{
+    delete impl;
+}
+
+
+void CMJacobianCalculator::setBaseLink(Link* base)
+{
+    impl->setBaseLink(base);
+}
+
+
+void CMJacobianCalculator::Impl::setBaseLink(Link* base)
+{
+    this->base = base;
+    std::fill(isOnBasePath.begin(), isOnBasePath.end(), false);
+    for(Link* link = base; link && link->parent(); link = link->parent()){
+        isOnBasePath[link->index()] = true;
+    }
+    const int nj = body->numJoints();
+    const int numCols = base ? nj : nj + 6;
+    J.resize(3, numCols);
+    H.resize(3, numCols);
+    isValid = false;
+}
+
+
+void CMJacobianCalculator::invalidate()
+{
+    impl->isValid = false;
+}
+
+
+/**
+   The links are marked dirty when they are moved by the joints whose displacements have been
+   changed, and then their ancestors are also marked. The links are in the order of the
+   depth-first traversal, so the sub masses of the dirty links can be updated in the reverse order.
+*/
+void CMJacobianCalculator::Impl::updateSubMasses()
+{
+    const int n = body->numLinks();
+    Link* rootLink = body->rootLink();
+
+    if(!isValid || rootLink->p() != prev_p_root || rootLink->R() != prev_R_root){
+        std::fill(isDirty.begin(), isDirty.end(), true);
+        isCMJacobianValid = false;
+        isValid = true;
+    } else {
+        isDirty[0] = false;
+        for(int i=1; i < n; ++i){
+            Link* link = body->link(i);
+            isDirty[i] = isDirty[link->parent()->index()] || (link->q() != prevJointDisplacements[i]);
+        }
+    }
+    prev_p_root = rootLink->p();
+    prev_R_root = rootLink->R();
+
+    for(int i = n - 1; i >= 0; --i){
+        if(!isDirty[i]){
+            continue;
+        }
+        Link* link = body->link(i);
+        prevJointDisplacements[i] = link->q();
+        isCMJacobianColumnDirty[i] = true;
+
+        SubMass& sub = subMasses[i];
+        const Matrix3& R = link->R();
+        sub.m = link->m();
+        sub.mwc = link->m() * link->wc();
+        sub.Io = R * link->I() * R.transpose() + link->m() * D(link->wc());
+        for(Link* child = link->child(); child; child = child->sibling()){
+            const SubMass& childSub = subMasses[child->index()];
+            sub.m += childSub.m;
+            sub.mwc += childSub.mwc;
+            sub.Io += childSub.Io;
+        }
+        if(Link* parent = link->parent()){
+            isDirty[parent->index()] = true;
+        }
+    }
+}
+
+
+/**
+   The moving part of a joint on the path from the root link to the base link is the
+   complement of the subtree of the joint.
+*/
+void CMJacobianCalculator::Impl::getMovingPart
+(Link* joint, double& out_m, Vector3& out_mwc, Matrix3& out_Io, double& out_sign) const
+{
+    const SubMass& sub = subMasses[joint->index()];
+    if(isOnBasePath[joint->index()]){
+        const SubMass& total = subMasses[0];
+        out_m = total.m - sub.m;
+        out_mwc = total.mwc - sub.mwc;
+        out_Io = total.Io - sub.Io;
+        out_sign = -1.0;
+    } else {
+        out_m = sub.m;
+        out_mwc = sub.mwc;
+        out_Io = sub.Io;
+        out_sign = 1.0;
+    }
+}
+
+
+const CMJacobianCalculator::Matrix3X& CMJacobianCalculator::calcCMJacobian()
+{
+    return impl->calcCMJacobian();
+}
+
+
+const CMJacobianCalculator::Matrix3X& CMJacobianCalculator::Impl::calcCMJacobian()
+{
+    updateSubMasses();
+
+    // The columns of the joints on the base path depend on the whole body
+    const bool updateAll = !isCMJacobianValid || base;
+    const double totalMass = subMasses[0].m;
+    const int nj = body->numJoints();
+    double m, sign;
+    Vector3 mwc;
+    Matrix3 Io;
+    
+    for(int i=0; i < nj; ++i){
+        Link* joint = body->joint(i);
+        const int index = joint->index();
+        if(!updateAll && !isCMJacobianColumnDirty[index]){
+            continue;
+        }
+        isCMJacobianColumnDirty[index] = false;
+        getMovingPart(joint, m, mwc, Io, sign);
+        if(joint->isRotationalJoint()){
+            const Vector3 omega = sign * joint->R() * joint->a();
+            J.col(i) = omega.cross(mwc - m * joint->p()) / totalMass;
+        } else if(joint->isSlideJoint()){
+            J.col(i) = (sign * m / totalMass) * (joint->R() * joint->d());
+        } else {
+            J.col(i).setZero();
+        }
+    }
+    isCMJacobianValid = true;
+
+    if(!base){
+        const Vector3 dp = subMasses[0].mwc / totalMass - body->rootLink()->p();
+        J.block<3, 3>(0, nj).setIdentity();
+        J.block<3, 3>(0, nj + 3) = -hat(dp);
+    }
+
+    return J;
+}
+
+
+const CMJacobianCalculator::Matrix3X& CMJacobianCalculator::calcAngularMomentumJacobian()
+{
+    return impl->calcAngularMomentumJacobian();
+}
+
+
+/**
+   The angular momentum is around the center of mass when the base link is not specified,
+   and it is around the world origin otherwise as calcAngularMomentumJacobian().
+*/
+const CMJacobianCalculator::Matrix3X& CMJacobianCalculator::Impl::calcAngularMomentumJacobian()
+{
+    updateSubMasses();
+
+    const SubMass& total = subMasses[0];
+    const Vector3 cm = total.mwc / total.m;
+    const int nj = body->numJoints();
+    double m, sign;
+    Vector3 mwc;
+    Matrix3 Io;
+
+    for(int i=0; i < nj; ++i){
+        Link* joint = body->joint(i);
+        getMovingPart(joint, m, mwc, Io, sign);
+        Vector3 P; // momentum
+        if(joint->isRotationalJoint()){
+            const Vector3 omega = sign * joint->R() * joint->a();
+            P = omega.cross(mwc - m * joint->p());
+            H.col(i) = Io * omega - mwc.cross(omega.cross(joint->p()));
+        } else if(joint->isSlideJoint()){
+            const Vector3 v = sign * joint->R() * joint->d();
+            P = m * v;
+            H.col(i) = mwc.cross(v);
+        } else {
+            P.setZero();
+            H.col(i).setZero();
+        }
+        if(!base){
+            H.col(i) -= cm.cross(P);
+        }
+    }
+
+    if(!base){
+        H.block<3, 3>(0, nj).setZero();
+        H.block<3, 3>(0, nj + 3) = total.Io - total.m * D(cm);
+    }
+
+    return H;
 }
@@ -13,6 +13,34 @@ CNOID_EXPORT void calcCMJacobian(Body* body, Link* base, Eigen::MatrixXd& J);
 
 CNOID_EXPORT void calcAngularMomentumJacobian(Body* body, Link* base, Eigen::MatrixXd& H);
 
+/**
+   This class calculates the matrices of calcCMJacobian() and calcAngularMomentumJacobian()
+   with a workspace bound to a body. The mass properties of the subtrees are only updated
+   for the links moved by the joints whose displacements have been changed since the previous
+   calculation, and the matrices are stored in the preallocated storage.
+   \note Link::wc must be computed by calcCM() before calling the calculation functions.
+   invalidate() must be called when the mass parameters of the body have been changed.
+*/
+class CNOID_EXPORT CMJacobianCalculator
+{
+public:
+    typedef Eigen::Matrix<double, 3, Eigen::Dynamic> Matrix3X;
+
+    CMJacobianCalculator(Body* body, Link* base = nullptr);
+    ~CMJacobianCalculator();
+
+    //! \param base link fixed to the environment
+    void setBaseLink(Link* base);
+    void invalidate();
+
+    const Matrix3X& calcCMJacobian();
+    const Matrix3X& calcAngularMomentumJacobian();
+
+private:
+    class Impl;
+    Impl* impl;
+};
+
 template<int elementMask, int rowOffset, int colOffset, bool useTargetLinkLocalPos>
 void setJacobian(const JointPath& path, Link* targetLink, const Vector3& targetLinkLocalPos,
                  MatrixXd& out_J) {
@@ -8,8 +8,13 @@
 #include "Body.h"
 #include "CustomJointPathHandler.h"
 #include "BodyCustomizerInterface.h"
+#include "BodyCollisionDetector.h"
 #include <cnoid/EigenUtil>
 #include <cnoid/TruncatedSVD>
+#include <vector>
+#include <map>
+#include <memory>
+#include <typeinfo>
 
 using namespace std;
 using namespace cnoid;
@@ -41,8 +46,111 @@ double JointPath::numericalIkDefaultTruncateRatio()
     return TruncatedSVD<MatrixXd>::defaultTruncateRatio();
 }
 
+namespace {
+
+typedef CollisionDetector::GeometryHandle GeometryHandle;
+typedef CollisionDetectorDistanceAPI::DistanceQuery DistanceQuery;
+
+/*
+  The damping added to the least squares with the collision avoidance constraints so that
+  the displacements in the null space of the task, which are only limited by the damping
+  in the usual least squares, do not diverge to satisfy the constraints.
+*/
+constexpr double CollisionAvoidanceDampingSqr = 1.0e-4;
+
+/*
+  The maximum joint displacement of an iteration with the constraints, which prevents
+  the constraint of a pair with a small gradient from causing a large step.
+*/
+constexpr double MaxCollisionAvoidanceJointStep = 1.0;
+
+// The step of an iteration is halved when it causes a new contact
+constexpr int MaxNumCollisionAvoidanceStepHalvings = 4;
+
+const char* JointPathCacheName = "JointPathCache";
+
+/*
+  The paths in the cache are only used as the sources of the link and joint lists and are never
+  given to the callers. The null path is stored for a pair whose path has the custom IK.
+*/
+class JointPathCache : public Referenced
+{
+public:
+    int linkTreeRevision;
+    std::map<std::pair<Link*, Link*>, shared_ptr<const JointPath>> paths;
+
+    JointPathCache() : linkTreeRevision(-1) { }
+};
+
+}
+
 namespace cnoid {
 
+/**
+   The distance constraints of the collision avoidance mode of the numerical IK.
+   The distance queries of the link pairs are kept and detected again at each iteration.
+*/
+class JointPathCollisionAvoidance
+{
+public:
+    struct LinkInfo
+    {
+        LinkPtr link;
+        GeometryHandle geometry;
+        // The index of the link of the path which the link moves together with
+        int pathLinkIndex;
+        Isometry3 T_offset;
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+    };
+
+    BodyCollisionDetector* bodyCollisionDetector;
+    CollisionDetector* collisionDetector;
+    CollisionDetectorDistanceAPI* distanceAPI;
+    double margin;
+    double activationDistance;
+    vector<LinkInfo, Eigen::aligned_allocator<LinkInfo>> links;
+    vector<std::pair<int, int>> linkPairs;
+    vector<DistanceQuery> queries;
+    vector<double> prevDistances;
+    vector<Vector3> normals;
+    vector<bool> normalValidities;
+    // The index of the first link of the path moved by each joint
+    vector<int> jointMotionBeginIndices;
+    bool isPathInfoValid;
+
+    // The constraints G dq >= h of the active pairs
+    MatrixXd G;
+    VectorXd h;
+    int numConstraints;
+
+    // The workspace of the constrained least squares
+    MatrixXd H;
+    VectorXd dq0;
+    MatrixXd Y;
+    Eigen::LLT<MatrixXd> llt;
+    vector<int> activeSet;
+    vector<bool> activeFlags;
+    MatrixXd S;
+    VectorXd r;
+    VectorXd mu;
+
+    JointPathCollisionAvoidance(
+        BodyCollisionDetector* detector, CollisionDetectorDistanceAPI* distanceAPI,
+        double margin, double activationDistance);
+    int findOrAddLink(Link* link);
+    void initializePathInfo(const JointPath& path);
+    void prepare(const JointPath& path);
+    Isometry3 geometryPosition(const JointPath& path, const LinkInfo& info) const;
+    void detectDistances(const JointPath& path);
+    bool isCollisionFree() const;
+    bool hasNewContact() const;
+    Vector3 calcPointVelocity(
+        const JointPath& path, int jointIndex, int pathLinkIndex, const Vector3& point) const;
+    int setConstraints(const JointPath& path, double deltaScale);
+    void solveConstrainedLeastSquares(
+        const MatrixXd& J, const VectorXd& dTask, double dampingConstantSqr, VectorXd& out_dq);
+};
+
 class NumericalIK
 {
 public:
@@ -60,10 +168,18 @@ public:
     VectorXd dTask;
     VectorXd dq;
     MatrixXd JJ;
+    VectorXd y;
+    Eigen::LDLT<MatrixXd> ldlt;
+    // The fixed-size workspace for the usual six-dimensional task
+    typedef Eigen::Matrix<double, 6, 6> Matrix6;
+    Matrix6 JJ6;
+    Vector6 y6;
+    Eigen::LDLT<Matrix6> ldlt6;
     Eigen::ColPivHouseholderQR<MatrixXd> QR;
     TruncatedSVD<MatrixXd> svd;
     std::function<double(VectorXd& out_error)> errorFunc;
     std::function<void(MatrixXd& out_Jacobian)> jacobianFunc;
+    unique_ptr<JointPathCollisionAvoidance> collisionAvoidance;
 
     NumericalIK() {
         deltaScale = JointPath::numericalIkDefaultDeltaScale();
@@ -81,6 +197,8 @@ public:
         J.resize(dTask.size(), numJoints);
         dq.resize(numJoints);
     }
+
+    void solveDampedLeastSquares();
 };
 
 }
@@ -110,6 +228,15 @@ JointPath::JointPath(Link* end)
 }
 
 
+JointPath::JointPath(const LinkPath& linkPath, const std::vector<LinkPtr>& joints, int numUpwardJointConnections)
+    : linkPath_(linkPath),
+      joints_(joints),
+      numUpwardJointConnections(numUpwardJointConnections)
+{
+    initialize();
+}
+
+
 void JointPath::initialize()
 {
     needForwardKinematicsBeforeIK = false;
@@ -288,6 +415,54 @@ void JointPath::customizeTarget
 }
 
 
+bool JointPath::setCollisionAvoidance
+(BodyCollisionDetector* detector, double margin, double activationDistance)
+{
+    auto distanceAPI = dynamic_cast<CollisionDetectorDistanceAPI*>(detector->collisionDetector());
+    if(!distanceAPI){
+        return false;
+    }
+    getOrCreateNumericalIK()->collisionAvoidance.reset(
+        new JointPathCollisionAvoidance(detector, distanceAPI, margin, activationDistance));
+    return true;
+}
+
+
+bool JointPath::addCollisionAvoidanceLinkPair(Link* link1, Link* link2)
+{
+    auto collisionAvoidance = numericalIK ? numericalIK->collisionAvoidance.get() : nullptr;
+    if(!collisionAvoidance){
+        return false;
+    }
+    int index1 = collisionAvoidance->findOrAddLink(link1);
+    int index2 = collisionAvoidance->findOrAddLink(link2);
+    if(index1 < 0 || index2 < 0){
+        return false;
+    }
+    collisionAvoidance->linkPairs.emplace_back(index1, index2);
+    collisionAvoidance->queries.emplace_back(
+        collisionAvoidance->links[index1].geometry, collisionAvoidance->links[index2].geometry);
+    collisionAvoidance->queries.back().distance = std::numeric_limits<double>::max();
+    collisionAvoidance->normals.emplace_back(Vector3::Zero());
+    collisionAvoidance->normalValidities.push_back(false);
+    return true;
+}
+
+
+void JointPath::clearCollisionAvoidance()
+{
+    if(numericalIK){
+        numericalIK->collisionAvoidance.reset();
+    }
+}
+
+
+bool JointPath::isCollisionAvoidanceEnabled() const
+{
+    return numericalIK && numericalIK->collisionAvoidance;
+}
+
+
 JointPath& JointPath::setBaseLinkGoal(const Isometry3& T)
 {
     linkPath_.baseLink()->setPosition(T);
@@ -365,6 +540,12 @@ bool JointPath::calcInverseKinematics(const Isometry3& T)
         nuIK->svd.setTruncateRatio(std::numeric_limits<double>::max());
     }
 
+    auto collisionAvoidance = nuIK->collisionAvoidance.get();
+    if(collisionAvoidance){
+        collisionAvoidance->prepare(*this);
+        collisionAvoidance->detectDistances(*this);
+    }
+
     for(nuIK->iteration = 0; nuIK->iteration < nuIK->maxIterations; ++nuIK->iteration){
 
         double errorSqr;
@@ -375,12 +556,17 @@ bool JointPath::calcInverseKinematics(const Isometry3& T)
             nuIK->dTask.segment<3>(3) = target->R() * omegaFromRot(target->R().transpose() * T.linear());
             errorSqr = nuIK->dTask.squaredNorm();
         }
-        if(errorSqr < nuIK->maxIkErrorSqr){
+        int numCollisionConstraints = 0;
+        if(collisionAvoidance){
+            numCollisionConstraints = collisionAvoidance->setConstraints(*this, nuIK->deltaScale);
+        }
+        if(errorSqr < nuIK->maxIkErrorSqr && (!collisionAvoidance || collisionAvoidance->isCollisionFree())){
             completed = true;
             target->T() = T;
             break;
         }
-        if(prevErrsqr - errorSqr < nuIK->maxIkErrorSqr){
+        // The error may increase while the constraints move the links away from the others
+        if(numCollisionConstraints == 0 && prevErrsqr - errorSqr < nuIK->maxIkErrorSqr){
             if(nuIK->isBestEffortIkMode && (errorSqr > prevErrsqr)){
                 // Revert the joint displacements to the previous state in this iteration
                 for(int j=0; j < n; ++j){
@@ -390,19 +576,20 @@ bool JointPath::calcInverseKinematics(const Isometry3& T)
             }
             break;
         }
-        prevErrsqr = errorSqr;
+        prevErrsqr = (numCollisionConstraints == 0) ? errorSqr : std::numeric_limits<double>::max();
 
         nuIK->jacobianFunc(nuIK->J);
 
-        if(useUsualInverseSolution){
+        if(numCollisionConstraints > 0){
+            collisionAvoidance->solveConstrainedLeastSquares(
+                nuIK->J, nuIK->dTask, nuIK->dampingConstantSqr, nuIK->dq);
+        } else if(useUsualInverseSolution){
             nuIK->dq = nuIK->QR.compute(nuIK->J).solve(nuIK->dTask);
         } else {
             if(USE_SVD_FOR_BEST_EFFORT_IK){
                 nuIK->svd.compute(nuIK->J).solve(nuIK->dTask, nuIK->dq);
             } else {
-                // The damped least squares (singurality robust inverse) method
-                nuIK->JJ = nuIK->J * nuIK->J.transpose() + nuIK->dampingConstantSqr * MatrixXd::Identity(nuIK->J.rows(), nuIK->J.rows());
-                nuIK->dq = nuIK->J.transpose() * nuIK->QR.compute(nuIK->JJ).solve(nuIK->dTask);
+                nuIK->solveDampedLeastSquares();
             }
         }
 
@@ -419,6 +606,22 @@ bool JointPath::calcInverseKinematics(const Isometry3& T)
         }
 
         calcForwardKinematics();
+
+        if(collisionAvoidance){
+            collisionAvoidance->detectDistances(*this);
+            double stepScale = nuIK->deltaScale;
+            for(int i=0; i < MaxNumCollisionAvoidanceStepHalvings; ++i){
+                if(!collisionAvoidance->hasNewContact()){
+                    break;
+                }
+                stepScale *= 0.5;
+                for(int j=0; j < n; ++j){
+                    joints_[j]->q() -= stepScale * nuIK->dq(j);
+                }
+                calcForwardKinematics();
+                collisionAvoidance->detectDistances(*this);
+            }
+        }
     }
 
     if(!completed && !nuIK->isBestEffortIkMode){
@@ -427,12 +630,340 @@ bool JointPath::calcInverseKinematics(const Isometry3& T)
         }
         calcForwardKinematics();
         target->T() = nuIK->T0;
+        if(collisionAvoidance){
+            collisionAvoidance->detectDistances(*this);
+        }
     }
 
     return completed;
 }
 
 
+/**
+   The damped least squares (singurality robust inverse) method.
+   The positive definite matrix of the normal equation is solved by the Cholesky decomposition
+   in the smaller space of the task and the joints, and the fixed-size workspace without the
+   heap allocation is used for the usual six-dimensional task.
+*/
+void NumericalIK::solveDampedLeastSquares()
+{
+    const int m = J.rows();
+    const int n = J.cols();
+
+    if(m == 6 && n >= 6){
+        JJ6.noalias() = J * J.transpose();
+        JJ6.diagonal().array() += dampingConstantSqr;
+        ldlt6.compute(JJ6);
+        y6 = ldlt6.solve(dTask.head<6>());
+        dq.noalias() = J.transpose() * y6;
+
+    } else if(m <= n){
+        JJ.noalias() = J * J.transpose();
+        JJ.diagonal().array() += dampingConstantSqr;
+        ldlt.compute(JJ);
+        y = ldlt.solve(dTask);
+        dq.noalias() = J.transpose() * y;
+
+    } else {
+        JJ.noalias() = J.transpose() * J;
+        JJ.diagonal().array() += dampingConstantSqr;
+        ldlt.compute(JJ);
+        y.noalias() = J.transpose() * dTask;
+        dq = ldlt.solve(y);
+    }
+}
+
+
+JointPathCollisionAvoidance::JointPathCollisionAvoidance
+(BodyCollisionDetector* detector, CollisionDetectorDistanceAPI* distanceAPI,
+ double margin, double activationDistance)
+    : bodyCollisionDetector(detector),
+      collisionDetector(detector->collisionDetector()),
+      distanceAPI(distanceAPI),
+      margin(margin),
+      activationDistance(std::max(activationDistance, margin))
+{
+    isPathInfoValid = false;
+    numConstraints = 0;
+}
+
+
+int JointPathCollisionAvoidance::findOrAddLink(Link* link)
+{
+    for(size_t i=0; i < links.size(); ++i){
+        if(links[i].link == link){
+            return i;
+        }
+    }
+    auto geometry = bodyCollisionDetector->findGeometryHandle(link);
+    if(!geometry){
+        return -1;
+    }
+    LinkInfo info;
+    info.link = link;
+    info.geometry = *geometry;
+    info.pathLinkIndex = -1;
+    links.push_back(info);
+    isPathInfoValid = false;
+    return links.size() - 1;
+}
+
+
+void JointPathCollisionAvoidance::initializePathInfo(const JointPath& path)
+{
+    const LinkPath& linkPath = path.linkPath();
+    const int numPathLinks = linkPath.size();
+    auto findPathLinkIndex = [&](Link* link){
+        for(int i=0; i < numPathLinks; ++i){
+            if(linkPath[i] == link){
+                return i;
+            }
+        }
+        return -1;
+    };
+
+    const int n = path.numJoints();
+    jointMotionBeginIndices.resize(n);
+    for(int i=0; i < n; ++i){
+        int index = findPathLinkIndex(path.joint(i));
+        // An upward joint moves the links beyond its parent link
+        jointMotionBeginIndices[i] = path.isJointDownward(i) ? index : index + 1;
+    }
+
+    // A link which is not in the path moves together with the closest ancestor in the path
+    for(auto& info : links){
+        info.pathLinkIndex = -1;
+        for(Link* link = info.link; link; link = link->parent()){
+            int index = findPathLinkIndex(link);
+            if(index >= 0){
+                info.pathLinkIndex = index;
+                break;
+            }
+        }
+    }
+
+    isPathInfoValid = true;
+}
+
+
+void JointPathCollisionAvoidance::prepare(const JointPath& path)
+{
+    if(!isPathInfoValid){
+        initializePathInfo(path);
+    }
+    const LinkPath& linkPath = path.linkPath();
+    for(auto& info : links){
+        if(info.pathLinkIndex >= 0){
+            info.T_offset = linkPath[info.pathLinkIndex]->T().inverse(Eigen::Isometry) * info.link->T();
+        }
+    }
+    for(auto& query : queries){
+        query.distance = std::numeric_limits<double>::max();
+    }
+    prevDistances.clear();
+    prevDistances.resize(queries.size(), std::numeric_limits<double>::max());
+}
+
+
+Isometry3 JointPathCollisionAvoidance::geometryPosition(const JointPath& path, const LinkInfo& info) const
+{
+    if(info.pathLinkIndex < 0){
+        return info.link->T();
+    }
+    return path.linkPath()[info.pathLinkIndex]->T() * info.T_offset;
+}
+
+
+void JointPathCollisionAvoidance::detectDistances(const JointPath& path)
+{
+    // The links of the same body which are not in the path are not updated in the iterations
+    for(auto& info : links){
+        if(info.pathLinkIndex > 0){
+            collisionDetector->updatePosition(info.geometry, geometryPosition(path, info));
+        }
+    }
+
+    distanceAPI->detectDistances(queries, activationDistance);
+
+    for(size_t i=0; i < queries.size(); ++i){
+        auto& query = queries[i];
+        if(query.distance < activationDistance){
+            Vector3 d = query.point1 - query.point2;
+            double norm = d.norm();
+            if(norm > 1.0e-9){
+                normals[i] = d / norm;
+                normalValidities[i] = true;
+            }
+        }
+    }
+}
+
+
+bool JointPathCollisionAvoidance::isCollisionFree() const
+{
+    for(auto& query : queries){
+        if(query.distance <= 0.0){
+            return false;
+        }
+    }
+    return true;
+}
+
+
+bool JointPathCollisionAvoidance::hasNewContact() const
+{
+    for(size_t i=0; i < queries.size(); ++i){
+        if(queries[i].distance <= 0.0 && prevDistances[i] > 0.0){
+            return true;
+        }
+    }
+    return false;
+}
+
+
+Vector3 JointPathCollisionAvoidance::calcPointVelocity
+(const JointPath& path, int jointIndex, int pathLinkIndex, const Vector3& point) const
+{
+    if(pathLinkIndex < jointMotionBeginIndices[jointIndex]){
+        return Vector3::Zero();
+    }
+    Link* joint = path.joint(jointIndex);
+    const double sign = path.isJointDownward(jointIndex) ? 1.0 : -1.0;
+    if(joint->isRotationalJoint()){
+        return (sign * (joint->R() * joint->a())).cross(point - joint->p());
+    } else if(joint->isSlideJoint()){
+        return sign * (joint->R() * joint->d());
+    }
+    return Vector3::Zero();
+}
+
+
+/**
+   Sets the linearized constraints of the pairs within the activation distance so that
+   the distance after the step of the iteration is not less than the margin.
+   The normal of the last separated state is used for a pair in contact, where the closest
+   points do not give the normal.
+*/
+int JointPathCollisionAvoidance::setConstraints(const JointPath& path, double deltaScale)
+{
+    const int numPairs = queries.size();
+    const int n = path.numJoints();
+    G.resize(numPairs, n);
+    h.resize(numPairs);
+    numConstraints = 0;
+
+    for(int i=0; i < numPairs; ++i){
+        const auto& query = queries[i];
+        prevDistances[i] = query.distance;
+        if(query.distance >= activationDistance){
+            continue;
+        }
+        const LinkInfo& info1 = links[linkPairs[i].first];
+        const LinkInfo& info2 = links[linkPairs[i].second];
+        Vector3 normal;
+        if(normalValidities[i]){
+            normal = normals[i];
+        } else {
+            normal = geometryPosition(path, info1).translation() - geometryPosition(path, info2).translation();
+            double norm = normal.norm();
+            if(norm < 1.0e-9){
+                continue;
+            }
+            normal /= norm;
+        }
+        auto row = G.row(numConstraints);
+        for(int j=0; j < n; ++j){
+            Vector3 v =
+                calcPointVelocity(path, j, info1.pathLinkIndex, query.point1) -
+                calcPointVelocity(path, j, info2.pathLinkIndex, query.point2);
+            row(j) = normal.dot(v);
+        }
+        if(row.squaredNorm() < 1.0e-18){
+            continue; // The path does not change the distance
+        }
+        h(numConstraints) = (margin - query.distance) / deltaScale;
+        ++numConstraints;
+    }
+
+    return numConstraints;
+}
+
+
+/**
+   Solves the damped least squares with the distance constraints by the active set method.
+   The constraint with the largest violation is added to the active set, and the one with
+   a negative multiplier is removed from it until no constraint is violated.
+*/
+void JointPathCollisionAvoidance::solveConstrainedLeastSquares
+(const MatrixXd& J, const VectorXd& dTask, double dampingConstantSqr, VectorXd& out_dq)
+{
+    const int m = numConstraints;
+
+    H.noalias() = J.transpose() * J;
+    H.diagonal().array() += dampingConstantSqr + CollisionAvoidanceDampingSqr;
+    llt.compute(H);
+    dq0.noalias() = J.transpose() * dTask;
+    dq0 = llt.solve(dq0);
+    Y = llt.solve(G.topRows(m).transpose());
+
+    activeSet.clear();
+    activeFlags.assign(m, false);
+    out_dq = dq0;
+
+    const int maxLoops = 2 * m + 2;
+    for(int loop = 0; loop < maxLoops; ++loop){
+        const int a = activeSet.size();
+        if(a > 0){
+            S.resize(a, a);
+            r.resize(a);
+            for(int i=0; i < a; ++i){
+                const int ci = activeSet[i];
+                for(int j=0; j < a; ++j){
+                    S(i, j) = G.row(ci).dot(Y.col(activeSet[j]));
+                }
+                S(i, i) += 1.0e-12;
+                r(i) = h(ci) - G.row(ci).dot(dq0);
+            }
+            mu = S.ldlt().solve(r);
+            int minIndex;
+            if(mu.minCoeff(&minIndex) < 0.0){
+                activeFlags[activeSet[minIndex]] = false;
+                activeSet.erase(activeSet.begin() + minIndex);
+                continue;
+            }
+            out_dq = dq0;
+            for(int i=0; i < a; ++i){
+                out_dq += mu(i) * Y.col(activeSet[i]);
+            }
+        } else {
+            out_dq = dq0;
+        }
+
+        int violated = -1;
+        double maxViolation = 1.0e-9;
+        for(int i=0; i < m; ++i){
+            if(!activeFlags[i]){
+                double violation = h(i) - G.row(i).dot(out_dq);
+                if(violation > maxViolation){
+                    maxViolation = violation;
+                    violated = i;
+                }
+            }
+        }
+        if(violated < 0){
+            break;
+        }
+        activeSet.push_back(violated);
+        activeFlags[violated] = true;
+    }
+
+    double maxStep = out_dq.cwiseAbs().maxCoeff();
+    if(maxStep > MaxCollisionAvoidanceJointStep){
+        out_dq *= MaxCollisionAvoidanceJointStep / maxStep;
+    }
+}
+
+
 bool JointPath::calcRemainingPartForwardKinematicsForInverseKinematics()
 {
     if(!remainingLinkTraverse){
@@ -500,14 +1031,15 @@ namespace {
 // deprecated
 class JointPathWithCustomizerIk : public JointPath
 {
-    BodyPtr body;
+    // The weak reference avoids the cyclic reference with the path cache of the body
+    weak_ref_ptr<Body> weakBody;
     int ikTypeId;
     bool isCustomizedIkPathReversed;
     
 public:
     JointPathWithCustomizerIk(const BodyPtr& body, Link* baseLink, Link* endLink)
         : JointPath(baseLink, endLink),
-          body(body)
+          weakBody(body)
     {
         ikTypeId = body->customizerInterface()->initializeAnalyticIk(
             body->customizerHandle(), baseLink->index(), endLink->index());
@@ -534,6 +1066,10 @@ public:
             return JointPath::calcInverseKinematics(T);
         }
         
+        auto body = weakBody.lock();
+        if(!body){
+            return false;
+        }
         const Link* baseLink_ = baseLink();
         Vector3 p;
         Matrix3 R;
@@ -577,3 +1113,32 @@ std::shared_ptr<JointPath> JointPath::getCustomPath(Body* body, Link* baseLink,
 
     return make_shared<JointPath>(baseLink, endLink);
 }
+
+
+std::shared_ptr<JointPath> JointPath::getCachedCustomPath(Body* body, Link* baseLink, Link* endLink)
+{
+    auto cache = body->getOrCreateCache<JointPathCache>(JointPathCacheName);
+    if(cache->linkTreeRevision != body->linkTreeRevision()){
+        cache->paths.clear();
+        cache->linkTreeRevision = body->linkTreeRevision();
+    }
+    auto inserted = cache->paths.emplace(std::make_pair(baseLink, endLink), nullptr);
+    auto& source = inserted.first->second;
+    if(inserted.second){
+        auto path = getCustomPath(body, baseLink, endLink);
+        if(!path || typeid(*path) != typeid(JointPath)){
+            return path;
+        }
+        source = path;
+    } else if(!source){
+        return getCustomPath(body, baseLink, endLink);
+    }
+    return shared_ptr<JointPath>(
+        new JointPath(source->linkPath_, source->joints_, source->numUpwardJointConnections));
+}
+
+
+void JointPath::clearPathCache(Body* body)
+{
+    body->removeCache(JointPathCacheName);
+}
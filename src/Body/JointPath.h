@@ -19,6 +19,7 @@ namespace cnoid {
 class NumericalIK;
 class LinkTraverse;
 class Body;
+class BodyCollisionDetector;
 
 class CNOID_EXPORT JointPath : public InverseKinematics
 {
@@ -28,6 +29,15 @@ public:
        when the body has the analytical one for a given path.
     */
     static std::shared_ptr<JointPath> getCustomPath(Body* body, Link* baseLink, Link* endLink);
+
+    /**
+       This function returns a new path that is equivalent to the one given by getCustomPath.
+       The link and joint lists of the path are copied from the cache of the body, which is
+       cleared when the link tree of the body is updated, so the path is not shared with the
+       other callers. A path with the custom IK is not cached and is created by getCustomPath.
+    */
+    static std::shared_ptr<JointPath> getCachedCustomPath(Body* body, Link* baseLink, Link* endLink);
+    static void clearPathCache(Body* body);
     
     JointPath();
     JointPath(Link* base, Link* end);
@@ -109,6 +119,29 @@ public:
     // For the path customized by the customizeTarget function
     bool calcInverseKinematics();
 
+    /**
+       Enables the collision avoidance of the numerical IK. The distances of the link pairs
+       added by addCollisionAvoidanceLinkPair are the inequality constraints of each iteration,
+       which keep the distances larger than the margin when they are within the activation
+       distance. A solution is completed only when no pair is in contact.
+       The collision detector of the given detector must implement CollisionDetectorDistanceAPI,
+       and its geometry handle map must be enabled. The positions of the geometries of the links
+       which are not moved by the path must be updated before the IK.
+       \return false if the collision detector does not support the distance detection
+    */
+    bool setCollisionAvoidance(
+        BodyCollisionDetector* detector, double margin = 0.005, double activationDistance = 0.05);
+
+    /**
+       The links can be the links of the path, the links of the same body which are moved
+       together with the links of the path, and the links of the other bodies.
+       \return false if the geometry of a link is not found in the detector
+    */
+    bool addCollisionAvoidanceLinkPair(Link* link1, Link* link2);
+
+    void clearCollisionAvoidance();
+    bool isCollisionAvoidanceEnabled() const;
+
     JointPath& storeCurrentPosition();
 
     JointPath& setBaseLinkGoal(const Isometry3& T);
@@ -162,6 +195,7 @@ public:
     static double numericalIkDefaultTruncateRatio();
 
 private:
+    JointPath(const LinkPath& linkPath, const std::vector<LinkPtr>& joints, int numUpwardJointConnections);
     void initialize();
     void extractJoints();
     void doResetWhenJointPathUpdated();
@@ -0,0 +1,88 @@
+#include "JointStateBatch.h"
+#include "Body.h"
+#include "Link.h"
+
+using namespace std;
+using namespace cnoid;
+
+
+JointStateBatch::JointStateBatch()
+{
+
+}
+
+
+JointStateBatch::~JointStateBatch()
+{
+
+}
+
+
+void JointStateBatch::addBody(Body* body)
+{
+    const int offset = q_.size();
+    const int n = offset + body->numJoints();
+    bodies.push_back(body);
+    jointOffsets.push_back(offset);
+    q_.conservativeResize(n);
+    dq_.conservativeResize(n);
+    u_.conservativeResize(n);
+    q_target_.conservativeResize(n);
+    dq_target_.conservativeResize(n);
+    for(int i=offset; i < n; ++i){
+        q_[i] = dq_[i] = u_[i] = q_target_[i] = dq_target_[i] = 0.0;
+    }
+}
+
+
+void JointStateBatch::clear()
+{
+    bodies.clear();
+    jointOffsets.clear();
+    q_.resize(0);
+    dq_.resize(0);
+    u_.resize(0);
+    q_target_.resize(0);
+    dq_target_.resize(0);
+}
+
+
+void JointStateBatch::readState()
+{
+    const int nb = bodies.size();
+    for(int i=0; i < nb; ++i){
+        auto body = bodies[i].get();
+        int index = jointOffsets[i];
+        for(auto& joint : body->joints()){
+            q_[index] = joint->q();
+            dq_[index] = joint->dq();
+            u_[index] = joint->u();
+            q_target_[index] = joint->q_target();
+            dq_target_[index] = joint->dq_target();
+            ++index;
+        }
+    }
+}
+
+
+void JointStateBatch::writeCommands()
+{
+    const int nb = bodies.size();
+    for(int i=0; i < nb; ++i){
+        auto body = bodies[i].get();
+        int index = jointOffsets[i];
+        for(auto& joint : body->joints()){
+            const int mode = joint->actuationMode();
+            if(mode & Link::JointDisplacement){
+                joint->q_target() = q_target_[index];
+            }
+            if(mode & Link::JointVelocity){
+                joint->dq_target() = dq_target_[index];
+            }
+            if(mode & Link::JointEffort){
+                joint->u() = u_[index];
+            }
+            ++index;
+        }
+    }
+}
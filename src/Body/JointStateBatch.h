@@ -0,0 +1,63 @@
+#ifndef CNOID_BODY_JOINT_STATE_BATCH_H
+#define CNOID_BODY_JOINT_STATE_BATCH_H
+
+#include <cnoid/Referenced>
+#include <cnoid/EigenTypes>
+#include <vector>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+class Body;
+
+/**
+   This class stores the joint states of multiple bodies in contiguous arrays so that they can be
+   processed at once, for example as arrays of a script language without copying them for each body.
+   The joints of the bodies are arranged in the order of the bodies added, and the joints of a body
+   are arranged in the order of the joint indices.
+*/
+class CNOID_EXPORT JointStateBatch : public Referenced
+{
+public:
+    JointStateBatch();
+    ~JointStateBatch();
+
+    //! \note The arrays are reallocated by this function.
+    void addBody(Body* body);
+    void clear();
+
+    int numBodies() const { return static_cast<int>(bodies.size()); }
+    Body* body(int index) const { return bodies[index]; }
+    int numJoints() const { return static_cast<int>(q_.size()); }
+    int jointOffset(int bodyIndex) const { return jointOffsets[bodyIndex]; }
+
+    VectorXd& q() { return q_; }
+    VectorXd& dq() { return dq_; }
+    VectorXd& u() { return u_; }
+    VectorXd& q_target() { return q_target_; }
+    VectorXd& dq_target() { return dq_target_; }
+
+    //! Copy the joint displacements, velocities, efforts and targets of the bodies to the arrays
+    void readState();
+
+    /**
+       Copy the targets and the efforts in the arrays to the joints of the bodies. Each value is
+       only copied to the joints actuated by the corresponding actuation mode.
+    */
+    void writeCommands();
+
+private:
+    std::vector<ref_ptr<Body>> bodies;
+    std::vector<int> jointOffsets;
+    VectorXd q_;
+    VectorXd dq_;
+    VectorXd u_;
+    VectorXd q_target_;
+    VectorXd dq_target_;
+};
+
+typedef ref_ptr<JointStateBatch> JointStateBatchPtr;
+
+}
+
+#endif
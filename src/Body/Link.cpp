@@ -4,6 +4,7 @@
 */
 
 #include "Link.h"
+#include "LinkArena.h"
 #include "Body.h"
 #include "Material.h"
 #include <cnoid/SceneGraph>
@@ -13,6 +14,18 @@ using namespace std;
 using namespace cnoid;
 
 
+void* Link::operator new(std::size_t size)
+{
+    return LinkArena::allocate(size);
+}
+
+
+void Link::operator delete(void* p)
+{
+    LinkArena::free(p);
+}
+
+
 Link::Link()
 {
     index_ = -1;
@@ -443,6 +456,12 @@ void Link::clearShapeNodes(SgUpdateRef update)
 }
 
 
+void Link::clearCollisionShapeNodes(SgUpdateRef update)
+{
+    collisionShape_->clearChildren(update);
+}
+
+
 void Link::resetInfo(Mapping* info)
 {
     info_ = info;
@@ -26,7 +26,21 @@ typedef ref_ptr<Link> LinkPtr;
 class CNOID_EXPORT Link : public ClonableReferenced
 {
 public:
-    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+    /*
+      A link is allocated from the LinkArena active in the thread if any. The other operators are
+      defined in the same way as EIGEN_MAKE_ALIGNED_OPERATOR_NEW. The subclasses should not define
+      their own operator new so that they can be allocated from the arena.
+    */
+    static void* operator new(std::size_t size);
+    static void operator delete(void* p);
+    static void* operator new[](std::size_t size) {
+        return Eigen::internal::conditional_aligned_malloc<true>(size);
+    }
+    static void operator delete[](void* p) {
+        Eigen::internal::conditional_aligned_free<true>(p);
+    }
+    static void* operator new(std::size_t, void* p) { return p; }
+    static void operator delete(void*, void*) { }
 
     Link();
 
@@ -334,7 +348,7 @@ public:
         const Vector3& force() const { return force_; }
         //! The relative velocity of the contact point on this link based on the other link.
         const Vector3& velocity() const { return velocity_; }
-        double depth() { return depth_; }
+        double depth() const { return depth_; }
 
     private:
         Vector3 position_;
@@ -422,6 +436,7 @@ public:
     void addCollisionShapeNode(SgNode* shape, SgUpdateRef update = nullptr);
     void removeShapeNode(SgNode* shape, SgUpdateRef update = nullptr);
     void clearShapeNodes(SgUpdateRef update = nullptr);
+    void clearCollisionShapeNodes(SgUpdateRef update = nullptr);
 
     [[deprecated("You don't have to use this function.")]]
     void updateShapeRs() {}
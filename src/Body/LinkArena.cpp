@@ -0,0 +1,137 @@
+#include "LinkArena.h"
+#include <Eigen/Core>
+#include <atomic>
+#include <algorithm>
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+/*
+  Each link is preceded by a header that stores the chunk the link is allocated from, or null if
+  the link is allocated from the heap. The header size keeps the alignment required by Eigen.
+*/
+const size_t HeaderSize = (EIGEN_MAX_ALIGN_BYTES > 16) ? EIGEN_MAX_ALIGN_BYTES : 16;
+
+size_t alignToHeaderSize(size_t size)
+{
+    return (size + HeaderSize - 1) / HeaderSize * HeaderSize;
+}
+
+thread_local LinkArena* currentArena = nullptr;
+std::atomic<bool> isArenaEnabled(true);
+
+}
+
+namespace cnoid {
+
+struct LinkArena::Chunk
+{
+    // The arena using the chunk and the links allocated from it have the references
+    std::atomic<int> numRefs;
+    char* memory;
+    size_t capacity;
+    size_t used;
+};
+
+}
+
+void LinkArena::setEnabled(bool on)
+{
+    isArenaEnabled = on;
+}
+
+
+bool LinkArena::isEnabled()
+{
+    return isArenaEnabled;
+}
+
+
+LinkArena::LinkArena(int numLinks)
+{
+    isActive = isArenaEnabled;
+    prevArena = nullptr;
+    chunk = nullptr;
+    numRemainingLinks = std::max(1, numLinks);
+
+    if(isActive){
+        prevArena = currentArena;
+        currentArena = this;
+    }
+}
+
+
+LinkArena::~LinkArena()
+{
+    if(isActive){
+        currentArena = prevArena;
+        if(chunk){
+            releaseChunk(chunk);
+        }
+    }
+}
+
+
+void* LinkArena::allocate(std::size_t size)
+{
+    if(currentArena){
+        return currentArena->allocateInChunk(size);
+    }
+    auto block = static_cast<char*>(Eigen::internal::aligned_malloc(HeaderSize + size));
+    *reinterpret_cast<Chunk**>(block) = nullptr;
+    return block + HeaderSize;
+}
+
+
+void* LinkArena::allocateInChunk(std::size_t size)
+{
+    const size_t blockSize = HeaderSize + alignToHeaderSize(size);
+
+    if(!chunk || chunk->used + blockSize > chunk->capacity){
+        // The first chunk is sized by the first link because the links of a body usually have the same class
+        size_t capacity = blockSize * numRemainingLinks;
+        if(chunk){
+            capacity = std::max(capacity, chunk->capacity * 2);
+            releaseChunk(chunk);
+        }
+        chunk = new Chunk;
+        chunk->numRefs = 1;
+        chunk->memory = static_cast<char*>(Eigen::internal::aligned_malloc(capacity));
+        chunk->capacity = capacity;
+        chunk->used = 0;
+    }
+
+    char* block = chunk->memory + chunk->used;
+    chunk->used += blockSize;
+    chunk->numRefs.fetch_add(1, std::memory_order_relaxed);
+    *reinterpret_cast<Chunk**>(block) = chunk;
+    if(numRemainingLinks > 1){
+        --numRemainingLinks;
+    }
+    return block + HeaderSize;
+}
+
+
+void LinkArena::free(void* p)
+{
+    if(!p){
+        return;
+    }
+    char* block = static_cast<char*>(p) - HeaderSize;
+    if(auto chunk = *reinterpret_cast<Chunk**>(block)){
+        releaseChunk(chunk);
+    } else {
+        Eigen::internal::aligned_free(block);
+    }
+}
+
+
+void LinkArena::releaseChunk(Chunk* chunk)
+{
+    if(chunk->numRefs.fetch_sub(1, std::memory_order_acq_rel) == 1){
+        Eigen::internal::aligned_free(chunk->memory);
+        delete chunk;
+    }
+}
@@ -0,0 +1,57 @@
+#ifndef CNOID_BODY_LINK_ARENA_H
+#define CNOID_BODY_LINK_ARENA_H
+
+#include <cstddef>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+/**
+   While an instance of this class exists, the links created in the thread are allocated from the
+   memory blocks owned by the arena. The links are placed contiguously in the order of creation,
+   so the links of a body cloned in an arena are placed in the order of the link indices, which
+   improves the cache locality of the traversals over the links.
+
+   The memory is managed by the links allocated from it, and it is released when all the links
+   are deleted. The links therefore behave in the same way as the links allocated from the heap
+   and can outlive the arena object.
+
+   This class is used by Body::copyFrom. The arena is only effective for the link classes that
+   do not define their own operator new.
+*/
+class CNOID_EXPORT LinkArena
+{
+public:
+    //! Arenas are enabled by default.
+    static void setEnabled(bool on);
+    static bool isEnabled();
+
+    /**
+       \param numLinks The expected number of links to allocate, which is used to decide the size
+       of the first memory block
+    */
+    LinkArena(int numLinks);
+    ~LinkArena();
+
+    LinkArena(const LinkArena&) = delete;
+    LinkArena& operator=(const LinkArena&) = delete;
+
+    //! Used by Link::operator new
+    static void* allocate(std::size_t size);
+    //! Used by Link::operator delete
+    static void free(void* p);
+
+private:
+    struct Chunk;
+    void* allocateInChunk(std::size_t size);
+    static void releaseChunk(Chunk* chunk);
+
+    bool isActive;
+    LinkArena* prevArena;
+    Chunk* chunk;
+    int numRemainingLinks;
+};
+
+}
+
+#endif
@@ -124,7 +124,7 @@ void LinkKinematicsKit::Impl::setBaseLink(Link* baseLink)
     configurationHandler.reset();
 
     if(baseLink && baseLink->body() == body){
-        jointPath = JointPath::getCustomPath(body, baseLink, link);
+        jointPath = JointPath::getCachedCustomPath(body, baseLink, link);
         if(jointPath){
             inverseKinematics = jointPath;
             if(jointPath->hasCustomIK()){
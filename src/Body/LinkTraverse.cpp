@@ -188,7 +188,7 @@ void LinkTraverse::calcForwardKinematics(bool calcVelocity, bool calcAcceleratio
             if(calcVelocity){
                 const Vector3 sv(link->R() * (child->Rb() * child->d()));
                 link->w() = child->w();
-                link->v().noalias() = child->v() - child->dq() * sv;
+                link->v().noalias() = child->v() - link->w().cross(arm) - child->dq() * sv;
 
                 if(calcAcceleration){
                     link->dw() = child->dw();
@@ -251,7 +251,7 @@ void LinkTraverse::calcForwardKinematics(bool calcVelocity, bool calcAcceleratio
             if(calcVelocity){
                 const Vector3 sv(parent->R() * (link->Rb() * link->d()));
                 link->w() = parent->w();
-                link->v().noalias() = parent->v() + sv * link->dq();
+                link->v().noalias() = parent->v() + parent->w().cross(arm) + sv * link->dq();
 
                 if(calcAcceleration){
                     link->dw() = parent->dw();
@@ -4,105 +4,186 @@
 
 #include "MassMatrix.h"
 #include "Link.h"
-#include "InverseDynamics.h"
+#include <cnoid/EigenUtil>
+#include <vector>
 
+using namespace std;
 using namespace cnoid;
 
 namespace {
 
-template<typename Derived>
-void setColumnOfMassMatrix(Body* body, Eigen::MatrixBase<Derived>& out_M, int column)
+/**
+   The quantities of a link used in the calculation.
+   All the spatial vectors are expressed in the world frame at the world origin
+   in the same way as calcInverseDynamics().
+*/
+struct LinkData
 {
-    Link* rootLink = body->rootLink();
-    Vector6 f = calcInverseDynamics(rootLink);
+    // joint axis
+    Vector3 sv;
+    Vector3 sw;
 
-    if(!rootLink->isFixedJoint()){
-        f.tail<3>() -= rootLink->p().cross(f.head<3>());
-        out_M. Eigen::template MatrixBase<Derived>::template block<6, 1>(0, column) = f;
-    }
-    const int n = body->numJoints();
-    for(int i = 0; i < n; ++i){
-        Link* joint = body->joint(i);
-        out_M(i + 6, column) = joint->u();
-    }
-}
+    // spatial acceleration with zero joint accelerations
+    Vector3 dvo;
+    Vector3 dw;
+
+    // accumulated force of the subtree
+    Vector3 f;
+    Vector3 tau;
+
+    // composite rigid body inertia of the subtree represented by
+    // the mass, the first moment of mass and the inertia around the origin
+    double m;
+    Vector3 h;
+    Matrix3 I;
+
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+};
+
+typedef vector<LinkData, Eigen::aligned_allocator<LinkData>> LinkDataArray;
 
 }
 
 namespace cnoid {
 
 /**
-   calculate the mass matrix using the unit vector method
-   \todo replace the unit vector method here with a more efficient method
+   calculate the mass matrix by the composite rigid body algorithm and the constant term
+   by the recursive Newton-Euler method in the same kinematic pass.
+   The calculation does not change any state of the body.
 
    The motion equation (dv != dvo)
    |       |   | dv  |   |   |   | fext      |
    | out_M | * | dw  | + | b | = | tauext    |
    |       |   | ddq |   |   |   | u         |
+
+   \note The elements for dv and dw are not included when the root link is fixed.
 */
 void calcMassMatrix(Body* body, const Vector3& g, Eigen::MatrixXd& out_M, VectorXd& out_b)
 {
     const int nj = body->numJoints();
+    const int numLinks = body->numLinks();
     Link* rootLink = body->rootLink();
-    const int totaldof = rootLink->isFixedJoint() ? nj : nj + 6;
-
-    out_M.resize(totaldof, totaldof);
-
-    // preserve and clear the joint accelerations
-    VectorXd ddqorg(nj);
-    VectorXd uorg(nj);
-    for(int i = 0; i < nj; ++i){
-        Link* joint = body->joint(i);
-        ddqorg[i] = joint->ddq();
-        uorg  [i] = joint->u();
-        joint->ddq() = 0.0;
-    }
-
-    // preserve and clear the root link acceleration
-    const Vector3 dvorg = rootLink->dv();
-    const Vector3 dworg  = rootLink->dw();
-
-    rootLink->dv() = g;
-    rootLink->dw().setZero();
+    const bool isRootFree = !rootLink->isFixedJoint();
+    const int jointOffset = isRootFree ? 6 : 0;
+    const int totaldof = nj + jointOffset;
 
+    // The elements of the joints in different branches are zero
+    out_M.setZero(totaldof, totaldof);
     out_b.resize(totaldof);
-    setColumnOfMassMatrix(body, out_b, 0);
 
-    if(!rootLink->isFixedJoint()){
-        for(int i=0; i < 3; ++i){
-            rootLink->dv()[i] += 1.0;
-            setColumnOfMassMatrix(body, out_M, i);
-            rootLink->dv()[i] -= 1.0;
+    LinkDataArray data(numLinks);
+
+    // Forward pass. The links are in the order of the depth-first traversal from the root link.
+    for(int i=0; i < numLinks; ++i){
+        Link* link = body->link(i);
+        LinkData& d = data[i];
+        Link* parent = link->parent();
+        if(!parent){
+            d.sv.setZero();
+            d.sw.setZero();
+            d.dvo = g - link->w().cross(link->v());
+            d.dw.setZero();
+        } else {
+            switch(link->jointType()){
+            case Link::ROTATIONAL_JOINT:
+                d.sw.noalias() = link->R() * link->a();
+                d.sv.noalias() = link->p().cross(d.sw);
+                break;
+            case Link::SLIDE_JOINT:
+                d.sw.setZero();
+                d.sv.noalias() = link->R() * link->d();
+                break;
+            case Link::FIXED_JOINT:
+            default:
+                d.sw.setZero();
+                d.sv.setZero();
+                break;
+            }
+            const LinkData& pd = data[parent->index()];
+            const Vector3 vo_parent = parent->v() - parent->w().cross(parent->p());
+            const Vector3 dsv = parent->w().cross(d.sv) + vo_parent.cross(d.sw);
+            const Vector3 dsw = parent->w().cross(d.sw);
+            d.dw = pd.dw + dsw * link->dq();
+            d.dvo = pd.dvo + dsv * link->dq();
         }
-        for(int i=0; i < 3; ++i){
-            rootLink->dw()[i] = 1.0;
-            setColumnOfMassMatrix(body, out_M, i + 3);
-            rootLink->dw()[i] = 0.0;
-        }
-    }
 
-    for(int i = 0; i < nj; ++i){
-        Link* joint = body->joint(i);
-        joint->ddq() = 1.0;
-        int j = i + 6;
-        setColumnOfMassMatrix(body, out_M, j);
-        out_M(j, j) += joint->Jm2(); // motor inertia
-        joint->ddq() = 0.0;
+        const Vector3 c = link->R() * link->c() + link->p();
+        d.m = link->m();
+        d.h = d.m * c;
+        const Matrix3 c_hat = hat(c);
+        d.I.noalias() = link->R() * link->I() * link->R().transpose();
+        d.I.noalias() += d.m * c_hat * c_hat.transpose();
+
+        const Vector3 vo = link->v() - link->w().cross(link->p());
+        const Vector3 P = d.m * vo + link->w().cross(d.h);
+        const Vector3 L = d.h.cross(vo) + d.I * link->w();
+        d.f = d.m * d.dvo + d.dw.cross(d.h) + link->w().cross(P);
+        d.tau = d.h.cross(d.dvo) + d.I * d.dw + vo.cross(P) + link->w().cross(L);
+        d.f -= link->externalForce();
+        d.tau -= link->externalTorque();
     }
 
-    // subtract the constant term
-    for(int i = 0; i < out_M.cols(); ++i){
-        out_M.col(i) -= out_b;
+    // Backward pass to accumulate the forces and the inertias of the subtrees
+    for(int i = numLinks - 1; i > 0; --i){
+        Link* link = body->link(i);
+        const LinkData& d = data[i];
+        LinkData& pd = data[link->parent()->index()];
+        pd.f += d.f;
+        pd.tau += d.tau;
+        pd.m += d.m;
+        pd.h += d.h;
+        pd.I += d.I;
+        const int id = link->jointId();
+        if(id >= 0 && id < nj){
+            out_b[id + jointOffset] = d.sv.dot(d.f) + d.sw.dot(d.tau);
+        }
+    }
+    const Vector3& p0 = rootLink->p();
+    const LinkData& rd = data[0];
+    if(isRootFree){
+        out_b.head<3>() = rd.f;
+        out_b.segment<3>(3) = rd.tau - p0.cross(rd.f);
+
+        // The spatial acceleration caused by dw is (-dw x p0, dw)
+        const Matrix3 p0_hat = hat(p0);
+        const Matrix3 h_hat = hat(rd.h);
+        const Matrix3 Mvw = rd.m * p0_hat - h_hat;
+        out_M.block<3, 3>(0, 0) = rd.m * Matrix3::Identity();
+        out_M.block<3, 3>(0, 3) = Mvw;
+        out_M.block<3, 3>(3, 0) = Mvw.transpose();
+        out_M.block<3, 3>(3, 3) = rd.I + h_hat * p0_hat - p0_hat * Mvw;
     }
 
-    // recover state
-    for(int i = 0; i < nj; ++i){
-        Link* joint = body->joint(i);
-        joint->ddq()  = ddqorg[i];
-        joint->u()    = uorg  [i];
+    // The spatial force of the subtree of each joint caused by the unit joint acceleration
+    // is projected to the axes of the joint and its ancestors
+    for(int i=1; i < numLinks; ++i){
+        Link* link = body->link(i);
+        const int id = link->jointId();
+        if(id < 0 || id >= nj){
+            continue;
+        }
+        const LinkData& d = data[i];
+        const Vector3 f = d.m * d.sv - d.h.cross(d.sw);
+        const Vector3 tau = d.h.cross(d.sv) + d.I * d.sw;
+        const int column = id + jointOffset;
+
+        out_M(column, column) = d.sv.dot(f) + d.sw.dot(tau) + link->Jm2(); // motor inertia
+
+        for(Link* ancestor = link->parent(); ancestor->parent(); ancestor = ancestor->parent()){
+            const int aid = ancestor->jointId();
+            if(aid >= 0 && aid < nj){
+                const LinkData& ad = data[ancestor->index()];
+                const double Mij = ad.sv.dot(f) + ad.sw.dot(tau);
+                out_M(aid + jointOffset, column) = Mij;
+                out_M(column, aid + jointOffset) = Mij;
+            }
+        }
+        if(isRootFree){
+            out_M.block<3, 1>(0, column) = f;
+            out_M.block<3, 1>(3, column) = tau - p0.cross(f);
+            out_M.block<1, 6>(column, 0) = out_M.block<6, 1>(0, column).transpose();
+        }
     }
-    rootLink->dv() = dvorg;
-    rootLink->dw() = dworg;
 }
 
 void calcMassMatrix(Body* body, MatrixXd& out_M)
@@ -112,4 +193,3 @@ void calcMassMatrix(Body* body, MatrixXd& out_M)
 }
 
 }
-
@@ -0,0 +1,312 @@
+/**
+   \file
+*/
+
+#include "MultiBodyForwardKinematics.h"
+#include "BatchForwardKinematics.h"
+#include "Body.h"
+#include <cnoid/ThreadPool>
+#include <vector>
+#include <memory>
+#include <atomic>
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+// The number of the bodies calculated together by a BatchForwardKinematics instance
+const int ChunkSize = 64;
+
+// The bodies of a structure shared by fewer bodies than this are calculated by their own links
+const int MinNumBodiesToBatch = 4;
+
+int getJointType(Link* link)
+{
+    if(link->isRevoluteJoint()){
+        return Link::ROTATIONAL_JOINT;
+    } else if(link->isPrismaticJoint()){
+        return Link::SLIDE_JOINT;
+    }
+    return Link::FIXED_JOINT;
+}
+
+//! The bodies are same if BatchForwardKinematics compiles them into the same data
+bool hasSameLinkStructure(Body* body1, Body* body2)
+{
+    const int n = body1->numLinks();
+    if(body2->numLinks() != n){
+        return false;
+    }
+    for(int i=1; i < n; ++i){
+        auto link1 = body1->link(i);
+        auto link2 = body2->link(i);
+        const int type = getJointType(link1);
+        if(type != getJointType(link2) ||
+           link1->parent()->index() != link2->parent()->index() ||
+           link1->b() != link2->b() ||
+           link1->Rb() != link2->Rb()){
+            return false;
+        }
+        if(type != Link::FIXED_JOINT && link1->a() != link2->a()){
+            return false;
+        }
+    }
+    return true;
+}
+
+struct BodyInfo
+{
+    BodyPtr body;
+    // The chunk calculating the body, or -1 if the body is calculated by its own links
+    int chunkIndex;
+    // The index of the configuration in the chunk
+    int configurationIndex;
+    bool isLinkPositionOutputEnabled;
+};
+
+struct Chunk
+{
+    BatchForwardKinematics fk;
+    vector<int> bodyIndices;
+};
+
+}
+
+namespace cnoid {
+
+class MultiBodyForwardKinematics::Impl
+{
+public:
+    vector<BodyInfo> bodies;
+    vector<unique_ptr<Chunk>> chunks;
+    vector<int> directBodyIndices;
+    bool needToUpdateChunks;
+    int numThreads;
+    unique_ptr<ThreadPool> threadPool;
+    std::atomic<int> nextUnitIndex;
+
+    Impl();
+    void updateChunks();
+    void calcUnit(int unitIndex);
+};
+
+}
+
+
+MultiBodyForwardKinematics::MultiBodyForwardKinematics()
+{
+    impl = new Impl;
+}
+
+
+MultiBodyForwardKinematics::Impl::Impl()
+{
+    needToUpdateChunks = false;
+    numThreads = 0;
+}
+
+
+MultiBodyForwardKinematics::~MultiBodyForwardKinematics()
+{
+    delete impl;
+}
+
+
+void MultiBodyForwardKinematics::clearBodies()
+{
+    impl->bodies.clear();
+    impl->chunks.clear();
+    impl->directBodyIndices.clear();
+    impl->needToUpdateChunks = false;
+}
+
+
+int MultiBodyForwardKinematics::addBody(Body* body, bool isLinkPositionOutputEnabled)
+{
+    BodyInfo info;
+    info.body = body;
+    info.chunkIndex = -1;
+    info.configurationIndex = 0;
+    info.isLinkPositionOutputEnabled = isLinkPositionOutputEnabled;
+    impl->bodies.push_back(info);
+    impl->needToUpdateChunks = true;
+    return impl->bodies.size() - 1;
+}
+
+
+int MultiBodyForwardKinematics::numBodies() const
+{
+    return impl->bodies.size();
+}
+
+
+Body* MultiBodyForwardKinematics::body(int bodyIndex) const
+{
+    return impl->bodies[bodyIndex].body;
+}
+
+
+void MultiBodyForwardKinematics::setLinkPositionOutputEnabled(int bodyIndex, bool on)
+{
+    impl->bodies[bodyIndex].isLinkPositionOutputEnabled = on;
+}
+
+
+bool MultiBodyForwardKinematics::isLinkPositionOutputEnabled(int bodyIndex) const
+{
+    return impl->bodies[bodyIndex].isLinkPositionOutputEnabled;
+}
+
+
+void MultiBodyForwardKinematics::setNumThreads(int n)
+{
+    if(n < 0){
+        n = 0;
+    }
+    if(n != impl->numThreads){
+        impl->numThreads = n;
+        impl->threadPool.reset();
+    }
+}
+
+
+int MultiBodyForwardKinematics::numThreads() const
+{
+    return impl->numThreads;
+}
+
+
+void MultiBodyForwardKinematics::Impl::updateChunks()
+{
+    chunks.clear();
+    directBodyIndices.clear();
+
+    // Group the bodies by the link structure
+    vector<vector<int>> groups;
+    for(size_t i=0; i < bodies.size(); ++i){
+        Body* body = bodies[i].body;
+        bool found = false;
+        for(auto& group : groups){
+            if(hasSameLinkStructure(bodies[group.front()].body, body)){
+                group.push_back(i);
+                found = true;
+                break;
+            }
+        }
+        if(!found){
+            groups.emplace_back(1, i);
+        }
+    }
+
+    for(auto& group : groups){
+        const int n = group.size();
+        if(n < MinNumBodiesToBatch){
+            for(auto index : group){
+                bodies[index].chunkIndex = -1;
+                directBodyIndices.push_back(index);
+            }
+            continue;
+        }
+        for(int begin = 0; begin < n; begin += ChunkSize){
+            const int end = std::min(begin + ChunkSize, n);
+            auto chunk = new Chunk;
+            chunk->fk.compile(bodies[group.front()].body);
+            chunk->fk.setNumConfigurations(end - begin);
+            for(int j = begin; j < end; ++j){
+                auto& info = bodies[group[j]];
+                info.chunkIndex = chunks.size();
+                info.configurationIndex = j - begin;
+                chunk->bodyIndices.push_back(group[j]);
+            }
+            chunks.emplace_back(chunk);
+        }
+    }
+
+    needToUpdateChunks = false;
+}
+
+
+void MultiBodyForwardKinematics::calcForwardKinematics()
+{
+    if(impl->needToUpdateChunks){
+        impl->updateChunks();
+    }
+
+    const int numUnits = impl->chunks.size() + impl->directBodyIndices.size();
+
+    if(impl->numThreads == 0 || numUnits <= 1){
+        for(int i=0; i < numUnits; ++i){
+            impl->calcUnit(i);
+        }
+    } else {
+        if(!impl->threadPool){
+            impl->threadPool.reset(new ThreadPool(impl->numThreads));
+        }
+        impl->nextUnitIndex = 0;
+        const int numActiveThreads = std::min(impl->numThreads, numUnits);
+        for(int i=0; i < numActiveThreads; ++i){
+            impl->threadPool->start(
+                [this, numUnits](){
+                    while(true){
+                        const int index = impl->nextUnitIndex.fetch_add(1);
+                        if(index >= numUnits){
+                            break;
+                        }
+                        impl->calcUnit(index);
+                    }
+                });
+        }
+        impl->threadPool->wait();
+    }
+}
+
+
+void MultiBodyForwardKinematics::Impl::calcUnit(int unitIndex)
+{
+    const int numChunks = chunks.size();
+    if(unitIndex >= numChunks){
+        bodies[directBodyIndices[unitIndex - numChunks]].body->calcForwardKinematics();
+        return;
+    }
+    auto& chunk = *chunks[unitIndex];
+    const int n = chunk.bodyIndices.size();
+    for(int k=0; k < n; ++k){
+        chunk.fk.readState(bodies[chunk.bodyIndices[k]].body, k);
+    }
+    chunk.fk.calcForwardKinematics();
+    for(int k=0; k < n; ++k){
+        auto& info = bodies[chunk.bodyIndices[k]];
+        if(info.isLinkPositionOutputEnabled){
+            chunk.fk.writeState(info.body, k);
+        }
+    }
+}
+
+
+Isometry3 MultiBodyForwardKinematics::T(int bodyIndex, int linkIndex) const
+{
+    auto& info = impl->bodies[bodyIndex];
+    if(info.chunkIndex < 0 || impl->needToUpdateChunks){
+        return info.body->link(linkIndex)->T();
+    }
+    return impl->chunks[info.chunkIndex]->fk.T(linkIndex, info.configurationIndex);
+}
+
+
+void MultiBodyForwardKinematics::writeLinkPositions(int bodyIndex)
+{
+    auto& info = impl->bodies[bodyIndex];
+    if(info.chunkIndex >= 0 && !impl->needToUpdateChunks){
+        impl->chunks[info.chunkIndex]->fk.writeState(info.body, info.configurationIndex);
+    }
+}
+
+
+void MultiBodyForwardKinematics::writeAllLinkPositions()
+{
+    const int n = impl->bodies.size();
+    for(int i=0; i < n; ++i){
+        writeLinkPositions(i);
+    }
+}
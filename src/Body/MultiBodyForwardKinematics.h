@@ -0,0 +1,56 @@
+#ifndef CNOID_BODY_MULTI_BODY_FORWARD_KINEMATICS_H
+#define CNOID_BODY_MULTI_BODY_FORWARD_KINEMATICS_H
+
+#include <cnoid/EigenTypes>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+class Body;
+
+/**
+   This class calculates the forward kinematics of many bodies in one pass.
+   The bodies with the same link structure are divided into chunks, each of which is
+   calculated by BatchForwardKinematics with the bodies as its configurations, and the
+   chunks are processed in parallel. The root positions and the joint displacements are
+   read from the links of the bodies, but the calculated link positions are only written
+   to the links of the bodies whose output is enabled. The positions of the other bodies
+   can be obtained by T(), or written to the links on demand by writeLinkPositions().
+   The body of a structure shared by too few bodies is calculated by its own links.
+*/
+class CNOID_EXPORT MultiBodyForwardKinematics
+{
+public:
+    MultiBodyForwardKinematics();
+    ~MultiBodyForwardKinematics();
+
+    void clearBodies();
+
+    //! \return The index of the body
+    int addBody(Body* body, bool isLinkPositionOutputEnabled = true);
+
+    int numBodies() const;
+    Body* body(int bodyIndex) const;
+
+    void setLinkPositionOutputEnabled(int bodyIndex, bool on);
+    bool isLinkPositionOutputEnabled(int bodyIndex) const;
+
+    //! Zero means the main thread only, which is the default.
+    void setNumThreads(int n);
+    int numThreads() const;
+
+    void calcForwardKinematics();
+
+    Isometry3 T(int bodyIndex, int linkIndex) const;
+
+    void writeLinkPositions(int bodyIndex);
+    void writeAllLinkPositions();
+
+private:
+    class Impl;
+    Impl* impl;
+};
+
+}
+
+#endif
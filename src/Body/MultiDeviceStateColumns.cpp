@@ -0,0 +1,150 @@
+#include "MultiDeviceStateColumns.h"
+#include "MultiDeviceStateSeq.h"
+#include "BodyMotion.h"
+#include <algorithm>
+
+using namespace std;
+using namespace cnoid;
+
+
+MultiDeviceStateColumns::MultiDeviceStateColumns()
+{
+    clear();
+}
+
+
+MultiDeviceStateColumns::MultiDeviceStateColumns(const MultiDeviceStateSeq& seq)
+{
+    extract(seq);
+}
+
+
+void MultiDeviceStateColumns::clear()
+{
+    devices.clear();
+    frameRate_ = 0.0;
+    offsetTime_ = 0.0;
+    numFrames_ = 0;
+}
+
+
+bool MultiDeviceStateColumns::extract(const BodyMotion& motion)
+{
+    if(auto seq = getMultiDeviceStateSeq(motion)){
+        extract(*seq);
+        return true;
+    }
+    clear();
+    return false;
+}
+
+
+/**
+   A state is only stored when it is a different object from the state of the previous frame
+   and its values are different from the previous ones.
+*/
+void MultiDeviceStateColumns::extract(const MultiDeviceStateSeq& seq)
+{
+    clear();
+
+    frameRate_ = seq.frameRate();
+    offsetTime_ = seq.offsetTime();
+    numFrames_ = seq.numFrames();
+    const int n = seq.numParts();
+    devices.resize(n);
+
+    vector<double> buf;
+    vector<double> prevBuf;
+
+    for(int i=0; i < n; ++i){
+        auto& device = devices[i];
+        device.name = seq.partLabel(i);
+        auto part = seq.part(i);
+        const DeviceState* prevState = nullptr;
+        for(int frame = 0; frame < numFrames_; ++frame){
+            const DeviceState* state = part[frame];
+            if(!state || state == prevState){
+                continue;
+            }
+            const int stateSize = state->stateSize();
+            buf.resize(stateSize);
+            state->writeState(buf.data());
+            if(!prevState){
+                device.typeName = state->typeName();
+                device.columns.resize(stateSize);
+                for(auto& column : device.columns){
+                    column.reserve(numFrames_);
+                }
+            } else if(buf == prevBuf){
+                prevState = state;
+                continue;
+            }
+            if(stateSize == static_cast<int>(device.columns.size())){
+                // The state before the first valid state is regarded as the first one
+                device.changeFrames.push_back(device.changeFrames.empty() ? 0 : frame);
+                for(int j=0; j < stateSize; ++j){
+                    device.columns[j].push_back(buf[j]);
+                }
+            }
+            prevState = state;
+            prevBuf.swap(buf);
+        }
+        device.changeFrames.shrink_to_fit();
+        for(auto& column : device.columns){
+            column.shrink_to_fit();
+        }
+    }
+}
+
+
+int MultiDeviceStateColumns::deviceIndex(const std::string& name) const
+{
+    for(size_t i=0; i < devices.size(); ++i){
+        if(devices[i].name == name){
+            return i;
+        }
+    }
+    return -1;
+}
+
+
+int MultiDeviceStateColumns::findChangeIndex(const DeviceColumns& device, int frame) const
+{
+    auto& frames = device.changeFrames;
+    auto p = std::upper_bound(frames.begin(), frames.end(), frame);
+    return (p == frames.begin()) ? -1 : static_cast<int>(p - frames.begin()) - 1;
+}
+
+
+//! \return 0.0 if the device does not have any state
+double MultiDeviceStateColumns::value(int deviceIndex, int elementIndex, int frame) const
+{
+    auto& device = devices[deviceIndex];
+    int index = findChangeIndex(device, frame);
+    return (index >= 0) ? device.columns[elementIndex][index] : 0.0;
+}
+
+
+/**
+   The signature of this function corresponds to the data request callback of GraphDataHandler
+   except for the device and element indices so that the values can be directly shown in a graph.
+*/
+void MultiDeviceStateColumns::readValues
+(int deviceIndex, int elementIndex, int frame, int size, double* out_values) const
+{
+    auto& device = devices[deviceIndex];
+    auto& frames = device.changeFrames;
+    const int numChanges = frames.size();
+    int index = findChangeIndex(device, frame);
+    if(index < 0){
+        std::fill(out_values, out_values + size, 0.0);
+        return;
+    }
+    auto& column = device.columns[elementIndex];
+    for(int i=0; i < size; ++i){
+        while(index + 1 < numChanges && frames[index + 1] <= frame + i){
+            ++index;
+        }
+        out_values[i] = column[index];
+    }
+}
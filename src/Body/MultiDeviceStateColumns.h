@@ -0,0 +1,74 @@
+#ifndef CNOID_BODY_MULTI_DEVICE_STATE_COLUMNS_H
+#define CNOID_BODY_MULTI_DEVICE_STATE_COLUMNS_H
+
+#include <vector>
+#include <string>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+class MultiDeviceStateSeq;
+class BodyMotion;
+
+/**
+   This class stores the device states of a MultiDeviceStateSeq in a columnar form. The state of
+   each device is stored as the value arrays of the elements of the state, which are the values
+   written by Device::writeState. The value array of an element is contiguous and can be read
+   without accessing the device state objects.
+
+   The values of a device are only stored at the frames where the state of the device changes.
+   The changeFrames function returns the indices of those frames, and the value arrays have the
+   values at them. The readValues function expands the values into a range of the frames.
+*/
+class CNOID_EXPORT MultiDeviceStateColumns
+{
+public:
+    MultiDeviceStateColumns();
+    MultiDeviceStateColumns(const MultiDeviceStateSeq& seq);
+
+    //! \return false if the motion does not have the device state sequence
+    bool extract(const BodyMotion& motion);
+    void extract(const MultiDeviceStateSeq& seq);
+    void clear();
+
+    double frameRate() const { return frameRate_; }
+    double offsetTime() const { return offsetTime_; }
+    int numFrames() const { return numFrames_; }
+    int numDevices() const { return static_cast<int>(devices.size()); }
+
+    //! \return -1 if the device is not found
+    int deviceIndex(const std::string& name) const;
+    const std::string& deviceName(int deviceIndex) const { return devices[deviceIndex].name; }
+    const std::string& deviceTypeName(int deviceIndex) const { return devices[deviceIndex].typeName; }
+    int stateSize(int deviceIndex) const { return static_cast<int>(devices[deviceIndex].columns.size()); }
+
+    //! The first element is always the frame 0 when the device has any state
+    const std::vector<int>& changeFrames(int deviceIndex) const {
+        return devices[deviceIndex].changeFrames;
+    }
+    const std::vector<double>& column(int deviceIndex, int elementIndex) const {
+        return devices[deviceIndex].columns[elementIndex];
+    }
+
+    double value(int deviceIndex, int elementIndex, int frame) const;
+    void readValues(int deviceIndex, int elementIndex, int frame, int size, double* out_values) const;
+
+private:
+    struct DeviceColumns
+    {
+        std::string name;
+        std::string typeName;
+        std::vector<int> changeFrames;
+        std::vector<std::vector<double>> columns;
+    };
+    std::vector<DeviceColumns> devices;
+    double frameRate_;
+    double offsetTime_;
+    int numFrames_;
+
+    int findChangeIndex(const DeviceColumns& device, int frame) const;
+};
+
+}
+
+#endif
@@ -7,7 +7,12 @@
 #include "Body.h"
 #include "JointPath.h"
 #include <cnoid/EigenUtil>
+#include <cnoid/ThreadPool>
 #include <map>
+#include <memory>
+#include <random>
+#include <chrono>
+#include <limits>
 #include <iostream>
 #include <algorithm>
 
@@ -133,6 +138,17 @@ public:
     double srk0; // k of the singular point
     double srw0; // threshold value to calc k
 
+    // multi-start mode
+    int numSeeds;
+    double seedPerturbation;
+    double timeBudget;
+    int numThreads;
+    std::mt19937 randomEngine;
+    // Each seed solver has its own clone of the body
+    vector<unique_ptr<PinDragIKImpl>> seedSolvers;
+    unique_ptr<ThreadPool> threadPool;
+    const std::chrono::steady_clock::time_point* deadline;
+
     enum IKStepResult { ERROR, PINS_NOT_CONVERGED, PINS_CONVERGED };
 
     void setBaseLink(Link* baseLink);
@@ -144,9 +160,16 @@ public:
     void setIKErrorThresh(double e);
     void setSRInverseParameters(double k0, double w0);
     void enableJointRangeConstraints(bool on);
+    void setMultiStartMode(int numSeeds, double perturbation, double timeBudget);
+    void setNumThreads(int n);
     bool initialize();
             
     bool calcInverseKinematics(const Isometry3& T);
+    bool calcInverseKinematicsFromCurrentPose(const Isometry3& T);
+    bool calcMultiStartInverseKinematics(const Isometry3& T);
+    bool prepareSeedSolvers();
+    PinDragIKImpl* createSeedSolver();
+    double calcErrorSqr(const Isometry3& T);
             
     IKStepResult calcOneStep(const Vector3& v, const Vector3& omega);
     void solveConstraints();
@@ -191,6 +214,12 @@ PinDragIKImpl::PinDragIKImpl(Body* body)
 
     //enableJointRangeConstraints(true);
     enableJointRangeConstraints(false);
+
+    numSeeds = 1;
+    seedPerturbation = 0.3;
+    timeBudget = 0.012;
+    numThreads = 0;
+    deadline = nullptr;
 }
 
 
@@ -363,6 +392,36 @@ void PinDragIKImpl::enableJointRangeConstraints(bool on)
 }
 
 
+void PinDragIK::setMultiStartMode(int numSeeds, double perturbation, double timeBudget)
+{
+    impl->setMultiStartMode(numSeeds, perturbation, timeBudget);
+}
+
+
+void PinDragIKImpl::setMultiStartMode(int numSeeds, double perturbation, double timeBudget)
+{
+    this->numSeeds = std::max(numSeeds, 1);
+    seedPerturbation = perturbation;
+    this->timeBudget = timeBudget;
+}
+
+
+void PinDragIK::setNumThreads(int n)
+{
+    impl->setNumThreads(n);
+}
+
+
+void PinDragIKImpl::setNumThreads(int n)
+{
+    n = std::max(n, 0);
+    if(n != numThreads){
+        numThreads = n;
+        threadPool.reset();
+    }
+}
+
+
 bool PinDragIK::initialize()
 {
     return impl->initialize();
@@ -371,6 +430,8 @@ bool PinDragIK::initialize()
 
 bool PinDragIKImpl::initialize()
 {
+    seedSolvers.clear();
+    
     if(!targetLink){
         return false;
     }
@@ -467,6 +528,15 @@ bool PinDragIK::calcInverseKinematics(const Isometry3& T)
 
 
 bool PinDragIKImpl::calcInverseKinematics(const Isometry3& T)
+{
+    if(numSeeds > 1){
+        return calcMultiStartInverseKinematics(T);
+    }
+    return calcInverseKinematicsFromCurrentPose(T);
+}
+
+
+bool PinDragIKImpl::calcInverseKinematicsFromCurrentPose(const Isometry3& T)
 {
     for(int i=0; i < NJ; i++){
         q_org[i] = body_->joint(i)->q();
@@ -496,6 +566,9 @@ bool PinDragIKImpl::calcInverseKinematics(const Isometry3& T)
         if((dp.squaredNorm() + omega.squaredNorm()) < ikErrorSqrThresh && result == PINS_CONVERGED){
             break;
         }
+        if(deadline && std::chrono::steady_clock::now() > *deadline){
+            break;
+        }
 
         result = calcOneStep(dp, omega);
 
@@ -516,6 +589,174 @@ bool PinDragIKImpl::calcInverseKinematics(const Isometry3& T)
 }
 
 
+//! The squared error of the target and the pins weighted by the pin weights
+double PinDragIKImpl::calcErrorSqr(const Isometry3& T)
+{
+    double errsqr = (T.translation() - targetLink->p()).squaredNorm();
+    if(isTargetAttitudeEnabled){
+        errsqr += omegaFromRot(targetLink->R().transpose() * T.linear()).squaredNorm();
+    }
+    for(auto& kv : pinPropertyMap){
+        Link* link = kv.first;
+        if(link != targetLink){
+            const PinProperty& property = kv.second;
+            if(property.axes & PinDragIK::TRANSLATION_3D){
+                errsqr += property.weight * (property.p - link->p()).squaredNorm();
+            }
+            if(property.axes & PinDragIK::ROTATION_3D){
+                errsqr += property.weight * omegaFromRot(link->R().transpose() * property.R).squaredNorm();
+            }
+        }
+    }
+    return errsqr;
+}
+
+
+PinDragIKImpl* PinDragIKImpl::createSeedSolver()
+{
+    auto solver = new PinDragIKImpl(body_->clone());
+    Body* body = solver->body_;
+
+    solver->maxIteration = maxIteration;
+    solver->ikErrorSqrThresh = ikErrorSqrThresh;
+    solver->minValidDet = minValidDet;
+    solver->qWeights = qWeights;
+    solver->srk0 = srk0;
+    solver->srw0 = srw0;
+    solver->isJointRangeConstraintsEnabled = isJointRangeConstraintsEnabled;
+    solver->baseLink = body->link(baseLink->index());
+    solver->isBaseLinkFreeMode = isBaseLinkFreeMode;
+    solver->setTargetLink(body->link(targetLink->index()), isTargetAttitudeEnabled);
+    for(auto& kv : pinPropertyMap){
+        solver->setPin(body->link(kv.first->index()), kv.second.axes, kv.second.weight);
+    }
+    if(!solver->initialize()){
+        delete solver;
+        return nullptr;
+    }
+    // The pinned positions must be the ones given when this solver was initialized
+    for(auto& kv : pinPropertyMap){
+        PinProperty& property = solver->pinPropertyMap[body->link(kv.first->index())];
+        property.p = kv.second.p;
+        property.R = kv.second.R;
+    }
+    return solver;
+}
+
+
+bool PinDragIKImpl::prepareSeedSolvers()
+{
+    if(N == 0){
+        return false; // not initialized
+    }
+    if(static_cast<int>(seedSolvers.size()) != numSeeds - 1){
+        seedSolvers.clear();
+        for(int i=1; i < numSeeds; ++i){
+            auto solver = createSeedSolver();
+            if(!solver){
+                seedSolvers.clear();
+                return false;
+            }
+            seedSolvers.emplace_back(solver);
+        }
+    }
+    if(numThreads > 0 && !threadPool){
+        threadPool.reset(new ThreadPool(numThreads));
+    }
+    return true;
+}
+
+
+/**
+   The IK is first solved from the current pose as usual, and the restarts are only done when
+   it does not converge. The perturbations are generated by the main thread so that the result
+   does not depend on the number of the threads unless the time budget is exceeded.
+*/
+bool PinDragIKImpl::calcMultiStartInverseKinematics(const Isometry3& T)
+{
+    using std::chrono::steady_clock;
+
+    const steady_clock::time_point callDeadline =
+        steady_clock::now() +
+        std::chrono::duration_cast<steady_clock::duration>(std::chrono::duration<double>(timeBudget));
+
+    VectorXd q0(NJ);
+    for(int i=0; i < NJ; ++i){
+        q0[i] = body_->joint(i)->q();
+    }
+    const Isometry3 T_base0 = baseLink->T();
+
+    deadline = &callDeadline;
+    bool solved = calcInverseKinematicsFromCurrentPose(T);
+    deadline = nullptr;
+    const double errsqr = calcErrorSqr(T);
+    
+    if(errsqr < ikErrorSqrThresh || steady_clock::now() > callDeadline || !prepareSeedSolvers()){
+        return solved;
+    }
+
+    const int numRestarts = seedSolvers.size();
+    std::uniform_real_distribution<double> perturbation(-seedPerturbation, seedPerturbation);
+    for(auto& solver : seedSolvers){
+        Body* body = solver->body_;
+        for(int i=0; i < NJ; ++i){
+            Link* joint = body->joint(i);
+            double q = q0[i] + perturbation(randomEngine);
+            if(joint->q_lower() < joint->q_upper()){
+                q = std::max(joint->q_lower(), std::min(joint->q_upper(), q));
+            }
+            joint->q() = q;
+        }
+        solver->baseLink->setPosition(T_base0);
+        solver->fkTraverse.calcForwardKinematics();
+        solver->deadline = &callDeadline;
+    }
+
+    vector<double> errors(numRestarts, std::numeric_limits<double>::max());
+    vector<char> solvedFlags(numRestarts, false);
+
+    auto restart = [&](int index){
+        if(steady_clock::now() <= callDeadline){
+            PinDragIKImpl* solver = seedSolvers[index].get();
+            solvedFlags[index] = solver->calcInverseKinematicsFromCurrentPose(T);
+            errors[index] = solver->calcErrorSqr(T);
+        }
+    };
+    if(numThreads == 0){
+        for(int i=0; i < numRestarts; ++i){
+            restart(i);
+        }
+    } else {
+        for(int i=0; i < numRestarts; ++i){
+            threadPool->start([&restart, i](){ restart(i); });
+        }
+        threadPool->wait();
+    }
+
+    int best = -1;
+    double minErrorSqr = errsqr;
+    for(int i=0; i < numRestarts; ++i){
+        if(solvedFlags[i] && errors[i] < minErrorSqr){
+            minErrorSqr = errors[i];
+            best = i;
+        }
+    }
+    if(best >= 0){
+        PinDragIKImpl* solver = seedSolvers[best].get();
+        for(int i=0; i < NJ; ++i){
+            body_->joint(i)->q() = solver->body_->joint(i)->q();
+        }
+        if(isBaseLinkFreeMode){
+            baseLink->setPosition(solver->baseLink->T());
+        }
+        fkTraverse.calcForwardKinematics();
+        solved = true;
+    }
+
+    return solved;
+}
+
+
 PinDragIKImpl::IKStepResult PinDragIKImpl::calcOneStep(const Vector3& v, const Vector3& omega)
 {
     // make Jacobian matrix for the target link
@@ -40,6 +40,18 @@ public:
     void setSRInverseParameters(double k0, double w0);
     void enableJointRangeConstraints(bool on);
 
+    /**
+       Enables the multi-start mode when numSeeds is greater than one.
+       If the IK from the current pose does not converge, it is also solved from numSeeds - 1
+       initial poses whose joint displacements are randomly perturbed within the given range,
+       and the pose with the least error of the target and the pins is taken. The restarts are
+       cut off when the time budget (seconds) per calcInverseKinematics() call has elapsed.
+    */
+    void setMultiStartMode(int numSeeds, double perturbation = 0.3, double timeBudget = 0.012);
+
+    //! The number of the threads solving the restarts. Zero means the main thread only.
+    void setNumThreads(int n);
+
     /**
        this must be called before the initial calcInverseKinematics() call
        after settings have been changed.
@@ -9,6 +9,9 @@
 #include "BodyMotion.h"
 #include "ZMPSeq.h"
 #include "PoseProvider.h"
+#include <cnoid/ThreadPool>
+#include <thread>
+#include <cstdint>
 
 using namespace std;
 using namespace cnoid;
@@ -41,20 +44,109 @@ void PoseProviderToBodyMotionConverter::setAllLinkPositionOutput(bool on)
 }
 
 
+void PoseProviderToBodyMotionConverter::initializeMotion
+(Body* body, PoseProvider* provider, BodyMotion& motion, int& out_beginningFrame, int& out_endingFrame)
+{
+    const double frameRate = motion.frameRate();
+    out_beginningFrame = static_cast<int>(frameRate * std::max(provider->beginningTime(), lowerTime));
+    out_endingFrame = static_cast<int>(frameRate * std::min(provider->endingTime(), upperTime));
+    const int numLinksToPut = (allLinkPositionOutputMode ? body->numLinks() : 1);
+    
+    motion.setDimension(out_endingFrame + 1, body->numJoints(), numLinksToPut, true);
+    getOrCreateZMPSeq(motion);
+}
+
+
 bool PoseProviderToBodyMotionConverter::convert(Body* body, PoseProvider* provider, BodyMotion& motion)
+{
+    int beginningFrame, endingFrame;
+    initializeMotion(body, provider, motion, beginningFrame, endingFrame);
+
+    // store the original state
+    const int numJoints = body->numJoints();
+    Link* rootLink = body->rootLink();
+    vector<double> orgq(numJoints);
+    for(int i=0; i < numJoints; ++i){
+        orgq[i] = body->joint(i)->q();
+    }
+    Vector3 p0 = rootLink->p();
+    Matrix3 R0 = rootLink->R();
+
+    convertFrames(body, provider, motion, beginningFrame, endingFrame + 1);
+
+    // restore the original state
+    for(int i=0; i < numJoints; ++i){
+        body->joint(i)->q() = orgq[i];
+    }
+    rootLink->p() = p0;
+    rootLink->R() = R0;
+    body->calcForwardKinematics();
+
+    return true;
+}
+
+
+bool PoseProviderToBodyMotionConverter::convert
+(Body* body, PoseProviderFactory createProvider, BodyMotion& motion, int numThreads)
+{
+    // The number of frames that is not worth being converted by another thread
+    static const int minNumFramesPerThread = 100;
+    
+    auto provider = createProvider();
+    if(!provider){
+        return false;
+    }
+    int beginningFrame, endingFrame;
+    initializeMotion(body, provider.get(), motion, beginningFrame, endingFrame);
+    const int numFrames = endingFrame + 1 - beginningFrame;
+
+    if(numThreads <= 0){
+        numThreads = std::thread::hardware_concurrency();
+    }
+    numThreads = std::max(1, std::min(numThreads, numFrames / minNumFramesPerThread));
+
+    vector<BodyPtr> bodies(numThreads);
+    vector<shared_ptr<PoseProvider>> providers(numThreads);
+    for(int i=0; i < numThreads; ++i){
+        bodies[i] = body->clone();
+        providers[i] = (i == 0) ? provider : createProvider();
+        if(!providers[i]){
+            return false;
+        }
+    }
+
+    ThreadPool threadPool(numThreads - 1);
+    for(int i=0; i < numThreads; ++i){
+        const int frameBegin = beginningFrame + static_cast<int>(static_cast<int64_t>(numFrames) * i / numThreads);
+        const int frameEnd = beginningFrame + static_cast<int>(static_cast<int64_t>(numFrames) * (i + 1) / numThreads);
+        auto func = [this, &bodies, &providers, &motion, i, frameBegin, frameEnd](){
+            convertFrames(bodies[i], providers[i].get(), motion, frameBegin, frameEnd); };
+        if(i < numThreads - 1){
+            threadPool.start(func);
+        } else {
+            func();
+        }
+    }
+    threadPool.wait();
+
+    return true;
+}
+
+
+/**
+   This function only writes the frames in the range, so the function can be executed for
+   different ranges of the same motion in parallel.
+*/
+void PoseProviderToBodyMotionConverter::convertFrames
+(Body* body, PoseProvider* provider, BodyMotion& motion, int frameBegin, int frameEnd)
 {
     const double frameRate = motion.frameRate();
-    const int beginningFrame = static_cast<int>(frameRate * std::max(provider->beginningTime(), lowerTime));
-    const int endingFrame = static_cast<int>(frameRate * std::min(provider->endingTime(), upperTime));
     const int numJoints = body->numJoints();
     const int numLinksToPut = (allLinkPositionOutputMode ? body->numLinks() : 1);
     
-    motion.setDimension(endingFrame + 1, numJoints, numLinksToPut, true);
-
     MultiValueSeq& qseq = *motion.jointPosSeq();
     MultiSE3Seq& pseq = *motion.linkPosSeq();
-    ZMPSeq& zmpseq = *getOrCreateZMPSeq(motion);
-    bool isZmpValid = false;
+    ZMPSeq& zmpseq = *getZMPSeq(motion);
 
     Link* rootLink = body->rootLink();
     Link* baseLink = rootLink;
@@ -66,17 +158,9 @@ bool PoseProviderToBodyMotionConverter::convert(Body* body, PoseProvider* provid
         fkTraverse = make_shared<LinkPath>(baseLink, rootLink);
     }
 
-    // store the original state
-    vector<double> orgq(numJoints);
-    for(int i=0; i < numJoints; ++i){
-        orgq[i] = body->joint(i)->q();
-    }
-    Vector3 p0 = rootLink->p();
-    Matrix3 R0 = rootLink->R();
-
     std::vector<stdx::optional<double>> jointPositions(numJoints);
 
-    for(int frame = beginningFrame; frame <= endingFrame; ++frame){
+    for(int frame = frameBegin; frame < frameEnd; ++frame){
 
         provider->seek(frame / frameRate);
 
@@ -114,22 +198,6 @@ bool PoseProviderToBodyMotionConverter::convert(Body* body, PoseProvider* provid
         auto zmp = provider->ZMP();
         if(zmp){
             zmpseq[frame] = *zmp;
-            isZmpValid = true;
         }
-
     }
-
-    if(!isZmpValid){
-        //bodyMotionItem->clearRelativeZmpSeq();
-    }
-
-    // restore the original state
-    for(int i=0; i < numJoints; ++i){
-        body->joint(i)->q() = orgq[i];
-    }
-    rootLink->p() = p0;
-    rootLink->R() = R0;
-    body->calcForwardKinematics();
-
-    return true;
 }
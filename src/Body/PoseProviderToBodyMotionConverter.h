@@ -5,6 +5,8 @@
 #ifndef CNOID_BODY_POSE_PROVIDER_TO_BODY_MOTION_CONVERTER_H
 #define CNOID_BODY_POSE_PROVIDER_TO_BODY_MOTION_CONVERTER_H
 
+#include <functional>
+#include <memory>
 #include "exportdecl.h"
 
 namespace cnoid {
@@ -22,10 +24,23 @@ public:
     void setAllLinkPositionOutput(bool on);
     bool convert(Body* body, PoseProvider* provider, BodyMotion& motion);
 
+    /**
+       The frames are divided into the ranges converted by the worker threads. Each thread uses
+       a clone of the body and a pose provider created by the factory function, which is called
+       in the calling thread. The providers must be able to work independently of each other.
+       Zero threads means the number of the hardware threads.
+    */
+    typedef std::function<std::shared_ptr<PoseProvider>()> PoseProviderFactory;
+    bool convert(Body* body, PoseProviderFactory createProvider, BodyMotion& motion, int numThreads = 0);
+
 private:
     double lowerTime;
     double upperTime;
     bool allLinkPositionOutputMode;
+
+    void initializeMotion(
+        Body* body, PoseProvider* provider, BodyMotion& motion, int& out_beginningFrame, int& out_endingFrame);
+    void convertFrames(Body* body, PoseProvider* provider, BodyMotion& motion, int frameBegin, int frameEnd);
 };
 
 }
@@ -393,6 +393,12 @@ void SceneBody::updateModel()
 {
     setName(body_->name());
 
+    if(body_->isStaticModel()){
+        setAttribute(Static);
+    } else {
+        clearAttribute(Static);
+    }
+
     if(sceneLinks_.empty()){
         impl->sceneLinkGroup->clearChildren();
         sceneLinks_.clear();
@@ -0,0 +1,333 @@
+#include "SelfCollisionPairAnalyzer.h"
+#include "Body.h"
+#include "Link.h"
+#include <cnoid/AISTCollisionDetector>
+#include <cnoid/SceneGraph>
+#include <cnoid/ValueTree>
+#include <cnoid/MathUtil>
+#include <cnoid/YAMLReader>
+#include <cnoid/YAMLWriter>
+#include <cnoid/UTF8>
+#include <cnoid/stdx/filesystem>
+#include <fmt/format.h>
+#include <random>
+#include "gettext.h"
+
+using namespace std;
+using namespace cnoid;
+using fmt::format;
+namespace filesystem = cnoid::stdx::filesystem;
+
+namespace {
+
+const char* PairListKey = "never_colliding_link_pairs";
+
+}
+
+namespace cnoid {
+
+class SelfCollisionPairAnalyzer::Impl
+{
+public:
+    CollisionDetectorPtr collisionDetector;
+    int numSamples;
+    double margin;
+    mt19937 randomEngine;
+    string bodyName;
+    vector<LinkNamePair> pairs;
+
+    Impl();
+    bool analyze(Body* orgBody);
+    double sampleJointDisplacement(Link* joint);
+    ListingPtr createPairListing() const;
+};
+
+}
+
+
+SelfCollisionPairAnalyzer::SelfCollisionPairAnalyzer()
+{
+    impl = new Impl;
+}
+
+
+SelfCollisionPairAnalyzer::Impl::Impl()
+{
+    numSamples = 5000;
+    margin = 0.01;
+}
+
+
+SelfCollisionPairAnalyzer::~SelfCollisionPairAnalyzer()
+{
+    delete impl;
+}
+
+
+void SelfCollisionPairAnalyzer::setCollisionDetector(CollisionDetector* detector)
+{
+    impl->collisionDetector = detector;
+}
+
+
+void SelfCollisionPairAnalyzer::setNumSamples(int n)
+{
+    impl->numSamples = n;
+}
+
+
+int SelfCollisionPairAnalyzer::numSamples() const
+{
+    return impl->numSamples;
+}
+
+
+void SelfCollisionPairAnalyzer::setMargin(double margin)
+{
+    impl->margin = margin;
+}
+
+
+double SelfCollisionPairAnalyzer::margin() const
+{
+    return impl->margin;
+}
+
+
+void SelfCollisionPairAnalyzer::setRandomSeed(unsigned int seed)
+{
+    impl->randomEngine.seed(seed);
+}
+
+
+bool SelfCollisionPairAnalyzer::analyze(Body* body)
+{
+    return impl->analyze(body);
+}
+
+
+/**
+   All the link pairs are checked including the adjacent ones, which usually collide and are not
+   included in the result, so that the result does not depend on the rules of the body.
+   The first sample is the current pose of the body. The distances of the pairs that have not
+   collided yet are checked with the margin when the detector supports the distance API.
+*/
+bool SelfCollisionPairAnalyzer::Impl::analyze(Body* orgBody)
+{
+    pairs.clear();
+    bodyName = orgBody->modelName();
+
+    BodyPtr body = orgBody->clone();
+    CollisionDetectorPtr detector;
+    if(collisionDetector){
+        detector = collisionDetector->clone();
+    } else {
+        detector = new AISTCollisionDetector;
+    }
+
+    const int numLinks = body->numLinks();
+    vector<pair<Link*, CollisionDetector::GeometryHandle>> geometries;
+    for(auto& link : body->links()){
+        if(auto handle = detector->addGeometry(link->collisionShape())){
+            detector->setCustomObject(*handle, link);
+            geometries.emplace_back(link, *handle);
+        }
+    }
+    if(geometries.size() < 2 || !detector->makeReady()){
+        return false;
+    }
+
+    vector<bool> collisionFlags(numLinks * numLinks, false);
+
+    auto distanceAPI = dynamic_cast<CollisionDetectorDistanceAPI*>(detector.get());
+    if(margin <= 0.0){
+        distanceAPI = nullptr;
+    }
+    typedef CollisionDetectorDistanceAPI::DistanceQuery DistanceQuery;
+    vector<DistanceQuery> distanceQueries;
+    vector<int> queryPairIndices;
+    const int numGeometries = geometries.size();
+
+    for(int i=0; i < numSamples; ++i){
+        if(i > 0){
+            for(auto& joint : body->joints()){
+                joint->q() = sampleJointDisplacement(joint);
+            }
+        }
+        body->calcForwardKinematics();
+        for(auto& geometry : geometries){
+            detector->updatePosition(geometry.second, geometry.first->T());
+        }
+        detector->detectCollisions(
+            [&](const CollisionPair& collisionPair){
+                int index1 = static_cast<Link*>(collisionPair.object(0))->index();
+                int index2 = static_cast<Link*>(collisionPair.object(1))->index();
+                collisionFlags[index1 * numLinks + index2] = true;
+                collisionFlags[index2 * numLinks + index1] = true;
+            });
+
+        if(distanceAPI){
+            distanceQueries.clear();
+            queryPairIndices.clear();
+            for(int j=0; j < numGeometries; ++j){
+                const int index1 = geometries[j].first->index();
+                for(int k = j + 1; k < numGeometries; ++k){
+                    const int index2 = geometries[k].first->index();
+                    if(!collisionFlags[index1 * numLinks + index2]){
+                        distanceQueries.emplace_back(geometries[j].second, geometries[k].second);
+                        queryPairIndices.push_back(index1 * numLinks + index2);
+                    }
+                }
+            }
+            distanceAPI->detectDistances(distanceQueries, margin);
+            for(size_t j=0; j < distanceQueries.size(); ++j){
+                if(distanceQueries[j].distance <= margin){
+                    const int pairIndex = queryPairIndices[j];
+                    collisionFlags[pairIndex] = true;
+                    collisionFlags[(pairIndex % numLinks) * numLinks + pairIndex / numLinks] = true;
+                }
+            }
+        }
+    }
+
+    for(int i=0; i < numGeometries; ++i){
+        auto link1 = geometries[i].first;
+        for(int j = i + 1; j < numGeometries; ++j){
+            auto link2 = geometries[j].first;
+            if(!collisionFlags[link1->index() * numLinks + link2->index()]){
+                pairs.emplace_back(link1->name(), link2->name());
+            }
+        }
+    }
+
+    return true;
+}
+
+
+/**
+   The displacements of the joints without finite limits are sampled in one turn for the
+   revolute joints and kept unchanged for the prismatic joints.
+*/
+double SelfCollisionPairAnalyzer::Impl::sampleJointDisplacement(Link* joint)
+{
+    double lower = joint->q_lower();
+    double upper = joint->q_upper();
+    if(joint->isRevoluteJoint()){
+        lower = std::max(lower, -PI);
+        upper = std::min(upper, PI);
+    } else if(!joint->isPrismaticJoint() ||
+              lower <= -std::numeric_limits<double>::max() || upper >= std::numeric_limits<double>::max()){
+        return joint->q();
+    }
+    if(lower >= upper){
+        return joint->q();
+    }
+    return std::uniform_real_distribution<double>(lower, upper)(randomEngine);
+}
+
+
+const std::vector<SelfCollisionPairAnalyzer::LinkNamePair>& SelfCollisionPairAnalyzer::neverCollidingLinkPairs() const
+{
+    return impl->pairs;
+}
+
+
+ListingPtr SelfCollisionPairAnalyzer::Impl::createPairListing() const
+{
+    ListingPtr listing = new Listing;
+    for(auto& pair : pairs){
+        ListingPtr pairNode = new Listing;
+        pairNode->setFlowStyle();
+        pairNode->append(pair.first, DOUBLE_QUOTED);
+        pairNode->append(pair.second, DOUBLE_QUOTED);
+        listing->append(pairNode);
+    }
+    return listing;
+}
+
+
+void SelfCollisionPairAnalyzer::apply(Body* body) const
+{
+    body->info()->insert(PairListKey, impl->createPairListing());
+}
+
+
+bool SelfCollisionPairAnalyzer::save(const std::string& filename, std::ostream& os) const
+{
+    YAMLWriter writer;
+    if(!writer.openFile(filename)){
+        os << format(_("\"{}\" cannot be opened."), filename) << endl;
+        return false;
+    }
+    writer.setKeyOrderPreservationMode(true);
+
+    MappingPtr topNode = new Mapping;
+    topNode->write("type", "SelfCollisionPairs");
+    topNode->write("format_version", 1.0);
+    topNode->write("body", impl->bodyName, DOUBLE_QUOTED);
+    topNode->write("num_samples", impl->numSamples);
+    topNode->insert(PairListKey, impl->createPairListing());
+    writer.putNode(topNode);
+
+    return true;
+}
+
+
+bool SelfCollisionPairAnalyzer::load(const std::string& filename, std::ostream& os)
+{
+    impl->pairs.clear();
+
+    bool result = false;
+    try {
+        YAMLReader reader;
+        MappingPtr topNode = reader.loadDocument(filename)->toMapping();
+        if(topNode->get("type", "") != "SelfCollisionPairs"){
+            os << format(_("\"{}\" is not a file of the self-collision pairs."), filename) << endl;
+        } else {
+            topNode->read("body", impl->bodyName);
+            topNode->read("num_samples", impl->numSamples);
+            auto& pairList = *topNode->findListing(PairListKey);
+            if(pairList.isValid()){
+                for(auto& node : pairList){
+                    auto& pairNode = *node->toListing();
+                    if(pairNode.size() == 2){
+                        impl->pairs.emplace_back(pairNode[0].toString(), pairNode[1].toString());
+                    }
+                }
+            }
+            result = true;
+        }
+    } catch(const ValueNode::Exception& ex){
+        os << ex.message();
+    }
+
+    return result;
+}
+
+
+std::string SelfCollisionPairAnalyzer::getDefaultFilename(const std::string& bodyFilename)
+{
+    filesystem::path path(fromUTF8(bodyFilename));
+    path.replace_extension(".self_collision.yaml");
+    return toUTF8(path.string());
+}
+
+
+bool SelfCollisionPairAnalyzer::loadDefaultFileAndApply
+(Body* body, const std::string& bodyFilename, std::ostream& os)
+{
+    filesystem::path bodyPath(fromUTF8(bodyFilename));
+    filesystem::path path(fromUTF8(getDefaultFilename(bodyFilename)));
+
+    stdx::error_code ec;
+    if(!filesystem::exists(path, ec) ||
+       filesystem::last_write_time(path, ec) < filesystem::last_write_time(bodyPath, ec)){
+        return false;
+    }
+    SelfCollisionPairAnalyzer analyzer;
+    if(!analyzer.load(toUTF8(path.string()), os)){
+        return false;
+    }
+    analyzer.apply(body);
+    return true;
+}
@@ -0,0 +1,69 @@
+#ifndef CNOID_BODY_SELF_COLLISION_PAIR_ANALYZER_H
+#define CNOID_BODY_SELF_COLLISION_PAIR_ANALYZER_H
+
+#include <cnoid/CollisionDetector>
+#include <string>
+#include <vector>
+#include <utility>
+#include <iosfwd>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+class Body;
+
+/**
+   This class finds the link pairs of a body that never collide with each other in the ranges of
+   the joint displacements by sampling the joint space. BodyCollisionDetector excludes the pairs
+   from the self-collision detection when the result is applied to the body, and BodyLoader applies
+   the result saved with the default filename next to the body file when the body is loaded.
+   \note The pairs are found by random sampling, so a pair that collides only in a small region
+   of the joint space may be included. Increase the number of samples for such a body.
+*/
+class CNOID_EXPORT SelfCollisionPairAnalyzer
+{
+public:
+    SelfCollisionPairAnalyzer();
+    ~SelfCollisionPairAnalyzer();
+
+    //! A clone of the detector is used for the analysis. AISTCollisionDetector is used by default.
+    void setCollisionDetector(CollisionDetector* detector);
+    void setNumSamples(int n);
+    int numSamples() const;
+
+    /**
+       The pairs that come closer than this distance in a sample are regarded as colliding ones
+       to compensate for the sparseness of the samples. The default value is 0.01.
+    */
+    void setMargin(double margin);
+    double margin() const;
+    void setRandomSeed(unsigned int seed);
+
+    bool analyze(Body* body);
+
+    typedef std::pair<std::string, std::string> LinkNamePair;
+    const std::vector<LinkNamePair>& neverCollidingLinkPairs() const;
+
+    //! The pairs are set to the info of the body as "never_colliding_link_pairs"
+    void apply(Body* body) const;
+
+    bool save(const std::string& filename, std::ostream& os) const;
+    bool load(const std::string& filename, std::ostream& os);
+
+    static std::string getDefaultFilename(const std::string& bodyFilename);
+
+    /**
+       Loads the result saved with the default filename of the body file and applies it to the
+       body if the result file is not older than the body file.
+       \return true if the result is applied
+    */
+    static bool loadDefaultFileAndApply(Body* body, const std::string& bodyFilename, std::ostream& os);
+
+private:
+    class Impl;
+    Impl* impl;
+};
+
+}
+
+#endif
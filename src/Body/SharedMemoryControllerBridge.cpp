@@ -0,0 +1,863 @@
+#include "SharedMemoryControllerBridge.h"
+#include "Body.h"
+#include "Link.h"
+#include "Device.h"
+#include <cnoid/ConnectionSet>
+#include <atomic>
+#include <new>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <cstring>
+#include <cerrno>
+#include <climits>
+#include <fmt/format.h>
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#endif
+#include "gettext.h"
+
+using namespace std;
+using namespace cnoid;
+using fmt::format;
+
+namespace {
+
+const uint32_t MagicNumber = 0x43534d43; // "CMSC"
+const uint32_t FormatVersion = 1;
+
+static_assert(ATOMIC_INT_LOCK_FREE == 2, "The atomic counters in the shared memory must be lock-free.");
+
+enum HostStatus { HostInactive = 0, HostActive, HostClosed };
+enum ControllerStatus { ControllerDetached = 0, ControllerReady };
+
+/*
+  The counters written by different sides are put in different cache lines
+  to avoid the false sharing between the processes.
+*/
+struct Header
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t numLinks;
+    uint32_t numDevices;
+    uint32_t deviceStateSize;
+    uint32_t bodyStructureHash;
+    uint64_t memorySize;
+    double timeStep;
+    std::atomic<uint32_t> hostStatus;
+    std::atomic<uint32_t> controllerStatus;
+    std::atomic<uint32_t> controllerReadyCounter;
+
+    // Futex words
+    alignas(64) std::atomic<uint32_t> requestCounter;
+    alignas(64) std::atomic<uint32_t> finishCounter;
+    std::atomic<uint32_t> controlResult;
+
+    // Sequence counters of the seqlocks of the input and output regions
+    alignas(64) std::atomic<uint32_t> inputSequence;
+    alignas(64) std::atomic<uint32_t> outputSequence;
+};
+
+struct LinkConfig
+{
+    uint32_t inputStateFlags;
+    uint32_t outputStateFlags;
+};
+
+struct LinkState
+{
+    double q;
+    double dq;
+    double ddq;
+    double u;
+    double q_target;
+    double dq_target;
+    double p[3];
+    double R[9];
+    double v[3];
+    double w[3];
+    double F_ext[6];
+};
+
+size_t alignSize(size_t size, size_t alignment)
+{
+    return (size + alignment - 1) / alignment * alignment;
+}
+
+uint32_t addHash(uint32_t hash, const void* data, size_t size)
+{
+    // FNV-1a
+    auto bytes = static_cast<const unsigned char*>(data);
+    for(size_t i=0; i < size; ++i){
+        hash ^= bytes[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+uint32_t calcBodyStructureHash(Body* body)
+{
+    uint32_t hash = 2166136261u;
+    for(auto& link : body->links()){
+        hash = addHash(hash, link->name().data(), link->name().size());
+        int jointType = link->jointType();
+        hash = addHash(hash, &jointType, sizeof(jointType));
+    }
+    for(auto& device : body->devices()){
+        hash = addHash(hash, device->name().data(), device->name().size());
+        int size = device->stateSize();
+        hash = addHash(hash, &size, sizeof(size));
+    }
+    return hash;
+}
+
+void waitOnFutex(std::atomic<uint32_t>& word, uint32_t value, double timeout)
+{
+#ifdef __linux__
+    timespec ts;
+    timespec* pts = nullptr;
+    if(timeout >= 0.0){
+        ts.tv_sec = static_cast<time_t>(timeout);
+        ts.tv_nsec = static_cast<long>((timeout - ts.tv_sec) * 1.0e9);
+        pts = &ts;
+    }
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAIT, value, pts, nullptr, 0);
+#else
+    std::this_thread::yield();
+#endif
+}
+
+void wakeFutex(std::atomic<uint32_t>& word)
+{
+#ifdef __linux__
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+#endif
+}
+
+void beginSeqlockWrite(std::atomic<uint32_t>& sequence)
+{
+    sequence.store(sequence.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+}
+
+void endSeqlockWrite(std::atomic<uint32_t>& sequence)
+{
+    sequence.store(sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+void readWithSeqlock(std::atomic<uint32_t>& sequence, void* dest, const void* src, size_t size)
+{
+    while(true){
+        uint32_t s = sequence.load(std::memory_order_acquire);
+        if(s & 1){
+            std::this_thread::yield();
+            continue;
+        }
+        memcpy(dest, src, size);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if(sequence.load(std::memory_order_relaxed) == s){
+            break;
+        }
+    }
+}
+
+}
+
+namespace cnoid {
+
+class SharedMemoryControllerBridge::Impl
+{
+public:
+    string shmName;
+    Body* body;
+    bool isSimulatorSide;
+    char* memory;
+    size_t memorySize;
+    Header* header;
+    LinkConfig* linkConfigs;
+
+    /*
+      Each of the input and output regions consists of the time, the change counters of the devices,
+      the link states and the device states in this order.
+    */
+    size_t regionSize;
+    size_t deviceCounterOffset;
+    size_t linkStateOffset;
+    size_t deviceStateOffset;
+    char* inputRegion;
+    char* outputRegion;
+    vector<double> regionBuf;
+    vector<int> deviceStateOffsets;
+    int deviceStateSize;
+
+    // Links whose states are sent and received by this side
+    vector<Link*> linksToSend;
+    vector<Link*> linksToReceive;
+    vector<int> sendingStateFlags;
+    vector<int> receivingStateFlags;
+
+    vector<uint32_t> receivedDeviceCounters;
+    vector<bool> deviceStateChangeFlags;
+    vector<int> changedDeviceIndices;
+    ScopedConnectionSet deviceStateConnections;
+
+    uint32_t lastControllerReadyCounter;
+    uint32_t currentRequest;
+    double currentTime;
+    string errorMessage;
+
+    Impl();
+    ~Impl();
+    void initializeLayout(Body* body);
+    void setupPointers();
+    void connectDeviceStateSignals();
+    void onDeviceStateChanged(int deviceIndex);
+    void setAllLinksForInitialStates(vector<Link*>& links, vector<int>& stateFlags);
+    bool create(const string& name, Body* body, double timeStep);
+    bool open(const string& name, Body* body);
+    void close();
+    void writeRegion(char* region, std::atomic<uint32_t>& sequence, bool isInput, double time);
+    void readRegion(char* region, std::atomic<uint32_t>& sequence, bool isInput);
+};
+
+}
+
+
+SharedMemoryControllerBridge::SharedMemoryControllerBridge()
+{
+    impl = new Impl;
+}
+
+
+SharedMemoryControllerBridge::Impl::Impl()
+{
+    body = nullptr;
+    isSimulatorSide = false;
+    memory = nullptr;
+    memorySize = 0;
+    header = nullptr;
+    currentTime = 0.0;
+}
+
+
+SharedMemoryControllerBridge::~SharedMemoryControllerBridge()
+{
+    delete impl;
+}
+
+
+SharedMemoryControllerBridge::Impl::~Impl()
+{
+    close();
+}
+
+
+void SharedMemoryControllerBridge::Impl::initializeLayout(Body* body)
+{
+    this->body = body;
+
+    const int numLinks = body->numLinks();
+    const int numDevices = body->numDevices();
+    deviceStateOffsets.resize(numDevices);
+    deviceStateSize = 0;
+    for(int i=0; i < numDevices; ++i){
+        deviceStateOffsets[i] = deviceStateSize;
+        deviceStateSize += body->device(i)->stateSize();
+    }
+
+    deviceCounterOffset = sizeof(double);
+    linkStateOffset = alignSize(deviceCounterOffset + numDevices * sizeof(uint32_t), sizeof(double));
+    deviceStateOffset = linkStateOffset + numLinks * sizeof(LinkState);
+    regionSize = alignSize(deviceStateOffset + deviceStateSize * sizeof(double), 64);
+    regionBuf.resize(regionSize / sizeof(double));
+
+    size_t linkConfigOffset = alignSize(sizeof(Header), 64);
+    size_t inputRegionOffset = alignSize(linkConfigOffset + numLinks * sizeof(LinkConfig), 64);
+    memorySize = inputRegionOffset + regionSize * 2;
+
+    receivedDeviceCounters.assign(numDevices, 0);
+    deviceStateChangeFlags.assign(numDevices, false);
+    changedDeviceIndices.clear();
+    linksToSend.clear();
+    linksToReceive.clear();
+    sendingStateFlags.clear();
+    receivingStateFlags.clear();
+}
+
+
+void SharedMemoryControllerBridge::Impl::setupPointers()
+{
+    header = reinterpret_cast<Header*>(memory);
+    size_t linkConfigOffset = alignSize(sizeof(Header), 64);
+    linkConfigs = reinterpret_cast<LinkConfig*>(memory + linkConfigOffset);
+    inputRegion = memory + alignSize(linkConfigOffset + body->numLinks() * sizeof(LinkConfig), 64);
+    outputRegion = inputRegion + regionSize;
+}
+
+
+void SharedMemoryControllerBridge::Impl::connectDeviceStateSignals()
+{
+    deviceStateConnections.disconnect();
+    const int numDevices = body->numDevices();
+    for(int i=0; i < numDevices; ++i){
+        deviceStateConnections.add(
+            body->device(i)->sigStateChanged().connect(
+                [this, i](){ onDeviceStateChanged(i); }));
+    }
+}
+
+
+void SharedMemoryControllerBridge::Impl::onDeviceStateChanged(int deviceIndex)
+{
+    if(!deviceStateChangeFlags[deviceIndex]){
+        deviceStateChangeFlags[deviceIndex] = true;
+        changedDeviceIndices.push_back(deviceIndex);
+    }
+}
+
+
+/**
+   The initial states of all the links are put in the input region when it is created so that the
+   controller can refer to them in its initialization, which is done before the controller specifies
+   the links to input.
+*/
+void SharedMemoryControllerBridge::Impl::setAllLinksForInitialStates(vector<Link*>& links, vector<int>& stateFlags)
+{
+    const int flags = Link::JointDisplacement | Link::JointVelocity | Link::LinkPosition | Link::LinkTwist;
+    links.clear();
+    stateFlags.clear();
+    for(auto& link : body->links()){
+        links.push_back(link);
+        stateFlags.push_back(flags);
+    }
+}
+
+
+bool SharedMemoryControllerBridge::create(const std::string& name, Body* body, double timeStep)
+{
+    return impl->create(name, body, timeStep);
+}
+
+
+bool SharedMemoryControllerBridge::Impl::create(const string& name, Body* body, double timeStep)
+{
+    close();
+    errorMessage.clear();
+
+#ifdef _WIN32
+    errorMessage = _("The shared memory controller bridge is not supported on this platform.");
+    return false;
+#else
+    shmName = (name.empty() || name[0] != '/') ? ("/" + name) : name;
+    initializeLayout(body);
+
+    ::shm_unlink(shmName.c_str());
+    int fd = ::shm_open(shmName.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if(fd < 0){
+        errorMessage = format(_("Shared memory \"{0}\" cannot be created: {1}"), shmName, strerror(errno));
+        return false;
+    }
+    if(::ftruncate(fd, memorySize) != 0){
+        errorMessage = format(_("Shared memory \"{0}\" cannot be resized: {1}"), shmName, strerror(errno));
+        ::close(fd);
+        ::shm_unlink(shmName.c_str());
+        return false;
+    }
+    void* p = ::mmap(nullptr, memorySize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if(p == MAP_FAILED){
+        errorMessage = format(_("Shared memory \"{0}\" cannot be mapped: {1}"), shmName, strerror(errno));
+        ::shm_unlink(shmName.c_str());
+        return false;
+    }
+    memory = static_cast<char*>(p);
+    isSimulatorSide = true;
+    setupPointers();
+
+    // The mapped memory is zero-filled
+    header = new(memory) Header;
+    header->magic = MagicNumber;
+    header->version = FormatVersion;
+    header->numLinks = body->numLinks();
+    header->numDevices = body->numDevices();
+    header->deviceStateSize = deviceStateSize;
+    header->bodyStructureHash = calcBodyStructureHash(body);
+    header->memorySize = memorySize;
+    header->timeStep = timeStep;
+    header->controllerStatus.store(ControllerDetached);
+    header->controllerReadyCounter.store(0);
+    header->requestCounter.store(0);
+    header->finishCounter.store(0);
+    header->inputSequence.store(0);
+    header->outputSequence.store(0);
+    header->hostStatus.store(HostActive, std::memory_order_release);
+
+    lastControllerReadyCounter = 0;
+    currentRequest = 0;
+    currentTime = 0.0;
+
+    connectDeviceStateSignals();
+    for(int i=0; i < body->numDevices(); ++i){
+        onDeviceStateChanged(i);
+    }
+    setAllLinksForInitialStates(linksToSend, sendingStateFlags);
+    writeRegion(inputRegion, header->inputSequence, true, 0.0);
+    linksToSend.clear();
+    sendingStateFlags.clear();
+
+    return true;
+#endif
+}
+
+
+bool SharedMemoryControllerBridge::open(const std::string& name, Body* body)
+{
+    return impl->open(name, body);
+}
+
+
+bool SharedMemoryControllerBridge::Impl::open(const string& name, Body* body)
+{
+    close();
+    errorMessage.clear();
+
+#ifdef _WIN32
+    errorMessage = _("The shared memory controller bridge is not supported on this platform.");
+    return false;
+#else
+    string shmName = (name.empty() || name[0] != '/') ? ("/" + name) : name;
+    initializeLayout(body);
+
+    int fd = ::shm_open(shmName.c_str(), O_RDWR, 0);
+    if(fd < 0){
+        errorMessage = format(_("Shared memory \"{0}\" cannot be opened: {1}"), shmName, strerror(errno));
+        return false;
+    }
+    struct stat st;
+    if(::fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(Header)){
+        errorMessage = format(_("Shared memory \"{}\" is not initialized."), shmName);
+        ::close(fd);
+        return false;
+    }
+    void* p = ::mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if(p == MAP_FAILED){
+        errorMessage = format(_("Shared memory \"{0}\" cannot be mapped: {1}"), shmName, strerror(errno));
+        return false;
+    }
+    memory = static_cast<char*>(p);
+    size_t mappedSize = st.st_size;
+    header = reinterpret_cast<Header*>(memory);
+
+    if(header->magic != MagicNumber || header->version != FormatVersion){
+        errorMessage = format(_("Shared memory \"{}\" is not a controller bridge of this version."), shmName);
+    } else if(header->hostStatus.load(std::memory_order_acquire) != HostActive){
+        errorMessage = format(_("The simulator of shared memory \"{}\" is not active."), shmName);
+    } else if(header->memorySize != memorySize || mappedSize < memorySize ||
+              header->bodyStructureHash != calcBodyStructureHash(body)){
+        errorMessage = format(_("The body of shared memory \"{0}\" is different from {1}."), shmName, body->name());
+    } else if(header->controllerStatus.load() != ControllerDetached){
+        errorMessage = format(_("Another controller is attached to shared memory \"{}\"."), shmName);
+    }
+    if(!errorMessage.empty()){
+        ::munmap(memory, mappedSize);
+        memory = nullptr;
+        header = nullptr;
+        return false;
+    }
+
+    this->shmName = shmName;
+    isSimulatorSide = false;
+    setupPointers();
+    currentRequest = header->requestCounter.load(std::memory_order_acquire);
+    connectDeviceStateSignals();
+    setAllLinksForInitialStates(linksToReceive, receivingStateFlags);
+    readRegion(inputRegion, header->inputSequence, true);
+    linksToReceive.clear();
+    receivingStateFlags.clear();
+
+    return true;
+#endif
+}
+
+
+void SharedMemoryControllerBridge::close()
+{
+    impl->close();
+}
+
+
+void SharedMemoryControllerBridge::Impl::close()
+{
+    if(!memory){
+        return;
+    }
+    deviceStateConnections.disconnect();
+
+#ifndef _WIN32
+    if(isSimulatorSide){
+        header->hostStatus.store(HostClosed, std::memory_order_release);
+        header->requestCounter.fetch_add(1, std::memory_order_release);
+        wakeFutex(header->requestCounter);
+        ::munmap(memory, memorySize);
+        ::shm_unlink(shmName.c_str());
+    } else {
+        header->controllerStatus.store(ControllerDetached, std::memory_order_release);
+        wakeFutex(header->finishCounter);
+        ::munmap(memory, memorySize);
+    }
+#endif
+
+    memory = nullptr;
+    header = nullptr;
+    body = nullptr;
+}
+
+
+bool SharedMemoryControllerBridge::isOpen() const
+{
+    return impl->memory != nullptr;
+}
+
+
+bool SharedMemoryControllerBridge::isSimulatorSide() const
+{
+    return impl->isSimulatorSide;
+}
+
+
+const std::string& SharedMemoryControllerBridge::errorMessage() const
+{
+    return impl->errorMessage;
+}
+
+
+double SharedMemoryControllerBridge::timeStep() const
+{
+    return impl->header ? impl->header->timeStep : 0.0;
+}
+
+
+double SharedMemoryControllerBridge::currentTime() const
+{
+    return impl->currentTime;
+}
+
+
+void SharedMemoryControllerBridge::setLinkIO(int linkIndex, int inputStateFlags, int outputStateFlags)
+{
+    auto& config = impl->linkConfigs[linkIndex];
+    config.inputStateFlags = inputStateFlags;
+    config.outputStateFlags = outputStateFlags;
+}
+
+
+void SharedMemoryControllerBridge::setControllerReady()
+{
+    auto body = impl->body;
+    impl->linksToSend.clear();
+    impl->sendingStateFlags.clear();
+    impl->linksToReceive.clear();
+    impl->receivingStateFlags.clear();
+    for(int i=0; i < body->numLinks(); ++i){
+        auto& config = impl->linkConfigs[i];
+        if(config.outputStateFlags){
+            impl->linksToSend.push_back(body->link(i));
+            impl->sendingStateFlags.push_back(config.outputStateFlags);
+        }
+        if(config.inputStateFlags){
+            impl->linksToReceive.push_back(body->link(i));
+            impl->receivingStateFlags.push_back(config.inputStateFlags);
+        }
+    }
+    auto header = impl->header;
+    impl->currentRequest = header->requestCounter.load(std::memory_order_acquire);
+    header->controllerReadyCounter.fetch_add(1, std::memory_order_release);
+    header->controllerStatus.store(ControllerReady, std::memory_order_release);
+}
+
+
+/**
+   \param timeout The time to wait in seconds. The function waits until the request comes
+   if the value is negative.
+*/
+SharedMemoryControllerBridge::WaitResult SharedMemoryControllerBridge::waitForControlRequest(double timeout)
+{
+    auto header = impl->header;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::duration<double>(timeout);
+    while(true){
+        uint32_t request = header->requestCounter.load(std::memory_order_acquire);
+        if(header->hostStatus.load(std::memory_order_acquire) != HostActive){
+            return Closed;
+        }
+        if(request != impl->currentRequest){
+            impl->currentRequest = request;
+            return Completed;
+        }
+        double remainingTime = -1.0;
+        if(timeout >= 0.0){
+            remainingTime = std::chrono::duration<double>(deadline - std::chrono::steady_clock::now()).count();
+            if(remainingTime <= 0.0){
+                return Timeout;
+            }
+        }
+        waitOnFutex(header->requestCounter, request, remainingTime);
+    }
+}
+
+
+void SharedMemoryControllerBridge::readInput()
+{
+    impl->readRegion(impl->inputRegion, impl->header->inputSequence, true);
+}
+
+
+void SharedMemoryControllerBridge::writeOutput()
+{
+    impl->writeRegion(impl->outputRegion, impl->header->outputSequence, false, impl->currentTime);
+}
+
+
+void SharedMemoryControllerBridge::notifyControlFinished(bool doContinue)
+{
+    auto header = impl->header;
+    header->controlResult.store(doContinue ? 1 : 0, std::memory_order_relaxed);
+    header->finishCounter.store(impl->currentRequest, std::memory_order_release);
+    wakeFutex(header->finishCounter);
+}
+
+
+bool SharedMemoryControllerBridge::checkControllerReady()
+{
+    auto header = impl->header;
+    if(header->controllerStatus.load(std::memory_order_acquire) != ControllerReady){
+        return false;
+    }
+    uint32_t counter = header->controllerReadyCounter.load(std::memory_order_acquire);
+    if(counter == impl->lastControllerReadyCounter){
+        return false;
+    }
+    impl->lastControllerReadyCounter = counter;
+
+    auto body = impl->body;
+    impl->linksToSend.clear();
+    impl->sendingStateFlags.clear();
+    impl->linksToReceive.clear();
+    impl->receivingStateFlags.clear();
+    for(int i=0; i < body->numLinks(); ++i){
+        auto link = body->link(i);
+        auto& config = impl->linkConfigs[i];
+        if(config.inputStateFlags){
+            link->mergeSensingMode(config.inputStateFlags);
+            impl->linksToSend.push_back(link);
+            impl->sendingStateFlags.push_back(config.inputStateFlags);
+        }
+        if(config.outputStateFlags){
+            link->setActuationMode(config.outputStateFlags);
+            impl->linksToReceive.push_back(link);
+            impl->receivingStateFlags.push_back(config.outputStateFlags);
+        }
+    }
+
+    // The current states of all the devices are sent to the new controller
+    for(int i=0; i < body->numDevices(); ++i){
+        impl->onDeviceStateChanged(i);
+    }
+    return true;
+}
+
+
+bool SharedMemoryControllerBridge::isControllerReady() const
+{
+    return impl->header &&
+        impl->header->controllerStatus.load(std::memory_order_acquire) == ControllerReady;
+}
+
+
+void SharedMemoryControllerBridge::writeInput(double time)
+{
+    impl->currentTime = time;
+    impl->writeRegion(impl->inputRegion, impl->header->inputSequence, true, time);
+}
+
+
+void SharedMemoryControllerBridge::requestControl()
+{
+    auto header = impl->header;
+    impl->currentRequest = header->requestCounter.fetch_add(1, std::memory_order_release) + 1;
+    wakeFutex(header->requestCounter);
+}
+
+
+SharedMemoryControllerBridge::WaitResult SharedMemoryControllerBridge::waitForControlToFinish
+(double timeout, bool& out_doContinue)
+{
+    auto header = impl->header;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::duration<double>(timeout);
+    while(true){
+        uint32_t finished = header->finishCounter.load(std::memory_order_acquire);
+        if(finished == impl->currentRequest){
+            out_doContinue = header->controlResult.load(std::memory_order_relaxed);
+            return Completed;
+        }
+        if(header->controllerStatus.load(std::memory_order_acquire) != ControllerReady){
+            return Closed;
+        }
+        double remainingTime = std::chrono::duration<double>(deadline - std::chrono::steady_clock::now()).count();
+        if(remainingTime <= 0.0){
+            return Timeout;
+        }
+        waitOnFutex(header->finishCounter, finished, remainingTime);
+    }
+}
+
+
+void SharedMemoryControllerBridge::readOutput()
+{
+    impl->readRegion(impl->outputRegion, impl->header->outputSequence, false);
+}
+
+
+/**
+   The input region is written by the simulator side with the sensed states, and the output region
+   is written by the controller side with the commands.
+*/
+void SharedMemoryControllerBridge::Impl::writeRegion
+(char* region, std::atomic<uint32_t>& sequence, bool isInput, double time)
+{
+    beginSeqlockWrite(sequence);
+
+    *reinterpret_cast<double*>(region) = time;
+
+    auto states = reinterpret_cast<LinkState*>(region + linkStateOffset);
+    const int n = linksToSend.size();
+    for(int i=0; i < n; ++i){
+        auto link = linksToSend[i];
+        const int flags = sendingStateFlags[i];
+        auto& state = states[link->index()];
+        if(flags & Link::JointDisplacement){
+            if(isInput){
+                state.q = link->q();
+            } else {
+                state.q_target = link->q_target();
+            }
+        }
+        if(flags & (Link::JointVelocity | Link::DeprecatedJointSurfaceVelocity)){
+            if(isInput){
+                state.dq = link->dq();
+            } else {
+                state.dq_target = link->dq_target();
+            }
+        }
+        if(flags & Link::JointAcceleration){
+            state.ddq = link->ddq();
+        }
+        if(flags & Link::JointEffort){
+            state.u = link->u();
+        }
+        if(flags & Link::LinkPosition){
+            Eigen::Map<Vector3>(state.p) = link->p();
+            Eigen::Map<Matrix3>(state.R) = link->R();
+        }
+        if(flags & Link::LinkTwist){
+            Eigen::Map<Vector3>(state.v) = link->v();
+            Eigen::Map<Vector3>(state.w) = link->w();
+        }
+        if(flags & Link::LinkExtWrench){
+            Eigen::Map<Vector6>(state.F_ext) = link->F_ext();
+        }
+    }
+
+    if(!changedDeviceIndices.empty()){
+        auto counters = reinterpret_cast<uint32_t*>(region + deviceCounterOffset);
+        auto deviceStates = reinterpret_cast<double*>(region + deviceStateOffset);
+        for(auto& index : changedDeviceIndices){
+            body->device(index)->writeState(deviceStates + deviceStateOffsets[index]);
+            ++counters[index];
+            deviceStateChangeFlags[index] = false;
+        }
+        changedDeviceIndices.clear();
+    }
+
+    endSeqlockWrite(sequence);
+}
+
+
+void SharedMemoryControllerBridge::Impl::readRegion
+(char* region, std::atomic<uint32_t>& sequence, bool isInput)
+{
+    char* buf = reinterpret_cast<char*>(regionBuf.data());
+    readWithSeqlock(sequence, buf, region, regionSize);
+
+    if(isInput){
+        currentTime = *reinterpret_cast<double*>(buf);
+    }
+
+    auto states = reinterpret_cast<const LinkState*>(buf + linkStateOffset);
+    const int n = linksToReceive.size();
+    for(int i=0; i < n; ++i){
+        auto link = linksToReceive[i];
+        const int flags = receivingStateFlags[i];
+        auto& state = states[link->index()];
+        if(flags & Link::JointDisplacement){
+            if(isInput){
+                link->q() = state.q;
+            } else {
+                link->q_target() = state.q_target;
+            }
+        }
+        if(flags & (Link::JointVelocity | Link::DeprecatedJointSurfaceVelocity)){
+            if(isInput){
+                link->dq() = state.dq;
+            } else {
+                link->dq_target() = state.dq_target;
+            }
+        }
+        if(flags & Link::JointAcceleration){
+            link->ddq() = state.ddq;
+        }
+        if(flags & Link::JointEffort){
+            link->u() = state.u;
+        }
+        if(flags & Link::LinkPosition){
+            link->p() = Eigen::Map<const Vector3>(state.p);
+            link->R() = Eigen::Map<const Matrix3>(state.R);
+        }
+        if(flags & Link::LinkTwist){
+            link->v() = Eigen::Map<const Vector3>(state.v);
+            link->w() = Eigen::Map<const Vector3>(state.w);
+        }
+        if(flags & Link::LinkExtWrench){
+            if(isInput){
+                link->F_ext() = Eigen::Map<const Vector6>(state.F_ext);
+            } else {
+                // The external forces of the controller are added to the ones of the other sources
+                link->F_ext() += Eigen::Map<const Vector6>(state.F_ext);
+            }
+        }
+    }
+
+    auto counters = reinterpret_cast<const uint32_t*>(buf + deviceCounterOffset);
+    auto deviceStates = reinterpret_cast<const double*>(buf + deviceStateOffset);
+    const int numDevices = receivedDeviceCounters.size();
+    for(int i=0; i < numDevices; ++i){
+        if(counters[i] != receivedDeviceCounters[i]){
+            receivedDeviceCounters[i] = counters[i];
+            auto device = body->device(i);
+            device->readState(deviceStates + deviceStateOffsets[i]);
+            // The received state is not sent back to the other side
+            deviceStateConnections.block(i);
+            device->notifyStateChange();
+            deviceStateConnections.unblock(i);
+        }
+    }
+}
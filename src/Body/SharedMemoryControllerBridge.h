@@ -0,0 +1,86 @@
+#ifndef CNOID_BODY_SHARED_MEMORY_CONTROLLER_BRIDGE_H
+#define CNOID_BODY_SHARED_MEMORY_CONTROLLER_BRIDGE_H
+
+#include <string>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+class Body;
+
+/**
+   This class exchanges the states of a body between a simulator and a controller running in
+   another process through a named shared memory region.
+
+   The simulator side creates the region with the create function, and the controller side opens
+   it with the open function for a body loaded from the same model. The controller side configures
+   the input and output states of each link with the setLinkIO function and calls setControllerReady
+   to make the simulator start the data exchange.
+
+   The joint, link and device states of each direction are written in a seqlock region, and a control
+   step is synchronized by the futexes on the request and finish counters in the region so that the
+   round trip of a step does not involve any socket or system-wide lock. The futexes are only
+   available on Linux, and the waiting sides poll the counters on the other POSIX platforms.
+   The shared memory is not supported on Windows.
+
+   \note The contact states of the links are not exchanged.
+*/
+class CNOID_EXPORT SharedMemoryControllerBridge
+{
+public:
+    SharedMemoryControllerBridge();
+    ~SharedMemoryControllerBridge();
+
+    enum WaitResult { Completed, Timeout, Closed };
+
+    //! The function for the simulator side
+    bool create(const std::string& name, Body* body, double timeStep);
+
+    //! The function for the controller side
+    bool open(const std::string& name, Body* body);
+
+    void close();
+    bool isOpen() const;
+    bool isSimulatorSide() const;
+    const std::string& errorMessage() const;
+
+    double timeStep() const;
+    double currentTime() const;
+
+    // Functions for the controller side
+    void setLinkIO(int linkIndex, int inputStateFlags, int outputStateFlags);
+    void setControllerReady();
+    WaitResult waitForControlRequest(double timeout);
+    void readInput();
+    void writeOutput();
+    void notifyControlFinished(bool doContinue);
+
+    // Functions for the simulator side
+
+    /**
+       This function returns true when the controller side becomes ready for the first time after
+       the previous call. The actuation modes and the sensing modes of the links are updated with
+       the link IO configurations of the controller side when it returns true.
+    */
+    bool checkControllerReady();
+
+    bool isControllerReady() const;
+    void writeInput(double time);
+    void requestControl();
+
+    /**
+       \param timeout The time to wait for the controller in seconds
+       \param out_doContinue The return value of the control function in the controller side
+    */
+    WaitResult waitForControlToFinish(double timeout, bool& out_doContinue);
+
+    void readOutput();
+
+private:
+    class Impl;
+    Impl* impl;
+};
+
+}
+
+#endif
@@ -0,0 +1,257 @@
+#include "SharedMemoryControllerRunner.h"
+#include "SharedMemoryControllerBridge.h"
+#include "Body.h"
+#include "Link.h"
+#include <cnoid/NullOut>
+#include <atomic>
+#include <vector>
+#include <memory>
+#include <fmt/format.h>
+#include "gettext.h"
+
+using namespace std;
+using namespace cnoid;
+using fmt::format;
+
+namespace {
+
+// The interval to check the stop request while waiting for the control request
+const double StopCheckInterval = 0.1;
+
+}
+
+namespace cnoid {
+
+class SharedMemoryControllerRunner::Impl
+{
+public:
+    SimpleController* controller;
+    string controllerName;
+    string optionString;
+    ostream* os;
+    Body* body;
+    SharedMemoryControllerBridge bridge;
+    vector<int> inputStateFlags;
+    vector<bool> outputFlags;
+    std::atomic<bool> isStopRequested;
+
+    Impl();
+    bool run(SharedMemoryControllerRunner* self, const string& channelName, Body* body);
+};
+
+}
+
+
+SharedMemoryControllerRunner::SharedMemoryControllerRunner()
+{
+    impl = new Impl;
+}
+
+
+SharedMemoryControllerRunner::Impl::Impl()
+    : isStopRequested(false)
+{
+    controller = nullptr;
+    os = &nullout();
+    body = nullptr;
+}
+
+
+SharedMemoryControllerRunner::~SharedMemoryControllerRunner()
+{
+    delete impl;
+}
+
+
+void SharedMemoryControllerRunner::setController(SimpleController* controller)
+{
+    impl->controller = controller;
+}
+
+
+void SharedMemoryControllerRunner::setControllerName(const std::string& name)
+{
+    impl->controllerName = name;
+}
+
+
+void SharedMemoryControllerRunner::setOptionString(const std::string& options)
+{
+    impl->optionString = options;
+}
+
+
+void SharedMemoryControllerRunner::setMessageOutput(std::ostream& os)
+{
+    impl->os = &os;
+}
+
+
+bool SharedMemoryControllerRunner::run(const std::string& channelName, Body* body)
+{
+    return impl->run(this, channelName, body);
+}
+
+
+bool SharedMemoryControllerRunner::Impl::run(SharedMemoryControllerRunner* self, const string& channelName, Body* body)
+{
+    if(!controller){
+        (*os) << _("The controller to run is not specified.") << endl;
+        return false;
+    }
+
+    isStopRequested = false;
+
+    if(!bridge.open(channelName, body)){
+        (*os) << bridge.errorMessage() << endl;
+        return false;
+    }
+    this->body = body;
+    if(controllerName.empty()){
+        controllerName = channelName;
+    }
+
+    SimpleControllerConfig config(self);
+    if(!controller->configure(&config)){
+        (*os) << format(_("{} failed to be configured."), controllerName) << endl;
+        bridge.close();
+        return false;
+    }
+
+    inputStateFlags.assign(body->numLinks(), Link::StateNone);
+    outputFlags.assign(body->numLinks(), false);
+
+    bool result = controller->initialize(self);
+    if(!result){
+        (*os) << format(_("{} failed to initialize."), controllerName) << endl;
+    } else {
+        for(int i=0; i < body->numLinks(); ++i){
+            int outputStateFlags =
+                outputFlags[i] ? static_cast<int>(body->link(i)->actuationMode()) : static_cast<int>(Link::StateNone);
+            bridge.setLinkIO(i, inputStateFlags[i], outputStateFlags);
+        }
+        result = controller->start();
+        if(!result){
+            (*os) << format(_("{} failed to start."), controllerName) << endl;
+        }
+    }
+
+    if(result){
+        bridge.setControllerReady();
+        while(!isStopRequested){
+            auto waitResult = bridge.waitForControlRequest(StopCheckInterval);
+            if(waitResult == SharedMemoryControllerBridge::Closed){
+                break;
+            } else if(waitResult == SharedMemoryControllerBridge::Completed){
+                bridge.readInput();
+                bool doContinue = controller->control();
+                bridge.writeOutput();
+                bridge.notifyControlFinished(doContinue);
+            }
+        }
+        controller->stop();
+    }
+
+    controller->unconfigure();
+    bridge.close();
+    this->body = nullptr;
+
+    return result;
+}
+
+
+void SharedMemoryControllerRunner::requestStop()
+{
+    impl->isStopRequested = true;
+}
+
+
+std::string SharedMemoryControllerRunner::controllerName() const
+{
+    return impl->controllerName;
+}
+
+
+Body* SharedMemoryControllerRunner::body()
+{
+    return impl->body;
+}
+
+
+std::string SharedMemoryControllerRunner::optionString() const
+{
+    return impl->optionString;
+}
+
+
+std::ostream& SharedMemoryControllerRunner::os() const
+{
+    return *impl->os;
+}
+
+
+double SharedMemoryControllerRunner::timeStep() const
+{
+    return impl->bridge.timeStep();
+}
+
+
+double SharedMemoryControllerRunner::currentTime() const
+{
+    return impl->bridge.currentTime();
+}
+
+
+void SharedMemoryControllerRunner::enableIO(Link* link)
+{
+    enableInput(link);
+    enableOutput(link);
+}
+
+
+void SharedMemoryControllerRunner::enableInput(Link* link)
+{
+    int stateFlags = Link::StateNone;
+    int actuationMode = link->actuationMode();
+    if(actuationMode & (Link::JointEffort | Link::JointDisplacement | Link::JointVelocity)){
+        if(link->jointType() != Link::PseudoContinuousTrackJoint){
+            stateFlags = Link::JointDisplacement;
+        }
+    }
+    if(actuationMode & Link::LinkExtWrench){
+        // Global link position is needed to calculate the correct external force value
+        stateFlags |= Link::LinkPosition;
+    }
+    enableInput(link, stateFlags);
+}
+
+
+void SharedMemoryControllerRunner::enableInput(Link* link, int stateFlags)
+{
+    impl->inputStateFlags[link->index()] |= stateFlags;
+    link->mergeSensingMode(stateFlags);
+}
+
+
+void SharedMemoryControllerRunner::enableOutput(Link* link)
+{
+    impl->outputFlags[link->index()] = true;
+}
+
+
+void SharedMemoryControllerRunner::enableOutput(Link* link, int stateFlags)
+{
+    link->setActuationMode(stateFlags);
+    if(stateFlags){
+        enableOutput(link);
+    }
+}
+
+
+/**
+   The state changes of all the devices are always transferred by the bridge.
+*/
+void SharedMemoryControllerRunner::enableInput(Device* /* device */)
+{
+
+}
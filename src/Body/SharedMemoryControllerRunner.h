@@ -0,0 +1,58 @@
+#ifndef CNOID_BODY_SHARED_MEMORY_CONTROLLER_RUNNER_H
+#define CNOID_BODY_SHARED_MEMORY_CONTROLLER_RUNNER_H
+
+#include "SimpleController.h"
+#include <iosfwd>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+/**
+   This class runs a simple controller in a process other than the simulator. The controller is
+   connected to SharedMemoryControllerItem in the simulator through SharedMemoryControllerBridge,
+   and it can be used in the same way as the one executed by SimpleControllerItem.
+*/
+class CNOID_EXPORT SharedMemoryControllerRunner : public SimpleControllerIO
+{
+public:
+    SharedMemoryControllerRunner();
+    ~SharedMemoryControllerRunner();
+
+    //! The controller is not owned by the runner.
+    void setController(SimpleController* controller);
+    void setControllerName(const std::string& name);
+    void setOptionString(const std::string& options);
+    void setMessageOutput(std::ostream& os);
+
+    /**
+       The controller is initialized for the body in the simulator and is executed at each control step
+       requested by the simulator until the simulation finishes or requestStop is called.
+       \param channelName The channel name specified in SharedMemoryControllerItem
+       \param body The body loaded from the same model as the body controlled in the simulator
+    */
+    bool run(const std::string& channelName, Body* body);
+
+    //! This function can be called from any thread.
+    void requestStop();
+
+    virtual std::string controllerName() const override;
+    virtual Body* body() override;
+    virtual std::string optionString() const override;
+    virtual std::ostream& os() const override;
+    virtual double timeStep() const override;
+    virtual double currentTime() const override;
+    virtual void enableIO(Link* link) override;
+    virtual void enableInput(Link* link) override;
+    virtual void enableInput(Link* link, int stateFlags) override;
+    virtual void enableOutput(Link* link) override;
+    virtual void enableOutput(Link* link, int stateFlags) override;
+    virtual void enableInput(Device* device) override;
+
+private:
+    class Impl;
+    Impl* impl;
+};
+
+}
+
+#endif
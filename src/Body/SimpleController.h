@@ -6,6 +6,7 @@
 #define CNOID_BODY_SIMPLE_CONTROLLER_H
 
 #include "ControllerIO.h"
+#include <cnoid/SharedDataChannel>
 #include "exportdecl.h"
 
 namespace cnoid {
@@ -28,6 +29,15 @@ class CNOID_EXPORT SimpleControllerIO : public ControllerIO
         return body()->findCache<T>(name);
     }
 
+    /**
+       The channel is shared in the same way as the objects obtained by getOrCreateSharedObject.
+       It should be obtained in the initialize function, and the publisher and the subscribers can
+       exchange the values through it in the control functions without any locking.
+    */
+    template<class T> SharedDataChannel<T>* getOrCreateSharedDataChannel(const std::string& name){
+        return getOrCreateSharedObject<SharedDataChannel<T>>(name);
+    }
+
     [[deprecated("Use the controllerName function.")]]
     std::string name() const;
     [[deprecated("Use enableInput for all links.")]]
@@ -838,6 +838,7 @@ bool StdBodyLoader::Impl::readBody(Mapping* topNode)
     sceneReader.setBaseDirectory(toUTF8(mainFilePath.parent_path().string()));
     sceneReader.setDefaultDivisionNumber(defaultDivisionNumber);
     sceneReader.readHeader(topNode, version);
+    sceneReader.prefetchResources(topNode);
 
     if(extract(topNode, "name", symbol)){
         body->setModelName(symbol);
@@ -0,0 +1,598 @@
+#include "TimeOptimalRetimer.h"
+#include "Body.h"
+#include "BodyMotion.h"
+#include "InverseDynamics.h"
+#include <cnoid/MultiValueSeq>
+#include <cnoid/MultiSE3Seq>
+#include <cnoid/Vector3Seq>
+#include <fmt/format.h>
+#include <vector>
+#include <limits>
+#include <cmath>
+#include "gettext.h"
+
+using namespace std;
+using namespace cnoid;
+using fmt::format;
+
+namespace {
+
+const double inf = std::numeric_limits<double>::infinity();
+
+// The upper bound of the squared path velocity when the path is not constrained
+const double MaxSquaredPathVelocity = 1.0e10;
+
+const int NumBisectionIterations = 60;
+
+/**
+   lower <= a * u + b * x <= upper, where u is the path acceleration and x is the squared
+   path velocity. The path parameter is incremented by one between the adjacent waypoints.
+*/
+struct Constraint
+{
+    double a;
+    double b;
+    double lower;
+    double upper;
+};
+
+struct GridPoint
+{
+    int constraintIndex;
+    int numConstraints;
+    double xmin;
+    double xmax;
+};
+
+double calcPathDerivative(const MultiValueSeq& path, int frame, int part)
+{
+    const int prev = std::max(frame - 1, 0);
+    const int next = std::min(frame + 1, path.numFrames() - 1);
+    return (path(next, part) - path(prev, part)) / (next - prev);
+}
+
+/**
+   The cubic Hermite interpolation with the derivatives used in the constraints.
+   The linear interpolation is not used because the joint velocities of the retimed motion
+   would jump at the waypoints.
+*/
+double interpolatePath(const MultiValueSeq& path, int part, int i, int j, double r)
+{
+    if(i == j){
+        return path(i, part);
+    }
+    const double r2 = r * r;
+    const double r3 = r2 * r;
+    return (2.0 * r3 - 3.0 * r2 + 1.0) * path(i, part) + (r3 - 2.0 * r2 + r) * calcPathDerivative(path, i, part)
+        + (3.0 * r2 - 2.0 * r3) * path(j, part) + (r3 - r2) * calcPathDerivative(path, j, part);
+}
+
+}
+
+namespace cnoid {
+
+class TimeOptimalRetimer::Impl
+{
+public:
+    BodyPtr body;
+    VectorXd dq_lower;
+    VectorXd dq_upper;
+    VectorXd ddq_lower;
+    VectorXd ddq_upper;
+    VectorXd u_lower;
+    VectorXd u_upper;
+    Vector3 g;
+    double duration;
+
+    vector<Constraint> constraints;
+    vector<GridPoint> grid;
+    vector<double> K_lower;
+    vector<double> K_upper;
+    vector<double> x;
+    vector<double> pathAccelerations;
+    vector<double> times;
+
+    Impl();
+    static double getLimit(const VectorXd& limits, int index, double defaultValue);
+    void setupConstraints(const MultiValueSeq& path);
+    void addConstraint(GridPoint& point, double a, double b, double lower, double upper);
+    void calcTorqueCoefficients(const MultiValueSeq& path, int frame, const VectorXd& dq, const VectorXd& ddq,
+                                VectorXd& out_a, VectorXd& out_b, VectorXd& out_c);
+    void calcPathAccelerationRange(int index, double x, double& out_lower, double& out_upper) const;
+    double evalFeasibility(int index, double x) const;
+    bool calcControllableSet(int index);
+    bool calcPathParameters(const MultiValueSeq& path, double frameRate, vector<double>& out_s, std::ostream& os);
+};
+
+}
+
+
+TimeOptimalRetimer::TimeOptimalRetimer()
+{
+    impl = new Impl;
+}
+
+
+TimeOptimalRetimer::Impl::Impl()
+    : g(0.0, 0.0, 9.80665)
+{
+    duration = 0.0;
+}
+
+
+TimeOptimalRetimer::~TimeOptimalRetimer()
+{
+    delete impl;
+}
+
+
+void TimeOptimalRetimer::setBody(Body* body)
+{
+    impl->body = body;
+    if(body){
+        const int n = body->numJoints();
+        impl->dq_lower.resize(n);
+        impl->dq_upper.resize(n);
+        for(int i=0; i < n; ++i){
+            auto joint = body->joint(i);
+            impl->dq_lower[i] = joint->dq_lower();
+            impl->dq_upper[i] = joint->dq_upper();
+        }
+    }
+}
+
+
+void TimeOptimalRetimer::setVelocityLimits(const VectorXd& lower, const VectorXd& upper)
+{
+    impl->dq_lower = lower;
+    impl->dq_upper = upper;
+}
+
+
+void TimeOptimalRetimer::setAccelerationLimits(const VectorXd& lower, const VectorXd& upper)
+{
+    impl->ddq_lower = lower;
+    impl->ddq_upper = upper;
+}
+
+
+void TimeOptimalRetimer::setTorqueLimits(const VectorXd& lower, const VectorXd& upper)
+{
+    impl->u_lower = lower;
+    impl->u_upper = upper;
+}
+
+
+void TimeOptimalRetimer::clearTorqueLimits()
+{
+    impl->u_lower.resize(0);
+    impl->u_upper.resize(0);
+}
+
+
+void TimeOptimalRetimer::setGravityAcceleration(const Vector3& g)
+{
+    impl->g = g;
+}
+
+
+double TimeOptimalRetimer::duration() const
+{
+    return impl->duration;
+}
+
+
+double TimeOptimalRetimer::Impl::getLimit(const VectorXd& limits, int index, double defaultValue)
+{
+    if(index < limits.size()){
+        const double limit = limits[index];
+        if(std::fabs(limit) < std::numeric_limits<double>::max()){
+            return limit;
+        }
+    }
+    return defaultValue;
+}
+
+
+void TimeOptimalRetimer::Impl::addConstraint(GridPoint& point, double a, double b, double lower, double upper)
+{
+    if(std::fabs(a) > 1.0e-12){
+        constraints.push_back({ a, b, lower, upper });
+        ++point.numConstraints;
+
+    } else if(std::fabs(b) > 1.0e-12){
+        // constraint on the squared path velocity only
+        double xl = lower / b;
+        double xu = upper / b;
+        if(b < 0.0){
+            std::swap(xl, xu);
+        }
+        point.xmin = std::max(point.xmin, xl);
+        point.xmax = std::min(point.xmax, xu);
+
+    } else if(lower > 0.0 || upper < 0.0){
+        point.xmax = -1.0; // infeasible
+    }
+}
+
+
+/**
+   The joint torques are written as out_a * u + out_b * x + out_c for the path acceleration u
+   and the squared path velocity x.
+*/
+void TimeOptimalRetimer::Impl::calcTorqueCoefficients
+(const MultiValueSeq& path, int frame, const VectorXd& dq, const VectorXd& ddq,
+ VectorXd& out_a, VectorXd& out_b, VectorXd& out_c)
+{
+    const int n = std::min(body->numJoints(), path.numParts());
+    Link* rootLink = body->rootLink();
+    rootLink->v().setZero();
+    rootLink->w().setZero();
+    rootLink->dw().setZero();
+
+    auto calcTorques = [&](bool isVelocityEnabled, const VectorXd* accelerations, const Vector3& rootAcc, VectorXd& out_u){
+        for(int i=0; i < n; ++i){
+            Link* joint = body->joint(i);
+            joint->q() = path(frame, i);
+            joint->dq() = isVelocityEnabled ? dq[i] : 0.0;
+            joint->ddq() = accelerations ? (*accelerations)[i] : 0.0;
+        }
+        rootLink->dv() = rootAcc;
+        body->calcForwardKinematics(true);
+        calcInverseDynamics(rootLink);
+        out_u.resize(n);
+        for(int i=0; i < n; ++i){
+            out_u[i] = body->joint(i)->u();
+        }
+    };
+
+    calcTorques(false, &dq, Vector3::Zero(), out_a);
+    calcTorques(true, &ddq, Vector3::Zero(), out_b);
+    calcTorques(false, nullptr, g, out_c);
+}
+
+
+void TimeOptimalRetimer::Impl::setupConstraints(const MultiValueSeq& path)
+{
+    const int numFrames = path.numFrames();
+    const int n = path.numParts();
+    const bool isTorqueLimitEnabled = body && (u_lower.size() > 0 || u_upper.size() > 0);
+
+    constraints.clear();
+    grid.resize(numFrames);
+    VectorXd dq(n), ddq(n), a, b, c;
+
+    for(int k=0; k < numFrames; ++k){
+        // The derivatives by the path parameter
+        const int center = std::max(1, std::min(k, numFrames - 2));
+        for(int i=0; i < n; ++i){
+            dq[i] = calcPathDerivative(path, k, i);
+            if(numFrames >= 3){
+                ddq[i] = path(center + 1, i) - 2.0 * path(center, i) + path(center - 1, i);
+            } else {
+                ddq[i] = 0.0;
+            }
+        }
+
+        GridPoint& point = grid[k];
+        point.constraintIndex = constraints.size();
+        point.numConstraints = 0;
+        point.xmin = 0.0;
+        point.xmax = MaxSquaredPathVelocity;
+
+        for(int i=0; i < n; ++i){
+            // The velocity constraints are dq * sqrt(x)
+            if(dq[i] > 1.0e-12){
+                const double v = getLimit(dq_upper, i, inf);
+                point.xmax = std::min(point.xmax, (v / dq[i]) * (v / dq[i]));
+            } else if(dq[i] < -1.0e-12){
+                const double v = getLimit(dq_lower, i, -inf);
+                point.xmax = std::min(point.xmax, (v / dq[i]) * (v / dq[i]));
+            }
+            const double al = getLimit(ddq_lower, i, -inf);
+            const double au = getLimit(ddq_upper, i, inf);
+            if(al > -inf || au < inf){
+                addConstraint(point, dq[i], ddq[i], al, au);
+            }
+        }
+
+        if(isTorqueLimitEnabled){
+            calcTorqueCoefficients(path, k, dq, ddq, a, b, c);
+            for(int i=0; i < a.size(); ++i){
+                const double ul = getLimit(u_lower, i, -inf);
+                const double uu = getLimit(u_upper, i, inf);
+                if(ul > -inf || uu < inf){
+                    addConstraint(point, a[i], b[i], ul - c[i], uu - c[i]);
+                }
+            }
+        }
+    }
+}
+
+
+void TimeOptimalRetimer::Impl::calcPathAccelerationRange
+(int index, double x, double& out_lower, double& out_upper) const
+{
+    out_lower = -inf;
+    out_upper = inf;
+    const GridPoint& point = grid[index];
+    const Constraint* c = &constraints[point.constraintIndex];
+    for(int i=0; i < point.numConstraints; ++i, ++c){
+        const double l = (c->lower - c->b * x) / c->a;
+        const double u = (c->upper - c->b * x) / c->a;
+        if(c->a > 0.0){
+            out_lower = std::max(out_lower, l);
+            out_upper = std::min(out_upper, u);
+        } else {
+            out_lower = std::max(out_lower, u);
+            out_upper = std::min(out_upper, l);
+        }
+    }
+}
+
+
+/**
+   The squared path velocity x at the index is feasible when the value is non negative.
+   This is a concave function of x because it is the minimum of the concave functions.
+*/
+double TimeOptimalRetimer::Impl::evalFeasibility(int index, double x) const
+{
+    double ul, uu;
+    calcPathAccelerationRange(index, x, ul, uu);
+    const double f1 = uu - ul;
+    const double f2 = x + 2.0 * uu - K_lower[index + 1];
+    const double f3 = K_upper[index + 1] - x - 2.0 * ul;
+    return std::min(f1, std::min(f2, f3));
+}
+
+
+/**
+   Calculates the set of the squared path velocities at the index from which the
+   controllable set of the next index can be reached.
+*/
+bool TimeOptimalRetimer::Impl::calcControllableSet(int index)
+{
+    const GridPoint& point = grid[index];
+    double lower = std::max(point.xmin, 0.0);
+    double upper = point.xmax;
+    if(lower > upper){
+        return false;
+    }
+    const double eps = 1.0e-12;
+    const bool isLowerFeasible = evalFeasibility(index, lower) >= -eps;
+    const bool isUpperFeasible = evalFeasibility(index, upper) >= -eps;
+
+    // A feasible point is needed to determine the set by the bisection method
+    double feasible;
+    if(isLowerFeasible){
+        feasible = lower;
+    } else if(isUpperFeasible){
+        feasible = upper;
+    } else {
+        // Golden section search for the maximum of the concave function
+        const double r = (std::sqrt(5.0) - 1.0) / 2.0;
+        double l = lower;
+        double u = upper;
+        double x1 = u - r * (u - l);
+        double x2 = l + r * (u - l);
+        double f1 = evalFeasibility(index, x1);
+        double f2 = evalFeasibility(index, x2);
+        for(int i=0; i < NumBisectionIterations * 2; ++i){
+            if(f1 < f2){
+                l = x1;
+                x1 = x2;
+                f1 = f2;
+                x2 = l + r * (u - l);
+                f2 = evalFeasibility(index, x2);
+            } else {
+                u = x2;
+                x2 = x1;
+                f2 = f1;
+                x1 = u - r * (u - l);
+                f1 = evalFeasibility(index, x1);
+            }
+        }
+        feasible = (f1 > f2) ? x1 : x2;
+        if(evalFeasibility(index, feasible) < -eps){
+            return false;
+        }
+    }
+
+    if(!isUpperFeasible){
+        double l = feasible;
+        double u = upper;
+        for(int i=0; i < NumBisectionIterations; ++i){
+            const double m = 0.5 * (l + u);
+            if(evalFeasibility(index, m) >= -eps){
+                l = m;
+            } else {
+                u = m;
+            }
+        }
+        upper = l;
+    }
+    if(!isLowerFeasible){
+        double l = lower;
+        double u = feasible;
+        for(int i=0; i < NumBisectionIterations; ++i){
+            const double m = 0.5 * (l + u);
+            if(evalFeasibility(index, m) >= -eps){
+                u = m;
+            } else {
+                l = m;
+            }
+        }
+        lower = u;
+    }
+    K_lower[index] = lower;
+    K_upper[index] = upper;
+
+    return true;
+}
+
+
+/**
+   \param out_s The path parameter of each frame of the retimed motion
+*/
+bool TimeOptimalRetimer::Impl::calcPathParameters
+(const MultiValueSeq& path, double frameRate, vector<double>& out_s, std::ostream& os)
+{
+    const int numFrames = path.numFrames();
+    out_s.clear();
+    duration = 0.0;
+
+    if(frameRate <= 0.0){
+        os << _("The frame rate of the retimed motion is not specified.") << endl;
+        return false;
+    }
+    if(numFrames < 2){
+        out_s.assign(numFrames, 0.0);
+        return true;
+    }
+    const int N = numFrames - 1;
+
+    setupConstraints(path);
+
+    // Backward pass
+    K_lower.resize(numFrames);
+    K_upper.resize(numFrames);
+    K_lower[N] = 0.0;
+    K_upper[N] = 0.0;
+    for(int i = N - 1; i >= 0; --i){
+        if(!calcControllableSet(i)){
+            os << format(_("The path cannot be retimed because the constraints at waypoint {0} cannot be satisfied."), i)
+               << endl;
+            return false;
+        }
+    }
+    if(K_lower[0] > 1.0e-9){
+        os << _("The path cannot be retimed because the motion cannot start at rest.") << endl;
+        return false;
+    }
+
+    // Forward pass
+    x.resize(numFrames);
+    pathAccelerations.resize(N);
+    times.resize(numFrames);
+    x[0] = 0.0;
+    times[0] = 0.0;
+    for(int i=0; i < N; ++i){
+        double ul, uu;
+        calcPathAccelerationRange(i, x[i], ul, uu);
+        double u = std::min(uu, 0.5 * (K_upper[i + 1] - x[i]));
+        u = std::max(u, 0.5 * (K_lower[i + 1] - x[i]));
+        x[i + 1] = std::max(0.0, x[i] + 2.0 * u);
+        pathAccelerations[i] = 0.5 * (x[i + 1] - x[i]);
+        const double v = std::sqrt(x[i]) + std::sqrt(x[i + 1]);
+        if(v <= 0.0){
+            os << format(_("The path cannot be retimed because the motion stops at waypoint {0}."), i)
+               << endl;
+            return false;
+        }
+        times[i + 1] = times[i] + 2.0 / v;
+    }
+    duration = times[N];
+
+    // Sampling with the constant path acceleration in each segment
+    const int numOutputFrames = static_cast<int>(std::ceil(duration * frameRate - 1.0e-9)) + 1;
+    out_s.resize(numOutputFrames);
+    int segment = 0;
+    for(int k=0; k < numOutputFrames; ++k){
+        const double t = std::min(k / frameRate, duration);
+        while(segment < N - 1 && times[segment + 1] <= t){
+            ++segment;
+        }
+        const double tau = t - times[segment];
+        double s = segment + std::sqrt(x[segment]) * tau + 0.5 * pathAccelerations[segment] * tau * tau;
+        out_s[k] = std::max(static_cast<double>(segment), std::min(s, segment + 1.0));
+    }
+    out_s.back() = N;
+
+    return true;
+}
+
+
+bool TimeOptimalRetimer::retime(const MultiValueSeq& path, MultiValueSeq& out_seq, std::ostream& os)
+{
+    const double frameRate = (out_seq.frameRate() > 0.0) ? out_seq.frameRate() : path.frameRate();
+    vector<double> s;
+    if(!impl->calcPathParameters(path, frameRate, s, os)){
+        return false;
+    }
+    const int numFrames = s.size();
+    const int n = path.numParts();
+    const int lastFrame = path.numFrames() - 1;
+    out_seq.setDimension(numFrames, n);
+    out_seq.setFrameRate(frameRate);
+    for(int k=0; k < numFrames; ++k){
+        const int i = std::min(static_cast<int>(s[k]), std::max(lastFrame - 1, 0));
+        const double r = s[k] - i;
+        const int j = std::min(i + 1, lastFrame);
+        for(int p=0; p < n; ++p){
+            out_seq(k, p) = interpolatePath(path, p, i, j, r);
+        }
+    }
+    return true;
+}
+
+
+bool TimeOptimalRetimer::retime(BodyMotion& motion, std::ostream& os)
+{
+    const double frameRate = motion.frameRate();
+    const MultiValueSeq jointPosSeq(*motion.jointPosSeq());
+    vector<double> s;
+    if(!impl->calcPathParameters(jointPosSeq, frameRate, s, os)){
+        return false;
+    }
+    const int numFrames = s.size();
+    const int lastFrame = jointPosSeq.numFrames() - 1;
+    auto getInterpolationFrames = [&](int k, int& out_i, int& out_j, double& out_r){
+        out_i = std::min(static_cast<int>(s[k]), std::max(lastFrame - 1, 0));
+        out_j = std::min(out_i + 1, lastFrame);
+        out_r = s[k] - out_i;
+    };
+
+    const MultiSE3Seq linkPosSeq(*motion.linkPosSeq());
+    motion.setNumFrames(numFrames);
+    int i, j;
+    double r;
+
+    auto& retimedJointPosSeq = *motion.jointPosSeq();
+    for(int k=0; k < numFrames; ++k){
+        getInterpolationFrames(k, i, j, r);
+        for(int p=0; p < jointPosSeq.numParts(); ++p){
+            retimedJointPosSeq(k, p) = interpolatePath(jointPosSeq, p, i, j, r);
+        }
+    }
+
+    auto& retimedLinkPosSeq = *motion.linkPosSeq();
+    if(linkPosSeq.numFrames() > lastFrame){
+        for(int k=0; k < numFrames; ++k){
+            getInterpolationFrames(k, i, j, r);
+            for(int p=0; p < linkPosSeq.numParts(); ++p){
+                const SE3& T1 = linkPosSeq(i, p);
+                const SE3& T2 = linkPosSeq(j, p);
+                retimedLinkPosSeq(k, p).set(
+                    (1.0 - r) * T1.translation() + r * T2.translation(),
+                    T1.rotation().slerp(r, T2.rotation()));
+            }
+        }
+    }
+
+    for(auto p = motion.extraSeqBegin(); p != motion.extraSeqEnd(); ++p){
+        if(auto seq = dynamic_pointer_cast<Vector3Seq>(p->second)){
+            if(seq->numFrames() > lastFrame){
+                const Vector3Seq orgSeq(*seq);
+                seq->setNumFrames(numFrames);
+                for(int k=0; k < numFrames; ++k){
+                    getInterpolationFrames(k, i, j, r);
+                    (*seq)[k] = (1.0 - r) * orgSeq[i] + r * orgSeq[j];
+                }
+            }
+        } else {
+            os << format(_("Extra sequence \"{0}\" is not retimed."), p->first) << endl;
+        }
+    }
+
+    return true;
+}
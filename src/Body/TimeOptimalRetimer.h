@@ -0,0 +1,57 @@
+#ifndef CNOID_BODY_TIME_OPTIMAL_RETIMER_H
+#define CNOID_BODY_TIME_OPTIMAL_RETIMER_H
+
+#include <cnoid/EigenTypes>
+#include <cnoid/NullOut>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+class Body;
+class BodyMotion;
+class MultiValueSeq;
+
+/**
+   This class retimes a joint space path to the time-optimal motion under the velocity,
+   acceleration and torque limits of the joints by the reachability analysis (TOPP-RA).
+   The frames of the given sequence are the waypoints of the path, and the motion starts
+   and ends at rest. The torque limits are evaluated by the inverse dynamics of the body
+   with the root link fixed.
+*/
+class CNOID_EXPORT TimeOptimalRetimer
+{
+public:
+    TimeOptimalRetimer();
+    ~TimeOptimalRetimer();
+
+    //! The velocity limits are initialized with the ones of the joints of the body.
+    void setBody(Body* body);
+
+    void setVelocityLimits(const VectorXd& lower, const VectorXd& upper);
+    void setAccelerationLimits(const VectorXd& lower, const VectorXd& upper);
+
+    //! This is only effective when the body is given.
+    void setTorqueLimits(const VectorXd& lower, const VectorXd& upper);
+    void clearTorqueLimits();
+    void setGravityAcceleration(const Vector3& g);
+
+    /**
+       \param out_seq The frame rate of the sequence is used for the retimed motion if it is
+       specified. Otherwise the frame rate of the path is used. This must not be the path itself.
+    */
+    bool retime(const MultiValueSeq& path, MultiValueSeq& out_seq, std::ostream& os = nullout());
+
+    //! The joint positions, the link positions and the Vector3 extra sequences are retimed.
+    bool retime(BodyMotion& motion, std::ostream& os = nullout());
+
+    //! The duration of the last retimed motion
+    double duration() const;
+
+private:
+    class Impl;
+    Impl* impl;
+};
+
+}
+
+#endif
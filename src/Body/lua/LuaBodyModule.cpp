@@ -3,12 +3,74 @@
 */
 
 #include "../Body.h"
+#include "../BatchForwardKinematics.h"
+#include "../BatchCollisionChecker.h"
+#include <cnoid/CollisionDetector>
 #include <cnoid/EigenUtil>
 #include <cnoid/LuaUtil>
 
 using namespace std;
 using namespace cnoid;
 
+namespace {
+
+/*
+  The following functions take the array of configurations, each of which is the array of the joint
+  displacements, and evaluate all of them in one call.
+*/
+
+sol::table BatchForwardKinematics_calcLinkTranslations
+(BatchForwardKinematics* self, Body* body, sol::table configurations, sol::this_state state)
+{
+    const int numConfigurations = configurations.size();
+    const int numJoints = body->numJoints();
+    self->setNumConfigurations(numConfigurations);
+    for(int k=0; k < numConfigurations; ++k){
+        self->readState(body, k);
+        sol::table q = configurations.get<sol::table>(k + 1);
+        for(int i=0; i < numJoints; ++i){
+            self->q(body->joint(i)->index(), k) = q.get<double>(i + 1);
+        }
+    }
+    self->calcForwardKinematics();
+
+    sol::state_view lua(state);
+    sol::table translations = lua.create_table(numConfigurations, 0);
+    const int numLinks = self->numLinks();
+    for(int k=0; k < numConfigurations; ++k){
+        sol::table links = lua.create_table(numLinks, 0);
+        for(int i=0; i < numLinks; ++i){
+            links[i + 1] = make_shared_aligned<Vector3>(self->p(i, k));
+        }
+        translations[k + 1] = links;
+    }
+    return translations;
+}
+
+sol::table BatchCollisionChecker_check(BatchCollisionChecker* self, sol::table configurations, sol::this_state state)
+{
+    const int numConfigurations = configurations.size();
+    const int numJoints = self->body() ? self->body()->numJoints() : 0;
+    MatrixXd q(numConfigurations, numJoints);
+    for(int k=0; k < numConfigurations; ++k){
+        sol::table qk = configurations.get<sol::table>(k + 1);
+        for(int i=0; i < numJoints; ++i){
+            q(k, i) = qk.get<double>(i + 1);
+        }
+    }
+    vector<bool> collided;
+    self->check(q, collided);
+
+    sol::state_view lua(state);
+    sol::table flags = lua.create_table(numConfigurations, 0);
+    for(int k=0; k < numConfigurations; ++k){
+        flags[k + 1] = static_cast<bool>(collided[k]);
+    }
+    return flags;
+}
+
+}
+
 extern "C" CNOID_EXPORT int luaopen_cnoid_Body(lua_State* L)
 {
     sol::state_view lua(L);
@@ -151,6 +213,32 @@ extern "C" CNOID_EXPORT int luaopen_cnoid_Body(lua_State* L)
         "addCustomizerDirectory", &Body::addCustomizerDirectory,
         "calcTotalMomentum", [](Body* self) { Vector3 P, L; self->calcTotalMomentum(P, L); return std::make_tuple(P, L); }
         );
+
+    module.new_usertype<BatchForwardKinematics>(
+        "BatchForwardKinematics",
+        "new", sol::factories([](Body* body) { return make_shared<BatchForwardKinematics>(body); }),
+        "compile", &BatchForwardKinematics::compile,
+        "numLinks", &BatchForwardKinematics::numLinks,
+        "calcLinkTranslations", BatchForwardKinematics_calcLinkTranslations
+        );
+
+    module.new_usertype<BatchCollisionChecker>(
+        "BatchCollisionChecker",
+        "new", sol::factories(
+            [](Body* body, const std::string& collisionDetectorName) {
+                auto checker = make_shared<BatchCollisionChecker>();
+                checker->setBody(body);
+                int index = CollisionDetector::factoryIndex(collisionDetectorName);
+                if(index >= 0){
+                    checker->setCollisionDetector(CollisionDetector::create(index));
+                }
+                return checker; }),
+        "addEnvironmentBody", &BatchCollisionChecker::addEnvironmentBody,
+        "clearEnvironmentBodies", &BatchCollisionChecker::clearEnvironmentBodies,
+        "setNumThreads", &BatchCollisionChecker::setNumThreads,
+        "numThreads", &BatchCollisionChecker::numThreads,
+        "check", BatchCollisionChecker_check
+        );
     
     sol::stack::push(L, module);
     
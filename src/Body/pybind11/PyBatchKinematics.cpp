@@ -0,0 +1,184 @@
+#include "../BatchForwardKinematics.h"
+#include "../BatchInverseKinematics.h"
+#include "../BatchCollisionChecker.h"
+#include "../Body.h"
+#include "../Link.h"
+#include <cnoid/CollisionDetector>
+#include <cnoid/PyUtil>
+#include <pybind11/numpy.h>
+
+using namespace std;
+using namespace cnoid;
+namespace py = pybind11;
+
+/*
+  The functions defined in this file evaluate all the configurations or targets given as an array
+  in one call without the GIL so that the overhead of the binding is paid once per batch.
+*/
+
+namespace {
+
+typedef py::array_t<double, py::array::c_style | py::array::forcecast> InputArray;
+
+void checkArrayShape(const InputArray& values, std::initializer_list<py::ssize_t> shape)
+{
+    bool isValid = (values.ndim() == static_cast<py::ssize_t>(shape.size()));
+    if(isValid){
+        int i = 0;
+        for(auto size : shape){
+            if(size >= 0 && values.shape(i) != size){
+                isValid = false;
+                break;
+            }
+            ++i;
+        }
+    }
+    if(!isValid){
+        PyErr_SetString(PyExc_ValueError, "The shape of the array is not supported");
+        throw py::error_already_set();
+    }
+}
+
+MatrixXd toConfigurationMatrix(const InputArray& q, int numJoints)
+{
+    checkArrayShape(q, { -1, numJoints });
+    return Eigen::Map<const Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>>(
+        q.data(), q.shape(0), numJoints);
+}
+
+py::array_t<bool> toBoolArray(const vector<bool>& flags)
+{
+    py::array_t<bool> array(flags.size());
+    auto r = array.mutable_unchecked<1>();
+    for(size_t i=0; i < flags.size(); ++i){
+        r(i) = flags[i];
+    }
+    return array;
+}
+
+/**
+   \return The array of the positions of the links as 4x4 homogeneous matrices, whose shape is
+   (the number of the configurations, the number of the links, 4, 4)
+*/
+py::array BatchForwardKinematics_calcLinkPositions(BatchForwardKinematics& self, Body* body, InputArray q)
+{
+    const int numJoints = body->numJoints();
+    checkArrayShape(q, { -1, numJoints });
+    const int numConfigurations = q.shape(0);
+    const int numLinks = self.numLinks();
+    py::array_t<double> positions({ numConfigurations, numLinks, 4, 4 });
+    const double* qdata = q.data();
+    double* pdata = positions.mutable_data();
+    {
+        py::gil_scoped_release release;
+        self.setNumConfigurations(numConfigurations);
+        for(int k=0; k < numConfigurations; ++k){
+            self.readState(body, k);
+            for(int i=0; i < numJoints; ++i){
+                self.q(body->joint(i)->index(), k) = qdata[k * numJoints + i];
+            }
+        }
+        self.calcForwardKinematics();
+        for(int k=0; k < numConfigurations; ++k){
+            for(int i=0; i < numLinks; ++i){
+                Eigen::Map<Eigen::Matrix<double, 4, 4, Eigen::RowMajor>> T(pdata + (k * numLinks + i) * 16);
+                T = self.T(i, k).matrix();
+            }
+        }
+    }
+    return positions;
+}
+
+/**
+   \param targets The array of the target positions of the end link as 4x4 homogeneous matrices
+   \return The tuple of the array of the flags of the solved targets and the array of the joint
+   displacements for the targets
+*/
+py::tuple BatchInverseKinematics_solve(BatchInverseKinematics& self, InputArray targets)
+{
+    checkArrayShape(targets, { -1, 4, 4 });
+    const int numTargets = targets.shape(0);
+    BatchInverseKinematics::PositionArray positions(numTargets);
+    const double* tdata = targets.data();
+    for(int i=0; i < numTargets; ++i){
+        positions[i].matrix() =
+            Eigen::Map<const Eigen::Matrix<double, 4, 4, Eigen::RowMajor>>(tdata + i * 16);
+    }
+    vector<bool> solved;
+    MatrixXd q;
+    {
+        py::gil_scoped_release release;
+        self.solve(positions, solved, q);
+    }
+    py::array_t<double> qarray({ static_cast<py::ssize_t>(q.rows()), static_cast<py::ssize_t>(q.cols()) });
+    Eigen::Map<Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>>(
+        qarray.mutable_data(), q.rows(), q.cols()) = q;
+    return py::make_tuple(toBoolArray(solved), qarray);
+}
+
+bool BatchCollisionChecker_setCollisionDetector(BatchCollisionChecker& self, const std::string& name)
+{
+    int index = CollisionDetector::factoryIndex(name);
+    if(index < 0){
+        return false;
+    }
+    self.setCollisionDetector(CollisionDetector::create(index));
+    return true;
+}
+
+//! \param q The array of the joint displacements of the configurations
+py::array_t<bool> BatchCollisionChecker_check(BatchCollisionChecker& self, InputArray q)
+{
+    auto body = self.body();
+    MatrixXd configurations = toConfigurationMatrix(q, body ? body->numJoints() : 0);
+    vector<bool> collided;
+    {
+        py::gil_scoped_release release;
+        self.check(configurations, collided);
+    }
+    return toBoolArray(collided);
+}
+
+}
+
+namespace cnoid {
+
+void exportPyBatchKinematics(py::module& m)
+{
+    py::class_<BatchForwardKinematics>(m, "BatchForwardKinematics")
+        .def(py::init<>())
+        .def(py::init<Body*, int>(), py::arg("body"), py::arg("numConfigurations") = 1)
+        .def("compile", &BatchForwardKinematics::compile)
+        .def_property_readonly("numConfigurations", &BatchForwardKinematics::numConfigurations)
+        .def_property_readonly("numLinks", &BatchForwardKinematics::numLinks)
+        .def("calcLinkPositions", &BatchForwardKinematics_calcLinkPositions)
+        ;
+
+    py::class_<BatchInverseKinematics>(m, "BatchInverseKinematics")
+        .def(py::init<Body*, Link*, Link*>())
+        .def("addBaseLink", &BatchInverseKinematics::addBaseLink)
+        .def_property("numThreads", &BatchInverseKinematics::numThreads, &BatchInverseKinematics::setNumThreads)
+        .def("setNumThreads", &BatchInverseKinematics::setNumThreads)
+        .def("solve", &BatchInverseKinematics_solve)
+        ;
+
+    py::class_<BatchCollisionChecker>(m, "BatchCollisionChecker")
+        .def(py::init<>())
+        .def(py::init([](Body* body, const std::string& collisionDetectorName){
+                    auto checker = new BatchCollisionChecker;
+                    checker->setBody(body);
+                    BatchCollisionChecker_setCollisionDetector(*checker, collisionDetectorName);
+                    return checker; }),
+            py::arg("body"), py::arg("collisionDetector") = "AISTCollisionDetector")
+        .def("setCollisionDetector", &BatchCollisionChecker_setCollisionDetector)
+        .def("setBody", &BatchCollisionChecker::setBody,
+             py::arg("body"), py::arg("isSelfCollisionDetectionEnabled") = true)
+        .def("addEnvironmentBody", &BatchCollisionChecker::addEnvironmentBody)
+        .def("clearEnvironmentBodies", &BatchCollisionChecker::clearEnvironmentBodies)
+        .def_property("numThreads", &BatchCollisionChecker::numThreads, &BatchCollisionChecker::setNumThreads)
+        .def("setNumThreads", &BatchCollisionChecker::setNumThreads)
+        .def("check", &BatchCollisionChecker_check)
+        ;
+}
+
+}
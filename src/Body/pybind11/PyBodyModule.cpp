@@ -5,6 +5,7 @@
 #include "../Body.h"
 #include "../BodyLoader.h"
 #include "../BodyMotion.h"
+#include "../MultiDeviceStateColumns.h"
 #include "../InverseKinematics.h"
 #include "../JointPath.h"
 #include "../LeggedBodyHelper.h"
@@ -27,6 +28,8 @@ void exportPyBody(py::module& m);
 void exportPyLink(py::module& m);
 void exportPyDeviceTypes(py::module& m);
 void exportPyMaterial(py::module& m);
+void exportPyJointStateBatch(py::module& m);
+void exportPyBatchKinematics(py::module& m);
 
 }
 
@@ -40,6 +43,8 @@ PYBIND11_MODULE(Body, m)
     exportPyLink(m);
     exportPyDeviceTypes(m);
     exportPyMaterial(m);
+    exportPyJointStateBatch(m);
+    exportPyBatchKinematics(m);
 
     py::class_<AbstractBodyLoader>(m, "AbstractBodyLoader")
         .def("setVerbose", &AbstractBodyLoader::setVerbose)
@@ -139,6 +144,32 @@ PYBIND11_MODULE(Body, m)
         .def("getFrame", &BodyMotion::Frame::frame)
         ;
 
+    py::class_<MultiDeviceStateColumns>(m, "MultiDeviceStateColumns")
+        .def(py::init<>())
+        .def(py::init([](const BodyMotion& motion){
+                    auto columns = new MultiDeviceStateColumns;
+                    columns->extract(motion);
+                    return columns; }))
+        .def("extract", [](MultiDeviceStateColumns& self, const BodyMotion& motion){ return self.extract(motion); })
+        .def_property_readonly("frameRate", &MultiDeviceStateColumns::frameRate)
+        .def_property_readonly("offsetTime", &MultiDeviceStateColumns::offsetTime)
+        .def_property_readonly("numFrames", &MultiDeviceStateColumns::numFrames)
+        .def_property_readonly("numDevices", &MultiDeviceStateColumns::numDevices)
+        .def("deviceIndex", &MultiDeviceStateColumns::deviceIndex)
+        .def("deviceName", &MultiDeviceStateColumns::deviceName)
+        .def("deviceTypeName", &MultiDeviceStateColumns::deviceTypeName)
+        .def("stateSize", &MultiDeviceStateColumns::stateSize)
+        .def("changeFrames", &MultiDeviceStateColumns::changeFrames)
+        .def("column", [](MultiDeviceStateColumns& self, int deviceIndex, int elementIndex){
+                auto& column = self.column(deviceIndex, elementIndex);
+                return VectorXd(Eigen::Map<const VectorXd>(column.data(), column.size())); })
+        .def("values", [](MultiDeviceStateColumns& self, int deviceIndex, int elementIndex){
+                VectorXd values(self.numFrames());
+                self.readValues(deviceIndex, elementIndex, 0, values.size(), values.data());
+                return values; })
+        .def("value", &MultiDeviceStateColumns::value)
+        ;
+
     py::class_<LeggedBodyHelper>(m, "LeggedBodyHelper")
         .def(py::init<>())
         .def(py::init<Body*>())
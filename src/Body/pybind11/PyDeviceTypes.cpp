@@ -6,6 +6,9 @@
 #include "../Device.h"
 #include "../Link.h"
 #include "../ForceSensor.h"
+#include "../Camera.h"
+#include "../RangeCamera.h"
+#include "../RangeSensor.h"
 #include <cnoid/PyUtil>
 
 using namespace std;
@@ -49,8 +52,78 @@ void exportPyDeviceTypes(py::module& m)
         .def("getLink", (Link*(Device::*)())&Device::link)
         ;
 
+    py::class_<Camera, CameraPtr, Device> cameraClass(m, "Camera");
+
+    cameraClass
+        .def(py::init<>())
+        .def_property("imageType", &Camera::imageType, &Camera::setImageType)
+        .def("setImageType", &Camera::setImageType)
+        .def_property("lensType", &Camera::lensType, &Camera::setLensType)
+        .def("setLensType", &Camera::setLensType)
+        .def_property("nearClipDistance", &Camera::nearClipDistance, &Camera::setNearClipDistance)
+        .def("setNearClipDistance", &Camera::setNearClipDistance)
+        .def_property("farClipDistance", &Camera::farClipDistance, &Camera::setFarClipDistance)
+        .def("setFarClipDistance", &Camera::setFarClipDistance)
+        .def_property("fieldOfView", &Camera::fieldOfView, &Camera::setFieldOfView)
+        .def("setFieldOfView", &Camera::setFieldOfView)
+        .def("setResolution", &Camera::setResolution)
+        .def_property("resolutionX", &Camera::resolutionX, &Camera::setResolutionX)
+        .def("setResolutionX", &Camera::setResolutionX)
+        .def_property("resolutionY", &Camera::resolutionY, &Camera::setResolutionY)
+        .def("setResolutionY", &Camera::setResolutionY)
+        .def_property("frameRate", &Camera::frameRate, &Camera::setFrameRate)
+        .def("setFrameRate", &Camera::setFrameRate)
+        .def_property_readonly("delay", &Camera::delay)
+        ;
+
+    py::enum_<Camera::ImageType>(cameraClass, "ImageType")
+        .value("NO_IMAGE", Camera::NO_IMAGE)
+        .value("COLOR_IMAGE", Camera::COLOR_IMAGE)
+        .value("GRAYSCALE_IMAGE", Camera::GRAYSCALE_IMAGE)
+        .export_values();
+
+    py::enum_<Camera::LensType>(cameraClass, "LensType")
+        .value("NORMAL_LENS", Camera::NORMAL_LENS)
+        .value("FISHEYE_LENS", Camera::FISHEYE_LENS)
+        .value("DUAL_FISHEYE_LENS", Camera::DUAL_FISHEYE_LENS)
+        .export_values();
+
+    py::class_<RangeCamera, RangeCameraPtr, Camera>(m, "RangeCamera")
+        .def(py::init<>())
+        .def_property("minDistance", &RangeCamera::minDistance, &RangeCamera::setMinDistance)
+        .def("setMinDistance", &RangeCamera::setMinDistance)
+        .def_property("maxDistance", &RangeCamera::maxDistance, &RangeCamera::setMaxDistance)
+        .def("setMaxDistance", &RangeCamera::setMaxDistance)
+        .def_property("isOrganized", &RangeCamera::isOrganized, &RangeCamera::setOrganized)
+        .def("setOrganized", &RangeCamera::setOrganized)
+        ;
+
+    py::class_<RangeSensor, RangeSensorPtr, Device>(m, "RangeSensor")
+        .def(py::init<>())
+        .def_property("yawRange", &RangeSensor::yawRange, &RangeSensor::setYawRange)
+        .def("setYawRange", &RangeSensor::setYawRange)
+        .def_property("yawStep", &RangeSensor::yawStep, &RangeSensor::setYawStep)
+        .def("setYawStep", &RangeSensor::setYawStep)
+        .def_property_readonly("numYawSamples", &RangeSensor::numYawSamples)
+        .def_property("pitchRange", &RangeSensor::pitchRange, &RangeSensor::setPitchRange)
+        .def("setPitchRange", &RangeSensor::setPitchRange)
+        .def_property("pitchStep", &RangeSensor::pitchStep, &RangeSensor::setPitchStep)
+        .def("setPitchStep", &RangeSensor::setPitchStep)
+        .def_property_readonly("numPitchSamples", &RangeSensor::numPitchSamples)
+        .def_property("minDistance", &RangeSensor::minDistance, &RangeSensor::setMinDistance)
+        .def("setMinDistance", &RangeSensor::setMinDistance)
+        .def_property("maxDistance", &RangeSensor::maxDistance, &RangeSensor::setMaxDistance)
+        .def("setMaxDistance", &RangeSensor::setMaxDistance)
+        .def_property("frameRate", &RangeSensor::frameRate, &RangeSensor::setFrameRate)
+        .def("setFrameRate", &RangeSensor::setFrameRate)
+        .def_property_readonly("delay", &RangeSensor::delay)
+        ;
+
     PyDeviceList<Device>(m, "DeviceList");
     PyDeviceList<ForceSensor>(m, "ForceSensorList");
+    PyDeviceList<Camera>(m, "CameraList");
+    PyDeviceList<RangeCamera>(m, "RangeCameraList");
+    PyDeviceList<RangeSensor>(m, "RangeSensorList");
 }
 
 }
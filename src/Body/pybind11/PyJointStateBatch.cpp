@@ -0,0 +1,52 @@
+#include "../JointStateBatch.h"
+#include "../Body.h"
+#include <cnoid/PyUtil>
+#include <pybind11/numpy.h>
+
+using namespace std;
+using namespace cnoid;
+namespace py = pybind11;
+
+namespace {
+
+/*
+  The array shares the memory of the batch, which is kept alive by the array object.
+  The array becomes invalid when a body is added to the batch or the batch is cleared.
+*/
+py::array getArrayView(VectorXd& values, py::handle batch)
+{
+    return py::array_t<double>(
+        { static_cast<py::ssize_t>(values.size()) }, { static_cast<py::ssize_t>(sizeof(double)) },
+        values.data(), batch);
+}
+
+}
+
+namespace cnoid {
+
+void exportPyJointStateBatch(py::module& m)
+{
+    py::class_<JointStateBatch, JointStateBatchPtr, Referenced>(m, "JointStateBatch")
+        .def(py::init<>())
+        .def("addBody", &JointStateBatch::addBody)
+        .def("clear", &JointStateBatch::clear)
+        .def_property_readonly("numBodies", &JointStateBatch::numBodies)
+        .def("body", &JointStateBatch::body)
+        .def_property_readonly("numJoints", &JointStateBatch::numJoints)
+        .def("jointOffset", &JointStateBatch::jointOffset)
+        .def_property_readonly(
+            "q", [](py::object self){ return getArrayView(self.cast<JointStateBatch&>().q(), self); })
+        .def_property_readonly(
+            "dq", [](py::object self){ return getArrayView(self.cast<JointStateBatch&>().dq(), self); })
+        .def_property_readonly(
+            "u", [](py::object self){ return getArrayView(self.cast<JointStateBatch&>().u(), self); })
+        .def_property_readonly(
+            "q_target", [](py::object self){ return getArrayView(self.cast<JointStateBatch&>().q_target(), self); })
+        .def_property_readonly(
+            "dq_target", [](py::object self){ return getArrayView(self.cast<JointStateBatch&>().dq_target(), self); })
+        .def("readState", &JointStateBatch::readState)
+        .def("writeCommands", &JointStateBatch::writeCommands)
+        ;
+}
+
+}
@@ -83,13 +83,18 @@ public:
         
     Selection dynamicsMode;
     Selection integrationMode;
+    Selection constraintSolverType;
     Vector3 gravity;
     double minFrictionCoefficient;
     double maxFrictionCoefficient;
     FloatingNumberString contactCullingDistance;
     FloatingNumberString contactCullingDepth;
+    bool isContactReductionEnabled;
     FloatingNumberString errorCriterion;
     int maxNumIterations;
+    int numThreadsForIntegration;
+    int numThreadsForAccelerationMatrix;
+    bool isGaussSeidelVectorizationEnabled;
     FloatingNumberString contactCorrectionDepth;
     FloatingNumberString contactCorrectionVelocityRatio;
     double epsilon;
@@ -142,7 +147,8 @@ AISTSimulatorItem::AISTSimulatorItem()
 AISTSimulatorItem::Impl::Impl(AISTSimulatorItem* self)
     : self(self),
       dynamicsMode(AISTSimulatorItem::N_DYNAMICS_MODES, CNOID_GETTEXT_DOMAIN_NAME),
-      integrationMode(AISTSimulatorItem::N_INTEGRATION_MODES, CNOID_GETTEXT_DOMAIN_NAME)
+      integrationMode(AISTSimulatorItem::N_INTEGRATION_MODES, CNOID_GETTEXT_DOMAIN_NAME),
+      constraintSolverType(AISTSimulatorItem::N_CONSTRAINT_SOLVER_TYPES, CNOID_GETTEXT_DOMAIN_NAME)
 {
     dynamicsMode.setSymbol(AISTSimulatorItem::FORWARD_DYNAMICS,  N_("Forward dynamics"));
     dynamicsMode.setSymbol(AISTSimulatorItem::KINEMATICS,        N_("Kinematics"));
@@ -150,6 +156,10 @@ AISTSimulatorItem::Impl::Impl(AISTSimulatorItem* self)
     integrationMode.setSymbol(AISTSimulatorItem::EULER_INTEGRATION,  N_("Euler"));
     integrationMode.setSymbol(AISTSimulatorItem::RUNGE_KUTTA_INTEGRATION,  N_("Runge Kutta"));
     integrationMode.select(AISTSimulatorItem::RUNGE_KUTTA_INTEGRATION);
+
+    constraintSolverType.setSymbol(AISTSimulatorItem::GAUSS_SEIDEL_SOLVER, N_("Gauss-Seidel"));
+    constraintSolverType.setSymbol(AISTSimulatorItem::NNCG_SOLVER, N_("NNCG"));
+    constraintSolverType.select(AISTSimulatorItem::GAUSS_SEIDEL_SOLVER);
     
     gravity << 0.0, 0.0, -DEFAULT_GRAVITY_ACCELERATION;
 
@@ -158,10 +168,14 @@ AISTSimulatorItem::Impl::Impl(AISTSimulatorItem* self)
     maxFrictionCoefficient = cfs.maxFrictionCoefficient();
     contactCullingDistance = cfs.contactCullingDistance();
     contactCullingDepth = cfs.contactCullingDepth();
+    isContactReductionEnabled = cfs.isContactReductionEnabled();
     epsilon = cfs.coefficientOfRestitution();
     
     errorCriterion = cfs.gaussSeidelErrorCriterion();
     maxNumIterations = cfs.gaussSeidelMaxNumIterations();
+    numThreadsForIntegration = 1;
+    numThreadsForAccelerationMatrix = 1;
+    isGaussSeidelVectorizationEnabled = cfs.isGaussSeidelVectorizationEnabled();
     contactCorrectionDepth = cfs.contactCorrectionDepth();
     contactCorrectionVelocityRatio = cfs.contactCorrectionVelocityRatio();
 
@@ -185,15 +199,20 @@ AISTSimulatorItem::AISTSimulatorItem(const AISTSimulatorItem& org)
 AISTSimulatorItem::Impl::Impl(AISTSimulatorItem* self, const Impl& org)
     : self(self),
       dynamicsMode(org.dynamicsMode),
-      integrationMode(org.integrationMode)
+      integrationMode(org.integrationMode),
+      constraintSolverType(org.constraintSolverType)
 {
     gravity = org.gravity;
     minFrictionCoefficient = org.minFrictionCoefficient;
     maxFrictionCoefficient = org.maxFrictionCoefficient;
     contactCullingDistance = org.contactCullingDistance;
     contactCullingDepth = org.contactCullingDepth;
+    isContactReductionEnabled = org.isContactReductionEnabled;
     errorCriterion = org.errorCriterion;
     maxNumIterations = org.maxNumIterations;
+    numThreadsForIntegration = org.numThreadsForIntegration;
+    numThreadsForAccelerationMatrix = org.numThreadsForAccelerationMatrix;
+    isGaussSeidelVectorizationEnabled = org.isGaussSeidelVectorizationEnabled;
     contactCorrectionDepth = org.contactCorrectionDepth;
     contactCorrectionVelocityRatio = org.contactCorrectionVelocityRatio;
     epsilon = org.epsilon;
@@ -223,6 +242,12 @@ void AISTSimulatorItem::setIntegrationMode(int mode)
 }
 
 
+void AISTSimulatorItem::setConstraintSolverType(int type)
+{
+    impl->constraintSolverType.select(type);
+}
+
+
 void AISTSimulatorItem::setGravity(const Vector3& gravity)
 {
     impl->gravity = gravity;
@@ -288,6 +313,12 @@ void AISTSimulatorItem::setContactCullingDepth(double value)
 }
 
     
+void AISTSimulatorItem::setContactReductionEnabled(bool on)
+{
+    impl->isContactReductionEnabled = on;
+}
+
+
 void AISTSimulatorItem::setErrorCriterion(double value)    
 {
     impl->errorCriterion = value;
@@ -300,6 +331,24 @@ void AISTSimulatorItem::setMaxNumIterations(int value)
 }
 
 
+void AISTSimulatorItem::setNumThreadsForIntegration(int n)
+{
+    impl->numThreadsForIntegration = n;
+}
+
+
+void AISTSimulatorItem::setNumThreadsForAccelerationMatrix(int n)
+{
+    impl->numThreadsForAccelerationMatrix = n;
+}
+
+
+void AISTSimulatorItem::setGaussSeidelVectorizationEnabled(bool on)
+{
+    impl->isGaussSeidelVectorizationEnabled = on;
+}
+
+
 void AISTSimulatorItem::setContactCorrectionDepth(double value)
 {
     impl->contactCorrectionDepth = value;
@@ -415,11 +464,19 @@ bool AISTSimulatorItem::Impl::initializeSimulation(const std::vector<SimulationB
     world.setOldAccelSensorCalcMode(isOldAccelSensorMode);
     world.setTimeStep(self->worldTimeStep());
     world.setCurrentTime(0.0);
+    world.setNumThreadsForIntegration(numThreadsForIntegration);
 
     ConstraintForceSolver& cfs = world.constraintForceSolver;
     cfs.setMaterialTable(self->worldItem()->materialTable());
+    if(constraintSolverType.is(AISTSimulatorItem::NNCG_SOLVER)){
+        cfs.setMCPSolverType(ConstraintForceSolver::NNCG_SOLVER);
+    } else {
+        cfs.setMCPSolverType(ConstraintForceSolver::GAUSS_SEIDEL_SOLVER);
+    }
     cfs.setGaussSeidelErrorCriterion(errorCriterion.value());
     cfs.setGaussSeidelMaxNumIterations(maxNumIterations);
+    cfs.setGaussSeidelVectorizationEnabled(isGaussSeidelVectorizationEnabled);
+    cfs.setNumThreadsForAccelerationMatrix(numThreadsForAccelerationMatrix);
     cfs.setContactDepthCorrection(contactCorrectionDepth.value(), contactCorrectionVelocityRatio.value());
     
     self->addPostDynamicsFunction([&](){ clearExternalForces(); });
@@ -451,6 +508,7 @@ bool AISTSimulatorItem::Impl::initializeSimulation(const std::vector<SimulationB
     cfs.setFrictionCoefficientRange(minFrictionCoefficient, maxFrictionCoefficient);
     cfs.setContactCullingDistance(contactCullingDistance.value());
     cfs.setContactCullingDepth(contactCullingDepth.value());
+    cfs.setContactReductionEnabled(isContactReductionEnabled);
     cfs.setCoefficientOfRestitution(epsilon);
     cfs.setCollisionDetector(self->getOrCreateCollisionDetector());
 
@@ -625,6 +683,46 @@ std::shared_ptr<CollisionLinkPairList> AISTSimulatorItem::getCollisions()
 }
 
 
+/**
+   The impulses used to warm-start the constraint force solver are also stored so that the
+   simulation restored from the snapshot proceeds in the same way as the original one.
+*/
+void AISTSimulatorItem::storeSnapshotState(std::vector<double>& out_state)
+{
+    out_state.push_back(impl->world.currentTime());
+    impl->world.constraintForceSolver.storeWarmStartState(out_state);
+}
+
+
+bool AISTSimulatorItem::restoreSnapshotState(const std::vector<double>& state)
+{
+    if(state.empty()){
+        return false;
+    }
+    auto& world = impl->world;
+    if(state.size() > 1){
+        size_t position = 1;
+        if(!world.constraintForceSolver.restoreWarmStartState(state, position)){
+            return false;
+        }
+    } else {
+        // The snapshot stored without the impulses starts the solver without them
+        size_t position = 0;
+        world.constraintForceSolver.restoreWarmStartState({ 0.0 }, position);
+    }
+    world.setCurrentTime(state[0]);
+
+    for(auto& body : world.bodies()){
+        for(auto& link : body->links()){
+            link->vo() = link->v() - link->w().cross(link->p());
+        }
+    }
+    world.refreshState();
+    
+    return true;
+}
+
+
 Vector3 AISTSimulatorItem::getGravity() const
 {
     return impl->gravity;
@@ -713,9 +811,14 @@ void AISTSimulatorItem::Impl::doPutProperties(PutPropertyFunction& putProperty)
                 [&](const string& v){ return contactCullingDistance.setNonNegativeValue(v); });
     putProperty(_("Contact culling depth"), contactCullingDepth,
                 [&](const string& v){ return contactCullingDepth.setNonNegativeValue(v); });
+    putProperty(_("Contact reduction"), isContactReductionEnabled, changeProperty(isContactReductionEnabled));
+    putProperty(_("Constraint solver"), constraintSolverType,
+                [&](int index){ return constraintSolverType.selectIndex(index); });
     putProperty(_("Error criterion"), errorCriterion,
                 [&](const string& v){ return errorCriterion.setPositiveValue(v); });
     putProperty.min(1)(_("Max iterations"), maxNumIterations, changeProperty(maxNumIterations));
+    putProperty(_("Vectorized solver"), isGaussSeidelVectorizationEnabled,
+                changeProperty(isGaussSeidelVectorizationEnabled));
     putProperty(_("CC depth"), contactCorrectionDepth,
                 [&](const string& v){ return contactCorrectionDepth.setNonNegativeValue(v); });
     putProperty(_("CC v-ratio"), contactCorrectionVelocityRatio,
@@ -724,6 +827,10 @@ void AISTSimulatorItem::Impl::doPutProperties(PutPropertyFunction& putProperty)
                 changeProperty(isKinematicWalkingEnabled));
     putProperty(_("2D mode"), is2Dmode, changeProperty(is2Dmode));
     putProperty(_("Old accel sensor mode"), isOldAccelSensorMode, changeProperty(isOldAccelSensorMode));
+    putProperty.min(1)(_("Integration threads"), numThreadsForIntegration,
+                       changeProperty(numThreadsForIntegration));
+    putProperty.min(1)(_("Constraint matrix threads"), numThreadsForAccelerationMatrix,
+                       changeProperty(numThreadsForAccelerationMatrix));
 }
 
 
@@ -738,18 +845,23 @@ bool AISTSimulatorItem::Impl::store(Archive& archive)
 {
     archive.write("dynamicsMode", dynamicsMode.selectedSymbol(), DOUBLE_QUOTED);
     archive.write("integrationMode", integrationMode.selectedSymbol(), DOUBLE_QUOTED);
+    archive.write("constraintSolver", constraintSolverType.selectedSymbol(), DOUBLE_QUOTED);
     write(archive, "gravity", gravity);
     archive.write("min_friction_coefficient", minFrictionCoefficient);
     archive.write("max_friction_coefficient", maxFrictionCoefficient);
     archive.write("cullingThresh", contactCullingDistance);
     archive.write("contactCullingDepth", contactCullingDepth);
+    archive.write("contactReduction", isContactReductionEnabled);
     archive.write("errorCriterion", errorCriterion);
     archive.write("maxNumIterations", maxNumIterations);
+    archive.write("vectorizedSolver", isGaussSeidelVectorizationEnabled);
     archive.write("contactCorrectionDepth", contactCorrectionDepth);
     archive.write("contactCorrectionVelocityRatio", contactCorrectionVelocityRatio);
     archive.write("kinematicWalking", isKinematicWalkingEnabled);
     archive.write("2Dmode", is2Dmode);
     archive.write("oldAccelSensorMode", isOldAccelSensorMode);
+    archive.write("numThreadsForIntegration", numThreadsForIntegration);
+    archive.write("numThreadsForAccelerationMatrix", numThreadsForAccelerationMatrix);
     return true;
 }
 
@@ -770,17 +882,24 @@ bool AISTSimulatorItem::Impl::restore(const Archive& archive)
     if(archive.read("integrationMode", symbol)){
         integrationMode.select(symbol);
     }
+    if(archive.read("constraintSolver", symbol)){
+        constraintSolverType.select(symbol);
+    }
     read(archive, "gravity", gravity);
     archive.read("min_friction_coefficient", minFrictionCoefficient);
     archive.read("max_friction_coefficient", maxFrictionCoefficient);
     contactCullingDistance = archive.get("cullingThresh", contactCullingDistance.string());
     contactCullingDepth = archive.get("contactCullingDepth", contactCullingDepth.string());
+    archive.read("contactReduction", isContactReductionEnabled);
     errorCriterion = archive.get("errorCriterion", errorCriterion.string());
     archive.read("maxNumIterations", maxNumIterations);
+    archive.read("vectorizedSolver", isGaussSeidelVectorizationEnabled);
     contactCorrectionDepth = archive.get("contactCorrectionDepth", contactCorrectionDepth.string());
     contactCorrectionVelocityRatio = archive.get("contactCorrectionVelocityRatio", contactCorrectionVelocityRatio.string());
     archive.read("kinematicWalking", isKinematicWalkingEnabled);
     archive.read("2Dmode", is2Dmode);
     archive.read("oldAccelSensorMode", isOldAccelSensorMode);
+    archive.read("numThreadsForIntegration", numThreadsForIntegration);
+    archive.read("numThreadsForAccelerationMatrix", numThreadsForAccelerationMatrix);
     return true;
 }
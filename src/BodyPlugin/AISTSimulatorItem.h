@@ -26,9 +26,11 @@ public:
 
     enum DynamicsMode { FORWARD_DYNAMICS = 0, KINEMATICS, N_DYNAMICS_MODES };
     enum IntegrationMode { EULER_INTEGRATION = 0, RUNGE_KUTTA_INTEGRATION, N_INTEGRATION_MODES };
+    enum ConstraintSolverType { GAUSS_SEIDEL_SOLVER = 0, NNCG_SOLVER, N_CONSTRAINT_SOLVER_TYPES };
 
     void setDynamicsMode(int mode);
     void setIntegrationMode(int mode);
+    void setConstraintSolverType(int type);
     void setGravity(const Vector3& gravity);
     const Vector3& gravity() const;
     void setFrictionCoefficientRange(double minFriction, double maxFriction);
@@ -36,8 +38,12 @@ public:
     double maxFrictionCoefficient() const;
     void setContactCullingDistance(double value);        
     void setContactCullingDepth(double value);        
+    void setContactReductionEnabled(bool on);
     void setErrorCriterion(double value);        
     void setMaxNumIterations(int value);
+    void setNumThreadsForIntegration(int n);
+    void setNumThreadsForAccelerationMatrix(int n);
+    void setGaussSeidelVectorizationEnabled(bool on);
     void setContactCorrectionDepth(double value);
     void setContactCorrectionVelocityRatio(double value);
     void setEpsilon(double epsilon);
@@ -72,6 +78,8 @@ protected:
     virtual bool stepSimulation(const std::vector<SimulationBody*>& activeSimBodies) override;
     virtual void finalizeSimulation() override;
     virtual std::shared_ptr<CollisionLinkPairList> getCollisions() override;
+    virtual void storeSnapshotState(std::vector<double>& out_state) override;
+    virtual bool restoreSnapshotState(const std::vector<double>& state) override;
         
     virtual Item* doDuplicate() const override;
     virtual void doPutProperties(PutPropertyFunction& putProperty) override;
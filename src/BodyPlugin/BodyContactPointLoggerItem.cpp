@@ -3,6 +3,7 @@
 #include <cnoid/ControllerLogItem>
 #include <cnoid/TimeSyncItemEngine>
 #include <cnoid/SceneDrawables>
+#include <cstring>
 #include "gettext.h"
 
 using namespace std;
@@ -21,12 +22,17 @@ public:
 typedef ref_ptr<BodyContactPointLogItem> BodyContactPointLogItemPtr;
 
 
-class BodyContactPointLog : public Referenced
+class BodyContactPointLog : public Referenced, public SerializableLogData
 {
 public:
     vector<vector<Link::ContactPoint>> bodyContactPoints;
+
+    virtual void serializeLogData(std::string& out_data) const override;
+    virtual Referenced* deserializeLogData(const std::string& data) const override;
 };
 
+typedef ref_ptr<BodyContactPointLog> BodyContactPointLogPtr;
+
 
 class BodyContactPointLogEngine : public TimeSyncItemEngine
 {
@@ -190,6 +196,74 @@ Item* BodyContactPointLogItem::doDuplicate() const
 }
 
 
+/*
+  The data consists of the number of links and the contact points of each link, which are the
+  number of the points followed by the position, normal, force, velocity and depth of each point.
+*/
+void BodyContactPointLog::serializeLogData(std::string& out_data) const
+{
+    auto putInt = [&](int value){
+        out_data.append(reinterpret_cast<const char*>(&value), sizeof(value)); };
+    auto putVector3 = [&](const Vector3& v){
+        out_data.append(reinterpret_cast<const char*>(v.data()), sizeof(double) * 3); };
+
+    putInt(bodyContactPoints.size());
+    for(auto& points : bodyContactPoints){
+        putInt(points.size());
+        for(auto& point : points){
+            putVector3(point.position());
+            putVector3(point.normal());
+            putVector3(point.force());
+            putVector3(point.velocity());
+            double depth = point.depth();
+            out_data.append(reinterpret_cast<const char*>(&depth), sizeof(depth));
+        }
+    }
+}
+
+
+Referenced* BodyContactPointLog::deserializeLogData(const std::string& data) const
+{
+    const char* pos = data.data();
+    const char* end = pos + data.size();
+    auto get = [&](void* out_value, size_t size){
+        if(end - pos < static_cast<ptrdiff_t>(size)){
+            return false;
+        }
+        std::memcpy(out_value, pos, size);
+        pos += size;
+        return true;
+    };
+
+    BodyContactPointLogPtr log = new BodyContactPointLog;
+    int numLinks;
+    if(!get(&numLinks, sizeof(numLinks)) || numLinks < 0){
+        return nullptr;
+    }
+    log->bodyContactPoints.resize(numLinks);
+    for(auto& points : log->bodyContactPoints){
+        int numPoints;
+        if(!get(&numPoints, sizeof(numPoints)) || numPoints < 0){
+            return nullptr;
+        }
+        points.reserve(numPoints);
+        for(int i=0; i < numPoints; ++i){
+            Vector3 position, normal, force, velocity;
+            double depth;
+            if(!get(position.data(), sizeof(double) * 3) ||
+               !get(normal.data(), sizeof(double) * 3) ||
+               !get(force.data(), sizeof(double) * 3) ||
+               !get(velocity.data(), sizeof(double) * 3) ||
+               !get(&depth, sizeof(depth))){
+                return nullptr;
+            }
+            points.emplace_back(position, normal, force, velocity, depth);
+        }
+    }
+    return log.retn();
+}
+
+
 BodyContactPointLogEngine* BodyContactPointLogEngine::create
 (BodyContactPointLogItem* logItem, BodyContactPointLogEngine* engine0)
 {
@@ -243,7 +317,7 @@ bool BodyContactPointLogEngine::onTimeChanged(double time)
         frame = log->numFrames() - 1;
     }
 
-    if(auto contactPointLog = dynamic_pointer_cast<BodyContactPointLog>(log->at(frame))){
+    if(auto contactPointLog = dynamic_pointer_cast<BodyContactPointLog>(logItem->logData(frame))){
         auto loggerItemImpl = BodyContactPointLoggerItem::Impl::getImpl(loggerItem);
         loggerItemImpl->updateScene(contactPointLog->bodyContactPoints);
     }
@@ -94,22 +94,39 @@ public:
     shared_ptr<InverseKinematics> holderIK;
 };
 
+/**
+   The joint positions are stored as the differences from the last edit state so that
+   the records of the edits on a body with many joints do not consume much memory.
+*/
 class KinematicStateRecord : public EditRecord
 {
 public:
     BodyItemPtr bodyItem;
     BodyItem::Impl* bodyItemImpl;
-    BodyState newState;
-    BodyState oldState;
+    int numJoints;
+    struct JointDelta {
+        int index;
+        double oldPosition;
+        double newPosition;
+    };
+    vector<JointDelta> jointDeltas;
+    BodyState::Data oldLinkPositions;
+    BodyState::Data newLinkPositions;
+    BodyState::Data oldZmp;
+    BodyState::Data newZmp;
     
     KinematicStateRecord(BodyItem::Impl* bodyItemImpl);
     KinematicStateRecord(BodyItem::Impl* bodyItemImpl, const BodyState& oldState);
     KinematicStateRecord(const KinematicStateRecord& org);
+    void setStates(const BodyState& newState, const BodyState& oldState);
 
     virtual EditRecord* clone() const override;
     virtual std::string label() const override;
+    virtual bool merge(const EditRecord* nextRecord) override;
+    virtual size_t memoryUsage() const override;
     virtual bool undo() override;
     virtual bool redo() override;
+    bool restoreState(bool isNewState);
 };
 
 }
@@ -1917,18 +1934,20 @@ KinematicStateRecord::KinematicStateRecord(BodyItem::Impl* bodyItemImpl)
       bodyItem(bodyItemImpl->self),
       bodyItemImpl(bodyItemImpl)
 {
-    bodyItem->storeKinematicState(newState);
-    oldState = newState;
+    BodyState state;
+    bodyItem->storeKinematicState(state);
+    setStates(state, state);
 }
 
 
 KinematicStateRecord::KinematicStateRecord(BodyItem::Impl* bodyItemImpl, const BodyState& oldState)
     : EditRecord(bodyItemImpl->self),
       bodyItem(bodyItemImpl->self),
-      bodyItemImpl(bodyItemImpl),
-      oldState(oldState)
+      bodyItemImpl(bodyItemImpl)
 {
+    BodyState newState;
     bodyItem->storeKinematicState(newState);
+    setStates(newState, oldState);
 }
 
 
@@ -1936,13 +1955,39 @@ KinematicStateRecord::KinematicStateRecord(const KinematicStateRecord& org)
     : EditRecord(org),
       bodyItem(org.bodyItem),
       bodyItemImpl(org.bodyItemImpl),
-      newState(org.newState),
-      oldState(org.oldState)
+      numJoints(org.numJoints),
+      jointDeltas(org.jointDeltas),
+      oldLinkPositions(org.oldLinkPositions),
+      newLinkPositions(org.newLinkPositions),
+      oldZmp(org.oldZmp),
+      newZmp(org.newZmp)
 {
 
 }
 
 
+void KinematicStateRecord::setStates(const BodyState& newState, const BodyState& oldState)
+{
+    auto& q_new = newState.data(BodyState::JOINT_POSITIONS);
+    auto& q_old = oldState.data(BodyState::JOINT_POSITIONS);
+    numJoints = q_new.size();
+    if(q_old.size() != q_new.size()){
+        // The delta cannot be applied, so the undo of this record always fails
+        numJoints = -1;
+    } else {
+        for(int i=0; i < numJoints; ++i){
+            if(q_new[i] != q_old[i]){
+                jointDeltas.push_back({ i, q_old[i], q_new[i] });
+            }
+        }
+    }
+    newLinkPositions = newState.data(BodyState::LINK_POSITIONS);
+    oldLinkPositions = oldState.data(BodyState::LINK_POSITIONS);
+    newZmp = newState.data(BodyState::ZMP);
+    oldZmp = oldState.data(BodyState::ZMP);
+}
+
+
 EditRecord* KinematicStateRecord::clone() const
 {
     return new KinematicStateRecord(*this);
@@ -1959,19 +2004,83 @@ std::string KinematicStateRecord::label() const
 }
 
 
-bool KinematicStateRecord::undo()
+bool KinematicStateRecord::merge(const EditRecord* nextRecord)
 {
-    bodyItem->restoreKinematicState(oldState);
-    bodyItem->storeKinematicState(bodyItemImpl->lastEditState);
-    bodyItemImpl->notifyKinematicStateChange(false, false, false, true);
+    auto next = dynamic_cast<const KinematicStateRecord*>(nextRecord);
+    if(!next || next->bodyItem != bodyItem || next->numJoints != numJoints || numJoints < 0){
+        return false;
+    }
+
+    // Both the delta lists are sorted by the joint index
+    vector<JointDelta> merged;
+    merged.reserve(jointDeltas.size() + next->jointDeltas.size());
+    auto p = jointDeltas.begin();
+    auto q = next->jointDeltas.begin();
+    while(p != jointDeltas.end() || q != next->jointDeltas.end()){
+        JointDelta delta;
+        if(q == next->jointDeltas.end() || (p != jointDeltas.end() && p->index < q->index)){
+            delta = *p++;
+        } else if(p == jointDeltas.end() || q->index < p->index){
+            delta = *q++;
+        } else {
+            delta = { p->index, p->oldPosition, q->newPosition };
+            ++p;
+            ++q;
+        }
+        if(delta.newPosition != delta.oldPosition){
+            merged.push_back(delta);
+        }
+    }
+    merged.shrink_to_fit();
+    jointDeltas.swap(merged);
+    
+    newLinkPositions = next->newLinkPositions;
+    newZmp = next->newZmp;
+
     return true;
 }
 
 
+size_t KinematicStateRecord::memoryUsage() const
+{
+    return sizeof(KinematicStateRecord) +
+        jointDeltas.capacity() * sizeof(JointDelta) +
+        (oldLinkPositions.capacity() + newLinkPositions.capacity() +
+         oldZmp.capacity() + newZmp.capacity()) * sizeof(double);
+}
+
+
+bool KinematicStateRecord::undo()
+{
+    return restoreState(false);
+}
+
+
 bool KinematicStateRecord::redo()
 {
-    bodyItem->restoreKinematicState(newState);
-    bodyItem->storeKinematicState(bodyItemImpl->lastEditState);
+    return restoreState(true);
+}
+
+
+/**
+   The state is reconstructed from the last edit state, which is the state on the other side
+   of this record when the undo and redo operations are carried out in the order of the history.
+*/
+bool KinematicStateRecord::restoreState(bool isNewState)
+{
+    auto& state = bodyItemImpl->lastEditState;
+    auto& q = state.data(BodyState::JOINT_POSITIONS);
+    if(numJoints < 0 || static_cast<int>(q.size()) != numJoints){
+        return false;
+    }
+    for(auto& delta : jointDeltas){
+        q[delta.index] = isNewState ? delta.newPosition : delta.oldPosition;
+    }
+    state.data(BodyState::LINK_POSITIONS) = isNewState ? newLinkPositions : oldLinkPositions;
+    state.data(BodyState::ZMP) = isNewState ? newZmp : oldZmp;
+    
+    bodyItem->restoreKinematicState(state);
+    bodyItem->storeKinematicState(state);
     bodyItemImpl->notifyKinematicStateChange(false, false, false, true);
     return true;
 }
@@ -150,7 +150,7 @@ void BodyItemFileIoBase::addTransformIntegrationCheck(QBoxLayout* box)
 
 
 BodyItemBodyFileIO::BodyItemBodyFileIO()
-    : BodyItemFileIoBase("CHOREONOID-BODY", Load | Save | Options | OptionPanelForSaving)
+    : BodyItemFileIoBase("CHOREONOID-BODY", Load | Save | Options | OptionPanelForSaving | Prefetch)
 {
     setCaption(_("Body"));
 
@@ -185,11 +185,27 @@ BodyLoader* BodyItemBodyFileIO::ensureBodyLoader()
 }
 
 
+ReferencedPtr BodyItemBodyFileIO::prefetch(const std::string& filename, std::ostream& os)
+{
+    // A loader is created for each prefetch because the loader is not thread-safe
+    BodyLoader loader;
+    loader.setMessageSink(os);
+    BodyPtr body = new Body;
+    if(!loader.load(body, filename)){
+        return nullptr;
+    }
+    return body;
+}
+
+
 bool BodyItemBodyFileIO::load(BodyItem* item, const std::string& filename)
 {
-    BodyPtr newBody = new Body;
-    if(!ensureBodyLoader()->load(newBody, filename)){
-        return false;
+    BodyPtr newBody = dynamic_pointer_cast<Body>(takePrefetchedData(filename));
+    if(!newBody){
+        newBody = new Body;
+        if(!ensureBodyLoader()->load(newBody, filename)){
+            return false;
+        }
     }
     item->setBody(newBody);
     
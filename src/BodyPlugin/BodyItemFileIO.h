@@ -44,6 +44,7 @@ protected:
     BodyLoader* ensureBodyLoader();
     StdBodyWriter* ensureBodyWriter();
 
+    virtual ReferencedPtr prefetch(const std::string& filename, std::ostream& os) override;
     virtual bool load(BodyItem* item, const std::string& filename) override;
     virtual void createOptionPanelForSaving() override;
     virtual void fetchOptionPanelForSaving() override;
@@ -6,6 +6,8 @@
 #include "BodyMotionEngine.h"
 #include "BodyItem.h"
 #include "BodyMotionItem.h"
+#include <cnoid/BodyMotionPager>
+#include <cnoid/LinkTraverse>
 #include <cnoid/ExtensionManager>
 #include <cnoid/ConnectionSet>
 #include <map>
@@ -32,11 +34,19 @@ public:
     BodyItemPtr bodyItem;
     BodyMotionItemPtr motionItem;
     BodyPtr body;
+    shared_ptr<BodyMotion> motion;
     shared_ptr<MultiValueSeq> qSeq;
     shared_ptr<MultiSE3Seq> positions;
     bool calcForwardKinematics;
     std::vector<TimeSyncItemEnginePtr> extraSeqEngines;
     ScopedConnectionSet connections;
+
+    // The clone of the body to compute the forward kinematics in the time change preparation
+    BodyPtr fkBody;
+    LinkTraverse fkTraverse;
+    int fkBaseLinkIndex;
+    double preparedTime;
+    bool isPrepared;
         
     Impl(BodyMotionEngine* self, BodyItem* bodyItem, BodyMotionItem* motionItem)
         : bodyItem(bodyItem),
@@ -44,10 +54,12 @@ public:
     {
         body = bodyItem->body();
         
-        auto motion = motionItem->motion();
+        motion = motionItem->motion();
         qSeq = motion->jointPosSeq();
         positions = motion->linkPosSeq();
         calcForwardKinematics = !(positions && positions->numParts() > 1);
+        fkBaseLinkIndex = -1;
+        isPrepared = false;
         
         updateExtraSeqEngines();
         
@@ -80,20 +92,24 @@ public:
     {
         bool isActive = false;
         bool fkDone = false;
+        auto pager = motion->pager();
+        const bool isPreparedStateAvailable = isPrepared && (preparedTime == time);
+        isPrepared = false;
             
         if(qSeq){
             bool isValid = false;
             const int numAllJoints = std::min(body->numAllJoints(), qSeq->numParts());
             const int numFrames = qSeq->numFrames();
-            if(numAllJoints > 0 && numFrames > 0){
+            if(numAllJoints > 0 && numFrames > 0 && pager && time < qSeq->offsetTime()){
+                isValid = readPagedJointDisplacements(pager.get(), time);
+            }
+            if(!isValid && numAllJoints > 0 && numFrames > 0){
                 const int frame = qSeq->frameOfTime(time);
                 isValid = (frame < numFrames);
                 const int clampedFrame = qSeq->clampFrameIndex(frame);
-                const MultiValueSeq::Frame q = qSeq->frame(clampedFrame);
-                for(int i=0; i < numAllJoints; ++i){
-                    body->joint(i)->q() = q[i];
-                }
+                setJointDisplacements(body, numAllJoints, clampedFrame, time);
                 if(motionItem->isBodyJointVelocityUpdateEnabled()){
+                    const MultiValueSeq::Frame q = qSeq->frame(clampedFrame);
                     const double dt = qSeq->timeStep();
                     const MultiValueSeq::Frame q_prev = qSeq->frame((clampedFrame == 0) ? 0 : (clampedFrame -1));
                     for(int i=0; i < numAllJoints; ++i){
@@ -108,33 +124,179 @@ public:
             bool isValid = false;
             const int numLinks = positions->numParts();
             const int numFrames = positions->numFrames();
-            if(numLinks > 0 && numFrames > 0){
+            if(numLinks > 0 && numFrames > 0 && pager && time < positions->offsetTime()){
+                isValid = readPagedLinkPositions(pager.get(), time);
+            }
+            if(!isValid && numLinks > 0 && numFrames > 0){
                 const int frame = positions->frameOfTime(time);
                 isValid = (frame < numFrames);
                 const int clampedFrame = positions->clampFrameIndex(frame);
+                double ratio;
+                const int frameToApply = getFrameToApply(*positions, clampedFrame, time, ratio);
                 for(int i=0; i < numLinks; ++i){
                     Link* link = body->link(i);
-                    const SE3& position = positions->at(clampedFrame, i);
-                    link->p() = position.translation();
-                    link->R() = position.rotation().toRotationMatrix();
+                    const SE3& position = positions->at(frameToApply, i);
+                    if(ratio > 0.0){
+                        SE3 interpolated = position.interpolated(positions->at(frameToApply + 1, i), ratio);
+                        link->p() = interpolated.translation();
+                        link->R() = interpolated.rotation().toRotationMatrix();
+                    } else {
+                        link->p() = position.translation();
+                        link->R() = position.rotation().toRotationMatrix();
+                    }
                 }
             }
             isActive |= isValid;
 
-            if(positions->numParts() == 1){
+            if(positions->numParts() == 1 && !isPreparedStateAvailable){
                 body->calcForwardKinematics(); // FK from the root
                 fkDone = true;
             }
         }
 
+        if(isPreparedStateAvailable){
+            const int numLinks = std::min(body->numLinks(), fkBody->numLinks());
+            for(int i=0; i < numLinks; ++i){
+                body->link(i)->T() = fkBody->link(i)->T();
+            }
+            fkDone = true;
+        }
+
         for(size_t i=0; i < extraSeqEngines.size(); ++i){
             isActive |= extraSeqEngines[i]->onTimeChanged(time);
         }
 
         bodyItem->notifyKinematicStateChange(!fkDone && calcForwardKinematics);
 
+        if(calcForwardKinematics){
+            updateFkBody();
+        }
+
         return isActive;
     }
+
+    //! The ratio is given only when the frame interpolation is enabled
+    template<class SeqType>
+    int getFrameToApply(SeqType& seq, int clampedFrame, double time, double& out_ratio)
+    {
+        if(motionItem->isFrameInterpolationEnabled()){
+            return seq.frameOfTime(time, out_ratio);
+        }
+        out_ratio = 0.0;
+        return clampedFrame;
+    }
+
+    void setJointDisplacements(Body* targetBody, int numJoints, int clampedFrame, double time)
+    {
+        double ratio;
+        const int frame = getFrameToApply(*qSeq, clampedFrame, time, ratio);
+        const MultiValueSeq::Frame q = qSeq->frame(frame);
+        if(ratio > 0.0){
+            const MultiValueSeq::Frame q_next = qSeq->frame(frame + 1);
+            for(int i=0; i < numJoints; ++i){
+                targetBody->joint(i)->q() = q[i] + ratio * (q_next[i] - q[i]);
+            }
+        } else {
+            for(int i=0; i < numJoints; ++i){
+                targetBody->joint(i)->q() = q[i];
+            }
+        }
+    }
+
+    void updateFkBody()
+    {
+        if(!fkBody || fkBody->numLinks() != body->numLinks()){
+            fkBody = body->clone();
+            fkBaseLinkIndex = -1;
+        }
+        int baseLinkIndex = 0;
+        if(!positions || positions->numParts() == 0){
+            if(auto baseLink = bodyItem->currentBaseLink()){
+                baseLinkIndex = baseLink->index();
+            }
+        }
+        if(baseLinkIndex != fkBaseLinkIndex){
+            fkTraverse.find(fkBody->link(baseLinkIndex), true, true);
+            fkBaseLinkIndex = baseLinkIndex;
+        }
+    }
+
+    /**
+       The joint displacements are applied to the clone of the body and the forward kinematics
+       is computed in the same way as onTimeChanged. The body itself is not modified here.
+    */
+    void prepareTimeChange(double time)
+    {
+        isPrepared = false;
+        
+        if(!fkBody || !qSeq){
+            return;
+        }
+        const int numAllJoints = std::min(fkBody->numAllJoints(), qSeq->numParts());
+        if(numAllJoints == 0 || qSeq->numFrames() == 0 || (motion->pager() && time < qSeq->offsetTime())){
+            return;
+        }
+        setJointDisplacements(fkBody, numAllJoints, qSeq->clampFrameIndex(qSeq->frameOfTime(time)), time);
+        Link* baseLink = fkBody->link(fkBaseLinkIndex);
+        if(positions && positions->numParts() == 1 && positions->numFrames() > 0){
+            if(motion->pager() && time < positions->offsetTime()){
+                return;
+            }
+            double ratio;
+            const int frame = getFrameToApply(
+                *positions, positions->clampFrameIndex(positions->frameOfTime(time)), time, ratio);
+            SE3 position = positions->at(frame, 0);
+            if(ratio > 0.0){
+                position = position.interpolated(positions->at(frame + 1, 0), ratio);
+            }
+            baseLink->p() = position.translation();
+            baseLink->R() = position.rotation().toRotationMatrix();
+        } else {
+            baseLink->T() = body->link(fkBaseLinkIndex)->T();
+        }
+        fkTraverse.calcForwardKinematics();
+
+        preparedTime = time;
+        isPrepared = true;
+    }
+
+    bool readPagedJointDisplacements(BodyMotionPager* pager, double time)
+    {
+        const double frameRate = qSeq->frameRate();
+        const int frame = static_cast<int>(time * frameRate);
+        const double* q = pager->jointDisplacements(frame);
+        if(!q){
+            return false;
+        }
+        const int numAllJoints = std::min(body->numAllJoints(), pager->numJoints());
+        for(int i=0; i < numAllJoints; ++i){
+            body->joint(i)->q() = q[i];
+        }
+        if(motionItem->isBodyJointVelocityUpdateEnabled()){
+            // The pointer to the current frame is invalidated by reading the previous frame
+            const double* q_prev = pager->jointDisplacements((frame == 0) ? 0 : (frame - 1));
+            for(int i=0; i < numAllJoints; ++i){
+                auto joint = body->joint(i);
+                joint->dq() = q_prev ? ((joint->q() - q_prev[i]) * frameRate) : 0.0;
+            }
+        }
+        return true;
+    }
+
+    bool readPagedLinkPositions(BodyMotionPager* pager, double time)
+    {
+        const SE3* pagedPositions = pager->linkPositions(static_cast<int>(time * positions->frameRate()));
+        if(!pagedPositions){
+            return false;
+        }
+        const int numLinks = std::min(body->numLinks(), pager->numLinks());
+        for(int i=0; i < numLinks; ++i){
+            Link* link = body->link(i);
+            link->p() = pagedPositions[i].translation();
+            link->R() = pagedPositions[i].rotation().toRotationMatrix();
+        }
+        return true;
+    }
 };
 
 
@@ -157,6 +319,9 @@ BodyMotionEngine::BodyMotionEngine(BodyItem* bodyItem, BodyMotionItem* motionIte
     : TimeSyncItemEngine(motionItem)
 {
     impl = new Impl(this, bodyItem, motionItem);
+
+    // Only the forward kinematics is worth being computed in parallel
+    setTimeChangePreparationEnabled(impl->calcForwardKinematics);
 }
 
 
@@ -190,6 +355,12 @@ bool BodyMotionEngine::onTimeChanged(double time)
 }
 
 
+void BodyMotionEngine::prepareTimeChange(double time)
+{
+    impl->prepareTimeChange(time);
+}
+
+
 void BodyMotionEngine::onPlaybackStopped(double time, bool isStoppedManually)
 {
     impl->bodyItem->notifyKinematicStateUpdate(false);
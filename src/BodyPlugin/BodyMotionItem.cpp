@@ -151,6 +151,21 @@ void BodyMotionItem::initializeClass(ExtensionManager* ext)
             return item->motion()->save(filename, 1.0, os);
         });
 
+    im.addLoaderAndSaver<BodyMotionItem>(
+        _("Body Motion (binary)"), "BODY-MOTION-BINARY", "bseq",
+        [](BodyMotionItem* item, const std::string& filename, std::ostream& os, Item* /* parentItem */){
+            return item->motion()->loadBinary(filename, os);
+        },
+        [](BodyMotionItem* item, const std::string& filename, std::ostream& os, Item* /* parentItem */){
+            return item->motion()->saveBinary(filename, false, os);
+        });
+
+    im.addSaver<BodyMotionItem>(
+        _("Body Motion (compressed binary)"), "BODY-MOTION-BINARY", "bseq",
+        [](BodyMotionItem* item, const std::string& filename, std::ostream& os, Item* /* parentItem */){
+            return item->motion()->saveBinary(filename, true, os);
+        });
+
     initialized = true;
 }
 
@@ -164,7 +179,8 @@ void BodyMotionItem::addExtraSeqItemFactory
 
 BodyMotionItem::BodyMotionItem()
     : bodyMotion_(new BodyMotion),
-      isBodyJointVelocityUpdateEnabled_(false)
+      isBodyJointVelocityUpdateEnabled_(false),
+      isFrameInterpolationEnabled_(false)
 {
     setAttribute(Reloadable);
     impl = new Impl(this);
@@ -174,7 +190,8 @@ BodyMotionItem::BodyMotionItem()
 
 BodyMotionItem::BodyMotionItem(std::shared_ptr<BodyMotion> bodyMotion)
     : bodyMotion_(bodyMotion),
-      isBodyJointVelocityUpdateEnabled_(false)
+      isBodyJointVelocityUpdateEnabled_(false),
+      isFrameInterpolationEnabled_(false)
 {
     impl = new Impl(this);
     impl->initialize();
@@ -184,7 +201,8 @@ BodyMotionItem::BodyMotionItem(std::shared_ptr<BodyMotion> bodyMotion)
 BodyMotionItem::BodyMotionItem(const BodyMotionItem& org)
     : AbstractSeqItem(org),
       bodyMotion_(new BodyMotion(*org.bodyMotion_)),
-      isBodyJointVelocityUpdateEnabled_(org.isBodyJointVelocityUpdateEnabled_)
+      isBodyJointVelocityUpdateEnabled_(org.isBodyJointVelocityUpdateEnabled_),
+      isFrameInterpolationEnabled_(org.isFrameInterpolationEnabled_)
 {
     impl = new Impl(this);
     impl->initialize();
@@ -399,6 +417,8 @@ void BodyMotionItem::doPutProperties(PutPropertyFunction& putProperty)
 {
     putProperty(_("Body joint velocity update"), isBodyJointVelocityUpdateEnabled_,
                 changeProperty(isBodyJointVelocityUpdateEnabled_));
+    putProperty(_("Frame interpolation"), isFrameInterpolationEnabled_,
+                changeProperty(isFrameInterpolationEnabled_));
 }
 
 
@@ -411,6 +431,9 @@ bool BodyMotionItem::store(Archive& archive)
             if(isBodyJointVelocityUpdateEnabled_){
                 archive.write("is_body_joint_velocity_update_enabled", true);
             }
+            if(isFrameInterpolationEnabled_){
+                archive.write("is_frame_interpolation_enabled", true);
+            }
         }
     }
     return result;
@@ -420,5 +443,6 @@ bool BodyMotionItem::store(Archive& archive)
 bool BodyMotionItem::restore(const Archive& archive)
 {
     isBodyJointVelocityUpdateEnabled_ = archive.get("is_body_joint_velocity_update_enabled", false);
+    isFrameInterpolationEnabled_ = archive.get("is_frame_interpolation_enabled", false);
     return archive.loadFileTo(this);
 }
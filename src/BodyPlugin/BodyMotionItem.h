@@ -69,6 +69,17 @@ public:
         isBodyJointVelocityUpdateEnabled_ = on;
     }
 
+    /**
+       When the frame interpolation is enabled, the body pose at a time between frames is
+       interpolated from the two frames around the time in the playback.
+    */
+    bool isFrameInterpolationEnabled() const {
+        return isFrameInterpolationEnabled_;
+    }
+    void setFrameInterpolationEnabled(bool on) {
+        isFrameInterpolationEnabled_ = on;
+    }
+
     virtual void notifyUpdate() override;
 
 protected:
@@ -87,6 +98,7 @@ private:
     Impl* impl;
 
     bool isBodyJointVelocityUpdateEnabled_;
+    bool isFrameInterpolationEnabled_;
 };
 
 typedef ref_ptr<BodyMotionItem> BodyMotionItemPtr;
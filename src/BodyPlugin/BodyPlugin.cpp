@@ -15,16 +15,20 @@
 #include "ControllerItem.h"
 #include "SimpleControllerItem.h"
 #include "BodyMotionControllerItem.h"
+#include "SharedMemoryControllerItem.h"
 #include "RegionIntrusionDetectorItem.h"
 #include "ControllerLogItem.h"
 #include "BodyContactPointLoggerItem.h"
 #include "SubSimulatorItem.h"
+#include "CoSimulatorItem.h"
 #include "GLVisionSimulatorItem.h"
+#include "RayCastRangeSensorSimulatorItem.h"
 #include "SimulationScriptItem.h"
 #include "BodyMotionItem.h"
 #include "ZMPSeqItem.h"
 #include "MultiDeviceStateSeqItem.h"
 #include "WorldLogFileItem.h"
+#include "WorldLogStreamItem.h"
 #include "IoConnectionMapItem.h"
 #include "SensorVisualizerItem.h"
 #include "BodySyncCameraItem.h"
@@ -47,6 +51,7 @@
 #include "JointGraphView.h"
 #include "LinkGraphView.h"
 #include "BodyLinkView.h"
+#include "ControlTimeView.h"
 #include "BodyBar.h"
 #include "LeggedBodyBar.h"
 #include "KinematicsBar.h"
@@ -108,14 +113,18 @@ bool BodyPlugin::initialize()
     ControllerItem::initializeClass(this);
     SimpleControllerItem::initializeClass(this);
     BodyMotionControllerItem::initializeClass(this);
+    SharedMemoryControllerItem::initializeClass(this);
     RegionIntrusionDetectorItem::initializeClass(this);
     ControllerLogItem::initializeClass(this);
     BodyContactPointLoggerItem::initializeClass(this);
     SubSimulatorItem::initializeClass(this);
+    CoSimulatorItem::initializeClass(this);
     GLVisionSimulatorItem::initializeClass(this);
+    RayCastRangeSensorSimulatorItem::initializeClass(this);
     SimulationScriptItem::initializeClass(this);
     BodyMotionItem::initializeClass(this);
     WorldLogFileItem::initializeClass(this);
+    WorldLogStreamItem::initializeClass(this);
     IoConnectionMapItem::initializeClass(this);
     SensorVisualizerItem::initializeClass(this);
     BodySyncCameraItem::initializeClass(this);
@@ -154,6 +163,7 @@ bool BodyPlugin::initialize()
     JointGraphView::initializeClass(this);
     LinkGraphView::initializeClass(this);
     BodyLinkView::initializeClass(this);
+    ControlTimeView::initializeClass(this);
     
     initializeHrpsysFileIO(this);
     
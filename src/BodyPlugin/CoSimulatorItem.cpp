@@ -0,0 +1,331 @@
+#include "CoSimulatorItem.h"
+#include "SimulatorItem.h"
+#include <cnoid/ItemManager>
+#include <cnoid/MessageView>
+#include <cnoid/PutPropertyFunction>
+#include <cnoid/Archive>
+#include <cnoid/Selection>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <fmt/format.h>
+#include "gettext.h"
+
+using namespace std;
+using namespace cnoid;
+using fmt::format;
+
+namespace cnoid {
+
+class CoSimulatorItem::Impl
+{
+public:
+    CoSimulatorItem* self;
+    Selection exchangeMode;
+    double maxWaitTime;
+
+    SimulatorItem* simulatorItem;
+    int preDynamicsFunctionId;
+    double worldTimeStep;
+    int externalFrame;
+    int numLateSteps;
+
+    // Variables shared with the exchange thread
+    std::thread exchangeThread;
+    std::mutex exchangeMutex;
+    std::condition_variable exchangeCondition;
+    bool isStepRequested;
+    bool isStepPending;
+    bool isTerminationRequested;
+    bool stepResult;
+    double requestedTimeStep;
+
+    Impl(CoSimulatorItem* self);
+    Impl(CoSimulatorItem* self, const Impl& org);
+    bool initializeSimulation(SimulatorItem* simulatorItem);
+    void finalizeSimulation();
+    void onPreDynamicsInLockstepMode();
+    void onPreDynamicsInPipelinedMode();
+    bool waitForExternalStep();
+    void exchangeLoop();
+    void stopSimulation();
+};
+
+}
+
+
+void CoSimulatorItem::initializeClass(ExtensionManager* ext)
+{
+    ext->itemManager().registerAbstractClass<CoSimulatorItem, SubSimulatorItem>();
+}
+
+
+CoSimulatorItem::CoSimulatorItem()
+{
+    impl = new Impl(this);
+}
+
+
+CoSimulatorItem::Impl::Impl(CoSimulatorItem* self)
+    : self(self),
+      exchangeMode(NumExchangeModes, CNOID_GETTEXT_DOMAIN_NAME)
+{
+    exchangeMode.setSymbol(LockstepMode, N_("Lockstep"));
+    exchangeMode.setSymbol(PipelinedMode, N_("Pipelined"));
+    exchangeMode.select(LockstepMode);
+    maxWaitTime = 0.0;
+    simulatorItem = nullptr;
+    numLateSteps = 0;
+}
+
+
+CoSimulatorItem::CoSimulatorItem(const CoSimulatorItem& org)
+    : SubSimulatorItem(org)
+{
+    impl = new Impl(this, *org.impl);
+}
+
+
+CoSimulatorItem::Impl::Impl(CoSimulatorItem* self, const Impl& org)
+    : self(self),
+      exchangeMode(org.exchangeMode)
+{
+    maxWaitTime = org.maxWaitTime;
+    simulatorItem = nullptr;
+    numLateSteps = 0;
+}
+
+
+CoSimulatorItem::~CoSimulatorItem()
+{
+    delete impl;
+}
+
+
+void CoSimulatorItem::setExchangeMode(int mode)
+{
+    impl->exchangeMode.select(mode);
+}
+
+
+int CoSimulatorItem::exchangeMode() const
+{
+    return impl->exchangeMode.which();
+}
+
+
+void CoSimulatorItem::setMaxWaitTime(double time)
+{
+    impl->maxWaitTime = std::max(time, 0.0);
+}
+
+
+double CoSimulatorItem::maxWaitTime() const
+{
+    return impl->maxWaitTime;
+}
+
+
+int CoSimulatorItem::numLateSteps() const
+{
+    return impl->numLateSteps;
+}
+
+
+bool CoSimulatorItem::initializeSimulation(SimulatorItem* simulatorItem)
+{
+    return impl->initializeSimulation(simulatorItem);
+}
+
+
+bool CoSimulatorItem::Impl::initializeSimulation(SimulatorItem* simulatorItem)
+{
+    if(!self->initializeExternalSimulation(simulatorItem)){
+        return false;
+    }
+
+    this->simulatorItem = simulatorItem;
+    worldTimeStep = simulatorItem->worldTimeStep();
+    externalFrame = -1;
+    numLateSteps = 0;
+
+    if(exchangeMode.is(LockstepMode)){
+        preDynamicsFunctionId =
+            simulatorItem->addPreDynamicsFunction([this](){ onPreDynamicsInLockstepMode(); });
+    } else {
+        isStepRequested = false;
+        isStepPending = false;
+        isTerminationRequested = false;
+        exchangeThread = std::thread([this](){ exchangeLoop(); });
+        preDynamicsFunctionId =
+            simulatorItem->addPreDynamicsFunction([this](){ onPreDynamicsInPipelinedMode(); });
+    }
+
+    return true;
+}
+
+
+void CoSimulatorItem::Impl::onPreDynamicsInLockstepMode()
+{
+    self->outputToExternalSimulator();
+    if(!self->stepExternalSimulation(worldTimeStep)){
+        stopSimulation();
+        return;
+    }
+    self->inputFromExternalSimulator();
+}
+
+
+/**
+   The external step started in this function advances the external simulator to the time at which
+   the dynamics step of the current frame finishes, and its outputs are input at the next frame.
+   A new step is not started while the previous step is running, so the time step of the next step
+   covers the frames in which the simulation did not wait for the external step.
+*/
+void CoSimulatorItem::Impl::onPreDynamicsInPipelinedMode()
+{
+    const int currentFrame = simulatorItem->currentFrame();
+    if(externalFrame < 0){
+        externalFrame = currentFrame;
+    }
+
+    if(isStepPending){
+        if(!waitForExternalStep()){
+            ++numLateSteps;
+            return;
+        }
+        isStepPending = false;
+        if(!stepResult){
+            stopSimulation();
+            return;
+        }
+        self->inputFromExternalSimulator();
+    }
+
+    self->outputToExternalSimulator();
+
+    const int targetFrame = currentFrame + 1;
+    {
+        std::lock_guard<std::mutex> lock(exchangeMutex);
+        requestedTimeStep = (targetFrame - externalFrame) * worldTimeStep;
+        isStepRequested = true;
+    }
+    exchangeCondition.notify_all();
+    externalFrame = targetFrame;
+    isStepPending = true;
+}
+
+
+//! \return false if the step does not finish in the maximum wait time
+bool CoSimulatorItem::Impl::waitForExternalStep()
+{
+    std::unique_lock<std::mutex> lock(exchangeMutex);
+    auto isFinished = [this](){ return !isStepRequested; };
+    if(maxWaitTime > 0.0){
+        return exchangeCondition.wait_for(lock, std::chrono::duration<double>(maxWaitTime), isFinished);
+    }
+    exchangeCondition.wait(lock, isFinished);
+    return true;
+}
+
+
+void CoSimulatorItem::Impl::exchangeLoop()
+{
+    std::unique_lock<std::mutex> lock(exchangeMutex);
+    while(true){
+        exchangeCondition.wait(lock, [this](){ return isStepRequested || isTerminationRequested; });
+        if(isTerminationRequested){
+            break;
+        }
+        const double timeStep = requestedTimeStep;
+        lock.unlock();
+        bool result = self->stepExternalSimulation(timeStep);
+        lock.lock();
+        stepResult = result;
+        isStepRequested = false;
+        exchangeCondition.notify_all();
+    }
+}
+
+
+void CoSimulatorItem::Impl::stopSimulation()
+{
+    MessageView::instance()->putln(
+        format(_("The external simulation of {0} failed at time {1:.3f}."),
+               self->displayName(), simulatorItem->currentTime()),
+        MessageView::Error);
+    simulatorItem->stopSimulation();
+}
+
+
+void CoSimulatorItem::finalizeSimulation()
+{
+    impl->finalizeSimulation();
+}
+
+
+void CoSimulatorItem::Impl::finalizeSimulation()
+{
+    if(!simulatorItem){
+        return;
+    }
+    simulatorItem->removePreDynamicsFunction(preDynamicsFunctionId);
+
+    if(exchangeThread.joinable()){
+        {
+            std::unique_lock<std::mutex> lock(exchangeMutex);
+            exchangeCondition.wait(lock, [this](){ return !isStepRequested; });
+            isTerminationRequested = true;
+        }
+        exchangeCondition.notify_all();
+        exchangeThread.join();
+    }
+
+    self->finalizeExternalSimulation();
+
+    if(numLateSteps > 0){
+        MessageView::instance()->putln(
+            format(_("The simulation did not wait for the external simulation of {0} in {1} steps."),
+                   self->displayName(), numLateSteps),
+            MessageView::Warning);
+    }
+    simulatorItem = nullptr;
+}
+
+
+void CoSimulatorItem::finalizeExternalSimulation()
+{
+
+}
+
+
+void CoSimulatorItem::doPutProperties(PutPropertyFunction& putProperty)
+{
+    SubSimulatorItem::doPutProperties(putProperty);
+    putProperty(_("Exchange mode"), impl->exchangeMode,
+                [&](int index){ return impl->exchangeMode.select(index); });
+    putProperty.min(0.0)(_("Max wait time [ms]"), impl->maxWaitTime * 1000.0,
+                         [&](double time){ setMaxWaitTime(time / 1000.0); return true; });
+}
+
+
+bool CoSimulatorItem::store(Archive& archive)
+{
+    SubSimulatorItem::store(archive);
+    archive.write("exchangeMode", impl->exchangeMode.selectedSymbol());
+    archive.write("maxWaitTime", impl->maxWaitTime);
+    return true;
+}
+
+
+bool CoSimulatorItem::restore(const Archive& archive)
+{
+    SubSimulatorItem::restore(archive);
+    string symbol;
+    if(archive.read("exchangeMode", symbol)){
+        impl->exchangeMode.select(symbol);
+    }
+    archive.read("maxWaitTime", impl->maxWaitTime);
+    return true;
+}
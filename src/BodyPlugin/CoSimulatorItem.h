@@ -0,0 +1,84 @@
+#ifndef CNOID_BODY_PLUGIN_CO_SIMULATOR_ITEM_H
+#define CNOID_BODY_PLUGIN_CO_SIMULATOR_ITEM_H
+
+#include "SubSimulatorItem.h"
+#include "exportdecl.h"
+
+namespace cnoid {
+
+/**
+   The base class of the items that couple an external simulator such as an FMU or a network
+   simulator with the simulation. The data exchange is done in the simulation thread by the
+   outputToExternalSimulator and inputFromExternalSimulator functions, and the external simulator
+   is advanced by the stepExternalSimulation function.
+
+   In the lockstep mode, the external simulator is advanced synchronously before each dynamics step.
+   In the pipelined mode, the external simulator is advanced in a dedicated thread while the dynamics
+   is computed, and its outputs are input at the next step, which means the outputs are delayed by
+   one time step. The results of both the modes are deterministic unless the maximum wait time is set
+   in the pipelined mode. In that case, the simulation continues without the outputs when the external
+   step does not finish in the time, and the external simulator catches up with the simulation time
+   in the step started after it finishes.
+*/
+class CNOID_EXPORT CoSimulatorItem : public SubSimulatorItem
+{
+public:
+    static void initializeClass(ExtensionManager* ext);
+
+    CoSimulatorItem();
+    CoSimulatorItem(const CoSimulatorItem& org);
+    ~CoSimulatorItem();
+
+    enum ExchangeMode { LockstepMode, PipelinedMode, NumExchangeModes };
+    void setExchangeMode(int mode);
+    int exchangeMode() const;
+
+    /**
+       \param time The maximum time in seconds for which the simulation thread waits for the
+       external step in the pipelined mode. Zero means that the simulation thread always waits
+       for the step to finish.
+    */
+    void setMaxWaitTime(double time);
+    double maxWaitTime() const;
+
+    //! The number of the steps in which the simulation continued without waiting for the external step
+    int numLateSteps() const;
+
+    virtual bool initializeSimulation(SimulatorItem* simulatorItem) override;
+    virtual void finalizeSimulation() override;
+
+protected:
+    virtual bool initializeExternalSimulation(SimulatorItem* simulatorItem) = 0;
+
+    //! This is called in the simulation thread to give the current state to the external simulator.
+    virtual void outputToExternalSimulator() = 0;
+
+    /**
+       This is called in the simulation thread in the lockstep mode and in the exchange thread in
+       the pipelined mode, so the function must only access the data given by outputToExternalSimulator
+       and the data of the external simulator.
+       \param timeStep The time by which the external simulator is advanced. This may be a multiple
+       of the world time step when the previous step was late.
+       \return false if the external simulation fails. The simulation is stopped in that case.
+    */
+    virtual bool stepExternalSimulation(double timeStep) = 0;
+
+    //! This is called in the simulation thread to apply the outputs of the external simulator.
+    virtual void inputFromExternalSimulator() = 0;
+
+    virtual void finalizeExternalSimulation();
+
+    virtual void doPutProperties(PutPropertyFunction& putProperty) override;
+    virtual bool store(Archive& archive) override;
+    virtual bool restore(const Archive& archive) override;
+
+private:
+    class Impl;
+    Impl* impl;
+};
+
+typedef ref_ptr<CoSimulatorItem> CoSimulatorItemPtr;
+
+}
+
+#endif
@@ -90,6 +90,8 @@ void CollisionSeq::readCollisionData(int nFrames, const Listing& values)
         return;
     }
 
+    log_.clear();
+
     for(int i=0; i < nFrames; ++i){
         const Mapping& frameNode = *values[i].toMapping();
         const Listing& linkPairs = *frameNode.findListing("LinkPairs");
@@ -135,6 +137,41 @@ void CollisionSeq::readCollisionData(int nFrames, const Listing& values)
 }
 
 
+void CollisionSeq::appendLoggedFrame(const CollisionLinkPairList& linkPairs)
+{
+    log_.appendFrame(linkPairs);
+    appendFrame()[0].reset();
+}
+
+
+void CollisionSeq::popFrontLoggedFrame()
+{
+    if(numFrames() > 0){
+        if(log_.numFrames() == numFrames()){
+            log_.popFrontFrame();
+        }
+        popFrontFrame();
+    }
+}
+
+
+void CollisionSeq::getLinkPairs(int frame, CollisionLinkPairList& out_linkPairs) const
+{
+    out_linkPairs.clear();
+    if(frame < 0 || frame >= numFrames()){
+        return;
+    }
+    if(auto& linkPairs = (*this)(frame, 0)){
+        out_linkPairs = *linkPairs;
+    } else {
+        int logFrame = frame - (numFrames() - log_.numFrames());
+        if(logFrame >= 0){
+            log_.getLinkPairs(logFrame, out_linkPairs);
+        }
+    }
+}
+
+
 void CollisionSeq::writeCollsionData(YAMLWriter& writer, std::shared_ptr<const CollisionLinkPairList> ptr)
 {
     writer.startMapping();
@@ -186,9 +223,10 @@ bool CollisionSeq::doWriteSeq(YAMLWriter& writer, std::function<void()> addition
             writer.putKey("frames");
             writer.startListing();
             const int n = numFrames();
+            auto linkPairs = std::make_shared<CollisionLinkPairList>();
             for(int i=0; i < n; ++i){
-                Frame f = frame(i);
-                writeCollsionData(writer, f[0]);
+                getLinkPairs(i, *linkPairs);
+                writeCollsionData(writer, linkPairs);
             }
             writer.endListing();
         });
@@ -6,7 +6,7 @@
 #ifndef CNOID_BODY_COLLISION_SEQ_H
 #define CNOID_BODY_COLLISION_SEQ_H
 
-#include <cnoid/CollisionLinkPair>
+#include <cnoid/CollisionLog>
 #include <cnoid/MultiSeq>
 #include <cnoid/YAMLWriter>
 #include "exportdecl.h"
@@ -16,8 +16,12 @@ namespace cnoid {
 class YAMLWriter;
 class CollisionSeqItem;
 
-typedef std::vector<CollisionLinkPairPtr> CollisionLinkPairList;
-
+/**
+   The frames of this sequence are the lists of the link pairs in collision, or they can be the
+   frames stored in the collision log, which keeps the collisions of the frames in a compact form.
+   The element of a logged frame is null, and the logged frames are the last frames of the sequence.
+   Use the getLinkPairs function to get the link pairs of any frame.
+*/
 class CNOID_EXPORT CollisionSeq : public MultiSeq<std::shared_ptr<CollisionLinkPairList>>
 {
     typedef MultiSeq<std::shared_ptr<CollisionLinkPairList>> BaseSeqType;
@@ -33,9 +37,19 @@ public:
     void writeCollsionData(YAMLWriter& writer, std::shared_ptr<const CollisionLinkPairList> ptr);
     void readCollisionData(int nFrames, const Listing& values);
 
+    const CollisionLog& log() const { return log_; }
+    void appendLoggedFrame(const CollisionLinkPairList& linkPairs);
+    //! This function also removes the front frame of the log if it is a logged frame
+    void popFrontLoggedFrame();
+    void clearLog() { log_.clear(); }
+    void getLinkPairs(int frame, CollisionLinkPairList& out_linkPairs) const;
+
 protected:
     virtual bool doReadSeq(const Mapping* archive, std::ostream& os) override;
     virtual bool doWriteSeq(YAMLWriter& writer, std::function<void()> additionalPartCallback) override;
+
+private:
+    CollisionLog log_;
 };
 
 }
@@ -38,12 +38,7 @@ public:
                 const int frame = colSeq->frameOfTime(time);
                 isValid = (frame < numFrames);
                 const int clampedFrame = colSeq->clampFrameIndex(frame);
-                const CollisionSeq::Frame collisionPairs0 = colSeq->frame(clampedFrame);
-                CollisionLinkPairList& collisionPairs = worldItem->collisions();
-                collisionPairs.clear();
-                for(size_t i=0; i < collisionPairs0[0]->size(); i++){
-                    collisionPairs.push_back(collisionPairs0[0]->at(i));
-                }
+                colSeq->getLinkPairs(clampedFrame, worldItem->collisions());
             }
         }
         dynamic_cast<SceneCollision*>(worldItem->getScene())->setDirty();
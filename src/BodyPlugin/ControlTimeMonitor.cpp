@@ -0,0 +1,52 @@
+#include "ControlTimeMonitor.h"
+#include <algorithm>
+
+using namespace std;
+using namespace cnoid;
+
+
+ControlTimeMonitor::ControlTimeMonitor()
+{
+    reset(0.0);
+}
+
+
+void ControlTimeMonitor::reset(double budget)
+{
+    budget_.store(budget, memory_order_relaxed);
+    numSamples_.store(0, memory_order_relaxed);
+    totalTime.store(0.0, memory_order_relaxed);
+    maxTime_.store(0.0, memory_order_relaxed);
+    for(auto& count : histogram){
+        count.store(0, memory_order_relaxed);
+    }
+}
+
+
+/*
+  The counters are only written by the thread executing the control function, so they are
+  updated by a load and a store instead of atomic read-modify-write operations.
+*/
+bool ControlTimeMonitor::record(double time)
+{
+    const double budget = budget_.load(memory_order_relaxed);
+    int bin = NumHistogramBins - 1;
+    if(time <= budget){
+        bin = std::min(static_cast<int>(time / budget * (NumHistogramBins - 1)), NumHistogramBins - 2);
+    }
+    auto& count = histogram[bin];
+    count.store(count.load(memory_order_relaxed) + 1, memory_order_relaxed);
+    numSamples_.store(numSamples_.load(memory_order_relaxed) + 1, memory_order_relaxed);
+    totalTime.store(totalTime.load(memory_order_relaxed) + time, memory_order_relaxed);
+    if(time > maxTime_.load(memory_order_relaxed)){
+        maxTime_.store(time, memory_order_relaxed);
+    }
+    return time <= budget;
+}
+
+
+double ControlTimeMonitor::averageTime() const
+{
+    const int n = numSamples();
+    return (n > 0) ? (totalTime.load(memory_order_relaxed) / n) : 0.0;
+}
@@ -0,0 +1,51 @@
+#ifndef CNOID_BODY_PLUGIN_CONTROL_TIME_MONITOR_H
+#define CNOID_BODY_PLUGIN_CONTROL_TIME_MONITOR_H
+
+#include <atomic>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+/**
+   This class records the elapsed times of the control function of a controller in a histogram
+   and counts the overruns of the time budget. The histogram bins divide the budget into ten
+   equal ranges, and the last bin contains the overrun times. The record function must be called
+   from the thread executing the control function, and the other functions can be called from
+   any thread to see the data during the simulation.
+*/
+class CNOID_EXPORT ControlTimeMonitor
+{
+public:
+    enum { NumHistogramBins = 11 };
+
+    ControlTimeMonitor();
+    ControlTimeMonitor(const ControlTimeMonitor&) = delete;
+    ControlTimeMonitor& operator=(const ControlTimeMonitor&) = delete;
+
+    //! \param budget The time budget in seconds
+    void reset(double budget);
+    double budget() const { return budget_.load(std::memory_order_relaxed); }
+
+    //! \return false if the time exceeds the budget
+    bool record(double time);
+
+    int numSamples() const { return numSamples_.load(std::memory_order_relaxed); }
+    int numOverruns() const { return histogram[NumHistogramBins - 1].load(std::memory_order_relaxed); }
+    double maxTime() const { return maxTime_.load(std::memory_order_relaxed); }
+    double averageTime() const;
+    int histogramCount(int bin) const { return histogram[bin].load(std::memory_order_relaxed); }
+
+    //! The lower bound of the times of a bin
+    double histogramBinTime(int bin) const { return budget() * bin / (NumHistogramBins - 1); }
+
+private:
+    std::atomic<double> budget_;
+    std::atomic<int> numSamples_;
+    std::atomic<double> totalTime;
+    std::atomic<double> maxTime_;
+    std::atomic<int> histogram[NumHistogramBins];
+};
+
+}
+
+#endif
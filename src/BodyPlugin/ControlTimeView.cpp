@@ -0,0 +1,152 @@
+#include "ControlTimeView.h"
+#include "ControllerItem.h"
+#include <cnoid/ViewManager>
+#include <cnoid/RootItem>
+#include <cnoid/Timer>
+#include <QTableWidget>
+#include <QHeaderView>
+#include <QBoxLayout>
+#include "gettext.h"
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+enum ColumnId {
+    ControllerColumn, BudgetColumn, CallColumn, AverageColumn, MaxColumn, OverrunColumn, HistogramColumn,
+    NumColumns
+};
+
+}
+
+namespace cnoid {
+
+/**
+   The table shows the controllers whose control time budgets are set. The table is updated
+   periodically while the view is active because the data is updated during the simulation.
+*/
+class ControlTimeView::Impl : public QTableWidget
+{
+public:
+    Timer updateTimer;
+
+    Impl();
+    void updateTable();
+    void setText(int row, int column, const QString& text);
+    QString getHistogramText(const ControlTimeMonitor& monitor);
+};
+
+}
+
+
+void ControlTimeView::initializeClass(ExtensionManager* ext)
+{
+    ext->viewManager().registerClass<ControlTimeView>(
+        N_("ControlTimeView"), N_("Control Time"));
+}
+
+
+ControlTimeView::ControlTimeView()
+{
+    impl = new Impl;
+
+    QVBoxLayout* vbox = new QVBoxLayout();
+    vbox->addWidget(impl);
+    setLayout(vbox);
+
+    setDefaultLayoutArea(BottomRightArea);
+}
+
+
+ControlTimeView::Impl::Impl()
+{
+    setFrameShape(QFrame::NoFrame);
+    setColumnCount(NumColumns);
+    setSelectionMode(QAbstractItemView::NoSelection);
+    setHorizontalHeaderLabels(
+        { _("Controller"), _("Budget [ms]"), _("Calls"), _("Average [ms]"), _("Max [ms]"),
+          _("Overruns"), _("Histogram (10% of the budget per bin)") });
+
+    QHeaderView* hh = horizontalHeader();
+    hh->setSectionResizeMode(QHeaderView::ResizeToContents);
+    hh->setStretchLastSection(true);
+    verticalHeader()->hide();
+
+    updateTimer.setInterval(500);
+    updateTimer.sigTimeout().connect([this](){ updateTable(); });
+}
+
+
+ControlTimeView::~ControlTimeView()
+{
+    delete impl;
+}
+
+
+void ControlTimeView::onActivated()
+{
+    impl->updateTable();
+    impl->updateTimer.start();
+}
+
+
+void ControlTimeView::onDeactivated()
+{
+    impl->updateTimer.stop();
+}
+
+
+void ControlTimeView::Impl::updateTable()
+{
+    int row = 0;
+    for(auto& controller : RootItem::instance()->descendantItems<ControllerItem>()){
+        auto& monitor = controller->controlTimeMonitor();
+        if(controller->controlTimeBudget() <= 0.0 && monitor.numSamples() == 0){
+            continue;
+        }
+        if(row >= rowCount()){
+            setRowCount(row + 1);
+        }
+        setText(row, ControllerColumn, controller->displayName().c_str());
+        setText(row, BudgetColumn, QString::number(controller->controlTimeBudget() * 1000.0, 'f', 3));
+        setText(row, CallColumn, QString::number(monitor.numSamples()));
+        setText(row, AverageColumn, QString::number(monitor.averageTime() * 1000.0, 'f', 3));
+        setText(row, MaxColumn, QString::number(monitor.maxTime() * 1000.0, 'f', 3));
+        setText(row, OverrunColumn, QString::number(monitor.numOverruns()));
+        setText(row, HistogramColumn, getHistogramText(monitor));
+        ++row;
+    }
+    setRowCount(row);
+}
+
+
+//! The existing item is reused so that the table is updated without recreating the items.
+void ControlTimeView::Impl::setText(int row, int column, const QString& text)
+{
+    if(auto tableItem = item(row, column)){
+        if(tableItem->text() != text){
+            tableItem->setText(text);
+        }
+    } else {
+        tableItem = new QTableWidgetItem(text);
+        tableItem->setFlags(Qt::ItemIsEnabled);
+        if(column != ControllerColumn && column != HistogramColumn){
+            tableItem->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
+        }
+        setItem(row, column, tableItem);
+    }
+}
+
+
+QString ControlTimeView::Impl::getHistogramText(const ControlTimeMonitor& monitor)
+{
+    QString text;
+    for(int i=0; i < ControlTimeMonitor::NumHistogramBins; ++i){
+        if(i > 0){
+            text += (i == ControlTimeMonitor::NumHistogramBins - 1) ? " | " : " ";
+        }
+        text += QString::number(monitor.histogramCount(i));
+    }
+    return text;
+}
@@ -0,0 +1,27 @@
+#ifndef CNOID_BODY_PLUGIN_CONTROL_TIME_VIEW_H
+#define CNOID_BODY_PLUGIN_CONTROL_TIME_VIEW_H
+
+#include <cnoid/View>
+
+namespace cnoid {
+
+class ControlTimeView : public View
+{
+public:
+    static void initializeClass(ExtensionManager* ext);
+
+    ControlTimeView();
+    ~ControlTimeView();
+
+protected:
+    virtual void onActivated() override;
+    virtual void onDeactivated() override;
+
+private:
+    class Impl;
+    Impl* impl;
+};
+
+}
+
+#endif
@@ -23,6 +23,8 @@ void ControllerItem::initializeClass(ExtensionManager* ext)
 ControllerItem::ControllerItem()
 {
     isNoDelayMode_ = false;
+    isAbortOnControlOverrunEnabled_ = false;
+    controlTimeBudget_ = 0.0;
 }
 
 
@@ -31,6 +33,8 @@ ControllerItem::ControllerItem(const ControllerItem& org)
       optionString_(org.optionString_)
 {
     isNoDelayMode_ = org.isNoDelayMode_;
+    isAbortOnControlOverrunEnabled_ = org.isAbortOnControlOverrunEnabled_;
+    controlTimeBudget_ = org.controlTimeBudget_;
 }
 
 
@@ -134,6 +138,11 @@ void ControllerItem::doPutProperties(PutPropertyFunction& putProperty)
                     onOptionsChanged();
                     return true;
                 });
+
+    putProperty.min(0.0)(_("Control time budget [ms]"), controlTimeBudget_ * 1000.0,
+                         [&](double budget){ controlTimeBudget_ = budget / 1000.0; return true; });
+    putProperty(_("Abort on control overrun"), isAbortOnControlOverrunEnabled_,
+                changeProperty(isAbortOnControlOverrunEnabled_));
 }
 
 
@@ -141,6 +150,10 @@ bool ControllerItem::store(Archive& archive)
 {
     archive.write("isNoDelayMode", isNoDelayMode_);
     archive.write("controllerOptions", optionString_, DOUBLE_QUOTED);
+    if(controlTimeBudget_ > 0.0){
+        archive.write("controlTimeBudget", controlTimeBudget_);
+        archive.write("abortOnControlOverrun", isAbortOnControlOverrunEnabled_);
+    }
     return true;
 }
 
@@ -152,5 +165,7 @@ bool ControllerItem::restore(const Archive& archive)
         archive.read("isImmediateMode", isNoDelayMode_); 
     }
     archive.read("controllerOptions", optionString_);
+    archive.read("controlTimeBudget", controlTimeBudget_);
+    archive.read("abortOnControlOverrun", isAbortOnControlOverrunEnabled_);
     return true;
 }
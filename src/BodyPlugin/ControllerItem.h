@@ -7,6 +7,7 @@
 #define CNOID_BODY_PLUGIN_CONTROLLER_ITEM_H
 
 #include "SimulatorItem.h"
+#include "ControlTimeMonitor.h"
 #include <cnoid/ControllerIO>
 #include "exportdecl.h"
 
@@ -33,6 +34,19 @@ public:
     bool isNoDelayMode() const { return isNoDelayMode_; }
     virtual void setNoDelayMode(bool on);
     
+    /**
+       The elapsed time of the control function is monitored by controlTimeMonitor() during
+       the simulation if the budget is positive. An overrun is counted when the time exceeds
+       the budget, and the simulation is stopped at an overrun if the abort mode is enabled.
+       \param budget The time budget in seconds
+    */
+    void setControlTimeBudget(double budget) { controlTimeBudget_ = budget; }
+    double controlTimeBudget() const { return controlTimeBudget_; }
+    void setAbortOnControlOverrunEnabled(bool on) { isAbortOnControlOverrunEnabled_ = on; }
+    bool isAbortOnControlOverrunEnabled() const { return isAbortOnControlOverrunEnabled_; }
+    ControlTimeMonitor& controlTimeMonitor() { return controlTimeMonitor_; }
+    const ControlTimeMonitor& controlTimeMonitor() const { return controlTimeMonitor_; }
+    
     const std::string& optionString() const { return optionString_; }
     void setOptions(const std::string& options) { optionString_ = options; }
 
@@ -97,6 +111,9 @@ protected:
 private:
     SimulatorItemPtr simulatorItem_;
     bool isNoDelayMode_;
+    bool isAbortOnControlOverrunEnabled_;
+    double controlTimeBudget_;
+    ControlTimeMonitor controlTimeMonitor_;
     std::string optionString_;
 
     friend class SimulatorItem;
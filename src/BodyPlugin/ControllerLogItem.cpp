@@ -1,9 +1,89 @@
 #include "ControllerLogItem.h"
 #include <cnoid/ItemManager>
+#include <vector>
+#include <cstdio>
+#include <cstdint>
+#include <typeinfo>
 #include "gettext.h"
 
+using namespace std;
 using namespace cnoid;
 
+namespace {
+
+/*
+  This class stores the serialized log data of the old frames in a temporary file. The frames
+  that have the same log data object share a record. The last loaded data is cached so that the
+  log data is not read from the file repeatedly when the frames sharing it are played back.
+*/
+class LogDataPager
+{
+public:
+    FILE* file;
+    int64_t fileSize;
+    bool isFileUnavailable;
+
+    struct Record
+    {
+        int typeIndex;
+        int64_t position;
+        int size;
+    };
+    vector<Record> records;
+    // -1 for the frame whose data is null or kept in the memory
+    vector<int> frameRecordIndices;
+    // The first log data object of each type, which is used to deserialize the data of the type
+    vector<ReferencedPtr> prototypes;
+
+    ReferencedPtr lastPagedData;
+    int lastRecordIndex;
+    ReferencedPtr loadedData;
+    int loadedRecordIndex;
+    string buf;
+
+    LogDataPager();
+    ~LogDataPager();
+    int numFrames() const { return frameRecordIndices.size(); }
+    int findOrAddPrototype(Referenced* data);
+    void pageOut(ReferencedPtr& data);
+    ReferencedPtr load(int frame);
+};
+
+typedef shared_ptr<LogDataPager> LogDataPagerPtr;
+
+bool seekFile(FILE* file, int64_t pos)
+{
+#ifdef _WIN32
+    return _fseeki64(file, pos, SEEK_SET) == 0;
+#else
+    return fseeko(file, pos, SEEK_SET) == 0;
+#endif
+}
+
+}
+
+namespace cnoid {
+
+class ControllerLogItem::Impl
+{
+public:
+    double memoryTimeLength;
+    // This is shared with the duplicated items, which have the same log data
+    LogDataPagerPtr pager;
+
+    Impl();
+    Impl(const Impl& org);
+};
+
+}
+
+
+SerializableLogData::~SerializableLogData()
+{
+
+}
+
+
 void ControllerLogItem::initializeClass(ExtensionManager* ext)
 {
     ext->itemManager().registerClass<ControllerLogItem, ReferencedObjectSeqItem>(N_("ControllerLogItem"));
@@ -12,21 +92,189 @@ void ControllerLogItem::initializeClass(ExtensionManager* ext)
 
 ControllerLogItem::ControllerLogItem()
 {
+    impl = new Impl;
+}
+
 
+ControllerLogItem::Impl::Impl()
+{
+    memoryTimeLength = 0.0;
 }
 
 
 ControllerLogItem::ControllerLogItem(const ControllerLogItem& org)
     : ReferencedObjectSeqItem(org)
 {
+    impl = new Impl(*org.impl);
+}
+
+
+ControllerLogItem::Impl::Impl(const Impl& org)
+    : memoryTimeLength(org.memoryTimeLength),
+      pager(org.pager)
+{
 
 }
 
 
+ControllerLogItem::~ControllerLogItem()
+{
+    delete impl;
+}
+
+
 Item* ControllerLogItem::doDuplicate() const
 {
     return new ControllerLogItem(*this);
 }
 
-    
 
+void ControllerLogItem::resetLog()
+{
+    resetSeq();
+    impl->pager.reset();
+}
+
+
+void ControllerLogItem::setMemoryTimeLength(double length)
+{
+    impl->memoryTimeLength = length;
+}
+
+
+double ControllerLogItem::memoryTimeLength() const
+{
+    return impl->memoryTimeLength;
+}
+
+
+void ControllerLogItem::pageOutOldFrames()
+{
+    if(impl->memoryTimeLength <= 0.0){
+        return;
+    }
+    auto& log = *seq_;
+    const int numMemoryFrames = std::max(1, static_cast<int>(impl->memoryTimeLength * log.frameRate()));
+    const int numPagedFrames = log.numFrames() - numMemoryFrames;
+    if(numPagedFrames > 0){
+        if(!impl->pager){
+            impl->pager = make_shared<LogDataPager>();
+        }
+        auto& pager = *impl->pager;
+        for(int frame = pager.numFrames(); frame < numPagedFrames; ++frame){
+            pager.pageOut(log.at(frame));
+        }
+    }
+}
+
+
+ReferencedPtr ControllerLogItem::logData(int frame)
+{
+    auto& log = *seq_;
+    if(frame < 0 || frame >= log.numFrames()){
+        return nullptr;
+    }
+    if(auto& data = log.at(frame)){
+        return data;
+    }
+    if(impl->pager && frame < impl->pager->numFrames()){
+        return impl->pager->load(frame);
+    }
+    return nullptr;
+}
+
+
+LogDataPager::LogDataPager()
+{
+    file = nullptr;
+    fileSize = 0;
+    isFileUnavailable = false;
+    lastRecordIndex = -1;
+    loadedRecordIndex = -1;
+}
+
+
+LogDataPager::~LogDataPager()
+{
+    if(file){
+        std::fclose(file);
+    }
+}
+
+
+int LogDataPager::findOrAddPrototype(Referenced* data)
+{
+    const int n = prototypes.size();
+    for(int i=0; i < n; ++i){
+        if(typeid(*prototypes[i]) == typeid(*data)){
+            return i;
+        }
+    }
+    prototypes.push_back(data);
+    return n;
+}
+
+
+void LogDataPager::pageOut(ReferencedPtr& data)
+{
+    if(!data){
+        frameRecordIndices.push_back(-1);
+        return;
+    }
+    if(data == lastPagedData){
+        frameRecordIndices.push_back(lastRecordIndex);
+        data.reset();
+        return;
+    }
+    auto serializable = dynamic_cast<SerializableLogData*>(data.get());
+    if(serializable && !file && !isFileUnavailable){
+        file = std::tmpfile();
+        isFileUnavailable = !file;
+    }
+    if(!serializable || !file){
+        frameRecordIndices.push_back(-1);
+        return;
+    }
+
+    buf.clear();
+    serializable->serializeLogData(buf);
+    if(!seekFile(file, fileSize) || std::fwrite(buf.data(), 1, buf.size(), file) != buf.size()){
+        frameRecordIndices.push_back(-1);
+        return;
+    }
+    Record record;
+    record.typeIndex = findOrAddPrototype(data);
+    record.position = fileSize;
+    record.size = buf.size();
+    fileSize += buf.size();
+    lastRecordIndex = records.size();
+    records.push_back(record);
+    frameRecordIndices.push_back(lastRecordIndex);
+
+    lastPagedData = data;
+    data.reset();
+}
+
+
+ReferencedPtr LogDataPager::load(int frame)
+{
+    const int recordIndex = frameRecordIndices[frame];
+    if(recordIndex < 0){
+        return nullptr;
+    }
+    if(recordIndex == lastRecordIndex && lastPagedData){
+        return lastPagedData;
+    }
+    if(recordIndex != loadedRecordIndex){
+        auto& record = records[recordIndex];
+        buf.resize(record.size);
+        loadedData.reset();
+        if(seekFile(file, record.position) &&
+           std::fread(&buf[0], 1, record.size, file) == static_cast<size_t>(record.size)){
+            auto prototype = dynamic_cast<SerializableLogData*>(prototypes[record.typeIndex].get());
+            loadedData = prototype->deserializeLogData(buf);
+        }
+        loadedRecordIndex = recordIndex;
+    }
+    return loadedData;
+}
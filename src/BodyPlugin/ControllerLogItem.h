@@ -2,23 +2,58 @@
 #define CNOID_BODY_PLUGIN_CONTROLLER_LOG_ITEM_H
 
 #include <cnoid/ReferencedObjectSeqItem>
+#include <string>
 #include "exportdecl.h"
 
 namespace cnoid {
 
+/**
+   This interface can be implemented by a log data class so that the log data of the old frames
+   can be moved from the memory to a file when the memory time length of the log is limited.
+   The log data that does not implement this interface is always kept in the memory.
+*/
+class CNOID_EXPORT SerializableLogData
+{
+public:
+    virtual ~SerializableLogData();
+    virtual void serializeLogData(std::string& out_data) const = 0;
+    //! \return A new log data object created from the data, or nullptr if the data is invalid
+    virtual Referenced* deserializeLogData(const std::string& data) const = 0;
+};
+
 class CNOID_EXPORT ControllerLogItem : public ReferencedObjectSeqItem
 {
 public:
     static void initializeClass(ExtensionManager* ext);
-            
+
     ControllerLogItem();
     ControllerLogItem(const ControllerLogItem& org);
+    ~ControllerLogItem();
 
     std::shared_ptr<ReferencedObjectSeq> log() { return seq(); }
-    void resetLog() { resetSeq(); }
+    void resetLog();
+
+    /**
+       The frames older than the time length from the last frame are moved to a file by
+       pageOutOldFrames. Zero means that all the frames are kept in the memory.
+    */
+    void setMemoryTimeLength(double length);
+    double memoryTimeLength() const;
+    void pageOutOldFrames();
+
+    /**
+       This function returns the log data of a frame including the data moved to the file.
+       Use this function instead of accessing the elements of the log directly because the
+       elements of the frames moved to the file are null.
+    */
+    ReferencedPtr logData(int frame);
 
 protected:
     virtual Item* doDuplicate() const override;
+
+private:
+    class Impl;
+    Impl* impl;
 };
 
 typedef ref_ptr<ControllerLogItem> ControllerLogItemPtr;
@@ -26,4 +61,3 @@ typedef ref_ptr<ControllerLogItem> ControllerLogItemPtr;
 }
 
 #endif
-
@@ -0,0 +1,182 @@
+/**
+   This file is compiled separately because the EGL headers may include X11 headers, whose
+   macros conflict with the other libraries.
+*/
+
+#include "EGLOffscreenContext.h"
+#define EGL_NO_X11
+#define MESA_EGL_NO_X11_HEADERS
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <fmt/format.h>
+#include <vector>
+#include <ostream>
+#include "gettext.h"
+
+using namespace std;
+using namespace cnoid;
+using fmt::format;
+
+namespace {
+
+PFNEGLQUERYDEVICESEXTPROC eglQueryDevicesEXT_ = nullptr;
+PFNEGLGETPLATFORMDISPLAYEXTPROC eglGetPlatformDisplayEXT_ = nullptr;
+bool areDeviceFunctionsInitialized = false;
+
+vector<EGLDeviceEXT> getDevices()
+{
+    if(!areDeviceFunctionsInitialized){
+        eglQueryDevicesEXT_ =
+            reinterpret_cast<PFNEGLQUERYDEVICESEXTPROC>(eglGetProcAddress("eglQueryDevicesEXT"));
+        eglGetPlatformDisplayEXT_ =
+            reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(eglGetProcAddress("eglGetPlatformDisplayEXT"));
+        areDeviceFunctionsInitialized = true;
+    }
+    vector<EGLDeviceEXT> devices;
+    if(eglQueryDevicesEXT_){
+        EGLint n = 0;
+        if(eglQueryDevicesEXT_(0, nullptr, &n) && n > 0){
+            devices.resize(n);
+            if(!eglQueryDevicesEXT_(n, devices.data(), &n)){
+                n = 0;
+            }
+            devices.resize(n);
+        }
+    }
+    return devices;
+}
+
+}
+
+namespace cnoid {
+
+class EGLOffscreenContext::Impl
+{
+public:
+    EGLDisplay display;
+    EGLContext context;
+
+    Impl() {
+        display = EGL_NO_DISPLAY;
+        context = EGL_NO_CONTEXT;
+    }
+};
+
+}
+
+
+int EGLOffscreenContext::numDevices()
+{
+    return getDevices().size();
+}
+
+
+EGLOffscreenContext::EGLOffscreenContext()
+{
+    impl = new Impl;
+    deviceIndex_ = -1;
+}
+
+
+EGLOffscreenContext::~EGLOffscreenContext()
+{
+    if(impl->context != EGL_NO_CONTEXT){
+        if(eglGetCurrentContext() == impl->context){
+            eglMakeCurrent(impl->display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        }
+        eglDestroyContext(impl->display, impl->context);
+    }
+    // The display is not terminated because it is shared by all the contexts on the device
+    delete impl;
+}
+
+
+bool EGLOffscreenContext::create
+(int deviceIndex, int majorVersion, int minorVersion, bool isCoreProfile, std::ostream& os)
+{
+    EGLDisplay display = EGL_NO_DISPLAY;
+    if(deviceIndex < 0){
+        display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    } else {
+        auto devices = getDevices();
+        if(deviceIndex >= static_cast<int>(devices.size()) || !eglGetPlatformDisplayEXT_){
+            os << format(_("EGL device {0} is not available."), deviceIndex) << endl;
+            return false;
+        }
+        display = eglGetPlatformDisplayEXT_(EGL_PLATFORM_DEVICE_EXT, devices[deviceIndex], nullptr);
+    }
+    if(display == EGL_NO_DISPLAY){
+        os << _("The EGL display cannot be obtained.") << endl;
+        return false;
+    }
+    EGLint major, minor;
+    if(!eglInitialize(display, &major, &minor)){
+        os << _("The EGL display cannot be initialized.") << endl;
+        return false;
+    }
+
+    const EGLint configAttributes[] = {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RED_SIZE, 8,
+        EGL_GREEN_SIZE, 8,
+        EGL_BLUE_SIZE, 8,
+        EGL_DEPTH_SIZE, 24,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_NONE
+    };
+    EGLConfig config;
+    EGLint numConfigs = 0;
+    if(!eglChooseConfig(display, configAttributes, &config, 1, &numConfigs) || numConfigs == 0){
+        os << _("No EGL configuration is available for OpenGL rendering.") << endl;
+        return false;
+    }
+
+    if(!eglBindAPI(EGL_OPENGL_API)){
+        os << _("OpenGL is not supported by the EGL display.") << endl;
+        return false;
+    }
+
+    const EGLint contextAttributes[] = {
+        EGL_CONTEXT_MAJOR_VERSION, majorVersion,
+        EGL_CONTEXT_MINOR_VERSION, minorVersion,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK,
+        isCoreProfile ? EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT : EGL_CONTEXT_OPENGL_COMPATIBILITY_PROFILE_BIT,
+        EGL_NONE
+    };
+    EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttributes);
+    if(context == EGL_NO_CONTEXT){
+        os << format(_("The EGL context of OpenGL {0}.{1} cannot be created."), majorVersion, minorVersion) << endl;
+        return false;
+    }
+
+    impl->display = display;
+    impl->context = context;
+    deviceIndex_ = deviceIndex;
+
+    return true;
+}
+
+
+bool EGLOffscreenContext::isValid() const
+{
+    return impl->context != EGL_NO_CONTEXT;
+}
+
+
+//! The context is made current without a surface by EGL_KHR_surfaceless_context.
+bool EGLOffscreenContext::makeCurrent()
+{
+    return eglMakeCurrent(impl->display, EGL_NO_SURFACE, EGL_NO_SURFACE, impl->context);
+}
+
+
+void EGLOffscreenContext::doneCurrent()
+{
+    eglMakeCurrent(impl->display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+}
+
+
+void* EGLOffscreenContext::getProcAddress(const char* name)
+{
+    return reinterpret_cast<void*>(eglGetProcAddress(name));
+}
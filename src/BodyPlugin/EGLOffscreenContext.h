@@ -0,0 +1,40 @@
+#ifndef CNOID_BODYPLUGIN_EGL_OFFSCREEN_CONTEXT_H
+#define CNOID_BODYPLUGIN_EGL_OFFSCREEN_CONTEXT_H
+
+#include <cnoid/NullOut>
+
+namespace cnoid {
+
+/**
+   This class creates an OpenGL context on an EGL device without any window system so that
+   the rendering can be done on a headless server. The context is made current without
+   a surface, so the rendering must be done to a framebuffer object.
+*/
+class EGLOffscreenContext
+{
+public:
+    //! \return The number of the EGL devices such as GPUs, or zero if the devices cannot be enumerated.
+    static int numDevices();
+
+    EGLOffscreenContext();
+    ~EGLOffscreenContext();
+
+    //! \param deviceIndex The index of the EGL device. The default display is used if this is negative.
+    bool create(
+        int deviceIndex, int majorVersion, int minorVersion, bool isCoreProfile, std::ostream& os = nullout());
+
+    bool isValid() const;
+    int deviceIndex() const { return deviceIndex_; }
+    bool makeCurrent();
+    void doneCurrent();
+    void* getProcAddress(const char* name);
+
+private:
+    class Impl;
+    Impl* impl;
+    int deviceIndex_;
+};
+
+}
+
+#endif
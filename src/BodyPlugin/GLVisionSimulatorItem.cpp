@@ -7,6 +7,7 @@
 #include "SimulatorItem.h"
 #include "WorldItem.h"
 #include "FisheyeLensConverter.h"
+#include "EGLOffscreenContext.h"
 #include <cnoid/ItemManager>
 #include <cnoid/MessageView>
 #include <cnoid/PutPropertyFunction>
@@ -19,23 +20,30 @@
 #include <cnoid/Camera>
 #include <cnoid/RangeCamera>
 #include <cnoid/RangeSensor>
+#include <cnoid/Light>
 #include <cnoid/SceneBody>
 #include <cnoid/SceneDevice>
 #include <cnoid/SceneCameras>
 #include <cnoid/SceneLights>
 #include <cnoid/CloneMap>
+#include <cnoid/SharedMemoryFrameRing>
 #include <cnoid/EigenUtil>
 #include <cnoid/StringUtil>
 #include <cnoid/Tokenizer>
+#include <cnoid/TimeMeasure>
 #include <QThread>
 #include <QApplication>
 #include <QOpenGLContext>
 #include <QOffscreenSurface>
 #include <QOpenGLFramebufferObject>
+#include <QOpenGLFunctions>
 #include <fmt/format.h>
 #include <mutex>
 #include <condition_variable>
 #include <queue>
+#include <cstdlib>
+#include <memory>
+#include <cctype>
 #include <iostream>
 #include "gettext.h"
 
@@ -50,6 +58,9 @@ constexpr bool DEBUG_MESSAGE = false;
 // This does not seem to be necessary
 constexpr bool USE_FLUSH_GL_FUNCTION = false;
 
+// The number of the frames kept in the shared memory of each sensor
+constexpr int NumSharedMemorySlots = 4;
+
 enum ScreenId {
     NO_SCREEN = FisheyeLensConverter::NO_SCREEN,
     FRONT_SCREEN = FisheyeLensConverter::FRONT_SCREEN,
@@ -87,6 +98,54 @@ bool updateNames(const string& nameListString, string& out_newNameListString, ve
     return true;
 }
 
+/**
+   The GL functions used for the offscreen buffers, which are resolved from the current context
+   of either backend because QOpenGLExtraFunctions is not available without QOpenGLContext.
+*/
+struct GLBufferFunctions
+{
+    void (QOPENGLF_APIENTRYP glGenBuffers)(GLsizei n, GLuint* buffers);
+    void (QOPENGLF_APIENTRYP glDeleteBuffers)(GLsizei n, const GLuint* buffers);
+    void (QOPENGLF_APIENTRYP glBindBuffer)(GLenum target, GLuint buffer);
+    void (QOPENGLF_APIENTRYP glBufferData)(GLenum target, GLsizeiptr size, const void* data, GLenum usage);
+    void* (QOPENGLF_APIENTRYP glMapBufferRange)(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access);
+    GLboolean (QOPENGLF_APIENTRYP glUnmapBuffer)(GLenum target);
+    void (QOPENGLF_APIENTRYP glGenFramebuffers)(GLsizei n, GLuint* framebuffers);
+    void (QOPENGLF_APIENTRYP glDeleteFramebuffers)(GLsizei n, const GLuint* framebuffers);
+    void (QOPENGLF_APIENTRYP glBindFramebuffer)(GLenum target, GLuint framebuffer);
+    GLenum (QOPENGLF_APIENTRYP glCheckFramebufferStatus)(GLenum target);
+    void (QOPENGLF_APIENTRYP glGenRenderbuffers)(GLsizei n, GLuint* renderbuffers);
+    void (QOPENGLF_APIENTRYP glDeleteRenderbuffers)(GLsizei n, const GLuint* renderbuffers);
+    void (QOPENGLF_APIENTRYP glBindRenderbuffer)(GLenum target, GLuint renderbuffer);
+    void (QOPENGLF_APIENTRYP glRenderbufferStorage)(GLenum target, GLenum internalformat, GLsizei width, GLsizei height);
+    void (QOPENGLF_APIENTRYP glFramebufferRenderbuffer)(
+        GLenum target, GLenum attachment, GLenum renderbuffertarget, GLuint renderbuffer);
+
+    template<class GetProcAddressFunction>
+    void resolve(GetProcAddressFunction getProcAddress){
+        resolve(glGenBuffers, getProcAddress, "glGenBuffers");
+        resolve(glDeleteBuffers, getProcAddress, "glDeleteBuffers");
+        resolve(glBindBuffer, getProcAddress, "glBindBuffer");
+        resolve(glBufferData, getProcAddress, "glBufferData");
+        resolve(glMapBufferRange, getProcAddress, "glMapBufferRange");
+        resolve(glUnmapBuffer, getProcAddress, "glUnmapBuffer");
+        resolve(glGenFramebuffers, getProcAddress, "glGenFramebuffers");
+        resolve(glDeleteFramebuffers, getProcAddress, "glDeleteFramebuffers");
+        resolve(glBindFramebuffer, getProcAddress, "glBindFramebuffer");
+        resolve(glCheckFramebufferStatus, getProcAddress, "glCheckFramebufferStatus");
+        resolve(glGenRenderbuffers, getProcAddress, "glGenRenderbuffers");
+        resolve(glDeleteRenderbuffers, getProcAddress, "glDeleteRenderbuffers");
+        resolve(glBindRenderbuffer, getProcAddress, "glBindRenderbuffer");
+        resolve(glRenderbufferStorage, getProcAddress, "glRenderbufferStorage");
+        resolve(glFramebufferRenderbuffer, getProcAddress, "glFramebufferRenderbuffer");
+    }
+
+    template<class FunctionPointer, class GetProcAddressFunction>
+    static void resolve(FunctionPointer& func, GetProcAddressFunction& getProcAddress, const char* name){
+        func = reinterpret_cast<FunctionPointer>(getProcAddress(name));
+    }
+};
+
 class QThreadEx : public QThread
 {
     std::function<void()> function;
@@ -106,7 +165,36 @@ class SensorScene : public Referenced
 {
 public:
     SgGroupPtr root;
+    // The switch of the root in the renderer shared with the other sensors
+    SgSwitchableGroupPtr sharedRendererSwitch;
     vector<SceneBodyPtr> sceneBodies;
+
+    // For the frustum culling
+    struct CullingView
+    {
+        Link* link;
+        Isometry3 T_local;
+        double nearDistance;
+        double farDistance;
+        bool hasSidePlanes;
+        double tanX;
+        double tanY;
+        double secX;
+        double secY;
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+    };
+    struct CullingSphere
+    {
+        Link* link;
+        Vector3 center;
+        double radius;
+    };
+    bool isCullingEnabled;
+    vector<CullingView, Eigen::aligned_allocator<CullingView>> cullingViews;
+    // The switches and the bounding spheres of the links of the bodies in the same order as sceneBodies
+    vector<SgSwitchableGroupPtr> bodySwitches;
+    vector<vector<CullingSphere>> bodyCullingSpheres;
+
     QThreadEx renderingThread;
     std::condition_variable renderingCondition;
     std::mutex renderingMutex;
@@ -118,8 +206,12 @@ public:
         isRenderingRequested = false;
         isRenderingFinished = false;
         isTerminationRequested = false;
+        isCullingEnabled = false;
     }
 
+    void initializeCulling(int sensorBodyIndex);
+    void addCullingView(Link* link, const Isometry3& T_local, SgCamera* camera, double aspectRatio);
+    bool isBodyInViews(int bodyIndex, vector<Isometry3, Eigen::aligned_allocator<Isometry3>>& T_views);
     void updateScene(double currentTime);
     void startConcurrentRendering();
     void concurrentRenderingLoop(std::function<void(SensorScreenRenderer*&)> render, std::function<void()> finalizeRendering);
@@ -128,6 +220,8 @@ public:
 
 typedef ref_ptr<SensorScene> SensorScenePtr;
 
+typedef ref_ptr<SensorScreenRenderer> SensorScreenRendererPtr;
+
 class SensorScreenRenderer : public Referenced
 {
 public:
@@ -149,6 +243,31 @@ public:
     QOpenGLContext* glContext;
     QOffscreenSurface* offscreenSurface;
     QOpenGLFramebufferObject* frameBuffer;
+    GLBufferFunctions* glFunctions;
+
+    // For the EGL backend, which does not use the above Qt objects
+    EGLOffscreenContext* eglContext;
+    int glDeviceIndex;
+    GLuint eglFrameBuffer;
+    GLuint eglRenderBuffers[2];
+
+    // The screen whose GL context and renderer are shared with this screen
+    SensorScreenRendererPtr glContextOwnerScreen;
+    bool isRendererShared;
+    // The scene currently rendered by the renderer of this screen if the renderer is shared by sensors
+    SensorScene* sceneInSharedRenderer;
+    SgCamera* sceneCamera;
+
+    // For the pipelined readback
+    bool isPixelBufferAvailable;
+    bool isReadbackPipelined;
+    bool hasPendingReadback;
+    GLuint pixelBuffers[2];
+    int currentPixelBufferIndex;
+    int colorDataSize;
+    int depthDataOffset;
+    int depthDataSize;
+    Matrix4 pendingProjectionMatrix;
 
     GLSceneRenderer* renderer;
     int numYawSamples;
@@ -157,6 +276,7 @@ public:
     int pixelHeight;
     vector<unsigned char> colorBuf;
     vector<float> depthBuf;
+    Eigen::Matrix4Xf xTerms;
     std::shared_ptr<Image> tmpImage;
     std::shared_ptr<RangeCamera::PointData> tmpPoints;
     std::shared_ptr<RangeSensor::RangeData> tmpRangeData;
@@ -164,11 +284,27 @@ public:
     bool isDense;
     bool flagToUpdatePreprocessedNodeTree;
 
+    // The times [s] taken to render the latest frame and to store its result
+    TimeMeasure timeMeasure;
+    TimeMeasure conversionTimeMeasure;
+    double renderingTime;
+    double storingTime;
+    double conversionTime;
+
     SensorScreenRenderer(GLVisionSimulatorItemImpl* simImpl, Device* device, Device* deviceForRendering);
     ~SensorScreenRenderer();
-    bool initialize(SensorScenePtr scene, int bodyIndex);
+    bool initialize(SensorScenePtr scene, int bodyIndex, SensorScreenRenderer* glContextOwnerScreen = nullptr);
     SgCamera* initializeCamera(int bodyIndex);
-    void initializeGL(SgCamera* sceneCamera);
+    bool initializeGL(SensorScreenRenderer* glContextOwnerScreen);
+    bool createGLContext(const QSurfaceFormat& surfaceFormat);
+    bool createEGLFrameBuffer();
+    void bindFrameBuffer();
+    GLuint frameBufferHandle() const;
+    bool hasSameGLContext(SensorScreenRenderer* other) const {
+        return glContext == other->glContext && eglContext == other->eglContext;
+    }
+    void updateHeadLightDirection();
+    void applyScreenSettingsToSharedRenderer();
     void startRenderingThread();
     void moveRenderingBufferToThread(QThread& thread);
     void moveRenderingBufferToMainThread();
@@ -178,11 +314,20 @@ public:
     void render(SensorScreenRenderer*& currentGLContextScreen);
     void finalizeRendering();
     void storeResultToTmpDataBuffer();
+    void initializePixelBuffers();
+    void storeResultToTmpDataBufferWithPixelBuffers();
+    void storePixelsToTmpDataBuffer(const unsigned char* colorPixels, const float* depthPixels);
     bool getCameraImage(Image& image);
+    bool copyCameraImage(const unsigned char* pixels, Image& image);
     bool getRangeCameraData(Image& image, vector<Vector3f>& points);
+    bool convertRangeCameraData(
+        const unsigned char* colorPixels, const float* depthPixels, const Matrix4& P,
+        Image& image, vector<Vector3f>& points);
     bool getRangeSensorData(vector<double>& rangeData);
+    bool convertRangeSensorData(const float* depthPixels, const Matrix4& P, vector<double>& rangeData);
+
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
 };
-typedef ref_ptr<SensorScreenRenderer> SensorScreenRendererPtr;
 
 class SensorRenderer : public Referenced
 {
@@ -195,10 +340,27 @@ public:
     RangeCameraPtr rangeCamera;
     RangeSensorPtr rangeSensor;
     DevicePtr deviceForRendering;
+    // The EGL device on which the sensor is rendered, or -1 for the default display
+    int glDeviceIndex;
     double elapsedTime;
     double cycleTime;
     double latency;
     double onsetTime;
+    double previousOnsetTime;
+    // The time by which the current frame has to be rendered
+    double deadline;
+    // The order of the sensors with the same deadline in the render queue
+    unsigned int queuingOrder;
+    // The statistics reported when the simulation is finished
+    int numDeliveredFrames;
+    int numDelayedFrames;
+    int numMeasuredFrames;
+    double totalRenderingTime;
+    double totalReadbackTime;
+    double totalConversionTime;
+    bool isCurrentFrameDelayed;
+    bool isReadbackPipelined;
+    bool isReadbackPipelineInvalidated;
     SensorScenePtr sharedScene;
     vector<SensorScenePtr> scenes;
     vector<SensorScreenRendererPtr> screens;
@@ -207,11 +369,16 @@ public:
     bool needToClearVisionDataByTurningOff;
     std::shared_ptr<RangeSensor::RangeData> rangeData;
     FisheyeLensConverter fisheyeLensConverter;
+    // The shared memory of the images and the one of the points or the range data
+    unique_ptr<SharedMemoryFrameRing> imageFrameRing;
+    unique_ptr<SharedMemoryFrameRing> dataFrameRing;
 
     SensorRenderer(GLVisionSimulatorItemImpl* simImpl, Device* sensor, SimulationBody* simBody, int bodyIndex);
     ~SensorRenderer();
     bool initialize(const vector<SimulationBody*>& simBodies);
     SensorScenePtr createSensorScene(const vector<SimulationBody*>& simBodies);
+    void initializeSharedMemoryExport();
+    SharedMemoryFrameRing* createFrameRing(const char* suffix, size_t slotCapacity);
     void startSharedRenderingThread();
     void moveRenderingBufferToMainThread();
     void startConcurrentRendering();
@@ -219,12 +386,26 @@ public:
     void render(SensorScreenRenderer*& currentGLContextScreen, bool doDoneGLContextCurrent);
     void finalizeRendering();
     bool waitForRenderingToFinish();
+    void resetReadbackPipeline();
     void clearVisionData();
     void copyVisionData();
+    void exportVisionData(double time);
     bool waitForRenderingToFinish(std::unique_lock<std::mutex>& lock);
+    void recordFrameDelay();
 };
 typedef ref_ptr<SensorRenderer> SensorRendererPtr;
 
+//! This orders the render queue by the earliest deadline first
+struct RenderingDeadlineGreater
+{
+    bool operator()(const SensorRenderer* renderer1, const SensorRenderer* renderer2) const {
+        if(renderer1->deadline != renderer2->deadline){
+            return renderer1->deadline > renderer2->deadline;
+        }
+        return renderer1->queuingOrder > renderer2->queuingOrder;
+    }
+};
+
 }
 
 namespace cnoid {
@@ -244,6 +425,8 @@ public:
     bool useQueueThreadForAllSensors;
     bool useThreadsForSensors;
     bool useThreadsForScreens;
+    bool useSharedGLResources;
+    bool useEGLBackend;
     bool isVisionDataRecordingEnabled;
     bool isBestEffortMode;
     bool isQueueRenderingTerminationRequested;
@@ -252,7 +435,8 @@ public:
     QThreadEx queueThread;
     std::condition_variable queueCondition;
     std::mutex queueMutex;
-    queue<SensorRenderer*> sensorQueue;
+    priority_queue<SensorRenderer*, vector<SensorRenderer*>, RenderingDeadlineGreater> sensorQueue;
+    unsigned int queuingCounter;
     
     double rangeSensorPrecisionRatio;
     double depthError;
@@ -262,6 +446,9 @@ public:
     vector<string> sensorNames;
     string sensorNameListString;
     Selection threadMode;
+    Selection glBackend;
+    vector<int> glDevices;
+    string glDeviceListString;
     bool isBestEffortModeProperty;
     bool shootAllSceneObjects;
     bool isHeadLightEnabled;
@@ -270,6 +457,20 @@ public:
     double maxLatency;
     CloneMap cloneMap;
     bool isAntiAliasingEnabled;
+    bool isPipelinedReadbackEnabled;
+    bool isGLResourceSharingEnabled;
+    bool isFrustumCullingEnabled;
+    bool isSharedMemoryExportEnabled;
+    double levelOfDetailDistanceScale;
+
+    // The screens owning the renderers shared by cameras and by range sensors, respectively
+    SensorScreenRendererPtr glResourceOwnerScreens[2];
+
+    // For the throughput report of the last simulation
+    TimeMeasure elapsedTimeMeasure;
+    TimeMeasure simulationThreadTimeMeasure;
+    double simulationThreadTime;
+    MappingPtr throughputReport;
         
     GLVisionSimulatorItemImpl(GLVisionSimulatorItem* self);
     GLVisionSimulatorItemImpl(GLVisionSimulatorItem* self, const GLVisionSimulatorItemImpl& org);
@@ -281,9 +482,11 @@ public:
     void getVisionDataInThreadsForSensors();
     void getVisionDataInQueueThread();
     void finalizeSimulation();
+    void putThroughputReport();
     void doPutProperties(PutPropertyFunction& putProperty);
     bool store(Archive& archive);
     bool restore(const Archive& archive);
+    bool updateGLDevices(const string& deviceListString);
 
     template<typename Type> void setProperty(Type& variable, const Type& value){
         if(value != variable){
@@ -313,7 +516,8 @@ GLVisionSimulatorItem::GLVisionSimulatorItem()
 GLVisionSimulatorItemImpl::GLVisionSimulatorItemImpl(GLVisionSimulatorItem* self)
     : self(self),
       os(MessageView::instance()->cout()),
-      threadMode(GLVisionSimulatorItem::N_THREAD_MODES, CNOID_GETTEXT_DOMAIN_NAME)
+      threadMode(GLVisionSimulatorItem::N_THREAD_MODES, CNOID_GETTEXT_DOMAIN_NAME),
+      glBackend(GLVisionSimulatorItem::N_GL_BACKENDS, CNOID_GETTEXT_DOMAIN_NAME)
 {
     simulatorItem = nullptr;
     maxFrameRate = 1000.0;
@@ -332,7 +536,16 @@ GLVisionSimulatorItemImpl::GLVisionSimulatorItemImpl(GLVisionSimulatorItem* self
     threadMode.setSymbol(GLVisionSimulatorItem::SCREEN_THREAD_MODE, N_("Screen"));
     threadMode.select(GLVisionSimulatorItem::SENSOR_THREAD_MODE);
 
+    glBackend.setSymbol(GLVisionSimulatorItem::QT_GL_BACKEND, N_("Qt"));
+    glBackend.setSymbol(GLVisionSimulatorItem::EGL_GL_BACKEND, N_("EGL"));
+    glBackend.select(GLVisionSimulatorItem::QT_GL_BACKEND);
+
     isAntiAliasingEnabled = false;
+    isPipelinedReadbackEnabled = false;
+    isGLResourceSharingEnabled = false;
+    isFrustumCullingEnabled = false;
+    isSharedMemoryExportEnabled = false;
+    levelOfDetailDistanceScale = 1.0;
 }
 
 
@@ -357,6 +570,9 @@ GLVisionSimulatorItemImpl::GLVisionSimulatorItemImpl(GLVisionSimulatorItem* self
     bodyNameListString = getNameListString(bodyNames);
     sensorNameListString = getNameListString(sensorNames);
     threadMode = org.threadMode;
+    glBackend = org.glBackend;
+    glDevices = org.glDevices;
+    glDeviceListString = org.glDeviceListString;
     isBestEffortModeProperty = org.isBestEffortModeProperty;
     shootAllSceneObjects = org.shootAllSceneObjects;
     isHeadLightEnabled = org.isHeadLightEnabled;
@@ -364,6 +580,11 @@ GLVisionSimulatorItemImpl::GLVisionSimulatorItemImpl(GLVisionSimulatorItem* self
     maxFrameRate = org.maxFrameRate;
     maxLatency = org.maxLatency;
     isAntiAliasingEnabled = org.isAntiAliasingEnabled;
+    isPipelinedReadbackEnabled = org.isPipelinedReadbackEnabled;
+    isGLResourceSharingEnabled = org.isGLResourceSharingEnabled;
+    isFrustumCullingEnabled = org.isFrustumCullingEnabled;
+    isSharedMemoryExportEnabled = org.isSharedMemoryExportEnabled;
+    levelOfDetailDistanceScale = org.levelOfDetailDistanceScale;
 }
 
 
@@ -426,6 +647,42 @@ void GLVisionSimulatorItem::setThreadMode(int mode)
 }
 
 
+void GLVisionSimulatorItem::setGLBackend(int backend)
+{
+    if(backend != impl->glBackend.which()){
+        impl->glBackend.select(backend);
+        notifyUpdate();
+    }
+}
+
+
+void GLVisionSimulatorItem::setGLDevices(const std::string& devices)
+{
+    impl->updateGLDevices(devices);
+    notifyUpdate();
+}
+
+
+bool GLVisionSimulatorItemImpl::updateGLDevices(const string& deviceListString)
+{
+    vector<int> devices;
+    for(auto& token : Tokenizer<CharSeparator<char>>(deviceListString, CharSeparator<char>(","))){
+        auto element = trimmed(token);
+        if(!element.empty()){
+            char* end;
+            long index = strtol(element.c_str(), &end, 10);
+            if(*end != '\0' || index < 0){
+                return false;
+            }
+            devices.push_back(index);
+        }
+    }
+    glDevices = devices;
+    glDeviceListString = deviceListString;
+    return true;
+}
+
+
 void GLVisionSimulatorItem::setDedicatedSensorThreadsEnabled(bool on)
 {
     setThreadMode(on ? SCREEN_THREAD_MODE : SINGLE_THREAD_MODE);
@@ -462,6 +719,36 @@ void GLVisionSimulatorItem::setAdditionalLightsEnabled(bool on)
 }
 
 
+void GLVisionSimulatorItem::setPipelinedReadbackEnabled(bool on)
+{
+    impl->setProperty(impl->isPipelinedReadbackEnabled, on);
+}
+
+
+void GLVisionSimulatorItem::setGLResourceSharingEnabled(bool on)
+{
+    impl->setProperty(impl->isGLResourceSharingEnabled, on);
+}
+
+
+void GLVisionSimulatorItem::setFrustumCullingEnabled(bool on)
+{
+    impl->setProperty(impl->isFrustumCullingEnabled, on);
+}
+
+
+void GLVisionSimulatorItem::setSharedMemoryExportEnabled(bool on)
+{
+    impl->setProperty(impl->isSharedMemoryExportEnabled, on);
+}
+
+
+void GLVisionSimulatorItem::setLevelOfDetailDistanceScale(double scale)
+{
+    impl->setProperty(impl->levelOfDetailDistanceScale, scale);
+}
+
+
 bool GLVisionSimulatorItem::initializeSimulation(SimulatorItem* simulatorItem)
 {
     return impl->initializeSimulation(simulatorItem);
@@ -492,6 +779,29 @@ bool GLVisionSimulatorItemImpl::initializeSimulation(SimulatorItem* simulatorIte
         useThreadsForScreens = true;
         break;
     }
+
+    useEGLBackend = (glBackend.which() == GLVisionSimulatorItem::EGL_GL_BACKEND);
+#ifndef USE_EGL
+    if(useEGLBackend){
+        os << format(_("{0}: The EGL backend is not available in this build, so the Qt backend is used.\n"),
+                     self->displayName());
+        useEGLBackend = false;
+    }
+#endif
+
+    // The sensors can only share a renderer if they are rendered in the same thread
+    useSharedGLResources = isGLResourceSharingEnabled && useQueueThreadForAllSensors;
+    if(isGLResourceSharingEnabled && !useSharedGLResources){
+        os << format(_("{0}: The GL resources are not shared because the thread mode is not \"Single\".\n"),
+                     self->displayName());
+    }
+    if(useSharedGLResources && useEGLBackend && glDevices.size() >= 2){
+        os << format(_("{0}: The GL resources are not shared because the sensors are rendered on multiple devices.\n"),
+                     self->displayName());
+        useSharedGLResources = false;
+    }
+    glResourceOwnerScreens[0].reset();
+    glResourceOwnerScreens[1].reset();
     
     isBestEffortMode = isBestEffortModeProperty;
     renderersInRendering.clear();
@@ -538,6 +848,17 @@ bool GLVisionSimulatorItemImpl::initializeSimulation(SimulatorItem* simulatorIte
         return false;
     }
 
+    // The sensors are pinned to the devices in turn
+    if(useEGLBackend && !glDevices.empty()){
+        for(size_t i=0; i < sensorRenderers.size(); ++i){
+            auto renderer = sensorRenderers[i];
+            renderer->glDeviceIndex = glDevices[i % glDevices.size()];
+            os << format(_("{0}: \"{1}\" of {2} is rendered on EGL device {3}.\n"),
+                         self->displayName(), renderer->device->name(), renderer->simBody->body()->name(),
+                         renderer->glDeviceIndex);
+        }
+    }
+
 #ifdef Q_OS_LINUX
     /**
        The following code is neccessary to avoid a crash when a view which has a widget such as
@@ -572,14 +893,28 @@ bool GLVisionSimulatorItemImpl::initializeSimulation(SimulatorItem* simulatorIte
     os.flush();
 
     if(!sensorRenderers.empty()){
-        simulatorItem->addPreDynamicsFunction([&](){ onPreDynamics(); });
-        simulatorItem->addPostDynamicsFunction([&](){ onPostDynamics(); });
+        simulationThreadTime = 0.0;
+        simulatorItem->addPreDynamicsFunction(
+            [&](){
+                simulationThreadTimeMeasure.begin();
+                onPreDynamics();
+                simulationThreadTimeMeasure.end();
+                simulationThreadTime += simulationThreadTimeMeasure.time();
+            });
+        simulatorItem->addPostDynamicsFunction(
+            [&](){
+                simulationThreadTimeMeasure.begin();
+                onPostDynamics();
+                simulationThreadTimeMeasure.end();
+                simulationThreadTime += simulationThreadTimeMeasure.time();
+            });
 
         if(useQueueThreadForAllSensors){
             while(!sensorQueue.empty()){
                 sensorQueue.pop();
             }
             isQueueRenderingTerminationRequested = false;
+            queuingCounter = 0;
             queueThread.start([&](){ queueRenderingLoop(); });
             for(size_t i=0; i < sensorRenderers.size(); ++i){
                 for(auto& screen : sensorRenderers[i]->screens){
@@ -588,6 +923,8 @@ bool GLVisionSimulatorItemImpl::initializeSimulation(SimulatorItem* simulatorIte
             }
         }
 
+        elapsedTimeMeasure.begin();
+
         return true;
     }
 
@@ -603,6 +940,7 @@ SensorRenderer::SensorRenderer(GLVisionSimulatorItemImpl* simImpl, Device* devic
       simBody(simBody),
       bodyIndex(bodyIndex)
 {
+    glDeviceIndex = -1;
     deviceForRendering = device->clone();
     camera = dynamic_cast<Camera*>(device);
     rangeCamera = dynamic_pointer_cast<RangeCamera>(camera);
@@ -718,17 +1056,36 @@ bool SensorRenderer::initialize(const vector<SimulationBody*>& simBodies)
     if(simImpl->useThreadsForScreens){
         for(auto& screen : screens){
             auto scene = createSensorScene(simBodies);
+            screen->glDeviceIndex = glDeviceIndex;
             if(!screen->initialize(scene, bodyIndex)){
                 return false;
             }
             scenes.push_back(scene);
         }
     } else {
+        /*
+          The screens rendered in the same thread share the GL context and the renderer of the
+          first screen so that the scene resources are only uploaded once and the context is not
+          switched between the screens.
+        */
         sharedScene = createSensorScene(simBodies);
+        SensorScreenRenderer* glContextOwnerScreen = nullptr;
+        // Range sensors do not share a renderer with cameras because the lighting mode is different
+        auto& glResourceOwnerScreen = simImpl->glResourceOwnerScreens[rangeSensor ? 1 : 0];
+        if(simImpl->useSharedGLResources){
+            glContextOwnerScreen = glResourceOwnerScreen;
+        }
         for(auto& screen : screens){
-            if(!screen->initialize(sharedScene, bodyIndex)){
+            screen->glDeviceIndex = glDeviceIndex;
+            if(!screen->initialize(sharedScene, bodyIndex, glContextOwnerScreen)){
                 return false;
             }
+            if(!glContextOwnerScreen){
+                glContextOwnerScreen = screen;
+                if(simImpl->useSharedGLResources){
+                    glResourceOwnerScreen = screen;
+                }
+            }
         }
         scenes.push_back(sharedScene);
     }
@@ -750,10 +1107,53 @@ bool SensorRenderer::initialize(const vector<SimulationBody*>& simBodies)
     elapsedTime = 0.0;
     latency = std::min(cycleTime, simImpl->maxLatency);
     onsetTime = 0.0;
+    previousOnsetTime = 0.0;
+    deadline = 0.0;
+    queuingOrder = 0;
+    numDeliveredFrames = 0;
+    numDelayedFrames = 0;
+    numMeasuredFrames = 0;
+    totalRenderingTime = 0.0;
+    totalReadbackTime = 0.0;
+    totalConversionTime = 0.0;
+    isCurrentFrameDelayed = false;
+
+    /*
+      The data of a frame is obtained in the rendering of the next frame in the pipelined
+      readback, so the additional delay of one cycle must be within the max latency.
+    */
+    isReadbackPipelined = false;
+    if(simImpl->isPipelinedReadbackEnabled){
+        bool isPixelBufferAvailable = true;
+        for(auto& screen : screens){
+            isPixelBufferAvailable = isPixelBufferAvailable && screen->isPixelBufferAvailable;
+        }
+        if(!isPixelBufferAvailable){
+            simImpl->os << format(_("{0}: The pipelined readback cannot be used for \"{1}\" "
+                                    "because pixel buffer objects are not available.\n"),
+                                  simImpl->self->displayName(), device->name());
+        } else if(simImpl->maxLatency < cycleTime){
+            simImpl->os << format(_("{0}: The pipelined readback is not used for \"{1}\" "
+                                    "because its cycle time exceeds the max latency.\n"),
+                                  simImpl->self->displayName(), device->name());
+        } else {
+            isReadbackPipelined = true;
+            latency = std::min(cycleTime, simImpl->maxLatency - cycleTime);
+        }
+    }
+    for(auto& screen : screens){
+        screen->isReadbackPipelined = isReadbackPipelined;
+        screen->hasPendingReadback = false;
+    }
+    isReadbackPipelineInvalidated = false;
     wasDeviceOn = false;
     isRendering = false;
     needToClearVisionDataByTurningOff = false;
 
+    if(simImpl->isSharedMemoryExportEnabled){
+        initializeSharedMemoryExport();
+    }
+
     if(simImpl->useThreadsForSensors){
         if(sharedScene){
             startSharedRenderingThread();
@@ -768,17 +1168,91 @@ bool SensorRenderer::initialize(const vector<SimulationBody*>& simBodies)
 }
 
 
+/**
+   The shared memory is named "cnoid-<body>-<device>-image" for the images and
+   "cnoid-<body>-<device>-points" or "cnoid-<body>-<device>-range" for the other data.
+*/
+void SensorRenderer::initializeSharedMemoryExport()
+{
+    if(camera){
+        const int numComponents = (camera->imageType() == Camera::GRAYSCALE_IMAGE) ? 1 : 3;
+        if(camera->imageType() != Camera::NO_IMAGE){
+            imageFrameRing.reset(
+                createFrameRing("image", camera->resolutionX() * camera->resolutionY() * numComponents));
+        }
+        if(rangeCamera){
+            dataFrameRing.reset(
+                createFrameRing("points", camera->resolutionX() * camera->resolutionY() * sizeof(Vector3f)));
+        }
+    } else if(rangeSensor && !screens.empty()){
+        int numYawSamples = 0;
+        for(auto& screen : screens){
+            numYawSamples += screen->numUniqueYawSamples;
+        }
+        const int numPitchSamples = screens[0]->rangeSensorForRendering->numPitchSamples();
+        dataFrameRing.reset(createFrameRing("range", numYawSamples * numPitchSamples * sizeof(double)));
+    }
+}
+
+
+SharedMemoryFrameRing* SensorRenderer::createFrameRing(const char* suffix, size_t slotCapacity)
+{
+    string name = format("cnoid-{0}-{1}-{2}", simBody->body()->name(), device->name(), suffix);
+    for(auto& c : name){
+        if(!isalnum(static_cast<unsigned char>(c)) && c != '-'){
+            c = '_';
+        }
+    }
+    auto ring = new SharedMemoryFrameRing;
+    if(ring->create(name, NumSharedMemorySlots, slotCapacity, simImpl->os)){
+        simImpl->os << format(_("{0}: The data of \"{1}\" is exported to the shared memory \"{2}\".\n"),
+                              simImpl->self->displayName(), device->name(), name);
+    } else {
+        delete ring;
+        ring = nullptr;
+    }
+    return ring;
+}
+
+
 SensorScenePtr SensorRenderer::createSensorScene(const vector<SimulationBody*>& simBodies)
 {
     SensorScenePtr scene = new SensorScene;
     scene->root = new SgGroup;
-    simImpl->cloneMap.clear();
+
+    if(simImpl->useSharedGLResources){
+        /*
+          The non-node objects such as meshes and textures cloned for the other sensors are reused
+          so that the GL resources created for them are shared by the sensors. The nodes are cloned
+          for each sensor because the scene of a sensor is updated while the other one is rendered.
+        */
+        simImpl->cloneMap.removeClonesIf(
+            [](const Referenced* org){
+                auto object = dynamic_cast<const SgObject*>(org);
+                return !object || object->isNode();
+            });
+        scene->sharedRendererSwitch = new SgSwitchableGroup;
+        scene->sharedRendererSwitch->setTurnedOn(false);
+        scene->sharedRendererSwitch->addChild(scene->root);
+    } else {
+        simImpl->cloneMap.clear();
+    }
 
     for(size_t i=0; i < simBodies.size(); ++i){
         auto sceneBody = new SceneBody(simBodies[i]->body());
         sceneBody->cloneShapes(simImpl->cloneMap);
         scene->sceneBodies.push_back(sceneBody);
-        scene->root->addChild(sceneBody);
+        if(simImpl->isFrustumCullingEnabled){
+            auto bodySwitch = new SgSwitchableGroup;
+            bodySwitch->addChild(sceneBody);
+            scene->bodySwitches.push_back(bodySwitch);
+            scene->root->addChild(bodySwitch);
+        } else {
+            scene->root->addChild(sceneBody);
+        }
+    }
+    if(simImpl->isFrustumCullingEnabled){
+        scene->initializeCulling(bodyIndex);
     }
 
     if(simImpl->shootAllSceneObjects){
@@ -812,21 +1286,52 @@ SensorScreenRenderer::SensorScreenRenderer(GLVisionSimulatorItemImpl* simImpl, D
     glContext = nullptr;
     offscreenSurface = nullptr;
     frameBuffer = nullptr;
+    glFunctions = nullptr;
+    eglContext = nullptr;
+    glDeviceIndex = -1;
+    eglFrameBuffer = 0;
+    eglRenderBuffers[0] = eglRenderBuffers[1] = 0;
+    isRendererShared = false;
+    sceneInSharedRenderer = nullptr;
+    sceneCamera = nullptr;
+    isPixelBufferAvailable = false;
+    isReadbackPipelined = false;
+    hasPendingReadback = false;
+    pixelBuffers[0] = pixelBuffers[1] = 0;
+    currentPixelBufferIndex = 0;
+    colorDataSize = 0;
+    depthDataOffset = 0;
+    depthDataSize = 0;
     renderer = nullptr;
     screenId = FRONT_SCREEN;
+    renderingTime = 0.0;
+    storingTime = 0.0;
+    conversionTime = 0.0;
 }
 
 
-bool SensorScreenRenderer::initialize(SensorScenePtr scene, int bodyIndex)
+bool SensorScreenRenderer::initialize(SensorScenePtr scene, int bodyIndex, SensorScreenRenderer* glContextOwnerScreen)
 {
     this->scene = scene;
 
-    auto sceneCamera = initializeCamera(bodyIndex);
+    sceneCamera = initializeCamera(bodyIndex);
     if(!sceneCamera){
         return false;
     }
 
-    initializeGL(sceneCamera);
+    if(scene->isCullingEnabled){
+        if(cameraForRendering){
+            scene->addCullingView(
+                camera->link(), cameraForRendering->T_local(), sceneCamera, double(pixelWidth) / pixelHeight);
+        } else {
+            scene->addCullingView(
+                rangeSensor->link(), rangeSensorForRendering->T_local(), sceneCamera, double(pixelWidth) / pixelHeight);
+        }
+    }
+
+    if(!initializeGL(glContextOwnerScreen)){
+        return false;
+    }
 
     hasUpdatedData = false;
 
@@ -926,36 +1431,81 @@ SgCamera* SensorScreenRenderer::initializeCamera(int bodyIndex)
 }
 
 
-void SensorScreenRenderer::initializeGL(SgCamera* sceneCamera)
-{
-    glContext = new QOpenGLContext;
+/**
+   \param glContextOwnerScreen The screen whose GL context and renderer are shared with this screen.
+   A new context and renderer are created if this is null.
+*/
+bool SensorScreenRenderer::initializeGL(SensorScreenRenderer* glContextOwnerScreen)
+{
+    if(glContextOwnerScreen){
+        this->glContextOwnerScreen = glContextOwnerScreen;
+        glContext = glContextOwnerScreen->glContext;
+        offscreenSurface = glContextOwnerScreen->offscreenSurface;
+        eglContext = glContextOwnerScreen->eglContext;
+        glFunctions = glContextOwnerScreen->glFunctions;
+        renderer = glContextOwnerScreen->renderer;
+        isRendererShared = true;
+        glContextOwnerScreen->isRendererShared = true;
+        makeGLContextCurrent();
 
-    QSurfaceFormat format;
-    format.setSwapBehavior(QSurfaceFormat::SingleBuffer);
-    if(GLSceneRenderer::rendererType() == GLSceneRenderer::GLSL_RENDERER){
-        format.setProfile(QSurfaceFormat::CoreProfile);
-        format.setVersion(3, 3);
     } else {
-        format.setVersion(1, 5);
+        QSurfaceFormat format;
+        format.setSwapBehavior(QSurfaceFormat::SingleBuffer);
+        if(GLSceneRenderer::rendererType() == GLSceneRenderer::GLSL_RENDERER){
+            format.setProfile(QSurfaceFormat::CoreProfile);
+            format.setVersion(3, 3);
+        } else {
+            format.setVersion(1, 5);
+        }
+        if(!createGLContext(format)){
+            return false;
+        }
+    }
+
+    if(eglContext){
+        if(!createEGLFrameBuffer()){
+            doneGLContextCurrent();
+            return false;
+        }
+        // glMapBufferRange is required to map a pixel buffer object
+        GLint majorVersion = 0;
+        glGetIntegerv(GL_MAJOR_VERSION, &majorVersion);
+        isPixelBufferAvailable = (majorVersion >= 3);
+    } else {
+        frameBuffer = new QOpenGLFramebufferObject(
+            pixelWidth, pixelHeight, QOpenGLFramebufferObject::CombinedDepthStencil);
+        frameBuffer->bind();
+        isPixelBufferAvailable = (glContext->format().version() >= qMakePair(3, 0));
+    }
+
+    if(glContextOwnerScreen){
+        if(scene->sharedRendererSwitch && !scene->sharedRendererSwitch->hasParents()){
+            renderer->sceneRoot()->addChild(scene->sharedRendererSwitch);
+        }
+        // Extract the camera of this screen added to the scene after the owner screen was initialized
+        glContextOwnerScreen->flagToUpdatePreprocessedNodeTree = true;
+        renderer->extractPreprocessedNodes();
+        applyScreenSettingsToSharedRenderer();
+        doneGLContextCurrent();
+        return true;
     }
-    glContext->setFormat(format);
-    glContext->create();
-    offscreenSurface = new QOffscreenSurface;
-    offscreenSurface->setFormat(format);
-    offscreenSurface->create();
-    glContext->makeCurrent(offscreenSurface);
-    frameBuffer = new QOpenGLFramebufferObject(pixelWidth, pixelHeight, QOpenGLFramebufferObject::CombinedDepthStencil);
-    frameBuffer->bind();
 
     if(!renderer){
         renderer = GLSceneRenderer::create();
         renderer->setFlagVariableToUpdatePreprocessedNodeTree(flagToUpdatePreprocessedNodeTree);
     }
 
-    renderer->setDefaultFramebufferObject(frameBuffer->handle());
+    renderer->setDefaultFramebufferObject(frameBufferHandle());
     renderer->initializeGL();
     renderer->setViewport(0, 0, pixelWidth, pixelHeight);
-    renderer->sceneRoot()->addChild(scene->root);
+    renderer->setLevelOfDetailDistanceScale(simImpl->levelOfDetailDistanceScale);
+    if(scene->sharedRendererSwitch){
+        scene->sharedRendererSwitch->setTurnedOn(true);
+        sceneInSharedRenderer = scene;
+        renderer->sceneRoot()->addChild(scene->sharedRendererSwitch);
+    } else {
+        renderer->sceneRoot()->addChild(scene->root);
+    }
     flagToUpdatePreprocessedNodeTree = true;
     renderer->extractPreprocessedNodes();
     renderer->setCurrentCamera(sceneCamera);
@@ -963,33 +1513,145 @@ void SensorScreenRenderer::initializeGL(SgCamera* sceneCamera)
     if(rangeSensorForRendering){
         renderer->setLightingMode(GLSceneRenderer::NoLighting);
     } else {
-        if(screenId != FRONT_SCREEN){
-            SgDirectionalLight* headLight = dynamic_cast<SgDirectionalLight*>(renderer->headLight());
-            if(headLight){
-                switch(screenId){
-                case LEFT_SCREEN:
-                    headLight->setDirection(Vector3( 1, 0, 0));
-                    break;
-                case RIGHT_SCREEN:
-                    headLight->setDirection(Vector3( -1, 0 ,0));
-                    break;
-                case TOP_SCREEN:
-                    headLight->setDirection(Vector3( 0, -1 ,0));
-                    break;
-                case BOTTOM_SCREEN:
-                    headLight->setDirection(Vector3( 0, 1 ,0));
-                    break;
-                case BACK_SCREEN:
-                    headLight->setDirection(Vector3( 0, 0 ,1));
-                    break;
-                }
-            }
-        }
+        updateHeadLightDirection();
         renderer->headLight()->on(simImpl->isHeadLightEnabled);
         renderer->enableAdditionalLights(simImpl->areAdditionalLightsEnabled);
     }
 
     doneGLContextCurrent();
+
+    return true;
+}
+
+
+/**
+   The EGL context is created on the GPU device given to the sensor without any window system
+   if the EGL backend is selected. The GL functions of the renderers are resolved through
+   the GL dispatch library, which dispatches them to the current context of both the backends.
+*/
+bool SensorScreenRenderer::createGLContext(const QSurfaceFormat& surfaceFormat)
+{
+    if(simImpl->useEGLBackend){
+#ifdef USE_EGL
+        eglContext = new EGLOffscreenContext;
+        if(!eglContext->create(
+               glDeviceIndex, surfaceFormat.majorVersion(), surfaceFormat.minorVersion(),
+               surfaceFormat.profile() == QSurfaceFormat::CoreProfile, simImpl->os)){
+            simImpl->os << format(_("{0}: The EGL context for \"{1}\" cannot be created.\n"),
+                                  simImpl->self->displayName(), device->name());
+            delete eglContext;
+            eglContext = nullptr;
+            return false;
+        }
+        eglContext->makeCurrent();
+        glFunctions = new GLBufferFunctions;
+        glFunctions->resolve([&](const char* name){ return eglContext->getProcAddress(name); });
+        return true;
+#endif
+    }
+
+    glContext = new QOpenGLContext;
+    glContext->setFormat(surfaceFormat);
+    glContext->create();
+    offscreenSurface = new QOffscreenSurface;
+    offscreenSurface->setFormat(surfaceFormat);
+    offscreenSurface->create();
+    glContext->makeCurrent(offscreenSurface);
+    glFunctions = new GLBufferFunctions;
+    glFunctions->resolve([&](const char* name){ return glContext->getProcAddress(name); });
+
+    return true;
+}
+
+
+bool SensorScreenRenderer::createEGLFrameBuffer()
+{
+    glFunctions->glGenFramebuffers(1, &eglFrameBuffer);
+    glFunctions->glBindFramebuffer(GL_FRAMEBUFFER, eglFrameBuffer);
+    glFunctions->glGenRenderbuffers(2, eglRenderBuffers);
+    glFunctions->glBindRenderbuffer(GL_RENDERBUFFER, eglRenderBuffers[0]);
+    glFunctions->glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, pixelWidth, pixelHeight);
+    glFunctions->glFramebufferRenderbuffer(
+        GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, eglRenderBuffers[0]);
+    glFunctions->glBindRenderbuffer(GL_RENDERBUFFER, eglRenderBuffers[1]);
+    glFunctions->glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, pixelWidth, pixelHeight);
+    glFunctions->glFramebufferRenderbuffer(
+        GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, eglRenderBuffers[1]);
+    glFunctions->glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    if(glFunctions->glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE){
+        simImpl->os << format(_("{0}: The frame buffer for \"{1}\" cannot be created.\n"),
+                              simImpl->self->displayName(), device->name());
+        return false;
+    }
+    return true;
+}
+
+
+void SensorScreenRenderer::bindFrameBuffer()
+{
+    if(eglContext){
+        glFunctions->glBindFramebuffer(GL_FRAMEBUFFER, eglFrameBuffer);
+    } else {
+        frameBuffer->bind();
+    }
+}
+
+
+GLuint SensorScreenRenderer::frameBufferHandle() const
+{
+    return eglContext ? eglFrameBuffer : frameBuffer->handle();
+}
+
+
+void SensorScreenRenderer::updateHeadLightDirection()
+{
+    SgDirectionalLight* headLight = dynamic_cast<SgDirectionalLight*>(renderer->headLight());
+    if(headLight){
+        switch(screenId){
+        case FRONT_SCREEN:
+            headLight->setDirection(Vector3( 0, 0, -1));
+            break;
+        case LEFT_SCREEN:
+            headLight->setDirection(Vector3( 1, 0, 0));
+            break;
+        case RIGHT_SCREEN:
+            headLight->setDirection(Vector3( -1, 0 ,0));
+            break;
+        case TOP_SCREEN:
+            headLight->setDirection(Vector3( 0, -1 ,0));
+            break;
+        case BOTTOM_SCREEN:
+            headLight->setDirection(Vector3( 0, 1 ,0));
+            break;
+        case BACK_SCREEN:
+            headLight->setDirection(Vector3( 0, 0 ,1));
+            break;
+        }
+    }
+}
+
+
+void SensorScreenRenderer::applyScreenSettingsToSharedRenderer()
+{
+    auto owner = glContextOwnerScreen ? glContextOwnerScreen.get() : this;
+    if(scene->sharedRendererSwitch && owner->sceneInSharedRenderer != scene){
+        if(owner->sceneInSharedRenderer){
+            owner->sceneInSharedRenderer->sharedRendererSwitch->setTurnedOn(false);
+        }
+        scene->sharedRendererSwitch->setTurnedOn(true);
+        owner->sceneInSharedRenderer = scene;
+        owner->flagToUpdatePreprocessedNodeTree = true;
+        renderer->extractPreprocessedNodes();
+    }
+    
+    bindFrameBuffer();
+    renderer->setDefaultFramebufferObject(frameBufferHandle());
+    renderer->setViewport(0, 0, pixelWidth, pixelHeight);
+    renderer->setCurrentCamera(sceneCamera);
+    if(!rangeSensorForRendering){
+        updateHeadLightDirection();
+    }
 }
 
 
@@ -999,7 +1661,8 @@ void SensorRenderer::startSharedRenderingThread()
     // This may be unnecessary
     std::unique_lock<std::mutex> lock(sharedScene->renderingMutex);
 
-    bool doDoneGLContextCurrent = (screens.size() >= 2);
+    // The screens sharing a GL context do not have to release it for each other
+    bool doDoneGLContextCurrent = (screens.size() >= 2) && !screens.front()->isRendererShared;
     
     sharedScene->renderingThread.start([=](){
             sharedScene->concurrentRenderingLoop(
@@ -1031,9 +1694,12 @@ void SensorScreenRenderer::startRenderingThread()
 }
     
 
+//! An EGL context does not have the thread affinity, so it only has to be made current in the thread
 void SensorScreenRenderer::moveRenderingBufferToThread(QThread& thread)
 {
-    glContext->moveToThread(&thread);
+    if(glContext){
+        glContext->moveToThread(&thread);
+    }
 }
 
 
@@ -1047,19 +1713,33 @@ void SensorRenderer::moveRenderingBufferToMainThread()
 
 void SensorScreenRenderer::moveRenderingBufferToMainThread()
 {
-    QThread* mainThread = QApplication::instance()->thread();
-    glContext->moveToThread(mainThread);
+    if(glContext){
+        QThread* mainThread = QApplication::instance()->thread();
+        glContext->moveToThread(mainThread);
+    }
 }
 
 
 void SensorScreenRenderer::makeGLContextCurrent()
 {
+#ifdef USE_EGL
+    if(eglContext){
+        eglContext->makeCurrent();
+        return;
+    }
+#endif
     glContext->makeCurrent(offscreenSurface);
 }
 
 
 void SensorScreenRenderer::doneGLContextCurrent()
 {
+#ifdef USE_EGL
+    if(eglContext){
+        eglContext->doneCurrent();
+        return;
+    }
+#endif
     glContext->doneCurrent();
 }
 
@@ -1083,10 +1763,19 @@ void GLVisionSimulatorItemImpl::onPreDynamics()
                     renderer->needToClearVisionDataByTurningOff = false;
                 }
                 renderer->elapsedTime = renderer->cycleTime;
+                if(renderer->isReadbackPipelined){
+                    renderer->isReadbackPipelineInvalidated = true;
+                }
             }
             if(renderer->elapsedTime >= renderer->cycleTime){
                 if(!renderer->isRendering){
+                    if(renderer->isReadbackPipelineInvalidated){
+                        renderer->resetReadbackPipeline();
+                    }
+                    renderer->previousOnsetTime = renderer->onsetTime;
                     renderer->onsetTime = currentTime;
+                    renderer->deadline = currentTime + renderer->latency;
+                    renderer->isCurrentFrameDelayed = false;
                     renderer->isRendering = true;
                     if(useThreadsForSensors){
                         renderer->startConcurrentRendering();
@@ -1096,6 +1785,7 @@ void GLVisionSimulatorItemImpl::onPreDynamics()
                             pQueueMutex->lock();
                         }
                         renderer->updateSensorScene(true);
+                        renderer->queuingOrder = queuingCounter++;
                         sensorQueue.push(renderer);
                     }
                     renderer->elapsedTime -= renderer->cycleTime;
@@ -1132,14 +1822,15 @@ void GLVisionSimulatorItemImpl::queueRenderingLoop()
                     goto exitRenderingQueueLoop;
                 }
                 if(!sensorQueue.empty()){
-                    renderer = sensorQueue.front();
+                    renderer = sensorQueue.top();
                     sensorQueue.pop();
                     break;
                 }
                 queueCondition.wait(lock);
             }
         }
-        renderer->render(currentGLContextScreen, true);
+        // The context does not have to be released if it is shared by all the sensors
+        renderer->render(currentGLContextScreen, !useSharedGLResources);
         
         {
             std::lock_guard<std::mutex> lock(queueMutex);
@@ -1169,10 +1860,114 @@ void SensorRenderer::updateSensorScene(bool updateSensorForRenderingThread)
 }
     
 
+/**
+   The bodies are culled by the bounding spheres of their links. The body of the sensor and
+   the bodies with lights are not culled so that the cameras and the lights are always extracted
+   by the renderer.
+*/
+void SensorScene::initializeCulling(int sensorBodyIndex)
+{
+    bodyCullingSpheres.resize(sceneBodies.size());
+    for(size_t i=0; i < sceneBodies.size(); ++i){
+        auto sceneBody = sceneBodies[i];
+        auto& spheres = bodyCullingSpheres[i];
+        if(static_cast<int>(i) == sensorBodyIndex || !sceneBody->body()->devices<Light>().empty()){
+            continue;
+        }
+        const int n = sceneBody->numSceneLinks();
+        for(int j=0; j < n; ++j){
+            auto sceneLink = sceneBody->sceneLink(j);
+            const BoundingBox& bbox = sceneLink->untransformedBoundingBox();
+            if(!bbox.empty()){
+                spheres.push_back({ sceneLink->link(), bbox.center(), bbox.boundingSphereRadius() });
+            }
+        }
+        if(spheres.empty()){
+            // A body without any shape is not culled
+            spheres.push_back({ sceneBody->body()->rootLink(), Vector3::Zero(), 0.0 });
+        }
+    }
+    isCullingEnabled = true;
+}
+
+
+void SensorScene::addCullingView(Link* link, const Isometry3& T_local, SgCamera* camera, double aspectRatio)
+{
+    auto perspectiveCamera = dynamic_cast<SgPerspectiveCamera*>(camera);
+    if(!perspectiveCamera){
+        // The culling is only supported for the perspective cameras
+        isCullingEnabled = false;
+        return;
+    }
+    CullingView view;
+    view.link = link;
+    view.T_local = T_local;
+    view.nearDistance = camera->nearClipDistance();
+    view.farDistance = camera->farClipDistance();
+    const double halfFovY = perspectiveCamera->fovy(aspectRatio) / 2.0;
+    view.tanY = tan(halfFovY);
+    view.tanX = view.tanY * aspectRatio;
+    view.hasSidePlanes = (halfFovY < radian(89.0) && atan(view.tanX) < radian(89.0));
+    view.secY = sqrt(1.0 + view.tanY * view.tanY);
+    view.secX = sqrt(1.0 + view.tanX * view.tanX);
+    cullingViews.push_back(view);
+}
+
+
+bool SensorScene::isBodyInViews(int bodyIndex, vector<Isometry3, Eigen::aligned_allocator<Isometry3>>& T_views)
+{
+    auto& spheres = bodyCullingSpheres[bodyIndex];
+    if(spheres.empty()){
+        return true;
+    }
+    for(auto& sphere : spheres){
+        const Vector3 p = sphere.link->T() * sphere.center;
+        const double r = sphere.radius;
+        for(size_t i=0; i < cullingViews.size(); ++i){
+            auto& view = cullingViews[i];
+            // The camera looks toward the negative z direction
+            const Vector3 q = T_views[i] * p;
+            const double z = -q.z();
+            if(z + r < view.nearDistance || z - r > view.farDistance){
+                continue;
+            }
+            if(view.hasSidePlanes){
+                if(fabs(q.x()) - z * view.tanX > r * view.secX ||
+                   fabs(q.y()) - z * view.tanY > r * view.secY){
+                    continue;
+                }
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+
 void SensorScene::updateScene(double currentTime)
 {
-    for(auto& sceneBody : sceneBodies){
-        sceneBody->updateLinkPositions();
+    if(!isCullingEnabled || cullingViews.empty()){
+        for(auto& sceneBody : sceneBodies){
+            sceneBody->updateLinkPositions();
+            sceneBody->updateSceneDevices(currentTime);
+        }
+        return;
+    }
+
+    // The inverse positions of the views, which move with the sensor body
+    vector<Isometry3, Eigen::aligned_allocator<Isometry3>> T_views(cullingViews.size());
+    for(size_t i=0; i < cullingViews.size(); ++i){
+        auto& view = cullingViews[i];
+        T_views[i] = (view.link->T() * view.T_local).inverse(Eigen::Isometry);
+    }
+    
+    for(size_t i=0; i < sceneBodies.size(); ++i){
+        auto& sceneBody = sceneBodies[i];
+        const bool isVisible = isBodyInViews(i, T_views);
+        bodySwitches[i]->setTurnedOn(isVisible);
+        if(isVisible){
+            sceneBody->updateLinkPositions();
+        }
         sceneBody->updateSceneDevices(currentTime);
     }
 }
@@ -1234,11 +2029,15 @@ exitConcurrentRenderingLoop:
 
 void SensorRenderer::render(SensorScreenRenderer*& currentGLContextScreen, bool doDoneGLContextCurrent)
 {
-    for(auto& screen : screens){
+    const int n = screens.size();
+    for(int i=0; i < n; ++i){
+        auto& screen = screens[i];
         screen->render(currentGLContextScreen);
         if(doDoneGLContextCurrent){
-            screen->doneGLContextCurrent();
-            currentGLContextScreen = nullptr;
+            if(i == n - 1 || !screens[i + 1]->hasSameGLContext(screen)){
+                screen->doneGLContextCurrent();
+                currentGLContextScreen = nullptr;
+            }
         }
     }
 }
@@ -1246,17 +2045,37 @@ void SensorRenderer::render(SensorScreenRenderer*& currentGLContextScreen, bool
 
 void SensorScreenRenderer::render(SensorScreenRenderer*& currentGLContextScreen)
 {
-    if(this != currentGLContextScreen){
+    if(!currentGLContextScreen || !currentGLContextScreen->hasSameGLContext(this)){
         makeGLContextCurrent();
-        currentGLContextScreen = this;
     }
-    renderer->render();
+    currentGLContextScreen = this;
+
+    if(isRendererShared){
+        applyScreenSettingsToSharedRenderer();
+    }
 
+    timeMeasure.begin();
+    renderer->render();
     if(USE_FLUSH_GL_FUNCTION){
         renderer->flushGL();
     }
-    
-    storeResultToTmpDataBuffer();
+    timeMeasure.end();
+    renderingTime = timeMeasure.time();
+
+    /*
+      The time to store the result includes the time to wait for the GPU to finish the
+      rendering unless the readback is pipelined. The readback time is what remains after
+      the conversion time is subtracted.
+    */
+    conversionTime = 0.0;
+    timeMeasure.begin();
+    if(isReadbackPipelined){
+        storeResultToTmpDataBufferWithPixelBuffers();
+    } else {
+        storeResultToTmpDataBuffer();
+    }
+    timeMeasure.end();
+    storingTime = timeMeasure.time();
 }
 
 
@@ -1293,6 +2112,99 @@ void SensorScreenRenderer::storeResultToTmpDataBuffer()
     }
 }
 
+
+void SensorScreenRenderer::initializePixelBuffers()
+{
+    const int numPixels = pixelWidth * pixelHeight;
+    colorDataSize = 0;
+    depthDataSize = 0;
+    if(cameraForRendering && cameraForRendering->imageType() == Camera::COLOR_IMAGE){
+        colorDataSize = numPixels * 3;
+    }
+    if(rangeCameraForRendering || rangeSensorForRendering){
+        depthDataSize = numPixels * sizeof(float);
+    }
+    depthDataOffset = (colorDataSize + 3) / 4 * 4;
+
+    glFunctions->glGenBuffers(2, pixelBuffers);
+    for(int i=0; i < 2; ++i){
+        glFunctions->glBindBuffer(GL_PIXEL_PACK_BUFFER, pixelBuffers[i]);
+        glFunctions->glBufferData(
+            GL_PIXEL_PACK_BUFFER, depthDataOffset + depthDataSize, nullptr, GL_STREAM_READ);
+    }
+    glFunctions->glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    currentPixelBufferIndex = 0;
+}
+
+
+/**
+   The pixels of the current frame are transferred to a pixel buffer object without waiting
+   for the completion, and the pixels of the previous frame, whose transfer has been completed
+   during the rendering of the current frame, are stored as the result.
+*/
+void SensorScreenRenderer::storeResultToTmpDataBufferWithPixelBuffers()
+{
+    if(!pixelBuffers[0]){
+        initializePixelBuffers();
+    }
+    
+    glFunctions->glBindBuffer(GL_PIXEL_PACK_BUFFER, pixelBuffers[currentPixelBufferIndex]);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    if(colorDataSize > 0){
+        glReadPixels(0, 0, pixelWidth, pixelHeight, GL_RGB, GL_UNSIGNED_BYTE, nullptr);
+    }
+    if(depthDataSize > 0){
+        glReadPixels(0, 0, pixelWidth, pixelHeight, GL_DEPTH_COMPONENT, GL_FLOAT,
+                     reinterpret_cast<GLvoid*>(static_cast<intptr_t>(depthDataOffset)));
+    }
+
+    hasUpdatedData = false;
+    if(hasPendingReadback){
+        glFunctions->glBindBuffer(GL_PIXEL_PACK_BUFFER, pixelBuffers[1 - currentPixelBufferIndex]);
+        auto data = static_cast<const unsigned char*>(
+            glFunctions->glMapBufferRange(
+                GL_PIXEL_PACK_BUFFER, 0, depthDataOffset + depthDataSize, GL_MAP_READ_BIT));
+        if(data){
+            storePixelsToTmpDataBuffer(
+                (colorDataSize > 0) ? data : nullptr,
+                (depthDataSize > 0) ? reinterpret_cast<const float*>(data + depthDataOffset) : nullptr);
+            glFunctions->glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        }
+    }
+    glFunctions->glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    pendingProjectionMatrix = renderer->projectionMatrix();
+    hasPendingReadback = true;
+    currentPixelBufferIndex = 1 - currentPixelBufferIndex;
+}
+
+
+void SensorScreenRenderer::storePixelsToTmpDataBuffer(const unsigned char* colorPixels, const float* depthPixels)
+{
+    if(cameraForRendering){
+        if(!tmpImage){
+            tmpImage = std::make_shared<Image>();
+        }
+        if(rangeCameraForRendering){
+            tmpPoints = std::make_shared<vector<Vector3f>>();
+            conversionTimeMeasure.begin();
+            hasUpdatedData = convertRangeCameraData(
+                colorPixels, depthPixels, pendingProjectionMatrix, *tmpImage, *tmpPoints);
+        } else {
+            conversionTimeMeasure.begin();
+            hasUpdatedData = copyCameraImage(colorPixels, *tmpImage);
+        }
+    } else if(rangeSensorForRendering){
+        tmpRangeData =  std::make_shared<vector<double>>();
+        conversionTimeMeasure.begin();
+        hasUpdatedData = convertRangeSensorData(depthPixels, pendingProjectionMatrix, *tmpRangeData);
+    } else {
+        return;
+    }
+    conversionTimeMeasure.end();
+    conversionTime = conversionTimeMeasure.time();
+}
+
 }
 
 
@@ -1348,6 +2260,7 @@ bool SensorRenderer::waitForRenderingToFinish()
     for(auto& scene : scenes){
         std::unique_lock<std::mutex> lock(scene->renderingMutex);
         if(!scene->isRenderingFinished){
+            recordFrameDelay();
             if(simImpl->isBestEffortMode){
                 if(elapsedTime > cycleTime){
                     elapsedTime = cycleTime;
@@ -1400,6 +2313,7 @@ namespace {
 bool SensorRenderer::waitForRenderingToFinish(std::unique_lock<std::mutex>& lock)
 {
     if(!sharedScene->isRenderingFinished){
+        recordFrameDelay();
         if(simImpl->isBestEffortMode){
             if(elapsedTime > cycleTime){
                 elapsedTime = cycleTime;
@@ -1417,6 +2331,25 @@ bool SensorRenderer::waitForRenderingToFinish(std::unique_lock<std::mutex>& lock
 }
 
 
+void SensorRenderer::recordFrameDelay()
+{
+    if(!isCurrentFrameDelayed){
+        ++numDelayedFrames;
+        isCurrentFrameDelayed = true;
+    }
+}
+
+
+//! This must be called when the rendering thread does not render the screens
+void SensorRenderer::resetReadbackPipeline()
+{
+    for(auto& screen : screens){
+        screen->hasPendingReadback = false;
+    }
+    isReadbackPipelineInvalidated = false;
+}
+
+
 void SensorRenderer::clearVisionData()
 {
     if(camera){
@@ -1443,10 +2376,15 @@ void SensorRenderer::copyVisionData()
     bool hasUpdatedData = true;
     for(auto& screen : screens){
         hasUpdatedData = hasUpdatedData && screen->hasUpdatedData;
+        // The times are accumulated here because the rendering of the screen has been finished
+        totalRenderingTime += screen->renderingTime;
+        totalReadbackTime += screen->storingTime - screen->conversionTime;
+        totalConversionTime += screen->conversionTime;
     }
+    ++numMeasuredFrames;
 
     if(hasUpdatedData){
-        double delay = simImpl->currentTime - onsetTime;
+        double delay = simImpl->currentTime - (isReadbackPipelined ? previousOnsetTime : onsetTime);
         if(camera){
             auto lensType = camera->lensType();
             if(lensType == Camera::NORMAL_LENS){
@@ -1497,6 +2435,10 @@ void SensorRenderer::copyVisionData()
             rangeSensor->setDelay(delay);
         }
 
+        if(imageFrameRing || dataFrameRing){
+            exportVisionData(simImpl->currentTime - delay);
+        }
+
         if(simImpl->isVisionDataRecordingEnabled){
             device->notifyStateChange();
         } else {
@@ -1506,6 +2448,53 @@ void SensorRenderer::copyVisionData()
         for(auto& screen : screens){
             screen->hasUpdatedData = false;
         }
+        ++numDeliveredFrames;
+    }
+}
+
+
+/**
+   The data is copied to the shared memory once here, and the external processes read it
+   in place instead of copying and serializing the data given by the device.
+*/
+void SensorRenderer::exportVisionData(double time)
+{
+    SharedMemoryFrameRing::FrameInfo info;
+    info.time = time;
+
+    if(imageFrameRing){
+        auto& image = camera->constImage();
+        if(!image.empty()){
+            info.dataType = SharedMemoryFrameRing::ImageData;
+            info.width = image.width();
+            info.height = image.height();
+            info.numComponents = image.numComponents();
+            info.dataSize = image.width() * image.height() * image.numComponents();
+            imageFrameRing->writeFrame(info, image.pixels());
+        }
+    }
+    if(dataFrameRing){
+        if(rangeCamera){
+            auto& points = rangeCamera->constPoints();
+            info.dataType = SharedMemoryFrameRing::PointData;
+            if(rangeCamera->isDense()){
+                info.width = rangeCamera->resolutionX();
+                info.height = rangeCamera->resolutionY();
+            } else {
+                info.width = points.size();
+                info.height = 1;
+            }
+            info.numComponents = 3;
+            info.dataSize = points.size() * sizeof(Vector3f);
+            dataFrameRing->writeFrame(info, points.data());
+        } else if(rangeSensor && rangeData){
+            info.dataType = SharedMemoryFrameRing::RangeData;
+            info.height = screens[0]->rangeSensorForRendering->numPitchSamples();
+            info.width = info.height > 0 ? rangeData->size() / info.height : 0;
+            info.numComponents = 1;
+            info.dataSize = rangeData->size() * sizeof(double);
+            dataFrameRing->writeFrame(info, rangeData->data());
+        }
     }
 }
 
@@ -1518,20 +2507,58 @@ bool SensorScreenRenderer::getCameraImage(Image& image)
     image.setSize(pixelWidth, pixelHeight, 3);
     glPixelStorei(GL_PACK_ALIGNMENT, 1);
     glReadPixels(0, 0, pixelWidth, pixelHeight, GL_RGB, GL_UNSIGNED_BYTE, image.pixels());
+    conversionTimeMeasure.begin();
     image.applyVerticalFlip();
+    conversionTimeMeasure.end();
+    conversionTime = conversionTimeMeasure.time();
     return true;
 }
 
 
-bool SensorScreenRenderer::getRangeCameraData(Image& image, vector<Vector3f>& points)
+bool SensorScreenRenderer::copyCameraImage(const unsigned char* pixels, Image& image)
 {
-    unsigned char* pixels = nullptr;
+    if(!pixels){
+        return false;
+    }
+    image.setSize(pixelWidth, pixelHeight, 3);
+    std::copy(pixels, pixels + pixelWidth * pixelHeight * 3, image.pixels());
+    image.applyVerticalFlip();
+    return true;
+}
+
 
+bool SensorScreenRenderer::getRangeCameraData(Image& image, vector<Vector3f>& points)
+{
     const bool extractColors = (cameraForRendering->imageType() == Camera::COLOR_IMAGE);
     if(extractColors){
         glPixelStorei(GL_PACK_ALIGNMENT, 1);
-        colorBuf.resize(pixelWidth * pixelHeight * 3 * sizeof(unsigned char));
+        colorBuf.resize(pixelWidth * pixelHeight * 3);
         glReadPixels(0, 0, pixelWidth, pixelHeight, GL_RGB, GL_UNSIGNED_BYTE, &colorBuf[0]);
+    }
+
+    depthBuf.resize(pixelWidth * pixelHeight);
+    glReadPixels(0, 0, pixelWidth, pixelHeight, GL_DEPTH_COMPONENT, GL_FLOAT, &depthBuf[0]);
+
+    conversionTimeMeasure.begin();
+    bool result = convertRangeCameraData(
+        extractColors ? &colorBuf[0] : nullptr, &depthBuf[0], renderer->projectionMatrix(), image, points);
+    conversionTimeMeasure.end();
+    conversionTime = conversionTimeMeasure.time();
+    return result;
+}
+
+
+/**
+   \param colorPixels The colors are not extracted if this is null
+*/
+bool SensorScreenRenderer::convertRangeCameraData
+(const unsigned char* colorPixels, const float* depthPixels, const Matrix4& P,
+ Image& image, vector<Vector3f>& points)
+{
+    unsigned char* pixels = nullptr;
+
+    const bool extractColors = (colorPixels != nullptr);
+    if(extractColors){
         if(rangeCameraForRendering->isOrganized()){
             image.setSize(pixelWidth, pixelHeight, 3);
         } else {
@@ -1540,37 +2567,40 @@ bool SensorScreenRenderer::getRangeCameraData(Image& image, vector<Vector3f>& po
         pixels = image.pixels();
     }
 
-    depthBuf.resize(pixelWidth * pixelHeight * sizeof(float));
-    glReadPixels(0, 0, pixelWidth, pixelHeight, GL_DEPTH_COMPONENT, GL_FLOAT, &depthBuf[0]);
-
-    const Matrix4f Pinv = renderer->projectionMatrix().inverse().cast<float>();
+    const Matrix4f Pinv = P.inverse().cast<float>();
     const float fw = pixelWidth;
     const float fh = pixelHeight;
     const int cx = pixelWidth / 2;
     const int cy = pixelHeight / 2;
     const bool isOrganized = rangeCameraForRendering->isOrganized();
-    Vector4f n;
-    n[3] = 1.0f;
     points.clear();
     points.reserve(pixelWidth * pixelHeight);
-    unsigned char* colorSrc = nullptr;
+    const unsigned char* colorSrc = nullptr;
+
+    /*
+      The unprojected homogeneous point Pinv * (nx, ny, 2 * z - 1, 1) is accumulated from the terms
+      of the normalized device coordinates. The terms of nx are shared by all the rows.
+    */
+    xTerms.resize(4, pixelWidth);
+    for(int x=0; x < pixelWidth; ++x){
+        xTerms.col(x) = Pinv.col(0) * (2.0f * x / fw - 1.0f);
+    }
+    const Vector4f zTerm = Pinv.col(2) * 2.0f;
 
     isDense = true;
     
     for(int y = pixelHeight - 1; y >= 0; --y){
         int srcpos = y * pixelWidth;
         if(extractColors){
-            colorSrc = &colorBuf[0] + y * pixelWidth * 3;
+            colorSrc = colorPixels + y * pixelWidth * 3;
         }
+        const Vector4f yTerm = Pinv.col(1) * (2.0f * y / fh - 1.0f) + Pinv.col(3) - Pinv.col(2);
         for(int x=0; x < pixelWidth; ++x){
-            const float z = depthBuf[srcpos + x];
+            const float z = depthPixels[srcpos + x];
             if(z > 0.0f && z < 1.0f){
-                n.x() = 2.0f * x / fw - 1.0f;
-                n.y() = 2.0f * y / fh - 1.0f;
-                n.z() = 2.0f * z - 1.0f;
-                const Vector4f o = Pinv * n;
-                const float& w = o[3];
-                points.push_back(Vector3f(o[0] / w, o[1] / w, o[2] / w));
+                const Vector4f o = xTerms.col(x) + yTerm + zTerm * z;
+                const float iw = 1.0f / o[3];
+                points.emplace_back(o[0] * iw, o[1] * iw, o[2] * iw);
                 if(pixels){
                     pixels[0] = colorSrc[0];
                     pixels[1] = colorSrc[1];
@@ -1603,7 +2633,9 @@ bool SensorScreenRenderer::getRangeCameraData(Image& image, vector<Vector3f>& po
                 }
                 isDense = false;
             }
-            colorSrc += 3;
+            if(extractColors){
+                colorSrc += 3;
+            }
         }
     }
 
@@ -1616,6 +2648,19 @@ bool SensorScreenRenderer::getRangeCameraData(Image& image, vector<Vector3f>& po
 
 
 bool SensorScreenRenderer::getRangeSensorData(vector<double>& rangeData)
+{
+    depthBuf.resize(pixelWidth * pixelHeight);
+    glReadPixels(0, 0, pixelWidth, pixelHeight, GL_DEPTH_COMPONENT, GL_FLOAT, &depthBuf[0]);
+
+    conversionTimeMeasure.begin();
+    bool result = convertRangeSensorData(&depthBuf[0], renderer->projectionMatrix(), rangeData);
+    conversionTimeMeasure.end();
+    conversionTime = conversionTimeMeasure.time();
+    return result;
+}
+
+
+bool SensorScreenRenderer::convertRangeSensorData(const float* depthPixels, const Matrix4& P, vector<double>& rangeData)
 {
     const double yawRange = rangeSensorForRendering->yawRange();
     const double yawStep = rangeSensorForRendering->yawStep();
@@ -1626,15 +2671,12 @@ bool SensorScreenRenderer::getRangeSensorData(vector<double>& rangeData)
     const double pitchStep = rangeSensorForRendering->pitchStep();
     const double maxTanPitchAngle = tan(pitchRange / 2.0) / cos(yawRange / 2.0);
 
-    const Matrix4 Pinv = renderer->projectionMatrix().inverse();
+    const Matrix4 Pinv = P.inverse();
     const double Pinv_32 = Pinv(3, 2);
     const double Pinv_33 = Pinv(3, 3);
     const double fw = pixelWidth;
     const double fh = pixelHeight;
 
-    depthBuf.resize(pixelWidth * pixelHeight * sizeof(float));
-    glReadPixels(0, 0, pixelWidth, pixelHeight, GL_DEPTH_COMPONENT, GL_FLOAT, &depthBuf[0]);
-
     rangeData.reserve(numUniqueYawSamples * numPitchSamples);
 
     for(int pitch=0; pitch < numPitchSamples; ++pitch){
@@ -1661,7 +2703,7 @@ bool SensorScreenRenderer::getRangeSensorData(vector<double>& rangeData)
                 px = nearbyint(r * (fw - 1.0));
             }
             //! \todo add the option to do the interpolation between the adjacent two pixel depths
-            const float depth = depthBuf[srcpos + px];
+            const float depth = depthPixels[srcpos + px];
             if(depth > 0.0f && depth < 1.0f){
                 const double z0 = 2.0 * depth - 1.0;
                 const double w = Pinv_32 * z0 + Pinv_33;
@@ -1733,11 +2775,73 @@ void GLVisionSimulatorItemImpl::finalizeSimulation()
             sensorQueue.pop();
         }
     }
-        
+
+    if(currentTime > 0.0){
+        putThroughputReport();
+    }
+
+    glResourceOwnerScreens[0].reset();
+    glResourceOwnerScreens[1].reset();
     sensorRenderers.clear();
 }
 
 
+/**
+   The report is output to the message view and is also stored in a mapping so that
+   a benchmark script can compare the throughputs of different settings.
+*/
+void GLVisionSimulatorItemImpl::putThroughputReport()
+{
+    elapsedTimeMeasure.end();
+    const double elapsedTime = elapsedTimeMeasure.time();
+
+    throughputReport = new Mapping;
+    throughputReport->write("threadMode", threadMode.selectedSymbol());
+    throughputReport->write("bestEffort", isBestEffortMode);
+    throughputReport->write("simulationTime", currentTime);
+    throughputReport->write("elapsedTime", elapsedTime);
+    throughputReport->write("simulationThreadTime", simulationThreadTime);
+    auto& sensors = *throughputReport->createListing("sensors");
+
+    os << format(_("{0}: {1:.3f} s of the simulation was computed in {2:.3f} s, "
+                   "and the simulation thread spent {3:.3f} s in updating and waiting for the vision sensors.\n"),
+                 self->displayName(), currentTime, elapsedTime, simulationThreadTime);
+
+    for(auto& renderer : sensorRenderers){
+        const double frameRate = renderer->numDeliveredFrames / currentTime;
+        const int n = std::max(renderer->numMeasuredFrames, 1);
+        const double renderingTime = renderer->totalRenderingTime / n;
+        const double readbackTime = renderer->totalReadbackTime / n;
+        const double conversionTime = renderer->totalConversionTime / n;
+
+        os << format(_("{0}: \"{1}\" of {2} achieved {3:.1f} of {4:.1f} frames per second, "
+                       "and {5} frames were not rendered within the latency. "
+                       "The rendering, readback and conversion of a frame took "
+                       "{6:.2f}, {7:.2f} and {8:.2f} ms on average.\n"),
+                     self->displayName(), renderer->device->name(), renderer->simBody->body()->name(),
+                     frameRate, 1.0 / renderer->cycleTime, renderer->numDelayedFrames,
+                     renderingTime * 1000.0, readbackTime * 1000.0, conversionTime * 1000.0);
+
+        auto info = sensors.newMapping();
+        info->write("body", renderer->simBody->body()->name());
+        info->write("sensor", renderer->device->name());
+        info->write("frameRate", frameRate);
+        info->write("targetFrameRate", 1.0 / renderer->cycleTime);
+        info->write("numDelayedFrames", renderer->numDelayedFrames);
+        info->write("renderingTime", renderingTime);
+        info->write("readbackTime", readbackTime);
+        info->write("conversionTime", conversionTime);
+    }
+    os.flush();
+}
+
+
+Mapping* GLVisionSimulatorItem::throughputReport() const
+{
+    return impl->throughputReport;
+}
+
+
 namespace {
 
 SensorRenderer::~SensorRenderer()
@@ -1764,14 +2868,31 @@ void SensorScene::terminate()
 
 SensorScreenRenderer::~SensorScreenRenderer()
 {
-    if(glContext){
+    if(glContext || eglContext){
         makeGLContextCurrent();
-        frameBuffer->release();
-        delete frameBuffer;
-        delete glContext;
-        delete offscreenSurface;
+        if(pixelBuffers[0]){
+            glFunctions->glDeleteBuffers(2, pixelBuffers);
+        }
+        if(frameBuffer){
+            frameBuffer->release();
+            delete frameBuffer;
+        }
+        if(eglFrameBuffer){
+            glFunctions->glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            glFunctions->glDeleteFramebuffers(1, &eglFrameBuffer);
+            glFunctions->glDeleteRenderbuffers(2, eglRenderBuffers);
+        }
+        // The shared context and renderer are deleted by the owner screen, which outlives this screen
+        if(!glContextOwnerScreen){
+            delete glContext;
+            delete offscreenSurface;
+#ifdef USE_EGL
+            delete eglContext;
+#endif
+            delete glFunctions;
+        }
     }
-    if(renderer){
+    if(renderer && !glContextOwnerScreen){
         delete renderer;
     }
 }
@@ -1796,6 +2917,9 @@ void GLVisionSimulatorItemImpl::doPutProperties(PutPropertyFunction& putProperty
     putProperty(_("Max latency [s]"), maxLatency, changeProperty(maxLatency));
     putProperty(_("Record vision data"), isVisionDataRecordingEnabled, changeProperty(isVisionDataRecordingEnabled));
     putProperty(_("Thread mode"), threadMode, [&](int index){ return threadMode.select(index); });
+    putProperty(_("GL backend"), glBackend, [&](int index){ return glBackend.select(index); });
+    putProperty(_("GL devices"), glDeviceListString,
+                [&](const string& devices){ return updateGLDevices(devices); });
     putProperty(_("Best effort"), isBestEffortModeProperty, changeProperty(isBestEffortModeProperty));
     putProperty(_("All scene objects"), shootAllSceneObjects, changeProperty(shootAllSceneObjects));
     putProperty.min(1.0);
@@ -1805,6 +2929,11 @@ void GLVisionSimulatorItemImpl::doPutProperties(PutPropertyFunction& putProperty
     putProperty(_("Head light"), isHeadLightEnabled, changeProperty(isHeadLightEnabled));
     putProperty(_("Additional lights"), areAdditionalLightsEnabled, changeProperty(areAdditionalLightsEnabled));
     putProperty(_("Anti-aliasing"), isAntiAliasingEnabled, changeProperty(isAntiAliasingEnabled));
+    putProperty(_("Pipelined readback"), isPipelinedReadbackEnabled, changeProperty(isPipelinedReadbackEnabled));
+    putProperty(_("Shared GL resources"), isGLResourceSharingEnabled, changeProperty(isGLResourceSharingEnabled));
+    putProperty(_("Frustum culling"), isFrustumCullingEnabled, changeProperty(isFrustumCullingEnabled));
+    putProperty(_("Shared memory export"), isSharedMemoryExportEnabled, changeProperty(isSharedMemoryExportEnabled));
+    putProperty.min(0.0)(_("LOD distance scale"), levelOfDetailDistanceScale, changeProperty(levelOfDetailDistanceScale));
 }
 
 
@@ -1823,6 +2952,10 @@ bool GLVisionSimulatorItemImpl::store(Archive& archive)
     archive.write("maxLatency", maxLatency);
     archive.write("recordVisionData", isVisionDataRecordingEnabled);
     archive.write("threadMode", threadMode.selectedSymbol());
+    archive.write("glBackend", glBackend.selectedSymbol());
+    if(!glDeviceListString.empty()){
+        archive.write("glDevices", glDeviceListString, DOUBLE_QUOTED);
+    }
     archive.write("bestEffort", isBestEffortModeProperty);
     archive.write("allSceneObjects", shootAllSceneObjects);
     archive.write("rangeSensorPrecisionRatio", rangeSensorPrecisionRatio);
@@ -1830,6 +2963,11 @@ bool GLVisionSimulatorItemImpl::store(Archive& archive)
     archive.write("enableHeadLight", isHeadLightEnabled);    
     archive.write("enableAdditionalLights", areAdditionalLightsEnabled);
     archive.write("antiAliasing", isAntiAliasingEnabled);
+    archive.write("pipelinedReadback", isPipelinedReadbackEnabled);
+    archive.write("sharedGLResources", isGLResourceSharingEnabled);
+    archive.write("frustumCulling", isFrustumCullingEnabled);
+    archive.write("sharedMemoryExport", isSharedMemoryExportEnabled);
+    archive.write("lodDistanceScale", levelOfDetailDistanceScale);
     return true;
 }
 
@@ -1858,8 +2996,20 @@ bool GLVisionSimulatorItemImpl::restore(const Archive& archive)
     archive.read("enableHeadLight", isHeadLightEnabled);
     archive.read("enableAdditionalLights", areAdditionalLightsEnabled);
     archive.read("antiAliasing", isAntiAliasingEnabled);
+    archive.read("pipelinedReadback", isPipelinedReadbackEnabled);
+    archive.read("sharedGLResources", isGLResourceSharingEnabled);
+    archive.read("frustumCulling", isFrustumCullingEnabled);
+    archive.read("sharedMemoryExport", isSharedMemoryExportEnabled);
+    archive.read("lodDistanceScale", levelOfDetailDistanceScale);
 
     string symbol;
+    if(archive.read("glBackend", symbol)){
+        glBackend.select(symbol);
+    }
+    string devices;
+    if(archive.read("glDevices", devices)){
+        updateGLDevices(devices);
+    }
     if(archive.read("threadMode", symbol)){
         threadMode.select(symbol);
     } else {
@@ -12,6 +12,7 @@
 namespace cnoid {
 
 class GLVisionSimulatorItemImpl;
+class Mapping;
 
 class CNOID_EXPORT GLVisionSimulatorItem : public SubSimulatorItem
 {
@@ -24,21 +25,45 @@ public:
 
     enum ThreadMode { SINGLE_THREAD_MODE, SENSOR_THREAD_MODE, SCREEN_THREAD_MODE, N_THREAD_MODES };
 
+    /**
+       The EGL backend renders the sensors without any window system, and it is only available
+       if the plugin is built with ENABLE_EGL_VISION_RENDERING.
+    */
+    enum GLBackend { QT_GL_BACKEND, EGL_GL_BACKEND, N_GL_BACKENDS };
+
     void setTargetBodies(const std::string& bodyNames);
     void setTargetSensors(const std::string& sensorNames);
     void setMaxFrameRate(double rate);
     void setMaxLatency(double latency);
     void setVisionDataRecordingEnabled(bool on);
     void setThreadMode(int mode);
+    void setGLBackend(int backend);
+    //! The indices of the EGL devices separated by commas. The sensors are rendered on the devices in turn.
+    void setGLDevices(const std::string& devices);
     void setBestEffortMode(bool on);
     void setRangeSensorPrecisionRatio(double r);
     void setAllSceneObjectsEnabled(bool on);
     void setHeadLightEnabled(bool on);
     void setAdditionalLightsEnabled(bool on);
+    void setPipelinedReadbackEnabled(bool on);
+    void setGLResourceSharingEnabled(bool on);
+    void setFrustumCullingEnabled(bool on);
+    void setSharedMemoryExportEnabled(bool on);
+    /**
+       The scale of the distances to select the levels of detail in the sensor images.
+       The most detailed levels are always used when the scale is zero.
+    */
+    void setLevelOfDetailDistanceScale(double scale);
 
     virtual bool initializeSimulation(SimulatorItem* simulatorItem);
     virtual void finalizeSimulation();
 
+    /**
+       The frame rates and the average times of the rendering, readback and conversion of
+       the sensors measured in the last simulation, or nullptr if no simulation has been finished.
+    */
+    Mapping* throughputReport() const;
+
     // deprecated
     void setDedicatedSensorThreadsEnabled(bool on); // setThreadMode(SENSOR_THREAD_MODE);
 
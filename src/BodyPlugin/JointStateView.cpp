@@ -129,6 +129,7 @@ JointStateView::Impl::Impl(JointStateView* self)
     self->sigDeactivated().connect([&](){ onActivated(false); });
 
     updateViewLater.setFunction([&](){ updateView(); });
+    updateViewLater.setPriority(LazyCaller::LowPriority);
 
     //self->enableFontSizeZoomKeys(true);
 }
@@ -24,12 +24,18 @@
 #include <cnoid/BodyCollisionDetector>
 #include <cnoid/AISTCollisionDetector>
 #include <cnoid/IdPair>
+#include <cnoid/ThreadPool>
 #include <QDialogButtonBox>
 #include <QBoxLayout>
 #include <QFrame>
 #include <QLabel>
 #include <fmt/format.h>
 #include <map>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include <sstream>
 #include "gettext.h"
 
 using namespace std;
@@ -38,16 +44,104 @@ using fmt::format;
 
 namespace {
 
-bool USE_DUPLICATED_BODY = false;
-
 KinematicFaultChecker* checkerInstance = nullptr;
 
+// The frames are divided into the blocks of this range of sizes to be checked in parallel
+const int MinFrameBlockSize = 50;
+const int MaxFrameBlockSize = 2000;
+
 #if defined(_MSC_VER) && _MSC_VER < 1800
 inline long lround(double x) {
     return static_cast<long>((x > 0.0) ? floor(x + 0.5) : ceil(x -0.5));
 }
 #endif
 
+struct FaultEvent
+{
+    enum Type { PositionFault, VelocityFault, Collision };
+    Type type;
+    int frame;
+    // The joint id for the joint faults, and the link indices for the collisions
+    int id0;
+    int id1;
+    double value;
+};
+
+/**
+   The body clone and the collision detector used by a thread. They are created in the main thread
+   because cloning the body and creating the geometries of the collision detector are not thread-safe.
+*/
+struct CheckWorkspace
+{
+    BodyPtr body;
+    BodyCollisionDetector collisionDetector;
+
+    // The pose of the frame whose collisions were last detected, and the detected collisions
+    bool hasLastCheckedPose;
+    vector<double> lastCheckedJointPositions;
+    vector<SE3, Eigen::aligned_allocator<SE3>> lastCheckedLinkPositions;
+    vector<IdPair<int>> lastCollisions;
+};
+
+/**
+   This class checks the frames of a motion in parallel. The faults detected in each frame block are
+   reported in the order of the frames as soon as the preceding blocks are completed, so the messages
+   are the same as those of the sequential check.
+*/
+class FaultCheck
+{
+public:
+    shared_ptr<MultiValueSeq> qseq;
+    shared_ptr<MultiSE3Seq> pseq;
+    vector<bool> linkSelection;
+    bool checkPosition;
+    bool checkVelocity;
+    bool checkCollision;
+    double frameRate;
+    double angleMargin;
+    double translationMargin;
+    double velocityLimitRatio;
+    double skipAngleTolerance;
+    double skipTranslationTolerance;
+    int beginningFrame;
+    int endingFrame;
+    int numJoints;
+    int numLinks;
+    string targetName;
+
+    vector<unique_ptr<CheckWorkspace>> workspaces;
+    std::atomic<bool> isCanceled;
+
+    FaultCheck() : isCanceled(false) { }
+    int run(std::function<void(const string& message)> output);
+
+private:
+    int frameBlockSize;
+    int numFrameBlocks;
+    std::atomic<int> nextFrameBlock;
+    vector<vector<FaultEvent>> blockEvents;
+    vector<bool> blockCompletions;
+    int numReportedBlocks;
+    std::mutex reportMutex;
+    std::function<void(const string& message)> output;
+
+    // The states to merge the continuous faults, which are only accessed in reportCompletedBlocks
+    int numFaults;
+    vector<int> lastPosFaultFrames;
+    vector<int> lastVelFaultFrames;
+    std::map<IdPair<int>, int> lastCollisionFrames;
+
+    void checkFrameBlock(CheckWorkspace* workspace, int block);
+    bool isPoseChangeWithinTolerance(CheckWorkspace* workspace, int frame);
+    void storeCheckedPose(CheckWorkspace* workspace, int frame);
+    void reportCompletedBlocks(int block);
+    void putJointPositionFault(std::ostream& os, const FaultEvent& event);
+    void putJointVelocityFault(std::ostream& os, const FaultEvent& event);
+    void putSelfCollision(std::ostream& os, const FaultEvent& event);
+};
+
+typedef shared_ptr<FaultCheck> FaultCheckPtr;
+
 }
 
 namespace cnoid {
@@ -70,32 +164,25 @@ public:
         
     DoubleSpinBox velocityLimitRatioSpin;
     CheckBox collisionCheck;
+    DoubleSpinBox skipAngleToleranceSpin;
+    DoubleSpinBox skipTranslationToleranceSpin;
 
     CheckBox onlyTimeBarRangeCheck;
 
-    int numFaults;
-    vector<int> lastPosFaultFrames;
-    vector<int> lastVelFaultFrames;
-    typedef IdPair<CollisionDetector::GeometryHandle> GeometryPair;
-    typedef std::map<GeometryPair, int> LastCollisionFrameMap;
-    LastCollisionFrameMap lastCollisionFrames;
-
-    double frameRate;
-    double angleMargin;
-    double translationMargin;
-    double velocityLimitRatio;
+    // The checks applied from the dialog are processed in this thread
+    std::thread backgroundThread;
+    vector<FaultCheckPtr> backgroundChecks;
 
     Impl();
+    ~Impl();
     bool store(Archive& archive);
     void restore(const Archive& archive);
     void apply();
-    int checkFaults(
+    void cancelBackgroundChecks();
+    FaultCheckPtr createFaultCheck(
         BodyItem* bodyItem, BodyMotionItem* motionItem,
         bool checkPosition, bool checkVelocity, bool checkCollision,
         vector<bool> linkSelection, double beginningTime, double endingTime);
-    void putJointPositionFault(int frame, Link* joint);
-    void putJointVelocityFault(int frame, Link* joint);
-    void putSelfCollision(Body* body, int frame, const CollisionPair& collisionPair);
 };
 
 }
@@ -209,6 +296,19 @@ KinematicFaultChecker::Impl::Impl()
     collisionCheck.setText(_("Self-collision check"));
     collisionCheck.setChecked(true);
     hbox->addWidget(&collisionCheck);
+    hbox->addSpacing(10);
+
+    hbox->addWidget(new QLabel(_("Skip pose changes within")));
+    skipAngleToleranceSpin.setDecimals(3);
+    skipAngleToleranceSpin.setRange(0.0, 9.999);
+    skipAngleToleranceSpin.setSingleStep(0.001);
+    hbox->addWidget(&skipAngleToleranceSpin);
+    hbox->addWidget(new QLabel("[deg]"));
+    skipTranslationToleranceSpin.setDecimals(4);
+    skipTranslationToleranceSpin.setRange(0.0, 0.9999);
+    skipTranslationToleranceSpin.setSingleStep(0.0001);
+    hbox->addWidget(&skipTranslationToleranceSpin);
+    hbox->addWidget(new QLabel("[m]"));
 
     hbox->addStretch();
     vbox->addLayout(hbox);
@@ -234,6 +334,12 @@ KinematicFaultChecker::Impl::Impl()
 }
 
 
+KinematicFaultChecker::Impl::~Impl()
+{
+    cancelBackgroundChecks();
+}
+
+
 bool KinematicFaultChecker::Impl::store(Archive& archive)
 {
     archive.write("checkJointPositions", positionCheck.isChecked());
@@ -245,6 +351,8 @@ bool KinematicFaultChecker::Impl::store(Archive& archive)
                   (allJointsRadio.isChecked() ? "all" :
                    (selectedJointsRadio.isChecked() ? "selected" : "non-selected")));
     archive.write("checkSelfCollisions", collisionCheck.isChecked());
+    archive.write("collisionSkipAngleTolerance", skipAngleToleranceSpin.value());
+    archive.write("collisionSkipTranslationTolerance", skipTranslationToleranceSpin.value());
     archive.write("onlyTimeBarRange", onlyTimeBarRangeCheck.isChecked());
     return true;
 }
@@ -268,12 +376,18 @@ void KinematicFaultChecker::Impl::restore(const Archive& archive)
         }
     }
     collisionCheck.setChecked(archive.get("checkSelfCollisions", collisionCheck.isChecked()));
+    skipAngleToleranceSpin.setValue(
+        archive.get("collisionSkipAngleTolerance", skipAngleToleranceSpin.value()));
+    skipTranslationToleranceSpin.setValue(
+        archive.get("collisionSkipTranslationTolerance", skipTranslationToleranceSpin.value()));
     onlyTimeBarRangeCheck.setChecked(archive.get("onlyTimeBarRange", onlyTimeBarRangeCheck.isChecked()));
 }
 
 
 void KinematicFaultChecker::Impl::apply()
 {
+    cancelBackgroundChecks();
+    
     auto items = RootItem::instance()->selectedItems<BodyMotionItem>();
     if(items.empty()){
         mv->notify(_("No BodyMotionItems are selected."));
@@ -284,10 +398,6 @@ void KinematicFaultChecker::Impl::apply()
             if(!bodyItem){
                 mv->notify(format(_("{} is not owned by any BodyItem. Check skiped."), motionItem->displayName()));
             } else {
-                mv->putln();
-                mv->notify(format(_("Applying the Kinematic Fault Checker to {} ..."),
-                                  motionItem->headItem()->displayName()));
-                
                 vector<bool> linkSelection;
                 if(allJointsRadio.isChecked()){
                     linkSelection.resize(bodyItem->body()->numLinks(), true);
@@ -300,20 +410,44 @@ void KinematicFaultChecker::Impl::apply()
                 
                 double beginningTime = 0.0;
                 double endingTime = motionItem->motion()->getTimeLength();
-                std::numeric_limits<double>::max();
                 if(onlyTimeBarRangeCheck.isChecked()){
                     TimeBar* timeBar = TimeBar::instance();
                     beginningTime = timeBar->minTime();
                     endingTime = timeBar->maxTime();
                 }
-                
-                int n = checkFaults(bodyItem, motionItem,
-                                    positionCheck.isChecked(),
-                                    velocityCheck.isChecked(),
-                                    collisionCheck.isChecked(),
-                                    linkSelection,
-                                    beginningTime, endingTime);
-                
+
+                backgroundChecks.push_back(
+                    createFaultCheck(
+                        bodyItem, motionItem,
+                        positionCheck.isChecked(),
+                        velocityCheck.isChecked(),
+                        collisionCheck.isChecked(),
+                        linkSelection,
+                        beginningTime, endingTime));
+            }
+        }
+    }
+
+    if(backgroundChecks.empty()){
+        return;
+    }
+
+    /*
+      The checks are processed in the background so that the GUI is not blocked by a long motion.
+      The messages put from the thread are rendered by MessageView in the order they are put.
+    */
+    backgroundThread = std::thread(
+        [this, checks = backgroundChecks](){
+            for(auto& check : checks){
+                mv->putln();
+                mv->notify(format(_("Applying the Kinematic Fault Checker to {} ..."), check->targetName));
+
+                int n = check->run([this](const string& message){ mv->put(message); });
+
+                if(check->isCanceled){
+                    mv->notify(_("The Kinematic Fault Checker has been canceled."));
+                    break;
+                }
                 if(n > 0){
                     if(n == 1){
                         mv->notify(_("A fault has been detected."));
@@ -324,8 +458,19 @@ void KinematicFaultChecker::Impl::apply()
                     mv->notify(_("No faults have been detected."));
                 }
             }
-        }
+        });
+}
+
+
+void KinematicFaultChecker::Impl::cancelBackgroundChecks()
+{
+    for(auto& check : backgroundChecks){
+        check->isCanceled = true;
     }
+    if(backgroundThread.joinable()){
+        backgroundThread.join();
+    }
+    backgroundChecks.clear();
 }
 
 
@@ -336,71 +481,152 @@ int KinematicFaultChecker::checkFaults
 (BodyItem* bodyItem, BodyMotionItem* motionItem, double beginningTime, double endingTime)
 {
     vector<bool> linkSelection(bodyItem->body()->numLinks(), true);
-    return impl->checkFaults(
+    auto check = impl->createFaultCheck(
         bodyItem, motionItem, true, true, true, linkSelection, beginningTime, endingTime);
+
+    // The messages are put after the check so that they precede the messages of the caller
+    string messages;
+    int numFaults = check->run([&messages](const string& message){ messages += message; });
+    impl->mv->put(messages);
+
+    return numFaults;
 }
 
 
-int KinematicFaultChecker::Impl::checkFaults
+FaultCheckPtr KinematicFaultChecker::Impl::createFaultCheck
 (BodyItem* bodyItem, BodyMotionItem* motionItem,
  bool checkPosition, bool checkVelocity, bool checkCollision, vector<bool> linkSelection,
  double beginningTime, double endingTime)
 {
-    numFaults = 0;
+    auto check = make_shared<FaultCheck>();
+    check->targetName = motionItem->headItem()->displayName();
+    check->beginningFrame = 0;
+    check->endingFrame = -1;
 
     auto body = bodyItem->body();
     auto motion = motionItem->motion();
-    auto qseq = motion->jointPosSeq();;
-    auto pseq = motion->linkPosSeq();
+    auto qseq = motion->jointPosSeq();
     
     if((!checkPosition && !checkVelocity && !checkCollision) || body->isStaticModel() || !qseq->getNumFrames()){
-        return numFaults;
+        return check;
     }
 
-    BodyState orgKinematicState;
-    
-    if(USE_DUPLICATED_BODY){
-        body = body->clone();
-    } else {
-        bodyItem->storeKinematicState(orgKinematicState);
-    }
+    // The sequences are copied because the motion may be modified during the background check
+    check->qseq = make_shared<MultiValueSeq>(*qseq);
+    check->pseq = make_shared<MultiSE3Seq>(*motion->linkPosSeq());
+    check->linkSelection = linkSelection;
+    check->checkPosition = checkPosition;
+    check->checkVelocity = checkVelocity;
+    check->checkCollision = checkCollision;
+    check->numJoints = std::min(body->numJoints(), check->qseq->numParts());
+    check->numLinks = std::min(body->numLinks(), check->pseq->numParts());
+    check->frameRate = motion->frameRate();
+    check->angleMargin = radian(angleMarginSpin.value());
+    check->translationMargin = translationMarginSpin.value();
+    check->velocityLimitRatio = velocityLimitRatioSpin.value() / 100.0;
+    check->skipAngleTolerance = radian(skipAngleToleranceSpin.value());
+    check->skipTranslationTolerance = skipTranslationToleranceSpin.value();
+    check->beginningFrame = std::max(0, (int)(beginningTime * check->frameRate));
+    check->endingFrame = std::min((motion->numFrames() - 1), (int)lround(endingTime * check->frameRate));
+
+    const int numFrames = check->endingFrame - check->beginningFrame + 1;
+    const int numWorkspaces =
+        std::max(1, std::min(static_cast<int>(std::thread::hardware_concurrency()),
+                             (numFrames + MinFrameBlockSize - 1) / MinFrameBlockSize));
 
-    BodyCollisionDetector bodyCollisionDetector;
     WorldItem* worldItem = bodyItem->findOwnerItem<WorldItem>();
-    if(worldItem){
-        bodyCollisionDetector.setCollisionDetector(worldItem->collisionDetector()->clone());
-    } else {
-        bodyCollisionDetector.setCollisionDetector(new AISTCollisionDetector);
+
+    for(int i=0; i < numWorkspaces; ++i){
+        auto workspace = new CheckWorkspace;
+        workspace->body = body->clone();
+        if(checkCollision){
+            auto& detector = workspace->collisionDetector;
+            if(worldItem){
+                detector.setCollisionDetector(worldItem->collisionDetector()->clone());
+            } else {
+                detector.setCollisionDetector(new AISTCollisionDetector);
+            }
+            detector.addBody(workspace->body, true);
+            detector.makeReady();
+            Link* root = workspace->body->rootLink();
+            root->p().setZero();
+            root->R().setIdentity();
+        }
+        check->workspaces.emplace_back(workspace);
     }
 
-    bodyCollisionDetector.addBody(body, true);
-    bodyCollisionDetector.makeReady();
+    return check;
+}
 
-    const int numJoints = std::min(body->numJoints(), qseq->numParts());
-    const int numLinks = std::min(body->numLinks(), pseq->numParts());
 
-    frameRate = motion->frameRate();
-    double stepRatio2 = 2.0 / frameRate;
-    angleMargin = radian(angleMarginSpin.value());
-    translationMargin = translationMarginSpin.value();
-    velocityLimitRatio = velocityLimitRatioSpin.value() / 100.0;
+int FaultCheck::run(std::function<void(const string& message)> output_)
+{
+    output = output_;
+    numFaults = 0;
 
-    int beginningFrame = std::max(0, (int)(beginningTime * frameRate));
-    int endingFrame = std::min((motion->numFrames() - 1), (int)lround(endingTime * frameRate));
+    const int numFrames = endingFrame - beginningFrame + 1;
+    if(numFrames <= 0 || workspaces.empty()){
+        return numFaults;
+    }
 
-    lastPosFaultFrames.clear();
-    lastPosFaultFrames.resize(numJoints, std::numeric_limits<int>::min());
-    lastVelFaultFrames.clear();
-    lastVelFaultFrames.resize(numJoints, std::numeric_limits<int>::min());
+    const int concurrency = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    frameBlockSize = std::max(MinFrameBlockSize,
+                              std::min(MaxFrameBlockSize, numFrames / (concurrency * 4)));
+    numFrameBlocks = (numFrames + frameBlockSize - 1) / frameBlockSize;
+    nextFrameBlock = 0;
+    blockEvents.clear();
+    blockEvents.resize(numFrameBlocks);
+    blockCompletions.assign(numFrameBlocks, false);
+    numReportedBlocks = 0;
+
+    lastPosFaultFrames.assign(numJoints, std::numeric_limits<int>::min());
+    lastVelFaultFrames.assign(numJoints, std::numeric_limits<int>::min());
     lastCollisionFrames.clear();
 
-    if(checkCollision){
-        Link* root = body->rootLink();
-        root->p().setZero();
-        root->R().setIdentity();
+    /*
+      Each thread uses its own workspace and takes the blocks in order until all the blocks are taken.
+      The check may take a long time, so it is processed by the dedicated threads instead of the
+      TaskScheduler, whose tasks may be processed by any thread waiting for a parallel loop.
+    */
+    auto checkBlocks =
+        [this](CheckWorkspace* workspace){
+            while(!isCanceled){
+                const int block = nextFrameBlock++;
+                if(block >= numFrameBlocks){
+                    break;
+                }
+                checkFrameBlock(workspace, block);
+                reportCompletedBlocks(block);
+            }
+        };
+    
+    const int numThreads = std::min(static_cast<int>(workspaces.size()), numFrameBlocks);
+    if(numThreads > 1){
+        ThreadPool threadPool(numThreads - 1);
+        for(int i=1; i < numThreads; ++i){
+            auto workspace = workspaces[i].get();
+            threadPool.start([checkBlocks, workspace](){ checkBlocks(workspace); });
+        }
+        checkBlocks(workspaces[0].get());
+        threadPool.wait();
+    } else {
+        checkBlocks(workspaces[0].get());
     }
-        
-    for(int frame = beginningFrame; frame <= endingFrame; ++frame){
+
+    return numFaults;
+}
+
+
+void FaultCheck::checkFrameBlock(CheckWorkspace* workspace, int block)
+{
+    auto& events = blockEvents[block];
+    Body* body = workspace->body;
+    const int blockBeginningFrame = beginningFrame + block * frameBlockSize;
+    const int blockEndingFrame = std::min(endingFrame, blockBeginningFrame + frameBlockSize - 1);
+    const double stepRatio2 = 2.0 / frameRate;
+    workspace->hasLastCheckedPose = false;
+
+    for(int frame = blockBeginningFrame; frame <= blockEndingFrame; ++frame){
 
         int prevFrame = (frame == beginningFrame) ? beginningFrame : frame - 1;
         int nextFrame = (frame == endingFrame) ? endingFrame : frame + 1;
@@ -418,14 +644,14 @@ int KinematicFaultChecker::Impl::checkFaults
                         fault = (q > (joint->q_upper() - translationMargin) || q < (joint->q_lower() + translationMargin));
                     }
                     if(fault){
-                        putJointPositionFault(frame, joint);
+                        events.push_back(FaultEvent{ FaultEvent::PositionFault, frame, i, -1, q });
                     }
                 }
                 if(checkVelocity){
                     double dq = (qseq->at(nextFrame, i) - qseq->at(prevFrame, i)) / stepRatio2;
                     joint->dq() = dq;
                     if(dq > (joint->dq_upper() * velocityLimitRatio) || dq < (joint->dq_lower() * velocityLimitRatio)){
-                        putJointVelocityFault(frame, joint);
+                        events.push_back(FaultEvent{ FaultEvent::VelocityFault, frame, i, -1, dq });
                     }
                 }
             }
@@ -433,6 +659,14 @@ int KinematicFaultChecker::Impl::checkFaults
 
         if(checkCollision){
 
+            // The collisions of the last checked frame are reused if the pose is almost the same
+            if(workspace->hasLastCheckedPose && isPoseChangeWithinTolerance(workspace, frame)){
+                for(auto& pair : workspace->lastCollisions){
+                    events.push_back(FaultEvent{ FaultEvent::Collision, frame, pair[0], pair[1], 0.0 });
+                }
+                continue;
+            }
+
             Link* link = body->link(0);
             if(!pseq->empty())
             {
@@ -458,34 +692,125 @@ int KinematicFaultChecker::Impl::checkFaults
                 }
             }
 
-            bodyCollisionDetector.updatePositions();
+            auto& detector = workspace->collisionDetector;
+            detector.updatePositions();
 
-            bodyCollisionDetector.detectCollisions(
+            workspace->lastCollisions.clear();
+            detector.detectCollisions(
                 [&](const CollisionPair& collisionPair){
-                    putSelfCollision(body, frame, collisionPair);
+                    int index0 = static_cast<Link*>(collisionPair.object(0))->index();
+                    int index1 = static_cast<Link*>(collisionPair.object(1))->index();
+                    // The order of the links is kept for the message
+                    workspace->lastCollisions.push_back(IdPair<int>());
+                    auto& pair = workspace->lastCollisions.back();
+                    pair[0] = index0;
+                    pair[1] = index1;
+                    events.push_back(FaultEvent{ FaultEvent::Collision, frame, index0, index1, 0.0 });
                 });
+
+            storeCheckedPose(workspace, frame);
         }
     }
+}
+
 
-    if(!USE_DUPLICATED_BODY){
-        bodyItem->restoreKinematicState(orgKinematicState);
+bool FaultCheck::isPoseChangeWithinTolerance(CheckWorkspace* workspace, int frame)
+{
+    Body* body = workspace->body;
+    for(int i=0; i < numJoints; ++i){
+        const double tolerance = body->joint(i)->isSlideJoint() ? skipTranslationTolerance : skipAngleTolerance;
+        if(fabs(qseq->at(frame, i) - workspace->lastCheckedJointPositions[i]) > tolerance){
+            return false;
+        }
+    }
+    if(!pseq->empty()){
+        for(int i=0; i < numLinks; ++i){
+            const SE3& p = pseq->at(frame, i);
+            const SE3& last = workspace->lastCheckedLinkPositions[i];
+            if((p.translation() - last.translation()).norm() > skipTranslationTolerance){
+                return false;
+            }
+            if(p.rotation().angularDistance(last.rotation()) > skipAngleTolerance){
+                return false;
+            }
+        }
     }
+    return true;
+}
 
-    return numFaults;
+
+void FaultCheck::storeCheckedPose(CheckWorkspace* workspace, int frame)
+{
+    workspace->lastCheckedJointPositions.resize(numJoints);
+    for(int i=0; i < numJoints; ++i){
+        workspace->lastCheckedJointPositions[i] = qseq->at(frame, i);
+    }
+    if(!pseq->empty()){
+        workspace->lastCheckedLinkPositions.resize(numLinks);
+        for(int i=0; i < numLinks; ++i){
+            workspace->lastCheckedLinkPositions[i] = pseq->at(frame, i);
+        }
+    }
+    workspace->hasLastCheckedPose = true;
 }
 
 
-void KinematicFaultChecker::Impl::putJointPositionFault(int frame, Link* joint)
+/**
+   The events of the completed blocks that follow the reported blocks are converted into the
+   messages. A fault that continues from the previous frame is not reported again.
+*/
+void FaultCheck::reportCompletedBlocks(int block)
+{
+    std::lock_guard<std::mutex> lock(reportMutex);
+
+    blockCompletions[block] = true;
+    if(block != numReportedBlocks){
+        return;
+    }
+
+    ostringstream os;
+    while(numReportedBlocks < numFrameBlocks && blockCompletions[numReportedBlocks]){
+        auto& events = blockEvents[numReportedBlocks];
+        for(auto& event : events){
+            switch(event.type){
+            case FaultEvent::PositionFault:
+                putJointPositionFault(os, event);
+                break;
+            case FaultEvent::VelocityFault:
+                putJointVelocityFault(os, event);
+                break;
+            case FaultEvent::Collision:
+                putSelfCollision(os, event);
+                break;
+            }
+        }
+        vector<FaultEvent>().swap(events);
+        ++numReportedBlocks;
+    }
+
+    auto messages = os.str();
+    if(!messages.empty()){
+        output(messages);
+    }
+}
+
+
+void FaultCheck::putJointPositionFault(std::ostream& os, const FaultEvent& event)
 {
-    if(frame > lastPosFaultFrames[joint->jointId()] + 1){
+    const int frame = event.frame;
+    const int jointId = event.id0;
+    
+    if(frame > lastPosFaultFrames[jointId] + 1){
+        // The limits and the name are only read from the body, which is not modified by the check
+        Link* joint = workspaces.front()->body->joint(jointId);
         double q, l, u, m;
         if(joint->isRotationalJoint()){
-            q = degree(joint->q());
+            q = degree(event.value);
             l = degree(joint->q_lower());
             u = degree(joint->q_upper());
             m = degree(angleMargin);
         } else {
-            q = joint->q();
+            q = event.value;
             l = joint->q_lower();
             u = joint->q_upper();
             m = translationMargin;
@@ -493,28 +818,32 @@ void KinematicFaultChecker::Impl::putJointPositionFault(int frame, Link* joint)
 
         if(m != 0.0){
             os << format(_("{0:7.3f} [s]: Position limit over of {1} ({2} is beyond the range ({3} , {4}) with margin {5}.)"),
-                         (frame / frameRate), joint->name(), q, l, u, m) << endl;
+                         (frame / frameRate), joint->name(), q, l, u, m) << "\n";
         } else {
             os << format(_("{0:7.3f} [s]: Position limit over of {1} ({2} is beyond the range ({3} , {4}).)"),
-                         (frame / frameRate), joint->name(), q, l, u) << endl;
+                         (frame / frameRate), joint->name(), q, l, u) << "\n";
         }
 
         numFaults++;
     }
-    lastPosFaultFrames[joint->jointId()] = frame;
+    lastPosFaultFrames[jointId] = frame;
 }
 
 
-void KinematicFaultChecker::Impl::putJointVelocityFault(int frame, Link* joint)
+void FaultCheck::putJointVelocityFault(std::ostream& os, const FaultEvent& event)
 {
-    if(frame > lastVelFaultFrames[joint->jointId()] + 1){
+    const int frame = event.frame;
+    const int jointId = event.id0;
+    
+    if(frame > lastVelFaultFrames[jointId] + 1){
+        Link* joint = workspaces.front()->body->joint(jointId);
         double dq, l, u;
         if(joint->isRotationalJoint()){
-            dq = degree(joint->dq());
+            dq = degree(event.value);
             l = degree(joint->dq_lower());
             u = degree(joint->dq_upper());
         } else {
-            dq = joint->dq();
+            dq = event.value;
             l = joint->dq_lower();
             u = joint->dq_upper();
         }
@@ -523,22 +852,23 @@ void KinematicFaultChecker::Impl::putJointVelocityFault(int frame, Link* joint)
         r *= 100.0;
 
         os << format(_("{0:7.3f} [s]: Velocity limit over of {1} ({2} is {3:.0f}% of the range ({4} , {5}).)"),
-                     (frame / frameRate), joint->name(), dq, r, l, u) << endl;
+                     (frame / frameRate), joint->name(), dq, r, l, u) << "\n";
         
         numFaults++;
     }
-    lastVelFaultFrames[joint->jointId()] = frame;
+    lastVelFaultFrames[jointId] = frame;
 }
 
 
-void KinematicFaultChecker::Impl::putSelfCollision(Body* body, int frame, const CollisionPair& collisionPair)
+void FaultCheck::putSelfCollision(std::ostream& os, const FaultEvent& event)
 {
+    const int frame = event.frame;
     bool putMessage = false;
-    GeometryPair gPair(collisionPair.geometries());
-    auto p = lastCollisionFrames.find(gPair);
+    IdPair<int> linkPair(event.id0, event.id1);
+    auto p = lastCollisionFrames.find(linkPair);
     if(p == lastCollisionFrames.end()){
         putMessage = true;
-        lastCollisionFrames[gPair] = frame;
+        lastCollisionFrames[linkPair] = frame;
     } else {
         if(frame > p->second + 1){
             putMessage = true;
@@ -547,10 +877,9 @@ void KinematicFaultChecker::Impl::putSelfCollision(Body* body, int frame, const
     }
 
     if(putMessage){
-        Link* link0 = static_cast<Link*>(collisionPair.object(0));
-        Link* link1 = static_cast<Link*>(collisionPair.object(1));
+        auto body = workspaces.front()->body;
         os << format(_("{0:7.3f} [s]: Collision between {1} and {2}"),
-                     (frame / frameRate), link0->name(), link1->name()) << endl;
+                     (frame / frameRate), body->link(event.id0)->name(), body->link(event.id1)->name()) << "\n";
         numFaults++;
     }
 }
@@ -6,7 +6,10 @@
 #include <cnoid/HolderDevice>
 #include <cnoid/AttachmentDevice>
 #include <cnoid/IoConnectionMap>
+#include <cnoid/MultiBodyForwardKinematics>
 #include <cnoid/ItemManager>
+#include <cnoid/PutPropertyFunction>
+#include <cnoid/Archive>
 #include <fmt/format.h>
 #include "gettext.h"
 
@@ -56,10 +59,15 @@ public:
     vector<HolderInfoPtr> holders;
     vector<HolderInfoPtr> activeHolders;
     vector<IoConnectionMapPtr> ioConnectionMaps;
+    MultiBodyForwardKinematics multiBodyFK;
+    // True if the link positions are not written to some links after the last calculation
+    bool hasPendingLinkPositions;
+    int numThreadsForKinematics;
 
     Impl(KinematicSimulatorItem* self);
     Impl(KinematicSimulatorItem* self, const Impl& org);
     bool initializeSimulation(const std::vector<SimulationBody*>& simBodies);
+    void calcForwardKinematics(const std::vector<SimulationBody*>& activeSimBodies);
     void onHolderStateChanged(HolderInfo* info);
     void activateHolder(HolderInfo* info);
     vector<Body*> findAttachableBodies(HolderDevice* holder, const Isometry3& T_holder);
@@ -90,7 +98,8 @@ KinematicSimulatorItem::KinematicSimulatorItem()
 KinematicSimulatorItem::Impl::Impl(KinematicSimulatorItem* self)
     : self(self)
 {
-
+    hasPendingLinkPositions = false;
+    numThreadsForKinematics = 1;
 }
 
 
@@ -104,7 +113,8 @@ KinematicSimulatorItem::KinematicSimulatorItem(const KinematicSimulatorItem& org
 KinematicSimulatorItem::Impl::Impl(KinematicSimulatorItem* self, const Impl& org)
     : self(self)
 {
-
+    hasPendingLinkPositions = false;
+    numThreadsForKinematics = org.numThreadsForKinematics;
 }
 
 
@@ -120,11 +130,18 @@ Item* KinematicSimulatorItem::doDuplicate() const
 }
 
 
+void KinematicSimulatorItem::setNumThreadsForKinematics(int n)
+{
+    impl->numThreadsForKinematics = n;
+}
+
+
 void KinematicSimulatorItem::clearSimulation()
 {
     impl->holders.clear();    
     impl->activeHolders.clear();    
     impl->ioConnectionMaps.clear();
+    impl->multiBodyFK.clearBodies();
 }
 
 
@@ -155,10 +172,26 @@ bool KinematicSimulatorItem::Impl::initializeSimulation(const std::vector<Simula
     for(auto& item : self->worldItem()->descendantItems<IoConnectionMapItem>()){
         item->updateIoDeviceInstances();
         auto connectionMap = self->cloneMap().getClone(item->connectionMap());
-        connectionMap->establishConnections();
+        // The signals are propagated in a bulk pass at each step instead of the device signals
+        connectionMap->compileRoutingTable();
         ioConnectionMaps.push_back(connectionMap);
     }
     
+    /*
+      The link positions are written to the links of the bodies with the devices such as
+      the sensors and the holders, and to the links of all the bodies in the all link position
+      output mode. The links of the other bodies only have the root link position and
+      the joint displacements during the simulation, which are enough to record the motion.
+    */
+    multiBodyFK.clearBodies();
+    hasPendingLinkPositions = false;
+    multiBodyFK.setNumThreads(numThreadsForKinematics > 1 ? numThreadsForKinematics : 0);
+    bool isAllLinkPositionOutputMode = self->isAllLinkPositionOutputMode();
+    for(auto& simBody : simBodies){
+        auto body = simBody->body();
+        multiBodyFK.addBody(body, isAllLinkPositionOutputMode || !body->devices().empty());
+    }
+    
     for(auto& simBody : simBodies){
         for(auto& holder : simBody->body()->devices<HolderDevice>()){
             auto info = new HolderInfo(holder);
@@ -177,6 +210,10 @@ bool KinematicSimulatorItem::Impl::initializeSimulation(const std::vector<Simula
 
 bool KinematicSimulatorItem::stepSimulation(const std::vector<SimulationBody*>& activeSimBodies)
 {
+    for(auto& connectionMap : impl->ioConnectionMaps){
+        connectionMap->updateSignals();
+    }
+
     for(size_t i=0; i < activeSimBodies.size(); ++i){
         SimulationBody* simBody = activeSimBodies[i];
         auto body = simBody->body();
@@ -185,8 +222,8 @@ bool KinematicSimulatorItem::stepSimulation(const std::vector<SimulationBody*>&
                 link->q() = link->q_target();
             }
         }
-        body->calcForwardKinematics();
     }
+    impl->calcForwardKinematics(activeSimBodies);
 
     for(auto& info : impl->activeHolders){
         auto& holder = info->holder;
@@ -209,6 +246,24 @@ bool KinematicSimulatorItem::stepSimulation(const std::vector<SimulationBody*>&
 }
 
 
+void KinematicSimulatorItem::Impl::calcForwardKinematics(const std::vector<SimulationBody*>& activeSimBodies)
+{
+    // The bodies are calculated in the packed arrays when all of them are active
+    if(static_cast<int>(activeSimBodies.size()) == multiBodyFK.numBodies()){
+        multiBodyFK.calcForwardKinematics();
+        hasPendingLinkPositions = true;
+    } else {
+        if(hasPendingLinkPositions){
+            multiBodyFK.writeAllLinkPositions();
+            hasPendingLinkPositions = false;
+        }
+        for(auto& simBody : activeSimBodies){
+            simBody->body()->calcForwardKinematics();
+        }
+    }
+}
+
+
 void KinematicSimulatorItem::Impl::onHolderStateChanged(HolderInfo* info)
 {
     if(info->holder->on()){
@@ -331,25 +386,34 @@ void KinematicSimulatorItem::Impl::deactivateHolder(HolderInfo* info)
 
 void KinematicSimulatorItem::finalizeSimulation()
 {
-
+    if(impl->hasPendingLinkPositions){
+        impl->multiBodyFK.writeAllLinkPositions();
+        impl->hasPendingLinkPositions = false;
+    }
 }
     
 
 void KinematicSimulatorItem::doPutProperties(PutPropertyFunction& putProperty)
 {
     SimulatorItem::doPutProperties(putProperty);
+    putProperty.min(1)(_("Kinematics threads"), impl->numThreadsForKinematics,
+                       changeProperty(impl->numThreadsForKinematics));
 }
 
 
 bool KinematicSimulatorItem::store(Archive& archive)
 {
-    return SimulatorItem::store(archive);
+    SimulatorItem::store(archive);
+    archive.write("numThreadsForKinematics", impl->numThreadsForKinematics);
+    return true;
 }
 
 
 bool KinematicSimulatorItem::restore(const Archive& archive)
 {
-    return SimulatorItem::restore(archive);
+    SimulatorItem::restore(archive);
+    archive.read("numThreadsForKinematics", impl->numThreadsForKinematics);
+    return true;
 }
 
 
@@ -16,6 +16,12 @@ public:
     virtual ~KinematicSimulatorItem();
     virtual Item* doDuplicate() const override;
 
+    /**
+       The forward kinematics of the bodies is calculated by MultiBodyForwardKinematics
+       with the given number of threads.
+    */
+    void setNumThreadsForKinematics(int n);
+
 protected:
     virtual void clearSimulation() override;
     virtual SimulationBody* createSimulationBody(Body* orgBody, CloneMap& cloneMap) override;
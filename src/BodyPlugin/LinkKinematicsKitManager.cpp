@@ -188,7 +188,7 @@ LinkKinematicsKit* LinkKinematicsKitManager::Impl::findKinematicsKit(Link* targe
         if(!kit && (baseLinkIndex != PresetBaseLink)){
             kit = new LinkKinematicsKit(targetLink);
             if(baseLinkIndex != UnspecifiedBaseLinkForPinDragIK){
-                kit->setInverseKinematics(JointPath::getCustomPath(body, baseLink, targetLink));
+                kit->setInverseKinematics(JointPath::getCachedCustomPath(body, baseLink, targetLink));
             }
             needToRegistration = true;
         }
@@ -220,7 +220,7 @@ std::shared_ptr<InverseKinematics> LinkKinematicsKitManager::Impl::findPresetIK(
             Link* baseLink = body->link(setup[0].toString());
             if(baseLink){
                 if(setup.size() == 1){
-                    ik = JointPath::getCustomPath(body, baseLink, targetLink);
+                    ik = JointPath::getCachedCustomPath(body, baseLink, targetLink);
                 } else {
                     auto compositeIK = make_shared<CompositeIK>(body, targetLink);
                     ik = compositeIK;
@@ -245,7 +245,7 @@ std::shared_ptr<InverseKinematics> LinkKinematicsKitManager::Impl::findPresetIK(
             auto link = targetLink->parent();
             while(link){
                 if(++dof >= 6){
-                    ik = JointPath::getCustomPath(body, body->rootLink(), targetLink);
+                    ik = JointPath::getCachedCustomPath(body, body->rootLink(), targetLink);
                     break;
                 }
                 link = link->parent();
@@ -0,0 +1,626 @@
+#include "RayCastRangeSensorSimulatorItem.h"
+#include "SimulatorItem.h"
+#include <cnoid/ItemManager>
+#include <cnoid/MessageView>
+#include <cnoid/Selection>
+#include <cnoid/PutPropertyFunction>
+#include <cnoid/Archive>
+#include <cnoid/ValueTreeUtil>
+#include <cnoid/Body>
+#include <cnoid/RangeSensor>
+#include <cnoid/AISTCollisionDetector>
+#include <cnoid/StringUtil>
+#include <cnoid/Tokenizer>
+#include <cnoid/EigenUtil>
+#include <fmt/format.h>
+#include <set>
+#include <limits>
+#include "gettext.h"
+
+using namespace std;
+using namespace cnoid;
+using fmt::format;
+
+namespace {
+
+typedef CollisionDetectorRayCastAPI::RayQuery RayQuery;
+
+string getNameListString(const vector<string>& names)
+{
+    string nameList;
+    for(size_t i=0; i < names.size(); ++i){
+        if(i > 0){
+            nameList += ", ";
+        }
+        nameList += names[i];
+    }
+    return nameList;
+}
+
+bool updateNames(const string& nameListString, string& out_newNameListString, vector<string>& out_names)
+{
+    out_names.clear();
+    for(auto& token : Tokenizer<CharSeparator<char>>(nameListString, CharSeparator<char>(","))){
+        auto name = trimmed(token);
+        if(!name.empty()){
+            out_names.push_back(name);
+        }
+    }
+    out_newNameListString = nameListString;
+    return true;
+}
+
+class SensorInfo : public Referenced
+{
+public:
+    RangeSensor* sensor;
+    SimulationBody* simBody;
+    int numYawSamples;
+    int numPitchSamples;
+    /**
+       The directions of the rays in the sensor coordinate. The rays of a beam are consecutive,
+       and the center ray is followed by the rays on the edge of the beam footprint.
+    */
+    vector<Vector3> directions;
+    int numRaysPerBeam;
+    double cycleTime;
+    double elapsedTime;
+    bool wasOn;
+    int queryIndexTop;
+
+    // The yaw columns of the beams which are cast in the current step
+    int columnToStartScan;
+    int columnToEndScan;
+    bool isScanning;
+    std::shared_ptr<RangeSensor::RangeData> rangeData;
+
+    SensorInfo(RangeSensor* sensor, SimulationBody* simBody, double beamDivergence);
+};
+
+typedef ref_ptr<SensorInfo> SensorInfoPtr;
+
+struct GeometryInfo
+{
+    Link* link;
+    CollisionDetector::GeometryHandle handle;
+};
+
+}
+
+namespace cnoid {
+
+class RayCastRangeSensorSimulatorItem::Impl
+{
+public:
+    RayCastRangeSensorSimulatorItem* self;
+    ostream& os;
+    SimulatorItem* simulatorItem;
+    double worldTimeStep;
+    vector<string> bodyNames;
+    string bodyNameListString;
+    vector<string> sensorNames;
+    string sensorNameListString;
+    bool isVisionDataRecordingEnabled;
+    int numThreads;
+    bool isMotionDistortionEnabled;
+    double beamDivergence;
+    Selection returnMode;
+
+    CollisionDetectorPtr collisionDetector;
+    CollisionDetectorRayCastAPI* rayCastAPI;
+    vector<GeometryInfo> movableGeometries;
+    vector<SensorInfoPtr> sensorInfos;
+    vector<SensorInfo*> sensorsToScan;
+    vector<RayQuery> queries;
+
+    Impl(RayCastRangeSensorSimulatorItem* self);
+    Impl(RayCastRangeSensorSimulatorItem* self, const Impl& org);
+    bool initializeSimulation(SimulatorItem* simulatorItem);
+    bool initializeCollisionDetector(const vector<SimulationBody*>& simBodies);
+    void onPostDynamics();
+    void scan();
+    void storeRangeData(SensorInfo* info);
+    void finalizeSimulation();
+    void doPutProperties(PutPropertyFunction& putProperty);
+    bool store(Archive& archive);
+    bool restore(const Archive& archive);
+};
+
+}
+
+
+void RayCastRangeSensorSimulatorItem::initializeClass(ExtensionManager* ext)
+{
+    ext->itemManager()
+        .registerClass<RayCastRangeSensorSimulatorItem, SubSimulatorItem>(N_("RayCastRangeSensorSimulatorItem"))
+        .addCreationPanel<RayCastRangeSensorSimulatorItem>();
+}
+
+
+RayCastRangeSensorSimulatorItem::RayCastRangeSensorSimulatorItem()
+{
+    impl = new Impl(this);
+    setName("RayCastRangeSensorSimulator");
+}
+
+
+RayCastRangeSensorSimulatorItem::Impl::Impl(RayCastRangeSensorSimulatorItem* self)
+    : self(self),
+      os(MessageView::instance()->cout()),
+      returnMode(RayCastRangeSensorSimulatorItem::N_RETURN_MODES, CNOID_GETTEXT_DOMAIN_NAME)
+{
+    simulatorItem = nullptr;
+    isVisionDataRecordingEnabled = false;
+    numThreads = 0;
+    isMotionDistortionEnabled = false;
+    beamDivergence = 0.0;
+    returnMode.setSymbol(RayCastRangeSensorSimulatorItem::FIRST_RETURN, N_("First"));
+    returnMode.setSymbol(RayCastRangeSensorSimulatorItem::LAST_RETURN, N_("Last"));
+    returnMode.select(RayCastRangeSensorSimulatorItem::FIRST_RETURN);
+}
+
+
+RayCastRangeSensorSimulatorItem::RayCastRangeSensorSimulatorItem(const RayCastRangeSensorSimulatorItem& org)
+    : SubSimulatorItem(org)
+{
+    impl = new Impl(this, *org.impl);
+}
+
+
+RayCastRangeSensorSimulatorItem::Impl::Impl(RayCastRangeSensorSimulatorItem* self, const Impl& org)
+    : self(self),
+      os(MessageView::instance()->cout()),
+      bodyNames(org.bodyNames),
+      sensorNames(org.sensorNames),
+      returnMode(org.returnMode)
+{
+    simulatorItem = nullptr;
+    bodyNameListString = getNameListString(bodyNames);
+    sensorNameListString = getNameListString(sensorNames);
+    isVisionDataRecordingEnabled = org.isVisionDataRecordingEnabled;
+    numThreads = org.numThreads;
+    isMotionDistortionEnabled = org.isMotionDistortionEnabled;
+    beamDivergence = org.beamDivergence;
+}
+
+
+RayCastRangeSensorSimulatorItem::~RayCastRangeSensorSimulatorItem()
+{
+    delete impl;
+}
+
+
+Item* RayCastRangeSensorSimulatorItem::doDuplicate() const
+{
+    return new RayCastRangeSensorSimulatorItem(*this);
+}
+
+
+void RayCastRangeSensorSimulatorItem::setTargetBodies(const std::string& bodyNames)
+{
+    updateNames(bodyNames, impl->bodyNameListString, impl->bodyNames);
+    notifyUpdate();
+}
+
+
+void RayCastRangeSensorSimulatorItem::setTargetSensors(const std::string& sensorNames)
+{
+    updateNames(sensorNames, impl->sensorNameListString, impl->sensorNames);
+    notifyUpdate();
+}
+
+
+void RayCastRangeSensorSimulatorItem::setVisionDataRecordingEnabled(bool on)
+{
+    if(on != impl->isVisionDataRecordingEnabled){
+        impl->isVisionDataRecordingEnabled = on;
+        notifyUpdate();
+    }
+}
+
+
+void RayCastRangeSensorSimulatorItem::setNumThreads(int n)
+{
+    if(n != impl->numThreads){
+        impl->numThreads = n;
+        notifyUpdate();
+    }
+}
+
+
+void RayCastRangeSensorSimulatorItem::setMotionDistortionEnabled(bool on)
+{
+    if(on != impl->isMotionDistortionEnabled){
+        impl->isMotionDistortionEnabled = on;
+        notifyUpdate();
+    }
+}
+
+
+void RayCastRangeSensorSimulatorItem::setBeamDivergence(double angle)
+{
+    if(angle != impl->beamDivergence){
+        impl->beamDivergence = angle;
+        notifyUpdate();
+    }
+}
+
+
+void RayCastRangeSensorSimulatorItem::setReturnMode(int mode)
+{
+    if(mode != impl->returnMode.which()){
+        impl->returnMode.select(mode);
+        notifyUpdate();
+    }
+}
+
+
+/**
+   \param beamDivergence The full angle of the beam cone. Each beam is cast as a single ray if this is zero.
+*/
+SensorInfo::SensorInfo(RangeSensor* sensor, SimulationBody* simBody, double beamDivergence)
+    : sensor(sensor),
+      simBody(simBody)
+{
+    // The same beam pattern as the one of GLVisionSimulatorItem
+    const double yawRange = sensor->yawRange();
+    const double yawStep = sensor->yawStep();
+    numYawSamples = sensor->numYawSamples();
+    const double pitchRange = sensor->pitchRange();
+    const double pitchStep = sensor->pitchStep();
+    numPitchSamples = sensor->numPitchSamples();
+
+    // The four rays on the edge of the footprint detect the other surfaces partially hit by the beam
+    numRaysPerBeam = (beamDivergence > 0.0) ? 5 : 1;
+    const double edgeOffset = tan(beamDivergence / 2.0);
+
+    directions.reserve(numYawSamples * numPitchSamples * numRaysPerBeam);
+    for(int pitch=0; pitch < numPitchSamples; ++pitch){
+        const double pitchAngle = pitch * pitchStep - pitchRange / 2.0;
+        const double cosPitchAngle = cos(pitchAngle);
+        for(int yaw=0; yaw < numYawSamples; ++yaw){
+            const double yawAngle = yaw * yawStep - yawRange / 2.0;
+            Vector3 d(-cosPitchAngle * sin(yawAngle), sin(pitchAngle), -cosPitchAngle * cos(yawAngle));
+            directions.push_back(d);
+            if(numRaysPerBeam > 1){
+                Vector3 u(cos(yawAngle), 0.0, -sin(yawAngle));
+                Vector3 v = d.cross(u);
+                directions.push_back((d + edgeOffset * u).normalized());
+                directions.push_back((d - edgeOffset * u).normalized());
+                directions.push_back((d + edgeOffset * v).normalized());
+                directions.push_back((d - edgeOffset * v).normalized());
+            }
+        }
+    }
+
+    double frameRate = sensor->frameRate();
+    cycleTime = (frameRate > 0.0) ? (1.0 / frameRate) : 0.0;
+    elapsedTime = 0.0;
+    wasOn = false;
+    queryIndexTop = 0;
+    columnToStartScan = 0;
+    columnToEndScan = 0;
+    isScanning = false;
+}
+
+
+bool RayCastRangeSensorSimulatorItem::initializeSimulation(SimulatorItem* simulatorItem)
+{
+    return impl->initializeSimulation(simulatorItem);
+}
+
+
+bool RayCastRangeSensorSimulatorItem::Impl::initializeSimulation(SimulatorItem* simulatorItem)
+{
+    this->simulatorItem = simulatorItem;
+    worldTimeStep = simulatorItem->worldTimeStep();
+    sensorInfos.clear();
+
+    std::set<string> bodyNameSet(bodyNames.begin(), bodyNames.end());
+    std::set<string> sensorNameSet(sensorNames.begin(), sensorNames.end());
+
+    auto& simBodies = simulatorItem->simulationBodies();
+    for(auto& simBody : simBodies){
+        Body* body = simBody->body();
+        if(bodyNameSet.empty() || bodyNameSet.find(body->name()) != bodyNameSet.end()){
+            for(int i=0; i < body->numDevices(); ++i){
+                if(auto sensor = dynamic_cast<RangeSensor*>(body->device(i))){
+                    if(sensorNameSet.empty() || sensorNameSet.find(sensor->name()) != sensorNameSet.end()){
+                        os << format(_("{0} detected range sensor \"{1}\" of {2} as a target.\n"),
+                                     self->displayName(), sensor->name(), body->name());
+                        sensorInfos.push_back(new SensorInfo(sensor, simBody, beamDivergence));
+                    }
+                }
+            }
+        }
+    }
+
+    if(sensorInfos.empty()){
+        os << format(_("{} has no target sensors"), self->displayName()) << endl;
+        return false;
+    }
+
+    if(!initializeCollisionDetector(simBodies)){
+        os << format(_("{} cannot initialize the collision detector for the ray casting."),
+                     self->displayName()) << endl;
+        return false;
+    }
+
+    simulatorItem->addPostDynamicsFunction([&](){ onPostDynamics(); });
+
+    return true;
+}
+
+
+/**
+   A new detector of the same type as the one of the simulator is used so that the geometries
+   of the simulator's detector are not affected. AISTCollisionDetector is used if the type does
+   not support the ray casting.
+*/
+bool RayCastRangeSensorSimulatorItem::Impl::initializeCollisionDetector(const vector<SimulationBody*>& simBodies)
+{
+    collisionDetector = simulatorItem->getOrCreateCollisionDetector()->clone();
+    rayCastAPI = dynamic_cast<CollisionDetectorRayCastAPI*>(collisionDetector.get());
+    if(!rayCastAPI){
+        collisionDetector = new AISTCollisionDetector;
+        rayCastAPI = dynamic_cast<CollisionDetectorRayCastAPI*>(collisionDetector.get());
+    }
+    if(auto aistCollisionDetector = dynamic_cast<AISTCollisionDetector*>(collisionDetector.get())){
+        aistCollisionDetector->setNumThreads(numThreads);
+    }
+
+    movableGeometries.clear();
+    for(auto& simBody : simBodies){
+        Body* body = simBody->body();
+        for(auto& link : body->links()){
+            if(auto handle = collisionDetector->addGeometry(link->collisionShape())){
+                collisionDetector->setCustomObject(*handle, link);
+                collisionDetector->updatePosition(*handle, link->T());
+                if(body->isStaticModel()){
+                    collisionDetector->setGeometryStatic(*handle);
+                } else {
+                    movableGeometries.push_back({ link, *handle });
+                }
+            }
+        }
+    }
+
+    return collisionDetector->makeReady();
+}
+
+
+/**
+   In the motion distortion mode, the yaw columns of the beams are cast in turn at the times
+   evenly distributed in the cycle as the rotating head of a real LiDAR does, so the motions of
+   the sensor and the objects during the scan are reflected in the range data. The data is
+   output when the last column is cast.
+*/
+void RayCastRangeSensorSimulatorItem::Impl::onPostDynamics()
+{
+    sensorsToScan.clear();
+
+    for(auto& info : sensorInfos){
+        auto sensor = info->sensor;
+        bool isOn = sensor->on();
+        if(isOn){
+            if(!info->wasOn){
+                info->elapsedTime = info->cycleTime;
+                info->isScanning = false;
+            }
+            if(!isMotionDistortionEnabled){
+                if(info->elapsedTime >= info->cycleTime){
+                    info->columnToStartScan = 0;
+                    info->columnToEndScan = info->numYawSamples;
+                    sensorsToScan.push_back(info);
+                    info->elapsedTime -= info->cycleTime;
+                }
+            } else {
+                if(!info->isScanning && info->elapsedTime >= info->cycleTime){
+                    info->isScanning = true;
+                    info->columnToEndScan = 0;
+                    info->elapsedTime -= info->cycleTime;
+                }
+                if(info->isScanning){
+                    int numScannedColumns = 1;
+                    if(info->cycleTime > 0.0){
+                        numScannedColumns += info->elapsedTime / info->cycleTime * info->numYawSamples;
+                    }
+                    info->columnToStartScan = info->columnToEndScan;
+                    info->columnToEndScan = std::min(numScannedColumns, info->numYawSamples);
+                    if(info->columnToEndScan > info->columnToStartScan){
+                        sensorsToScan.push_back(info);
+                    }
+                }
+            }
+            info->elapsedTime += worldTimeStep;
+        } else if(info->wasOn){
+            sensor->clearRangeData();
+            if(isVisionDataRecordingEnabled){
+                sensor->notifyStateChange();
+            } else {
+                info->simBody->notifyUnrecordedDeviceStateChange(sensor);
+            }
+        }
+        info->wasOn = isOn;
+    }
+
+    if(!sensorsToScan.empty()){
+        scan();
+    }
+}
+
+
+/**
+   The rays of all the sensors scanning at the current time are cast together so that
+   they are processed in parallel.
+*/
+void RayCastRangeSensorSimulatorItem::Impl::scan()
+{
+    for(auto& geometry : movableGeometries){
+        collisionDetector->updatePosition(geometry.handle, geometry.link->T());
+    }
+
+    queries.clear();
+    for(auto& info : sensorsToScan){
+        auto sensor = info->sensor;
+        const Isometry3 T = sensor->link()->T() * sensor->T_local();
+        const Vector3 p = T.translation();
+        const double minDistance = sensor->minDistance();
+        const double maxDistance = sensor->maxDistance() - minDistance;
+        const int n = info->numRaysPerBeam;
+        info->queryIndexTop = queries.size();
+        for(int pitch=0; pitch < info->numPitchSamples; ++pitch){
+            auto direction = info->directions.begin() + (pitch * info->numYawSamples + info->columnToStartScan) * n;
+            const int numRays = (info->columnToEndScan - info->columnToStartScan) * n;
+            for(int i=0; i < numRays; ++i){
+                Vector3 d = T.linear() * (*direction++);
+                // The ray starts from the minimum distance
+                queries.emplace_back(p + minDistance * d, d, maxDistance);
+            }
+        }
+    }
+
+    rayCastAPI->castRays(queries);
+
+    for(auto& info : sensorsToScan){
+        storeRangeData(info);
+    }
+}
+
+
+/**
+   The range of a beam cast as multiple rays is the closest or farthest distance of the surfaces
+   hit by the rays depending on the return mode.
+*/
+void RayCastRangeSensorSimulatorItem::Impl::storeRangeData(SensorInfo* info)
+{
+    auto sensor = info->sensor;
+    if(info->columnToStartScan == 0){
+        info->rangeData = std::make_shared<RangeSensor::RangeData>(info->numYawSamples * info->numPitchSamples);
+    }
+    const double minDistance = sensor->minDistance();
+    const bool isLastReturn = (returnMode.which() == RayCastRangeSensorSimulatorItem::LAST_RETURN);
+    const int n = info->numRaysPerBeam;
+    auto query = queries.begin() + info->queryIndexTop;
+    auto& rangeData = *info->rangeData;
+
+    for(int pitch=0; pitch < info->numPitchSamples; ++pitch){
+        for(int yaw = info->columnToStartScan; yaw < info->columnToEndScan; ++yaw){
+            double distance = query->distance;
+            for(int i=1; i < n; ++i){
+                double d = query[i].distance;
+                if(isLastReturn){
+                    if(d != std::numeric_limits<double>::infinity() &&
+                       (d > distance || distance == std::numeric_limits<double>::infinity())){
+                        distance = d;
+                    }
+                } else if(d < distance){
+                    distance = d;
+                }
+            }
+            rangeData[pitch * info->numYawSamples + yaw] = distance + minDistance;
+            query += n;
+        }
+    }
+
+    if(info->columnToEndScan < info->numYawSamples){
+        return;
+    }
+
+    sensor->setRangeData(info->rangeData);
+    // The data is delayed from the time when the first column is cast in the motion distortion mode
+    sensor->setDelay(isMotionDistortionEnabled ? info->elapsedTime - worldTimeStep : 0.0);
+    info->isScanning = false;
+    if(isVisionDataRecordingEnabled){
+        sensor->notifyStateChange();
+    } else {
+        info->simBody->notifyUnrecordedDeviceStateChange(sensor);
+    }
+}
+
+
+void RayCastRangeSensorSimulatorItem::finalizeSimulation()
+{
+    impl->finalizeSimulation();
+}
+
+
+void RayCastRangeSensorSimulatorItem::Impl::finalizeSimulation()
+{
+    sensorInfos.clear();
+    sensorsToScan.clear();
+    movableGeometries.clear();
+    queries.clear();
+    collisionDetector.reset();
+    rayCastAPI = nullptr;
+}
+
+
+void RayCastRangeSensorSimulatorItem::doPutProperties(PutPropertyFunction& putProperty)
+{
+    SubSimulatorItem::doPutProperties(putProperty);
+    impl->doPutProperties(putProperty);
+}
+
+
+void RayCastRangeSensorSimulatorItem::Impl::doPutProperties(PutPropertyFunction& putProperty)
+{
+    putProperty(_("Target bodies"), bodyNameListString,
+                [&](const string& names){ return updateNames(names, bodyNameListString, bodyNames); });
+    putProperty(_("Target sensors"), sensorNameListString,
+                [&](const string& names){ return updateNames(names, sensorNameListString, sensorNames); });
+    putProperty(_("Record vision data"), isVisionDataRecordingEnabled, changeProperty(isVisionDataRecordingEnabled));
+    putProperty.min(0)(_("Number of threads"), numThreads, changeProperty(numThreads));
+    putProperty(_("Motion distortion"), isMotionDistortionEnabled, changeProperty(isMotionDistortionEnabled));
+    putProperty.min(0.0).max(10.0).decimals(3)(_("Beam divergence"), degree(beamDivergence),
+                [&](double angle){ beamDivergence = radian(angle); return true; });
+    putProperty.reset()(_("Return mode"), returnMode, [&](int index){ return returnMode.select(index); });
+}
+
+
+bool RayCastRangeSensorSimulatorItem::store(Archive& archive)
+{
+    SubSimulatorItem::store(archive);
+    return impl->store(archive);
+}
+
+
+bool RayCastRangeSensorSimulatorItem::Impl::store(Archive& archive)
+{
+    writeElements(archive, "target_bodies", bodyNames, true);
+    writeElements(archive, "target_sensors", sensorNames, true);
+    archive.write("record_vision_data", isVisionDataRecordingEnabled);
+    archive.write("num_threads", numThreads);
+    archive.write("motion_distortion", isMotionDistortionEnabled);
+    archive.write("beam_divergence", degree(beamDivergence));
+    archive.write("return_mode", returnMode.selectedSymbol());
+    return true;
+}
+
+
+bool RayCastRangeSensorSimulatorItem::restore(const Archive& archive)
+{
+    SubSimulatorItem::restore(archive);
+    return impl->restore(archive);
+}
+
+
+bool RayCastRangeSensorSimulatorItem::Impl::restore(const Archive& archive)
+{
+    readElements(archive, "target_bodies", bodyNames);
+    bodyNameListString = getNameListString(bodyNames);
+    readElements(archive, "target_sensors", sensorNames);
+    sensorNameListString = getNameListString(sensorNames);
+    archive.read("record_vision_data", isVisionDataRecordingEnabled);
+    archive.read("num_threads", numThreads);
+    archive.read("motion_distortion", isMotionDistortionEnabled);
+    double angle;
+    if(archive.read("beam_divergence", angle)){
+        beamDivergence = radian(angle);
+    }
+    string symbol;
+    if(archive.read("return_mode", symbol)){
+        returnMode.select(symbol);
+    }
+    return true;
+}
@@ -0,0 +1,59 @@
+#ifndef CNOID_BODY_PLUGIN_RAY_CAST_RANGE_SENSOR_SIMULATOR_ITEM_H
+#define CNOID_BODY_PLUGIN_RAY_CAST_RANGE_SENSOR_SIMULATOR_ITEM_H
+
+#include "SubSimulatorItem.h"
+#include "exportdecl.h"
+
+namespace cnoid {
+
+/**
+   This item simulates the range sensors by casting the rays of the sensors to the collision
+   shapes of the simulation bodies with the bounding volume trees of the collision detector.
+   The cost is proportional to the number of the rays instead of the rendered pixels, so this is
+   suitable for the multi-channel 3D LiDARs with sparse beam patterns. The visual shapes and the
+   scene objects other than the bodies are not seen by the sensors.
+*/
+class CNOID_EXPORT RayCastRangeSensorSimulatorItem : public SubSimulatorItem
+{
+public:
+    static void initializeClass(ExtensionManager* ext);
+
+    RayCastRangeSensorSimulatorItem();
+    RayCastRangeSensorSimulatorItem(const RayCastRangeSensorSimulatorItem& org);
+    ~RayCastRangeSensorSimulatorItem();
+
+    void setTargetBodies(const std::string& bodyNames);
+    void setTargetSensors(const std::string& sensorNames);
+    void setVisionDataRecordingEnabled(bool on);
+    //! The number of the threads casting the rays. Zero means the main thread only.
+    void setNumThreads(int n);
+
+    //! The yaw columns of the beams are cast in turn during the scan cycle if this is enabled.
+    void setMotionDistortionEnabled(bool on);
+
+    //! \param angle The full angle of the beam cone in radian. Zero means a beam is a single ray.
+    void setBeamDivergence(double angle);
+
+    enum ReturnMode { FIRST_RETURN, LAST_RETURN, N_RETURN_MODES };
+    //! The return of a diverged beam which is output as the range
+    void setReturnMode(int mode);
+
+    virtual bool initializeSimulation(SimulatorItem* simulatorItem) override;
+    virtual void finalizeSimulation() override;
+
+protected:
+    virtual Item* doDuplicate() const override;
+    virtual void doPutProperties(PutPropertyFunction& putProperty) override;
+    virtual bool store(Archive& archive) override;
+    virtual bool restore(const Archive& archive) override;
+
+private:
+    class Impl;
+    Impl* impl;
+};
+
+typedef ref_ptr<RayCastRangeSensorSimulatorItem> RayCastRangeSensorSimulatorItemPtr;
+
+}
+
+#endif
@@ -10,6 +10,9 @@
 #include <cnoid/Archive>
 #include <cnoid/EigenArchive>
 #include <fmt/format.h>
+#include <map>
+#include <mutex>
+#include <algorithm>
 #include "gettext.h"
 
 using namespace std;
@@ -31,6 +34,40 @@ public:
     virtual SignalProxy<void()> sigLocationChanged() override;
 };
 
+/**
+   The regions of the detectors for the same body share this group so that the link positions
+   are updated once in a simulation step and only the pairs of a region and a link whose bounding
+   boxes overlap are examined by the broadphase of the collision detector. The regions are static
+   geometries, so the pairs between the regions are skipped, and the sorted order of the broadphase
+   is incrementally updated as the links move.
+*/
+class IntrusionDetectionGroup : public Referenced
+{
+public:
+    static IntrusionDetectionGroup* getOrCreate(Body* body);
+    ~IntrusionDetectionGroup();
+    void addRegion(RegionIntrusionDetectorItem::Impl* region);
+    void removeRegion(RegionIntrusionDetectorItem::Impl* region);
+    void update(double time);
+
+private:
+    BodyPtr body;
+    vector<RegionIntrusionDetectorItem::Impl*> regions;
+    AISTCollisionDetectorPtr collisionDetector;
+    unique_ptr<BodyCollisionDetector> bodyCollisionDetector;
+    std::map<Link*, RegionIntrusionDetectorItem::Impl*> regionLinkMap;
+    bool isReady;
+    double lastUpdateTime;
+
+    IntrusionDetectionGroup(Body* body);
+    void makeReady();
+};
+
+typedef ref_ptr<IntrusionDetectionGroup> IntrusionDetectionGroupPtr;
+
+std::mutex groupMapMutex;
+std::map<Body*, IntrusionDetectionGroup*> groupMap;
+
 }
 
 namespace cnoid {
@@ -39,13 +76,16 @@ class RegionIntrusionDetectorItem::Impl
 {
 public:
     RegionIntrusionDetectorItem* self;
-    unique_ptr<AISTCollisionDetector> collisionDetector;
-    unique_ptr<BodyCollisionDetector> bodyCollisionDetector;
+    IntrusionDetectionGroupPtr detectionGroup;
+    ControllerIO* io;
     DigitalIoDevicePtr ioDevice;
     int ioSignalNumber;
     bool isIntruding;
     bool intrusionChanged;
 
+    // Updated by the detection group in each simulation step
+    bool isIntrusionDetected;
+
     // Region model members for the collision detection
     Vector3 boxRegionSize;
     Isometry3 regionOffset;
@@ -64,8 +104,9 @@ public:
     
     Impl(RegionIntrusionDetectorItem* self);
     Impl(RegionIntrusionDetectorItem* self, Impl& org);
-    void initializeCollisionDetector();
+    void createRegionBody();
     bool initialize(ControllerIO* io);
+    void stop();
     void createRegionMarker();
     void updateMarkerVertices();
     void updateMarkerPosition();
@@ -98,6 +139,7 @@ RegionIntrusionDetectorItem::RegionIntrusionDetectorItem(const RegionIntrusionDe
 RegionIntrusionDetectorItem::Impl::Impl(RegionIntrusionDetectorItem* self)
     : self(self)
 {
+    io = nullptr;
     boxRegionSize.setOnes();
     regionOffset.setIdentity();
     ioSignalNumber = 0;
@@ -115,6 +157,7 @@ RegionIntrusionDetectorItem::Impl::Impl(RegionIntrusionDetectorItem* self, Impl&
 
 RegionIntrusionDetectorItem::~RegionIntrusionDetectorItem()
 {
+    impl->stop();
     delete impl;
 }
 
@@ -170,12 +213,8 @@ int RegionIntrusionDetectorItem::digitalIoSignalNumber() const
 }
 
 
-void RegionIntrusionDetectorItem::Impl::initializeCollisionDetector()
+void RegionIntrusionDetectorItem::Impl::createRegionBody()
 {
-    collisionDetector.reset(new AISTCollisionDetector);
-    bodyCollisionDetector.reset(new BodyCollisionDetector);
-    bodyCollisionDetector->setCollisionDetector(collisionDetector.get());
-
     regionBody = new Body;
     regionLink = regionBody->rootLink();
     regionLink->setJointType(Link::FixedJoint);
@@ -194,8 +233,10 @@ bool RegionIntrusionDetectorItem::initialize(ControllerIO* io)
 
 bool RegionIntrusionDetectorItem::Impl::initialize(ControllerIO* io)
 {
-    if(!collisionDetector){
-        initializeCollisionDetector();
+    stop();
+    
+    if(!regionBody){
+        createRegionBody();
     }
     
     auto body = io->body();
@@ -206,18 +247,17 @@ bool RegionIntrusionDetectorItem::Impl::initialize(ControllerIO* io)
         return false;
     }
 
-    bodyCollisionDetector->clearBodies();
-
     regionShapeLocalOffset->setTranslation(Vector3(0.0, 0.0, boxRegionSize.z() / 2.0));
     regionShape->setMesh(meshGenerator.generateBox(boxRegionSize));
     regionLink->setPosition(regionOffset);
-    bodyCollisionDetector->addBody(regionBody, false);
 
-    bodyCollisionDetector->addBody(io->body(), false);
-    bodyCollisionDetector->makeReady();
+    this->io = io;
+    detectionGroup = IntrusionDetectionGroup::getOrCreate(body);
+    detectionGroup->addRegion(this);
 
     isIntruding = false;
     intrusionChanged = false;
+    isIntrusionDetected = false;
 
     return true;
 }
@@ -225,17 +265,14 @@ bool RegionIntrusionDetectorItem::Impl::initialize(ControllerIO* io)
 
 void RegionIntrusionDetectorItem::input()
 {
-    impl->bodyCollisionDetector->updatePositions();
+    impl->detectionGroup->update(impl->io->currentTime());
 }
 
 
 bool RegionIntrusionDetectorItem::control()
 {
-    bool prevIntrusion = impl->isIntruding;
-    impl->isIntruding = false;
-    impl->bodyCollisionDetector->detectCollisions(
-        [this](const CollisionPair&){ impl->isIntruding = true; });
-    impl->intrusionChanged = (impl->isIntruding != prevIntrusion);
+    impl->intrusionChanged = (impl->isIntrusionDetected != impl->isIntruding);
+    impl->isIntruding = impl->isIntrusionDetected;
     return false;
 }
 
@@ -251,8 +288,117 @@ void RegionIntrusionDetectorItem::output()
 
 void RegionIntrusionDetectorItem::stop()
 {
-    impl->ioDevice.reset();
-    impl->bodyCollisionDetector->clearBodies();
+    impl->stop();
+}
+
+
+void RegionIntrusionDetectorItem::Impl::stop()
+{
+    ioDevice.reset();
+    if(detectionGroup){
+        detectionGroup->removeRegion(this);
+        detectionGroup.reset();
+    }
+    io = nullptr;
+}
+
+
+IntrusionDetectionGroup* IntrusionDetectionGroup::getOrCreate(Body* body)
+{
+    std::lock_guard<std::mutex> lock(groupMapMutex);
+    auto& group = groupMap[body];
+    if(!group){
+        group = new IntrusionDetectionGroup(body);
+    }
+    return group;
+}
+
+
+IntrusionDetectionGroup::IntrusionDetectionGroup(Body* body)
+    : body(body)
+{
+    isReady = false;
+    lastUpdateTime = 0.0;
+}
+
+
+IntrusionDetectionGroup::~IntrusionDetectionGroup()
+{
+    std::lock_guard<std::mutex> lock(groupMapMutex);
+    auto p = groupMap.find(body);
+    if(p != groupMap.end() && p->second == this){
+        groupMap.erase(p);
+    }
+}
+
+
+void IntrusionDetectionGroup::addRegion(RegionIntrusionDetectorItem::Impl* region)
+{
+    regions.push_back(region);
+    isReady = false;
+}
+
+
+void IntrusionDetectionGroup::removeRegion(RegionIntrusionDetectorItem::Impl* region)
+{
+    regions.erase(std::remove(regions.begin(), regions.end(), region), regions.end());
+    isReady = false;
+}
+
+
+/**
+   The collision detector is built when the first update is done after the regions are changed
+   because the detectors for the body are initialized one by one.
+*/
+void IntrusionDetectionGroup::makeReady()
+{
+    if(!collisionDetector){
+        collisionDetector = new AISTCollisionDetector;
+        bodyCollisionDetector.reset(new BodyCollisionDetector);
+        bodyCollisionDetector->setCollisionDetector(collisionDetector);
+    }
+    bodyCollisionDetector->clearBodies();
+    regionLinkMap.clear();
+
+    for(auto& region : regions){
+        bodyCollisionDetector->addBody(region->regionBody, false);
+        regionLinkMap[region->regionLink] = region;
+    }
+    bodyCollisionDetector->addBody(body, false);
+    bodyCollisionDetector->makeReady();
+
+    isReady = true;
+}
+
+
+/**
+   This function is called by the input functions of the detectors, which are called in the
+   simulation thread, and the collisions are only detected by the first call in a step.
+*/
+void IntrusionDetectionGroup::update(double time)
+{
+    if(isReady && time == lastUpdateTime){
+        return;
+    }
+    if(!isReady){
+        makeReady();
+    }
+    lastUpdateTime = time;
+
+    bodyCollisionDetector->updatePositions();
+
+    for(auto& region : regions){
+        region->isIntrusionDetected = false;
+    }
+    bodyCollisionDetector->detectCollisions(
+        [this](const CollisionPair& collisionPair){
+            for(int i=0; i < 2; ++i){
+                auto p = regionLinkMap.find(static_cast<Link*>(collisionPair.object(i)));
+                if(p != regionLinkMap.end()){
+                    p->second->isIntrusionDetected = true;
+                }
+            }
+        });
 }
 
 
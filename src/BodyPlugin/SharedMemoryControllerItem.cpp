@@ -0,0 +1,309 @@
+#include "SharedMemoryControllerItem.h"
+#include <cnoid/SharedMemoryControllerBridge>
+#include <cnoid/ItemManager>
+#include <cnoid/MessageView>
+#include <cnoid/PutPropertyFunction>
+#include <cnoid/Archive>
+#include <thread>
+#include <chrono>
+#include <fmt/format.h>
+#include "gettext.h"
+
+using namespace std;
+using namespace cnoid;
+using fmt::format;
+
+namespace cnoid {
+
+class SharedMemoryControllerItem::Impl
+{
+public:
+    SharedMemoryControllerItem* self;
+    ControllerIO* io;
+    SharedMemoryControllerBridge bridge;
+    string channelName;
+    double connectionTimeout;
+    double responseTimeout;
+    bool isControlRequested;
+    bool isOutputAvailable;
+    bool isResponseDelayed;
+    bool doContinue;
+    MessageView* mv;
+
+    Impl(SharedMemoryControllerItem* self);
+    Impl(SharedMemoryControllerItem* self, const Impl& org);
+    bool initialize(ControllerIO* io);
+    void waitForControllerConnection();
+    void input();
+    bool control();
+    void output();
+};
+
+}
+
+
+void SharedMemoryControllerItem::initializeClass(ExtensionManager* ext)
+{
+    ItemManager& itemManager = ext->itemManager();
+    itemManager.registerClass<SharedMemoryControllerItem, ControllerItem>(N_("SharedMemoryControllerItem"));
+    itemManager.addCreationPanel<SharedMemoryControllerItem>();
+}
+
+
+SharedMemoryControllerItem::SharedMemoryControllerItem()
+{
+    impl = new Impl(this);
+}
+
+
+SharedMemoryControllerItem::Impl::Impl(SharedMemoryControllerItem* self)
+    : self(self)
+{
+    io = nullptr;
+    connectionTimeout = 10.0;
+    responseTimeout = 1.0;
+    isControlRequested = false;
+    isOutputAvailable = false;
+    isResponseDelayed = false;
+    doContinue = true;
+    mv = MessageView::instance();
+}
+
+
+SharedMemoryControllerItem::SharedMemoryControllerItem(const SharedMemoryControllerItem& org)
+    : ControllerItem(org)
+{
+    impl = new Impl(this, *org.impl);
+}
+
+
+SharedMemoryControllerItem::Impl::Impl(SharedMemoryControllerItem* self, const Impl& org)
+    : Impl(self)
+{
+    channelName = org.channelName;
+    connectionTimeout = org.connectionTimeout;
+    responseTimeout = org.responseTimeout;
+}
+
+
+SharedMemoryControllerItem::~SharedMemoryControllerItem()
+{
+    delete impl;
+}
+
+
+Item* SharedMemoryControllerItem::doDuplicate() const
+{
+    return new SharedMemoryControllerItem(*this);
+}
+
+
+void SharedMemoryControllerItem::setChannelName(const std::string& name)
+{
+    impl->channelName = name;
+}
+
+
+const std::string& SharedMemoryControllerItem::channelName() const
+{
+    return impl->channelName;
+}
+
+
+void SharedMemoryControllerItem::setConnectionTimeout(double timeout)
+{
+    impl->connectionTimeout = timeout;
+}
+
+
+double SharedMemoryControllerItem::connectionTimeout() const
+{
+    return impl->connectionTimeout;
+}
+
+
+void SharedMemoryControllerItem::setResponseTimeout(double timeout)
+{
+    impl->responseTimeout = timeout;
+}
+
+
+double SharedMemoryControllerItem::responseTimeout() const
+{
+    return impl->responseTimeout;
+}
+
+
+bool SharedMemoryControllerItem::initialize(ControllerIO* io)
+{
+    return impl->initialize(io);
+}
+
+
+bool SharedMemoryControllerItem::Impl::initialize(ControllerIO* io)
+{
+    auto body = io->body();
+    if(!body){
+        mv->putln(format(_("{} does not have a target body."), self->displayName()), MessageView::Error);
+        return false;
+    }
+    string name = channelName.empty() ? body->name() : channelName;
+    if(!bridge.create(name, body, io->timeStep())){
+        mv->putln(bridge.errorMessage(), MessageView::Error);
+        return false;
+    }
+    this->io = io;
+    isControlRequested = false;
+    isOutputAvailable = false;
+    isResponseDelayed = false;
+    doContinue = true;
+
+    waitForControllerConnection();
+
+    return true;
+}
+
+
+void SharedMemoryControllerItem::Impl::waitForControllerConnection()
+{
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::duration<double>(connectionTimeout);
+    while(!bridge.checkControllerReady()){
+        if(std::chrono::steady_clock::now() >= deadline){
+            mv->putln(
+                format(_("The controller of {0} is not connected yet. "
+                         "The controller can be connected to channel \"{1}\" during the simulation."),
+                       self->displayName(), channelName.empty() ? io->body()->name() : channelName),
+                MessageView::Warning);
+            return;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    mv->putln(format(_("The controller of {} has been connected."), self->displayName()));
+}
+
+
+bool SharedMemoryControllerItem::start()
+{
+    return true;
+}
+
+
+void SharedMemoryControllerItem::input()
+{
+    impl->input();
+}
+
+
+void SharedMemoryControllerItem::Impl::input()
+{
+    isControlRequested = false;
+    isOutputAvailable = false;
+
+    if(!bridge.isOpen()){
+        return;
+    }
+    if(bridge.checkControllerReady()){
+        mv->putln(format(_("The controller of {} has been connected."), self->displayName()));
+    }
+    if(bridge.isControllerReady()){
+        bridge.writeInput(io->currentTime());
+        isControlRequested = true;
+    }
+}
+
+
+bool SharedMemoryControllerItem::control()
+{
+    return impl->control();
+}
+
+
+/**
+   This function is executed in the simulation thread or a controller thread, and the body must not
+   be accessed in it.
+*/
+bool SharedMemoryControllerItem::Impl::control()
+{
+    if(!isControlRequested){
+        return doContinue;
+    }
+    bridge.requestControl();
+    auto result = bridge.waitForControlToFinish(responseTimeout, doContinue);
+    if(result == SharedMemoryControllerBridge::Completed){
+        isOutputAvailable = true;
+        isResponseDelayed = false;
+    } else if(result == SharedMemoryControllerBridge::Timeout){
+        if(!isResponseDelayed){
+            mv->putln(format(_("The controller of {} did not respond in time."), self->displayName()),
+                      MessageView::Warning);
+            isResponseDelayed = true;
+        }
+    } else {
+        mv->putln(format(_("The controller of {} has been disconnected."), self->displayName()),
+                  MessageView::Warning);
+    }
+    return doContinue;
+}
+
+
+void SharedMemoryControllerItem::output()
+{
+    impl->output();
+}
+
+
+void SharedMemoryControllerItem::Impl::output()
+{
+    if(isOutputAvailable){
+        bridge.readOutput();
+    }
+}
+
+
+void SharedMemoryControllerItem::stop()
+{
+    impl->bridge.close();
+    impl->io = nullptr;
+}
+
+
+void SharedMemoryControllerItem::onDisconnectedFromRoot()
+{
+    stop();
+}
+
+
+void SharedMemoryControllerItem::doPutProperties(PutPropertyFunction& putProperty)
+{
+    ControllerItem::doPutProperties(putProperty);
+    putProperty(_("Channel name"), impl->channelName, changeProperty(impl->channelName));
+    putProperty.min(0.0);
+    putProperty(_("Connection timeout"), impl->connectionTimeout, changeProperty(impl->connectionTimeout));
+    putProperty.min(0.001);
+    putProperty(_("Response timeout"), impl->responseTimeout, changeProperty(impl->responseTimeout));
+    putProperty.reset();
+}
+
+
+bool SharedMemoryControllerItem::store(Archive& archive)
+{
+    if(!ControllerItem::store(archive)){
+        return false;
+    }
+    archive.write("channel_name", impl->channelName, DOUBLE_QUOTED);
+    archive.write("connection_timeout", impl->connectionTimeout);
+    archive.write("response_timeout", impl->responseTimeout);
+    return true;
+}
+
+
+bool SharedMemoryControllerItem::restore(const Archive& archive)
+{
+    if(!ControllerItem::restore(archive)){
+        return false;
+    }
+    archive.read("channel_name", impl->channelName);
+    archive.read("connection_timeout", impl->connectionTimeout);
+    archive.read("response_timeout", impl->responseTimeout);
+    return true;
+}
@@ -0,0 +1,58 @@
+#ifndef CNOID_BODY_PLUGIN_SHARED_MEMORY_CONTROLLER_ITEM_H
+#define CNOID_BODY_PLUGIN_SHARED_MEMORY_CONTROLLER_ITEM_H
+
+#include "ControllerItem.h"
+#include "exportdecl.h"
+
+namespace cnoid {
+
+/**
+   This item connects the target body of the simulation to a controller running in another process
+   through SharedMemoryControllerBridge. The controller process can use SharedMemoryControllerRunner
+   to run a simple controller with the channel name of this item.
+*/
+class CNOID_EXPORT SharedMemoryControllerItem : public ControllerItem
+{
+public:
+    static void initializeClass(ExtensionManager* ext);
+
+    SharedMemoryControllerItem();
+    SharedMemoryControllerItem(const SharedMemoryControllerItem& org);
+    virtual ~SharedMemoryControllerItem();
+
+    //! The name of the body is used if the channel name is empty.
+    void setChannelName(const std::string& name);
+    const std::string& channelName() const;
+
+    //! The simulation waits for the controller to be connected for this time when it is initialized.
+    void setConnectionTimeout(double timeout);
+    double connectionTimeout() const;
+
+    //! The simulation waits for the control of each step for this time.
+    void setResponseTimeout(double timeout);
+    double responseTimeout() const;
+
+    virtual bool initialize(ControllerIO* io) override;
+    virtual bool start() override;
+    virtual void input() override;
+    virtual bool control() override;
+    virtual void output() override;
+    virtual void stop() override;
+
+protected:
+    virtual Item* doDuplicate() const override;
+    virtual void onDisconnectedFromRoot() override;
+    virtual void doPutProperties(PutPropertyFunction& putProperty) override;
+    virtual bool store(Archive& archive) override;
+    virtual bool restore(const Archive& archive) override;
+
+private:
+    class Impl;
+    Impl* impl;
+};
+
+typedef ref_ptr<SharedMemoryControllerItem> SharedMemoryControllerItemPtr;
+
+}
+
+#endif
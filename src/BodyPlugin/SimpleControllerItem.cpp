@@ -20,7 +20,6 @@
 #include <cnoid/stdx/filesystem>
 #include <fmt/format.h>
 #include <set>
-#include <bitset>
 #include <algorithm>
 #include "gettext.h"
 
@@ -37,10 +36,16 @@ struct SharedInfo : public Referenced
     ScopedConnectionSet inputDeviceStateConnections;
     vector<bool> inputEnabledDeviceFlag;
     vector<bool> inputDeviceStateChangeFlag;
+    vector<int> changedInputDeviceIndices;
 };
 
 typedef ref_ptr<SharedInfo> SharedInfoPtr;
 
+constexpr int stateTypeIndex(int stateBit, int index = 0)
+{
+    return (stateBit <= 1) ? index : stateTypeIndex(stateBit >> 1, index + 1);
+}
+
 class MySimpleControllerConfig : public SimpleControllerConfig
 {
 public:
@@ -63,27 +68,28 @@ public:
     ControllerIO* io;
     SharedInfoPtr sharedInfo;
 
-    vector<unsigned short> inputLinkIndices;
-    
     vector<short> linkIndexToInputStateTypeMap;
-
-    // This vector contains input state types of all the links.
-    // The elements are the sequence of [number of input state types of the i-th link] [state type 1] [state type 2] ...
-    vector<short> inputStateTypes;
-
     vector<bool> outputLinkFlags;
 
-    struct LinkOutputStateInfo
+    /*
+      The pairs of the simulation body link and the I/O body link for each state type, which
+      are compiled by updateIOStateTypes. The input and output functions copy each state with
+      a flat loop over the pairs without checking the state types of each link.
+    */
+    struct LinkPair
     {
-        int linkIndex;
-        vector<short> stateTypes;
+        Link* simLink;
+        Link* ioLink;
     };
-    vector<LinkOutputStateInfo> linkOutputStateInfos;
+    vector<LinkPair> inputLinkPairs[Link::NumStateTypes];
+    vector<LinkPair> outputLinkPairs[Link::NumStateTypes];
     
     bool isOldTargetVariableMode;
 
     ConnectionSet outputDeviceStateConnections;
     vector<bool> outputDeviceStateChangeFlag;
+    vector<int> changedOutputDeviceIndices;
+    vector<int> deviceIndicesBeingProcessed;
 
     vector<SimpleControllerItemPtr> subControllerItems;
 
@@ -470,6 +476,7 @@ void SimpleControllerItem::Impl::updateInputEnabledDevices()
     const DeviceList<>& devices = simulationBody->devices();
     sharedInfo->inputDeviceStateChangeFlag.clear();
     sharedInfo->inputDeviceStateChangeFlag.resize(devices.size(), false);
+    sharedInfo->changedInputDeviceIndices.clear();
     sharedInfo->inputDeviceStateConnections.disconnect();
 
     const auto& flag = sharedInfo->inputEnabledDeviceFlag;
@@ -493,6 +500,7 @@ void SimpleControllerItem::Impl::initializeIoBody()
     const DeviceList<>& ioDevices = ioBody->devices();
     outputDeviceStateChangeFlag.clear();
     outputDeviceStateChangeFlag.resize(ioDevices.size(), false);
+    changedOutputDeviceIndices.clear();
     for(size_t i=0; i < ioDevices.size(); ++i){
         outputDeviceStateConnections.add(
             ioDevices[i]->sigStateChanged().connect(
@@ -508,10 +516,11 @@ void SimpleControllerItem::Impl::initializeIoBody()
 
 void SimpleControllerItem::Impl::clearIoTargets()
 {
-    inputLinkIndices.clear();
-    inputStateTypes.clear();
+    for(int i=0; i < Link::NumStateTypes; ++i){
+        inputLinkPairs[i].clear();
+        outputLinkPairs[i].clear();
+    }
     outputLinkFlags.clear();
-    linkOutputStateInfos.clear();
     subControllerItems.clear();
 }
 
@@ -591,38 +600,38 @@ SimpleController* SimpleControllerItem::Impl::initialize(ControllerIO* io, Share
 void SimpleControllerItem::Impl::updateIOStateTypes()
 {
     // Input
-    inputLinkIndices.clear();
-    inputStateTypes.clear();
+    for(int i=0; i < Link::NumStateTypes; ++i){
+        inputLinkPairs[i].clear();
+    }
     for(size_t i=0; i < linkIndexToInputStateTypeMap.size(); ++i){
-        bitset<Link::NumStateTypes> types(linkIndexToInputStateTypeMap[i]);
-        if(types.any()){
-            simulationBody->link(i)->mergeSensingMode(ioBody->link(i)->sensingMode());
-            const int n = types.count();
-            inputLinkIndices.push_back(i);
-            inputStateTypes.push_back(n);
+        int types = linkIndexToInputStateTypeMap[i];
+        if(types){
+            auto simLink = simulationBody->link(i);
+            auto ioLink = ioBody->link(i);
+            simLink->mergeSensingMode(ioLink->sensingMode());
             for(int j=0; j < Link::NumStateTypes; ++j){
-                if(types.test(j)){
-                    inputStateTypes.push_back(1 << j);
+                if(types & (1 << j)){
+                    inputLinkPairs[j].push_back({ simLink, ioLink });
                 }
             }
         }
     }
 
     // Output
-    linkOutputStateInfos.clear();
+    for(int i=0; i < Link::NumStateTypes; ++i){
+        outputLinkPairs[i].clear();
+    }
     for(size_t i=0; i < outputLinkFlags.size(); ++i){
         if(outputLinkFlags[i]){
-            LinkOutputStateInfo info;
-            info.linkIndex = i;
-            int actuationMode = ioBody->link(i)->actuationMode();
-            simulationBody->link(i)->setActuationMode(actuationMode);
+            auto simLink = simulationBody->link(i);
+            auto ioLink = ioBody->link(i);
+            int actuationMode = ioLink->actuationMode();
+            simLink->setActuationMode(actuationMode);
             for(int j=0; j < Link::NumStateTypes; ++j){
-                int stateBit = 1 << j;
-                if(actuationMode & stateBit){
-                    info.stateTypes.push_back(stateBit);
+                if(actuationMode & (1 << j)){
+                    outputLinkPairs[j].push_back({ simLink, ioLink });
                 }
             }
-            linkOutputStateInfos.push_back(info);
         }
     }
 }
@@ -844,64 +853,60 @@ void SimpleControllerItem::input()
 
 void SimpleControllerItem::Impl::input()
 {
-    int typeArrayIndex = 0;
-    for(size_t i=0; i < inputLinkIndices.size(); ++i){
-        const int linkIndex = inputLinkIndices[i];
-        const Link* simLink = simulationBody->link(linkIndex);
-        Link* ioLink = ioBody->link(linkIndex);
-        const int n = inputStateTypes[typeArrayIndex++];
-        for(int j=0; j < n; ++j){
-            switch(inputStateTypes[typeArrayIndex++]){
-            case Link::JointDisplacement:
-                ioLink->q() = simLink->q();
-                break;
-            case Link::JointVelocity:
-                ioLink->dq() = simLink->dq();
-                break;
-            case Link::JointAcceleration:
-                ioLink->ddq() = simLink->ddq();
-                break;
-            case Link::JointEffort:
-                ioLink->u() = simLink->u();
-                break;
-            case Link::LinkPosition:
-                ioLink->T() = simLink->T();
-                break;
-            case Link::LinkTwist:
-                ioLink->v() = simLink->v();
-                ioLink->w() = simLink->w();
-                break;
-            case Link::LinkExtWrench:
-                ioLink->F_ext() = simLink->F_ext();
-                break;
-            case Link::LinkContactState:
-                ioLink->contactPoints() = simLink->contactPoints();
-                break;
-            default:
-                break;
-            }
-        }
+    for(auto& pair : inputLinkPairs[stateTypeIndex(Link::JointDisplacement)]){
+        pair.ioLink->q() = pair.simLink->q();
+    }
+    for(auto& pair : inputLinkPairs[stateTypeIndex(Link::JointVelocity)]){
+        pair.ioLink->dq() = pair.simLink->dq();
+    }
+    for(auto& pair : inputLinkPairs[stateTypeIndex(Link::JointAcceleration)]){
+        pair.ioLink->ddq() = pair.simLink->ddq();
+    }
+    for(auto& pair : inputLinkPairs[stateTypeIndex(Link::JointEffort)]){
+        pair.ioLink->u() = pair.simLink->u();
+    }
+    for(auto& pair : inputLinkPairs[stateTypeIndex(Link::LinkPosition)]){
+        pair.ioLink->T() = pair.simLink->T();
+    }
+    for(auto& pair : inputLinkPairs[stateTypeIndex(Link::LinkTwist)]){
+        pair.ioLink->v() = pair.simLink->v();
+        pair.ioLink->w() = pair.simLink->w();
+    }
+    for(auto& pair : inputLinkPairs[stateTypeIndex(Link::LinkExtWrench)]){
+        pair.ioLink->F_ext() = pair.simLink->F_ext();
+    }
+    for(auto& pair : inputLinkPairs[stateTypeIndex(Link::LinkContactState)]){
+        pair.ioLink->contactPoints() = pair.simLink->contactPoints();
     }
 
-    auto& flag = sharedInfo->inputDeviceStateChangeFlag;
-    const auto& devices = simulationBody->devices();
-    const auto& ioDevices = ioBody->devices();
-    for(size_t i=0; i < flag.size(); ++i){
-        if(flag[i]){
+    // Only the devices whose states have been changed are processed
+    auto& changedIndices = sharedInfo->changedInputDeviceIndices;
+    if(!changedIndices.empty()){
+        // The indices are moved because the signal handlers may change the device states again
+        deviceIndicesBeingProcessed.swap(changedIndices);
+        auto& flag = sharedInfo->inputDeviceStateChangeFlag;
+        const auto& devices = simulationBody->devices();
+        const auto& ioDevices = ioBody->devices();
+        for(auto& i : deviceIndicesBeingProcessed){
             Device* ioDevice = ioDevices[i];
             ioDevice->copyStateFrom(*devices[i]);
+            flag[i] = false;
             outputDeviceStateConnections.block(i);
             ioDevice->notifyStateChange();
             outputDeviceStateConnections.unblock(i);
-            flag[i] = false;
         }
+        deviceIndicesBeingProcessed.clear();
     }
 }
 
 
 void SimpleControllerItem::Impl::onInputDeviceStateChanged(int deviceIndex)
 {
-    sharedInfo->inputDeviceStateChangeFlag[deviceIndex] = true;
+    auto& flag = sharedInfo->inputDeviceStateChangeFlag;
+    if(!flag[deviceIndex]){
+        flag[deviceIndex] = true;
+        sharedInfo->changedInputDeviceIndices.push_back(deviceIndex);
+    }
 }
 
 
@@ -921,7 +926,10 @@ bool SimpleControllerItem::control()
 
 void SimpleControllerItem::Impl::onOutputDeviceStateChanged(int deviceIndex)
 {
-    outputDeviceStateChangeFlag[deviceIndex] = true;
+    if(!outputDeviceStateChangeFlag[deviceIndex]){
+        outputDeviceStateChangeFlag[deviceIndex] = true;
+        changedOutputDeviceIndices.push_back(deviceIndex);
+    }
 }
 
 
@@ -937,72 +945,57 @@ void SimpleControllerItem::output()
 
 void SimpleControllerItem::Impl::output()
 {
-    for(size_t i=0; i < linkOutputStateInfos.size(); ++i){
-
-        const auto& info = linkOutputStateInfos[i];
-        const int index = info.linkIndex;
-        const Link* ioLink = ioBody->link(index);
-        Link* simLink = simulationBody->link(index);
-
-        const auto& stateTypes = info.stateTypes;
-        for(size_t j=0; j < stateTypes.size(); ++j){
-            switch(stateTypes[j]){
-
-            case Link::JointDisplacement:
-                if(isOldTargetVariableMode){
-                    simLink->q_target() = ioLink->q();
-                } else {
-                    simLink->q_target() = ioLink->q_target();
-                }
-                break;
-
-            case Link::JointVelocity:
-            case Link::DeprecatedJointSurfaceVelocity:
-                if(isOldTargetVariableMode){
-                    simLink->dq_target() = ioLink->dq();
-                } else {
-                    simLink->dq_target() = ioLink->dq_target();
-                }
-                break;
-
-            case Link::JointAcceleration:
-                simLink->ddq() = ioLink->ddq();
-                break;
-
-            case Link::JointEffort:
-                simLink->u() = ioLink->u();
-                break;
-
-            case Link::LinkPosition:
-                simLink->T() = ioLink->T();
-                break;
-
-            case Link::LinkTwist:
-                simLink->v() = ioLink->v();
-                simLink->w() = ioLink->w();
-                break;
-
-            case Link::LinkExtWrench:
-                simLink->F_ext() += ioLink->F_ext();
-                break;
-
-            default:
-                break;
-            }
+    if(isOldTargetVariableMode){
+        for(auto& pair : outputLinkPairs[stateTypeIndex(Link::JointDisplacement)]){
+            pair.simLink->q_target() = pair.ioLink->q();
+        }
+        for(auto& pair : outputLinkPairs[stateTypeIndex(Link::JointVelocity)]){
+            pair.simLink->dq_target() = pair.ioLink->dq();
+        }
+        for(auto& pair : outputLinkPairs[stateTypeIndex(Link::DeprecatedJointSurfaceVelocity)]){
+            pair.simLink->dq_target() = pair.ioLink->dq();
+        }
+    } else {
+        for(auto& pair : outputLinkPairs[stateTypeIndex(Link::JointDisplacement)]){
+            pair.simLink->q_target() = pair.ioLink->q_target();
+        }
+        for(auto& pair : outputLinkPairs[stateTypeIndex(Link::JointVelocity)]){
+            pair.simLink->dq_target() = pair.ioLink->dq_target();
+        }
+        for(auto& pair : outputLinkPairs[stateTypeIndex(Link::DeprecatedJointSurfaceVelocity)]){
+            pair.simLink->dq_target() = pair.ioLink->dq_target();
         }
     }
+    for(auto& pair : outputLinkPairs[stateTypeIndex(Link::JointAcceleration)]){
+        pair.simLink->ddq() = pair.ioLink->ddq();
+    }
+    for(auto& pair : outputLinkPairs[stateTypeIndex(Link::JointEffort)]){
+        pair.simLink->u() = pair.ioLink->u();
+    }
+    for(auto& pair : outputLinkPairs[stateTypeIndex(Link::LinkPosition)]){
+        pair.simLink->T() = pair.ioLink->T();
+    }
+    for(auto& pair : outputLinkPairs[stateTypeIndex(Link::LinkTwist)]){
+        pair.simLink->v() = pair.ioLink->v();
+        pair.simLink->w() = pair.ioLink->w();
+    }
+    for(auto& pair : outputLinkPairs[stateTypeIndex(Link::LinkExtWrench)]){
+        pair.simLink->F_ext() += pair.ioLink->F_ext();
+    }
 
-    const DeviceList<>& devices = simulationBody->devices();
-    const DeviceList<>& ioDevices = ioBody->devices();
-    for(size_t i=0; i < outputDeviceStateChangeFlag.size(); ++i){
-        if(outputDeviceStateChangeFlag[i]){
+    if(!changedOutputDeviceIndices.empty()){
+        deviceIndicesBeingProcessed.swap(changedOutputDeviceIndices);
+        const DeviceList<>& devices = simulationBody->devices();
+        const DeviceList<>& ioDevices = ioBody->devices();
+        for(auto& i : deviceIndicesBeingProcessed){
             Device* device = devices[i];
             device->copyStateFrom(*ioDevices[i]);
+            outputDeviceStateChangeFlag[i] = false;
             sharedInfo->inputDeviceStateConnections.block(i);
             device->notifyStateChange();
             sharedInfo->inputDeviceStateConnections.unblock(i);
-            outputDeviceStateChangeFlag[i] = false;
         }
+        deviceIndicesBeingProcessed.clear();
     }
 }
 
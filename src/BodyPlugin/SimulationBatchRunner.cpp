@@ -0,0 +1,234 @@
+/**
+   @author Shin'ichiro Nakaoka
+*/
+
+#include "SimulationBatchRunner.h"
+#include "SimulatorItem.h"
+#include "WorldItem.h"
+#include <cnoid/ThreadPool>
+#include <cnoid/MessageView>
+#include <QElapsedTimer>
+#include <thread>
+#include <fmt/format.h>
+#include "gettext.h"
+
+using namespace std;
+using namespace cnoid;
+using fmt::format;
+
+namespace cnoid {
+
+class SimulationBatchRunner::Impl
+{
+public:
+    int numRuns;
+    int numThreads;
+    std::function<void(int runIndex, WorldItem* worldItem)> runSetupFunction;
+    std::function<void(int runIndex, SimulatorItem* simulatorItem, bool isCompleted)> resultFunction;
+    vector<WorldItemPtr> worldItems;
+    vector<SimulatorItemPtr> simulatorItems;
+    vector<RunResult> results;
+    double elapsedTime;
+
+    Impl();
+    bool run(WorldItem* worldItem, SimulatorItem* simulatorItem);
+    SimulatorItem* findCorrespondingSimulatorItem(
+        WorldItem* orgWorld, SimulatorItem* orgSimulator, WorldItem* duplicatedWorld);
+};
+
+}
+
+
+SimulationBatchRunner::SimulationBatchRunner()
+{
+    impl = new Impl;
+}
+
+
+SimulationBatchRunner::Impl::Impl()
+{
+    numRuns = 1;
+    numThreads = 0;
+    elapsedTime = 0.0;
+}
+
+
+SimulationBatchRunner::~SimulationBatchRunner()
+{
+    delete impl;
+}
+
+
+void SimulationBatchRunner::setNumRuns(int n)
+{
+    impl->numRuns = std::max(0, n);
+}
+
+
+int SimulationBatchRunner::numRuns() const
+{
+    return impl->numRuns;
+}
+
+
+void SimulationBatchRunner::setNumThreads(int n)
+{
+    impl->numThreads = std::max(0, n);
+}
+
+
+int SimulationBatchRunner::numThreads() const
+{
+    return impl->numThreads;
+}
+
+
+void SimulationBatchRunner::setRunSetupFunction(std::function<void(int runIndex, WorldItem* worldItem)> func)
+{
+    impl->runSetupFunction = func;
+}
+
+
+void SimulationBatchRunner::setResultFunction
+(std::function<void(int runIndex, SimulatorItem* simulatorItem, bool isCompleted)> func)
+{
+    impl->resultFunction = func;
+}
+
+
+const SimulationBatchRunner::RunResult& SimulationBatchRunner::result(int runIndex) const
+{
+    return impl->results[runIndex];
+}
+
+
+double SimulationBatchRunner::elapsedTime() const
+{
+    return impl->elapsedTime;
+}
+
+
+bool SimulationBatchRunner::run(WorldItem* worldItem, SimulatorItem* simulatorItem)
+{
+    return impl->run(worldItem, simulatorItem);
+}
+
+
+/**
+   The simulator item in the duplicated world is identified by the position of the original
+   one in the list of the simulator items in the original world.
+*/
+SimulatorItem* SimulationBatchRunner::Impl::findCorrespondingSimulatorItem
+(WorldItem* orgWorld, SimulatorItem* orgSimulator, WorldItem* duplicatedWorld)
+{
+    auto orgSimulators = orgWorld->descendantItems<SimulatorItem>();
+    auto duplicatedSimulators = duplicatedWorld->descendantItems<SimulatorItem>();
+    for(size_t i=0; i < orgSimulators.size(); ++i){
+        if(orgSimulators[i] == orgSimulator){
+            if(i < duplicatedSimulators.size()){
+                return duplicatedSimulators[i];
+            }
+            break;
+        }
+    }
+    return nullptr;
+}
+
+
+bool SimulationBatchRunner::Impl::run(WorldItem* worldItem, SimulatorItem* simulatorItem)
+{
+    auto mv = MessageView::instance();
+    
+    results.clear();
+    results.resize(numRuns, RunResult{ false, false, 0.0, 0.0 });
+    elapsedTime = 0.0;
+
+    if(!worldItem || numRuns == 0){
+        return false;
+    }
+    if(!simulatorItem){
+        simulatorItem = worldItem->findItem<SimulatorItem>();
+        if(!simulatorItem){
+            mv->putln(format(_("There is no simulator item in {0}."), worldItem->displayName()),
+                      MessageView::Error);
+            return false;
+        }
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    worldItems.clear();
+    simulatorItems.clear();
+    worldItems.reserve(numRuns);
+    simulatorItems.reserve(numRuns);
+
+    // The duplication and the initialization of the simulation is done in the main thread
+    for(int i=0; i < numRuns; ++i){
+        WorldItemPtr duplicatedWorld = dynamic_cast<WorldItem*>(worldItem->duplicateSubTree());
+        SimulatorItemPtr duplicatedSimulator;
+        if(duplicatedWorld){
+            duplicatedWorld->setName(format("{0}-{1}", worldItem->name(), i));
+            if(runSetupFunction){
+                runSetupFunction(i, duplicatedWorld);
+            }
+            duplicatedSimulator = findCorrespondingSimulatorItem(worldItem, simulatorItem, duplicatedWorld);
+        }
+        if(duplicatedSimulator){
+            duplicatedSimulator->setBatchMode(true);
+            results[i].isInitialized = duplicatedSimulator->startSimulation(true);
+        }
+        if(!results[i].isInitialized){
+            mv->putln(format(_("The simulation of run {0} cannot be initialized."), i), MessageView::Error);
+        }
+        worldItems.push_back(duplicatedWorld);
+        simulatorItems.push_back(duplicatedSimulator);
+    }
+
+    int n = numThreads;
+    if(n == 0){
+        n = std::max((unsigned)1, thread::hardware_concurrency());
+    }
+    n = std::min(n, numRuns);
+
+    {
+        ThreadPool threadPool(n);
+        for(int i=0; i < numRuns; ++i){
+            if(results[i].isInitialized){
+                auto simulator = simulatorItems[i].get();
+                auto& result = results[i];
+                threadPool.start(
+                    [simulator, &result](){
+                        result.isCompleted = simulator->runSimulationLoopInBatchMode();
+                    });
+            }
+        }
+        threadPool.wait();
+    }
+
+    bool completed = true;
+    for(int i=0; i < numRuns; ++i){
+        auto& result = results[i];
+        if(auto simulator = simulatorItems[i]){
+            if(result.isInitialized){
+                result.finishTime = simulator->finishTime();
+                result.computationTime = simulator->actualSimulationTime();
+                simulator->finishBatchSimulation();
+            }
+            if(resultFunction){
+                resultFunction(i, simulator, result.isCompleted);
+            }
+        }
+        completed &= result.isCompleted;
+    }
+
+    worldItems.clear();
+    simulatorItems.clear();
+
+    elapsedTime = timer.elapsed() / 1000.0;
+
+    mv->putln(format(_("Batch simulation of {0} runs with {1} threads has finished in {2} [s]."),
+                     numRuns, n, elapsedTime));
+
+    return completed;
+}
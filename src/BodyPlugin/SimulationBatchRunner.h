@@ -0,0 +1,77 @@
+/**
+   @author Shin'ichiro Nakaoka
+*/
+
+#ifndef CNOID_BODY_PLUGIN_SIMULATION_BATCH_RUNNER_H
+#define CNOID_BODY_PLUGIN_SIMULATION_BATCH_RUNNER_H
+
+#include <functional>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+class WorldItem;
+class SimulatorItem;
+
+/**
+   This class runs a simulation of a world several times in parallel.
+   The world item sub tree is duplicated for each run, and the simulation loop of the
+   simulator item in each duplicated world is executed in the batch mode by a worker thread.
+   The duplicated worlds are not added to the project item tree.
+*/
+class CNOID_EXPORT SimulationBatchRunner
+{
+public:
+    SimulationBatchRunner();
+    ~SimulationBatchRunner();
+
+    void setNumRuns(int n);
+    int numRuns() const;
+
+    //! The number of hardware threads is used when n is zero
+    void setNumThreads(int n);
+    int numThreads() const;
+
+    /**
+       The function is called from the main thread for each duplicated world before its
+       simulation is started. It can be used to set the parameters of each run.
+    */
+    void setRunSetupFunction(std::function<void(int runIndex, WorldItem* worldItem)> func);
+
+    /**
+       The function is called from the main thread for each run after the simulation is finished.
+       The record items created by the simulator item are available in the duplicated world.
+    */
+    void setResultFunction(
+        std::function<void(int runIndex, SimulatorItem* simulatorItem, bool isCompleted)> func);
+
+    /**
+       \param simulatorItem The simulator item in worldItem to use. The first simulator item
+       found in the world is used if it is nullptr.
+       \return true if all the runs were executed without errors.
+       \note This function must be called from the main thread.
+    */
+    bool run(WorldItem* worldItem, SimulatorItem* simulatorItem = nullptr);
+
+    struct RunResult
+    {
+        bool isInitialized;
+        bool isCompleted;
+        double finishTime;
+        double computationTime;
+    };
+
+    const RunResult& result(int runIndex) const;
+
+    //! Total elapsed time of the last run() call
+    double elapsedTime() const;
+
+    class Impl;
+
+private:
+    Impl* impl;
+};
+
+}
+
+#endif
@@ -0,0 +1,131 @@
+/**
+   @author Shin'ichiro Nakaoka
+*/
+
+#include "SimulationStepProfiler.h"
+#include <fmt/format.h>
+#include <algorithm>
+#include <fstream>
+#include <ostream>
+
+using namespace std;
+using namespace cnoid;
+using fmt::format;
+
+
+SimulationStepProfiler::SimulationStepProfiler()
+{
+    windowSize_ = 1000;
+}
+
+
+void SimulationStepProfiler::setWindowSize(int n)
+{
+    windowSize_ = std::max(1, n);
+    for(auto& phase : phases){
+        phase.window.clear();
+        phase.windowPos = 0;
+    }
+}
+
+
+void SimulationStepProfiler::clear()
+{
+    phases.clear();
+}
+
+
+int SimulationStepProfiler::addPhase(const std::string& name)
+{
+    int index = phases.size();
+    phases.emplace_back();
+    Phase& phase = phases.back();
+    phase.name = name;
+    phase.window.reserve(windowSize_);
+    phase.windowPos = 0;
+    phase.numSamples = 0;
+    phase.totalTime = 0.0;
+    phase.maxTime = 0.0;
+    return index;
+}
+
+
+void SimulationStepProfiler::record(int phaseIndex, double time)
+{
+    Phase& phase = phases[phaseIndex];
+    if(static_cast<int>(phase.window.size()) < windowSize_){
+        phase.window.push_back(time);
+    } else {
+        phase.window[phase.windowPos] = time;
+        phase.windowPos = (phase.windowPos + 1) % windowSize_;
+    }
+    ++phase.numSamples;
+    phase.totalTime += time;
+    if(time > phase.maxTime){
+        phase.maxTime = time;
+    }
+}
+
+
+SimulationStepProfiler::Statistics SimulationStepProfiler::statistics(int phaseIndex) const
+{
+    const Phase& phase = phases[phaseIndex];
+    Statistics stat;
+    stat.numSamples = phase.numSamples;
+    stat.totalTime = phase.totalTime;
+    stat.maxTime = phase.maxTime;
+    stat.rollingAverage = 0.0;
+    stat.rolling99thPercentile = 0.0;
+
+    const int n = phase.window.size();
+    if(n > 0){
+        vector<double> times(phase.window);
+        double sum = 0.0;
+        for(auto& t : times){
+            sum += t;
+        }
+        stat.rollingAverage = sum / n;
+        auto p99 = times.begin() + std::min(n - 1, static_cast<int>(n * 0.99));
+        std::nth_element(times.begin(), p99, times.end());
+        stat.rolling99thPercentile = *p99;
+    }
+
+    return stat;
+}
+
+
+void SimulationStepProfiler::putSummary(std::ostream& os) const
+{
+    size_t nameWidth = 0;
+    for(auto& phase : phases){
+        nameWidth = std::max(nameWidth, phase.name.size());
+    }
+    os << format("{0:<{1}}  {2:>10}  {3:>10}  {4:>10}  {5:>10}\n",
+                 "Phase [ms]", nameWidth, "Average", "Avg(roll)", "P99(roll)", "Max");
+    for(int i=0; i < numPhases(); ++i){
+        auto stat = statistics(i);
+        double average = (stat.numSamples > 0) ? (stat.totalTime / stat.numSamples) : 0.0;
+        os << format("{0:<{1}}  {2:>10.4f}  {3:>10.4f}  {4:>10.4f}  {5:>10.4f}\n",
+                     phases[i].name, nameWidth, average * 1000.0, stat.rollingAverage * 1000.0,
+                     stat.rolling99thPercentile * 1000.0, stat.maxTime * 1000.0);
+    }
+}
+
+
+bool SimulationStepProfiler::writeCsvFile(const std::string& filename) const
+{
+    ofstream ofs(filename);
+    if(!ofs){
+        return false;
+    }
+    ofs << "phase,samples,total_s,average_ms,rolling_average_ms,rolling_p99_ms,max_ms\n";
+    for(int i=0; i < numPhases(); ++i){
+        auto stat = statistics(i);
+        double average = (stat.numSamples > 0) ? (stat.totalTime / stat.numSamples) : 0.0;
+        ofs << format("\"{}\",{},{:.6f},{:.6f},{:.6f},{:.6f},{:.6f}\n",
+                      phases[i].name, stat.numSamples, stat.totalTime, average * 1000.0,
+                      stat.rollingAverage * 1000.0, stat.rolling99thPercentile * 1000.0,
+                      stat.maxTime * 1000.0);
+    }
+    return !ofs.fail();
+}
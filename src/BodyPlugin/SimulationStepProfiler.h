@@ -0,0 +1,81 @@
+/**
+   @author Shin'ichiro Nakaoka
+*/
+
+#ifndef CNOID_BODY_PLUGIN_SIMULATION_STEP_PROFILER_H
+#define CNOID_BODY_PLUGIN_SIMULATION_STEP_PROFILER_H
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include <iosfwd>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+/**
+   This class measures the elapsed time of the phases of each simulation step.
+   The times of the recent steps are kept to calculate the rolling statistics.
+   The measurement functions must be called from the thread executing the simulation loop.
+*/
+class CNOID_EXPORT SimulationStepProfiler
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    SimulationStepProfiler();
+
+    void setWindowSize(int n);
+    int windowSize() const { return windowSize_; }
+
+    //! This function clears all the phases and the measured data
+    void clear();
+    
+    int addPhase(const std::string& name);
+    int numPhases() const { return phases.size(); }
+    const std::string& phaseName(int index) const { return phases[index].name; }
+
+    void beginStep(){ lastTime = Clock::now(); }
+
+    //! This function records the time from the last lap or the beginning of the step
+    void lap(int phaseIndex){
+        Clock::time_point now = Clock::now();
+        record(phaseIndex, std::chrono::duration<double>(now - lastTime).count());
+        lastTime = now;
+    }
+
+    void record(int phaseIndex, double time);
+
+    struct Statistics
+    {
+        int numSamples;
+        double totalTime;
+        double maxTime;
+        double rollingAverage;
+        double rolling99thPercentile;
+    };
+
+    //! \note The times are given in seconds
+    Statistics statistics(int phaseIndex) const;
+
+    void putSummary(std::ostream& os) const;
+    bool writeCsvFile(const std::string& filename) const;
+
+private:
+    struct Phase
+    {
+        std::string name;
+        std::vector<double> window;
+        int windowPos;
+        int numSamples;
+        double totalTime;
+        double maxTime;
+    };
+    std::vector<Phase> phases;
+    int windowSize_;
+    Clock::time_point lastTime;
+};
+
+}
+
+#endif
@@ -10,8 +10,10 @@
 #include "SimulationScriptItem.h"
 #include "BodyMotionItem.h"
 #include "WorldLogFileItem.h"
+#include "WorldLogStreamItem.h"
 #include "CollisionSeqItem.h"
 #include "CollisionSeqEngine.h"
+#include "SimulationStepProfiler.h"
 #include <cnoid/ExtensionManager>
 #include <cnoid/ItemManager>
 #include <cnoid/MenuManager>
@@ -27,23 +29,38 @@
 #include <cnoid/PutPropertyFunction>
 #include <cnoid/Archive>
 #include <cnoid/MultiDeviceStateSeq>
+#include <cnoid/BodyMotionPager>
+#include <cnoid/DeviceStatePool>
 #include <cnoid/ControllerLogItem>
 #include <cnoid/Timer>
 #include <cnoid/Deque2D>
+#include <cnoid/TripleBuffer>
 #include <cnoid/ConnectionSet>
 #include <cnoid/FloatingNumberString>
 #include <cnoid/SceneGraph>
 #include <cnoid/SceneView>
 #include <cnoid/CloneMap>
+#include <cnoid/Tracer>
 #include <QThread>
 #include <QMutex>
 #include <QElapsedTimer>
 #include <thread>
+#include <chrono>
 #include <mutex>
+#include <atomic>
 #include <condition_variable>
 #include <set>
 #include <deque>
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
 #include <fmt/format.h>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#endif
 #include "gettext.h"
 
 using namespace std;
@@ -52,16 +69,153 @@ using fmt::format;
 
 namespace {
 
+const uint32_t SnapshotMagicNumber = 0x53534e43; // "CNSS"
+const uint32_t SnapshotFormatVersion = 1;
+// The position, the rotation, the velocities, the accelerations and the joint state of a link
+const int SnapshotLinkStateSize = 25;
+
+/*
+  When the record paging is enabled, the records and the controller logs of this time length are
+  kept in the memory and the older ones are moved to the page files so that they can be played back.
+*/
+const double recordPagingMemoryTimeLength = 60.0;
+
 enum { RESOLUTION_TIMESTEP, RESOLUTION_FRAMERATE, RESOLUTION_TIMEBAR, N_TEMPORARL_RESOLUTION_TYPES };
 
 typedef Deque2D<SE3, Eigen::aligned_allocator<SE3> > MultiSE3Deque;
 
+// The number of the simulations locking the process memory
+int numMemoryLockingSimulations = 0;
+
+bool parseCpuList(const string& s, vector<int>& out_cpus)
+{
+    vector<int> cpus;
+    const char* p = s.c_str();
+    while(*p){
+        if(*p == ',' || *p == ' ' || *p == '\t'){
+            ++p;
+            continue;
+        }
+        char* end;
+        long cpu = strtol(p, &end, 10);
+        if(end == p || cpu < 0){
+            return false;
+        }
+        cpus.push_back(cpu);
+        p = end;
+    }
+    out_cpus = cpus;
+    return true;
+}
+
+
+string getCpuListString(const vector<int>& cpus)
+{
+    string s;
+    for(size_t i=0; i < cpus.size(); ++i){
+        if(i > 0){
+            s += ", ";
+        }
+        s += std::to_string(cpus[i]);
+    }
+    return s;
+}
+
+
+/**
+   The current thread is pinned to the CPU if the cpu is not negative, and is scheduled by
+   the SCHED_FIFO policy with the priority if the priority is positive.
+*/
+bool setCurrentThreadRealtimeAttributes(int cpu, int priority, string& out_error)
+{
+#ifdef __linux__
+    bool result = true;
+    if(cpu >= 0){
+        cpu_set_t cpuSet;
+        CPU_ZERO(&cpuSet);
+        CPU_SET(cpu, &cpuSet);
+        int error = pthread_setaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet);
+        if(error){
+            out_error = format(_("The thread cannot be pinned to CPU {0}: {1}"), cpu, strerror(error));
+            result = false;
+        }
+    }
+    if(priority > 0){
+        sched_param param;
+        param.sched_priority = std::min(priority, sched_get_priority_max(SCHED_FIFO));
+        int error = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+        if(error){
+            if(!out_error.empty()){
+                out_error += "\n";
+            }
+            out_error += format(_("The real-time priority {0} cannot be set to the thread: {1}"),
+                                param.sched_priority, strerror(error));
+            result = false;
+        }
+    }
+    return result;
+#else
+    if(cpu >= 0 || priority > 0){
+        out_error = _("The real-time thread mode is not supported on this platform.");
+        return false;
+    }
+    return true;
+#endif
+}
+
+
+bool lockProcessMemory(string& out_error)
+{
+#ifdef __linux__
+    if(mlockall(MCL_CURRENT | MCL_FUTURE) != 0){
+        out_error = format(_("The process memory cannot be locked: {}"), strerror(errno));
+        return false;
+    }
+    return true;
+#else
+    out_error = _("Memory locking is not supported on this platform.");
+    return false;
+#endif
+}
+
+
+void unlockProcessMemory()
+{
+#ifdef __linux__
+    munlockall();
+#endif
+}
+
+
+/**
+   The minor page faults of the current thread are counted as the sign of the memory allocation
+   in the real-time part because the memory newly allocated by the heap is mapped when it is
+   touched first. Zero is always returned on the platforms where the count is not available.
+*/
+long getNumPageFaultsOfCurrentThread()
+{
+#if defined(__linux__) && defined(RUSAGE_THREAD)
+    rusage usage;
+    if(getrusage(RUSAGE_THREAD, &usage) == 0){
+        return usage.ru_minflt + usage.ru_majflt;
+    }
+#endif
+    return 0;
+}
+
+struct KinematicState
+{
+    vector<SE3, Eigen::aligned_allocator<SE3>> linkPositions;
+    vector<double> jointPositions;
+};
+
 typedef map<weak_ref_ptr<BodyItem>, SimulationBodyPtr> BodyItemToSimBodyMap;
 
 struct FunctionSet
 {
     struct FunctionInfo {
         int id;
+        int profilePhaseIndex;
         std::function<void()> function;
     };
     vector<FunctionInfo> functions;
@@ -95,11 +249,96 @@ struct FunctionSet
         }
     }
 
+    void callWithProfiling(SimulationStepProfiler& profiler, const char* label){
+        if(needToUpdate){
+            updateFunctions();
+        }
+        for(auto& info : functions){
+            if(info.profilePhaseIndex < 0){
+                info.profilePhaseIndex = profiler.addPhase(format("{0} #{1}", label, info.id));
+            }
+            auto time = SimulationStepProfiler::Clock::now();
+            info.function();
+            profiler.record(
+                info.profilePhaseIndex,
+                std::chrono::duration<double>(SimulationStepProfiler::Clock::now() - time).count());
+        }
+    }
+
+    void resetProfilePhases(){
+        std::lock_guard<std::mutex> lock(mutex);
+        for(auto& info : functions){
+            info.profilePhaseIndex = -1;
+        }
+        for(auto& info : functionsToAdd){
+            info.profilePhaseIndex = -1;
+        }
+    }
+
     int add(std::function<void()>& func);
     void remove(int id);
     void updateFunctions();
 };
 
+class SnapshotWriter
+{
+public:
+    vector<char>& data;
+    SnapshotWriter(vector<char>& data) : data(data) { }
+    template<class T> void write(const T& value){
+        const char* p = reinterpret_cast<const char*>(&value);
+        data.insert(data.end(), p, p + sizeof(T));
+    }
+    void write(const string& s){
+        write<uint32_t>(s.size());
+        data.insert(data.end(), s.begin(), s.end());
+    }
+    void write(const double* values, int n){
+        const char* p = reinterpret_cast<const char*>(values);
+        data.insert(data.end(), p, p + sizeof(double) * n);
+    }
+};
+
+class SnapshotReader
+{
+public:
+    const char* pos;
+    const char* end;
+    SnapshotReader(const vector<char>& data) : pos(data.data()), end(data.data() + data.size()) { }
+    template<class T> bool read(T& out_value){
+        if(end - pos < static_cast<ptrdiff_t>(sizeof(T))){
+            return false;
+        }
+        std::memcpy(&out_value, pos, sizeof(T));
+        pos += sizeof(T);
+        return true;
+    }
+    bool read(string& out_s){
+        uint32_t size;
+        if(!read(size) || end - pos < static_cast<ptrdiff_t>(size)){
+            return false;
+        }
+        out_s.assign(pos, size);
+        pos += size;
+        return true;
+    }
+    bool read(double* out_values, int n){
+        const size_t size = sizeof(double) * n;
+        if(end - pos < static_cast<ptrdiff_t>(size)){
+            return false;
+        }
+        std::memcpy(out_values, pos, size);
+        pos += size;
+        return true;
+    }
+};
+
+struct SnapshotBodyState
+{
+    vector<double> linkStates;
+    vector<vector<double>> deviceStates;
+};
+
 class ControllerInfo : public Referenced, public ControllerIO
 {
 public:
@@ -107,14 +346,17 @@ public:
     SimulatorItem::Impl* simImpl;
     Body* body_;
 
-    std::thread controlThread;
-    std::condition_variable controlCondition;
-    std::mutex controlMutex;
-    bool isExitingControlLoopRequested;
-    bool isControlRequested;
+    // Accessed in the critical section of ControllerWorkerPool::mutex
     bool isControlFinished;
     bool isControlToBeContinued;
 
+    // Accessed only in the thread executing the control function during the simulation loop
+    int numControlCalls;
+    long numControlPageFaults;
+
+    // Set before the simulation loop is started
+    bool isControlTimeMonitored;
+
     std::mutex logMutex;
     ReferencedPtr lastLogData;
     unique_ptr<ReferencedObjectSeq> logBuf;
@@ -124,6 +366,7 @@ public:
     bool isLogEnabled_;
 
     ControllerInfo(ControllerItem* controller, SimulationBody::Impl* simBodyImpl);
+    bool control(bool doCheckPageFaults);
 
     virtual std::string controllerName() const override;
     virtual Body* body() override;
@@ -139,13 +382,57 @@ public:
 
     virtual bool isNoDelayMode() const override;
     virtual bool setNoDelayMode(bool on) override;
-
-    bool waitForControlInThreadToFinish();
-    void concurrentControlLoop();    
 };
 
 typedef ref_ptr<ControllerInfo> ControllerInfoPtr;
 
+/**
+   The control functions of all the controllers in a simulation step are executed as a batch by
+   a fixed number of worker threads. Each controller is always executed by the same worker thread,
+   which is determined by the order of the controllers, and the controllers assigned to a worker
+   thread are executed in that order.
+*/
+class ControllerWorkerPool
+{
+public:
+    ControllerWorkerPool();
+    ~ControllerWorkerPool();
+
+    /**
+       The worker threads started after this function is called are pinned to the CPUs in the order
+       of the threads, and are scheduled by the SCHED_FIFO policy with the priority if it is positive.
+       The number of the threads is limited to the number of the CPUs if any CPU is specified.
+    */
+    void setRealtimeAttributes(const vector<int>& cpus, int priority, bool doCheckPageFaults);
+    
+    void start(const vector<ControllerInfoPtr>& controllerInfos, int numThreads);
+    void stop();
+    void requestControl();
+    bool waitForControlToFinish(ControllerInfo* info);
+    bool waitForAllControlsToFinish();
+
+private:
+    struct Worker
+    {
+        std::thread thread;
+        int cpu;
+        vector<ControllerInfo*> controllerInfos;
+    };
+    vector<unique_ptr<Worker>> workers;
+    vector<int> cpus;
+    int realtimePriority;
+    bool doCheckPageFaults;
+    vector<ControllerInfo*> controllerInfos;
+    std::mutex mutex;
+    std::condition_variable requestCondition;
+    std::condition_variable finishCondition;
+    int requestCounter;
+    int numRemainingControls;
+    bool isExitRequested;
+
+    void runWorker(Worker* worker);
+};
+
 class SimulationLogEngine : public TimeSyncItemEngine
 {
 public:
@@ -186,18 +473,37 @@ public:
     bool isDynamic;
     bool areShapesCloned;
 
+    // Buffers written in the simulation thread
     Deque2D<double> jointPosBuf;
     MultiSE3Deque linkPosBuf;
+    Deque2D<DeviceStatePtr> deviceStateBuf;
+    vector<DeviceStatePtr> lastDeviceStates;
+    vector<DeviceStatePool> deviceStatePools;
+
+    /*
+      Buffers exchanged with the above buffers when the records are flushed.
+      The records are flushed from these buffers outside the critical section.
+    */
+    Deque2D<double> jointPosFlushBuf;
+    MultiSE3Deque linkPosFlushBuf;
+    Deque2D<DeviceStatePtr> deviceStateFlushBuf;
+
+    /*
+      The latest kinematic state published by the simulation thread for the direct mode,
+      in which the state is reflected to the body item without recording it.
+    */
+    TripleBuffer<KinematicState> publishedKinematicState;
+    
     vector<Device*> devicesToNotifyRecords;
     ScopedConnectionSet deviceStateConnections;
     vector<bool> deviceStateChangeFlag;
-    Deque2D<DeviceStatePtr> deviceStateBuf;
 
     ItemPtr parentOfRecordItems;
     string recordItemPrefix;
     shared_ptr<BodyMotion> motion;
     shared_ptr<MultiValueSeq> jointPosRecord;
     shared_ptr<MultiSE3Seq> linkPosRecord;
+    shared_ptr<BodyMotionPager> recordPager;
     MultiSE3SeqItemPtr linkPosRecordItem;
     vector<DeviceStatePtr> prevFlushedDeviceStateInDirectMode;
     shared_ptr<MultiDeviceStateSeq> deviceStateRecord;
@@ -215,10 +521,12 @@ public:
     void setInitialStateOfBodyMotion(shared_ptr<BodyMotion> bodyMotion);
     void setActive(bool on);
     void bufferRecords();
+    void publishKinematicState();
+    void swapRecordBuffers();
     void flushRecords();
     void flushRecordsToBodyMotionItems();
     void flushRecordsToBody();
-    void flushRecordsToWorldLogFile(int bufferFrame);
+    template<class WorldLogItem> void flushRecordsToWorldLog(WorldLogItem* log, int bufferFrame);
     void notifyRecords(double time);
 };
 
@@ -232,6 +540,7 @@ public:
     vector<SimulationBodyPtr> allSimBodies;
     vector<SimulationBody*> simBodiesWithBody;
     vector<SimulationBody*> activeSimBodies;
+    vector<SimulationBody*> flushingSimBodies;
     vector<ControllerInfoPtr> loggedControllerInfos;
 
     BodyItemToSimBodyMap simBodyMap;
@@ -245,6 +554,7 @@ public:
     double worldTimeStep_;
     int frameAtLastBufferWriting;
     int numBufferedFrames;
+    int frameAtLastFlushBufferWriting;
     Timer flushTimer;
 
     FunctionSet preDynamicsFunctions;
@@ -263,26 +573,56 @@ public:
 
     shared_ptr<CollisionSeq> collisionSeq;
     deque<shared_ptr<CollisionLinkPairList>> collisionPairsBuf;
+    deque<shared_ptr<CollisionLinkPairList>> collisionPairsFlushBuf;
 
     Selection recordingMode;
     Selection timeRangeMode;
     double timeLength;
     int maxFrame;
     int ringBufferSize;
+    // The number of the frames of the link position and joint displacement records kept in memory
+    int pagedRecordBufferSize;
     bool isRecordingEnabled;
     bool isRingBufferMode;
     bool isActiveControlTimeRangeMode;
     bool useControllerThreads;
+    ControllerWorkerPool controllerWorkerPool;
     bool useControllerThreadsProperty;
+    bool isRealtimeThreadModeEnabled;
+    int realtimeThreadPriority;
+    int simulationThreadCpu;
+    vector<int> controllerThreadCpus;
+    bool isControlPageFaultCheckEnabled;
+    bool isControlPageFaultCheckActive;
+    bool isProcessMemoryLocked;
+    std::atomic<bool> isControlOverrunAbortRequested;
     bool isAllLinkPositionOutputMode;
     bool isDeviceStateOutputEnabled;
     bool isDoingSimulationLoop;
     volatile bool stopRequested;
     volatile bool pauseRequested;
     bool isRealtimeSyncMode;
+    bool isStepProfilingEnabled;
+    bool isStepProfilingActive;
+    string stepProfileFile;
+    SimulationStepProfiler stepProfiler;
+    enum StepPhase {
+        PreDynamicsPhase, ControlPhase, MidDynamicsPhase, DynamicsPhase, CollisionOutputPhase,
+        ControlWaitPhase, PostDynamicsPhase, ControllerLogPhase, RecordBufferingPhase,
+        ControlOutputPhase, WholeStepPhase
+    };
+    SimulationStepProfiler::Clock::time_point dynamicsStepLapTime;
+    int dynamicsStepPhaseIndices[NumDynamicsStepPhases];
+    double targetRealtimeFactor;
+    double achievedRealtimeFactor;
+    int frameAtLastRealtimeFactorUpdate;
+    QElapsedTimer realtimeFactorTimer;
+    bool isBatchMode;
     bool needToUpdateSimBodyLists;
     bool hasActiveFreeBodies;
     bool recordCollisionData;
+    bool isCollisionStreamingEnabled;
+    bool isRecordPagingEnabled;
     bool isSceneViewEditModeBlockedDuringSimulation;
 
     string controllerOptionString_;
@@ -306,6 +646,10 @@ public:
     int nextLogFrame;
     double nextLogTime;
     double logTimeStep;
+    WorldLogStreamItemPtr worldLogStreamItem;
+    int nextStreamFrame;
+    double nextStreamTime;
+    double streamTimeStep;
     
     stdx::optional<int> extForceFunctionId;
     std::mutex extForceMutex;
@@ -342,6 +686,8 @@ public:
     void clearSimulation();
     bool startSimulation(bool doReset);
     virtual void run() override;
+    bool runSimulationLoopInBatchMode();
+    void finishSimulationLoop(int frame, double elapsedTime);
     void onSimulationLoopStarted();
     void updateSimBodyLists();
     bool stepSimulationMain();
@@ -351,12 +697,22 @@ public:
     void pauseSimulation();
     void restartSimulation();
     void onSimulationLoopStopped(bool isForced);
+    void putControlTimeSummary(ControllerItem* controller);
+    bool saveSnapshot(std::vector<char>& out_data);
+    bool restoreSnapshot(const std::vector<char>& data);
+    void storeSnapshotBodyStates(vector<SnapshotBodyState>& out_states);
+    bool readSnapshotBodyStates(SnapshotReader& reader, vector<SnapshotBodyState>& out_states);
+    void applySnapshotBodyStates(const vector<SnapshotBodyState>& states);
     void setExternalForce(BodyItem* bodyItem, Link* link, const Vector3& point, const Vector3& f, double time);
     void doSetExternalForce();
     void setVirtualElasticString(
         BodyItem* bodyItem, Link* link, const Vector3& attachmentPoint, const Vector3& endPoint);
     void setVirtualElasticStringForce();
     void onRealtimeSyncChanged(bool on);
+    void updateAchievedRealtimeFactor(int frame);
+    void initializeStepProfiler();
+    void lapDynamicsStepPhase(int phase);
+    void outputStepProfile();
     bool onAllLinkPositionOutputModeChanged(bool on);
     void doPutProperties(PutPropertyFunction& putProperty);
     bool store(Archive& archive);
@@ -506,7 +862,38 @@ ControllerInfo::ControllerInfo(ControllerItem* controller, SimulationBody::Impl*
       simImpl(simBodyImpl->simImpl),
       isLogEnabled_(false)
 {
+    numControlCalls = 0;
+    numControlPageFaults = 0;
+    isControlTimeMonitored = false;
+}
+
+
+/**
+   The page faults in the first call are not counted because the stack and the memory allocated
+   in the initialization are usually touched first in it.
+*/
+bool ControllerInfo::control(bool doCheckPageFaults)
+{
+    if(!doCheckPageFaults && !isControlTimeMonitored){
+        return controller->control();
+    }
+    long numPageFaults = doCheckPageFaults ? getNumPageFaultsOfCurrentThread() : 0;
+    auto startTime = std::chrono::steady_clock::now();
+
+    bool result = controller->control();
 
+    if(isControlTimeMonitored){
+        double time = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+        if(!controller->controlTimeMonitor().record(time) && controller->isAbortOnControlOverrunEnabled()){
+            simImpl->isControlOverrunAbortRequested = true;
+        }
+    }
+    if(doCheckPageFaults && numControlCalls > 0){
+        numControlPageFaults += getNumPageFaultsOfCurrentThread() - numPageFaults;
+    }
+    ++numControlCalls;
+    
+    return result;
 }
 
 
@@ -555,13 +942,14 @@ bool ControllerInfo::enableLog()
     string logName = simImpl->self->name() + "-" + controller->name();
     logItem = controller->findChildItem<ControllerLogItem>(logName);
     if(logItem){
-        logItem->resetSeq();
+        logItem->resetLog();
     } else {
         logItem = controller->createLogItem();
         logItem->setTemporal();
         logItem->setName(logName);
         controller->addChildItem(logItem);
     }
+    logItem->setMemoryTimeLength(simImpl->isRecordPagingEnabled ? recordPagingMemoryTimeLength : 0.0);
     log = logItem->seq();
     log->setNumFrames(0);
     log->setFrameRate(simImpl->worldFrameRate);
@@ -618,6 +1006,7 @@ void ControllerInfo::flushLog()
         }
         logBuf->clear();
         logBufFrameOffset += numBufFrames;
+        logItem->pageOutOldFrames();
     }
 }
 
@@ -848,6 +1237,11 @@ void SimulationBody::Impl::initializeRecordBuffers()
     }
     linkPosBuf.resizeColumn(numLinksToRecord);
 
+    jointPosFlushBuf.clear();
+    linkPosFlushBuf.clear();
+    deviceStateFlushBuf.clear();
+    publishedKinematicState.clear();
+
     const DeviceList<>& devices = body_->devices();
     const int numDevices = devices.size();
     deviceStateConnections.disconnect();
@@ -857,16 +1251,15 @@ void SimulationBody::Impl::initializeRecordBuffers()
     
     if(devices.empty() || !simImpl->isDeviceStateOutputEnabled){
         deviceStateBuf.clear();
+        lastDeviceStates.clear();
+        deviceStatePools.clear();
         prevFlushedDeviceStateInDirectMode.clear();
     } else {
-        /**
-           Temporary code to avoid a bug in storing device states by reserving sufficient buffer size.
-           The original bug is in Deque2D's resize operation.
-        */
-        deviceStateBuf.resize(100, numDevices); 
-        
-        // This buf always has the first element to keep unchanged states
-        deviceStateBuf.resize(1, numDevices); 
+        deviceStateBuf.resizeColumn(numDevices);
+        // This keeps the last states so that unchanged states can be shared
+        lastDeviceStates.resize(numDevices);
+        deviceStatePools.clear();
+        deviceStatePools.resize(numDevices);
         prevFlushedDeviceStateInDirectMode.resize(numDevices);
         for(size_t i=0; i < devices.size(); ++i){
             deviceStateConnections.add(
@@ -911,6 +1304,18 @@ void SimulationBody::Impl::initializeRecordItems()
     linkPosRecordItem = motionItem->linkPosSeqItem();
     linkPosRecord = motion->linkPosSeq();
 
+    recordPager.reset();
+    if(simImpl->isRecordPagingEnabled && !simImpl->isRingBufferMode){
+        recordPager = make_shared<BodyMotionPager>();
+        if(!recordPager->open(linkPosBuf.colSize(), jointPosBuf.colSize())){
+            simImpl->mv->putln(
+                format(_("The page file of the records of {0} cannot be created."), body_->name()),
+                MessageView::Warning);
+            recordPager.reset();
+        }
+    }
+    motion->setPager(recordPager);
+
     const int numDevices = deviceStateBuf.colSize();
     if(numDevices == 0 || !simImpl->isDeviceStateOutputEnabled){
         clearMultiDeviceStateSeq(*motion);
@@ -1016,29 +1421,68 @@ void SimulationBody::Impl::bufferRecords()
             pos[i].set(link->p(), link->R());
         }
     }
+    if(!simImpl->isRecordingEnabled){
+        publishKinematicState();
+    }
     if(deviceStateBuf.colSize() > 0){
-        const int prevIndex = std::max(0, deviceStateBuf.rowSize() - 1);
         Deque2D<DeviceStatePtr>::Row current = deviceStateBuf.append();
-        Deque2D<DeviceStatePtr>::Row prev = deviceStateBuf[prevIndex];
         const DeviceList<>& devices = body_->devices();
         for(size_t i=0; i < devices.size(); ++i){
             if(deviceStateChangeFlag[i]){
-                current[i] = devices[i]->cloneState();
+                lastDeviceStates[i] = deviceStatePools[i].getStateCopy(*devices[i]);
                 deviceStateChangeFlag[i] = false;
-            } else {
-                current[i] = prev[i];
             }
+            current[i] = lastDeviceStates[i];
         }
     }
 }
 
 
+void SimulationBody::Impl::publishKinematicState()
+{
+    KinematicState& state = publishedKinematicState.writeBuffer();
+    const int numLinks = linkPosBuf.colSize();
+    state.linkPositions.resize(numLinks);
+    for(int i=0; i < numLinks; ++i){
+        Link* link = body_->link(i);
+        state.linkPositions[i].set(link->p(), link->R());
+    }
+    const int numJoints = body_->numJoints();
+    state.jointPositions.resize(numJoints);
+    for(int i=0; i < numJoints; ++i){
+        state.jointPositions[i] = body_->joint(i)->q();
+    }
+    publishedKinematicState.publish();
+}
+
+
+/**
+   This function must be called in the critical section of recordBufMutex.
+   The flush buffers must have been emptied by flushRecords before calling this function.
+   Since the memory of the buffers is kept when they are emptied, appending the records
+   to the exchanged buffers does not reallocate the memory in the steady state.
+*/
+void SimulationBody::Impl::swapRecordBuffers()
+{
+    jointPosBuf.swap(jointPosFlushBuf);
+    jointPosBuf.resize(0, jointPosFlushBuf.colSize());
+    linkPosBuf.swap(linkPosFlushBuf);
+    linkPosBuf.resize(0, linkPosFlushBuf.colSize());
+    deviceStateBuf.swap(deviceStateFlushBuf);
+    deviceStateBuf.resize(0, deviceStateFlushBuf.colSize());
+}
+
+
 void SimulationBody::flushRecords()
 {
     impl->flushRecords();
 }
 
 
+/**
+   This function flushes the records exchanged by swapRecordBuffers and can be executed
+   without locking recordBufMutex.
+*/
 void SimulationBody::Impl::flushRecords()
 {
     if(simImpl->isRecordingEnabled){
@@ -1048,12 +1492,9 @@ void SimulationBody::Impl::flushRecords()
     }
 
     // clear buffers
-    linkPosBuf.resizeRow(0);
-    jointPosBuf.resizeRow(0);
-
-    // keep the last state so that unchanged states can be shared
-    const int numPops = (deviceStateBuf.rowSize() >= 2) ? (deviceStateBuf.rowSize() - 1) : 0;
-    deviceStateBuf.pop_front(numPops);
+    linkPosFlushBuf.resizeRow(0);
+    jointPosFlushBuf.resizeRow(0);
+    deviceStateFlushBuf.resizeRow(0);
 }
 
 
@@ -1063,15 +1504,23 @@ void SimulationBody::Impl::flushRecordsToBodyMotionItems()
         initializeRecordItems();
     }
 
+    /*
+      Only the link positions and the joint displacements are paged out, so the other records
+      are trimmed with the original ring buffer size.
+    */
     const int ringBufferSize = simImpl->ringBufferSize;
-    const int numBufFrames = linkPosBuf.rowSize();
-    const int nextFrame = simImpl->currentFrame + 1;
+    const int kinematicRecordBufferSize = recordPager ? simImpl->pagedRecordBufferSize : ringBufferSize;
+    const int numBufFrames = linkPosFlushBuf.rowSize();
+    const int nextFrame = simImpl->frameAtLastFlushBufferWriting + 1;
 
-    if(linkPosBuf.colSize() > 0){
+    if(linkPosFlushBuf.colSize() > 0){
         bool offsetChanged = false;
         for(int i=0; i < numBufFrames; ++i){
-            auto buf = linkPosBuf.row(i);
-            if(linkPosRecord->numFrames() >= ringBufferSize){
+            auto buf = linkPosFlushBuf.row(i);
+            if(linkPosRecord->numFrames() >= kinematicRecordBufferSize){
+                if(recordPager){
+                    recordPager->appendLinkPositions(linkPosRecord->frame(0).begin());
+                }
                 linkPosRecord->popFrontFrame();
                 offsetChanged = true;
             }
@@ -1081,11 +1530,14 @@ void SimulationBody::Impl::flushRecordsToBodyMotionItems()
             linkPosRecord->setOffsetTimeFrame(nextFrame - linkPosRecord->numFrames());
         }
     }
-    if(jointPosBuf.colSize() > 0){
+    if(jointPosFlushBuf.colSize() > 0){
         bool offsetChanged = false;
-        for(int i=0; i < numBufFrames; ++i){
-            auto buf = jointPosBuf.row(i);
-            if(jointPosRecord->numFrames() >= ringBufferSize){
+        for(int i=0; i < jointPosFlushBuf.rowSize(); ++i){
+            auto buf = jointPosFlushBuf.row(i);
+            if(jointPosRecord->numFrames() >= kinematicRecordBufferSize){
+                if(recordPager){
+                    recordPager->appendJointDisplacements(jointPosRecord->frame(0).begin());
+                }
                 jointPosRecord->popFrontFrame();
                 offsetChanged = true;
             }
@@ -1095,11 +1547,10 @@ void SimulationBody::Impl::flushRecordsToBodyMotionItems()
             jointPosRecord->setOffsetTimeFrame(nextFrame - jointPosRecord->numFrames());
         }
     }
-    if(deviceStateBuf.colSize() > 0){
+    if(deviceStateFlushBuf.colSize() > 0){
         bool offsetChanged = false;
-        // This loop begins with the second element to skip the first element to keep the unchanged states
-        for(int i=1; i < deviceStateBuf.rowSize(); ++i){ 
-            auto buf = deviceStateBuf.row(i);
+        for(int i=0; i < deviceStateFlushBuf.rowSize(); ++i){ 
+            auto buf = deviceStateFlushBuf.row(i);
             if(deviceStateRecord->numFrames() >= ringBufferSize){
                 deviceStateRecord->popFrontFrame();
                 offsetChanged = true;
@@ -1113,30 +1564,32 @@ void SimulationBody::Impl::flushRecordsToBodyMotionItems()
 }
 
 
+/**
+   The kinematic state is taken from the latest state published by the simulation thread
+   instead of the flushed records so that the body item always reflects a complete state of
+   the most recent frame.
+*/
 void SimulationBody::Impl::flushRecordsToBody()
 {
     Body* orgBody = bodyItem->body();
-    if(!linkPosBuf.empty()){
-        auto last = linkPosBuf.last();
-        const int n = last.size();
-        for(int i=0; i < n; ++i){
-            SE3& pos = last[i];
+    if(publishedKinematicState.update()){
+        const KinematicState& state = publishedKinematicState.readBuffer();
+        const int numLinks = state.linkPositions.size();
+        for(int i=0; i < numLinks; ++i){
+            const SE3& pos = state.linkPositions[i];
             Link* link = orgBody->link(i);
             link->p() = pos.translation();
             link->R() = pos.rotation().toRotationMatrix();
         }
-    }
-    if(!jointPosBuf.empty()){
-        auto last = jointPosBuf.last();
-        const int n = body_->numJoints();
-        for(int i=0; i < n; ++i){
-            orgBody->joint(i)->q() = last[i];
+        const int numJoints = state.jointPositions.size();
+        for(int i=0; i < numJoints; ++i){
+            orgBody->joint(i)->q() = state.jointPositions[i];
         }
     }
-    if(!deviceStateBuf.empty()){
+    if(!deviceStateFlushBuf.empty()){
         devicesToNotifyRecords.clear();
         const DeviceList<>& devices = orgBody->devices();
-        auto ds = deviceStateBuf.last();
+        auto ds = deviceStateFlushBuf.last();
         const int ndevices = devices.size();
         for(int i=0; i < ndevices; ++i){
             const DeviceStatePtr& s = ds[i];
@@ -1151,24 +1604,26 @@ void SimulationBody::Impl::flushRecordsToBody()
 }
 
 
-void SimulationBody::Impl::flushRecordsToWorldLogFile(int bufferFrame)
+/**
+   The log is WorldLogFileItem or WorldLogStreamItem, which have the same output functions.
+*/
+template<class WorldLogItem>
+void SimulationBody::Impl::flushRecordsToWorldLog(WorldLogItem* log, int bufferFrame)
 {
     //if(bufferFrame < linkPosBuf.rowSize()){
     
-    WorldLogFileItem* log = simImpl->worldLogFileItem;
     log->beginBodyStateOutput();
 
-    if(linkPosBuf.colSize() > 0){
-        auto posbuf = linkPosBuf.row(bufferFrame);
+    if(linkPosFlushBuf.colSize() > 0){
+        auto posbuf = linkPosFlushBuf.row(bufferFrame);
         log->outputLinkPositions(posbuf.begin(), posbuf.size());
     }
-    if(jointPosBuf.colSize() > 0){
-        auto jointbuf = jointPosBuf.row(bufferFrame);
+    if(jointPosFlushBuf.colSize() > 0){
+        auto jointbuf = jointPosFlushBuf.row(bufferFrame);
         log->outputJointPositions(jointbuf.begin(), jointbuf.size());
     }
-    if(deviceStateBuf.colSize() > 0){
-        // Skip the first element because it is used for sharing an unchanged state
-        auto states = deviceStateBuf.row(bufferFrame + 1);
+    if(deviceStateFlushBuf.colSize() > 0){
+        auto states = deviceStateFlushBuf.row(bufferFrame);
         log->beginDeviceStateOutput();
         for(int i=0; i < states.size(); ++i){
             log->outputDeviceState(states[i]);
@@ -1234,6 +1689,7 @@ SimulatorItem::Impl::Impl(SimulatorItem* self)
     worldFrameRate = 1.0;
     worldTimeStep_ = 1.0;
     frameAtLastBufferWriting = 0;
+    frameAtLastFlushBufferWriting = 0;
     flushTimer.sigTimeout().connect([&](){ flushRecords(); });
 
     recordingMode.setSymbol(FullRecording, N_("full"));
@@ -1248,12 +1704,27 @@ SimulatorItem::Impl::Impl(SimulatorItem* self)
 
     timeLength = 180.0; // 3 min.
     useControllerThreadsProperty = true;
+    isRealtimeThreadModeEnabled = false;
+    realtimeThreadPriority = 80;
+    simulationThreadCpu = -1;
+    isControlPageFaultCheckEnabled = true;
+    isControlPageFaultCheckActive = false;
+    isProcessMemoryLocked = false;
+    isControlOverrunAbortRequested = false;
     isActiveControlTimeRangeMode = false;
     isAllLinkPositionOutputMode = true;
     isDeviceStateOutputEnabled = true;
     isDoingSimulationLoop = false;
     isRealtimeSyncMode = true;
+    isStepProfilingEnabled = false;
+    isStepProfilingActive = false;
+    targetRealtimeFactor = 1.0;
+    achievedRealtimeFactor = 0.0;
+    frameAtLastRealtimeFactorUpdate = 0;
+    isBatchMode = false;
     recordCollisionData = false;
+    isCollisionStreamingEnabled = false;
+    isRecordPagingEnabled = false;
     isSceneViewEditModeBlockedDuringSimulation = false;
 
     timeBar = TimeBar::instance();
@@ -1279,11 +1750,25 @@ SimulatorItem::Impl::Impl(SimulatorItem* self, const Impl& org)
 
     timeLength = org.timeLength;
     useControllerThreadsProperty = org.useControllerThreadsProperty;
+    isRealtimeThreadModeEnabled = org.isRealtimeThreadModeEnabled;
+    realtimeThreadPriority = org.realtimeThreadPriority;
+    simulationThreadCpu = org.simulationThreadCpu;
+    controllerThreadCpus = org.controllerThreadCpus;
+    isControlPageFaultCheckEnabled = org.isControlPageFaultCheckEnabled;
+    isControlPageFaultCheckActive = false;
+    isProcessMemoryLocked = false;
+    isControlOverrunAbortRequested = false;
     isActiveControlTimeRangeMode = org.isActiveControlTimeRangeMode;
     isAllLinkPositionOutputMode = org.isAllLinkPositionOutputMode;
     isDeviceStateOutputEnabled = org.isDeviceStateOutputEnabled;
     isRealtimeSyncMode = org.isRealtimeSyncMode;
+    isStepProfilingEnabled = org.isStepProfilingEnabled;
+    stepProfileFile = org.stepProfileFile;
+    targetRealtimeFactor = org.targetRealtimeFactor;
+    isBatchMode = org.isBatchMode;
     recordCollisionData = org.recordCollisionData;
+    isCollisionStreamingEnabled = false;
+    isRecordPagingEnabled = org.isRecordPagingEnabled;
     controllerOptionString_ = org.controllerOptionString_;
 }
     
@@ -1396,6 +1881,70 @@ void SimulatorItem::setRealtimeSyncMode(bool on)
 }
 
 
+void SimulatorItem::setStepProfilingEnabled(bool on)
+{
+    impl->isStepProfilingEnabled = on;
+}
+
+
+bool SimulatorItem::isStepProfilingEnabled() const
+{
+    return impl->isStepProfilingEnabled;
+}
+
+
+void SimulatorItem::setStepProfileFile(const std::string& filename)
+{
+    impl->stepProfileFile = filename;
+}
+
+
+/**
+   The profiler can be used to add the phases measured by the inherited class.
+   The measurement functions must be called in the simulation thread.
+*/
+SimulationStepProfiler* SimulatorItem::stepProfiler()
+{
+    return impl->isStepProfilingActive ? &impl->stepProfiler : nullptr;
+}
+
+
+void SimulatorItem::lapDynamicsStepPhase(int phase)
+{
+    if(impl->isStepProfilingActive){
+        impl->lapDynamicsStepPhase(phase);
+    }
+}
+
+
+//! The phases are added when they are first measured so that only the measured ones are shown
+void SimulatorItem::Impl::lapDynamicsStepPhase(int phase)
+{
+    static const char* phaseNames[] = {
+        "Dynamics: state input", "Dynamics: engine step", "Dynamics: state output"
+    };
+    int& index = dynamicsStepPhaseIndices[phase];
+    if(index < 0){
+        index = stepProfiler.addPhase(phaseNames[phase]);
+    }
+    auto now = SimulationStepProfiler::Clock::now();
+    stepProfiler.record(index, std::chrono::duration<double>(now - dynamicsStepLapTime).count());
+    dynamicsStepLapTime = now;
+}
+
+
+void SimulatorItem::setBatchMode(bool on)
+{
+    impl->isBatchMode = on;
+}
+
+
+bool SimulatorItem::isBatchMode() const
+{
+    return impl->isBatchMode;
+}
+
+
 void SimulatorItem::setDeviceStateOutputEnabled(bool on)
 {
     impl->isDeviceStateOutputEnabled = on;
@@ -1518,6 +2067,7 @@ int FunctionSet::add(std::function<void()>& func)
     std::lock_guard<std::mutex> lock(mutex);
     
     FunctionInfo info;
+    info.profilePhaseIndex = -1;
     info.function = func;
     while(true){
         if(registerdIds.insert(idCounter).second){
@@ -1654,6 +2204,16 @@ bool SimulatorItem::Impl::startSimulation(bool doReset)
 
     cloneMap.clear();
 
+    // The clone map is expanded in advance for the links and devices of the bodies
+    size_t numObjectsToClone = 0;
+    for(size_t i=0; i < targetItems.size(); ++i){
+        if(auto bodyItem = dynamic_cast<BodyItem*>(targetItems.get(i))){
+            auto body = bodyItem->body();
+            numObjectsToClone += body->numLinks() + body->numDevices() + 1;
+        }
+    }
+    cloneMap.reserve(numObjectsToClone);
+
     currentFrame = 0;
     worldTimeStep_ = self->worldTimeStep();
     worldFrameRate = 1.0 / worldTimeStep_;
@@ -1803,9 +2363,12 @@ bool SimulatorItem::Impl::startSimulation(bool doReset)
         }
 
         numBufferedFrames = 1;
+
+        initializeStepProfiler();
     
         if(isRecordingEnabled && recordCollisionData){
             collisionPairsBuf.clear();
+            collisionPairsFlushBuf.clear();
             string collisionSeqName = self->name() + "-collisions";
             auto collisionSeqItem = worldItem->findChildItem<CollisionSeqItem>(collisionSeqName);
             if(!collisionSeqItem){
@@ -1818,6 +2381,7 @@ bool SimulatorItem::Impl::startSimulation(bool doReset)
             collisionSeq = collisionSeqItem->collisionSeq();
             collisionSeq->setFrameRate(worldFrameRate);
             collisionSeq->setNumParts(1);
+            collisionSeq->clearLog();
             collisionSeq->setNumFrames(1);
             CollisionSeq::Frame frame0 = collisionSeq->frame(0);
             frame0[0]  = std::make_shared<CollisionLinkPairList>();
@@ -1842,18 +2406,46 @@ bool SimulatorItem::Impl::startSimulation(bool doReset)
         } else {
             maxFrame = std::numeric_limits<int>::max();
         }
+        pagedRecordBufferSize = ringBufferSize;
+        if(isRecordPagingEnabled && !isRingBufferMode){
+            pagedRecordBufferSize =
+                std::max(1, static_cast<int>(recordPagingMemoryTimeLength / worldTimeStep_));
+        }
 
-        useControllerThreads = useControllerThreadsProperty;
-        if(useControllerThreads){
-            for(auto& info : activeControllerInfos){
-                info->isExitingControlLoopRequested = false;
-                info->isControlRequested = false;
-                info->isControlFinished = false;
-                info->isControlToBeContinued = false;
-                info->controlThread = std::thread([info](){ info->concurrentControlLoop(); });
+        isControlPageFaultCheckActive = false;
+        if(isRealtimeThreadModeEnabled){
+            string error;
+            if(!isProcessMemoryLocked){
+                if(numMemoryLockingSimulations > 0 || lockProcessMemory(error)){
+                    isProcessMemoryLocked = true;
+                    ++numMemoryLockingSimulations;
+                } else {
+                    mv->putln(error, MessageView::Warning);
+                }
+            }
+            // The page faults in the control functions are only meaningful after the memory is locked
+            isControlPageFaultCheckActive = isControlPageFaultCheckEnabled && isProcessMemoryLocked;
+            controllerWorkerPool.setRealtimeAttributes(
+                controllerThreadCpus, realtimeThreadPriority, isControlPageFaultCheckActive);
+        } else {
+            controllerWorkerPool.setRealtimeAttributes(vector<int>(), 0, false);
+        }
+        isControlOverrunAbortRequested = false;
+        for(auto& info : activeControllerInfos){
+            info->numControlCalls = 0;
+            info->numControlPageFaults = 0;
+            auto& controller = info->controller;
+            info->isControlTimeMonitored = (controller->controlTimeBudget() > 0.0);
+            if(info->isControlTimeMonitored){
+                controller->controlTimeMonitor().reset(controller->controlTimeBudget());
             }
         }
 
+        useControllerThreads = useControllerThreadsProperty && !activeControllerInfos.empty();
+        if(useControllerThreads){
+            controllerWorkerPool.start(activeControllerInfos, std::thread::hardware_concurrency());
+        }
+
         aboutToQuitConnection.disconnect();
         aboutToQuitConnection = App::sigAboutToQuit().connect(
             [&](){ stopSimulation(true, true); });
@@ -1891,13 +2483,42 @@ bool SimulatorItem::Impl::startSimulation(bool doReset)
             }
         }
 
-        if(isRecordingEnabled){
+        worldLogStreamItem = nullptr;
+        auto worldLogStreamItems = self->descendantItems<WorldLogStreamItem>();
+        if(worldLogStreamItems.empty()){
+            worldLogStreamItems = worldItem->descendantItems<WorldLogStreamItem>();
+        }
+        worldLogStreamItem = worldLogStreamItems.toSingle(true);
+        if(worldLogStreamItem && !worldLogStreamItem->startStreaming()){
+            worldLogStreamItem = nullptr;
+        }
+        isCollisionStreamingEnabled = false;
+        if(worldLogStreamItem){
+            worldLogStreamItem->beginHeaderOutput();
+            for(size_t i=0; i < activeSimBodies.size(); ++i){
+                worldLogStreamItem->outputBodyHeader(activeSimBodies[i]->impl->body_->name());
+            }
+            worldLogStreamItem->endHeaderOutput();
+            nextStreamFrame = 0;
+            nextStreamTime = 0.0;
+            streamTimeStep = 1.0 / worldLogStreamItem->streamingFrameRate();
+            isCollisionStreamingEnabled = worldLogStreamItem->isContactStreamingEnabled();
+        }
+
+        if(isRecordingEnabled && !isBatchMode){
             logEngine->startOngoingTimeUpdate(0.0);
         }
 
+        achievedRealtimeFactor = 0.0;
+        frameAtLastRealtimeFactorUpdate = 0;
+        realtimeFactorTimer.start();
+
         flushRecords();
-        start();
-        flushTimer.start(1000.0 / timeBar->playbackFrameRate());
+
+        if(!isBatchMode){
+            start();
+            flushTimer.start(1000.0 / timeBar->playbackFrameRate());
+        }
 
         mv->notify(format(_("Simulation by {} has started."), self->displayName()));
 
@@ -1905,7 +2526,7 @@ bool SimulatorItem::Impl::startSimulation(bool doReset)
     }
 
     if(result){
-        if(isSceneViewEditModeBlockedDuringSimulation){
+        if(isSceneViewEditModeBlockedDuringSimulation && !isBatchMode){
             SceneView::blockEditModeForAllViews(self);
         }
     } else {
@@ -2011,6 +2632,15 @@ SimulationBody* SimulatorItem::findSimulationBody(const std::string& name)
 // Simulation loop
 void SimulatorItem::Impl::run()
 {
+    if(isRealtimeThreadModeEnabled){
+        string error;
+        if(!setCurrentThreadRealtimeAttributes(simulationThreadCpu, realtimeThreadPriority, error)){
+            mv->putln(error, MessageView::Warning);
+        }
+    }
+
+    Tracer::setThreadName("Simulation");
+    
     self->initializeSimulationThread();
 
     double elapsedTime = 0.0;
@@ -2023,7 +2653,8 @@ void SimulatorItem::Impl::run()
     if(isRealtimeSyncMode){
         const double dt = worldTimeStep_;
         const double compensationRatio = (dt > 0.1) ? 0.1 : dt;
-        const double dtms = dt * 1000.0;
+        // The wall clock time [ms] spent for a simulation step
+        const double dtms = dt * 1000.0 / targetRealtimeFactor;
         double compensatedSimulationTime = 0.0;
         while(true){
             if(pauseRequested){
@@ -2031,7 +2662,7 @@ void SimulatorItem::Impl::run()
                     break;
                 }
                 if(!isOnPause){
-                    elapsedTime += timer.elapsed();
+                    elapsedTime += timer.nsecsElapsed() / 1.0e6;
                     isOnPause = true;
                     sigSimulationPaused();
                 }
@@ -2045,9 +2676,10 @@ void SimulatorItem::Impl::run()
                 if(!stepSimulationMain() || stopRequested || frame >= maxFrame){
                     break;
                 }
-                double diff = (double)compensatedSimulationTime - (elapsedTime + timer.elapsed());
-                if(diff >= 1.0){
-                    QThread::msleep(diff);
+                double diff = compensatedSimulationTime - (elapsedTime + timer.nsecsElapsed() / 1.0e6);
+                if(diff > 0.0){
+                    // QThread::msleep cannot keep the sub-millisecond time steps
+                    std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(diff));
                 } else if(diff < 0.0){
                     const double compensationTime = -diff * compensationRatio;
                     compensatedSimulationTime += compensationTime;
@@ -2068,7 +2700,7 @@ void SimulatorItem::Impl::run()
                     break;
                 }
                 if(!isOnPause){
-                    elapsedTime += timer.elapsed();
+                    elapsedTime += timer.nsecsElapsed() / 1.0e6;
                     isOnPause = true;
                     sigSimulationPaused();
                 }
@@ -2087,23 +2719,10 @@ void SimulatorItem::Impl::run()
     }
 
     if(!isOnPause){
-    	elapsedTime += timer.elapsed();
+    	elapsedTime += timer.nsecsElapsed() / 1.0e6;
     }
-    actualSimulationTime = (elapsedTime / 1000.0);
-    finishTime = frame / worldFrameRate;
-
-    isDoingSimulationLoop = false;
 
-    if(useControllerThreads){
-        for(auto& info : activeControllerInfos){
-            {
-                std::lock_guard<std::mutex> lock(info->controlMutex);
-                info->isExitingControlLoopRequested = true;
-            }
-            info->controlCondition.notify_all();
-            info->controlThread.join();
-        }
-    }
+    finishSimulationLoop(frame, elapsedTime);
 
     if(!isWaitingForSimulationToStop){
         callLater([&](){ onSimulationLoopStopped(isForcedToStopSimulation); });
@@ -2113,23 +2732,103 @@ void SimulatorItem::Impl::run()
 }
 
 
-bool SimulatorItem::Impl::stepSimulationMain()
+bool SimulatorItem::runSimulationLoopInBatchMode()
 {
-    currentFrame++;
+    return impl->runSimulationLoopInBatchMode();
+}
 
-    if(needToUpdateSimBodyLists){
-        updateSimBodyLists();
+
+/**
+   The simulation loop executed in the caller's thread.
+   The buffered records are flushed in this loop because the flush timer is not available.
+*/
+bool SimulatorItem::Impl::runSimulationLoopInBatchMode()
+{
+    if(!isBatchMode || !isDoingSimulationLoop){
+        return false;
     }
     
-    bool doContinue = !doStopSimulationWhenNoActiveControllers;
-
-    preDynamicsFunctions.call();
+    self->initializeSimulationThread();
+
+    QElapsedTimer timer;
+    timer.start();
+
+    const int flushInterval = std::max(1, static_cast<int>(worldFrameRate / 10.0));
+    int frame = 0;
+    
+    while(true){
+        if(!stepSimulationMain() || stopRequested || frame++ >= maxFrame){
+            break;
+        }
+        if(numBufferedFrames >= flushInterval){
+            flushRecords();
+        }
+    }
+
+    finishSimulationLoop(frame, timer.elapsed());
+
+    flushRecords();
+
+    self->finalizeSimulationThread();
+
+    return !isForcedToStopSimulation;
+}
+
+
+void SimulatorItem::Impl::finishSimulationLoop(int frame, double elapsedTime)
+{
+    actualSimulationTime = (elapsedTime / 1000.0);
+    finishTime = frame / worldFrameRate;
+
+    isDoingSimulationLoop = false;
+
+    if(useControllerThreads){
+        controllerWorkerPool.stop();
+    }
+}
+
+
+void SimulatorItem::finishBatchSimulation()
+{
+    if(impl->isBatchMode && !impl->isDoingSimulationLoop && !impl->allSimBodies.empty()){
+        impl->onSimulationLoopStopped(impl->isForcedToStopSimulation);
+    }
+}
+
+
+bool SimulatorItem::Impl::stepSimulationMain()
+{
+    CNOID_TRACE_ZONE("Simulation step", "Simulation");
+
+    const bool isProfiling = isStepProfilingActive;
+    SimulationStepProfiler::Clock::time_point stepStartTime;
+    if(isProfiling){
+        stepProfiler.beginStep();
+        stepStartTime = SimulationStepProfiler::Clock::now();
+    }
+    
+    currentFrame++;
+
+    if(needToUpdateSimBodyLists){
+        updateSimBodyLists();
+    }
+    
+    bool doContinue = !doStopSimulationWhenNoActiveControllers;
+
+    if(!isProfiling){
+        CNOID_TRACE_ZONE("Pre-dynamics functions", "Simulation");
+        preDynamicsFunctions.call();
+    } else {
+        preDynamicsFunctions.callWithProfiling(stepProfiler, "Pre-dynamics function");
+        stepProfiler.lap(PreDynamicsPhase);
+    }
 
     if(!useControllerThreads){
+        CNOID_TRACE_ZONE("Control", "Simulation");
         for(auto& info : activeControllerInfos){
             auto& controller = info->controller;
             controller->input();
-            doContinue |= controller->control();
+            doContinue |= info->control(isControlPageFaultCheckActive);
             if(controller->isNoDelayMode()){
                 controller->output();
             }
@@ -2141,19 +2840,16 @@ bool SimulatorItem::Impl::stepSimulationMain()
             if(controller->isNoDelayMode()){
                 hasNoDelayModeControllers = true;
             }
-            info->controller->input();
-            {
-                std::lock_guard<std::mutex> lock(info->controlMutex);                
-                info->isControlRequested = true;
-            }
-            info->controlCondition.notify_all();
+            controller->input();
         }
+        controllerWorkerPool.requestControl();
+        
         if(hasNoDelayModeControllers){
             // Todo: Process the controller that finishes control earlier first to
             // reduce the total elapsed time before finishing all the output functions.
             for(auto& info : activeControllerInfos){
                 if(info->controller->isNoDelayMode()){
-                    if(info->waitForControlInThreadToFinish()){
+                    if(controllerWorkerPool.waitForControlToFinish(info)){
                         doContinue = true;
                     }
                     info->controller->output();
@@ -2162,32 +2858,60 @@ bool SimulatorItem::Impl::stepSimulationMain()
         }
     }
 
-    midDynamicsFunctions.call();
+    if(!isProfiling){
+        CNOID_TRACE_ZONE("Mid-dynamics functions", "Simulation");
+        midDynamicsFunctions.call();
+    } else {
+        stepProfiler.lap(ControlPhase);
+        midDynamicsFunctions.callWithProfiling(stepProfiler, "Mid-dynamics function");
+        stepProfiler.lap(MidDynamicsPhase);
+        dynamicsStepLapTime = SimulationStepProfiler::Clock::now();
+    }
+
+    {
+        CNOID_TRACE_ZONE("Dynamics", "Simulation");
+        self->stepSimulation(activeSimBodies);
+    }
 
-    self->stepSimulation(activeSimBodies);
+    if(isProfiling){
+        stepProfiler.lap(DynamicsPhase);
+    }
 
     shared_ptr<CollisionLinkPairList> collisionPairs;
-    if(isRecordingEnabled && recordCollisionData){
+    if((isRecordingEnabled && recordCollisionData) || isCollisionStreamingEnabled){
+        CNOID_TRACE_ZONE("Collision output", "Simulation");
         collisionPairs = self->getCollisions();
+        if(isProfiling){
+            stepProfiler.lap(CollisionOutputPhase);
+        }
     }
 
     if(useControllerThreads){
-        for(auto& info : activeControllerInfos){
-            if(!info->controller->isNoDelayMode()){
-                if(info->waitForControlInThreadToFinish()){
-                    doContinue = true;
-                }
-            }
+        CNOID_TRACE_ZONE("Control wait", "Simulation");
+        if(controllerWorkerPool.waitForAllControlsToFinish()){
+            doContinue = true;
         }
     }
 
-    postDynamicsFunctions.call();
+    if(!isProfiling){
+        CNOID_TRACE_ZONE("Post-dynamics functions", "Simulation");
+        postDynamicsFunctions.call();
+    } else {
+        stepProfiler.lap(ControlWaitPhase);
+        postDynamicsFunctions.callWithProfiling(stepProfiler, "Post-dynamics function");
+        stepProfiler.lap(PostDynamicsPhase);
+    }
 
     for(auto& controller : loggingControllers){
         controller->log();
     }
 
+    if(isProfiling){
+        stepProfiler.lap(ControllerLogPhase);
+    }
+
     {
+        CNOID_TRACE_ZONE("Record buffering", "Simulation");
         recordBufMutex.lock();
 
         ++numBufferedFrames;
@@ -2200,59 +2924,253 @@ bool SimulatorItem::Impl::stepSimulationMain()
         recordBufMutex.unlock();
     }
 
+    if(isProfiling){
+        stepProfiler.lap(RecordBufferingPhase);
+    }
+
     for(auto& info : activeControllerInfos){
         if(!info->controller->isNoDelayMode()){
             info->controller->output();
         }
     }
 
+    if(isProfiling){
+        stepProfiler.lap(ControlOutputPhase);
+        stepProfiler.record(
+            WholeStepPhase,
+            std::chrono::duration<double>(SimulationStepProfiler::Clock::now() - stepStartTime).count());
+    }
+
+    if(isControlOverrunAbortRequested){
+        return false;
+    }
+
     return doContinue;
 }
 
 
+void SimulatorItem::Impl::initializeStepProfiler()
+{
+    stepProfiler.clear();
+    isStepProfilingActive = isStepProfilingEnabled;
+    
+    if(isStepProfilingActive){
+        // The order must be the same as StepPhase
+        stepProfiler.addPhase("Pre-dynamics functions");
+        stepProfiler.addPhase("Control");
+        stepProfiler.addPhase("Mid-dynamics functions");
+        stepProfiler.addPhase("Dynamics");
+        stepProfiler.addPhase("Collision output");
+        stepProfiler.addPhase("Control wait");
+        stepProfiler.addPhase("Post-dynamics functions");
+        stepProfiler.addPhase("Controller log");
+        stepProfiler.addPhase("Record buffering");
+        stepProfiler.addPhase("Control output");
+        stepProfiler.addPhase("Whole step");
+        for(int i=0; i < NumDynamicsStepPhases; ++i){
+            dynamicsStepPhaseIndices[i] = -1;
+        }
+
+        preDynamicsFunctions.resetProfilePhases();
+        midDynamicsFunctions.resetProfilePhases();
+        postDynamicsFunctions.resetProfilePhases();
+    }
+}
+
+
+void SimulatorItem::Impl::putControlTimeSummary(ControllerItem* controller)
+{
+    auto& monitor = controller->controlTimeMonitor();
+    int numOverruns = monitor.numOverruns();
+    mv->putln(
+        format(_("The control function of {0} exceeded the time budget of {1:.3f} [ms] {2} times in {3} calls "
+                 "(average: {4:.3f} [ms], max: {5:.3f} [ms])."),
+               controller->displayName(), monitor.budget() * 1000.0, numOverruns, monitor.numSamples(),
+               monitor.averageTime() * 1000.0, monitor.maxTime() * 1000.0),
+        numOverruns > 0 ? MessageView::Warning : MessageView::Normal);
+}
+
+
+void SimulatorItem::Impl::outputStepProfile()
+{
+    if(!isStepProfilingActive){
+        return;
+    }
+    isStepProfilingActive = false;
+    
+    mv->putln(format(_("Step profile of {0}:"), self->displayName()));
+    stepProfiler.putSummary(mv->cout());
+
+    if(!stepProfileFile.empty()){
+        if(stepProfiler.writeCsvFile(stepProfileFile)){
+            mv->putln(format(_("The step profile has been written to \"{0}\"."), stepProfileFile));
+        } else {
+            mv->putln(format(_("The step profile cannot be written to \"{0}\"."), stepProfileFile),
+                      MessageView::Error);
+        }
+    }
+}
+
+
 namespace {
 
-bool ControllerInfo::waitForControlInThreadToFinish()
+ControllerWorkerPool::ControllerWorkerPool()
+{
+    realtimePriority = 0;
+    doCheckPageFaults = false;
+}
+
+
+ControllerWorkerPool::~ControllerWorkerPool()
+{
+    stop();
+}
+
+
+void ControllerWorkerPool::setRealtimeAttributes(const vector<int>& cpus, int priority, bool doCheckPageFaults)
+{
+    this->cpus = cpus;
+    realtimePriority = priority;
+    this->doCheckPageFaults = doCheckPageFaults;
+}
+
+
+void ControllerWorkerPool::start(const vector<ControllerInfoPtr>& infos, int numThreads)
+{
+    stop();
+    
+    const int numControllers = infos.size();
+    if(!cpus.empty()){
+        numThreads = cpus.size();
+    }
+    numThreads = std::max(1, std::min(numThreads, numControllers));
+    requestCounter = 0;
+    numRemainingControls = 0;
+    isExitRequested = false;
+
+    controllerInfos.clear();
+    workers.resize(numThreads);
+    for(int i=0; i < numThreads; ++i){
+        auto worker = new Worker;
+        worker->cpu = cpus.empty() ? -1 : cpus[i];
+        workers[i].reset(worker);
+    }
+    for(int i=0; i < numControllers; ++i){
+        ControllerInfo* info = infos[i];
+        info->isControlFinished = false;
+        info->isControlToBeContinued = false;
+        info->numControlCalls = 0;
+        info->numControlPageFaults = 0;
+        controllerInfos.push_back(info);
+        workers[i % numThreads]->controllerInfos.push_back(info);
+    }
+    for(auto& worker : workers){
+        Worker* pWorker = worker.get();
+        worker->thread = std::thread([this, pWorker](){ runWorker(pWorker); });
+    }
+}
+
+
+void ControllerWorkerPool::stop()
 {
-    std::unique_lock<std::mutex> lock(controlMutex);
-    while(!isControlFinished){
-        controlCondition.wait(lock);
+    if(workers.empty()){
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        isExitRequested = true;
+    }
+    requestCondition.notify_all();
+    for(auto& worker : workers){
+        worker->thread.join();
     }
-    isControlFinished = false;
-    return isControlToBeContinued;
+    workers.clear();
+    controllerInfos.clear();
 }
 
 
-void ControllerInfo::concurrentControlLoop()
+void ControllerWorkerPool::requestControl()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for(auto& info : controllerInfos){
+            info->isControlFinished = false;
+            info->isControlToBeContinued = false;
+        }
+        numRemainingControls = controllerInfos.size();
+        ++requestCounter;
+    }
+    requestCondition.notify_all();
+}
+
+
+bool ControllerWorkerPool::waitForControlToFinish(ControllerInfo* info)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while(!info->isControlFinished){
+        finishCondition.wait(lock);
+    }
+    return info->isControlToBeContinued;
+}
+
+
+/**
+   @return true if any controller requests to continue the simulation
+*/
+bool ControllerWorkerPool::waitForAllControlsToFinish()
 {
+    std::unique_lock<std::mutex> lock(mutex);
+    while(numRemainingControls > 0){
+        finishCondition.wait(lock);
+    }
+    bool doContinue = false;
+    for(auto& info : controllerInfos){
+        if(info->isControlToBeContinued){
+            doContinue = true;
+        }
+    }
+    return doContinue;
+}
+
+
+void ControllerWorkerPool::runWorker(Worker* worker)
+{
+    int processedRequestCounter = 0;
+
+    string error;
+    if(!setCurrentThreadRealtimeAttributes(worker->cpu, realtimePriority, error)){
+        MessageView::instance()->putln(error, MessageView::Warning);
+    }
+    
+    Tracer::setThreadName("Controller worker");
+
     while(true){
         {
-            std::unique_lock<std::mutex> lock(controlMutex);
-            while(true){
-                if(isExitingControlLoopRequested){
-                    goto exitConcurrentControlLoop;
-                }
-                if(isControlRequested){
-                    isControlRequested = false;
-                    isControlToBeContinued = false;
-                    break;
-                }
-                controlCondition.wait(lock);
+            std::unique_lock<std::mutex> lock(mutex);
+            while(requestCounter == processedRequestCounter && !isExitRequested){
+                requestCondition.wait(lock);
             }
+            if(isExitRequested){
+                break;
+            }
+            processedRequestCounter = requestCounter;
         }
-
-        bool doContinue = controller->control();
-        
-        {
-            std::lock_guard<std::mutex> lock(controlMutex);
-            isControlFinished = true;
-            isControlToBeContinued = doContinue;
+        for(auto& info : worker->controllerInfos){
+            CNOID_TRACE_ZONE("Control", "Simulation");
+            bool doContinue = info->control(doCheckPageFaults);
+            bool doNotify;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                info->isControlFinished = true;
+                info->isControlToBeContinued = doContinue;
+                --numRemainingControls;
+                doNotify = (numRemainingControls == 0) || info->isNoDelayMode();
+            }
+            if(doNotify){
+                finishCondition.notify_all();
+            }
         }
-        controlCondition.notify_all();
     }
-    
-exitConcurrentControlLoop:
-    return;
 }
 
 }
@@ -2260,12 +3178,21 @@ exitConcurrentControlLoop:
 
 void SimulatorItem::Impl::flushRecords()
 {
+    // The scene updates of the bodies are notified together at the end of this function
+    SgUpdateBatch sceneUpdateBatch;
+    
     int frame = flushMainRecords();
 
     for(auto& info : loggedControllerInfos){
         info->flushLog();
     }
 
+    if(isBatchMode){
+        return;
+    }
+
+    updateAchievedRealtimeFactor(frame);
+
     if(isRecordingEnabled){
         logEngine->updateOngoingTime(frame / worldFrameRate);
         
@@ -2281,19 +3208,36 @@ void SimulatorItem::Impl::flushRecords()
 }
 
 
+/**
+   The buffers written by the simulation thread are just exchanged with the flush buffers
+   in the critical section, and the records are flushed from the flush buffers after leaving
+   it. This prevents the simulation thread from being blocked while the records are flushed.
+*/
 int SimulatorItem::Impl::flushMainRecords()
 {
     recordBufMutex.lock();
 
+    for(auto& simBody : activeSimBodies){
+        simBody->impl->swapRecordBuffers();
+    }
+    flushingSimBodies = activeSimBodies;
+    collisionPairsBuf.swap(collisionPairsFlushBuf);
+    const int numFlushFrames = numBufferedFrames;
+    const int frame = frameAtLastBufferWriting;
+    frameAtLastFlushBufferWriting = frame;
+    numBufferedFrames = 0;
+    
+    recordBufMutex.unlock();
+
     if(worldLogFileItem){
-        if(numBufferedFrames > 0){
-            int firstFrame = frameAtLastBufferWriting - (numBufferedFrames - 1);
-            for(int bufFrame = 0; bufFrame < numBufferedFrames; ++bufFrame){
+        if(numFlushFrames > 0){
+            int firstFrame = frame - (numFlushFrames - 1);
+            for(int bufFrame = 0; bufFrame < numFlushFrames; ++bufFrame){
                 double time = (firstFrame + bufFrame) * worldTimeStep_;
                 while(time >= nextLogTime){
                     worldLogFileItem->beginFrameOutput(time);
-                    for(size_t i=0; i < activeSimBodies.size(); ++i){
-                        activeSimBodies[i]->impl->flushRecordsToWorldLogFile(bufFrame);
+                    for(auto& simBody : flushingSimBodies){
+                        simBody->impl->flushRecordsToWorldLog(worldLogFileItem.get(), bufFrame);
                     }
                     worldLogFileItem->endFrameOutput();
                     nextLogTime = ++nextLogFrame * logTimeStep;
@@ -2301,33 +3245,50 @@ int SimulatorItem::Impl::flushMainRecords()
             }
         }
     }
+
+    if(worldLogStreamItem){
+        int firstFrame = frame - (numFlushFrames - 1);
+        for(int bufFrame = 0; bufFrame < numFlushFrames; ++bufFrame){
+            double time = (firstFrame + bufFrame) * worldTimeStep_;
+            if(time >= nextStreamTime){
+                worldLogStreamItem->beginFrameOutput(time);
+                for(auto& simBody : flushingSimBodies){
+                    simBody->impl->flushRecordsToWorldLog(worldLogStreamItem.get(), bufFrame);
+                }
+                if(auto& collisionPairs = collisionPairsFlushBuf[bufFrame]){
+                    worldLogStreamItem->outputContacts(*collisionPairs);
+                }
+                worldLogStreamItem->endFrameOutput();
+                // Frames are skipped instead of being output repeatedly when the simulation is slow
+                nextStreamFrame = static_cast<int>(time / streamTimeStep) + 1;
+                nextStreamTime = nextStreamFrame * streamTimeStep;
+            }
+        }
+    }
     
-    for(auto& simBody : activeSimBodies){
+    for(auto& simBody : flushingSimBodies){
         simBody->flushRecords();
     }
 
     bool offsetChanged;
     if(isRecordingEnabled && recordCollisionData){
         offsetChanged = false;
-        for(size_t i=0 ; i < collisionPairsBuf.size(); ++i){
+        for(size_t i=0 ; i < collisionPairsFlushBuf.size(); ++i){
             if(collisionSeq->numFrames() >= ringBufferSize){
-                collisionSeq->popFrontFrame();
+                collisionSeq->popFrontLoggedFrame();
                 offsetChanged = true;
             }
-            CollisionSeq::Frame collisionSeq0 = collisionSeq->appendFrame();
-            collisionSeq0[0] = collisionPairsBuf[i];
+            if(auto& collisionPairs = collisionPairsFlushBuf[i]){
+                collisionSeq->appendLoggedFrame(*collisionPairs);
+            } else {
+                collisionSeq->appendLoggedFrame(CollisionLinkPairList());
+            }
         }
         if(offsetChanged){
-            collisionSeq->setOffsetTimeFrame(currentFrame + 1 - collisionSeq->numFrames());
+            collisionSeq->setOffsetTimeFrame(frame + 1 - collisionSeq->numFrames());
         }
     }
-    collisionPairsBuf.clear();
-
-    int frame = frameAtLastBufferWriting;
-    
-    numBufferedFrames = 0;
-    
-    recordBufMutex.unlock();
+    collisionPairsFlushBuf.clear();
 
     return frame;
 }
@@ -2402,14 +3363,35 @@ void SimulatorItem::finalizeSimulation()
 void SimulatorItem::Impl::onSimulationLoopStopped(bool isForced)
 {
     flushTimer.stop();
+
+    if(isProcessMemoryLocked){
+        if(--numMemoryLockingSimulations == 0){
+            unlockProcessMemory();
+        }
+        isProcessMemoryLocked = false;
+    }
     
     for(auto& simBody : allSimBodies){
         for(auto& info : simBody->impl->controllerInfos){
             auto& controller = info->controller;
+            if(isControlPageFaultCheckActive && info->numControlPageFaults > 0){
+                mv->putln(
+                    format(_("The control function of {0} caused {1} page faults during the simulation. "
+                             "It may allocate memory, which is not real-time safe."),
+                           controller->displayName(), info->numControlPageFaults),
+                    MessageView::Warning);
+            }
+            if(info->isControlTimeMonitored){
+                putControlTimeSummary(controller);
+            }
             controller->stop();
             controller->setSimulatorItem(nullptr);
         }
     }
+    if(isControlOverrunAbortRequested){
+        mv->putln(_("The simulation has been aborted because a control function exceeded its time budget."),
+                  MessageView::Error);
+    }
     self->finalizeSimulation();
 
     for(auto& subSimulator : subSimulatorItems){
@@ -2418,7 +3400,9 @@ void SimulatorItem::Impl::onSimulationLoopStopped(bool isForced)
 
     flushRecords();
 
-    logEngine->stopOngoingTimeUpdate();
+    if(!isBatchMode){
+        logEngine->stopOngoingTimeUpdate();
+    }
 
     mv->notify(format(_("Simulation by {0} has finished at {1} [s]."), self->displayName(), finishTime));
 
@@ -2427,9 +3411,13 @@ void SimulatorItem::Impl::onSimulationLoopStopped(bool isForced)
                          actualSimulationTime, (actualSimulationTime / finishTime)));
     }
 
+    outputStepProfile();
+
     clearSimulation();
 
-    SceneView::unblockEditModeForAllViews(self);
+    if(!isBatchMode){
+        SceneView::unblockEditModeForAllViews(self);
+    }
 
     sigSimulationFinished(isForced);
 }
@@ -2453,6 +3441,243 @@ bool SimulatorItem::isActive() const
 }
 
 
+bool SimulatorItem::saveSnapshot(std::vector<char>& out_data)
+{
+    return impl->saveSnapshot(out_data);
+}
+
+
+bool SimulatorItem::Impl::saveSnapshot(std::vector<char>& out_data)
+{
+    if(!isDoingSimulationLoop){
+        return false;
+    }
+
+    out_data.clear();
+    SnapshotWriter writer(out_data);
+    writer.write(SnapshotMagicNumber);
+    writer.write(SnapshotFormatVersion);
+    writer.write<int32_t>(currentFrame);
+    writer.write<uint32_t>(simBodiesWithBody.size());
+
+    vector<SnapshotBodyState> bodyStates;
+    storeSnapshotBodyStates(bodyStates);
+    for(size_t i=0; i < simBodiesWithBody.size(); ++i){
+        Body* body = simBodiesWithBody[i]->body();
+        auto& state = bodyStates[i];
+        writer.write(body->name());
+        writer.write<int32_t>(body->numLinks());
+        writer.write(state.linkStates.data(), state.linkStates.size());
+        writer.write<int32_t>(state.deviceStates.size());
+        for(auto& deviceState : state.deviceStates){
+            writer.write<int32_t>(deviceState.size());
+            writer.write(deviceState.data(), deviceState.size());
+        }
+    }
+
+    vector<double> buf;
+    self->storeSnapshotState(buf);
+    writer.write<uint32_t>(buf.size());
+    writer.write(buf.data(), buf.size());
+    
+    return true;
+}
+
+
+bool SimulatorItem::restoreSnapshot(const std::vector<char>& data)
+{
+    return impl->restoreSnapshot(data);
+}
+
+
+bool SimulatorItem::Impl::restoreSnapshot(const std::vector<char>& data)
+{
+    if(!isDoingSimulationLoop){
+        return false;
+    }
+
+    // The whole data is parsed and validated before any state is changed
+    SnapshotReader reader(data);
+    uint32_t magic, version, numBodies;
+    int32_t frame;
+    if(!reader.read(magic) || magic != SnapshotMagicNumber ||
+       !reader.read(version) || version != SnapshotFormatVersion ||
+       !reader.read(frame) || !reader.read(numBodies) || numBodies != simBodiesWithBody.size()){
+        mv->putln(format(_("{0}: The snapshot is not compatible with the current simulation."),
+                         self->displayName()),
+                  MessageView::Error);
+        return false;
+    }
+
+    vector<SnapshotBodyState> bodyStates;
+    vector<double> simulatorState;
+    bool isValid = readSnapshotBodyStates(reader, bodyStates);
+    if(isValid){
+        uint32_t stateSize;
+        isValid = reader.read(stateSize);
+        if(isValid){
+            simulatorState.resize(stateSize);
+            isValid = reader.read(simulatorState.data(), stateSize) && reader.pos == reader.end;
+        }
+    }
+    if(!isValid){
+        mv->putln(format(_("{0}: The snapshot data is broken or does not match the simulation bodies."),
+                         self->displayName()),
+                  MessageView::Error);
+        return false;
+    }
+
+    /*
+      The current body states are kept to recover them when the simulator rejects its state,
+      which can only be checked after the body states are restored.
+    */
+    vector<SnapshotBodyState> currentBodyStates;
+    storeSnapshotBodyStates(currentBodyStates);
+
+    applySnapshotBodyStates(bodyStates);
+
+    if(!self->restoreSnapshotState(simulatorState)){
+        applySnapshotBodyStates(currentBodyStates);
+        mv->putln(format(_("{0}: The simulator state of the snapshot cannot be restored."),
+                         self->displayName()),
+                  MessageView::Error);
+        return false;
+    }
+
+    currentFrame = frame;
+
+    return true;
+}
+
+
+void SimulatorItem::Impl::storeSnapshotBodyStates(vector<SnapshotBodyState>& out_states)
+{
+    out_states.resize(simBodiesWithBody.size());
+    for(size_t i=0; i < simBodiesWithBody.size(); ++i){
+        Body* body = simBodiesWithBody[i]->body();
+        auto& state = out_states[i];
+        const int numLinks = body->numLinks();
+        state.linkStates.resize(numLinks * SnapshotLinkStateSize);
+        for(int j=0; j < numLinks; ++j){
+            Link* link = body->link(j);
+            double* s = &state.linkStates[j * SnapshotLinkStateSize];
+            Quaternion quat(link->R());
+            std::copy(link->p().data(), link->p().data() + 3, s);
+            std::copy(quat.coeffs().data(), quat.coeffs().data() + 4, s + 3);
+            std::copy(link->v().data(), link->v().data() + 3, s + 7);
+            std::copy(link->w().data(), link->w().data() + 3, s + 10);
+            std::copy(link->dv().data(), link->dv().data() + 3, s + 13);
+            std::copy(link->dw().data(), link->dw().data() + 3, s + 16);
+            s[19] = link->q();
+            s[20] = link->dq();
+            s[21] = link->ddq();
+            s[22] = link->u();
+            s[23] = link->q_target();
+            s[24] = link->dq_target();
+        }
+        const int numDevices = body->numDevices();
+        state.deviceStates.resize(numDevices);
+        for(int j=0; j < numDevices; ++j){
+            Device* device = body->device(j);
+            state.deviceStates[j].resize(device->stateSize());
+            device->writeState(state.deviceStates[j].data());
+        }
+    }
+}
+
+
+bool SimulatorItem::Impl::readSnapshotBodyStates(SnapshotReader& reader, vector<SnapshotBodyState>& out_states)
+{
+    out_states.resize(simBodiesWithBody.size());
+    for(size_t i=0; i < simBodiesWithBody.size(); ++i){
+        Body* body = simBodiesWithBody[i]->body();
+        auto& state = out_states[i];
+        string name;
+        int32_t numLinks;
+        if(!reader.read(name) || name != body->name() ||
+           !reader.read(numLinks) || numLinks != body->numLinks()){
+            return false;
+        }
+        state.linkStates.resize(numLinks * SnapshotLinkStateSize);
+        if(!reader.read(state.linkStates.data(), state.linkStates.size())){
+            return false;
+        }
+        int32_t numDevices;
+        if(!reader.read(numDevices) || numDevices != body->numDevices()){
+            return false;
+        }
+        state.deviceStates.resize(numDevices);
+        for(int j=0; j < numDevices; ++j){
+            int32_t size;
+            if(!reader.read(size) || size != body->device(j)->stateSize()){
+                return false;
+            }
+            state.deviceStates[j].resize(size);
+            if(!reader.read(state.deviceStates[j].data(), size)){
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+
+void SimulatorItem::Impl::applySnapshotBodyStates(const vector<SnapshotBodyState>& states)
+{
+    for(size_t i=0; i < simBodiesWithBody.size(); ++i){
+        Body* body = simBodiesWithBody[i]->body();
+        auto& state = states[i];
+        const int numLinks = body->numLinks();
+        for(int j=0; j < numLinks; ++j){
+            Link* link = body->link(j);
+            const double* s = &state.linkStates[j * SnapshotLinkStateSize];
+            link->p() = Vector3(s[0], s[1], s[2]);
+            link->R() = Quaternion(s[6], s[3], s[4], s[5]).toRotationMatrix();
+            link->v() = Vector3(s[7], s[8], s[9]);
+            link->w() = Vector3(s[10], s[11], s[12]);
+            link->dv() = Vector3(s[13], s[14], s[15]);
+            link->dw() = Vector3(s[16], s[17], s[18]);
+            link->q() = s[19];
+            link->dq() = s[20];
+            link->ddq() = s[21];
+            link->u() = s[22];
+            link->q_target() = s[23];
+            link->dq_target() = s[24];
+        }
+        const int numDevices = body->numDevices();
+        for(int j=0; j < numDevices; ++j){
+            Device* device = body->device(j);
+            device->readState(state.deviceStates[j].data());
+            device->notifyStateChange();
+        }
+    }
+}
+
+
+void SimulatorItem::storeSnapshotState(std::vector<double>& /* out_state */)
+{
+
+}
+
+
+bool SimulatorItem::restoreSnapshotState(const std::vector<double>& /* state */)
+{
+    return true;
+}
+
+
+double SimulatorItem::actualSimulationTime() const
+{
+    return impl->actualSimulationTime;
+}
+
+
+double SimulatorItem::finishTime() const
+{
+    return impl->finishTime;
+}
+
+
 int SimulatorItem::currentFrame() const
 {
     return impl->currentFrame;
@@ -2686,6 +3911,43 @@ void SimulatorItem::Impl::onRealtimeSyncChanged(bool on)
 }
 
 
+void SimulatorItem::setTargetRealtimeFactor(double factor)
+{
+    if(factor > 0.0){
+        impl->targetRealtimeFactor = factor;
+    }
+}
+
+
+double SimulatorItem::targetRealtimeFactor() const
+{
+    return impl->targetRealtimeFactor;
+}
+
+
+/**
+   The ratio of the simulation time to the wall clock time, which is measured
+   over the last second of the simulation.
+*/
+double SimulatorItem::achievedRealtimeFactor() const
+{
+    return impl->achievedRealtimeFactor;
+}
+
+
+void SimulatorItem::Impl::updateAchievedRealtimeFactor(int frame)
+{
+    const qint64 elapsed = realtimeFactorTimer.elapsed();
+    if(elapsed >= 1000){
+        achievedRealtimeFactor =
+            (frame - frameAtLastRealtimeFactorUpdate) * worldTimeStep_ * 1000.0 / elapsed;
+        frameAtLastRealtimeFactorUpdate = frame;
+        realtimeFactorTimer.start();
+        self->notifyUpdate();
+    }
+}
+
+
 /**
    This function may be overridden.
 */
@@ -2729,6 +3991,13 @@ void SimulatorItem::Impl::doPutProperties(PutPropertyFunction& putProperty)
 
     putProperty(_("Sync with realtime"), isRealtimeSyncMode,
                 [&](bool on){ onRealtimeSyncChanged(on); return true; });
+    putProperty.decimals(2).min(0.01).max(1000.0);
+    putProperty(_("Realtime factor"), targetRealtimeFactor,
+                [&](double factor){ self->setTargetRealtimeFactor(factor); return true; });
+    putProperty.reset();
+    if(isDoingSimulationLoop){
+        putProperty(_("Achieved realtime factor"), achievedRealtimeFactor);
+    }
     putProperty(_("Time range"), timeRangeMode,
                 [&](int index){ return timeRangeMode.select(index); });
     putProperty.min(0.0);
@@ -2744,12 +4013,28 @@ void SimulatorItem::Impl::doPutProperties(PutPropertyFunction& putProperty)
                 changeProperty(isDeviceStateOutputEnabled));
     putProperty(_("Record collision data"), recordCollisionData,
                 changeProperty(recordCollisionData));
+    putProperty(_("Record paging"), isRecordPagingEnabled, changeProperty(isRecordPagingEnabled));
     putProperty(_("Controller Threads"), useControllerThreadsProperty,
                 changeProperty(useControllerThreadsProperty));
+    putProperty(_("Real-time thread mode"), isRealtimeThreadModeEnabled,
+                changeProperty(isRealtimeThreadModeEnabled));
+    if(isRealtimeThreadModeEnabled){
+        putProperty.min(1).max(99);
+        putProperty(_("Real-time priority"), realtimeThreadPriority, changeProperty(realtimeThreadPriority));
+        putProperty.min(-1).max(std::numeric_limits<int>::max());
+        putProperty(_("Simulation thread CPU"), simulationThreadCpu, changeProperty(simulationThreadCpu));
+        putProperty.reset();
+        putProperty(_("Controller thread CPUs"), getCpuListString(controllerThreadCpus),
+                    [&](const string& s){ return parseCpuList(s, controllerThreadCpus); });
+        putProperty(_("Control page fault check"), isControlPageFaultCheckEnabled,
+                    changeProperty(isControlPageFaultCheckEnabled));
+    }
     putProperty(_("Controller options"), controllerOptionString_,
                 changeProperty(controllerOptionString_));
     putProperty(_("Block scene view edit mode"), isSceneViewEditModeBlockedDuringSimulation,
                 [&](bool on){ self->setSceneViewEditModeBlockedDuringSimulation(on); return true; });
+    putProperty(_("Step profiling"), isStepProfilingEnabled, changeProperty(isStepProfilingEnabled));
+    putProperty(_("Step profile file"), stepProfileFile, changeProperty(stepProfileFile));
 }
 
 
@@ -2768,6 +4053,7 @@ bool SimulatorItem::Impl::store(Archive& archive)
         archive.write("frameRate", frameRateProperty);
     }
     archive.write("realtimeSync", isRealtimeSyncMode);
+    archive.write("realtime_factor", targetRealtimeFactor);
     archive.write("recording", recordingMode.selectedSymbol(), DOUBLE_QUOTED);
     archive.write("timeRangeMode", timeRangeMode.selectedSymbol(), DOUBLE_QUOTED);
     archive.write("timeLength", timeLength);
@@ -2775,9 +4061,24 @@ bool SimulatorItem::Impl::store(Archive& archive)
     archive.write("allLinkPositionOutputMode", isAllLinkPositionOutputMode);
     archive.write("deviceStateOutput", isDeviceStateOutputEnabled);
     archive.write("controllerThreads", useControllerThreadsProperty);
+    archive.write("realtime_thread_mode", isRealtimeThreadModeEnabled);
+    archive.write("realtime_thread_priority", realtimeThreadPriority);
+    archive.write("simulation_thread_cpu", simulationThreadCpu);
+    if(!controllerThreadCpus.empty()){
+        auto cpus = archive.createFlowStyleListing("controller_thread_cpus");
+        for(auto& cpu : controllerThreadCpus){
+            cpus->append(cpu);
+        }
+    }
+    archive.write("control_page_fault_check", isControlPageFaultCheckEnabled);
     archive.write("recordCollisionData", recordCollisionData);
+    archive.write("record_paging", isRecordPagingEnabled);
     archive.write("controllerOptions", controllerOptionString_, DOUBLE_QUOTED);
     archive.write("scene_view_edit_mode_blocking", isSceneViewEditModeBlockedDuringSimulation);
+    archive.write("step_profiling", isStepProfilingEnabled);
+    if(!stepProfileFile.empty()){
+        archive.writeRelocatablePath("step_profile_file", stepProfileFile);
+    }
     
     ListingPtr idseq = new Listing();
     idseq->setFlowStyle(true);
@@ -2841,13 +4142,34 @@ bool SimulatorItem::Impl::restore(const Archive& archive)
         }
     }
     archive.read("realtimeSync", isRealtimeSyncMode);
+    double realtimeFactor;
+    if(archive.read("realtime_factor", realtimeFactor)){
+        // An invalid factor is ignored as it is in the property
+        self->setTargetRealtimeFactor(realtimeFactor);
+    }
     archive.read("timeLength", timeLength);
     self->setAllLinkPositionOutputMode(archive.get("allLinkPositionOutputMode", isAllLinkPositionOutputMode));
     archive.read("deviceStateOutput", isDeviceStateOutputEnabled);
     archive.read("recordCollisionData", recordCollisionData);
+    archive.read("record_paging", isRecordPagingEnabled);
     archive.read("controllerThreads", useControllerThreadsProperty);
+    archive.read("realtime_thread_mode", isRealtimeThreadModeEnabled);
+    archive.read("realtime_thread_priority", realtimeThreadPriority);
+    archive.read("simulation_thread_cpu", simulationThreadCpu);
+    controllerThreadCpus.clear();
+    auto cpus = archive.findListing("controller_thread_cpus");
+    if(cpus->isValid()){
+        for(int i=0; i < cpus->size(); ++i){
+            controllerThreadCpus.push_back(cpus->at(i)->toInt());
+        }
+    }
+    archive.read("control_page_fault_check", isControlPageFaultCheckEnabled);
     archive.read("controllerOptions", controllerOptionString_);
     archive.read("scene_view_edit_mode_blocking", isSceneViewEditModeBlockedDuringSimulation);
+    archive.read("step_profiling", isStepProfilingEnabled);
+    if(archive.read("step_profile_file", symbol)){
+        stepProfileFile = archive.resolveRelocatablePath(symbol);
+    }
 
     archive.addPostProcess([&](){ restoreTimeSyncItemEngines(archive); });
     
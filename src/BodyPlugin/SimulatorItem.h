@@ -20,6 +20,7 @@ class Link;
 class Device;
 class CollisionDetector;
 class WorldItem;
+class SimulationStepProfiler;
 class BodyItem;
 class ControllerItem;
 class SimulatorItem;
@@ -99,6 +100,37 @@ public:
     bool isPausing() const;
     bool isActive() const; ///< isRunning() && !isPausing()
 
+    /**
+       In the batch mode, startSimulation only initializes the simulation and the simulation
+       loop is not started in the simulation thread. The loop must be executed by calling
+       runSimulationLoopInBatchMode from an arbitrary thread, and finishBatchSimulation must
+       be called from the main thread after the loop finishes. The Qt event loop is not used
+       during the simulation loop in this mode. This is used by SimulationBatchRunner.
+    */
+    void setBatchMode(bool on);
+    bool isBatchMode() const;
+    bool runSimulationLoopInBatchMode();
+    void finishBatchSimulation();
+
+    /**
+       Save the dynamic state of the simulation into a binary data block.
+       The state consists of the current frame, the link positions and velocities, the joint
+       states, the joint targets and the device states of all the simulation bodies, and the
+       simulator specific state stored by the storeSnapshotState function.
+       \note These functions must be called from the simulation thread, for example in a
+       function registered by addPreDynamicsFunction, or while the simulation is paused.
+       \note The records which have already been stored in the record items are not rewound
+       by restoreSnapshot. The following records are just appended to them.
+    */
+    bool saveSnapshot(std::vector<char>& out_data);
+    bool restoreSnapshot(const std::vector<char>& data);
+
+    //! Computation time of the last simulation in seconds
+    double actualSimulationTime() const;
+
+    //! Simulation time at which the last simulation finished
+    double finishTime() const;
+
     //! This can only be called from the simulation thread
     int currentFrame() const;
     
@@ -163,9 +195,43 @@ public:
     bool isActiveControlTimeRangeMode() const;
 
     void setRealtimeSyncMode(bool on);
+
+    /**
+       The ratio of the simulation time to the wall clock time that the realtime sync mode keeps.
+       A factor greater than one makes the simulation run faster than realtime up to the factor.
+    */
+    void setTargetRealtimeFactor(double factor);
+    double targetRealtimeFactor() const;
+    double achievedRealtimeFactor() const;
     
     void setDeviceStateOutputEnabled(bool on);
 
+    /**
+       The elapsed time of each phase of the simulation steps is measured when the step
+       profiling is enabled. The summary is output to the message view when the simulation
+       finishes, and it is also written to the step profile file in the CSV format if the
+       file is specified.
+    */
+    void setStepProfilingEnabled(bool on);
+    bool isStepProfilingEnabled() const;
+    void setStepProfileFile(const std::string& filename);
+
+    //! This function returns nullptr when the step profiling is not active
+    SimulationStepProfiler* stepProfiler();
+
+    enum DynamicsStepPhase {
+        StateInputPhase, EngineStepPhase, StateOutputPhase, NumDynamicsStepPhases
+    };
+
+    /**
+       This function can be called in stepSimulation to measure the elapsed times of the phases
+       of the dynamics step, which are the transfer of the body states to the physics engine,
+       the step of the engine, and the transfer of the states from the engine. The time from the
+       beginning of stepSimulation or the previous call of this function is recorded as the time
+       of the given phase. This function does nothing when the step profiling is not active.
+    */
+    void lapDynamicsStepPhase(int phase);
+
     bool isRecordingEnabled() const;
     bool isDeviceStateOutputEnabled() const;
 
@@ -285,6 +351,15 @@ protected:
 
     virtual std::shared_ptr<CollisionLinkPairList> getCollisions();
 
+    /**
+       Override these functions to store and restore the internal state of the simulator
+       that cannot be recovered from the body states, such as the state of a solver.
+       restoreSnapshotState is called after the body states are restored, and a simulator must
+       update its internal state corresponding to the restored body states in the function.
+    */
+    virtual void storeSnapshotState(std::vector<double>& out_state);
+    virtual bool restoreSnapshotState(const std::vector<double>& state);
+
     virtual void doPutProperties(PutPropertyFunction& putProperty) override;
     virtual bool store(Archive& archive) override;
     virtual bool restore(const Archive& archive) override;
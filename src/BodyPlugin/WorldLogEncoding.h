@@ -0,0 +1,97 @@
+#ifndef CNOID_BODYPLUGIN_WORLD_LOG_ENCODING_H
+#define CNOID_BODYPLUGIN_WORLD_LOG_ENCODING_H
+
+#include <cnoid/EigenTypes>
+#include <string>
+#include <vector>
+
+namespace cnoid {
+
+namespace world_log {
+
+/**
+   The IDs of the data in a frame. They are shared by the world log file and the world log stream,
+   and CONTACTS is only used in the stream.
+*/
+enum DataTypeID {
+    BODY_STATE,
+    LINK_POSITIONS,
+    JOINT_POSITIONS,
+    DEVICE_STATES,
+    LINK_POSITION_DELTAS,
+    CONTACTS
+};
+
+//! The buffer to encode the data of the world log in the little endian byte order.
+class WriteBufBase
+{
+public:
+    std::vector<char> data;
+
+    int size() const {
+        return data.size();
+    }
+
+    void writeID(DataTypeID id){
+        writeOctet((char)id);
+    }
+
+    void writeBool(bool value){
+        data.push_back(value);
+    }
+
+    void writeOctet(char value){
+        data.push_back(value);
+    }
+
+    void writeShort(short value){
+        data.push_back(value & 0xff);
+        data.push_back(value >> 8);
+    }
+
+    void writeInt(int value){
+        data.push_back(value & 0xff);
+        data.push_back((value >> 8) & 0xff);
+        data.push_back((value >> 16) & 0xff);
+        data.push_back((value >> 24) & 0xff);
+    }
+
+    void writeInt(int pos, int value){
+        data[pos++] = value & 0xff;
+        data[pos++] = (value >> 8) & 0xff;
+        data[pos++] = (value >> 16) & 0xff;
+        data[pos++] = (value >> 24) & 0xff;
+    }
+
+    void writeFloat(float value){
+        char* p = (char*)&value;
+        data.insert(data.end(), p, p + sizeof(float));
+    }
+
+    void writeVector3(const Vector3& v){
+        writeFloat(v.x());
+        writeFloat(v.y());
+        writeFloat(v.z());
+    }
+
+    void writeSE3(const SE3& position){
+        writeVector3(position.translation());
+        const Quaternion& q = position.rotation();
+        writeFloat(q.w());
+        writeFloat(q.x());
+        writeFloat(q.y());
+        writeFloat(q.z());
+    }
+
+    void writeString(const std::string& str){
+        const int size = str.size();
+        writeShort((unsigned char)size);
+        data.insert(data.end(), str.begin(), str.begin() + size);
+    }
+};
+
+}
+
+}
+
+#endif
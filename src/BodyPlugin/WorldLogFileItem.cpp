@@ -8,6 +8,7 @@
 #include "SubSimulatorItem.h"
 #include "ControllerItem.h"
 #include "BodyItemFileIO.h"
+#include "WorldLogEncoding.h"
 #include <cnoid/MainWindow>
 #include <cnoid/ItemManager>
 #include <cnoid/MenuManager>
@@ -25,6 +26,8 @@
 #include <cnoid/PutPropertyFunction>
 #include <cnoid/FileDialog>
 #include <cnoid/Archive>
+#include <cnoid/YAMLReader>
+#include <cnoid/YAMLWriter>
 #include <cnoid/UTF8>
 #include <cnoid/stdx/filesystem>
 #include <fmt/format.h>
@@ -32,14 +35,21 @@
 #include <QMessageBox>
 #include <fstream>
 #include <stack>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
 #include <map>
 #include <regex>
+#include <algorithm>
 #include "gettext.h"
 
 using namespace std;
 using namespace cnoid;
 using fmt::format;
 namespace filesystem = stdx::filesystem;
+using namespace cnoid::world_log;
 
 namespace {
 
@@ -49,12 +59,43 @@ static const int frameHeaderSize =
     + sizeof(int)   // data size
     ;
 
-enum DataTypeID {
-    BODY_STATE,
-    LINK_POSITIONS,
-    JOINT_POSITIONS,
-    DEVICE_STATES
-};
+/*
+  The positions of the frames are recorded in the index file at this interval of frames.
+  The index file is a sidecar file of the log file, whose name is the log file name with the
+  ".index" suffix. It has the magic string and the version number, and each entry of it is
+  the pair of the frame time and the frame position in the log file.
+*/
+const int frameIndexInterval = 64;
+
+/*
+  A device state that is not changed from the previous frame is written as the reference to the
+  position where the state is fully written. The states of all the devices are fully written at
+  the frames indexed in the frame index file, so the references never go back beyond the last
+  indexed frame, and the device states of an indexed frame can be read from the frame itself.
+*/
+const char* frameIndexFileMagic = "CNOID-WORLD-LOG-INDEX";
+const int frameIndexFileVersion = 1;
+
+/*
+  In the delta encoding of link positions, the positions of a body are written as a key frame
+  of the LINK_POSITIONS type at this interval of frames. The other frames are written with the
+  LINK_POSITION_DELTAS type, which refers to the position of the key frame data in the log file
+  and only contains the positions of the links that moved from the key frame beyond the tolerance.
+  A frame can be restored from the key frame and the frame itself, so the seek is not affected.
+*/
+const int linkPositionKeyFrameInterval = 64;
+
+/*
+  When the log sharding is enabled, the recording is continued in a new log file called a shard
+  when the current shard exceeds the size limit or the time length. The shards except the first
+  one are named with the sequence number suffix such as "world-1.log", and each shard is a
+  complete log file with its own header and frame index file. The manifest file, whose name is
+  the log file name with the ".shards" suffix, lists the shards with the times of their first
+  frames so that the playback can seek to any time across the shards.
+*/
+const char* shardManifestType = "WorldLogShards";
+
+typedef vector<SE3, Eigen::aligned_allocator<SE3>> SE3Array;
 
 struct NotEnoughDataException { };
 
@@ -205,15 +246,130 @@ public:
 };
 
 
-class WriteBuf
+/*
+  The log data is written to the file by the thread of this class so that the output of the
+  frames is not blocked by the file system. The buffers waiting for being written are queued up
+  to the maximum size, and a buffer exceeding it is rejected instead of blocking the caller.
+*/
+class LogFileWriter
+{
+public:
+    static constexpr size_t maxQueuedBytes = 64 * 1024 * 1024;
+
+    LogFileWriter(){
+        queuedBytes = 0;
+        numWrittenBytes = 0;
+        isFinishing = false;
+        hasWriteError_ = false;
+    }
+
+    ~LogFileWriter(){
+        close();
+    }
+
+    bool open(const string& filename){
+        close();
+        ofs.open(filename.c_str(), ios::out | ios::binary | ios::trunc);
+        if(!ofs.is_open()){
+            return false;
+        }
+        queuedBytes = 0;
+        numWrittenBytes = 0;
+        isFinishing = false;
+        hasWriteError_ = false;
+        writerThread = std::thread([this](){ writeQueuedBuffers(); });
+        return true;
+    }
+
+    bool is_open() const {
+        return ofs.is_open();
+    }
+
+    //! All the queued buffers are written before the file is closed
+    void close(){
+        if(writerThread.joinable()){
+            {
+                std::lock_guard<std::mutex> lock(queueMutex);
+                isFinishing = true;
+            }
+            queueCondition.notify_all();
+            writerThread.join();
+        }
+        if(ofs.is_open()){
+            ofs.close();
+        }
+    }
+
+    /**
+       The data is moved to the queue and cleared if it is accepted.
+       A buffer is always accepted when the queue is empty.
+    */
+    bool push(vector<char>& data){
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            if(!queue.empty() && queuedBytes + data.size() > maxQueuedBytes){
+                return false;
+            }
+            queuedBytes += data.size();
+            queue.emplace_back();
+            queue.back().swap(data);
+        }
+        queueCondition.notify_all();
+        return true;
+    }
+
+    size_t writtenBytes() const {
+        return numWrittenBytes;
+    }
+
+    bool hasWriteError() const {
+        return hasWriteError_;
+    }
+
+private:
+    ofstream ofs;
+    std::thread writerThread;
+    std::mutex queueMutex;
+    std::condition_variable queueCondition;
+    deque<vector<char>> queue;
+    size_t queuedBytes;
+    bool isFinishing;
+    std::atomic<size_t> numWrittenBytes;
+    std::atomic<bool> hasWriteError_;
+
+    void writeQueuedBuffers(){
+        vector<char> buf;
+        std::unique_lock<std::mutex> lock(queueMutex);
+        while(true){
+            queueCondition.wait(lock, [this](){ return !queue.empty() || isFinishing; });
+            if(queue.empty()){
+                break;
+            }
+            buf.swap(queue.front());
+            queue.pop_front();
+            lock.unlock();
+
+            ofs.write(buf.data(), buf.size());
+            ofs.flush();
+            if(ofs.fail()){
+                hasWriteError_ = true;
+            }
+            numWrittenBytes += buf.size();
+            
+            lock.lock();
+            queuedBytes -= buf.size();
+            buf.clear();
+        }
+    }
+};
+
+
+class WriteBuf : public world_log::WriteBufBase
 {
 public:
-    vector<char> data;
-    ofstream& ofs;
     size_t seekOffset;
 
-    WriteBuf(ofstream& ofs)
-        : ofs(ofs) {
+    WriteBuf() {
         seekOffset = 0;
     }
     
@@ -231,48 +387,29 @@ public:
 
     void clear(){
         data.clear();
-        seekOffset = ofs.tellp();
     }
 
-    int size() const {
-        return data.size();
-    }
-
-    void flush(){
-        ofs.write(&data.front(), data.size());
-        ofs.flush();
-        clear();
-    }
-        
-    void writeID(DataTypeID id){
-        writeOctet((char)id);
-    }
-
-    void writeBool(bool value){
-        data.push_back(value);
-    }
-
-    void writeOctet(char value){
-        data.push_back(value);
-    }
-
-    void writeShort(short value){
-        data.push_back(value & 0xff);
-        data.push_back(value >> 8);
+    void reset(){
+        data.clear();
+        seekOffset = 0;
     }
 
-    void writeInt(int value){
-        data.push_back(value & 0xff);
-        data.push_back((value >> 8) & 0xff);
-        data.push_back((value >> 16) & 0xff);
-        data.push_back((value >> 24) & 0xff);
+    void flush(ostream& os){
+        os.write(&data.front(), data.size());
+        os.flush();
+        seekOffset += data.size();
+        data.clear();
     }
 
-    void writeInt(int pos, int value){
-        data[pos++] = value & 0xff;
-        data[pos++] = (value >> 8) & 0xff;
-        data[pos++] = (value >> 16) & 0xff;
-        data[pos++] = (value >> 24) & 0xff;
+    //! \return false if the data is discarded because the writer does not accept it
+    bool flush(LogFileWriter& writer){
+        size_t size = data.size();
+        if(writer.push(data)){
+            seekOffset += size;
+            return true;
+        }
+        data.clear();
+        return false;
     }
 
     void writeSeekPos(int pos){
@@ -286,35 +423,6 @@ public:
     void writeSeekOffset(int pos, int offset){
         writeInt(pos, offset);
     }
-    
-    void writeFloat(float value){
-        char* p = (char*)&value;
-        const int n = sizeof(float);
-        for(int i=0; i < n; ++i){
-            data.push_back(p[i]);
-        }
-    }
-
-    void writeSE3(const SE3& position){
-        const Vector3& p = position.translation();
-        writeFloat(p.x());
-        writeFloat(p.y());
-        writeFloat(p.z());
-        const Quaternion& q = position.rotation();
-        writeFloat(q.w());
-        writeFloat(q.x());
-        writeFloat(q.y());
-        writeFloat(q.z());
-    }
-
-    void writeString(const std::string& str){
-        const int size = str.size();
-        data.reserve(data.size() + size + 1);
-        writeShort((unsigned char)size);
-        for(int i=0; i < size; ++i){
-            writeOctet(str[i]);
-        }
-    }
 };
 
 
@@ -336,9 +444,12 @@ public:
     BodyItem* bodyItem;
     Body* body;
     vector<DeviceInfo> deviceInfos;
+    int linkPositionKeySeekPos;
+    SE3Array linkPositionKey;
     
     BodyInfo(BodyItem* bodyItem){
         this->bodyItem = bodyItem;
+        linkPositionKeySeekPos = 0;
         if(bodyItem){
             body = bodyItem->body();
             deviceInfos.resize(body->numDevices());
@@ -405,9 +516,11 @@ public:
     bool isTimeStampSuffixEnabled;
     vector<string> bodyNames;
     
-    ofstream ofs;
+    LogFileWriter logFileWriter;
     WriteBuf writeBuf;
     int lastOutputFramePos;
+    int prevOutputFramePos;
+    int numDroppedFrames;
     double recordingFrameRate;
     stack<int> sizeHeaderStack;
 
@@ -426,6 +539,49 @@ public:
     int currentDeviceStateCacheArrayIndex;
     vector<double> doubleWriteBuf;
 
+    struct FrameIndexEntry {
+        float time;
+        int pos;
+    };
+    vector<FrameIndexEntry> frameIndex;
+    // The entries of the frames that have not been written to the log file yet
+    struct PendingFrameIndexEntry {
+        FrameIndexEntry entry;
+        size_t endPos;
+    };
+    deque<PendingFrameIndexEntry> pendingFrameIndexEntries;
+    ofstream indexOfs;
+    WriteBuf indexWriteBuf;
+    int lastOutputFrameIndexCounter;
+    float lastOutputFrameTime;
+
+    // for the delta encoding of link positions
+    bool isLinkPositionDeltaEncodingEnabled;
+    double linkPositionTolerance;
+    struct LinkPositionKey {
+        SE3Array positions;
+        int seekPos;
+        int numDeltaFrames;
+    };
+    vector<LinkPositionKey> linkPositionKeys;
+    vector<int> changedLinkIndices;
+    int outputBodyIndex;
+
+    // for the log sharding
+    double shardSizeLimit; // in megabytes
+    double shardTimeLength;
+    struct ShardInfo {
+        string filename; // without the directory
+        double startTime;
+    };
+    vector<ShardInfo> shards;
+    int outputShardIndex;
+    int numShardOutputFrames;
+    int readShardIndex;
+    vector<string> outputBodyNames;
+    // The index of the shard being recorded, which is the same as frameIndex when the shard is read
+    vector<FrameIndexEntry> outputFrameIndex;
+
     ifstream ifs;
     ReadBuf readBuf;
     ReadBuf readBuf2;
@@ -445,25 +601,43 @@ public:
     ~Impl();
     bool setLogFile(const std::string& name, bool isLoading = false);
     string getActualFilename();
+    string getShardFilename(int shardIndex);
+    string getIndexFilename(int shardIndex);
+    string getShardManifestFilename();
+    bool isShardingEnabled() const;
+    void loadShardManifest();
+    void writeShardManifest();
+    int findShard(double time) const;
     void updateBodyInfos();
     void onWorldSubTreeChanged();
     bool readTopHeader();
     bool readFrameHeader(int pos);
+    void loadFrameIndex();
+    bool seekToIndexedFrame(double time);
     bool seek(double time);
     bool recallStateAtTime(double time);
     bool loadCurrentFrameData();
     void readBodyStatees();
     void readBodyState(BodyInfo* bodyInfo, double time);
     int readLinkPositions(Body* body);
+    int readLinkPositionDeltas(BodyInfo* bodyInfo);
+    bool loadLinkPositionKey(BodyInfo* bodyInfo, int pos);
     int readJointPositions(Body* body);
     void readDeviceStates(BodyInfo* bodyInfo, double time);
     void readDeviceState(DeviceInfo& devInfo, Device* device, ReadBuf& buf, int size);
     void readLastDeviceState(DeviceInfo& devInfo, Device* device);
     void clearOutput();
+    void openOutputShard();
+    void startNextShard(double time);
     void reserveSizeHeader();
     void fixSizeHeader();
     void endHeaderOutput();
     void beginFrameOutput(double time);
+    void outputLinkPositions(SE3* positions, int size);
+    void writeLinkPositionKey(LinkPositionKey& key, SE3* positions, int size);
+    void endFrameOutput();
+    void updateFrameIndex(bool isOutputFinished);
+    void finishOutput();
     void outputDeviceState(DeviceState* state);
     void exchangeDeviceStateCacheArrays();
     void openDialogToSelectDirectoryToSavePlaybackArchive();
@@ -514,12 +688,19 @@ WorldLogFileItem::WorldLogFileItem()
 
 WorldLogFileItem::Impl::Impl(WorldLogFileItem* self)
     : self(self),
-      writeBuf(ofs),
       readBuf(ifs),
       readBuf2(ifs)
 {
     isTimeStampSuffixEnabled = false;
     recordingFrameRate = 0.0;
+    isLinkPositionDeltaEncodingEnabled = false;
+    linkPositionTolerance = 0.0;
+    shardSizeLimit = 0.0;
+    shardTimeLength = 0.0;
+    outputShardIndex = 0;
+    numShardOutputFrames = 0;
+    readShardIndex = 0;
+    lastOutputFrameIndexCounter = 0;
     isBodyInfoUpdateNeeded = true;
 }
 
@@ -533,12 +714,19 @@ WorldLogFileItem::WorldLogFileItem(const WorldLogFileItem& org)
 
 WorldLogFileItem::Impl::Impl(WorldLogFileItem* self, Impl& org)
     : self(self),
-      writeBuf(ofs),
       readBuf(ifs),
       readBuf2(ifs)
 {
     isTimeStampSuffixEnabled = org.isTimeStampSuffixEnabled;
     recordingFrameRate = org.recordingFrameRate;
+    isLinkPositionDeltaEncodingEnabled = org.isLinkPositionDeltaEncodingEnabled;
+    linkPositionTolerance = org.linkPositionTolerance;
+    shardSizeLimit = org.shardSizeLimit;
+    shardTimeLength = org.shardTimeLength;
+    outputShardIndex = 0;
+    numShardOutputFrames = 0;
+    readShardIndex = 0;
+    lastOutputFrameIndexCounter = 0;
     isBodyInfoUpdateNeeded = true;
 }
 
@@ -551,7 +739,7 @@ WorldLogFileItem::~WorldLogFileItem()
 
 WorldLogFileItem::Impl::~Impl()
 {
-
+    finishOutput();
 }
 
 
@@ -583,6 +771,10 @@ bool WorldLogFileItem::setLogFile(const std::string& filename)
 bool WorldLogFileItem::Impl::setLogFile(const std::string& filename, bool isLoading)
 {
     self->updateFileInformation(filename, "CNOID-WORLD-LOG");
+    // The shards are being updated by the recording
+    if(!logFileWriter.is_open()){
+        loadShardManifest();
+    }
     bool loaded = readTopHeader();
     return isLoading ? loaded : true;
 }
@@ -600,6 +792,28 @@ bool WorldLogFileItem::isTimeStampSuffixEnabled() const
 }
 
 
+string WorldLogFileItem::Impl::getShardFilename(int shardIndex)
+{
+    if(shardIndex > 0 && shardIndex < static_cast<int>(shards.size())){
+        filesystem::path filepath(fromUTF8(getActualFilename()));
+        return toUTF8((filepath.parent_path() / fromUTF8(shards[shardIndex].filename)).generic_string());
+    }
+    return getActualFilename();
+}
+
+
+string WorldLogFileItem::Impl::getIndexFilename(int shardIndex)
+{
+    return getShardFilename(shardIndex) + ".index";
+}
+
+
+string WorldLogFileItem::Impl::getShardManifestFilename()
+{
+    return getActualFilename() + ".shards";
+}
+
+
 string WorldLogFileItem::Impl::getActualFilename()
 {
     if(isTimeStampSuffixEnabled && recordingStartTime.isValid()){
@@ -626,6 +840,121 @@ double WorldLogFileItem::recordingFrameRate() const
 }
 
 
+void WorldLogFileItem::setLinkPositionDeltaEncodingEnabled(bool on)
+{
+    impl->isLinkPositionDeltaEncodingEnabled = on;
+}
+
+
+bool WorldLogFileItem::isLinkPositionDeltaEncodingEnabled() const
+{
+    return impl->isLinkPositionDeltaEncodingEnabled;
+}
+
+
+void WorldLogFileItem::setLinkPositionTolerance(double tolerance)
+{
+    impl->linkPositionTolerance = std::max(0.0, tolerance);
+}
+
+
+double WorldLogFileItem::linkPositionTolerance() const
+{
+    return impl->linkPositionTolerance;
+}
+
+
+void WorldLogFileItem::setShardSizeLimit(double megabytes)
+{
+    impl->shardSizeLimit = std::max(0.0, megabytes);
+}
+
+
+double WorldLogFileItem::shardSizeLimit() const
+{
+    return impl->shardSizeLimit;
+}
+
+
+void WorldLogFileItem::setShardTimeLength(double length)
+{
+    impl->shardTimeLength = std::max(0.0, length);
+}
+
+
+double WorldLogFileItem::shardTimeLength() const
+{
+    return impl->shardTimeLength;
+}
+
+
+bool WorldLogFileItem::Impl::isShardingEnabled() const
+{
+    return shardSizeLimit > 0.0 || shardTimeLength > 0.0;
+}
+
+
+void WorldLogFileItem::Impl::loadShardManifest()
+{
+    shards.clear();
+    readShardIndex = 0;
+
+    string filename = getShardManifestFilename();
+    if(!filesystem::exists(fromUTF8(filename))){
+        return;
+    }
+    try {
+        YAMLReader reader;
+        auto manifest = reader.loadDocument(filename)->toMapping();
+        if(manifest->get("type", "") != shardManifestType){
+            return;
+        }
+        auto& shardNodes = *manifest->findListing("shards");
+        if(shardNodes.isValid()){
+            for(int i=0; i < shardNodes.size(); ++i){
+                auto node = shardNodes[i].toMapping();
+                ShardInfo shard;
+                shard.filename = node->get("file").toString();
+                shard.startTime = node->get("time").toDouble();
+                shards.push_back(shard);
+            }
+        }
+    }
+    catch(const ValueNode::Exception& ex){
+        shards.clear();
+    }
+}
+
+
+void WorldLogFileItem::Impl::writeShardManifest()
+{
+    YAMLWriter writer(getShardManifestFilename());
+    writer.startMapping();
+    writer.putKeyValue("type", shardManifestType);
+    writer.putKey("shards");
+    writer.startListing();
+    for(auto& shard : shards){
+        writer.startFlowStyleMapping();
+        writer.putKey("file");
+        writer.putDoubleQuotedString(shard.filename);
+        writer.putKeyValue("time", shard.startTime);
+        writer.endMapping();
+    }
+    writer.endListing();
+    writer.endMapping();
+}
+
+
+//! \return The index of the last shard starting at or before the time
+int WorldLogFileItem::Impl::findShard(double time) const
+{
+    auto p = std::upper_bound(
+        shards.begin(), shards.end(), time,
+        [](double t, const ShardInfo& shard){ return t < shard.startTime; });
+    return std::max(0, static_cast<int>(p - shards.begin()) - 1);
+}
+
+
 void WorldLogFileItem::Impl::updateBodyInfos()
 {
     bodyInfos.clear();
@@ -686,7 +1015,7 @@ bool WorldLogFileItem::Impl::readTopHeader()
     if(ifs.is_open()){
         ifs.close();
     }
-    string fname = fromUTF8(getActualFilename());
+    string fname = fromUTF8(getShardFilename(readShardIndex));
     if(filesystem::exists(fname)){
         ifs.open(fname.c_str(), ios::in | ios::binary);
         if(ifs.is_open()){
@@ -706,6 +1035,13 @@ bool WorldLogFileItem::Impl::readTopHeader()
         }
     }
 
+    // The index is updated in recording while the log file is being written
+    if(!logFileWriter.is_open() || readShardIndex != outputShardIndex){
+        loadFrameIndex();
+    } else {
+        frameIndex = outputFrameIndex;
+    }
+
     isBodyInfoUpdateNeeded = true;
 
     return result;
@@ -742,10 +1078,80 @@ bool WorldLogFileItem::Impl::readFrameHeader(int pos)
 }
         
         
+/**
+   The index file is not loaded when it does not exist, which is the case of the log files
+   recorded by the old versions. The frames are scanned from the current frame in that case.
+*/
+void WorldLogFileItem::Impl::loadFrameIndex()
+{
+    frameIndex.clear();
+
+    ifstream indexIfs(fromUTF8(getIndexFilename(readShardIndex)).c_str(), ios::in | ios::binary);
+    if(!indexIfs.is_open()){
+        return;
+    }
+    ReadBuf buf(indexIfs);
+    try {
+        if(buf.readString() != frameIndexFileMagic || buf.readInt() != frameIndexFileVersion){
+            return;
+        }
+        const int entrySize = sizeof(float) + sizeof(int);
+        int lastPos = 0;
+        while(buf.checkSize(entrySize)){
+            FrameIndexEntry entry;
+            entry.time = buf.readFloat();
+            entry.pos = buf.readSeekOffset();
+            if(entry.pos <= lastPos){
+                frameIndex.clear();
+                break;
+            }
+            frameIndex.push_back(entry);
+            lastPos = entry.pos;
+        }
+    }
+    catch(NotEnoughDataException& ex){
+        frameIndex.clear();
+    }
+}
+
+
+/**
+   This function moves the current frame to the last indexed frame at or before the time
+   unless the current frame is already between the indexed frame and the time.
+*/
+bool WorldLogFileItem::Impl::seekToIndexedFrame(double time)
+{
+    auto p = std::upper_bound(
+        frameIndex.begin(), frameIndex.end(), time,
+        [](double t, const FrameIndexEntry& entry){ return t < entry.time; });
+    if(p != frameIndex.begin()){
+        --p;
+    }
+    if(currentReadFrameTime >= p->time && currentReadFrameTime <= time){
+        return true;
+    }
+    int orgPos = currentReadFramePos;
+    if(readFrameHeader(p->pos) && currentReadFrameTime == p->time){
+        return true;
+    }
+    // The index does not match the log file
+    frameIndex.clear();
+    return readFrameHeader(orgPos);
+}
+
+
 bool WorldLogFileItem::Impl::seek(double time)
 {
     isOverRange = false;
 
+    if(shards.size() > 1){
+        int shardIndex = findShard(time);
+        if(shardIndex != readShardIndex){
+            readShardIndex = shardIndex;
+            readTopHeader();
+        }
+    }
+
     if(!readFrameHeader(currentReadFramePos)){
         readTopHeader();
     }
@@ -754,6 +1160,15 @@ bool WorldLogFileItem::Impl::seek(double time)
         return true;
     }
 
+    if(!frameIndex.empty()){
+        if(!seekToIndexedFrame(time)){
+            return false;
+        }
+        if(currentReadFrameTime == time){
+            return true;
+        }
+    }
+
     if(currentReadFrameTime < time){
         while(true){
             int pos = currentReadFramePos;
@@ -860,7 +1275,12 @@ void WorldLogFileItem::Impl::readBodyState(BodyInfo* bodyInfo, double time)
         int dataType = readBuf.readID();
         switch(dataType){
         case LINK_POSITIONS:
-            numLinks = readLinkPositions(bodyInfo->body);
+        case LINK_POSITION_DELTAS:
+            if(dataType == LINK_POSITIONS){
+                numLinks = readLinkPositions(bodyInfo->body);
+            } else {
+                numLinks = readLinkPositionDeltas(bodyInfo);
+            }
             if(numLinks > 0){
                 updated = true;
                 if(numLinks > 1){
@@ -907,6 +1327,63 @@ int WorldLogFileItem::Impl::readLinkPositions(Body* body)
 }
 
 
+int WorldLogFileItem::Impl::readLinkPositionDeltas(BodyInfo* bodyInfo)
+{
+    int endPos = readBuf.readNextBlockPos();
+    int keyPos = readBuf.readSeekOffset();
+    int size = readBuf.readShort();
+    if(keyPos != bodyInfo->linkPositionKeySeekPos){
+        if(!loadLinkPositionKey(bodyInfo, keyPos)){
+            readBuf.seek(endPos);
+            return 0;
+        }
+    }
+    Body* body = bodyInfo->body;
+    const SE3Array& key = bodyInfo->linkPositionKey;
+    int n = std::min(size, body->numLinks());
+    n = std::min(n, static_cast<int>(key.size()));
+    for(int i=0; i < n; ++i){
+        Link* link = body->link(i);
+        link->p() = key[i].translation();
+        link->R() = key[i].rotation().toRotationMatrix();
+    }
+    int numChangedLinks = readBuf.readShort();
+    for(int i=0; i < numChangedLinks; ++i){
+        int index = readBuf.readShort();
+        SE3 position = readBuf.readSE3();
+        if(index < n){
+            Link* link = body->link(index);
+            link->p() = position.translation();
+            link->R() = position.rotation().toRotationMatrix();
+        }
+    }
+    readBuf.seek(endPos);
+    return n;
+}
+
+
+bool WorldLogFileItem::Impl::loadLinkPositionKey(BodyInfo* bodyInfo, int pos)
+{
+    SE3Array& key = bodyInfo->linkPositionKey;
+    bodyInfo->linkPositionKeySeekPos = 0;
+    ifs.seekg(pos);
+    readBuf2.clear();
+    try {
+        int size = readBuf2.readShort();
+        key.resize(size);
+        for(int i=0; i < size; ++i){
+            key[i] = readBuf2.readSE3();
+        }
+    }
+    catch(NotEnoughDataException& ex){
+        key.clear();
+        return false;
+    }
+    bodyInfo->linkPositionKeySeekPos = pos;
+    return true;
+}
+
+
 int WorldLogFileItem::Impl::readJointPositions(Body* body)
 {
     int endPos = readBuf.readNextBlockPos();
@@ -1007,20 +1484,72 @@ void WorldLogFileItem::Impl::clearOutput()
     if(ifs.is_open()){
         ifs.close();
     }
-    if(ofs.is_open()){
-        ofs.close();
-    }
+    finishOutput();
     recordingStartTime = QDateTime::currentDateTime();
-    
-    ofs.open(fromUTF8(getActualFilename()).c_str(), ios::out | ios::binary | ios::trunc);
-    writeBuf.clear();
-    lastOutputFramePos = 0;
+    numDroppedFrames = 0;
+
+    shards.clear();
+    outputShardIndex = 0;
+    readShardIndex = 0;
+    if(isShardingEnabled()){
+        ShardInfo shard;
+        shard.filename = toUTF8(filesystem::path(fromUTF8(getActualFilename())).filename().string());
+        shard.startTime = 0.0;
+        shards.push_back(shard);
+    } else {
+        // The manifest of the previous recording must not be applied to the new log file
+        stdx::error_code ec;
+        filesystem::remove(fromUTF8(getShardManifestFilename()), ec);
+    }
+    frameIndex.clear();
+    outputBodyNames.clear();
+
+    openOutputShard();
+}
+
 
+void WorldLogFileItem::Impl::openOutputShard()
+{
+    logFileWriter.open(fromUTF8(getShardFilename(outputShardIndex)));
+    writeBuf.reset();
+    lastOutputFramePos = 0;
+    numShardOutputFrames = 0;
+
+    outputFrameIndex.clear();
+    pendingFrameIndexEntries.clear();
+    indexOfs.open(fromUTF8(getIndexFilename(outputShardIndex)).c_str(), ios::out | ios::binary | ios::trunc);
+    indexWriteBuf.reset();
+    indexWriteBuf.writeString(frameIndexFileMagic);
+    indexWriteBuf.writeInt(frameIndexFileVersion);
+    indexWriteBuf.flush(indexOfs);
+    // The first frame is always indexed
+    lastOutputFrameIndexCounter = frameIndexInterval - 1;
+
+    linkPositionKeys.clear();
+    deviceStateCacheArrays[0].clear();
+    deviceStateCacheArrays[1].clear();
     currentDeviceStateCacheArrayIndex = 0;
     exchangeDeviceStateCacheArrays();
 }
 
 
+void WorldLogFileItem::Impl::finishOutput()
+{
+    if(logFileWriter.is_open()){
+        logFileWriter.close();
+        updateFrameIndex(true);
+        if(logFileWriter.hasWriteError()){
+            MessageView::instance()->putln(
+                format(_("The log file of {0} was not written correctly."), self->displayName()),
+                MessageView::Error);
+        }
+    }
+    if(indexOfs.is_open()){
+        indexOfs.close();
+    }
+}
+
+
 void WorldLogFileItem::Impl::reserveSizeHeader()
 {
     sizeHeaderStack.push(writeBuf.size());
@@ -1062,7 +1591,37 @@ void WorldLogFileItem::endHeaderOutput()
 void WorldLogFileItem::Impl::endHeaderOutput()
 {
     fixSizeHeader();
-    writeBuf.flush();
+    writeBuf.flush(logFileWriter);
+    outputBodyNames = bodyNames;
+}
+
+
+/**
+   The current shard is closed and the recording is continued in the next shard, which begins
+   with the same header. This function blocks until the queued data of the current shard is
+   written to the file.
+*/
+void WorldLogFileItem::Impl::startNextShard(double time)
+{
+    finishOutput();
+
+    ++outputShardIndex;
+    filesystem::path filepath(fromUTF8(getActualFilename()));
+    ShardInfo shard;
+    shard.filename = toUTF8(
+        (filepath.stem().string() + "-" + std::to_string(outputShardIndex) + filepath.extension().string()));
+    shard.startTime = time;
+    shards.push_back(shard);
+
+    openOutputShard();
+
+    writeBuf.clear();
+    reserveSizeHeader();
+    for(auto& name : outputBodyNames){
+        writeBuf.writeString(name);
+    }
+    fixSizeHeader();
+    writeBuf.flush(logFileWriter);
 }
 
 
@@ -1086,6 +1645,19 @@ void WorldLogFileItem::beginFrameOutput(double time)
 
 void WorldLogFileItem::Impl::beginFrameOutput(double time)
 {
+    if(!shards.empty()){
+        if(numShardOutputFrames > 0 &&
+           ((shardSizeLimit > 0.0 && writeBuf.seekPos() >= shardSizeLimit * 1024.0 * 1024.0) ||
+            (shardTimeLength > 0.0 && time - shards[outputShardIndex].startTime >= shardTimeLength))){
+            startNextShard(time);
+        }
+        if(numShardOutputFrames == 0){
+            shards[outputShardIndex].startTime = time;
+            writeShardManifest();
+        }
+    }
+    ++numShardOutputFrames;
+
     size_t pos = writeBuf.seekPos();
     
     if(lastOutputFramePos){
@@ -1093,9 +1665,16 @@ void WorldLogFileItem::Impl::beginFrameOutput(double time)
     } else {
         writeBuf.writeSeekOffset(0);
     }
+    prevOutputFramePos = lastOutputFramePos;
     lastOutputFramePos = pos;
+    lastOutputFrameTime = time;
     
     deviceIndex = 0;
+    if(lastOutputFrameIndexCounter + 1 >= frameIndexInterval){
+        // The frame to be indexed is the key frame of the device states
+        numDeviceStateCaches = 0;
+    }
+    outputBodyIndex = -1;
     writeBuf.writeFloat(time);
     reserveSizeHeader(); // area for the frame data size
 }
@@ -1105,18 +1684,105 @@ void WorldLogFileItem::beginBodyStateOutput()
 {
     impl->writeBuf.writeID(BODY_STATE);
     impl->reserveSizeHeader();
+    ++impl->outputBodyIndex;
 }
 
 
 void WorldLogFileItem::outputLinkPositions(SE3* positions, int size)
 {
-    impl->writeBuf.writeID(LINK_POSITIONS);
-    impl->reserveSizeHeader();
-    impl->writeBuf.writeShort(size);
+    impl->outputLinkPositions(positions, size);
+}
+
+
+static SE3 toFloatPrecision(const SE3& position)
+{
+    const Vector3& p = position.translation();
+    const Quaternion& q = position.rotation();
+    return SE3(Vector3(static_cast<float>(p.x()), static_cast<float>(p.y()), static_cast<float>(p.z())),
+               Quaternion(static_cast<float>(q.w()), static_cast<float>(q.x()),
+                          static_cast<float>(q.y()), static_cast<float>(q.z())));
+}
+
+
+/**
+   The positions are compared as written in the log file. The tolerance is applied to both
+   the distance in meters and the rotation angle in radians.
+*/
+static bool isWithinTolerance(const SE3& position, const SE3& keyPosition, double tolerance)
+{
+    SE3 written = toFloatPrecision(position);
+    if(tolerance <= 0.0){
+        return written.translation() == keyPosition.translation() &&
+            written.rotation().coeffs() == keyPosition.rotation().coeffs();
+    }
+    return (written.translation() - keyPosition.translation()).norm() <= tolerance &&
+        written.rotation().angularDistance(keyPosition.rotation()) <= tolerance;
+}
+
+
+void WorldLogFileItem::Impl::outputLinkPositions(SE3* positions, int size)
+{
+    if(!isLinkPositionDeltaEncodingEnabled || outputBodyIndex < 0){
+        writeBuf.writeID(LINK_POSITIONS);
+        reserveSizeHeader();
+        writeBuf.writeShort(size);
+        for(int i=0; i < size; ++i){
+            writeBuf.writeSE3(positions[i]);
+        }
+        fixSizeHeader();
+        return;
+    }
+
+    if(outputBodyIndex >= static_cast<int>(linkPositionKeys.size())){
+        linkPositionKeys.resize(outputBodyIndex + 1);
+        linkPositionKeys[outputBodyIndex].seekPos = 0;
+    }
+    auto& key = linkPositionKeys[outputBodyIndex];
+    
+    if(key.seekPos > 0 &&
+       key.numDeltaFrames < linkPositionKeyFrameInterval &&
+       static_cast<int>(key.positions.size()) == size){
+
+        changedLinkIndices.clear();
+        for(int i=0; i < size; ++i){
+            if(!isWithinTolerance(positions[i], key.positions[i], linkPositionTolerance)){
+                changedLinkIndices.push_back(i);
+            }
+        }
+        // A key frame is written instead if it is not much larger than the deltas
+        if(static_cast<int>(changedLinkIndices.size()) * 2 <= size){
+            writeBuf.writeID(LINK_POSITION_DELTAS);
+            reserveSizeHeader();
+            writeBuf.writeSeekPos(key.seekPos);
+            writeBuf.writeShort(size);
+            writeBuf.writeShort(changedLinkIndices.size());
+            for(auto& index : changedLinkIndices){
+                writeBuf.writeShort(index);
+                writeBuf.writeSE3(positions[index]);
+            }
+            fixSizeHeader();
+            ++key.numDeltaFrames;
+            return;
+        }
+    }
+
+    writeLinkPositionKey(key, positions, size);
+}
+
+
+void WorldLogFileItem::Impl::writeLinkPositionKey(LinkPositionKey& key, SE3* positions, int size)
+{
+    writeBuf.writeID(LINK_POSITIONS);
+    reserveSizeHeader();
+    key.seekPos = writeBuf.seekPos();
+    key.numDeltaFrames = 0;
+    key.positions.resize(size);
+    writeBuf.writeShort(size);
     for(int i=0; i < size; ++i){
-        impl->writeBuf.writeSE3(positions[i]);
+        writeBuf.writeSE3(positions[i]);
+        key.positions[i] = toFloatPrecision(positions[i]);
     }
-    impl->fixSizeHeader();
+    fixSizeHeader();
 }
 
 
@@ -1193,9 +1859,73 @@ void WorldLogFileItem::endBodyStateOutput()
 
 void WorldLogFileItem::endFrameOutput()
 {
-    impl->fixSizeHeader();
-    impl->writeBuf.flush();
-    impl->exchangeDeviceStateCacheArrays();
+    impl->endFrameOutput();
+}
+
+
+void WorldLogFileItem::Impl::endFrameOutput()
+{
+    fixSizeHeader();
+
+    if(!writeBuf.flush(logFileWriter)){
+        /*
+          The writer thread cannot keep up with the output. The frame is dropped so that the
+          simulation is not blocked, and the next frame is linked to the previous one. The
+          device states of the next frame are fully written because the cached positions of
+          the states in the dropped frame are invalid.
+        */
+        lastOutputFramePos = prevOutputFramePos;
+        linkPositionKeys.clear();
+        deviceStateCacheArrays[0].clear();
+        deviceStateCacheArrays[1].clear();
+        exchangeDeviceStateCacheArrays();
+        if(numDroppedFrames++ == 0){
+            MessageView::instance()->putln(
+                format(_("Writing the log file of {0} is behind the simulation. "
+                         "Some frames are not recorded."), self->displayName()),
+                MessageView::Warning);
+        }
+        return;
+    }
+    exchangeDeviceStateCacheArrays();
+
+    if(++lastOutputFrameIndexCounter >= frameIndexInterval){
+        PendingFrameIndexEntry pending;
+        pending.entry.time = lastOutputFrameTime;
+        pending.entry.pos = lastOutputFramePos;
+        pending.endPos = writeBuf.seekPos();
+        pendingFrameIndexEntries.push_back(pending);
+        lastOutputFrameIndexCounter = 0;
+    }
+    updateFrameIndex(false);
+}
+
+
+/**
+   The frame is indexed after it is written to the log file by the writer thread so that
+   the indexed frame can be read when the index is used.
+*/
+void WorldLogFileItem::Impl::updateFrameIndex(bool isOutputFinished)
+{
+    size_t writtenBytes = logFileWriter.writtenBytes();
+    while(!pendingFrameIndexEntries.empty()){
+        auto& pending = pendingFrameIndexEntries.front();
+        if(!isOutputFinished && pending.endPos > writtenBytes){
+            break;
+        }
+        outputFrameIndex.push_back(pending.entry);
+        if(readShardIndex == outputShardIndex){
+            frameIndex.push_back(pending.entry);
+        }
+        if(indexOfs.is_open()){
+            indexWriteBuf.writeFloat(pending.entry.time);
+            indexWriteBuf.writeSeekOffset(pending.entry.pos);
+        }
+        pendingFrameIndexEntries.pop_front();
+    }
+    if(indexWriteBuf.size() > 0){
+        indexWriteBuf.flush(indexOfs);
+    }
 }
 
 
@@ -1203,6 +1933,7 @@ void WorldLogFileItem::Impl::exchangeDeviceStateCacheArrays()
 {
     int i = 1 - currentDeviceStateCacheArrayIndex;
     pCurrentDeviceStateCacheArray = &deviceStateCacheArrays[i];
+    pCurrentDeviceStateCacheArray->clear();
     pLastDeviceStateCacheArray = &deviceStateCacheArrays[1-i];
     numDeviceStateCaches = pLastDeviceStateCacheArray->size();
     currentDeviceStateCacheArrayIndex = i;
@@ -1220,6 +1951,15 @@ void WorldLogFileItem::doPutProperties(PutPropertyFunction& putProperty)
                 changeProperty(impl->isTimeStampSuffixEnabled));
     putProperty(_("Recording frame rate"), impl->recordingFrameRate,
                 changeProperty(impl->recordingFrameRate));
+    putProperty(_("Link position delta encoding"), impl->isLinkPositionDeltaEncodingEnabled,
+                changeProperty(impl->isLinkPositionDeltaEncodingEnabled));
+    putProperty.min(0.0).decimals(6)(
+        _("Link position tolerance"), impl->linkPositionTolerance,
+        changeProperty(impl->linkPositionTolerance));
+    putProperty.min(0.0).decimals(1)(
+        _("Shard size limit [MB]"), impl->shardSizeLimit, changeProperty(impl->shardSizeLimit));
+    putProperty.min(0.0).decimals(1)(
+        _("Shard time length"), impl->shardTimeLength, changeProperty(impl->shardTimeLength));
 }
 
 
@@ -1228,6 +1968,14 @@ bool WorldLogFileItem::store(Archive& archive)
     archive.writeFileInformation(this);
     archive.write("timeStampSuffix", impl->isTimeStampSuffixEnabled);
     archive.write("recordingFrameRate", impl->recordingFrameRate);
+    archive.write("linkPositionDeltaEncoding", impl->isLinkPositionDeltaEncodingEnabled);
+    archive.write("linkPositionTolerance", impl->linkPositionTolerance);
+    if(impl->shardSizeLimit > 0.0){
+        archive.write("shardSizeLimit", impl->shardSizeLimit);
+    }
+    if(impl->shardTimeLength > 0.0){
+        archive.write("shardTimeLength", impl->shardTimeLength);
+    }
     return true;
 }
 
@@ -1236,6 +1984,10 @@ bool WorldLogFileItem::restore(const Archive& archive)
 {
     archive.read("timeStampSuffix", impl->isTimeStampSuffixEnabled);
     archive.read("recordingFrameRate", impl->recordingFrameRate);
+    archive.read("linkPositionDeltaEncoding", impl->isLinkPositionDeltaEncodingEnabled);
+    archive.read("linkPositionTolerance", impl->linkPositionTolerance);
+    archive.read("shardSizeLimit", impl->shardSizeLimit);
+    archive.read("shardTimeLength", impl->shardTimeLength);
 
     std::string filename;
     if(archive.read({ "file", "filename" }, filename)){
@@ -1349,6 +2101,32 @@ void WorldLogFileItem::Impl::saveProjectAsPlaybackArchive(const string& projectF
                        ec.message()));
             return;
         }
+        /*
+          The archive can be played back without the index files, so the copy errors of them
+          are ignored. The shards are also copied when the log is sharded.
+        */
+        vector<string> extraFiles;
+        extraFiles.push_back(getIndexFilename(0));
+        if(shards.size() > 1){
+            extraFiles.push_back(getShardManifestFilename());
+            for(size_t i=1; i < shards.size(); ++i){
+                extraFiles.push_back(getShardFilename(i));
+                extraFiles.push_back(getIndexFilename(i));
+            }
+        }
+        for(auto& file : extraFiles){
+            filesystem::path filePath(fromUTF8(file));
+            if(filesystem::exists(filePath, ec)){
+                filesystem::copy_file(
+                    filePath, info.archiveDirPath / filePath.filename(),
+#if __cplusplus > 201402L            
+                    filesystem::copy_options::overwrite_existing,
+#else
+                    filesystem::copy_option::overwrite_if_exists,
+#endif
+                    ec);
+            }
+        }
         setLogFile(toUTF8((info.archiveDirPath / logFilePath.filename()).generic_string()));
         isTimeStampSuffixEnabled = false;
 
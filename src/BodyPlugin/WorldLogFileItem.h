@@ -32,6 +32,25 @@ public:
     void setRecordingFrameRate(double rate);
     double recordingFrameRate() const;
 
+    /**
+       When the delta encoding is enabled, the link positions of each body are written only for
+       the links that moved from the last key frame beyond the tolerance. It is disabled by default.
+    */
+    void setLinkPositionDeltaEncodingEnabled(bool on);
+    bool isLinkPositionDeltaEncodingEnabled() const;
+    void setLinkPositionTolerance(double tolerance);
+    double linkPositionTolerance() const;
+
+    /**
+       When the size limit in megabytes or the time length is set, the log is split into multiple
+       files called shards, and a new shard is started when the current one exceeds either limit.
+       The playback seeks across the shards seamlessly. Zero disables each limit.
+    */
+    void setShardSizeLimit(double megabytes);
+    double shardSizeLimit() const;
+    void setShardTimeLength(double length);
+    double shardTimeLength() const;
+
     void clearOutput();
     void beginHeaderOutput();
     int outputBodyHeader(const std::string& name);
@@ -0,0 +1,594 @@
+#include "WorldLogStreamItem.h"
+#include "WorldLogEncoding.h"
+#include <cnoid/ItemManager>
+#include <cnoid/PutPropertyFunction>
+#include <cnoid/Archive>
+#include <cnoid/MessageView>
+#include <cnoid/Device>
+#include <cnoid/EigenTypes>
+#include <fmt/format.h>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <vector>
+#include <deque>
+#include <stack>
+#include <unordered_map>
+#include <memory>
+#include <algorithm>
+#include "gettext.h"
+
+using namespace std;
+using namespace cnoid;
+using fmt::format;
+using namespace cnoid::world_log;
+
+namespace {
+
+/*
+  Each message of the stream begins with the message size and the message type ID. The size
+  is the number of the bytes following it. The header message has the magic string, the version
+  number and the names of the bodies, and it is sent when a subscriber connects and when a new
+  simulation is started. The frame message has the same data as a frame of the world log file
+  except that the link positions and the device states are always fully written so that a frame
+  can be decoded without the previous frames.
+*/
+const char* streamMagic = "CNOID-WORLD-LOG-STREAM";
+const int streamVersion = 1;
+
+enum MessageTypeID {
+    HEADER_MESSAGE,
+    FRAME_MESSAGE
+};
+
+// The frames are kept in the queue of a subscriber while the socket has this amount of unsent data
+const qint64 maxSocketBufferSize = 256 * 1024;
+
+typedef shared_ptr<const vector<char>> MessagePtr;
+
+struct Subscriber
+{
+    QTcpSocket* socket;
+    deque<MessagePtr> queue;
+};
+
+}
+
+namespace cnoid {
+
+class WorldLogStreamItem::Impl
+{
+public:
+    WorldLogStreamItem* self;
+    int port;
+    double streamingFrameRate;
+    int maxNumQueuedFrames;
+    bool isContactStreamingEnabled;
+
+    QTcpServer server;
+    vector<unique_ptr<Subscriber>> subscribers;
+    MessagePtr header;
+    vector<string> bodyNames;
+    unordered_map<const Body*, int> bodyIndexMap;
+    WriteBufBase writeBuf;
+    stack<int> sizeHeaderStack;
+    vector<double> doubleWriteBuf;
+    bool isFrameOutputActive;
+    int numDroppedFrames;
+
+    Impl(WorldLogStreamItem* self);
+    Impl(WorldLogStreamItem* self, const Impl& org);
+    ~Impl();
+    void initialize();
+    bool startStreaming();
+    void stopStreaming();
+    void onNewConnection();
+    void removeSubscriber(QTcpSocket* socket);
+    void reserveSizeHeader();
+    void fixSizeHeader();
+    MessagePtr finishMessage();
+    void sendQueuedFrames(Subscriber* subscriber);
+    int findBodyIndex(const Body* body);
+    void outputContacts(const CollisionLinkPairList& linkPairs);
+    void endFrameOutput();
+};
+
+}
+
+
+void WorldLogStreamItem::initializeClass(ExtensionManager* ext)
+{
+    ItemManager& im = ext->itemManager();
+    im.registerClass<WorldLogStreamItem>(N_("WorldLogStreamItem"));
+    im.addCreationPanel<WorldLogStreamItem>();
+}
+
+
+WorldLogStreamItem::WorldLogStreamItem()
+{
+    impl = new Impl(this);
+    setName("WorldLogStream");
+}
+
+
+WorldLogStreamItem::Impl::Impl(WorldLogStreamItem* self)
+    : self(self)
+{
+    port = 50500;
+    streamingFrameRate = 30.0;
+    maxNumQueuedFrames = 10;
+    isContactStreamingEnabled = true;
+    initialize();
+}
+
+
+WorldLogStreamItem::WorldLogStreamItem(const WorldLogStreamItem& org)
+    : Item(org)
+{
+    impl = new Impl(this, *org.impl);
+}
+
+
+WorldLogStreamItem::Impl::Impl(WorldLogStreamItem* self, const Impl& org)
+    : self(self)
+{
+    port = org.port;
+    streamingFrameRate = org.streamingFrameRate;
+    maxNumQueuedFrames = org.maxNumQueuedFrames;
+    isContactStreamingEnabled = org.isContactStreamingEnabled;
+    initialize();
+}
+
+
+void WorldLogStreamItem::Impl::initialize()
+{
+    isFrameOutputActive = false;
+    numDroppedFrames = 0;
+
+    QObject::connect(&server, &QTcpServer::newConnection, [this](){ onNewConnection(); });
+}
+
+
+WorldLogStreamItem::~WorldLogStreamItem()
+{
+    delete impl;
+}
+
+
+WorldLogStreamItem::Impl::~Impl()
+{
+    stopStreaming();
+}
+
+
+Item* WorldLogStreamItem::doDuplicate() const
+{
+    return new WorldLogStreamItem(*this);
+}
+
+
+void WorldLogStreamItem::setPort(int port)
+{
+    impl->port = port;
+}
+
+
+int WorldLogStreamItem::port() const
+{
+    return impl->port;
+}
+
+
+void WorldLogStreamItem::setStreamingFrameRate(double rate)
+{
+    impl->streamingFrameRate = rate;
+}
+
+
+double WorldLogStreamItem::streamingFrameRate() const
+{
+    return impl->streamingFrameRate;
+}
+
+
+void WorldLogStreamItem::setMaxNumQueuedFrames(int n)
+{
+    impl->maxNumQueuedFrames = std::max(n, 1);
+}
+
+
+int WorldLogStreamItem::maxNumQueuedFrames() const
+{
+    return impl->maxNumQueuedFrames;
+}
+
+
+void WorldLogStreamItem::setContactStreamingEnabled(bool on)
+{
+    impl->isContactStreamingEnabled = on;
+}
+
+
+bool WorldLogStreamItem::isContactStreamingEnabled() const
+{
+    return impl->isContactStreamingEnabled;
+}
+
+
+bool WorldLogStreamItem::startStreaming()
+{
+    return impl->startStreaming();
+}
+
+
+bool WorldLogStreamItem::Impl::startStreaming()
+{
+    if(server.isListening()){
+        if(server.serverPort() == port){
+            return true;
+        }
+        stopStreaming();
+    }
+    if(!server.listen(QHostAddress::Any, port)){
+        MessageView::instance()->putln(
+            format(_("{0} cannot listen on port {1}: {2}"),
+                   self->displayName(), port, server.errorString().toStdString()),
+            MessageView::Error);
+        return false;
+    }
+    MessageView::instance()->putln(
+        format(_("{0} is streaming the simulation on port {1}."), self->displayName(), port));
+    return true;
+}
+
+
+void WorldLogStreamItem::stopStreaming()
+{
+    impl->stopStreaming();
+}
+
+
+void WorldLogStreamItem::Impl::stopStreaming()
+{
+    server.close();
+    for(auto& subscriber : subscribers){
+        subscriber->socket->disconnect();
+        subscriber->socket->abort();
+        subscriber->socket->deleteLater();
+    }
+    subscribers.clear();
+}
+
+
+void WorldLogStreamItem::onDisconnectedFromRoot()
+{
+    impl->stopStreaming();
+}
+
+
+bool WorldLogStreamItem::isStreaming() const
+{
+    return impl->server.isListening();
+}
+
+
+int WorldLogStreamItem::numSubscribers() const
+{
+    return impl->subscribers.size();
+}
+
+
+void WorldLogStreamItem::Impl::onNewConnection()
+{
+    while(auto socket = server.nextPendingConnection()){
+        auto subscriber = new Subscriber;
+        subscriber->socket = socket;
+        subscribers.emplace_back(subscriber);
+
+        QObject::connect(socket, &QTcpSocket::bytesWritten, socket,
+                         [this, subscriber](qint64){ sendQueuedFrames(subscriber); });
+        QObject::connect(socket, &QTcpSocket::disconnected, socket,
+                         [this, socket](){ removeSubscriber(socket); });
+
+        if(header){
+            socket->write(header->data(), header->size());
+        }
+    }
+}
+
+
+void WorldLogStreamItem::Impl::removeSubscriber(QTcpSocket* socket)
+{
+    auto p = std::find_if(subscribers.begin(), subscribers.end(),
+                          [socket](const unique_ptr<Subscriber>& s){ return s->socket == socket; });
+    if(p != subscribers.end()){
+        subscribers.erase(p);
+    }
+    socket->deleteLater();
+}
+
+
+void WorldLogStreamItem::Impl::reserveSizeHeader()
+{
+    sizeHeaderStack.push(writeBuf.size());
+    writeBuf.writeInt(0);
+}
+
+
+void WorldLogStreamItem::Impl::fixSizeHeader()
+{
+    if(!sizeHeaderStack.empty()){
+        writeBuf.writeInt(sizeHeaderStack.top(), writeBuf.size() - (sizeHeaderStack.top() + sizeof(int)));
+        sizeHeaderStack.pop();
+    }
+}
+
+
+MessagePtr WorldLogStreamItem::Impl::finishMessage()
+{
+    fixSizeHeader();
+    auto message = make_shared<vector<char>>();
+    message->swap(writeBuf.data);
+    return message;
+}
+
+
+void WorldLogStreamItem::beginHeaderOutput()
+{
+    impl->bodyNames.clear();
+    impl->bodyIndexMap.clear();
+    impl->numDroppedFrames = 0;
+    impl->writeBuf.data.clear();
+    impl->reserveSizeHeader();
+    impl->writeBuf.writeOctet(HEADER_MESSAGE);
+    impl->writeBuf.writeString(streamMagic);
+    impl->writeBuf.writeShort(streamVersion);
+}
+
+
+int WorldLogStreamItem::outputBodyHeader(const std::string& name)
+{
+    int index = impl->bodyNames.size();
+    impl->bodyNames.push_back(name);
+    impl->writeBuf.writeString(name);
+    return index;
+}
+
+
+/**
+   The frames of the previous simulation remaining in the queues are discarded, and the new header
+   is sent to the current subscribers.
+*/
+void WorldLogStreamItem::endHeaderOutput()
+{
+    impl->header = impl->finishMessage();
+    for(auto& subscriber : impl->subscribers){
+        subscriber->queue.clear();
+        subscriber->socket->write(impl->header->data(), impl->header->size());
+    }
+}
+
+
+/**
+   The frame is not encoded when there is no subscriber, and the following output functions
+   do nothing until endFrameOutput is called.
+*/
+void WorldLogStreamItem::beginFrameOutput(double time)
+{
+    impl->isFrameOutputActive = !impl->subscribers.empty();
+    if(impl->isFrameOutputActive){
+        impl->writeBuf.data.clear();
+        impl->reserveSizeHeader();
+        impl->writeBuf.writeOctet(FRAME_MESSAGE);
+        impl->writeBuf.writeFloat(time);
+    }
+}
+
+
+void WorldLogStreamItem::beginBodyStateOutput()
+{
+    if(impl->isFrameOutputActive){
+        impl->writeBuf.writeID(BODY_STATE);
+        impl->reserveSizeHeader();
+    }
+}
+
+
+void WorldLogStreamItem::outputLinkPositions(SE3* positions, int size)
+{
+    if(impl->isFrameOutputActive){
+        impl->writeBuf.writeID(LINK_POSITIONS);
+        impl->reserveSizeHeader();
+        impl->writeBuf.writeShort(size);
+        for(int i=0; i < size; ++i){
+            impl->writeBuf.writeSE3(positions[i]);
+        }
+        impl->fixSizeHeader();
+    }
+}
+
+
+void WorldLogStreamItem::outputJointPositions(double* values, int size)
+{
+    if(impl->isFrameOutputActive){
+        impl->writeBuf.writeID(JOINT_POSITIONS);
+        impl->reserveSizeHeader();
+        impl->writeBuf.writeShort(size);
+        for(int i=0; i < size; ++i){
+            impl->writeBuf.writeFloat(values[i]);
+        }
+        impl->fixSizeHeader();
+    }
+}
+
+
+void WorldLogStreamItem::beginDeviceStateOutput()
+{
+    if(impl->isFrameOutputActive){
+        impl->writeBuf.writeID(DEVICE_STATES);
+        impl->reserveSizeHeader();
+    }
+}
+
+
+void WorldLogStreamItem::outputDeviceState(DeviceState* state)
+{
+    if(!impl->isFrameOutputActive){
+        return;
+    }
+    if(!state){
+        impl->writeBuf.writeShort(0);
+    } else {
+        auto& buf = impl->doubleWriteBuf;
+        int size = state->stateSize();
+        impl->writeBuf.writeShort(size);
+        buf.resize(size);
+        state->writeState(buf.data());
+        for(int i=0; i < size; ++i){
+            impl->writeBuf.writeFloat(buf[i]);
+        }
+    }
+}
+
+
+void WorldLogStreamItem::endDeviceStateOutput()
+{
+    if(impl->isFrameOutputActive){
+        impl->fixSizeHeader();
+    }
+}
+
+
+void WorldLogStreamItem::endBodyStateOutput()
+{
+    if(impl->isFrameOutputActive){
+        impl->fixSizeHeader();
+    }
+}
+
+
+//! \return -1 if the body is not a body in the header
+int WorldLogStreamItem::Impl::findBodyIndex(const Body* body)
+{
+    auto p = bodyIndexMap.find(body);
+    if(p != bodyIndexMap.end()){
+        return p->second;
+    }
+    int index = -1;
+    auto q = std::find(bodyNames.begin(), bodyNames.end(), body->name());
+    if(q != bodyNames.end()){
+        index = q - bodyNames.begin();
+    }
+    bodyIndexMap[body] = index;
+    return index;
+}
+
+
+void WorldLogStreamItem::outputContacts(const CollisionLinkPairList& linkPairs)
+{
+    if(impl->isFrameOutputActive && impl->isContactStreamingEnabled){
+        impl->outputContacts(linkPairs);
+    }
+}
+
+
+void WorldLogStreamItem::Impl::outputContacts(const CollisionLinkPairList& linkPairs)
+{
+    writeBuf.writeID(CONTACTS);
+    reserveSizeHeader();
+    writeBuf.writeShort(linkPairs.size());
+    for(auto& linkPair : linkPairs){
+        for(int i=0; i < 2; ++i){
+            writeBuf.writeShort(findBodyIndex(linkPair->body[i]));
+            writeBuf.writeShort(linkPair->link[i]->index());
+        }
+        auto& collisions = linkPair->collisions;
+        writeBuf.writeShort(collisions.size());
+        for(auto& collision : collisions){
+            writeBuf.writeVector3(collision.point);
+            writeBuf.writeVector3(collision.normal);
+            writeBuf.writeFloat(collision.depth);
+        }
+    }
+    fixSizeHeader();
+}
+
+
+void WorldLogStreamItem::endFrameOutput()
+{
+    if(impl->isFrameOutputActive){
+        impl->endFrameOutput();
+        impl->isFrameOutputActive = false;
+    }
+}
+
+
+/**
+   The frame is shared by the queues of all the subscribers. When the queue of a subscriber is
+   full, the oldest frame in it is dropped.
+*/
+void WorldLogStreamItem::Impl::endFrameOutput()
+{
+    auto frame = finishMessage();
+    bool dropped = false;
+    for(auto& subscriber : subscribers){
+        auto& queue = subscriber->queue;
+        if(static_cast<int>(queue.size()) >= maxNumQueuedFrames){
+            queue.pop_front();
+            dropped = true;
+        }
+        queue.push_back(frame);
+        sendQueuedFrames(subscriber.get());
+    }
+    if(dropped && numDroppedFrames++ == 0){
+        MessageView::instance()->putln(
+            format(_("Some subscribers of {0} cannot keep up with the stream. "
+                     "The old frames are dropped for them."), self->displayName()),
+            MessageView::Warning);
+    }
+}
+
+
+void WorldLogStreamItem::Impl::sendQueuedFrames(Subscriber* subscriber)
+{
+    auto socket = subscriber->socket;
+    auto& queue = subscriber->queue;
+    while(!queue.empty() && socket->bytesToWrite() < maxSocketBufferSize){
+        auto& frame = queue.front();
+        socket->write(frame->data(), frame->size());
+        queue.pop_front();
+    }
+}
+
+
+void WorldLogStreamItem::doPutProperties(PutPropertyFunction& putProperty)
+{
+    putProperty.min(1).max(65535)(_("Port"), impl->port, changeProperty(impl->port));
+    putProperty(_("Streaming"), isStreaming());
+    putProperty(_("Subscribers"), numSubscribers());
+    putProperty.min(0.1)(_("Streaming frame rate"), impl->streamingFrameRate,
+                         changeProperty(impl->streamingFrameRate));
+    putProperty.min(1)(_("Max queued frames"), impl->maxNumQueuedFrames,
+                       changeProperty(impl->maxNumQueuedFrames));
+    putProperty(_("Stream contacts"), impl->isContactStreamingEnabled,
+                changeProperty(impl->isContactStreamingEnabled));
+}
+
+
+bool WorldLogStreamItem::store(Archive& archive)
+{
+    archive.write("port", impl->port);
+    archive.write("streamingFrameRate", impl->streamingFrameRate);
+    archive.write("maxNumQueuedFrames", impl->maxNumQueuedFrames);
+    archive.write("streamContacts", impl->isContactStreamingEnabled);
+    return true;
+}
+
+
+bool WorldLogStreamItem::restore(const Archive& archive)
+{
+    archive.read("port", impl->port);
+    archive.read("streamingFrameRate", impl->streamingFrameRate);
+    archive.read("maxNumQueuedFrames", impl->maxNumQueuedFrames);
+    archive.read("streamContacts", impl->isContactStreamingEnabled);
+    return true;
+}
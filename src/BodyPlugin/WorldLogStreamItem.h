@@ -0,0 +1,78 @@
+#ifndef CNOID_BODY_PLUGIN_WORLD_LOG_STREAM_ITEM_H
+#define CNOID_BODY_PLUGIN_WORLD_LOG_STREAM_ITEM_H
+
+#include <cnoid/Item>
+#include <cnoid/CollisionLog>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+class SE3;
+class DeviceState;
+
+/**
+   This item streams the states of a running simulation to the subscribers connected to a TCP port.
+   The frames are encoded in the same way as the frames of WorldLogFileItem except that each frame
+   is self-contained, and the contacts of the bodies are appended to it.
+
+   Each subscriber has a queue of the frames waiting to be sent. When the queue is full, the oldest
+   frame is dropped so that a slow subscriber never blocks the simulation or the other subscribers.
+*/
+class CNOID_EXPORT WorldLogStreamItem : public Item
+{
+public:
+    static void initializeClass(ExtensionManager* ext);
+
+    WorldLogStreamItem();
+    WorldLogStreamItem(const WorldLogStreamItem& org);
+    ~WorldLogStreamItem();
+
+    void setPort(int port);
+    int port() const;
+
+    void setStreamingFrameRate(double rate);
+    double streamingFrameRate() const;
+
+    void setMaxNumQueuedFrames(int n);
+    int maxNumQueuedFrames() const;
+
+    void setContactStreamingEnabled(bool on);
+    bool isContactStreamingEnabled() const;
+
+    //! The server keeps listening on the port until stopStreaming is called or the item is deleted
+    bool startStreaming();
+    void stopStreaming();
+    bool isStreaming() const;
+    int numSubscribers() const;
+
+    void beginHeaderOutput();
+    int outputBodyHeader(const std::string& name);
+    void endHeaderOutput();
+    void beginFrameOutput(double time);
+    void beginBodyStateOutput();
+    void outputLinkPositions(SE3* positions, int size);
+    void outputJointPositions(double* values, int size);
+    void beginDeviceStateOutput();
+    void outputDeviceState(DeviceState* state);
+    void endDeviceStateOutput();
+    void endBodyStateOutput();
+    void outputContacts(const CollisionLinkPairList& linkPairs);
+    void endFrameOutput();
+
+protected:
+    virtual Item* doDuplicate() const override;
+    virtual void onDisconnectedFromRoot() override;
+    virtual void doPutProperties(PutPropertyFunction& putProperty) override;
+    virtual bool store(Archive& archive) override;
+    virtual bool restore(const Archive& archive) override;
+
+private:
+    class Impl;
+    Impl* impl;
+};
+
+typedef ref_ptr<WorldLogStreamItem> WorldLogStreamItemPtr;
+
+}
+
+#endif
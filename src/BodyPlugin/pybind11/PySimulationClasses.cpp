@@ -11,15 +11,41 @@
 #include "../BodyItem.h"
 #include "../SimpleControllerItem.h"
 #include "../ControllerLogItem.h"
+#include <cnoid/JointStateBatch>
+#include <cnoid/ValueTree>
 #include <cnoid/PyBase>
 
 using namespace cnoid;
 namespace py = pybind11;
 
+namespace {
+
+/*
+  The joint states are copied to the batch and the commands are copied from it without the GIL,
+  and the GIL is only acquired once in each step to call the Python function for all the bodies
+  in the batch.
+*/
+std::function<void()> makeBatchedFunction(JointStateBatchPtr batch, std::function<void()> func)
+{
+    return [batch, func](){
+        batch->readState();
+        func();
+        batch->writeCommands();
+    };
+}
+
+}
+
 namespace cnoid {
 
 void exportSimulationClasses(py::module m)
 {
+    py::class_<SimulationBody, SimulationBodyPtr, Referenced>(m, "SimulationBody")
+        .def_property_readonly("bodyItem", &SimulationBody::bodyItem)
+        .def_property_readonly("body", &SimulationBody::body)
+        .def("isActive", &SimulationBody::isActive)
+        ;
+
     py::class_<SimulatorItem, SimulatorItemPtr, Item> simulatorItemClass(m, "SimulatorItem");
 
     simulatorItemClass
@@ -56,6 +82,25 @@ void exportSimulationClasses(py::module m)
         .def("clearExternalForces", &SimulatorItem::clearExternalForces)
         .def("setForcedPosition", &SimulatorItem::setForcedPosition)
         .def("clearForcedPositions", &SimulatorItem::clearForcedPositions)
+        .def_property_readonly("simulationBodies", &SimulatorItem::simulationBodies)
+        .def("findSimulationBody", (SimulationBody*(SimulatorItem::*)(BodyItem*)) &SimulatorItem::findSimulationBody)
+        .def("findSimulationBody",
+             (SimulationBody*(SimulatorItem::*)(const std::string&)) &SimulatorItem::findSimulationBody)
+        .def("addPreDynamicsFunction", &SimulatorItem::addPreDynamicsFunction)
+        .def("addMidDynamicsFunction", &SimulatorItem::addMidDynamicsFunction)
+        .def("addPostDynamicsFunction", &SimulatorItem::addPostDynamicsFunction)
+        .def("addPreDynamicsFunction",
+             [](SimulatorItem& self, JointStateBatch* batch, std::function<void()> func){
+                 return self.addPreDynamicsFunction(makeBatchedFunction(batch, func)); })
+        .def("addMidDynamicsFunction",
+             [](SimulatorItem& self, JointStateBatch* batch, std::function<void()> func){
+                 return self.addMidDynamicsFunction(makeBatchedFunction(batch, func)); })
+        .def("addPostDynamicsFunction",
+             [](SimulatorItem& self, JointStateBatch* batch, std::function<void()> func){
+                 return self.addPostDynamicsFunction(makeBatchedFunction(batch, func)); })
+        .def("removePreDynamicsFunction", &SimulatorItem::removePreDynamicsFunction)
+        .def("removeMidDynamicsFunction", &SimulatorItem::removeMidDynamicsFunction)
+        .def("removePostDynamicsFunction", &SimulatorItem::removePostDynamicsFunction)
 
         // deprecated
         .def("setSpecifiedRecordingTimeLength", &SimulatorItem::setTimeLength)
@@ -144,7 +189,10 @@ void exportSimulationClasses(py::module m)
 
     PyItemList<SubSimulatorItem>(m, "SubSimulatorItemList");
 
-    py::class_<GLVisionSimulatorItem, GLVisionSimulatorItemPtr, SubSimulatorItem>(m, "GLVisionSimulatorItem")
+    py::class_<GLVisionSimulatorItem, GLVisionSimulatorItemPtr, SubSimulatorItem>
+        glVisionSimulatorItemClass(m, "GLVisionSimulatorItem");
+
+    glVisionSimulatorItemClass
         .def(py::init<>())
         .def("setTargetBodies", &GLVisionSimulatorItem::setTargetBodies)
         .def("setTargetSensors", &GLVisionSimulatorItem::setTargetSensors)
@@ -157,8 +205,23 @@ void exportSimulationClasses(py::module m)
         .def("setAllSceneObjectsEnabled", &GLVisionSimulatorItem::setAllSceneObjectsEnabled)
         .def("setHeadLightEnabled", &GLVisionSimulatorItem::setHeadLightEnabled)
         .def("setAdditionalLightsEnabled", &GLVisionSimulatorItem::setAdditionalLightsEnabled)
+        .def("setPipelinedReadbackEnabled", &GLVisionSimulatorItem::setPipelinedReadbackEnabled)
+        .def("setGLResourceSharingEnabled", &GLVisionSimulatorItem::setGLResourceSharingEnabled)
+        .def("setFrustumCullingEnabled", &GLVisionSimulatorItem::setFrustumCullingEnabled)
+        .def("setSharedMemoryExportEnabled", &GLVisionSimulatorItem::setSharedMemoryExportEnabled)
+        .def("setGLBackend", &GLVisionSimulatorItem::setGLBackend)
+        .def("setGLDevices", &GLVisionSimulatorItem::setGLDevices)
+        .def("setThreadMode", &GLVisionSimulatorItem::setThreadMode)
+        .def("throughputReport", &GLVisionSimulatorItem::throughputReport)
         ;
 
+    py::enum_<GLVisionSimulatorItem::ThreadMode>(glVisionSimulatorItemClass, "ThreadMode")
+        .value("SINGLE_THREAD_MODE", GLVisionSimulatorItem::SINGLE_THREAD_MODE)
+        .value("SENSOR_THREAD_MODE", GLVisionSimulatorItem::SENSOR_THREAD_MODE)
+        .value("SCREEN_THREAD_MODE", GLVisionSimulatorItem::SCREEN_THREAD_MODE)
+        .value("N_THREAD_MODES", GLVisionSimulatorItem::N_THREAD_MODES)
+        .export_values();
+
     PyItemList<GLVisionSimulatorItem>(m, "GLVisionSimulatorItemList");
 
     py::class_<SimulationScriptItem, SimulationScriptItemPtr, ScriptItem> simulationScriptItemClass(m,"SimulationScriptItem");
@@ -208,6 +271,10 @@ void exportSimulationClasses(py::module m)
         .def(py::init<>())
         .def_property_readonly("log", &ControllerLogItem::log)
         .def("resetLog", &ControllerLogItem::resetLog)
+        .def_property("memoryTimeLength",
+                      &ControllerLogItem::memoryTimeLength, &ControllerLogItem::setMemoryTimeLength)
+        .def("setMemoryTimeLength", &ControllerLogItem::setMemoryTimeLength)
+        .def("logData", &ControllerLogItem::logData)
         ;
 
     PyItemList<ControllerLogItem>(m, "ControllerLogItemList");
@@ -11,8 +11,12 @@
 #include <cnoid/stdx/optional>
 #include <btBulletDynamicsCommon.h>
 #include <HACD/hacdHACD.h>
+#include <BulletCollision/CollisionShapes/btHeightfieldTerrainShape.h>
 #include <BulletCollision/Gimpact/btGImpactShape.h>
 #include <BulletCollision/Gimpact/btGImpactCollisionAlgorithm.h>
+#include <unordered_set>
+#include <unordered_map>
+#include <algorithm>
 
 using namespace std;
 using namespace cnoid;
@@ -44,6 +48,7 @@ public :
     btCollisionShape* collisionShape;
     vector<btScalar> vertices;
     vector<int> triangles;
+    vector<shared_ptr<const SgMesh::HeightField>> heightFields;
     btTriangleIndexVertexArray* meshData;
     btTriangleMesh* trimesh;
     bool isStatic;
@@ -97,19 +102,36 @@ public:
     btCollisionWorld* collisionWorld;
 
     MeshExtractor meshExtractor;
-    typedef set<IdPair<GeometryHandle>> GeometryHandlePairSet;
-    GeometryHandlePairSet ignoredPairs;
-    GeometryHandlePairSet interfarencePairs;
+    unordered_set<IdPair<GeometryHandle>> ignoredPairs;
     std::function<void(const CollisionPair&)> callbackOnCollisionDetected;
 
+    /*
+      The broadphase calls this to check if the overlapping pair is added to the pair cache,
+      so the ignored pairs are excluded before the narrowphase.
+    */
+    class OverlapFilter : public btOverlapFilterCallback
+    {
+    public:
+        BulletCollisionDetectorImpl* impl;
+        virtual bool needBroadphaseCollision(btBroadphaseProxy* proxy0, btBroadphaseProxy* proxy1) const override;
+    };
+    OverlapFilter overlapFilter;
+
+    // The contacts of the compound shapes are divided into multiple manifolds for a pair
+    unordered_map<IdPair<GeometryHandle>, int> pairToCollisionPairIndexMap;
+    vector<CollisionPair> collisionPairs;
+
     BulletCollisionDetectorImpl();
     ~BulletCollisionDetectorImpl();
+    void removeCollisionObjects();
     stdx::optional<GeometryHandle> addGeometry(SgNode* geometry);
     void addMesh(GeometryInfo* model);
+    void addHeightField(GeometryInfo* ginfo);
+    void addChildShape(GeometryInfo* ginfo, btCollisionShape* shape, const Isometry3& T);
+    void ignoreGeometryPair(GeometryHandle geometry1, GeometryHandle geometry2, bool ignore);
     bool makeReady();
     void setGeometryPosition(GeometryInfo* ginfo, const Isometry3& position);
     void detectCollisions();
-    void detectObjectCollisions(btCollisionObject* object1, btCollisionObject* object2, CollisionPair& collisionPair);
 };
 }
 
@@ -145,11 +167,17 @@ BulletCollisionDetectorImpl::BulletCollisionDetectorImpl()
     broadphase = new btDbvtBroadphase();
     collisionWorld = new btCollisionWorld(dispatcher,broadphase,collisionConfiguration);
     btGImpactCollisionAlgorithm::registerAlgorithm(dispatcher);
+
+    // Only the bounding boxes of the active (non-static) objects are updated in every detection
+    collisionWorld->setForceUpdateAllAabbs(false);
+    overlapFilter.impl = this;
+    collisionWorld->getPairCache()->setOverlapFilterCallback(&overlapFilter);
 }
 
 
 BulletCollisionDetectorImpl::~BulletCollisionDetectorImpl()
 {
+    removeCollisionObjects();
     if(collisionWorld)
         delete collisionWorld;
     if(dispatcher)
@@ -161,11 +189,21 @@ BulletCollisionDetectorImpl::~BulletCollisionDetectorImpl()
 }
 
 
+void BulletCollisionDetectorImpl::removeCollisionObjects()
+{
+    for(auto& ginfo : geometryInfos){
+        if(ginfo && ginfo->collisionObject && ginfo->collisionObject->getBroadphaseHandle()){
+            collisionWorld->removeCollisionObject(ginfo->collisionObject);
+        }
+    }
+}
+
+
 void BulletCollisionDetector::clearGeometries()
 {
+    impl->removeCollisionObjects();
     impl->geometryInfos.clear();
     impl->ignoredPairs.clear();
-    impl->interfarencePairs.clear();
 }
 
 
@@ -230,6 +268,7 @@ stdx::optional<GeometryHandle> BulletCollisionDetectorImpl::addGeometry(SgNode*
             }
             ginfo->collisionObject = new btCollisionObject();
             ginfo->collisionObject->setCollisionShape(ginfo->collisionShape);
+            ginfo->collisionObject->setUserPointer(ginfo.get());
             geometryInfos.push_back(ginfo);
             return handle;
         }
@@ -239,14 +278,59 @@ stdx::optional<GeometryHandle> BulletCollisionDetectorImpl::addGeometry(SgNode*
 }
 
 
+/**
+   The heightfield shape of Bullet is centered at the center of the grid and the middle of the
+   height range. The quad edges are flipped so that the cells are divided in the same way as
+   the mesh triangles.
+*/
+void BulletCollisionDetectorImpl::addHeightField(GeometryInfo* ginfo)
+{
+    auto heightField = meshExtractor.currentMesh()->sharedHeightField();
+    auto range = std::minmax_element(heightField->heights.begin(), heightField->heights.end());
+    const double minHeight = *range.first;
+    const double maxHeight = *range.second;
+    auto shape = new btHeightfieldTerrainShape(
+        heightField->xDimension, heightField->zDimension, &heightField->heights[0],
+        1.0, minHeight, maxHeight, 1, PHY_FLOAT, true);
+    shape->setLocalScaling(btVector3(heightField->xSpacing, 1.0, heightField->zSpacing));
+    shape->setMargin(DEFAULT_COLLISION_MARGIN);
+    ginfo->heightFields.push_back(heightField);
+
+    Isometry3 T = meshExtractor.currentTransformWithoutScaling();
+    T *= Translation3(heightField->xSize() / 2.0, (minHeight + maxHeight) / 2.0, heightField->zSize() / 2.0);
+    addChildShape(ginfo, shape, T);
+}
+
+
+void BulletCollisionDetectorImpl::addChildShape(GeometryInfo* ginfo, btCollisionShape* shape, const Isometry3& T)
+{
+    btCompoundShape* compoundShape = dynamic_cast<btCompoundShape*>(ginfo->collisionShape);
+    if(!compoundShape){
+        ginfo->collisionShape = new btCompoundShape();
+        ginfo->collisionShape->setLocalScaling(btVector3(1.f,1.f,1.f));
+        compoundShape = dynamic_cast<btCompoundShape*>(ginfo->collisionShape);
+    }
+    btVector3 p(T(0,3), T(1,3), T(2,3));
+    btMatrix3x3 R(T(0,0), T(0,1), T(0,2),
+                  T(1,0), T(1,1), T(1,2),
+                  T(2,0), T(2,1), T(2,2));
+    compoundShape->addChildShape(btTransform(R, p), shape);
+}
+
+
 void BulletCollisionDetectorImpl::addMesh(GeometryInfo* ginfo)
 {
     SgMesh* mesh = meshExtractor.currentMesh();
     const Affine3& T = meshExtractor.currentTransform();
 
     bool meshAdded = false;
+
+    if(mesh->heightField() && !meshExtractor.isCurrentScaled()){
+        addHeightField(ginfo);
+        meshAdded = true;
+    }
     
-    if(mesh->primitiveType() != SgMesh::MESH){
+    if(!meshAdded && mesh->primitiveType() != SgMesh::MESH){
         bool doAddPrimitive = false;
         Vector3 scale;
         stdx::optional<Vector3> translation;
@@ -317,22 +401,11 @@ void BulletCollisionDetectorImpl::addMesh(GeometryInfo* ginfo)
             }
             if(created){
                 primitiveShape->setMargin(DEFAULT_COLLISION_MARGIN);
-                btCompoundShape* compoundShape = dynamic_cast<btCompoundShape*>(ginfo->collisionShape);
-                if(!compoundShape){
-                    ginfo->collisionShape = new btCompoundShape();
-                    ginfo->collisionShape->setLocalScaling(btVector3(1.f,1.f,1.f));
-                    compoundShape = dynamic_cast<btCompoundShape*>(ginfo->collisionShape);
-                }
-                Affine3 T_ = meshExtractor.currentTransformWithoutScaling();
+                Isometry3 T_ = meshExtractor.currentTransformWithoutScaling();
                 if(translation){
                     T_ *= Translation3(*translation);
                 }
-                btVector3 p(T_(0,3), T_(1,3), T_(2,3));
-                btMatrix3x3 R(T_(0,0), T_(0,1), T_(0,2),
-                              T_(1,0), T_(1,1), T_(1,2),
-                              T_(2,0), T_(2,1), T_(2,2));
-                btTransform btT(R, p);
-                compoundShape->addChildShape(btT, primitiveShape);
+                addChildShape(ginfo, primitiveShape, T_);
                 meshAdded = true;
             }
         }
@@ -493,38 +566,95 @@ void BulletCollisionDetector::setGeometryStatic(GeometryHandle geometry, bool is
 
 
 void BulletCollisionDetector::ignoreGeometryPair(GeometryHandle geometry1, GeometryHandle geometry2, bool ignore)
+{
+    impl->ignoreGeometryPair(geometry1, geometry2, ignore);
+}
+
+
+/**
+   The broadphase only adds a pair to the pair cache when the bounding boxes begin to overlap,
+   so the pair cache is updated here for the pair whose bounding boxes currently overlap.
+*/
+void BulletCollisionDetectorImpl::ignoreGeometryPair(GeometryHandle geometry1, GeometryHandle geometry2, bool ignore)
 {
     IdPair<GeometryHandle> idPair(geometry1, geometry2);
     if(ignore){
-        impl->ignoredPairs.insert(idPair);
+        ignoredPairs.insert(idPair);
     } else {
-        impl->ignoredPairs.erase(idPair);
+        ignoredPairs.erase(idPair);
+    }
+
+    GeometryInfo* ginfo1 = geometryInfos[geometry1];
+    GeometryInfo* ginfo2 = geometryInfos[geometry2];
+    if(ginfo1 && ginfo2 && ginfo1->collisionObject && ginfo2->collisionObject){
+        auto proxy1 = ginfo1->collisionObject->getBroadphaseHandle();
+        auto proxy2 = ginfo2->collisionObject->getBroadphaseHandle();
+        if(proxy1 && proxy2){
+            auto pairCache = collisionWorld->getPairCache();
+            if(ignore){
+                // Remove the pair which has already been cached by the broadphase
+                pairCache->removeOverlappingPair(proxy1, proxy2, dispatcher);
+            } else if(TestAabbAgainstAabb2(proxy1->m_aabbMin, proxy1->m_aabbMax,
+                                           proxy2->m_aabbMin, proxy2->m_aabbMax)){
+                // The pair is not added if it is rejected by the overlap filter or is already cached
+                pairCache->addOverlappingPair(proxy1, proxy2);
+            }
+        }
     }
 }
 
 
+bool BulletCollisionDetectorImpl::OverlapFilter::needBroadphaseCollision
+(btBroadphaseProxy* proxy0, btBroadphaseProxy* proxy1) const
+{
+    if(!(proxy0->m_collisionFilterGroup & proxy1->m_collisionFilterMask) ||
+       !(proxy1->m_collisionFilterGroup & proxy0->m_collisionFilterMask)){
+        return false;
+    }
+    if(!impl->ignoredPairs.empty()){
+        auto ginfo0 = static_cast<GeometryInfo*>(static_cast<btCollisionObject*>(proxy0->m_clientObject)->getUserPointer());
+        auto ginfo1 = static_cast<GeometryInfo*>(static_cast<btCollisionObject*>(proxy1->m_clientObject)->getUserPointer());
+        if(impl->ignoredPairs.find(IdPair<GeometryHandle>(ginfo0->geometryHandle, ginfo1->geometryHandle))
+           != impl->ignoredPairs.end()){
+            return false;
+        }
+    }
+    return true;
+}
+
+
 bool BulletCollisionDetector::makeReady()
 {
     return impl->makeReady();
 }
 
 
+/**
+   The collision objects are added to the collision world so that the candidate pairs are
+   given by the dynamic AABB tree broadphase and the contacts are kept in the persistent
+   manifolds of the dispatcher over the detections. The static objects are put in the static
+   filter group, whose pairs are not produced by the broadphase, and their bounding boxes are
+   not updated unless their positions are changed.
+*/
 bool BulletCollisionDetectorImpl::makeReady()
 {
-    interfarencePairs.clear();
-
-    const int n = geometryInfos.size();
-    for(int i=0; i < n; ++i){
-        if(auto& info1 = geometryInfos[i]){
-            for(int j = i+1; j < n; ++j){
-                if(auto& info2 = geometryInfos[j]){
-                    if(!info1->isStatic || !info2->isStatic){
-                        IdPair<GeometryHandle> geometryPair(i, j);
-                        if(ignoredPairs.find(geometryPair) == ignoredPairs.end()){
-                            interfarencePairs.insert(geometryPair);
-                        }
-                    }
-                }
+    removeCollisionObjects();
+
+    for(auto& ginfo : geometryInfos){
+        // The world computes the bounding box of an object when it is added, which requires the shape
+        if(ginfo && ginfo->collisionObject && ginfo->collisionShape){
+            auto object = ginfo->collisionObject;
+            if(ginfo->isStatic){
+                object->setCollisionFlags(object->getCollisionFlags() | btCollisionObject::CF_STATIC_OBJECT);
+                object->setActivationState(ISLAND_SLEEPING);
+                collisionWorld->addCollisionObject(
+                    object, btBroadphaseProxy::StaticFilter,
+                    btBroadphaseProxy::AllFilter ^ btBroadphaseProxy::StaticFilter);
+            } else {
+                object->setCollisionFlags(object->getCollisionFlags() & ~btCollisionObject::CF_STATIC_OBJECT);
+                object->forceActivationState(DISABLE_DEACTIVATION);
+                collisionWorld->addCollisionObject(
+                    object, btBroadphaseProxy::DefaultFilter, btBroadphaseProxy::AllFilter);
             }
         }
     }
@@ -564,8 +694,12 @@ void BulletCollisionDetectorImpl::setGeometryPosition(GeometryInfo* ginfo, const
         btTransform transform;
         transform.setBasis(R);
         transform.setOrigin(p);
-        if(ginfo->collisionObject)
-            ginfo->collisionObject->setWorldTransform(transform);
+        if(auto object = ginfo->collisionObject){
+            object->setWorldTransform(transform);
+            if(ginfo->isStatic && object->getBroadphaseHandle()){
+                collisionWorld->updateSingleAabb(object);
+            }
+        }
     }
 }
 
@@ -579,66 +713,50 @@ void BulletCollisionDetector::detectCollisions(std::function<void(const Collisio
 
 void BulletCollisionDetectorImpl::detectCollisions()
 {
-    for(auto& interfarencePair : interfarencePairs){
-        GeometryInfo* ginfo1 = geometryInfos[interfarencePair[0]];
-        GeometryInfo* ginfo2 = geometryInfos[interfarencePair[1]];
+    collisionWorld->performDiscreteCollisionDetection();
 
-        if(ginfo1->collisionObject && ginfo2->collisionObject){
-            CollisionPair collisionPair(
-                    ginfo1->geometryHandle, ginfo1->object, ginfo2->geometryHandle, ginfo2->object);
-            detectObjectCollisions(ginfo1->collisionObject, ginfo2->collisionObject, collisionPair);
+    pairToCollisionPairIndexMap.clear();
+    collisionPairs.clear();
 
-            if(!collisionPair.collisions().empty()){
-                callbackOnCollisionDetected(collisionPair);
+    const int numManifolds = dispatcher->getNumManifolds();
+    for(int i=0; i < numManifolds; ++i){
+        btPersistentManifold* manifold = dispatcher->getManifoldByIndexInternal(i);
+        const int numContacts = manifold->getNumContacts();
+        if(numContacts == 0){
+            continue;
+        }
+        auto ginfo0 = static_cast<GeometryInfo*>(manifold->getBody0()->getUserPointer());
+        auto ginfo1 = static_cast<GeometryInfo*>(manifold->getBody1()->getUserPointer());
+
+        CollisionPair* collisionPair = nullptr;
+        for(int j=0; j < numContacts; ++j){
+            const btManifoldPoint& point = manifold->getContactPoint(j);
+            // The points kept in the manifold may be separated within the breaking threshold
+            if(point.getDistance() > 0.0){
+                continue;
             }
+            if(!collisionPair){
+                IdPair<GeometryHandle> idPair(ginfo0->geometryHandle, ginfo1->geometryHandle);
+                auto inserted = pairToCollisionPairIndexMap.emplace(idPair, collisionPairs.size());
+                if(inserted.second){
+                    collisionPairs.emplace_back(
+                        ginfo0->geometryHandle, ginfo0->object, ginfo1->geometryHandle, ginfo1->object);
+                }
+                collisionPair = &collisionPairs[inserted.first->second];
+            }
+            bool isSwapped = (collisionPair->geometry(0) != ginfo0->geometryHandle);
+            const btVector3& p = isSwapped ? point.getPositionWorldOnA() : point.getPositionWorldOnB();
+            const btVector3 normal = isSwapped ? point.m_normalWorldOnB : -point.m_normalWorldOnB;
+            Collision& collision = collisionPair->newCollision();
+            collision.point = Vector3(p.x(), p.y(), p.z());
+            collision.normal = Vector3(normal.x(), normal.y(), normal.z());
+            collision.depth = -point.getDistance();
+            collision.id1 = std::max(isSwapped ? point.m_index1 : point.m_index0, 0);
+            collision.id2 = std::max(isSwapped ? point.m_index0 : point.m_index1, 0);
         }
     }
-}
-
 
-void BulletCollisionDetectorImpl::detectObjectCollisions(btCollisionObject* object1, btCollisionObject* object2, CollisionPair& collisionPair)
-{
-    CollisionArray& collisions = collisionPair.collisions();
-    #ifdef BT_VER_GT_281
-    btCollisionObjectWrapper objectWrapper1(0, object1->getCollisionShape(), object1, object1->getWorldTransform(), -1, -1);
-    btCollisionObjectWrapper objectWrapper2(0, object2->getCollisionShape(), object2, object2->getWorldTransform(), -1, -1);
-    #else
-    btCollisionObjectWrapper objectWrapper1(0, object1->getCollisionShape(), object1, object1->getWorldTransform());
-    btCollisionObjectWrapper objectWrapper2(0, object2->getCollisionShape(), object2, object2->getWorldTransform());
-    #endif
-
-#ifdef BT_VER_GT_286
-    btCollisionAlgorithm* algo = collisionWorld->getDispatcher()->findAlgorithm(&objectWrapper1, &objectWrapper2, 0, BT_CONTACT_POINT_ALGORITHMS);
-#else
-    btCollisionAlgorithm* algo = collisionWorld->getDispatcher()->findAlgorithm(&objectWrapper1, &objectWrapper2);
-#endif
-
-    if (algo){
-        btManifoldResult contactPointResult(&objectWrapper1, &objectWrapper2);
-        algo->processCollision(&objectWrapper1, &objectWrapper2, collisionWorld->getDispatchInfo(), &contactPointResult);
-
-        btManifoldArray manifoldArray;
-        algo->getAllContactManifolds(manifoldArray);
-        int numManifolds = manifoldArray.size();
-        for (int i=0;i<numManifolds;i++)
-            {
-                btPersistentManifold* contactManifold = manifoldArray[i];
-                const btCollisionObject* obA = contactManifold->getBody0();
-                int numContacts = contactManifold->getNumContacts();
-                bool swap = obA == object1;
-
-                for (int j=0;j<numContacts;j++)
-                    {
-                        btManifoldPoint& pt = contactManifold->getContactPoint(j);
-                        btVector3 ptA = swap? pt.getPositionWorldOnB() : pt.getPositionWorldOnA();
-                        btVector3 normal = swap? -pt.m_normalWorldOnB : pt.m_normalWorldOnB;
-
-                        collisions.push_back(Collision());
-                        Collision& collision = collisions.back();
-                        collision.point = Vector3(ptA.x(), ptA.y(), ptA.z());
-                        collision.normal = Vector3(normal.x(), normal.y(), normal.z());
-                        collision.depth =  -pt.getDistance();
-                    }
-            }
+    for(auto& collisionPair : collisionPairs){
+        callbackOnCollisionDetected(collisionPair);
     }
 }
@@ -18,6 +18,7 @@
 #include <cnoid/SceneDrawables>
 #include <btBulletDynamicsCommon.h>
 #include <HACD/hacdHACD.h>
+#include <BulletCollision/CollisionShapes/btHeightfieldTerrainShape.h>
 #include <BulletCollision/Gimpact/btGImpactShape.h>
 #include <BulletCollision/Gimpact/btGImpactCollisionAlgorithm.h>
 #include <BulletDynamics/Featherstone/btMultiBody.h>
@@ -29,6 +30,15 @@
 #include <BulletDynamics/Featherstone/btMultiBodyJointMotor.h>
 #include <BulletDynamics/Featherstone/btMultiBodyPoint2Point.h>
 #include <BulletDynamics/Featherstone/btMultiBodyJointFeedback.h>
+#ifdef BT_VER_GT_287
+#include <BulletDynamics/Dynamics/btDiscreteDynamicsWorldMt.h>
+#include <BulletDynamics/ConstraintSolver/btSequentialImpulseConstraintSolverMt.h>
+#include <BulletCollision/CollisionDispatch/btCollisionDispatcherMt.h>
+#include <LinearMath/btThreads.h>
+#endif
+#include <cnoid/MessageView>
+#include <fmt/format.h>
+#include <algorithm>
 #include "gettext.h"
 
 using namespace std;
@@ -49,6 +59,18 @@ const btScalar DEFAULT_COLLISION_MARGIN = 0.0001;
 const bool meshOnly = false;             // not use primitive Shape
 const bool mixedPrimitiveMesh = true;   // mixed of Primitive and Mesh on one link
 
+#ifdef BT_VER_GT_287
+/**
+   The task scheduler is shared by all the simulator items because Bullet only has one global
+   task scheduler. Null is returned if the Bullet library is not built with BT_THREADSAFE.
+*/
+btITaskScheduler* getTaskScheduler()
+{
+    static btITaskScheduler* scheduler = btCreateDefaultTaskScheduler();
+    return scheduler;
+}
+#endif
+
 void diagonalizeInertia(const Vector3& c, const Matrix3& I, btVector3& localInertia, btTransform& shift)
 {
     shift.setIdentity();
@@ -77,6 +99,7 @@ public:
     btTransform invShift;
     vector<btScalar> vertices;
     vector<int> triangles;
+    vector<shared_ptr<const SgMesh::HeightField>> heightFields;
 
     btTriangleIndexVertexArray* pMeshData;
     btTriangleMesh* trimesh;
@@ -98,6 +121,8 @@ public:
     void createLinkBody(BulletSimulatorItemImpl* simImpl, BulletLink* parent, const Vector3& origin,
                         short group, bool isSelfCollisionDetectionEnabled);
     void addMesh(MeshExtractor* extractor, bool meshOnly);
+    void addHeightField(MeshExtractor* extractor);
+    void addChildShape(btCollisionShape* shape, const Isometry3& T);
     void createGeometry();
     void getKinematicStateFromBullet();
     void setKinematicStateToBullet();
@@ -147,6 +172,7 @@ public:
     btCollisionDispatcher* dispatcher;
     btBroadphaseInterface* broadphase;
     btConstraintSolver* solver;
+    btConstraintSolver* largeIslandSolver;
     btDynamicsWorld* dynamicsWorld;
 
     Vector3 gravity;
@@ -160,6 +186,7 @@ public:
     bool useHACD;                           // Hierarchical Approximate Convex Decomposition
     double collisionMargin;
     bool usefeatherstoneAlgorithm;
+    int numThreads;
 
     BulletSimulatorItemImpl(BulletSimulatorItem* self);
     BulletSimulatorItemImpl(BulletSimulatorItem* self, const BulletSimulatorItemImpl& org);
@@ -171,6 +198,7 @@ public:
     void restore(const Archive& archive);
     void initialize();
     void clear();
+    bool createMultiThreadedWorld();
     void addBody(BulletBody* bulletBody, short group);
     void setSolverParameter();
 };
@@ -338,6 +366,47 @@ void BulletLink::createGeometry()
 }
 
 
+/**
+   The heightfield shape of Bullet is centered at the center of the grid and the middle of the
+   height range, so the shape is placed at the point in the coordinate of the mesh.
+   The quad edges are flipped so that the cells are divided in the same way as the mesh triangles.
+*/
+void BulletLink::addHeightField(MeshExtractor* extractor)
+{
+    auto heightField = extractor->currentMesh()->sharedHeightField();
+    auto range = std::minmax_element(heightField->heights.begin(), heightField->heights.end());
+    const double minHeight = *range.first;
+    const double maxHeight = *range.second;
+    auto shape = new btHeightfieldTerrainShape(
+        heightField->xDimension, heightField->zDimension, &heightField->heights[0],
+        1.0, minHeight, maxHeight, 1, PHY_FLOAT, true);
+    shape->setLocalScaling(btVector3(heightField->xSpacing, 1.0, heightField->zSpacing));
+    shape->setMargin(simImpl->collisionMargin);
+    heightFields.push_back(heightField);
+
+    Isometry3 T_ = extractor->currentTransformWithoutScaling();
+    T_ *= Translation3(heightField->xSize() / 2.0, (minHeight + maxHeight) / 2.0, heightField->zSize() / 2.0);
+    addChildShape(shape, T_);
+}
+
+
+void BulletLink::addChildShape(btCollisionShape* shape, const Isometry3& T)
+{
+    btCompoundShape* compoundShape = dynamic_cast<btCompoundShape*>(collisionShape);
+    if(!compoundShape){
+        collisionShape = new btCompoundShape();
+        collisionShape->setLocalScaling(btVector3(1.f,1.f,1.f));
+        compoundShape = dynamic_cast<btCompoundShape*>(collisionShape);
+    }
+    btVector3 p(T(0,3), T(1,3), T(2,3));
+    btMatrix3x3 R(T(0,0), T(0,1), T(0,2),
+                  T(1,0), T(1,1), T(1,2),
+                  T(2,0), T(2,1), T(2,2));
+    btTransform btT(R, p);
+    compoundShape->addChildShape(invShift * btT, shape);
+}
+
+
 void BulletLink::addMesh(MeshExtractor* extractor, bool meshOnly)
 {
     SgMesh* mesh = extractor->currentMesh();
@@ -346,7 +415,12 @@ void BulletLink::addMesh(MeshExtractor* extractor, bool meshOnly)
     bool meshAdded = false;
     
     if(!meshOnly){
-        if(mesh->primitiveType() != SgMesh::MESH){
+        // The heightfield shape is a concave shape which is only available for a static link
+        if(isStatic && mesh->heightField() && !extractor->isCurrentScaled()){
+            addHeightField(extractor);
+            meshAdded = true;
+        }
+        if(!meshAdded && mesh->primitiveType() != SgMesh::MESH){
             bool doAddPrimitive = false;
             Vector3 scale;
             stdx::optional<Vector3> translation;
@@ -417,22 +491,11 @@ void BulletLink::addMesh(MeshExtractor* extractor, bool meshOnly)
                 }
                 if(created){
                     primitiveShape->setMargin(simImpl->collisionMargin);
-                    btCompoundShape* compoundShape = dynamic_cast<btCompoundShape*>(collisionShape);
-                    if(!compoundShape){
-                        collisionShape = new btCompoundShape();
-                        collisionShape->setLocalScaling(btVector3(1.f,1.f,1.f));
-                        compoundShape = dynamic_cast<btCompoundShape*>(collisionShape);
-                    }
-                    Affine3 T_ = extractor->currentTransformWithoutScaling();
+                    Isometry3 T_ = extractor->currentTransformWithoutScaling();
                     if(translation){
                         T_ *= Translation3(*translation);
                     }
-                    btVector3 p(T_(0,3), T_(1,3), T_(2,3));
-                    btMatrix3x3 R(T_(0,0), T_(0,1), T_(0,2),
-                                  T_(1,0), T_(1,1), T_(1,2),
-                                  T_(2,0), T_(2,1), T_(2,2));
-                    btTransform btT(R, p);
-                    compoundShape->addChildShape(invShift * btT, primitiveShape);
+                    addChildShape(primitiveShape, T_);
                     meshAdded = true;
                 }
             }
@@ -1314,7 +1377,7 @@ BulletSimulatorItemImpl::BulletSimulatorItemImpl(BulletSimulatorItem* self)
     useHACD = false;
     collisionMargin = DEFAULT_COLLISION_MARGIN;
     usefeatherstoneAlgorithm = true;
-
+    numThreads = 1;
 }
 
 
@@ -1339,7 +1402,7 @@ BulletSimulatorItemImpl::BulletSimulatorItemImpl(BulletSimulatorItem* self, cons
     useHACD = org.useHACD;
     collisionMargin = org.collisionMargin;
     usefeatherstoneAlgorithm = org.usefeatherstoneAlgorithm;
-
+    numThreads = org.numThreads;
 }
 
 void BulletSimulatorItemImpl::initialize()
@@ -1348,6 +1411,7 @@ void BulletSimulatorItemImpl::initialize()
     dispatcher = 0;
     broadphase = 0;
     solver =0;
+    largeIslandSolver = 0;
     dynamicsWorld = 0;
 
     gContactAddedCallback = 0;
@@ -1402,14 +1466,24 @@ bool BulletSimulatorItemImpl::initializeSimulation(const std::vector<SimulationB
     clear();
 
     collisionConfiguration = new btDefaultCollisionConfiguration();
-    dispatcher = new btCollisionDispatcher(collisionConfiguration);
     broadphase = new btDbvtBroadphase();
 
     if(usefeatherstoneAlgorithm){
+        if(numThreads > 1){
+            MessageView::instance()->putln(
+                fmt::format(_("{0}: The multi-threaded dynamics world is not available with "
+                              "the Featherstone algorithm. The simulation is done in a single thread."),
+                            self->displayName()),
+                MessageView::Warning);
+        }
+        dispatcher = new btCollisionDispatcher(collisionConfiguration);
         btMultiBodyConstraintSolver* solver_ = new btMultiBodyConstraintSolver;
         solver = solver_;
         dynamicsWorld = new btMultiBodyDynamicsWorld(dispatcher,broadphase,solver_,collisionConfiguration);
+    }else if(numThreads > 1 && createMultiThreadedWorld()){
+        self->setAllLinkPositionOutputMode(true);
     }else{
+        dispatcher = new btCollisionDispatcher(collisionConfiguration);
         solver = new btSequentialImpulseConstraintSolver();
         dynamicsWorld = new btDiscreteDynamicsWorld(dispatcher,broadphase,solver,collisionConfiguration);
         self->setAllLinkPositionOutputMode(true);
@@ -1436,18 +1510,61 @@ bool BulletSimulatorItemImpl::initializeSimulation(const std::vector<SimulationB
     return true;
 }
 
+/**
+   The collision pairs are processed and the islands are solved in parallel by the threads of
+   the task scheduler. The constraint solver pool has a solver for each thread, and the large
+   islands are solved by the multi-threaded solver.
+*/
+bool BulletSimulatorItemImpl::createMultiThreadedWorld()
+{
+#ifdef BT_VER_GT_287
+    btITaskScheduler* scheduler = getTaskScheduler();
+    if(scheduler){
+        scheduler->setNumThreads(std::min(numThreads, scheduler->getMaxNumThreads()));
+        btSetTaskScheduler(scheduler);
+        dispatcher = new btCollisionDispatcherMt(collisionConfiguration);
+        auto solverPool = new btConstraintSolverPoolMt(scheduler->getNumThreads());
+        solver = solverPool;
+        largeIslandSolver = new btSequentialImpulseConstraintSolverMt;
+        dynamicsWorld = new btDiscreteDynamicsWorldMt(
+            dispatcher, broadphase, solverPool, largeIslandSolver, collisionConfiguration);
+        return true;
+    }
+#endif
+    MessageView::instance()->putln(
+        fmt::format(_("{0}: The Bullet library does not support the multi-threaded dynamics world. "
+                      "The simulation is done in a single thread."), self->displayName()),
+        MessageView::Warning);
+    return false;
+}
+
+
 void BulletSimulatorItemImpl::clear()
 {
-    if(dynamicsWorld)
+    if(dynamicsWorld){
         delete dynamicsWorld;
-    if(solver)
+        dynamicsWorld = 0;
+    }
+    if(solver){
         delete solver;
-    if(dispatcher)
+        solver = 0;
+    }
+    if(largeIslandSolver){
+        delete largeIslandSolver;
+        largeIslandSolver = 0;
+    }
+    if(dispatcher){
         delete dispatcher;
-    if(collisionConfiguration)
+        dispatcher = 0;
+    }
+    if(collisionConfiguration){
         delete collisionConfiguration;
-    if(broadphase)
+        collisionConfiguration = 0;
+    }
+    if(broadphase){
         delete broadphase;
+        broadphase = 0;
+    }
 }
 
 void BulletSimulatorItemImpl::addBody(BulletBody* bulletBody, short group)
@@ -1494,9 +1611,11 @@ bool BulletSimulatorItemImpl::stepSimulation(const std::vector<SimulationBody*>&
         bulletBody->body->setVirtualJointForces();
         bulletBody->setControlValToBullet();
     }
+    self->lapDynamicsStepPhase(SimulatorItem::StateInputPhase);
 
     //dynamicsWorld->stepSimulation(timeStep,2,timeStep/2.);
     dynamicsWorld->stepSimulation(timeStep,1,timeStep);
+    self->lapDynamicsStepPhase(SimulatorItem::EngineStepPhase);
 
 #if DEBUG_OUT
     int numManifolds = dispatcher->getNumManifolds();
@@ -1532,6 +1651,7 @@ bool BulletSimulatorItemImpl::stepSimulation(const std::vector<SimulationBody*>&
             bulletBody->sensorHelper.updateGyroAndAccelerationSensors();
         }
     }
+    self->lapDynamicsStepPhase(SimulatorItem::StateOutputPhase);
     return true;
 }
 
@@ -1557,6 +1677,8 @@ void BulletSimulatorItemImpl::doPutProperties(PutPropertyFunction& putProperty)
     putProperty(_("use HACD"), useHACD, changeProperty(useHACD));
     putProperty(_("Collision Margin"), collisionMargin, changeProperty(collisionMargin));
     putProperty(_("use Featherstone Algorithm"), usefeatherstoneAlgorithm, changeProperty(usefeatherstoneAlgorithm));
+    putProperty.reset().min(1);
+    putProperty(_("Num of Threads"), numThreads, changeProperty(numThreads));
 }
 
 
@@ -1579,6 +1701,7 @@ void BulletSimulatorItemImpl::store(Archive& archive)
     archive.write("useHACD", useHACD);
     archive.write("CollisionMargin", collisionMargin);
     archive.write("usefeatherstoneAlgorithm", usefeatherstoneAlgorithm);
+    archive.write("NumThreads", numThreads);
 }
 
 
@@ -1601,6 +1724,7 @@ void BulletSimulatorItemImpl::restore(const Archive& archive)
     archive.read("useHACD", useHACD);
     archive.read("CollisionMargin", collisionMargin);
     archive.read("usefeatherstoneAlgorithm", usefeatherstoneAlgorithm);
+    archive.read("NumThreads", numThreads);
 }
 
 void BulletSimulatorItemImpl::setSolverParameter()
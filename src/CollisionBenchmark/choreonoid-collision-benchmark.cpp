@@ -0,0 +1,449 @@
+/**
+   This program measures the performance of the collision detectors registered as the factories
+   of CollisionDetector with the same scenes and the same sequences of the poses so that the
+   detectors can be compared with each other and the regressions can be caught.
+*/
+
+#include <cnoid/CollisionDetector>
+#include <cnoid/AISTCollisionDetector>
+#include <cnoid/BodyCollisionDetector>
+#include <cnoid/BodyLoader>
+#include <cnoid/BodyMotion>
+#include <cnoid/Body>
+#include <cnoid/Link>
+#include <cnoid/MeshGenerator>
+#include <cnoid/SceneDrawables>
+#include <cnoid/YAMLReader>
+#include <cnoid/EigenArchive>
+#include <cnoid/EigenUtil>
+#include <cnoid/ExecutablePath>
+#include <cnoid/FilePathVariableProcessor>
+#include <cnoid/stdx/filesystem>
+#include <fmt/format.h>
+#include <random>
+#include <chrono>
+#include <algorithm>
+#include <iostream>
+
+#ifndef _WIN32
+#include <dlfcn.h>
+#endif
+
+using namespace std;
+using namespace cnoid;
+using fmt::format;
+namespace filesystem = cnoid::stdx::filesystem;
+
+namespace {
+
+struct BodyInfo
+{
+    BodyPtr body;
+    bool isSelfCollisionDetectionEnabled;
+    shared_ptr<BodyMotion> motion;
+};
+
+class Benchmark
+{
+public:
+    vector<BodyInfo> bodies;
+    int numFrames;
+    unsigned int seed;
+    BodyLoader bodyLoader;
+
+    // The positions of all the links of the bodies in each frame
+    vector<vector<Isometry3>> framePositions;
+
+    Benchmark();
+    bool loadScene(const string& scene);
+    bool loadBody(const string& filename, const Isometry3& T, bool isSelfCollisionDetectionEnabled);
+    bool loadProject(const string& filename);
+    void createBoxPile(int numBoxes);
+    bool loadMotion(const string& filename);
+    void generateFrames();
+    void measure(const string& detectorName, CollisionDetector* detector);
+};
+
+}
+
+
+Benchmark::Benchmark()
+{
+    numFrames = 1000;
+    seed = 0;
+    bodyLoader.setMessageSink(cerr);
+}
+
+
+bool Benchmark::loadScene(const string& scene)
+{
+    if(scene == "boxes"){
+        createBoxPile(100);
+        return true;
+
+    } else if(scene == "humanoid"){
+        return loadBody(shareDir() + "/model/GR001/GR001.body", Isometry3::Identity(), true);
+
+    } else if(scene == "wrs2018"){
+        if(!loadProject(shareDir() + "/WRS2018/project/T1L.cnoid")){
+            return false;
+        }
+        Isometry3 T = Isometry3::Identity();
+        T.translation() << -1.0, 0.0, 0.0;
+        return loadBody(shareDir() + "/model/DoubleArmV7/DoubleArmV7A.body", T, true);
+    }
+
+    cerr << format("Unknown scene \"{}\".", scene) << endl;
+    return false;
+}
+
+
+bool Benchmark::loadBody(const string& filename, const Isometry3& T, bool isSelfCollisionDetectionEnabled)
+{
+    BodyPtr body = bodyLoader.load(filename);
+    if(!body){
+        cerr << format("\"{}\" cannot be loaded.", filename) << endl;
+        return false;
+    }
+    body->rootLink()->setPosition(T);
+    body->calcForwardKinematics();
+    bodies.push_back({ body, isSelfCollisionDetectionEnabled, nullptr });
+    return true;
+}
+
+
+/**
+   Loads the bodies of the body items in a project file with the initial positions
+   written in the file.
+*/
+bool Benchmark::loadProject(const string& filename)
+{
+    YAMLReader reader;
+    if(!reader.load(filename)){
+        cerr << format("\"{0}\" cannot be loaded: {1}", filename, reader.errorMessage()) << endl;
+        return false;
+    }
+    auto pathProcessor = FilePathVariableProcessor::systemInstance();
+    pathProcessor->setProjectDirectory(filesystem::path(filename).parent_path().string());
+
+    vector<Mapping*> items;
+    if(auto root = reader.document()->toMapping()->findMapping("items")){
+        items.push_back(root);
+    }
+    while(!items.empty()){
+        auto item = items.back();
+        items.pop_back();
+        auto children = item->findListing("children");
+        for(int i = children->size() - 1; i >= 0; --i){
+            if(auto child = children->at(i)->toMapping()){
+                items.push_back(child);
+            }
+        }
+        if(item->get("class", "") != "BodyItem"){
+            continue;
+        }
+        auto data = item->findMapping("data");
+        string modelFile;
+        if(!data->read("modelFile", modelFile)){
+            continue;
+        }
+        if(!data->get("collisionDetection", true)){
+            continue;
+        }
+        Isometry3 T = Isometry3::Identity();
+        Vector3 p;
+        if(read(data, "rootPosition", p)){
+            T.translation() = p;
+        }
+        Matrix3 R;
+        if(read(data, "rootAttitude", R)){
+            T.linear() = R;
+        }
+        if(!loadBody(pathProcessor->expand(modelFile, true), T, data->get("selfCollisionDetection", false))){
+            return false;
+        }
+    }
+    pathProcessor->clearProjectDirectory();
+
+    return true;
+}
+
+
+/**
+   The boxes are stacked on a floor with small gaps so that the random displacements of the
+   boxes in the frames cause many contacts.
+*/
+void Benchmark::createBoxPile(int numBoxes)
+{
+    MeshGenerator meshGenerator;
+
+    BodyPtr floor = new Body;
+    floor->setName("Floor");
+    auto floorLink = floor->createLink();
+    floorLink->setName("Floor");
+    floorLink->setJointType(Link::FixedJoint);
+    auto floorShape = new SgShape;
+    floorShape->setMesh(meshGenerator.generateBox(Vector3(10.0, 10.0, 0.1)));
+    floorLink->addShapeNode(floorShape);
+    floor->setRootLink(floorLink);
+    floorLink->setTranslation(Vector3(0.0, 0.0, -0.05));
+    floor->calcForwardKinematics();
+    bodies.push_back({ floor, false, nullptr });
+
+    const double size = 0.1;
+    const double pitch = size + 0.002;
+    const int numColumns = 5;
+    auto boxMesh = meshGenerator.generateBox(Vector3(size, size, size));
+    for(int i=0; i < numBoxes; ++i){
+        BodyPtr box = new Body;
+        box->setName(format("Box{}", i));
+        auto link = box->createLink();
+        link->setName("Box");
+        link->setJointType(Link::FreeJoint);
+        auto shape = new SgShape;
+        shape->setMesh(boxMesh);
+        link->addShapeNode(shape);
+        box->setRootLink(link);
+        int layer = i / (numColumns * numColumns);
+        int column = i % (numColumns * numColumns);
+        link->setTranslation(
+            Vector3((column % numColumns) * pitch, (column / numColumns) * pitch, size / 2.0 + layer * pitch));
+        box->calcForwardKinematics();
+        bodies.push_back({ box, false, nullptr });
+    }
+}
+
+
+//! The motion is replayed by the body given last.
+bool Benchmark::loadMotion(const string& filename)
+{
+    if(bodies.empty()){
+        cerr << "A body must be given before the motion." << endl;
+        return false;
+    }
+    auto motion = make_shared<BodyMotion>();
+    if(!motion->load(filename, cerr)){
+        cerr << format("\"{}\" cannot be loaded.", filename) << endl;
+        return false;
+    }
+    bodies.back().motion = motion;
+    return true;
+}
+
+
+/**
+   The poses of the bodies without motions are generated randomly with the fixed seed.
+   The joints move in their ranges and the free bodies are displaced from their initial
+   positions by a few millimeters.
+*/
+void Benchmark::generateFrames()
+{
+    std::mt19937 engine(seed);
+    std::uniform_real_distribution<double> uniform(-1.0, 1.0);
+
+    vector<Isometry3> initialRootPositions;
+    for(auto& info : bodies){
+        initialRootPositions.push_back(info.body->rootLink()->position());
+    }
+
+    framePositions.resize(numFrames);
+    for(int frame=0; frame < numFrames; ++frame){
+        auto& positions = framePositions[frame];
+        positions.clear();
+        for(size_t i=0; i < bodies.size(); ++i){
+            auto& info = bodies[i];
+            auto body = info.body;
+            if(info.motion){
+                const BodyMotion& motion = *info.motion;
+                int motionFrame = std::min(frame, motion.numFrames() - 1);
+                motion.frame(motionFrame) >> *body;
+            } else if(!body->isStaticModel()){
+                for(auto& joint : body->joints()){
+                    double lower = std::max(joint->q_lower(), -PI);
+                    double upper = std::min(joint->q_upper(), PI);
+                    if(lower < upper){
+                        joint->q() = (lower + upper) / 2.0 + uniform(engine) * (upper - lower) / 2.0;
+                    }
+                }
+                auto rootLink = body->rootLink();
+                if(rootLink->isFreeJoint()){
+                    const Isometry3& T0 = initialRootPositions[i];
+                    rootLink->p() = T0.translation() + 0.003 * Vector3(uniform(engine), uniform(engine), uniform(engine));
+                    rootLink->R() =
+                        T0.linear() * rotFromRpy(0.05 * uniform(engine), 0.05 * uniform(engine), 0.05 * uniform(engine));
+                }
+            }
+            body->calcForwardKinematics();
+            for(auto& link : body->links()){
+                positions.push_back(link->position());
+            }
+        }
+    }
+}
+
+
+void Benchmark::measure(const string& detectorName, CollisionDetector* detector)
+{
+    BodyCollisionDetector bodyCollisionDetector;
+    bodyCollisionDetector.setCollisionDetector(detector);
+
+    auto setupStart = std::chrono::steady_clock::now();
+    for(auto& info : bodies){
+        bodyCollisionDetector.addBody(info.body, info.isSelfCollisionDetectionEnabled);
+    }
+    if(!bodyCollisionDetector.makeReady()){
+        cout << format("{}: The detector cannot be initialized.", detectorName) << endl;
+        return;
+    }
+    double setupTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - setupStart).count();
+
+    vector<double> latencies(numFrames);
+    int64_t numPairs = 0;
+    int64_t numContacts = 0;
+
+    for(int frame=0; frame < numFrames; ++frame){
+        auto position = framePositions[frame].begin();
+        for(auto& info : bodies){
+            for(auto& link : info.body->links()){
+                link->setPosition(*position++);
+            }
+        }
+        auto start = std::chrono::steady_clock::now();
+        bodyCollisionDetector.updatePositions();
+        bodyCollisionDetector.detectCollisions(
+            [&](const CollisionPair& collisionPair){
+                ++numPairs;
+                numContacts += collisionPair.numCollisions();
+            });
+        latencies[frame] = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    double totalTime = 0.0;
+    for(auto& latency : latencies){
+        totalTime += latency;
+    }
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&](double ratio){
+        return latencies[std::min(numFrames - 1, static_cast<int>(ratio * numFrames))] * 1.0e6;
+    };
+
+    cout << format("{:<28} {:>9.1f} {:>10.0f} {:>10.0f} {:>9.2f} {:>10.2f} {:>10.1f} {:>10.1f} {:>10.1f}",
+                   detectorName, setupTime * 1.0e3, numFrames / totalTime, numPairs / totalTime,
+                   static_cast<double>(numPairs) / numFrames, static_cast<double>(numContacts) / numFrames,
+                   totalTime / numFrames * 1.0e6, percentile(0.5), percentile(0.99))
+         << endl;
+}
+
+
+static void printUsage()
+{
+    cerr <<
+        "Usage: choreonoid-collision-benchmark [options]\n"
+        "  --scene boxes|humanoid|wrs2018  Add a representative scene\n"
+        "  --body <file>                   Add a body with the self-collision detection\n"
+        "  --project <file>                Add the bodies of a project file\n"
+        "  --motion <file>                 Replay a motion file by the body given last\n"
+        "  --library <file>                Load a library registering collision detectors\n"
+        "  --detector <name>               Measure the detector only (repeatable)\n"
+        "  --frames <n>                    The number of the frames (default: 1000)\n"
+        "  --seed <n>                      The seed of the random poses (default: 0)\n";
+}
+
+
+int main(int argc, char *argv[])
+{
+    Benchmark benchmark;
+    vector<string> detectorNames;
+    bool isSceneGiven = false;
+
+    for(int i=1; i < argc; ++i){
+        string option(argv[i]);
+        if(option == "--help" || option == "-h"){
+            printUsage();
+            return 0;
+        }
+        if(i + 1 >= argc){
+            printUsage();
+            return 1;
+        }
+        string value(argv[++i]);
+        bool ok = true;
+        if(option == "--scene"){
+            ok = benchmark.loadScene(value);
+            isSceneGiven = true;
+        } else if(option == "--body"){
+            ok = benchmark.loadBody(value, Isometry3::Identity(), true);
+            isSceneGiven = true;
+        } else if(option == "--project"){
+            ok = benchmark.loadProject(value);
+            isSceneGiven = true;
+        } else if(option == "--motion"){
+            ok = benchmark.loadMotion(value);
+        } else if(option == "--library"){
+#ifndef _WIN32
+            if(!dlopen(value.c_str(), RTLD_NOW | RTLD_GLOBAL)){
+                cerr << dlerror() << endl;
+                ok = false;
+            }
+#else
+            cerr << "--library is not supported on this platform." << endl;
+            ok = false;
+#endif
+        } else if(option == "--detector"){
+            detectorNames.push_back(value);
+        } else if(option == "--frames"){
+            benchmark.numFrames = std::max(1, std::stoi(value));
+        } else if(option == "--seed"){
+            benchmark.seed = std::stoul(value);
+        } else {
+            printUsage();
+            return 1;
+        }
+        if(!ok){
+            return 1;
+        }
+    }
+
+    if(!isSceneGiven){
+        if(!benchmark.loadScene("boxes")){
+            return 1;
+        }
+    }
+
+    // Make sure that the AIST collision detector is registered
+    AISTCollisionDetector aistCollisionDetector;
+
+    if(detectorNames.empty()){
+        for(int i=0; i < CollisionDetector::numFactories(); ++i){
+            string name = CollisionDetector::factoryName(i);
+            if(name != "NullCollisionDetector"){
+                detectorNames.push_back(name);
+            }
+        }
+    }
+
+    benchmark.generateFrames();
+
+    int numLinks = 0;
+    for(auto& info : benchmark.bodies){
+        numLinks += info.body->numLinks();
+    }
+    cout << format("{} bodies, {} links, {} frames\n",
+                   benchmark.bodies.size(), numLinks, benchmark.numFrames) << endl;
+    cout << format("{:<28} {:>9} {:>10} {:>10} {:>9} {:>10} {:>10} {:>10} {:>10}",
+                   "Detector", "Setup[ms]", "Frames/s", "Pairs/s", "Pairs", "Contacts",
+                   "Mean[us]", "p50[us]", "p99[us]")
+         << endl;
+
+    for(auto& name : detectorNames){
+        int index = CollisionDetector::factoryIndex(name);
+        if(index < 0){
+            cout << format("{}: The detector is not registered.", name) << endl;
+            continue;
+        }
+        CollisionDetectorPtr detector = CollisionDetector::create(index);
+        benchmark.measure(name, detector);
+    }
+
+    return 0;
+}
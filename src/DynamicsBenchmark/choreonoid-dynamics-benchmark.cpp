@@ -0,0 +1,507 @@
+/**
+   This program measures the performance and the accuracy of the AIST physics engine with the
+   canonical scenes so that the regressions of the dynamics computation, the constraint force
+   solver and the collision detection can be caught for each commit. The results can be written
+   in JSON to be compared by scripts.
+*/
+
+#include <cnoid/HeadlessSimulator>
+#include <cnoid/ConstraintForceSolver>
+#include <cnoid/BodyLoader>
+#include <cnoid/BodyMotion>
+#include <cnoid/Body>
+#include <cnoid/Link>
+#include <cnoid/MeshGenerator>
+#include <cnoid/SceneDrawables>
+#include <cnoid/EigenUtil>
+#include <cnoid/ExecutablePath>
+#include <fmt/format.h>
+#include <random>
+#include <cmath>
+#include <chrono>
+#include <fstream>
+#include <algorithm>
+#include <iostream>
+
+using namespace std;
+using namespace cnoid;
+using fmt::format;
+
+namespace {
+
+const Vector3 Gravity(0.0, 0.0, -9.80665);
+
+// The gains of SR1WalkPatternController in the SimpleController samples
+const double WalkPGains[] = {
+    8000.0, 8000.0, 8000.0, 8000.0, 8000.0, 8000.0,
+    3000.0, 3000.0, 3000.0, 3000.0, 3000.0, 3000.0, 3000.0,
+    8000.0, 8000.0, 8000.0, 8000.0, 8000.0, 8000.0,
+    3000.0, 3000.0, 3000.0, 3000.0, 3000.0, 3000.0, 3000.0,
+    8000.0, 8000.0, 8000.0 };
+
+const double WalkDGain = 100.0;
+
+struct Result
+{
+    string scene;
+    string solver;
+    string forwardDynamics;
+    double timeStep;
+    int numSteps;
+    double elapsedTime;
+    double meanSolverIterations;
+    int maxSolverIterations;
+    double meanContacts;
+    int maxContacts;
+    double initialEnergy;
+    double finalEnergy;
+    double maxEnergyIncrease;
+};
+
+class Benchmark
+{
+public:
+    BodyLoader bodyLoader;
+    string patternDirectory;
+    double timeLength;
+    int numThreads;
+    vector<Result> results;
+
+    Benchmark();
+    bool run(const string& scene, const string& solver);
+    void putResult(const Result& result);
+    bool writeJson(const string& filename);
+
+private:
+    BodyPtr createFloor();
+    BodyPtr createBox(const string& name, double size, double mass);
+    BodyPtr loadBody(const string& filename);
+    bool setupBoxStack(HeadlessSimulator& simulator);
+    bool setupPile(HeadlessSimulator& simulator);
+    bool setupHumanoidWalk(HeadlessSimulator& simulator, bool isHighGainMode, double& io_timeStep);
+    bool setupTrackedVehicle(HeadlessSimulator& simulator);
+};
+
+double calcEnergy(HeadlessSimulator& simulator)
+{
+    double energy = 0.0;
+    for(int i=0; i < simulator.numBodies(); ++i){
+        for(auto& link : simulator.body(i)->links()){
+            const Matrix3& R = link->R();
+            const Vector3 c = R * link->c();
+            const Vector3 vc = link->v() + link->w().cross(c);
+            const Vector3& w = link->w();
+            const double m = link->m();
+            energy += 0.5 * m * vc.squaredNorm() + 0.5 * w.dot(R * link->I() * R.transpose() * w);
+            energy -= m * Gravity.dot(link->p() + c);
+        }
+    }
+    return energy;
+}
+
+}
+
+
+Benchmark::Benchmark()
+{
+    bodyLoader.setMessageSink(cerr);
+    patternDirectory = shareDir() + "/motion/SR1";
+    timeLength = 0.0;
+    numThreads = 1;
+}
+
+
+BodyPtr Benchmark::createFloor()
+{
+    MeshGenerator meshGenerator;
+    BodyPtr floor = new Body;
+    floor->setName("Floor");
+    auto link = floor->createLink();
+    link->setName("Floor");
+    link->setJointType(Link::FixedJoint);
+    auto shape = new SgShape;
+    shape->setMesh(meshGenerator.generateBox(Vector3(20.0, 20.0, 0.1)));
+    link->addShapeNode(shape);
+    floor->setRootLink(link);
+    link->setTranslation(Vector3(0.0, 0.0, -0.05));
+    floor->calcForwardKinematics();
+    return floor;
+}
+
+
+BodyPtr Benchmark::createBox(const string& name, double size, double mass)
+{
+    MeshGenerator meshGenerator;
+    BodyPtr box = new Body;
+    box->setName(name);
+    auto link = box->createLink();
+    link->setName(name);
+    link->setJointType(Link::FreeJoint);
+    link->setMass(mass);
+    link->setCenterOfMass(Vector3::Zero());
+    link->setInertia(Matrix3::Identity() * mass * size * size / 6.0);
+    auto shape = new SgShape;
+    shape->setMesh(meshGenerator.generateBox(Vector3(size, size, size)));
+    link->addShapeNode(shape);
+    box->setRootLink(link);
+    return box;
+}
+
+
+BodyPtr Benchmark::loadBody(const string& filename)
+{
+    BodyPtr body = bodyLoader.load(filename);
+    if(!body){
+        cerr << format("\"{}\" cannot be loaded.", filename) << endl;
+    }
+    return body;
+}
+
+
+//! Ten boxes are stacked in a column, which should stand still.
+bool Benchmark::setupBoxStack(HeadlessSimulator& simulator)
+{
+    simulator.addBody(createFloor());
+    const double size = 0.1;
+    for(int i=0; i < 10; ++i){
+        auto box = createBox(format("Box{}", i), size, 1.0);
+        box->rootLink()->setTranslation(Vector3(0.0, 0.0, size / 2.0 + i * size));
+        box->calcForwardKinematics();
+        simulator.addBody(box);
+    }
+    return true;
+}
+
+
+//! A hundred boxes with random attitudes are dropped onto the floor to make a pile.
+bool Benchmark::setupPile(HeadlessSimulator& simulator)
+{
+    simulator.addBody(createFloor());
+    std::mt19937 engine(0);
+    std::uniform_real_distribution<double> uniform(-PI, PI);
+    const double size = 0.1;
+    const double pitch = 0.16;
+    for(int i=0; i < 100; ++i){
+        auto box = createBox(format("Box{}", i), size, 1.0);
+        int layer = i / 25;
+        int column = i % 25;
+        auto rootLink = box->rootLink();
+        rootLink->setTranslation(
+            Vector3((column % 5 - 2) * pitch, (column / 5 - 2) * pitch, 0.2 + layer * pitch));
+        rootLink->setRotation(rotFromRpy(uniform(engine), uniform(engine), uniform(engine)));
+        box->calcForwardKinematics();
+        simulator.addBody(box);
+    }
+    return true;
+}
+
+
+/**
+   The SR1 model walks with the walking pattern of SR1WalkPatternController in the SimpleController
+   samples. The joints are controlled by the PD control in the torque mode, where the articulated
+   body method is used, and follow the pattern directly in the high-gain mode, where the
+   constraint-based method is used.
+*/
+bool Benchmark::setupHumanoidWalk(HeadlessSimulator& simulator, bool isHighGainMode, double& io_timeStep)
+{
+    auto robot = loadBody(shareDir() + "/model/SR1/SR1.body");
+    if(!robot){
+        return false;
+    }
+    string patternFile = patternDirectory + (isHighGainMode ? "/SR1WalkPattern2.seq" : "/SR1WalkPattern1.seq");
+    auto motion = make_shared<BodyMotion>();
+    if(!motion->loadStandardYAMLformat(patternFile)){
+        cerr << format("\"{0}\" cannot be loaded: {1}", patternFile, motion->seqMessage()) << endl;
+        return false;
+    }
+    auto qseq = motion->jointPosSeq();
+    if(qseq->numFrames() == 0 || qseq->numParts() != robot->numJoints()){
+        cerr << format("\"{}\" does not match the SR1 model.", patternFile) << endl;
+        return false;
+    }
+    io_timeStep = 1.0 / qseq->frameRate();
+
+    simulator.addBody(createFloor());
+    robot->rootLink()->setTranslation(Vector3(0.0, 0.0, 0.7135));
+    auto frame0 = qseq->frame(0);
+    for(int i=0; i < robot->numJoints(); ++i){
+        robot->joint(i)->q() = frame0[i];
+    }
+    robot->calcForwardKinematics();
+    Body* body = simulator.body(simulator.addBody(robot));
+
+    for(auto& joint : body->joints()){
+        joint->setActuationMode(isHighGainMode ? Link::JointDisplacement : Link::JointTorque);
+    }
+
+    auto frameIndex = make_shared<int>(0);
+    simulator.addPreDynamicsFunction(
+        [body, qseq, frameIndex, isHighGainMode](){
+            auto frame = qseq->frame(std::min(*frameIndex, qseq->numFrames() - 1));
+            auto prevFrame = qseq->frame(std::max(0, std::min(*frameIndex - 1, qseq->numFrames() - 1)));
+            const double dt = 1.0 / qseq->frameRate();
+            for(int i=0; i < body->numJoints(); ++i){
+                auto joint = body->joint(i);
+                if(isHighGainMode){
+                    joint->q_target() = frame[i];
+                } else {
+                    double dq_ref = (frame[i] - prevFrame[i]) / dt;
+                    joint->u() = (frame[i] - joint->q()) * WalkPGains[i] + (dq_ref - joint->dq()) * WalkDGain;
+                }
+            }
+            ++(*frameIndex);
+        });
+
+    return true;
+}
+
+
+//! The tank model goes straight with the pseudo continuous tracks.
+bool Benchmark::setupTrackedVehicle(HeadlessSimulator& simulator)
+{
+    auto tank = loadBody(shareDir() + "/model/Tank/Tank.body");
+    if(!tank){
+        return false;
+    }
+    simulator.addBody(createFloor());
+    tank->rootLink()->setTranslation(Vector3(0.0, 0.0, 0.106));
+    tank->calcForwardKinematics();
+    Body* body = simulator.body(simulator.addBody(tank));
+
+    auto trackL = body->link("TRACK_L");
+    auto trackR = body->link("TRACK_R");
+    if(!trackL || !trackR){
+        cerr << "The tracks of the tank model are not found." << endl;
+        return false;
+    }
+    trackL->setActuationMode(Link::JointVelocity);
+    trackR->setActuationMode(Link::JointVelocity);
+    vector<Link*> turretJoints;
+    for(auto& joint : body->joints()){
+        if(joint != trackL && joint != trackR){
+            joint->setActuationMode(Link::JointTorque);
+            turretJoints.push_back(joint);
+        }
+    }
+
+    simulator.addPreDynamicsFunction(
+        [trackL, trackR, turretJoints](){
+            trackL->dq_target() = 1.0;
+            trackR->dq_target() = 1.0;
+            // The gains of TankJoystickController in the SimpleController samples
+            for(auto& joint : turretJoints){
+                joint->u() = -200.0 * joint->q() - 50.0 * joint->dq();
+            }
+        });
+
+    return true;
+}
+
+
+bool Benchmark::run(const string& scene, const string& solver)
+{
+    HeadlessSimulator simulator;
+    simulator.setMessageOutput(cerr);
+    simulator.setGravity(Gravity);
+    simulator.setNumThreadsForIntegration(numThreads);
+
+    Result result;
+    result.scene = scene;
+    result.solver = solver;
+    result.forwardDynamics = "ABM";
+    result.timeStep = 0.001;
+    double sceneTimeLength = 2.0;
+
+    bool ok;
+    if(scene == "box-stack"){
+        ok = setupBoxStack(simulator);
+    } else if(scene == "pile"){
+        ok = setupPile(simulator);
+    } else if(scene == "humanoid-walk"){
+        ok = setupHumanoidWalk(simulator, false, result.timeStep);
+        sceneTimeLength = 5.0;
+    } else if(scene == "humanoid-walk-highgain"){
+        ok = setupHumanoidWalk(simulator, true, result.timeStep);
+        result.forwardDynamics = "CBM";
+        sceneTimeLength = 5.0;
+    } else if(scene == "tracked-vehicle"){
+        ok = setupTrackedVehicle(simulator);
+        sceneTimeLength = 3.0;
+    } else {
+        cerr << format("Unknown scene \"{}\".", scene) << endl;
+        return false;
+    }
+    if(!ok){
+        return false;
+    }
+
+    if(solver == "nncg"){
+        simulator.setNNCGSolverEnabled(true);
+    } else if(solver != "gs"){
+        cerr << format("Unknown solver \"{}\".", solver) << endl;
+        return false;
+    }
+
+    simulator.setTimeStep(result.timeStep);
+    if(!simulator.initialize()){
+        return false;
+    }
+    auto solverStats = simulator.constraintForceSolver();
+
+    result.numSteps = static_cast<int>(std::round((timeLength > 0.0 ? timeLength : sceneTimeLength) / result.timeStep));
+    result.initialEnergy = calcEnergy(simulator);
+    result.maxEnergyIncrease = 0.0;
+    result.maxSolverIterations = 0;
+    result.maxContacts = 0;
+    int64_t totalSolverIterations = 0;
+    int64_t totalContacts = 0;
+    double elapsedTime = 0.0;
+
+    for(int i=0; i < result.numSteps; ++i){
+        auto start = std::chrono::steady_clock::now();
+        simulator.stepSimulation();
+        elapsedTime += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        int n = solverStats->lastNumSolverIterations();
+        totalSolverIterations += n;
+        result.maxSolverIterations = std::max(result.maxSolverIterations, n);
+        int m = solverStats->lastNumContactPoints();
+        totalContacts += m;
+        result.maxContacts = std::max(result.maxContacts, m);
+        result.maxEnergyIncrease = std::max(result.maxEnergyIncrease, calcEnergy(simulator) - result.initialEnergy);
+    }
+
+    result.elapsedTime = elapsedTime;
+    result.meanSolverIterations = static_cast<double>(totalSolverIterations) / result.numSteps;
+    result.meanContacts = static_cast<double>(totalContacts) / result.numSteps;
+    result.finalEnergy = calcEnergy(simulator);
+    results.push_back(result);
+    putResult(result);
+
+    return true;
+}
+
+
+void Benchmark::putResult(const Result& r)
+{
+    cout << format("{:<24} {:<6} {:<4} {:>10.0f} {:>9.1f} {:>9} {:>9.1f} {:>9} {:>12.4f} {:>12.4f}",
+                   r.scene, r.solver, r.forwardDynamics, r.numSteps / r.elapsedTime,
+                   r.meanSolverIterations, r.maxSolverIterations, r.meanContacts, r.maxContacts,
+                   r.finalEnergy - r.initialEnergy, r.maxEnergyIncrease)
+         << endl;
+}
+
+
+bool Benchmark::writeJson(const string& filename)
+{
+    ofstream file(filename.c_str(), ios::out | ios::trunc);
+    if(!file){
+        cerr << format("\"{}\" cannot be opened.", filename) << endl;
+        return false;
+    }
+    file << "{\n  \"benchmark\": \"dynamics\",\n  \"results\": [\n";
+    for(size_t i=0; i < results.size(); ++i){
+        auto& r = results[i];
+        file << format(
+            "    {{ \"scene\": \"{}\", \"solver\": \"{}\", \"forward_dynamics\": \"{}\", "
+            "\"time_step\": {}, \"steps\": {}, \"steps_per_second\": {:.1f}, "
+            "\"mean_solver_iterations\": {:.3f}, \"max_solver_iterations\": {}, "
+            "\"mean_contacts\": {:.3f}, \"max_contacts\": {}, "
+            "\"initial_energy\": {:.6f}, \"final_energy\": {:.6f}, "
+            "\"energy_drift\": {:.6f}, \"max_energy_increase\": {:.6f} }}",
+            r.scene, r.solver, r.forwardDynamics, r.timeStep, r.numSteps, r.numSteps / r.elapsedTime,
+            r.meanSolverIterations, r.maxSolverIterations, r.meanContacts, r.maxContacts,
+            r.initialEnergy, r.finalEnergy, r.finalEnergy - r.initialEnergy, r.maxEnergyIncrease);
+        file << ((i + 1 < results.size()) ? ",\n" : "\n");
+    }
+    file << "  ]\n}\n";
+    return static_cast<bool>(file);
+}
+
+
+static void printUsage()
+{
+    cerr <<
+        "Usage: choreonoid-dynamics-benchmark [options]\n"
+        "  --scene <name>        box-stack, pile, humanoid-walk, humanoid-walk-highgain or\n"
+        "                        tracked-vehicle (repeatable, default: all)\n"
+        "  --solver gs|nncg      The MCP solver (repeatable, default: both)\n"
+        "  --time <seconds>      The time length of each scene instead of its default\n"
+        "  --threads <n>         The number of the threads for the integration\n"
+        "  --pattern-dir <dir>   The directory of the walking pattern files of the SR1 samples\n"
+        "  --json <file>         Write the results in JSON\n";
+}
+
+
+int main(int argc, char *argv[])
+{
+    Benchmark benchmark;
+    vector<string> scenes;
+    vector<string> solvers;
+    string jsonFile;
+
+    for(int i=1; i < argc; ++i){
+        string option(argv[i]);
+        if(option == "--help" || option == "-h"){
+            printUsage();
+            return 0;
+        }
+        if(i + 1 >= argc){
+            printUsage();
+            return 1;
+        }
+        string value(argv[++i]);
+        try {
+            if(option == "--scene"){
+                scenes.push_back(value);
+            } else if(option == "--solver"){
+                solvers.push_back(value);
+            } else if(option == "--time"){
+                benchmark.timeLength = std::stod(value);
+            } else if(option == "--threads"){
+                benchmark.numThreads = std::max(1, std::stoi(value));
+            } else if(option == "--pattern-dir"){
+                benchmark.patternDirectory = value;
+            } else if(option == "--json"){
+                jsonFile = value;
+            } else {
+                printUsage();
+                return 1;
+            }
+        }
+        catch(const std::logic_error&){
+            cerr << format("Invalid value \"{0}\" for {1}.", value, option) << endl;
+            return 1;
+        }
+    }
+
+    if(scenes.empty()){
+        scenes = { "box-stack", "pile", "humanoid-walk", "humanoid-walk-highgain", "tracked-vehicle" };
+    }
+    if(solvers.empty()){
+        solvers = { "gs", "nncg" };
+    }
+
+    cout << format("{:<24} {:<6} {:<4} {:>10} {:>9} {:>9} {:>9} {:>9} {:>12} {:>12}",
+                   "Scene", "Solver", "FD", "Steps/s", "Iter", "MaxIter", "Contacts", "MaxCont",
+                   "EnergyDrift", "MaxEnergyInc")
+         << endl;
+
+    bool failed = false;
+    for(auto& scene : scenes){
+        for(auto& solver : solvers){
+            if(!benchmark.run(scene, solver)){
+                cout << format("{0} ({1}): The scene cannot be set up.", scene, solver) << endl;
+                failed = true;
+            }
+        }
+    }
+
+    if(!jsonFile.empty()){
+        if(!benchmark.writeJson(jsonFile)){
+            return 1;
+        }
+    }
+
+    return failed ? 1 : 0;
+}
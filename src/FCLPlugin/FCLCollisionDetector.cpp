@@ -3,12 +3,16 @@
 #include <cnoid/IdPair>
 #include <cnoid/MeshExtractor>
 #include <cnoid/SceneDrawables>
+#include <cnoid/ThreadPool>
 #include <cnoid/stdx/optional>
 #include <fcl/collision.h>
+#include <fcl/distance.h>
 #include <fcl/BVH/BVH_model.h>
 #include <fcl/BV/BV.h>
 #include <fcl/narrowphase/gjk.h>
 #include <memory>
+#include <algorithm>
+#include <atomic>
 
 using namespace std;
 using namespace cnoid;
@@ -17,6 +21,9 @@ namespace {
 
 const bool USE_PRIMITIVE = true;
 
+// The distance queries are processed in parallel in the chunks of this number of queries
+const int DistanceQueryChunkSize = 16;
+
 typedef shared_ptr<fcl::CollisionObject> CollisionObjectPtr;
 typedef fcl::BVHModel<fcl::OBBRSS> MeshModel;
 typedef shared_ptr<MeshModel> MeshModelPtr;
@@ -43,6 +50,7 @@ public :
 typedef ref_ptr<CollisionModel> CollisionModelPtr;
 
 typedef CollisionDetector::GeometryHandle GeometryHandle;
+typedef CollisionDetectorDistanceAPI::DistanceQuery DistanceQuery;
 
 CollisionModel* getCollisionModel(GeometryHandle handle)
 {
@@ -93,6 +101,14 @@ public:
     void detectCollisions(std::function<void(const CollisionPair&)> callback);
     void detectObjectCollisions(
         fcl::CollisionObject* object1, fcl::CollisionObject* object2, CollisionPair& collisionPair);
+
+    int numThreads;
+    unique_ptr<ThreadPool> threadPool;
+    std::atomic<int> nextDistanceQueryIndex;
+    void detectDistances(vector<DistanceQuery>& queries, double threshold);
+    void detectDistance(DistanceQuery& query, double threshold);
+    void detectObjectDistance(
+        fcl::CollisionObject* object1, fcl::CollisionObject* object2, DistanceQuery& query);
 };
 
 }
@@ -107,6 +123,7 @@ FCLCollisionDetector::FCLCollisionDetector()
 FCLCollisionDetector::Impl::Impl()
 {
     isReady = false;
+    numThreads = 0;
 }    
 
 
@@ -383,15 +400,18 @@ void FCLCollisionDetector::updatePosition(GeometryHandle geometry, const Isometr
 
 void FCLCollisionDetector::Impl::updatePosition(CollisionModel* model, const Isometry3& position)
 {
+    // The AABBs in the world coordinate are updated for the early-out of the distance queries
     auto T = convertToFclTransform(position);
     if(model->meshObject){
         model->meshObject->setTransform(T);
+        model->meshObject->computeAABB();
     }
     auto pLocalPosition = model->primitiveLocalPositions.begin();
     for(auto& primitive : model->primitiveObjects){
         if(primitive){
             const auto& T_local = *pLocalPosition;
             primitive->setTransform(T * T_local);
+            primitive->computeAABB();
         }
         ++pLocalPosition;
     }
@@ -488,6 +508,167 @@ void FCLCollisionDetector::Impl::detectObjectCollisions
 }
 
 
+void FCLCollisionDetector::setNumThreads(int n)
+{
+    if(n != impl->numThreads){
+        impl->numThreads = n;
+        if(n > 0){
+            impl->threadPool.reset(new ThreadPool(n));
+        } else {
+            impl->threadPool.reset();
+        }
+    }
+}
+
+
+double FCLCollisionDetector::detectDistance
+(GeometryHandle geometry1, GeometryHandle geometry2, Vector3& out_point1, Vector3& out_point2)
+{
+    DistanceQuery query(geometry1, geometry2);
+    impl->detectDistance(query, std::numeric_limits<double>::max());
+    out_point1 = query.point1;
+    out_point2 = query.point2;
+    return query.distance;
+}
+
+
+void FCLCollisionDetector::detectDistances(vector<DistanceQuery>& io_queries, double threshold)
+{
+    impl->detectDistances(io_queries, threshold);
+}
+
+
+void FCLCollisionDetector::Impl::detectDistances(vector<DistanceQuery>& queries, double threshold)
+{
+    const int n = queries.size();
+    if(numThreads == 0 || n <= DistanceQueryChunkSize){
+        for(auto& query : queries){
+            detectDistance(query, threshold);
+        }
+    } else {
+        nextDistanceQueryIndex = 0;
+        const int numChunks = (n + DistanceQueryChunkSize - 1) / DistanceQueryChunkSize;
+        const int numActiveThreads = std::min(numThreads, numChunks);
+        for(int i=0; i < numActiveThreads; ++i){
+            threadPool->start(
+                [this, &queries, n, threshold](){
+                    while(true){
+                        const int begin = nextDistanceQueryIndex.fetch_add(DistanceQueryChunkSize);
+                        if(begin >= n){
+                            break;
+                        }
+                        const int end = std::min(begin + DistanceQueryChunkSize, n);
+                        for(int j = begin; j < end; ++j){
+                            detectDistance(queries[j], threshold);
+                        }
+                    }
+                });
+        }
+        threadPool->wait();
+    }
+}
+
+
+/**
+   The distance between two models is the minimum distance of the combinations of their mesh
+   and primitive objects. The combinations whose AABBs are farther than the threshold or the
+   current minimum distance are skipped.
+*/
+void FCLCollisionDetector::Impl::detectDistance(DistanceQuery& query, double threshold)
+{
+    auto model1 = getCollisionModel(query.geometry1);
+    auto model2 = getCollisionModel(query.geometry2);
+    if(!model1 || !model2){
+        query.distance = -1.0;
+        return;
+    }
+
+    vector<fcl::CollisionObject*> objects[2];
+    int index = 0;
+    for(auto& model : { model1, model2 }){
+        if(model->meshObject){
+            objects[index].push_back(model->meshObject.get());
+        }
+        for(auto& primitive : model->primitiveObjects){
+            objects[index].push_back(primitive.get());
+        }
+        ++index;
+    }
+
+    query.distance = std::numeric_limits<double>::max();
+    double lowerBound = std::numeric_limits<double>::max();
+    for(auto& object1 : objects[0]){
+        for(auto& object2 : objects[1]){
+            double d = object1->getAABB().distance(object2->getAABB());
+            if(d > threshold){
+                lowerBound = std::min(lowerBound, d);
+            } else if(d < query.distance){
+                detectObjectDistance(object1, object2, query);
+            }
+        }
+    }
+    if(query.distance > threshold){
+        query.distance = std::min(query.distance, lowerBound);
+    }
+}
+
+
+void FCLCollisionDetector::Impl::detectObjectDistance
+(fcl::CollisionObject* object1, fcl::CollisionObject* object2, DistanceQuery& query)
+{
+    fcl::DistanceRequest request(true);
+    fcl::DistanceResult result;
+    fcl::distance(object1, object2, request, result);
+
+    if(result.min_distance < query.distance){
+        query.distance = result.min_distance;
+        /*
+          FCL 0.5 gives the nearest points of two BVH models in the world coordinate, but the
+          ones of the other combinations in the local coordinates of the objects.
+        */
+        const bool isWorldCoordinate =
+            (object1->getObjectType() == fcl::OT_BVH && object2->getObjectType() == fcl::OT_BVH);
+        Vector3* points[] = { &query.point1, &query.point2 };
+        fcl::CollisionObject* objects[] = { object1, object2 };
+        for(int i=0; i < 2; ++i){
+            fcl::Vec3f p = result.nearest_points[i];
+            if(!isWorldCoordinate){
+                p = objects[i]->getTransform().transform(p);
+            }
+            *points[i] << p[0], p[1], p[2];
+        }
+    }
+}
+
+
+void FCLCollisionDetector::detectDistances
+(GeometryHandle geometry, double threshold, vector<DistanceQuery>& out_queries)
+{
+    out_queries.clear();
+
+    auto model = getCollisionModel(geometry);
+    if(!model){
+        return;
+    }
+    for(auto& other : impl->models){
+        if(other && other != model){
+            auto handle = getHandle(other);
+            if(impl->ignoredPairs.find(IdPair<GeometryHandle>(geometry, handle)) == impl->ignoredPairs.end()){
+                out_queries.emplace_back(geometry, handle);
+            }
+        }
+    }
+
+    impl->detectDistances(out_queries, threshold);
+
+    out_queries.erase(
+        std::remove_if(
+            out_queries.begin(), out_queries.end(),
+            [threshold](const DistanceQuery& query){ return query.distance > threshold; }),
+        out_queries.end());
+}
+
+
 class FCLPlugin : public Plugin
 {
 public:
@@ -5,7 +5,7 @@
 
 namespace cnoid {
 
-class FCLCollisionDetector : public CollisionDetector
+class FCLCollisionDetector : public CollisionDetector, public CollisionDetectorDistanceAPI
 {
 public:
     FCLCollisionDetector();
@@ -24,6 +24,17 @@ public:
         std::function<void(Referenced* object, Isometry3*& out_position)> positionQuery) override;
     virtual void detectCollisions(std::function<void(const CollisionPair&)> callback) override;
 
+    // CollisionDetectorDistanceAPI
+    virtual double detectDistance(
+        GeometryHandle geometry1, GeometryHandle geometry2, Vector3& out_point1, Vector3& out_point2) override;
+    virtual void detectDistances(
+        std::vector<DistanceQuery>& io_queries, double threshold = std::numeric_limits<double>::max()) override;
+    virtual void detectDistances(
+        GeometryHandle geometry, double threshold, std::vector<DistanceQuery>& out_queries) override;
+
+    //! The distance queries given to detectDistances() are processed by this number of threads
+    void setNumThreads(int n);
+
 private:
     class Impl;
     Impl* impl;
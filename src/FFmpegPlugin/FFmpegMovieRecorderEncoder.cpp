@@ -7,6 +7,8 @@ extern "C" {
 #include <libavformat/avformat.h>
 #include <libavutil/opt.h>
 #include <libavutil/imgutils.h>
+#include <libavutil/hwcontext.h>
+#include <libswscale/swscale.h>
 }
 
 #include "gettext.h"
@@ -17,19 +19,48 @@ using fmt::format;
 
 namespace {
 
-void YCbCrfromRGB(double& Y, double& Cb, double& Cr, const double R, const double G, const double B) 
+const char* getCodecName(FFmpegMovieRecorderEncoder::EncoderType type)
 {
-    Y = 0.257 * R + 0.504 * G + 0.098 * B + 16.0;
-    Cb = -0.148 * R - 0.291 * G + 0.439 * B + 128.0;
-    Cr = 0.439 * R - 0.368 * G - 0.071 * B + 128.0;
+    switch(type){
+    case FFmpegMovieRecorderEncoder::NvencEncoder:
+        return "h264_nvenc";
+    case FFmpegMovieRecorderEncoder::VaapiEncoder:
+        return "h264_vaapi";
+    default:
+#ifdef _WIN32
+        return "libopenh264";
+#else
+        return "libx264";
+#endif
+    }
+}
+
 }
 
+
+bool FFmpegMovieRecorderEncoder::isAvailable(EncoderType type)
+{
+    return avcodec_find_encoder_by_name(getCodecName(type)) != nullptr;
+}
+
+
+FFmpegMovieRecorderEncoder::FFmpegMovieRecorderEncoder(EncoderType type)
+    : encoderType(type)
+{
+
 }
 
 
 std::string FFmpegMovieRecorderEncoder::formatName() const
 {
-    return "MP4";
+    switch(encoderType){
+    case NvencEncoder:
+        return "MP4 (NVENC)";
+    case VaapiEncoder:
+        return "MP4 (VA-API)";
+    default:
+        return "MP4";
+    }
 }
 
 
@@ -66,11 +97,7 @@ bool FFmpegMovieRecorderEncoder::doEncoding(std::string fileBasename)
 
     format_context->pb = io_context;
 
-#ifdef _WIN32
-    const char* encoderName = "libopenh264";
-#else
-    const char* encoderName = "libx264";
-#endif
+    const char* encoderName = getCodecName(encoderType);
     AVCodec* codec = avcodec_find_encoder_by_name(encoderName);
     if(!codec){
         setErrorMessage(format(_("Encoder \"{0}\" is not found."), encoderName));
@@ -94,6 +121,20 @@ bool FFmpegMovieRecorderEncoder::doEncoding(std::string fileBasename)
     codec_context->max_b_frames = 1;
     codec_context->pix_fmt = AVPixelFormat::AV_PIX_FMT_YUV420P;
 
+    /*
+      The VA-API encoder takes the frames in the GPU memory, so the converted frames are uploaded
+      to the hardware frames allocated in the frames context. NV12 is the frame format which is
+      supported by all the VA-API drivers.
+    */
+    AVPixelFormat swFramePixelFormat = codec_context->pix_fmt;
+    if(encoderType == VaapiEncoder){
+        if(!setHardwareFramesContext(codec_context)){
+            avcodec_free_context(&codec_context);
+            return false;
+        }
+        swFramePixelFormat = AVPixelFormat::AV_PIX_FMT_NV12;
+    }
+
     if(format_context->oformat->flags & AVFMT_GLOBALHEADER){
         codec_context->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
     }
@@ -132,7 +173,7 @@ bool FFmpegMovieRecorderEncoder::doEncoding(std::string fileBasename)
         setErrorMessage(_("A video frame data cannot be allocated."));
         return false;
     }
-    avFrame->format = codec_context->pix_fmt;
+    avFrame->format = swFramePixelFormat;
     avFrame->width = codec_context->width;
     avFrame->height = codec_context->height;
 
@@ -142,7 +183,16 @@ bool FFmpegMovieRecorderEncoder::doEncoding(std::string fileBasename)
         return false;
     }
 
-    int img_size = codec_context->height * codec_context->width;
+    AVFrame* hwFrame = nullptr;
+    if(encoderType == VaapiEncoder){
+        hwFrame = av_frame_alloc();
+        if(!hwFrame){
+            setErrorMessage(_("A video frame data cannot be allocated."));
+            return false;
+        }
+    }
+
+    SwsContext* sws_context = nullptr;
     bool failed = false;
 
     while(true){
@@ -161,87 +211,149 @@ bool FFmpegMovieRecorderEncoder::doEncoding(std::string fileBasename)
             break;
         }
 
-        // copy into frame
         QImage image;
         if(stdx::get_variant_index(captured->image) == 0){
             image = stdx::get<QPixmap>(captured->image).toImage();
         } else {
             image = stdx::get<QImage>(captured->image);
         }
-        
-        for(int y = 0; y < codec_context->height; ++y){
-            for (int x = 0; x < codec_context->width; ++x){
-                QRgb rgb = image.pixel(x, y);
-                double Y, Cb, Cr;
-                YCbCrfromRGB(Y, Cb, Cr, qRed(rgb), qGreen(rgb), qBlue(rgb));
-                avFrame->data[0][y * avFrame->linesize[0] + x] = Y;
-            }
-        }
-        for(int y = 0; y < codec_context->height / 2; ++y){
-            for(int x = 0; x < codec_context->width / 2; ++x){
-                QRgb rgb = image.pixel(2 * x, 2 * y);
-                double Y, Cb, Cr;
-                YCbCrfromRGB(Y, Cb, Cr, qRed(rgb), qGreen(rgb), qBlue(rgb));
-                avFrame->data[1][y * avFrame->linesize[1] + x] = Cb;
-                avFrame->data[2][y * avFrame->linesize[2] + x] = Cr;
-            }
+        /*
+          The pixel format of QImage::Format_RGB32 corresponds to AV_PIX_FMT_RGB32 because both
+          the formats store a pixel as a 32-bit integer of 0xAARRGGBB in the native byte order.
+          The images captured from the scene views are in Format_RGBX8888, which is the byte
+          order of the OpenGL framebuffer. The context is only recreated when the image size
+          or the pixel format changes.
+        */
+        AVPixelFormat srcPixelFormat;
+        switch(image.format()){
+        case QImage::Format_RGBX8888:
+        case QImage::Format_RGBA8888:
+            srcPixelFormat = AVPixelFormat::AV_PIX_FMT_RGBA;
+            break;
+        case QImage::Format_RGB32:
+        case QImage::Format_ARGB32:
+            srcPixelFormat = AVPixelFormat::AV_PIX_FMT_RGB32;
+            break;
+        default:
+            image = image.convertToFormat(QImage::Format_RGB32);
+            srcPixelFormat = AVPixelFormat::AV_PIX_FMT_RGB32;
+            break;
         }
-        
-        avFrame->pts = captured->frame;
-
-        if(avcodec_send_frame(codec_context, avFrame) != 0){
-            setErrorMessage(_("Executing avcodec_send_frame failed."));
+        sws_context = sws_getCachedContext(
+            sws_context, image.width(), image.height(), srcPixelFormat,
+            width, height, swFramePixelFormat, SWS_BILINEAR, nullptr, nullptr, nullptr);
+        if(!sws_context){
+            setErrorMessage(_("The color conversion context cannot be created."));
             failed = true;
             break;
         }
-        AVPacket packet = AVPacket();
-        while(avcodec_receive_packet(codec_context, &packet) == 0){
-            packet.stream_index = 0;
-            av_packet_rescale_ts(&packet, codec_context->time_base, stream->time_base);
-            ret = av_interleaved_write_frame(format_context, &packet);
-            if(ret != 0){
-                setErrorMessage(format(_("Executing av_interleaved_write_frame failed: {0}"), ret));
+        const uint8_t* srcData[] = { image.constBits() };
+        const int srcLinesize[] = { static_cast<int>(image.bytesPerLine()) };
+        sws_scale(sws_context, srcData, srcLinesize, 0, image.height(), avFrame->data, avFrame->linesize);
+
+        avFrame->pts = captured->frame;
+
+        AVFrame* frameToSend = avFrame;
+        if(hwFrame){
+            av_frame_unref(hwFrame);
+            if(av_hwframe_get_buffer(codec_context->hw_frames_ctx, hwFrame, 0) < 0 ||
+               av_hwframe_transfer_data(hwFrame, avFrame, 0) < 0){
+                setErrorMessage(_("A video frame cannot be uploaded to the hardware encoder."));
                 failed = true;
                 break;
             }
+            hwFrame->pts = avFrame->pts;
+            frameToSend = hwFrame;
         }
-        if(failed){
+
+        if(!sendFrame(codec_context, frameToSend) ||
+           !writePackets(format_context, codec_context, stream)){
+            failed = true;
             break;
         }
     }
 
-    AVPacket packet;
+    if(!failed){
+        // flush encoder
+        if(!sendFrame(codec_context, nullptr) ||
+           !writePackets(format_context, codec_context, stream)){
+            failed = true;
+        } else if(av_write_trailer(format_context) != 0){
+            setErrorMessage(_("Executing av_write_trailer failed."));
+            failed = true;
+        }
+    }
+
+    sws_freeContext(sws_context);
+    av_frame_free(&hwFrame);
+    av_frame_free(&avFrame);
+    avcodec_free_context(&codec_context);
+    avformat_free_context(format_context);
+    avio_closep(&io_context);
+
+    return !failed;
+}
 
-    if(failed){
-        goto finalization;
+
+bool FFmpegMovieRecorderEncoder::setHardwareFramesContext(AVCodecContext* codec_context)
+{
+    AVBufferRef* hw_device_context = nullptr;
+    int ret = av_hwdevice_ctx_create(&hw_device_context, AV_HWDEVICE_TYPE_VAAPI, nullptr, nullptr, 0);
+    if(ret < 0){
+        char error[AV_ERROR_MAX_STRING_SIZE];
+        av_make_error_string(error, AV_ERROR_MAX_STRING_SIZE, ret);
+        setErrorMessage(format(_("The VA-API device cannot be opened: {0}"), error));
+        return false;
     }
 
-    // flush encoder
-    if(avcodec_send_frame(codec_context, nullptr) != 0){
+    bool result = false;
+    AVBufferRef* hw_frames_ref = av_hwframe_ctx_alloc(hw_device_context);
+    if(!hw_frames_ref){
+        setErrorMessage(_("The hardware frames context cannot be allocated."));
+    } else {
+        auto frames_context = reinterpret_cast<AVHWFramesContext*>(hw_frames_ref->data);
+        frames_context->format = AVPixelFormat::AV_PIX_FMT_VAAPI;
+        frames_context->sw_format = AVPixelFormat::AV_PIX_FMT_NV12;
+        frames_context->width = width;
+        frames_context->height = height;
+        frames_context->initial_pool_size = 20;
+        if(av_hwframe_ctx_init(hw_frames_ref) < 0){
+            setErrorMessage(_("The hardware frames context cannot be initialized."));
+        } else {
+            codec_context->pix_fmt = AVPixelFormat::AV_PIX_FMT_VAAPI;
+            codec_context->hw_frames_ctx = av_buffer_ref(hw_frames_ref);
+            result = (codec_context->hw_frames_ctx != nullptr);
+        }
+        av_buffer_unref(&hw_frames_ref);
+    }
+    av_buffer_unref(&hw_device_context);
+
+    return result;
+}
+
+
+bool FFmpegMovieRecorderEncoder::sendFrame(AVCodecContext* codec_context, AVFrame* frame)
+{
+    if(avcodec_send_frame(codec_context, frame) != 0){
         setErrorMessage(_("Executing avcodec_send_frame failed."));
-        failed = true;
-        goto finalization;
+        return false;
     }
+    return true;
+}
+
+
+bool FFmpegMovieRecorderEncoder::writePackets
+(AVFormatContext* format_context, AVCodecContext* codec_context, AVStream* stream)
+{
+    AVPacket packet = AVPacket();
     while(avcodec_receive_packet(codec_context, &packet) == 0){
         packet.stream_index = 0;
         av_packet_rescale_ts(&packet, codec_context->time_base, stream->time_base);
-        ret = av_interleaved_write_frame(format_context, &packet);
+        int ret = av_interleaved_write_frame(format_context, &packet);
         if(ret != 0){
             setErrorMessage(format(_("Executing av_interleaved_write_frame failed: {0}"), ret));
-            failed = true;
-            goto finalization;
+            return false;
         }
     }
-    if(av_write_trailer(format_context) != 0){
-        setErrorMessage(_("Executing av_write_trailer failed."));
-        failed = true;
-    }
-
-finalization:
-    av_frame_free(&avFrame);
-    avcodec_free_context(&codec_context);
-    avformat_free_context(format_context);
-    avio_closep(&io_context);
-
-    return !failed;
+    return true;
 }
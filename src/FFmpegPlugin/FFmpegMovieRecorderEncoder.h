@@ -3,19 +3,36 @@
 
 #include <cnoid/MovieRecorder>
 
+struct AVCodecContext;
+struct AVFormatContext;
+struct AVStream;
+struct AVFrame;
+
 namespace cnoid {
 
 class FFmpegMovieRecorderEncoder : public MovieRecorderEncoder
 {
 public:
+    enum EncoderType { SoftwareEncoder, NvencEncoder, VaapiEncoder };
+
+    //! \return true if the codec of the encoder type is available in the linked FFmpeg libraries
+    static bool isAvailable(EncoderType type);
+
+    FFmpegMovieRecorderEncoder(EncoderType type = SoftwareEncoder);
+
     virtual std::string formatName() const override;
     virtual bool initializeEncoding(int width, int height, int frameRate) override;
     virtual bool doEncoding(std::string fileBasename) override;
 
 private:
+    EncoderType encoderType;
     int width;
     int height;
     int frameRate;
+
+    bool setHardwareFramesContext(AVCodecContext* codec_context);
+    bool sendFrame(AVCodecContext* codec_context, AVFrame* frame);
+    bool writePackets(AVFormatContext* format_context, AVCodecContext* codec_context, AVStream* stream);
 };
 
 }
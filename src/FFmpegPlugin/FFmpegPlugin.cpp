@@ -16,6 +16,11 @@ public:
     virtual bool initialize()
     {
         MovieRecorder::addEncoder(new FFmpegMovieRecorderEncoder);
+        for(auto type : { FFmpegMovieRecorderEncoder::NvencEncoder, FFmpegMovieRecorderEncoder::VaapiEncoder }){
+            if(FFmpegMovieRecorderEncoder::isAvailable(type)){
+                MovieRecorder::addEncoder(new FFmpegMovieRecorderEncoder(type));
+            }
+        }
         return true;
     }
 };
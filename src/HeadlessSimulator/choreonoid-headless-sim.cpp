@@ -0,0 +1,105 @@
+/**
+   This program runs the simulation of a project with the AIST physics engine without
+   initializing the GUI so that simulations can be run on machines without a display and
+   many simulation processes can be run in parallel.
+*/
+
+#include <cnoid/HeadlessSimulator>
+#include <cnoid/Body>
+#include <cnoid/Link>
+#include <fmt/format.h>
+#include <chrono>
+#include <iostream>
+
+using namespace std;
+using namespace cnoid;
+using fmt::format;
+
+namespace {
+
+void printUsage()
+{
+    cout << "Usage: choreonoid-headless-sim [options] project-file\n"
+         << "Options:\n"
+         << "  --time <seconds>     The time length of the simulation. The time length specified\n"
+         << "                       in the simulator item of the project is used by default.\n"
+         << "  --timestep <seconds> The time step of the simulation\n"
+         << "  --threads <number>   The number of threads used for the integration\n";
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    HeadlessSimulator simulator;
+    simulator.setMessageOutput(cerr);
+
+    string projectFile;
+    double timeLength = 0.0;
+    double timeStep = 0.0;
+    int numThreads = 0;
+
+    for(int i=1; i < argc; ++i){
+        string option(argv[i]);
+        if(option == "--help" || option == "-h"){
+            printUsage();
+            return 0;
+        }
+        if(option.compare(0, 2, "--") != 0){
+            projectFile = option;
+            continue;
+        }
+        if(i + 1 >= argc){
+            printUsage();
+            return 1;
+        }
+        string value(argv[++i]);
+        try {
+            if(option == "--time"){
+                timeLength = std::stod(value);
+            } else if(option == "--timestep"){
+                timeStep = std::stod(value);
+            } else if(option == "--threads"){
+                numThreads = std::stoi(value);
+            } else {
+                printUsage();
+                return 1;
+            }
+        }
+        catch(const std::logic_error&){
+            cerr << format("Invalid value \"{0}\" for {1}.", value, option) << endl;
+            return 1;
+        }
+    }
+
+    if(projectFile.empty()){
+        printUsage();
+        return 1;
+    }
+    if(!simulator.loadProject(projectFile)){
+        return 1;
+    }
+    if(timeStep > 0.0){
+        simulator.setTimeStep(timeStep);
+    }
+    if(numThreads > 0){
+        simulator.setNumThreadsForIntegration(numThreads);
+    }
+
+    auto startTime = std::chrono::steady_clock::now();
+    if(!simulator.simulate(timeLength)){
+        return 1;
+    }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+
+    cout << format("Simulated {0:.3f} s in {1:.3f} s (realtime factor {2:.2f}).",
+                   simulator.currentTime(), elapsed, simulator.currentTime() / elapsed) << endl;
+
+    for(int i=0; i < simulator.numBodies(); ++i){
+        auto body = simulator.body(i);
+        auto p = body->rootLink()->translation();
+        cout << format("{0}: root position ({1:.6f}, {2:.6f}, {3:.6f})", body->name(), p.x(), p.y(), p.z()) << endl;
+    }
+
+    return 0;
+}
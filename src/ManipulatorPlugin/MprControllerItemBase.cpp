@@ -1,6 +1,7 @@
 #include "MprControllerItemBase.h"
 #include "MprProgramItemBase.h"
 #include "MprBasicStatements.h"
+#include "MprTagTraceStatement.h"
 #include "MprVariableList.h"
 #include "MprMultiVariableListItem.h"
 #include <cnoid/ItemManager>
@@ -110,6 +111,7 @@ public:
     unordered_map<type_index, InterpretFunction> interpreterMap;
     DigitalIoDevicePtr ioDevice;
     double speedRatio;
+    bool isTagTraceIkPrecomputationEnabled;
 
     MprControllerLogPtr currentLog;
     unordered_map<MprProgramPtr, shared_ptr<string>> topLevelProgramToSharedNameMap;
@@ -127,6 +129,8 @@ public:
     Impl(MprControllerItemBase* self);
     bool initialize(ControllerIO* io);
     bool createKinematicsKitForControl();
+    void precomputeTagTraceIk(ItemList<MprProgramItemBase>& programItems);
+    void applyTagTraceIkPrecomputation();
 
     // Default variable mappings
     bool initializeDefaultVariableMappings();
@@ -177,6 +181,7 @@ MprControllerItemBase::MprControllerItemBase(const MprControllerItemBase& org)
     : ControllerItem(org)
 {
     impl = new Impl(this);
+    impl->isTagTraceIkPrecomputationEnabled = org.impl->isTagTraceIkPrecomputationEnabled;
 }
 
 
@@ -185,6 +190,7 @@ MprControllerItemBase::Impl::Impl(MprControllerItemBase* self)
 {
     isControlActive = false;
     speedRatio = 1.0;
+    isTagTraceIkPrecomputationEnabled = true;
     currentLog = new MprControllerLog;
 }
 
@@ -307,6 +313,11 @@ bool MprControllerItemBase::Impl::initialize(ControllerIO* io)
                          self->displayName()), MessageView::Error);
         return false;
     }
+
+    if(isTagTraceIkPrecomputationEnabled){
+        precomputeTagTraceIk(programItems);
+    }
+    
     startupProgram = cloneMap.getClone(startupProgramItem->program());
     currentProgram = startupProgram;
 
@@ -320,6 +331,10 @@ bool MprControllerItemBase::Impl::initialize(ControllerIO* io)
             otherProgramMap.insert(make_pair(item->name(), program));
         }
     }
+
+    if(isTagTraceIkPrecomputationEnabled){
+        applyTagTraceIkPrecomputation();
+    }
     
     if(!self->initializeVariables()){
         mv->putln(format(_("Variables for {} cannot be initialized."), self->displayName()),
@@ -364,6 +379,42 @@ bool MprControllerItemBase::Impl::createKinematicsKitForControl()
 }
 
 
+/**
+   The inverse kinematics of the tag trace statements is solved for the original statements
+   so that the results are cached in them and reused in the following simulations as long as
+   the tag groups and the body are not changed.
+*/
+void MprControllerItemBase::Impl::precomputeTagTraceIk(ItemList<MprProgramItemBase>& programItems)
+{
+    auto orgKinematicsKit = startupProgramItem->kinematicsKit();
+    if(!orgKinematicsKit || !orgKinematicsKit->jointPath()){
+        return;
+    }
+    for(auto& programItem : programItems){
+        programItem->program()->traverseStatements(
+            [&](MprStatement* statement){
+                if(auto tagTrace = dynamic_cast<MprTagTraceStatement*>(statement)){
+                    tagTrace->updateJointDisplacementCache(orgKinematicsKit);
+                }
+            });
+    }
+}
+
+
+void MprControllerItemBase::Impl::applyTagTraceIkPrecomputation()
+{
+    auto apply = [&](MprStatement* statement){
+        if(auto tagTrace = dynamic_cast<MprTagTraceStatement*>(statement)){
+            tagTrace->replaceIkPositionsWithJointDisplacementCache(kinematicsKit);
+        }
+    };
+    startupProgram->traverseStatements(apply);
+    for(auto& kv : otherProgramMap){
+        kv.second->traverseStatements(apply);
+    }
+}
+
+
 bool MprControllerItemBase::initializeVariables()
 {
     return impl->initializeDefaultVariableMappings();
@@ -1267,12 +1318,15 @@ bool MprControllerItemBase::Impl::interpretDelayStatement(MprDelayStatement* sta
 void MprControllerItemBase::doPutProperties(PutPropertyFunction& putProperty)
 {
     putProperty(_("Speed ratio"), impl->speedRatio, changeProperty(impl->speedRatio));
+    putProperty(_("Tag trace IK precomputation"), impl->isTagTraceIkPrecomputationEnabled,
+                changeProperty(impl->isTagTraceIkPrecomputationEnabled));
 }
 
 
 bool MprControllerItemBase::store(Archive& archive)
 {
     archive.write("speed_ratio", impl->speedRatio);
+    archive.write("tag_trace_ik_precomputation", impl->isTagTraceIkPrecomputationEnabled);
     return true;
 }
     
@@ -1282,6 +1336,7 @@ bool MprControllerItemBase::restore(const Archive& archive)
     if(!archive.read("speed_ratio", impl->speedRatio)){
         archive.read("speedRatio", impl->speedRatio); // old
     }
+    archive.read("tag_trace_ik_precomputation", impl->isTagTraceIkPrecomputationEnabled);
     return true;
 }
 
@@ -424,12 +424,16 @@ void PositionListModel::addPosition(int row, MprPosition* position, bool doInser
 void PositionListModel::removePositions(QModelIndexList selected)
 {
     if(positionList){
-        std::sort(selected.begin(), selected.end());
-        int numRemoved = 0;
+        // Removing the positions from the back does not change the indices of the remaining ones
+        std::sort(selected.begin(), selected.end(),
+                  [](const QModelIndex& index1, const QModelIndex& index2){ return index1.row() > index2.row(); });
+        int prevRow = -1;
         for(auto& index : selected){
-            int positionIndex = index.row() - numRemoved;
-            positionList->removeAt(positionIndex);
-            ++numRemoved;
+            int row = index.row();
+            if(row != prevRow){
+                positionList->removeAt(row);
+                prevRow = row;
+            }
         }
     }
 }
@@ -632,6 +636,8 @@ MprPositionListView::Impl::Impl(MprPositionListView* self)
     hheader->setSectionResizeMode(NoteColumn, QHeaderView::Stretch);
     hheader->setSectionResizeMode(PositionColumn, QHeaderView::ResizeToContents);
     hheader->setSectionResizeMode(JointSpaceCheckColumn, QHeaderView::ResizeToContents);
+    // Only the visible rows are used to fit the columns to the contents
+    hheader->setResizeContentsPrecision(0);
     verticalHeader()->hide();
 
     connect(this, &QTableView::pressed,
@@ -644,6 +644,8 @@ void MprProgramViewBase::Impl::setupWidgets()
     setDropIndicatorShown(true);
     setTabKeyNavigation(true);
     setAllColumnsShowFocus(true);
+    // The row height is not computed for each statement item
+    setUniformRowHeights(true);
     //setAlternatingRowColors(true);
     setEditTriggers(
         QAbstractItemView::DoubleClicked |
@@ -669,6 +671,8 @@ void MprProgramViewBase::Impl::setupWidgets()
     rheader.setSectionResizeMode(1, QHeaderView::ResizeToContents);
     rheader.setSectionResizeMode(2, QHeaderView::ResizeToContents);
     rheader.setSectionResizeMode(3, QHeaderView::Stretch);
+    // Only the visible rows are used to fit the columns to the contents
+    rheader.setResizeContentsPrecision(0);
     sigSectionResized().connect([&](int, int, int){ updateGeometry(); });
 
     sigItemSelectionChanged().connect([&](){ onItemSelectionChanged(); });
@@ -965,9 +969,17 @@ void MprProgramViewBase::Impl::addStatementsToTree
             parentItem->addChild(new StatementItem(dummyStatement, nullptr, this));
         }
     } else {
+        // The items are added at once so that the row insertion is notified only once
+        QList<QTreeWidgetItem*> statementItems;
+        statementItems.reserve(program->numStatements());
         for(auto& statement : *program){
-            auto statementItem = new StatementItem(statement, program, this);
-            parentItem->addChild(statementItem);
+            statementItems.append(new StatementItem(statement, program, this));
+        }
+        parentItem->addChildren(statementItems);
+
+        int index = 0;
+        for(auto& statement : *program){
+            auto statementItem = statementItems[index++];
             if(auto structured = dynamic_cast<MprStructuredStatement*>(statement.get())){
                 if(auto lowerLevelProgram = structured->lowerLevelProgram()){
                     addStatementsToTree(
@@ -4,17 +4,98 @@
 #include "MprPositionList.h"
 #include "MprStatementRegistration.h"
 #include <cnoid/LinkKinematicsKit>
+#include <cnoid/JointPath>
+#include <cnoid/Body>
+#include <cnoid/ThreadPool>
 #include <cnoid/ValueTree>
 #include <cnoid/EigenArchive>
 #include <cnoid/EigenUtil>
 #include <cnoid/CloneMap>
 #include <fmt/format.h>
+#include <thread>
+#include <atomic>
 #include "gettext.h"
 
 using namespace std;
 using namespace cnoid;
 using fmt::format;
 
+namespace {
+
+void collectIkPositions(MprProgram* program, vector<MprIkPosition*>& out_positions)
+{
+    out_positions.clear();
+    for(auto& statement : *program){
+        if(auto positionStatement = dynamic_cast<MprPositionStatement*>(statement.get())){
+            if(auto position = positionStatement->position()){
+                if(auto ikPosition = position->ikPosition()){
+                    out_positions.push_back(ikPosition);
+                }
+            }
+        }
+    }
+}
+
+
+void appendPosition(const Isometry3& T, vector<double>& out_signature)
+{
+    auto& M = T.matrix();
+    for(int i=0; i < 3; ++i){
+        for(int j=0; j < 4; ++j){
+            out_signature.push_back(M(i, j));
+        }
+    }
+}
+
+
+/**
+   The signature consists of the values that affect the solutions of the inverse kinematics,
+   which are the structure and the current state of the joint path used as the initial values.
+*/
+bool getBodySignature(LinkKinematicsKit* kinematicsKit, vector<double>& out_signature)
+{
+    out_signature.clear();
+    auto path = kinematicsKit->jointPath();
+    if(!path || path->numJoints() > MprPosition::MaxNumJoints){
+        return false;
+    }
+    auto body = kinematicsKit->body();
+    out_signature.push_back(body->numLinks());
+    out_signature.push_back(path->baseLink()->index());
+    out_signature.push_back(path->endLink()->index());
+    appendPosition(body->rootLink()->T(), out_signature);
+    for(auto& joint : path->joints()){
+        out_signature.push_back(joint->index());
+        out_signature.push_back(joint->q());
+        appendPosition(joint->Tb(), out_signature);
+    }
+    return true;
+}
+
+
+bool isSameIkPosition(const MprIkPosition* position1, const MprIkPosition* position2)
+{
+    return position1->id() == position2->id() &&
+        position1->position().matrix() == position2->position().matrix() &&
+        position1->baseFrameId() == position2->baseFrameId() &&
+        position1->offsetFrameId() == position2->offsetFrameId() &&
+        position1->configuration() == position2->configuration();
+}
+
+}
+
+namespace cnoid {
+
+struct MprTagTraceStatement::JointDisplacementCache
+{
+    vector<double> bodySignature;
+    vector<MprIkPositionPtr> ikPositions;
+    // The element is null when the inverse kinematics of the corresponding position is not solved
+    vector<MprFkPositionPtr> fkPositions;
+};
+
+}
+
 
 MprTagTraceStatement::MprTagTraceStatement()
     : T_tags(Isometry3::Identity()),
@@ -32,7 +113,8 @@ MprTagTraceStatement::MprTagTraceStatement(const MprTagTraceStatement& org, Clon
       tagGroupName_(org.tagGroupName_),
       T_tags(org.T_tags),
       baseFrameId_(org.baseFrameId_),
-      offsetFrameId_(org.offsetFrameId_)
+      offsetFrameId_(org.offsetFrameId_),
+      jointDisplacementCache(org.jointDisplacementCache)
 {
     auto program = lowerLevelProgram();
     program->setLocalPositionListEnabled(true);
@@ -65,6 +147,7 @@ void MprTagTraceStatement::setTagGroup
     if(tags != tagGroup_){
         tagGroupConnections.disconnect();
         tagGroup_ = tags;
+        jointDisplacementCache.reset();
         if(doUpdateTagGroupName){
             if(tags){
                 tagGroupName_ = tags->name();
@@ -189,6 +272,123 @@ bool MprTagTraceStatement::decomposeIntoTagTraceStatements()
 }
 
 
+bool MprTagTraceStatement::updateJointDisplacementCache(LinkKinematicsKit* kinematicsKit, int numThreads)
+{
+    vector<MprIkPosition*> ikPositions;
+    collectIkPositions(lowerLevelProgram(), ikPositions);
+    vector<double> bodySignature;
+    if(!getBodySignature(kinematicsKit, bodySignature)){
+        return false;
+    }
+    if(checkJointDisplacementCache(ikPositions, bodySignature)){
+        return true;
+    }
+
+    auto cache = make_shared<JointDisplacementCache>();
+    cache->bodySignature = bodySignature;
+    const int n = ikPositions.size();
+    cache->ikPositions.resize(n);
+    cache->fkPositions.resize(n);
+    for(int i=0; i < n; ++i){
+        cache->ikPositions[i] = static_cast<MprIkPosition*>(ikPositions[i]->clone());
+    }
+
+    if(numThreads <= 0){
+        numThreads = std::thread::hardware_concurrency();
+    }
+    numThreads = std::max(1, std::min(numThreads, n));
+
+    /*
+      Each thread has its own copy of the kinematics kit and solves the positions of its range
+      sequentially so that the solution of a position is used as the initial value of the next
+      position as well as in executing the program.
+    */
+    vector<LinkKinematicsKitPtr> kits(numThreads);
+    for(auto& kit : kits){
+        CloneMap cloneMap;
+        kit = cloneMap.getClone(kinematicsKit);
+    }
+    std::atomic<int> numSolved(0);
+    auto solve = [&](int threadIndex){
+        auto kit = kits[threadIndex];
+        const int begin = n * threadIndex / numThreads;
+        const int end = n * (threadIndex + 1) / numThreads;
+        for(int i = begin; i < end; ++i){
+            auto ikPosition = cache->ikPositions[i];
+            if(ikPosition->apply(kit)){
+                MprFkPositionPtr fkPosition = new MprFkPosition(ikPosition->id());
+                fkPosition->fetch(kit);
+                cache->fkPositions[i] = fkPosition;
+                ++numSolved;
+            }
+        }
+    };
+    if(numThreads == 1){
+        solve(0);
+    } else {
+        ThreadPool threadPool(numThreads);
+        for(int i=0; i < numThreads; ++i){
+            threadPool.start([&solve, i](){ solve(i); });
+        }
+        threadPool.wait();
+    }
+
+    jointDisplacementCache = cache;
+
+    return numSolved == n;
+}
+
+
+bool MprTagTraceStatement::checkJointDisplacementCache
+(const std::vector<MprIkPosition*>& ikPositions, const std::vector<double>& bodySignature) const
+{
+    auto& cache = jointDisplacementCache;
+    if(!cache || cache->bodySignature != bodySignature){
+        return false;
+    }
+    const int n = ikPositions.size();
+    if(static_cast<int>(cache->ikPositions.size()) != n){
+        return false;
+    }
+    for(int i=0; i < n; ++i){
+        if(!isSameIkPosition(ikPositions[i], cache->ikPositions[i])){
+            return false;
+        }
+    }
+    return true;
+}
+
+
+bool MprTagTraceStatement::hasValidJointDisplacementCache(LinkKinematicsKit* kinematicsKit)
+{
+    vector<MprIkPosition*> ikPositions;
+    collectIkPositions(lowerLevelProgram(), ikPositions);
+    vector<double> bodySignature;
+    if(!getBodySignature(kinematicsKit, bodySignature)){
+        return false;
+    }
+    return checkJointDisplacementCache(ikPositions, bodySignature);
+}
+
+
+int MprTagTraceStatement::replaceIkPositionsWithJointDisplacementCache(LinkKinematicsKit* kinematicsKit)
+{
+    if(!hasValidJointDisplacementCache(kinematicsKit)){
+        return 0;
+    }
+    int numReplaced = 0;
+    auto positions = lowerLevelProgram()->positionList();
+    for(auto& fkPosition : jointDisplacementCache->fkPositions){
+        if(fkPosition){
+            int index = positions->indexOf(positions->findPosition(fkPosition->id()));
+            if(index >= 0 && positions->replace(index, fkPosition->clone())){
+                ++numReplaced;
+            }
+        }
+    }
+    return numReplaced;
+}
+
 
 bool MprTagTraceStatement::read(MprProgram* program, const Mapping& archive)
 {
@@ -6,11 +6,13 @@
 #include <cnoid/GeneralId>
 #include <cnoid/PositionTagGroup>
 #include <cnoid/ConnectionSet>
+#include <memory>
 #include "exportdecl.h"
 
 namespace cnoid {
 
 class LinkKinematicsKit;
+class MprIkPosition;
 
 class CNOID_EXPORT MprTagTraceStatement : public MprStructuredStatement
 {
@@ -45,6 +47,27 @@ public:
 
     virtual bool updateTagTraceProgram() = 0;
     bool decomposeIntoTagTraceStatements();
+
+    /**
+       Solves the inverse kinematics of the IK positions in the tag trace program in advance
+       and caches the resulting joint displacements. The positions are divided into continuous
+       ranges solved in parallel, and the cache is kept until the positions of the tag trace
+       program or the body state used to solve them is changed.
+       \param numThreads Zero means the number of the hardware threads.
+       eturn true if all the positions are solved.
+    */
+    bool updateJointDisplacementCache(LinkKinematicsKit* kinematicsKit, int numThreads = 0);
+
+    bool hasValidJointDisplacementCache(LinkKinematicsKit* kinematicsKit);
+
+    /**
+       Replaces the IK positions of the tag trace program with the FK positions of the cached
+       joint displacements so that the inverse kinematics is not solved in executing the program.
+       This function is supposed to be used for the statement cloned for the control, which
+       shares the cache with the original statement.
+       eturn The number of the replaced positions
+    */
+    int replaceIkPositionsWithJointDisplacementCache(LinkKinematicsKit* kinematicsKit);
     
     virtual bool isExpandedByDefault() const override;
     virtual bool read(MprProgram* program, const Mapping& archive) override;
@@ -66,7 +89,12 @@ private:
     GeneralId offsetFrameId_;
     ScopedConnectionSet tagGroupConnections;
 
+    struct JointDisplacementCache;
+    std::shared_ptr<const JointDisplacementCache> jointDisplacementCache;
+
     void connectTagGroupUpdateSignals();
+    bool checkJointDisplacementCache(
+        const std::vector<MprIkPosition*>& ikPositions, const std::vector<double>& bodySignature) const;
 };
 
 typedef ref_ptr<MprTagTraceStatement> MprTagTraceStatementPtr;
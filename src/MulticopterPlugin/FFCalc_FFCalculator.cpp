@@ -169,6 +169,111 @@ void FFCalculator::calcSurfaceGeneral(LinkForce* pLinkForceN, LinkForce* pLinkFo
     return;
 }
 
+void FFCalculator::calcSurfaceGeneral(LinkForce* pLinkForce, SurfaceQuadrature& quadrature)
+{
+
+    const int numIP = quadrature.size();
+    if (numIP == 0)
+        return;
+
+    SurfaceQuadrature::Workspace& w = quadrature.workspace;
+
+    const Matrix3 R = _linkState.trans().linear();
+    const Vector3 p = _linkState.trans().translation();
+
+    w.gx = R(0,0) * quadrature.x + R(0,1) * quadrature.y + R(0,2) * quadrature.z + p.x();
+    w.gy = R(1,0) * quadrature.x + R(1,1) * quadrature.y + R(1,2) * quadrature.z + p.y();
+    w.gz = R(2,0) * quadrature.x + R(2,1) * quadrature.y + R(2,2) * quadrature.z + p.z();
+    w.gnx = R(0,0) * quadrature.nx + R(0,1) * quadrature.ny + R(0,2) * quadrature.nz;
+    w.gny = R(1,0) * quadrature.nx + R(1,1) * quadrature.ny + R(1,2) * quadrature.nz;
+    w.gnz = R(2,0) * quadrature.nx + R(2,1) * quadrature.ny + R(2,2) * quadrature.nz;
+
+    // The fluid values at the points where the fluid does not exist are set to zero
+    if (_fluidEnv.isNull())
+    {
+        if (_fluidEnvAll.isFluid == false)
+            return;
+        w.density.setConstant (_fluidEnvAll.density);
+        w.viscosity.setConstant (_fluidEnvAll.viscosity);
+        w.vx.setConstant (_fluidEnvAll.velocity.x());
+        w.vy.setConstant (_fluidEnvAll.velocity.y());
+        w.vz.setConstant (_fluidEnvAll.velocity.z());
+    }
+    else
+    {
+        for (int i=0; i<numIP; ++i)
+        {
+            FluidEnvironment::FluidValue fluid;
+            bool inBounds = _fluidEnv.get (Vector3(w.gx[i], w.gy[i], w.gz[i]), fluid);
+            if (inBounds==false && _fluidEnvAll.isFluid == true)
+                fluid = _fluidEnvAll;
+            else if (inBounds==false || fluid.isFluid == false)
+                fluid.density = fluid.viscosity = 0.0;
+
+            w.density[i] = fluid.density;
+            w.viscosity[i] = fluid.viscosity;
+            if (fluid.density > 0.0)
+            {
+                w.vx[i] = fluid.velocity.x();
+                w.vy[i] = fluid.velocity.y();
+                w.vz[i] = fluid.velocity.z();
+            }
+            else
+            {
+                w.vx[i] = w.vy[i] = w.vz[i] = 0.0;
+            }
+        }
+    }
+
+    // Relative velocity of the fluid
+    const Vector3 v0 = _linkState.translationalVelocityAt (Vector3::Zero());
+    const Vector3& omega = _linkState.rotationalVelocity();
+    w.vx -= v0.x() + omega.y() * w.gz - omega.z() * w.gy;
+    w.vy -= v0.y() + omega.z() * w.gx - omega.x() * w.gz;
+    w.vz -= v0.z() + omega.x() * w.gy - omega.y() * w.gx;
+
+    // Decomposition into the component toward the surface and the component along the surface
+    w.velPerp = -(w.vx * w.gnx + w.vy * w.gny + w.vz * w.gnz);
+    w.vx += w.gnx * w.velPerp;
+    w.vy += w.gny * w.velPerp;
+    w.vz += w.gnz * w.velPerp;
+    w.velPara = (w.vx.square() + w.vy.square() + w.vz.square()).sqrt();
+
+    const auto isFluid = w.density > 0.0;
+
+    w.pressureCoef =
+        (isFluid && w.velPerp > TINY_VELOCITY).select(
+            quadrature.coef * 0.5 * w.density * w.velPerp.square(), 0.0);
+
+    // The tangential force divided by the parallel velocity, which is multiplied by the parallel velocity vector
+    const double repLength = std::pow (_linkVolume, 1.0/3.0);
+    const auto coefReynolds = w.density * w.velPara * repLength / w.viscosity;
+    const auto laminarForce = 0.664 * (w.viscosity * w.density * w.velPara / repLength).sqrt();
+    const auto coefResistTurbulent =
+        0.455 / coefReynolds.log10().pow(2.58) - 1700.0 / coefReynolds;
+    const auto coefResist =
+        (coefReynolds < 6.0e5).select(coefResistTurbulent.max(1.328 / coefReynolds.sqrt()), coefResistTurbulent);
+    const auto turbulentForce = coefResist * 0.5 * w.density * w.velPara;
+    w.tangentCoef =
+        (isFluid && w.velPara > TINY_VELOCITY).select(
+            quadrature.coef * (coefReynolds < 4.0e5).select(laminarForce, turbulentForce), 0.0);
+
+    w.fx = w.tangentCoef * w.vx - w.pressureCoef * w.gnx;
+    w.fy = w.tangentCoef * w.vy - w.pressureCoef * w.gny;
+    w.fz = w.tangentCoef * w.vz - w.pressureCoef * w.gnz;
+
+    const Vector3 force (w.fx.sum(), w.fy.sum(), w.fz.sum());
+    const Vector3 momentAtOrigin (
+        (w.gy * w.fz - w.gz * w.fy).sum(),
+        (w.gz * w.fx - w.gx * w.fz).sum(),
+        (w.gx * w.fy - w.gy * w.fx).sum());
+
+    pLinkForce->addForce (force, pLinkForce->point());
+    pLinkForce->addMoment (momentAtOrigin - pLinkForce->point().cross(force));
+
+    return;
+}
+
 void FFCalculator::calcGravity_forDebug (LinkForce* pLinkForce)
 {
 
@@ -53,6 +53,13 @@ public:
 
     void calcSurfaceGeneral (LinkForce* pLinkForceN, LinkForce* pLinkForceT,int);
 
+    /**
+       This function gives the same forces as calcSurfaceGeneral using the precomputed quadrature
+       table of the link. The workspace of the table is used, so the table must not be shared
+       between threads.
+    */
+    void calcSurfaceGeneral (LinkForce* pLinkForce, SurfaceQuadrature& quadrature);
+
     void calcGravity_forDebug (LinkForce* pLinkForce);
 
 private:
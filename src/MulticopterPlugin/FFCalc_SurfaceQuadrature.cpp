@@ -0,0 +1,61 @@
+/**
+   @author Japan Atomic Energy Agency
+*/
+
+#include "MulticopterPluginHeader.h"
+
+namespace Multicopter {
+namespace FFCalc {
+
+void SurfaceQuadrature::build (const std::vector<LinkTriangleAttribute>& triAttrAry, int degreeNumber)
+{
+    const int numIP = degreeNumber;
+
+    std::vector<Vector3> points;
+    std::vector<Vector3> normals;
+    std::vector<double> coefs;
+    points.reserve(triAttrAry.size() * numIP);
+    normals.reserve(triAttrAry.size() * numIP);
+    coefs.reserve(triAttrAry.size() * numIP);
+
+    for (const auto& triAttr : triAttrAry)
+    {
+        const GaussTriangle3d tri (triAttr.triangle());
+        if (!(tri.area() > 0.0))
+            continue;
+
+        for (int iIP=0; iIP<numIP; ++iIP)
+        {
+            const double cutCoef = triAttr.cutoffCoefficient(iIP);
+            if (cutCoef < 1.0e-12)
+                continue;
+
+            points.push_back (tri.getGaussPoint(iIP,numIP));
+            normals.push_back (tri.normal());
+            coefs.push_back (cutCoef * tri.getGaussWeight(iIP,numIP) * tri.area());
+        }
+    }
+
+    const int n = static_cast<int>(coefs.size());
+    x.resize(n);  y.resize(n);  z.resize(n);
+    nx.resize(n); ny.resize(n); nz.resize(n);
+    coef.resize(n);
+    for (int i=0; i<n; ++i)
+    {
+        x[i]  = points[i].x();  y[i]  = points[i].y();  z[i]  = points[i].z();
+        nx[i] = normals[i].x(); ny[i] = normals[i].y(); nz[i] = normals[i].z();
+        coef[i] = coefs[i];
+    }
+
+    Workspace& w = workspace;
+    for (auto array : { &w.gx, &w.gy, &w.gz, &w.gnx, &w.gny, &w.gnz, &w.density, &w.viscosity,
+                        &w.vx, &w.vy, &w.vz, &w.velPerp, &w.velPara, &w.pressureCoef, &w.tangentCoef,
+                        &w.fx, &w.fy, &w.fz })
+    {
+        array->resize(n);
+    }
+
+    return;
+}
+
+}}
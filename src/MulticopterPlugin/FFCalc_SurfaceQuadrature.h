@@ -0,0 +1,57 @@
+/**
+   @author Japan Atomic Energy Agency
+*/
+
+#pragma once
+#include "FFCalc_Common.h"
+
+#include <vector>
+
+namespace Multicopter {
+
+class LinkTriangleAttribute;
+
+namespace FFCalc {
+
+/**
+   Gauss quadrature points of the surface triangles of a link in the link local coordinate.
+   The values are stored in the structure-of-arrays layout so that the fluid forces of all the
+   points can be evaluated by the vectorized array operations of Eigen.
+*/
+class SurfaceQuadrature
+{
+public:
+
+    // Point positions and the normals of the triangles in the link local coordinate
+    Eigen::ArrayXd x, y, z;
+    Eigen::ArrayXd nx, ny, nz;
+
+    // Product of the Gauss weight, the triangle area and the cutoff coefficient
+    Eigen::ArrayXd coef;
+
+    // Buffers used in the force calculation, which must not be shared between threads
+    struct Workspace
+    {
+        Eigen::ArrayXd gx, gy, gz;
+        Eigen::ArrayXd gnx, gny, gnz;
+        Eigen::ArrayXd density, viscosity;
+        Eigen::ArrayXd vx, vy, vz;
+        Eigen::ArrayXd velPerp, velPara;
+        Eigen::ArrayXd pressureCoef, tangentCoef;
+        Eigen::ArrayXd fx, fy, fz;
+    };
+    Workspace workspace;
+
+    /**
+       The points whose cutoff coefficients are almost zero are not stored because
+       they do not contribute to the forces.
+    */
+    void build (const std::vector<LinkTriangleAttribute>& triAttrAry, int degreeNumber);
+
+    int size() const
+    {
+        return static_cast<int>(coef.size());
+    }
+};
+
+}}
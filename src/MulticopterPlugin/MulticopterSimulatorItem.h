@@ -51,6 +51,7 @@ private:
     bool _groundEffect;
     bool _outputParam;
     double _timeStep;
+    int _numThreads;
 
     SimulatorItem* _curSimItem;
 };
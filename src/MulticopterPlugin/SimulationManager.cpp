@@ -96,6 +96,7 @@ SimulationManager::SimulationManager()
     _logIntrvSim=_logIntrv=0.001;
 
     _effectLinkBodyMapSize=0;
+    _numThreads=1;
 
 }
 
@@ -152,6 +153,8 @@ SimulationManager::initializeSimulation(SimulatorItem* simItem, MulticopterSimul
 
     calculateSurfaceCuttoffCoefficient(_fluidLinkBodyMap,_linkPolygonMap);
 
+    updateLinkSurfaceQuadrature();
+
     double curTime = simItem->currentTime();
     _nextLogTime         = curTime;
 
@@ -309,6 +312,77 @@ void
 SimulationManager::clearLinkPolygon()
 {
     _linkPolygonMap.clear();
+    _linkSurfaceAry.clear();
+    _linkSurfaceIndexMap.clear();
+    _threadPool.reset();
+}
+
+void
+SimulationManager::updateLinkSurfaceQuadrature()
+{
+    _linkSurfaceAry.clear();
+    _linkSurfaceIndexMap.clear();
+
+    for(auto& linkPolygon : _linkPolygonMap){
+        Link* link = linkPolygon.first;
+        const LinkAttribute& linkAttr = get<1>(_fluidLinkBodyMap[link]);
+        if( linkAttr.isNull() == true || linkAttr.linkForceApplyFlgAry()[3] == false ){
+            continue;
+        }
+        _linkSurfaceIndexMap[link] = _linkSurfaceAry.size();
+        _linkSurfaceAry.emplace_back(link);
+        _linkSurfaceAry.back().quadrature.build(linkPolygon.second, getDegreeNumber());
+    }
+
+    const int numThreads = std::min(_numThreads, static_cast<int>(_linkSurfaceAry.size()));
+    if( numThreads >= 2 ){
+        if( !_threadPool || _threadPool->size() != numThreads ){
+            _threadPool.reset(new ThreadPool(numThreads));
+        }
+    }
+    else{
+        _threadPool.reset();
+    }
+}
+
+/**
+   The surface forces of the links are calculated in advance because they are independent of each
+   other and take most of the time of the fluid force calculation. The links are distributed to the
+   threads of the pool when the number of threads is more than one.
+*/
+void
+SimulationManager::calcLinkSurfaceForces()
+{
+    const FluidEnvironment& fluidEnv = *fluidEnvironmentSim();
+
+    auto calcLinkSurfaceForce = [&](LinkSurface& surface){
+        Link& link = *surface.link;
+        const LinkAttribute& linkAttr = get<1>(_fluidLinkBodyMap.find(&link)->second);
+        const FFCalc::LinkState& linkState = *_linkStateMap.find(&link)->second;
+        FFCalc::FFCalculator ffc (_gravity, fluidEnv, _fluEnvAllSim, link, linkAttr, linkState, _linkPolygonMap.find(&link)->second);
+        surface.force = FFCalc::LinkForce(Vector3::Zero());
+        ffc.calcSurfaceGeneral(&surface.force, surface.quadrature);
+    };
+
+    const int numLinks = _linkSurfaceAry.size();
+
+    if( !_threadPool ){
+        for(auto& surface : _linkSurfaceAry){
+            calcLinkSurfaceForce(surface);
+        }
+        return;
+    }
+
+    const int numThreads = _threadPool->size();
+    for(int i=0 ; i<numThreads ; ++i){
+        _threadPool->start(
+            [this, i, numThreads, numLinks, &calcLinkSurfaceForce](){
+                for(int j=i ; j<numLinks ; j+=numThreads){
+                    calcLinkSurfaceForce(_linkSurfaceAry[j]);
+                }
+            });
+    }
+    _threadPool->wait();
 }
 
 void
@@ -520,6 +594,15 @@ SimulationManager::midDynamicFunction(SimulatorItem* simItem, MulticopterSimulat
     _rotorOutValAry.clear();
     _linkOutValAry.clear();
 
+    for(auto itb = begin(_bodyLinkMap) ; itb != end(_bodyLinkMap) ; ++itb){
+        std::vector<cnoid::Link*>& linkAry = itb->second;
+        for(auto itl = begin(linkAry) ; itl != end(linkAry) ; ++itl){
+            _linkStateMap[*itl]->update (simItem->currentTime(), **itl);
+        }
+    }
+
+    calcLinkSurfaceForces();
+
     for(auto itb = begin(_bodyLinkMap) ; itb != end(_bodyLinkMap) ; ++itb){
         std::map<int,std::tuple<double,Vector3>> effectMap;
         bool calFlag=false;
@@ -557,7 +640,6 @@ SimulationManager::midDynamicFunction(SimulatorItem* simItem, MulticopterSimulat
             try{
                 FFCalc::LinkStatePtr pLinkState;
                 pLinkState = _linkStateMap[*itl];
-                pLinkState->update (simItem->currentTime(), **itl);
 
                 std::unique_ptr<FFCalc::LinkForce> pLinkForce = midDynamicFunctionLink (
                     simItem, multicopterSimItem, **itl, *pLinkState,effectMap,calFlag);
@@ -620,7 +702,13 @@ std::unique_ptr<FFCalc::LinkForce> SimulationManager::midDynamicFunctionLink (
         FFCalc::LinkForce lfGenSurface(pLinkForce->point());
 
         if(linkForceApplyTarget[3] == true){
-            ffc.calcSurfaceGeneral (&lfGenSurface, &lfGenSurface,getDegreeNumber());
+            auto it = _linkSurfaceIndexMap.find(&link);
+            if(it != _linkSurfaceIndexMap.end()){
+                lfGenSurface.add(_linkSurfaceAry[it->second].force);
+            }
+            else{
+                ffc.calcSurfaceGeneral (&lfGenSurface, &lfGenSurface,getDegreeNumber());
+            }
             lfSurface.add(lfGenSurface);
         }
         pLinkForce->add(lfSurface);
@@ -847,6 +935,11 @@ SimulationManager::targetRotorDevices(cnoid::Link* link) const
 }
 
 
+void SimulationManager::setNumThreads(int numThreads)
+{
+    _numThreads = std::max(numThreads, 1);
+}
+
 void SimulationManager::setGroundEffect(bool groundEffect)
 {
     _groundEffect = groundEffect;
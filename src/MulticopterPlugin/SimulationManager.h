@@ -54,6 +54,7 @@ public:
     void setFluidVelocity(const cnoid::Vector3 &fluidVelocity);
     void setWallEffect(bool wallEffect);
     void setGroundEffect(bool groundEffect);
+    void setNumThreads(int numThreads);
     bool isLogEnabled() const;
     void setLogEnabled(bool flg);
     void setLogInterval(double sec);
@@ -108,6 +109,10 @@ protected:
 
     void clearLinkPolygon();
 
+    void updateLinkSurfaceQuadrature();
+
+    void calcLinkSurfaceForces();
+
     void updateLinkState(double time);
 
     void clearLinkState();
@@ -158,6 +163,17 @@ private:
     std::map<cnoid::Link*, std::vector<LinkTriangleAttribute>>_linkPolygonMap;
     std::map<const cnoid::Link*, FFCalc::LinkStatePtr> _linkStateMap;
 
+    struct LinkSurface
+    {
+        cnoid::Link* link;
+        FFCalc::SurfaceQuadrature quadrature;
+        FFCalc::LinkForce force;
+        LinkSurface(cnoid::Link* link) : link(link), force(Eigen::Vector3d::Zero()) { }
+    };
+    std::vector<LinkSurface> _linkSurfaceAry;
+    std::map<const cnoid::Link*, int> _linkSurfaceIndexMap;
+    std::unique_ptr<cnoid::ThreadPool> _threadPool;
+
     std::list<RotorOutValue> _rotorOutValAry;
     std::list<FluidOutValue> _linkOutValAry;
     
@@ -183,6 +199,7 @@ private:
 
     int _effectLinkBodyMapSize;
     int _degree;
+    int _numThreads;
 
     MulticopterMonitorView* _multicopterMonitorView;
     cnoid::AISTCollisionDetectorPtr _collisionDetector;
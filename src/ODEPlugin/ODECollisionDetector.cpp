@@ -9,6 +9,8 @@
 #include <cnoid/SceneDrawables>
 #include <cnoid/EigenUtil>
 #include <cnoid/IdPair>
+#include <unordered_set>
+#include <algorithm>
 
 #ifdef GAZEBO_ODE
 #include <gazebo/ode/ode.h>
@@ -24,6 +26,16 @@ namespace {
 typedef CollisionDetector::GeometryHandle GeometryHandle;
 typedef IdPair<dSpaceID> SpaceIdPair;
 
+/*
+  The static geometries are given the category which is not included in their collide bits
+  so that the broadphase of the hash space does not produce the pairs of them.
+*/
+const unsigned long DynamicCategoryBit = 1;
+const unsigned long StaticCategoryBit = 2;
+
+// The thickness of the solid below the lowest point of a heightfield
+const double HeightfieldThickness = 1.0;
+
 struct FactoryRegistration
 {
     FactoryRegistration(){
@@ -43,6 +55,7 @@ struct PrimitiveInfo
 class GeometryInfo : public Referenced
 {
 public :
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
     GeometryInfo();
     ~GeometryInfo();
     GeometryHandle geometryHandle;
@@ -51,7 +64,11 @@ public :
     vector<PrimitiveInfo, Eigen::aligned_allocator<PrimitiveInfo>> primitives;
     dGeomID meshGeomID;
     dTriMeshDataID triMeshDataID;
+    vector<dHeightfieldDataID> heightfieldDataIDs;
+    vector<shared_ptr<const SgMesh::HeightField>> heightFields;
     bool isStatic;
+    bool isPositionValid;
+    Isometry3 position;
 };
 typedef ref_ptr<GeometryInfo> GeometryInfoPtr;
 
@@ -62,6 +79,7 @@ GeometryInfo::GeometryInfo()
     meshGeomID = 0;
     triMeshDataID = 0;
     isStatic = false;
+    isPositionValid = false;
 }
 
 GeometryInfo::~GeometryInfo()
@@ -75,6 +93,9 @@ GeometryInfo::~GeometryInfo()
     if(triMeshDataID){
         dGeomTriMeshDataDestroy(triMeshDataID);
     }
+    for(auto& dataID : heightfieldDataIDs){
+        dGeomHeightfieldDataDestroy(dataID);
+    }
     if(spaceID){
         dSpaceDestroy(spaceID);
     }
@@ -90,7 +111,7 @@ public:
     dSpaceID spaceID;
     vector<GeometryInfoPtr> geometryInfos;
     
-    set<SpaceIdPair> ignoredPairs;
+    unordered_set<SpaceIdPair> ignoredPairs;
     std::function<void(const CollisionPair&)> callbackOnCollisionDetected;
 
     MeshExtractor meshExtractor;
@@ -107,6 +128,7 @@ public:
     void addMesh(GeometryInfo* model);
     void ignoreGeometryPair(GeometryHandle geometry1, GeometryHandle geometry2, bool ignore);
     bool makeReady();
+    void setCategory(GeometryInfo* ginfo);
     void setGeometryPosition(GeometryInfo* ginfo, const Isometry3& position);
     void detectCollisions(std::function<void(const CollisionPair&)> callback);
 };
@@ -208,8 +230,31 @@ void ODECollisionDetectorImpl::addMesh(GeometryInfo* ginfo)
     const Affine3& T = meshExtractor.currentTransform();
 
     bool meshAdded = false;
+
+    if(auto heightField = mesh->sharedHeightField()){
+        if(!meshExtractor.isCurrentScaled()){
+            // The height data is not copied because the data is kept by the geometry info
+            dHeightfieldDataID dataID = dGeomHeightfieldDataCreate();
+            dGeomHeightfieldDataBuildSingle(
+                dataID, &heightField->heights[0], 0, heightField->xSize(), heightField->zSize(),
+                heightField->xDimension, heightField->zDimension, 1.0, 0.0, HeightfieldThickness, 0);
+            auto range = std::minmax_element(heightField->heights.begin(), heightField->heights.end());
+            dGeomHeightfieldDataSetBounds(dataID, *range.first, *range.second);
+            ginfo->heightfieldDataIDs.push_back(dataID);
+            ginfo->heightFields.push_back(heightField);
+
+            PrimitiveInfo pinfo;
+            pinfo.geomId = dCreateHeightfield(ginfo->spaceID, dataID, 1);
+            // The origin of the heightfield is the center of the grid
+            pinfo.localPosition =
+                meshExtractor.currentTransformWithoutScaling() *
+                Translation3(heightField->xSize() / 2.0, 0.0, heightField->zSize() / 2.0);
+            ginfo->primitives.push_back(pinfo);
+            meshAdded = true;
+        }
+    }
     
-    if(mesh->primitiveType() != SgMesh::MESH){
+    if(!meshAdded && mesh->primitiveType() != SgMesh::MESH){
         bool doAddPrimitive = false;
         Vector3 scale;
         bool hasTranslationByScaling = false;
@@ -358,24 +403,53 @@ bool ODECollisionDetector::makeReady()
 
 bool ODECollisionDetectorImpl::makeReady()
 {
-    const int n = geometryInfos.size();
-    for(int i=0; i < n; ++i){
-        if(auto& info1 = geometryInfos[i]){
-            for(int j=i + 1; j < n; ++j){
-                if(auto& info2 = geometryInfos[j]){
-                    if(info1->isStatic && info2->isStatic){
-                        ignoredPairs.insert(SpaceIdPair(info1->spaceID, info2->spaceID));
-                    }
-                }
-            }
+    for(auto& info : geometryInfos){
+        if(info){
+            setCategory(info);
         }
     }
     return true;
 }
 
 
+void ODECollisionDetectorImpl::setCategory(GeometryInfo* ginfo)
+{
+    unsigned long categoryBits;
+    unsigned long collideBits;
+    if(ginfo->isStatic){
+        categoryBits = StaticCategoryBit;
+        collideBits = DynamicCategoryBit;
+    } else {
+        categoryBits = DynamicCategoryBit;
+        collideBits = DynamicCategoryBit | StaticCategoryBit;
+    }
+    dGeomSetCategoryBits((dGeomID)ginfo->spaceID, categoryBits);
+    dGeomSetCollideBits((dGeomID)ginfo->spaceID, collideBits);
+    if(ginfo->meshGeomID){
+        dGeomSetCategoryBits(ginfo->meshGeomID, categoryBits);
+        dGeomSetCollideBits(ginfo->meshGeomID, collideBits);
+    }
+    for(auto& pinfo : ginfo->primitives){
+        dGeomSetCategoryBits(pinfo.geomId, categoryBits);
+        dGeomSetCollideBits(pinfo.geomId, collideBits);
+    }
+}
+
+
+/**
+   The position of a static geometry is not set again when it is not changed because
+   a position change makes the hash space recompute the bounding box of the geometry,
+   which requires all the vertices of a triangle mesh to be transformed.
+*/
 void ODECollisionDetectorImpl::setGeometryPosition(GeometryInfo* ginfo, const Isometry3& position)
 {
+    if(ginfo->isStatic){
+        if(ginfo->isPositionValid && position.matrix() == ginfo->position.matrix()){
+            return;
+        }
+        ginfo->position = position;
+        ginfo->isPositionValid = true;
+    }
     if(ginfo->meshGeomID){
         Vector3 p = position.translation();
         const Isometry3& T = position;
@@ -424,11 +498,10 @@ static void nearCallback(void* data, dGeomID g1, dGeomID g2)
     dSpaceID space1 = dGeomGetSpace(g1);
     dSpaceID space2 = dGeomGetSpace(g2);
     ODECollisionDetectorImpl* impl = static_cast<ODECollisionDetectorImpl*>(data);
-    if(impl->ignoredPairs.find(SpaceIdPair(space1, space2)) != impl->ignoredPairs.end()){
-        return;
-    }
-    if(impl->ignoredPairs.find(SpaceIdPair(space2, space1)) != impl->ignoredPairs.end()){
-        return;
+    if(!impl->ignoredPairs.empty()){
+        if(impl->ignoredPairs.find(SpaceIdPair(space1, space2)) != impl->ignoredPairs.end()){
+            return;
+        }
     }
 
     if(dGeomIsSpace(g1) || dGeomIsSpace(g2)) { 
@@ -453,6 +526,9 @@ static void nearCallback(void* data, dGeomID g1, dGeomID g2)
                 collision.normal[1] = contacts[i].geom.normal[1];
                 collision.normal[2] = contacts[i].geom.normal[2];
                 collision.depth = contacts[i].geom.depth;
+                // The indices of the triangles of the meshes, which are zero for the primitives
+                collision.id1 = std::max(contacts[i].geom.side2, 0);
+                collision.id2 = std::max(contacts[i].geom.side1, 0);
             }
             impl->callbackOnCollisionDetected(collisionPair);
         }
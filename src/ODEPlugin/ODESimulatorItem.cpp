@@ -26,8 +26,12 @@
 #define ITEM_NAME N_("GazeboODESimulatorItem")
 #else
 #include <ode/ode.h>
+#include <ode/threading_impl.h>
 #define ITEM_NAME N_("ODESimulatorItem")
 #endif
+#include <cnoid/MessageView>
+#include <fmt/format.h>
+#include <algorithm>
 #include <iostream>
 
 using namespace std;
@@ -42,6 +46,12 @@ const bool MEASURE_PHYSICS_CALCULATION_TIME = true;
 
 const double DEFAULT_GRAVITY_ACCELERATION = 9.80665;
 
+// The depth of the quadtree space for a static body
+const int QUADTREE_SPACE_DEPTH = 6;
+
+// The thickness of the solid below the lowest point of a heightfield
+const double HEIGHTFIELD_THICKNESS = 1.0;
+
 typedef Eigen::Matrix<float, 3, 1> Vertex;
 
 struct Triangle {
@@ -73,6 +83,24 @@ void flipYZ(dMatrix3& R)
     R[10] = y.z();
 }
 
+dGeomID createHeightfield(dSpaceID spaceID, const SgMesh::HeightField& field, dHeightfieldDataID& out_dataID)
+{
+    out_dataID = dGeomHeightfieldDataCreate();
+    // The height data is not copied because the data is kept by the caller
+    dGeomHeightfieldDataBuildSingle(
+        out_dataID, &field.heights[0], 0, field.xSize(), field.zSize(),
+        field.xDimension, field.zDimension, 1.0, 0.0, HEIGHTFIELD_THICKNESS, 0);
+    auto range = std::minmax_element(field.heights.begin(), field.heights.end());
+    dGeomHeightfieldDataSetBounds(out_dataID, *range.first, *range.second);
+    return dCreateHeightfield(spaceID, out_dataID, 1);
+}
+
+// The origin of an ODE heightfield is the center of the grid, which is this point in the mesh coordinate
+Translation3 getHeightfieldCenter(const SgMesh::HeightField& field)
+{
+    return Translation3(field.xSize() / 2.0, 0.0, field.zSize() / 2.0);
+}
+
 class ODEBody;
 
 class ODELink : public Referenced
@@ -85,6 +113,8 @@ public:
     dTriMeshDataID triMeshDataID;
     vector<Vertex> vertices;
     vector<Triangle> triangles;
+    vector<dHeightfieldDataID> heightfieldDataIDs;
+    vector<shared_ptr<const SgMesh::HeightField>> heightFields;
     typedef map<dGeomID, Isometry3, std::less<dGeomID>, 
                 Eigen::aligned_allocator< pair<const dGeomID, Isometry3>>> OffsetMap;
     OffsetMap offsetMap;
@@ -104,6 +134,7 @@ public:
     void getKinematicStateFromODE();
     void getKinematicStateFromODEflip();
     void addMesh(MeshExtractor* extractor, ODEBody* odeBody, bool doFlipYZ);
+    void addGeometry(dGeomID geomId, const Isometry3& T_, bool doFlipYZ);
 };
 typedef ref_ptr<ODELink> ODELinkPtr;
 
@@ -161,6 +192,13 @@ public:
     double surfaceLayerDepth;
     bool useWorldCollisionDetector;
     BodyCollisionDetector bodyCollisionDetector;
+    int numThreads;
+    Selection staticSpaceType;
+
+#ifndef GAZEBO_ODE
+    dThreadingImplementationID threadingImpl;
+    dThreadingThreadPoolID threadPool;
+#endif
 
     double physicsTime;
     QElapsedTimer physicsTimer;
@@ -172,6 +210,9 @@ public:
     void initialize();
     ~ODESimulatorItemImpl();
     void clear();
+    void initializeThreading();
+    void releaseThreading();
+    dSpaceID createBodySpace(Body* body);
     bool initializeSimulation(const std::vector<SimulationBody*>& simBodies);
     void addBody(ODEBody* odeBody);
     bool stepSimulation(const std::vector<SimulationBody*>& activeSimBodies);
@@ -381,8 +422,21 @@ void ODELink::addMesh(MeshExtractor* extractor, ODEBody* odeBody, bool doFlipYZ)
     const Affine3& T = extractor->currentTransform();
     
     bool meshAdded = false;
+
+    if(auto heightField = mesh->sharedHeightField()){
+        if(!extractor->isCurrentScaled()){
+            dHeightfieldDataID dataID;
+            dGeomID geomId = createHeightfield(odeBody->spaceID, *heightField, dataID);
+            heightfieldDataIDs.push_back(dataID);
+            heightFields.push_back(heightField);
+            addGeometry(
+                geomId, extractor->currentTransformWithoutScaling() * getHeightfieldCenter(*heightField),
+                doFlipYZ);
+            meshAdded = true;
+        }
+    }
     
-    if(mesh->primitiveType() != SgMesh::MESH){
+    if(!meshAdded && mesh->primitiveType() != SgMesh::MESH){
         bool doAddPrimitive = false;
         Vector3 scale;
         stdx::optional<Vector3> translation;
@@ -442,8 +496,6 @@ void ODELink::addMesh(MeshExtractor* extractor, ODEBody* odeBody, bool doFlipYZ)
                 break;
             }
             if(created){
-                geomID.push_back(geomId);
-                dGeomSetBody(geomId, bodyID);
                 Isometry3 T_ = extractor->currentTransformWithoutScaling();
                 if(translation){
                     T_ *= Translation3(*translation);
@@ -451,20 +503,7 @@ void ODELink::addMesh(MeshExtractor* extractor, ODEBody* odeBody, bool doFlipYZ)
                 if(mesh->primitiveType()==SgMesh::CYLINDER ||
                         mesh->primitiveType()==SgMesh::CAPSULE )
                     T_ *= AngleAxis(radian(90), Vector3::UnitX());
-                Vector3 p = T_.translation() - link->c();
-                dMatrix3 R = { T_(0,0), T_(0,1), T_(0,2), 0.0,
-                               T_(1,0), T_(1,1), T_(1,2), 0.0,
-                               T_(2,0), T_(2,1), T_(2,2), 0.0 };
-                if(bodyID){
-                    if(doFlipYZ){
-                        flipYZ(p);
-                        flipYZ(R);
-                    }
-                    dGeomSetOffsetPosition(geomId, p.x(), p.y(), p.z());
-                    dGeomSetOffsetRotation(geomId, R);
-                } else {
-                    offsetMap.insert(OffsetMap::value_type(geomId,T_));
-                }
+                addGeometry(geomId, T_, doFlipYZ);
                 meshAdded = true;
             }
         }
@@ -500,6 +539,27 @@ void ODELink::addMesh(MeshExtractor* extractor, ODEBody* odeBody, bool doFlipYZ)
 }
 
 
+void ODELink::addGeometry(dGeomID geomId, const Isometry3& T_, bool doFlipYZ)
+{
+    geomID.push_back(geomId);
+    dGeomSetBody(geomId, bodyID);
+    Vector3 p = T_.translation() - link->c();
+    dMatrix3 R = { T_(0,0), T_(0,1), T_(0,2), 0.0,
+                   T_(1,0), T_(1,1), T_(1,2), 0.0,
+                   T_(2,0), T_(2,1), T_(2,2), 0.0 };
+    if(bodyID){
+        if(doFlipYZ){
+            flipYZ(p);
+            flipYZ(R);
+        }
+        dGeomSetOffsetPosition(geomId, p.x(), p.y(), p.z());
+        dGeomSetOffsetRotation(geomId, R);
+    } else {
+        offsetMap.insert(OffsetMap::value_type(geomId,T_));
+    }
+}
+
+
 ODELink::~ODELink()
 {
     for(vector<dGeomID>::iterator it=geomID.begin(); it!=geomID.end(); it++){
@@ -508,6 +568,9 @@ ODELink::~ODELink()
     if(triMeshDataID){
         dGeomTriMeshDataDestroy(triMeshDataID);
     }
+    for(auto& dataID : heightfieldDataIDs){
+        dGeomHeightfieldDataDestroy(dataID);
+    }
 }
 
 
@@ -693,7 +756,7 @@ void ODEBody::createBody(ODESimulatorItemImpl* simImpl)
     worldID = body->isStaticModel() ? 0 : simImpl->worldID;
 
     if(!simImpl->useWorldCollisionDetector){
-        spaceID = dHashSpaceCreate(simImpl->spaceID);
+        spaceID = simImpl->createBodySpace(body);
         dSpaceSetCleanup(spaceID, 0);
     }
 
@@ -892,14 +955,18 @@ ODESimulatorItem::ODESimulatorItem()
 
 ODESimulatorItemImpl::ODESimulatorItemImpl(ODESimulatorItem* self)
     : self(self),
-      stepMode(ODESimulatorItem::NUM_STEP_MODES, CNOID_GETTEXT_DOMAIN_NAME)
-
+      stepMode(ODESimulatorItem::NUM_STEP_MODES, CNOID_GETTEXT_DOMAIN_NAME),
+      staticSpaceType(ODESimulatorItem::NUM_STATIC_SPACE_TYPES, CNOID_GETTEXT_DOMAIN_NAME)
 {
     initialize();
 
     stepMode.setSymbol(ODESimulatorItem::STEP_ITERATIVE,  N_("Iterative (quick step)"));
     stepMode.setSymbol(ODESimulatorItem::STEP_BIG_MATRIX, N_("Big matrix"));
     stepMode.select(ODESimulatorItem::STEP_ITERATIVE);
+
+    staticSpaceType.setSymbol(ODESimulatorItem::HASH_SPACE, N_("Hash"));
+    staticSpaceType.setSymbol(ODESimulatorItem::QUADTREE_SPACE, N_("Quadtree"));
+    staticSpaceType.select(ODESimulatorItem::HASH_SPACE);
     
     gravity << 0.0, 0.0, -DEFAULT_GRAVITY_ACCELERATION;
     globalERP = 0.4;
@@ -914,6 +981,7 @@ ODESimulatorItemImpl::ODESimulatorItemImpl(ODESimulatorItem* self)
     is2Dmode = false;
     doFlipYZ = false;
     useWorldCollisionDetector = false;
+    numThreads = 1;
 }
 
 
@@ -943,6 +1011,8 @@ ODESimulatorItemImpl::ODESimulatorItemImpl(ODESimulatorItem* self, const ODESimu
     is2Dmode = org.is2Dmode;
     doFlipYZ = org.doFlipYZ;
     useWorldCollisionDetector = org.useWorldCollisionDetector;
+    numThreads = org.numThreads;
+    staticSpaceType = org.staticSpaceType;
 }
 
 
@@ -950,6 +1020,10 @@ void ODESimulatorItemImpl::initialize()
 {
     worldID = 0;
     spaceID = 0;
+#ifndef GAZEBO_ODE
+    threadingImpl = nullptr;
+    threadPool = nullptr;
+#endif
     contactJointGroupID = dJointGroupCreate(0);
     self->SimulatorItem::setAllLinkPositionOutputMode(true);
 }
@@ -1049,6 +1123,24 @@ void ODESimulatorItem::useWorldCollisionDetector(bool on)
 }
 
 
+void ODESimulatorItem::setNumThreads(int n)
+{
+    impl->numThreads = std::max(n, 1);
+}
+
+
+int ODESimulatorItem::numThreads() const
+{
+    return impl->numThreads;
+}
+
+
+void ODESimulatorItem::setStaticSpaceType(int type)
+{
+    impl->staticSpaceType.select(type);
+}
+
+
 void ODESimulatorItem::setAllLinkPositionOutputMode(bool)
 {
     // The mode is not changed.
@@ -1067,6 +1159,8 @@ void ODESimulatorItemImpl::clear()
 {
     dJointGroupEmpty(contactJointGroupID);
 
+    releaseThreading();
+
     if(worldID){
         dWorldDestroy(worldID);
         worldID = 0;
@@ -1080,6 +1174,88 @@ void ODESimulatorItemImpl::clear()
 }    
 
 
+/**
+   The islands of the world are stepped in parallel by the threads of the pool. The contact
+   joints are still created in the simulation thread because the collision detection is done
+   in the thread.
+*/
+void ODESimulatorItemImpl::initializeThreading()
+{
+#ifdef GAZEBO_ODE
+    MessageView::instance()->putln(
+        fmt::format(_("{0}: Multi-threaded stepping is not supported by Gazebo ODE."), self->displayName()),
+        MessageView::Warning);
+#else
+    threadingImpl = dThreadingAllocateMultiThreadedImplementation();
+    if(threadingImpl){
+        threadPool = dThreadingAllocateThreadPool(numThreads, 0, dAllocateFlagBasicData, nullptr);
+    }
+    if(!threadPool){
+        if(threadingImpl){
+            dThreadingFreeImplementation(threadingImpl);
+            threadingImpl = nullptr;
+        }
+        MessageView::instance()->putln(
+            fmt::format(_("{0}: The ODE library does not support the multi-threaded stepping. "
+                          "The simulation is done in a single thread."), self->displayName()),
+            MessageView::Warning);
+        return;
+    }
+    dThreadingThreadPoolServeMultiThreadedImplementation(threadPool, threadingImpl);
+    dWorldSetStepThreadingImplementation(
+        worldID, dThreadingImplementationGetFunctions(threadingImpl), threadingImpl);
+    dWorldSetStepIslandsProcessingMaxThreadCount(worldID, numThreads);
+#endif
+}
+
+
+void ODESimulatorItemImpl::releaseThreading()
+{
+#ifndef GAZEBO_ODE
+    if(threadingImpl){
+        dThreadingImplementationShutdownProcessing(threadingImpl);
+        dThreadingThreadPoolWaitIdleState(threadPool);
+        dThreadingFreeThreadPool(threadPool);
+        threadPool = nullptr;
+        if(worldID){
+            dWorldSetStepThreadingImplementation(worldID, nullptr, nullptr);
+        }
+        dThreadingFreeImplementation(threadingImpl);
+        threadingImpl = nullptr;
+    }
+#endif
+}
+
+
+/**
+   The quadtree space is only used for the static bodies because the region of the tree must be
+   fixed in advance. The region is given by the bounding box of the collision shapes of the body.
+*/
+dSpaceID ODESimulatorItemImpl::createBodySpace(Body* body)
+{
+    if(body->isStaticModel() && staticSpaceType.is(ODESimulatorItem::QUADTREE_SPACE) && !doFlipYZ){
+        BoundingBox bbox;
+        for(auto& link : body->links()){
+            if(auto shape = link->collisionShape()){
+                BoundingBox linkBBox = shape->boundingBox();
+                if(!linkBBox.empty()){
+                    linkBBox.transform(link->T());
+                    bbox.expandBy(linkBBox);
+                }
+            }
+        }
+        if(!bbox.empty()){
+            Vector3 c = bbox.center();
+            Vector3 s = bbox.size();
+            dVector3 center = { c.x(), c.y(), c.z() };
+            dVector3 extents = { s.x(), s.y(), s.z() };
+            return dQuadTreeSpaceCreate(spaceID, center, extents, QUADTREE_SPACE_DEPTH);
+        }
+    }
+    return dHashSpaceCreate(spaceID);
+}
+
+
 Item* ODESimulatorItem::doDuplicate() const
 {
     return new ODESimulatorItem(*this);
@@ -1128,6 +1304,10 @@ bool ODESimulatorItemImpl::initializeSimulation(const std::vector<SimulationBody
     dWorldSetContactMaxCorrectingVel(worldID, enableMaxCorrectingVel ? maxCorrectingVel.value() : dInfinity);
     dWorldSetContactSurfaceLayer(worldID, surfaceLayerDepth);
 
+    if(numThreads > 1){
+        initializeThreading();
+    }
+
     timeStep = self->worldTimeStep();
 
     for(size_t i=0; i < simBodies.size(); ++i){
@@ -1270,6 +1450,7 @@ bool ODESimulatorItemImpl::stepSimulation(const std::vector<SimulationBody*>& ac
             odeBody->setControlValToODE();
         }
     }
+    self->lapDynamicsStepPhase(SimulatorItem::StateInputPhase);
 
     if(MEASURE_PHYSICS_CALCULATION_TIME){
         physicsTimer.start();
@@ -1304,6 +1485,7 @@ bool ODESimulatorItemImpl::stepSimulation(const std::vector<SimulationBody*>& ac
     if(MEASURE_PHYSICS_CALCULATION_TIME){
         physicsTime += physicsTimer.nsecsElapsed();
     }
+    self->lapDynamicsStepPhase(SimulatorItem::EngineStepPhase);
 
     //! \todo Bodies with sensors should be managed by the specialized container to increase the efficiency
     for(size_t i=0; i < activeSimBodies.size(); ++i){
@@ -1323,6 +1505,7 @@ bool ODESimulatorItemImpl::stepSimulation(const std::vector<SimulationBody*>& ac
             }
         }
     }
+    self->lapDynamicsStepPhase(SimulatorItem::StateOutputPhase);
 
     return true;
 }
@@ -1436,6 +1619,10 @@ void ODESimulatorItemImpl::doPutProperties(PutPropertyFunction& putProperty)
     putProperty(_("2D mode"), is2Dmode, changeProperty(is2Dmode));
 
     putProperty(_("Use WorldItem's Collision Detector"), useWorldCollisionDetector, changeProperty(useWorldCollisionDetector));
+
+    putProperty.min(1)(_("Threads"), numThreads, changeProperty(numThreads));
+
+    putProperty(_("Static body space"), staticSpaceType, changeProperty(staticSpaceType));
 }
 
 
@@ -1461,6 +1648,8 @@ void ODESimulatorItemImpl::store(Archive& archive)
     archive.write("maxCorrectingVel", maxCorrectingVel);
     archive.write("2Dmode", is2Dmode);
     archive.write("useWorldCollisionDetector", useWorldCollisionDetector);
+    archive.write("numThreads", numThreads);
+    archive.write("staticSpaceType", staticSpaceType.selectedSymbol());
 }
 
 
@@ -1491,4 +1680,10 @@ void ODESimulatorItemImpl::restore(const Archive& archive)
     if(!archive.read("useWorldCollisionDetector", useWorldCollisionDetector)){
         archive.read("UseWorldItem'sCollisionDetector", useWorldCollisionDetector);
     }
+    if(archive.read("numThreads", numThreads)){
+        numThreads = std::max(numThreads, 1);
+    }
+    if(archive.read("staticSpaceType", symbol)){
+        staticSpaceType.select(symbol);
+    }
 }
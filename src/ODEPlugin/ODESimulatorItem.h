@@ -42,6 +42,17 @@ public:
     void setSurfaceLayerDepth(double value);
     void useWorldCollisionDetector(bool on);
 
+    /**
+       The islands of the world are stepped in parallel when the number of threads is more than one.
+       This requires the ODE library built with the built-in threading implementation.
+    */
+    void setNumThreads(int n);
+    int numThreads() const;
+
+    enum StaticSpaceType { HASH_SPACE, QUADTREE_SPACE, NUM_STATIC_SPACE_TYPES };
+    //! The type of the collision space used for the geometries of each static body
+    void setStaticSpaceType(int type);
+
     virtual void setAllLinkPositionOutputMode(bool on) override;
     virtual Vector3 getGravity() const override;
 
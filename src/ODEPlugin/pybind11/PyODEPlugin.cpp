@@ -29,6 +29,9 @@ PYBIND11_MODULE(ODEPlugin, m)
         .def("setMaxCorrectingVelocity", &ODESimulatorItem::setMaxCorrectingVelocity)
         .def("setSurfaceLayerDepth", &ODESimulatorItem::setSurfaceLayerDepth)
         .def("useWorldCollisionDetector", &ODESimulatorItem::useWorldCollisionDetector)
+        .def("setNumThreads", &ODESimulatorItem::setNumThreads)
+        .def_property_readonly("numThreads", &ODESimulatorItem::numThreads)
+        .def("setStaticSpaceType", &ODESimulatorItem::setStaticSpaceType)
         ;
 
     py::enum_<ODESimulatorItem::StepMode>(odeSimulatorItemScope, "StepMode")
@@ -37,5 +40,11 @@ PYBIND11_MODULE(ODEPlugin, m)
         .value("NUM_STEP_MODES", ODESimulatorItem::StepMode::NUM_STEP_MODES)
         .export_values();
 
+    py::enum_<ODESimulatorItem::StaticSpaceType>(odeSimulatorItemScope, "StaticSpaceType")
+        .value("HASH_SPACE", ODESimulatorItem::StaticSpaceType::HASH_SPACE)
+        .value("QUADTREE_SPACE", ODESimulatorItem::StaticSpaceType::QUADTREE_SPACE)
+        .value("NUM_STATIC_SPACE_TYPES", ODESimulatorItem::StaticSpaceType::NUM_STATIC_SPACE_TYPES)
+        .export_values();
+
     PyItemList<ODESimulatorItem>(m, "ODESimulatorItemList");
 }
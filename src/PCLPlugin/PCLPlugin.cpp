@@ -3,6 +3,7 @@
   @author Shin'ichiro Nakaoka
 */
 
+#include "PointCloudMapItem.h"
 #include <cnoid/Plugin>
 
 using namespace cnoid;
@@ -11,10 +12,14 @@ class PCLPlugin : public Plugin
 {
 public:
     
-    PCLPlugin() : Plugin("PCL") { }
+    PCLPlugin() : Plugin("PCL") {
+        require("Body");
+    }
     
     virtual bool initialize(){
 
+        PointCloudMapItem::initializeClass(this);
+
         return true;
     }
 };
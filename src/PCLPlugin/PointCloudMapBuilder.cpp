@@ -0,0 +1,398 @@
+#include "PointCloudMapBuilder.h"
+#include <pcl/point_types.h>
+#include <pcl/common/transforms.h>
+#include <pcl/filters/voxel_grid.h>
+#include <pcl/filters/statistical_outlier_removal.h>
+#include <pcl/registration/icp.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+typedef pcl::PointCloud<pcl::PointXYZ> PointCloud;
+
+struct Parameters
+{
+    double voxelSize;
+    double mapVoxelSize;
+    int numOutlierRemovalNeighbors;
+    double outlierRemovalStddevMultiplier;
+    bool isRegistrationEnabled;
+    double maxCorrespondenceDistance;
+    int maxRegistrationIterations;
+};
+
+PointCloud::Ptr downsample(PointCloud::Ptr cloud, double voxelSize)
+{
+    if(voxelSize <= 0.0 || cloud->empty()){
+        return cloud;
+    }
+    PointCloud::Ptr filtered(new PointCloud);
+    pcl::VoxelGrid<pcl::PointXYZ> voxelGrid;
+    const float s = voxelSize;
+    voxelGrid.setInputCloud(cloud);
+    voxelGrid.setLeafSize(s, s, s);
+    voxelGrid.filter(*filtered);
+    return filtered;
+}
+
+}
+
+namespace cnoid {
+
+class PointCloudMapBuilder::Impl
+{
+public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+    // Variables shared with the processing thread
+    std::thread processingThread;
+    mutable std::mutex mutex;
+    std::condition_variable condition;
+    Parameters parameters;
+    std::shared_ptr<const PointData> pendingPoints;
+    Isometry3 pendingSensorPosition;
+    bool isStopRequested;
+    std::atomic<bool> isMapClearRequested;
+    std::atomic<int> numProcessedFrames;
+    std::atomic<int> numDroppedFrames;
+
+    // Variables only accessed in the processing thread
+    PointCloud::Ptr map;
+    Isometry3 correction;
+
+    // Variables published by the processing thread
+    mutable std::mutex mapMutex;
+    PointData mapPoints;
+    Isometry3 lastSensorPosition;
+
+    Signal<void()> sigMapUpdated;
+
+    Impl();
+    void start();
+    void stop();
+    void processingLoop();
+    void processFrame(const PointData& points, const Isometry3& T_sensor, const Parameters& param);
+};
+
+}
+
+
+PointCloudMapBuilder::PointCloudMapBuilder()
+{
+    impl = new Impl;
+}
+
+
+PointCloudMapBuilder::Impl::Impl()
+{
+    parameters.voxelSize = 0.05;
+    parameters.mapVoxelSize = 0.05;
+    parameters.numOutlierRemovalNeighbors = 20;
+    parameters.outlierRemovalStddevMultiplier = 1.0;
+    parameters.isRegistrationEnabled = true;
+    parameters.maxCorrespondenceDistance = 0.2;
+    parameters.maxRegistrationIterations = 30;
+
+    pendingSensorPosition.setIdentity();
+    isStopRequested = false;
+    isMapClearRequested = false;
+    numProcessedFrames = 0;
+    numDroppedFrames = 0;
+    correction.setIdentity();
+    lastSensorPosition.setIdentity();
+}
+
+
+PointCloudMapBuilder::~PointCloudMapBuilder()
+{
+    impl->stop();
+    delete impl;
+}
+
+
+void PointCloudMapBuilder::setVoxelSize(double size)
+{
+    std::lock_guard<std::mutex> lock(impl->mutex);
+    impl->parameters.voxelSize = std::max(size, 0.0);
+}
+
+
+double PointCloudMapBuilder::voxelSize() const
+{
+    std::lock_guard<std::mutex> lock(impl->mutex);
+    return impl->parameters.voxelSize;
+}
+
+
+void PointCloudMapBuilder::setMapVoxelSize(double size)
+{
+    std::lock_guard<std::mutex> lock(impl->mutex);
+    impl->parameters.mapVoxelSize = std::max(size, 0.0);
+}
+
+
+double PointCloudMapBuilder::mapVoxelSize() const
+{
+    std::lock_guard<std::mutex> lock(impl->mutex);
+    return impl->parameters.mapVoxelSize;
+}
+
+
+void PointCloudMapBuilder::setOutlierRemovalParameters(int numNeighbors, double stddevMultiplier)
+{
+    std::lock_guard<std::mutex> lock(impl->mutex);
+    impl->parameters.numOutlierRemovalNeighbors = std::max(numNeighbors, 0);
+    impl->parameters.outlierRemovalStddevMultiplier = stddevMultiplier;
+}
+
+
+int PointCloudMapBuilder::numOutlierRemovalNeighbors() const
+{
+    std::lock_guard<std::mutex> lock(impl->mutex);
+    return impl->parameters.numOutlierRemovalNeighbors;
+}
+
+
+double PointCloudMapBuilder::outlierRemovalStddevMultiplier() const
+{
+    std::lock_guard<std::mutex> lock(impl->mutex);
+    return impl->parameters.outlierRemovalStddevMultiplier;
+}
+
+
+void PointCloudMapBuilder::setRegistrationEnabled(bool on)
+{
+    std::lock_guard<std::mutex> lock(impl->mutex);
+    impl->parameters.isRegistrationEnabled = on;
+}
+
+
+bool PointCloudMapBuilder::isRegistrationEnabled() const
+{
+    std::lock_guard<std::mutex> lock(impl->mutex);
+    return impl->parameters.isRegistrationEnabled;
+}
+
+
+void PointCloudMapBuilder::setRegistrationParameters(double maxCorrespondenceDistance, int maxIterations)
+{
+    std::lock_guard<std::mutex> lock(impl->mutex);
+    impl->parameters.maxCorrespondenceDistance = maxCorrespondenceDistance;
+    impl->parameters.maxRegistrationIterations = std::max(maxIterations, 1);
+}
+
+
+double PointCloudMapBuilder::maxCorrespondenceDistance() const
+{
+    std::lock_guard<std::mutex> lock(impl->mutex);
+    return impl->parameters.maxCorrespondenceDistance;
+}
+
+
+int PointCloudMapBuilder::maxRegistrationIterations() const
+{
+    std::lock_guard<std::mutex> lock(impl->mutex);
+    return impl->parameters.maxRegistrationIterations;
+}
+
+
+void PointCloudMapBuilder::start()
+{
+    impl->start();
+}
+
+
+void PointCloudMapBuilder::Impl::start()
+{
+    if(!processingThread.joinable()){
+        isStopRequested = false;
+        processingThread = std::thread([this](){ processingLoop(); });
+    }
+}
+
+
+void PointCloudMapBuilder::stop()
+{
+    impl->stop();
+}
+
+
+//! The frame being processed is completed, and the pending frame is discarded.
+void PointCloudMapBuilder::Impl::stop()
+{
+    if(processingThread.joinable()){
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            isStopRequested = true;
+            pendingPoints.reset();
+        }
+        condition.notify_all();
+        processingThread.join();
+    }
+}
+
+
+bool PointCloudMapBuilder::isRunning() const
+{
+    return impl->processingThread.joinable();
+}
+
+
+void PointCloudMapBuilder::clearMap()
+{
+    impl->isMapClearRequested = true;
+    {
+        std::lock_guard<std::mutex> lock(impl->mapMutex);
+        impl->mapPoints.clear();
+    }
+}
+
+
+void PointCloudMapBuilder::addFrame(std::shared_ptr<const PointData> points, const Isometry3& T_sensor)
+{
+    {
+        std::lock_guard<std::mutex> lock(impl->mutex);
+        if(impl->pendingPoints){
+            ++impl->numDroppedFrames;
+        }
+        impl->pendingPoints = points;
+        impl->pendingSensorPosition = T_sensor;
+    }
+    impl->condition.notify_all();
+}
+
+
+void PointCloudMapBuilder::Impl::processingLoop()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while(true){
+        condition.wait(lock, [this](){ return pendingPoints || isStopRequested; });
+        if(isStopRequested){
+            break;
+        }
+        auto points = pendingPoints;
+        pendingPoints.reset();
+        const Isometry3 T_sensor = pendingSensorPosition;
+        const Parameters param = parameters;
+        lock.unlock();
+        processFrame(*points, T_sensor, param);
+        lock.lock();
+    }
+}
+
+
+void PointCloudMapBuilder::Impl::processFrame
+(const PointData& points, const Isometry3& T_sensor, const Parameters& param)
+{
+    if(isMapClearRequested.exchange(false)){
+        map.reset();
+        correction.setIdentity();
+    }
+
+    PointCloud::Ptr cloud(new PointCloud);
+    cloud->reserve(points.size());
+    for(auto& p : points){
+        if(p.allFinite()){
+            cloud->push_back(pcl::PointXYZ(p.x(), p.y(), p.z()));
+        }
+    }
+    cloud = downsample(cloud, param.voxelSize);
+
+    if(param.numOutlierRemovalNeighbors > 0 && cloud->size() > static_cast<size_t>(param.numOutlierRemovalNeighbors)){
+        PointCloud::Ptr filtered(new PointCloud);
+        pcl::StatisticalOutlierRemoval<pcl::PointXYZ> outlierRemoval;
+        outlierRemoval.setInputCloud(cloud);
+        outlierRemoval.setMeanK(param.numOutlierRemovalNeighbors);
+        outlierRemoval.setStddevMulThresh(param.outlierRemovalStddevMultiplier);
+        outlierRemoval.filter(*filtered);
+        cloud = filtered;
+    }
+
+    if(cloud->empty()){
+        ++numProcessedFrames;
+        return;
+    }
+
+    Isometry3 T = correction * T_sensor;
+    PointCloud::Ptr transformed(new PointCloud);
+    pcl::transformPointCloud(*cloud, *transformed, T.matrix().cast<float>().eval());
+
+    if(param.isRegistrationEnabled && map && !map->empty()){
+        typedef pcl::IterativeClosestPoint<pcl::PointXYZ, pcl::PointXYZ> ICP;
+        ICP icp;
+        icp.setInputTarget(map);
+        icp.setInputSource(transformed);
+        icp.setMaxCorrespondenceDistance(param.maxCorrespondenceDistance);
+        icp.setMaximumIterations(param.maxRegistrationIterations);
+        icp.setTransformationEpsilon(1.0e-8);
+        PointCloud::Ptr aligned(new PointCloud);
+        icp.align(*aligned);
+        if(icp.hasConverged()){
+            Isometry3 T_icp;
+            T_icp.matrix() = icp.getFinalTransformation().cast<double>();
+            T = T_icp * T;
+            correction = T * T_sensor.inverse();
+            transformed = aligned;
+        }
+    }
+
+    if(!map){
+        map = transformed;
+    } else {
+        *map += *transformed;
+    }
+    map = downsample(map, param.mapVoxelSize);
+
+    {
+        std::lock_guard<std::mutex> lock(mapMutex);
+        if(!isMapClearRequested){
+            mapPoints.resize(map->size());
+            for(size_t i=0; i < map->size(); ++i){
+                mapPoints[i] = map->points[i].getVector3fMap();
+            }
+        }
+        lastSensorPosition = T;
+    }
+
+    ++numProcessedFrames;
+
+    sigMapUpdated();
+}
+
+
+SignalProxy<void()> PointCloudMapBuilder::sigMapUpdated()
+{
+    return impl->sigMapUpdated;
+}
+
+
+void PointCloudMapBuilder::getMap(PointData& out_points) const
+{
+    std::lock_guard<std::mutex> lock(impl->mapMutex);
+    out_points = impl->mapPoints;
+}
+
+
+Isometry3 PointCloudMapBuilder::lastSensorPosition() const
+{
+    std::lock_guard<std::mutex> lock(impl->mapMutex);
+    return impl->lastSensorPosition;
+}
+
+
+int PointCloudMapBuilder::numProcessedFrames() const
+{
+    return impl->numProcessedFrames;
+}
+
+
+int PointCloudMapBuilder::numDroppedFrames() const
+{
+    return impl->numDroppedFrames;
+}
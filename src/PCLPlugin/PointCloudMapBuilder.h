@@ -0,0 +1,80 @@
+#ifndef CNOID_PCL_PLUGIN_POINT_CLOUD_MAP_BUILDER_H
+#define CNOID_PCL_PLUGIN_POINT_CLOUD_MAP_BUILDER_H
+
+#include <cnoid/EigenTypes>
+#include <cnoid/Signal>
+#include <memory>
+#include <vector>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+/**
+   This class builds a point cloud map from the successive frames of a range sensor in a
+   background thread. Each frame is downsampled with a voxel grid, filtered with the statistical
+   outlier removal, aligned to the current map with ICP, and merged into the map, which is also
+   downsampled with a voxel grid.
+
+   When a frame is given while the previous frame is being processed, the frame is kept as the
+   next frame to process, and the frame kept before is dropped. The processing thread therefore
+   never lags behind the latest frame by more than one frame.
+*/
+class CNOID_EXPORT PointCloudMapBuilder
+{
+public:
+    typedef std::vector<Vector3f> PointData;
+
+    PointCloudMapBuilder();
+    ~PointCloudMapBuilder();
+
+    //! Zero disables the downsampling of the frames
+    void setVoxelSize(double size);
+    double voxelSize() const;
+
+    //! Zero disables the downsampling of the map
+    void setMapVoxelSize(double size);
+    double mapVoxelSize() const;
+
+    //! The outlier removal is disabled when the number of neighbors is zero
+    void setOutlierRemovalParameters(int numNeighbors, double stddevMultiplier);
+    int numOutlierRemovalNeighbors() const;
+    double outlierRemovalStddevMultiplier() const;
+
+    void setRegistrationEnabled(bool on);
+    bool isRegistrationEnabled() const;
+    void setRegistrationParameters(double maxCorrespondenceDistance, int maxIterations);
+    double maxCorrespondenceDistance() const;
+    int maxRegistrationIterations() const;
+
+    void start();
+    void stop();
+    bool isRunning() const;
+
+    void clearMap();
+
+    /**
+       This function can be called from any thread.
+       \param points The points in the sensor coordinate frame. The data is shared with the caller
+       and must not be modified after the call.
+       \param T_sensor The sensor position used as the initial guess of the registration.
+       The correction given by the registration of the previous frame is applied to it.
+    */
+    void addFrame(std::shared_ptr<const PointData> points, const Isometry3& T_sensor);
+
+    //! The signal is emitted in the processing thread when the map is updated.
+    SignalProxy<void()> sigMapUpdated();
+
+    //! The following functions can be called from any thread.
+    void getMap(PointData& out_points) const;
+    Isometry3 lastSensorPosition() const;
+    int numProcessedFrames() const;
+    int numDroppedFrames() const;
+
+private:
+    class Impl;
+    Impl* impl;
+};
+
+}
+
+#endif
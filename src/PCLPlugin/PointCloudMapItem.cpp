@@ -0,0 +1,305 @@
+#include "PointCloudMapItem.h"
+#include "PointCloudMapBuilder.h"
+#include <cnoid/ItemManager>
+#include <cnoid/BodyItem>
+#include <cnoid/RangeCamera>
+#include <cnoid/SceneDrawables>
+#include <cnoid/LazyCaller>
+#include <cnoid/Signal>
+#include <cnoid/PutPropertyFunction>
+#include <cnoid/Archive>
+#include <atomic>
+#include "gettext.h"
+
+using namespace std;
+using namespace cnoid;
+
+namespace cnoid {
+
+class PointCloudMapItem::Impl
+{
+public:
+    PointCloudMapItem* self;
+    PointCloudMapBuilder builder;
+    BodyItem* bodyItem;
+    RangeCameraPtr rangeCamera;
+    string rangeCameraName;
+    bool isMappingEnabled;
+    ScopedConnection rangeCameraConnection;
+    ScopedConnection mapConnection;
+    QueuedCaller mapUpdateCaller;
+    std::atomic<bool> isMapUpdatePending;
+
+    Impl(PointCloudMapItem* self);
+    Impl(PointCloudMapItem* self, const Impl& org);
+    void setBodyItem(BodyItem* bodyItem);
+    void updateRangeCamera();
+    void onRangeCameraStateChanged();
+    void onMapUpdated();
+    void updateMap();
+};
+
+}
+
+
+void PointCloudMapItem::initializeClass(ExtensionManager* ext)
+{
+    ItemManager& im = ext->itemManager();
+    im.registerClass<PointCloudMapItem, PointSetItem>(N_("PointCloudMapItem"));
+    im.addCreationPanel<PointCloudMapItem>();
+}
+
+
+PointCloudMapItem::PointCloudMapItem()
+{
+    impl = new Impl(this);
+}
+
+
+PointCloudMapItem::Impl::Impl(PointCloudMapItem* self)
+    : self(self)
+{
+    bodyItem = nullptr;
+    isMappingEnabled = true;
+    isMapUpdatePending = false;
+    mapConnection = builder.sigMapUpdated().connect([this](){ onMapUpdated(); });
+}
+
+
+PointCloudMapItem::PointCloudMapItem(const PointCloudMapItem& org)
+    : PointSetItem(org)
+{
+    impl = new Impl(this, *org.impl);
+}
+
+
+PointCloudMapItem::Impl::Impl(PointCloudMapItem* self, const Impl& org)
+    : Impl(self)
+{
+    rangeCameraName = org.rangeCameraName;
+    isMappingEnabled = org.isMappingEnabled;
+    builder.setVoxelSize(org.builder.voxelSize());
+    builder.setMapVoxelSize(org.builder.mapVoxelSize());
+    builder.setOutlierRemovalParameters(
+        org.builder.numOutlierRemovalNeighbors(), org.builder.outlierRemovalStddevMultiplier());
+    builder.setRegistrationEnabled(org.builder.isRegistrationEnabled());
+    builder.setRegistrationParameters(
+        org.builder.maxCorrespondenceDistance(), org.builder.maxRegistrationIterations());
+}
+
+
+PointCloudMapItem::~PointCloudMapItem()
+{
+    impl->rangeCameraConnection.disconnect();
+    impl->builder.stop();
+    impl->mapConnection.disconnect();
+    impl->mapUpdateCaller.cancel();
+    delete impl;
+}
+
+
+Item* PointCloudMapItem::doDuplicate() const
+{
+    return new PointCloudMapItem(*this);
+}
+
+
+PointCloudMapBuilder* PointCloudMapItem::mapBuilder()
+{
+    return &impl->builder;
+}
+
+
+void PointCloudMapItem::setRangeCameraName(const std::string& name)
+{
+    if(name != impl->rangeCameraName){
+        impl->rangeCameraName = name;
+        impl->updateRangeCamera();
+    }
+}
+
+
+const std::string& PointCloudMapItem::rangeCameraName() const
+{
+    return impl->rangeCameraName;
+}
+
+
+void PointCloudMapItem::setMappingEnabled(bool on)
+{
+    if(on != impl->isMappingEnabled){
+        impl->isMappingEnabled = on;
+        impl->updateRangeCamera();
+    }
+}
+
+
+bool PointCloudMapItem::isMappingEnabled() const
+{
+    return impl->isMappingEnabled;
+}
+
+
+void PointCloudMapItem::clearMap()
+{
+    impl->builder.clearMap();
+    impl->updateMap();
+}
+
+
+void PointCloudMapItem::onTreePathChanged()
+{
+    impl->setBodyItem(findOwnerItem<BodyItem>());
+}
+
+
+void PointCloudMapItem::onDisconnectedFromRoot()
+{
+    impl->setBodyItem(nullptr);
+}
+
+
+void PointCloudMapItem::Impl::setBodyItem(BodyItem* bodyItem)
+{
+    if(bodyItem != this->bodyItem){
+        this->bodyItem = bodyItem;
+        updateRangeCamera();
+    }
+}
+
+
+void PointCloudMapItem::Impl::updateRangeCamera()
+{
+    rangeCameraConnection.disconnect();
+    rangeCamera.reset();
+
+    if(bodyItem && isMappingEnabled){
+        auto body = bodyItem->body();
+        if(rangeCameraName.empty()){
+            rangeCamera = body->findDevice<RangeCamera>();
+        } else {
+            rangeCamera = body->findDevice<RangeCamera>(rangeCameraName);
+        }
+    }
+
+    if(rangeCamera){
+        rangeCameraConnection =
+            rangeCamera->sigStateChanged().connect([this](){ onRangeCameraStateChanged(); });
+        builder.start();
+    } else {
+        builder.stop();
+    }
+}
+
+
+/**
+   The point data of the range camera is shared with the map builder without copying it
+   because the range camera replaces the data with new one when it is updated.
+*/
+void PointCloudMapItem::Impl::onRangeCameraStateChanged()
+{
+    auto points = rangeCamera->sharedPoints();
+    if(points && !points->empty()){
+        builder.addFrame(points, rangeCamera->link()->T() * rangeCamera->T_local());
+    }
+}
+
+
+//! This function is called in the processing thread of the map builder
+void PointCloudMapItem::Impl::onMapUpdated()
+{
+    if(!isMapUpdatePending.exchange(true)){
+        mapUpdateCaller.callLater([this](){ updateMap(); }, LazyCaller::LowPriority);
+    }
+}
+
+
+void PointCloudMapItem::Impl::updateMap()
+{
+    isMapUpdatePending = false;
+    auto pointSet = self->pointSet();
+    builder.getMap(*pointSet->getOrCreateVertices());
+    self->notifyUpdate();
+}
+
+
+void PointCloudMapItem::doPutProperties(PutPropertyFunction& putProperty)
+{
+    PointSetItem::doPutProperties(putProperty);
+
+    auto builder = &impl->builder;
+    putProperty(_("Range camera"), impl->rangeCameraName,
+                [=](const string& name){ setRangeCameraName(name); return true; });
+    putProperty(_("Mapping"), impl->isMappingEnabled,
+                [=](bool on){ setMappingEnabled(on); return true; });
+    putProperty.min(0.0).decimals(3)
+        (_("Frame voxel size"), builder->voxelSize(),
+         [=](double size){ builder->setVoxelSize(size); return true; });
+    putProperty.min(0.0).decimals(3)
+        (_("Map voxel size"), builder->mapVoxelSize(),
+         [=](double size){ builder->setMapVoxelSize(size); return true; });
+    putProperty.min(0)
+        (_("Outlier removal neighbors"), builder->numOutlierRemovalNeighbors(),
+         [=](int n){
+            builder->setOutlierRemovalParameters(n, builder->outlierRemovalStddevMultiplier());
+            return true; });
+    putProperty.min(0.0).decimals(2)
+        (_("Outlier removal stddev"), builder->outlierRemovalStddevMultiplier(),
+         [=](double s){
+            builder->setOutlierRemovalParameters(builder->numOutlierRemovalNeighbors(), s);
+            return true; });
+    putProperty(_("Registration"), builder->isRegistrationEnabled(),
+                [=](bool on){ builder->setRegistrationEnabled(on); return true; });
+    putProperty.min(0.0).decimals(3)
+        (_("Max correspondence distance"), builder->maxCorrespondenceDistance(),
+         [=](double d){
+            builder->setRegistrationParameters(d, builder->maxRegistrationIterations());
+            return true; });
+    putProperty.min(1)
+        (_("Max registration iterations"), builder->maxRegistrationIterations(),
+         [=](int n){
+            builder->setRegistrationParameters(builder->maxCorrespondenceDistance(), n);
+            return true; });
+    putProperty.reset();
+    putProperty(_("Processed frames"), builder->numProcessedFrames());
+    putProperty(_("Dropped frames"), builder->numDroppedFrames());
+}
+
+
+bool PointCloudMapItem::store(Archive& archive)
+{
+    PointSetItem::store(archive);
+
+    auto& builder = impl->builder;
+    archive.write("range_camera", impl->rangeCameraName);
+    archive.write("mapping", impl->isMappingEnabled);
+    archive.write("frame_voxel_size", builder.voxelSize());
+    archive.write("map_voxel_size", builder.mapVoxelSize());
+    archive.write("outlier_removal_neighbors", builder.numOutlierRemovalNeighbors());
+    archive.write("outlier_removal_stddev", builder.outlierRemovalStddevMultiplier());
+    archive.write("registration", builder.isRegistrationEnabled());
+    archive.write("max_correspondence_distance", builder.maxCorrespondenceDistance());
+    archive.write("max_registration_iterations", builder.maxRegistrationIterations());
+    return true;
+}
+
+
+bool PointCloudMapItem::restore(const Archive& archive)
+{
+    PointSetItem::restore(archive);
+
+    auto& builder = impl->builder;
+    archive.read("range_camera", impl->rangeCameraName);
+    archive.read("mapping", impl->isMappingEnabled);
+    builder.setVoxelSize(archive.get("frame_voxel_size", builder.voxelSize()));
+    builder.setMapVoxelSize(archive.get("map_voxel_size", builder.mapVoxelSize()));
+    builder.setOutlierRemovalParameters(
+        archive.get("outlier_removal_neighbors", builder.numOutlierRemovalNeighbors()),
+        archive.get("outlier_removal_stddev", builder.outlierRemovalStddevMultiplier()));
+    builder.setRegistrationEnabled(archive.get("registration", builder.isRegistrationEnabled()));
+    builder.setRegistrationParameters(
+        archive.get("max_correspondence_distance", builder.maxCorrespondenceDistance()),
+        archive.get("max_registration_iterations", builder.maxRegistrationIterations()));
+    impl->updateRangeCamera();
+    return true;
+}
@@ -0,0 +1,53 @@
+#ifndef CNOID_PCL_PLUGIN_POINT_CLOUD_MAP_ITEM_H
+#define CNOID_PCL_PLUGIN_POINT_CLOUD_MAP_ITEM_H
+
+#include <cnoid/PointSetItem>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+class PointCloudMapBuilder;
+
+/**
+   This item builds a point cloud map from the range camera of the owner body item with
+   PointCloudMapBuilder. The frames are taken when the state of the range camera is updated,
+   for example by the vision simulation, and the map is shown as the point set of this item.
+*/
+class CNOID_EXPORT PointCloudMapItem : public PointSetItem
+{
+public:
+    static void initializeClass(ExtensionManager* ext);
+
+    PointCloudMapItem();
+    PointCloudMapItem(const PointCloudMapItem& org);
+    virtual ~PointCloudMapItem();
+
+    PointCloudMapBuilder* mapBuilder();
+
+    //! An empty name means the first range camera of the body
+    void setRangeCameraName(const std::string& name);
+    const std::string& rangeCameraName() const;
+
+    void setMappingEnabled(bool on);
+    bool isMappingEnabled() const;
+
+    void clearMap();
+
+protected:
+    virtual Item* doDuplicate() const override;
+    virtual void onTreePathChanged() override;
+    virtual void onDisconnectedFromRoot() override;
+    virtual void doPutProperties(PutPropertyFunction& putProperty) override;
+    virtual bool store(Archive& archive) override;
+    virtual bool restore(const Archive& archive) override;
+
+private:
+    class Impl;
+    Impl* impl;
+};
+
+typedef ref_ptr<PointCloudMapItem> PointCloudMapItemPtr;
+
+}
+
+#endif
@@ -34,6 +34,10 @@ using std::isfinite;
 #endif
 #endif
 
+#if PX_PHYSICS_VERSION_MAJOR == 3 && PX_PHYSICS_VERSION_MINOR >= 4 && PX_SUPPORT_GPU_PHYSX
+#define GPU_PHYSX_SUPPORTED
+#endif
+
 using namespace std;
 using namespace cnoid;
 using namespace physx;
@@ -67,7 +71,7 @@ public:
     PxConvexMesh* createConvexMeshSafe();
     void addMesh(MeshExtractor* extractor, PhysXBody* physXBody);
     void setKinematicStateToPhysX();
-    void getKinematicStateFromPhysX();
+    void getJointStateFromPhysX();
     void setTorqueToPhysX();
     void setVelocityToPhysX();
 };
@@ -87,7 +91,7 @@ public:
     ~PhysXBody();
     void createBody(PhysXSimulatorItemImpl* simImpl);
     void setKinematicStateToPhysX();
-    void getKinematicStateFromPhysX();
+    void getJointStateFromPhysX();
     void updateForceSensors();
     void setExtraJoints();
     void setControlValToPhysX();
@@ -101,6 +105,33 @@ public:
     PxProfileZoneManager* pxProfileZoneManager = 0;
 #endif
     PxCooking* pxCooking = 0;
+
+void setLinkPositionFromPhysX(Link* link, const PxTransform& T)
+{
+    const PxVec3& p = T.p;
+    link->p() = Vector3(p[0], p[1], p[2]);
+    PxMat33 R(T.q);
+    link->R() << R(0,0), R(0,1), R(0,2),
+        R(1,0), R(1,1), R(1,2),
+        R(2,0), R(2,1), R(2,2);
+}
+
+void setLinkVelocityFromPhysX(Link* link, PxActor* pxActor)
+{
+#ifdef VERSION_3_3_LATER
+    if(pxActor->getType()==PxActorType::eRIGID_DYNAMIC){
+        PxRigidDynamic* actor = reinterpret_cast<PxRigidDynamic*>(pxActor);
+        PxVec3 v = actor->getLinearVelocity();
+        PxVec3 w = actor->getAngularVelocity();
+#else
+    if(pxActor->isRigidDynamic()){
+        PxVec3 v = pxActor->isRigidDynamic()->getLinearVelocity();
+        PxVec3 w = pxActor->isRigidDynamic()->getAngularVelocity();
+#endif
+        link->w() = Vector3(w[0], w[1], w[2]);
+        link->v() = Vector3(v[0], v[1], v[2]);
+    }
+}
 }
 
 
@@ -116,6 +147,9 @@ public:
     PxDefaultCpuDispatcher* pxDispatcher;
     PxScene* pxScene;
     PxMaterial* pxMaterial;
+#ifdef GPU_PHYSX_SUPPORTED
+    PxCudaContextManager* pxCudaContextManager;
+#endif
 
     Vector3 gravity;
     double timeStep;
@@ -124,6 +158,8 @@ public:
     double dynamicFriction;
     double restitution;
     bool isJointLimitMode;
+    bool isGpuDynamicsEnabled;
+    bool isGpuBroadPhaseEnabled;
 
     PhysXSimulatorItemImpl(PhysXSimulatorItem* self);
     PhysXSimulatorItemImpl(PhysXSimulatorItem* self, const PhysXSimulatorItemImpl& org);
@@ -132,8 +168,10 @@ public:
     ~PhysXSimulatorItemImpl();
     void clear();
     bool initializeSimulation(const std::vector<SimulationBody*>& simBodies);
+    bool setGpuSceneDesc(PxSceneDesc& sceneDesc);
     bool stepSimulation(const std::vector<SimulationBody*>& activeSimBodies);
     void addBody(PhysXBody* physXBody);
+    void getActiveLinkStatesFromPhysX();
     void doPutProperties(PutPropertyFunction& putProperty);
     void store(Archive& archive);
     void restore(const Archive& archive);
@@ -601,7 +639,7 @@ void PhysXLink::setKinematicStateToPhysX()
 }
 
 
-void PhysXLink::getKinematicStateFromPhysX()
+void PhysXLink::getJointStateFromPhysX()
 {
     if(pxJoint){
         if(link->isRotationalJoint()){
@@ -614,29 +652,6 @@ void PhysXLink::getKinematicStateFromPhysX()
             link->dq() = joint->getVelocity();
         }
     }
-
-    PxTransform T = pxRigidActor->getGlobalPose();
-    PxVec3& p = T.p;
-    link->p() = Vector3(p[0], p[1], p[2]);
-    PxMat33 R(T.q);
-    link->R() << R(0,0), R(0,1), R(0,2),
-        R(1,0), R(1,1), R(1,2),
-        R(2,0), R(2,1), R(2,2);
-
-#ifdef VERSION_3_3_LATER
-    if(pxRigidActor->getType()==PxActorType::eRIGID_DYNAMIC){
-        PxRigidDynamic* actor = reinterpret_cast<PxRigidDynamic*>(pxRigidActor);
-        PxVec3 v = actor->getLinearVelocity();
-        PxVec3 w = actor->getAngularVelocity();
-#else
-    if(pxRigidActor->isRigidDynamic()){
-        PxVec3 v = pxRigidActor->isRigidDynamic()->getLinearVelocity();
-        PxVec3 w = pxRigidActor->isRigidDynamic()->getAngularVelocity();
-#endif
-        link->w() = Vector3(w[0], w[1], w[2]);
-        link->v() = Vector3(v[0], v[1], v[2]);
-    }
-
 }
 
 
@@ -859,10 +874,10 @@ void PhysXBody::setControlValToPhysX()
 }
 
 
-void PhysXBody::getKinematicStateFromPhysX()
+void PhysXBody::getJointStateFromPhysX()
 {
     for(size_t i=0; i < physXLinks.size(); ++i){
-        physXLinks[i]->getKinematicStateFromPhysX();
+        physXLinks[i]->getJointStateFromPhysX();
     }
 }
 
@@ -910,6 +925,8 @@ PhysXSimulatorItemImpl::PhysXSimulatorItemImpl(PhysXSimulatorItem* self)
     gravity << 0.0, 0.0, -DEFAULT_GRAVITY_ACCELERATION;
     
     isJointLimitMode = false;
+    isGpuDynamicsEnabled = false;
+    isGpuBroadPhaseEnabled = false;
     staticFriction = 0.5;
     dynamicFriction = 0.5;
     restitution = 0.1;
@@ -936,6 +953,8 @@ PhysXSimulatorItemImpl::PhysXSimulatorItemImpl(PhysXSimulatorItem* self, const P
     dynamicFriction = org.dynamicFriction;
     restitution = org.restitution;
     isJointLimitMode = org.isJointLimitMode;
+    isGpuDynamicsEnabled = org.isGpuDynamicsEnabled;
+    isGpuBroadPhaseEnabled = org.isGpuBroadPhaseEnabled;
 
 }
 
@@ -967,6 +986,9 @@ void PhysXSimulatorItemImpl::initialize()
     pxScene = 0;
     pxDispatcher = 0;
     pxMaterial = 0;
+#ifdef GPU_PHYSX_SUPPORTED
+    pxCudaContextManager = 0;
+#endif
 }
 
 
@@ -1027,6 +1049,12 @@ void PhysXSimulatorItemImpl::clear()
         pxDispatcher->release();
         pxDispatcher = 0;
     }
+#ifdef GPU_PHYSX_SUPPORTED
+    if(pxCudaContextManager){
+        pxCudaContextManager->release();
+        pxCudaContextManager = 0;
+    }
+#endif
 
 }    
 
@@ -1062,6 +1090,14 @@ bool PhysXSimulatorItemImpl::initializeSimulation(const std::vector<SimulationBo
     sceneDesc.contactModifyCallback = this;
     if(DEBUG_COLLISION)
         sceneDesc.simulationEventCallback = this;
+    sceneDesc.flags |= PxSceneFlag::eENABLE_ACTIVETRANSFORMS;
+
+    if(isGpuDynamicsEnabled || isGpuBroadPhaseEnabled){
+        if(!setGpuSceneDesc(sceneDesc)){
+            mv->putln(_("The GPU pipeline of PhysX is not available. The CPU pipeline is used instead."),
+                      MessageView::Warning);
+        }
+    }
 
     pxScene = pxPhysics->createScene(sceneDesc);
     if (!pxScene)
@@ -1081,6 +1117,34 @@ bool PhysXSimulatorItemImpl::initializeSimulation(const std::vector<SimulationBo
 }
 
 
+bool PhysXSimulatorItemImpl::setGpuSceneDesc(PxSceneDesc& sceneDesc)
+{
+#ifdef GPU_PHYSX_SUPPORTED
+    PxCudaContextManagerDesc cudaContextManagerDesc;
+    pxCudaContextManager = PxCreateCudaContextManager(*pxFoundation, cudaContextManagerDesc);
+    if(pxCudaContextManager && !pxCudaContextManager->contextIsValid()){
+        pxCudaContextManager->release();
+        pxCudaContextManager = 0;
+    }
+    if(!pxCudaContextManager){
+        return false;
+    }
+    sceneDesc.gpuDispatcher = pxCudaContextManager->getGpuDispatcher();
+    if(isGpuDynamicsEnabled){
+        // The GPU rigid body dynamics requires the persistent contact manifold
+        sceneDesc.flags |= PxSceneFlag::eENABLE_GPU_DYNAMICS;
+        sceneDesc.flags |= PxSceneFlag::eENABLE_PCM;
+    }
+    if(isGpuBroadPhaseEnabled){
+        sceneDesc.broadPhaseType = PxBroadPhaseType::eGPU;
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+
 void PhysXSimulatorItemImpl::addBody(PhysXBody* physXBody)
 {
     Body& body = *physXBody->body();
@@ -1186,14 +1250,18 @@ bool PhysXSimulatorItemImpl::stepSimulation(const std::vector<SimulationBody*>&
         physXBody->body()->setVirtualJointForces();
         physXBody->setControlValToPhysX();
     }
+    self->lapDynamicsStepPhase(SimulatorItem::StateInputPhase);
 
     pxScene->simulate(timeStep);
     pxScene->fetchResults(true);
+    self->lapDynamicsStepPhase(SimulatorItem::EngineStepPhase);
+
+    getActiveLinkStatesFromPhysX();
 
     for(size_t i=0; i < activeSimBodies.size(); ++i){
         PhysXBody* physXBody = static_cast<PhysXBody*>(activeSimBodies[i]);
 
-        physXBody->getKinematicStateFromPhysX();
+        physXBody->getJointStateFromPhysX();
 
         if(!physXBody->sensorHelper.forceSensors().empty()){
             physXBody->updateForceSensors();
@@ -1203,11 +1271,30 @@ bool PhysXSimulatorItemImpl::stepSimulation(const std::vector<SimulationBody*>&
             physXBody->sensorHelper.updateGyroAndAccelerationSensors();
         }
     }
+    self->lapDynamicsStepPhase(SimulatorItem::StateOutputPhase);
 
     return true;
 }
 
 
+/**
+   The poses of the actors moved in the step are obtained from the scene at once as the active
+   transforms instead of querying each actor, which also avoids reading the poses of the actors
+   that do not move. This is effective especially when the GPU pipeline is used.
+*/
+void PhysXSimulatorItemImpl::getActiveLinkStatesFromPhysX()
+{
+    PxU32 numActiveTransforms = 0;
+    const PxActiveTransform* activeTransforms = pxScene->getActiveTransforms(numActiveTransforms);
+    for(PxU32 i=0; i < numActiveTransforms; ++i){
+        const PxActiveTransform& transform = activeTransforms[i];
+        Link* link = (Link*)transform.userData;
+        setLinkPositionFromPhysX(link, transform.actor2World);
+        setLinkVelocityFromPhysX(link, transform.actor);
+    }
+}
+
+
 void PhysXSimulatorItem::doPutProperties(PutPropertyFunction& putProperty)
 {
     SimulatorItem::doPutProperties(putProperty);
@@ -1228,6 +1315,10 @@ void PhysXSimulatorItemImpl::doPutProperties(PutPropertyFunction& putProperty)
 
     putProperty(_("Limit joint range"), isJointLimitMode, changeProperty(isJointLimitMode));
 
+    putProperty(_("GPU dynamics"), isGpuDynamicsEnabled, changeProperty(isGpuDynamicsEnabled));
+
+    putProperty(_("GPU broad phase"), isGpuBroadPhaseEnabled, changeProperty(isGpuBroadPhaseEnabled));
+
 }
 
 
@@ -1245,6 +1336,8 @@ void PhysXSimulatorItemImpl::store(Archive& archive)
     archive.write("dynamicFriction", dynamicFriction);
     archive.write("Restitution", restitution);
     archive.write("jointLimitMode", isJointLimitMode);
+    archive.write("gpuDynamics", isGpuDynamicsEnabled);
+    archive.write("gpuBroadPhase", isGpuBroadPhaseEnabled);
 }
 
 
@@ -1264,4 +1357,6 @@ void PhysXSimulatorItemImpl::restore(const Archive& archive)
     archive.read("dynamicFriction", dynamicFriction);
     archive.read("Restitution", restitution);
     archive.read("jointLimitMode", isJointLimitMode);
+    archive.read("gpuDynamics", isGpuDynamicsEnabled);
+    archive.read("gpuBroadPhase", isGpuBroadPhaseEnabled);
 }
@@ -530,7 +530,17 @@ bool BodyMotionGenerationBar::shapeBodyMotionWithSimpleInterpolation
     auto motion = motionItem->motion();
     motion->setFrameRate(timeBar->frameRate());
 
-    bool result = poseProviderToBodyMotionConverter->convert(body, provider, *motion);
+    bool result;
+    if(auto interpolator = dynamic_cast<PoseSeqInterpolator*>(provider)){
+        // The interpolation data is updated before it is copied to the interpolators of the threads
+        interpolator->update();
+        result = poseProviderToBodyMotionConverter->convert(
+            body,
+            [interpolator](){ return std::make_shared<PoseSeqInterpolator>(*interpolator); },
+            *motion);
+    } else {
+        result = poseProviderToBodyMotionConverter->convert(body, provider, *motion);
+    }
     
     if(result){
         motionItem->notifyUpdate();
@@ -19,6 +19,7 @@
 #include <iostream>
 #include <algorithm>
 #include <unordered_map>
+#include <set>
 
 using namespace std;
 using namespace cnoid;
@@ -207,7 +208,8 @@ struct ZmpSample
         isDirty = true;
     }
 
-    ZmpSample(double time, const Vector3& p){
+    ZmpSample(double time, const Vector3& p)
+        : poseIter() {
         segmentType = UNDETERMINED;
         x = time;
         for(int i=0; i < 3; ++i){
@@ -256,6 +258,7 @@ class PSIImpl
 public:
 
     PSIImpl(PoseSeqInterpolator* self);
+    PSIImpl(PoseSeqInterpolator* self, const PSIImpl& org);
 
     PoseSeqInterpolator* self;
     BodyPtr body;
@@ -263,6 +266,15 @@ public:
 
     bool needUpdate;
 
+    /*
+      The samples of each joint, IK link and ZMP are called a channel. When poses are inserted,
+      removed or modified, only the channels of the poses are updated by the next update.
+    */
+    bool isChannelUpdateNeeded;
+    set<int> jointsToUpdate;
+    set<int> linksToUpdate;
+    bool isZmpUpdateNeeded;
+
     ConnectionSet poseSeqConnections;
 
     vector<JointInfo> jointInfos;
@@ -350,6 +362,8 @@ public:
     void calcIkJointPositionsSub(Link* link, Link* baseLink, LinkInfo* baseLinkInfo, bool doUpward, Link* prevLink);
     void appendPronun(PoseSeq::iterator poseIter);
     void appendLinkSamples(PoseSeq::iterator poseIter, PosePtr& pose);
+    void appendLinkSample(LinkInfo* linkInfo, PoseSeq::iterator poseIter, const Pose::LinkInfo& ikLinkInfo);
+    void appendJointSample(JointInfo& jointInfo, PoseSeq::iterator poseIter, Pose* pose, int jointId);
 
     inline bool checkZmp(const Vector3& zmp, const Vector3& centerZmp);
         
@@ -374,6 +388,13 @@ public:
     void adjustZmpAndFootKeyPoses();
     void insertAuxKeyPosesForStealthySteps();
     bool update();
+    void updateAllChannels();
+    void updateModifiedChannels();
+    void updateJointChannel(int jointId);
+    void updateLinkChannel(int linkIndex);
+    void updateZmpChannel();
+    void addChannelsToUpdate(PoseSeq::iterator it);
+    void clearChannelsToUpdate();
     LinkInfo* getIkLinkInfo(int linkIndex);
     void onPoseInserted(PoseSeq::iterator it);
     void onPoseRemoving(PoseSeq::iterator it, bool isMoving);
@@ -801,11 +822,95 @@ PSIImpl::PSIImpl(PoseSeqInterpolator* self)
     zmpMaxDistanceFromCenterSqr = 0.015 * 0.015;
 
     isStealthyStepMode = false;
+    stealthyHeightRatioThresh = 0.0;
+    flatLiftingHeight = 0.0;
+    flatLandingHeight = 0.0;
+    impactReductionHeight = 0.0;
+    impactReductionTime = 0.0;
     setStealthyStepParameters(2.0, 0.005, 0.005, 0.012, 0.3);
 
     isLipSyncMixEnabled = false;
     
     needUpdate = true;
+    clearChannelsToUpdate();
+}
+
+
+PoseSeqInterpolator::PoseSeqInterpolator(const PoseSeqInterpolator& org)
+{
+    impl = new PSIImpl(this, *org.impl);
+}
+
+
+/**
+   The copy has its own body and interpolation state. The updated interpolation data is copied,
+   and the iterators are reset to the copied data. The modification of the pose sequence is not
+   tracked by the copy.
+*/
+PSIImpl::PSIImpl(PoseSeqInterpolator* self, const PSIImpl& org)
+    : self(self),
+      poseSeq(org.poseSeq),
+      jointInfos(org.jointInfos),
+      ikLinkInfos(org.ikLinkInfos),
+      footLinkIndices(org.footLinkIndices),
+      soleCenters(org.soleCenters),
+      zmpSamples(org.zmpSamples),
+      lipSyncJoints(org.lipSyncJoints),
+      lipSyncLinkIndices(org.lipSyncLinkIndices),
+      lipSyncShapes(org.lipSyncShapes),
+      lipSyncSeq(org.lipSyncSeq),
+      validIkLinkFlag(org.validIkLinkFlag)
+{
+    if(org.body){
+        body = org.body->clone();
+    }
+    
+    isAutoZmpAdjustmentMode = org.isAutoZmpAdjustmentMode;
+    minZmpTransitionTime = org.minZmpTransitionTime;
+    zmpCenteringTimeThresh = org.zmpCenteringTimeThresh;
+    zmpTimeMarginBeforeLifting = org.zmpTimeMarginBeforeLifting;
+    zmpMaxDistanceFromCenterSqr = org.zmpMaxDistanceFromCenterSqr;
+    isStealthyStepMode = org.isStealthyStepMode;
+    stealthyHeightRatioThresh = org.stealthyHeightRatioThresh;
+    flatLiftingHeight = org.flatLiftingHeight;
+    flatLandingHeight = org.flatLandingHeight;
+    impactReductionHeight = org.impactReductionHeight;
+    impactReductionTime = org.impactReductionTime;
+    impactReductionVelocity = org.impactReductionVelocity;
+    isLipSyncMixEnabled = org.isLipSyncMixEnabled;
+    lipSyncMaxTransitionTime = org.lipSyncMaxTransitionTime;
+    timeScaleRatio = org.timeScaleRatio;
+    waistTranslation = org.waistTranslation;
+
+    for(auto& info : jointInfos){
+        info.iter = info.samples.begin();
+    }
+    for(auto& kv : ikLinkInfos){
+        auto& info = kv.second;
+        info.iter = info.samples.begin();
+        info.zIter = info.zSamples.begin();
+    }
+    for(auto& linkIndex : footLinkIndices){
+        auto p = ikLinkInfos.find(linkIndex);
+        if(p != ikLinkInfos.end() && p->second.isFootLink){
+            footLinkInfos.push_back(&p->second);
+        }
+    }
+    zmpIter = zmpSamples.begin();
+    lipSyncIter = lipSyncSeq.begin();
+    invalidateCurrentInterpolation();
+
+    needUpdate = org.needUpdate;
+    isChannelUpdateNeeded = org.isChannelUpdateNeeded;
+    jointsToUpdate = org.jointsToUpdate;
+    linksToUpdate = org.linksToUpdate;
+    isZmpUpdateNeeded = org.isZmpUpdateNeeded;
+}
+
+
+PoseSeqInterpolator::~PoseSeqInterpolator()
+{
+    delete impl;
 }
 
 
@@ -1013,28 +1118,43 @@ double PoseSeqInterpolator::endingTime() const
 }
 
 
+/*
+  The setters of the parameters only request the update when the parameters are changed so that
+  the update only for the modified poses is not replaced with the full update when the parameters
+  are set before every update.
+*/
 void PoseSeqInterpolator::enableAutoZmpAdjustmentMode(bool on)
 {
-    impl->isAutoZmpAdjustmentMode = on;
-    impl->needUpdate = true;
+    if(on != impl->isAutoZmpAdjustmentMode){
+        impl->isAutoZmpAdjustmentMode = on;
+        impl->needUpdate = true;
+    }
 }
 
 
 void PoseSeqInterpolator::setZmpAdjustmentParameters
 (double minTransitionTime, double centeringTimeThresh, double timeMarginBeforeLifting, double maxDistanceFromCenter)
 {
-    impl->minZmpTransitionTime = minTransitionTime;
-    impl->zmpCenteringTimeThresh = centeringTimeThresh;
-    impl->zmpTimeMarginBeforeLifting = timeMarginBeforeLifting;
-    impl->zmpMaxDistanceFromCenterSqr = maxDistanceFromCenter * maxDistanceFromCenter;
-    impl->needUpdate = true;
+    const double maxDistanceFromCenterSqr = maxDistanceFromCenter * maxDistanceFromCenter;
+    if(minTransitionTime != impl->minZmpTransitionTime ||
+       centeringTimeThresh != impl->zmpCenteringTimeThresh ||
+       timeMarginBeforeLifting != impl->zmpTimeMarginBeforeLifting ||
+       maxDistanceFromCenterSqr != impl->zmpMaxDistanceFromCenterSqr){
+        impl->minZmpTransitionTime = minTransitionTime;
+        impl->zmpCenteringTimeThresh = centeringTimeThresh;
+        impl->zmpTimeMarginBeforeLifting = timeMarginBeforeLifting;
+        impl->zmpMaxDistanceFromCenterSqr = maxDistanceFromCenterSqr;
+        impl->needUpdate = true;
+    }
 }
 
 
 void PoseSeqInterpolator::enableStealthyStepMode(bool on)
 {
-    impl->isStealthyStepMode = on;
-    impl->needUpdate = true;
+    if(on != impl->isStealthyStepMode){
+        impl->isStealthyStepMode = on;
+        impl->needUpdate = true;
+    }
 }
 
 
@@ -1054,6 +1174,14 @@ void PSIImpl::setStealthyStepParameters
  double flatLiftingHeight, double flatLandingHeight,
  double impactReductionHeight, double impactReductionTime)
 {
+    if(heightRatioThresh == this->stealthyHeightRatioThresh &&
+       flatLiftingHeight == this->flatLiftingHeight &&
+       flatLandingHeight == this->flatLandingHeight &&
+       impactReductionHeight == this->impactReductionHeight &&
+       impactReductionTime == this->impactReductionTime){
+        return;
+    }
+    
     this->stealthyHeightRatioThresh = heightRatioThresh;
     this->flatLiftingHeight = flatLiftingHeight;
     this->flatLandingHeight = flatLandingHeight;
@@ -1123,7 +1251,7 @@ bool PSIImpl::interpolate(double time, int waistLinkIndex, const Vector3& waistT
         return false;
     }
 
-    if(needUpdate){
+    if(needUpdate || isChannelUpdateNeeded){
         if(!update()){
             return false;
         }
@@ -1516,7 +1644,25 @@ bool PSIImpl::update()
     if(!body || !poseSeq){
         return false;
     }
+
+    if(!needUpdate && isChannelUpdateNeeded){
+        updateModifiedChannels();
+    } else {
+        updateAllChannels();
+    }
     
+    invalidateCurrentInterpolation();
+    needUpdate = false;
+    clearChannelsToUpdate();
+
+    sigUpdated();
+
+    return true;
+}
+
+
+void PSIImpl::updateAllChannels()
+{
     for(size_t i=0; i < jointInfos.size(); ++i){
         jointInfos[i].clear();
     }
@@ -1551,21 +1697,8 @@ bool PSIImpl::update()
             const int n = std::min(pose->numJoints(), (int)jointInfos.size());
 
             for(int i=0; i < n; ++i){
-                JointInfo& jointInfo = jointInfos[i];
                 if(pose->isJointValid(i)){
-
-                    // make a flipping point stationary point
-                    double q = pose->jointPosition(i);
-                    double sign = q - jointInfo.prev_q;
-                    if(jointInfo.prevSegmentDirectionSign * sign <= 0.0){
-                        if(!jointInfo.samples.empty()){
-                            jointInfo.samples.back().isEndPoint = true;
-                        }
-                    }
-                    jointInfo.prevSegmentDirectionSign = sign;
-                    jointInfo.prev_q = q;
-
-                    appendSample(jointInfo.samples, JointSample(poseIter, i, jointInfo.useLinearInterpolation));
+                    appendJointSample(jointInfos[i], poseIter, pose, i);
                 }
             }
             if(pose->isZmpValid()){
@@ -1606,13 +1739,105 @@ bool PSIImpl::update()
     zmpIter = zmpSamples.begin();
 
     lipSyncIter = lipSyncSeq.begin();
+}
 
-    invalidateCurrentInterpolation();
-    needUpdate = false;
 
-    sigUpdated();
+void PSIImpl::appendJointSample(JointInfo& jointInfo, PoseSeq::iterator poseIter, Pose* pose, int jointId)
+{
+    // make a flipping point stationary point
+    double q = pose->jointPosition(jointId);
+    double sign = q - jointInfo.prev_q;
+    if(jointInfo.prevSegmentDirectionSign * sign <= 0.0){
+        if(!jointInfo.samples.empty()){
+            jointInfo.samples.back().isEndPoint = true;
+        }
+    }
+    jointInfo.prevSegmentDirectionSign = sign;
+    jointInfo.prev_q = q;
 
-    return true;
+    appendSample(jointInfo.samples, JointSample(poseIter, jointId, jointInfo.useLinearInterpolation));
+}
+
+
+/**
+   The samples of each channel only depend on the poses having the channel, so a channel is updated
+   by appending the samples from the poses again in the same way as the full update.
+*/
+void PSIImpl::updateModifiedChannels()
+{
+    for(auto& jointId : jointsToUpdate){
+        updateJointChannel(jointId);
+    }
+    for(auto& linkIndex : linksToUpdate){
+        updateLinkChannel(linkIndex);
+    }
+    if(isZmpUpdateNeeded){
+        updateZmpChannel();
+    }
+}
+
+
+void PSIImpl::updateJointChannel(int jointId)
+{
+    if(jointId >= static_cast<int>(jointInfos.size())){
+        return;
+    }
+    JointInfo& info = jointInfos[jointId];
+    info.clear();
+    for(PoseSeq::iterator poseIter = poseSeq->begin(); poseIter != poseSeq->end(); ++poseIter){
+        if(auto pose = poseIter->get<Pose>()){
+            if(pose->isJointValid(jointId)){
+                appendJointSample(info, poseIter, pose, jointId);
+            }
+        }
+    }
+    if(!info.useLinearInterpolation){
+        initializeInterpolation<1, JointSample, false>(info.samples);
+    }
+    info.iter = info.samples.begin();
+}
+
+
+void PSIImpl::updateLinkChannel(int linkIndex)
+{
+    LinkInfo* info = getIkLinkInfo(linkIndex);
+    if(!info){
+        return;
+    }
+    info->samples.clear();
+    info->zSamples.clear();
+    for(PoseSeq::iterator poseIter = poseSeq->begin(); poseIter != poseSeq->end(); ++poseIter){
+        if(auto pose = poseIter->get<Pose>()){
+            if(auto ikLinkInfo = pose->ikLinkInfo(linkIndex)){
+                appendLinkSample(info, poseIter, *ikLinkInfo);
+            }
+        }
+    }
+    if(info->samples.empty() && !info->isFootLink){
+        ikLinkInfos.erase(linkIndex);
+        return;
+    }
+    initializeInterpolation<6, LinkSample, false>(info->samples);
+    info->iter = info->samples.begin();
+    if(info->isFootLink){
+        initializeInterpolation<1, LinkZSample, false>(info->zSamples);
+        info->zIter = info->zSamples.begin();
+    }
+}
+
+
+void PSIImpl::updateZmpChannel()
+{
+    zmpSamples.clear();
+    for(PoseSeq::iterator poseIter = poseSeq->begin(); poseIter != poseSeq->end(); ++poseIter){
+        if(auto pose = poseIter->get<Pose>()){
+            if(pose->isZmpValid()){
+                appendSample(zmpSamples, ZmpSample(poseIter));
+            }
+        }
+    }
+    initializeInterpolation<3, ZmpSample, false>(zmpSamples);
+    zmpIter = zmpSamples.begin();
 }
 
 
@@ -1622,22 +1847,26 @@ void PSIImpl::appendLinkSamples(PoseSeq::iterator poseIter, PosePtr& pose)
         const int linkIndex = it->first;
         LinkInfo* linkInfo = getIkLinkInfo(linkIndex);
         if(linkInfo){
-            const Pose::LinkInfo& ikLinkInfo = it->second;
-    
-            LinkSample::Seq& samples = linkInfo->samples;
-            applyMaxTransitionTime<LinkSample>(samples, poseIter);
-            samples.push_back(LinkSample(poseIter, ikLinkInfo));
-
-            if(linkInfo->isFootLink){
-                LinkZSample::Seq& zSamples = linkInfo->zSamples;
-                applyMaxTransitionTime<LinkZSample>(zSamples, poseIter);
-                zSamples.push_back(LinkZSample(poseIter, ikLinkInfo));
-            }
+            appendLinkSample(linkInfo, poseIter, it->second);
         }
     }
 }
 
 
+void PSIImpl::appendLinkSample(LinkInfo* linkInfo, PoseSeq::iterator poseIter, const Pose::LinkInfo& ikLinkInfo)
+{
+    LinkSample::Seq& samples = linkInfo->samples;
+    applyMaxTransitionTime<LinkSample>(samples, poseIter);
+    samples.push_back(LinkSample(poseIter, ikLinkInfo));
+
+    if(linkInfo->isFootLink){
+        LinkZSample::Seq& zSamples = linkInfo->zSamples;
+        applyMaxTransitionTime<LinkZSample>(zSamples, poseIter);
+        zSamples.push_back(LinkZSample(poseIter, ikLinkInfo));
+    }
+}
+
+
 inline bool PSIImpl::checkZmp(const Vector3& zmp, const Vector3& centerZmp)
 {
     return (zmp - centerZmp).squaredNorm() <= zmpMaxDistanceFromCenterSqr;
@@ -2198,17 +2427,89 @@ LinkInfo* PSIImpl::getIkLinkInfo(int linkIndex)
 
 void PSIImpl::onPoseInserted(PoseSeq::iterator it)
 {
-    needUpdate = true;
+    addChannelsToUpdate(it);
 }
 
 
 void PSIImpl::onPoseRemoving(PoseSeq::iterator it, bool isMoving)
 {
-    needUpdate = true;
+    addChannelsToUpdate(it);
 }
 
 
 void PSIImpl::onPoseModified(PoseSeq::iterator it)
 {
-    needUpdate = true;
+    addChannelsToUpdate(it);
+}
+
+
+/**
+   The channels that have the samples of the pose and the channels that the pose currently has
+   are updated. The full update is done when the pose affects the samples beyond its channels,
+   which are the lip sync samples, and the ZMP and foot link samples adjusted by the auto ZMP
+   adjustment and the stealthy step modes.
+*/
+void PSIImpl::addChannelsToUpdate(PoseSeq::iterator it)
+{
+    if(needUpdate){
+        return;
+    }
+    auto pose = it->get<Pose>();
+    if(!pose){
+        needUpdate = true;
+        return;
+    }
+    const bool isFootAdjustmentEnabled = (isAutoZmpAdjustmentMode || isStealthyStepMode) && !footLinkIndices.empty();
+    
+    const int numJoints = jointInfos.size();
+    for(int i=0; i < numJoints; ++i){
+        if(pose->isJointValid(i)){
+            jointsToUpdate.insert(i);
+        } else {
+            auto& samples = jointInfos[i].samples;
+            if(std::find_if(samples.begin(), samples.end(),
+                            [it](const JointSample& sample){ return sample.poseIter == it; }) != samples.end()){
+                jointsToUpdate.insert(i);
+            }
+        }
+    }
+    for(auto p = pose->ikLinkBegin(); p != pose->ikLinkEnd(); ++p){
+        linksToUpdate.insert(p->first);
+    }
+    for(auto& kv : ikLinkInfos){
+        auto& samples = kv.second.samples;
+        if(std::find_if(samples.begin(), samples.end(),
+                        [it](const LinkSample& sample){ return sample.poseIter == it; }) != samples.end()){
+            linksToUpdate.insert(kv.first);
+        }
+    }
+    if(pose->isZmpValid() ||
+       std::find_if(zmpSamples.begin(), zmpSamples.end(),
+                    [it](const ZmpSample& sample){ return sample.poseIter == it; }) != zmpSamples.end()){
+        isZmpUpdateNeeded = true;
+    }
+
+    if(isFootAdjustmentEnabled){
+        if(isZmpUpdateNeeded){
+            needUpdate = true;
+        } else {
+            for(auto& linkIndex : footLinkIndices){
+                if(linksToUpdate.find(linkIndex) != linksToUpdate.end()){
+                    needUpdate = true;
+                    break;
+                }
+            }
+        }
+    }
+    
+    isChannelUpdateNeeded = true;
+}
+
+
+void PSIImpl::clearChannelsToUpdate()
+{
+    isChannelUpdateNeeded = false;
+    jointsToUpdate.clear();
+    linksToUpdate.clear();
+    isZmpUpdateNeeded = false;
 }
@@ -22,6 +22,15 @@ class CNOID_EXPORT PoseSeqInterpolator : public PoseProvider
 public:
     PoseSeqInterpolator();
 
+    /**
+       The copy can interpolate the pose sequence independently of the original, so the copies
+       can be used to evaluate the sequence in parallel threads. The copy does not track the
+       modifications of the pose sequence, and the update function must be called when the
+       sequence is modified.
+    */
+    PoseSeqInterpolator(const PoseSeqInterpolator& org);
+    ~PoseSeqInterpolator();
+
     void setBody(Body* body);
     Body* body() const;
 
@@ -57,6 +66,10 @@ public:
     */
     void setAutoUpdateMode(bool on);
             
+    /**
+       When only some poses have been inserted, removed or modified since the last update, only the
+       joints, the IK links and the ZMP of the poses are updated. Otherwise all of them are updated.
+    */
     bool update();
 
     SignalProxy<void()> sigUpdated();
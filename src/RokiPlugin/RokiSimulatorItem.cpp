@@ -158,7 +158,7 @@ public:
     void createLink(RokiSimulatorItemImpl* simImpl, RokiBody* body, const Vector3& origin, bool stuffisLinkName);
     void createGeometry();
     void addMesh(MeshExtractor* extractor);
-    void getKinematicStateFromRoki();
+    void getKinematicStateFromRoki(const double* dis, const double* v);
     void setKinematicStateToRoki(zVec dis, int k);
     void setTorqueToRoki();
 };
@@ -176,6 +176,9 @@ public:
     int geometryId;
     RokiLinkMap rokiLinkMap;
     vector<RokiBreakLinkTraverse> linkTraverseList;
+    vector<int> linkOffsets;
+    zVec jointDis;
+    zVec jointVel;
 
     RokiBody(const Body& orgBody);
     ~RokiBody();
@@ -698,13 +701,12 @@ RokiLink::~RokiLink()
 }
 
 
-void RokiLink::getKinematicStateFromRoki()
+/**
+   \param dis The joint displacements of the link in the whole joint displacement vector of the chain
+   \param v The joint velocities of the link in the whole joint velocity vector of the chain
+*/
+void RokiLink::getKinematicStateFromRoki(const double* dis, const double* v)
 {
-    double dis[6];
-    double v[6];
-    rkLinkGetJointDis( rklink, dis );
-    rkLinkGetJointVel( rklink, v);
-
     switch(link->jointType()){
         case Link::ROTATIONAL_JOINT:
         case Link::SLIDE_JOINT:
@@ -791,6 +793,8 @@ RokiBody::RokiBody(const Body& orgBody)
     Body* body = this->body();
     rokiLinkMap.clear();
     linkTraverseList.clear();
+    jointDis = nullptr;
+    jointVel = nullptr;
 }
 
 
@@ -799,6 +803,10 @@ RokiBody::~RokiBody()
     rokiLinks.clear();
     rokiLinkMap.clear();
     linkTraverseList.clear();
+    if(jointDis){
+        zVecFree(jointDis);
+        zVecFree(jointVel);
+    }
     rkChainDestroy( chain );
 }
 
@@ -832,6 +840,13 @@ void RokiBody::createBody(RokiSimulatorItemImpl* simImpl, bool stuffisLinkName)
     if(size){
         _rkFDCellPush( &simImpl->fd, lc );
 
+        jointDis = zVecAlloc(size);
+        jointVel = zVecAlloc(size);
+        linkOffsets.resize(rokiLinks.size());
+        for(size_t i=0; i < rokiLinks.size(); ++i){
+            linkOffsets[i] = rkChainLinkOffset(chain, rokiLinks[i]->link->index());
+        }
+
         for(int i=0; i<rokiLinks.size(); i++){
             RokiLink* rokiLink = rokiLinks[i].get();
             if(rokiLink->isCrawler){
@@ -859,10 +874,20 @@ void RokiBody::createBody(RokiSimulatorItemImpl* simImpl, bool stuffisLinkName)
 }
 
 
+/**
+   The joint states of the whole chain are copied at once instead of getting the state of each joint.
+*/
 void RokiBody::getKinematicStateFromRoki()
 {
-    for(size_t i=0; i < rokiLinks.size(); ++i){
-        rokiLinks[i]->getKinematicStateFromRoki();
+    if(jointDis){
+        rkChainGetJointDisAll(chain, jointDis);
+        rkChainGetJointVelAll(chain, jointVel);
+        for(size_t i=0; i < rokiLinks.size(); ++i){
+            const int k = linkOffsets[i];
+            if(k >= 0){
+                rokiLinks[i]->getKinematicStateFromRoki(&zVecElem(jointDis, k), &zVecElem(jointVel, k));
+            }
+        }
     }
 
     for(int i=0; i<linkTraverseList.size(); i++){
@@ -1130,10 +1155,12 @@ bool RokiSimulatorItemImpl::stepSimulation(const std::vector<SimulationBody*>& a
         RokiBody* rokiBody = static_cast<RokiBody*>(activeSimBodies[i]);
         rokiBody->setTorqueToRoki();
     }
+    self->lapDynamicsStepPhase(SimulatorItem::StateInputPhase);
 
     timer.start();
     rkFDUpdate( &fd );
     simulationTime += timer.nsecsElapsed();
+    self->lapDynamicsStepPhase(SimulatorItem::EngineStepPhase);
 
 
     for(size_t i=0; i < activeSimBodies.size(); i++){
@@ -1147,6 +1174,7 @@ bool RokiSimulatorItemImpl::stepSimulation(const std::vector<SimulationBody*>& a
             rokiBody->sensorHelper.updateGyroAndAccelerationSensors();
         }
     }
+    self->lapDynamicsStepPhase(SimulatorItem::StateOutputPhase);
 
     return true;
 }
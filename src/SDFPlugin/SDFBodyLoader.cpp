@@ -13,6 +13,7 @@
 #include <cnoid/SceneLoader>
 #include <cnoid/MeshGenerator>
 #include <cnoid/ImageIO>
+#include <cnoid/ImageCache>
 #include <cnoid/Exception>
 #include <cnoid/MessageView>
 #include <cnoid/WorldItem>
@@ -30,6 +31,9 @@
 #include <boost/algorithm/string.hpp>
 #include <fmt/format.h>
 #include <map>
+#include <mutex>
+#include <fstream>
+#include <sstream>
 #include "gettext.h"
 
 using namespace std;
@@ -55,6 +59,87 @@ double getLimitValue(double val, double defaultValue)
     return val;
 }
 
+/*
+   The parsed SDF files are shared by all the loaders so that a file loaded many times is parsed
+   only once. A parsed file is used while the file is not modified. A file including other files
+   is not shared because the modification of the included files cannot be detected from the
+   stamp of the file. The shared files are released by SceneLoader::clearSharedScenes().
+*/
+struct ParsedSDF
+{
+    sdf::SDFPtr sdf;
+    uintmax_t fileSize;
+    time_t fileTime;
+};
+std::map<std::string, ParsedSDF> parsedSDFMap;
+std::mutex parsedSDFMutex;
+
+bool getFileStamp(const string& filename, uintmax_t& out_size, time_t& out_time)
+{
+    filesystem::path path(fromUTF8(filename));
+    stdx::error_code ec;
+    out_size = filesystem::file_size(path, ec);
+    if(ec){
+        return false;
+    }
+    try {
+        out_time = filesystem::last_write_time_to_time_t(path);
+    }
+    catch(...){
+        return false;
+    }
+    return true;
+}
+
+bool hasIncludeElements(const string& filename)
+{
+    ifstream ifs(fromUTF8(filename).c_str(), ios::in | ios::binary);
+    if(!ifs){
+        return true;
+    }
+    stringstream ss;
+    ss << ifs.rdbuf();
+    return ss.str().find("<include") != string::npos;
+}
+
+void clearParsedSDFFiles()
+{
+    lock_guard<mutex> lock(parsedSDFMutex);
+    parsedSDFMap.clear();
+}
+
+sdf::SDFPtr readSDFFile(const std::string& filename)
+{
+    uintmax_t fileSize;
+    time_t fileTime;
+    string key;
+    if(getFileStamp(filename, fileSize, fileTime)){
+        stdx::error_code ec;
+        key = toUTF8(filesystem::absolute(fromUTF8(filename), ec).string());
+        lock_guard<mutex> lock(parsedSDFMutex);
+        auto p = parsedSDFMap.find(key);
+        if(p != parsedSDFMap.end()){
+            if(p->second.fileSize == fileSize && p->second.fileTime == fileTime){
+                return p->second.sdf;
+            }
+            parsedSDFMap.erase(p);
+        }
+    }
+
+    sdf::SDFPtr sdf(new sdf::SDF());
+    sdf::init(sdf);
+    if(!sdf::readFile(filename, sdf)){ // this can read both SDF and URDF
+        return nullptr;
+    }
+    if(!key.empty() && !hasIncludeElements(filename)){
+        static Connection clearConnection =
+            SceneLoader::sigSharedScenesCleared().connect([](){ clearParsedSDFFiles(); });
+        lock_guard<mutex> lock(parsedSDFMutex);
+        parsedSDFMap[key] = ParsedSDF{ sdf, fileSize, fileTime };
+    }
+    return sdf;
+}
+
 }
 
 namespace cnoid {
@@ -267,6 +352,11 @@ public:
     bool isVerbose;
     typedef std::map<std::string, SgImagePtr> ImagePathToSgImageMap;
     ImagePathToSgImageMap imagePathToSgImageMap;
+    struct DaeAssetInfo {
+        float scale;
+        string upAxis;
+    };
+    std::map<std::string, DaeAssetInfo> daeAssetInfoMap;
     SceneLoader sceneLoader;
     MeshGenerator meshGenerator;
 
@@ -276,6 +366,7 @@ public:
     ~SDFBodyLoaderImpl();
     void pos3dToIsometry3(const ignition::math::Pose3d& pose, cnoid::Isometry3& out);
 
+    void clearLoadCaches();
     void readSDF(const std::string& filename, vector<ModelInfoPtr>& modelInfos);
 
     bool load(Body* body, const std::string& filename);
@@ -622,6 +713,9 @@ SDFBodyLoaderImpl::SDFBodyLoaderImpl()
     isVerbose = false;
     os_ = &nullout();
 
+    // The models included in worlds many times share the same mesh files
+    sceneLoader.setSceneSharingEnabled(true);
+
     gazeboColor = new SDFLoaderPseudoGazeboColor;
 
 }
@@ -678,6 +772,7 @@ bool SDFBodyLoaderImpl::load(BodyItem* item, const std::string& filename)
 {
     vector<ModelInfoPtr> models;
 
+    clearLoadCaches();
     try{
         readSDF(filename, models);
     } catch(const std::exception& ex){
@@ -728,17 +823,20 @@ bool SDFBodyLoaderImpl::load(BodyItem* item, const std::string& filename)
 }
 
 
-void  SDFBodyLoaderImpl::readSDF(const std::string& filename, vector<ModelInfoPtr>& models)
+void SDFBodyLoaderImpl::clearLoadCaches()
 {
     imagePathToSgImageMap.clear();
-    
+    daeAssetInfoMap.clear();
+}
+
+
+void  SDFBodyLoaderImpl::readSDF(const std::string& filename, vector<ModelInfoPtr>& models)
+{
     try {
         sdf::ElementPtr root = NULL;
 
-        sdf::SDFPtr sdf(new sdf::SDF());
-        sdf::init(sdf);
-
-        if (sdf::readFile(filename, sdf) == false) {  // this can read both SDF and URDF
+        sdf::SDFPtr sdf = readSDFFile(filename);
+        if (!sdf) {
             throw std::invalid_argument("load failed");
         }
         root = sdf->Root();
@@ -1088,26 +1186,33 @@ GeometryInfo* SDFBodyLoaderImpl::readGeometry(sdf::ElementPtr geometry)
                 float scale0 = 1;
 
                 if (boost::algorithm::iends_with(urllower, "dae")){
-                    TiXmlDocument xmlDoc;
-                    xmlDoc.LoadFile(url);
                     string dae_axis = "Y_UP";
-                    if(!xmlDoc.Error()) {
-                        TiXmlElement * colladaXml = xmlDoc.FirstChildElement("COLLADA");
-                        if(colladaXml) {
-                            TiXmlElement *assetXml = colladaXml->FirstChildElement("asset");
-                            if(assetXml) {
-                                TiXmlElement *unitXml = assetXml->FirstChildElement("unit");
-                                if (unitXml && unitXml->Attribute("meter") &&
-                                    unitXml->QueryFloatAttribute("meter", &scale0) == TIXML_SUCCESS) {
-                                }
-                                TiXmlElement *up_axisXml = assetXml->FirstChildElement("up_axis");
-                                if (up_axisXml) {
-                                    dae_axis = up_axisXml->GetText();
+                    auto p = daeAssetInfoMap.find(url);
+                    if(p != daeAssetInfoMap.end()){
+                        scale0 = p->second.scale;
+                        dae_axis = p->second.upAxis;
+                    } else {
+                        TiXmlDocument xmlDoc;
+                        xmlDoc.LoadFile(url);
+                        if(!xmlDoc.Error()) {
+                            TiXmlElement * colladaXml = xmlDoc.FirstChildElement("COLLADA");
+                            if(colladaXml) {
+                                TiXmlElement *assetXml = colladaXml->FirstChildElement("asset");
+                                if(assetXml) {
+                                    TiXmlElement *unitXml = assetXml->FirstChildElement("unit");
+                                    if (unitXml && unitXml->Attribute("meter") &&
+                                        unitXml->QueryFloatAttribute("meter", &scale0) == TIXML_SUCCESS) {
+                                    }
+                                    TiXmlElement *up_axisXml = assetXml->FirstChildElement("up_axis");
+                                    if (up_axisXml) {
+                                        dae_axis = up_axisXml->GetText();
+                                    }
                                 }
                             }
+                        }else{
+                            cout << xmlDoc.ErrorDesc() << endl;
                         }
-                    }else{
-                        cout << xmlDoc.ErrorDesc() << endl;
+                        daeAssetInfoMap[url] = DaeAssetInfo{ scale0, dae_axis };
                     }
 
                     SgNode* node = sceneLoader.load(url);
@@ -1473,6 +1578,7 @@ bool SDFBodyLoaderImpl::load(Body* body, const std::string& filename)
 {
     vector<ModelInfoPtr> models;
 
+    clearLoadCaches();
     try{
         readSDF(filename, models);
     } catch(const std::exception& ex){
@@ -1600,17 +1706,15 @@ SgTexture* SDFBodyLoaderImpl::convertTexture(MaterialInfo* material, const strin
     string textureFile = texturePath + "/" + textureName;
     ImagePathToSgImageMap::iterator p = imagePathToSgImageMap.find(textureFile);
 
-    SgImage* image;
+    SgImage* image = nullptr;
     if(p != imagePathToSgImageMap.end()){
         image = p->second;
     } else {
-        image = new SgImage;
         ImageIO imageIO;
         imageIO.setUpsideDown(true);
-        if(imageIO.load(image->image(), textureFile)){
+        if(auto loaded = ImageCache::instance()->load(textureFile, imageIO, nullout())){
+            image = new SgImage(loaded);
             imagePathToSgImageMap[textureFile] = image;
-        } else {
-            image = nullptr;
         }
     }
 
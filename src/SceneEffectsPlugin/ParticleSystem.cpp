@@ -21,6 +21,7 @@ ParticleSystem::ParticleSystem()
     initialSpeedVariation_ = 0.1f;
     emissionRange_ = PI / 3.0f;
     acceleration_.setZero();
+    isCollisionEnabled_ = false;
 }
 
 
@@ -35,6 +36,7 @@ ParticleSystem::ParticleSystem(const ParticleSystem& org)
     initialSpeedVariation_ = org.initialSpeedVariation_;
     emissionRange_ = org.emissionRange_;
     acceleration_ = org.acceleration_;
+    isCollisionEnabled_ = org.isCollisionEnabled_;
 }
 
 
@@ -54,6 +56,7 @@ void ParticleSystem::readParameters(const Mapping* info)
     info->read({ "initial_speed_variation", "initialSpeedVariation" }, initialSpeedVariation_);
     info->readAngle({ "emission_range", "emissionRange" }, emissionRange_);
     read(info, "acceleration", acceleration_);
+    info->read("collision", isCollisionEnabled_);
 }
 
 
@@ -67,5 +70,8 @@ void ParticleSystem::writeParameters(Mapping* info) const
     info->write("initial_speed_variation", initialSpeedVariation_);
     info->write("emission_range", degree(emissionRange_));
     write(info, "acceleration", acceleration_);
+    if(isCollisionEnabled_){
+        info->write("collision", true);
+    }
 }
    
@@ -45,6 +45,13 @@ public:
     const Vector3f& acceleration() const { return acceleration_; }
     void setAcceleration(const Vector3f& a){ acceleration_ = a; }
 
+    /**
+       When this is enabled, the particles that support the collision keep their states on the GPU
+       and stop at the surfaces of the scene. Currently rain and snow support it.
+    */
+    bool isCollisionEnabled() const { return isCollisionEnabled_; }
+    void setCollisionEnabled(bool on) { isCollisionEnabled_ = on; }
+
     void readParameters(const Mapping* info);
     void writeParameters(Mapping* info) const;
 
@@ -58,6 +65,7 @@ private:
     float initialSpeedVariation_;
     float emissionRange_;
     Vector3f acceleration_;
+    bool isCollisionEnabled_;
 };
 
 }
@@ -136,6 +136,7 @@ void ParticlesProgramBase::render
     glUniform1i(particleTexLocation, 0);
 
     globalAttitude_ = position.linear().cast<float>();
+    globalPosition_ = position;
     renderingFunction();
 
     renderer_->popShaderProgram();
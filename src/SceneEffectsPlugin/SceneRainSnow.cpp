@@ -9,27 +9,70 @@
 #include <cnoid/SceneNodeClassRegistry>
 #include <cnoid/MathUtil>
 #include <cnoid/GLSLProgram>
+#include <cnoid/MeshExtractor>
+#include <cnoid/SceneDrawables>
+#include <cnoid/BoundingBox>
+#include <cnoid/MessageView>
+#include <fmt/format.h>
+#include <limits>
+#include "gettext.h"
 
 using namespace std;
 using namespace cnoid;
 
 namespace {
 
+const int HeightFieldResolution = 256;
+
 class RainSnowProgram : public ParticlesProgram
 {
 public:
     RainSnowProgram(GLSLSceneRenderer* renderer);
     virtual bool initializeRendering(SceneParticles* particles) override;
+    bool initializeStateBuffers();
+    void resetStates(SceneRainSnowBase* particles, float time);
+    void createHeightField(SceneRainSnowBase* particles);
+    void updateStates(SceneRainSnowBase* particles, float time);
     void render(SceneRainSnowBase* particles);
 
     GLint velocityLocation;
     GLint lifeTimeLocation;
+    GLint isStateBufferEnabledLocation;
 
     GLfloat lifeTime;
     GLuint numParticles;
     GLuint initPosBuffer;
     GLuint offsetTimeBuffer;
     GLuint vertexArray;
+
+    /*
+      The following variables are used when the collision is enabled. The particle states are
+      updated by the transform feedback of the update program with the two state buffers used
+      alternately.
+    */
+    bool isStateBufferEnabled;
+    GLSLProgram updateProgram;
+    GLint deltaTimeLocation;
+    GLint updateVelocityLocation;
+    GLint topLocation;
+    GLint bottomLocation;
+    GLint restTimeLocation;
+    GLint localToWorldLocation;
+    GLint worldToLocalLocation;
+    GLint heightFieldLocation;
+    GLint heightFieldOriginLocation;
+    GLint heightFieldSizeLocation;
+    vector<GLfloat> initPositions;
+    vector<GLfloat> offsetTimes;
+    GLuint stateBuffers[2];
+    GLuint stateVertexArrays[2];
+    int currentStateIndex;
+    bool isStateInitialized;
+    float lastTime;
+    GLuint heightFieldTexture;
+    bool isHeightFieldReady;
+    Vector2f heightFieldOrigin;
+    Vector2f heightFieldSize;
 };
 
 struct Registration {
@@ -53,6 +96,7 @@ SceneRainSnowBase::SceneRainSnowBase(int classId)
     radius_ = 10.0f;
     top_ = 10.0f;
     bottom_ = 0.0f;
+    restTime_ = 0.0f;
 }
 
 
@@ -62,6 +106,7 @@ SceneRainSnowBase::SceneRainSnowBase(const SceneRainSnowBase& org)
     radius_ = org.radius_;
     top_ = org.top_;
     bottom_ = org.bottom_;
+    restTime_ = org.restTime_;
     velocity_ = org.velocity_;
 }
 
@@ -76,6 +121,7 @@ SceneRain::SceneRain()
     : SceneRainSnowBase(findClassId<SceneRain>())
 {
     setVelocity(Vector3f(0.0f, 0.0f, -5.0f));
+    setRestTime(0.05f);
     setTexture(":/SceneEffectsPlugin/texture/rain.png");
 }
 
@@ -97,6 +143,7 @@ SceneSnow::SceneSnow()
     : SceneRainSnowBase(findClassId<SceneSnow>())
 {
     setVelocity(Vector3f(0.0f, 0.0f, -0.3f));
+    setRestTime(3.0f);
     setTexture(":/SceneEffectsPlugin/texture/snow.png");
 }
 
@@ -154,8 +201,12 @@ bool RainSnowProgram::initializeRendering(SceneParticles* particles)
     glGenBuffers(1, &initPosBuffer);
     glBindBuffer(GL_ARRAY_BUFFER, initPosBuffer);
     glBufferData(GL_ARRAY_BUFFER, data.size() * sizeof(float), &data.front(), GL_STATIC_DRAW);
+    if(ps.isCollisionEnabled()){
+        initPositions = data;
+    }
 
     // Offset time buffer
+    numParticles = ps.numParticles();
     data.resize(ps.numParticles());
     lifeTime = fabsf((rs->top() - rs->bottom()) / rs->velocity().z());
     float rate = lifeTime / ps.numParticles();
@@ -168,6 +219,9 @@ bool RainSnowProgram::initializeRendering(SceneParticles* particles)
     glBindBuffer(GL_ARRAY_BUFFER, offsetTimeBuffer);
     glBufferData(GL_ARRAY_BUFFER, data.size() * sizeof(float), &data.front(), GL_STATIC_DRAW);
     glBindBuffer(GL_ARRAY_BUFFER, 0);
+    if(ps.isCollisionEnabled()){
+        offsetTimes = data;
+    }
 
     // Vertex arrays
     glGenVertexArrays(1, &vertexArray);
@@ -183,20 +237,257 @@ bool RainSnowProgram::initializeRendering(SceneParticles* particles)
     auto& glsl = glslProgram();
     velocityLocation = glsl.getUniformLocation("velocity");
     lifeTimeLocation = glsl.getUniformLocation("lifeTime");
+    isStateBufferEnabledLocation = glsl.getUniformLocation("isStateBufferEnabled");
+
+    isStateBufferEnabled = false;
+    if(ps.isCollisionEnabled()){
+        isStateBufferEnabled = initializeStateBuffers();
+    }
 
     return true;
 }
 
 
+bool RainSnowProgram::initializeStateBuffers()
+{
+    try {
+        updateProgram.loadShader(":/SceneEffectsPlugin/shader/RainSnowUpdate.vert", GL_VERTEX_SHADER);
+        const GLchar* varyings[] = { "newState" };
+        glTransformFeedbackVaryings(updateProgram.handle(), 1, varyings, GL_INTERLEAVED_ATTRIBS);
+        updateProgram.link();
+    }
+    catch(const std::runtime_error& ex){
+        MessageView::instance()->putln(
+            fmt::format(_("The collision of the particles is disabled because the update program is not available: {0}"),
+                        ex.what()),
+            MessageView::Warning);
+        updateProgram.release();
+        return false;
+    }
+
+    deltaTimeLocation = updateProgram.getUniformLocation("deltaTime");
+    updateVelocityLocation = updateProgram.getUniformLocation("velocity");
+    topLocation = updateProgram.getUniformLocation("top");
+    bottomLocation = updateProgram.getUniformLocation("bottom");
+    restTimeLocation = updateProgram.getUniformLocation("restTime");
+    localToWorldLocation = updateProgram.getUniformLocation("localToWorld");
+    worldToLocalLocation = updateProgram.getUniformLocation("worldToLocal");
+    heightFieldLocation = updateProgram.getUniformLocation("heightField");
+    heightFieldOriginLocation = updateProgram.getUniformLocation("heightFieldOrigin");
+    heightFieldSizeLocation = updateProgram.getUniformLocation("heightFieldSize");
+
+    glGenBuffers(2, stateBuffers);
+    glGenVertexArrays(2, stateVertexArrays);
+    for(int i=0; i < 2; ++i){
+        glBindBuffer(GL_ARRAY_BUFFER, stateBuffers[i]);
+        glBufferData(GL_ARRAY_BUFFER, numParticles * 4 * sizeof(float), nullptr, GL_DYNAMIC_COPY);
+
+        glBindVertexArray(stateVertexArrays[i]);
+        glBindBuffer(GL_ARRAY_BUFFER, initPosBuffer);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, NULL);
+        glEnableVertexAttribArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, offsetTimeBuffer);
+        glVertexAttribPointer(1, 1, GL_FLOAT, GL_FALSE, 0, NULL);
+        glEnableVertexAttribArray(1);
+        glBindBuffer(GL_ARRAY_BUFFER, stateBuffers[i]);
+        glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, 0, NULL);
+        glEnableVertexAttribArray(2);
+    }
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    currentStateIndex = 0;
+    isStateInitialized = false;
+    isHeightFieldReady = false;
+    heightFieldTexture = 0;
+
+    return true;
+}
+
+
+//! The particles are placed at the positions given by the stateless motion at the time
+void RainSnowProgram::resetStates(SceneRainSnowBase* particles, float time)
+{
+    const Vector3f& v = particles->velocity();
+    vector<GLfloat> states(numParticles * 4);
+    for(GLuint i = 0; i < numParticles; ++i){
+        float t = fmodf(time - offsetTimes[i], lifeTime);
+        if(t < 0.0f){
+            t += lifeTime;
+        }
+        for(int j=0; j < 3; ++j){
+            states[4*i + j] = initPositions[3*i + j] + v[j] * t;
+        }
+        states[4*i + 3] = -1.0f;
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, stateBuffers[currentStateIndex]);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, states.size() * sizeof(float), &states.front());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+
+/**
+   The height field is the highest surface below the top of the particle region for each cell
+   of the grid covering the region in the world coordinate. It is created from the meshes in the
+   scene when the particles are rendered first, so the objects that move after that are not
+   taken into account.
+*/
+void RainSnowProgram::createHeightField(SceneRainSnowBase* particles)
+{
+    const Affine3& T = globalPosition();
+    const double r = particles->radius();
+    BoundingBox region;
+    for(double z : { (double)particles->top(), (double)particles->bottom() }){
+        for(double x : { -r, r }){
+            for(double y : { -r, r }){
+                region.expandBy(T * Vector3(x, y, z));
+            }
+        }
+    }
+    const double topHeight = region.max().z();
+    const int n = HeightFieldResolution;
+    const Vector2 origin = region.min().head<2>();
+    const Vector2 size = (region.max() - region.min()).head<2>().cwiseMax(Vector2(1.0e-6, 1.0e-6));
+    const Vector2 cellSize = size / n;
+
+    vector<float> heights(n * n, std::numeric_limits<float>::lowest());
+
+    MeshExtractor meshExtractor;
+    meshExtractor.extract(
+        renderer()->sceneRoot(),
+        [&](SgMesh* mesh){
+            if(!mesh->hasVertices()){
+                return;
+            }
+            const Affine3& M = meshExtractor.currentTransform();
+            const auto& vertices = *mesh->vertices();
+            const int numTriangles = mesh->numTriangles();
+            for(int i=0; i < numTriangles; ++i){
+                auto triangle = mesh->triangle(i);
+                const Vector3 p0 = M * vertices[triangle[0]].cast<double>();
+                const Vector3 e1 = M * vertices[triangle[1]].cast<double>() - p0;
+                const Vector3 e2 = M * vertices[triangle[2]].cast<double>() - p0;
+                const double det = e1.x() * e2.y() - e2.x() * e1.y();
+                if(fabs(det) < 1.0e-12){
+                    continue; // vertical or degenerate triangle
+                }
+                const double minX = std::min({ p0.x(), p0.x() + e1.x(), p0.x() + e2.x() });
+                const double maxX = std::max({ p0.x(), p0.x() + e1.x(), p0.x() + e2.x() });
+                const double minY = std::min({ p0.y(), p0.y() + e1.y(), p0.y() + e2.y() });
+                const double maxY = std::max({ p0.y(), p0.y() + e1.y(), p0.y() + e2.y() });
+                const int ix0 = std::max(0, (int)ceil((minX - origin.x()) / cellSize.x() - 0.5));
+                const int ix1 = std::min(n - 1, (int)floor((maxX - origin.x()) / cellSize.x() - 0.5));
+                const int iy0 = std::max(0, (int)ceil((minY - origin.y()) / cellSize.y() - 0.5));
+                const int iy1 = std::min(n - 1, (int)floor((maxY - origin.y()) / cellSize.y() - 0.5));
+
+                for(int iy = iy0; iy <= iy1; ++iy){
+                    const double dy = origin.y() + (iy + 0.5) * cellSize.y() - p0.y();
+                    for(int ix = ix0; ix <= ix1; ++ix){
+                        const double dx = origin.x() + (ix + 0.5) * cellSize.x() - p0.x();
+                        const double b1 = (dx * e2.y() - e2.x() * dy) / det;
+                        const double b2 = (e1.x() * dy - dx * e1.y()) / det;
+                        if(b1 >= 0.0 && b2 >= 0.0 && b1 + b2 <= 1.0){
+                            const double z = p0.z() + b1 * e1.z() + b2 * e2.z();
+                            float& height = heights[iy * n + ix];
+                            if(z <= topHeight && z > height){
+                                height = z;
+                            }
+                        }
+                    }
+                }
+            }
+        });
+
+    heightFieldOrigin = origin.cast<float>();
+    heightFieldSize = size.cast<float>();
+
+    glGenTextures(1, &heightFieldTexture);
+    glBindTexture(GL_TEXTURE_2D, heightFieldTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, n, n, 0, GL_RED, GL_FLOAT, &heights.front());
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+
+void RainSnowProgram::updateStates(SceneRainSnowBase* particles, float time)
+{
+    if(!isHeightFieldReady){
+        createHeightField(particles);
+        isHeightFieldReady = true;
+    }
+    if(!isStateInitialized || time < lastTime){
+        resetStates(particles, time);
+        isStateInitialized = true;
+        lastTime = time;
+        return;
+    }
+    const float deltaTime = time - lastTime;
+    if(deltaTime <= 0.0f){
+        return;
+    }
+    lastTime = time;
+
+    glUseProgram(updateProgram.handle());
+
+    glUniform1f(deltaTimeLocation, deltaTime);
+    glUniform3fv(updateVelocityLocation, 1, particles->velocity().data());
+    glUniform1f(topLocation, particles->top());
+    glUniform1f(bottomLocation, particles->bottom());
+    glUniform1f(restTimeLocation, particles->restTime());
+    const Affine3f T = globalPosition().cast<float>();
+    const Matrix4f localToWorld = T.matrix();
+    const Matrix4f worldToLocal = T.inverse().matrix();
+    glUniformMatrix4fv(localToWorldLocation, 1, GL_FALSE, localToWorld.data());
+    glUniformMatrix4fv(worldToLocalLocation, 1, GL_FALSE, worldToLocal.data());
+    glUniform2fv(heightFieldOriginLocation, 1, heightFieldOrigin.data());
+    glUniform2fv(heightFieldSizeLocation, 1, heightFieldSize.data());
+
+    // Texture unit 0 is used for the particle texture
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, heightFieldTexture);
+    glBindSampler(1, 0);
+    glUniform1i(heightFieldLocation, 1);
+
+    glEnable(GL_RASTERIZER_DISCARD);
+    glBindVertexArray(stateVertexArrays[currentStateIndex]);
+    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, stateBuffers[1 - currentStateIndex]);
+    glBeginTransformFeedback(GL_POINTS);
+    glDrawArrays(GL_POINTS, 0, numParticles);
+    glEndTransformFeedback();
+    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+    glDisable(GL_RASTERIZER_DISCARD);
+    glActiveTexture(GL_TEXTURE0);
+
+    currentStateIndex = 1 - currentStateIndex;
+
+    glUseProgram(glslProgram().handle());
+}
+
+
 void RainSnowProgram::render(SceneRainSnowBase* particles)
 {
     auto& ps = particles->particleSystem();
+    const float time = particles->time() + ps.offsetTime();
+
+    // This must be done before setting the uniform variables of the rendering program
+    if(isStateBufferEnabled){
+        updateStates(particles, time);
+    }
 
-    setTime(particles->time() + ps.offsetTime());
+    setTime(time);
 
     glUniform1f(lifeTimeLocation, lifeTime);
     glUniform3fv(velocityLocation, 1, particles->velocity().data());
 
-    glBindVertexArray(vertexArray);
-    glDrawArrays(GL_POINTS, 0, ps.numParticles());
+    if(isStateBufferEnabled){
+        glUniform1i(isStateBufferEnabledLocation, 1);
+        glBindVertexArray(stateVertexArrays[currentStateIndex]);
+        glDrawArrays(GL_POINTS, 0, numParticles);
+    } else {
+        glBindVertexArray(vertexArray);
+        glDrawArrays(GL_POINTS, 0, ps.numParticles());
+    }
 }
@@ -21,11 +21,14 @@ public:
     float radius() const { return radius_; }
     float top() const { return top_; }
     float bottom() const { return bottom_; }
+    //! Time for which the particles stay on the surfaces when the collision is enabled
+    float restTime() const { return restTime_; }
 
     void setVelocity(const Vector3f& v) { velocity_ = v; }
     void setRadius(float r) { radius_ = r; }
     void setTop(float t) { top_ = t; }
     void setBottom(float b) { bottom_ = b; }
+    void setRestTime(float t) { restTime_ = t; }
 
     virtual ParticleSystem* getParticleSystem() override;
 
@@ -37,6 +40,7 @@ private:
     float radius_;
     float top_;
     float bottom_;
+    float restTime_;
     Vector3f velocity_;
 };
 
@@ -2,6 +2,7 @@
 
 layout (location = 0) in vec3 vertexInitPos;
 layout (location = 1) in float offsetTime;
+layout (location = 2) in vec4 particleState;
 
 out vec3 position;
 out float alpha;
@@ -9,6 +10,7 @@ out float alpha;
 uniform float time;
 uniform float lifeTime;
 uniform vec3 velocity;
+uniform bool isStateBufferEnabled = false;
 
 uniform mat4 modelViewMatrix;
 uniform mat4 projectionMatrix;
@@ -20,8 +22,11 @@ void main()
     vec3 pos = vertexInitPos;
     alpha = 0.0;
     float t = time - offsetTime;
-    //if(t > 0){
-    if(true){
+    if(isStateBufferEnabled){
+        pos = particleState.xyz;
+        alpha = 1.0;
+    //} else if(t > 0){
+    } else {
         t = mod(t, lifeTime);
         pos = vertexInitPos + velocity * t;
         alpha = 1.0;
@@ -0,0 +1,51 @@
+#version 330
+
+layout (location = 0) in vec3 vertexInitPos;
+layout (location = 2) in vec4 particleState;
+
+// xyz: position, w: elapsed time after landing (negative while falling)
+out vec4 newState;
+
+uniform float deltaTime;
+uniform vec3 velocity;
+uniform float top;
+uniform float bottom;
+uniform float restTime;
+
+uniform mat4 localToWorld;
+uniform mat4 worldToLocal;
+uniform sampler2D heightField;
+uniform vec2 heightFieldOrigin;
+uniform vec2 heightFieldSize;
+
+void main()
+{
+    if(particleState.w < 0.0){
+        vec3 pos = particleState.xyz + velocity * deltaTime;
+        bool landed = false;
+
+        vec4 worldPos = localToWorld * vec4(pos, 1.0);
+        vec2 uv = (worldPos.xy - heightFieldOrigin) / heightFieldSize;
+        if(all(greaterThanEqual(uv, vec2(0.0))) && all(lessThanEqual(uv, vec2(1.0)))){
+            float height = texture(heightField, uv).r;
+            if(worldPos.z <= height){
+                worldPos.z = height;
+                pos = (worldToLocal * worldPos).xyz;
+                landed = true;
+            }
+        }
+        if(pos.z <= bottom){
+            pos.z = bottom;
+            landed = true;
+        }
+        newState = vec4(pos, landed ? 0.0 : -1.0);
+
+    } else {
+        float t = particleState.w + deltaTime;
+        if(t >= restTime){
+            newState = vec4(vertexInitPos.xy, top, -1.0);
+        } else {
+            newState = vec4(particleState.xyz, t);
+        }
+    }
+}
@@ -165,6 +165,7 @@ public:
     void            clear               ();
 	//void            clearExternalForces ();
     void            addBody             (SpringheadBody* sprBody);
+    void            disableSelfContacts (const std::vector<SimulationBody*>& simBodies);
     //void            collisionCallback   (const CollisionPair& collisionPair);
 };
 
@@ -615,16 +616,17 @@ void SpringheadLink::setVelocityToSpringhead()
 }
 
 void SpringheadLink::setExternalForceToSpringhead(){
-	Vector3 f_ext   = link->f_ext  ();
-	Vector3 tau_ext = link->tau_ext();
+	Vector3& f_ext   = link->f_ext  ();
+	Vector3& tau_ext = link->tau_ext();
+	if(f_ext.isZero() && tau_ext.isZero()){
+		return;
+	}
 	phSolid->AddForce (ToSpr(f_ext  ));
 	phSolid->AddTorque(ToSpr(tau_ext));
 
 	// not appropriate to clear forces here...
-	link->f_ext  ().setZero();
-	link->tau_ext().setZero();
-
-	DSTR << ToSpr(f_ext) << endl;
+	f_ext  .setZero();
+	tau_ext.setZero();
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
@@ -905,6 +907,8 @@ bool SpringheadSimulatorItemImpl::initializeSimulation(const std::vector<Simulat
     }
     if(param.useWorldCollision)
         collisionDetector->makeReady();
+	else
+		disableSelfContacts(simBodies);
 
     if(MEASURE_PHYSICS_CALCULATION_TIME){
         physicsTime   = 0;
@@ -937,6 +941,25 @@ void SpringheadSimulatorItemImpl::addBody(SpringheadBody* sprBody)
     sprBody->createBody(this);
 }
 
+/**
+   Collisions between solids that belong to the same choreonoid body are disabled.
+   The contact modes are kept in the scene, so this is done once instead of every step.
+*/
+void SpringheadSimulatorItemImpl::disableSelfContacts(const std::vector<SimulationBody*>& simBodies)
+{
+	std::vector<Spr::PHSolidIf*> solids;
+	for(size_t i = 0; i < simBodies.size(); i++){
+		SpringheadBody* sprBody = static_cast<SpringheadBody*>(simBodies[i]);
+
+		solids.clear();
+		for(size_t j = 0; j < sprBody->sprLinks.size(); j++)
+			solids.push_back(sprBody->sprLinks[j]->phSolid);
+
+		if(!solids.empty())
+			phScene->SetContactMode(&solids[0], solids.size(), Spr::PHSceneDesc::MODE_NONE);
+	}
+}
+
 bool SpringheadSimulatorItemImpl::stepSimulation(const std::vector<SimulationBody*>& activeSimBodies)
 {
 	for(size_t i=0; i < activeSimBodies.size(); ++i){
@@ -945,6 +968,7 @@ bool SpringheadSimulatorItemImpl::stepSimulation(const std::vector<SimulationBod
 		sprBody->setControlValToSpringhead();
 		sprBody->setExternalForceToSpringhead();
     }
+	self->lapDynamicsStepPhase(SimulatorItem::StateInputPhase);
 
 	if(MEASURE_PHYSICS_CALCULATION_TIME){
 	    physicsTimer.start();
@@ -957,18 +981,6 @@ bool SpringheadSimulatorItemImpl::stepSimulation(const std::vector<SimulationBod
 		if(MEASURE_PHYSICS_CALCULATION_TIME)
 			collisionTimer.start();
 
-		// disable collisions between solids that belong to the same choreonoid body
-		std::vector<Spr::PHSolidIf*> solids;
-		for(int i = 0; i < (int)activeSimBodies.size(); i++){
-			SpringheadBody* sprBody = static_cast<SpringheadBody*>(activeSimBodies[i]);
-
-			solids.clear();
-			for(int j = 0; j < sprBody->sprLinks.size(); j++)
-				solids.push_back(sprBody->sprLinks[j]->phSolid);
-
-			phScene->SetContactMode(&solids[0], solids.size(), Spr::PHSceneDesc::MODE_NONE);
-		}
-
 		phScene->Step();
 		
 		if(MEASURE_PHYSICS_CALCULATION_TIME)
@@ -978,6 +990,7 @@ bool SpringheadSimulatorItemImpl::stepSimulation(const std::vector<SimulationBod
     if(MEASURE_PHYSICS_CALCULATION_TIME){
         physicsTime += physicsTimer.nsecsElapsed();
     }
+	self->lapDynamicsStepPhase(SimulatorItem::EngineStepPhase);
 
     //! \todo Bodies with sensors should be managed by the specialized container to increase the efficiency
     for(size_t i=0; i < activeSimBodies.size(); ++i){
@@ -995,6 +1008,7 @@ bool SpringheadSimulatorItemImpl::stepSimulation(const std::vector<SimulationBod
             sprBody->sensorHelper.updateGyroAndAccelerationSensors();
         }
     }
+	self->lapDynamicsStepPhase(SimulatorItem::StateOutputPhase);
 
     return true;
 }
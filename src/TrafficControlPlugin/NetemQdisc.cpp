@@ -0,0 +1,173 @@
+#include "NetemQdisc.h"
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <linux/pkt_sched.h>
+#include <net/if.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <cstdint>
+#include <limits>
+
+using namespace std;
+
+namespace {
+
+const unsigned int NETEM_PARENT = TC_H_MAKE(1 << 16, 1);   // 1:1
+const unsigned int NETEM_HANDLE = TC_H_MAKE(0x11 << 16, 0); // 11:
+const unsigned int NETEM_LIMIT = 1000; // Default packet limit of the tc command
+
+struct Request
+{
+    nlmsghdr n;
+    tcmsg t;
+    char buf[512];
+};
+
+rtattr* tail(nlmsghdr* n)
+{
+    return reinterpret_cast<rtattr*>(reinterpret_cast<char*>(n) + NLMSG_ALIGN(n->nlmsg_len));
+}
+
+bool addAttr(nlmsghdr* n,const int& maxlen,const int& type,const void* data,const int& len)
+{
+    int rtalen=RTA_LENGTH(len);
+    if(NLMSG_ALIGN(n->nlmsg_len)+RTA_ALIGN(rtalen)>static_cast<unsigned int>(maxlen)) {
+        return false;
+    }
+    rtattr* rta=tail(n);
+    rta->rta_type=type;
+    rta->rta_len=rtalen;
+    if(len>0) {
+        memcpy(RTA_DATA(rta),data,len);
+    }
+    n->nlmsg_len=NLMSG_ALIGN(n->nlmsg_len)+RTA_ALIGN(rtalen);
+    return true;
+}
+
+}
+
+NetemQdisc::NetemQdisc()
+{
+    _socket=-1;
+    _seq=0;
+}
+
+NetemQdisc::~NetemQdisc()
+{
+    close();
+}
+
+bool
+NetemQdisc::open() {
+    if(_socket>=0) return true;
+
+    _socket=socket(AF_NETLINK,SOCK_RAW|SOCK_CLOEXEC,NETLINK_ROUTE);
+    if(_socket<0) {
+        _errorMessage=string("socket: ")+strerror(errno);
+        return false;
+    }
+
+    sockaddr_nl local;
+    memset(&local,0,sizeof(local));
+    local.nl_family=AF_NETLINK;
+    if(bind(_socket,reinterpret_cast<sockaddr*>(&local),sizeof(local))<0) {
+        _errorMessage=string("bind: ")+strerror(errno);
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+void
+NetemQdisc::close() {
+    if(_socket>=0) {
+        ::close(_socket);
+        _socket=-1;
+    }
+}
+
+bool
+NetemQdisc::replace(const std::string& nic,const int& delay,const int& rate,const double& loss) {
+    if(_socket<0) {
+        _errorMessage="netlink socket is not open";
+        return false;
+    }
+
+    unsigned int ifindex=if_nametoindex(nic.c_str());
+    if(ifindex==0) {
+        _errorMessage=nic+": "+strerror(errno);
+        return false;
+    }
+
+    Request req;
+    memset(&req,0,sizeof(req));
+    req.n.nlmsg_len=NLMSG_LENGTH(sizeof(tcmsg));
+    req.n.nlmsg_type=RTM_NEWQDISC;
+    req.n.nlmsg_flags=NLM_F_REQUEST|NLM_F_CREATE|NLM_F_REPLACE|NLM_F_ACK;
+    req.n.nlmsg_seq=++_seq;
+    req.t.tcm_family=AF_UNSPEC;
+    req.t.tcm_ifindex=ifindex;
+    req.t.tcm_parent=NETEM_PARENT;
+    req.t.tcm_handle=NETEM_HANDLE;
+
+    const int maxlen=sizeof(req);
+    const char kind[]="netem";
+    addAttr(&req.n,maxlen,TCA_KIND,kind,sizeof(kind));
+
+    // The latency field of tc_netem_qopt is in the scheduler ticks, which are overridden by
+    // TCA_NETEM_LATENCY64 given in nanoseconds.
+    tc_netem_qopt opt;
+    memset(&opt,0,sizeof(opt));
+    opt.limit=NETEM_LIMIT;
+    opt.loss=static_cast<uint32_t>(loss/100.0*numeric_limits<uint32_t>::max());
+
+    rtattr* options=tail(&req.n);
+    addAttr(&req.n,maxlen,TCA_OPTIONS,&opt,sizeof(opt));
+
+    int64_t latency=static_cast<int64_t>(delay)*1000000;
+    addAttr(&req.n,maxlen,TCA_NETEM_LATENCY64,&latency,sizeof(latency));
+
+    tc_netem_rate netemRate;
+    memset(&netemRate,0,sizeof(netemRate));
+    netemRate.rate=static_cast<uint32_t>(static_cast<uint64_t>(rate)*1000/8);
+    addAttr(&req.n,maxlen,TCA_NETEM_RATE,&netemRate,sizeof(netemRate));
+
+    options->rta_len=reinterpret_cast<char*>(tail(&req.n))-reinterpret_cast<char*>(options);
+
+    sockaddr_nl kernel;
+    memset(&kernel,0,sizeof(kernel));
+    kernel.nl_family=AF_NETLINK;
+    if(sendto(_socket,&req,req.n.nlmsg_len,0,reinterpret_cast<sockaddr*>(&kernel),sizeof(kernel))<0) {
+        _errorMessage=string("sendto: ")+strerror(errno);
+        return false;
+    }
+
+    return receiveAck(req.n.nlmsg_seq);
+}
+
+bool
+NetemQdisc::receiveAck(unsigned int seq) {
+    char buf[4096];
+    while(true) {
+        int len=recv(_socket,buf,sizeof(buf),0);
+        if(len<0) {
+            if(errno==EINTR) continue;
+            _errorMessage=string("recv: ")+strerror(errno);
+            return false;
+        }
+        for(nlmsghdr* h=reinterpret_cast<nlmsghdr*>(buf);NLMSG_OK(h,static_cast<unsigned int>(len));h=NLMSG_NEXT(h,len)) {
+            if(h->nlmsg_seq!=seq) continue;
+            if(h->nlmsg_type==NLMSG_ERROR) {
+                nlmsgerr* err=static_cast<nlmsgerr*>(NLMSG_DATA(h));
+                if(err->error==0) {
+                    return true;
+                }
+                _errorMessage=strerror(-err->error);
+                return false;
+            }
+        }
+    }
+}
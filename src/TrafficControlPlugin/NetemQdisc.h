@@ -0,0 +1,44 @@
+#pragma once
+
+#include <string>
+
+/**
+   Updates the parameters of the netem qdiscs created by TCSimulatorItem::initTC through a
+   rtnetlink socket. This is equivalent to "tc qdisc replace dev <nic> parent 1:1 handle 11: netem ..."
+   but does not spawn any process, so the parameters can be updated at every simulation step.
+   The process needs the CAP_NET_ADMIN capability.
+*/
+class NetemQdisc
+{
+public:
+
+    NetemQdisc();
+
+    ~NetemQdisc();
+
+    NetemQdisc(const NetemQdisc&) = delete;
+    NetemQdisc& operator=(const NetemQdisc&) = delete;
+
+    bool open();
+
+    void close();
+
+    bool isOpen() const { return _socket>=0; }
+
+    /**
+       \param delay Delay in milliseconds
+       \param rate Bandwidth in kbit/s. Zero means no limitation.
+       \param loss Loss ratio in percent
+    */
+    bool replace(const std::string& nic,const int& delay,const int& rate,const double& loss);
+
+    const std::string& errorMessage() const { return _errorMessage; }
+
+private:
+
+    bool receiveAck(unsigned int seq);
+
+    int _socket;
+    unsigned int _seq;
+    std::string _errorMessage;
+};
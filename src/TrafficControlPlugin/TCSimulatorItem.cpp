@@ -183,6 +183,7 @@ TCSimulatorItem::TCSimulatorItem()
 TCSimulatorItem::TCSimulatorItem(const TCSimulatorItem& org) : SubSimulatorItem(org)
 {
     _enableTrafficControl=org._enableTrafficControl;
+    _useNetlink=org._useNetlink;
     _communicationPort=org._communicationPort;
 
     for(int i=0;i<NIC_MAX;i++) {
@@ -252,6 +253,12 @@ TCSimulatorItem::initializeSimulation(SimulatorItem* simulatorItem)
 
     _share->setTcsRunning(true);
 
+    if(_useNetlink&&!_netem.open()) {
+        MessageView::mainInstance()->putln(
+            "TCSimulatorItem::initializeSimulation netlink socket is not available ("+_netem.errorMessage()+"). The tc command is used instead.",
+            MessageView::Warning);
+    }
+
     doTC();
 
     return true;
@@ -321,6 +328,8 @@ TCSimulatorItem::finalizeSimulation()
 
     _curSimItem = nullptr;
 
+    _netem.close();
+
     _share->setTcsInstance(nullptr);
 }
 
@@ -370,6 +379,8 @@ TCSimulatorItem::doPutProperties(PutPropertyFunction& putProperty)
 
     putProperty(_("EnableTrafficControl"),_enableTrafficControl, changeProperty(_enableTrafficControl));
 
+    putProperty(_("UseNetlink"),_useNetlink, changeProperty(_useNetlink));
+
     putProperty(_("Port"), _communicationPort,
                 [&](int index){ _portChanged = true; _idxNew = index; return _communicationPort.selectIndex(index);});
 
@@ -451,6 +462,7 @@ TCSimulatorItem::store(Archive& archive)
     SubSimulatorItem::store(archive);
 
     archive.write("EnableTrafficControl",_enableTrafficControl);
+    archive.write("UseNetlink",_useNetlink);
 
     int portCount=_communicationPort.size();
     archive.write("PortCount",portCount);
@@ -498,6 +510,7 @@ TCSimulatorItem::restore(const Archive& archive)
     SubSimulatorItem::restore(archive);
 
     archive.read("EnableTrafficControl",_enableTrafficControl);
+    archive.read("UseNetlink",_useNetlink);
 
     int portCount = -1;
     archive.read("PortCount",portCount);
@@ -951,8 +964,7 @@ TCSimulatorItem::doTC2com(const int& ethIdxNo,const int *p1,const int *p2,const
         rc1=false;
     }
     if(rc1) {
-        string cmd="tc qdisc replace dev "+_ethName[ethIdxNo]+" parent 1:1 handle 11: netem"+" delay "+std::to_string(p1[ethIdxNo])+"ms"+" rate "+std::to_string(p2[ethIdxNo])+"kbit"+" loss "+std::to_string(p3[ethIdxNo])+"%";
-        sysCall(cmd);
+        replaceNetem(_ethName[ethIdxNo],p1[ethIdxNo],p2[ethIdxNo],p3[ethIdxNo]);
     }
 
     bool rc2=true;
@@ -976,9 +988,28 @@ TCSimulatorItem::doTC2com(const int& ethIdxNo,const int *p1,const int *p2,const
         rc2=false;
     }
     if(rc2) {
-        string cmd="tc qdisc replace dev "+_virName[ethIdxNo]+" parent 1:1 handle 11: netem"+" delay "+std::to_string(p4[ethIdxNo])+"ms"+" rate "+std::to_string(p5[ethIdxNo])+"kbit"+" loss "+std::to_string(p6[ethIdxNo])+"%";
-        sysCall(cmd);
+        replaceNetem(_virName[ethIdxNo],p4[ethIdxNo],p5[ethIdxNo],p6[ethIdxNo]);
+    }
+}
+
+/**
+   The netem qdisc is updated through the netlink socket while the simulation is running so that
+   DynamicTCSimulatorItem can change the parameters at every step without spawning the tc command.
+   The tc command is used when the socket is not available or the update fails.
+*/
+void
+TCSimulatorItem::replaceNetem(const std::string& nic,const int& delay,const int& rate,const double& loss) {
+    if(_netem.isOpen()) {
+        if(_netem.replace(nic,delay,rate,loss)) {
+            return;
+        }
+        MessageView::mainInstance()->putln(
+            "TCSimulatorItem::replaceNetem netlink request failed, nic="+nic+" ("+_netem.errorMessage()+"). The tc command is used instead.",
+            MessageView::Warning);
+        _netem.close();
     }
+    string cmd="tc qdisc replace dev "+nic+" parent 1:1 handle 11: netem"+" delay "+std::to_string(delay)+"ms"+" rate "+std::to_string(rate)+"kbit"+" loss "+std::to_string(loss)+"%";
+    sysCall(cmd);
 }
 
 void
@@ -6,6 +6,7 @@
 
 #include <cnoid/SubSimulatorItem>
 #include <cnoid/Selection>
+#include "NetemQdisc.h"
 #include <map>
 #include <vector>
 #include "exportdecl.h"
@@ -94,6 +95,7 @@ private:
     void initTC();
     void resetTC();
     bool findNIC(const std::string &nic);
+    void replaceNetem(const std::string& nic,const int& delay,const int& rate,const double& loss);
 
     int _preFuncId, _midFuncId, _postFuncId;
 
@@ -138,6 +140,9 @@ private:
     bool _initTC = false;
 
     bool _monitorDynamicTC = false;
+
+    bool _useNetlink = true;
+    NetemQdisc _netem;
 };
 
 typedef cnoid::ref_ptr<TCSimulatorItem> TCSimulatorItemPtr;
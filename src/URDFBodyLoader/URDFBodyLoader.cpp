@@ -179,7 +179,10 @@ URDFBodyLoader::URDFBodyLoader()
 
 URDFBodyLoader::Impl::Impl()
     : os_(&nullout())
-{}
+{
+    // the same mesh files are often used by multiple links and robots
+    sceneLoader_.setSceneSharingEnabled(true);
+}
 
 
 URDFBodyLoader::~URDFBodyLoader()
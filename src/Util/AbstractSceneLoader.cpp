@@ -29,3 +29,9 @@ void AbstractSceneLoader::setDefaultCreaseAngle(double /* theta */)
 {
 
 }
+
+
+bool AbstractSceneLoader::isCacheable() const
+{
+    return false;
+}
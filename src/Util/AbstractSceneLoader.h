@@ -18,6 +18,12 @@ public:
     virtual void setDefaultDivisionNumber(int n);
     virtual void setDefaultCreaseAngle(double theta);
     virtual SgNode* load(const std::string& filename) = 0;
+
+    /**
+       \return true if the loaded scene only depends on the file and the image files specified
+       by the absolute URIs of the SgImage objects, so that the scene can be cached by SceneLoader.
+    */
+    virtual bool isCacheable() const;
 };
 
 }
@@ -0,0 +1,644 @@
+#include "BinarySeqFile.h"
+#include "MultiValueSeq.h"
+#include "Vector3Seq.h"
+#include "MultiVector3Seq.h"
+#include "MultiSE3Seq.h"
+#include "MultiSE3MatrixSeq.h"
+#include "MappedFile.h"
+#include "Exception.h"
+#include "UTF8.h"
+#include <zlib.h>
+#include <fmt/format.h>
+#include <fstream>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include "gettext.h"
+
+using namespace std;
+using namespace cnoid;
+using fmt::format;
+
+namespace {
+
+const uint32_t FileMagic = 0x51455343; // "CSEQ"
+const uint32_t FileVersion = 1;
+const uint32_t CompressedChunkFlag = 1;
+const int DefaultNumChunkFrames = 1000;
+
+/*
+  The elements are stored as the sequences of double values. A SE3 value is stored as the
+  translation followed by the quaternion in the order of w, x, y, z, and an Isometry3 value
+  is stored as the translation followed by the rotation matrix in the column-major order.
+*/
+inline void encode(double value, double* out) { out[0] = value; }
+inline void decode(const double* in, double& value) { value = in[0]; }
+
+inline void encode(const Vector3& v, double* out) { out[0] = v.x(); out[1] = v.y(); out[2] = v.z(); }
+inline void decode(const double* in, Vector3& v) { v << in[0], in[1], in[2]; }
+
+inline void encode(const SE3& x, double* out)
+{
+    encode(x.translation(), out);
+    auto& q = x.rotation();
+    out[3] = q.w(); out[4] = q.x(); out[5] = q.y(); out[6] = q.z();
+}
+inline void decode(const double* in, SE3& x)
+{
+    decode(in, x.translation());
+    x.rotation() = Quaternion(in[3], in[4], in[5], in[6]);
+}
+
+inline void encode(const Isometry3& T, double* out)
+{
+    encode(Vector3(T.translation()), out);
+    Eigen::Map<Matrix3>(out + 3) = T.linear();
+}
+inline void decode(const double* in, Isometry3& T)
+{
+    T.translation() << in[0], in[1], in[2];
+    T.linear() = Eigen::Map<const Matrix3>(in + 3);
+}
+
+template<class ElementType> struct ElementSize { };
+template<> struct ElementSize<double> { static const int value = 1; };
+template<> struct ElementSize<Vector3> { static const int value = 3; };
+template<> struct ElementSize<SE3> { static const int value = 7; };
+template<> struct ElementSize<Isometry3> { static const int value = 12; };
+
+class SeqAccessor
+{
+public:
+    virtual ~SeqAccessor() { }
+    virtual int numScalars() const = 0;
+    virtual int numFrames() const = 0;
+    virtual int numParts() const = 0;
+    virtual void setDimension(int numFrames, int numParts) = 0;
+    virtual void getFrame(int frame, double* out) const = 0;
+    virtual void setFrame(int frame, const double* values) = 0;
+};
+
+template<class SeqType>
+class MultiSeqAccessor : public SeqAccessor
+{
+    SeqType* seq;
+    typedef typename SeqType::value_type ElementType;
+    static const int n = ElementSize<ElementType>::value;
+public:
+    MultiSeqAccessor(SeqType* seq) : seq(seq) { }
+    virtual int numScalars() const override { return n; }
+    virtual int numFrames() const override { return seq->numFrames(); }
+    virtual int numParts() const override { return seq->numParts(); }
+    virtual void setDimension(int numFrames, int numParts) override {
+        seq->setDimension(numFrames, numParts);
+    }
+    virtual void getFrame(int frame, double* out) const override {
+        auto f = seq->frame(frame);
+        const int m = seq->numParts();
+        for(int i=0; i < m; ++i){
+            encode(f[i], out + i * n);
+        }
+    }
+    virtual void setFrame(int frame, const double* values) override {
+        auto f = seq->frame(frame);
+        const int m = seq->numParts();
+        for(int i=0; i < m; ++i){
+            decode(values + i * n, f[i]);
+        }
+    }
+};
+
+template<class SeqType>
+class SingleSeqAccessor : public SeqAccessor
+{
+    SeqType* seq;
+    typedef typename SeqType::value_type ElementType;
+    static const int n = ElementSize<ElementType>::value;
+public:
+    SingleSeqAccessor(SeqType* seq) : seq(seq) { }
+    virtual int numScalars() const override { return n; }
+    virtual int numFrames() const override { return seq->numFrames(); }
+    virtual int numParts() const override { return 1; }
+    virtual void setDimension(int numFrames, int /* numParts */) override {
+        seq->setNumFrames(numFrames);
+    }
+    virtual void getFrame(int frame, double* out) const override {
+        encode(seq->at(frame), out);
+    }
+    virtual void setFrame(int frame, const double* values) override {
+        decode(values, seq->at(frame));
+    }
+};
+
+unique_ptr<SeqAccessor> createAccessor(AbstractSeq* seq)
+{
+    if(auto s = dynamic_cast<MultiValueSeq*>(seq)){
+        return unique_ptr<SeqAccessor>(new MultiSeqAccessor<MultiValueSeq>(s));
+    } else if(auto s = dynamic_cast<MultiSE3Seq*>(seq)){
+        return unique_ptr<SeqAccessor>(new MultiSeqAccessor<MultiSE3Seq>(s));
+    } else if(auto s = dynamic_cast<MultiVector3Seq*>(seq)){
+        return unique_ptr<SeqAccessor>(new MultiSeqAccessor<MultiVector3Seq>(s));
+    } else if(auto s = dynamic_cast<MultiSE3MatrixSeq*>(seq)){
+        return unique_ptr<SeqAccessor>(new MultiSeqAccessor<MultiSE3MatrixSeq>(s));
+    } else if(auto s = dynamic_cast<Vector3Seq*>(seq)){
+        return unique_ptr<SeqAccessor>(new SingleSeqAccessor<Vector3Seq>(s));
+    }
+    return nullptr;
+}
+
+shared_ptr<AbstractSeq> createSeq(const string& type)
+{
+    if(type == "MultiValueSeq"){
+        return make_shared<MultiValueSeq>();
+    } else if(type == "MultiSE3Seq"){
+        return make_shared<MultiSE3Seq>();
+    } else if(type == "MultiVector3Seq"){
+        return make_shared<MultiVector3Seq>();
+    } else if(type == "MultiSE3MatrixSeq"){
+        return make_shared<MultiSE3MatrixSeq>();
+    } else if(type == "Vector3Seq"){
+        return make_shared<Vector3Seq>();
+    }
+    return nullptr;
+}
+
+struct ChunkInfo
+{
+    uint64_t offset;
+    uint64_t size;
+    uint32_t flags;
+};
+
+struct SeqRecord
+{
+    string name;
+    string type;
+    string contentName;
+    double frameRate;
+    double offsetTime;
+    int32_t numFrames;
+    int32_t numParts;
+    int32_t numScalars;
+    int32_t numChunkFrames;
+    vector<ChunkInfo> chunks;
+    AbstractSeq* seq;
+};
+
+class Writer
+{
+public:
+    ofstream& ofs;
+    Writer(ofstream& ofs) : ofs(ofs) { }
+    template<class T> void write(const T& value) {
+        ofs.write(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+    void write(const string& s) {
+        write(static_cast<uint32_t>(s.size()));
+        ofs.write(s.data(), s.size());
+    }
+};
+
+class Reader
+{
+public:
+    const unsigned char* data;
+    size_t size;
+    size_t pos;
+    Reader(const unsigned char* data, size_t size) : data(data), size(size), pos(0) { }
+    void check(size_t n) {
+        if(n > size - pos){
+            throw file_read_error() << error_info_message(_("The file is truncated."));
+        }
+    }
+    template<class T> T read() {
+        T value;
+        check(sizeof(T));
+        memcpy(&value, data + pos, sizeof(T));
+        pos += sizeof(T);
+        return value;
+    }
+    string readString() {
+        auto n = read<uint32_t>();
+        check(n);
+        string s(reinterpret_cast<const char*>(data + pos), n);
+        pos += n;
+        return s;
+    }
+};
+
+}
+
+namespace cnoid {
+
+class BinarySeqFile::Impl
+{
+public:
+    ostream* os_;
+    bool isCompressionEnabled;
+    int numChunkFrames;
+    vector<SeqRecord> records;
+    unique_ptr<MappedFile> file;
+    vector<double> buffer;
+
+    Impl();
+    ostream& os() { return *os_; }
+    bool save(const string& filename);
+    void writeHeader(Writer& writer);
+    bool writeChunks(Writer& writer, SeqRecord& record, SeqAccessor* accessor);
+    bool open(const string& filename);
+    void readHeader();
+    bool readFrames(int index, int beginFrame, int numFrames, AbstractSeq* seq);
+    void decodeChunk(const SeqRecord& record, int chunkIndex);
+};
+
+}
+
+
+BinarySeqFile::BinarySeqFile()
+{
+    impl = new Impl;
+}
+
+
+BinarySeqFile::Impl::Impl()
+{
+    os_ = &nullout();
+    isCompressionEnabled = false;
+    numChunkFrames = DefaultNumChunkFrames;
+}
+
+
+BinarySeqFile::~BinarySeqFile()
+{
+    delete impl;
+}
+
+
+bool BinarySeqFile::isSupportedSeq(const AbstractSeq* seq)
+{
+    return createAccessor(const_cast<AbstractSeq*>(seq)) != nullptr;
+}
+
+
+void BinarySeqFile::setMessageSink(std::ostream& os)
+{
+    impl->os_ = &os;
+}
+
+
+void BinarySeqFile::setCompressionEnabled(bool on)
+{
+    impl->isCompressionEnabled = on;
+}
+
+
+void BinarySeqFile::setNumChunkFrames(int n)
+{
+    impl->numChunkFrames = std::max(1, n);
+}
+
+
+void BinarySeqFile::addSeq(const std::string& name, AbstractSeq* seq)
+{
+    SeqRecord record;
+    record.name = name;
+    record.seq = seq;
+    impl->records.push_back(record);
+}
+
+
+bool BinarySeqFile::save(const std::string& filename)
+{
+    bool result = impl->save(filename);
+    impl->records.clear();
+    return result;
+}
+
+
+bool BinarySeqFile::Impl::save(const std::string& filename)
+{
+    file.reset();
+
+    vector<unique_ptr<SeqAccessor>> accessors;
+    for(auto& record : records){
+        auto accessor = createAccessor(record.seq);
+        if(!accessor){
+            os() << format(_("The sequence \"{0}\" of type {1} cannot be saved in the binary format."),
+                           record.name, record.seq->seqType()) << endl;
+            return false;
+        }
+        record.type = record.seq->seqType();
+        record.contentName = record.seq->seqContentName();
+        record.frameRate = record.seq->getFrameRate();
+        record.offsetTime = record.seq->getOffsetTime();
+        record.numFrames = accessor->numFrames();
+        record.numParts = accessor->numParts();
+        record.numScalars = accessor->numScalars();
+        record.numChunkFrames = numChunkFrames;
+        int numChunks = (record.numFrames + numChunkFrames - 1) / numChunkFrames;
+        record.chunks.assign(numChunks, ChunkInfo{ 0, 0, 0 });
+        accessors.push_back(std::move(accessor));
+    }
+
+    ofstream ofs(fromUTF8(filename).c_str(), ios::out | ios::binary);
+    if(!ofs){
+        os() << format(_("\"{}\" cannot be opened."), filename) << endl;
+        return false;
+    }
+    Writer writer(ofs);
+
+    // The header is written again after the chunk table is determined
+    writeHeader(writer);
+    for(size_t i=0; i < records.size(); ++i){
+        if(!writeChunks(writer, records[i], accessors[i].get())){
+            return false;
+        }
+    }
+    ofs.seekp(0);
+    writeHeader(writer);
+
+    if(!ofs){
+        os() << format(_("\"{}\" cannot be written."), filename) << endl;
+        return false;
+    }
+    return true;
+}
+
+
+void BinarySeqFile::Impl::writeHeader(Writer& writer)
+{
+    writer.write(FileMagic);
+    writer.write(FileVersion);
+    writer.write(static_cast<uint32_t>(records.size()));
+    for(auto& record : records){
+        writer.write(record.name);
+        writer.write(record.type);
+        writer.write(record.contentName);
+        writer.write(record.frameRate);
+        writer.write(record.offsetTime);
+        writer.write(record.numFrames);
+        writer.write(record.numParts);
+        writer.write(record.numScalars);
+        writer.write(record.numChunkFrames);
+        writer.write(static_cast<uint32_t>(record.chunks.size()));
+        for(auto& chunk : record.chunks){
+            writer.write(chunk.offset);
+            writer.write(chunk.size);
+            writer.write(chunk.flags);
+        }
+    }
+}
+
+
+bool BinarySeqFile::Impl::writeChunks(Writer& writer, SeqRecord& record, SeqAccessor* accessor)
+{
+    const int frameSize = record.numParts * record.numScalars;
+    vector<unsigned char> compressed;
+
+    for(size_t i=0; i < record.chunks.size(); ++i){
+        const int beginFrame = i * record.numChunkFrames;
+        const int n = std::min(record.numChunkFrames, record.numFrames - beginFrame);
+        buffer.resize(n * frameSize);
+        for(int j=0; j < n; ++j){
+            accessor->getFrame(beginFrame + j, &buffer[j * frameSize]);
+        }
+        const unsigned char* data = reinterpret_cast<const unsigned char*>(buffer.data());
+        uLong size = buffer.size() * sizeof(double);
+        uint32_t flags = 0;
+
+        if(isCompressionEnabled){
+            uLongf compressedSize = compressBound(size);
+            compressed.resize(compressedSize);
+            if(compress2(compressed.data(), &compressedSize, data, size, Z_BEST_SPEED) != Z_OK){
+                os() << format(_("The sequence \"{}\" cannot be compressed."), record.name) << endl;
+                return false;
+            }
+            // A chunk that does not become smaller is stored as it is
+            if(compressedSize < size){
+                data = compressed.data();
+                size = compressedSize;
+                flags |= CompressedChunkFlag;
+            }
+        }
+
+        auto& chunk = record.chunks[i];
+        chunk.offset = writer.ofs.tellp();
+        chunk.size = size;
+        chunk.flags = flags;
+        writer.ofs.write(reinterpret_cast<const char*>(data), size);
+    }
+
+    return true;
+}
+
+
+bool BinarySeqFile::open(const std::string& filename)
+{
+    return impl->open(filename);
+}
+
+
+bool BinarySeqFile::Impl::open(const std::string& filename)
+{
+    records.clear();
+    file.reset();
+
+    try {
+        file.reset(new MappedFile(filename));
+        readHeader();
+    }
+    catch(const file_read_error& ex){
+        os() << format(_("\"{0}\" cannot be loaded: {1}"), filename, *boost::get_error_info<error_info_message>(ex))
+             << endl;
+        records.clear();
+        file.reset();
+        return false;
+    }
+    return true;
+}
+
+
+void BinarySeqFile::Impl::readHeader()
+{
+    Reader reader(file->data(), file->size());
+
+    if(reader.read<uint32_t>() != FileMagic){
+        throw file_read_error() << error_info_message(_("The file is not a binary sequence file."));
+    }
+    auto version = reader.read<uint32_t>();
+    if(version > FileVersion){
+        throw file_read_error() << error_info_message(
+            format(_("Format version {} is not supported."), version));
+    }
+
+    auto numSeqs = reader.read<uint32_t>();
+    records.resize(numSeqs);
+    for(auto& record : records){
+        record.name = reader.readString();
+        record.type = reader.readString();
+        record.contentName = reader.readString();
+        record.frameRate = reader.read<double>();
+        record.offsetTime = reader.read<double>();
+        record.numFrames = reader.read<int32_t>();
+        record.numParts = reader.read<int32_t>();
+        record.numScalars = reader.read<int32_t>();
+        record.numChunkFrames = reader.read<int32_t>();
+        auto numChunks = reader.read<uint32_t>();
+        if(record.numFrames < 0 || record.numParts < 0 || record.numScalars <= 0 ||
+           record.numChunkFrames <= 0 ||
+           static_cast<int64_t>(numChunks) * record.numChunkFrames < record.numFrames){
+            throw file_read_error() << error_info_message(
+                format(_("The record of the sequence \"{}\" is invalid."), record.name));
+        }
+        record.chunks.resize(numChunks);
+        for(auto& chunk : record.chunks){
+            chunk.offset = reader.read<uint64_t>();
+            chunk.size = reader.read<uint64_t>();
+            chunk.flags = reader.read<uint32_t>();
+            if(chunk.offset > file->size() || chunk.size > file->size() - chunk.offset){
+                throw file_read_error() << error_info_message(_("The file is truncated."));
+            }
+        }
+        record.seq = nullptr;
+    }
+}
+
+
+void BinarySeqFile::close()
+{
+    impl->records.clear();
+    impl->file.reset();
+}
+
+
+bool BinarySeqFile::isOpen() const
+{
+    return impl->file != nullptr;
+}
+
+
+int BinarySeqFile::numSeqs() const
+{
+    return impl->records.size();
+}
+
+
+const std::string& BinarySeqFile::seqName(int index) const
+{
+    return impl->records[index].name;
+}
+
+
+const std::string& BinarySeqFile::seqType(int index) const
+{
+    return impl->records[index].type;
+}
+
+
+int BinarySeqFile::numFrames(int index) const
+{
+    return impl->records[index].numFrames;
+}
+
+
+int BinarySeqFile::findSeq(const std::string& name) const
+{
+    for(size_t i=0; i < impl->records.size(); ++i){
+        if(impl->records[i].name == name){
+            return i;
+        }
+    }
+    return -1;
+}
+
+
+std::shared_ptr<AbstractSeq> BinarySeqFile::readSeq(int index)
+{
+    auto seq = createSeq(impl->records[index].type);
+    if(!seq){
+        impl->os() << format(_("The sequence type {} is not supported."), impl->records[index].type) << endl;
+    } else if(!readSeq(index, seq.get())){
+        seq.reset();
+    }
+    return seq;
+}
+
+
+bool BinarySeqFile::readSeq(int index, AbstractSeq* seq)
+{
+    return impl->readFrames(index, 0, impl->records[index].numFrames, seq);
+}
+
+
+bool BinarySeqFile::readFrames(int index, int beginFrame, int numFrames, AbstractSeq* seq)
+{
+    return impl->readFrames(index, beginFrame, numFrames, seq);
+}
+
+
+bool BinarySeqFile::Impl::readFrames(int index, int beginFrame, int numFrames, AbstractSeq* seq)
+{
+    auto& record = records[index];
+    auto accessor = createAccessor(seq);
+    if(!accessor || seq->seqType() != record.type || accessor->numScalars() != record.numScalars){
+        os() << format(_("The sequence \"{0}\" cannot be read into a sequence of type {1}."),
+                       record.name, seq->seqType()) << endl;
+        return false;
+    }
+
+    beginFrame = std::max(0, std::min(beginFrame, static_cast<int>(record.numFrames)));
+    const int endFrame = std::min(beginFrame + std::max(0, numFrames), static_cast<int>(record.numFrames));
+
+    seq->setFrameRate(record.frameRate);
+    seq->setOffsetTime(record.offsetTime);
+    if(!record.contentName.empty()){
+        seq->setSeqContentName(record.contentName);
+    }
+    accessor->setDimension(endFrame - beginFrame, record.numParts);
+
+    const int frameSize = record.numParts * record.numScalars;
+    int frame = beginFrame;
+    try {
+        while(frame < endFrame){
+            const int chunkIndex = frame / record.numChunkFrames;
+            decodeChunk(record, chunkIndex);
+            const int chunkBegin = chunkIndex * record.numChunkFrames;
+            const int chunkEnd = std::min(chunkBegin + record.numChunkFrames, endFrame);
+            for(; frame < chunkEnd; ++frame){
+                accessor->setFrame(frame - beginFrame, &buffer[(frame - chunkBegin) * frameSize]);
+            }
+        }
+    }
+    catch(const file_read_error& ex){
+        os() << format(_("The sequence \"{0}\" cannot be read: {1}"),
+                       record.name, *boost::get_error_info<error_info_message>(ex)) << endl;
+        return false;
+    }
+
+    return true;
+}
+
+
+void BinarySeqFile::Impl::decodeChunk(const SeqRecord& record, int chunkIndex)
+{
+    auto& chunk = record.chunks[chunkIndex];
+    const int chunkBegin = chunkIndex * record.numChunkFrames;
+    const int n = std::min(record.numChunkFrames, record.numFrames - chunkBegin);
+    buffer.resize(n * record.numParts * record.numScalars);
+    uLongf size = buffer.size() * sizeof(double);
+    const unsigned char* data = file->data() + chunk.offset;
+
+    if(chunk.flags & CompressedChunkFlag){
+        uLongf decompressedSize = size;
+        if(uncompress(reinterpret_cast<Bytef*>(buffer.data()), &decompressedSize, data, chunk.size) != Z_OK ||
+           decompressedSize != size){
+            throw file_read_error() << error_info_message(_("A chunk cannot be decompressed."));
+        }
+    } else {
+        if(chunk.size != size){
+            throw file_read_error() << error_info_message(_("The size of a chunk is invalid."));
+        }
+        memcpy(buffer.data(), data, size);
+    }
+}
@@ -0,0 +1,71 @@
+#ifndef CNOID_UTIL_BINARY_SEQ_FILE_H
+#define CNOID_UTIL_BINARY_SEQ_FILE_H
+
+#include "NullOut.h"
+#include <string>
+#include <memory>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+class AbstractSeq;
+
+/**
+   This class writes and reads the binary sequence file format, which stores multiple sequences
+   with their names. The frames of each sequence are divided into chunks of a fixed number of
+   frames, and each chunk can be compressed with the deflate algorithm. The file is mapped to the
+   memory in reading it, and only the chunks covering the requested frames are decoded.
+
+   The supported sequence types are MultiValueSeq, Vector3Seq, MultiVector3Seq, MultiSE3Seq and
+   MultiSE3MatrixSeq.
+*/
+class CNOID_EXPORT BinarySeqFile
+{
+public:
+    BinarySeqFile();
+    ~BinarySeqFile();
+
+    BinarySeqFile(const BinarySeqFile&) = delete;
+    BinarySeqFile& operator=(const BinarySeqFile&) = delete;
+
+    static bool isSupportedSeq(const AbstractSeq* seq);
+
+    void setMessageSink(std::ostream& os);
+
+    //! The compression is disabled by default
+    void setCompressionEnabled(bool on);
+    void setNumChunkFrames(int n);
+
+    void addSeq(const std::string& name, AbstractSeq* seq);
+    bool save(const std::string& filename);
+
+    bool open(const std::string& filename);
+    void close();
+    bool isOpen() const;
+
+    int numSeqs() const;
+    const std::string& seqName(int index) const;
+    const std::string& seqType(int index) const;
+    int numFrames(int index) const;
+    int findSeq(const std::string& name) const;
+
+    //! \return nullptr if the sequence cannot be read
+    std::shared_ptr<AbstractSeq> readSeq(int index);
+
+    //! The seq must be of the type given by the seqType function
+    bool readSeq(int index, AbstractSeq* seq);
+
+    /**
+       Reads the frames from beginFrame to beginFrame + numFrames - 1 into the frames of the seq
+       from 0. The number of the frames of the seq is set to the number of the read frames.
+    */
+    bool readFrames(int index, int beginFrame, int numFrames, AbstractSeq* seq);
+
+private:
+    class Impl;
+    Impl* impl;
+};
+
+}
+
+#endif
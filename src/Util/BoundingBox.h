@@ -21,6 +21,7 @@ public:
     BoundingBox(const Vector3& min, const Vector3& max);
     BoundingBox(const BoundingBox& org);
     BoundingBox(const BoundingBoxf& org);
+    BoundingBox& operator=(const BoundingBox& rhs) = default;
 
     bool operator==(const BoundingBox& rhs) const {
         return (min_ == rhs.min_) && (max_ == rhs.max_);
@@ -65,6 +66,7 @@ public:
     BoundingBoxf(const Vector3f& min, const Vector3f& max);
     BoundingBoxf(const BoundingBoxf& org);
     BoundingBoxf(const BoundingBox& org);
+    BoundingBoxf& operator=(const BoundingBoxf& rhs) = default;
         
     bool operator==(const BoundingBoxf& rhs) const {
         return (min_ == rhs.min_) && (max_ == rhs.max_);
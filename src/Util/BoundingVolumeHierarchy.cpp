@@ -0,0 +1,522 @@
+#include "BoundingVolumeHierarchy.h"
+#include "SceneDrawables.h"
+#include <cnoid/ConnectionSet>
+#include <algorithm>
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+constexpr int MaxLeafSize = 4;
+constexpr int MaxTreeDepth = 64;
+
+// The tree is built again when the total surface area of the refitted boxes exceeds this ratio
+constexpr double RebuildingAreaRatio = 2.0;
+
+struct TreeNode
+{
+    BoundingBox bbox;
+    // The first index of the shapes under the node in the shapeOrder array
+    int first;
+    // The number of the shapes in a leaf node, or zero for an internal node
+    int count;
+    // The left child immediately follows its parent in the array
+    int right;
+    bool isLeaf() const { return count > 0; }
+};
+
+double getSurfaceArea(const BoundingBox& bbox)
+{
+    if(bbox.empty()){
+        return 0.0;
+    }
+    const Vector3 s = bbox.size();
+    return 2.0 * (s.x() * s.y() + s.y() * s.z() + s.z() * s.x());
+}
+
+bool intersectRayWithBox
+(const BoundingBox& bbox, const Vector3& origin, const Vector3& invDirection, double maxDistance, double& out_distance)
+{
+    double tmin = 0.0;
+    double tmax = maxDistance;
+    for(int i=0; i < 3; ++i){
+        double t1 = (bbox.min()[i] - origin[i]) * invDirection[i];
+        double t2 = (bbox.max()[i] - origin[i]) * invDirection[i];
+        if(t1 > t2){
+            std::swap(t1, t2);
+        }
+        // The comparisons are written so that NaN does not narrow the range
+        if(t1 > tmin){
+            tmin = t1;
+        }
+        if(t2 < tmax){
+            tmax = t2;
+        }
+        if(tmin > tmax){
+            return false;
+        }
+    }
+    out_distance = tmin;
+    return true;
+}
+
+/**
+   \return -1 if the box is outside the planes, 1 if the box is inside the planes, or 0
+   if the box intersects the boundary
+*/
+int checkBoxWithPlanes(const BoundingBox& bbox, const Vector4* planes, int numPlanes)
+{
+    const Vector3 center = bbox.center();
+    const Vector3 extent = bbox.size() / 2.0;
+    int result = 1;
+    for(int i=0; i < numPlanes; ++i){
+        const Vector3 n = planes[i].head<3>();
+        const double d = n.dot(center) + planes[i][3];
+        const double r = n.cwiseAbs().dot(extent);
+        if(d + r < 0.0){
+            return -1;
+        } else if(d - r < 0.0){
+            result = 0;
+        }
+    }
+    return result;
+}
+
+bool checkBoxIntersection(const BoundingBox& bbox1, const BoundingBox& bbox2)
+{
+    return (bbox1.min().array() <= bbox2.max().array()).all() &&
+        (bbox2.min().array() <= bbox1.max().array()).all();
+}
+
+bool checkBoxContainment(const BoundingBox& bbox, const Vector3& point)
+{
+    return (bbox.min().array() <= point.array()).all() && (point.array() <= bbox.max().array()).all();
+}
+
+}
+
+namespace cnoid {
+
+class BoundingVolumeHierarchy::Impl
+{
+public:
+    CompiledScene compiledScene;
+    ScopedConnection rootConnection;
+    bool isGeometryModified;
+    vector<SgShape*> builtShapes;
+    vector<BoundingBox> shapeBoxes;
+    vector<Vector3> shapeCenters;
+    vector<int> shapeOrder;
+    vector<TreeNode> nodes;
+    double builtSurfaceArea;
+    BoundingBox emptyBoundingBox;
+
+    Impl();
+    void setRoot(SgNode* root);
+    void onSceneUpdated(const SgUpdate& update);
+    bool sync();
+    void updateShapeBoxes();
+    void rebuild();
+    int buildSubTree(int begin, int end);
+    void refit();
+    int getShapeRangeEnd(int nodeIndex) const;
+
+    template<class NodeChecker, class ShapeFunction>
+    void traverse(NodeChecker checkNode, ShapeFunction processShape) const;
+};
+
+}
+
+
+BoundingVolumeHierarchy::BoundingVolumeHierarchy()
+{
+    impl = new Impl;
+}
+
+
+BoundingVolumeHierarchy::BoundingVolumeHierarchy(SgNode* root)
+    : BoundingVolumeHierarchy()
+{
+    setRoot(root);
+}
+
+
+BoundingVolumeHierarchy::Impl::Impl()
+{
+    isGeometryModified = false;
+    builtSurfaceArea = 0.0;
+}
+
+
+BoundingVolumeHierarchy::~BoundingVolumeHierarchy()
+{
+    delete impl;
+}
+
+
+void BoundingVolumeHierarchy::setRoot(SgNode* root)
+{
+    impl->setRoot(root);
+}
+
+
+void BoundingVolumeHierarchy::Impl::setRoot(SgNode* root)
+{
+    if(root){
+        rootConnection =
+            root->sigUpdated().connect(
+                [&](const SgUpdate& update){ onSceneUpdated(update); });
+    } else {
+        rootConnection.disconnect();
+    }
+    compiledScene.setRoot(root);
+    isGeometryModified = false;
+    rebuild();
+}
+
+
+SgNode* BoundingVolumeHierarchy::root() const
+{
+    return impl->compiledScene.root();
+}
+
+
+/**
+   The modifications of the transforms are tracked by the compiled scene, and the other
+   geometry modifications such as the ones of the meshes are tracked here.
+*/
+void BoundingVolumeHierarchy::Impl::onSceneUpdated(const SgUpdate& update)
+{
+    if(!isGeometryModified && update.hasAction(SgUpdate::GeometryModified) &&
+       !update.path().front()->isTransformNode()){
+        isGeometryModified = true;
+    }
+}
+
+
+bool BoundingVolumeHierarchy::sync()
+{
+    return impl->sync();
+}
+
+
+bool BoundingVolumeHierarchy::Impl::sync()
+{
+    bool isCompiledSceneChanged = compiledScene.sync();
+    if(!isCompiledSceneChanged && !isGeometryModified){
+        return false;
+    }
+    isGeometryModified = false;
+
+    bool isStructureChanged = false;
+    const int n = compiledScene.numShapes();
+    if(n != static_cast<int>(builtShapes.size())){
+        isStructureChanged = true;
+    } else {
+        for(int i=0; i < n; ++i){
+            if(compiledScene.shape(i).shape != builtShapes[i]){
+                isStructureChanged = true;
+                break;
+            }
+        }
+    }
+    if(isStructureChanged){
+        rebuild();
+    } else {
+        refit();
+    }
+    return true;
+}
+
+
+void BoundingVolumeHierarchy::Impl::updateShapeBoxes()
+{
+    const int n = compiledScene.numShapes();
+    shapeBoxes.clear();
+    shapeBoxes.reserve(n);
+    for(int i=0; i < n; ++i){
+        shapeBoxes.push_back(compiledScene.shape(i).shape->boundingBox());
+        auto& bbox = shapeBoxes.back();
+        if(!bbox.empty()){
+            bbox.transform(compiledScene.shapeTransform(i));
+        }
+    }
+}
+
+
+void BoundingVolumeHierarchy::rebuild()
+{
+    impl->rebuild();
+}
+
+
+void BoundingVolumeHierarchy::Impl::rebuild()
+{
+    const int n = compiledScene.numShapes();
+    builtShapes.resize(n);
+    for(int i=0; i < n; ++i){
+        builtShapes[i] = compiledScene.shape(i).shape;
+    }
+    updateShapeBoxes();
+
+    shapeCenters.resize(n);
+    shapeOrder.resize(n);
+    for(int i=0; i < n; ++i){
+        shapeOrder[i] = i;
+        if(shapeBoxes[i].empty()){
+            shapeCenters[i].setZero();
+        } else {
+            shapeCenters[i] = shapeBoxes[i].center();
+        }
+    }
+
+    nodes.clear();
+    builtSurfaceArea = 0.0;
+    if(n > 0){
+        nodes.reserve(2 * (n / MaxLeafSize) + 1);
+        buildSubTree(0, n);
+        for(auto& node : nodes){
+            builtSurfaceArea += getSurfaceArea(node.bbox);
+        }
+    }
+}
+
+
+/**
+   The shapes are split at the median of the box centers along the longest axis of the centers.
+   The median split keeps the depth of the tree logarithmic for any distribution of the shapes.
+*/
+int BoundingVolumeHierarchy::Impl::buildSubTree(int begin, int end)
+{
+    const int index = nodes.size();
+    nodes.emplace_back();
+
+    auto& bbox = nodes[index].bbox;
+    BoundingBox centerBounds;
+    for(int i = begin; i < end; ++i){
+        const int shapeIndex = shapeOrder[i];
+        bbox.expandBy(shapeBoxes[shapeIndex]);
+        centerBounds.expandBy(shapeCenters[shapeIndex]);
+    }
+
+    const int count = end - begin;
+    if(count <= MaxLeafSize){
+        auto& node = nodes[index];
+        node.first = begin;
+        node.count = count;
+        node.right = -1;
+        return index;
+    }
+
+    int axis;
+    centerBounds.size().maxCoeff(&axis);
+    const int middle = begin + count / 2;
+    std::nth_element(
+        shapeOrder.begin() + begin, shapeOrder.begin() + middle, shapeOrder.begin() + end,
+        [&](int i1, int i2){ return shapeCenters[i1][axis] < shapeCenters[i2][axis]; });
+
+    buildSubTree(begin, middle);
+    const int right = buildSubTree(middle, end);
+    auto& node = nodes[index];
+    node.first = begin;
+    node.count = 0;
+    node.right = right;
+    return index;
+}
+
+
+void BoundingVolumeHierarchy::Impl::refit()
+{
+    updateShapeBoxes();
+
+    // The children always follow their parent in the array
+    double area = 0.0;
+    for(int i = nodes.size() - 1; i >= 0; --i){
+        auto& node = nodes[i];
+        node.bbox.clear();
+        if(node.isLeaf()){
+            for(int j = node.first; j < node.first + node.count; ++j){
+                node.bbox.expandBy(shapeBoxes[shapeOrder[j]]);
+            }
+        } else {
+            node.bbox.expandBy(nodes[i + 1].bbox);
+            node.bbox.expandBy(nodes[node.right].bbox);
+        }
+        area += getSurfaceArea(node.bbox);
+    }
+
+    if(area > builtSurfaceArea * RebuildingAreaRatio){
+        rebuild();
+    }
+}
+
+
+const CompiledScene& BoundingVolumeHierarchy::compiledScene() const
+{
+    return impl->compiledScene;
+}
+
+
+int BoundingVolumeHierarchy::numShapes() const
+{
+    return impl->shapeBoxes.size();
+}
+
+
+const BoundingBox& BoundingVolumeHierarchy::shapeBoundingBox(int shapeIndex) const
+{
+    return impl->shapeBoxes[shapeIndex];
+}
+
+
+const BoundingBox& BoundingVolumeHierarchy::boundingBox() const
+{
+    if(impl->nodes.empty()){
+        return impl->emptyBoundingBox;
+    }
+    return impl->nodes.front().bbox;
+}
+
+
+/**
+   \param checkNode The function returning -1 to skip the node, 1 to accept all the shapes
+   under the node, or 0 to check the children of the node
+   \param processShape The function called for the shapes that are accepted or that are
+   in the leaf nodes passing the check. It must check the box of the shape in the latter case.
+*/
+template<class NodeChecker, class ShapeFunction>
+void BoundingVolumeHierarchy::Impl::traverse(NodeChecker checkNode, ShapeFunction processShape) const
+{
+    if(nodes.empty()){
+        return;
+    }
+    int stack[MaxTreeDepth];
+    int stackSize = 0;
+    stack[stackSize++] = 0;
+
+    while(stackSize > 0){
+        const int index = stack[--stackSize];
+        auto& node = nodes[index];
+        if(node.bbox.empty()){
+            continue;
+        }
+        const int result = checkNode(node.bbox);
+        if(result < 0){
+            continue;
+        }
+        if(result > 0 || node.isLeaf()){
+            const int end = getShapeRangeEnd(index);
+            for(int i = node.first; i < end; ++i){
+                processShape(shapeOrder[i], result > 0);
+            }
+        } else {
+            stack[stackSize++] = node.right;
+            stack[stackSize++] = index + 1;
+        }
+    }
+}
+
+
+/**
+   The shapes under a node are stored contiguously in the shapeOrder array from the first
+   index of the node to the end of its rightmost leaf.
+*/
+int BoundingVolumeHierarchy::Impl::getShapeRangeEnd(int nodeIndex) const
+{
+    while(!nodes[nodeIndex].isLeaf()){
+        nodeIndex = nodes[nodeIndex].right;
+    }
+    auto& leaf = nodes[nodeIndex];
+    return leaf.first + leaf.count;
+}
+
+
+void BoundingVolumeHierarchy::findShapesOnRay
+(const Vector3& origin, const Vector3& direction, std::vector<RayHit>& out_hits, double maxDistance) const
+{
+    out_hits.clear();
+    const Vector3 invDirection = direction.cwiseInverse();
+    double distance;
+
+    impl->traverse(
+        [&](const BoundingBox& bbox){
+            return intersectRayWithBox(bbox, origin, invDirection, maxDistance, distance) ? 0 : -1;
+        },
+        [&](int shapeIndex, bool /* isAccepted */){
+            auto& bbox = impl->shapeBoxes[shapeIndex];
+            if(!bbox.empty() && intersectRayWithBox(bbox, origin, invDirection, maxDistance, distance)){
+                out_hits.push_back({ shapeIndex, distance });
+            }
+        });
+
+    std::sort(out_hits.begin(), out_hits.end(),
+              [](const RayHit& hit1, const RayHit& hit2){ return hit1.distance < hit2.distance; });
+}
+
+
+void BoundingVolumeHierarchy::findShapesInsidePlanes
+(const Vector4* planes, int numPlanes, std::vector<int>& out_shapeIndices) const
+{
+    out_shapeIndices.clear();
+    impl->traverse(
+        [&](const BoundingBox& bbox){
+            return checkBoxWithPlanes(bbox, planes, numPlanes);
+        },
+        [&](int shapeIndex, bool isAccepted){
+            auto& bbox = impl->shapeBoxes[shapeIndex];
+            if(!bbox.empty() && (isAccepted || checkBoxWithPlanes(bbox, planes, numPlanes) >= 0)){
+                out_shapeIndices.push_back(shapeIndex);
+            }
+        });
+}
+
+
+void BoundingVolumeHierarchy::findShapesInFrustum
+(const Matrix4& projectionViewMatrix, std::vector<int>& out_shapeIndices) const
+{
+    // The planes are extracted from the view projection matrix with the normals inward
+    Vector4 planes[6];
+    for(int i=0; i < 3; ++i){
+        planes[i * 2] = projectionViewMatrix.row(3) + projectionViewMatrix.row(i);
+        planes[i * 2 + 1] = projectionViewMatrix.row(3) - projectionViewMatrix.row(i);
+    }
+    findShapesInsidePlanes(planes, 6, out_shapeIndices);
+}
+
+
+void BoundingVolumeHierarchy::findShapesIntersectingBox
+(const BoundingBox& bbox, std::vector<int>& out_shapeIndices) const
+{
+    out_shapeIndices.clear();
+    if(bbox.empty()){
+        return;
+    }
+    impl->traverse(
+        [&](const BoundingBox& nodeBox){
+            return checkBoxIntersection(nodeBox, bbox) ? 0 : -1;
+        },
+        [&](int shapeIndex, bool /* isAccepted */){
+            auto& shapeBox = impl->shapeBoxes[shapeIndex];
+            if(!shapeBox.empty() && checkBoxIntersection(shapeBox, bbox)){
+                out_shapeIndices.push_back(shapeIndex);
+            }
+        });
+}
+
+
+void BoundingVolumeHierarchy::findShapesContainingPoint
+(const Vector3& point, std::vector<int>& out_shapeIndices) const
+{
+    out_shapeIndices.clear();
+    impl->traverse(
+        [&](const BoundingBox& bbox){
+            return checkBoxContainment(bbox, point) ? 0 : -1;
+        },
+        [&](int shapeIndex, bool /* isAccepted */){
+            auto& bbox = impl->shapeBoxes[shapeIndex];
+            if(!bbox.empty() && checkBoxContainment(bbox, point)){
+                out_shapeIndices.push_back(shapeIndex);
+            }
+        });
+}
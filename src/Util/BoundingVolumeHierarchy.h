@@ -0,0 +1,84 @@
+#ifndef CNOID_UTIL_BOUNDING_VOLUME_HIERARCHY_H
+#define CNOID_UTIL_BOUNDING_VOLUME_HIERARCHY_H
+
+#include "CompiledScene.h"
+#include "BoundingBox.h"
+#include <vector>
+#include <limits>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+/**
+   This class builds a bounding volume hierarchy of the axis-aligned bounding boxes of the
+   shapes in a scene graph in the world coordinate, and answers the spatial queries to the
+   shapes with it. The shapes are given by CompiledScene, so the indices of the shapes are
+   the same as those of the CompiledScene instance returned by the compiledScene function.
+
+   The hierarchy is updated by the sync function. When the transforms or the geometries are
+   modified, the boxes of the shapes are updated and the boxes of the hierarchy are refitted
+   to them without changing the tree structure. The tree is built again when the structure of
+   the scene is changed or when the refitted tree becomes much looser than its initial state.
+   The query functions return the shapes whose boxes satisfy the conditions, so the exact
+   tests to the mesh geometries should be done by the callers if necessary.
+*/
+class CNOID_EXPORT BoundingVolumeHierarchy
+{
+public:
+    BoundingVolumeHierarchy();
+    BoundingVolumeHierarchy(SgNode* root);
+    ~BoundingVolumeHierarchy();
+
+    BoundingVolumeHierarchy(const BoundingVolumeHierarchy&) = delete;
+    BoundingVolumeHierarchy& operator=(const BoundingVolumeHierarchy&) = delete;
+
+    void setRoot(SgNode* root);
+    SgNode* root() const;
+
+    /**
+       \return true if the hierarchy is changed by the updates of the scene graph
+       notified after the last synchronization.
+    */
+    bool sync();
+
+    //! Builds the tree from scratch with the current boxes of the shapes
+    void rebuild();
+
+    const CompiledScene& compiledScene() const;
+    int numShapes() const;
+    const BoundingBox& shapeBoundingBox(int shapeIndex) const;
+    const BoundingBox& boundingBox() const;
+
+    struct RayHit
+    {
+        int shapeIndex;
+        //! The distance to the point where the ray enters the box of the shape
+        double distance;
+    };
+
+    /**
+       The hits are sorted in the ascending order of the distances. The direction does not
+       have to be normalized, and the distances are measured in the unit of its length.
+    */
+    void findShapesOnRay(
+        const Vector3& origin, const Vector3& direction, std::vector<RayHit>& out_hits,
+        double maxDistance = std::numeric_limits<double>::max()) const;
+
+    //! The planes are given as (n, d) with the inward normals n so that n.dot(p) + d >= 0 inside.
+    void findShapesInsidePlanes(
+        const Vector4* planes, int numPlanes, std::vector<int>& out_shapeIndices) const;
+
+    //! The frustum planes are extracted from the product of the projection and view matrices.
+    void findShapesInFrustum(const Matrix4& projectionViewMatrix, std::vector<int>& out_shapeIndices) const;
+
+    void findShapesIntersectingBox(const BoundingBox& bbox, std::vector<int>& out_shapeIndices) const;
+    void findShapesContainingPoint(const Vector3& point, std::vector<int>& out_shapeIndices) const;
+
+private:
+    class Impl;
+    Impl* impl;
+};
+
+}
+
+#endif
@@ -1,8 +1,10 @@
 #include "CloneMap.h"
 #include "ClonableReferenced.h"
+#include "MemoryTelemetry.h"
 #include <unordered_map>
 #include <vector>
 #include <mutex>
+#include <cstdint>
 
 using namespace std;
 using namespace cnoid;
@@ -13,6 +15,25 @@ unordered_map<string, int> flagNameToIdMap;
 int idCounter = 0;
 mutex flagMapMutex;
 
+constexpr size_t MinTableSize = 64;
+
+inline size_t hashPointer(const Referenced* object)
+{
+    /*
+      The objects cloned successively are usually allocated successively, so the lower bits
+      are used as they are to keep the entries of such objects close in the table. The upper
+      bits are mixed to avoid the collisions of the objects in the distant memory blocks.
+    */
+    auto x = reinterpret_cast<uintptr_t>(object);
+    return static_cast<size_t>((x >> 4) ^ (x >> 20));
+}
+
+MemoryTelemetry::Counter* getMemoryCounter()
+{
+    static MemoryTelemetry::Counter* counter = MemoryTelemetry::instance()->counter("CloneMap");
+    return counter;
+}
+
 }
 
 namespace cnoid {
@@ -20,7 +41,19 @@ namespace cnoid {
 class CloneMap::Impl
 {
 public:
-    unordered_map<ReferencedPtr, ReferencedPtr> orgToCloneMap;
+    /*
+      The map from the original objects to the clones is an open-addressing hash table with
+      linear probing because a large number of objects are inserted when a world is cloned.
+      An entry whose original object is null is empty. The table size is a power of two and
+      the table is expanded so that the load factor does not exceed 0.75.
+    */
+    struct Entry
+    {
+        ReferencedPtr org;
+        ReferencedPtr clone;
+    };
+    vector<Entry> entries;
+    size_t numEntries;
 
     CloneFunction cloneFunction;
 
@@ -38,6 +71,13 @@ public:
     Impl();
     Impl(const CloneFunction& cloneFunction);
     Impl(const Impl& org);
+    ~Impl();
+    void clear();
+    void reserve(size_t numObjects);
+    void rehash(size_t tableSize);
+    Entry& findEntry(const Referenced* org);
+    Referenced* find(const Referenced* org);
+    void insert(const Referenced* org, Referenced* clone);
 };
 
 }
@@ -52,7 +92,7 @@ CloneMap::CloneMap()
 
 CloneMap::Impl::Impl()
 {
-
+    numEntries = 0;
 }
 
 
@@ -66,7 +106,7 @@ CloneMap::CloneMap(const CloneFunction& cloneFunction)
 CloneMap::Impl::Impl(const CloneFunction& cloneFunction)
     : cloneFunction(cloneFunction)
 {
-
+    numEntries = 0;
 }
 
 
@@ -79,10 +119,17 @@ CloneMap::CloneMap(const CloneMap& org)
 
 
 CloneMap::Impl::Impl(const Impl& org)
-    : orgToCloneMap(org.orgToCloneMap)
+    : entries(org.entries),
+      numEntries(org.numEntries)
       //cloneFunction(org.cloneFunction)
 {
+    getMemoryCounter()->allocated(entries.size() * sizeof(Entry));
+}
+
 
+CloneMap::Impl::~Impl()
+{
+    getMemoryCounter()->freed(entries.size() * sizeof(Entry));
 }
 
 
@@ -94,24 +141,111 @@ CloneMap::~CloneMap()
 
 void CloneMap::clear()
 {
-    impl->orgToCloneMap.clear();
+    impl->clear();
     impl->replaceFunctions.clear();
 }
 
 
+void CloneMap::Impl::clear()
+{
+    // The table is kept to clone the objects again without expanding it
+    if(numEntries > 0){
+        for(auto& entry : entries){
+            entry.org.reset();
+            entry.clone.reset();
+        }
+        numEntries = 0;
+    }
+}
+
+
+void CloneMap::reserve(size_t numObjects)
+{
+    impl->reserve(numObjects);
+}
+
+
+void CloneMap::Impl::reserve(size_t numObjects)
+{
+    size_t tableSize = MinTableSize;
+    while(tableSize * 3 < numObjects * 4){
+        tableSize *= 2;
+    }
+    if(tableSize > entries.size()){
+        rehash(tableSize);
+    }
+}
+
+
+void CloneMap::Impl::rehash(size_t tableSize)
+{
+    vector<Entry> orgEntries(tableSize);
+    orgEntries.swap(entries);
+    getMemoryCounter()->allocated(tableSize * sizeof(Entry));
+    getMemoryCounter()->freed(orgEntries.size() * sizeof(Entry));
+    const size_t mask = tableSize - 1;
+    for(auto& entry : orgEntries){
+        if(entry.org){
+            size_t index = hashPointer(entry.org) & mask;
+            while(entries[index].org){
+                index = (index + 1) & mask;
+            }
+            entries[index].org.swap(entry.org);
+            entries[index].clone.swap(entry.clone);
+        }
+    }
+}
+
+
+CloneMap::Impl::Entry& CloneMap::Impl::findEntry(const Referenced* org)
+{
+    const size_t mask = entries.size() - 1;
+    size_t index = hashPointer(org) & mask;
+    while(true){
+        auto& entry = entries[index];
+        if(!entry.org || entry.org == org){
+            return entry;
+        }
+        index = (index + 1) & mask;
+    }
+}
+
+
+Referenced* CloneMap::Impl::find(const Referenced* org)
+{
+    if(numEntries == 0 || !org){
+        return nullptr;
+    }
+    return findEntry(org).clone;
+}
+
+
+void CloneMap::Impl::insert(const Referenced* org, Referenced* clone)
+{
+    if(!org){
+        return;
+    }
+    if((numEntries + 1) * 4 > entries.size() * 3){
+        rehash(entries.empty() ? MinTableSize : entries.size() * 2);
+    }
+    auto& entry = findEntry(org);
+    if(!entry.org){
+        entry.org = const_cast<Referenced*>(org);
+        ++numEntries;
+    }
+    entry.clone = clone;
+}
+
+
 void CloneMap::setClone(const Referenced* org, Referenced* clone)
 {
-    impl->orgToCloneMap[const_cast<Referenced*>(org)] = clone;
+    impl->insert(org, clone);
 }
 
 
 Referenced* CloneMap::findClone_(const Referenced* org)
 {
-    auto iter = impl->orgToCloneMap.find(const_cast<Referenced*>(org));
-    if(iter != impl->orgToCloneMap.end()){
-        return iter->second;
-    }
-    return nullptr;
+    return impl->find(org);
 }
 
 
@@ -123,7 +257,7 @@ Referenced* CloneMap::findOrCreateClone_(const Referenced* org)
     auto clone = findClone_(org);
     if(!clone){
         clone = impl->cloneFunction(org);
-        impl->orgToCloneMap[const_cast<Referenced*>(org)] = clone;
+        impl->insert(org, clone);
     }
     return clone;
 }
@@ -137,7 +271,7 @@ Referenced* CloneMap::findOrCreateClone_(const ClonableReferenced* org)
     auto clone = findClone_(org);
     if(!clone){
         clone = org->doClone(this);
-        impl->orgToCloneMap[const_cast<ClonableReferenced*>(org)] = clone;
+        impl->insert(org, clone);
     }
     return clone;
 }
@@ -152,7 +286,7 @@ Referenced* CloneMap::findOrCreateClone_
     auto clone = findClone_(org);
     if(!clone){
         clone = cloneFunction(org);
-        impl->orgToCloneMap[const_cast<Referenced*>(org)] = clone;
+        impl->insert(org, clone);
     }
     return clone;
 }
@@ -187,7 +321,24 @@ void CloneMap::replacePendingObjects()
 
 void CloneMap::setOriginalAsClone(const Referenced* org)
 {
-    impl->orgToCloneMap[const_cast<Referenced*>(org)] = const_cast<Referenced*>(org);
+    impl->insert(org, const_cast<Referenced*>(org));
+}
+
+
+void CloneMap::removeClonesIf(std::function<bool(const Referenced* org)> predicate)
+{
+    // The remaining entries are inserted again because an entry cannot simply be
+    // emptied in the linear probing
+    vector<Impl::Entry> remainingEntries;
+    for(auto& entry : impl->entries){
+        if(entry.org && !predicate(entry.org)){
+            remainingEntries.push_back(std::move(entry));
+        }
+    }
+    impl->clear();
+    for(auto& entry : remainingEntries){
+        impl->insert(entry.org, entry.clone);
+    }
 }
 
 
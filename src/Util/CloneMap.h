@@ -22,6 +22,12 @@ public:
 
     void clear();
 
+    /**
+       Reserve the space for the given number of objects so that the map is not expanded
+       while a large number of objects are cloned.
+    */
+    void reserve(size_t numObjects);
+
     void setClone(const Referenced* org, Referenced* clone);
 
     template<class ObjectType>
@@ -87,6 +93,9 @@ public:
 
     void setOriginalAsClone(const Referenced* org);
 
+    //! Remove the clones of the original objects for which the predicate returns true.
+    void removeClonesIf(std::function<bool(const Referenced* org)> predicate);
+
     class FlagId {
         int id_;
     public:
@@ -152,3 +152,15 @@ CollisionDetector::~CollisionDetector()
 {
 
 }
+
+
+bool CollisionDetector::removeGeometry(GeometryHandle /* geometry */)
+{
+    return false;
+}
+
+
+bool CollisionDetector::setContinuousCollisionDetectionEnabled(GeometryHandle /* geometry */, bool /* on */)
+{
+    return false;
+}
@@ -9,6 +9,8 @@
 #include "Collision.h"
 #include "Referenced.h"
 #include <cnoid/stdx/optional>
+#include <vector>
+#include <limits>
 #include <cstdint>
 #include "exportdecl.h"
 
@@ -45,8 +47,25 @@ public:
        \return A handle of the geometry in the collision detector
     */
     virtual stdx::optional<GeometryHandle> addGeometry(SgNode* geometry) = 0;
+
+    /**
+       Removes a geometry added by addGeometry(). The handle becomes invalid.
+       \return false if the detector does not support removing a geometry, which is the default
+    */
+    virtual bool removeGeometry(GeometryHandle geometry);
+
     virtual void setCustomObject(GeometryHandle geometry, Referenced* object) = 0;
     virtual void setGeometryStatic(GeometryHandle geometry, bool isStatic = true) = 0;
+
+    /**
+       Enables the continuous collision detection of a geometry. The collisions of the geometry
+       are then detected along its motion from the position of the previous detection so that a
+       thin or fast geometry does not pass through the others between the detections.
+       \return false if the detector does not support the continuous collision detection,
+       which is the default
+    */
+    virtual bool setContinuousCollisionDetectionEnabled(GeometryHandle geometry, bool on = true);
+
     virtual void ignoreGeometryPair(GeometryHandle geometry1, GeometryHandle geometry2, bool ignore = true) = 0;
     virtual bool makeReady() = 0;
     
@@ -66,6 +85,71 @@ public:
     virtual double detectDistance(
         CollisionDetector::GeometryHandle geometry1, CollisionDetector::GeometryHandle geometry2,
         Vector3& out_point1, Vector3& out_point2) = 0;
+
+    class DistanceQuery
+    {
+    public:
+        DistanceQuery() { }
+        DistanceQuery(CollisionDetector::GeometryHandle geometry1, CollisionDetector::GeometryHandle geometry2)
+            : geometry1(geometry1), geometry2(geometry2) { }
+        
+        CollisionDetector::GeometryHandle geometry1;
+        CollisionDetector::GeometryHandle geometry2;
+        //! The distance, or a lower bound of it when it is larger than the threshold
+        double distance;
+        //! The closest points, which are not set when the distance is larger than the threshold
+        Vector3 point1;
+        Vector3 point2;
+    };
+
+    /**
+       Detects the distances of the geometry pairs given as the elements of io_queries.
+       The calculation of a pair is cut short when its distance turns out to be larger than
+       the threshold, so give the largest distance of interest to reduce the calculation.
+       The implementation may process the pairs in parallel.
+    */
+    virtual void detectDistances(
+        std::vector<DistanceQuery>& io_queries, double /* threshold */ = std::numeric_limits<double>::max()){
+        for(auto& query : io_queries){
+            query.distance = detectDistance(query.geometry1, query.geometry2, query.point1, query.point2);
+        }
+    }
+
+    /**
+       Detects the distances between a geometry and all the other geometries except the ones
+       paired with it by ignoreGeometryPair. The pairs within the threshold are stored in out_queries.
+    */
+    virtual void detectDistances(
+        CollisionDetector::GeometryHandle geometry, double threshold, std::vector<DistanceQuery>& out_queries) = 0;
+};
+
+
+class CollisionDetectorRayCastAPI
+{
+public:
+    class RayQuery
+    {
+    public:
+        RayQuery() { }
+        RayQuery(const Vector3& origin, const Vector3& direction, double maxDistance)
+            : origin(origin), direction(direction), maxDistance(maxDistance) { }
+
+        Vector3 origin;
+        //! This must be normalized
+        Vector3 direction;
+        double maxDistance;
+        //! The distance to the closest hit point, or infinity when the ray hits no geometry
+        double distance;
+        //! The geometry hit by the ray, which is not set when the ray hits no geometry
+        CollisionDetector::GeometryHandle geometry;
+    };
+
+    /**
+       Finds the closest geometries hit by the rays given as the elements of io_queries.
+       The faces hit from the back side are ignored so that the rays cast from the inside
+       of a geometry go through it. The implementation may process the rays in parallel.
+    */
+    virtual void castRays(std::vector<RayQuery>& io_queries) = 0;
 };
 
 
@@ -0,0 +1,261 @@
+#include "CompiledScene.h"
+#include "SceneDrawables.h"
+#include "PolymorphicSceneNodeFunctionSet.h"
+#include <cnoid/ConnectionSet>
+#include <unordered_map>
+
+using namespace std;
+using namespace cnoid;
+
+namespace cnoid {
+
+class CompiledScene::Impl
+{
+public:
+    CompiledScene* self;
+    SgNodePtr root;
+    ScopedConnection rootConnection;
+    PolymorphicSceneNodeFunctionSet functions;
+    int currentTransformIndex;
+
+    // The objects in the arrays are kept alive until the scene is compiled again
+    vector<SgObjectPtr> compiledObjects;
+
+    // A transform node shared by some paths has multiple indices
+    unordered_multimap<SgObject*, int> transformIndexMap;
+
+    bool isCompilationNeeded;
+    vector<int> modifiedTransformIndices;
+
+    Impl(CompiledScene* self);
+    void setRoot(SgNode* root);
+    void onSceneUpdated(const SgUpdate& update);
+    bool sync();
+    void compile();
+    void visitGroup(SgGroup* group);
+    void visitSwitchableGroup(SgSwitchableGroup* group);
+    void visitLOD(SgLOD* lod);
+    void visitTransform(SgTransform* transform);
+    void visitShape(SgShape* shape);
+    void updateGlobalTransforms(int beginIndex);
+};
+
+}
+
+
+CompiledScene::CompiledScene()
+{
+    impl = new Impl(this);
+}
+
+
+CompiledScene::CompiledScene(SgNode* root)
+    : CompiledScene()
+{
+    setRoot(root);
+}
+
+
+CompiledScene::Impl::Impl(CompiledScene* self)
+    : self(self)
+{
+    functions.setFunction<SgGroup>(
+        [&](SgGroup* node){ visitGroup(node); });
+    functions.setFunction<SgSwitchableGroup>(
+        [&](SgSwitchableGroup* node){ visitSwitchableGroup(node); });
+    functions.setFunction<SgLOD>(
+        [&](SgLOD* node){ visitLOD(node); });
+    functions.setFunction<SgTransform>(
+        [&](SgTransform* node){ visitTransform(node); });
+    functions.setFunction<SgShape>(
+        [&](SgShape* node){ visitShape(node); });
+    functions.updateDispatchTable();
+
+    isCompilationNeeded = false;
+}
+
+
+CompiledScene::~CompiledScene()
+{
+    delete impl;
+}
+
+
+void CompiledScene::setRoot(SgNode* root)
+{
+    impl->setRoot(root);
+}
+
+
+void CompiledScene::Impl::setRoot(SgNode* root)
+{
+    this->root = root;
+    if(root){
+        rootConnection =
+            root->sigUpdated().connect(
+                [&](const SgUpdate& update){ onSceneUpdated(update); });
+    } else {
+        rootConnection.disconnect();
+    }
+    compile();
+}
+
+
+SgNode* CompiledScene::root() const
+{
+    return impl->root;
+}
+
+
+void CompiledScene::Impl::onSceneUpdated(const SgUpdate& update)
+{
+    if(isCompilationNeeded){
+        return;
+    }
+    if(update.hasAction(SgUpdate::Added | SgUpdate::Removed)){
+        isCompilationNeeded = true;
+        return;
+    }
+    auto object = update.path().front();
+    if(dynamic_cast<SgSwitch*>(object) || dynamic_cast<SgSwitchableGroup*>(object)){
+        isCompilationNeeded = true;
+        return;
+    }
+    if(update.hasAction(SgUpdate::GeometryModified)){
+        auto range = transformIndexMap.equal_range(object);
+        for(auto p = range.first; p != range.second; ++p){
+            modifiedTransformIndices.push_back(p->second);
+        }
+    }
+}
+
+
+bool CompiledScene::sync()
+{
+    return impl->sync();
+}
+
+
+bool CompiledScene::Impl::sync()
+{
+    if(isCompilationNeeded){
+        compile();
+        return true;
+    }
+    if(modifiedTransformIndices.empty()){
+        return false;
+    }
+    int minIndex = self->numTransforms();
+    for(auto& index : modifiedTransformIndices){
+        self->transformNodes_[index]->getTransform(self->localTransforms_[index]);
+        if(index < minIndex){
+            minIndex = index;
+        }
+    }
+    modifiedTransformIndices.clear();
+
+    // The transforms before the first modified one are not affected
+    updateGlobalTransforms(minIndex);
+
+    return true;
+}
+
+
+void CompiledScene::Impl::compile()
+{
+    self->transformNodes_.clear();
+    self->parentIndices_.clear();
+    self->localTransforms_.clear();
+    self->globalTransforms_.clear();
+    self->shapes_.clear();
+    compiledObjects.clear();
+    transformIndexMap.clear();
+    modifiedTransformIndices.clear();
+    isCompilationNeeded = false;
+
+    self->transformNodes_.push_back(nullptr);
+    self->parentIndices_.push_back(-1);
+    self->localTransforms_.push_back(Affine3::Identity());
+    currentTransformIndex = 0;
+
+    if(root){
+        functions.dispatch(root);
+    }
+
+    self->globalTransforms_.resize(self->localTransforms_.size());
+    updateGlobalTransforms(0);
+}
+
+
+void CompiledScene::Impl::updateGlobalTransforms(int beginIndex)
+{
+    auto& parentIndices = self->parentIndices_;
+    auto& localTransforms = self->localTransforms_;
+    auto& globalTransforms = self->globalTransforms_;
+    const int n = parentIndices.size();
+
+    // The parent of a transform always precedes it in the arrays
+    for(int i = beginIndex; i < n; ++i){
+        const int parentIndex = parentIndices[i];
+        if(parentIndex < 0){
+            globalTransforms[i] = localTransforms[i];
+        } else {
+            globalTransforms[i] = globalTransforms[parentIndex] * localTransforms[i];
+        }
+    }
+}
+
+
+void CompiledScene::Impl::visitGroup(SgGroup* group)
+{
+    for(auto& child : *group){
+        functions.dispatch(child);
+    }
+}
+
+
+void CompiledScene::Impl::visitSwitchableGroup(SgSwitchableGroup* group)
+{
+    if(group->isTurnedOn()){
+        visitGroup(group);
+    }
+}
+
+
+void CompiledScene::Impl::visitLOD(SgLOD* lod)
+{
+    if(!lod->empty()){
+        functions.dispatch(lod->child(0));
+    }
+}
+
+
+void CompiledScene::Impl::visitTransform(SgTransform* transform)
+{
+    const int index = self->parentIndices_.size();
+    self->transformNodes_.push_back(transform);
+    self->parentIndices_.push_back(currentTransformIndex);
+    self->localTransforms_.emplace_back();
+    transform->getTransform(self->localTransforms_.back());
+    transformIndexMap.emplace(transform, index);
+    compiledObjects.push_back(transform);
+
+    const int parentIndex = currentTransformIndex;
+    currentTransformIndex = index;
+    visitGroup(transform);
+    currentTransformIndex = parentIndex;
+}
+
+
+void CompiledScene::Impl::visitShape(SgShape* shape)
+{
+    if(auto mesh = shape->mesh()){
+        auto material = shape->material();
+        self->shapes_.push_back({ shape, mesh, material, currentTransformIndex });
+        compiledObjects.push_back(shape);
+        compiledObjects.push_back(mesh);
+        if(material){
+            compiledObjects.push_back(material);
+        }
+    }
+}
@@ -0,0 +1,84 @@
+#ifndef CNOID_UTIL_COMPILED_SCENE_H
+#define CNOID_UTIL_COMPILED_SCENE_H
+
+#include "EigenTypes.h"
+#include <vector>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+class SgNode;
+class SgTransform;
+class SgShape;
+class SgMesh;
+class SgMaterial;
+
+/**
+   This class flattens the transforms and shapes of a scene graph into arrays so that
+   the consumers which only read the scene can iterate them linearly. The transforms are
+   stored in the depth-first order and each transform refers to the index of its parent
+   transform, so the global transforms are computed by a single pass over the array.
+   The transform of index 0 corresponds to the coordinate frame of the root node.
+
+   The arrays are updated by the sync function. The local transforms of the modified
+   transform nodes are updated incrementally, and the whole scene is compiled again when
+   nodes are added or removed, or when a switch is changed. The highest detail level of
+   each SgLOD node is compiled.
+*/
+class CNOID_EXPORT CompiledScene
+{
+public:
+    CompiledScene();
+    CompiledScene(SgNode* root);
+    ~CompiledScene();
+
+    CompiledScene(const CompiledScene&) = delete;
+    CompiledScene& operator=(const CompiledScene&) = delete;
+
+    void setRoot(SgNode* root);
+    SgNode* root() const;
+
+    /**
+       \return true if the arrays are changed by the updates of the scene graph
+       notified after the last synchronization.
+    */
+    bool sync();
+
+    typedef std::vector<Affine3, Eigen::aligned_allocator<Affine3>> Affine3Array;
+
+    int numTransforms() const { return static_cast<int>(parentIndices_.size()); }
+    //! \return nullptr for the transform of index 0
+    SgTransform* transformNode(int index) const { return transformNodes_[index]; }
+    const std::vector<int>& parentIndices() const { return parentIndices_; }
+    const Affine3Array& localTransforms() const { return localTransforms_; }
+    const Affine3Array& globalTransforms() const { return globalTransforms_; }
+
+    struct Shape
+    {
+        SgShape* shape;
+        SgMesh* mesh;
+        SgMaterial* material;
+        int transformIndex;
+    };
+
+    int numShapes() const { return static_cast<int>(shapes_.size()); }
+    const Shape& shape(int index) const { return shapes_[index]; }
+    const std::vector<Shape>& shapes() const { return shapes_; }
+    const Affine3& shapeTransform(int index) const {
+        return globalTransforms_[shapes_[index].transformIndex];
+    }
+
+private:
+    std::vector<SgTransform*> transformNodes_;
+    std::vector<int> parentIndices_;
+    Affine3Array localTransforms_;
+    Affine3Array globalTransforms_;
+    std::vector<Shape> shapes_;
+
+    class Impl;
+    Impl* impl;
+};
+
+}
+
+#endif
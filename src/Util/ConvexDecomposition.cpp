@@ -0,0 +1,935 @@
+#include "ConvexDecomposition.h"
+#include "MeshExtractor.h"
+#include "SceneGraph.h"
+#include "UTF8.h"
+#include <cnoid/stdx/filesystem>
+#include <unordered_map>
+#include <fstream>
+#include <cstdlib>
+#include <cstdint>
+#include <cstdio>
+#include <limits>
+#include <algorithm>
+
+using namespace std;
+using namespace cnoid;
+namespace filesystem = cnoid::stdx::filesystem;
+
+namespace {
+
+const uint32_t CacheFileMagic = 0x44434e43; // "CNCD"
+const uint32_t CacheFileVersion = 1;
+
+inline int64_t getEdgeKey(int a, int b)
+{
+    return (static_cast<int64_t>(a) << 32) | static_cast<uint32_t>(b);
+}
+
+/**
+   Quickhull. The points farthest from the current hull are added first so that the hull
+   with the limited number of vertices approximates the whole hull well.
+*/
+class ConvexHullBuilder
+{
+public:
+    struct Face
+    {
+        int vertices[3];
+        Vector3 normal;
+        double d;
+        vector<int> outsidePoints;
+        int farthestPoint;
+        double farthestDistance;
+        bool isAlive;
+        int visitId;
+    };
+
+    const vector<Vector3>& points;
+    const vector<int>& pointIndices;
+    double epsilon;
+    vector<Face> faces;
+    unordered_map<int64_t, int> edgeToFaceMap;
+    int visitId;
+
+    vector<Vector3> hullVertices;
+    vector<int> hullTriangles;
+    double volume;
+
+    ConvexHullBuilder(const vector<Vector3>& points, const vector<int>& pointIndices)
+        : points(points), pointIndices(pointIndices) { }
+    bool build(int maxNumVertices);
+    bool createInitialTetrahedron();
+    int addFace(int v0, int v1, int v2);
+    void assignPoints(const vector<int>& candidates, const vector<int>& newFaces);
+    void addPoint(int faceIndex);
+    void createOutput();
+    double distanceToFace(const Face& face, const Vector3& p) const {
+        return face.normal.dot(p) - face.d;
+    }
+};
+
+}
+
+
+int ConvexHullBuilder::addFace(int v0, int v1, int v2)
+{
+    int index = faces.size();
+    faces.emplace_back();
+    Face& face = faces.back();
+    face.vertices[0] = v0;
+    face.vertices[1] = v1;
+    face.vertices[2] = v2;
+    const Vector3& p0 = points[v0];
+    Vector3 n = (points[v1] - p0).cross(points[v2] - p0);
+    double norm = n.norm();
+    face.normal = (norm > 0.0) ? Vector3(n / norm) : Vector3::Zero();
+    face.d = face.normal.dot(p0);
+    face.farthestPoint = -1;
+    face.farthestDistance = 0.0;
+    face.isAlive = true;
+    face.visitId = 0;
+    edgeToFaceMap[getEdgeKey(v0, v1)] = index;
+    edgeToFaceMap[getEdgeKey(v1, v2)] = index;
+    edgeToFaceMap[getEdgeKey(v2, v0)] = index;
+    return index;
+}
+
+
+bool ConvexHullBuilder::createInitialTetrahedron()
+{
+    // Extreme points on the axes
+    int extremes[6];
+    for(int i=0; i < 3; ++i){
+        extremes[i * 2] = extremes[i * 2 + 1] = pointIndices[0];
+    }
+    for(auto index : pointIndices){
+        const Vector3& p = points[index];
+        for(int i=0; i < 3; ++i){
+            if(p[i] < points[extremes[i * 2]][i]){
+                extremes[i * 2] = index;
+            }
+            if(p[i] > points[extremes[i * 2 + 1]][i]){
+                extremes[i * 2 + 1] = index;
+            }
+        }
+    }
+    double scale = 0.0;
+    for(int i=0; i < 3; ++i){
+        scale = std::max(scale, points[extremes[i * 2 + 1]][i] - points[extremes[i * 2]][i]);
+    }
+    epsilon = scale * 1.0e-6;
+    if(scale <= 0.0){
+        return false;
+    }
+
+    int i0 = -1, i1 = -1;
+    double maxDistance2 = -1.0;
+    for(int i=0; i < 6; ++i){
+        for(int j = i + 1; j < 6; ++j){
+            double d2 = (points[extremes[i]] - points[extremes[j]]).squaredNorm();
+            if(d2 > maxDistance2){
+                maxDistance2 = d2;
+                i0 = extremes[i];
+                i1 = extremes[j];
+            }
+        }
+    }
+    const Vector3& p0 = points[i0];
+    Vector3 axis = (points[i1] - p0).normalized();
+    int i2 = -1;
+    double maxDistance = epsilon;
+    for(auto index : pointIndices){
+        Vector3 v = points[index] - p0;
+        double d = (v - axis.dot(v) * axis).norm();
+        if(d > maxDistance){
+            maxDistance = d;
+            i2 = index;
+        }
+    }
+    if(i2 < 0){
+        return false;
+    }
+    Vector3 normal = (points[i1] - p0).cross(points[i2] - p0).normalized();
+    int i3 = -1;
+    maxDistance = epsilon;
+    for(auto index : pointIndices){
+        double d = fabs(normal.dot(points[index] - p0));
+        if(d > maxDistance){
+            maxDistance = d;
+            i3 = index;
+        }
+    }
+    if(i3 < 0){
+        return false;
+    }
+    // The faces are oriented to be counterclockwise seen from the outside
+    const Vector3 center = (points[i0] + points[i1] + points[i2] + points[i3]) / 4.0;
+    const int tetrahedron[4][3] = { { i0, i1, i2 }, { i0, i1, i3 }, { i0, i2, i3 }, { i1, i2, i3 } };
+    vector<int> initialFaces;
+    for(auto& v : tetrahedron){
+        const Vector3& q0 = points[v[0]];
+        if((points[v[1]] - q0).cross(points[v[2]] - q0).dot(center - q0) > 0.0){
+            initialFaces.push_back(addFace(v[0], v[2], v[1]));
+        } else {
+            initialFaces.push_back(addFace(v[0], v[1], v[2]));
+        }
+    }
+    vector<int> candidates;
+    candidates.reserve(pointIndices.size());
+    for(auto index : pointIndices){
+        if(index != i0 && index != i1 && index != i2 && index != i3){
+            candidates.push_back(index);
+        }
+    }
+    assignPoints(candidates, initialFaces);
+
+    return true;
+}
+
+
+void ConvexHullBuilder::assignPoints(const vector<int>& candidates, const vector<int>& newFaces)
+{
+    for(auto index : candidates){
+        const Vector3& p = points[index];
+        for(auto faceIndex : newFaces){
+            Face& face = faces[faceIndex];
+            double distance = distanceToFace(face, p);
+            if(distance > epsilon){
+                face.outsidePoints.push_back(index);
+                if(distance > face.farthestDistance){
+                    face.farthestDistance = distance;
+                    face.farthestPoint = index;
+                }
+                break;
+            }
+        }
+    }
+}
+
+
+void ConvexHullBuilder::addPoint(int faceIndex)
+{
+    const int pointIndex = faces[faceIndex].farthestPoint;
+    const Vector3& point = points[pointIndex];
+
+    // Collect the faces visible from the point
+    ++visitId;
+    vector<int> visibleFaces;
+    vector<int> stack = { faceIndex };
+    faces[faceIndex].visitId = visitId;
+    while(!stack.empty()){
+        int current = stack.back();
+        stack.pop_back();
+        visibleFaces.push_back(current);
+        auto& vertices = faces[current].vertices;
+        for(int i=0; i < 3; ++i){
+            auto p = edgeToFaceMap.find(getEdgeKey(vertices[(i + 1) % 3], vertices[i]));
+            if(p != edgeToFaceMap.end()){
+                Face& neighbor = faces[p->second];
+                if(neighbor.visitId != visitId && distanceToFace(neighbor, point) > epsilon){
+                    neighbor.visitId = visitId;
+                    stack.push_back(p->second);
+                }
+            }
+        }
+    }
+
+    // The edges of the visible faces whose opposite faces are not visible make the horizon
+    vector<pair<int, int>> horizon;
+    vector<int> orphanPoints;
+    for(auto index : visibleFaces){
+        Face& face = faces[index];
+        for(int i=0; i < 3; ++i){
+            int a = face.vertices[i];
+            int b = face.vertices[(i + 1) % 3];
+            auto q = edgeToFaceMap.find(getEdgeKey(b, a));
+            if(q == edgeToFaceMap.end() || faces[q->second].visitId != visitId){
+                horizon.emplace_back(a, b);
+            }
+        }
+        for(auto other : face.outsidePoints){
+            if(other != pointIndex){
+                orphanPoints.push_back(other);
+            }
+        }
+        face.outsidePoints.clear();
+        face.isAlive = false;
+    }
+    for(auto index : visibleFaces){
+        auto& vertices = faces[index].vertices;
+        for(int i=0; i < 3; ++i){
+            auto q = edgeToFaceMap.find(getEdgeKey(vertices[i], vertices[(i + 1) % 3]));
+            if(q != edgeToFaceMap.end() && q->second == index){
+                edgeToFaceMap.erase(q);
+            }
+        }
+    }
+
+    vector<int> newFaces;
+    newFaces.reserve(horizon.size());
+    for(auto& edge : horizon){
+        newFaces.push_back(addFace(edge.first, edge.second, pointIndex));
+    }
+    assignPoints(orphanPoints, newFaces);
+}
+
+
+bool ConvexHullBuilder::build(int maxNumVertices)
+{
+    faces.clear();
+    edgeToFaceMap.clear();
+    visitId = 0;
+    hullVertices.clear();
+    hullTriangles.clear();
+    volume = 0.0;
+
+    if(pointIndices.size() < 4 || !createInitialTetrahedron()){
+        return false;
+    }
+
+    int numVertices = 4;
+    while(maxNumVertices <= 0 || numVertices < maxNumVertices){
+        int farthestFace = -1;
+        double maxDistance = 0.0;
+        for(size_t i=0; i < faces.size(); ++i){
+            auto& face = faces[i];
+            if(face.isAlive && !face.outsidePoints.empty() && face.farthestDistance > maxDistance){
+                maxDistance = face.farthestDistance;
+                farthestFace = i;
+            }
+        }
+        if(farthestFace < 0){
+            break;
+        }
+        addPoint(farthestFace);
+        ++numVertices;
+    }
+
+    createOutput();
+
+    return true;
+}
+
+
+void ConvexHullBuilder::createOutput()
+{
+    unordered_map<int, int> vertexIndexMap;
+    for(auto& face : faces){
+        if(face.isAlive){
+            for(int i=0; i < 3; ++i){
+                int index = face.vertices[i];
+                auto inserted = vertexIndexMap.emplace(index, hullVertices.size());
+                if(inserted.second){
+                    hullVertices.push_back(points[index]);
+                }
+                hullTriangles.push_back(inserted.first->second);
+            }
+            const Vector3& p0 = points[face.vertices[0]];
+            const Vector3& p1 = points[face.vertices[1]];
+            const Vector3& p2 = points[face.vertices[2]];
+            volume += p0.dot(p1.cross(p2)) / 6.0;
+        }
+    }
+}
+
+
+namespace cnoid {
+
+class ConvexDecomposition::Impl
+{
+public:
+    int maxNumHulls;
+    int maxNumHullVertices;
+    double concavityThreshold;
+    string cacheDirectory;
+
+    struct Plane
+    {
+        Vector3 normal;
+        double d;
+    };
+    
+    struct Part
+    {
+        vector<int> triangles;
+        vector<Plane> planes; // The half spaces containing the part
+        vector<Vector3> points;
+        vector<Vector3> hullVertices;
+        vector<int> hullTriangles;
+        double volume;
+        double concavity;
+    };
+
+    // Temporary variables for a mesh
+    vector<Vector3> points;
+    const SgIndexArray* triangleVertices;
+    vector<int> pointStamps;
+    int stamp;
+
+    Impl();
+    Impl(const Impl& org);
+    bool decompose(const SgVertexArray& vertices, const SgIndexArray& triangles, const Affine3* T,
+                   vector<SgMeshPtr>& out_hulls);
+    bool decompose(vector<Part>& parts);
+    bool createPart(const vector<int>& triangles, const vector<Plane>& planes, Part& out_part);
+    void calcConcavity(Part& part);
+    bool splitPart(const Part& part, Part& out_part1, Part& out_part2);
+    uint64_t calcHash(const SgVertexArray& vertices, const SgIndexArray& triangles, const Affine3* T) const;
+    string getCacheFilename(uint64_t hash) const;
+    bool loadCache(const string& filename, vector<SgMeshPtr>& out_hulls);
+    void saveCache(const string& filename, const vector<SgMeshPtr>& hulls);
+};
+
+}
+
+
+ConvexDecomposition::ConvexDecomposition()
+{
+    impl = new Impl;
+}
+
+
+ConvexDecomposition::Impl::Impl()
+{
+    maxNumHulls = 16;
+    maxNumHullVertices = 64;
+    concavityThreshold = 0.02;
+    cacheDirectory = defaultCacheDirectory();
+    stamp = 0;
+}
+
+
+ConvexDecomposition::ConvexDecomposition(const ConvexDecomposition& org)
+{
+    impl = new Impl(*org.impl);
+}
+
+
+ConvexDecomposition::Impl::Impl(const Impl& org)
+    : maxNumHulls(org.maxNumHulls),
+      maxNumHullVertices(org.maxNumHullVertices),
+      concavityThreshold(org.concavityThreshold),
+      cacheDirectory(org.cacheDirectory)
+{
+    stamp = 0;
+}
+
+
+ConvexDecomposition::~ConvexDecomposition()
+{
+    delete impl;
+}
+
+
+void ConvexDecomposition::setMaxNumHulls(int n)
+{
+    impl->maxNumHulls = std::max(n, 1);
+}
+
+
+int ConvexDecomposition::maxNumHulls() const
+{
+    return impl->maxNumHulls;
+}
+
+
+void ConvexDecomposition::setMaxNumHullVertices(int n)
+{
+    impl->maxNumHullVertices = (n > 0) ? std::max(n, 4) : 0;
+}
+
+
+int ConvexDecomposition::maxNumHullVertices() const
+{
+    return impl->maxNumHullVertices;
+}
+
+
+void ConvexDecomposition::setConcavityThreshold(double ratio)
+{
+    impl->concavityThreshold = ratio;
+}
+
+
+double ConvexDecomposition::concavityThreshold() const
+{
+    return impl->concavityThreshold;
+}
+
+
+void ConvexDecomposition::setCacheDirectory(const std::string& directory)
+{
+    impl->cacheDirectory = directory;
+}
+
+
+const std::string& ConvexDecomposition::cacheDirectory() const
+{
+    return impl->cacheDirectory;
+}
+
+
+std::string ConvexDecomposition::defaultCacheDirectory()
+{
+    filesystem::path path;
+#ifdef _WIN32
+    if(auto appdata = getenv("LOCALAPPDATA")){
+        path = filesystem::path(appdata) / "Choreonoid" / "cache";
+    }
+#else
+    if(auto cache = getenv("XDG_CACHE_HOME")){
+        path = filesystem::path(cache) / "choreonoid";
+    } else if(auto home = getenv("HOME")){
+        path = filesystem::path(home) / ".cache" / "choreonoid";
+    }
+#endif
+    if(path.empty()){
+        return string();
+    }
+    return toUTF8((path / "convex").string());
+}
+
+
+bool ConvexDecomposition::decompose(SgMesh* mesh, std::vector<SgMeshPtr>& out_hulls)
+{
+    out_hulls.clear();
+    if(!mesh->hasVertices()){
+        return false;
+    }
+    return impl->decompose(*mesh->vertices(), mesh->triangleVertices(), nullptr, out_hulls);
+}
+
+
+SgMesh* ConvexDecomposition::createConvexHull(SgMesh* mesh)
+{
+    int maxNumHulls = impl->maxNumHulls;
+    impl->maxNumHulls = 1;
+    vector<SgMeshPtr> hulls;
+    bool decomposed = decompose(mesh, hulls);
+    impl->maxNumHulls = maxNumHulls;
+    return decomposed ? hulls.front().retn() : nullptr;
+}
+
+
+bool ConvexDecomposition::Impl::decompose
+(const SgVertexArray& vertices, const SgIndexArray& triangles, const Affine3* T, vector<SgMeshPtr>& out_hulls)
+{
+    string cacheFilename;
+    if(!cacheDirectory.empty()){
+        cacheFilename = getCacheFilename(calcHash(vertices, triangles, T));
+        if(loadCache(cacheFilename, out_hulls)){
+            return true;
+        }
+    }
+
+    const int numVertices = vertices.size();
+    points.resize(numVertices);
+    for(int i=0; i < numVertices; ++i){
+        if(T){
+            points[i] = *T * vertices[i].cast<double>();
+        } else {
+            points[i] = vertices[i].cast<double>();
+        }
+    }
+    pointStamps.assign(numVertices, 0);
+    stamp = 0;
+    triangleVertices = &triangles;
+
+    vector<Part> parts(1);
+    vector<int> allTriangles(triangles.size() / 3);
+    for(size_t i=0; i < allTriangles.size(); ++i){
+        allTriangles[i] = i;
+    }
+    bool decomposed = createPart(allTriangles, vector<Plane>(), parts.front());
+    if(decomposed){
+        decomposed = decompose(parts);
+    }
+    points.clear();
+
+    if(!decomposed){
+        return false;
+    }
+
+    out_hulls.clear();
+    for(auto& part : parts){
+        auto mesh = new SgMesh;
+        auto& hullVertices = *mesh->getOrCreateVertices(part.hullVertices.size());
+        for(size_t i=0; i < part.hullVertices.size(); ++i){
+            hullVertices[i] = part.hullVertices[i].cast<float>();
+        }
+        mesh->faceVertexIndices() = part.hullTriangles;
+        mesh->setSolid(true);
+        mesh->updateBoundingBox();
+        out_hulls.push_back(mesh);
+    }
+
+    if(!cacheFilename.empty()){
+        saveCache(cacheFilename, out_hulls);
+    }
+
+    return true;
+}
+
+
+bool ConvexDecomposition::Impl::decompose(vector<Part>& parts)
+{
+    Vector3 lower = points.front();
+    Vector3 upper = points.front();
+    for(auto& p : points){
+        lower = lower.cwiseMin(p);
+        upper = upper.cwiseMax(p);
+    }
+    const double allowableConcavity = concavityThreshold * (upper - lower).norm();
+
+    if(maxNumHulls > 1){
+        calcConcavity(parts.front());
+    }
+
+    while(static_cast<int>(parts.size()) < maxNumHulls){
+        int target = -1;
+        double maxConcavity = allowableConcavity;
+        for(size_t i=0; i < parts.size(); ++i){
+            if(parts[i].concavity > maxConcavity){
+                maxConcavity = parts[i].concavity;
+                target = i;
+            }
+        }
+        if(target < 0){
+            break;
+        }
+        Part part1, part2;
+        if(!splitPart(parts[target], part1, part2)){
+            // The part cannot be split any more
+            parts[target].concavity = 0.0;
+            continue;
+        }
+        calcConcavity(part1);
+        calcConcavity(part2);
+        parts[target] = std::move(part1);
+        parts.push_back(std::move(part2));
+    }
+
+    return true;
+}
+
+
+/**
+   The triangles are clipped by the planes of the part so that the hulls of the parts
+   split from a part do not overlap with each other.
+*/
+bool ConvexDecomposition::Impl::createPart(const vector<int>& triangles, const vector<Plane>& planes, Part& out_part)
+{
+    ++stamp;
+    out_part.triangles.clear();
+    out_part.planes = planes;
+    auto& partPoints = out_part.points;
+    partPoints.clear();
+    const auto& indices = *triangleVertices;
+    vector<Vector3> polygon, clipped;
+    
+    for(auto triangle : triangles){
+        const int* vertices = &indices[triangle * 3];
+        bool isInside = true;
+        for(auto& plane : planes){
+            for(int i=0; i < 3; ++i){
+                if(plane.normal.dot(points[vertices[i]]) > plane.d){
+                    isInside = false;
+                    break;
+                }
+            }
+            if(!isInside){
+                break;
+            }
+        }
+        if(isInside){
+            for(int i=0; i < 3; ++i){
+                int index = vertices[i];
+                if(pointStamps[index] != stamp){
+                    pointStamps[index] = stamp;
+                    partPoints.push_back(points[index]);
+                }
+            }
+            out_part.triangles.push_back(triangle);
+            continue;
+        }
+        polygon = { points[vertices[0]], points[vertices[1]], points[vertices[2]] };
+        for(auto& plane : planes){
+            clipped.clear();
+            const int n = polygon.size();
+            for(int i=0; i < n; ++i){
+                const Vector3& p0 = polygon[i];
+                const Vector3& p1 = polygon[(i + 1) % n];
+                double d0 = plane.normal.dot(p0) - plane.d;
+                double d1 = plane.normal.dot(p1) - plane.d;
+                if(d0 <= 0.0){
+                    clipped.push_back(p0);
+                }
+                if((d0 < 0.0 && d1 > 0.0) || (d0 > 0.0 && d1 < 0.0)){
+                    clipped.push_back(p0 + (p1 - p0) * (d0 / (d0 - d1)));
+                }
+            }
+            polygon.swap(clipped);
+            if(polygon.empty()){
+                break;
+            }
+        }
+        if(!polygon.empty()){
+            partPoints.insert(partPoints.end(), polygon.begin(), polygon.end());
+            out_part.triangles.push_back(triangle);
+        }
+    }
+
+    vector<int> pointIndices(partPoints.size());
+    for(size_t i=0; i < pointIndices.size(); ++i){
+        pointIndices[i] = i;
+    }
+    ConvexHullBuilder builder(partPoints, pointIndices);
+    if(!builder.build(maxNumHullVertices)){
+        return false;
+    }
+    out_part.hullVertices.swap(builder.hullVertices);
+    out_part.hullTriangles.swap(builder.hullTriangles);
+    out_part.volume = builder.volume;
+    out_part.concavity = 0.0;
+    return true;
+}
+
+
+void ConvexDecomposition::Impl::calcConcavity(Part& part)
+{
+    vector<Plane> faces;
+    const int numHullTriangles = part.hullTriangles.size() / 3;
+    for(int i=0; i < numHullTriangles; ++i){
+        const Vector3& p0 = part.hullVertices[part.hullTriangles[i * 3]];
+        const Vector3& p1 = part.hullVertices[part.hullTriangles[i * 3 + 1]];
+        const Vector3& p2 = part.hullVertices[part.hullTriangles[i * 3 + 2]];
+        Vector3 n = (p1 - p0).cross(p2 - p0);
+        double norm = n.norm();
+        if(norm > 0.0){
+            n /= norm;
+            faces.push_back({ n, n.dot(p0) });
+        }
+    }
+
+    double concavity = 0.0;
+    for(auto& p : part.points){
+        double depth = std::numeric_limits<double>::max();
+        for(auto& face : faces){
+            depth = std::min(depth, face.d - face.normal.dot(p));
+        }
+        concavity = std::max(concavity, depth);
+    }
+    part.concavity = concavity;
+}
+
+
+/**
+   The planes perpendicular to the axes at the quarter points of the bounding box of the
+   part are evaluated, and the one minimizing the total volume of the hulls is used.
+*/
+bool ConvexDecomposition::Impl::splitPart(const Part& part, Part& out_part1, Part& out_part2)
+{
+    Vector3 lower = Vector3::Constant(std::numeric_limits<double>::max());
+    Vector3 upper = -lower;
+    for(auto& p : part.points){
+        lower = lower.cwiseMin(p);
+        upper = upper.cwiseMax(p);
+    }
+
+    bool found = false;
+    double minVolume = std::numeric_limits<double>::max();
+    vector<Plane> planes1 = part.planes;
+    vector<Plane> planes2 = part.planes;
+    planes1.emplace_back();
+    planes2.emplace_back();
+    Part part1, part2;
+    
+    for(int axis=0; axis < 3; ++axis){
+        if(upper[axis] - lower[axis] <= 0.0){
+            continue;
+        }
+        for(int k=1; k <= 3; ++k){
+            double position = lower[axis] + (upper[axis] - lower[axis]) * k / 4.0;
+            Vector3 normal = Vector3::Unit(axis);
+            planes1.back() = { normal, position };
+            planes2.back() = { -normal, -position };
+            if(createPart(part.triangles, planes1, part1) && createPart(part.triangles, planes2, part2)){
+                double volume = part1.volume + part2.volume;
+                if(volume < minVolume){
+                    minVolume = volume;
+                    out_part1 = std::move(part1);
+                    out_part2 = std::move(part2);
+                    found = true;
+                }
+            }
+        }
+    }
+
+    return found;
+}
+
+
+//! FNV-1a
+uint64_t ConvexDecomposition::Impl::calcHash
+(const SgVertexArray& vertices, const SgIndexArray& triangles, const Affine3* T) const
+{
+    uint64_t hash = 14695981039346656037ULL;
+    auto update = [&hash](const void* data, size_t size){
+        auto bytes = static_cast<const unsigned char*>(data);
+        for(size_t i=0; i < size; ++i){
+            hash = (hash ^ bytes[i]) * 1099511628211ULL;
+        }
+    };
+    update(&maxNumHulls, sizeof(maxNumHulls));
+    update(&maxNumHullVertices, sizeof(maxNumHullVertices));
+    update(&concavityThreshold, sizeof(concavityThreshold));
+    if(T){
+        update(T->matrix().data(), sizeof(double) * 16);
+    }
+    for(auto& v : vertices){
+        update(v.data(), sizeof(float) * 3);
+    }
+    if(!triangles.empty()){
+        update(triangles.data(), sizeof(int) * triangles.size());
+    }
+    return hash;
+}
+
+
+string ConvexDecomposition::Impl::getCacheFilename(uint64_t hash) const
+{
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.bin", static_cast<unsigned long long>(hash));
+    return toUTF8((filesystem::path(fromUTF8(cacheDirectory)) / name).string());
+}
+
+
+bool ConvexDecomposition::Impl::loadCache(const string& filename, vector<SgMeshPtr>& out_hulls)
+{
+    ifstream ifs(fromUTF8(filename), ios::binary);
+    if(!ifs){
+        return false;
+    }
+    auto read = [&ifs](uint32_t& value){
+        return static_cast<bool>(ifs.read(reinterpret_cast<char*>(&value), sizeof(value)));
+    };
+    uint32_t magic, version, numHulls;
+    if(!read(magic) || magic != CacheFileMagic || !read(version) || version != CacheFileVersion ||
+       !read(numHulls) || numHulls == 0){
+        return false;
+    }
+    vector<SgMeshPtr> hulls;
+    for(uint32_t i=0; i < numHulls; ++i){
+        uint32_t numVertices, numIndices;
+        if(!read(numVertices)){
+            return false;
+        }
+        SgMeshPtr mesh = new SgMesh;
+        auto& vertices = *mesh->getOrCreateVertices(numVertices);
+        if(!ifs.read(reinterpret_cast<char*>(vertices.data()), sizeof(float) * 3 * numVertices) ||
+           !read(numIndices)){
+            return false;
+        }
+        auto& indices = mesh->faceVertexIndices();
+        indices.resize(numIndices);
+        if(!ifs.read(reinterpret_cast<char*>(indices.data()), sizeof(int) * numIndices)){
+            return false;
+        }
+        for(auto index : indices){
+            if(index < 0 || index >= static_cast<int>(numVertices)){
+                return false;
+            }
+        }
+        mesh->setSolid(true);
+        mesh->updateBoundingBox();
+        hulls.push_back(mesh);
+    }
+    out_hulls.swap(hulls);
+    return true;
+}
+
+
+void ConvexDecomposition::Impl::saveCache(const string& filename, const vector<SgMeshPtr>& hulls)
+{
+    filesystem::path path(fromUTF8(filename));
+    stdx::error_code ec;
+    filesystem::create_directories(path.parent_path(), ec);
+
+    // A temporary file is renamed so that the other processes do not read a partial file
+    filesystem::path tmpPath(path);
+    tmpPath += ".tmp";
+    {
+        ofstream ofs(tmpPath.string(), ios::binary);
+        if(!ofs){
+            return;
+        }
+        auto write = [&ofs](uint32_t value){
+            ofs.write(reinterpret_cast<const char*>(&value), sizeof(value));
+        };
+        write(CacheFileMagic);
+        write(CacheFileVersion);
+        write(hulls.size());
+        for(auto& mesh : hulls){
+            auto& vertices = *mesh->vertices();
+            write(vertices.size());
+            ofs.write(reinterpret_cast<const char*>(vertices.data()), sizeof(float) * 3 * vertices.size());
+            auto& indices = mesh->faceVertexIndices();
+            write(indices.size());
+            ofs.write(reinterpret_cast<const char*>(indices.data()), sizeof(int) * indices.size());
+        }
+        if(!ofs){
+            ofs.close();
+            filesystem::remove(tmpPath, ec);
+            return;
+        }
+    }
+    filesystem::rename(tmpPath, path, ec);
+    if(ec){
+        filesystem::remove(tmpPath, ec);
+    }
+}
+
+
+SgNode* ConvexDecomposition::convertShape(SgNode* scene)
+{
+    SgGroupPtr group = new SgGroup;
+    bool isConverted = false;
+    vector<SgMeshPtr> hulls;
+    MeshExtractor extractor;
+
+    extractor.extract(
+        scene,
+        [&](){
+            SgShape* shape = extractor.currentShape();
+            SgMesh* mesh = extractor.currentMesh();
+            bool isScaled = extractor.isCurrentScaled();
+            if((!isScaled && mesh->primitiveType() != SgMesh::MeshType) ||
+               !mesh->hasVertices() ||
+               !impl->decompose(*mesh->vertices(), mesh->triangleVertices(), &extractor.currentTransform(), hulls)){
+                // Keep the original shape
+                SgGroupPtr transform;
+                if(isScaled){
+                    transform = new SgAffineTransform(extractor.currentTransform());
+                } else {
+                    transform = new SgPosTransform(extractor.currentTransformWithoutScaling());
+                }
+                transform->addChild(shape);
+                group->addChild(transform);
+            } else {
+                for(auto& hull : hulls){
+                    auto hullShape = new SgShape;
+                    hullShape->setMesh(hull);
+                    hullShape->setMaterial(shape->material());
+                    hullShape->setName(shape->name());
+                    group->addChild(hullShape);
+                }
+                isConverted = true;
+            }
+        });
+
+    if(!isConverted){
+        return nullptr;
+    }
+    group->setName(scene->name());
+    return group.retn();
+}
@@ -0,0 +1,67 @@
+#ifndef CNOID_UTIL_CONVEX_DECOMPOSITION_H
+#define CNOID_UTIL_CONVEX_DECOMPOSITION_H
+
+#include "SceneDrawables.h"
+#include <string>
+#include <vector>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+/**
+   This class converts the meshes into the convex hulls or the approximate convex decompositions
+   so that the collision detectors can process the heavy meshes with bounded-size convex shapes.
+   A mesh is recursively split by the planes minimizing the total volume of the hulls until the
+   concavity of each part becomes smaller than the threshold. The results are cached on disk
+   with the hash of the mesh and the parameters when the cache directory is not empty.
+*/
+class CNOID_EXPORT ConvexDecomposition
+{
+public:
+    ConvexDecomposition();
+    ConvexDecomposition(const ConvexDecomposition& org);
+    ~ConvexDecomposition();
+
+    //! The mesh is converted into a single convex hull when the number is 1. The default value is 16.
+    void setMaxNumHulls(int n);
+    int maxNumHulls() const;
+
+    //! The number of the vertices of each hull is limited to this number. The default value is 64.
+    void setMaxNumHullVertices(int n);
+    int maxNumHullVertices() const;
+
+    /**
+       The ratio of the allowable concavity to the diagonal length of the bounding box
+       of the whole mesh. The concavity of a part is the maximum distance between the
+       vertices of the part and the surface of its convex hull. The default value is 0.02.
+    */
+    void setConcavityThreshold(double ratio);
+    double concavityThreshold() const;
+
+    //! The caching is disabled when the directory is empty.
+    void setCacheDirectory(const std::string& directory);
+    const std::string& cacheDirectory() const;
+    static std::string defaultCacheDirectory();
+
+    /**
+       \return false if the mesh is flat or empty and it cannot be converted.
+    */
+    bool decompose(SgMesh* mesh, std::vector<SgMeshPtr>& out_hulls);
+
+    SgMesh* createConvexHull(SgMesh* mesh);
+
+    /**
+       Creates the scene in which the meshes of the shape nodes in the given scene are replaced
+       with the convex shapes. The primitive shapes except the scaled ones are kept as they are.
+       \return nullptr if no mesh is converted.
+    */
+    SgNode* convertShape(SgNode* scene);
+
+private:
+    class Impl;
+    Impl* impl;
+};
+
+}
+
+#endif
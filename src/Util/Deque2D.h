@@ -8,9 +8,18 @@
 
 #include <memory>
 #include <iterator>
+#include <utility>
+#include "exportdecl.h"
 
 namespace cnoid {
 
+/*
+  These functions count the memory of all the deques for the memory telemetry. They are defined
+  in the library so that this header does not depend on the telemetry.
+*/
+CNOID_EXPORT void countDeque2DAllocation(std::size_t bytes);
+CNOID_EXPORT void countDeque2DDeallocation(std::size_t bytes);
+
 template <typename ElementType, typename Allocator = std::allocator<ElementType>>
 class Deque2D
 {
@@ -323,7 +332,7 @@ public:
         buf = 0;
 
         if(capacity_){
-            buf = allocator.allocate(capacity_);
+            buf = allocateBuffer(capacity_);
             offset = 0;
             ElementType* p = buf;
             ElementType* pend = buf + size_;
@@ -372,7 +381,7 @@ public:
                     allocator.destroy(q);
                 }
             }
-            allocator.deallocate(buf, capacity_);
+            deallocateBuffer(buf, capacity_);
         }
     }
 
@@ -380,12 +389,46 @@ public:
         return !rowSize_ || !colSize_;
     }
 
+    /**
+       Exchange the contents with another deque without copying the elements.
+    */
+    void swap(Deque2DType& other) {
+        std::swap(allocator, other.allocator);
+        std::swap(buf, other.buf);
+        std::swap(offset, other.offset);
+        std::swap(rowSize_, other.rowSize_);
+        std::swap(colSize_, other.colSize_);
+        std::swap(capacity_, other.capacity_);
+        std::swap(size_, other.size_);
+        std::swap(end_, other.end_);
+    }
+
 private:
+    void destroyElements() {
+        if(capacity_ > 0){
+            ElementType* p = buf + offset;
+            const ElementType* pend = buf + (offset + size_) % capacity_;
+            if(p <= pend){
+                while(p != pend){
+                    allocator.destroy(p++);
+                }
+            } else {
+                for(ElementType* q = buf; q != pend; ++q){
+                    allocator.destroy(q);
+                }
+                const ElementType* pterm = buf + capacity_;
+                for(ElementType* q = p; q != pterm; ++q){
+                    allocator.destroy(q);
+                }
+            }
+        }
+    }
+    
     void reallocMemory(int newColSize, int newSize, int newCapacity, bool doCopy) {
 
         ElementType* newBuf;
         if(newCapacity > 0){
-            newBuf = allocator.allocate(newCapacity);
+            newBuf = allocateBuffer(newCapacity);
         } else {
             newBuf = 0;
         }
@@ -395,20 +438,20 @@ private:
         if(capacity_ > 0){
             ElementType* qend = buf + (offset + size_) % capacity_;
             
-            // copy the existing elements
+            // move the existing elements
             if(newCapacity > 0 && newColSize == colSize_ && doCopy){
                 ElementType* q = buf + offset;
                 if(q <= qend){
                     while(q != qend && p != pend){
-                        allocator.construct(p++, *q++);
+                        allocator.construct(p++, std::move(*q++));
                     }
                 } else {
-                    for(ElementType* r = buf; r != qend && p != pend; ++r){
-                        allocator.construct(p++, *r);
-                    }
                     ElementType* qterm = buf + capacity_;
                     for(ElementType* r = q; r != qterm && p != pend; ++r){
-                        allocator.construct(p++, *r);
+                        allocator.construct(p++, std::move(*r));
+                    }
+                    for(ElementType* r = buf; r != qend && p != pend; ++r){
+                        allocator.construct(p++, std::move(*r));
                     }
                 }
             }
@@ -435,7 +478,7 @@ private:
         }
 
         if(buf){
-            allocator.deallocate(buf, capacity_);
+            deallocateBuffer(buf, capacity_);
         }
         buf = newBuf;
         capacity_ = newCapacity;
@@ -447,8 +490,13 @@ private:
         const int newSize = newRowSize * newColSize;
 
         if(newSize == 0){
-            reallocMemory(newColSize, newSize, 0, false);
-            
+            if(newColSize > 0 && newColSize == colSize_ && capacity_ > 0){
+                // Keep the allocated memory so that appending rows again does not reallocate it
+                destroyElements();
+                offset = 0;
+            } else {
+                reallocMemory(newColSize, newSize, 0, false);
+            }
         } else {
             // The area for the 'end' iterator should be reserved
             const int minCapacity = newSize + newColSize;
@@ -494,7 +542,7 @@ private:
                 if(!buf){
                     capacity_ = minCapacity;
                     if(capacity_ > 0){
-                        buf = allocator.allocate(minCapacity);
+                        buf = allocateBuffer(minCapacity);
                         ElementType* p = buf;
                         ElementType* pend = buf + newSize;
                         // construct new elements
@@ -503,12 +551,16 @@ private:
                         }
                     }
                 } else {
-                    int newCapacity;
-                    const int expandedSize = size_ * 3 / 2;
-                    if(expandedSize > newSize){
-                        newCapacity = expandedSize - (expandedSize % newColSize) + newColSize;
-                    } else {
-                        newCapacity = minCapacity;
+                    int newCapacity = minCapacity;
+                    if(newColSize == colSize_){
+                        /*
+                          The capacity is expanded geometrically in rows so that appending rows
+                          one by one only reallocates the memory O(log n) times.
+                        */
+                        const int expandedRowSize = rowSize_ + rowSize_ / 2 + 1;
+                        if(expandedRowSize > newRowSize){
+                            newCapacity = (expandedRowSize + 1) * newColSize;
+                        }
                     }
                     reallocMemory(newColSize, newSize, newCapacity, doCopy);
                 }
@@ -545,6 +597,28 @@ public:
         return colSize_;
     }
 
+    /**
+       Allocates the memory for the rows so that the rows can be appended up to the
+       specified number without reallocation. The column size must be set beforehand.
+    */
+    void reserve(int numRows) {
+        const int newCapacity = (numRows + 1) * colSize_;
+        if(colSize_ > 0 && newCapacity > capacity_){
+            reallocMemory(colSize_, size_, newCapacity, true);
+            end_ = iterator(*this, buf + size_);
+        }
+    }
+
+    //! The number of the rows that can be stored without reallocation
+    int rowCapacity() const {
+        return (colSize_ > 0 && capacity_ > 0) ? (capacity_ / colSize_ - 1) : 0;
+    }
+
+    //! The size of the memory allocated for the elements
+    std::size_t allocatedBytes() const {
+        return static_cast<std::size_t>(capacity_) * sizeof(ElementType);
+    }
+
     void clear() {
         resize(0, 0);
     }
@@ -635,7 +709,59 @@ public:
         size_ -= popSize;
     }
 
+    /**
+       The elements are stored in a ring buffer and they may wrap around the end of it after
+       pop_front() is called. This function returns true if all the elements are stored in a
+       contiguous area starting from data() in the row-major order.
+    */
+    bool isContiguous() const {
+        return offset + size_ <= capacity_;
+    }
+
+    //! Move the elements so that they are stored in a contiguous area starting from data()
+    void makeContiguous() {
+        if(isContiguous()){
+            return;
+        }
+        ElementType* newBuf = allocateBuffer(capacity_);
+        ElementType* p = newBuf;
+        ElementType* qterm = buf + capacity_;
+        for(ElementType* q = buf + offset; q != qterm; ++q){
+            allocator.construct(p++, std::move(*q));
+            allocator.destroy(q);
+        }
+        ElementType* qend = buf + (offset + size_ - capacity_);
+        for(ElementType* q = buf; q != qend; ++q){
+            allocator.construct(p++, std::move(*q));
+            allocator.destroy(q);
+        }
+        deallocateBuffer(buf, capacity_);
+        buf = newBuf;
+        offset = 0;
+        end_ = iterator(*this, buf + size_);
+    }
+
+    //! \note The elements are only accessible as a contiguous array when isContiguous() returns true.
+    ElementType* data() {
+        return buf + offset;
+    }
+
+    const ElementType* data() const {
+        return buf + offset;
+    }
+
 private:
+    ElementType* allocateBuffer(int n) {
+        ElementType* p = allocator.allocate(n);
+        countDeque2DAllocation(n * sizeof(ElementType));
+        return p;
+    }
+
+    void deallocateBuffer(ElementType* p, int n) {
+        allocator.deallocate(p, n);
+        countDeque2DDeallocation(n * sizeof(ElementType));
+    }
+
     Allocator allocator;
     ElementType* buf;
     int offset;
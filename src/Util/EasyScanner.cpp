@@ -321,15 +321,16 @@ int EasyScanner::readToken()
     skipSpace();
 
     if(isdigit((unsigned char)*text) || *text == '+' || *text == '-'){
-        char* tail;
-        intValue = strtol(text, &tail, 0);
+        long value;
+        const char* tail = parseInt(text, textBufEnd, value, 0);
         if(tail != text){
-            text = tail;
+            intValue = value;
+            text = const_cast<char*>(tail);
             return T_INTEGER;
         }
-        doubleValue = cnoid::strtod(text, &tail);
+        tail = parseFloat(text, textBufEnd, doubleValue);
         if(tail != text){
-            text = tail;
+            text = const_cast<char*>(tail);
             return T_DOUBLE;
         }
         charValue = *text;
@@ -415,14 +416,12 @@ bool EasyScanner::extractQuotedString()
 
 bool EasyScanner::readFloat()
 {
-    char* tail;
-
     if(checkLF()) return false;
 
-    floatValue = cnoid::strtof(text, &tail);
+    const char* tail = parseFloat(text, textBufEnd, floatValue);
 
     if(tail != text){
-        text = tail;
+        text = const_cast<char*>(tail);
         return true;
     }
 
@@ -432,14 +431,12 @@ bool EasyScanner::readFloat()
 
 bool EasyScanner::readDouble()
 {
-    char* tail;
-
     if(checkLF()) return false;
 
-    doubleValue = cnoid::strtod(text, &tail);
+    const char* tail = parseFloat(text, textBufEnd, doubleValue);
 
     if(tail != text){
-        text = tail;
+        text = const_cast<char*>(tail);
         return true;
     }
 
@@ -449,13 +446,13 @@ bool EasyScanner::readDouble()
 
 bool EasyScanner::readInt()
 {
-    char* tail;
-
     if(checkLF()) return false;
 
-    intValue = strtol(text, &tail, 0);
+    long value;
+    const char* tail = parseInt(text, textBufEnd, value, 0);
     if(tail != text){
-        text = tail;
+        intValue = value;
+        text = const_cast<char*>(tail);
         return true;
     }
 
@@ -463,6 +460,49 @@ bool EasyScanner::readInt()
 }
 
 
+template<class ValueType, class ParsedType, class Parser>
+static int readNumberSequence
+(EasyScanner* scanner, char*& text, const char* end, std::vector<ValueType>& out_values, Parser parse)
+{
+    int n = 0;
+    while(!scanner->checkLF()){
+        ParsedType value;
+        const char* tail = parse(text, end, value);
+        if(tail == text){
+            break;
+        }
+        out_values.push_back(value);
+        text = const_cast<char*>(tail);
+        ++n;
+    }
+    return n;
+}
+
+
+int EasyScanner::readNumbers(std::vector<float>& out_values)
+{
+    return readNumberSequence<float, float>(
+        this, text, textBufEnd, out_values,
+        [](const char* begin, const char* end, float& value){ return parseFloat(begin, end, value); });
+}
+
+
+int EasyScanner::readNumbers(std::vector<double>& out_values)
+{
+    return readNumberSequence<double, double>(
+        this, text, textBufEnd, out_values,
+        [](const char* begin, const char* end, double& value){ return parseFloat(begin, end, value); });
+}
+
+
+int EasyScanner::readNumbers(std::vector<int>& out_values)
+{
+    return readNumberSequence<int, long>(
+        this, text, textBufEnd, out_values,
+        [](const char* begin, const char* end, long& value){ return parseInt(begin, end, value, 0); });
+}
+
+
 bool EasyScanner::readChar()
 {
     skipSpace();
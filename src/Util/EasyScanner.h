@@ -90,6 +90,17 @@ public:
     bool readFloat();
     bool readDouble();
     bool readInt();
+
+    /**
+       These functions read the numbers separated by the white spaces until a token that is not
+       a number appears, and append them to the vector. The line feed also terminates the reading
+       in the line oriented mode.
+       \return The number of the read values
+    */
+    int readNumbers(std::vector<float>& out_values);
+    int readNumbers(std::vector<double>& out_values);
+    int readNumbers(std::vector<int>& out_values);
+    
     bool readChar();
     bool readChar(int chara);
     int  peekChar();
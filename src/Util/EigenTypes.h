@@ -107,6 +107,11 @@ public:
     const Vector3& translation() const { return p; }
     Quaternion& rotation() { return q; }
     const Quaternion& rotation() const { return q; }
+
+    //! The translation is interpolated linearly and the rotation is interpolated spherically
+    SE3 interpolated(const SE3& to, double ratio) const {
+        return SE3(Vector3(p + ratio * (to.p - p)), q.slerp(ratio, to.q));
+    }
 };
 
 }
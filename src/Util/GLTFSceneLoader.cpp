@@ -0,0 +1,1488 @@
+#include "GLTFSceneLoader.h"
+#include "SceneLoader.h"
+#include "SceneDrawables.h"
+#include "MeshFilter.h"
+#include "MappedFile.h"
+#include "YAMLReader.h"
+#include "ValueTree.h"
+#include "ImageIO.h"
+#include "Exception.h"
+#include "EigenUtil.h"
+#include "NullOut.h"
+#include "UTF8.h"
+#include <cnoid/stdx/filesystem>
+#include <fmt/format.h>
+#include <memory>
+#include <cstring>
+#include <cmath>
+#include "gettext.h"
+
+using namespace std;
+using namespace cnoid;
+using fmt::format;
+namespace filesystem = cnoid::stdx::filesystem;
+
+namespace {
+
+struct Registration {
+    Registration(){
+        SceneLoader::registerLoader(
+            { "gltf", "glb" },
+            []() -> shared_ptr<AbstractSceneLoader> { return std::make_shared<GLTFSceneLoader>(); });
+    }
+} registration;
+
+constexpr uint32_t GLB_Magic = 0x46546C67; // "glTF"
+constexpr uint32_t GLB_JSONChunk = 0x4E4F534A;
+constexpr uint32_t GLB_BinaryChunk = 0x004E4942;
+
+enum ComponentType {
+    Byte = 5120, UnsignedByte = 5121, Short = 5122, UnsignedShort = 5123, UnsignedInt = 5125, Float = 5126
+};
+
+enum PrimitiveMode {
+    Points = 0, Lines = 1, LineLoop = 2, LineStrip = 3, Triangles = 4, TriangleStrip = 5, TriangleFan = 6
+};
+
+void throwError(const std::string& message)
+{
+    throw file_read_error() << error_info_message(message);
+}
+
+int getComponentSize(int componentType)
+{
+    switch(componentType){
+    case Byte:
+    case UnsignedByte:
+        return 1;
+    case Short:
+    case UnsignedShort:
+        return 2;
+    case UnsignedInt:
+    case Float:
+        return 4;
+    default:
+        break;
+    }
+    return 0;
+}
+
+int getNumComponents(const std::string& type)
+{
+    if(type == "SCALAR"){
+        return 1;
+    } else if(type == "VEC2"){
+        return 2;
+    } else if(type == "VEC3"){
+        return 3;
+    } else if(type == "VEC4" || type == "MAT2"){
+        return 4;
+    } else if(type == "MAT3"){
+        return 9;
+    } else if(type == "MAT4"){
+        return 16;
+    }
+    return 0;
+}
+
+float readComponent(const unsigned char* p, int componentType, bool normalized)
+{
+    switch(componentType){
+    case Float: {
+        float value;
+        memcpy(&value, p, 4);
+        return value;
+    }
+    case Byte: {
+        float value = static_cast<signed char>(*p);
+        return normalized ? std::max(value / 127.0f, -1.0f) : value;
+    }
+    case UnsignedByte: {
+        float value = *p;
+        return normalized ? (value / 255.0f) : value;
+    }
+    case Short: {
+        int16_t v;
+        memcpy(&v, p, 2);
+        float value = v;
+        return normalized ? std::max(value / 32767.0f, -1.0f) : value;
+    }
+    case UnsignedShort: {
+        uint16_t v;
+        memcpy(&v, p, 2);
+        float value = v;
+        return normalized ? (value / 65535.0f) : value;
+    }
+    case UnsignedInt: {
+        uint32_t v;
+        memcpy(&v, p, 4);
+        return static_cast<float>(v);
+    }
+    default:
+        break;
+    }
+    return 0.0f;
+}
+
+uint32_t readIndex(const unsigned char* p, int componentType)
+{
+    switch(componentType){
+    case UnsignedByte:
+        return *p;
+    case UnsignedShort: {
+        uint16_t v;
+        memcpy(&v, p, 2);
+        return v;
+    }
+    case UnsignedInt: {
+        uint32_t v;
+        memcpy(&v, p, 4);
+        return v;
+    }
+    default:
+        break;
+    }
+    return 0;
+}
+
+size_t getSize(const Mapping* info, const char* key, size_t defaultValue = 0)
+{
+    auto node = info->find(key);
+    if(node->isValid()){
+        double value = node->toDouble();
+        if(value < 0.0){
+            info->throwException(format(_("Negative value is specified for \"{}\"."), key));
+        }
+        return static_cast<size_t>(value);
+    }
+    return defaultValue;
+}
+
+Mapping* findExtension(const Mapping* info, const char* name)
+{
+    auto extensions = info->findMapping("extensions");
+    if(extensions->isValid()){
+        return extensions->findMapping(name);
+    }
+    return extensions;
+}
+
+bool decodeBase64(const char* src, size_t size, vector<unsigned char>& out_data)
+{
+    static const char* chars = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    int table[256];
+    std::fill(table, table + 256, -1);
+    for(int i=0; i < 64; ++i){
+        table[static_cast<unsigned char>(chars[i])] = i;
+    }
+    out_data.clear();
+    out_data.reserve(size * 3 / 4);
+    uint32_t bits = 0;
+    int numBits = 0;
+    for(size_t i=0; i < size; ++i){
+        unsigned char c = src[i];
+        if(c == '='){
+            break;
+        }
+        int value = table[c];
+        if(value < 0){
+            return false;
+        }
+        bits = (bits << 6) | value;
+        numBits += 6;
+        if(numBits >= 8){
+            numBits -= 8;
+            out_data.push_back((bits >> numBits) & 0xff);
+        }
+    }
+    return true;
+}
+
+string decodePercentEncoding(const std::string& uri)
+{
+    string decoded;
+    decoded.reserve(uri.size());
+    for(size_t i=0; i < uri.size(); ++i){
+        if(uri[i] == '%' && i + 2 < uri.size() && isxdigit(uri[i+1]) && isxdigit(uri[i+2])){
+            decoded.push_back(static_cast<char>(std::stoi(uri.substr(i + 1, 2), nullptr, 16)));
+            i += 2;
+        } else {
+            decoded.push_back(uri[i]);
+        }
+    }
+    return decoded;
+}
+
+
+/**
+   The following functions decode the buffer views compressed with the EXT_meshopt_compression
+   extension, which is based on the codecs of the meshoptimizer library. They return false for
+   the invalid data. See the specification of the extension for the details of the formats.
+*/
+namespace meshopt {
+
+constexpr unsigned char VertexHeader = 0xa0;
+constexpr unsigned char IndexHeader = 0xe0;
+constexpr unsigned char SequenceHeader = 0xd0;
+constexpr size_t ByteGroupSize = 16;
+constexpr size_t VertexBlockSizeBytes = 8192;
+constexpr size_t VertexBlockMaxSize = 256;
+constexpr size_t TailMaxSize = 32;
+
+const unsigned char* decodeBytesGroup
+(const unsigned char* data, const unsigned char* dataEnd, unsigned char* out, int bitsLog2)
+{
+    if(bitsLog2 == 0){
+        memset(out, 0, ByteGroupSize);
+        return data;
+    }
+    if(bitsLog2 == 3){
+        if(static_cast<size_t>(dataEnd - data) < ByteGroupSize){
+            return nullptr;
+        }
+        memcpy(out, data, ByteGroupSize);
+        return data + ByteGroupSize;
+    }
+    // Each value of the packed bits is read from the most significant bits, and the maximum
+    // value means that the actual value is stored as a byte after the packed bits
+    const int bits = (bitsLog2 == 1) ? 2 : 4;
+    const size_t packedSize = ByteGroupSize * bits / 8;
+    if(static_cast<size_t>(dataEnd - data) < packedSize){
+        return nullptr;
+    }
+    const unsigned int sentinel = (1 << bits) - 1;
+    const unsigned char* extra = data + packedSize;
+    for(size_t i=0; i < ByteGroupSize; ++i){
+        unsigned int byte = data[i * bits / 8];
+        unsigned int shift = 8 - bits - (i * bits) % 8;
+        unsigned int value = (byte >> shift) & sentinel;
+        if(value == sentinel){
+            if(extra >= dataEnd){
+                return nullptr;
+            }
+            value = *extra++;
+        }
+        out[i] = value;
+    }
+    return extra;
+}
+
+const unsigned char* decodeBytes
+(const unsigned char* data, const unsigned char* dataEnd, unsigned char* out, size_t size)
+{
+    const size_t numGroups = size / ByteGroupSize;
+    const size_t headerSize = (numGroups + 3) / 4;
+    if(static_cast<size_t>(dataEnd - data) < headerSize){
+        return nullptr;
+    }
+    const unsigned char* header = data;
+    data += headerSize;
+    for(size_t i=0; i < numGroups; ++i){
+        int bitsLog2 = (header[i / 4] >> ((i % 4) * 2)) & 3;
+        data = decodeBytesGroup(data, dataEnd, out + i * ByteGroupSize, bitsLog2);
+        if(!data){
+            return nullptr;
+        }
+    }
+    return data;
+}
+
+bool decodeVertexBuffer
+(unsigned char* out, size_t count, size_t stride, const unsigned char* data, size_t size)
+{
+    if(stride == 0 || stride > 256 || stride % 4 != 0){
+        return false;
+    }
+    const unsigned char* dataEnd = data + size;
+    if(size < 1 || data[0] != VertexHeader){
+        return false;
+    }
+    ++data;
+
+    // The tail of the data has the first vertex, which is used as the base of the deltas
+    const size_t tailSize = std::max(stride, TailMaxSize);
+    if(static_cast<size_t>(dataEnd - data) < tailSize){
+        return false;
+    }
+    unsigned char lastVertex[256];
+    memcpy(lastVertex, dataEnd - stride, stride);
+
+    const size_t blockSize = std::min((VertexBlockSizeBytes / stride) & ~(ByteGroupSize - 1), VertexBlockMaxSize);
+    unsigned char buffer[VertexBlockMaxSize];
+
+    for(size_t offset = 0; offset < count; offset += blockSize){
+        const size_t numVertices = std::min(blockSize, count - offset);
+        const size_t alignedSize = (numVertices + ByteGroupSize - 1) & ~(ByteGroupSize - 1);
+        unsigned char* block = out + offset * stride;
+        for(size_t k=0; k < stride; ++k){
+            data = decodeBytes(data, dataEnd - tailSize, buffer, alignedSize);
+            if(!data){
+                return false;
+            }
+            unsigned char prev = lastVertex[k];
+            for(size_t i=0; i < numVertices; ++i){
+                // The deltas are zigzag-encoded
+                unsigned char delta = buffer[i];
+                unsigned char value = ((delta >> 1) ^ -(delta & 1)) + prev;
+                block[i * stride + k] = value;
+                prev = value;
+            }
+        }
+        memcpy(lastVertex, block + (numVertices - 1) * stride, stride);
+    }
+
+    return static_cast<size_t>(dataEnd - data) == tailSize;
+}
+
+uint32_t decodeVByte(const unsigned char*& data)
+{
+    unsigned char lead = *data++;
+    if(lead < 128){
+        return lead;
+    }
+    uint32_t result = lead & 127;
+    uint32_t shift = 7;
+    for(int i=0; i < 4; ++i){
+        unsigned char group = *data++;
+        result |= static_cast<uint32_t>(group & 127) << shift;
+        shift += 7;
+        if(group < 128){
+            break;
+        }
+    }
+    return result;
+}
+
+uint32_t decodeIndex(const unsigned char*& data, uint32_t last)
+{
+    uint32_t v = decodeVByte(data);
+    uint32_t d = (v >> 1) ^ -static_cast<int32_t>(v & 1);
+    return last + d;
+}
+
+bool decodeIndexBuffer(uint32_t* out, size_t count, const unsigned char* data, size_t size)
+{
+    if(count % 3 != 0 || size < 1 + count / 3 + 16){
+        return false;
+    }
+    if((data[0] & 0xf0) != IndexHeader){
+        return false;
+    }
+    const int version = data[0] & 0x0f;
+    if(version > 1){
+        return false;
+    }
+
+    uint32_t edgeFifo[16][2];
+    uint32_t vertexFifo[16];
+    memset(edgeFifo, -1, sizeof(edgeFifo));
+    memset(vertexFifo, -1, sizeof(vertexFifo));
+    size_t edgeFifoOffset = 0;
+    size_t vertexFifoOffset = 0;
+
+    auto pushEdge = [&](uint32_t a, uint32_t b){
+        edgeFifo[edgeFifoOffset][0] = a;
+        edgeFifo[edgeFifoOffset][1] = b;
+        edgeFifoOffset = (edgeFifoOffset + 1) & 15;
+    };
+    auto pushVertex = [&](uint32_t v, bool doPush){
+        vertexFifo[vertexFifoOffset] = v;
+        vertexFifoOffset = (vertexFifoOffset + (doPush ? 1 : 0)) & 15;
+    };
+
+    uint32_t next = 0;
+    uint32_t last = 0;
+    const int fecMax = (version >= 1) ? 13 : 15;
+
+    // The table of the auxiliary codes is stored in the last 16 bytes
+    const unsigned char* code = data + 1;
+    const unsigned char* p = code + count / 3;
+    const unsigned char* safeEnd = data + size - 16;
+    const unsigned char* codeAuxTable = safeEnd;
+
+    for(size_t i=0; i < count; i += 3){
+        // A triangle reads at most 16 bytes
+        if(p > safeEnd){
+            return false;
+        }
+        unsigned char codeTri = *code++;
+        uint32_t a, b, c;
+
+        if(codeTri < 0xf0){
+            int fe = codeTri >> 4;
+            a = edgeFifo[(edgeFifoOffset - 1 - fe) & 15][0];
+            b = edgeFifo[(edgeFifoOffset - 1 - fe) & 15][1];
+            int fec = codeTri & 15;
+            if(fec < fecMax){
+                c = (fec == 0) ? next : vertexFifo[(vertexFifoOffset - 1 - fec) & 15];
+                bool fec0 = (fec == 0);
+                if(fec0){
+                    ++next;
+                }
+                pushVertex(c, fec0);
+            } else {
+                // 13 and 14 are the deltas -1 and 1 from the last free index
+                c = (fec != 15) ? (last + (fec - (fec ^ 3))) : decodeIndex(p, last);
+                last = c;
+                pushVertex(c, true);
+            }
+            pushEdge(c, b);
+            pushEdge(a, c);
+
+        } else if(codeTri < 0xfe){
+            unsigned char codeAux = codeAuxTable[codeTri & 15];
+            int feb = codeAux >> 4;
+            int fec = codeAux & 15;
+            a = next++;
+            b = (feb == 0) ? next : vertexFifo[(vertexFifoOffset - feb) & 15];
+            bool feb0 = (feb == 0);
+            if(feb0){
+                ++next;
+            }
+            c = (fec == 0) ? next : vertexFifo[(vertexFifoOffset - fec) & 15];
+            bool fec0 = (fec == 0);
+            if(fec0){
+                ++next;
+            }
+            pushVertex(a, true);
+            pushVertex(b, feb0);
+            pushVertex(c, fec0);
+            pushEdge(b, a);
+            pushEdge(c, b);
+            pushEdge(a, c);
+
+        } else {
+            unsigned char codeAux = *p++;
+            int fea = (codeTri == 0xfe) ? 0 : 15;
+            int feb = codeAux >> 4;
+            int fec = codeAux & 15;
+            if(codeAux == 0){
+                next = 0;
+            }
+            a = (fea == 0) ? next++ : 0;
+            b = (feb == 0) ? next++ : vertexFifo[(vertexFifoOffset - feb) & 15];
+            c = (fec == 0) ? next++ : vertexFifo[(vertexFifoOffset - fec) & 15];
+            if(fea == 15){
+                last = a = decodeIndex(p, last);
+            }
+            if(feb == 15){
+                last = b = decodeIndex(p, last);
+            }
+            if(fec == 15){
+                last = c = decodeIndex(p, last);
+            }
+            pushVertex(a, true);
+            pushVertex(b, (feb == 0) || (feb == 15));
+            pushVertex(c, (fec == 0) || (fec == 15));
+            pushEdge(b, a);
+            pushEdge(c, b);
+            pushEdge(a, c);
+        }
+
+        out[i] = a;
+        out[i + 1] = b;
+        out[i + 2] = c;
+    }
+
+    return p == safeEnd;
+}
+
+bool decodeIndexSequence(uint32_t* out, size_t count, const unsigned char* data, size_t size)
+{
+    if(size < 1 + count + 4){
+        return false;
+    }
+    if((data[0] & 0xf0) != SequenceHeader || (data[0] & 0x0f) > 1){
+        return false;
+    }
+    const unsigned char* p = data + 1;
+    const unsigned char* safeEnd = data + size - 4;
+    uint32_t last[2] = { 0, 0 };
+    for(size_t i=0; i < count; ++i){
+        if(p >= safeEnd){
+            return false;
+        }
+        uint32_t v = decodeVByte(p);
+        // The lowest bit selects one of the two baselines
+        uint32_t current = v & 1;
+        v >>= 1;
+        uint32_t d = (v >> 1) ^ -static_cast<int32_t>(v & 1);
+        uint32_t index = last[current] + d;
+        last[current] = index;
+        out[i] = index;
+    }
+    return p == safeEnd;
+}
+
+template<typename T>
+void decodeOctahedralFilter(T* data, size_t count)
+{
+    const float maxValue = static_cast<float>((1 << (sizeof(T) * 8 - 1)) - 1);
+    for(size_t i=0; i < count; ++i){
+        T* v = data + i * 4;
+        float x = v[0];
+        float y = v[1];
+        float z = static_cast<float>(v[2]) - fabsf(x) - fabsf(y);
+        float t = (z < 0.0f) ? z : 0.0f;
+        x += (x >= 0.0f) ? t : -t;
+        y += (y >= 0.0f) ? t : -t;
+        float s = maxValue / sqrtf(x * x + y * y + z * z);
+        v[0] = static_cast<T>(static_cast<int>(x * s + (x >= 0.0f ? 0.5f : -0.5f)));
+        v[1] = static_cast<T>(static_cast<int>(y * s + (y >= 0.0f ? 0.5f : -0.5f)));
+        v[2] = static_cast<T>(static_cast<int>(z * s + (z >= 0.0f ? 0.5f : -0.5f)));
+    }
+}
+
+void decodeQuaternionFilter(int16_t* data, size_t count)
+{
+    const float scale = 1.0f / sqrtf(2.0f);
+    for(size_t i=0; i < count; ++i){
+        int16_t* q = data + i * 4;
+        // The scale is stored in the upper bits of the fourth component
+        int sf = q[3] | 3;
+        float ss = scale / static_cast<float>(sf);
+        float x = q[0] * ss;
+        float y = q[1] * ss;
+        float z = q[2] * ss;
+        float ww = 1.0f - x * x - y * y - z * z;
+        float w = sqrtf(ww >= 0.0f ? ww : 0.0f);
+        int xf = static_cast<int>(x * 32767.0f + (x >= 0.0f ? 0.5f : -0.5f));
+        int yf = static_cast<int>(y * 32767.0f + (y >= 0.0f ? 0.5f : -0.5f));
+        int zf = static_cast<int>(z * 32767.0f + (z >= 0.0f ? 0.5f : -0.5f));
+        int wf = static_cast<int>(w * 32767.0f + 0.5f);
+        // The lower two bits give the index of the omitted component
+        int qc = q[3] & 3;
+        q[(qc + 1) & 3] = static_cast<int16_t>(xf);
+        q[(qc + 2) & 3] = static_cast<int16_t>(yf);
+        q[(qc + 3) & 3] = static_cast<int16_t>(zf);
+        q[(qc + 0) & 3] = static_cast<int16_t>(wf);
+    }
+}
+
+void decodeExponentialFilter(uint32_t* data, size_t count)
+{
+    for(size_t i=0; i < count; ++i){
+        uint32_t v = data[i];
+        // 24-bit signed mantissa and 8-bit signed exponent
+        int32_t m = static_cast<int32_t>(v << 8) >> 8;
+        int32_t e = static_cast<int32_t>(v) >> 24;
+        float value = ldexpf(static_cast<float>(m), e);
+        memcpy(&data[i], &value, 4);
+    }
+}
+
+}
+
+}
+
+namespace cnoid {
+
+class GLTFSceneLoader::Impl
+{
+public:
+    ostream* os_;
+    ostream& os() { return *os_; }
+
+    string filename;
+    filesystem::path directory;
+    unique_ptr<MappedFile> mainFile;
+    MappingPtr gltf;
+
+    struct Buffer {
+        const unsigned char* data;
+        size_t size;
+        unique_ptr<MappedFile> file;
+        vector<unsigned char> decoded;
+        bool isLoaded;
+    };
+    vector<Buffer> buffers;
+    const unsigned char* glbBinaryChunk;
+    size_t glbBinaryChunkSize;
+
+    struct BufferView {
+        const unsigned char* data;
+        size_t size;
+        size_t stride;
+        vector<unsigned char> decoded;
+        bool isLoaded;
+    };
+    vector<BufferView> bufferViews;
+
+    struct Accessor {
+        const unsigned char* data;
+        size_t stride;
+        int componentType;
+        int numComponents;
+        size_t count;
+        bool normalized;
+        Mapping* sparse;
+    };
+
+    struct MaterialInfo {
+        SgMaterialPtr material;
+        SgTexturePtr texture;
+        bool isDoubleSided;
+        bool isLoaded;
+    };
+    vector<MaterialInfo> materials;
+    MaterialInfo defaultMaterial;
+    vector<SgTexturePtr> textures;
+    vector<bool> isTextureLoaded;
+    vector<SgGroupPtr> meshes;
+    vector<bool> isNodeVisited;
+
+    Listing* accessorInfos;
+    Listing* meshInfos;
+    Listing* nodeInfos;
+    ImageIO imageIO;
+    MeshFilter meshFilter;
+    bool isDracoWarningShown;
+
+    Impl();
+    void clear();
+    SgNode* load(const std::string& filename);
+    SgNode* loadScene();
+    void readGLB(const unsigned char* data, size_t size);
+    Mapping* getElement(const char* listKey, int index);
+    Buffer& getBuffer(int index);
+    BufferView& getBufferView(int index);
+    void decodeMeshoptBufferView(const Mapping* info, const Mapping* ext, BufferView& view);
+    Accessor getAccessor(int index);
+    void readFloats(int accessorIndex, int numComponents, float* out);
+    void readIndices(int accessorIndex, SgIndexArray& out_indices);
+    SgNode* readNode(int index);
+    SgGroup* getMesh(int index);
+    SgShape* readPrimitive(const Mapping* primitive);
+    MaterialInfo& getMaterial(int index);
+    SgTexture* getTexture(int index);
+};
+
+}
+
+
+GLTFSceneLoader::GLTFSceneLoader()
+{
+    impl = new Impl;
+}
+
+
+GLTFSceneLoader::Impl::Impl()
+{
+    os_ = &nullout();
+
+    defaultMaterial.material = new SgMaterial;
+    defaultMaterial.material->setDiffuseColor(Vector3f(1.0f, 1.0f, 1.0f));
+    defaultMaterial.isDoubleSided = false;
+    defaultMaterial.isLoaded = true;
+}
+
+
+GLTFSceneLoader::~GLTFSceneLoader()
+{
+    delete impl;
+}
+
+
+void GLTFSceneLoader::setMessageSink(std::ostream& os)
+{
+    impl->os_ = &os;
+}
+
+
+SgNode* GLTFSceneLoader::load(const std::string& filename)
+{
+    return impl->load(filename);
+}
+
+
+void GLTFSceneLoader::Impl::clear()
+{
+    gltf.reset();
+    mainFile.reset();
+    buffers.clear();
+    bufferViews.clear();
+    materials.clear();
+    textures.clear();
+    isTextureLoaded.clear();
+    meshes.clear();
+    isNodeVisited.clear();
+    glbBinaryChunk = nullptr;
+    glbBinaryChunkSize = 0;
+}
+
+
+SgNode* GLTFSceneLoader::Impl::load(const std::string& filename)
+{
+    this->filename = filename;
+    directory = filesystem::path(fromUTF8(filename)).parent_path();
+    isDracoWarningShown = false;
+    SgNodePtr scene;
+
+    try {
+        clear();
+        mainFile.reset(new MappedFile(filename));
+        const unsigned char* data = mainFile->data();
+        const size_t size = mainFile->size();
+
+        uint32_t magic = 0;
+        if(size >= 4){
+            memcpy(&magic, data, 4);
+        }
+        const char* json = reinterpret_cast<const char*>(data);
+        size_t jsonSize = size;
+        if(magic == GLB_Magic){
+            readGLB(data, size);
+            json = reinterpret_cast<const char*>(data) + 20;
+            memcpy(&jsonSize, data + 12, 4);
+        }
+        // The JSON text is parsed as the flow style of YAML
+        YAMLReader reader;
+        if(!reader.parse(json, jsonSize)){
+            throwError(reader.errorMessage());
+        }
+        if(reader.numDocuments() > 0){
+            gltf = reader.document()->toMapping();
+        }
+        if(!gltf){
+            throwError(_("The glTF data is not found."));
+        }
+        string version;
+        auto asset = gltf->findMapping("asset");
+        if(asset->isValid()){
+            asset->read("version", version);
+        }
+        if(version.empty() || version[0] != '2'){
+            throwError(format(_("glTF version {} is not supported."), version));
+        }
+
+        scene = loadScene();
+
+    } catch(const ValueNode::Exception& ex){
+        os() << format(_("Error in loading \"{0}\": {1}"), filename, ex.message()) << endl;
+        scene.reset();
+    } catch(const boost::exception& ex){
+        os() << format(_("Error in loading \"{0}\""), filename);
+        if(auto message = boost::get_error_info<error_info_message>(ex)){
+            os() << ": " << *message;
+        }
+        os() << endl;
+        scene.reset();
+    }
+
+    clear();
+
+    return scene.retn();
+}
+
+
+void GLTFSceneLoader::Impl::readGLB(const unsigned char* data, size_t size)
+{
+    uint32_t header[3];
+    if(size < 20){
+        throwError(_("The GLB header is broken."));
+    }
+    memcpy(header, data, 12);
+    if(header[1] != 2){
+        throwError(format(_("GLB version {} is not supported."), header[1]));
+    }
+    size_t totalSize = std::min(static_cast<size_t>(header[2]), size);
+
+    // The first chunk must be the JSON chunk, which is optionally followed by the binary chunk
+    size_t offset = 12;
+    int chunkIndex = 0;
+    while(offset + 8 <= totalSize){
+        uint32_t chunkHeader[2];
+        memcpy(chunkHeader, data + offset, 8);
+        const size_t chunkSize = chunkHeader[0];
+        const uint32_t chunkType = chunkHeader[1];
+        offset += 8;
+        if(chunkSize > totalSize - offset){
+            throwError(_("A GLB chunk is truncated."));
+        }
+        if(chunkIndex == 0){
+            if(chunkType != GLB_JSONChunk){
+                throwError(_("The first chunk of the GLB file is not the JSON chunk."));
+            }
+        } else if(chunkType == GLB_BinaryChunk && !glbBinaryChunk){
+            glbBinaryChunk = data + offset;
+            glbBinaryChunkSize = chunkSize;
+        }
+        offset += (chunkSize + 3) & ~static_cast<size_t>(3);
+        ++chunkIndex;
+    }
+    if(chunkIndex == 0){
+        throwError(_("The JSON chunk is not found in the GLB file."));
+    }
+}
+
+
+SgNode* GLTFSceneLoader::Impl::loadScene()
+{
+    accessorInfos = gltf->findListing("accessors");
+    meshInfos = gltf->findListing("meshes");
+    nodeInfos = gltf->findListing("nodes");
+
+    buffers.resize(gltf->findListing("buffers")->size());
+    for(auto& buffer : buffers){
+        buffer.isLoaded = false;
+    }
+    bufferViews.resize(gltf->findListing("bufferViews")->size());
+    for(auto& view : bufferViews){
+        view.isLoaded = false;
+    }
+    materials.resize(gltf->findListing("materials")->size());
+    for(auto& material : materials){
+        material.isLoaded = false;
+    }
+    auto textureInfos = gltf->findListing("textures");
+    textures.resize(textureInfos->size());
+    isTextureLoaded.resize(textureInfos->size(), false);
+    meshes.resize(meshInfos->size());
+    isNodeVisited.resize(nodeInfos->size(), false);
+
+    SgGroupPtr top = new SgGroup;
+    
+    auto sceneInfos = gltf->findListing("scenes");
+    if(sceneInfos->empty()){
+        // The nodes which are not the children of any nodes are the root nodes
+        vector<bool> isChild(nodeInfos->size(), false);
+        for(auto& node : *nodeInfos){
+            auto children = node->toMapping()->findListing("children");
+            for(auto& child : *children){
+                int index = child->toInt();
+                if(index >= 0 && index < nodeInfos->size()){
+                    isChild[index] = true;
+                }
+            }
+        }
+        for(int i=0; i < nodeInfos->size(); ++i){
+            if(!isChild[i]){
+                top->addChild(readNode(i));
+            }
+        }
+    } else {
+        int sceneIndex = gltf->get("scene", 0);
+        auto sceneInfo = getElement("scenes", sceneIndex);
+        string name;
+        if(sceneInfo->read("name", name)){
+            top->setName(name);
+        }
+        for(auto& node : *sceneInfo->findListing("nodes")){
+            top->addChild(readNode(node->toInt()));
+        }
+    }
+
+    if(top->empty()){
+        os() << format(_("Warning: glTF file \"{}\" is an empty scene."), filename) << endl;
+    }
+
+    return top.retn();
+}
+
+
+Mapping* GLTFSceneLoader::Impl::getElement(const char* listKey, int index)
+{
+    auto elements = gltf->findListing(listKey);
+    if(index < 0 || index >= elements->size()){
+        throwError(format(_("The index {0} of \"{1}\" is out of range."), index, listKey));
+    }
+    auto element = elements->at(index)->toMapping();
+    return element;
+}
+
+
+GLTFSceneLoader::Impl::Buffer& GLTFSceneLoader::Impl::getBuffer(int index)
+{
+    auto info = getElement("buffers", index);
+    auto& buffer = buffers[index];
+    if(buffer.isLoaded){
+        return buffer;
+    }
+    buffer.data = nullptr;
+    buffer.size = 0;
+
+    string uri;
+    if(!info->read("uri", uri)){
+        // The buffer without uri refers to the binary chunk of the GLB file
+        if(!glbBinaryChunk){
+            throwError(format(_("The data of buffer {} is not found."), index));
+        }
+        buffer.data = glbBinaryChunk;
+        buffer.size = glbBinaryChunkSize;
+
+    } else if(uri.compare(0, 5, "data:") == 0){
+        auto pos = uri.find(";base64,");
+        if(pos == string::npos){
+            throwError(format(_("The data URI of buffer {} is not encoded by base64."), index));
+        }
+        pos += 8;
+        if(!decodeBase64(uri.data() + pos, uri.size() - pos, buffer.decoded)){
+            throwError(format(_("The data URI of buffer {} is broken."), index));
+        }
+        buffer.data = buffer.decoded.data();
+        buffer.size = buffer.decoded.size();
+
+    } else {
+        filesystem::path path(fromUTF8(decodePercentEncoding(uri)));
+        if(path.is_relative()){
+            path = directory / path;
+        }
+        buffer.file.reset(new MappedFile(toUTF8(path.string())));
+        buffer.data = buffer.file->data();
+        buffer.size = buffer.file->size();
+    }
+
+    if(buffer.size < getSize(info, "byteLength")){
+        throwError(format(_("The data of buffer {} is shorter than its byte length."), index));
+    }
+    buffer.isLoaded = true;
+    return buffer;
+}
+
+
+GLTFSceneLoader::Impl::BufferView& GLTFSceneLoader::Impl::getBufferView(int index)
+{
+    auto info = getElement("bufferViews", index);
+    auto& view = bufferViews[index];
+    if(view.isLoaded){
+        return view;
+    }
+    view.stride = getSize(info, "byteStride");
+
+    auto ext = findExtension(info, "EXT_meshopt_compression");
+    if(!ext->isValid()){
+        ext = findExtension(info, "KHR_meshopt_compression");
+    }
+    if(ext->isValid()){
+        decodeMeshoptBufferView(info, ext, view);
+    } else {
+        auto& buffer = getBuffer(info->get<int>("buffer"));
+        size_t offset = getSize(info, "byteOffset");
+        view.size = getSize(info, "byteLength");
+        if(offset > buffer.size || view.size > buffer.size - offset){
+            throwError(format(_("Buffer view {} exceeds the range of its buffer."), index));
+        }
+        view.data = buffer.data + offset;
+    }
+    
+    view.isLoaded = true;
+    return view;
+}
+
+
+void GLTFSceneLoader::Impl::decodeMeshoptBufferView(const Mapping* info, const Mapping* ext, BufferView& view)
+{
+    auto& buffer = getBuffer(ext->get<int>("buffer"));
+    size_t offset = getSize(ext, "byteOffset");
+    size_t size = getSize(ext, "byteLength");
+    if(offset > buffer.size || size > buffer.size - offset){
+        ext->throwException(_("The compressed data exceeds the range of its buffer."));
+    }
+    const unsigned char* src = buffer.data + offset;
+    size_t stride = getSize(ext, "byteStride");
+    size_t count = getSize(ext, "count");
+    string mode = ext->get<string>("mode");
+    string filter = ext->get("filter", "NONE");
+
+    view.decoded.resize(count * stride);
+    view.data = view.decoded.data();
+    view.size = view.decoded.size();
+
+    bool decoded = false;
+    if(mode == "ATTRIBUTES"){
+        decoded = meshopt::decodeVertexBuffer(view.decoded.data(), count, stride, src, size);
+    } else if(mode == "TRIANGLES" || mode == "INDICES"){
+        if(stride != 2 && stride != 4){
+            ext->throwException(_("The byte stride of the compressed indices must be 2 or 4."));
+        }
+        vector<uint32_t> indices(count);
+        if(mode == "TRIANGLES"){
+            decoded = meshopt::decodeIndexBuffer(indices.data(), count, src, size);
+        } else {
+            decoded = meshopt::decodeIndexSequence(indices.data(), count, src, size);
+        }
+        if(decoded){
+            if(stride == 4){
+                memcpy(view.decoded.data(), indices.data(), count * 4);
+            } else {
+                for(size_t i=0; i < count; ++i){
+                    uint16_t index = indices[i];
+                    memcpy(view.decoded.data() + i * 2, &index, 2);
+                }
+            }
+        }
+    } else {
+        ext->throwException(format(_("Compression mode \"{}\" is not supported."), mode));
+    }
+    if(!decoded){
+        ext->throwException(_("The compressed data is broken."));
+    }
+
+    if(filter == "OCTAHEDRAL"){
+        if(stride == 4){
+            meshopt::decodeOctahedralFilter(reinterpret_cast<int8_t*>(view.decoded.data()), count);
+        } else if(stride == 8){
+            meshopt::decodeOctahedralFilter(reinterpret_cast<int16_t*>(view.decoded.data()), count);
+        } else {
+            ext->throwException(_("The byte stride for the octahedral filter must be 4 or 8."));
+        }
+    } else if(filter == "QUATERNION"){
+        if(stride != 8){
+            ext->throwException(_("The byte stride for the quaternion filter must be 8."));
+        }
+        meshopt::decodeQuaternionFilter(reinterpret_cast<int16_t*>(view.decoded.data()), count);
+    } else if(filter == "EXPONENTIAL"){
+        meshopt::decodeExponentialFilter(reinterpret_cast<uint32_t*>(view.decoded.data()), count * stride / 4);
+    } else if(filter != "NONE"){
+        ext->throwException(format(_("Filter \"{}\" is not supported."), filter));
+    }
+
+    if(view.stride == 0){
+        view.stride = stride;
+    }
+}
+
+
+GLTFSceneLoader::Impl::Accessor GLTFSceneLoader::Impl::getAccessor(int index)
+{
+    auto info = getElement("accessors", index);
+    Accessor accessor;
+    accessor.componentType = info->get<int>("componentType");
+    accessor.numComponents = getNumComponents(info->get<string>("type"));
+    accessor.count = getSize(info, "count");
+    accessor.normalized = info->get("normalized", false);
+    accessor.sparse = info->findMapping("sparse");
+    accessor.data = nullptr;
+    accessor.stride = 0;
+
+    const int componentSize = getComponentSize(accessor.componentType);
+    if(componentSize == 0 || accessor.numComponents == 0){
+        info->throwException(_("Invalid component type of the accessor."));
+    }
+    const size_t elementSize = componentSize * accessor.numComponents;
+
+    // The accessor without the buffer view is initialized with zeros
+    auto viewNode = info->find("bufferView");
+    if(viewNode->isValid()){
+        auto& view = getBufferView(viewNode->toInt());
+        size_t offset = getSize(info, "byteOffset");
+        accessor.stride = view.stride ? view.stride : elementSize;
+        if(accessor.count > 0){
+            size_t requiredSize = offset + accessor.stride * (accessor.count - 1) + elementSize;
+            if(requiredSize > view.size){
+                info->throwException(_("The accessor exceeds the range of its buffer view."));
+            }
+        }
+        accessor.data = view.data + offset;
+    }
+    
+    return accessor;
+}
+
+
+/**
+   The first numComponents components of the elements are read into the out array. The tightly
+   packed float values, which are usually used for the vertices, normals and texture coordinates,
+   are copied from the mapped buffer to the array at once.
+*/
+void GLTFSceneLoader::Impl::readFloats(int accessorIndex, int numComponents, float* out)
+{
+    auto accessor = getAccessor(accessorIndex);
+    if(accessor.numComponents < numComponents){
+        throwError(format(_("Accessor {} does not have enough components."), accessorIndex));
+    }
+    const size_t n = accessor.count;
+    const int componentSize = getComponentSize(accessor.componentType);
+
+    if(!accessor.data){
+        std::fill(out, out + n * numComponents, 0.0f);
+
+    } else if(accessor.componentType == Float && accessor.numComponents == numComponents &&
+              accessor.stride == sizeof(float) * numComponents){
+        memcpy(out, accessor.data, n * accessor.stride);
+
+    } else {
+        for(size_t i=0; i < n; ++i){
+            const unsigned char* p = accessor.data + i * accessor.stride;
+            for(int j=0; j < numComponents; ++j){
+                *out++ = readComponent(p + j * componentSize, accessor.componentType, accessor.normalized);
+            }
+        }
+        out -= n * numComponents;
+    }
+
+    if(accessor.sparse->isValid()){
+        // The sparse values replace the elements of the given indices
+        auto sparse = accessor.sparse;
+        size_t count = getSize(sparse, "count");
+        auto indicesInfo = sparse->findMapping("indices");
+        auto valuesInfo = sparse->findMapping("values");
+        auto& indexView = getBufferView(indicesInfo->get<int>("bufferView"));
+        auto& valueView = getBufferView(valuesInfo->get<int>("bufferView"));
+        int indexType = indicesInfo->get<int>("componentType");
+        int indexSize = getComponentSize(indexType);
+        size_t indexOffset = getSize(indicesInfo, "byteOffset");
+        size_t valueOffset = getSize(valuesInfo, "byteOffset");
+        size_t valueSize = componentSize * accessor.numComponents;
+        if(indexType == Byte || indexType == Short || indexType == Float ||
+           indexOffset + count * indexSize > indexView.size ||
+           valueOffset + count * valueSize > valueView.size){
+            sparse->throwException(_("Invalid sparse accessor."));
+        }
+        for(size_t i=0; i < count; ++i){
+            size_t index = readIndex(indexView.data + indexOffset + i * indexSize, indexType);
+            if(index >= n){
+                sparse->throwException(_("The index of the sparse accessor is out of range."));
+            }
+            const unsigned char* p = valueView.data + valueOffset + i * valueSize;
+            for(int j=0; j < numComponents; ++j){
+                out[index * numComponents + j] =
+                    readComponent(p + j * componentSize, accessor.componentType, accessor.normalized);
+            }
+        }
+    }
+}
+
+
+void GLTFSceneLoader::Impl::readIndices(int accessorIndex, SgIndexArray& out_indices)
+{
+    auto accessor = getAccessor(accessorIndex);
+    if(accessor.numComponents != 1 || accessor.sparse->isValid() || !accessor.data ||
+       (accessor.componentType != UnsignedByte && accessor.componentType != UnsignedShort &&
+        accessor.componentType != UnsignedInt)){
+        throwError(format(_("Accessor {} cannot be used as the indices."), accessorIndex));
+    }
+    const size_t n = accessor.count;
+    out_indices.resize(n);
+    if(n == 0){
+        return;
+    }
+    if(accessor.componentType == UnsignedInt && accessor.stride == 4){
+        memcpy(out_indices.data(), accessor.data, n * 4);
+    } else {
+        for(size_t i=0; i < n; ++i){
+            out_indices[i] = readIndex(accessor.data + i * accessor.stride, accessor.componentType);
+        }
+    }
+}
+
+
+SgNode* GLTFSceneLoader::Impl::readNode(int index)
+{
+    auto info = getElement("nodes", index);
+    if(isNodeVisited[index]){
+        throwError(format(_("Node {} is referred to more than once."), index));
+    }
+    isNodeVisited[index] = true;
+
+    SgGroupPtr group;
+    SgGroup* bottom = nullptr;
+    
+    auto matrixNode = info->findListing("matrix");
+    if(matrixNode->isValid()){
+        if(matrixNode->size() != 16){
+            matrixNode->throwException(_("The matrix must have 16 elements."));
+        }
+        // The matrix is stored in the column-major order
+        Affine3 T;
+        for(int col=0; col < 4; ++col){
+            for(int row=0; row < 3; ++row){
+                T.matrix()(row, col) = matrixNode->at(col * 4 + row)->toDouble();
+            }
+        }
+        T.matrix().row(3) << 0.0, 0.0, 0.0, 1.0;
+        if(T.linear().isUnitary(1.0e-6) && T.linear().determinant() > 0.0){
+            group = new SgPosTransform(Isometry3(T.matrix()));
+        } else {
+            group = new SgAffineTransform(T);
+        }
+        bottom = group;
+        
+    } else {
+        auto translation = info->findListing("translation");
+        auto rotation = info->findListing("rotation");
+        auto scale = info->findListing("scale");
+        if(translation->size() == 3 || rotation->size() == 4){
+            auto transform = new SgPosTransform;
+            if(translation->size() == 3){
+                transform->setTranslation(
+                    Vector3(translation->at(0)->toDouble(), translation->at(1)->toDouble(),
+                            translation->at(2)->toDouble()));
+            }
+            if(rotation->size() == 4){
+                // The quaternion is stored as x, y, z, w
+                Quaternion q(rotation->at(3)->toDouble(), rotation->at(0)->toDouble(),
+                             rotation->at(1)->toDouble(), rotation->at(2)->toDouble());
+                transform->setRotation(q.normalized());
+            }
+            group = transform;
+        }
+        if(scale->size() == 3){
+            Vector3 s(scale->at(0)->toDouble(), scale->at(1)->toDouble(), scale->at(2)->toDouble());
+            if(!s.isOnes()){
+                auto scaleTransform = new SgScaleTransform(s);
+                if(group){
+                    group->addChild(scaleTransform);
+                } else {
+                    group = scaleTransform;
+                }
+                bottom = scaleTransform;
+            }
+        }
+        if(!group){
+            group = new SgGroup;
+        }
+        if(!bottom){
+            bottom = group;
+        }
+    }
+
+    string name;
+    if(info->read("name", name)){
+        group->setName(name);
+    }
+
+    auto meshNode = info->find("mesh");
+    if(meshNode->isValid()){
+        bottom->addChild(getMesh(meshNode->toInt()));
+    }
+    for(auto& child : *info->findListing("children")){
+        bottom->addChild(readNode(child->toInt()));
+    }
+
+    return group.retn();
+}
+
+
+SgGroup* GLTFSceneLoader::Impl::getMesh(int index)
+{
+    auto info = getElement("meshes", index);
+    auto& group = meshes[index];
+    if(group){
+        // The mesh shared by multiple nodes is shared in the scene graph
+        return group;
+    }
+    group = new SgGroup;
+    string name;
+    if(info->read("name", name)){
+        group->setName(name);
+    }
+    for(auto& primitive : *info->findListing("primitives")){
+        if(auto shape = readPrimitive(primitive->toMapping())){
+            group->addChild(shape);
+        }
+    }
+    return group;
+}
+
+
+SgShape* GLTFSceneLoader::Impl::readPrimitive(const Mapping* primitive)
+{
+    auto attributes = primitive->findMapping("attributes");
+    int positionIndex = attributes->get("POSITION", -1);
+    if(positionIndex < 0){
+        return nullptr;
+    }
+    if(findExtension(primitive, "KHR_draco_mesh_compression")->isValid()){
+        // The uncompressed data is only available when the accessors have the buffer views
+        if(!getElement("accessors", positionIndex)->find("bufferView")->isValid()){
+            if(!isDracoWarningShown){
+                os() << format(_("Warning: The meshes compressed by Draco in \"{}\" are skipped "
+                                 "because the Draco compression is not supported."), filename) << endl;
+                isDracoWarningShown = true;
+            }
+            return nullptr;
+        }
+    }
+    int mode = primitive->get("mode", static_cast<int>(Triangles));
+    if(mode != Triangles && mode != TriangleStrip && mode != TriangleFan){
+        os() << format(_("Warning: The primitive mode {0} in \"{1}\" is not supported."), mode, filename) << endl;
+        return nullptr;
+    }
+
+    SgMeshPtr mesh = new SgMesh;
+
+    auto vertices = mesh->getOrCreateVertices(getAccessor(positionIndex).count);
+    const int numVertices = vertices->size();
+    if(numVertices == 0){
+        return nullptr;
+    }
+    readFloats(positionIndex, 3, vertices->data());
+
+    SgIndexArray indices;
+    int indicesIndex = primitive->get("indices", -1);
+    if(indicesIndex >= 0){
+        readIndices(indicesIndex, indices);
+        for(auto& index : indices){
+            if(index < 0 || index >= numVertices){
+                throwError(format(_("Accessor {} has an index out of range."), indicesIndex));
+            }
+        }
+    } else {
+        indices.resize(numVertices);
+        for(int i=0; i < numVertices; ++i){
+            indices[i] = i;
+        }
+    }
+    auto& triangles = mesh->triangleVertices();
+    if(mode == Triangles){
+        indices.resize(indices.size() / 3 * 3);
+        triangles.swap(indices);
+    } else {
+        const int n = static_cast<int>(indices.size()) - 2;
+        if(n > 0){
+            triangles.reserve(n * 3);
+            for(int i=0; i < n; ++i){
+                if(mode == TriangleFan){
+                    mesh->addTriangle(indices[0], indices[i + 1], indices[i + 2]);
+                } else if(i % 2 == 0){
+                    mesh->addTriangle(indices[i], indices[i + 1], indices[i + 2]);
+                } else {
+                    mesh->addTriangle(indices[i + 1], indices[i], indices[i + 2]);
+                }
+            }
+        }
+    }
+    if(!mesh->hasTriangles()){
+        return nullptr;
+    }
+
+    int normalIndex = attributes->get("NORMAL", -1);
+    if(normalIndex >= 0 && getAccessor(normalIndex).count == static_cast<size_t>(numVertices)){
+        auto normals = mesh->getOrCreateNormals();
+        normals->resize(numVertices);
+        readFloats(normalIndex, 3, normals->data());
+    } else {
+        // The flat normals are used for the mesh without normals
+        meshFilter.generateNormals(mesh, 0.0f);
+    }
+
+    int texCoordIndex = attributes->get("TEXCOORD_0", -1);
+    if(texCoordIndex >= 0 && getAccessor(texCoordIndex).count == static_cast<size_t>(numVertices)){
+        auto texCoords = mesh->getOrCreateTexCoords();
+        texCoords->resize(numVertices);
+        readFloats(texCoordIndex, 2, texCoords->data());
+        // The origin of the texture coordinate of glTF is the upper left corner of the image
+        for(auto& uv : *texCoords){
+            uv.y() = 1.0f - uv.y();
+        }
+    }
+
+    int colorIndex = attributes->get("COLOR_0", -1);
+    if(colorIndex >= 0 && getAccessor(colorIndex).count == static_cast<size_t>(numVertices)){
+        auto colors = mesh->getOrCreateColors(numVertices);
+        readFloats(colorIndex, 3, colors->data());
+    }
+
+    mesh->updateBoundingBox();
+
+    SgShapePtr shape = new SgShape;
+    shape->setMesh(mesh);
+    int materialIndex = primitive->get("material", -1);
+    auto& material = (materialIndex >= 0) ? getMaterial(materialIndex) : defaultMaterial;
+    shape->setMaterial(material.material);
+    if(material.texture && mesh->hasTexCoords()){
+        shape->setTexture(material.texture);
+    }
+    mesh->setSolid(!material.isDoubleSided);
+
+    return shape.retn();
+}
+
+
+GLTFSceneLoader::Impl::MaterialInfo& GLTFSceneLoader::Impl::getMaterial(int index)
+{
+    auto info = getElement("materials", index);
+    auto& material = materials[index];
+    if(material.isLoaded){
+        return material;
+    }
+    material.material = new SgMaterial;
+    material.isDoubleSided = info->get("doubleSided", false);
+
+    string name;
+    if(info->read("name", name)){
+        material.material->setName(name);
+    }
+
+    Vector4f baseColor(1.0f, 1.0f, 1.0f, 1.0f);
+    float metallic = 1.0f;
+    float roughness = 1.0f;
+    auto pbr = info->findMapping("pbrMetallicRoughness");
+    if(pbr->isValid()){
+        auto baseColorFactor = pbr->findListing("baseColorFactor");
+        if(baseColorFactor->size() == 4){
+            for(int i=0; i < 4; ++i){
+                baseColor[i] = baseColorFactor->at(i)->toFloat();
+            }
+        }
+        pbr->read("metallicFactor", metallic);
+        pbr->read("roughnessFactor", roughness);
+        auto baseColorTexture = pbr->findMapping("baseColorTexture");
+        if(baseColorTexture->isValid()){
+            material.texture = getTexture(baseColorTexture->get<int>("index"));
+        }
+    }
+    material.material->setDiffuseColor(baseColor.head<3>());
+    if(info->get<string>("alphaMode", "OPAQUE") == "BLEND"){
+        material.material->setTransparency(1.0f - baseColor[3]);
+    }
+
+    // The metallic-roughness model is roughly approximated by the specular parameters
+    material.material->setSpecularColor(
+        (Vector3f::Constant(0.04f) * (1.0f - metallic) + baseColor.head<3>() * metallic).eval());
+    material.material->setSpecularExponent(std::max(1.0f, 128.0f * (1.0f - roughness)));
+
+    auto emissiveFactor = info->findListing("emissiveFactor");
+    if(emissiveFactor->size() == 3){
+        material.material->setEmissiveColor(
+            Vector3f(emissiveFactor->at(0)->toFloat(), emissiveFactor->at(1)->toFloat(),
+                     emissiveFactor->at(2)->toFloat()));
+    }
+
+    material.isLoaded = true;
+    return material;
+}
+
+
+SgTexture* GLTFSceneLoader::Impl::getTexture(int index)
+{
+    auto info = getElement("textures", index);
+    if(isTextureLoaded[index]){
+        return textures[index];
+    }
+    isTextureLoaded[index] = true;
+
+    int sourceIndex = info->get("source", -1);
+    if(sourceIndex < 0){
+        return nullptr;
+    }
+    auto imageInfo = getElement("images", sourceIndex);
+    string uri;
+    if(!imageInfo->read("uri", uri) || uri.compare(0, 5, "data:") == 0){
+        os() << format(_("Warning: The embedded image {0} in \"{1}\" is not supported."),
+                       sourceIndex, filename) << endl;
+        return nullptr;
+    }
+    uri = decodePercentEncoding(uri);
+    filesystem::path path(fromUTF8(uri));
+    if(path.is_relative()){
+        path = directory / path;
+    }
+    SgTexturePtr texture = new SgTexture;
+    auto image = texture->getOrCreateImage();
+    if(!imageIO.load(image->image(), toUTF8(path.string()), os())){
+        return nullptr;
+    }
+    image->setUriByFilePathAndBaseDirectory(uri, toUTF8(directory.generic_string()));
+
+    // The repeat wrapping is the default of glTF
+    auto samplerNode = info->find("sampler");
+    if(samplerNode->isValid()){
+        auto sampler = getElement("samplers", samplerNode->toInt());
+        texture->setRepeat(sampler->get("wrapS", 10497) != 33071, sampler->get("wrapT", 10497) != 33071);
+    }
+    
+    textures[index] = texture;
+    return texture;
+}
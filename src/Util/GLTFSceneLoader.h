@@ -0,0 +1,34 @@
+#ifndef CNOID_UTIL_GLTF_SCENE_LOADER_H
+#define CNOID_UTIL_GLTF_SCENE_LOADER_H
+
+#include "AbstractSceneLoader.h"
+#include "exportdecl.h"
+
+namespace cnoid {
+
+/**
+   This class loads the glTF 2.0 files of the JSON format (.gltf) and the binary format (.glb).
+   The binary buffers, which are the binary chunk of a GLB file or the external buffer files,
+   are mapped to the memory, and the accessor data is directly read from them into the arrays
+   of the meshes. The buffer views compressed with the EXT_meshopt_compression extension are
+   decoded in loading. The meshes compressed with the KHR_draco_mesh_compression extension are
+   only loaded when they have the uncompressed fallback data.
+
+   The coordinate system of glTF, whose upper axis is the Y axis, is kept in the loaded scene.
+*/
+class CNOID_EXPORT GLTFSceneLoader : public AbstractSceneLoader
+{
+public:
+    GLTFSceneLoader();
+    ~GLTFSceneLoader();
+    virtual void setMessageSink(std::ostream& os) override;
+    virtual SgNode* load(const std::string& filename) override;
+
+private:
+    class Impl;
+    Impl* impl;
+};
+
+}
+
+#endif
@@ -7,6 +7,7 @@
 #define CNOID_UTIL_GENERAL_SEQ_READER_H
 
 #include "ValueTree.h"
+#include "YAMLReader.h"
 #include "AbstractSeq.h"
 #include <functional>
 #include <type_traits>
@@ -30,6 +31,7 @@ class GeneralSeqReader
     double formatVersion_;
     bool hasFrameTime_;
     int numParts_;
+    const CompactRowListing* compactFrames_;
 
     std::function<bool(GeneralSeqReader& reader, const std::string& type)> customSeqTypeChecker;
 
@@ -42,6 +44,7 @@ public:
         formatVersion_ = 2.0;
         hasFrameTime_ = false;
         numParts_ = 0;
+        compactFrames_ = nullptr;
     }
 
     std::ostream& os() { return os_; }
@@ -67,11 +70,23 @@ private:
             archive->throwException(frames_key_not_found_message());
         }
         const Listing& frames = *framesNode->toListing();
-        if(frames.empty()){
+        // The frames are stored as a CompactRowListing if YAMLReader::setCompactRowListingKey is used
+        compactFrames_ = dynamic_cast<const CompactRowListing*>(&frames);
+        if(getNumFrames(frames) == 0){
             frames.throwException(no_frame_data_message());
         }
         return frames;
     }
+
+    int getNumFrames(const Listing& frames) const
+    {
+        return compactFrames_ ? compactFrames_->numRows() : frames.size();
+    }
+
+    const Listing& getFrame(const Listing& frames, int index) const
+    {
+        return compactFrames_ ? compactFrames_->row(index) : *frames[index].toListing();
+    }
         
 public:        
     bool readHeaders(const Mapping* archive, AbstractSeq* seq)
@@ -158,11 +173,11 @@ public:
         std::function<void(const Listing& srcNode, int topIndex, typename SeqType::value_type& seqValue)> readValue)
     {
         const Listing& frames = getFrames(archive);
-        const int numFrames = frames.size();
+        const int numFrames = getNumFrames(frames);
         seq->setNumFrames(hasFrameTime_ ? 0 : numFrames);
 
         for(int i=0; i < numFrames; ++i){
-            const Listing& srcValue = *frames[i].toListing();
+            const Listing& srcValue = getFrame(frames, i);
             if(!hasFrameTime_){
                 auto& seqValue = (*seq)[i];
                 readValue(srcValue, 0, seqValue);
@@ -205,7 +220,7 @@ public:
         }
 
         const Listing& frames = getFrames(archive);
-        const int numFrames = frames.size();
+        const int numFrames = getNumFrames(frames);
 
         if(hasFrameTime_){
             seq->setDimension(0, numParts_);
@@ -214,7 +229,7 @@ public:
         }
 
         for(int i=0; i < numFrames; ++i){
-            const Listing& srcValues = *frames[i].toListing();
+            const Listing& srcValues = getFrame(frames, i);
             if(srcValues.size() != frameDataSize){
                 srcValues.throwException(invalid_frame_size_message());
             }
@@ -0,0 +1,185 @@
+#include "ImageCache.h"
+#include "ThreadPool.h"
+#include "Tracer.h"
+#include "UTF8.h"
+#include <cnoid/stdx/filesystem>
+#include <unordered_map>
+#include <mutex>
+#include <sstream>
+#include <ctime>
+#include <algorithm>
+#include <fmt/format.h>
+
+using namespace std;
+using namespace cnoid;
+namespace filesystem = cnoid::stdx::filesystem;
+
+namespace {
+
+const size_t MinNumEntriesToRelease = 64;
+
+struct Entry
+{
+    // Locked while the image is decoded so that it is only decoded once
+    std::mutex mutex;
+    std::shared_ptr<Image> image;
+    std::time_t modificationTime;
+
+    Entry() : modificationTime(0) { }
+};
+
+}
+
+namespace cnoid {
+
+class ImageCache::Impl
+{
+public:
+    std::mutex mutex;
+    unordered_map<string, shared_ptr<Entry>> entries;
+    size_t numEntriesToRelease;
+
+    Impl() : numEntriesToRelease(MinNumEntriesToRelease) { }
+
+    shared_ptr<Entry> findEntry(const string& key);
+    shared_ptr<Image> load(const string& filename, const ImageIO& imageIO, ostream& os);
+    void releaseUnusedImages();
+};
+
+}
+
+
+ImageCache* ImageCache::instance()
+{
+    static ImageCache cache;
+    return &cache;
+}
+
+
+ImageCache::ImageCache()
+{
+    impl = new Impl;
+}
+
+
+ImageCache::~ImageCache()
+{
+    delete impl;
+}
+
+
+std::shared_ptr<Image> ImageCache::load(const std::string& filename, const ImageIO& imageIO, std::ostream& os)
+{
+    return impl->load(filename, imageIO, os);
+}
+
+
+shared_ptr<Entry> ImageCache::Impl::findEntry(const string& key)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto& entry = entries[key];
+    if(entry){
+        return entry;
+    }
+    entry = make_shared<Entry>();
+    auto newEntry = entry;
+    if(entries.size() >= numEntriesToRelease){
+        releaseUnusedImages();
+        numEntriesToRelease = std::max(MinNumEntriesToRelease, entries.size() * 2);
+    }
+    return newEntry;
+}
+
+
+shared_ptr<Image> ImageCache::Impl::load(const string& filename, const ImageIO& imageIO, ostream& os)
+{
+    CNOID_TRACE_ZONE("Load image", "ImageCache");
+
+    std::time_t modificationTime = 0;
+    try {
+        modificationTime = filesystem::last_write_time_to_time_t(filesystem::path(fromUTF8(filename)));
+    }
+    catch(const filesystem::filesystem_error&){
+        // The image is not cached because ImageIO reports the error
+        auto image = make_shared<Image>();
+        ImageIO io(imageIO);
+        if(!io.load(*image, filename, os)){
+            image.reset();
+        }
+        return image;
+    }
+
+    auto key = fmt::format("{}\n{}\n{}", filename, imageIO.isUpsideDown(), imageIO.scaleDenominator());
+    auto entry = findEntry(key);
+
+    std::lock_guard<std::mutex> lock(entry->mutex);
+    if(entry->image && entry->modificationTime == modificationTime){
+        return entry->image;
+    }
+    auto image = make_shared<Image>();
+    ImageIO io(imageIO);
+    if(!io.load(*image, filename, os)){
+        return nullptr;
+    }
+    entry->image = image;
+    entry->modificationTime = modificationTime;
+    return image;
+}
+
+
+std::vector<std::shared_ptr<Image>> ImageCache::loadInParallel
+(const std::vector<std::string>& filenames, const ImageIO& imageIO, std::ostream& os)
+{
+    const int n = filenames.size();
+    vector<shared_ptr<Image>> images(n);
+    vector<ostringstream> messages(n);
+
+    // The images are loaded by a thread pool because the loading blocks for file I/O
+    const int numThreads = std::min(n, static_cast<int>(std::thread::hardware_concurrency()));
+    if(numThreads < 2){
+        for(int i=0; i < n; ++i){
+            images[i] = impl->load(filenames[i], imageIO, messages[i]);
+        }
+    } else {
+        ThreadPool threadPool(numThreads);
+        for(int i=0; i < n; ++i){
+            threadPool.start([&, i](){ images[i] = impl->load(filenames[i], imageIO, messages[i]); });
+        }
+        threadPool.wait();
+    }
+
+    for(auto& message : messages){
+        os << message.str();
+    }
+    return images;
+}
+
+
+void ImageCache::releaseUnusedImages()
+{
+    std::lock_guard<std::mutex> lock(impl->mutex);
+    impl->releaseUnusedImages();
+}
+
+
+//! The mutex must be locked by the caller.
+void ImageCache::Impl::releaseUnusedImages()
+{
+    auto p = entries.begin();
+    while(p != entries.end()){
+        auto& entry = p->second;
+        // An entry is only acquired with the mutex, so the entry is not used by any thread here
+        if(entry.use_count() == 1 && (!entry->image || entry->image.use_count() == 1)){
+            p = entries.erase(p);
+        } else {
+            ++p;
+        }
+    }
+}
+
+
+void ImageCache::clear()
+{
+    std::lock_guard<std::mutex> lock(impl->mutex);
+    impl->entries.clear();
+}
@@ -0,0 +1,62 @@
+#ifndef CNOID_UTIL_IMAGE_CACHE_H
+#define CNOID_UTIL_IMAGE_CACHE_H
+
+#include "Image.h"
+#include "ImageIO.h"
+#include <memory>
+#include <vector>
+#include <string>
+#include <iosfwd>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+/**
+   This class shares the decoded images in the process so that a texture file used by many
+   models or loaded again is only decoded once. An image is identified by the file path, the
+   modification time of the file, and the options of ImageIO that affect the pixels.
+
+   The cache holds a reference to each image so that SgImage copies the image before it is
+   modified. The images that are only referred by the cache are released when the number of the
+   cached images doubles or releaseUnusedImages is called.
+
+   The functions are thread-safe. When the same image is requested by multiple threads at the
+   same time, it is decoded by one of them and the others wait for it.
+*/
+class CNOID_EXPORT ImageCache
+{
+public:
+    static ImageCache* instance();
+
+    ImageCache();
+    ~ImageCache();
+
+    ImageCache(const ImageCache&) = delete;
+    ImageCache& operator=(const ImageCache&) = delete;
+
+    /**
+       \return The shared image, or null if the image cannot be loaded.
+       The image must not be modified because it is shared. Copy it to modify the pixels.
+    */
+    std::shared_ptr<Image> load(const std::string& filename, const ImageIO& imageIO, std::ostream& os);
+
+    /**
+       The images are decoded concurrently by a thread pool. The messages are output
+       in the order of the files after all the images are decoded.
+    */
+    std::vector<std::shared_ptr<Image>> loadInParallel(
+        const std::vector<std::string>& filenames, const ImageIO& imageIO, std::ostream& os);
+
+    void releaseUnusedImages();
+
+    //! The images that are being used are not released by this function.
+    void clear();
+
+private:
+    class Impl;
+    Impl* impl;
+};
+
+}
+
+#endif
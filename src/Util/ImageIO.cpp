@@ -19,6 +19,47 @@ namespace filesystem = stdx::filesystem;
 
 namespace {
 
+//! The pixels in each block of the denominator size are averaged
+void downscale(Image& image, int denominator)
+{
+    const int w = std::max(1, image.width() / denominator);
+    const int h = std::max(1, image.height() / denominator);
+    const int nc = image.numComponents();
+    const int srcWidth = image.width();
+    const int srcHeight = image.height();
+    const unsigned char* src = image.pixels();
+
+    Image scaled;
+    scaled.setSize(w, h, nc);
+    unsigned char* dest = scaled.pixels();
+    vector<int> sums(nc);
+
+    for(int y=0; y < h; ++y){
+        const int y0 = y * denominator;
+        const int y1 = std::min(y0 + denominator, srcHeight);
+        for(int x=0; x < w; ++x){
+            const int x0 = x * denominator;
+            const int x1 = std::min(x0 + denominator, srcWidth);
+            std::fill(sums.begin(), sums.end(), 0);
+            for(int sy = y0; sy < y1; ++sy){
+                const unsigned char* p = src + (sy * srcWidth + x0) * nc;
+                for(int sx = x0; sx < x1; ++sx){
+                    for(int k=0; k < nc; ++k){
+                        sums[k] += *p++;
+                    }
+                }
+            }
+            const int n = (y1 - y0) * (x1 - x0);
+            for(int k=0; k < nc; ++k){
+                *dest++ = (sums[k] + n / 2) / n;
+            }
+        }
+    }
+
+    image = scaled;
+}
+
+
 bool loadPNG(Image& image, const std::string& filename, bool isUpsideDown, ostream& os)
 {
     FILE* fp = fopen(fromUTF8(filename).c_str(), "rb");
@@ -204,7 +245,7 @@ bool savePNG(const Image& image, const std::string& filename, bool isUpsideDown,
 }
 
     
-bool loadJPEG(Image& image, const std::string& filename, bool isUpsideDown, ostream& os)
+bool loadJPEG(Image& image, const std::string& filename, bool isUpsideDown, int scaleDenominator, ostream& os)
 {
     FILE* fp = fopen(fromUTF8(filename).c_str(), "rb");
     if(!fp){
@@ -221,6 +262,11 @@ bool loadJPEG(Image& image, const std::string& filename, bool isUpsideDown, ostr
     jpeg_stdio_src(&cinfo, fp);
         
     jpeg_read_header(&cinfo, TRUE);
+    if(scaleDenominator > 1){
+        // The IDCT of the reduced size skips most of the decoding work
+        cinfo.scale_num = 1;
+        cinfo.scale_denom = scaleDenominator;
+    }
     jpeg_start_decompress(&cinfo);
     image.setSize(cinfo.output_width, cinfo.output_height, cinfo.output_components);
         
@@ -323,6 +369,21 @@ bool loadTGA(Image& image, const std::string& filename, bool isUpsideDown, ostre
 ImageIO::ImageIO()
 {
     isUpsideDown_ = false;
+    scaleDenominator_ = 1;
+}
+
+
+void ImageIO::setScaleDenominator(int denominator)
+{
+    if(denominator >= 8){
+        scaleDenominator_ = 8;
+    } else if(denominator >= 4){
+        scaleDenominator_ = 4;
+    } else if(denominator >= 2){
+        scaleDenominator_ = 2;
+    } else {
+        scaleDenominator_ = 1;
+    }
 }
 
 
@@ -337,13 +398,18 @@ bool ImageIO::load(Image& image, const std::string& filename, std::ostream& os)
     if(ext == ".png"){
         loaded = loadPNG(image, filename, isUpsideDown_, os);
     } else if(ext == ".jpg" || ext == ".jpeg"){
-        loaded = loadJPEG(image, filename, isUpsideDown_, os);
+        loaded = loadJPEG(image, filename, isUpsideDown_, scaleDenominator_, os);
     } else if(ext == ".tga"){
         loaded = loadTGA(image, filename, isUpsideDown_, os);
     } else {
         os << format(_("The image file format of \"{0}\" is not supported."), filename) << endl;
     }
 
+    // JPEG images have already been scaled by the decoder
+    if(loaded && scaleDenominator_ > 1 && !image.empty() && ext != ".jpg" && ext != ".jpeg"){
+        downscale(image, scaleDenominator_);
+    }
+
     return loaded;
 }
 
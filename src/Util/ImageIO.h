@@ -13,6 +13,15 @@ public:
     ImageIO();
 
     void setUpsideDown(bool on) { isUpsideDown_ = on; }
+    bool isUpsideDown() const { return isUpsideDown_; }
+
+    /**
+       The image is loaded with the width and the height divided by the denominator, which is
+       1, 2, 4 or 8. JPEG images are scaled in the decoding, which is much faster than decoding
+       the full image, so this is suitable for the preview levels of detail.
+    */
+    void setScaleDenominator(int denominator);
+    int scaleDenominator() const { return scaleDenominator_; }
 
     //! \todo implement this mode.
     void allocateAlphaComponent(bool on);
@@ -22,6 +31,7 @@ public:
 
 private:
     bool isUpsideDown_;
+    int scaleDenominator_;
 };
 
 }
@@ -0,0 +1,94 @@
+#include "MappedFile.h"
+#include "Exception.h"
+#include "UTF8.h"
+#include <fmt/format.h>
+#include <cstring>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+using namespace cnoid;
+using fmt::format;
+
+
+MappedFile::MappedFile(const std::string& filename)
+{
+    data_ = nullptr;
+    size_ = 0;
+    
+#ifdef _WIN32
+    fileHandle = CreateFileA(
+        fromUTF8(filename).c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if(fileHandle == INVALID_HANDLE_VALUE){
+        throw file_read_error() << error_info_message(format("\"{}\" cannot be opened.", filename));
+    }
+    LARGE_INTEGER fileSize;
+    if(!GetFileSizeEx(fileHandle, &fileSize)){
+        CloseHandle(fileHandle);
+        throw file_read_error() << error_info_message(format("\"{}\" cannot be read.", filename));
+    }
+    size_ = fileSize.QuadPart;
+    mappingHandle = nullptr;
+    if(size_ > 0){
+        mappingHandle = CreateFileMappingA(static_cast<HANDLE>(fileHandle), nullptr, PAGE_READONLY, 0, 0, nullptr);
+        void* p = mappingHandle ? MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0) : nullptr;
+        if(!p){
+            if(mappingHandle){
+                CloseHandle(mappingHandle);
+            }
+            CloseHandle(fileHandle);
+            throw file_read_error() << error_info_message(format("\"{}\" cannot be mapped.", filename));
+        }
+        data_ = static_cast<const unsigned char*>(p);
+    }
+#else
+    int fd = open(fromUTF8(filename).c_str(), O_RDONLY);
+    if(fd < 0){
+        throw file_read_error() << error_info_message(
+            format("\"{0}\" cannot be opened: {1}", filename, strerror(errno)));
+    }
+    struct stat st;
+    if(fstat(fd, &st) != 0){
+        ::close(fd);
+        throw file_read_error() << error_info_message(
+            format("\"{0}\" cannot be read: {1}", filename, strerror(errno)));
+    }
+    size_ = st.st_size;
+    if(size_ > 0){
+        void* p = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(p == MAP_FAILED){
+            ::close(fd);
+            throw file_read_error() << error_info_message(
+                format("\"{0}\" cannot be mapped: {1}", filename, strerror(errno)));
+        }
+        madvise(p, size_, MADV_SEQUENTIAL);
+        data_ = static_cast<const unsigned char*>(p);
+    }
+    ::close(fd);
+#endif
+}
+
+
+MappedFile::~MappedFile()
+{
+#ifdef _WIN32
+    if(data_){
+        UnmapViewOfFile(data_);
+        CloseHandle(mappingHandle);
+    }
+    CloseHandle(fileHandle);
+#else
+    if(data_){
+        munmap(const_cast<unsigned char*>(data_), size_);
+    }
+#endif
+}
+
+
@@ -0,0 +1,40 @@
+#ifndef CNOID_UTIL_MAPPED_FILE_H
+#define CNOID_UTIL_MAPPED_FILE_H
+
+#include <string>
+#include <cstddef>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+/**
+   This class maps a file to the memory in the read-only mode so that the binary data in the
+   file can be read without copying the whole file into a buffer. The pages of the file are
+   loaded by the operating system when they are accessed.
+*/
+class CNOID_EXPORT MappedFile
+{
+public:
+    //! \exception file_read_error is thrown when the file cannot be mapped.
+    MappedFile(const std::string& filename);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    //! \return nullptr for an empty file
+    const unsigned char* data() const { return data_; }
+    size_t size() const { return size_; }
+
+private:
+    const unsigned char* data_;
+    size_t size_;
+#ifdef _WIN32
+    void* fileHandle;
+    void* mappingHandle;
+#endif
+};
+
+}
+
+#endif
@@ -0,0 +1,237 @@
+#include "MemoryTelemetry.h"
+#include "Deque2D.h"
+#include "UTF8.h"
+#include <map>
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <chrono>
+#include <ctime>
+#include <fstream>
+#include <fmt/format.h>
+#include "gettext.h"
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+struct ReportedValue
+{
+    int64_t bytes;
+    int64_t numObjects;
+};
+
+MemoryTelemetry::Counter* getDeque2DCounter()
+{
+    static MemoryTelemetry::Counter* counter = MemoryTelemetry::instance()->counter("Deque2D");
+    return counter;
+}
+
+}
+
+namespace cnoid {
+
+class MemoryTelemetry::Impl
+{
+public:
+    std::mutex counterMutex;
+    // The counters are kept in the list so that their addresses are not changed
+    vector<unique_ptr<Counter>> counters;
+    map<string, Counter*> counterMap;
+
+    Signal<void()> sigSampling;
+
+    // The values reported in the current sampling
+    std::mutex reportMutex;
+    map<string, ReportedValue> reportedValues;
+};
+
+class MemoryTelemetry::Sampler::Impl
+{
+public:
+    vector<Record> records;
+    map<string, Record> lastRecords;
+    std::chrono::steady_clock::time_point lastSamplingTime;
+    bool hasLastSampling;
+    std::time_t samplingTime;
+    ofstream file;
+    string filename;
+};
+
+}
+
+
+MemoryTelemetry* MemoryTelemetry::instance()
+{
+    static MemoryTelemetry telemetry;
+    return &telemetry;
+}
+
+
+MemoryTelemetry::MemoryTelemetry()
+{
+    impl = new Impl;
+}
+
+
+MemoryTelemetry::~MemoryTelemetry()
+{
+    delete impl;
+}
+
+
+MemoryTelemetry::Counter* MemoryTelemetry::counter(const std::string& name)
+{
+    std::lock_guard<std::mutex> lock(impl->counterMutex);
+    auto& counter = impl->counterMap[name];
+    if(!counter){
+        impl->counters.emplace_back(new Counter(name));
+        counter = impl->counters.back().get();
+    }
+    return counter;
+}
+
+
+SignalProxy<void()> MemoryTelemetry::sigSampling()
+{
+    return impl->sigSampling;
+}
+
+
+void MemoryTelemetry::report(const std::string& name, int64_t bytes, int64_t numObjects)
+{
+    std::lock_guard<std::mutex> lock(impl->reportMutex);
+    auto inserted = impl->reportedValues.emplace(name, ReportedValue{ bytes, numObjects });
+    if(!inserted.second){
+        auto& value = inserted.first->second;
+        value.bytes += bytes;
+        if(numObjects >= 0){
+            value.numObjects = std::max(value.numObjects, int64_t(0)) + numObjects;
+        }
+    }
+}
+
+
+MemoryTelemetry::Sampler::Sampler()
+{
+    impl = new Impl;
+    impl->hasLastSampling = false;
+    impl->samplingTime = 0;
+}
+
+
+MemoryTelemetry::Sampler::~Sampler()
+{
+    delete impl;
+}
+
+
+const std::vector<MemoryTelemetry::Record>& MemoryTelemetry::Sampler::sample()
+{
+    auto telemetry = MemoryTelemetry::instance()->impl;
+
+    {
+        std::lock_guard<std::mutex> lock(telemetry->reportMutex);
+        telemetry->reportedValues.clear();
+    }
+    telemetry->sigSampling();
+
+    auto now = std::chrono::steady_clock::now();
+    impl->samplingTime = std::time(nullptr);
+    double elapsed = 0.0;
+    if(impl->hasLastSampling){
+        elapsed = std::chrono::duration<double>(now - impl->lastSamplingTime).count();
+    }
+
+    // The records are collected in the map to sort them by the names
+    map<string, Record> currentRecords;
+    {
+        std::lock_guard<std::mutex> lock(telemetry->reportMutex);
+        for(auto& kv : telemetry->reportedValues){
+            currentRecords[kv.first] = Record{ kv.first, kv.second.bytes, kv.second.numObjects, -1, 0.0, 0.0 };
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(telemetry->counterMutex);
+        for(auto& counter : telemetry->counters){
+            currentRecords[counter->name()] =
+                Record{ counter->name(), counter->bytes(), -1, counter->numAllocations(), 0.0, 0.0 };
+        }
+    }
+
+    impl->records.clear();
+    for(auto& kv : currentRecords){
+        auto& record = kv.second;
+        if(elapsed > 0.0){
+            auto p = impl->lastRecords.find(record.name);
+            if(p != impl->lastRecords.end()){
+                auto& last = p->second;
+                record.bytesPerSecond = (record.bytes - last.bytes) / elapsed;
+                if(record.numAllocations >= 0 && last.numAllocations >= 0){
+                    record.allocationsPerSecond = (record.numAllocations - last.numAllocations) / elapsed;
+                }
+            }
+        }
+        impl->records.push_back(record);
+    }
+    impl->lastRecords.swap(currentRecords);
+    impl->lastSamplingTime = now;
+    impl->hasLastSampling = true;
+
+    return impl->records;
+}
+
+
+const std::vector<MemoryTelemetry::Record>& MemoryTelemetry::Sampler::records() const
+{
+    return impl->records;
+}
+
+
+bool MemoryTelemetry::Sampler::writeRecords(const std::string& filename, std::string& out_errorMessage)
+{
+    out_errorMessage.clear();
+
+    if(!impl->file.is_open() || filename != impl->filename){
+        impl->file.close();
+        impl->file.clear();
+        impl->file.open(fromUTF8(filename).c_str(), ios::out | ios::trunc);
+        if(!impl->file){
+            out_errorMessage = fmt::format(_("The memory telemetry file \"{}\" cannot be opened."), filename);
+            return false;
+        }
+        impl->filename = filename;
+        impl->file << "time,name,bytes,objects,allocations,bytes_per_second,allocations_per_second\n";
+    }
+
+    char timeText[32];
+    std::strftime(timeText, sizeof(timeText), "%Y-%m-%d %H:%M:%S", std::localtime(&impl->samplingTime));
+
+    for(auto& record : impl->records){
+        impl->file << fmt::format(
+            "{},\"{}\",{},{},{},{:.1f},{:.1f}\n",
+            timeText, record.name, record.bytes, record.numObjects, record.numAllocations,
+            record.bytesPerSecond, record.allocationsPerSecond);
+    }
+    // The file is flushed so that the records are kept even if the process is terminated
+    impl->file.flush();
+
+    if(!impl->file){
+        out_errorMessage = fmt::format(_("The memory telemetry cannot be written to \"{}\"."), filename);
+        return false;
+    }
+    return true;
+}
+
+
+void cnoid::countDeque2DAllocation(std::size_t bytes)
+{
+    getDeque2DCounter()->allocated(bytes);
+}
+
+
+void cnoid::countDeque2DDeallocation(std::size_t bytes)
+{
+    getDeque2DCounter()->freed(bytes);
+}
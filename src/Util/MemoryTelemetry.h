@@ -0,0 +1,110 @@
+#ifndef CNOID_UTIL_MEMORY_TELEMETRY_H
+#define CNOID_UTIL_MEMORY_TELEMETRY_H
+
+#include "Signal.h"
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+/**
+   This class collects the memory usage of the subsystems so that the growth of the memory in a
+   long-running session can be found without a debugger.
+
+   The memory is collected in two ways. A subsystem that allocates the memory in any thread updates
+   a counter given by counter(), which only takes relaxed atomic operations. A subsystem whose memory
+   can be measured by traversing its data connects a slot to sigSampling and reports the memory by
+   report() in the slot. The slots are called in the main thread when a sampler samples the memory.
+   The values reported with the same name are summed up.
+*/
+class CNOID_EXPORT MemoryTelemetry
+{
+public:
+    static MemoryTelemetry* instance();
+
+    class Counter
+    {
+    public:
+        void allocated(std::size_t bytes){
+            bytes_.fetch_add(bytes, std::memory_order_relaxed);
+            numAllocations_.fetch_add(1, std::memory_order_relaxed);
+        }
+        void freed(std::size_t bytes){
+            bytes_.fetch_sub(bytes, std::memory_order_relaxed);
+        }
+        const std::string& name() const { return name_; }
+        int64_t bytes() const { return bytes_.load(std::memory_order_relaxed); }
+        int64_t numAllocations() const { return numAllocations_.load(std::memory_order_relaxed); }
+
+    private:
+        Counter(const std::string& name) : name_(name), bytes_(0), numAllocations_(0) { }
+        std::string name_;
+        std::atomic<int64_t> bytes_;
+        std::atomic<int64_t> numAllocations_;
+        friend class MemoryTelemetry;
+    };
+
+    //! The counter with the same name is shared, and the counter is never deleted.
+    Counter* counter(const std::string& name);
+
+    SignalProxy<void()> sigSampling();
+
+    /**
+       This function must be called in the slots of sigSampling.
+       \param numObjects The number of the objects holding the memory, or -1 if it is not counted
+    */
+    void report(const std::string& name, int64_t bytes, int64_t numObjects = -1);
+
+    struct Record
+    {
+        std::string name;
+        int64_t bytes;
+        int64_t numObjects;
+        //! The total number of the allocations, or -1 for the memory reported by a slot
+        int64_t numAllocations;
+        double bytesPerSecond;
+        double allocationsPerSecond;
+    };
+
+    /**
+       This class samples the memory usage. The rates of the records are calculated from the
+       previous sampling of the same sampler, so the samplers used for different purposes
+       do not interfere with each other.
+    */
+    class CNOID_EXPORT Sampler
+    {
+    public:
+        Sampler();
+        ~Sampler();
+        Sampler(const Sampler&) = delete;
+        Sampler& operator=(const Sampler&) = delete;
+
+        //! This function must be called in the main thread. The records are sorted by the names.
+        const std::vector<Record>& sample();
+        const std::vector<Record>& records() const;
+
+        /**
+           The records of the last sampling are appended to the file in the CSV format with the
+           time of the sampling. The file is truncated when the records are written first.
+        */
+        bool writeRecords(const std::string& filename, std::string& out_errorMessage);
+
+    private:
+        class Impl;
+        Impl* impl;
+    };
+
+private:
+    MemoryTelemetry();
+    ~MemoryTelemetry();
+
+    class Impl;
+    Impl* impl;
+};
+
+}
+
+#endif
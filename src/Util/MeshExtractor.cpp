@@ -5,6 +5,7 @@
 
 #include "MeshExtractor.h"
 #include "SceneDrawables.h"
+#include "MeshGenerator.h"
 #include "PolymorphicSceneNodeFunctionSet.h"
 
 using namespace cnoid;
@@ -25,6 +26,8 @@ public:
     Isometry3 currentTransformWithoutScaling;
     bool isCurrentScaled;
     bool meshFound;
+    bool isPendingMeshTessellationEnabled;
+    MeshGenerator meshGenerator;
     
     MeshExtractorImpl();
     void visitGroup(SgGroup* group);
@@ -57,6 +60,14 @@ MeshExtractorImpl::MeshExtractorImpl()
     functions.setFunction<SgShape>(
         [&](SgShape* node){ visitShape(node); });
     functions.updateDispatchTable();
+
+    isPendingMeshTessellationEnabled = true;
+}
+
+
+void MeshExtractor::setPendingMeshTessellationEnabled(bool on)
+{
+    impl->isPendingMeshTessellationEnabled = on;
 }
     
     
@@ -105,7 +116,13 @@ void MeshExtractorImpl::visitPosTransform(SgPosTransform* transform)
 void MeshExtractorImpl::visitShape(SgShape* shape)
 {
     SgMesh* mesh = shape->mesh();
-    if(mesh && mesh->vertices() && !mesh->vertices()->empty() && !mesh->triangleVertices().empty()){
+    if(!mesh){
+        return;
+    }
+    if(mesh->isTessellationPending() && isPendingMeshTessellationEnabled){
+        meshGenerator.tessellate(mesh);
+    }
+    if(mesh->isTessellationPending() || (mesh->hasVertices() && mesh->hasTriangles())){
         meshFound = true;
         currentMesh = mesh;
         currentShape = shape;
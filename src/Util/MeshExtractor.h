@@ -21,6 +21,14 @@ class CNOID_EXPORT MeshExtractor
 {
 public:
     MeshExtractor();
+
+    /**
+       The meshes whose tessellation is pending are tessellated before they are passed to the
+       callback by default. When this is disabled, such meshes are passed as they are so that
+       the callback can use the primitive information without the tessellation.
+    */
+    void setPendingMeshTessellationEnabled(bool on);
+
     bool extract(SgNode* node, std::function<void()> callback);
     bool extract(SgNode* node, std::function<void(SgMesh* mesh)> callback);
     SgMesh* integrate(SgNode* node);
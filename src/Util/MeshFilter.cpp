@@ -8,9 +8,17 @@
 #include "SceneDrawables.h"
 #include "IdPair.h"
 #include "EigenUtil.h"
+#include "CloneMap.h"
+#include "ThreadPool.h"
 #include <unordered_map>
 #include <unordered_set>
 #include <array>
+#include <queue>
+#include <list>
+#include <numeric>
+#include <mutex>
+#include <cstdint>
+#include <cstring>
 
 using namespace std;
 using namespace cnoid;
@@ -69,7 +77,85 @@ struct EdgeId : public IdPair<int>
         }
     }
 };
-    
+
+struct EdgeCollapse
+{
+    double cost;
+    int vertex1;
+    int vertex2;
+    // The counts of the modifications of the vertices when the collapse is evaluated
+    int stamp1;
+    int stamp2;
+    Vector3 position;
+
+    // The collapse with the lowest cost is the top of the priority queue
+    bool operator<(const EdgeCollapse& rhs) const { return cost > rhs.cost; }
+};
+
+double calcQuadricError(const Matrix4& Q, const Vector3& p)
+{
+    Vector4 h(p.x(), p.y(), p.z(), 1.0);
+    return h.dot(Q * h);
+}
+
+// The weight of the planes to keep the boundary edges
+constexpr double BoundaryQuadricWeight = 1.0e3;
+
+// The number of elements processed in a parallel task
+constexpr int ParallelTaskSize = 65536;
+
+// The hash of FaceId is also used for this type
+typedef array<int, 3> CellId;
+
+/**
+   The results of the normal generation are cached with the hash values of the vertices,
+   triangles and crease angles of the meshes so that the normals of the same meshes loaded
+   again are not generated again. The small meshes are not cached because generating their
+   normals is fast enough.
+*/
+constexpr int MinNumCachedTriangles = 10000;
+constexpr size_t MaxNormalCacheBytes = 64 * 1024 * 1024;
+
+struct NormalCacheEntry
+{
+    uint64_t key;
+    int numVertices;
+    int numTriangles;
+    SgNormalArrayPtr normals;
+    SgIndexArray normalIndices;
+    size_t bytes() const {
+        return normals->size() * sizeof(Vector3f) + normalIndices.size() * sizeof(int);
+    }
+};
+
+std::mutex normalCacheMutex;
+list<NormalCacheEntry> normalCache; // The most recently used entry is the front
+unordered_map<uint64_t, list<NormalCacheEntry>::iterator> normalCacheMap;
+size_t normalCacheBytes = 0;
+
+void hashCombine(uint64_t& seed, uint32_t value)
+{
+    seed ^= value + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2);
+}
+
+uint64_t calcNormalCacheKey(SgMesh* mesh, float creaseAngle)
+{
+    uint64_t seed = 0;
+    uint32_t value;
+    for(auto& v : *mesh->vertices()){
+        for(int i=0; i < 3; ++i){
+            memcpy(&value, &v[i], sizeof(value));
+            hashCombine(seed, value);
+        }
+    }
+    for(auto& index : mesh->triangleVertices()){
+        hashCombine(seed, index);
+    }
+    memcpy(&value, &creaseAngle, sizeof(value));
+    hashCombine(seed, value);
+    return seed;
+}
+
 }
 
 namespace std {
@@ -95,7 +181,6 @@ template<> struct hash<EdgeId>
         return std::hash<IdPair<int>>()(id);
     }
 };
-
 }
 
 namespace cnoid {
@@ -108,13 +193,20 @@ public:
     vector<vector<int>> facesOfVertexMap;
     unordered_map<EdgeId, vector<int>> facesOfEdgeMap;
     vector<vector<int>> normalsOfVertexMap;
+    vector<Vector3f> cornerNormals;
     float minCreaseAngle;
     float maxCreaseAngle;
     bool isNormalOverwritingEnabled;
+    bool isNormalCacheEnabled;
+    unique_ptr<ThreadPool> threadPool;
 
     MeshFilterImpl();
     MeshFilterImpl(const MeshFilterImpl& org);
     void forAllMeshes(SgNode* node, function<void(SgMesh* mesh)> callback);
+    void forEachRange(int n, function<void(int begin, int end)> func);
+    void mergeApproxVectors(
+        const SgVectorArray<Vector3f>& orgVectors, const vector<bool>& usedFlags,
+        SgVectorArray<Vector3f>& out_vectors, vector<int>& out_indexMap);
     void removeRedundantVertices(SgMesh* mesh);
     void removeRedundantFaces(SgMesh* mesh, int reductionMode);
     void removeNormalIndicesOfRedundantFaces(SgMesh* mesh, const vector<int>& validFaceIndices);
@@ -123,6 +215,9 @@ public:
     void makeFacesOfVertexMap(SgMesh* mesh, bool removeSameNormalFaces = false);
     void makeFacesOfEdgeMap(SgMesh* mesh);
     void setVertexNormals(SgMesh* mesh, float creaseAngle);
+    bool restoreCachedNormals(SgMesh* mesh, uint64_t key);
+    void cacheNormals(SgMesh* mesh, uint64_t key);
+    SgMesh* createSimplifiedMesh(SgMesh* mesh, double ratio);
 };
 
 }
@@ -137,6 +232,7 @@ MeshFilter::MeshFilter()
 MeshFilterImpl::MeshFilterImpl()
 {
     isNormalOverwritingEnabled = false;
+    isNormalCacheEnabled = true;
     minCreaseAngle = 0.0f;
     maxCreaseAngle = PI;
 }
@@ -151,6 +247,7 @@ MeshFilter::MeshFilter(const MeshFilter& org)
 MeshFilterImpl::MeshFilterImpl(const MeshFilterImpl& org)
 {
     isNormalOverwritingEnabled = org.isNormalOverwritingEnabled;
+    isNormalCacheEnabled = org.isNormalCacheEnabled;
     minCreaseAngle = org.minCreaseAngle;
     maxCreaseAngle = org.maxCreaseAngle;
 }
@@ -171,6 +268,98 @@ void MeshFilterImpl::forAllMeshes(SgNode* node, function<void(SgMesh* mesh)> cal
 }
 
 
+/**
+   Calls the function for the ranges dividing [0, n). The ranges are processed by the
+   worker threads when n is large enough.
+*/
+void MeshFilterImpl::forEachRange(int n, function<void(int begin, int end)> func)
+{
+    if(n < ParallelTaskSize * 2){
+        func(0, n);
+        return;
+    }
+    if(!threadPool){
+        threadPool.reset(new ThreadPool(std::max(1u, std::thread::hardware_concurrency())));
+    }
+    for(int begin = 0; begin < n; begin += ParallelTaskSize){
+        const int end = std::min(begin + ParallelTaskSize, n);
+        threadPool->start([func, begin, end](){ func(begin, end); });
+    }
+    threadPool->wait();
+}
+
+
+/**
+   Appends the used vectors that are not approximately equal to the preceding ones to
+   out_vectors. The vectors are looked up with a hash grid whose cell size is the maximum
+   distance between the vectors regarded as the same by isApprox, so only the vectors in
+   the neighboring cells have to be compared.
+*/
+void MeshFilterImpl::mergeApproxVectors
+(const SgVectorArray<Vector3f>& orgVectors, const vector<bool>& usedFlags,
+ SgVectorArray<Vector3f>& out_vectors, vector<int>& out_indexMap)
+{
+    const int numOrgVectors = orgVectors.size();
+    out_indexMap.resize(numOrgVectors);
+
+    float maxNorm = 0.0f;
+    for(int i=0; i < numOrgVectors; ++i){
+        if(usedFlags[i]){
+            maxNorm = std::max(maxNorm, orgVectors[i].norm());
+        }
+    }
+    float cellSize = 1.01f * Eigen::NumTraits<float>::dummy_precision() * maxNorm;
+    if(!(cellSize > 0.0f)){
+        cellSize = 1.0f;
+    }
+
+    unordered_map<CellId, int> firstVectorInCell;
+    vector<int> nextVectorInCell;
+    firstVectorInCell.reserve(numOrgVectors);
+    nextVectorInCell.reserve(numOrgVectors);
+    
+    for(int i=0; i < numOrgVectors; ++i){
+        if(!usedFlags[i]){
+            continue;
+        }
+        const Vector3f& v = orgVectors[i];
+        const CellId cell = {
+            static_cast<int>(floorf(v.x() / cellSize)),
+            static_cast<int>(floorf(v.y() / cellSize)),
+            static_cast<int>(floorf(v.z() / cellSize)) };
+
+        // The first vector of the same ones is used as in the linear search
+        int index = -1;
+        for(int x = cell[0] - 1; x <= cell[0] + 1; ++x){
+            for(int y = cell[1] - 1; y <= cell[1] + 1; ++y){
+                for(int z = cell[2] - 1; z <= cell[2] + 1; ++z){
+                    auto p = firstVectorInCell.find(CellId{ x, y, z });
+                    if(p != firstVectorInCell.end()){
+                        for(int j = p->second; j >= 0; j = nextVectorInCell[j]){
+                            if((index < 0 || j < index) && v.isApprox(out_vectors[j])){
+                                index = j;
+                            }
+                        }
+                    }
+                }
+            }
+        }
+        if(index < 0){
+            index = out_vectors.size();
+            out_vectors.emplace_back(v);
+            auto inserted = firstVectorInCell.emplace(cell, index);
+            if(inserted.second){
+                nextVectorInCell.push_back(-1);
+            } else {
+                nextVectorInCell.push_back(inserted.first->second);
+                inserted.first->second = index;
+            }
+        }
+        out_indexMap[i] = index;
+    }
+}
+
+
 void MeshFilter::integrateMeshes(SgMesh* mesh1, SgMesh* mesh2)
 {
     if(!mesh1 || !mesh2 || !mesh2->hasVertices()){
@@ -232,7 +421,7 @@ void MeshFilterImpl::removeRedundantVertices(SgMesh* mesh)
     const size_t numOrgVertices = pOrgVertices->size();
     SgVertexArray& vertices = *mesh->vertices();
     vertices.clear();
-    vector<int> indexMap(numOrgVertices);
+    vector<int> indexMap;
     auto& triangleVertices = mesh->triangleVertices();
 
     vector<bool> usedVertexFlags(numOrgVertices, false);
@@ -240,25 +429,7 @@ void MeshFilterImpl::removeRedundantVertices(SgMesh* mesh)
         usedVertexFlags[triangleVertices[i]] = true;
     }
 
-    for(size_t i=0; i < numOrgVertices; ++i){
-        if(!usedVertexFlags[i]){
-            continue;
-        }
-        const auto& vertex = pOrgVertices->at(i);
-        bool found = false;
-        size_t index = 0;
-        while(index < vertices.size()){
-            if(vertex.isApprox(vertices[index])){
-                found = true;
-                break;
-            }
-            ++index;
-        }
-        indexMap[i] = index;
-        if(!found){
-            vertices.emplace_back(vertex);
-        }
-    }
+    mergeApproxVectors(*pOrgVertices, usedVertexFlags, vertices, indexMap);
     vertices.shrink_to_fit();
 
     if(vertices.size() == numOrgVertices){
@@ -420,27 +591,8 @@ void MeshFilterImpl::removeRedundantNormals(SgMesh* mesh)
 
     SgVertexArray& normals = *mesh->normals();
     normals.clear();
-    vector<int> indexMap(numOrgNormals);
-
-    for(size_t i=0; i< numOrgNormals; ++i){
-        if(!usedNormalFlags[i]){
-            continue;
-        }
-        const auto& normal = pOrgNormals->at(i);
-        bool found = false;
-        size_t index = 0;
-        while(index < normals.size()){
-            if(normal.isApprox(normals[index])){
-                found = true;
-                break;
-            }
-            ++index;
-        }
-        indexMap[i] = index;
-        if(!found){
-            normals.emplace_back(normal);
-        }
-    }
+    vector<int> indexMap;
+    mergeApproxVectors(*pOrgNormals, usedNormalFlags, normals, indexMap);
     normals.shrink_to_fit();
 
     if(normals.size() == numOrgNormals){
@@ -465,14 +617,86 @@ bool MeshFilter::generateNormals(SgMesh* mesh, float creaseAngle, bool removeRed
     if(removeRedundantVertices){
         impl->removeRedundantVertices(mesh);
     }
+
+    uint64_t cacheKey = 0;
+    const bool doUseCache = impl->isNormalCacheEnabled && mesh->numTriangles() >= MinNumCachedTriangles;
+    if(doUseCache){
+        cacheKey = calcNormalCacheKey(
+            mesh, std::max(impl->minCreaseAngle, std::min(impl->maxCreaseAngle, creaseAngle)));
+        if(impl->restoreCachedNormals(mesh, cacheKey)){
+            return true;
+        }
+    }
+    
     impl->calculateFaceNormals(mesh, false);
     impl->makeFacesOfVertexMap(mesh, true);
     impl->setVertexNormals(mesh, creaseAngle);
 
+    if(doUseCache){
+        impl->cacheNormals(mesh, cacheKey);
+    }
+
     return true;
 }
 
 
+bool MeshFilterImpl::restoreCachedNormals(SgMesh* mesh, uint64_t key)
+{
+    std::lock_guard<std::mutex> lock(normalCacheMutex);
+    auto p = normalCacheMap.find(key);
+    if(p == normalCacheMap.end()){
+        return false;
+    }
+    auto& entry = *p->second;
+    if(entry.numVertices != static_cast<int>(mesh->vertices()->size()) ||
+       entry.numTriangles != mesh->numTriangles()){
+        return false;
+    }
+    mesh->setNormals(new SgNormalArray(*entry.normals));
+    mesh->normalIndices() = entry.normalIndices;
+    normalCache.splice(normalCache.begin(), normalCache, p->second);
+    return true;
+}
+
+
+void MeshFilterImpl::cacheNormals(SgMesh* mesh, uint64_t key)
+{
+    NormalCacheEntry entry;
+    entry.key = key;
+    entry.numVertices = mesh->vertices()->size();
+    entry.numTriangles = mesh->numTriangles();
+    entry.normals = new SgNormalArray(*mesh->normals());
+    entry.normalIndices = mesh->normalIndices();
+    const size_t bytes = entry.bytes();
+    if(bytes > MaxNormalCacheBytes / 2){
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(normalCacheMutex);
+    auto p = normalCacheMap.find(key);
+    if(p != normalCacheMap.end()){
+        normalCacheBytes -= p->second->bytes();
+        normalCache.erase(p->second);
+        normalCacheMap.erase(p);
+    }
+    while(!normalCache.empty() && normalCacheBytes + bytes > MaxNormalCacheBytes){
+        auto& last = normalCache.back();
+        normalCacheBytes -= last.bytes();
+        normalCacheMap.erase(last.key);
+        normalCache.pop_back();
+    }
+    normalCache.push_front(std::move(entry));
+    normalCacheMap[key] = normalCache.begin();
+    normalCacheBytes += bytes;
+}
+
+
+void MeshFilter::setNormalCacheEnabled(bool on)
+{
+    impl->isNormalCacheEnabled = on;
+}
+
+
 void MeshFilter::setNormalOverwritingEnabled(bool on)
 {
     impl->isNormalOverwritingEnabled = on;
@@ -501,26 +725,29 @@ void MeshFilterImpl::calculateFaceNormals(SgMesh* mesh, bool ignoreZeroNormals)
 {
     const SgVertexArray& vertices = *mesh->vertices();
     const int numTriangles = mesh->numTriangles();
-    faceNormals.clear();
-    faceNormals.reserve(numTriangles);
-
-    for(int i=0; i < numTriangles; ++i){
-        SgMesh::TriangleRef triangle = mesh->triangle(i);
-        const Vector3f& v0 = vertices[triangle[0]];
-        const Vector3f& v1 = vertices[triangle[1]];
-        const Vector3f& v2 = vertices[triangle[2]];
-        Vector3f normal((v1 - v0).cross(v2 - v0));
-        // prevent NaN
-        if(normal.norm() > 0.0){
-            normal.normalize();
-        } else {
-            if(!ignoreZeroNormals){
-                //! \todo remove degenerate faces
-                normal = Vector3f::UnitZ();
+    faceNormals.resize(numTriangles);
+
+    forEachRange(
+        numTriangles,
+        [&](int begin, int end){
+            for(int i = begin; i < end; ++i){
+                SgMesh::TriangleRef triangle = mesh->triangle(i);
+                const Vector3f& v0 = vertices[triangle[0]];
+                const Vector3f& v1 = vertices[triangle[1]];
+                const Vector3f& v2 = vertices[triangle[2]];
+                Vector3f normal((v1 - v0).cross(v2 - v0));
+                // prevent NaN
+                if(normal.norm() > 0.0){
+                    normal.normalize();
+                } else {
+                    if(!ignoreZeroNormals){
+                        //! \todo remove degenerate faces
+                        normal = Vector3f::UnitZ();
+                    }
+                }
+                faceNormals[i] = normal;
             }
-        }
-        faceNormals.emplace_back(normal);
-    }
+        });
 }
 
 
@@ -590,6 +817,42 @@ void MeshFilterImpl::setVertexNormals(SgMesh* mesh, float givenCreaseAngle)
     normalsOfVertexMap.clear();
     normalsOfVertexMap.resize(numVertices);
 
+    // The normals of the triangle corners are calculated in parallel
+    cornerNormals.resize(numTriangles * 3);
+    forEachRange(
+        numTriangles,
+        [&](int begin, int end){
+            for(int faceIndex = begin; faceIndex < end; ++faceIndex){
+                SgMesh::TriangleRef triangle = mesh->triangle(faceIndex);
+                for(int i=0; i < 3; ++i){
+                    const auto& faceIndicesOfVertex = facesOfVertexMap[triangle[i]];
+                    const Vector3f& currentFaceNormal = faceNormals[faceIndex];
+                    Vector3f normal = currentFaceNormal;
+                    bool normalIsFaceNormal = true;
+                
+                    // avarage normals of the faces whose crease angle is below the 'creaseAngle' variable
+                    for(size_t j=0; j < faceIndicesOfVertex.size(); ++j){
+                        const int adjacentFaceIndex = faceIndicesOfVertex[j];
+                        const Vector3f& adjacentFaceNormal = faceNormals[adjacentFaceIndex];
+                        float cosAngle = currentFaceNormal.dot(adjacentFaceNormal)
+                            / (currentFaceNormal.norm() * adjacentFaceNormal.norm());
+                        //prevent NaN
+                        if (cosAngle >  1.0) cosAngle =  1.0;
+                        if (cosAngle < -1.0) cosAngle = -1.0;
+                        const float angle = acosf(cosAngle);
+                        if(angle > 0.0f && angle < creaseAngle){
+                            normal += adjacentFaceNormal;
+                            normalIsFaceNormal = false;
+                        }
+                    }
+                    if(!normalIsFaceNormal){
+                        normal.normalize();
+                    }
+                    cornerNormals[faceIndex * 3 + i] = normal;
+                }
+            }
+        });
+
     for(int faceIndex=0; faceIndex < numTriangles; ++faceIndex){
 
         SgMesh::TriangleRef triangle = mesh->triangle(faceIndex);
@@ -597,30 +860,7 @@ void MeshFilterImpl::setVertexNormals(SgMesh* mesh, float givenCreaseAngle)
         for(int i=0; i < 3; ++i){
 
             const int vertexIndex = triangle[i];
-            const auto& faceIndicesOfVertex = facesOfVertexMap[vertexIndex];
-            const Vector3f& currentFaceNormal = faceNormals[faceIndex];
-            Vector3f normal = currentFaceNormal;
-            bool normalIsFaceNormal = true;
-                
-            // avarage normals of the faces whose crease angle is below the 'creaseAngle' variable
-            for(size_t j=0; j < faceIndicesOfVertex.size(); ++j){
-                const int adjacentFaceIndex = faceIndicesOfVertex[j];
-                const Vector3f& adjacentFaceNormal = faceNormals[adjacentFaceIndex];
-                float cosAngle = currentFaceNormal.dot(adjacentFaceNormal)
-                  / (currentFaceNormal.norm() * adjacentFaceNormal.norm());
-                //prevent NaN
-                if (cosAngle >  1.0) cosAngle =  1.0;
-                if (cosAngle < -1.0) cosAngle = -1.0;
-                const float angle = acosf(cosAngle);
-                if(angle > 0.0f && angle < creaseAngle){
-                    normal += adjacentFaceNormal;
-                    normalIsFaceNormal = false;
-                }
-            }
-            if(!normalIsFaceNormal){
-                normal.normalize();
-            }
-            
+            const Vector3f& normal = cornerNormals[faceIndex * 3 + i];
             int normalIndex = -1;
             
             for(int j=0; j < 3; ++j){
@@ -645,3 +885,302 @@ void MeshFilterImpl::setVertexNormals(SgMesh* mesh, float givenCreaseAngle)
         }
     }
 }
+
+
+SgMesh* MeshFilter::createSimplifiedMesh(SgMesh* mesh, double ratio)
+{
+    return impl->createSimplifiedMesh(mesh, ratio);
+}
+
+
+SgNode* MeshFilter::createSimplifiedScene(SgNode* scene, double ratio)
+{
+    CloneMap cloneMap;
+    SgObject::setNonNodeCloning(cloneMap, false);
+    SgNodePtr simplifiedScene = cloneMap.getClone<SgNode>(scene);
+
+    unordered_map<SgMesh*, SgMeshPtr> simplifiedMeshMap;
+    MeshExtractor extractor;
+    extractor.extract(
+        simplifiedScene,
+        [&](SgMesh* mesh){
+            auto inserted = simplifiedMeshMap.insert(make_pair(mesh, nullptr));
+            auto& simplifiedMesh = inserted.first->second;
+            if(inserted.second){
+                simplifiedMesh = impl->createSimplifiedMesh(mesh, ratio);
+            }
+            if(simplifiedMesh){
+                extractor.currentShape()->setMesh(simplifiedMesh);
+            }
+        });
+
+    return simplifiedScene.retn();
+}
+
+
+SgMesh* MeshFilterImpl::createSimplifiedMesh(SgMesh* mesh, double ratio)
+{
+    if(!mesh->hasVertices() || !mesh->hasTriangles() || mesh->hasColors() || mesh->hasTexCoords()){
+        return nullptr;
+    }
+    const int numOrgTriangles = mesh->numTriangles();
+    const int numTargetTriangles = static_cast<int>(numOrgTriangles * ratio);
+    if(numTargetTriangles < 1 || numTargetTriangles >= numOrgTriangles){
+        return nullptr;
+    }
+
+    // The vertices at the same position are merged so that the faces are connected
+    const auto& orgVertices = *mesh->vertices();
+    const int numOrgVertices = orgVertices.size();
+    vector<int> sortedVertexIndices(numOrgVertices);
+    std::iota(sortedVertexIndices.begin(), sortedVertexIndices.end(), 0);
+    std::sort(sortedVertexIndices.begin(), sortedVertexIndices.end(),
+              [&](int i, int j){
+                  const auto& v1 = orgVertices[i];
+                  const auto& v2 = orgVertices[j];
+                  return std::lexicographical_compare(v1.data(), v1.data() + 3, v2.data(), v2.data() + 3);
+              });
+    vector<Vector3> positions;
+    vector<int> vertexIndexMap(numOrgVertices);
+    for(int i=0; i < numOrgVertices; ++i){
+        const int index = sortedVertexIndices[i];
+        if(i == 0 || orgVertices[index] != orgVertices[sortedVertexIndices[i - 1]]){
+            positions.push_back(orgVertices[index].cast<double>());
+        }
+        vertexIndexMap[index] = positions.size() - 1;
+    }
+    const int numVertices = positions.size();
+
+    vector<Array3i> triangles;
+    triangles.reserve(numOrgTriangles);
+    for(int i=0; i < numOrgTriangles; ++i){
+        auto orgTriangle = mesh->triangle(i);
+        Array3i triangle(vertexIndexMap[orgTriangle[0]], vertexIndexMap[orgTriangle[1]], vertexIndexMap[orgTriangle[2]]);
+        if(triangle[0] != triangle[1] && triangle[1] != triangle[2] && triangle[2] != triangle[0]){
+            triangles.push_back(triangle);
+        }
+    }
+    int numTriangles = triangles.size();
+    vector<bool> isTriangleRemoved(numTriangles, false);
+
+    auto calcNormal = [&](const Vector3& p0, const Vector3& p1, const Vector3& p2) -> Vector3 {
+        Vector3 n = (p1 - p0).cross(p2 - p0);
+        const double norm = n.norm();
+        return (norm > 0.0) ? Vector3(n / norm) : Vector3(Vector3::Zero());
+    };
+
+    vector<Matrix4, Eigen::aligned_allocator<Matrix4>> quadrics(numVertices, Matrix4::Zero());
+    vector<vector<int>> trianglesOfVertex(numVertices);
+    unordered_map<IdPair<int>, int> numTrianglesOfEdge;
+    vector<Vector3> triangleNormals(numTriangles);
+    for(int i=0; i < numTriangles; ++i){
+        const auto& triangle = triangles[i];
+        const Vector3& p0 = positions[triangle[0]];
+        Vector3 n = calcNormal(p0, positions[triangle[1]], positions[triangle[2]]);
+        triangleNormals[i] = n;
+        Vector4 plane(n.x(), n.y(), n.z(), -n.dot(p0));
+        Matrix4 K = plane * plane.transpose();
+        for(int j=0; j < 3; ++j){
+            quadrics[triangle[j]] += K;
+            trianglesOfVertex[triangle[j]].push_back(i);
+            ++numTrianglesOfEdge[IdPair<int>(triangle[j], triangle[(j + 1) % 3])];
+        }
+    }
+    for(int i=0; i < numTriangles; ++i){
+        const auto& triangle = triangles[i];
+        for(int j=0; j < 3; ++j){
+            const int v1 = triangle[j];
+            const int v2 = triangle[(j + 1) % 3];
+            if(numTrianglesOfEdge[IdPair<int>(v1, v2)] == 1){
+                Vector3 m = (positions[v2] - positions[v1]).cross(triangleNormals[i]);
+                const double norm = m.norm();
+                if(norm > 0.0){
+                    m /= norm;
+                    Vector4 plane(m.x(), m.y(), m.z(), -m.dot(positions[v1]));
+                    Matrix4 K = BoundaryQuadricWeight * plane * plane.transpose();
+                    quadrics[v1] += K;
+                    quadrics[v2] += K;
+                }
+            }
+        }
+    }
+
+    vector<int> stamps(numVertices, 0);
+    vector<bool> isVertexRemoved(numVertices, false);
+    std::priority_queue<EdgeCollapse> collapses;
+
+    auto pushEdgeCollapse = [&](int v1, int v2){
+        EdgeCollapse collapse;
+        collapse.vertex1 = v1;
+        collapse.vertex2 = v2;
+        collapse.stamp1 = stamps[v1];
+        collapse.stamp2 = stamps[v2];
+        const Matrix4 Q = quadrics[v1] + quadrics[v2];
+        const Vector3& p1 = positions[v1];
+        const Vector3& p2 = positions[v2];
+        const Vector3 center = (p1 + p2) / 2.0;
+        bool isOptimalPositionFound = false;
+        Eigen::FullPivLU<Matrix3> lu(Q.topLeftCorner<3, 3>());
+        if(lu.isInvertible()){
+            collapse.position = lu.solve(-Q.topRightCorner<3, 1>());
+            // The position given by an ill-conditioned quadric is not used
+            isOptimalPositionFound = ((collapse.position - center).norm() <= (p2 - p1).norm());
+        }
+        if(isOptimalPositionFound){
+            collapse.cost = calcQuadricError(Q, collapse.position);
+        } else {
+            collapse.position = center;
+            collapse.cost = calcQuadricError(Q, center);
+            for(auto& p : { p1, p2 }){
+                double cost = calcQuadricError(Q, p);
+                if(cost < collapse.cost){
+                    collapse.position = p;
+                    collapse.cost = cost;
+                }
+            }
+        }
+        collapses.push(collapse);
+    };
+
+    for(auto& kv : numTrianglesOfEdge){
+        pushEdgeCollapse(kv.first[0], kv.first[1]);
+    }
+
+    auto getNeighborVertices = [&](int v, vector<int>& out_neighbors){
+        out_neighbors.clear();
+        for(int t : trianglesOfVertex[v]){
+            if(!isTriangleRemoved[t]){
+                for(int j=0; j < 3; ++j){
+                    const int u = triangles[t][j];
+                    if(u != v && std::find(out_neighbors.begin(), out_neighbors.end(), u) == out_neighbors.end()){
+                        out_neighbors.push_back(u);
+                    }
+                }
+            }
+        }
+    };
+
+    // Check if moving vertex v to the position flips the triangles not shared with vertex u
+    auto flipsTriangles = [&](int v, int u, const Vector3& position){
+        for(int t : trianglesOfVertex[v]){
+            if(isTriangleRemoved[t]){
+                continue;
+            }
+            const auto& triangle = triangles[t];
+            if(triangle[0] == u || triangle[1] == u || triangle[2] == u){
+                continue;
+            }
+            Vector3 p[3];
+            for(int j=0; j < 3; ++j){
+                p[j] = (triangle[j] == v) ? position : positions[triangle[j]];
+            }
+            Vector3 n = calcNormal(p[0], p[1], p[2]);
+            if(n.dot(triangleNormals[t]) < 0.2){
+                return true;
+            }
+        }
+        return false;
+    };
+
+    vector<int> neighbors1;
+    vector<int> neighbors2;
+    
+    while(numTriangles > numTargetTriangles && !collapses.empty()){
+        const EdgeCollapse collapse = collapses.top();
+        collapses.pop();
+        const int v1 = collapse.vertex1;
+        const int v2 = collapse.vertex2;
+        if(isVertexRemoved[v1] || isVertexRemoved[v2] ||
+           stamps[v1] != collapse.stamp1 || stamps[v2] != collapse.stamp2){
+            continue;
+        }
+
+        // The collapse must not make the surface non-manifold
+        getNeighborVertices(v1, neighbors1);
+        getNeighborVertices(v2, neighbors2);
+        int numCommonNeighbors = 0;
+        for(int u : neighbors1){
+            if(std::find(neighbors2.begin(), neighbors2.end(), u) != neighbors2.end()){
+                ++numCommonNeighbors;
+            }
+        }
+        int numSharedTriangles = 0;
+        for(int t : trianglesOfVertex[v1]){
+            const auto& triangle = triangles[t];
+            if(!isTriangleRemoved[t] && (triangle[0] == v2 || triangle[1] == v2 || triangle[2] == v2)){
+                ++numSharedTriangles;
+            }
+        }
+        if(numSharedTriangles == 0 || numCommonNeighbors > numSharedTriangles){
+            continue;
+        }
+        if(flipsTriangles(v1, v2, collapse.position) || flipsTriangles(v2, v1, collapse.position)){
+            continue;
+        }
+
+        positions[v1] = collapse.position;
+        quadrics[v1] += quadrics[v2];
+        isVertexRemoved[v2] = true;
+        for(int t : trianglesOfVertex[v2]){
+            if(isTriangleRemoved[t]){
+                continue;
+            }
+            auto& triangle = triangles[t];
+            if(triangle[0] == v1 || triangle[1] == v1 || triangle[2] == v1){
+                isTriangleRemoved[t] = true;
+                --numTriangles;
+            } else {
+                for(int j=0; j < 3; ++j){
+                    if(triangle[j] == v2){
+                        triangle[j] = v1;
+                    }
+                }
+                trianglesOfVertex[v1].push_back(t);
+            }
+        }
+        trianglesOfVertex[v2].clear();
+
+        auto& trianglesOfV1 = trianglesOfVertex[v1];
+        trianglesOfV1.erase(
+            std::remove_if(trianglesOfV1.begin(), trianglesOfV1.end(), [&](int t){ return isTriangleRemoved[t]; }),
+            trianglesOfV1.end());
+        for(int t : trianglesOfV1){
+            const auto& triangle = triangles[t];
+            triangleNormals[t] = calcNormal(positions[triangle[0]], positions[triangle[1]], positions[triangle[2]]);
+        }
+
+        ++stamps[v1];
+        getNeighborVertices(v1, neighbors1);
+        for(int u : neighbors1){
+            pushEdgeCollapse(v1, u);
+        }
+    }
+
+    auto simplifiedMesh = new SgMesh;
+    auto& vertices = *simplifiedMesh->getOrCreateVertices();
+    vector<int> newVertexIndices(numVertices, -1);
+    simplifiedMesh->reserveNumTriangles(numTriangles);
+    for(size_t i=0; i < triangles.size(); ++i){
+        if(isTriangleRemoved[i]){
+            continue;
+        }
+        auto newTriangle = simplifiedMesh->newTriangle();
+        for(int j=0; j < 3; ++j){
+            int& index = newVertexIndices[triangles[i][j]];
+            if(index < 0){
+                index = vertices.size();
+                vertices.push_back(positions[triangles[i][j]].cast<float>());
+            }
+            newTriangle[j] = index;
+        }
+    }
+    simplifiedMesh->setCreaseAngle(mesh->creaseAngle());
+    simplifiedMesh->setSolid(mesh->isSolid());
+    simplifiedMesh->updateBoundingBox();
+
+    calculateFaceNormals(simplifiedMesh, false);
+    makeFacesOfVertexMap(simplifiedMesh, true);
+    setVertexNormals(simplifiedMesh, mesh->creaseAngle());
+
+    return simplifiedMesh;
+}
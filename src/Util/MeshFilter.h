@@ -45,6 +45,27 @@ public:
     void setNormalOverwritingEnabled(bool on);
     void setMinCreaseAngle(float angle);
     void setMaxCreaseAngle(float angle);
+
+    /**
+       The normals generated for large meshes are cached with the hash values of the mesh
+       contents, and the cached normals are used for the same meshes. This is enabled by default.
+    */
+    void setNormalCacheEnabled(bool on);
+    
+    /**
+       Creates a mesh simplified by collapsing the edges in the order of the quadric error
+       until the number of the triangles is reduced to the ratio of the original number.
+       The normals of the simplified mesh are generated with the crease angle of the original
+       mesh. The meshes with the colors or the texture coordinates are not simplified.
+       \return The simplified mesh, or nullptr if the mesh is not simplified
+    */
+    SgMesh* createSimplifiedMesh(SgMesh* mesh, double ratio);
+
+    /**
+       Creates a copy of the scene whose meshes are replaced with the simplified meshes.
+       The meshes that are not simplified are shared with the original scene.
+    */
+    SgNode* createSimplifiedScene(SgNode* scene, double ratio);
     
     // Deprecated. Use enableNormalOverwriting()
     void setOverwritingEnabled(bool on);
@@ -25,6 +25,7 @@ MeshGenerator::MeshGenerator()
     extraDivisionMode_ = SgMesh::ExtraDivisionPreferred;
     isNormalGenerationEnabled_ = true;
     isBoundingBoxUpdateEnabled_ = true;
+    isTessellationDeferred_ = false;
     meshFilter = nullptr;
 }
 
@@ -100,7 +101,87 @@ bool MeshGenerator::isBoundingBoxUpdateEnabled() const
 }
 
 
+void MeshGenerator::setTessellationDeferred(bool on)
+{
+    isTessellationDeferred_ = on;
+}
+
+
+bool MeshGenerator::isTessellationDeferred() const
+{
+    return isTessellationDeferred_;
+}
+
+
 bool MeshGenerator::updateMeshWithPrimitiveInformation(SgMesh* mesh, int options)
+{
+    if(isTessellationDeferred_){
+        return deferTessellation(mesh, options);
+    }
+    return generatePrimitive(mesh, options);
+}
+
+
+bool MeshGenerator::deferTessellation(SgMesh* mesh, int options)
+{
+    bool isValid = false;
+    switch(mesh->primitiveType()){
+    case SgMesh::BoxType: {
+        auto& size = mesh->primitive<SgMesh::Box>().size;
+        isValid = (size.x() >= 0.0 && size.y() >= 0.0 && size.z() >= 0.0);
+        break;
+    }
+    case SgMesh::SphereType:
+        isValid = (mesh->primitive<SgMesh::Sphere>().radius > 0.0);
+        break;
+    case SgMesh::CylinderType: {
+        auto& cylinder = mesh->primitive<SgMesh::Cylinder>();
+        isValid = (cylinder.height > 0.0 && cylinder.radius > 0.0);
+        break;
+    }
+    case SgMesh::ConeType: {
+        auto& cone = mesh->primitive<SgMesh::Cone>();
+        isValid = (cone.height > 0.0 && cone.radius > 0.0);
+        break;
+    }
+    case SgMesh::CapsuleType: {
+        auto& capsule = mesh->primitive<SgMesh::Capsule>();
+        isValid = (capsule.height >= 0.0 && capsule.radius > 0.0);
+        break;
+    }
+    default:
+        break;
+    }
+    if(isValid){
+        mesh->setTessellationPending(options);
+        if(isBoundingBoxUpdateEnabled_){
+            mesh->updateBoundingBox();
+        }
+    }
+    return isValid;
+}
+
+
+bool MeshGenerator::tessellate(SgMesh* mesh, int divisionNumber)
+{
+    if(!mesh->isTessellationPending()){
+        return false;
+    }
+    const int options = mesh->pendingMeshOptions();
+    mesh->clearTessellationPending();
+
+    const int orgDivisionNumber = divisionNumber_;
+    if(divisionNumber >= 4){
+        divisionNumber_ = divisionNumber;
+    }
+    bool generated = generatePrimitive(mesh, options);
+    divisionNumber_ = orgDivisionNumber;
+
+    return generated;
+}
+
+
+bool MeshGenerator::generatePrimitive(SgMesh* mesh, int options)
 {
     bool generated = false;
     switch(mesh->primitiveType()){
@@ -130,7 +211,7 @@ SgMesh* MeshGenerator::generateBox(const Vector3& size, int options)
 {
     SgMeshPtr mesh = new SgMesh;
     mesh->setPrimitive(SgMesh::Box(size));
-    if(!generateBox(mesh, options)){
+    if(!updateMeshWithPrimitiveInformation(mesh, options)){
         mesh.reset();
     }
     return mesh.retn();
@@ -343,7 +424,7 @@ SgMesh* MeshGenerator::generateSphere(double radius, int options)
 {
     SgMeshPtr mesh = new SgMesh;
     mesh->setPrimitive(SgMesh::Sphere(radius));
-    if(!generateSphere(mesh, options)){
+    if(!updateMeshWithPrimitiveInformation(mesh, options)){
         mesh.reset();
     }
     return mesh.retn();
@@ -493,7 +574,7 @@ SgMesh* MeshGenerator::generateCylinder(double radius, double height, int option
 {
     SgMeshPtr mesh = new SgMesh;
     mesh->setPrimitive(SgMesh::Cylinder(radius, height));
-    if(!generateCylinder(mesh, options)){
+    if(!updateMeshWithPrimitiveInformation(mesh, options)){
         mesh.reset();
     }
     return mesh.retn();
@@ -689,7 +770,7 @@ SgMesh* MeshGenerator::generateCone(double radius, double height, int options)
 {
     SgMeshPtr mesh = new SgMesh;
     mesh->setPrimitive(SgMesh::Cone(radius, height));
-    if(!generateCone(mesh, options)){
+    if(!updateMeshWithPrimitiveInformation(mesh, options)){
         mesh.reset();
     }
     return mesh.retn();
@@ -834,7 +915,7 @@ SgMesh* MeshGenerator::generateCapsule(double radius, double height)
 {
     SgMeshPtr mesh = new SgMesh;
     mesh->setPrimitive(SgMesh::Capsule(radius, height));
-    if(!generateCapsule(mesh)){
+    if(!updateMeshWithPrimitiveInformation(mesh)){
         mesh.reset();
     }
     return mesh.retn();
@@ -1460,6 +1541,17 @@ SgMesh* MeshGenerator::generateElevationGrid(const ElevationGrid& grid, int mesh
         generateTextureCoordinateForElevationGrid(mesh, grid);
     }
 
+    // The grid of a clockwise surface is not given because its solid side is the upper side
+    if(grid.ccw && grid.xDimension >= 2 && grid.zDimension >= 2){
+        auto heightField = std::make_shared<SgMesh::HeightField>();
+        heightField->xDimension = grid.xDimension;
+        heightField->zDimension = grid.zDimension;
+        heightField->xSpacing = grid.xSpacing;
+        heightField->zSpacing = grid.zSpacing;
+        heightField->heights.assign(grid.height.begin(), grid.height.end());
+        mesh->setHeightField(heightField);
+    }
+
     if(isBoundingBoxUpdateEnabled_){
         mesh->updateBoundingBox();
     }
@@ -47,8 +47,26 @@ public:
         TextureCoordinate = 1
     };
 
+    /**
+       When the tessellation is deferred, the meshes of the primitives (box, sphere, cylinder,
+       cone and capsule) generated by this object only have the primitive information and the
+       bounding box, and their triangles are generated by the tessellate function when a
+       consumer of the meshes requires them. The division number of the consumer is used
+       for the tessellation if the mesh does not specify it.
+    */
+    void setTessellationDeferred(bool on);
+    bool isTessellationDeferred() const;
+
     bool updateMeshWithPrimitiveInformation(SgMesh* mesh, int options = NoOption);
 
+    /**
+       Generates the triangles of a mesh whose tessellation is pending.
+       \param divisionNumber The division number used instead of the one of this object.
+       The one of the mesh is used if it is specified.
+       \return true if the triangles are generated.
+    */
+    bool tessellate(SgMesh* mesh, int divisionNumber = -1);
+
     SgMesh* generateBox(const Vector3& size, int options = NoOption);
     SgMesh* generateSphere(double radius, int options = NoOption);
     SgMesh* generateCylinder(double radius, double height, int options = NoOption);
@@ -111,9 +129,12 @@ private:
     int extraDivisionMode_;
     bool isNormalGenerationEnabled_;
     bool isBoundingBoxUpdateEnabled_;
+    bool isTessellationDeferred_;
     MeshFilter* meshFilter;
 
     MeshFilter* getOrCreateMeshFilter();
+    bool generatePrimitive(SgMesh* mesh, int options);
+    bool deferTessellation(SgMesh* mesh, int options);
     void generateNormals(SgMesh* mesh, double creaseAngle);
     bool generateBox(SgMesh* mesh, int options);
     bool generateBoxWithExtraTriangles(SgMesh* mesh);
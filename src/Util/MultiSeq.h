@@ -155,6 +155,25 @@ public:
     int frameOfTime(double time) const {
         return static_cast<int>((time - offsetTime_) * frameRate_);
     }
+
+    /**
+       This function returns the valid frame at or before the time and gives the ratio of the
+       time between the frame and the next frame, which can be used to interpolate the frames.
+       The ratio is zero when the time is outside the frame range.
+    */
+    int frameOfTime(double time, double& out_ratio) const {
+        out_ratio = 0.0;
+        const double position = (time - offsetTime_) * frameRate_;
+        if(position <= 0.0){
+            return 0;
+        }
+        const int frame = static_cast<int>(position);
+        if(frame >= numFrames() - 1){
+            return std::max(0, numFrames() - 1);
+        }
+        out_ratio = position - frame;
+        return frame;
+    }
             
     double timeOfFrame(int frame) const {
         return (frameRate_ > 0.0) ? ((frame / frameRate_) + offsetTime_) : offsetTime_;
@@ -208,6 +227,11 @@ public:
         return Container::append();
     }
 
+    //! Allocates the memory so that the frames can be appended up to the number without reallocation
+    void reserveFrames(int numFrames) {
+        Container::reserve(numFrames);
+    }
+
     int clampFrameIndex(int frameIndex){
         if(frameIndex < 0){
             return 0;
@@ -3,10 +3,15 @@
 #include "SceneDrawables.h"
 #include "SceneLoader.h"
 #include "Triangulator.h"
+#include "MappedFile.h"
 #include "ImageIO.h"
 #include "NullOut.h"
+#include <fast_float/fast_float.h>
 #include <unordered_map>
+#include <thread>
+#include <limits>
 #include <algorithm>
+#include <cstring>
 #include "gettext.h"
 
 using namespace std;
@@ -16,6 +21,9 @@ namespace filesystem = stdx::filesystem;
 
 namespace {
 
+const size_t SizePerThread = 4 * 1024 * 1024;
+const int NoIndex = std::numeric_limits<int>::min();
+
 struct Registration {
     Registration(){
         SceneLoader::registerLoader(
@@ -39,14 +47,72 @@ void readVector3Ex(SimpleScanner& scanner, Vector3f& v)
     v.z() = scanner.readFloatEx();
 }
 
+struct FaceElement
+{
+    int vertex;
+    int texCoord;
+    int normal;
 };
 
+struct Directive
+{
+    enum Type { NewNode, UseMaterial, MaterialLibrary };
+    Type type;
+    //! The number of the faces preceding the directive in the chunk
+    size_t faceIndex;
+    string name;
+};
+
+/**
+   This class parses the lines of a chunk of the file. The vertex data, the faces and the
+   directives affecting the scene structure are stored for each chunk, and they are merged
+   in the order of the chunks after all the chunks are parsed. The chunks can be parsed
+   concurrently because the face elements refer to the vertex data by the indices in the
+   whole file.
+*/
+class ChunkParser
+{
+public:
+    vector<Vector3f> vertices;
+    vector<Vector3f> normals;
+    vector<Vector2f> texCoords;
+    vector<FaceElement> faceElements;
+    vector<int> faceSizes;
+    vector<Directive> directives;
+    size_t numLines;
+    string error;
+
+    void parse(const char* begin, const char* end);
+    void parseConcurrently(const char* begin, const char* end);
+    void join();
+
+private:
+    const char* pos;
+    const char* lineEnd;
+    thread parserThread;
+
+    bool parseLine();
+    bool setError(const string& message);
+    void skipSpaces();
+    bool checkEOL();
+    bool checkString(const char* str);
+    bool readFloat(float& out_value);
+    bool readInt(int& out_value);
+    string readString();
+    string readStringToEOL();
+    bool readVector3(vector<Vector3f>& vectors);
+    bool readVector2(vector<Vector2f>& vectors);
+    bool readFace();
+    bool addDirective(Directive::Type type, const string& name);
+};
+
+}
+
 namespace cnoid {
 
 class ObjSceneLoader::Impl
 {
 public:
-    SimpleScanner scanner;
     SimpleScanner subScanner;
     string token;
     SgGroupPtr group;
@@ -85,18 +151,17 @@ public:
     filesystem::path filePath;
     string fileBaseName;
     filesystem::path directoryPath;
+    size_t maxNumThreads;
 
     Impl();
     void clearBufObjects();
     SgNode* load(const string& filename);
-    SgNodePtr loadScene();
+    SgNodePtr loadScene(const char* data, size_t size);
+    void parseChunks(const char* data, size_t size, vector<ChunkParser>& parsers);
+    void mergeVertexData(vector<ChunkParser>& parsers);
     void createNewNode(const std::string& name);
     bool checkAndAddCurrentNode();
-    void readVertex();
-    void readNormal();
-    void readTextureCoordinate();
-    void readFace();
-    bool readFaceElement(int axis);
+    void addFace(const FaceElement* elements, int numElements);
     bool loadMaterialTemplateLibrary(const std::string& name);
     void readMaterial(const std::string& name);
     void createNewMaterial(const string& name);
@@ -117,6 +182,254 @@ public:
 }
 
 
+void ChunkParser::parse(const char* begin, const char* end)
+{
+    numLines = 0;
+    pos = begin;
+    try {
+        while(pos != end){
+            lineEnd = static_cast<const char*>(memchr(pos, '\n', end - pos));
+            if(!lineEnd){
+                lineEnd = end;
+            }
+            ++numLines;
+            if(!parseLine()){
+                break;
+            }
+            pos = (lineEnd == end) ? end : lineEnd + 1;
+        }
+    }
+    catch(const std::exception& ex){
+        error = ex.what();
+    }
+}
+
+
+void ChunkParser::parseConcurrently(const char* begin, const char* end)
+{
+    parserThread = thread([this, begin, end](){ parse(begin, end); });
+}
+
+
+void ChunkParser::join()
+{
+    if(parserThread.joinable()){
+        parserThread.join();
+    }
+}
+
+
+bool ChunkParser::parseLine()
+{
+    if(pos == lineEnd){
+        return true;
+    }
+    
+    switch(*pos){
+
+    case 'v':
+        ++pos;
+        if(pos != lineEnd){
+            if(*pos == ' ' || *pos == '\t'){
+                return readVector3(vertices);
+            } else if(*pos == 'n'){
+                ++pos;
+                return readVector3(normals);
+            } else if(*pos == 't'){
+                ++pos;
+                return readVector2(texCoords);
+            }
+        }
+        return setError("Unsupported directive");
+
+    case 'f':
+        ++pos;
+        return readFace();
+
+    case 'm':
+        if(checkString("mtllib ")){
+            return addDirective(Directive::MaterialLibrary, readStringToEOL());
+        }
+        return setError(format("Unsupported directive '{0}'", readString()));
+
+    case 'u':
+        if(checkString("usemtl")){
+            return addDirective(Directive::UseMaterial, readStringToEOL());
+        }
+        return setError(format("Unsupported directive '{0}'", readString()));
+
+    case 'o':
+    case 'g':
+        ++pos;
+        return addDirective(Directive::NewNode, readString());
+
+    case 'l':
+    case 's':
+    case '#':
+        return true;
+
+    default:
+        if(!checkEOL()){
+            return setError("Unsupported directive");
+        }
+        return true;
+    }
+}
+
+
+bool ChunkParser::setError(const string& message)
+{
+    error = message;
+    return false;
+}
+
+
+void ChunkParser::skipSpaces()
+{
+    while(pos != lineEnd && (*pos == ' ' || *pos == '\t')){
+        ++pos;
+    }
+}
+
+
+bool ChunkParser::checkEOL()
+{
+    skipSpaces();
+    return (pos == lineEnd || *pos == '\r');
+}
+
+
+bool ChunkParser::checkString(const char* str)
+{
+    const size_t length = strlen(str);
+    if(static_cast<size_t>(lineEnd - pos) >= length && strncmp(pos, str, length) == 0){
+        pos += length;
+        return true;
+    }
+    return false;
+}
+
+
+bool ChunkParser::readFloat(float& out_value)
+{
+    skipSpaces();
+    auto result = fast_float::from_chars(pos, lineEnd, out_value);
+    if(result.ec != std::errc()){
+        return false;
+    }
+    pos = result.ptr;
+    return true;
+}
+
+
+//! The spaces are not skipped because they cannot be put in a face element
+bool ChunkParser::readInt(int& out_value)
+{
+    const char* p = pos;
+    bool isNegative = false;
+    if(p != lineEnd && (*p == '-' || *p == '+')){
+        isNegative = (*p == '-');
+        ++p;
+    }
+    if(p == lineEnd || *p < '0' || *p > '9'){
+        return false;
+    }
+    int value = 0;
+    while(p != lineEnd && *p >= '0' && *p <= '9'){
+        value = value * 10 + (*p - '0');
+        ++p;
+    }
+    out_value = isNegative ? -value : value;
+    pos = p;
+    return true;
+}
+
+
+string ChunkParser::readString()
+{
+    skipSpaces();
+    const char* pos0 = pos;
+    while(pos != lineEnd && *pos != ' ' && *pos != '\t' && *pos != '\r'){
+        ++pos;
+    }
+    return string(pos0, pos - pos0);
+}
+
+
+string ChunkParser::readStringToEOL()
+{
+    skipSpaces();
+    const char* pos0 = pos;
+    while(pos != lineEnd && *pos != '\r'){
+        ++pos;
+    }
+    return string(pos0, pos - pos0);
+}
+
+
+bool ChunkParser::readVector3(vector<Vector3f>& vectors)
+{
+    Vector3f v;
+    if(!readFloat(v.x()) || !readFloat(v.y()) || !readFloat(v.z())){
+        return setError("Invalid value");
+    }
+    vectors.push_back(v);
+    return true;
+}
+
+
+bool ChunkParser::readVector2(vector<Vector2f>& vectors)
+{
+    Vector2f v;
+    if(!readFloat(v.x()) || !readFloat(v.y())){
+        return setError("Invalid value");
+    }
+    vectors.push_back(v);
+    return true;
+}
+
+
+bool ChunkParser::readFace()
+{
+    int numElements = 0;
+    int index;
+    while(true){
+        skipSpaces();
+        if(!readInt(index)){
+            break;
+        }
+        FaceElement element { index - 1, NoIndex, NoIndex };
+        if(pos != lineEnd && *pos == '/'){
+            ++pos;
+            if(readInt(index)){
+                element.texCoord = index - 1;
+            }
+            if(pos != lineEnd && *pos == '/'){
+                ++pos;
+                if(!readInt(index)){
+                    return setError("Invalid value");
+                }
+                element.normal = index - 1;
+            }
+        }
+        faceElements.push_back(element);
+        ++numElements;
+    }
+    if(numElements <= 2){
+        return setError("The number of face elements is less than three");
+    }
+    faceSizes.push_back(numElements);
+    return true;
+}
+
+
+bool ChunkParser::addDirective(Directive::Type type, const string& name)
+{
+    directives.push_back({ type, faceSizes.size(), name });
+    return true;
+}
+
+
 ObjSceneLoader::ObjSceneLoader()
 {
     impl = new Impl;
@@ -126,6 +439,7 @@ ObjSceneLoader::ObjSceneLoader()
 ObjSceneLoader::Impl::Impl()
 {
     imageIO.setUpsideDown(true);
+    maxNumThreads = std::max((unsigned)1, thread::hardware_concurrency());
     os_ = &nullout();
 }
 
@@ -168,7 +482,11 @@ SgNode* ObjSceneLoader::load(const std::string& filename)
 
 SgNode* ObjSceneLoader::Impl::load(const string& filename)
 {
-    if(!scanner.open(fromUTF8(filename).c_str())){
+    unique_ptr<MappedFile> file;
+    try {
+        file.reset(new MappedFile(filename));
+    }
+    catch(...){
         os() << format(_("Unable to open file \"{}\"."), filename) << endl;
         return nullptr;
     }
@@ -187,7 +505,7 @@ SgNode* ObjSceneLoader::Impl::load(const string& filename)
     currentMaterialDef = dummyMaterialInfo.material;
     
     try {
-        scene = loadScene();
+        scene = loadScene(reinterpret_cast<const char*>(file->data()), file->size());
     }
     catch(const std::exception& ex){
         os() << ex.what() << endl;
@@ -197,90 +515,58 @@ SgNode* ObjSceneLoader::Impl::load(const string& filename)
         scene->setUriByFilePathAndCurrentDirectory(filename);
     }
 
-    scanner.close();
     clearBufObjects();
 
     return scene.retn();
 }
 
 
-SgNodePtr ObjSceneLoader::Impl::loadScene()
+SgNodePtr ObjSceneLoader::Impl::loadScene(const char* data, size_t size)
 {
-    group = new SgGroup;
+    vector<ChunkParser> parsers(std::min(maxNumThreads, std::max(size_t(1), size / SizePerThread)));
+    parseChunks(data, size, parsers);
+
+    size_t lineOffset = 0;
+    for(auto& parser : parsers){
+        if(!parser.error.empty()){
+            throw std::runtime_error(
+                format("{0} at line {1} of \"{2}\".",
+                       parser.error, lineOffset + parser.numLines, filePath.filename().string()));
+        }
+        lineOffset += parser.numLines;
+    }
 
-    createNewNode(fileBaseName);
+    mergeVertexData(parsers);
 
-    while(scanner.getLine()){
-
-        switch(scanner.peekChar()){
-            
-        case 'v':
-            scanner.moveForward();
-            if(scanner.peekChar() == ' '){
-                readVertex();
-            } else if(scanner.peekChar() == 'n'){
-                scanner.moveForward();
-                readNormal();
-            } else if(scanner.peekChar() == 't'){
-                scanner.moveForward();
-                readTextureCoordinate();
-            } else {
-                scanner.throwEx("Unsupported directive");
-            }
-            break;
-            
-        case 'f':
-            scanner.moveForward();
-            readFace();
-            break;
+    group = new SgGroup;
 
-        case 'l':
-            break;
-            
-        case 'm':
-            if(scanner.checkStringAtCurrentPosition("mtllib ")){
-                scanner.readStringToEOL(token);
-                loadMaterialTemplateLibrary(token);
-            } else {
-                scanner.readString(token);
-                scanner.throwEx(format("Unsupported directive '{0}'", token));
-            }
-            break;
+    createNewNode(fileBaseName);
 
-        case 'u':
-            if(scanner.checkStringAtCurrentPosition("usemtl")){
-                scanner.readStringToEOL(token);
-                readMaterial(token);
-            } else {
-                scanner.readString(token);
-                scanner.throwEx(format("Unsupported directive '{0}'", token));
+    for(auto& parser : parsers){
+        const FaceElement* elements = parser.faceElements.data();
+        size_t faceIndex = 0;
+        auto directive = parser.directives.begin();
+        while(true){
+            while(directive != parser.directives.end() && directive->faceIndex == faceIndex){
+                switch(directive->type){
+                case Directive::NewNode:
+                    createNewNode(directive->name);
+                    break;
+                case Directive::UseMaterial:
+                    readMaterial(directive->name);
+                    break;
+                case Directive::MaterialLibrary:
+                    loadMaterialTemplateLibrary(directive->name);
+                    break;
+                }
+                ++directive;
             }
-            break;
-
-        case 'o':
-            scanner.moveForward();
-            scanner.readString(token);
-            createNewNode(token);
-            break;
-
-        case 'g':
-            scanner.moveForward();
-            scanner.readString(token);
-            createNewNode(token);
-            break;
-
-        case 's':
-            break;
-            
-        case '#':
-            break;
-
-        default:
-            scanner.skipSpacesAndTabs();
-            if(!scanner.checkLF()){
-                scanner.throwEx("Unsupported directive");
+            if(faceIndex == parser.faceSizes.size()){
+                break;
             }
-            break;
+            const int numElements = parser.faceSizes[faceIndex++];
+            addFace(elements, numElements);
+            elements += numElements;
         }
     }
 
@@ -303,6 +589,67 @@ SgNodePtr ObjSceneLoader::Impl::loadScene()
 }
 
 
+/**
+   The file is divided into the chunks at the line heads, and the chunks except the first one
+   are parsed by the other threads while the first one is parsed by the calling thread.
+*/
+void ObjSceneLoader::Impl::parseChunks(const char* data, size_t size, vector<ChunkParser>& parsers)
+{
+    const char* end = data + size;
+    const char* begin = data;
+    const size_t numChunks = parsers.size();
+    const char* firstChunkEnd = end;
+    for(size_t i=0; i < numChunks; ++i){
+        const char* chunkEnd = end;
+        if(i < numChunks - 1){
+            const char* p = std::max(begin, data + size * (i + 1) / numChunks);
+            if(auto lf = static_cast<const char*>(memchr(p, '\n', end - p))){
+                chunkEnd = lf + 1;
+            }
+        }
+        if(i == 0){
+            firstChunkEnd = chunkEnd;
+        } else {
+            parsers[i].parseConcurrently(begin, chunkEnd);
+        }
+        begin = chunkEnd;
+    }
+    parsers[0].parse(data, firstChunkEnd);
+
+    for(size_t i=1; i < numChunks; ++i){
+        parsers[i].join();
+    }
+}
+
+
+void ObjSceneLoader::Impl::mergeVertexData(vector<ChunkParser>& parsers)
+{
+    size_t numVertices = 0;
+    size_t numNormals = 0;
+    size_t numTexCoords = 0;
+    for(auto& parser : parsers){
+        numVertices += parser.vertices.size();
+        numNormals += parser.normals.size();
+        numTexCoords += parser.texCoords.size();
+    }
+    vertices->resize(numVertices);
+    normals->resize(numNormals);
+    texCoords->resize(numTexCoords);
+
+    auto vpos = vertices->begin();
+    auto npos = normals->begin();
+    auto tpos = texCoords->begin();
+    for(auto& parser : parsers){
+        vpos = std::copy(parser.vertices.begin(), parser.vertices.end(), vpos);
+        npos = std::copy(parser.normals.begin(), parser.normals.end(), npos);
+        tpos = std::copy(parser.texCoords.begin(), parser.texCoords.end(), tpos);
+        vector<Vector3f>().swap(parser.vertices);
+        vector<Vector3f>().swap(parser.normals);
+        vector<Vector2f>().swap(parser.texCoords);
+    }
+}
+
+
 void ObjSceneLoader::Impl::createNewNode(const std::string& name)
 {
     if(currentShape && !currentMesh->hasTriangles()){
@@ -381,44 +728,24 @@ bool ObjSceneLoader::Impl::checkAndAddCurrentNode()
 }
 
 
-void ObjSceneLoader::Impl::readVertex()
-{
-    vertices->emplace_back();
-    readVector3Ex(scanner, vertices->back());
-}
-
-
-void ObjSceneLoader::Impl::readNormal()
+void ObjSceneLoader::Impl::addFace(const FaceElement* elements, int numElements)
 {
-    normals->emplace_back();
-    readVector3Ex(scanner, normals->back());
-}
-
-
-void ObjSceneLoader::Impl::readTextureCoordinate()
-{
-    texCoords->emplace_back();
-    readVector2Ex(scanner, texCoords->back());
-}
-
-
-void ObjSceneLoader::Impl::readFace()
-{
-    int axis = 0;
-    while(true){
-        if(!readFaceElement(axis)){
-            break;
+    for(int i=0; i < numElements; ++i){
+        auto& element = elements[i];
+        currentVertexIndices->push_back(element.vertex);
+        if(element.texCoord != NoIndex){
+            currentTexCoordIndices->push_back(element.texCoord);
+        }
+        if(element.normal != NoIndex){
+            currentNormalIndices->push_back(element.normal);
         }
-        ++axis;
     }
-    if(axis <= 2){
-        scanner.throwEx("The number of face elements is less than thrree");
 
-    } else if(axis >= 4){
-        int index0 = currentVertexIndices->size() - axis;
-        polygon.resize(axis);
+    if(numElements >= 4){
+        int index0 = currentVertexIndices->size() - numElements;
+        polygon.resize(numElements);
         auto vpos = currentVertexIndices->begin() + index0;
-        std::copy(vpos, vpos + axis, polygon.begin());
+        std::copy(vpos, vpos + numElements, polygon.begin());
         int numTriangles = triangulator.apply(polygon);
         const auto& triangles = triangulator.triangles();
 
@@ -436,7 +763,7 @@ void ObjSceneLoader::Impl::readFace()
         }
         if(needTofixNormalIndices){
             auto npos = currentNormalIndices->begin() + index0;
-            std::copy(npos, npos + axis, polygon.begin());
+            std::copy(npos, npos + numElements, polygon.begin());
             currentNormalIndices->resize(index0);
             int localIndex = 0;
             for(int i=0; i < numTriangles; ++i){
@@ -447,7 +774,7 @@ void ObjSceneLoader::Impl::readFace()
         }
         if(needTofixTexCoordIndices){
             auto npos = currentTexCoordIndices->begin() + index0;
-            std::copy(npos, npos + axis, polygon.begin());
+            std::copy(npos, npos + numElements, polygon.begin());
             currentTexCoordIndices->resize(index0);
             int localIndex = 0;
             for(int i=0; i < numTriangles; ++i){
@@ -460,28 +787,6 @@ void ObjSceneLoader::Impl::readFace()
 }
 
 
-bool ObjSceneLoader::Impl::readFaceElement(int axis)
-{
-    int index;
-    if(!scanner.readInt(index)){
-        return false;
-    }
-        
-    currentVertexIndices->push_back(index - 1);
-
-    if(scanner.checkCharAtCurrentPosition('/')){
-        if(scanner.readInt(index)){
-            currentTexCoordIndices->push_back(index - 1);
-        }
-        if(scanner.checkCharAtCurrentPosition('/')){
-            currentNormalIndices->push_back(scanner.readIntEx() - 1);
-        }
-    }
-
-    return true;
-}
-
-
 void ObjSceneLoader::Impl::readMaterial(const std::string& name)
 {
     createNewNode("");
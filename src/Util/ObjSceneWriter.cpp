@@ -1,6 +1,7 @@
 #include "ObjSceneWriter.h"
 #include "SceneGraph.h"
 #include "SceneDrawables.h"
+#include "MeshGenerator.h"
 #include "PolymorphicSceneNodeFunctionSet.h"
 #include "IdPair.h"
 #include "UTF8.h"
@@ -45,6 +46,8 @@ public:
     MaterialPair lastMaterialPair;
     int materialLabelIdCounter;
 
+    MeshGenerator meshGenerator;
+
     filesystem::path filepath;
     filesystem::path baseDirPath;
 
@@ -204,6 +207,9 @@ bool ObjSceneWriter::Impl::writeShape(SgShape* shape, const Affine3& T)
         }
     }
     auto mesh = shape->mesh();
+    if(mesh->isTessellationPending()){
+        meshGenerator.tessellate(mesh);
+    }
     if(mesh->hasVertices() && mesh->numTriangles() > 0){
         writeMesh(mesh, T);
     }
@@ -4,19 +4,47 @@
 */
 
 #include "PointSetUtil.h"
+#include "MappedFile.h"
 #include <cnoid/EasyScanner>
 #include <cnoid/Exception>
 #include <cnoid/UTF8>
+#include <cnoid/SceneGraph>
+#include <unordered_set>
+#include <algorithm>
+#include <fmt/format.h>
 #include <fstream>
 #include <iomanip>
+#include <cstring>
 
 using namespace std;
 using namespace boost;
 using namespace cnoid;
+using fmt::format;
 
 namespace {
 
-enum Element { E_X, E_Y, E_Z, E_NORMAL_X,E_NORMAL_Y, E_NORMAL_Z, E_RGB };
+enum Element { E_X, E_Y, E_Z, E_NORMAL_X,E_NORMAL_Y, E_NORMAL_Z, E_RGB, E_OTHER };
+
+constexpr double StandardFocalLengthInPixels = 1000.0;
+constexpr int MaxOctreeDepth = 20;
+
+class OctreePointSetBuilder
+{
+public:
+    const SgPointSet* pointSet;
+    const SgVertexArray& points;
+    double pixelError;
+    int resolution;
+    std::function<bool()> isCanceled;
+    vector<int> indices;
+    unordered_set<uint64_t> occupiedCells;
+
+    OctreePointSetBuilder(const SgPointSet* pointSet, double pixelError, int resolution, std::function<bool()> isCanceled);
+    SgNode* build();
+    SgNode* buildNode(int begin, int end, const Vector3f& center, float halfSize, int depth);
+    void partitionIntoOctants(int begin, int end, const Vector3f& center, int axis, int octant, int* octantEnds);
+    SgPointSet* createPointSet(int begin, int end);
+};
 
 typedef union {
     struct {
@@ -29,7 +57,181 @@ typedef union {
 } RGBValue;
 
 
-void readPoints(SgPointSet* out_pointSet, EasyScanner& scanner, const std::vector<Element>& elements, int numPoints)
+class PCDLoadProgress
+{
+public:
+    std::function<void(double ratio)> progressCallback;
+    std::function<bool()> isCanceled;
+    int numPoints;
+
+    //! \return false if the loading is canceled
+    bool update(int pointIndex) {
+        if((pointIndex & 0xffff) == 0){
+            if(progressCallback && numPoints > 0){
+                progressCallback(std::min(1.0, static_cast<double>(pointIndex) / numPoints));
+            }
+            if(isCanceled && isCanceled()){
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+
+struct PCDField
+{
+    Element element;
+    int size;
+    char type;
+    int count;
+};
+
+
+/**
+   This function decompresses the data compressed by the LZF algorithm, which is used by the
+   binary_compressed format of PCD. A control byte less than 32 is followed by a literal run
+   of (control + 1) bytes. Otherwise the upper three bits of the control byte give the length
+   of a back reference minus two, where 7 means that the next byte is added to the length,
+   and the lower five bits and the next byte give the distance minus one.
+*/
+void decompressLZF(const unsigned char* in, size_t inSize, unsigned char* out, size_t outSize)
+{
+    const unsigned char* ip = in;
+    const unsigned char* inEnd = in + inSize;
+    unsigned char* op = out;
+    unsigned char* outEnd = out + outSize;
+
+    while(ip < inEnd){
+        unsigned int ctrl = *ip++;
+        if(ctrl < (1 << 5)){
+            size_t len = ctrl + 1;
+            if(ip + len > inEnd || op + len > outEnd){
+                throw file_read_error() << error_info_message("The compressed point data is corrupted.");
+            }
+            memcpy(op, ip, len);
+            ip += len;
+            op += len;
+        } else {
+            size_t len = ctrl >> 5;
+            if(len == 7){
+                if(ip >= inEnd){
+                    throw file_read_error() << error_info_message("The compressed point data is corrupted.");
+                }
+                len += *ip++;
+            }
+            len += 2;
+            if(ip >= inEnd){
+                throw file_read_error() << error_info_message("The compressed point data is corrupted.");
+            }
+            size_t distance = ((ctrl & 0x1f) << 8) + *ip++ + 1;
+            if(distance > static_cast<size_t>(op - out) || op + len > outEnd){
+                throw file_read_error() << error_info_message("The compressed point data is corrupted.");
+            }
+            // The reference may overlap the output, so the bytes are copied one by one
+            const unsigned char* ref = op - distance;
+            for(size_t i=0; i < len; ++i){
+                op[i] = ref[i];
+            }
+            op += len;
+        }
+    }
+
+    if(op != outEnd){
+        throw file_read_error() << error_info_message("The size of the decompressed point data is not correct.");
+    }
+}
+
+
+/**
+   This function compresses the data in the LZF format decoded by decompressLZF.
+   \return The size of the compressed data. The output buffer must have the capacity of
+   (inSize + inSize / 32 + 1) bytes, which is the size of the incompressible data.
+*/
+size_t compressLZF(const unsigned char* in, size_t inSize, unsigned char* out)
+{
+    constexpr int HashBits = 16;
+    constexpr size_t MaxDistance = 1 << 13;
+    constexpr int MaxLiteralLength = 1 << 5;
+    constexpr size_t MaxMatchLength = (1 << 8) + (1 << 3);
+
+    vector<int64_t> hashTable(1 << HashBits, -1);
+    auto getHash = [in](size_t pos){
+        uint32_t v = (in[pos] << 16) | (in[pos + 1] << 8) | in[pos + 2];
+        return (v * 2654435761u) >> (32 - HashBits);
+    };
+    
+    size_t ip = 0;
+    size_t op = 1; // The first byte is reserved for the length of the literal run
+    int literalLength = 0;
+
+    while(ip + 2 < inSize){
+        const uint32_t hash = getHash(ip);
+        const int64_t ref = hashTable[hash];
+        hashTable[hash] = ip;
+
+        if(ref >= 0 && (ip - ref) <= MaxDistance &&
+           in[ref] == in[ip] && in[ref + 1] == in[ip + 1] && in[ref + 2] == in[ip + 2]){
+
+            const size_t maxLength = std::min(MaxMatchLength, inSize - ip);
+            size_t length = 3;
+            while(length < maxLength && in[ref + length] == in[ip + length]){
+                ++length;
+            }
+            if(literalLength > 0){
+                out[op - literalLength - 1] = literalLength - 1;
+            } else {
+                --op; // The reserved byte is not used
+            }
+            const size_t distance = ip - ref - 1;
+            const size_t encodedLength = length - 2;
+            if(encodedLength < 7){
+                out[op++] = (encodedLength << 5) | (distance >> 8);
+            } else {
+                out[op++] = (7 << 5) | (distance >> 8);
+                out[op++] = encodedLength - 7;
+            }
+            out[op++] = distance & 0xff;
+
+            const size_t matchEnd = ip + length;
+            for(++ip; ip < matchEnd && ip + 2 < inSize; ++ip){
+                hashTable[getHash(ip)] = ip;
+            }
+            ip = matchEnd;
+            literalLength = 0;
+            ++op;
+
+        } else {
+            out[op++] = in[ip++];
+            if(++literalLength == MaxLiteralLength){
+                out[op - literalLength - 1] = literalLength - 1;
+                literalLength = 0;
+                ++op;
+            }
+        }
+    }
+
+    while(ip < inSize){
+        out[op++] = in[ip++];
+        if(++literalLength == MaxLiteralLength){
+            out[op - literalLength - 1] = literalLength - 1;
+            literalLength = 0;
+            ++op;
+        }
+    }
+    if(literalLength > 0){
+        out[op - literalLength - 1] = literalLength - 1;
+    } else {
+        --op;
+    }
+    
+    return op;
+}
+
+
+bool readPoints
+(SgPointSet* out_pointSet, EasyScanner& scanner, const std::vector<Element>& elements, int numPoints,
+ PCDLoadProgress& progress)
 {
     SgVertexArrayPtr vertices = new SgVertexArray();
     vertices->reserve(numPoints);
@@ -57,7 +259,11 @@ void readPoints(SgPointSet* out_pointSet, EasyScanner& scanner, const std::vecto
     Vector3f color = Vector3f::Zero();
     RGBValue rgb;
 
+    int lineIndex = 0;
     while(!scanner.isEOF()){
+        if(!progress.update(lineIndex++)){
+            return false;
+        }
         scanner.skipBlankLines();
 
         bool hasIllegalValue = false;
@@ -85,6 +291,8 @@ void readPoints(SgPointSet* out_pointSet, EasyScanner& scanner, const std::vecto
                     color[1] = rgb.green / 255.0;
                     color[2] = rgb.blue / 255.0;
                     break;
+                default:
+                    break;
                 }
             }
         }
@@ -109,6 +317,141 @@ void readPoints(SgPointSet* out_pointSet, EasyScanner& scanner, const std::vecto
         out_pointSet->setColors(colors);
         out_pointSet->colorIndices().clear();
     }
+    return true;
+}
+
+
+double readBinaryValue(const unsigned char* p, char type, int size)
+{
+    switch(type){
+    case 'F':
+        if(size == 4){
+            float value;
+            memcpy(&value, p, 4);
+            return value;
+        } else if(size == 8){
+            double value;
+            memcpy(&value, p, 8);
+            return value;
+        }
+        break;
+    case 'U':
+        switch(size){
+        case 1: return *p;
+        case 2: { uint16_t value; memcpy(&value, p, 2); return value; }
+        case 4: { uint32_t value; memcpy(&value, p, 4); return value; }
+        case 8: { uint64_t value; memcpy(&value, p, 8); return value; }
+        }
+        break;
+    case 'I':
+        switch(size){
+        case 1: return static_cast<int8_t>(*p);
+        case 2: { int16_t value; memcpy(&value, p, 2); return value; }
+        case 4: { int32_t value; memcpy(&value, p, 4); return value; }
+        case 8: { int64_t value; memcpy(&value, p, 8); return value; }
+        }
+        break;
+    }
+    return 0.0;
+}
+
+
+/**
+   The binary point data is read from the mapped file or the decompressed buffer. The value of a
+   field of the i-th point is stored at (data + fieldOffsets[j] + i * fieldStrides[j]), which
+   covers both the point-major layout of the binary format and the field-major layout of the
+   binary_compressed format. As in the ascii format, the points with invalid coordinates,
+   which are written as NaN by PCL, are skipped.
+*/
+bool readBinaryPoints
+(SgPointSet* out_pointSet, const unsigned char* data, const vector<PCDField>& fields,
+ const vector<size_t>& fieldOffsets, const vector<size_t>& fieldStrides, int numPoints,
+ PCDLoadProgress& progress)
+{
+    SgVertexArrayPtr vertices = new SgVertexArray;
+    vertices->reserve(numPoints);
+    SgNormalArrayPtr normals;
+    SgColorArrayPtr colors;
+
+    struct ElementReader {
+        Element element;
+        const unsigned char* data;
+        size_t stride;
+        char type;
+        int size;
+    };
+    vector<ElementReader> readers;
+    
+    for(size_t i=0; i < fields.size(); ++i){
+        auto& field = fields[i];
+        if(field.element == E_OTHER){
+            continue;
+        }
+        if(field.element >= E_NORMAL_X && field.element <= E_NORMAL_Z){
+            if(!normals){
+                normals = new SgNormalArray;
+                normals->reserve(numPoints);
+            }
+        } else if(field.element == E_RGB){
+            if(field.size != 4){
+                throw file_read_error() << error_info_message("The size of the 'rgb' field must be 4.");
+            }
+            if(!colors){
+                colors = new SgColorArray;
+                colors->reserve(numPoints);
+            }
+        }
+        readers.push_back({ field.element, data + fieldOffsets[i], fieldStrides[i], field.type, field.size });
+    }
+
+    Vector3f vertex = Vector3f::Zero();
+    Vector3f normal = Vector3f::Zero();
+    Vector3f color = Vector3f::Zero();
+    RGBValue rgb;
+
+    for(int i=0; i < numPoints; ++i){
+        if(!progress.update(i)){
+            return false;
+        }
+        for(auto& reader : readers){
+            const unsigned char* p = reader.data + i * reader.stride;
+            switch(reader.element){
+            case E_X: vertex.x() = readBinaryValue(p, reader.type, reader.size); break;
+            case E_Y: vertex.y() = readBinaryValue(p, reader.type, reader.size); break;
+            case E_Z: vertex.z() = readBinaryValue(p, reader.type, reader.size); break;
+            case E_NORMAL_X: normal.x() = readBinaryValue(p, reader.type, reader.size); break;
+            case E_NORMAL_Y: normal.y() = readBinaryValue(p, reader.type, reader.size); break;
+            case E_NORMAL_Z: normal.z() = readBinaryValue(p, reader.type, reader.size); break;
+            case E_RGB:
+                memcpy(&rgb.float_value, p, 4);
+                color[0] = rgb.red / 255.0f;
+                color[1] = rgb.green / 255.0f;
+                color[2] = rgb.blue / 255.0f;
+                break;
+            default:
+                break;
+            }
+        }
+        if(vertex.allFinite()){
+            vertices->push_back(vertex);
+            if(normals){
+                normals->push_back(normal);
+            }
+            if(colors){
+                colors->push_back(color);
+            }
+        }
+    }
+
+    if(vertices->empty()){
+        throw file_read_error() << error_info_message("No valid points");
+    }
+    out_pointSet->setVertices(vertices);
+    out_pointSet->setNormals(normals);
+    out_pointSet->normalIndices().clear();
+    out_pointSet->setColors(colors);
+    out_pointSet->colorIndices().clear();
+    return true;
 }
 
 }
@@ -116,13 +459,54 @@ void readPoints(SgPointSet* out_pointSet, EasyScanner& scanner, const std::vecto
 
 void cnoid::loadPCD(SgPointSet* out_pointSet, const std::string& filename)
 {
+    loadPCD(out_pointSet, filename, nullptr, nullptr);
+}
+
+
+bool cnoid::loadPCD
+(SgPointSet* out_pointSet, const std::string& filename,
+ std::function<void(double ratio)> progressCallback, std::function<bool()> isCanceled)
+{
+    PCDLoadProgress progress;
+    progress.progressCallback = progressCallback;
+    progress.isCanceled = isCanceled;
+    progress.numPoints = 0;
+
+    MappedFile file(filename);
+    const char* text = reinterpret_cast<const char*>(file.data());
+    const char* textEnd = text + file.size();
+
+    // The header ends with the line of the 'DATA' field
+    const char* dataBegin = nullptr;
+    for(const char* p = text; p < textEnd; ){
+        const char* lineEnd = static_cast<const char*>(memchr(p, '\n', textEnd - p));
+        if(!lineEnd){
+            lineEnd = textEnd;
+        }
+        while(p < lineEnd && (*p == ' ' || *p == '\t')){
+            ++p;
+        }
+        if(lineEnd - p >= 4 && strncmp(p, "DATA", 4) == 0){
+            dataBegin = (lineEnd < textEnd) ? (lineEnd + 1) : textEnd;
+            break;
+        }
+        p = lineEnd + 1;
+    }
+    if(!dataBegin){
+        throw file_read_error() << error_info_message("The 'DATA' field is not found.");
+    }
+    
     try {
-        EasyScanner scanner(filename);
+        EasyScanner scanner;
+        scanner.setText(text, dataBegin - text);
+        scanner.filename = filename;
         scanner.setCommentChar('#');
 
         int numPoints = 0;
-
-        std::vector<Element> elements;
+        vector<PCDField> fields;
+        vector<int> sizes;
+        vector<char> types;
+        vector<int> counts;
 
         while(true){
             scanner.skipBlankLines();
@@ -130,48 +514,147 @@ void cnoid::loadPCD(SgPointSet* out_pointSet, const std::string& filename)
 
             if(scanner.stringValue == "FIELDS"){
                 while(scanner.readWord()){
+                    PCDField field;
                     if(scanner.stringValue == "x"){
-                        elements.push_back(E_X);
+                        field.element = E_X;
                     } else if(scanner.stringValue == "y"){
-                        elements.push_back(E_Y);
+                        field.element = E_Y;
                     } else if(scanner.stringValue == "z"){
-                        elements.push_back(E_Z);
+                        field.element = E_Z;
                     } else if(scanner.stringValue == "normal_x"){
-                        elements.push_back(E_NORMAL_X);
+                        field.element = E_NORMAL_X;
                     } else if(scanner.stringValue == "normal_y"){
-                        elements.push_back(E_NORMAL_Y);
+                        field.element = E_NORMAL_Y;
                     } else if(scanner.stringValue == "normal_z"){
-                        elements.push_back(E_NORMAL_Z);
-                    } else if(scanner.stringValue == "rgb"){
-                        elements.push_back(E_RGB);
+                        field.element = E_NORMAL_Z;
+                    } else if(scanner.stringValue == "rgb" || scanner.stringValue == "rgba"){
+                        field.element = E_RGB;
+                    } else {
+                        field.element = E_OTHER;
                     }
+                    field.size = 4;
+                    field.type = 'F';
+                    field.count = 1;
+                    fields.push_back(field);
+                }
+            } else if(scanner.stringValue == "SIZE"){
+                while(scanner.readInt()){
+                    sizes.push_back(scanner.intValue);
+                }
+            } else if(scanner.stringValue == "TYPE"){
+                while(scanner.readWord()){
+                    types.push_back(scanner.stringValue.empty() ? 'F' : scanner.stringValue[0]);
+                }
+            } else if(scanner.stringValue == "COUNT"){
+                while(scanner.readInt()){
+                    counts.push_back(scanner.intValue);
                 }
             } else if(scanner.stringValue == "POINTS"){
                 numPoints = scanner.readIntEx("The 'POINTS' field is not correctly specified.");
             } else if(scanner.stringValue == "DATA"){
                 scanner.readWordEx("The 'DATA' field is not correctly specified.");
-                if(scanner.stringValue == "ascii"){
-                    scanner.readLFex();
-                    if(elements.empty()){
-                        scanner.throwException("The specification of field elements is not found.");
-                    }
-                    readPoints(out_pointSet, scanner, elements, numPoints);
-                    break;
-                } else {
-                    scanner.throwException("The 'ascii' format is only supported for the point DATA.");
-                }
+                break;
             } else {
                 scanner.skipToLineEnd();
             }
             scanner.readLFEOFex("The field value is not correctly specified.");
         }
+
+        if(fields.empty()){
+            scanner.throwException("The specification of field elements is not found.");
+        }
+        const string dataFormat = scanner.stringValue;
+
+        if(dataFormat == "ascii"){
+            // Each of the values of a field with multiple counts is a column
+            vector<Element> elements;
+            for(size_t i=0; i < fields.size(); ++i){
+                int count = (i < counts.size()) ? counts[i] : 1;
+                for(int j=0; j < count; ++j){
+                    elements.push_back(fields[i].element);
+                }
+            }
+            EasyScanner dataScanner;
+            dataScanner.setText(dataBegin, textEnd - dataBegin);
+            dataScanner.filename = filename;
+            dataScanner.setCommentChar('#');
+            progress.numPoints = numPoints;
+            return readPoints(out_pointSet, dataScanner, elements, numPoints, progress);
+        }
+
+        if(dataFormat != "binary" && dataFormat != "binary_compressed"){
+            scanner.throwException(format("The '{}' format is not supported for the point DATA.", dataFormat));
+        }
+        if(sizes.size() != fields.size() || types.size() != fields.size() ||
+           (!counts.empty() && counts.size() != fields.size())){
+            scanner.throwException("The numbers of the SIZE, TYPE or COUNT values do not match the FIELDS.");
+        }
+        size_t pointSize = 0;
+        for(size_t i=0; i < fields.size(); ++i){
+            auto& field = fields[i];
+            field.size = sizes[i];
+            field.type = types[i];
+            field.count = counts.empty() ? 1 : counts[i];
+            if(field.size <= 0 || field.count <= 0){
+                scanner.throwException("Invalid SIZE or COUNT value.");
+            }
+            pointSize += field.size * field.count;
+        }
+
+        const unsigned char* data = reinterpret_cast<const unsigned char*>(dataBegin);
+        const size_t dataSize = textEnd - dataBegin;
+        vector<size_t> fieldOffsets(fields.size());
+        vector<size_t> fieldStrides(fields.size());
+        vector<unsigned char> decompressed;
+        
+        if(dataFormat == "binary"){
+            if(dataSize < pointSize * numPoints){
+                scanner.throwException("The point data is shorter than the number of the points.");
+            }
+            size_t offset = 0;
+            for(size_t i=0; i < fields.size(); ++i){
+                fieldOffsets[i] = offset;
+                fieldStrides[i] = pointSize;
+                offset += fields[i].size * fields[i].count;
+            }
+        } else {
+            uint32_t compressedSize;
+            uint32_t uncompressedSize;
+            if(dataSize < 8){
+                scanner.throwException("The sizes of the compressed point data are not found.");
+            }
+            memcpy(&compressedSize, data, 4);
+            memcpy(&uncompressedSize, data + 4, 4);
+            if(dataSize - 8 < compressedSize){
+                scanner.throwException("The compressed point data is truncated.");
+            }
+            if(uncompressedSize != pointSize * numPoints){
+                scanner.throwException("The size of the compressed point data does not match the number of the points.");
+            }
+            decompressed.resize(uncompressedSize);
+            decompressLZF(data + 8, compressedSize, decompressed.data(), uncompressedSize);
+            data = decompressed.data();
+
+            // The values of each field are stored contiguously in the order of the fields
+            size_t offset = 0;
+            for(size_t i=0; i < fields.size(); ++i){
+                fieldOffsets[i] = offset;
+                fieldStrides[i] = fields[i].size * fields[i].count;
+                offset += fieldStrides[i] * numPoints;
+            }
+        }
+
+        progress.numPoints = numPoints;
+        return readBinaryPoints(out_pointSet, data, fields, fieldOffsets, fieldStrides, numPoints, progress);
+
     } catch(EasyScanner::Exception& ex){
         throw file_read_error() << error_info_message(ex.getFullMessage());
     }
 }
 
 
-void cnoid::savePCD(SgPointSet* pointSet, const std::string& filename, const Isometry3& viewpoint)
+void cnoid::savePCD
+(SgPointSet* pointSet, const std::string& filename, const Isometry3& viewpoint, PCDDataFormat format)
 {
     if(!pointSet->hasVertices()){
         throw empty_data_error() << error_info_message("Empty pointset");
@@ -180,7 +663,11 @@ void cnoid::savePCD(SgPointSet* pointSet, const std::string& filename, const Iso
     bool hasColors = pointSet->hasColors() && pointSet->colorIndices().empty();
 
     ofstream ofs;
-    ofs.open(fromUTF8(filename.c_str()));
+    if(format == PCD_ASCII){
+        ofs.open(fromUTF8(filename.c_str()));
+    } else {
+        ofs.open(fromUTF8(filename.c_str()), ios::out | ios::binary);
+    }
     ofs << scientific << setprecision(9);
 
     ofs << "# .PCD v.7 - Point Cloud Data file format\n";
@@ -209,27 +696,242 @@ void cnoid::savePCD(SgPointSet* pointSet, const std::string& filename, const Iso
     ofs << q.w() << " " << q.x() << " " << q.y() << " " << q.z() << "\n";
 
     ofs << "POINTS " << numPoints << "\n";
-    
-    ofs << "DATA ascii\n";
 
-    if(hasColors){
-        RGBValue rgb;
-        rgb.alpha = 0.0;
-        const SgColorArray& colors = *pointSet->colors();
-        for(int i=0; i < numPoints; ++i){
-            const Vector3f& p = points[i];
-            const Vector3f& c = colors[i];
-            rgb.red = (unsigned char)(255.0 * c[0]);
-            rgb.green = (unsigned char)(255.0 * c[1]);
-            rgb.blue = (unsigned char)(255.0 * c[2]);
-            ofs << p.x() << " " << p.y() << " " << p.z() << " " << rgb.float_value << "\n";
+    RGBValue rgb;
+    rgb.alpha = 0.0;
+    auto getRGB = [&](const Vector3f& c){
+        rgb.red = (unsigned char)(255.0 * c[0]);
+        rgb.green = (unsigned char)(255.0 * c[1]);
+        rgb.blue = (unsigned char)(255.0 * c[2]);
+        return rgb.float_value;
+    };
+
+    if(format == PCD_ASCII){
+        ofs << "DATA ascii\n";
+
+        if(hasColors){
+            const SgColorArray& colors = *pointSet->colors();
+            for(int i=0; i < numPoints; ++i){
+                const Vector3f& p = points[i];
+                ofs << p.x() << " " << p.y() << " " << p.z() << " " << getRGB(colors[i]) << "\n";
+            }
+        } else {
+            for(int i=0; i < numPoints; ++i){
+                const Vector3f& p = points[i];
+                ofs << p.x() << " " << p.y() << " " << p.z() << "\n";
+            }
         }
     } else {
-        for(int i=0; i < numPoints; ++i){
-            const Vector3f& p = points[i];
-            ofs << p.x() << " " << p.y() << " " << p.z() << "\n";
+        const int numFields = hasColors ? 4 : 3;
+        const size_t dataSize = sizeof(float) * numFields * numPoints;
+        vector<float> values(numFields * numPoints);
+        
+        if(format == PCD_BINARY){
+            // The values are stored in the point-major order
+            for(int i=0; i < numPoints; ++i){
+                float* v = &values[i * numFields];
+                const Vector3f& p = points[i];
+                v[0] = p.x();
+                v[1] = p.y();
+                v[2] = p.z();
+                if(hasColors){
+                    v[3] = getRGB((*pointSet->colors())[i]);
+                }
+            }
+            ofs << "DATA binary\n";
+            ofs.write(reinterpret_cast<const char*>(values.data()), dataSize);
+            
+        } else {
+            // The values are stored in the field-major order, which is compressed better
+            for(int i=0; i < numPoints; ++i){
+                const Vector3f& p = points[i];
+                values[i] = p.x();
+                values[numPoints + i] = p.y();
+                values[2 * numPoints + i] = p.z();
+                if(hasColors){
+                    values[3 * numPoints + i] = getRGB((*pointSet->colors())[i]);
+                }
+            }
+            vector<unsigned char> compressed(dataSize + dataSize / 32 + 1);
+            const uint32_t compressedSize =
+                compressLZF(reinterpret_cast<const unsigned char*>(values.data()), dataSize, compressed.data());
+            const uint32_t uncompressedSize = dataSize;
+            ofs << "DATA binary_compressed\n";
+            ofs.write(reinterpret_cast<const char*>(&compressedSize), 4);
+            ofs.write(reinterpret_cast<const char*>(&uncompressedSize), 4);
+            ofs.write(reinterpret_cast<const char*>(compressed.data()), compressedSize);
         }
     }
 
     ofs.close();
 }
+
+
+OctreePointSetBuilder::OctreePointSetBuilder
+(const SgPointSet* pointSet, double pixelError, int resolution, std::function<bool()> isCanceled)
+    : pointSet(pointSet),
+      points(*pointSet->vertices()),
+      pixelError(pixelError),
+      resolution(std::max(2, std::min(resolution, 1 << 20))),
+      isCanceled(isCanceled)
+{
+
+}
+
+
+SgNode* OctreePointSetBuilder::build()
+{
+    const int n = points.size();
+    indices.resize(n);
+    Vector3f min = points[0];
+    Vector3f max = points[0];
+    for(int i=0; i < n; ++i){
+        indices[i] = i;
+        min = min.cwiseMin(points[i]);
+        max = max.cwiseMax(points[i]);
+    }
+    float halfSize = (max - min).maxCoeff() / 2.0f;
+    if(halfSize <= 0.0f){
+        halfSize = 1.0f;
+    }
+    // A margin is added so that the points on the boundary are inside the cube
+    halfSize *= 1.001f;
+    
+    return buildNode(0, n, (min + max) / 2.0f, halfSize, 0);
+}
+
+
+/**
+   A node having not more points than the number of the cells on a face of the grid is a leaf,
+   which renders all the points. Otherwise the first point in each cell is moved to the front
+   of the range of the node, and the other points are given to the child nodes.
+*/
+SgNode* OctreePointSetBuilder::buildNode(int begin, int end, const Vector3f& center, float halfSize, int depth)
+{
+    if(isCanceled && isCanceled()){
+        return nullptr;
+    }
+
+    if(end - begin <= resolution * resolution || depth >= MaxOctreeDepth){
+        auto leaf = new SgPosTransform;
+        leaf->addChild(createPointSet(begin, end));
+        return leaf;
+    }
+
+    const float cellSize = 2.0f * halfSize / resolution;
+    const Vector3f corner = center - Vector3f::Constant(halfSize);
+    occupiedCells.clear();
+    int sampleEnd = begin;
+    for(int i = begin; i < end; ++i){
+        Vector3f c = (points[indices[i]] - corner) / cellSize;
+        uint64_t key = 0;
+        for(int j=0; j < 3; ++j){
+            int k = std::max(0, std::min(static_cast<int>(c[j]), resolution - 1));
+            key = key * resolution + k;
+        }
+        if(occupiedCells.insert(key).second){
+            std::swap(indices[sampleEnd++], indices[i]);
+        }
+    }
+    SgPointSetPtr samples = createPointSet(begin, sampleEnd);
+
+    int octantEnds[8];
+    partitionIntoOctants(sampleEnd, end, center, 0, 0, octantEnds);
+
+    SgGroupPtr detailedGroup = new SgGroup;
+    detailedGroup->addChild(samples);
+    const float childHalfSize = halfSize / 2.0f;
+    int childBegin = sampleEnd;
+    for(int i=0; i < 8; ++i){
+        int childEnd = octantEnds[i];
+        if(childEnd > childBegin){
+            Vector3f childCenter = center;
+            for(int j=0; j < 3; ++j){
+                childCenter[j] += (i & (4 >> j)) ? childHalfSize : -childHalfSize;
+            }
+            auto child = buildNode(childBegin, childEnd, childCenter, childHalfSize, depth + 1);
+            if(!child){
+                return nullptr;
+            }
+            detailedGroup->addChild(child);
+        }
+        childBegin = childEnd;
+    }
+
+    auto lod = new SgLOD;
+    lod->setCenter(center.cast<double>());
+    lod->setRanges({ cellSize * StandardFocalLengthInPixels / pixelError });
+    lod->addChild(detailedGroup);
+    lod->addChild(samples);
+
+    // The transform is used for the frustum culling of the node by the renderer
+    auto transform = new SgPosTransform;
+    transform->addChild(lod);
+
+    return transform;
+}
+
+
+/**
+   The points are partitioned by the x, y and z coordinates in this order, and the bits of an
+   octant index correspond to the positive sides of the x, y and z axes from the highest bit.
+*/
+void OctreePointSetBuilder::partitionIntoOctants
+(int begin, int end, const Vector3f& center, int axis, int octant, int* octantEnds)
+{
+    if(axis == 3){
+        octantEnds[octant] = end;
+        return;
+    }
+    auto middle = std::partition(
+        indices.begin() + begin, indices.begin() + end,
+        [&](int index){ return points[index][axis] < center[axis]; });
+    int mid = middle - indices.begin();
+    partitionIntoOctants(begin, mid, center, axis + 1, octant << 1, octantEnds);
+    partitionIntoOctants(mid, end, center, axis + 1, (octant << 1) | 1, octantEnds);
+}
+
+
+SgPointSet* OctreePointSetBuilder::createPointSet(int begin, int end)
+{
+    auto nodePointSet = new SgPointSet;
+    nodePointSet->setPointSize(pointSet->pointSize());
+    const int n = end - begin;
+    
+    auto& vertices = *nodePointSet->getOrCreateVertices(n);
+    for(int i=0; i < n; ++i){
+        vertices[i] = points[indices[begin + i]];
+    }
+    if(pointSet->hasNormals()){
+        auto& orgNormals = *pointSet->normals();
+        auto& normalIndices = pointSet->normalIndices();
+        auto& normals = *nodePointSet->getOrCreateNormals();
+        normals.resize(n);
+        for(int i=0; i < n; ++i){
+            int index = indices[begin + i];
+            normals[i] = orgNormals[normalIndices.empty() ? index : normalIndices[index]];
+        }
+    }
+    if(pointSet->hasColors()){
+        auto& orgColors = *pointSet->colors();
+        auto& colorIndices = pointSet->colorIndices();
+        auto& colors = *nodePointSet->getOrCreateColors();
+        colors.resize(n);
+        for(int i=0; i < n; ++i){
+            int index = indices[begin + i];
+            colors[i] = orgColors[colorIndices.empty() ? index : colorIndices[index]];
+        }
+    }
+    return nodePointSet;
+}
+
+
+SgNode* cnoid::createOctreePointSetScene
+(const SgPointSet* pointSet, double pixelError, int resolution, std::function<bool()> isCanceled)
+{
+    if(!pointSet->hasVertices()){
+        return nullptr;
+    }
+    OctreePointSetBuilder builder(pointSet, pixelError, resolution, isCanceled);
+    return builder.build();
+}
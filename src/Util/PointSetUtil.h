@@ -7,12 +7,48 @@
 #define CNOID_UTIL_POINT_SET_UTIL_H
 
 #include <cnoid/SceneDrawables>
+#include <functional>
 #include "exportdecl.h"
 
 namespace cnoid {
 
+/**
+   The point data of the ascii, binary and binary_compressed formats can be loaded. The binary
+   data is read from the file mapped to the memory. The x, y, z, normal and rgb fields are loaded
+   into the point set, and the other fields are skipped.
+*/
 CNOID_EXPORT void loadPCD(SgPointSet* out_pointSet, const std::string& filename);
-CNOID_EXPORT void savePCD(SgPointSet* pointSet, const std::string& filename, const Isometry3& viewpoint = Isometry3::Identity());
+
+/**
+   \param progressCallback This function is called with the ratio of the read points
+   at intervals while the points are read.
+   \param isCanceled The loading is canceled if this function returns true.
+   \return false if the loading is canceled. The point set is not modified in that case.
+*/
+CNOID_EXPORT bool loadPCD(
+    SgPointSet* out_pointSet, const std::string& filename,
+    std::function<void(double ratio)> progressCallback, std::function<bool()> isCanceled = nullptr);
+
+enum PCDDataFormat { PCD_ASCII, PCD_BINARY, PCD_BINARY_COMPRESSED };
+
+CNOID_EXPORT void savePCD(
+    SgPointSet* pointSet, const std::string& filename, const Isometry3& viewpoint = Isometry3::Identity(),
+    PCDDataFormat format = PCD_ASCII);
+
+/**
+   This function creates a scene graph rendering the points with the levels of detail of an octree.
+   Each octree node has one point for each cell of the grid with the given resolution dividing its
+   cube, and the other points of the node are given to its child nodes. The child nodes are only
+   rendered when the cell size of the node is projected larger than the given pixel error with the
+   standard focal length of 1000 pixels. The distances can be scaled by the level of detail distance
+   scale of the renderer.
+   
+   \param isCanceled The building is canceled and null is returned if this function returns true.
+   The points are not modified by the function, which can be executed in a background thread.
+*/
+CNOID_EXPORT SgNode* createOctreePointSetScene(
+    const SgPointSet* pointSet, double pixelError = 2.0, int resolution = 128,
+    std::function<bool()> isCanceled = nullptr);
 
 }
 
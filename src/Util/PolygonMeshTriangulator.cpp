@@ -6,19 +6,47 @@
 #include "PolygonMeshTriangulator.h"
 #include "Triangulator.h"
 #include "SceneDrawables.h"
+#include "ThreadPool.h"
 #include <fmt/format.h>
+#include <memory>
 
 using namespace std;
 using namespace cnoid;
 
+namespace {
+
+// The polygons are triangulated by the worker threads when they have at least twice this number of indices
+constexpr int ParallelTaskSize = 65536;
+
+struct PolygonRange
+{
+    // The position of the first index and the position of the delimiter
+    int begin;
+    int end;
+    // The position of the first index when the delimiters are not counted
+    int topPositionWithoutDelimiters;
+};
+
+struct TriangulationBuffer
+{
+    Triangulator<SgVertexArray> triangulator;
+    vector<int> polygon;
+    SgIndexArray triangleVertices;
+    vector<int> newIndexPositionToOrgPositionWithDelimitersMap;
+    vector<int> newIndexPositionToOrgPositionMap;
+};
+
+}
+
 namespace cnoid {
 
 class PolygonMeshTriangulatorImpl
 {
 public:
     bool isDeepCopyEnabled;
-    Triangulator<SgVertexArray> triangulator;
-    std::vector<int> polygon;
+    vector<PolygonRange> polygonRanges;
+    vector<TriangulationBuffer> buffers;
+    unique_ptr<ThreadPool> threadPool;
     std::vector<int> newIndexPositionToOrgPositionWithDelimitersMap;
     std::vector<int> newIndexPositionToOrgPositionMap;
     std::string errorMessage;
@@ -37,7 +65,11 @@ public:
     }
 
     PolygonMeshTriangulatorImpl();
+    PolygonMeshTriangulatorImpl(const PolygonMeshTriangulatorImpl& org);
     SgMesh* triangulate(SgPolygonMesh* polygonMesh);
+    void triangulatePolygons(
+        const SgVertexArray& vertices, const SgIndexArray& vertexIndices,
+        int beginPolygon, int endPolygon, TriangulationBuffer& buffer);
     bool setIndices(
         SgIndexArray& indices, int numElements,
         const SgIndexArray& orgIndices, const SgIndexArray& orgVertexIndices, int elementTypeId);
@@ -69,6 +101,12 @@ PolygonMeshTriangulatorImpl::PolygonMeshTriangulatorImpl()
 }
 
 
+PolygonMeshTriangulatorImpl::PolygonMeshTriangulatorImpl(const PolygonMeshTriangulatorImpl& org)
+{
+    isDeepCopyEnabled = org.isDeepCopyEnabled;
+}
+
+
 void PolygonMeshTriangulator::setDeepCopyEnabled(bool on)
 {
     impl->isDeepCopyEnabled = on;
@@ -105,14 +143,11 @@ SgMesh* PolygonMeshTriangulatorImpl::triangulate(SgPolygonMesh* orgMesh)
     }
     const SgVertexArray& vertices = *mesh->vertices();
     const int numVertices = vertices.size();
-    triangulator.setVertices(vertices);
-    SgIndexArray& triangleVertices = mesh->triangleVertices();
 
-    polygon.clear();
-    newIndexPositionToOrgPositionWithDelimitersMap.clear();
-    newIndexPositionToOrgPositionMap.clear();
+    polygonRanges.clear();
     int polygonTopIndexPosition = 0;
     int polygonTopIndexPositionWithoutDelimiters = 0;
+    int numPolygonVertices = 0;
     int numInvalidIndices = 0;
     
     for(size_t i=0; i < vertexIndices.size(); ++i){
@@ -123,29 +158,82 @@ SgMesh* PolygonMeshTriangulatorImpl::triangulate(SgPolygonMesh* orgMesh)
             }
             ++numInvalidIndices;
         } else if(index >= 0){
-            polygon.push_back(index);
+            ++numPolygonVertices;
         } else {
-            if(polygon.size() == 3){
-                for(int j=0; j < 3; ++j){
-                    triangleVertices.push_back(polygon[j]);
-                    newIndexPositionToOrgPositionWithDelimitersMap.push_back(polygonTopIndexPosition + j);
-                    newIndexPositionToOrgPositionMap.push_back(polygonTopIndexPositionWithoutDelimiters + j);
-                }
-            } else {
-                const int numTriangles = triangulator.apply(polygon);
-                const vector<int>& triangles = triangulator.triangles();
-                for(int j=0; j < numTriangles; ++j){
-                    for(int k=0; k < 3; ++k){
-                        int localIndex = triangles[j * 3 + k];
-                        triangleVertices.push_back(polygon[localIndex]);
-                        newIndexPositionToOrgPositionWithDelimitersMap.push_back(polygonTopIndexPosition + localIndex);
-                        newIndexPositionToOrgPositionMap.push_back(polygonTopIndexPositionWithoutDelimiters + localIndex);
-                    }
-                }
-            }
+            polygonRanges.push_back({ polygonTopIndexPosition, static_cast<int>(i), polygonTopIndexPositionWithoutDelimiters });
             polygonTopIndexPosition = i + 1;
-            polygonTopIndexPositionWithoutDelimiters += polygon.size();
-            polygon.clear();
+            polygonTopIndexPositionWithoutDelimiters += numPolygonVertices;
+            numPolygonVertices = 0;
+        }
+    }
+
+    /*
+      The polygons are divided into the chunks triangulated independently, and the outputs
+      of the chunks are concatenated in the order of the polygons so that the result does not
+      depend on the number of threads.
+    */
+    vector<int> chunkTopPolygons;
+    const int numPolygons = polygonRanges.size();
+    if(static_cast<int>(vertexIndices.size()) < ParallelTaskSize * 2){
+        chunkTopPolygons = { 0, numPolygons };
+    } else {
+        int chunkTopIndexPosition = 0;
+        for(int i=0; i < numPolygons; ++i){
+            if(polygonRanges[i].begin - chunkTopIndexPosition >= ParallelTaskSize || i == 0){
+                chunkTopPolygons.push_back(i);
+                chunkTopIndexPosition = polygonRanges[i].begin;
+            }
+        }
+        chunkTopPolygons.push_back(numPolygons);
+    }
+    const int numChunks = chunkTopPolygons.size() - 1;
+    if(static_cast<int>(buffers.size()) < numChunks){
+        buffers.resize(numChunks);
+    }
+    if(numChunks == 1){
+        triangulatePolygons(vertices, vertexIndices, 0, numPolygons, buffers[0]);
+    } else {
+        if(!threadPool){
+            threadPool.reset(new ThreadPool(std::max(1u, std::thread::hardware_concurrency())));
+        }
+        for(int i=0; i < numChunks; ++i){
+            threadPool->start(
+                [this, &vertices, &vertexIndices, &chunkTopPolygons, i](){
+                    triangulatePolygons(
+                        vertices, vertexIndices, chunkTopPolygons[i], chunkTopPolygons[i + 1], buffers[i]);
+                });
+        }
+        threadPool->wait();
+    }
+
+    SgIndexArray& triangleVertices = mesh->triangleVertices();
+    newIndexPositionToOrgPositionWithDelimitersMap.clear();
+    newIndexPositionToOrgPositionMap.clear();
+    if(numChunks == 1){
+        auto& buffer = buffers[0];
+        triangleVertices.swap(buffer.triangleVertices);
+        newIndexPositionToOrgPositionWithDelimitersMap.swap(buffer.newIndexPositionToOrgPositionWithDelimitersMap);
+        newIndexPositionToOrgPositionMap.swap(buffer.newIndexPositionToOrgPositionMap);
+    } else {
+        size_t numIndices = 0;
+        for(int i=0; i < numChunks; ++i){
+            numIndices += buffers[i].triangleVertices.size();
+        }
+        triangleVertices.reserve(numIndices);
+        newIndexPositionToOrgPositionWithDelimitersMap.reserve(numIndices);
+        newIndexPositionToOrgPositionMap.reserve(numIndices);
+        for(int i=0; i < numChunks; ++i){
+            auto& buffer = buffers[i];
+            triangleVertices.insert(
+                triangleVertices.end(), buffer.triangleVertices.begin(), buffer.triangleVertices.end());
+            newIndexPositionToOrgPositionWithDelimitersMap.insert(
+                newIndexPositionToOrgPositionWithDelimitersMap.end(),
+                buffer.newIndexPositionToOrgPositionWithDelimitersMap.begin(),
+                buffer.newIndexPositionToOrgPositionWithDelimitersMap.end());
+            newIndexPositionToOrgPositionMap.insert(
+                newIndexPositionToOrgPositionMap.end(),
+                buffer.newIndexPositionToOrgPositionMap.begin(),
+                buffer.newIndexPositionToOrgPositionMap.end());
         }
     }
 
@@ -200,6 +288,55 @@ SgMesh* PolygonMeshTriangulatorImpl::triangulate(SgPolygonMesh* orgMesh)
 }
 
 
+void PolygonMeshTriangulatorImpl::triangulatePolygons
+(const SgVertexArray& vertices, const SgIndexArray& vertexIndices, int beginPolygon, int endPolygon,
+ TriangulationBuffer& buffer)
+{
+    const int numVertices = vertices.size();
+    auto& triangulator = buffer.triangulator;
+    auto& polygon = buffer.polygon;
+    auto& triangleVertices = buffer.triangleVertices;
+    auto& newIndexPositionToOrgPositionWithDelimitersMap = buffer.newIndexPositionToOrgPositionWithDelimitersMap;
+    auto& newIndexPositionToOrgPositionMap = buffer.newIndexPositionToOrgPositionMap;
+
+    triangulator.setVertices(vertices);
+    triangleVertices.clear();
+    newIndexPositionToOrgPositionWithDelimitersMap.clear();
+    newIndexPositionToOrgPositionMap.clear();
+    
+    for(int i = beginPolygon; i < endPolygon; ++i){
+        auto& range = polygonRanges[i];
+        polygon.clear();
+        for(int j = range.begin; j < range.end; ++j){
+            const int index = vertexIndices[j];
+            if(index >= 0 && index < numVertices){
+                polygon.push_back(index);
+            }
+        }
+        const int polygonTopIndexPosition = range.begin;
+        const int polygonTopIndexPositionWithoutDelimiters = range.topPositionWithoutDelimiters;
+        if(polygon.size() == 3){
+            for(int j=0; j < 3; ++j){
+                triangleVertices.push_back(polygon[j]);
+                newIndexPositionToOrgPositionWithDelimitersMap.push_back(polygonTopIndexPosition + j);
+                newIndexPositionToOrgPositionMap.push_back(polygonTopIndexPositionWithoutDelimiters + j);
+            }
+        } else {
+            const int numTriangles = triangulator.apply(polygon);
+            const vector<int>& triangles = triangulator.triangles();
+            for(int j=0; j < numTriangles; ++j){
+                for(int k=0; k < 3; ++k){
+                    int localIndex = triangles[j * 3 + k];
+                    triangleVertices.push_back(polygon[localIndex]);
+                    newIndexPositionToOrgPositionWithDelimitersMap.push_back(polygonTopIndexPosition + localIndex);
+                    newIndexPositionToOrgPositionMap.push_back(polygonTopIndexPositionWithoutDelimiters + localIndex);
+                }
+            }
+        }
+    }
+}
+
+
 namespace {
 const char* message1(int elementTypeId){
     switch(elementTypeId){
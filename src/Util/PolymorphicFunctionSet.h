@@ -121,6 +121,23 @@ public:
         return functionId;
     }
 
+    /**
+       \return The id of the class whose function is dispatched for the objects of the given
+       class, or -1 if no function is dispatched for them
+    */
+    int functionClassId(int id)
+    {
+        if(id >= validDispatchTableSize){
+            if(!updateDispatchTable(id)){
+                return -1;
+            }
+        }
+        while(id >= 0 && !isFixed[id]){
+            id = registry.superClassId(id);
+        }
+        return id;
+    }
+
     bool hasFunctionFor(ObjectBase* obj) const
     {
         auto id = obj->classId();
@@ -193,6 +193,11 @@ public:
         return px;
     }
 
+    //! The number of the references to the object, including the one of this pointer
+    int use_count() const {
+        return px ? px->refCount() : 0;
+    }
+
     void swap(ref_ptr& rhs){
         T* tmp = px;
         px = rhs.px;
@@ -473,6 +473,12 @@ SgNode* STLSceneLoader::load(const std::string& filename)
 }
 
 
+bool STLSceneLoader::isCacheable() const
+{
+    return true;
+}
+
+
 SgNode* STLSceneLoader::Impl::load(const string& filename)
 {
     ifstream ifs(fromUTF8(filename).c_str(), std::ios::in | std::ios::binary);
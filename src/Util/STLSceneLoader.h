@@ -17,6 +17,7 @@ public:
     ~STLSceneLoader();
     virtual void setMessageSink(std::ostream& os) override;
     virtual SgNode* load(const std::string& filename) override;
+    virtual bool isCacheable() const override;
 
 private:
     class Impl;
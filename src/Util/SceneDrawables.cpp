@@ -4,6 +4,7 @@
 */
 
 #include "SceneDrawables.h"
+#include "MeshGenerator.h"
 #include "CloneMap.h"
 #include "SceneNodeClassRegistry.h"
 
@@ -464,6 +465,7 @@ SgMesh::SgMesh()
     divisionNumber_ = -1;
     extraDivisionNumber_ = -1;
     extraDivisionMode_ = ExtraDivisionPreferred;
+    pendingMeshOptions_ = -1;
 }
 
 
@@ -477,9 +479,11 @@ SgMesh::SgMesh(Primitive primitive)
 SgMesh::SgMesh(const SgMesh& org, CloneMap* cloneMap)
     : SgMeshBase(org, cloneMap),
       primitive_(org.primitive_),
+      heightField_(org.heightField_),
       divisionNumber_(org.divisionNumber_),
       extraDivisionNumber_(org.extraDivisionNumber_),
-      extraDivisionMode_(org.extraDivisionMode_)
+      extraDivisionMode_(org.extraDivisionMode_),
+      pendingMeshOptions_(org.pendingMeshOptions_)
 {
 
 }
@@ -493,7 +497,10 @@ Referenced* SgMesh::doClone(CloneMap* cloneMap) const
 
 void SgMesh::updateBoundingBox()
 {
-    if(!USE_FACES_FOR_BOUNDING_BOX_CALCULATION){
+    if(isTessellationPending()){
+        updateBoundingBoxWithPrimitive();
+
+    } else if(!USE_FACES_FOR_BOUNDING_BOX_CALCULATION){
         SgMeshBase::updateBoundingBox();
 
     } else {
@@ -502,7 +509,7 @@ void SgMesh::updateBoundingBox()
         } else {
             BoundingBoxf bboxf;
             const SgVertexArray& v = *vertices();
-            for(auto& index : faceVertexIndices_){
+            for(auto& index : faceVertexIndices_.get()){
                 bboxf.expandBy(v[index]);
             }
             bbox = bboxf;
@@ -511,8 +518,46 @@ void SgMesh::updateBoundingBox()
 }
 
 
+void SgMesh::updateBoundingBoxWithPrimitive()
+{
+    Vector3 half;
+    switch(primitiveType()){
+    case BoxType:
+        half = primitive<Box>().size / 2.0;
+        break;
+    case SphereType: {
+        double r = primitive<Sphere>().radius;
+        half << r, r, r;
+        break;
+    }
+    case CylinderType: {
+        auto& cylinder = primitive<Cylinder>();
+        half << cylinder.radius, cylinder.height / 2.0, cylinder.radius;
+        break;
+    }
+    case ConeType: {
+        auto& cone = primitive<Cone>();
+        half << cone.radius, cone.height / 2.0, cone.radius;
+        break;
+    }
+    case CapsuleType: {
+        auto& capsule = primitive<Capsule>();
+        half << capsule.radius, capsule.height / 2.0 + capsule.radius, capsule.radius;
+        break;
+    }
+    default:
+        bbox.clear();
+        return;
+    }
+    bbox.set(-half, half);
+}
+
+
 void SgMesh::transform(const Affine3& T)
 {
+    if(isTessellationPending()){
+        MeshGenerator().tessellate(this);
+    }
     if(hasVertices()){
         auto& v = *vertices();
         for(size_t i=0; i < v.size(); ++i){
@@ -527,11 +572,15 @@ void SgMesh::transform(const Affine3& T)
         }
     }
     setPrimitive(SgMesh::Mesh()); // clear the primitive information
+    heightField_.reset();
 }
 
 
 void SgMesh::transform(const Affine3f& T)
 {
+    if(isTessellationPending()){
+        MeshGenerator().tessellate(this);
+    }
     if(hasVertices()){
         auto& v = *vertices();
         for(size_t i=0; i < v.size(); ++i){
@@ -545,11 +594,15 @@ void SgMesh::transform(const Affine3f& T)
         }
     }
     setPrimitive(SgMesh::Mesh()); // clear the primitive information
+    heightField_.reset();
 }
 
 
 void SgMesh::translate(const Vector3f& translation)
 {
+    if(isTessellationPending()){
+        MeshGenerator().tessellate(this);
+    }
     if(hasVertices()){
         auto& v = *vertices();
         for(size_t i=0; i < v.size(); ++i){
@@ -557,11 +610,15 @@ void SgMesh::translate(const Vector3f& translation)
         }
     }
     setPrimitive(SgMesh::Mesh()); // clear the primitive information
+    heightField_.reset();
 }
     
 
 void SgMesh::rotate(const Matrix3f& R)
 {
+    if(isTessellationPending()){
+        MeshGenerator().tessellate(this);
+    }
     if(hasVertices()){
         auto& v = *vertices();
         for(size_t i=0; i < v.size(); ++i){
@@ -575,6 +632,7 @@ void SgMesh::rotate(const Matrix3f& R)
         }
     }
     setPrimitive(SgMesh::Mesh()); // clear the primitive information
+    heightField_.reset();
 }    
     
 
@@ -608,7 +666,7 @@ void SgPolygonMesh::updateBoundingBox()
         } else {
             BoundingBoxf bboxf;
             const SgVertexArray& v = *vertices();
-            for(auto& index : faceVertexIndices_){
+            for(auto& index : faceVertexIndices_.get()){
                 if(index >= 0){
                     bboxf.expandBy(v[index]);
                 }
@@ -168,6 +168,45 @@ private:
 typedef ref_ptr<SgTexture> SgTexturePtr;
 
 
+/**
+   This class holds the data shared by the copies of an object until one of them modifies
+   it (copy-on-write), so that the cloned scenes do not duplicate the geometry data. The
+   non-const accessors of the classes holding the data make it unique to the object, so the
+   data should be read with the const accessors to keep it shared.
+*/
+template<class Container>
+class SgSharedData
+{
+public:
+    SgSharedData() { }
+    SgSharedData(Container&& org) : data_(std::make_shared<Container>(std::move(org))) { }
+    SgSharedData(const Container& org) : data_(std::make_shared<Container>(org)) { }
+
+    const Container& get() const {
+        if(data_){
+            return *data_;
+        }
+        static const Container emptyContainer;
+        return emptyContainer;
+    }
+    Container& getMutable() {
+        if(!data_){
+            data_ = std::make_shared<Container>();
+        } else if(data_.use_count() > 1){
+            data_ = std::make_shared<Container>(*data_);
+        }
+        return *data_;
+    }
+    void clear() { data_.reset(); }
+    bool isShared() const { return data_.use_count() > 1; }
+    //! The copies sharing the data have the same id
+    const void* id() const { return data_.get(); }
+
+private:
+    std::shared_ptr<Container> data_;
+};
+
+
 template<class T, class Alloc = std::allocator<T>> class SgVectorArray : public SgObject
 {
     typedef std::vector<T> Container;
@@ -184,58 +223,64 @@ public:
     typedef typename T::Scalar Scalar;
 
     SgVectorArray() { }
-    SgVectorArray(size_t size) : values(size) { }
+    SgVectorArray(size_t size) : values(Container(size)) { }
     SgVectorArray(const std::vector<T>& org) : values(org) { }
-    SgVectorArray(std::initializer_list<T> init) : values(init) { }
+    SgVectorArray(std::initializer_list<T> init) : values(Container(init)) { }
 
     template<class Element>
     SgVectorArray(const std::vector<Element>& org) {
-        values.reserve(org.size());
+        auto& v = values.getMutable();
+        v.reserve(org.size());
         for(typename std::vector<Element>::const_iterator p = org.begin(); p != org.end(); ++p){
-            values.push_back(p->template cast<typename T::Scalar>());
+            v.push_back(p->template cast<typename T::Scalar>());
         }
     }
-        
+
+    //! The copy shares the values with the original array until one of them is modified
     SgVectorArray(const SgVectorArray& org) : SgObject(org), values(org.values) { }
 
     SgVectorArray<T>& operator=(const SgVectorArray<T>& rhs) {
         values = rhs.values;
         return *this;
     }
-    iterator begin() { return values.begin(); }
-    const_iterator begin() const { return values.begin(); }
-    iterator end() { return values.end(); }
-    const_iterator end() const { return values.end(); }
-    size_type size() const { return values.size(); }
-    void resize(size_type s) { values.resize(s); }
-    void resize(size_type s, const T& v) { values.resize(s, v); }
-    bool empty() const { return values.empty(); }
-    void reserve(size_type s) { values.reserve(s); }
-    size_type capacity() const { return values.capacity(); }
-    T& operator[](size_type i) { return values[i]; }
-    const T& operator[](size_type i) const { return values[i]; }
-    T& at(size_type i) { return values[i]; }
-    const T& at(size_type i) const { return values[i]; }
-    T& front() { return values.front(); }
-    const T& front() const { return values.front(); }
-    T& back() { return values.back(); }
-    const T& back() const { return values.back(); }
-    Scalar* data() { return values.front().data(); }
-    const Scalar* data() const { return values.front().data(); }
-    iterator insert(const_iterator pos, std::initializer_list<T> il){ return values.insert(pos, il); }
-    void push_back(const T& v) { values.push_back(v); }
-    template<class... Args> void emplace_back(Args&&... args) { values.emplace_back(args...); }
-    void pop_back() { values.pop_back(); }
-    iterator erase(iterator p) { return values.erase(p); }
-    iterator erase(iterator first, iterator last) { return values.erase(first, last); }
+    iterator begin() { return values.getMutable().begin(); }
+    const_iterator begin() const { return values.get().begin(); }
+    iterator end() { return values.getMutable().end(); }
+    const_iterator end() const { return values.get().end(); }
+    size_type size() const { return values.get().size(); }
+    void resize(size_type s) { values.getMutable().resize(s); }
+    void resize(size_type s, const T& v) { values.getMutable().resize(s, v); }
+    bool empty() const { return values.get().empty(); }
+    void reserve(size_type s) { values.getMutable().reserve(s); }
+    size_type capacity() const { return values.get().capacity(); }
+    T& operator[](size_type i) { return values.getMutable()[i]; }
+    const T& operator[](size_type i) const { return values.get()[i]; }
+    T& at(size_type i) { return values.getMutable()[i]; }
+    const T& at(size_type i) const { return values.get()[i]; }
+    T& front() { return values.getMutable().front(); }
+    const T& front() const { return values.get().front(); }
+    T& back() { return values.getMutable().back(); }
+    const T& back() const { return values.get().back(); }
+    Scalar* data() { return values.getMutable().front().data(); }
+    const Scalar* data() const { return values.get().front().data(); }
+    iterator insert(const_iterator pos, std::initializer_list<T> il){ return values.getMutable().insert(pos, il); }
+    void push_back(const T& v) { values.getMutable().push_back(v); }
+    template<class... Args> void emplace_back(Args&&... args) { values.getMutable().emplace_back(args...); }
+    void pop_back() { values.getMutable().pop_back(); }
+    iterator erase(iterator p) { return values.getMutable().erase(p); }
+    iterator erase(iterator first, iterator last) { return values.getMutable().erase(first, last); }
     void clear() { values.clear(); }
-    void shrink_to_fit() { values.shrink_to_fit(); }
+    void shrink_to_fit() { values.getMutable().shrink_to_fit(); }
+
+    bool isDataShared() const { return values.isShared(); }
+    const void* dataId() const { return values.id(); }
+    size_t dataBytes() const { return values.get().capacity() * sizeof(T); }
 
 protected:
     virtual Referenced* doClone(CloneMap*) const override { return new SgVectorArray(*this); }
         
 private:
-    Container values;
+    SgSharedData<Container> values;
 };
 
 typedef SgVectorArray<Vector3f> SgVertexArray;
@@ -293,23 +338,23 @@ public:
     SgTexCoordArray* setTexCoords(SgTexCoordArray* texCoords);
     SgTexCoordArray* getOrCreateTexCoords();
 
-    bool hasFaceVertexIndices() const { return !faceVertexIndices_.empty(); }
-    const SgIndexArray& faceVertexIndices() const { return faceVertexIndices_; }
-    SgIndexArray& faceVertexIndices() { return faceVertexIndices_; }
+    bool hasFaceVertexIndices() const { return !faceVertexIndices_.get().empty(); }
+    const SgIndexArray& faceVertexIndices() const { return faceVertexIndices_.get(); }
+    SgIndexArray& faceVertexIndices() { return faceVertexIndices_.getMutable(); }
     /**
        Normals are assinged for vertices in triangles.
     */
-    bool hasNormalIndices() const { return !normalIndices_.empty(); }
-    const SgIndexArray& normalIndices() const { return normalIndices_; }
-    SgIndexArray& normalIndices() { return normalIndices_; }
+    bool hasNormalIndices() const { return !normalIndices_.get().empty(); }
+    const SgIndexArray& normalIndices() const { return normalIndices_.get(); }
+    SgIndexArray& normalIndices() { return normalIndices_.getMutable(); }
 
-    bool hasColorIndices() const { return !colorIndices_.empty(); }
-    const SgIndexArray& colorIndices() const { return colorIndices_; }
-    SgIndexArray& colorIndices() { return colorIndices_; }
+    bool hasColorIndices() const { return !colorIndices_.get().empty(); }
+    const SgIndexArray& colorIndices() const { return colorIndices_.get(); }
+    SgIndexArray& colorIndices() { return colorIndices_.getMutable(); }
 
-    bool hasTexCoordIndices() const { return !texCoordIndices_.empty(); }
-    const SgIndexArray& texCoordIndices() const { return texCoordIndices_; }
-    SgIndexArray& texCoordIndices() { return texCoordIndices_; }
+    bool hasTexCoordIndices() const { return !texCoordIndices_.get().empty(); }
+    const SgIndexArray& texCoordIndices() const { return texCoordIndices_.get(); }
+    SgIndexArray& texCoordIndices() { return texCoordIndices_.getMutable(); }
 
     float creaseAngle() const { return creaseAngle_; }
     void setCreaseAngle(float angle) { creaseAngle_ = angle; }
@@ -320,13 +365,13 @@ public:
 protected:
     BoundingBox bbox;
     SgVertexArrayPtr vertices_;
-    SgIndexArray faceVertexIndices_;
+    SgSharedData<SgIndexArray> faceVertexIndices_;
     SgNormalArrayPtr normals_;
-    SgIndexArray normalIndices_;
+    SgSharedData<SgIndexArray> normalIndices_;
     SgColorArrayPtr colors_;
-    SgIndexArray colorIndices_;
+    SgSharedData<SgIndexArray> colorIndices_;
     SgTexCoordArrayPtr texCoords_;
-    SgIndexArray texCoordIndices_;
+    SgSharedData<SgIndexArray> texCoordIndices_;
     float creaseAngle_;
     bool isSolid_;
 };
@@ -345,53 +390,57 @@ public:
     /**
        Triangle indices (triangles variable) should be CCW.
     */
-    const SgIndexArray& triangleVertices() const { return faceVertexIndices_; }
-    SgIndexArray& triangleVertices() { return faceVertexIndices_; }
+    const SgIndexArray& triangleVertices() const { return faceVertexIndices_.get(); }
+    SgIndexArray& triangleVertices() { return faceVertexIndices_.getMutable(); }
 
-    bool hasTriangles() const { return !faceVertexIndices_.empty(); }
-    int numTriangles() const { return static_cast<int>(faceVertexIndices_.size()) / 3; }
-    void setNumTriangles(int n) { faceVertexIndices_.resize(n * 3); }
-    void reserveNumTriangles(int n) { faceVertexIndices_.reserve(n * 3); }
+    bool hasTriangles() const { return !faceVertexIndices_.get().empty(); }
+    int numTriangles() const { return static_cast<int>(faceVertexIndices_.get().size()) / 3; }
+    void setNumTriangles(int n) { faceVertexIndices_.getMutable().resize(n * 3); }
+    void reserveNumTriangles(int n) { faceVertexIndices_.getMutable().reserve(n * 3); }
 
     typedef Eigen::Map<Array3i> TriangleRef;
     TriangleRef triangle(int index){
-        return TriangleRef(&faceVertexIndices_[index * 3]);
+        return TriangleRef(&faceVertexIndices_.getMutable()[index * 3]);
     }
 
     typedef Eigen::Map<const Array3i> ConstTriangleRef;
     ConstTriangleRef triangle(int index) const {
-        return ConstTriangleRef(&faceVertexIndices_[index * 3]);
+        return ConstTriangleRef(&faceVertexIndices_.get()[index * 3]);
     }
 
     void setTriangle(int index, int v0, int v1, int v2){
+        auto& indices = faceVertexIndices_.getMutable();
         const int i = index * 3;
-        faceVertexIndices_[i+0] = v0;
-        faceVertexIndices_[i+1] = v1;
-        faceVertexIndices_[i+2] = v2;
+        indices[i+0] = v0;
+        indices[i+1] = v1;
+        indices[i+2] = v2;
     }
 
     TriangleRef newTriangle(){
-        const size_t s = faceVertexIndices_.size();
-        faceVertexIndices_.resize(s + 3);
-        return TriangleRef(&faceVertexIndices_[s]);
+        auto& indices = faceVertexIndices_.getMutable();
+        const size_t s = indices.size();
+        indices.resize(s + 3);
+        return TriangleRef(&indices[s]);
     }
 
     // deprecated
     TriangleRef addTriangle(){ return newTriangle(); }
 
     void addTriangles(std::initializer_list<Array3i> il){
-        faceVertexIndices_.reserve(faceVertexIndices_.size() + il.size() * 3);
+        auto& indices = faceVertexIndices_.getMutable();
+        indices.reserve(indices.size() + il.size() * 3);
         for(auto& v : il){
             for(int i=0; i < 3; ++i){
-                faceVertexIndices_.push_back(v[i]);
+                indices.push_back(v[i]);
             }
         }
     }
 
     void addTriangle(int v0, int v1, int v2){
-        faceVertexIndices_.push_back(v0);
-        faceVertexIndices_.push_back(v1);
-        faceVertexIndices_.push_back(v2);
+        auto& indices = faceVertexIndices_.getMutable();
+        indices.push_back(v0);
+        indices.push_back(v1);
+        indices.push_back(v2);
     }
         
     enum PrimitiveType {
@@ -463,6 +512,33 @@ public:
     template<class TPrimitive> const TPrimitive& primitive() const { return stdx::get<TPrimitive>(primitive_); }
     void setPrimitive(Primitive prim) { primitive_ = prim; }
 
+    /**
+       The grid of the heights from which the triangles of the mesh are generated.
+       The vertex of grid point (x, z) is (x * xSpacing, height(x, z), z * zSpacing), and the
+       triangles face the +Y direction. A collision detector or a physics engine can use this
+       information to create a height field shape instead of the triangle mesh.
+    */
+    class HeightField {
+    public:
+        HeightField() : xDimension(0), zDimension(0), xSpacing(1.0), zSpacing(1.0) { }
+        int xDimension;
+        int zDimension;
+        double xSpacing;
+        double zSpacing;
+        std::vector<float> heights;
+        float height(int x, int z) const { return heights[z * xDimension + x]; }
+        double xSize() const { return (xDimension - 1) * xSpacing; }
+        double zSize() const { return (zDimension - 1) * zSpacing; }
+    };
+
+    /**
+       The height field is shared by the cloned meshes. It is cleared by the functions to
+       transform the vertices because the vertices no longer correspond to the grid.
+    */
+    const HeightField* heightField() const { return heightField_.get(); }
+    std::shared_ptr<const HeightField> sharedHeightField() const { return heightField_; }
+    void setHeightField(std::shared_ptr<const HeightField> heightField) { heightField_ = heightField; }
+
     //! The value is -1 when the division number is not explicitly specified.
     int divisionNumber() const { return divisionNumber_; }
     void setDivisionNumber(int n) { divisionNumber_ = n; }
@@ -482,6 +558,17 @@ public:
     int extraDivisionMode() const { return extraDivisionMode_; }
     void setExtraDivisionMode(int mode) { extraDivisionMode_ = mode; }
 
+    /**
+       The tessellation of a primitive mesh is pending when it is deferred by MeshGenerator.
+       Such a mesh only has the primitive information and the bounding box until the triangles
+       are generated by MeshGenerator::tessellate.
+    */
+    bool isTessellationPending() const { return pendingMeshOptions_ >= 0; }
+    //! \return A combination of MeshGenerator::MeshOption symbols, or -1 if the tessellation is not pending
+    int pendingMeshOptions() const { return pendingMeshOptions_; }
+    void setTessellationPending(int meshOptions) { pendingMeshOptions_ = meshOptions; }
+    void clearTessellationPending() { pendingMeshOptions_ = -1; }
+
     void transform(const Affine3& T);
     void transform(const Affine3f& T);
     void translate(const Vector3f& translation);
@@ -492,9 +579,13 @@ protected:
 
 private:
     Primitive primitive_;
+    std::shared_ptr<const HeightField> heightField_;
     short divisionNumber_;
     short extraDivisionNumber_;
     short extraDivisionMode_;
+    short pendingMeshOptions_;
+
+    void updateBoundingBoxWithPrimitive();
 };
 
 typedef ref_ptr<SgMesh> SgMeshPtr;
@@ -516,9 +607,9 @@ public:
        indices in the same way.
     */
     [[deprecated("Use faceVertexIndices")]]
-    SgIndexArray& polygonVertices() { return faceVertexIndices_; }
+    SgIndexArray& polygonVertices() { return faceVertexIndices(); }
     [[deprecated("Use faceVertexIndices")]]
-    const SgIndexArray& polygonVertices() const { return faceVertexIndices_; }
+    const SgIndexArray& polygonVertices() const { return faceVertexIndices(); }
 
 protected:
     virtual Referenced* doClone(CloneMap* cloneMap) const override;
@@ -602,8 +693,8 @@ public:
     SgColorArray* setColors(SgColorArray* colors);
     SgColorArray* getOrCreateColors(int size = 0);
 
-    const SgIndexArray& colorIndices() const { return colorIndices_; }
-    SgIndexArray& colorIndices() { return colorIndices_; }
+    const SgIndexArray& colorIndices() const { return colorIndices_.get(); }
+    SgIndexArray& colorIndices() { return colorIndices_.getMutable(); }
 
     /**
        The following normal data is usually not used for rendering lines or points,
@@ -617,17 +708,17 @@ public:
     const SgNormalArray* normals() const { return normals_; }
     SgNormalArray* setNormals(SgNormalArray* normals);
     SgVertexArray* getOrCreateNormals();
-    const SgIndexArray& normalIndices() const { return normalIndices_; }
-    SgIndexArray& normalIndices() { return normalIndices_; }
+    const SgIndexArray& normalIndices() const { return normalIndices_.get(); }
+    SgIndexArray& normalIndices() { return normalIndices_.getMutable(); }
 
 private:
     BoundingBox bbox;
     SgVertexArrayPtr vertices_;
     SgMaterialPtr material_;
     SgColorArrayPtr colors_;
-    SgIndexArray colorIndices_;
+    SgSharedData<SgIndexArray> colorIndices_;
     SgNormalArrayPtr normals_;
-    SgIndexArray normalIndices_;
+    SgSharedData<SgIndexArray> normalIndices_;
 };
 
 typedef ref_ptr<SgPlot> SgPlotPtr;
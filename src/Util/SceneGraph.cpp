@@ -25,6 +25,17 @@ CloneMap::FlagId DisableNonNodeCloning("SgObjectDisableNonNodeCloning");
 
 const BoundingBox emptyBoundingBox;
 
+struct UpdateBatchState
+{
+    int depth;
+    vector<pair<SgObjectPtr, int>> dirtyObjects;
+    unordered_map<SgObject*, int> dirtyObjectIndices;
+    unordered_map<SgObject*, int> notifiedActions;
+    UpdateBatchState() : depth(0) { }
+};
+
+thread_local UpdateBatchState updateBatchState;
+
 }
 
 
@@ -37,9 +48,11 @@ SgObject::SgObject()
 
 SgObject::SgObject(const SgObject& org)
     : attributes_(org.attributes_),
-      hasValidBoundingBoxCache_(false),
-      name_(org.name_)
+      hasValidBoundingBoxCache_(false)
 {
+    if(org.name_){
+        name_.reset(new string(*org.name_));
+    }
     if(org.uriInfo){
         uriInfo.reset(new UriInfo(*org.uriInfo));
     }
@@ -52,6 +65,32 @@ Referenced* SgObject::doClone(CloneMap*) const
 }
 
 
+const std::string& SgObject::emptyName()
+{
+    static const string name;
+    return name;
+}
+
+
+void SgObject::setName(const std::string& name)
+{
+    if(name_){
+        *name_ = name;
+    } else if(!name.empty()){
+        name_.reset(new string(name));
+    }
+}
+
+
+SgObject::Signals* SgObject::getOrCreateSignals()
+{
+    if(!signals_){
+        signals_.reset(new Signals);
+    }
+    return signals_.get();
+}
+
+
 bool SgObject::checkNonNodeCloning(const CloneMap& cloneMap)
 {
     return !cloneMap.flag(DisableNonNodeCloning);
@@ -88,7 +127,9 @@ void SgObject::notifyUpperNodesOfUpdate(SgUpdate& update, bool doInvalidateBound
     if(doInvalidateBoundingBox){
         invalidateBoundingBox();
     }
-    sigUpdated_(update);
+    if(signals_){
+        signals_->sigUpdated(update);
+    }
     for(const_parentIter p = parents.begin(); p != parents.end(); ++p){
         (*p)->notifyUpperNodesOfUpdate(update, doInvalidateBoundingBox);
     }
@@ -96,6 +137,67 @@ void SgObject::notifyUpperNodesOfUpdate(SgUpdate& update, bool doInvalidateBound
 }
 
 
+bool SgObject::deferUpdateInBatch(int action)
+{
+    auto& state = updateBatchState;
+    if(state.depth == 0 || (action & (SgUpdate::Added | SgUpdate::Removed)) || refCount() == 0){
+        return false;
+    }
+    auto inserted = state.dirtyObjectIndices.emplace(this, state.dirtyObjects.size());
+    if(inserted.second){
+        state.dirtyObjects.emplace_back(this, action);
+    } else {
+        state.dirtyObjects[inserted.first->second].second |= action;
+    }
+    return true;
+}
+
+
+/**
+   This function does the same thing as notifyUpperNodesOfUpdate except that the upper nodes that
+   have already been notified of the same action in the batch are not notified again. Only the
+   root nodes above them are notified so that the slots of the roots receive the path.
+*/
+void SgObject::notifyUpperNodesOfBatchUpdate(SgUpdate& update, bool doInvalidateBoundingBox)
+{
+    update.pushNode(this);
+    if(doInvalidateBoundingBox){
+        invalidateBoundingBox();
+    }
+    if(signals_){
+        signals_->sigUpdated(update);
+    }
+    const int action = update.action();
+    auto& notifiedActions = updateBatchState.notifiedActions;
+    for(const_parentIter p = parents.begin(); p != parents.end(); ++p){
+        int& notified = notifiedActions[*p];
+        if((notified & action) != action){
+            notified |= action;
+            (*p)->notifyUpperNodesOfBatchUpdate(update, doInvalidateBoundingBox);
+        } else {
+            (*p)->notifyRootNodesOfBatchUpdate(update);
+        }
+    }
+    update.popNode();
+}
+
+
+void SgObject::notifyRootNodesOfBatchUpdate(SgUpdate& update)
+{
+    update.pushNode(this);
+    if(parents.empty()){
+        if(signals_){
+            signals_->sigUpdated(update);
+        }
+    } else {
+        for(const_parentIter p = parents.begin(); p != parents.end(); ++p){
+            (*p)->notifyRootNodesOfBatchUpdate(update);
+        }
+    }
+    update.popNode();
+}
+
+
 void SgObject::addParent(SgObject* parent, SgUpdateRef update)
 {
     parents.insert(parent);
@@ -107,8 +209,8 @@ void SgObject::addParent(SgObject* parent, SgUpdateRef update)
             update->withAction(SgUpdate::Added), hasAttribute(Geometry));
     }
 
-    if(parents.size() == 1){
-        sigGraphConnection_(true);
+    if(parents.size() == 1 && signals_){
+        signals_->sigGraphConnection(true);
     }
 }
 
@@ -116,9 +218,36 @@ void SgObject::addParent(SgObject* parent, SgUpdateRef update)
 void SgObject::removeParent(SgObject* parent)
 {
     parents.erase(parent);
-    if(parents.empty()){
-        sigGraphConnection_(false);
+    if(parents.empty() && signals_){
+        signals_->sigGraphConnection(false);
+    }
+}
+
+
+static size_t getStringHeapBytes(const string& s)
+{
+    // The short strings are stored in the string object itself
+    return (s.capacity() >= sizeof(string)) ? (s.capacity() + 1) : 0;
+}
+
+
+size_t SgObject::auxiliaryDataBytes() const
+{
+    // Each node of std::set has three links and a color flag in addition to the value
+    size_t bytes = parents.size() * (sizeof(void*) * 4 + sizeof(SgObject*));
+    if(signals_){
+        bytes += sizeof(Signals);
+    }
+    if(name_){
+        bytes += sizeof(string) + getStringHeapBytes(*name_);
     }
+    if(uriInfo){
+        bytes += sizeof(UriInfo) +
+            getStringHeapBytes(uriInfo->uri) +
+            getStringHeapBytes(uriInfo->absoluteUri) +
+            getStringHeapBytes(uriInfo->fragment);
+    }
+    return bytes;
 }
 
 
@@ -197,6 +326,56 @@ void SgObject::setUriFragment(const std::string& fragment)
 }
 
 
+SgUpdateBatch::SgUpdateBatch()
+{
+    ++updateBatchState.depth;
+}
+
+
+SgUpdateBatch::~SgUpdateBatch()
+{
+    if(--updateBatchState.depth == 0){
+        flush();
+    }
+}
+
+
+bool SgUpdateBatch::isActive()
+{
+    return updateBatchState.depth > 0;
+}
+
+
+void SgUpdateBatch::flush()
+{
+    auto& state = updateBatchState;
+    if(state.dirtyObjects.empty()){
+        return;
+    }
+    // The updates notified by the slots are not deferred because the depth is zero here
+    vector<pair<SgObjectPtr, int>> dirtyObjects;
+    dirtyObjects.swap(state.dirtyObjects);
+    state.dirtyObjectIndices.clear();
+
+    SgUpdate update;
+    update.reservePathCapacity(16);
+    for(auto& dirty : dirtyObjects){
+        auto& object = dirty.first;
+        const int action = dirty.second;
+        int& notified = state.notifiedActions[object];
+        update.setAction(action);
+        update.clearPath();
+        if((notified & action) != action){
+            notified |= action;
+            object->notifyUpperNodesOfBatchUpdate(update, update.hasAction(SgUpdate::GeometryModified));
+        } else {
+            object->notifyRootNodesOfBatchUpdate(update);
+        }
+    }
+    state.notifiedActions.clear();
+}
+
+
 int SgNode::findClassId(const std::type_info& nodeType)
 {
     return SceneNodeClassRegistry::instance().classId(nodeType);
@@ -992,6 +1171,47 @@ Referenced* SgUnpickableGroup::doClone(CloneMap* cloneMap) const
 }
 
 
+SgLOD::SgLOD()
+    : SgLOD(findClassId<SgLOD>())
+{
+
+}
+
+
+SgLOD::SgLOD(int classId)
+    : SgGroup(classId),
+      center_(Vector3::Zero())
+{
+
+}
+
+
+SgLOD::SgLOD(const SgLOD& org, CloneMap* cloneMap)
+    : SgGroup(org, cloneMap),
+      center_(org.center_),
+      ranges_(org.ranges_)
+{
+
+}
+
+
+Referenced* SgLOD::doClone(CloneMap* cloneMap) const
+{
+    return new SgLOD(*this, cloneMap);
+}
+
+
+int SgLOD::selectLevel(double distance) const
+{
+    const int numRanges = ranges_.size();
+    int level = 0;
+    while(level < numRanges && distance >= ranges_[level]){
+        ++level;
+    }
+    return (level < numChildren()) ? level : -1;
+}
+
+
 SgPreprocessed::SgPreprocessed(int classId)
     : SgNode(classId)
 {
@@ -1020,6 +1240,7 @@ struct NodeClassRegistration {
             .registerClass<SgFixedPixelSizeGroup, SgGroup>()
             .registerClass<SgSwitchableGroup, SgGroup>()
             .registerClass<SgUnpickableGroup, SgGroup>()
+            .registerClass<SgLOD, SgGroup>()
             .registerClass<SgPreprocessed, SgNode>();
     }
 } registration;
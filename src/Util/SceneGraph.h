@@ -53,7 +53,9 @@ public:
         NodeDecoration = 1 << 6,
         Marker = 1 << 7,
         Operable = 1 << 8,
-        MaxAttributeBit = 9,
+        // The object is usually not moved or modified, so renderers may cache the results of rendering it
+        Static = 1 << 9,
+        MaxAttributeBit = 10,
 
         // deprecated
         GroupAttribute = GroupNode,
@@ -63,29 +65,38 @@ public:
 
     void setAttribute(int attr){ attributes_ |= attr; }
     void setAttributes(int attrs){ attributes_ |= attrs; }
+    void clearAttribute(int attr){ attributes_ &= ~attr; }
     int attributes() const { return attributes_; }
     bool hasAttribute(int attr) const { return attributes_ & attr; }
     bool hasAttributes(int attrs) const { return (attributes_ & attrs) == attrs; }
     
-    const std::string& name() const { return name_; }
-    void setName(const std::string& name) { name_ = name; }
+    const std::string& name() const { return name_ ? *name_ : emptyName(); }
+    void setName(const std::string& name);
 
     virtual int numChildObjects() const;
     virtual SgObject* childObject(int index);
 
     SignalProxy<void(const SgUpdate& update)> sigUpdated() {
-        return sigUpdated_;
+        return getOrCreateSignals()->sigUpdated;
     }
         
+    /**
+       The update is deferred while an SgUpdateBatch instance exists in the current thread.
+       Note that the update action cannot be deferred when it contains Added or Removed.
+    */
     void notifyUpdate(SgUpdate& update) {
-        update.clearPath();
-        notifyUpperNodesOfUpdate(update);
+        if(!deferUpdateInBatch(update.action())){
+            update.clearPath();
+            notifyUpperNodesOfUpdate(update);
+        }
     }
 
     void notifyUpdate(int action = SgUpdate::Modified) {
-        SgUpdate update(action);
-        update.reservePathCapacity(16);
-        notifyUpperNodesOfUpdate(update);
+        if(!deferUpdateInBatch(action)){
+            SgUpdate update(action);
+            update.reservePathCapacity(16);
+            notifyUpperNodesOfUpdate(update);
+        }
     }
 
     void addParent(SgObject* parent, SgUpdateRef update = nullptr);
@@ -101,7 +112,7 @@ public:
        or the object is detached from all the upper node.
     */
     SignalProxy<void(bool on)> sigGraphConnection() {
-        return sigGraphConnection_;
+        return getOrCreateSignals()->sigGraphConnection;
     }
 
     bool hasValidBoundingBoxCache() const { return hasValidBoundingBoxCache_; }
@@ -120,6 +131,13 @@ public:
     void setUriFragment(const std::string& fragment);
     void clearUri() { uriInfo.reset(); }
 
+    /**
+       \return The approximate size of the heap memory allocated for the members of this class,
+       which are the parent container, the signals, the name and the URI information.
+       The memory allocated for the connected slots is not included.
+    */
+    size_t auxiliaryDataBytes() const;
+
     bool isNode() const { return hasAttribute(Node); }
     SgNode* toNode();
     bool isGroupNode() const { return hasAttribute(GroupNode); }
@@ -135,12 +153,27 @@ protected:
     void notifyUpperNodesOfUpdate(SgUpdate& update, bool doInvalidateBoundingBox);
             
 private:
+    bool deferUpdateInBatch(int action);
+    void notifyUpperNodesOfBatchUpdate(SgUpdate& update, bool doInvalidateBoundingBox);
+    void notifyRootNodesOfBatchUpdate(SgUpdate& update);
+    static const std::string& emptyName();
+
     unsigned short attributes_;
     mutable bool hasValidBoundingBoxCache_;
     ParentContainer parents;
-    Signal<void(const SgUpdate& update)> sigUpdated_;
-    Signal<void(bool on)> sigGraphConnection_;
-    std::string name_;
+
+    /*
+      The signals and the name are allocated only when they are used because most of
+      the objects in a large scene graph have neither a slot connected to them nor a name.
+    */
+    struct Signals {
+        Signal<void(const SgUpdate& update)> sigUpdated;
+        Signal<void(bool on)> sigGraphConnection;
+    };
+    std::unique_ptr<Signals> signals_;
+    std::unique_ptr<std::string> name_;
+
+    Signals* getOrCreateSignals();
 
     struct UriInfo {
         std::string uri;
@@ -149,11 +182,37 @@ private:
     };
     
     mutable std::unique_ptr<UriInfo> uriInfo;
+
+    friend class SgUpdateBatch;
 };
 
 typedef ref_ptr<SgObject> SgObjectPtr;
 
 
+/**
+   The updates notified by SgObject::notifyUpdate in the current thread are collected while
+   an instance of this class exists, and they are notified when the outermost instance is
+   destroyed. Each object is notified once with the merged actions of its deferred updates,
+   and the upper nodes shared by the updated objects are also notified only once for each action.
+   The root nodes, which have no parents, are notified of the update of every object so that
+   their slots can check the path of each update. Note that the bounding box caches of the upper nodes are invalidated when the updates are
+   notified, so the bounding boxes should not be used to check the deferred modifications.
+*/
+class CNOID_EXPORT SgUpdateBatch
+{
+public:
+    SgUpdateBatch();
+    ~SgUpdateBatch();
+    SgUpdateBatch(const SgUpdateBatch&) = delete;
+    SgUpdateBatch& operator=(const SgUpdateBatch&) = delete;
+
+    static bool isActive();
+
+private:
+    static void flush();
+};
+
+
 class CNOID_EXPORT SgNode : public SgObject
 {
 public:
@@ -592,6 +651,39 @@ protected:
 typedef ref_ptr<SgUnpickableGroup> SgUnpickableGroupPtr;
 
 
+/**
+   The children are the levels of detail in the order from the most detailed one, and the
+   level whose distance range includes the distance from the viewpoint to the center is
+   rendered. The i-th range is the distance at which the i-th level is switched to the next
+   one. Beyond the last range, the last child is rendered if the number of the children
+   exceeds the number of the ranges, and no child is rendered otherwise.
+*/
+class CNOID_EXPORT SgLOD : public SgGroup
+{
+public:
+    SgLOD();
+    SgLOD(const SgLOD& org, CloneMap* cloneMap = nullptr);
+
+    const Vector3& center() const { return center_; }
+    void setCenter(const Vector3& center) { center_ = center; }
+    const std::vector<double>& ranges() const { return ranges_; }
+    void setRanges(const std::vector<double>& ranges) { ranges_ = ranges; }
+
+    //! \return The index of the child to render, or -1 if no child is rendered
+    int selectLevel(double distance) const;
+
+protected:
+    SgLOD(int classId);
+    virtual Referenced* doClone(CloneMap* cloneMap) const override;
+
+private:
+    Vector3 center_;
+    std::vector<double> ranges_;
+};
+
+typedef ref_ptr<SgLOD> SgLODPtr;
+
+
 class CNOID_EXPORT SgPreprocessed : public SgNode
 {
 protected:
@@ -24,11 +24,32 @@ public:
 
     int optimizedPathCounter;
 
+    // For the static mesh merging
+    struct StaticShapeInfo {
+        SgShape* shape;
+        SgGroup* parent;
+        Affine3 T;
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+    };
+    struct StaticShapeBatch {
+        SgShape* firstShape;
+        vector<StaticShapeInfo*> shapes;
+    };
+    vector<StaticShapeInfo, Eigen::aligned_allocator<StaticShapeInfo>> staticShapes;
+    vector<StaticShapeBatch> staticShapeBatches;
+    // The pairs of the group nodes and their parents in the post-order
+    vector<pair<SgGroup*, SgGroup*>> visitedStaticGroups;
+    int mergedShapeCounter;
+
     int simplifyTransformPathsWithTransformedMeshes(SgGroup* scene, CloneMap& cloneMap);
     void extractMeshPaths(SgGroup* group, NodePath& path);
     void extractCommonPathsToMeshes();
     void transformMeshes();
     void simplifyMeshPaths(CloneMap& cloneMap);
+    void findStaticGroups(SgGroup* group);
+    void mergeStaticMeshesInGroup(SgGroup* group);
+    void extractStaticShapes(SgGroup* group, const Affine3& T);
+    SgMesh* createMergedMesh(const vector<StaticShapeInfo*>& shapes);
 };
 
 }
@@ -52,6 +73,14 @@ int SceneGraphOptimizer::simplifyTransformPathsWithTransformedMeshes(SgGroup* sc
 }
 
 
+int SceneGraphOptimizer::mergeStaticMeshes(SgGroup* scene)
+{
+    impl->mergedShapeCounter = 0;
+    impl->findStaticGroups(scene);
+    return impl->mergedShapeCounter;
+}
+
+
 int SceneGraphOptimizer::Impl::simplifyTransformPathsWithTransformedMeshes(SgGroup* scene, CloneMap& cloneMap)
 {
     optimizedPathCounter = 0;
@@ -205,3 +234,244 @@ void SceneGraphOptimizer::Impl::simplifyMeshPaths(CloneMap& cloneMap)
         }
     }
 }
+
+
+namespace {
+
+// The meshes having more triangles are not merged because merging them does not reduce draw calls much
+constexpr int MaxNumMergedMeshTriangles = 10000;
+
+bool isMergeableGroup(SgNode* node)
+{
+    static const int groupClassIds[] = {
+        SgNode::findClassId<SgGroup>(),
+        SgNode::findClassId<SgInvariantGroup>(),
+        SgNode::findClassId<SgPosTransform>(),
+        SgNode::findClassId<SgScaleTransform>(),
+        SgNode::findClassId<SgAffineTransform>()
+    };
+    if(node->hasAttribute(SgObject::Operable)){
+        return false;
+    }
+    const int classId = node->classId();
+    for(auto& id : groupClassIds){
+        if(classId == id){
+            return true;
+        }
+    }
+    return false;
+}
+
+SgMesh* getMergeableMesh(SgNode* node)
+{
+    static const int shapeClassId = SgNode::findClassId<SgShape>();
+    if(node->classId() != shapeClassId || node->hasAttribute(SgObject::Operable)){
+        return nullptr;
+    }
+    auto mesh = static_cast<SgShape*>(node)->mesh();
+    if(!mesh || !mesh->hasVertices() || !mesh->hasTriangles() ||
+       mesh->numTriangles() > MaxNumMergedMeshTriangles){
+        return nullptr;
+    }
+    return mesh;
+}
+
+bool isSameMaterial(const SgMaterial* m1, const SgMaterial* m2)
+{
+    if(m1 == m2){
+        return true;
+    }
+    if(!m1 || !m2){
+        return false;
+    }
+    return (m1->diffuseColor() == m2->diffuseColor() &&
+            m1->emissiveColor() == m2->emissiveColor() &&
+            m1->specularColor() == m2->specularColor() &&
+            m1->specularExponent() == m2->specularExponent() &&
+            m1->ambientIntensity() == m2->ambientIntensity() &&
+            m1->transparency() == m2->transparency());
+}
+
+//! The shapes rendered in the same way except for the geometry can be merged.
+bool canBeMerged(SgShape* shape1, SgShape* shape2)
+{
+    auto mesh1 = shape1->mesh();
+    auto mesh2 = shape2->mesh();
+    return (shape1->texture() == shape2->texture() &&
+            isSameMaterial(shape1->material(), shape2->material()) &&
+            mesh1->hasNormals() == mesh2->hasNormals() &&
+            mesh1->hasColors() == mesh2->hasColors() &&
+            mesh1->hasTexCoords() == mesh2->hasTexCoords() &&
+            mesh1->isSolid() == mesh2->isSolid() &&
+            mesh1->creaseAngle() == mesh2->creaseAngle());
+}
+
+/**
+   Appends the indices of the triangles. The indices of the triangle vertices of
+   the mesh are used when the attribute does not have its own indices.
+*/
+void appendTriangleIndices(SgIndexArray& indices, const SgIndexArray& orgIndices, int offset, bool isMirrored)
+{
+    const size_t n = orgIndices.size();
+    indices.reserve(indices.size() + n);
+    for(size_t i=0; i + 2 < n; i += 3){
+        indices.push_back(orgIndices[i] + offset);
+        // The vertex order is reversed to keep the faces CCW when the transform is a mirror
+        if(isMirrored){
+            indices.push_back(orgIndices[i + 2] + offset);
+            indices.push_back(orgIndices[i + 1] + offset);
+        } else {
+            indices.push_back(orgIndices[i + 1] + offset);
+            indices.push_back(orgIndices[i + 2] + offset);
+        }
+    }
+}
+
+}
+
+
+void SceneGraphOptimizer::Impl::findStaticGroups(SgGroup* group)
+{
+    for(auto& node : *group){
+        if(node->isGroupNode()){
+            auto childGroup = node->toGroupNode();
+            if(dynamic_cast<SgInvariantGroup*>(childGroup) || childGroup->hasAttribute(SgObject::Static)){
+                mergeStaticMeshesInGroup(childGroup);
+            } else {
+                findStaticGroups(childGroup);
+            }
+        }
+    }
+}
+
+
+void SceneGraphOptimizer::Impl::mergeStaticMeshesInGroup(SgGroup* group)
+{
+    extractStaticShapes(group, Affine3::Identity());
+
+    for(auto& info : staticShapes){
+        StaticShapeBatch* batch = nullptr;
+        for(auto& existingBatch : staticShapeBatches){
+            if(canBeMerged(existingBatch.firstShape, info.shape)){
+                batch = &existingBatch;
+                break;
+            }
+        }
+        if(!batch){
+            staticShapeBatches.emplace_back();
+            batch = &staticShapeBatches.back();
+            batch->firstShape = info.shape;
+        }
+        batch->shapes.push_back(&info);
+    }
+
+    for(auto& batch : staticShapeBatches){
+        if(batch.shapes.size() < 2){
+            continue;
+        }
+        SgShapePtr mergedShape = new SgShape;
+        mergedShape->setMesh(createMergedMesh(batch.shapes));
+        mergedShape->setMaterial(batch.firstShape->material());
+        mergedShape->setTexture(batch.firstShape->texture());
+        for(auto& info : batch.shapes){
+            info->parent->removeChild(info->shape);
+        }
+        group->addChild(mergedShape);
+        mergedShapeCounter += batch.shapes.size();
+    }
+
+    // Remove the emptied groups. The children are visited before their parents.
+    for(auto& groupAndParent : visitedStaticGroups){
+        auto childGroup = groupAndParent.first;
+        if(childGroup->empty() && childGroup->name().empty()){
+            groupAndParent.second->removeChild(childGroup);
+        }
+    }
+
+    staticShapes.clear();
+    staticShapeBatches.clear();
+    visitedStaticGroups.clear();
+}
+
+
+void SceneGraphOptimizer::Impl::extractStaticShapes(SgGroup* group, const Affine3& T)
+{
+    for(auto& node : *group){
+        if(getMergeableMesh(node)){
+            staticShapes.emplace_back();
+            auto& info = staticShapes.back();
+            info.shape = static_cast<SgShape*>(node.get());
+            info.parent = group;
+            info.T = T;
+        } else if(isMergeableGroup(node)){
+            auto childGroup = node->toGroupNode();
+            if(childGroup->isTransformNode()){
+                Affine3 T_local;
+                childGroup->toTransformNode()->getTransform(T_local);
+                extractStaticShapes(childGroup, T * T_local);
+            } else {
+                extractStaticShapes(childGroup, T);
+            }
+            visitedStaticGroups.emplace_back(childGroup, group);
+        }
+    }
+}
+
+
+SgMesh* SceneGraphOptimizer::Impl::createMergedMesh(const vector<StaticShapeInfo*>& shapes)
+{
+    auto mergedMesh = new SgMesh;
+    auto firstMesh = shapes.front()->shape->mesh();
+    mergedMesh->setCreaseAngle(firstMesh->creaseAngle());
+    mergedMesh->setSolid(firstMesh->isSolid());
+    auto& vertices = *mergedMesh->getOrCreateVertices();
+    
+    for(auto& info : shapes){
+        auto mesh = info->shape->mesh();
+        const Affine3f T = info->T.cast<float>();
+        const bool isMirrored = T.linear().determinant() < 0.0f;
+        const auto& triangles = mesh->triangleVertices();
+
+        const int vertexOffset = vertices.size();
+        for(auto& v : *mesh->vertices()){
+            vertices.push_back(T * v);
+        }
+        appendTriangleIndices(mergedMesh->triangleVertices(), triangles, vertexOffset, isMirrored);
+
+        if(mesh->hasNormals()){
+            auto& normals = *mergedMesh->getOrCreateNormals();
+            const int offset = normals.size();
+            // The inverse transpose keeps the normals perpendicular to the scaled faces
+            const Matrix3f N = T.linear().inverse().transpose();
+            for(auto& n : *mesh->normals()){
+                normals.push_back((N * n).normalized());
+            }
+            appendTriangleIndices(
+                mergedMesh->normalIndices(),
+                mesh->hasNormalIndices() ? mesh->normalIndices() : triangles, offset, isMirrored);
+        }
+        if(mesh->hasColors()){
+            auto& colors = *mergedMesh->getOrCreateColors();
+            const int offset = colors.size();
+            for(auto& c : *mesh->colors()){
+                colors.push_back(c);
+            }
+            appendTriangleIndices(
+                mergedMesh->colorIndices(),
+                mesh->hasColorIndices() ? mesh->colorIndices() : triangles, offset, isMirrored);
+        }
+        if(mesh->hasTexCoords()){
+            auto& texCoords = *mergedMesh->getOrCreateTexCoords();
+            const int offset = texCoords.size();
+            for(auto& t : *mesh->texCoords()){
+                texCoords.push_back(t);
+            }
+            appendTriangleIndices(
+                mergedMesh->texCoordIndices(),
+                mesh->hasTexCoordIndices() ? mesh->texCoordIndices() : triangles, offset, isMirrored);
+        }
+    }
+
+    mergedMesh->updateBoundingBox();
+    return mergedMesh;
+}
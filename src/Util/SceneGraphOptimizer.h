@@ -22,6 +22,18 @@ public:
     //! \return Number of the simplified paths
     int simplifyTransformPathsWithTransformedMeshes(SgGroup* scene, CloneMap& cloneMap);
 
+    /**
+       Merges the meshes of the shapes with the same appearance in each SgInvariantGroup node
+       and each group node with the Static attribute into a mesh whose vertices are transformed
+       into the coordinate frame of the group node. The merged shapes are put directly under the
+       group node, and the group nodes emptied by the merging are removed unless they have names.
+       The nodes with the Operable attribute and their sub trees are kept as they are so that
+       they can still be picked, and so are the switchable groups, the LOD nodes and the large
+       meshes. The scene is modified without notifying any update.
+       \return Number of the shapes merged into the batched shapes
+    */
+    int mergeStaticMeshes(SgGroup* scene);
+
 private:
     class Impl;
     Impl* impl;
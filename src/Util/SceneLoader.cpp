@@ -3,17 +3,28 @@
 */
 
 #include "SceneLoader.h"
+#include "SceneDrawables.h"
+#include "CloneMap.h"
 #include "NullOut.h"
 #include "UTF8.h"
+#include "Tracer.h"
 #include <cnoid/stdx/filesystem>
 #include <fmt/format.h>
 #include <mutex>
 #include <map>
+#include <unordered_map>
+#include <fstream>
+#include <sstream>
+#include <typeinfo>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
 #include <algorithm>
 #include "gettext.h"
 
 using namespace std;
 using namespace cnoid;
+namespace filesystem = cnoid::stdx::filesystem;
 
 namespace {
 
@@ -25,6 +36,574 @@ vector<LoaderFactory> loaderFactories;
 mutex loaderMutex;
 Signal<void(const std::vector<std::string>& extensions)> sigAvailableFileExtensionsAdded_;
 
+string cacheDirectory_;
+mutex cacheDirectoryMutex;
+
+struct SharedScene
+{
+    SgNodePtr scene;
+    int64_t fileSize;
+    int64_t fileTime;
+};
+unordered_map<string, SharedScene> sharedScenes;
+mutex sharedSceneMutex;
+Signal<void()> sigSharedScenesCleared_;
+
+const uint32_t CacheFileMagic = 0x53434e43; // "CNCS"
+const uint32_t CacheFileVersion = 1;
+
+enum CacheObjectTag : uint8_t {
+    NullTag,
+    ReferenceTag,
+    GroupTag,
+    PosTransformTag,
+    ScaleTransformTag,
+    AffineTransformTag,
+    ShapeTag,
+    MeshTag,
+    Vector3fArrayTag,
+    TexCoordArrayTag,
+    MaterialTag,
+    TextureTag,
+    ImageTag,
+    TextureTransformTag
+};
+
+bool getFileStamp(const filesystem::path& path, int64_t& out_size, int64_t& out_time)
+{
+    stdx::error_code ec;
+    if(!filesystem::is_regular_file(path, ec)){
+        return false;
+    }
+    out_size = filesystem::file_size(path, ec);
+    if(ec){
+        return false;
+    }
+    try {
+        out_time = filesystem::last_write_time_to_time_t(path);
+    }
+    catch(...){
+        return false;
+    }
+    return true;
+}
+
+SgNode* cloneSharedScene(SgNode* scene)
+{
+    SgNodePtr clone;
+    {
+        // The clone map holds the clone, which must be kept over the destruction of the map
+        CloneMap cloneMap;
+        SgObject::setNonNodeCloning(cloneMap, false);
+        clone = cloneMap.getClone<SgNode>(scene);
+    }
+    return clone.retn();
+}
+
+string getFilePathOfUri(const string& uri)
+{
+    if(uri.compare(0, 7, "file://") == 0){
+        return uri.substr(7);
+    } else if(uri.find("://") != string::npos){
+        return string();
+    }
+    return uri;
+}
+
+
+/**
+   The objects are written in the depth-first order and the objects shared by multiple
+   parents are written only once and referred to by the indices of the written order.
+   Only the exact classes of the scene objects generated by the mesh file loaders are
+   supported, so that the cached scene does not lose any information.
+*/
+class SceneCacheWriter
+{
+public:
+    ostream& ofs;
+    unordered_map<const SgObject*, uint32_t> objectIndexMap;
+    vector<string> dependentFiles;
+
+    SceneCacheWriter(ostream& ofs) : ofs(ofs) { }
+
+    template<class T> void write(const T& value){
+        ofs.write(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+    void writeBytes(const void* data, size_t size){
+        if(size > 0){
+            ofs.write(static_cast<const char*>(data), size);
+        }
+    }
+    void writeString(const string& str){
+        write<uint32_t>(str.size());
+        writeBytes(str.data(), str.size());
+    }
+    void writeIndexArray(const SgIndexArray& indices){
+        write<uint32_t>(indices.size());
+        writeBytes(indices.data(), sizeof(int) * indices.size());
+    }
+    bool writeObject(const SgObject* object);
+    bool writeObjectBody(const SgObject* object, const type_info& type);
+    bool writeGroupChildren(const SgGroup* group);
+    bool writeMesh(const SgMesh* mesh);
+};
+
+
+class SceneCacheReader
+{
+public:
+    ifstream& ifs;
+    vector<SgObjectPtr> objects;
+
+    SceneCacheReader(ifstream& ifs) : ifs(ifs) { }
+
+    template<class T> bool read(T& value){
+        return static_cast<bool>(ifs.read(reinterpret_cast<char*>(&value), sizeof(T)));
+    }
+    bool readBytes(void* data, size_t size){
+        return size == 0 || static_cast<bool>(ifs.read(static_cast<char*>(data), size));
+    }
+    bool readString(string& out_str){
+        uint32_t size;
+        if(!read(size)){
+            return false;
+        }
+        out_str.resize(size);
+        return readBytes(&out_str[0], size);
+    }
+    bool readIndexArray(SgIndexArray& indices){
+        uint32_t size;
+        if(!read(size)){
+            return false;
+        }
+        indices.resize(size);
+        return readBytes(indices.data(), sizeof(int) * size);
+    }
+    template<class ArrayType> bool readVectorArray(ArrayType* array){
+        uint32_t size;
+        if(!read(size)){
+            return false;
+        }
+        array->resize(size);
+        return size == 0 || readBytes(array->data(), sizeof(typename ArrayType::value_type) * size);
+    }
+    template<class T> bool readObject(ref_ptr<T>& out_object);
+    bool readObject(SgObjectPtr& out_object);
+    bool readObjectBody(uint8_t tag, SgObject* object);
+    bool readGroupChildren(SgGroup* group);
+    bool readMesh(SgMesh* mesh);
+};
+
+}
+
+
+bool SceneCacheWriter::writeObject(const SgObject* object)
+{
+    if(!object){
+        write<uint8_t>(NullTag);
+        return true;
+    }
+    auto p = objectIndexMap.find(object);
+    if(p != objectIndexMap.end()){
+        write<uint8_t>(ReferenceTag);
+        write<uint32_t>(p->second);
+        return true;
+    }
+    const uint32_t index = objectIndexMap.size();
+    objectIndexMap[object] = index;
+
+    return writeObjectBody(object, typeid(*object));
+}
+
+
+bool SceneCacheWriter::writeObjectBody(const SgObject* object, const type_info& type)
+{
+    uint8_t tag;
+    if(type == typeid(SgGroup)){
+        tag = GroupTag;
+    } else if(type == typeid(SgPosTransform)){
+        tag = PosTransformTag;
+    } else if(type == typeid(SgScaleTransform)){
+        tag = ScaleTransformTag;
+    } else if(type == typeid(SgAffineTransform)){
+        tag = AffineTransformTag;
+    } else if(type == typeid(SgShape)){
+        tag = ShapeTag;
+    } else if(type == typeid(SgMesh)){
+        tag = MeshTag;
+    } else if(type == typeid(SgVertexArray)){
+        tag = Vector3fArrayTag;
+    } else if(type == typeid(SgTexCoordArray)){
+        tag = TexCoordArrayTag;
+    } else if(type == typeid(SgMaterial)){
+        tag = MaterialTag;
+    } else if(type == typeid(SgTexture)){
+        tag = TextureTag;
+    } else if(type == typeid(SgImage)){
+        tag = ImageTag;
+    } else if(type == typeid(SgTextureTransform)){
+        tag = TextureTransformTag;
+    } else {
+        return false;
+    }
+    write(tag);
+    write<uint16_t>(object->attributes());
+    writeString(object->name());
+    writeString(object->hasUri() ? object->uri() : string());
+    writeString(object->hasAbsoluteUri() ? object->absoluteUri() : string());
+    writeString(object->hasUriFragment() ? object->uriFragment() : string());
+
+    switch(tag){
+    case GroupTag:
+        return writeGroupChildren(static_cast<const SgGroup*>(object));
+    case PosTransformTag:
+        write(static_cast<const SgPosTransform*>(object)->position());
+        return writeGroupChildren(static_cast<const SgGroup*>(object));
+    case ScaleTransformTag:
+        write(static_cast<const SgScaleTransform*>(object)->scale());
+        return writeGroupChildren(static_cast<const SgGroup*>(object));
+    case AffineTransformTag:
+        write(static_cast<const SgAffineTransform*>(object)->T());
+        return writeGroupChildren(static_cast<const SgGroup*>(object));
+    case ShapeTag: {
+        auto shape = static_cast<const SgShape*>(object);
+        return writeObject(shape->mesh()) && writeObject(shape->material()) && writeObject(shape->texture());
+    }
+    case MeshTag:
+        return writeMesh(static_cast<const SgMesh*>(object));
+    case Vector3fArrayTag: {
+        auto array = static_cast<const SgVertexArray*>(object);
+        write<uint32_t>(array->size());
+        if(!array->empty()){
+            writeBytes(array->data(), sizeof(Vector3f) * array->size());
+        }
+        return true;
+    }
+    case TexCoordArrayTag: {
+        auto array = static_cast<const SgTexCoordArray*>(object);
+        write<uint32_t>(array->size());
+        if(!array->empty()){
+            writeBytes(array->data(), sizeof(Vector2f) * array->size());
+        }
+        return true;
+    }
+    case MaterialTag: {
+        auto material = static_cast<const SgMaterial*>(object);
+        write(material->diffuseColor());
+        write(material->emissiveColor());
+        write(material->specularColor());
+        write(material->ambientIntensity());
+        write(material->specularExponent());
+        write(material->transparency());
+        return true;
+    }
+    case TextureTag: {
+        auto texture = static_cast<const SgTexture*>(object);
+        write<uint8_t>(texture->repeatS());
+        write<uint8_t>(texture->repeatT());
+        return writeObject(texture->image()) && writeObject(texture->textureTransform());
+    }
+    case ImageTag: {
+        auto image = static_cast<const SgImage*>(object);
+        if(image->hasAbsoluteUri()){
+            auto path = getFilePathOfUri(image->absoluteUri());
+            if(path.empty()){
+                return false;
+            }
+            dependentFiles.push_back(path);
+        }
+        write<int32_t>(image->width());
+        write<int32_t>(image->height());
+        write<int32_t>(image->numComponents());
+        if(!image->empty()){
+            writeBytes(image->pixels(), image->width() * image->height() * image->numComponents());
+        }
+        return true;
+    }
+    case TextureTransformTag: {
+        auto transform = static_cast<const SgTextureTransform*>(object);
+        write(transform->center());
+        write(transform->scale());
+        write(transform->translation());
+        write(transform->rotation());
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
+
+bool SceneCacheWriter::writeGroupChildren(const SgGroup* group)
+{
+    write<uint32_t>(group->numChildren());
+    for(int i=0; i < group->numChildren(); ++i){
+        if(!writeObject(group->child(i))){
+            return false;
+        }
+    }
+    return true;
+}
+
+
+bool SceneCacheWriter::writeMesh(const SgMesh* mesh)
+{
+    if(mesh->primitiveType() != SgMesh::MeshType || mesh->isTessellationPending()){
+        return false;
+    }
+    write(mesh->creaseAngle());
+    write<uint8_t>(mesh->isSolid());
+    writeIndexArray(mesh->faceVertexIndices());
+    writeIndexArray(mesh->normalIndices());
+    writeIndexArray(mesh->colorIndices());
+    writeIndexArray(mesh->texCoordIndices());
+    return
+        writeObject(mesh->vertices()) &&
+        writeObject(mesh->normals()) &&
+        writeObject(mesh->colors()) &&
+        writeObject(mesh->texCoords());
+}
+
+
+template<class T> bool SceneCacheReader::readObject(ref_ptr<T>& out_object)
+{
+    SgObjectPtr object;
+    if(!readObject(object)){
+        return false;
+    }
+    if(!object){
+        out_object = nullptr;
+        return true;
+    }
+    out_object = dynamic_cast<T*>(object.get());
+    return out_object != nullptr;
+}
+
+
+bool SceneCacheReader::readObject(SgObjectPtr& out_object)
+{
+    uint8_t tag;
+    if(!read(tag)){
+        return false;
+    }
+    if(tag == NullTag){
+        out_object = nullptr;
+        return true;
+    }
+    if(tag == ReferenceTag){
+        uint32_t index;
+        if(!read(index) || index >= objects.size()){
+            return false;
+        }
+        out_object = objects[index];
+        return true;
+    }
+
+    SgObjectPtr object;
+    switch(tag){
+    case GroupTag: object = new SgGroup; break;
+    case PosTransformTag: object = new SgPosTransform; break;
+    case ScaleTransformTag: object = new SgScaleTransform; break;
+    case AffineTransformTag: object = new SgAffineTransform; break;
+    case ShapeTag: object = new SgShape; break;
+    case MeshTag: object = new SgMesh; break;
+    case Vector3fArrayTag: object = new SgVertexArray; break;
+    case TexCoordArrayTag: object = new SgTexCoordArray; break;
+    case MaterialTag: object = new SgMaterial; break;
+    case TextureTag: object = new SgTexture; break;
+    case ImageTag: object = new SgImage; break;
+    case TextureTransformTag: object = new SgTextureTransform; break;
+    default:
+        return false;
+    }
+    objects.push_back(object);
+    
+    uint16_t attributes;
+    string name, uri, absoluteUri, fragment;
+    if(!read(attributes) || !readString(name) || !readString(uri) ||
+       !readString(absoluteUri) || !readString(fragment)){
+        return false;
+    }
+    object->setAttributes(attributes);
+    object->setName(name);
+    if(!uri.empty() || !absoluteUri.empty()){
+        object->setUri(uri, absoluteUri);
+    }
+    if(!fragment.empty()){
+        object->setUriFragment(fragment);
+    }
+    if(!readObjectBody(tag, object)){
+        return false;
+    }
+    out_object = object;
+    return true;
+}
+
+
+bool SceneCacheReader::readObjectBody(uint8_t tag, SgObject* object)
+{
+    switch(tag){
+    case GroupTag:
+        return readGroupChildren(static_cast<SgGroup*>(object));
+    case PosTransformTag: {
+        Isometry3 T;
+        if(!read(T)){
+            return false;
+        }
+        auto transform = static_cast<SgPosTransform*>(object);
+        transform->setPosition(T);
+        return readGroupChildren(transform);
+    }
+    case ScaleTransformTag: {
+        Vector3 scale;
+        if(!read(scale)){
+            return false;
+        }
+        auto transform = static_cast<SgScaleTransform*>(object);
+        transform->setScale(scale);
+        return readGroupChildren(transform);
+    }
+    case AffineTransformTag: {
+        Affine3 T;
+        if(!read(T)){
+            return false;
+        }
+        auto transform = static_cast<SgAffineTransform*>(object);
+        transform->setTransform(T);
+        return readGroupChildren(transform);
+    }
+    case ShapeTag: {
+        auto shape = static_cast<SgShape*>(object);
+        SgMeshPtr mesh;
+        SgMaterialPtr material;
+        SgTexturePtr texture;
+        if(!readObject(mesh) || !readObject(material) || !readObject(texture)){
+            return false;
+        }
+        shape->setMesh(mesh);
+        shape->setMaterial(material);
+        shape->setTexture(texture);
+        return true;
+    }
+    case MeshTag:
+        return readMesh(static_cast<SgMesh*>(object));
+    case Vector3fArrayTag:
+        return readVectorArray(static_cast<SgVertexArray*>(object));
+    case TexCoordArrayTag:
+        return readVectorArray(static_cast<SgTexCoordArray*>(object));
+    case MaterialTag: {
+        auto material = static_cast<SgMaterial*>(object);
+        Vector3f diffuseColor, emissiveColor, specularColor;
+        float ambientIntensity, specularExponent, transparency;
+        if(!read(diffuseColor) || !read(emissiveColor) || !read(specularColor) ||
+           !read(ambientIntensity) || !read(specularExponent) || !read(transparency)){
+            return false;
+        }
+        material->setDiffuseColor(diffuseColor);
+        material->setEmissiveColor(emissiveColor);
+        material->setSpecularColor(specularColor);
+        material->setAmbientIntensity(ambientIntensity);
+        material->setSpecularExponent(specularExponent);
+        material->setTransparency(transparency);
+        return true;
+    }
+    case TextureTag: {
+        auto texture = static_cast<SgTexture*>(object);
+        uint8_t repeatS, repeatT;
+        SgImagePtr image;
+        SgTextureTransformPtr textureTransform;
+        if(!read(repeatS) || !read(repeatT) || !readObject(image) || !readObject(textureTransform)){
+            return false;
+        }
+        texture->setRepeat(repeatS, repeatT);
+        texture->setImage(image);
+        texture->setTextureTransform(textureTransform);
+        return true;
+    }
+    case ImageTag: {
+        auto image = static_cast<SgImage*>(object);
+        int32_t width, height, numComponents;
+        if(!read(width) || !read(height) || !read(numComponents) ||
+           width < 0 || height < 0 || numComponents < 0){
+            return false;
+        }
+        const size_t size = static_cast<size_t>(width) * height * numComponents;
+        if(size == 0){
+            return true;
+        }
+        image->setSize(width, height, numComponents);
+        return readBytes(image->pixels(), size);
+    }
+    case TextureTransformTag: {
+        auto transform = static_cast<SgTextureTransform*>(object);
+        Vector2 center, scale, translation;
+        double rotation;
+        if(!read(center) || !read(scale) || !read(translation) || !read(rotation)){
+            return false;
+        }
+        transform->setCenter(center);
+        transform->setScale(scale);
+        transform->setTranslation(translation);
+        transform->setRotation(rotation);
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
+
+bool SceneCacheReader::readGroupChildren(SgGroup* group)
+{
+    uint32_t numChildren;
+    if(!read(numChildren)){
+        return false;
+    }
+    for(uint32_t i=0; i < numChildren; ++i){
+        SgNodePtr child;
+        if(!readObject(child) || !child){
+            return false;
+        }
+        group->addChild(child);
+    }
+    return true;
+}
+
+
+bool SceneCacheReader::readMesh(SgMesh* mesh)
+{
+    float creaseAngle;
+    uint8_t isSolid;
+    if(!read(creaseAngle) || !read(isSolid) ||
+       !readIndexArray(mesh->faceVertexIndices()) ||
+       !readIndexArray(mesh->normalIndices()) ||
+       !readIndexArray(mesh->colorIndices()) ||
+       !readIndexArray(mesh->texCoordIndices())){
+        return false;
+    }
+    mesh->setCreaseAngle(creaseAngle);
+    mesh->setSolid(isSolid);
+
+    SgVertexArrayPtr vertices;
+    SgNormalArrayPtr normals;
+    SgColorArrayPtr colors;
+    SgTexCoordArrayPtr texCoords;
+    if(!readObject(vertices) || !readObject(normals) || !readObject(colors) || !readObject(texCoords)){
+        return false;
+    }
+    mesh->setVertices(vertices);
+    mesh->setNormals(normals);
+    mesh->setColors(colors);
+    mesh->setTexCoords(texCoords);
+
+    const int numVertices = vertices ? vertices->size() : 0;
+    for(auto& index : mesh->faceVertexIndices()){
+        if(index < 0 || index >= numVertices){
+            return false;
+        }
+    }
+    mesh->updateBoundingBox();
+    return true;
 }
 
 namespace cnoid {
@@ -38,10 +617,17 @@ public:
     LoaderMap loaders;
     int defaultDivisionNumber;
     double defaultCreaseAngle;
+    bool isSceneSharingEnabled;
 
     Impl();
     AbstractSceneLoaderPtr findLoader(string ext);
     SgNode* load(const std::string& filename, bool* out_isSupportedFormat);
+    bool getSceneKey(const stdx::filesystem::path& filepath, string& out_key);
+    SgNode* findSharedScene(const string& key, int64_t fileSize, int64_t fileTime);
+    SgNode* shareScene(const string& key, int64_t fileSize, int64_t fileTime, SgNode* scene);
+    string getCacheFilename(const stdx::filesystem::path& filepath, string& out_key);
+    SgNode* loadCache(const string& cacheFilename, const string& key);
+    void saveCache(const string& cacheFilename, const string& key, const string& filename, SgNode* node);
 };
 
 }
@@ -92,6 +678,41 @@ SignalProxy<void(const std::vector<std::string>& extensions)> SceneLoader::sigAv
 }
 
 
+void SceneLoader::setCacheDirectory(const std::string& directory)
+{
+    lock_guard<mutex> lock(cacheDirectoryMutex);
+    cacheDirectory_ = directory;
+}
+
+
+std::string SceneLoader::cacheDirectory()
+{
+    lock_guard<mutex> lock(cacheDirectoryMutex);
+    return cacheDirectory_;
+}
+
+
+std::string SceneLoader::defaultCacheDirectory()
+{
+    filesystem::path path;
+#ifdef _WIN32
+    if(auto appdata = getenv("LOCALAPPDATA")){
+        path = filesystem::path(appdata) / "Choreonoid" / "cache";
+    }
+#else
+    if(auto cache = getenv("XDG_CACHE_HOME")){
+        path = filesystem::path(cache) / "choreonoid";
+    } else if(auto home = getenv("HOME")){
+        path = filesystem::path(home) / ".cache" / "choreonoid";
+    }
+#endif
+    if(path.empty()){
+        return string();
+    }
+    return toUTF8((path / "scene").string());
+}
+
+
 SceneLoader::SceneLoader()
 {
     impl = new Impl;
@@ -103,6 +724,7 @@ SceneLoader::Impl::Impl()
     os_ = &nullout();
     defaultDivisionNumber = -1;
     defaultCreaseAngle = -1.0;
+    isSceneSharingEnabled = false;
 }
 
 
@@ -118,6 +740,28 @@ void SceneLoader::setMessageSink(std::ostream& os)
 }
 
 
+void SceneLoader::setSceneSharingEnabled(bool on)
+{
+    impl->isSceneSharingEnabled = on;
+}
+
+
+void SceneLoader::clearSharedScenes()
+{
+    {
+        lock_guard<mutex> lock(sharedSceneMutex);
+        sharedScenes.clear();
+    }
+    sigSharedScenesCleared_();
+}
+
+
+SignalProxy<void()> SceneLoader::sigSharedScenesCleared()
+{
+    return sigSharedScenesCleared_;
+}
+
+
 void SceneLoader::setDefaultDivisionNumber(int n)
 {
     impl->defaultDivisionNumber = n;
@@ -169,6 +813,8 @@ SgNode* SceneLoader::load(const std::string& filename, bool& out_isSupportedForm
 
 SgNode* SceneLoader::Impl::load(const std::string& filename, bool* out_isSupportedFormat)
 {
+    CNOID_TRACE_ZONE("Scene loading", "Loading");
+
     stdx::filesystem::path filepath(fromUTF8(filename));
 
     string ext = filepath.extension().string();
@@ -197,9 +843,188 @@ SgNode* SceneLoader::Impl::load(const std::string& filename, bool* out_isSupport
         if(defaultCreaseAngle >= 0.0){
             loader->setDefaultCreaseAngle(defaultCreaseAngle);
         }
-        node = loader->load(filename);
+
+        string sharingKey;
+        int64_t fileSize, fileTime;
+        if(isSceneSharingEnabled && getSceneKey(filepath, sharingKey)){
+            if(!getFileStamp(filepath, fileSize, fileTime)){
+                sharingKey.clear();
+            } else if((node = findSharedScene(sharingKey, fileSize, fileTime))){
+                return node;
+            }
+        }
+
+        string cacheFilename, cacheKey;
+        if(loader->isCacheable()){
+            cacheFilename = getCacheFilename(filepath, cacheKey);
+            if(!cacheFilename.empty()){
+                node = loadCache(cacheFilename, cacheKey);
+            }
+        }
+        if(!node){
+            node = loader->load(filename);
+            if(node && !cacheFilename.empty()){
+                saveCache(cacheFilename, cacheKey, filename, node);
+            }
+        }
+        if(node && !sharingKey.empty()){
+            node = shareScene(sharingKey, fileSize, fileTime, node);
+        }
         os().flush();
     }
 
     return node;
 }
+
+
+bool SceneLoader::Impl::getSceneKey(const stdx::filesystem::path& filepath, string& out_key)
+{
+    stdx::error_code ec;
+    auto absolutePath = filesystem::absolute(filepath, ec);
+    if(ec){
+        return false;
+    }
+    // The URIs of the loaded objects depend on the given file path
+    out_key = fmt::format("{}\n{}\n{}\n{}",
+                          toUTF8(filesystem::lexically_normal(absolutePath).string()),
+                          toUTF8(filepath.string()), defaultDivisionNumber, defaultCreaseAngle);
+    return true;
+}
+
+
+SgNode* SceneLoader::Impl::findSharedScene(const string& key, int64_t fileSize, int64_t fileTime)
+{
+    lock_guard<mutex> lock(sharedSceneMutex);
+    auto p = sharedScenes.find(key);
+    if(p == sharedScenes.end()){
+        return nullptr;
+    }
+    auto& shared = p->second;
+    if(shared.fileSize != fileSize || shared.fileTime != fileTime){
+        sharedScenes.erase(p);
+        return nullptr;
+    }
+    return cloneSharedScene(shared.scene);
+}
+
+
+/**
+   The loaded scene is kept and its copy is returned so that the kept scene is not modified
+   by the caller. The nodes of the copy are different objects but the meshes, materials and
+   textures are shared with the kept scene.
+*/
+SgNode* SceneLoader::Impl::shareScene(const string& key, int64_t fileSize, int64_t fileTime, SgNode* scene)
+{
+    lock_guard<mutex> lock(sharedSceneMutex);
+    auto& shared = sharedScenes[key];
+    shared.scene = scene;
+    shared.fileSize = fileSize;
+    shared.fileTime = fileTime;
+    return cloneSharedScene(scene);
+}
+
+
+string SceneLoader::Impl::getCacheFilename(const stdx::filesystem::path& filepath, string& out_key)
+{
+    auto directory = SceneLoader::cacheDirectory();
+    if(directory.empty() || !getSceneKey(filepath, out_key)){
+        return string();
+    }
+
+    //! FNV-1a
+    uint64_t hash = 14695981039346656037ULL;
+    for(auto c : out_key){
+        hash = (hash ^ static_cast<unsigned char>(c)) * 1099511628211ULL;
+    }
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.bin", static_cast<unsigned long long>(hash));
+    return toUTF8((filesystem::path(fromUTF8(directory)) / name).string());
+}
+
+
+SgNode* SceneLoader::Impl::loadCache(const string& cacheFilename, const string& key)
+{
+    ifstream ifs(fromUTF8(cacheFilename), ios::binary);
+    if(!ifs){
+        return nullptr;
+    }
+    SceneCacheReader reader(ifs);
+    uint32_t magic, version, numFiles;
+    string storedKey;
+    if(!reader.read(magic) || magic != CacheFileMagic || !reader.read(version) || version != CacheFileVersion ||
+       !reader.readString(storedKey) || storedKey != key || !reader.read(numFiles)){
+        return nullptr;
+    }
+    // The cache is valid only when the source file and the image files are not modified
+    for(uint32_t i=0; i < numFiles; ++i){
+        string file;
+        int64_t size, time, currentSize, currentTime;
+        if(!reader.readString(file) || !reader.read(size) || !reader.read(time) ||
+           !getFileStamp(fromUTF8(file), currentSize, currentTime) ||
+           currentSize != size || currentTime != time){
+            return nullptr;
+        }
+    }
+    SgNodePtr node;
+    if(!reader.readObject(node) || !node){
+        return nullptr;
+    }
+    reader.objects.clear();
+    return node.retn();
+}
+
+
+void SceneLoader::Impl::saveCache
+(const string& cacheFilename, const string& key, const string& filename, SgNode* node)
+{
+    filesystem::path path(fromUTF8(cacheFilename));
+    stdx::error_code ec;
+    filesystem::create_directories(path.parent_path(), ec);
+
+    // The objects are written first because the image files depended on are found in writing them
+    ostringstream objectData;
+    SceneCacheWriter objectWriter(objectData);
+    if(!objectWriter.writeObject(node)){
+        return;
+    }
+    vector<string> files;
+    files.push_back(toUTF8(filesystem::absolute(fromUTF8(filename), ec).string()));
+    files.insert(files.end(), objectWriter.dependentFiles.begin(), objectWriter.dependentFiles.end());
+
+    // A temporary file is renamed so that the other processes do not read a partial file
+    filesystem::path tmpPath(path);
+    tmpPath += ".tmp";
+    {
+        ofstream ofs(tmpPath.string(), ios::binary);
+        if(!ofs){
+            return;
+        }
+        SceneCacheWriter writer(ofs);
+        writer.write(CacheFileMagic);
+        writer.write(CacheFileVersion);
+        writer.writeString(key);
+        writer.write<uint32_t>(files.size());
+        for(auto& file : files){
+            int64_t size, time;
+            if(!getFileStamp(fromUTF8(file), size, time)){
+                ofs.close();
+                filesystem::remove(tmpPath, ec);
+                return;
+            }
+            writer.writeString(file);
+            writer.write(size);
+            writer.write(time);
+        }
+        auto data = objectData.str();
+        writer.writeBytes(data.data(), data.size());
+        if(!ofs){
+            ofs.close();
+            filesystem::remove(tmpPath, ec);
+            return;
+        }
+    }
+    filesystem::rename(tmpPath, path, ec);
+    if(ec){
+        filesystem::remove(tmpPath, ec);
+    }
+}
@@ -26,8 +26,35 @@ public:
     static std::vector<std::string> availableFileExtensions();
     static SignalProxy<void(const std::vector<std::string>& extensions)> sigAvailableFileExtensionsAdded();
 
+    /**
+       When the cache directory is specified, the scenes loaded by the loaders whose isCacheable
+       functions return true are stored in the directory in a binary format, and they are read
+       from it instead of the original files while the files and their image files are not
+       modified. The cache is disabled when the directory is empty, which is the default.
+    */
+    static void setCacheDirectory(const std::string& directory);
+    static std::string cacheDirectory();
+    static std::string defaultCacheDirectory();
+
     SceneLoader();
     virtual ~SceneLoader();
+
+    /**
+       When the scene sharing is enabled, the scene loaded from a file is kept in the memory and
+       it is used for the following loads of the same file by the scene loaders enabling the
+       sharing while the file is not modified. The nodes of the scene are created for each load,
+       and the meshes, materials and textures are shared among the loaded scenes. Since the shared
+       objects must not be modified, the sharing is disabled by default.
+    */
+    void setSceneSharingEnabled(bool on);
+    static void clearSharedScenes();
+
+    /**
+       This signal is emitted by clearSharedScenes() so that the loaders keeping their own data
+       shared between the loads, such as the parsed model files, can release it together.
+    */
+    static SignalProxy<void()> sigSharedScenesCleared();
+    
     virtual void setMessageSink(std::ostream& os) override;
     virtual void setDefaultDivisionNumber(int n) override;
     virtual void setDefaultCreaseAngle(double theta) override;
@@ -7,6 +7,16 @@
 #include "PolymorphicSceneNodeFunctionSet.h"
 #include "CloneMap.h"
 #include "EigenUtil.h"
+#include <fmt/format.h>
+#include <unordered_set>
+#include <unordered_map>
+#include <typeindex>
+#include <algorithm>
+#include <ostream>
+#include <cstdlib>
+#ifdef __GNUC__
+#include <cxxabi.h>
+#endif
 
 using namespace std;
 using namespace cnoid;
@@ -159,3 +169,409 @@ int cnoid::makeTransparent(SgNode* topNode, float transparency, CloneMap& cloneM
     }
     return 0;
 }
+
+
+namespace cnoid {
+
+class SceneGeometryMemoryCounter::Impl : public PolymorphicSceneNodeFunctionSet
+{
+public:
+    unordered_set<const void*> countedData;
+    size_t referredBytes;
+    size_t allocatedBytes;
+
+    Impl();
+    void clear();
+    void countData(const void* id, size_t bytes);
+    template<class ArrayType> void countArray(const ArrayType* array);
+    void countIndices(const SgIndexArray& indices);
+    void visitGroup(SgGroup* group);
+    void visitShape(SgShape* shape);
+    void visitPlot(SgPlot* plot);
+};
+
+}
+
+
+SceneGeometryMemoryCounter::SceneGeometryMemoryCounter()
+{
+    impl = new Impl;
+}
+
+
+SceneGeometryMemoryCounter::Impl::Impl()
+{
+    setFunction<SgGroup>(
+        [&](SgGroup* node){ visitGroup(node); });
+    setFunction<SgShape>(
+        [&](SgShape* node){ visitShape(node); });
+    setFunction<SgPlot>(
+        [&](SgPlot* node){ visitPlot(node); });
+    updateDispatchTable();
+
+    clear();
+}
+
+
+SceneGeometryMemoryCounter::~SceneGeometryMemoryCounter()
+{
+    delete impl;
+}
+
+
+void SceneGeometryMemoryCounter::clear()
+{
+    impl->clear();
+}
+
+
+void SceneGeometryMemoryCounter::Impl::clear()
+{
+    countedData.clear();
+    referredBytes = 0;
+    allocatedBytes = 0;
+}
+
+
+size_t SceneGeometryMemoryCounter::referredBytes() const
+{
+    return impl->referredBytes;
+}
+
+
+size_t SceneGeometryMemoryCounter::allocatedBytes() const
+{
+    return impl->allocatedBytes;
+}
+
+
+void SceneGeometryMemoryCounter::count(SgNode* scene)
+{
+    if(scene){
+        impl->dispatch(scene);
+    }
+}
+
+
+void SceneGeometryMemoryCounter::Impl::countData(const void* id, size_t bytes)
+{
+    if(bytes > 0){
+        referredBytes += bytes;
+        if(countedData.insert(id).second){
+            allocatedBytes += bytes;
+        }
+    }
+}
+
+
+template<class ArrayType>
+void SceneGeometryMemoryCounter::Impl::countArray(const ArrayType* array)
+{
+    if(array){
+        countData(array->dataId(), array->dataBytes());
+    }
+}
+
+
+void SceneGeometryMemoryCounter::Impl::countIndices(const SgIndexArray& indices)
+{
+    // The copies sharing the indices refer to the same array object
+    countData(&indices, indices.capacity() * sizeof(int));
+}
+
+
+void SceneGeometryMemoryCounter::Impl::visitGroup(SgGroup* group)
+{
+    for(auto& child : *group){
+        dispatch(child);
+    }
+}
+
+
+void SceneGeometryMemoryCounter::Impl::visitShape(SgShape* shape)
+{
+    if(const SgMesh* mesh = shape->mesh()){
+        countArray(mesh->vertices());
+        countArray(mesh->normals());
+        countArray(mesh->colors());
+        countArray(mesh->texCoords());
+        countIndices(mesh->faceVertexIndices());
+        countIndices(mesh->normalIndices());
+        countIndices(mesh->colorIndices());
+        countIndices(mesh->texCoordIndices());
+    }
+    if(auto texture = shape->texture()){
+        if(auto image = texture->image()){
+            auto& data = image->constImage();
+            countData(&data, size_t(data.width()) * data.height() * data.numComponents());
+        }
+    }
+}
+
+
+void SceneGeometryMemoryCounter::Impl::visitPlot(SgPlot* plot)
+{
+    const SgPlot* constPlot = plot;
+    countArray(constPlot->vertices());
+    countArray(constPlot->normals());
+    countArray(constPlot->colors());
+    countIndices(constPlot->normalIndices());
+    countIndices(constPlot->colorIndices());
+}
+
+
+namespace {
+
+struct KnownClass
+{
+    std::type_index type;
+    size_t size;
+    bool (*isInstance)(const SgObject* object);
+};
+
+template<class ObjectType>
+KnownClass knownClass()
+{
+    return { typeid(ObjectType), sizeof(ObjectType),
+             [](const SgObject* object){ return dynamic_cast<const ObjectType*>(object) != nullptr; } };
+}
+
+// A sub class must precede its super classes
+const vector<KnownClass>& getKnownClasses()
+{
+    static vector<KnownClass> classes = {
+        knownClass<SgPosTransform>(),
+        knownClass<SgScaleTransform>(),
+        knownClass<SgAffineTransform>(),
+        knownClass<SgTransform>(),
+        knownClass<SgInvariantGroup>(),
+        knownClass<SgFixedPixelSizeGroup>(),
+        knownClass<SgSwitchableGroup>(),
+        knownClass<SgUnpickableGroup>(),
+        knownClass<SgLOD>(),
+        knownClass<SgViewportOverlay>(),
+        knownClass<SgOverlay>(),
+        knownClass<SgGroup>(),
+        knownClass<SgShape>(),
+        knownClass<SgPointSet>(),
+        knownClass<SgLineSet>(),
+        knownClass<SgPlot>(),
+        knownClass<SgPreprocessed>(),
+        knownClass<SgNode>(),
+        knownClass<SgMesh>(),
+        knownClass<SgPolygonMesh>(),
+        knownClass<SgMeshBase>(),
+        knownClass<SgVertexArray>(),
+        knownClass<SgTexCoordArray>(),
+        knownClass<SgMaterial>(),
+        knownClass<SgTexture>(),
+        knownClass<SgTextureTransform>(),
+        knownClass<SgImage>(),
+        knownClass<SgSwitch>(),
+        knownClass<SgObject>()
+    };
+    return classes;
+}
+
+string getClassName(const std::type_info& type)
+{
+    string name;
+#ifdef __GNUC__
+    int status;
+    char* demangled = abi::__cxa_demangle(type.name(), nullptr, nullptr, &status);
+    if(demangled){
+        name = demangled;
+        free(demangled);
+    }
+#endif
+    if(name.empty()){
+        name = type.name();
+    }
+    return name;
+}
+
+}
+
+namespace cnoid {
+
+class SceneObjectMemoryCounter::Impl
+{
+public:
+    unordered_set<SgObject*> countedObjects;
+
+    struct ClassCounter
+    {
+        ClassInfo info;
+        size_t objectSize;
+    };
+    unordered_map<std::type_index, ClassCounter> classCounters;
+
+    int numObjects;
+    size_t objectBytes;
+    size_t memberBytes;
+    SceneGeometryMemoryCounter geometryMemoryCounter;
+
+    Impl();
+    void clear();
+    void count(SgObject* object);
+    ClassCounter& getClassCounter(SgObject* object);
+};
+
+}
+
+
+SceneObjectMemoryCounter::SceneObjectMemoryCounter()
+{
+    impl = new Impl;
+}
+
+
+SceneObjectMemoryCounter::Impl::Impl()
+{
+    clear();
+}
+
+
+SceneObjectMemoryCounter::~SceneObjectMemoryCounter()
+{
+    delete impl;
+}
+
+
+void SceneObjectMemoryCounter::clear()
+{
+    impl->clear();
+}
+
+
+void SceneObjectMemoryCounter::Impl::clear()
+{
+    countedObjects.clear();
+    classCounters.clear();
+    numObjects = 0;
+    objectBytes = 0;
+    memberBytes = 0;
+    geometryMemoryCounter.clear();
+}
+
+
+void SceneObjectMemoryCounter::count(SgObject* object)
+{
+    if(object){
+        impl->count(object);
+        if(auto node = object->toNode()){
+            impl->geometryMemoryCounter.count(node);
+        }
+    }
+}
+
+
+void SceneObjectMemoryCounter::Impl::count(SgObject* object)
+{
+    if(!countedObjects.insert(object).second){
+        return;
+    }
+
+    auto& counter = getClassCounter(object);
+    size_t bytes = object->auxiliaryDataBytes();
+    if(auto group = object->toGroupNode()){
+        bytes += group->numChildren() * sizeof(SgNodePtr);
+    }
+    auto& info = counter.info;
+    ++info.numObjects;
+    info.objectBytes += counter.objectSize;
+    info.memberBytes += bytes;
+    ++numObjects;
+    objectBytes += counter.objectSize;
+    memberBytes += bytes;
+
+    const int n = object->numChildObjects();
+    for(int i=0; i < n; ++i){
+        if(auto child = object->childObject(i)){
+            count(child);
+        }
+    }
+}
+
+
+SceneObjectMemoryCounter::Impl::ClassCounter&
+SceneObjectMemoryCounter::Impl::getClassCounter(SgObject* object)
+{
+    const std::type_info& type = typeid(*object);
+    auto inserted = classCounters.emplace(std::type_index(type), ClassCounter());
+    auto& counter = inserted.first->second;
+    if(inserted.second){
+        auto& info = counter.info;
+        info.className = getClassName(type);
+        info.numObjects = 0;
+        info.objectBytes = 0;
+        info.memberBytes = 0;
+        info.isObjectSizeLowerBound = true;
+        counter.objectSize = sizeof(SgObject);
+        for(auto& known : getKnownClasses()){
+            if(known.isInstance(object)){
+                counter.objectSize = known.size;
+                info.isObjectSizeLowerBound = (known.type != std::type_index(type));
+                break;
+            }
+        }
+    }
+    return counter;
+}
+
+
+std::vector<SceneObjectMemoryCounter::ClassInfo> SceneObjectMemoryCounter::classInfos() const
+{
+    vector<ClassInfo> infos;
+    infos.reserve(impl->classCounters.size());
+    for(auto& kv : impl->classCounters){
+        infos.push_back(kv.second.info);
+    }
+    std::sort(infos.begin(), infos.end(),
+              [](const ClassInfo& info1, const ClassInfo& info2){
+                  return (info1.objectBytes + info1.memberBytes) > (info2.objectBytes + info2.memberBytes);
+              });
+    return infos;
+}
+
+
+int SceneObjectMemoryCounter::numObjects() const
+{
+    return impl->numObjects;
+}
+
+
+size_t SceneObjectMemoryCounter::objectBytes() const
+{
+    return impl->objectBytes;
+}
+
+
+size_t SceneObjectMemoryCounter::memberBytes() const
+{
+    return impl->memberBytes;
+}
+
+
+const SceneGeometryMemoryCounter& SceneObjectMemoryCounter::geometryMemoryCounter() const
+{
+    return impl->geometryMemoryCounter;
+}
+
+
+void SceneObjectMemoryCounter::putReport(std::ostream& os) const
+{
+    // The class names are put at the end of the lines because some of them are long
+    os << fmt::format("{:>10} {:>14} {:>14}  {}\n", "Objects", "Object bytes", "Member bytes", "Class");
+    for(auto& info : classInfos()){
+        os << fmt::format("{:>10} {:>13}{} {:>14}  {}\n",
+                          info.numObjects, info.objectBytes, info.isObjectSizeLowerBound ? "+" : " ",
+                          info.memberBytes, info.className);
+    }
+    os << fmt::format("{:>10} {:>14} {:>14}  {}\n",
+                      impl->numObjects, impl->objectBytes, impl->memberBytes, "Total");
+    auto& geometry = impl->geometryMemoryCounter;
+    os << fmt::format("Geometry data: {} bytes allocated, {} bytes referred\n",
+                      geometry.allocatedBytes(), geometry.referredBytes());
+    os << "(+: counted with the size of a super class)" << std::endl;
+}
@@ -6,6 +6,9 @@
 #define CNOID_UTIL_SCENE_UTIL_H
 
 #include "SceneGraph.h"
+#include <vector>
+#include <string>
+#include <iosfwd>
 #include "exportdecl.h"
 
 namespace cnoid {
@@ -19,6 +22,79 @@ CNOID_EXPORT Isometry3 calcRelativePosition(SgNodePath::const_iterator begin, Sg
 
 CNOID_EXPORT int makeTransparent(SgNode* topNode, float transparency, CloneMap& cloneMap, bool doKeepOrgTransparency = true);
 
+/**
+   This class accumulates the memory size of the geometry data (vertices, normals, colors,
+   texture coordinates, indices and texture images) referred by scenes. The data shared by
+   copy-on-write among the cloned scenes is counted once as the allocated data.
+*/
+class CNOID_EXPORT SceneGeometryMemoryCounter
+{
+public:
+    SceneGeometryMemoryCounter();
+    ~SceneGeometryMemoryCounter();
+
+    SceneGeometryMemoryCounter(const SceneGeometryMemoryCounter&) = delete;
+    SceneGeometryMemoryCounter& operator=(const SceneGeometryMemoryCounter&) = delete;
+
+    void count(SgNode* scene);
+    void clear();
+
+    //! The total bytes of the data referred by the counted scenes
+    size_t referredBytes() const;
+    //! The bytes of the data actually allocated for the counted scenes
+    size_t allocatedBytes() const;
+
+private:
+    class Impl;
+    Impl* impl;
+};
+
+/**
+   This class counts the scene objects for each class and reports the memory consumed by them.
+   An object shared by several paths is counted once. The sizes of the classes defined in the
+   Util module are known, and the objects of the other classes are counted with the size of
+   their nearest known super class. The geometry data of the counted nodes are also counted
+   by SceneGeometryMemoryCounter.
+*/
+class CNOID_EXPORT SceneObjectMemoryCounter
+{
+public:
+    SceneObjectMemoryCounter();
+    ~SceneObjectMemoryCounter();
+
+    SceneObjectMemoryCounter(const SceneObjectMemoryCounter&) = delete;
+    SceneObjectMemoryCounter& operator=(const SceneObjectMemoryCounter&) = delete;
+
+    void count(SgObject* object);
+    void clear();
+
+    struct ClassInfo
+    {
+        std::string className;
+        int numObjects;
+        //! The total size of the objects themselves
+        size_t objectBytes;
+        //! The heap memory allocated for the members such as the parents, children, signals and name
+        size_t memberBytes;
+        //! True if the objects are counted with the size of a super class
+        bool isObjectSizeLowerBound;
+    };
+
+    //! \return The information sorted in the descending order of the total bytes
+    std::vector<ClassInfo> classInfos() const;
+
+    int numObjects() const;
+    size_t objectBytes() const;
+    size_t memberBytes() const;
+    const SceneGeometryMemoryCounter& geometryMemoryCounter() const;
+
+    void putReport(std::ostream& os) const;
+
+private:
+    class Impl;
+    Impl* impl;
+};
+
 }
 
 #endif
@@ -0,0 +1,160 @@
+#ifndef CNOID_UTIL_SHARED_DATA_CHANNEL_H
+#define CNOID_UTIL_SHARED_DATA_CHANNEL_H
+
+#include "Referenced.h"
+#include <atomic>
+#include <cstdint>
+
+namespace cnoid {
+
+/**
+   This class passes the latest value of type T from a publisher to subscribers without locking and
+   copying the value. The publisher writes a value in the buffer given by writeBuffer() and publishes
+   it by publish(). Each subscriber obtains the latest published value by Subscriber::update() and
+   refers to it by Subscriber::value() until the next update.
+
+   The channel has a slot for each subscriber in addition to the slots of the latest value and
+   the value being written, and the slot referred to by a subscriber is never written by the
+   publisher. Therefore the publisher never waits for the subscribers and a subscriber always
+   sees a consistent value. The buffer given by writeBuffer() contains an older value, which must
+   be overwritten by the publisher.
+
+   \note A channel can have only one publisher.
+*/
+template<class T, int MaxNumSubscribers = 4>
+class SharedDataChannel : public Referenced
+{
+public:
+    SharedDataChannel()
+        : latestIndex(0),
+          numSubscribers_(0)
+    {
+        for(auto& slot : slots){
+            slot.numReferences.store(0);
+            slot.version = 0;
+        }
+        writeIndex = 1;
+        publishCounter = 0;
+    }
+
+    SharedDataChannel(const SharedDataChannel&) = delete;
+    SharedDataChannel& operator=(const SharedDataChannel&) = delete;
+
+    T& writeBuffer() { return slots[writeIndex].value; }
+
+    //! \return The version number of the published value, which starts from one
+    uint64_t publish() {
+        Slot& slot = slots[writeIndex];
+        slot.version = ++publishCounter;
+        latestIndex.store(writeIndex);
+
+        // Find a slot which is neither the latest one nor referred to by any subscriber
+        int index = writeIndex;
+        do {
+            index = (index + 1) % NumSlots;
+        } while(index == writeIndex || slots[index].numReferences.load() > 0);
+        writeIndex = index;
+
+        return slot.version;
+    }
+
+    uint64_t latestVersion() const { return slots[latestIndex.load()].version; }
+    int numSubscribers() const { return numSubscribers_.load(); }
+
+    class Subscriber
+    {
+    public:
+        Subscriber() : index(-1), version_(0) { }
+        Subscriber(const Subscriber&) = delete;
+        Subscriber& operator=(const Subscriber&) = delete;
+        ~Subscriber() { unsubscribe(); }
+
+        /**
+           This function should be called when the controller is initialized.
+           \return false if the channel already has the maximum number of subscribers
+        */
+        bool subscribe(SharedDataChannel* channel) {
+            unsubscribe();
+            if(++channel->numSubscribers_ > MaxNumSubscribers){
+                --channel->numSubscribers_;
+                return false;
+            }
+            this->channel = channel;
+            return true;
+        }
+
+        void unsubscribe() {
+            if(channel){
+                release();
+                --channel->numSubscribers_;
+                channel.reset();
+            }
+            version_ = 0;
+        }
+
+        bool isSubscribed() const { return channel != nullptr; }
+
+        /**
+           @return true if a value newer than the current one has been published
+        */
+        bool update() {
+            const int latest = channel->latestIndex.load();
+            if(latest == index){
+                return false;
+            }
+            release();
+            while(true){
+                int i = channel->latestIndex.load();
+                auto& numReferences = channel->slots[i].numReferences;
+                ++numReferences;
+                if(channel->latestIndex.load() == i){
+                    index = i;
+                    break;
+                }
+                --numReferences;
+            }
+            uint64_t version = channel->slots[index].version;
+            bool isUpdated = (version != version_);
+            version_ = version;
+            return isUpdated;
+        }
+
+        //! The value is valid after update() returns true at least once.
+        const T& value() const { return channel->slots[index].value; }
+
+        //! Zero is returned if no value has been obtained.
+        uint64_t version() const { return version_; }
+
+    private:
+        ref_ptr<SharedDataChannel> channel;
+        int index;
+        uint64_t version_;
+
+        void release() {
+            if(index >= 0){
+                --channel->slots[index].numReferences;
+                index = -1;
+            }
+        }
+    };
+
+private:
+    enum { NumSlots = MaxNumSubscribers + 2 };
+
+    struct Slot
+    {
+        T value;
+        std::atomic<int> numReferences;
+        uint64_t version;
+    };
+
+    Slot slots[NumSlots];
+    std::atomic<int> latestIndex;
+    std::atomic<int> numSubscribers_;
+    int writeIndex;
+    uint64_t publishCounter;
+};
+
+}
+
+#endif
@@ -0,0 +1,410 @@
+#include "SharedMemoryFrameRing.h"
+#include <fmt/format.h>
+#include <atomic>
+#include <cstring>
+#include <new>
+#include <ostream>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+#include "gettext.h"
+
+using namespace std;
+using namespace cnoid;
+using fmt::format;
+
+namespace {
+
+const char Magic[8] = { 'C', 'N', 'O', 'I', 'D', 'S', 'F', 'R' };
+const uint32_t Version = 1;
+const size_t Alignment = 64;
+
+struct alignas(64) RegionHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t numSlots;
+    uint64_t slotCapacity;
+    uint64_t slotStride;
+    std::atomic<uint64_t> latestFrameNumber;
+};
+
+/**
+   The sequence number is (frameNumber * 2 - 1) while the frame is being written and
+   (frameNumber * 2) after the frame is written.
+*/
+struct alignas(64) SlotHeader
+{
+    std::atomic<uint64_t> sequence;
+    SharedMemoryFrameRing::FrameInfo info;
+};
+
+static_assert(sizeof(RegionHeader) % Alignment == 0, "RegionHeader must be aligned");
+static_assert(sizeof(SlotHeader) % Alignment == 0, "SlotHeader must be aligned");
+
+size_t alignSize(size_t size)
+{
+    return (size + Alignment - 1) / Alignment * Alignment;
+}
+
+string getSystemName(const string& name)
+{
+#ifdef _WIN32
+    if(!name.empty() && name[0] == '/'){
+        return name.substr(1);
+    }
+    return name;
+#else
+    if(!name.empty() && name[0] == '/'){
+        return name;
+    }
+    return string("/") + name;
+#endif
+}
+
+}
+
+namespace cnoid {
+
+class SharedMemoryFrameRing::Impl
+{
+public:
+    string name;
+    bool isWriter;
+    unsigned char* region;
+    size_t regionSize;
+    RegionHeader* header;
+#ifdef _WIN32
+    HANDLE mappingHandle;
+#endif
+
+    Impl();
+    bool create(const string& name, int numSlots, size_t slotCapacity, ostream& os);
+    bool open(const string& name, ostream& os);
+    void close();
+    SlotHeader* slot(uint64_t frameNumber) const {
+        return reinterpret_cast<SlotHeader*>(
+            region + sizeof(RegionHeader) + ((frameNumber - 1) % header->numSlots) * header->slotStride);
+    }
+    unsigned char* data(SlotHeader* slot) const {
+        return reinterpret_cast<unsigned char*>(slot) + sizeof(SlotHeader);
+    }
+};
+
+}
+
+
+SharedMemoryFrameRing::SharedMemoryFrameRing()
+{
+    impl = new Impl;
+}
+
+
+SharedMemoryFrameRing::Impl::Impl()
+{
+    isWriter = false;
+    region = nullptr;
+    regionSize = 0;
+    header = nullptr;
+#ifdef _WIN32
+    mappingHandle = nullptr;
+#endif
+}
+
+
+SharedMemoryFrameRing::~SharedMemoryFrameRing()
+{
+    impl->close();
+    delete impl;
+}
+
+
+bool SharedMemoryFrameRing::create(const std::string& name, int numSlots, size_t slotCapacity, std::ostream& os)
+{
+    return impl->create(name, numSlots, slotCapacity, os);
+}
+
+
+bool SharedMemoryFrameRing::Impl::create(const string& name, int numSlots, size_t slotCapacity, ostream& os)
+{
+    close();
+
+    if(numSlots < 2){
+        os << format(_("The shared memory \"{0}\" must have two slots at least."), name) << endl;
+        return false;
+    }
+
+    const size_t slotStride = sizeof(SlotHeader) + alignSize(slotCapacity);
+    const size_t size = sizeof(RegionHeader) + slotStride * numSlots;
+    const string systemName = getSystemName(name);
+
+#ifdef _WIN32
+    mappingHandle = CreateFileMappingA(
+        INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+        static_cast<DWORD>(static_cast<uint64_t>(size) >> 32), static_cast<DWORD>(size & 0xffffffff),
+        systemName.c_str());
+    if(!mappingHandle){
+        os << format(_("The shared memory \"{0}\" cannot be created."), name) << endl;
+        return false;
+    }
+    auto p = MapViewOfFile(mappingHandle, FILE_MAP_ALL_ACCESS, 0, 0, size);
+    if(!p){
+        os << format(_("The shared memory \"{0}\" cannot be mapped."), name) << endl;
+        CloseHandle(mappingHandle);
+        mappingHandle = nullptr;
+        return false;
+    }
+#else
+    shm_unlink(systemName.c_str());
+    int fd = shm_open(systemName.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+    if(fd < 0){
+        os << format(_("The shared memory \"{0}\" cannot be created: {1}"), name, strerror(errno)) << endl;
+        return false;
+    }
+    if(ftruncate(fd, size) != 0){
+        os << format(_("The shared memory \"{0}\" cannot be resized: {1}"), name, strerror(errno)) << endl;
+        ::close(fd);
+        shm_unlink(systemName.c_str());
+        return false;
+    }
+    auto p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if(p == MAP_FAILED){
+        os << format(_("The shared memory \"{0}\" cannot be mapped: {1}"), name, strerror(errno)) << endl;
+        shm_unlink(systemName.c_str());
+        return false;
+    }
+#endif
+
+    region = static_cast<unsigned char*>(p);
+    regionSize = size;
+    this->name = name;
+    isWriter = true;
+
+    header = new(region) RegionHeader;
+    header->version = Version;
+    header->numSlots = numSlots;
+    header->slotCapacity = slotCapacity;
+    header->slotStride = slotStride;
+    header->latestFrameNumber.store(0);
+    for(int i=0; i < numSlots; ++i){
+        new(region + sizeof(RegionHeader) + i * slotStride) SlotHeader;
+        slot(i + 1)->sequence.store(0);
+    }
+    // The magic number is written last to tell readers that the region is initialized
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(header->magic, Magic, sizeof(Magic));
+
+    return true;
+}
+
+
+bool SharedMemoryFrameRing::open(const std::string& name, std::ostream& os)
+{
+    return impl->open(name, os);
+}
+
+
+bool SharedMemoryFrameRing::Impl::open(const string& name, ostream& os)
+{
+    close();
+
+    const string systemName = getSystemName(name);
+    size_t size = 0;
+
+#ifdef _WIN32
+    mappingHandle = OpenFileMappingA(FILE_MAP_READ, FALSE, systemName.c_str());
+    if(!mappingHandle){
+        os << format(_("The shared memory \"{0}\" cannot be opened."), name) << endl;
+        return false;
+    }
+    auto p = MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+    if(p){
+        MEMORY_BASIC_INFORMATION info;
+        if(VirtualQuery(p, &info, sizeof(info))){
+            size = info.RegionSize;
+        }
+    } else {
+        os << format(_("The shared memory \"{0}\" cannot be mapped."), name) << endl;
+        CloseHandle(mappingHandle);
+        mappingHandle = nullptr;
+        return false;
+    }
+#else
+    int fd = shm_open(systemName.c_str(), O_RDONLY, 0);
+    if(fd < 0){
+        os << format(_("The shared memory \"{0}\" cannot be opened: {1}"), name, strerror(errno)) << endl;
+        return false;
+    }
+    struct stat st;
+    if(fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(RegionHeader))){
+        os << format(_("The shared memory \"{0}\" is not initialized."), name) << endl;
+        ::close(fd);
+        return false;
+    }
+    size = st.st_size;
+    auto p = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if(p == MAP_FAILED){
+        os << format(_("The shared memory \"{0}\" cannot be mapped: {1}"), name, strerror(errno)) << endl;
+        return false;
+    }
+#endif
+
+    region = static_cast<unsigned char*>(p);
+    regionSize = size;
+    header = reinterpret_cast<RegionHeader*>(region);
+    this->name = name;
+    isWriter = false;
+
+    bool isValid = (memcmp(header->magic, Magic, sizeof(Magic)) == 0);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if(!isValid || header->version != Version){
+        os << format(_("The shared memory \"{0}\" is not a frame ring of this version."), name) << endl;
+        close();
+        return false;
+    }
+    if(sizeof(RegionHeader) + header->slotStride * header->numSlots > regionSize){
+        os << format(_("The shared memory \"{0}\" is smaller than its slots."), name) << endl;
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+
+void SharedMemoryFrameRing::close()
+{
+    impl->close();
+}
+
+
+void SharedMemoryFrameRing::Impl::close()
+{
+    if(!region){
+        return;
+    }
+#ifdef _WIN32
+    UnmapViewOfFile(region);
+    CloseHandle(mappingHandle);
+    mappingHandle = nullptr;
+#else
+    munmap(region, regionSize);
+    if(isWriter){
+        shm_unlink(getSystemName(name).c_str());
+    }
+#endif
+    region = nullptr;
+    regionSize = 0;
+    header = nullptr;
+    isWriter = false;
+    name.clear();
+}
+
+
+bool SharedMemoryFrameRing::isOpen() const
+{
+    return impl->region != nullptr;
+}
+
+
+bool SharedMemoryFrameRing::isWriter() const
+{
+    return impl->isWriter;
+}
+
+
+const std::string& SharedMemoryFrameRing::name() const
+{
+    return impl->name;
+}
+
+
+int SharedMemoryFrameRing::numSlots() const
+{
+    return impl->header ? impl->header->numSlots : 0;
+}
+
+
+size_t SharedMemoryFrameRing::slotCapacity() const
+{
+    return impl->header ? impl->header->slotCapacity : 0;
+}
+
+
+unsigned char* SharedMemoryFrameRing::beginFrame(size_t dataSize)
+{
+    if(!impl->isWriter || dataSize > impl->header->slotCapacity){
+        return nullptr;
+    }
+    const uint64_t frameNumber = impl->header->latestFrameNumber.load(std::memory_order_relaxed) + 1;
+    auto slot = impl->slot(frameNumber);
+    slot->sequence.store(frameNumber * 2 - 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    return impl->data(slot);
+}
+
+
+void SharedMemoryFrameRing::endFrame(const FrameInfo& info)
+{
+    const uint64_t frameNumber = impl->header->latestFrameNumber.load(std::memory_order_relaxed) + 1;
+    auto slot = impl->slot(frameNumber);
+    slot->info = info;
+    slot->sequence.store(frameNumber * 2, std::memory_order_release);
+    impl->header->latestFrameNumber.store(frameNumber, std::memory_order_release);
+}
+
+
+bool SharedMemoryFrameRing::writeFrame(const FrameInfo& info, const void* data)
+{
+    auto buf = beginFrame(info.dataSize);
+    if(!buf){
+        return false;
+    }
+    memcpy(buf, data, info.dataSize);
+    endFrame(info);
+    return true;
+}
+
+
+uint64_t SharedMemoryFrameRing::latestFrameNumber() const
+{
+    if(!impl->header){
+        return 0;
+    }
+    return impl->header->latestFrameNumber.load(std::memory_order_acquire);
+}
+
+
+const unsigned char* SharedMemoryFrameRing::frameData(uint64_t frameNumber, FrameInfo& out_info) const
+{
+    if(!impl->header || frameNumber == 0 || frameNumber > latestFrameNumber()){
+        return nullptr;
+    }
+    auto slot = impl->slot(frameNumber);
+    if(slot->sequence.load(std::memory_order_acquire) != frameNumber * 2){
+        return nullptr;
+    }
+    out_info = slot->info;
+    if(!isFrameValid(frameNumber) || out_info.dataSize > impl->header->slotCapacity){
+        return nullptr;
+    }
+    return impl->data(slot);
+}
+
+
+bool SharedMemoryFrameRing::isFrameValid(uint64_t frameNumber) const
+{
+    if(!impl->header || frameNumber == 0){
+        return false;
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return impl->slot(frameNumber)->sequence.load(std::memory_order_relaxed) == frameNumber * 2;
+}
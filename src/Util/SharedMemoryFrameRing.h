@@ -0,0 +1,80 @@
+#ifndef CNOID_UTIL_SHARED_MEMORY_FRAME_RING_H
+#define CNOID_UTIL_SHARED_MEMORY_FRAME_RING_H
+
+#include "NullOut.h"
+#include <string>
+#include <cstdint>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+/**
+   This class provides a ring of frame buffers in a named shared memory region so that
+   a process can pass images or point clouds to other processes without serializing them.
+   The writer creates the region by create() and writes each frame in the next slot of the
+   ring by beginFrame() and endFrame(). A reader maps the region by open() and accesses
+   the data of a frame in place. The sequence number of each slot is odd while the slot is
+   being written, so a reader must confirm that isFrameValid() still returns true after
+   reading the data of a frame to detect the frame that has been overwritten meanwhile.
+*/
+class CNOID_EXPORT SharedMemoryFrameRing
+{
+public:
+    enum DataType {
+        // Pixels of 8-bit components
+        ImageData = 0,
+        // Vector3f elements
+        PointData = 1,
+        // Double elements
+        RangeData = 2
+    };
+
+    struct FrameInfo {
+        uint32_t dataType;
+        uint32_t width;
+        uint32_t height;
+        uint32_t numComponents;
+        uint64_t dataSize;
+        double time;
+    };
+
+    SharedMemoryFrameRing();
+    ~SharedMemoryFrameRing();
+
+    //! The existing region of the same name is replaced with a new one.
+    bool create(const std::string& name, int numSlots, size_t slotCapacity, std::ostream& os = nullout());
+    bool open(const std::string& name, std::ostream& os = nullout());
+    void close();
+
+    bool isOpen() const;
+    bool isWriter() const;
+    const std::string& name() const;
+    int numSlots() const;
+    size_t slotCapacity() const;
+
+    /**
+       \return The buffer of the given size to write the data of the new frame, or nullptr
+       if the size exceeds the slot capacity. The function must be followed by endFrame().
+    */
+    unsigned char* beginFrame(size_t dataSize);
+    void endFrame(const FrameInfo& info);
+    bool writeFrame(const FrameInfo& info, const void* data);
+
+    //! \return The number of the last frame written by the writer, or zero if no frame is written.
+    uint64_t latestFrameNumber() const;
+
+    /**
+       \return The data of the frame in the shared memory, or nullptr if the frame is being
+       written or has been overwritten.
+    */
+    const unsigned char* frameData(uint64_t frameNumber, FrameInfo& out_info) const;
+    bool isFrameValid(uint64_t frameNumber) const;
+
+private:
+    class Impl;
+    Impl* impl;
+};
+
+}
+
+#endif
@@ -107,17 +107,50 @@ class SignalBase
 {
 protected:
     typedef ref_ptr<SlotHolderBase> SlotHolderPtr;
+
+    /**
+       A call frame exists on the stack while the slots are being called. The slots disconnected
+       during the calls are kept alive by the outermost frame until the calls are finished, so the
+       slots can be iterated without taking the references to them, which requires the atomic
+       operations for each slot. A slot can also destroy the signal during the call.
+    */
+    struct CallFrame
+    {
+        SignalBase* signal;
+        CallFrame* prev;
+        CallFrame* outermost;
+        bool isSignalDestroyed;
+        std::vector<SlotHolderPtr> removedSlots;
+
+        CallFrame(SignalBase* signal)
+            : signal(signal), prev(signal->currentCallFrame), isSignalDestroyed(false) {
+            outermost = prev ? prev->outermost : this;
+            signal->currentCallFrame = this;
+        }
+        ~CallFrame() {
+            if(!isSignalDestroyed){
+                signal->currentCallFrame = prev;
+                if(!prev && signal->pSlotsToConnectLater){
+                    signal->connectSlotsWithPendingConnection();
+                }
+            }
+        }
+    };
+    
     SlotHolderPtr firstSlot;
     SlotHolderBase* lastSlot;
     std::vector<SlotHolderPtr>* pSlotsToConnectLater;
-    bool isCallingSlots;
+    CallFrame* currentCallFrame;
 
     friend class SlotHolderBase;
     
-    SignalBase() : lastSlot(nullptr), pSlotsToConnectLater(nullptr), isCallingSlots(false) { }
+    SignalBase() : lastSlot(nullptr), pSlotsToConnectLater(nullptr), currentCallFrame(nullptr) { }
 
     ~SignalBase() {
         disconnectAllSlots();
+        for(auto frame = currentCallFrame; frame; frame = frame->prev){
+            frame->isSignalDestroyed = true;
+        }
         if(pSlotsToConnectLater){
             delete pSlotsToConnectLater;
         }
@@ -125,7 +158,7 @@ protected:
 
     void connectSlotHolder(SlotHolderBase* slot) {
 
-        if(!isCallingSlots){
+        if(!currentCallFrame){
             if(!firstSlot){
                 firstSlot = slot;
                 lastSlot = slot;
@@ -176,6 +209,10 @@ protected:
             slot->owner = nullptr;
             ++(slot->blockCounter);
 
+            if(currentCallFrame){
+                currentCallFrame->outermost->removedSlots.push_back(slot);
+            }
+
             /**
                keep slot->next so that the slot call iteration
                can be continued even if the slot is disconnected
@@ -475,15 +512,30 @@ public:
 private:
     void invoke(std::true_type, Args&&... args){
         if(firstSlot){
-            typedef signal_private::SlotCallIterator<SlotHolderType, Args...> IteratorType;
-            Combiner combiner;
-            std::tuple<Args...> argset(args...);
-            isCallingSlots = true;
-            combiner(IteratorType(firstSlot, argset), IteratorType(nullptr, argset));
-            isCallingSlots = false;
-            if(pSlotsToConnectLater){
-                connectSlotsWithPendingConnection();
+            CallFrame frame(this);
+            if(std::is_same<Combiner, signal_private::last_value<void>>::value){
+                callSlots(args...);
+            } else {
+                typedef signal_private::SlotCallIterator<SlotHolderType, Args...> IteratorType;
+                Combiner combiner;
+                std::tuple<Args...> argset(args...);
+                combiner(IteratorType(firstSlot, argset), IteratorType(nullptr, argset));
+            }
+        }
+    }
+
+    /**
+       The slots of a signal with the default combiner are called directly without packing the
+       arguments into a tuple and going through the iterators of the combiner. A signal with a
+       single slot is processed by one iteration of the loop.
+    */
+    void callSlots(Args&... args){
+        signal_private::SlotHolderBase* slot = firstSlot;
+        while(slot){
+            if(slot->blockCounter == 0){
+                static_cast<SlotHolderType*>(slot)->func(args...);
             }
+            slot = slot->next;
         }
     }
 
@@ -495,13 +547,8 @@ private:
         typedef signal_private::SlotCallIterator<SlotHolderType, Args...> IteratorType;
         Combiner combiner;
         std::tuple<Args...> argset(args...);
-        isCallingSlots = true;
-        auto result = combiner(IteratorType(firstSlot, argset), IteratorType(nullptr, argset));
-        isCallingSlots = false;
-        if(pSlotsToConnectLater){
-            connectSlotsWithPendingConnection();
-        }
-        return result;
+        CallFrame frame(this);
+        return combiner(IteratorType(firstSlot, argset), IteratorType(nullptr, argset));
     }
 };
 
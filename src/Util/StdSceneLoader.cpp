@@ -104,6 +104,7 @@ SgNode* StdSceneLoader::Impl::load(const std::string& filename)
             if(!sceneSrc->isValid()){
                 os() << format(_("Scene file \"{}\" does not have the \"scene\" node."), filename) << endl;
             } else {
+                sceneReader.prefetchResources(sceneSrc);
                 scene = sceneReader.readScene(sceneSrc);
                 if(!scene){
                     os() << format(_("Scene file \"{}\" is an empty scene."), filename) << endl;
@@ -12,18 +12,27 @@
 #include "PolygonMeshTriangulator.h"
 #include "MeshFilter.h"
 #include "SceneLoader.h"
+#include "ObjSceneWriter.h"
 #include "YAMLReader.h"
 #include "EigenArchive.h"
 #include "FilePathVariableProcessor.h"
 #include "NullOut.h"
 #include "ImageIO.h"
+#include "ImageCache.h"
 #include "UTF8.h"
+#include "ThreadPool.h"
+#include "MappedFile.h"
+#include "Exception.h"
 #include <cnoid/stdx/filesystem>
 #include <cnoid/Config>
 #include <fmt/format.h>
 #include <unordered_map>
+#include <unordered_set>
+#include <sstream>
 #include <mutex>
 #include <regex>
+#include <cstring>
+#include <cstdint>
 #include "gettext.h"
 
 using namespace std;
@@ -73,17 +82,33 @@ public:
         unique_ptr<SceneNodeMap> sceneNodeMap;
         unique_ptr<YAMLReader> yamlReader;
         string directory;
+        string filename;
+        // The simplified scenes for the levels of detail with the triangle ratios as the keys
+        map<double, SgNodePtr> simplifiedScenes;
     };
     typedef ref_ptr<ResourceInfo> ResourceInfoPtr;
 
     map<string, ResourceInfoPtr> resourceInfoMap;
     
     SceneLoader sceneLoader;
+    int sceneLoaderDivisionNumber;
+
+    struct PrefetchedScene
+    {
+        SgNodePtr scene;
+        string messages;
+    };
+    // The file names are the keys
+    unordered_map<string, PrefetchedScene> prefetchedScenes;
+    // The prefetched images are kept in the image cache while the scene is read
+    vector<shared_ptr<Image>> prefetchedImages;
+
     FilePathVariableProcessorPtr pathVariableProcessor;
     regex uriSchemeRegex;
     bool isUriSchemeRegexReady;
     typedef map<string, SgImagePtr> ImagePathToSgImageMap;
     ImagePathToSgImageMap imagePathToSgImageMap;
+    unique_ptr<MappedFile> geometryDataFile;
 
     typedef SgNode* (Impl::*NodeFunction)(Mapping* info);
     typedef unordered_map<string, NodeFunction> NodeFunctionMap;
@@ -122,6 +147,10 @@ public:
     SgMesh* readExtrusion(Mapping* info, int meshOptions);
     SgMesh* readElevationGrid(Mapping* info, int meshOptions);
     SgMesh* readMesh(Mapping* info, bool isTriangleMesh, int meshOptions);
+    void openGeometryDataFile(ValueNode* fileNode);
+    const unsigned char* findGeometryData(Mapping* info, int numScalarsPerElement, size_t& out_numElements);
+    template<class Container>
+    void readGeometryData(Mapping* info, int numScalarsPerElement, Container& out_container);
     SgMesh* readResourceAsGeometry(Mapping* info, int meshOptions);
     void readAppearance(SgShape* shape, Mapping* info);
     void readMaterial(SgShape* shape, Mapping* info);
@@ -140,9 +169,16 @@ public:
     Resource readResourceNode(Mapping* info, bool doSetUri);
     void extractNamedSceneNodes(Mapping* resourceNode, ResourceInfo* info, Resource& resource);
     ResourceInfo* getOrCreateResourceInfo(Mapping* resourceNode, const string& uri);
+    void prefetchResources(ValueNode* node);
+    void collectPrefetchableFiles(
+        ValueNode* node, vector<string>& filenames, vector<string>& imageFilenames,
+        unordered_set<string>& filenameSet);
+    string getPrefetchableFilename(const string& uri);
     stdx::filesystem::path findFileInPackage(const string& file);
     void adjustNodeCoordinate(SceneNodeInfo& info);
     void makeSceneNodeMap(ResourceInfo* info);
+    SgNode* readLevelsOfDetail(Mapping* lodInfo, ResourceInfo* resourceInfo);
+    SgNode* getOrCreateSimplifiedScene(ResourceInfo* info, double ratio);
     void makeSceneNodeMapSub(const SceneNodeInfo& nodeInfo, SceneNodeMap& nodeMap);
 };
 
@@ -207,6 +243,7 @@ StdSceneReader::Impl::Impl(StdSceneReader* self)
     }
     
     os_ = &nullout();
+    sceneLoaderDivisionNumber = -1;
     isUriSchemeRegexReady = false;
     imageIO.setUpsideDown(true);
 }
@@ -235,6 +272,7 @@ void StdSceneReader::setDefaultDivisionNumber(int n)
 {
     impl->meshGenerator.setDivisionNumber(n);
     impl->sceneLoader.setDefaultDivisionNumber(n);
+    impl->sceneLoaderDivisionNumber = n;
 }
 
 
@@ -244,6 +282,18 @@ int StdSceneReader::defaultDivisionNumber() const
 }
 
 
+void StdSceneReader::setTessellationDeferred(bool on)
+{
+    impl->meshGenerator.setTessellationDeferred(on);
+}
+
+
+bool StdSceneReader::isTessellationDeferred() const
+{
+    return impl->meshGenerator.isTessellationDeferred();
+}
+
+
 void StdSceneReader::setBaseDirectory(const std::string& directory)
 {
     impl->getOrCreatePathVariableProcessor()->setBaseDirectory(directory);
@@ -294,7 +344,10 @@ void StdSceneReader::clear()
     isDegreeMode_ = true;
     impl->defaultMaterial.reset();
     impl->resourceInfoMap.clear();
+    impl->prefetchedScenes.clear();
+    impl->prefetchedImages.clear();
     impl->imagePathToSgImageMap.clear();
+    impl->geometryDataFile.reset();
 }
 
 
@@ -333,6 +386,10 @@ void StdSceneReader::readHeader(Mapping* info, double formatVersion)
             angleUnitNode->throwException(_("The \"angleUnit\" value must be either \"radian\" or \"degree\""));
         }
     }
+
+    if(auto geometryDataNode = info->extract("geometry_data")){
+        impl->openGeometryDataFile(geometryDataNode);
+    }
 }
 
 
@@ -1090,6 +1147,11 @@ SgMesh* StdSceneReader::Impl::readMesh(Mapping* info, bool isTriangleMesh, int m
                 v[j] = srcVertices[i*3 + j].toFloat();
             }
         }
+    } else {
+        auto verticesInfo = info->findMapping({ "vertices", "coordinate" });
+        if(verticesInfo->isValid()){
+            readGeometryData(verticesInfo, 3, *meshBase->getOrCreateVertices());
+        }
     }
 
     Listing& srcFaces = *info->findListing({ "faces", "coordIndex" });
@@ -1100,6 +1162,11 @@ SgMesh* StdSceneReader::Impl::readMesh(Mapping* info, bool isTriangleMesh, int m
         for(int i=0; i < numIndices; ++i){
             face[i] = srcFaces[i].toInt();
         }
+    } else {
+        auto facesInfo = info->findMapping({ "faces", "coordIndex" });
+        if(facesInfo->isValid()){
+            readGeometryData(facesInfo, 1, meshBase->faceVertexIndices());
+        }
     }
 
     Listing& srcNormals = *info->findListing("normals");
@@ -1113,6 +1180,11 @@ SgMesh* StdSceneReader::Impl::readMesh(Mapping* info, bool isTriangleMesh, int m
                 n[j] = srcNormals[i*3 + j].toFloat();
             }
         }
+    } else {
+        auto normalsInfo = info->findMapping("normals");
+        if(normalsInfo->isValid()){
+            readGeometryData(normalsInfo, 3, *meshBase->getOrCreateNormals());
+        }
     }
 
     Listing& srcNormalIndices = *info->findListing("normal_indices");
@@ -1123,6 +1195,11 @@ SgMesh* StdSceneReader::Impl::readMesh(Mapping* info, bool isTriangleMesh, int m
         for(int i=0; i < numIndices; ++i){
             normalIndices[i] = srcNormalIndices[i].toInt();
         }
+    } else {
+        auto normalIndicesInfo = info->findMapping("normal_indices");
+        if(normalIndicesInfo->isValid()){
+            readGeometryData(normalIndicesInfo, 1, meshBase->normalIndices());
+        }
     }
 
     Listing& srcTexCoords = *info->findListing({ "tex_coords", "texCoord" });
@@ -1136,6 +1213,11 @@ SgMesh* StdSceneReader::Impl::readMesh(Mapping* info, bool isTriangleMesh, int m
                 p[j] = srcTexCoords[i*2 + j].toFloat();
             }
         }
+    } else {
+        auto texCoordsInfo = info->findMapping({ "tex_coords", "texCoord" });
+        if(texCoordsInfo->isValid()){
+            readGeometryData(texCoordsInfo, 2, *meshBase->getOrCreateTexCoords());
+        }
     }
 
     Listing& srcTexCoordIndices = *info->findListing({ "tex_coord_indices", "texCoordIndex" });
@@ -1146,6 +1228,11 @@ SgMesh* StdSceneReader::Impl::readMesh(Mapping* info, bool isTriangleMesh, int m
         for(int i=0; i < numIndices; ++i){
             texCoordIndices[i] = srcTexCoordIndices[i].toInt();
         }
+    } else {
+        auto texCoordIndicesInfo = info->findMapping({ "tex_coord_indices", "texCoordIndex" });
+        if(texCoordIndicesInfo->isValid()){
+            readGeometryData(texCoordIndicesInfo, 1, meshBase->texCoordIndices());
+        }
     }
 
     //polygonMeshTriangulator.setDeepCopyEnabled(true);
@@ -1177,6 +1264,66 @@ SgMesh* StdSceneReader::Impl::readMesh(Mapping* info, bool isTriangleMesh, int m
 }
 
 
+void StdSceneReader::Impl::openGeometryDataFile(ValueNode* fileNode)
+{
+    filesystem::path path(fromUTF8(fileNode->toString()));
+    if(path.is_relative()){
+        path = self->baseDirPath() / path;
+    }
+    auto filename = toUTF8(path.string());
+    try {
+        geometryDataFile.reset(new MappedFile(filename));
+    }
+    catch(const file_read_error&){
+        fileNode->throwException(
+            format(_("Geometry data file \"{}\" cannot be opened."), filename));
+    }
+    uint32_t version = 0;
+    if(geometryDataFile->size() >= 8){
+        memcpy(&version, geometryDataFile->data() + 4, sizeof(version));
+    }
+    if(geometryDataFile->size() < 8 || memcmp(geometryDataFile->data(), "CNSG", 4) != 0 || version != 1){
+        geometryDataFile.reset();
+        fileNode->throwException(
+            format(_("\"{}\" is not a supported geometry data file."), filename));
+    }
+}
+
+
+/**
+   The array in the geometry data file is specified by the byte offset in the file and the
+   number of the scalar values, which are 32-bit floats or integers.
+*/
+const unsigned char* StdSceneReader::Impl::findGeometryData
+(Mapping* info, int numScalarsPerElement, size_t& out_numElements)
+{
+    if(!geometryDataFile){
+        info->throwException(_("The geometry data file is not specified."));
+    }
+    const double offset = (*info)["offset"].toDouble();
+    const int count = (*info)["count"].toInt();
+    if(offset < 0.0 || count < 0 || count % numScalarsPerElement != 0 ||
+       offset + count * static_cast<double>(sizeof(float)) > geometryDataFile->size()){
+        info->throwException(_("The geometry data is out of the range of the geometry data file."));
+    }
+    out_numElements = count / numScalarsPerElement;
+    return geometryDataFile->data() + static_cast<size_t>(offset);
+}
+
+
+template<class Container>
+void StdSceneReader::Impl::readGeometryData(Mapping* info, int numScalarsPerElement, Container& out_container)
+{
+    size_t numElements;
+    auto data = findGeometryData(info, numScalarsPerElement, numElements);
+    out_container.resize(numElements);
+    if(numElements > 0){
+        // The scalars are 32-bit values, whose size is the same as float
+        memcpy(static_cast<void*>(out_container.data()), data, numElements * numScalarsPerElement * sizeof(float));
+    }
+}
+
+
 SgMesh* StdSceneReader::Impl::readResourceAsGeometry(Mapping* info, int meshOptions)
 {
     auto resource = readResourceNode(info, false);
@@ -1289,15 +1436,11 @@ void StdSceneReader::Impl::readTexture(SgShape* shape, Mapping* info)
             if(filename.empty()){
                 os() << format(_("Warning: texture uri \"{0}\" is not valid: {1}"),
                                uri, fpvp->errorMessage()) << endl;
-            } else {
-                image = new SgImage;
-                if(imageIO.load(image->image(), filename, os())){
-                    image->setUriByFilePathAndBaseDirectory(
-                        uri, getOrCreatePathVariableProcessor()->baseDirectory());
-                    imagePathToSgImageMap[uri] = image;
-                } else {
-                    image.reset();
-                }
+            } else if(auto loaded = ImageCache::instance()->load(filename, imageIO, os())){
+                image = new SgImage(loaded);
+                image->setUriByFilePathAndBaseDirectory(
+                    uri, getOrCreatePathVariableProcessor()->baseDirectory());
+                imagePathToSgImageMap[uri] = image;
             }
         }
         if(image){
@@ -1495,7 +1638,12 @@ StdSceneReader::Resource StdSceneReader::Impl::readResourceNode(Mapping* info, b
             if(isYamlResouce){
                 resource.info = resourceInfo->yamlReader->document();
             } else {
-                resource.scene = resourceInfo->scene;
+                auto lodInfo = info->findMapping("lod");
+                if(lodInfo->isValid()){
+                    resource.scene = readLevelsOfDetail(lodInfo, resourceInfo);
+                } else {
+                    resource.scene = resourceInfo->scene;
+                }
             }
         } else {
             if(!isYamlResouce){
@@ -1626,12 +1774,21 @@ StdSceneReader::Impl::getOrCreateResourceInfo(Mapping* resourceNode, const strin
         info->yamlReader = std::move(reader);
 
     } else {
-        SgNodePtr scene = sceneLoader.load(filename);
+        SgNodePtr scene;
+        auto prefetched = prefetchedScenes.find(filename);
+        if(prefetched != prefetchedScenes.end()){
+            os() << prefetched->second.messages;
+            scene = prefetched->second.scene;
+            prefetchedScenes.erase(prefetched);
+        } else {
+            scene = sceneLoader.load(filename);
+        }
         if(!scene){
             resourceNode->throwException(
                 format(_("The resource is not found at URI \"{}\""), uri));
         }
         info->scene = scene;
+        info->filename = filename;
     }
 
     info->directory = toUTF8(filepath.parent_path().string());
@@ -1642,6 +1799,206 @@ StdSceneReader::Impl::getOrCreateResourceInfo(Mapping* resourceNode, const strin
 }
 
 
+void StdSceneReader::prefetchResources(ValueNode* node)
+{
+    impl->prefetchResources(node);
+}
+
+
+void StdSceneReader::Impl::prefetchResources(ValueNode* node)
+{
+    vector<string> filenames;
+    vector<string> imageFilenames;
+    unordered_set<string> filenameSet;
+    collectPrefetchableFiles(node, filenames, imageFilenames, filenameSet);
+
+    const int numThreads = std::min(filenames.size(), static_cast<size_t>(thread::hardware_concurrency()));
+    if(numThreads < 2 && imageFilenames.size() < 2){
+        return;
+    }
+
+    /*
+      The images are decoded before the scenes so that the textures used in the scenes are
+      also found in the cache. The messages are output when the textures are read again.
+    */
+    if(imageFilenames.size() >= 2){
+        prefetchedImages = ImageCache::instance()->loadInParallel(imageFilenames, imageIO, nullout());
+    }
+
+    if(numThreads < 2){
+        return;
+    }
+
+    /*
+      The files are loaded by a thread pool instead of the TaskScheduler because the loading
+      blocks for file I/O. Each thread uses its own loader instance, and the messages are output
+      when the scene is used.
+    */
+    vector<PrefetchedScene> scenes(filenames.size());
+    {
+        ThreadPool threadPool(numThreads);
+        for(size_t i=0; i < filenames.size(); ++i){
+            threadPool.start(
+                [this, i, &filenames, &scenes](){
+                    SceneLoader loader;
+                    ostringstream messages;
+                    loader.setMessageSink(messages);
+                    if(sceneLoaderDivisionNumber > 0){
+                        loader.setDefaultDivisionNumber(sceneLoaderDivisionNumber);
+                    }
+                    try {
+                        scenes[i].scene = loader.load(filenames[i]);
+                    }
+                    catch(...){
+                        // The file is loaded again when the resource node is read
+                        scenes[i].scene.reset();
+                    }
+                    scenes[i].messages = messages.str();
+                });
+        }
+        threadPool.wait();
+    }
+
+    for(size_t i=0; i < filenames.size(); ++i){
+        if(scenes[i].scene){
+            prefetchedScenes[filenames[i]] = std::move(scenes[i]);
+        }
+    }
+}
+
+
+/**
+   Only the URIs without a scheme or with the file scheme are prefetched because the other
+   scheme handlers may have side effects.
+*/
+void StdSceneReader::Impl::collectPrefetchableFiles
+(ValueNode* node, vector<string>& filenames, vector<string>& imageFilenames, unordered_set<string>& filenameSet)
+{
+    if(node->isMapping()){
+        auto mapping = node->toMapping();
+        auto typeNode = mapping->find("type");
+        auto uriNode = mapping->find("uri");
+        if(typeNode->isString() && typeNode->toString() == "Resource" && uriNode->isString()){
+            auto& uri = uriNode->toString();
+            if(resourceInfoMap.find(uri) == resourceInfoMap.end()){
+                auto filename = getPrefetchableFilename(uri);
+                if(!filename.empty()){
+                    string ext = filesystem::path(fromUTF8(filename)).extension().string();
+                    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+                    if(ext != ".yaml" && ext != ".yml" && filenameSet.insert(filename).second){
+                        filenames.push_back(filename);
+                    }
+                }
+            }
+        }
+        auto textureNode = mapping->find("texture");
+        if(textureNode->isMapping()){
+            auto texture = textureNode->toMapping();
+            auto textureUriNode = texture->find({ "uri", "url" });
+            if(textureUriNode->isString()){
+                auto& uri = textureUriNode->toString();
+                auto filename = getPrefetchableFilename(uri);
+                if(!filename.empty() && imagePathToSgImageMap.find(uri) == imagePathToSgImageMap.end() &&
+                   filenameSet.insert(filename).second){
+                    imageFilenames.push_back(filename);
+                }
+            }
+        }
+        for(auto& kv : *mapping){
+            collectPrefetchableFiles(kv.second, filenames, imageFilenames, filenameSet);
+        }
+    } else if(node->isListing()){
+        for(auto& element : *node->toListing()){
+            collectPrefetchableFiles(element, filenames, imageFilenames, filenameSet);
+        }
+    }
+}
+
+
+string StdSceneReader::Impl::getPrefetchableFilename(const string& uri)
+{
+    string filename;
+    if(uri.compare(0, 7, "file://") == 0){
+        filename = uri.substr(7);
+    } else if(uri.find("://") == string::npos){
+        filename = uri;
+    }
+    if(!filename.empty()){
+        filename = getOrCreatePathVariableProcessor()->expand(filename, true);
+    }
+    return filename;
+}
+
+
+/**
+   The levels of detail are the original scene and the scenes simplified with the triangle
+   ratios given by the "ratios" list. The "ranges" list gives the switching distances of the
+   levels as SgLOD::ranges.
+*/
+SgNode* StdSceneReader::Impl::readLevelsOfDetail(Mapping* lodInfo, ResourceInfo* resourceInfo)
+{
+    SgLODPtr lod = new SgLOD;
+    lod->setCenter(resourceInfo->scene->boundingBox().center());
+    lod->addChild(resourceInfo->scene);
+
+    Listing& ratiosNode = *lodInfo->findListing("ratios");
+    if(ratiosNode.isValid()){
+        for(int i=0; i < ratiosNode.size(); ++i){
+            double ratio = ratiosNode[i].toDouble();
+            if(ratio <= 0.0 || ratio >= 1.0){
+                ratiosNode[i].throwException(_("The ratio of a level of detail must be between 0 and 1"));
+            }
+            lod->addChild(getOrCreateSimplifiedScene(resourceInfo, ratio));
+        }
+    }
+
+    Listing& rangesNode = *lodInfo->findListing("ranges");
+    if(rangesNode.isValid()){
+        vector<double> ranges(rangesNode.size());
+        for(int i=0; i < rangesNode.size(); ++i){
+            ranges[i] = rangesNode[i].toDouble();
+        }
+        lod->setRanges(ranges);
+    }
+
+    return lod.retn();
+}
+
+
+/**
+   The simplified scene is cached as an OBJ file in the directory of the resource file,
+   and the cache is used while it is newer than the resource file.
+*/
+SgNode* StdSceneReader::Impl::getOrCreateSimplifiedScene(ResourceInfo* info, double ratio)
+{
+    auto& scene = info->simplifiedScenes[ratio];
+    if(scene){
+        return scene;
+    }
+
+    filesystem::path filepath(fromUTF8(info->filename));
+    filesystem::path cachePath =
+        filepath.parent_path() / fromUTF8(format("{0}.lod{1}.obj", toUTF8(filepath.stem().string()), ratio));
+    string cacheFilename = toUTF8(cachePath.string());
+
+    stdx::error_code ec;
+    if(filesystem::exists(cachePath, ec) &&
+       filesystem::last_write_time(cachePath, ec) >= filesystem::last_write_time(filepath, ec)){
+        scene = sceneLoader.load(cacheFilename);
+    }
+    if(!scene){
+        scene = meshFilter.createSimplifiedScene(info->scene, ratio);
+        ObjSceneWriter writer;
+        writer.setMessageSink(os());
+        if(!writer.writeScene(cacheFilename, scene)){
+            os() << format(_("Warning: The level of detail of \"{0}\" cannot be cached in \"{1}\"."),
+                           info->filename, cacheFilename) << endl;
+        }
+    }
+    return scene;
+}
+
+
 void StdSceneReader::Impl::adjustNodeCoordinate(SceneNodeInfo& info)
 {
     if(auto pos = dynamic_cast<SgPosTransform*>(info.node.get())){
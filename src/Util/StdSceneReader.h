@@ -27,6 +27,13 @@ public:
     void setDefaultDivisionNumber(int n);
     int defaultDivisionNumber() const;
 
+    /**
+       The tessellation of the primitive shapes is deferred until it is required by the consumers
+       of the meshes when this is enabled. See MeshGenerator::setTessellationDeferred.
+    */
+    void setTessellationDeferred(bool on);
+    bool isTessellationDeferred() const;
+
     // One of the settings is valid for the following two functions
     void setBaseDirectory(const std::string& directory);
     void setFilePathVariableProcessor(FilePathVariableProcessor* processor);
@@ -38,6 +45,13 @@ public:
     void readHeader(Mapping* info);
     void readHeader(Mapping* info, double formatVersion);
 
+    /**
+       This function loads the mesh files referred to by the resource nodes under the given node
+       concurrently in advance. The prefetched scenes are used when the resource nodes are read,
+       so the resulting scene and the messages output are the same as those without the prefetch.
+    */
+    void prefetchResources(ValueNode* node);
+
     enum AngleUnit { DEGREE, RADIAN };
     void setAngleUnit(AngleUnit unit);
     bool isDegreeMode() const {
@@ -12,8 +12,12 @@
 #include "FilePathVariableProcessor.h"
 #include "CloneMap.h"
 #include "NullOut.h"
+#include "UTF8.h"
 #include <cnoid/stdx/filesystem>
 #include <fmt/format.h>
+#include <fstream>
+#include <map>
+#include <cstdint>
 #include "gettext.h"
 
 using namespace std;
@@ -21,6 +25,13 @@ using namespace cnoid;
 using fmt::format;
 namespace filesystem = cnoid::stdx::filesystem;
 
+namespace {
+
+const char* GeometryDataFileMagic = "CNSG";
+const uint32_t GeometryDataFileVersion = 1;
+
+}
+
 namespace cnoid {
 
 class StdSceneWriter::Impl
@@ -34,6 +45,11 @@ public:
     bool isAppearanceEnabled;
     bool isReplacingExistingModelFile;
     bool isMeshEnabled;
+    bool isGeometryDataFileEnabled;
+    bool isWritingGeometryData;
+    string geometryData;
+    // The offsets of the arrays written in the geometry data with their data pointers as the keys
+    map<pair<const void*, size_t>, size_t> geometryDataOffsetMap;
     int extModelFileMode;
     SgMaterialPtr defaultMaterial;
     FilePathVariableProcessorPtr pathVariableProcessor;
@@ -71,6 +87,10 @@ public:
     MappingPtr writeGeometry(SgShape* shape);
     void writeMeshAttributes(Mapping* archive, SgMesh* mesh);
     bool writeMesh(Mapping* archive, SgMesh* mesh);
+    void writeMeshArrays(Mapping* archive, SgMesh* mesh);
+    void writeMeshArraysAsGeometryData(Mapping* archive, SgMesh* mesh);
+    void writeGeometryData(Mapping* archive, const char* key, const void* data, size_t numScalars);
+    bool writeGeometryDataFile(const string& filename);
     void writePrimitiveAttributes(Mapping* archive, SgMesh* mesh);
     void writeBox(Mapping* archive, SgMesh* mesh);
     void writeSphere(Mapping* archive, SgMesh* mesh);
@@ -132,6 +152,8 @@ StdSceneWriter::Impl::Impl(StdSceneWriter* self)
     isAppearanceEnabled = true;
     isReplacingExistingModelFile = false;
     isMeshEnabled = true;
+    isGeometryDataFileEnabled = false;
+    isWritingGeometryData = false;
     extModelFileMode = EmbedModels;
 
     os_ = &nullout();    
@@ -151,6 +173,7 @@ void StdSceneWriter::Impl::copyConfigurations(const Impl* org)
     isTransformIntegrationEnabled = org->isTransformIntegrationEnabled;
     isAppearanceEnabled = org->isAppearanceEnabled;
     isMeshEnabled = org->isMeshEnabled;
+    isGeometryDataFileEnabled = org->isGeometryDataFileEnabled;
     extModelFileMode = org->extModelFileMode;
     os_ = org->os_;
     if(org->yamlWriter){
@@ -295,6 +318,18 @@ bool StdSceneWriter::isMeshEnabled() const
 }
 
 
+void StdSceneWriter::setGeometryDataFileEnabled(bool on)
+{
+    impl->isGeometryDataFileEnabled = on;
+}
+
+
+bool StdSceneWriter::isGeometryDataFileEnabled() const
+{
+    return impl->isGeometryDataFileEnabled;
+}
+
+
 void StdSceneWriter::Impl::pushToUriDirectoryStack(const std::string& uri)
 {
     if(!isReplacingExistingModelFile){
@@ -377,10 +412,29 @@ bool StdSceneWriter::Impl::writeScene
 
     numSkippedNode = 0;
 
+    geometryData.clear();
+    isWritingGeometryData = isGeometryDataFileEnabled;
+
     ListingPtr nodeList = new Listing;
     for(auto& node : *group){
         nodeList->append(writeSceneNode(node));
     }
+
+    isWritingGeometryData = false;
+    if(!geometryData.empty()){
+        filesystem::path dataFilePath(fromUTF8(filename));
+        dataFilePath.replace_extension(".bin");
+        if(!writeGeometryDataFile(toUTF8(dataFilePath.string()))){
+            geometryData.clear();
+            geometryDataOffsetMap.clear();
+            yamlWriter->closeFile();
+            return false;
+        }
+        header->write("geometry_data", toUTF8(dataFilePath.filename().generic_string()), DOUBLE_QUOTED);
+        geometryData.clear();
+        geometryDataOffsetMap.clear();
+    }
+    
     header->insert("scene", nodeList);
 
     if(numSkippedNode == 1){
@@ -672,71 +726,148 @@ bool StdSceneWriter::Impl::writeMesh(Mapping* archive, SgMesh* mesh)
 
         writeMeshAttributes(archive, mesh);
 
-        auto vertices = archive->createFlowStyleListing("vertices");
-        const auto srcVertices = mesh->vertices();
-        const int scalarElementSize = srcVertices->size() * 3;
-        vertices->reserve(scalarElementSize);
-        for(auto& v : *srcVertices){
-            vertices->append(v.x(), 12, scalarElementSize);
-            vertices->append(v.y(), 12, scalarElementSize);
-            vertices->append(v.z(), 12, scalarElementSize);
+        if(isWritingGeometryData){
+            writeMeshArraysAsGeometryData(archive, mesh);
+        } else {
+            writeMeshArrays(archive, mesh);
         }
         
-        Listing& indexList = *archive->createFlowStyleListing("faces");
-        const int numTriScalars = numTriangles * 3;
-        indexList.reserve(numTriScalars);
-        for(int i=0; i < numTriangles; ++i){
-            auto triangle = mesh->triangle(i);
-            indexList.append(triangle[0], 15, numTriScalars);
-            indexList.append(triangle[1], 15, numTriScalars);
-            indexList.append(triangle[2], 15, numTriScalars);
-        }
+        isValid = true;
+    }
+    
+    return isValid;
+}
 
-        if(mesh->hasNormals() && mesh->creaseAngle() == 0.0f){
-            auto normals = archive->createFlowStyleListing("normals");
-            const auto srcNormals = mesh->normals();
-            const int scalarElementSize = srcNormals->size() * 3;
-            normals->reserve(scalarElementSize);
-            for(auto& n : *srcNormals){
-                normals->append(n.x(), 12, scalarElementSize);
-                normals->append(n.y(), 12, scalarElementSize);
-                normals->append(n.z(), 12, scalarElementSize);
-            }
-            if(mesh->hasNormalIndices()){
-                const auto& srcNormalIndices = mesh->normalIndices();
-                const int n = srcNormalIndices.size();
-                Listing& indexList = *archive->createFlowStyleListing("normal_indices");
-                indexList.reserve(n);
-                for(auto& index : srcNormalIndices){
-                    indexList.append(index, 15, n);
-                }
+
+void StdSceneWriter::Impl::writeMeshArrays(Mapping* archive, SgMesh* mesh)
+{
+    const int numTriangles = mesh->numTriangles();
+
+    auto vertices = archive->createFlowStyleListing("vertices");
+    const auto srcVertices = mesh->vertices();
+    const int scalarElementSize = srcVertices->size() * 3;
+    vertices->reserve(scalarElementSize);
+    for(auto& v : *srcVertices){
+        vertices->append(v.x(), 12, scalarElementSize);
+        vertices->append(v.y(), 12, scalarElementSize);
+        vertices->append(v.z(), 12, scalarElementSize);
+    }
+    
+    Listing& indexList = *archive->createFlowStyleListing("faces");
+    const int numTriScalars = numTriangles * 3;
+    indexList.reserve(numTriScalars);
+    for(int i=0; i < numTriangles; ++i){
+        auto triangle = mesh->triangle(i);
+        indexList.append(triangle[0], 15, numTriScalars);
+        indexList.append(triangle[1], 15, numTriScalars);
+        indexList.append(triangle[2], 15, numTriScalars);
+    }
+
+    if(mesh->hasNormals() && mesh->creaseAngle() == 0.0f){
+        auto normals = archive->createFlowStyleListing("normals");
+        const auto srcNormals = mesh->normals();
+        const int scalarElementSize = srcNormals->size() * 3;
+        normals->reserve(scalarElementSize);
+        for(auto& n : *srcNormals){
+            normals->append(n.x(), 12, scalarElementSize);
+            normals->append(n.y(), 12, scalarElementSize);
+            normals->append(n.z(), 12, scalarElementSize);
+        }
+        if(mesh->hasNormalIndices()){
+            const auto& srcNormalIndices = mesh->normalIndices();
+            const int n = srcNormalIndices.size();
+            Listing& indexList = *archive->createFlowStyleListing("normal_indices");
+            indexList.reserve(n);
+            for(auto& index : srcNormalIndices){
+                indexList.append(index, 15, n);
             }
         }
+    }
 
-        if(isAppearanceEnabled && mesh->hasTexCoords()){
-            auto texCoords = archive->createFlowStyleListing("tex_coords");
-            const auto srcTexCoords = mesh->texCoords();
-            const int scalarElementSize = srcTexCoords->size() * 2;
-            texCoords->reserve(scalarElementSize);
-            for(auto& t : *srcTexCoords){
-                texCoords->append(t.x(), 12, scalarElementSize);
-                texCoords->append(t.y(), 12, scalarElementSize);
-            }
-            if(mesh->hasTexCoordIndices()){
-                const auto& srcTexCoordIndices = mesh->texCoordIndices();
-                const int n = srcTexCoordIndices.size();
-                Listing& indexList = *archive->createFlowStyleListing("tex_coord_indices");
-                indexList.reserve(n);
-                for(auto& index : srcTexCoordIndices){
-                    indexList.append(index, 15, n);
-                }
+    if(isAppearanceEnabled && mesh->hasTexCoords()){
+        auto texCoords = archive->createFlowStyleListing("tex_coords");
+        const auto srcTexCoords = mesh->texCoords();
+        const int scalarElementSize = srcTexCoords->size() * 2;
+        texCoords->reserve(scalarElementSize);
+        for(auto& t : *srcTexCoords){
+            texCoords->append(t.x(), 12, scalarElementSize);
+            texCoords->append(t.y(), 12, scalarElementSize);
+        }
+        if(mesh->hasTexCoordIndices()){
+            const auto& srcTexCoordIndices = mesh->texCoordIndices();
+            const int n = srcTexCoordIndices.size();
+            Listing& indexList = *archive->createFlowStyleListing("tex_coord_indices");
+            indexList.reserve(n);
+            for(auto& index : srcTexCoordIndices){
+                indexList.append(index, 15, n);
             }
         }
-        
-        isValid = true;
     }
-    
-    return isValid;
+}
+
+
+void StdSceneWriter::Impl::writeMeshArraysAsGeometryData(Mapping* archive, SgMesh* mesh)
+{
+    const auto vertices = mesh->vertices();
+    writeGeometryData(archive, "vertices", vertices->data(), vertices->size() * 3);
+
+    const auto& triangleVertices = mesh->triangleVertices();
+    writeGeometryData(archive, "faces", triangleVertices.data(), triangleVertices.size());
+
+    if(mesh->hasNormals() && mesh->creaseAngle() == 0.0f){
+        const auto normals = mesh->normals();
+        writeGeometryData(archive, "normals", normals->data(), normals->size() * 3);
+        if(mesh->hasNormalIndices()){
+            const auto& normalIndices = mesh->normalIndices();
+            writeGeometryData(archive, "normal_indices", normalIndices.data(), normalIndices.size());
+        }
+    }
+
+    if(isAppearanceEnabled && mesh->hasTexCoords()){
+        const auto texCoords = mesh->texCoords();
+        writeGeometryData(archive, "tex_coords", texCoords->data(), texCoords->size() * 2);
+        if(mesh->hasTexCoordIndices()){
+            const auto& texCoordIndices = mesh->texCoordIndices();
+            writeGeometryData(archive, "tex_coord_indices", texCoordIndices.data(), texCoordIndices.size());
+        }
+    }
+}
+
+
+/**
+   The scalar values of the array, which are 32-bit floats or integers, are appended to the
+   geometry data, and the archive refers to them by the byte offset in the geometry data file
+   and the number of the scalar values. An array shared by multiple meshes is written only once.
+*/
+void StdSceneWriter::Impl::writeGeometryData
+(Mapping* archive, const char* key, const void* data, size_t numScalars)
+{
+    if(geometryData.empty()){
+        geometryData.append(GeometryDataFileMagic, 4);
+        const uint32_t version = GeometryDataFileVersion;
+        geometryData.append(reinterpret_cast<const char*>(&version), sizeof(version));
+    }
+    auto inserted = geometryDataOffsetMap.emplace(make_pair(data, numScalars), geometryData.size());
+    if(inserted.second){
+        geometryData.append(static_cast<const char*>(data), numScalars * 4);
+    }
+    auto info = archive->createFlowStyleMapping(key);
+    info->write("offset", std::to_string(inserted.first->second));
+    info->write("count", static_cast<int>(numScalars));
+}
+
+
+bool StdSceneWriter::Impl::writeGeometryDataFile(const string& filename)
+{
+    ofstream ofs(fromUTF8(filename), ios::binary);
+    if(ofs){
+        ofs.write(geometryData.data(), geometryData.size());
+    }
+    if(!ofs){
+        os() << format(_("Geometry data file \"{}\" cannot be written."), filename) << endl;
+        return false;
+    }
+    return true;
 }
 
 
@@ -47,6 +47,15 @@ public:
     void setMeshEnabled(bool on);
     bool isMeshEnabled() const;
 
+    /**
+       When this is enabled, the arrays of the meshes are written in a binary geometry data file
+       instead of the scene file when the scene is written into a file. The name of the geometry
+       data file is the scene file name whose extension is replaced with ".bin", and the arrays
+       are referred to by their offsets in the geometry data file. This is disabled by default.
+    */
+    void setGeometryDataFileEnabled(bool on);
+    bool isGeometryDataFileEnabled() const;
+
     //enum AngleUnit { Degree, Radian };
     //void setAngleUnit(AngleUnit unit);
 
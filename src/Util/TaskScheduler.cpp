@@ -0,0 +1,366 @@
+#include "TaskScheduler.h"
+#include "Tracer.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <algorithm>
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+// An idle thread checks the deques this number of times before it starts yielding
+const int NumSpinsBeforeYield = 64;
+
+// An idle thread yields this number of times before it sleeps
+const int NumYieldsBeforeSleep = 16;
+
+}
+
+namespace cnoid {
+
+class TaskScheduler::Impl
+{
+public:
+    struct Job
+    {
+        RangeFunction function;
+        const void* func;
+        int grainSize;
+        // The number of the tasks that are queued or being processed
+        std::atomic<int> numPendingTasks;
+        // The number of the tasks that are queued and not taken by any thread yet
+        std::atomic<int> numQueuedTasks;
+        std::mutex mutex;
+        std::condition_variable condition;
+        bool isCompleted;
+    };
+
+    struct Task
+    {
+        Job* job;
+        int begin;
+        int end;
+    };
+
+    // The owner pushes and pops the tasks at the back, and the other threads steal them at the front
+    struct alignas(64) TaskDeque
+    {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    vector<std::thread> workers;
+
+    // The last deque is shared by the threads that are not the workers
+    vector<unique_ptr<TaskDeque>> deques;
+
+    std::atomic<int> numQueuedTasks;
+    std::atomic<int> numSleepingWorkers;
+    std::atomic<bool> isDestroying;
+    std::mutex sleepMutex;
+    std::condition_variable sleepCondition;
+
+    // The scheduler and the worker index of the worker thread
+    static thread_local Impl* currentScheduler;
+    static thread_local int currentWorkerIndex;
+
+    Impl(int numWorkers);
+    ~Impl();
+    int getCurrentDequeIndex();
+    void push(int dequeIndex, const Task& task);
+    bool findTask(int dequeIndex, Task& out_task);
+    bool findJobTask(int dequeIndex, const Job* job, Task& out_task);
+    bool takeJobTask(TaskDeque& deque, const Job* job, bool fromBack, Task& out_task);
+    void execute(int dequeIndex, Task task);
+    void wait(Job& job, int dequeIndex);
+    void workerLoop(int workerIndex);
+};
+
+}
+
+thread_local TaskScheduler::Impl* TaskScheduler::Impl::currentScheduler = nullptr;
+thread_local int TaskScheduler::Impl::currentWorkerIndex = -1;
+
+
+TaskScheduler* TaskScheduler::instance()
+{
+    static TaskScheduler scheduler;
+    return &scheduler;
+}
+
+
+TaskScheduler::TaskScheduler(int numWorkers)
+{
+    if(numWorkers < 0){
+        numWorkers = std::max(0, static_cast<int>(thread::hardware_concurrency()) - 1);
+    }
+    impl = new Impl(numWorkers);
+}
+
+
+TaskScheduler::Impl::Impl(int numWorkers)
+    : numQueuedTasks(0),
+      numSleepingWorkers(0),
+      isDestroying(false)
+{
+    for(int i=0; i <= numWorkers; ++i){
+        deques.emplace_back(new TaskDeque);
+    }
+    for(int i=0; i < numWorkers; ++i){
+        workers.emplace_back([this, i](){ workerLoop(i); });
+    }
+}
+
+
+TaskScheduler::~TaskScheduler()
+{
+    delete impl;
+}
+
+
+TaskScheduler::Impl::~Impl()
+{
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        isDestroying = true;
+    }
+    sleepCondition.notify_all();
+    for(auto& worker : workers){
+        worker.join();
+    }
+}
+
+
+int TaskScheduler::numWorkers() const
+{
+    return impl->workers.size();
+}
+
+
+int TaskScheduler::grainSize(int n, int numTasksPerThread) const
+{
+    return std::max(1, n / (concurrency() * std::max(1, numTasksPerThread)));
+}
+
+
+void TaskScheduler::run(int begin, int end, int grainSize, RangeFunction function, const void* func)
+{
+    if(begin >= end){
+        return;
+    }
+    grainSize = std::max(1, grainSize);
+    if(impl->workers.empty() || end - begin <= grainSize){
+        function(func, begin, end);
+        return;
+    }
+
+    Impl::Job job;
+    job.function = function;
+    job.func = func;
+    job.grainSize = grainSize;
+    job.numPendingTasks = 1;
+    job.numQueuedTasks = 0;
+    job.isCompleted = false;
+
+    const int dequeIndex = impl->getCurrentDequeIndex();
+    impl->execute(dequeIndex, Impl::Task{ &job, begin, end });
+    impl->wait(job, dequeIndex);
+}
+
+
+int TaskScheduler::Impl::getCurrentDequeIndex()
+{
+    if(currentScheduler == this){
+        return currentWorkerIndex;
+    }
+    return deques.size() - 1;
+}
+
+
+void TaskScheduler::Impl::push(int dequeIndex, const Task& task)
+{
+    auto& deque = *deques[dequeIndex];
+    ++task.job->numQueuedTasks;
+    {
+        std::lock_guard<std::mutex> lock(deque.mutex);
+        deque.tasks.push_back(task);
+    }
+    ++numQueuedTasks;
+
+    /*
+      A worker increments numSleepingWorkers before it checks numQueuedTasks to sleep,
+      so either the worker finds the task or this function finds the sleeping worker.
+    */
+    if(numSleepingWorkers > 0){
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        sleepCondition.notify_one();
+    }
+}
+
+
+bool TaskScheduler::Impl::findTask(int dequeIndex, Task& out_task)
+{
+    if(numQueuedTasks == 0){
+        return false;
+    }
+
+    auto& own = *deques[dequeIndex];
+    {
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if(!own.tasks.empty()){
+            out_task = own.tasks.back();
+            own.tasks.pop_back();
+            --numQueuedTasks;
+            --out_task.job->numQueuedTasks;
+            return true;
+        }
+    }
+
+    const int n = deques.size();
+    for(int i=1; i < n; ++i){
+        auto& victim = *deques[(dequeIndex + i) % n];
+        std::unique_lock<std::mutex> lock(victim.mutex, std::try_to_lock);
+        if(lock.owns_lock() && !victim.tasks.empty()){
+            out_task = victim.tasks.front();
+            victim.tasks.pop_front();
+            --numQueuedTasks;
+            --out_task.job->numQueuedTasks;
+            return true;
+        }
+    }
+    return false;
+}
+
+
+/**
+   This function only finds the tasks of the given job. The tasks of the job are searched from the
+   back of the own deque, where the tasks pushed by the thread are, and from the front of the others.
+*/
+bool TaskScheduler::Impl::findJobTask(int dequeIndex, const Job* job, Task& out_task)
+{
+    if(job->numQueuedTasks == 0){
+        return false;
+    }
+    if(takeJobTask(*deques[dequeIndex], job, true, out_task)){
+        return true;
+    }
+    const int n = deques.size();
+    for(int i=1; i < n; ++i){
+        if(takeJobTask(*deques[(dequeIndex + i) % n], job, false, out_task)){
+            return true;
+        }
+    }
+    return false;
+}
+
+
+bool TaskScheduler::Impl::takeJobTask(TaskDeque& deque, const Job* job, bool fromBack, Task& out_task)
+{
+    std::lock_guard<std::mutex> lock(deque.mutex);
+    auto& tasks = deque.tasks;
+    const int n = tasks.size();
+    for(int i=0; i < n; ++i){
+        auto p = fromBack ? (tasks.end() - 1 - i) : (tasks.begin() + i);
+        if(p->job == job){
+            out_task = *p;
+            tasks.erase(p);
+            --numQueuedTasks;
+            --out_task.job->numQueuedTasks;
+            return true;
+        }
+    }
+    return false;
+}
+
+
+/**
+   The range of the task is split in half until it is not larger than the grain size, and the
+   upper halves are pushed to the deque. The last task of a job wakes up the thread waiting for it.
+*/
+void TaskScheduler::Impl::execute(int dequeIndex, Task task)
+{
+    Job* job = task.job;
+    while(task.end - task.begin > job->grainSize){
+        const int middle = task.begin + (task.end - task.begin) / 2;
+        ++job->numPendingTasks;
+        push(dequeIndex, Task{ job, middle, task.end });
+        task.end = middle;
+    }
+
+    {
+        CNOID_TRACE_ZONE("Task", "TaskScheduler");
+        job->function(job->func, task.begin, task.end);
+    }
+
+    if(--job->numPendingTasks == 0){
+        std::lock_guard<std::mutex> lock(job->mutex);
+        job->isCompleted = true;
+        job->condition.notify_all();
+    }
+}
+
+
+/**
+   The waiting thread only processes the tasks of the job so that the time to complete the job does
+   not depend on the tasks of the other jobs. The thread sleeps only when no task of the job is
+   queued, and the remaining tasks of the job are then being processed by the other threads.
+*/
+void TaskScheduler::Impl::wait(Job& job, int dequeIndex)
+{
+    int numSpins = 0;
+    while(job.numPendingTasks > 0){
+        Task task;
+        if(findJobTask(dequeIndex, &job, task)){
+            execute(dequeIndex, task);
+            numSpins = 0;
+        } else if(numSpins < NumSpinsBeforeYield){
+            ++numSpins;
+        } else if(numSpins < NumSpinsBeforeYield + NumYieldsBeforeSleep){
+            ++numSpins;
+            std::this_thread::yield();
+        } else if(job.numQueuedTasks > 0){
+            // A task of the job is being pushed or is taken by another thread
+            std::this_thread::yield();
+        } else {
+            break;
+        }
+    }
+
+    // The job must not be destroyed until the thread completing it releases the mutex
+    std::unique_lock<std::mutex> lock(job.mutex);
+    job.condition.wait(lock, [&job](){ return job.isCompleted; });
+}
+
+
+void TaskScheduler::Impl::workerLoop(int workerIndex)
+{
+    currentScheduler = this;
+    currentWorkerIndex = workerIndex;
+    Tracer::setThreadName("Task worker");
+
+    int numSpins = 0;
+    while(!isDestroying){
+        Task task;
+        if(findTask(workerIndex, task)){
+            execute(workerIndex, task);
+            numSpins = 0;
+        } else if(numSpins < NumSpinsBeforeYield){
+            ++numSpins;
+        } else if(numSpins < NumSpinsBeforeYield + NumYieldsBeforeSleep){
+            ++numSpins;
+            std::this_thread::yield();
+        } else {
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            ++numSleepingWorkers;
+            sleepCondition.wait(lock, [this](){ return numQueuedTasks > 0 || isDestroying; });
+            --numSleepingWorkers;
+            numSpins = 0;
+        }
+    }
+}
@@ -0,0 +1,83 @@
+#ifndef CNOID_UTIL_TASK_SCHEDULER_H
+#define CNOID_UTIL_TASK_SCHEDULER_H
+
+#include "exportdecl.h"
+
+namespace cnoid {
+
+/**
+   This class processes the data-parallel loops with the worker threads shared in the process.
+
+   Each worker has its own deque of tasks, and a worker that runs out of tasks steals the oldest
+   task of another worker. A loop is divided in the fork-join manner: the range of a task is split
+   in half until it is not larger than the grain size, and the upper halves are pushed to the deque
+   of the thread so that idle workers can steal them. The thread calling parallelFor also processes
+   the tasks of the loop until the loop is completed, so the function can be called in a task of
+   another loop. The thread does not process the tasks of the other loops while it waits, so the
+   latency of a loop is not affected by the loops of the other threads.
+   The tasks are stored by value, so no memory is allocated for each task.
+
+   An idle thread spins and then yields for a while to pick up the next task quickly, and then
+   sleeps until a new task is pushed or the loop it is waiting for is completed.
+
+   The components of Choreonoid should use the global instance given by instance() so that their
+   loops do not oversubscribe the cores with separate thread pools. The tasks should be short and
+   should not block. Use ThreadPool for the jobs that take a long time or wait for file I/O.
+*/
+class CNOID_EXPORT TaskScheduler
+{
+public:
+    static TaskScheduler* instance();
+
+    /**
+       \param numWorkers The number of the worker threads. The number of the hardware threads
+       minus one is used when the value is negative because the calling thread also works.
+    */
+    TaskScheduler(int numWorkers = -1);
+    ~TaskScheduler();
+
+    TaskScheduler(const TaskScheduler&) = delete;
+    TaskScheduler& operator=(const TaskScheduler&) = delete;
+
+    int numWorkers() const;
+
+    //! The number of the threads that process a loop including the calling thread
+    int concurrency() const { return numWorkers() + 1; }
+
+    //! \return The grain size that divides n iterations into about numTasksPerThread tasks per thread
+    int grainSize(int n, int numTasksPerThread = 4) const;
+
+    /**
+       Calls func(begin, end) for the sub-ranges of [begin, end) that are not larger than grainSize,
+       and returns when all the sub-ranges are processed.
+    */
+    template<class Function>
+    void parallelForRange(int begin, int end, int grainSize, const Function& func){
+        run(begin, end, grainSize,
+            [](const void* f, int b, int e){ (*static_cast<const Function*>(f))(b, e); },
+            &func);
+    }
+
+    //! Calls func(i) for each i in [begin, end).
+    template<class Function>
+    void parallelFor(int begin, int end, int grainSize, const Function& func){
+        parallelForRange(
+            begin, end, grainSize,
+            [&func](int b, int e){
+                for(int i = b; i < e; ++i){
+                    func(i);
+                }
+            });
+    }
+
+private:
+    typedef void (*RangeFunction)(const void* func, int begin, int end);
+    void run(int begin, int end, int grainSize, RangeFunction function, const void* func);
+
+    class Impl;
+    Impl* impl;
+};
+
+}
+
+#endif
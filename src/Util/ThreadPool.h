@@ -14,6 +14,10 @@
 
 namespace cnoid {
 
+/**
+   \note Use TaskScheduler for data-parallel loops. Its worker threads are shared in the process
+   and the loop is balanced by work stealing.
+*/
 class ThreadPool
 {
 private:
@@ -63,17 +67,20 @@ public:
         }
     }
     
+    //! This function polls for a while and then blocks by wait() so that it does not occupy a core
     void waitLoop(){
-        while(true){
+        for(int i=0; i < 256; ++i){
             {
                 std::unique_lock<std::mutex> lock(mutex, std::try_to_lock_t());
                 if(lock.owns_lock()){
                     if(queue.empty() && numActiveThreads == 0){
-                        break;
+                        return;
                     }
                 }
             }
+            std::this_thread::yield();
         }
+        wait();
     }
 
     bool isRunning() {
@@ -0,0 +1,232 @@
+#include "Tracer.h"
+#include "UTF8.h"
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <chrono>
+#include <algorithm>
+#include <fstream>
+#include <fmt/format.h>
+#include "gettext.h"
+
+using namespace std;
+using namespace cnoid;
+
+std::atomic<bool> Tracer::isEnabled_(false);
+
+namespace {
+
+const int ZoneChunkSize = 4096;
+const int MaxNumZoneChunks = 1024;
+
+struct ZoneRecord
+{
+    const char* name;
+    const char* category;
+    int64_t beginTime;
+    int64_t endTime;
+};
+
+/**
+   The buffer is only written by the owner thread. The chunks are allocated when they are
+   first used and are never moved, so the zones can be read by the thread writing the trace
+   up to the number of the zones published with the release order.
+*/
+struct ThreadBuffer
+{
+    std::atomic<ZoneRecord*> chunks[MaxNumZoneChunks];
+    std::atomic<int> numZones;
+    std::atomic<int> generation;
+    int threadIndex;
+    string threadName; // protected by registryMutex
+
+    ThreadBuffer(int threadIndex)
+        : numZones(0), generation(-1), threadIndex(threadIndex) {
+        for(auto& chunk : chunks){
+            chunk.store(nullptr, std::memory_order_relaxed);
+        }
+    }
+    ~ThreadBuffer(){
+        for(auto& chunk : chunks){
+            delete[] chunk.load(std::memory_order_relaxed);
+        }
+    }
+};
+
+std::mutex registryMutex;
+vector<unique_ptr<ThreadBuffer>> threadBuffers;
+thread_local ThreadBuffer* currentThreadBuffer = nullptr;
+
+// The generation is incremented when a recording is started
+std::atomic<int> currentGeneration(0);
+std::atomic<int64_t> originTime(0);
+std::atomic<int> numDroppedZones_(0);
+
+int64_t getClockTime()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+ThreadBuffer* getThreadBuffer()
+{
+    if(!currentThreadBuffer){
+        std::lock_guard<std::mutex> lock(registryMutex);
+        threadBuffers.emplace_back(new ThreadBuffer(threadBuffers.size() + 1));
+        currentThreadBuffer = threadBuffers.back().get();
+    }
+    return currentThreadBuffer;
+}
+
+string escapeJsonString(const string& s)
+{
+    string escaped;
+    escaped.reserve(s.size());
+    for(auto c : s){
+        switch(c){
+        case '"':  escaped += "\\\""; break;
+        case '\\': escaped += "\\\\"; break;
+        case '\n': escaped += "\\n";  break;
+        case '\t': escaped += "\\t";  break;
+        default:
+            if(static_cast<unsigned char>(c) < 0x20){
+                escaped += fmt::format("\\u{:04x}", static_cast<int>(c));
+            } else {
+                escaped += c;
+            }
+            break;
+        }
+    }
+    return escaped;
+}
+
+}
+
+
+void Tracer::start()
+{
+    std::lock_guard<std::mutex> lock(registryMutex);
+    if(!isEnabled_){
+        numDroppedZones_ = 0;
+        originTime.store(getClockTime(), std::memory_order_relaxed);
+        currentGeneration.fetch_add(1, std::memory_order_release);
+        isEnabled_.store(true, std::memory_order_release);
+    }
+}
+
+
+void Tracer::stop()
+{
+    isEnabled_.store(false, std::memory_order_release);
+}
+
+
+void Tracer::setThreadName(const std::string& name)
+{
+    auto buffer = getThreadBuffer();
+    std::lock_guard<std::mutex> lock(registryMutex);
+    buffer->threadName = name;
+}
+
+
+int64_t Tracer::now()
+{
+    return getClockTime() - originTime.load(std::memory_order_relaxed);
+}
+
+
+void Tracer::addZone(const char* name, const char* category, int64_t beginTime, int64_t endTime)
+{
+    auto buffer = getThreadBuffer();
+
+    // The zones of the previous recording are discarded by the owner thread
+    const int generation = currentGeneration.load(std::memory_order_acquire);
+    if(buffer->generation.load(std::memory_order_relaxed) != generation){
+        buffer->numZones.store(0, std::memory_order_relaxed);
+        buffer->generation.store(generation, std::memory_order_release);
+    }
+
+    const int index = buffer->numZones.load(std::memory_order_relaxed);
+    if(index >= ZoneChunkSize * MaxNumZoneChunks){
+        numDroppedZones_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    auto& chunkPointer = buffer->chunks[index / ZoneChunkSize];
+    ZoneRecord* chunk = chunkPointer.load(std::memory_order_relaxed);
+    if(!chunk){
+        chunk = new ZoneRecord[ZoneChunkSize];
+        chunkPointer.store(chunk, std::memory_order_release);
+    }
+    chunk[index % ZoneChunkSize] = ZoneRecord{ name, category, beginTime, endTime };
+    buffer->numZones.store(index + 1, std::memory_order_release);
+}
+
+
+int Tracer::numDroppedZones()
+{
+    return numDroppedZones_;
+}
+
+
+bool Tracer::writeChromeTrace(const std::string& filename, std::string& out_errorMessage)
+{
+    out_errorMessage.clear();
+
+    std::lock_guard<std::mutex> lock(registryMutex);
+    const int generation = currentGeneration.load(std::memory_order_acquire);
+
+    ofstream file(fromUTF8(filename).c_str(), ios::out | ios::trunc);
+    if(!file){
+        out_errorMessage = fmt::format(_("The trace file \"{}\" cannot be opened."), filename);
+        return false;
+    }
+
+    file << "{\"traceEvents\":[\n";
+    bool isFirstEvent = true;
+    vector<ZoneRecord> zones;
+
+    for(auto& buffer : threadBuffers){
+        if(buffer->generation.load(std::memory_order_acquire) != generation){
+            continue;
+        }
+        const int numZones = buffer->numZones.load(std::memory_order_acquire);
+        if(numZones == 0){
+            continue;
+        }
+        zones.resize(numZones);
+        for(int i=0; i < numZones; ++i){
+            zones[i] = buffer->chunks[i / ZoneChunkSize].load(std::memory_order_acquire)[i % ZoneChunkSize];
+        }
+        // The outer zones are put before the inner ones when they begin at the same time
+        std::stable_sort(
+            zones.begin(), zones.end(),
+            [](const ZoneRecord& z1, const ZoneRecord& z2){
+                if(z1.beginTime != z2.beginTime){
+                    return z1.beginTime < z2.beginTime;
+                }
+                return z1.endTime > z2.endTime;
+            });
+
+        if(!buffer->threadName.empty()){
+            file << fmt::format(
+                "{}{{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":{},\"args\":{{\"name\":\"{}\"}}}}",
+                isFirstEvent ? "" : ",\n", buffer->threadIndex, escapeJsonString(buffer->threadName));
+            isFirstEvent = false;
+        }
+        for(auto& zone : zones){
+            file << fmt::format(
+                "{}{{\"name\":\"{}\",\"cat\":\"{}\",\"ph\":\"X\",\"ts\":{:.3f},\"dur\":{:.3f},\"pid\":1,\"tid\":{}}}",
+                isFirstEvent ? "" : ",\n",
+                escapeJsonString(zone.name), escapeJsonString(zone.category),
+                zone.beginTime / 1000.0, (zone.endTime - zone.beginTime) / 1000.0, buffer->threadIndex);
+            isFirstEvent = false;
+        }
+    }
+    file << "\n],\"displayTimeUnit\":\"ms\"}\n";
+
+    if(!file){
+        out_errorMessage = fmt::format(_("The trace cannot be written to \"{}\"."), filename);
+        return false;
+    }
+    return true;
+}
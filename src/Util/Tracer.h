@@ -0,0 +1,83 @@
+#ifndef CNOID_UTIL_TRACER_H
+#define CNOID_UTIL_TRACER_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+/**
+   This class records the zones of the code executed in the threads of the process so that the
+   timeline of the whole system can be examined. The recorded zones are written in the Chrome
+   trace event format, which can be viewed with chrome://tracing or Perfetto.
+
+   A zone is recorded by putting the CNOID_TRACE_ZONE macro at the beginning of a scope.
+   The zones are only checked by a relaxed atomic load while the recording is not started, so
+   the macros can be left in the code. Define CNOID_DISABLE_TRACE to remove them completely.
+
+   Each thread records the zones to its own buffer without any lock. The buffers are kept until
+   the next recording is started so that the zones can be written after the recording is stopped.
+*/
+class CNOID_EXPORT Tracer
+{
+public:
+    static bool isEnabled() { return isEnabled_.load(std::memory_order_relaxed); }
+
+    //! The zones recorded in the previous recording are discarded.
+    static void start();
+    static void stop();
+
+    //! The name is shown as the name of the calling thread in the timeline.
+    static void setThreadName(const std::string& name);
+
+    //! \return The time in nanoseconds from the start of the recording
+    static int64_t now();
+
+    /**
+       \param name The string must be alive until the zone is written. A string literal is
+       usually given.
+    */
+    static void addZone(const char* name, const char* category, int64_t beginTime, int64_t endTime);
+
+    //! \return The number of the zones that were not recorded because a buffer was full
+    static int numDroppedZones();
+
+    //! This function should be called after the recording is stopped.
+    static bool writeChromeTrace(const std::string& filename, std::string& out_errorMessage);
+
+    class Zone
+    {
+    public:
+        Zone(const char* name, const char* category)
+            : name(name), category(category), beginTime(isEnabled() ? now() : -1) { }
+        ~Zone(){
+            if(beginTime >= 0){
+                addZone(name, category, beginTime, now());
+            }
+        }
+        Zone(const Zone&) = delete;
+        Zone& operator=(const Zone&) = delete;
+    private:
+        const char* name;
+        const char* category;
+        int64_t beginTime;
+    };
+
+private:
+    static std::atomic<bool> isEnabled_;
+};
+
+}
+
+#ifdef CNOID_DISABLE_TRACE
+#define CNOID_TRACE_ZONE(name, category)
+#else
+#define CNOID_TRACE_ZONE_CONCAT_(x, y) x##y
+#define CNOID_TRACE_ZONE_CONCAT(x, y) CNOID_TRACE_ZONE_CONCAT_(x, y)
+#define CNOID_TRACE_ZONE(name, category) \
+    cnoid::Tracer::Zone CNOID_TRACE_ZONE_CONCAT(cnoidTraceZone, __LINE__)(name, category)
+#endif
+
+#endif
@@ -90,6 +90,53 @@ template<class TVector3Array> class Triangulator
         
         return contains;
     }
+
+    /**
+       Checks if the polygon is strictly convex. The corners must turn in the same direction
+       and the edge directions projected onto the polygon plane must change their signs at
+       most twice along each axis so that a self-intersecting polygon such as a pentagram
+       is not regarded as convex.
+    */
+    bool isConvex()
+    {
+        const int n = workPolygon.size();
+        for(int i=0; i < n; ++i){
+            if(calcConvexity(i) != CONVEX){
+                return false;
+            }
+        }
+        int axis;
+        ccs.cwiseAbs().maxCoeff(&axis);
+        const int ax = (axis + 1) % 3;
+        const int ay = (axis + 2) % 3;
+        int numSignChanges[2] = { 0, 0 };
+        int firstSigns[2] = { 0, 0 };
+        int prevSigns[2] = { 0, 0 };
+        for(int i=0; i < n; ++i){
+            const TVector3 d = workVertex((i + 1) % n) - workVertex(i);
+            const float components[2] = { static_cast<float>(d[ax]), static_cast<float>(d[ay]) };
+            for(int j=0; j < 2; ++j){
+                const int sign = (components[j] > 0.0f) ? 1 : ((components[j] < 0.0f) ? -1 : 0);
+                if(sign != 0){
+                    if(prevSigns[j] == 0){
+                        firstSigns[j] = sign;
+                    } else if(sign != prevSigns[j]){
+                        ++numSignChanges[j];
+                    }
+                    prevSigns[j] = sign;
+                }
+            }
+        }
+        for(int j=0; j < 2; ++j){
+            if(prevSigns[j] != firstSigns[j]){
+                ++numSignChanges[j];
+            }
+            if(numSignChanges[j] > 2){
+                return false;
+            }
+        }
+        return true;
+    }
     
 public:
     void setVertices(const TVector3Array& vertices)
@@ -132,6 +179,22 @@ public:
             ccs += (vertex(i) - o).cross(vertex((i+1) % numOrgVertices) - o);
         }
         
+        /*
+          A convex polygon is triangulated as a fan without searching the ears. The ear clipping
+          below clips the first vertex of the remaining polygon repeatedly for a convex polygon,
+          so the triangles are the same unless it skips a nearly flat corner. The ear clipping
+          is faster for the polygons with a few vertices.
+        */
+        if(numOrgVertices >= 6 && isConvex()){
+            const int last = numOrgVertices - 1;
+            for(int i=0; i < last - 1; ++i){
+                triangles_.push_back(last);
+                triangles_.push_back(i);
+                triangles_.push_back(i + 1);
+            }
+            return last - 1;
+        }
+        
         int numTriangles = 0;
         
         while(true) {
@@ -0,0 +1,67 @@
+/**
+   @file
+   @author Shin'ichiro Nakaoka
+*/
+
+#ifndef CNOID_UTIL_TRIPLE_BUFFER_H
+#define CNOID_UTIL_TRIPLE_BUFFER_H
+
+#include <atomic>
+
+namespace cnoid {
+
+/**
+   This class passes the latest value from a writer thread to a reader thread without locking.
+   The writer writes a value in the buffer given by writeBuffer() and publishes it by publish().
+   The reader obtains the latest published value by update() and readBuffer().
+   Each side always accesses a buffer owned by itself, so the writer never waits for the reader
+   and the reader never sees a value being written.
+*/
+template<class ElementType>
+class TripleBuffer
+{
+public:
+    TripleBuffer() {
+        clear();
+    }
+
+    /**
+       This function must not be called while the buffer is accessed by the other threads.
+    */
+    void clear() {
+        writeIndex = 0;
+        middle.store(1);
+        readIndex = 2;
+    }
+
+    ElementType& writeBuffer() { return buffers[writeIndex]; }
+
+    void publish() {
+        writeIndex = middle.exchange(writeIndex | UpdatedBit, std::memory_order_acq_rel) & IndexMask;
+    }
+
+    /**
+       @return true if a new value has been published since the last update
+    */
+    bool update() {
+        if(!(middle.load(std::memory_order_relaxed) & UpdatedBit)){
+            return false;
+        }
+        readIndex = middle.exchange(readIndex, std::memory_order_acq_rel) & IndexMask;
+        return true;
+    }
+
+    const ElementType& readBuffer() const { return buffers[readIndex]; }
+
+private:
+    enum { IndexMask = 3, UpdatedBit = 4 };
+    
+    ElementType buffers[3];
+    std::atomic<int> middle;
+    int writeIndex;
+    int readIndex;
+};
+
+}
+
+#endif
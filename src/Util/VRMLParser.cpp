@@ -333,6 +333,10 @@ public:
     ostream& os() { return *os_; }
     std::shared_ptr<EasyScanner> topScanner;
     EasyScanner* scanner; // current one
+    vector<float> floatBuf;
+    vector<double> doubleBuf;
+    vector<float>& numberBuf(float) { return floatBuf; }
+    vector<double>& numberBuf(double) { return doubleBuf; }
     VRMLProtoInstancePtr currentProtoInstance;
 
     bool protoInstanceActualNodeExtractionMode;
@@ -433,6 +437,7 @@ public:
     SFNode readSFNode(VRMLNodeCategory nodeCategory);
     void readMFNode(MFNode& out_nodes, VRMLNodeCategory nodeCategory);
     void readSFImage( SFImage& out_image );
+    template<class ArrayType> void readVectorArrayElements(ArrayType& out_array, const char* message);
 private:
     VRMLParserImpl(const VRMLParserImpl& self, const list<string>& ref);
     const list<string>* getAncestorPathsList() const {return &ancestorPathsList;}
@@ -2041,14 +2046,40 @@ void VRMLParserImpl::readMFInt32(MFInt32& out_value)
         if(!scanner->readChar('[')){
             out_value.push_back(scanner->readIntEx("illegal int value"));
         } else {
-            while(!scanner->readChar(']')){
-                out_value.push_back(scanner->readIntEx("illegal int value"));
+            scanner->readNumbers(out_value);
+            if(!scanner->readChar(']')){
+                scanner->throwException("illegal int value");
             }
         }
     }
 }
 
 
+/**
+   This function reads the elements of an array of fixed size vectors in the bracket at once so
+   that the numbers are scanned continuously without the per-element overhead.
+*/
+template<class ArrayType>
+void VRMLParserImpl::readVectorArrayElements(ArrayType& out_array, const char* message)
+{
+    typedef typename ArrayType::value_type VectorType;
+    typedef typename VectorType::Scalar Scalar;
+    const int n = VectorType::RowsAtCompileTime;
+
+    auto& buf = numberBuf(Scalar());
+    buf.clear();
+    scanner->readNumbers(buf);
+    if(buf.size() % n != 0 || !scanner->readChar(']')){
+        scanner->throwException(message);
+    }
+    const size_t numElements = buf.size() / n;
+    out_array.resize(numElements);
+    for(size_t i=0; i < numElements; ++i){
+        out_array[i] = Eigen::Map<const VectorType>(&buf[i * n]);
+    }
+}
+
+
 void VRMLParserImpl::readSFFloat(SFFloat& out_value)
 {
     if(scanner->readSymbol(F_IS)){
@@ -2068,8 +2099,9 @@ void VRMLParserImpl::readMFFloat(MFFloat& out_value)
         if(!scanner->readChar('[')){
             out_value.push_back(scanner->readDoubleEx("illegal float value"));
         } else {
-            while(!scanner->readChar(']')){
-                out_value.push_back(scanner->readDoubleEx("illegal float value"));
+            scanner->readNumbers(out_value);
+            if(!scanner->readChar(']')){
+                scanner->throwException("illegal float value");
             }
         }
     }
@@ -2105,9 +2137,7 @@ void VRMLParserImpl::readMFColor(MFColor& out_value)
         if(!scanner->readChar('[')){
             out_value.push_back(::readSFColor(scanner));
         } else {
-            while(!scanner->readChar(']')){
-                out_value.push_back(::readSFColor(scanner));
-            }
+            readVectorArrayElements(out_value, "illegal color element");
         }
     }
 }
@@ -2169,9 +2199,7 @@ void VRMLParserImpl::readMFVec2f(MFVec2f& out_value)
         if(!scanner->readChar('[')){
             out_value.push_back(::readSFVec2f(scanner));
         } else {
-            while(!scanner->readChar(']')){
-                out_value.push_back(::readSFVec2f(scanner));
-            }
+            readVectorArrayElements(out_value, "illegal vector element");
         }
     }
 }
@@ -2211,9 +2239,7 @@ void VRMLParserImpl::readMFVec2s(MFVec2s& out_value)
         if(!scanner->readChar('[')){
             out_value.push_back(::readSFVec2s(scanner));
         } else {
-            while(!scanner->readChar(']')){
-                out_value.push_back(::readSFVec2s(scanner));
-            }
+            readVectorArrayElements(out_value, "illegal vector element");
         }
     }
 }
@@ -2248,9 +2274,7 @@ void VRMLParserImpl::readMFVec3f(MFVec3f& out_value)
         if(!scanner->readChar('[')){
             out_value.push_back(::readSFVec3f(scanner));
         } else {
-            while(!scanner->readChar(']')){
-                out_value.push_back(::readSFVec3f(scanner));
-            }
+            readVectorArrayElements(out_value, "illegal vector element");
         }
     }
 }
@@ -2290,9 +2314,7 @@ void VRMLParserImpl::readMFVec3s(MFVec3s& out_value)
         if(!scanner->readChar('[')){
             out_value.push_back(::readSFVec3s(scanner));
         } else {
-            while(!scanner->readChar(']')){
-                out_value.push_back(::readSFVec3s(scanner));
-            }
+            readVectorArrayElements(out_value, "illegal vector element");
         }
     }
 }
@@ -11,6 +11,7 @@
 #include "MeshFilter.h"
 #include "MeshGenerator.h"
 #include "ImageIO.h"
+#include "ImageCache.h"
 #include "SceneLoader.h"
 #include "Exception.h"
 #include "NullOut.h"
@@ -846,6 +847,16 @@ SgMeshPtr VRMLToSGConverterImpl::createMeshFromElevationGrid(VRMLElevationGrid*
     mesh->setCreaseAngle(grid->creaseAngle);
     mesh->setSolid(grid->solid);
 
+    if(grid->ccw && grid->xDimension >= 2 && grid->zDimension >= 2){
+        auto heightField = std::make_shared<SgMesh::HeightField>();
+        heightField->xDimension = grid->xDimension;
+        heightField->zDimension = grid->zDimension;
+        heightField->xSpacing = grid->xSpacing;
+        heightField->zSpacing = grid->zSpacing;
+        heightField->heights.assign(grid->height.begin(), grid->height.end());
+        mesh->setHeightField(heightField);
+    }
+
     if(isNormalGenerationEnabled){
         meshFilter.generateNormals(mesh, grid->creaseAngle);
     }
@@ -1225,7 +1236,6 @@ SgTexture* VRMLToSGConverterImpl::createTexture(VRMLTexture* vt)
     VRMLImageTexturePtr imageTextureNode = dynamic_node_cast<VRMLImageTexture>(vt);
     if(imageTextureNode){
         SgImagePtr image;
-        SgImagePtr imageForLoading;
         const MFString& filepaths = imageTextureNode->filepath;
         for(size_t i=0; i < filepaths.size(); ++i){
             auto& filepath = filepaths[i];
@@ -1234,16 +1244,11 @@ SgTexture* VRMLToSGConverterImpl::createTexture(VRMLTexture* vt)
                 if(p != imagePathToSgImageMap.end()){
                     image = p->second;
                     break;
-                } else {
-                    if(!imageForLoading){
-                        imageForLoading = new SgImage;
-                    }
-                    if(imageIO.load(imageForLoading->image(), filepath, os())){
-                        image = imageForLoading;
-                        image->setUri(imageTextureNode->url[i], filepath);
-                        imagePathToSgImageMap[filepath] = image;
-                        break;
-                    }
+                } else if(auto loaded = ImageCache::instance()->load(filepath, imageIO, os())){
+                    image = new SgImage(loaded);
+                    image->setUri(imageTextureNode->url[i], filepath);
+                    imagePathToSgImageMap[filepath] = image;
+                    break;
                 }
             }
         }
@@ -5,6 +5,7 @@
 #include "ValueTree.h"
 #include "UTF8.h"
 #include "MathUtil.h"
+#include "strtofloat.h"
 #include <stack>
 #include <iostream>
 #include <yaml.h>
@@ -152,10 +153,10 @@ ValueNode& ValueNode::operator=(const ValueNode&)
 bool ValueNode::read(int &out_value) const
 {
     if(isScalar()){
-        const char* nptr = &(static_cast<const ScalarNode* const>(this)->stringValue_[0]);
-        char* endptr;
-        out_value = strtol(nptr, &endptr, 10);
-        if(endptr > nptr){
+        auto& s = static_cast<const ScalarNode*>(this)->stringValue_;
+        long value;
+        if(parseInt(s.data(), s.data() + s.size(), value) > s.data()){
+            out_value = value;
             return true;
         }
     }
@@ -171,11 +172,10 @@ int ValueNode::toInt() const
 
     const ScalarNode* const scalar = static_cast<const ScalarNode* const>(this);
     
-    const char* nptr = &(scalar->stringValue_[0]);
-    char* endptr;
-    const int value = strtol(nptr, &endptr, 10);
+    auto& s = scalar->stringValue_;
+    long value;
 
-    if(endptr == nptr){
+    if(parseInt(s.data(), s.data() + s.size(), value) == s.data()){
         ScalarTypeMismatchException ex;
         ex.setPosition(line(), column());
         ex.setMessage(fmt::format(_("The value \"{}\" must be an integer value"), scalar->stringValue_));
@@ -189,10 +189,8 @@ int ValueNode::toInt() const
 bool ValueNode::read(double& out_value) const
 {
     if(isScalar()){
-        const char* nptr = &(static_cast<const ScalarNode* const>(this)->stringValue_[0]);
-        char* endptr;
-        out_value = strtod(nptr, &endptr);
-        if(endptr > nptr){
+        auto& s = static_cast<const ScalarNode*>(this)->stringValue_;
+        if(parseFloat(s.data(), s.data() + s.size(), out_value) > s.data()){
             return true;
         }
     }
@@ -203,10 +201,8 @@ bool ValueNode::read(double& out_value) const
 bool ValueNode::read(float& out_value) const
 {
     if(isScalar()){
-        const char* nptr = &(static_cast<const ScalarNode* const>(this)->stringValue_[0]);
-        char* endptr;
-        out_value = strtof(nptr, &endptr);
-        if(endptr > nptr){
+        auto& s = static_cast<const ScalarNode*>(this)->stringValue_;
+        if(parseFloat(s.data(), s.data() + s.size(), out_value) > s.data()){
             return true;
         }
     }
@@ -222,11 +218,10 @@ double ValueNode::toDouble() const
 
     const ScalarNode* const scalar = static_cast<const ScalarNode* const>(this);
 
-    const char* nptr = &(scalar->stringValue_[0]);
-    char* endptr;
-    const double value = strtod(nptr, &endptr);
+    auto& s = scalar->stringValue_;
+    double value;
 
-    if(endptr == nptr){
+    if(parseFloat(s.data(), s.data() + s.size(), value) == s.data()){
         ScalarTypeMismatchException ex;
         ex.setPosition(line(), column());
         ex.setMessage(fmt::format(_("The value \"{}\" must be a floating point number"), scalar->stringValue_));
@@ -245,11 +240,10 @@ float ValueNode::toFloat() const
 
     const ScalarNode* const scalar = static_cast<const ScalarNode* const>(this);
 
-    const char* nptr = &(scalar->stringValue_[0]);
-    char* endptr;
-    const float value = strtof(nptr, &endptr);
+    auto& s = scalar->stringValue_;
+    float value;
 
-    if(endptr == nptr){
+    if(parseFloat(s.data(), s.data() + s.size(), value) == s.data()){
         ScalarTypeMismatchException ex;
         ex.setPosition(line(), column());
         ex.setMessage(fmt::format(_("The value \"{}\" must be a floating point number"), scalar->stringValue_));
@@ -458,6 +452,7 @@ Mapping::Mapping(int line, int column)
     column_ = column;
     mode = READ_MODE;
     indexCounter = 0;
+    keyStringStyle_ = PLAIN_STRING;
     isFlowStyle_ = false;
     floatingNumberFormat_ = defaultFloatingNumberFormat;
 }
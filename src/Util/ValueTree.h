@@ -622,6 +622,7 @@ private:
 
     friend class Mapping;
     friend class YAMLReaderImpl;
+    friend class CompactRowListing;
 };
 
 
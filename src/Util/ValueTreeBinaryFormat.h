@@ -0,0 +1,68 @@
+#ifndef CNOID_UTIL_VALUE_TREE_BINARY_FORMAT_H
+#define CNOID_UTIL_VALUE_TREE_BINARY_FORMAT_H
+
+#include <string>
+#include <cstdint>
+#include <cstring>
+
+/*
+  The binary format of value trees written by YAMLWriter::writeBinary and read by YAMLReader.
+
+  The data begins with the magic number, the version number and the key table, which stores
+  each distinct key of the mappings only once. The node tree follows it. Each node begins with
+  the tag byte and the line and column numbers. The values of a scalar node are its string,
+  and the values of a mapping node are the pairs of a key index and a node. The integers
+  following the magic number are unsigned ones encoded in the LEB128 format.
+*/
+
+namespace cnoid {
+
+namespace valueTreeBinary {
+
+constexpr char Magic[] = { 'C', 'N', 'V', 'T' };
+constexpr uint64_t Version = 1;
+
+enum NodeTag : uint8_t {
+    ScalarTag = 1,
+    MappingTag = 2,
+    ListingTag = 3,
+    TypeMask = 3,
+    // Flow style of a mapping or a listing
+    FlowStyleBit = 4,
+    // The string style of a scalar or the key string style of a mapping
+    StringStyleShift = 4
+};
+
+inline bool hasMagic(const char* data, size_t size)
+{
+    return size >= sizeof(Magic) && std::memcmp(data, Magic, sizeof(Magic)) == 0;
+}
+
+inline void writeUnsigned(std::string& out, uint64_t value)
+{
+    while(value >= 0x80){
+        out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+//! \return false if the data ends before the value is completed
+inline bool readUnsigned(const char*& pos, const char* end, uint64_t& out_value)
+{
+    out_value = 0;
+    for(int shift = 0; shift < 64 && pos != end; shift += 7){
+        uint8_t byte = static_cast<uint8_t>(*pos++);
+        out_value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if(!(byte & 0x80)){
+            return true;
+        }
+    }
+    return false;
+}
+
+}
+
+}
+
+#endif
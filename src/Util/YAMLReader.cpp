@@ -3,6 +3,7 @@
 */
 
 #include "YAMLReader.h"
+#include "ValueTreeBinaryFormat.h"
 #include "UTF8.h"
 #include <cerrno>
 #include <stack>
@@ -10,6 +11,7 @@
 #include <yaml.h>
 #include <fmt/format.h>
 #include <unordered_map>
+#include <memory>
 #include "gettext.h"
 
 using namespace std;
@@ -17,7 +19,24 @@ using namespace cnoid;
 using fmt::format;
 
 namespace {
+
 const bool debugTrace = false;
+
+class CompactRowListingBuilder : public YAMLReader::EventHandler
+{
+public:
+    CompactRowListingPtr listing;
+    int depth;
+
+    virtual ValueNode* onValueStart(const std::string& key, int line, int column) override;
+    virtual void onMappingStart(int line, int column) override;
+    virtual void onListingStart(int line, int column) override;
+    virtual void onListingEnd() override;
+    virtual void onScalar(const char* value, size_t length, int line, int column) override;
+    virtual void onValueEnd() override;
+    void throwInvalidStructureException(int line, int column);
+};
+
 }
 
 namespace cnoid {
@@ -45,7 +64,21 @@ public:
     void onScalar(yaml_event_t& event);
     void onAlias(yaml_event_t& event);
 
+    bool processEventByHandler(yaml_event_t& event);
+    void finishHandlerValue(yaml_event_t& event);
+
+    bool readBinary(const char* data, size_t size);
+    uint64_t readBinaryUnsigned();
+    void readBinaryNodeHeader(int& out_tag, int& out_line, int& out_column);
+    ValueNode* readBinaryNode();
+    ValueNode* readBinaryHandlerValue(YAMLReader::EventHandler* handler, const string& key);
+    void replayBinaryNode(YAMLReader::EventHandler* handler);
+    [[noreturn]] void throwBrokenBinaryException();
+
     static ScalarNode* createScalar(const yaml_event_t& event);
+    static void setPosition(ValueNode* node, int line, int column);
+    static void setScalarValue(ScalarNode* scalar, const char* value, size_t length);
+    static vector<ValueNodePtr>& listingElements(Listing* listing);
 
     YAMLReader* self;
 
@@ -73,6 +106,17 @@ public:
     bool isRegularMultiListingExpected;
     vector<int> expectedListingSizes;
 
+    unordered_map<string, YAMLReader::EventHandler*> eventHandlers;
+    vector<unique_ptr<YAMLReader::EventHandler>> ownedEventHandlers;
+    YAMLReader::EventHandler* pendingEventHandler;
+    YAMLReader::EventHandler* currentEventHandler;
+    ValueNodePtr handlerValueNode;
+    int handlerDepth;
+
+    const char* binaryPos;
+    const char* binaryEnd;
+    vector<string> binaryKeys;
+
     string errorMessage;
 };
 
@@ -92,6 +136,9 @@ YAMLReaderImpl::YAMLReaderImpl(YAMLReader* self)
     mappingFactory = new YAMLReader::MappingFactory<Mapping>();
     currentDocumentIndex = 0;
     isRegularMultiListingExpected = false;
+    pendingEventHandler = nullptr;
+    currentEventHandler = nullptr;
+    handlerDepth = 0;
 }
 
 
@@ -125,6 +172,24 @@ void YAMLReaderImpl::setMappingFactory(YAMLReader::MappingFactoryBase* factory)
 }
 
 
+void YAMLReader::setEventHandler(const std::string& key, EventHandler* handler)
+{
+    if(handler){
+        impl->eventHandlers[key] = handler;
+    } else {
+        impl->eventHandlers.erase(key);
+    }
+}
+
+
+void YAMLReader::setCompactRowListingKey(const std::string& key)
+{
+    auto builder = new CompactRowListingBuilder;
+    impl->ownedEventHandlers.emplace_back(builder);
+    setEventHandler(key, builder);
+}
+
+
 void YAMLReader::expectRegularMultiListing()
 {
     impl->isRegularMultiListingExpected = true;
@@ -142,6 +207,9 @@ void YAMLReaderImpl::clearDocuments()
     while(!nodeStack.empty()){
         nodeStack.pop();
     }
+    pendingEventHandler = nullptr;
+    currentEventHandler = nullptr;
+    handlerValueNode.reset();
     anchorMap.clear();
     documents.clear();
 }
@@ -172,9 +240,25 @@ bool YAMLReaderImpl::load(const std::string& filename)
     if(file==NULL){
         errorMessage = strerror(errno);
     } else {
-        yaml_parser_set_input_file(&parser, file);
+        char magic[sizeof(valueTreeBinary::Magic)];
+        size_t magicSize = fread(magic, 1, sizeof(magic), file);
         try {
-            result = parse();
+            if(valueTreeBinary::hasMagic(magic, magicSize)){
+                string data;
+                if(fseek(file, 0, SEEK_END) == 0){
+                    long size = ftell(file);
+                    if(size > 0){
+                        data.resize(size);
+                        rewind(file);
+                        data.resize(fread(&data[0], 1, size, file));
+                    }
+                }
+                result = readBinary(data.data(), data.size());
+            } else {
+                rewind(file);
+                yaml_parser_set_input_file(&parser, file);
+                result = parse();
+            }
         }
         catch(const ValueNode::Exception& ex){
             errorMessage = ex.message();
@@ -213,9 +297,13 @@ bool YAMLReaderImpl::parse(const char* input, size_t size)
 
     bool result = false;
     
-    yaml_parser_set_input_string(&parser, (const unsigned char*)input, size);
     try {
-        result = parse();
+        if(valueTreeBinary::hasMagic(input, size)){
+            result = readBinary(input, size);
+        } else {
+            yaml_parser_set_input_string(&parser, (const unsigned char*)input, size);
+            result = parse();
+        }
     }
     catch(const ValueNode::Exception& ex){
         errorMessage = ex.message();
@@ -239,6 +327,21 @@ bool YAMLReaderImpl::parse()
             goto error;
         }
 
+        if(pendingEventHandler || currentEventHandler){
+            bool processed;
+            try {
+                processed = processEventByHandler(event);
+            }
+            catch(...){
+                yaml_event_delete(&event);
+                throw;
+            }
+            if(processed){
+                yaml_event_delete(&event);
+                continue;
+            }
+        }
+
         switch(event.type){
             
         case YAML_STREAM_START_EVENT:
@@ -303,6 +406,293 @@ error:
 }
 
 
+bool YAMLReaderImpl::processEventByHandler(yaml_event_t& event)
+{
+    const yaml_mark_t& mark = event.start_mark;
+
+    if(!currentEventHandler){
+        auto handler = pendingEventHandler;
+        pendingEventHandler = nullptr;
+        if(event.type == YAML_ALIAS_EVENT){
+            // The aliased node is stored as usual
+            return false;
+        }
+        handlerValueNode = handler->onValueStart(nodeStack.top().key, mark.line, mark.column);
+        if(handlerValueNode){
+            setPosition(handlerValueNode, mark.line, mark.column);
+        }
+        currentEventHandler = handler;
+        handlerDepth = 0;
+    }
+
+    auto handler = currentEventHandler;
+    
+    switch(event.type){
+    case YAML_MAPPING_START_EVENT:
+        ++handlerDepth;
+        handler->onMappingStart(mark.line, mark.column);
+        break;
+    case YAML_MAPPING_END_EVENT:
+        handler->onMappingEnd();
+        --handlerDepth;
+        break;
+    case YAML_SEQUENCE_START_EVENT:
+        ++handlerDepth;
+        handler->onListingStart(mark.line, mark.column);
+        break;
+    case YAML_SEQUENCE_END_EVENT:
+        handler->onListingEnd();
+        --handlerDepth;
+        break;
+    case YAML_SCALAR_EVENT:
+        handler->onScalar(
+            (char*)event.data.scalar.value, event.data.scalar.length, mark.line, mark.column);
+        break;
+    default: {
+        ValueNode::SyntaxException ex;
+        ex.setMessage(_("An alias cannot be used in a value read by an event handler"));
+        ex.setPosition(mark.line, mark.column);
+        throw ex;
+    }
+    }
+
+    if(handlerDepth == 0){
+        finishHandlerValue(event);
+    }
+    
+    return true;
+}
+
+
+void YAMLReaderImpl::finishHandlerValue(yaml_event_t& event)
+{
+    currentEventHandler->onValueEnd();
+    currentEventHandler = nullptr;
+    if(handlerValueNode){
+        addNode(handlerValueNode, event);
+        handlerValueNode.reset();
+    } else {
+        nodeStack.top().key.clear();
+    }
+}
+
+
+/**
+   The binary value tree written by YAMLWriter::writeBinary is read into the nodes without the
+   YAML parser. The key strings of the mappings are decoded only once from the key table.
+   The event handlers receive the events replayed from the data.
+*/
+bool YAMLReaderImpl::readBinary(const char* data, size_t size)
+{
+    binaryPos = data + sizeof(valueTreeBinary::Magic);
+    binaryEnd = data + size;
+
+    if(readBinaryUnsigned() != valueTreeBinary::Version){
+        errorMessage = _("The version of the binary value tree is not supported");
+        return false;
+    }
+
+    binaryKeys.clear();
+    uint64_t numKeys = readBinaryUnsigned();
+    if(numKeys > size){
+        throwBrokenBinaryException();
+    }
+    binaryKeys.reserve(numKeys);
+    for(uint64_t i=0; i < numKeys; ++i){
+        uint64_t length = readBinaryUnsigned();
+        if(length == 0 || length > static_cast<uint64_t>(binaryEnd - binaryPos)){
+            throwBrokenBinaryException();
+        }
+        binaryKeys.emplace_back(binaryPos, length);
+        binaryPos += length;
+    }
+
+    ValueNodePtr node = readBinaryNode();
+    documents.push_back(node);
+    binaryKeys.clear();
+
+    return true;
+}
+
+
+uint64_t YAMLReaderImpl::readBinaryUnsigned()
+{
+    uint64_t value;
+    if(!valueTreeBinary::readUnsigned(binaryPos, binaryEnd, value)){
+        throwBrokenBinaryException();
+    }
+    return value;
+}
+
+
+void YAMLReaderImpl::readBinaryNodeHeader(int& out_tag, int& out_line, int& out_column)
+{
+    if(binaryPos == binaryEnd){
+        throwBrokenBinaryException();
+    }
+    out_tag = static_cast<uint8_t>(*binaryPos++);
+    // The zero-based numbers are used in the reader
+    out_line = static_cast<int>(readBinaryUnsigned()) - 1;
+    out_column = static_cast<int>(readBinaryUnsigned()) - 1;
+}
+
+
+ValueNode* YAMLReaderImpl::readBinaryNode()
+{
+    using namespace valueTreeBinary;
+
+    int tag, line, column;
+    readBinaryNodeHeader(tag, line, column);
+    const int style = tag >> StringStyleShift;
+    if(style > FOLDED_STRING){
+        throwBrokenBinaryException();
+    }
+
+    switch(tag & TypeMask){
+
+    case ScalarTag: {
+        uint64_t length = readBinaryUnsigned();
+        if(length > static_cast<uint64_t>(binaryEnd - binaryPos)){
+            throwBrokenBinaryException();
+        }
+        auto scalar = new ScalarNode(binaryPos, length, static_cast<StringStyle>(style));
+        binaryPos += length;
+        setPosition(scalar, line, column);
+        return scalar;
+    }
+
+    case MappingTag: {
+        MappingPtr mapping = mappingFactory->create(line, column);
+        mapping->setFlowStyle(tag & FlowStyleBit);
+        mapping->setKeyQuoteStyle(static_cast<StringStyle>(style));
+        uint64_t n = readBinaryUnsigned();
+        for(uint64_t i=0; i < n; ++i){
+            uint64_t keyIndex = readBinaryUnsigned();
+            if(keyIndex >= binaryKeys.size()){
+                throwBrokenBinaryException();
+            }
+            const string& key = binaryKeys[keyIndex];
+            ValueNodePtr node;
+            YAMLReader::EventHandler* handler = nullptr;
+            if(!eventHandlers.empty()){
+                auto p = eventHandlers.find(key);
+                if(p != eventHandlers.end()){
+                    handler = p->second;
+                }
+            }
+            if(handler){
+                node = readBinaryHandlerValue(handler, key);
+            } else {
+                node = readBinaryNode();
+            }
+            if(node){
+                mapping->insert(key, node);
+            }
+        }
+        return mapping.retn();
+    }
+
+    case ListingTag: {
+        ListingPtr listing = new Listing(line, column);
+        listing->setFlowStyle(tag & FlowStyleBit);
+        uint64_t n = readBinaryUnsigned();
+        // Each node takes three bytes at least
+        if(n > static_cast<uint64_t>(binaryEnd - binaryPos) / 3){
+            throwBrokenBinaryException();
+        }
+        auto& elements = listingElements(listing);
+        elements.reserve(n);
+        for(uint64_t i=0; i < n; ++i){
+            elements.push_back(readBinaryNode());
+        }
+        return listing.retn();
+    }
+
+    default:
+        throwBrokenBinaryException();
+    }
+}
+
+
+ValueNode* YAMLReaderImpl::readBinaryHandlerValue(YAMLReader::EventHandler* handler, const string& key)
+{
+    // Peek the position of the value
+    int tag, line, column;
+    const char* valuePos = binaryPos;
+    readBinaryNodeHeader(tag, line, column);
+    binaryPos = valuePos;
+
+    ValueNodePtr node = handler->onValueStart(key, line, column);
+    if(node){
+        setPosition(node, line, column);
+    }
+    replayBinaryNode(handler);
+    handler->onValueEnd();
+
+    return node.retn();
+}
+
+
+void YAMLReaderImpl::replayBinaryNode(YAMLReader::EventHandler* handler)
+{
+    using namespace valueTreeBinary;
+
+    int tag, line, column;
+    readBinaryNodeHeader(tag, line, column);
+
+    switch(tag & TypeMask){
+
+    case ScalarTag: {
+        uint64_t length = readBinaryUnsigned();
+        if(length > static_cast<uint64_t>(binaryEnd - binaryPos)){
+            throwBrokenBinaryException();
+        }
+        handler->onScalar(binaryPos, length, line, column);
+        binaryPos += length;
+        break;
+    }
+
+    case MappingTag: {
+        handler->onMappingStart(line, column);
+        uint64_t n = readBinaryUnsigned();
+        for(uint64_t i=0; i < n; ++i){
+            uint64_t keyIndex = readBinaryUnsigned();
+            if(keyIndex >= binaryKeys.size()){
+                throwBrokenBinaryException();
+            }
+            // The position of the key is not stored, so the position of the mapping is given
+            const string& key = binaryKeys[keyIndex];
+            handler->onScalar(key.data(), key.size(), line, column);
+            replayBinaryNode(handler);
+        }
+        handler->onMappingEnd();
+        break;
+    }
+
+    case ListingTag: {
+        handler->onListingStart(line, column);
+        uint64_t n = readBinaryUnsigned();
+        for(uint64_t i=0; i < n; ++i){
+            replayBinaryNode(handler);
+        }
+        handler->onListingEnd();
+        break;
+    }
+
+    default:
+        throwBrokenBinaryException();
+    }
+}
+
+
+void YAMLReaderImpl::throwBrokenBinaryException()
+{
+    ValueNode::Exception ex;
+    ex.setMessage(_("The binary value tree is broken"));
+    throw ex;
+}
+
+
 void YAMLReaderImpl::popNode(yaml_event_t& event)
 {
     ValueNodePtr current = nodeStack.top().node;
@@ -498,6 +888,12 @@ void YAMLReaderImpl::onScalar(yaml_event_t& event)
                 ex.setPosition(start_mark.line, start_mark.column);
                 throw ex;
             }
+            if(!eventHandlers.empty()){
+                auto p = eventHandlers.find(info.key);
+                if(p != eventHandlers.end()){
+                    pendingEventHandler = p->second;
+                }
+            }
         } else {
             scalar = createScalar(event);
         }
@@ -545,6 +941,25 @@ ScalarNode* YAMLReaderImpl::createScalar(const yaml_event_t& event)
 }
 
 
+void YAMLReaderImpl::setPosition(ValueNode* node, int line, int column)
+{
+    node->line_ = line;
+    node->column_ = column;
+}
+
+
+void YAMLReaderImpl::setScalarValue(ScalarNode* scalar, const char* value, size_t length)
+{
+    scalar->stringValue_.assign(value, length);
+}
+
+
+vector<ValueNodePtr>& YAMLReaderImpl::listingElements(Listing* listing)
+{
+    return listing->values;
+}
+
+
 void YAMLReaderImpl::onAlias(yaml_event_t& event)
 {
     if(debugTrace){
@@ -630,3 +1045,220 @@ const std::string& YAMLReader::errorMessage()
 {
     return impl->errorMessage;
 }
+
+
+YAMLReader::EventHandler::~EventHandler()
+{
+
+}
+
+
+void YAMLReader::EventHandler::onMappingStart(int /* line */, int /* column */)
+{
+
+}
+
+
+void YAMLReader::EventHandler::onMappingEnd()
+{
+
+}
+
+
+void YAMLReader::EventHandler::onListingStart(int /* line */, int /* column */)
+{
+
+}
+
+
+void YAMLReader::EventHandler::onListingEnd()
+{
+
+}
+
+
+void YAMLReader::EventHandler::onScalar(const char* /* value */, size_t /* length */, int /* line */, int /* column */)
+{
+
+}
+
+
+void YAMLReader::EventHandler::onValueEnd()
+{
+
+}
+
+
+ValueNode* CompactRowListingBuilder::onValueStart(const std::string& /* key */, int /* line */, int /* column */)
+{
+    listing = new CompactRowListing;
+    depth = 0;
+    return listing;
+}
+
+
+void CompactRowListingBuilder::onMappingStart(int line, int column)
+{
+    throwInvalidStructureException(line, column);
+}
+
+
+void CompactRowListingBuilder::onListingStart(int line, int column)
+{
+    ++depth;
+    if(depth == 2){
+        listing->startRow(line, column);
+    } else if(depth == 3){
+        listing->startElementListing();
+    } else if(depth > 3){
+        throwInvalidStructureException(line, column);
+    }
+}
+
+
+void CompactRowListingBuilder::onListingEnd()
+{
+    if(depth == 3){
+        listing->endElementListing();
+    }
+    --depth;
+}
+
+
+void CompactRowListingBuilder::onScalar(const char* value, size_t length, int line, int column)
+{
+    if(depth < 2){
+        throwInvalidStructureException(line, column);
+    }
+    listing->addScalar(value, length);
+}
+
+
+void CompactRowListingBuilder::onValueEnd()
+{
+    listing.reset();
+}
+
+
+void CompactRowListingBuilder::throwInvalidStructureException(int line, int column)
+{
+    ValueNode::SyntaxException ex;
+    ex.setMessage(_("The value must be a listing of listings of scalars or listings of scalars"));
+    ex.setPosition(line, column);
+    throw ex;
+}
+
+
+CompactRowListing::CompactRowListing()
+{
+    scalarOffsets.push_back(0);
+    elementScalarOffsets.push_back(0);
+    rowElementOffsets.push_back(0);
+    isInElementListing = false;
+}
+
+
+CompactRowListing::CompactRowListing(const CompactRowListing& org)
+    : Listing(org),
+      text(org.text),
+      scalarOffsets(org.scalarOffsets),
+      elementScalarOffsets(org.elementScalarOffsets),
+      isElementListing(org.isElementListing),
+      rowElementOffsets(org.rowElementOffsets),
+      rowLines(org.rowLines),
+      rowColumns(org.rowColumns),
+      isInElementListing(false)
+{
+
+}
+
+
+ValueNode* CompactRowListing::clone() const
+{
+    return new CompactRowListing(*this);
+}
+
+
+void CompactRowListing::startRow(int line, int column)
+{
+    rowElementOffsets.push_back(rowElementOffsets.back());
+    rowLines.push_back(line);
+    rowColumns.push_back(column);
+}
+
+
+void CompactRowListing::startElementListing()
+{
+    isInElementListing = true;
+    elementScalarOffsets.push_back(elementScalarOffsets.back());
+    isElementListing.push_back(true);
+    ++rowElementOffsets.back();
+}
+
+
+void CompactRowListing::endElementListing()
+{
+    isInElementListing = false;
+}
+
+
+void CompactRowListing::addScalar(const char* value, size_t length)
+{
+    text.insert(text.end(), value, value + length);
+    scalarOffsets.push_back(text.size());
+    if(!isInElementListing){
+        elementScalarOffsets.push_back(elementScalarOffsets.back());
+        isElementListing.push_back(false);
+        ++rowElementOffsets.back();
+    }
+    ++elementScalarOffsets.back();
+}
+
+
+const Listing& CompactRowListing::row(int index) const
+{
+    if(!rowListing){
+        rowListing = new Listing;
+    }
+    Listing& rowNode = *rowListing;
+    const int line = rowLines[index];
+    const int column = rowColumns[index];
+    YAMLReaderImpl::setPosition(&rowNode, line, column);
+
+    auto setScalar = [&](ValueNodePtr& node, int scalarIndex){
+        if(!node || !node->isScalar()){
+            node = new ScalarNode(string());
+        }
+        const int offset = scalarOffsets[scalarIndex];
+        YAMLReaderImpl::setScalarValue(
+            static_cast<ScalarNode*>(node.get()), &text[0] + offset, scalarOffsets[scalarIndex + 1] - offset);
+        YAMLReaderImpl::setPosition(node, line, column);
+    };
+
+    // The nodes of the previous row are reused when the rows have the same structure
+    const int elementBegin = rowElementOffsets[index];
+    const int numElements = rowElementOffsets[index + 1] - elementBegin;
+    auto& elements = YAMLReaderImpl::listingElements(&rowNode);
+    elements.resize(numElements);
+    for(int i=0; i < numElements; ++i){
+        const int elementIndex = elementBegin + i;
+        const int scalarBegin = elementScalarOffsets[elementIndex];
+        ValueNodePtr& element = elements[i];
+        if(!isElementListing[elementIndex]){
+            setScalar(element, scalarBegin);
+        } else {
+            if(!element || !element->isListing()){
+                element = new Listing;
+            }
+            YAMLReaderImpl::setPosition(element, line, column);
+            auto& elementListing = YAMLReaderImpl::listingElements(static_cast<Listing*>(element.get()));
+            const int numScalars = elementScalarOffsets[elementIndex + 1] - scalarBegin;
+            elementListing.resize(numScalars);
+            for(int j=0; j < numScalars; ++j){
+                setScalar(elementListing[j], scalarBegin + j);
+            }
+        }
+    }
+
+    return rowNode;
+}
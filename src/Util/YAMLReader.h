@@ -6,12 +6,52 @@
 #define CNOID_UTIL_YAML_READER_H
 
 #include "ValueTree.h"
+#include <vector>
 #include "exportdecl.h"
 
 namespace cnoid {
 
 class YAMLReaderImpl;
 
+/**
+   This class stores a listing of rows, each of which is a listing of scalars or a listing of
+   listings of scalars, such as the frames of a sequence, without creating a node for each
+   scalar. The row function returns a temporary listing node whose elements are overwritten
+   every time the function is called, so that the code reading a listing node can read the rows.
+*/
+class CNOID_EXPORT CompactRowListing : public Listing
+{
+public:
+    CompactRowListing();
+
+    virtual ValueNode* clone() const override;
+
+    int numRows() const { return static_cast<int>(rowElementOffsets.size()) - 1; }
+    const Listing& row(int index) const;
+
+    void startRow(int line, int column);
+    void startElementListing();
+    void endElementListing();
+    void addScalar(const char* value, size_t length);
+
+private:
+    CompactRowListing(const CompactRowListing& org);
+
+    std::vector<char> text;
+    // The scalar of index i is the range [scalarOffsets[i], scalarOffsets[i+1]) of the text
+    std::vector<int> scalarOffsets;
+    // The element of index i has the scalars [elementScalarOffsets[i], elementScalarOffsets[i+1])
+    std::vector<int> elementScalarOffsets;
+    std::vector<bool> isElementListing;
+    std::vector<int> rowElementOffsets;
+    std::vector<int> rowLines;
+    std::vector<int> rowColumns;
+    bool isInElementListing;
+    mutable ref_ptr<Listing> rowListing;
+};
+
+typedef ref_ptr<CompactRowListing> CompactRowListingPtr;
+
 class CNOID_EXPORT YAMLReader
 {
     class MappingFactoryBase {
@@ -33,6 +73,38 @@ public:
     template <class TMapping> inline void setMappingClass() {
         setMappingFactory(new MappingFactory<TMapping>());
     }
+
+    /**
+       SAX-style interface to receive the parse events of the values of the mapping keys given
+       to the setEventHandler function instead of building the nodes of the values. The keys of
+       the mappings in the values are also given by the onScalar function. The line and column
+       numbers are the zero-based ones given by the parser.
+    */
+    class CNOID_EXPORT EventHandler
+    {
+    public:
+        virtual ~EventHandler();
+        /**
+           \return The node stored in the document as the value of the key. Nothing is stored
+           if the returned node is null.
+        */
+        virtual ValueNode* onValueStart(const std::string& key, int line, int column) = 0;
+        virtual void onMappingStart(int line, int column);
+        virtual void onMappingEnd();
+        virtual void onListingStart(int line, int column);
+        virtual void onListingEnd();
+        virtual void onScalar(const char* value, size_t length, int line, int column);
+        virtual void onValueEnd();
+    };
+
+    //! The handler is not owned by the reader.
+    void setEventHandler(const std::string& key, EventHandler* handler);
+
+    /**
+       The values of the key are stored as CompactRowListing nodes. This reduces the memory
+       and the time to read the large numeric data such as the frames of sequences.
+    */
+    void setCompactRowListingKey(const std::string& key);
         
     void expectRegularMultiListing();
 #ifdef CNOID_BACKWARD_COMPATIBILITY
@@ -40,6 +112,10 @@ public:
     bool load_string(const std::string& yamlstring) { return parse(yamlstring); }
 #endif
 
+    /**
+       The load and parse functions also read the binary value tree written by the
+       YAMLWriter::writeBinary function, which is distinguished by the magic number.
+    */
     bool load(const std::string& filename);
     bool parse(const std::string& yamlstring);
     bool parse(const char* input, size_t size);
@@ -3,16 +3,35 @@
 */
 
 #include "YAMLWriter.h"
+#include "YAMLReader.h"
+#include "ValueTreeBinaryFormat.h"
 #include "NullOut.h"
 #include "UTF8.h"
 #include <iostream>
 #include <algorithm>
 #include <stack>
 #include <fstream>
+#include <unordered_map>
 
 using namespace std;
 using namespace cnoid;
 
+namespace {
+
+class BinaryNodeWriter
+{
+public:
+    string keyData;
+    string nodeData;
+    unordered_map<string, uint64_t> keyIndexMap;
+
+    bool writeNode(const ValueNode* node);
+    void writeTag(int tag, const ValueNode* node);
+    void writeKey(const string& key);
+};
+
+}
+
 namespace cnoid {
 
 enum { TOP, MAPPING, LISTING };
@@ -896,3 +915,118 @@ void YAMLWriter::resetInfo(Mapping* info)
 {
     impl->info = info;
 }
+
+
+bool YAMLWriter::writeBinary(const ValueNode* node, std::ostream& os)
+{
+    BinaryNodeWriter writer;
+    if(!node || !writer.writeNode(node)){
+        return false;
+    }
+    string header(valueTreeBinary::Magic, sizeof(valueTreeBinary::Magic));
+    valueTreeBinary::writeUnsigned(header, valueTreeBinary::Version);
+    valueTreeBinary::writeUnsigned(header, writer.keyIndexMap.size());
+    os.write(header.data(), header.size());
+    os.write(writer.keyData.data(), writer.keyData.size());
+    os.write(writer.nodeData.data(), writer.nodeData.size());
+    return !os.fail();
+}
+
+
+bool YAMLWriter::saveBinary(const ValueNode* node, const std::string& filename)
+{
+    ofstream ofs(fromUTF8(filename), ios::out | ios::binary);
+    if(!ofs){
+        return false;
+    }
+    return writeBinary(node, ofs);
+}
+
+
+void BinaryNodeWriter::writeTag(int tag, const ValueNode* node)
+{
+    nodeData.push_back(static_cast<char>(tag));
+    // The line and column numbers are written as the one-based numbers, which are zero when
+    // the node does not have the line information.
+    valueTreeBinary::writeUnsigned(nodeData, std::max(node->line(), 0));
+    valueTreeBinary::writeUnsigned(nodeData, std::max(node->column(), 0));
+}
+
+
+void BinaryNodeWriter::writeKey(const string& key)
+{
+    auto inserted = keyIndexMap.emplace(key, keyIndexMap.size());
+    if(inserted.second){
+        valueTreeBinary::writeUnsigned(keyData, key.size());
+        keyData.append(key);
+    }
+    valueTreeBinary::writeUnsigned(nodeData, inserted.first->second);
+}
+
+
+bool BinaryNodeWriter::writeNode(const ValueNode* node)
+{
+    using namespace valueTreeBinary;
+    
+    if(node->isScalar()){
+        auto scalar = static_cast<const ScalarNode*>(node);
+        writeTag(ScalarTag | (scalar->stringStyle() << StringStyleShift), node);
+        auto& value = scalar->stringValue();
+        writeUnsigned(nodeData, value.size());
+        nodeData.append(value);
+
+    } else if(node->isMapping()){
+        auto mapping = node->toMapping();
+        int tag = MappingTag | (mapping->keyStringStyle() << StringStyleShift);
+        if(mapping->isFlowStyle()){
+            tag |= FlowStyleBit;
+        }
+        writeTag(tag, node);
+
+        vector<Mapping::const_iterator> iters;
+        iters.reserve(mapping->size());
+        for(auto it = mapping->begin(); it != mapping->end(); ++it){
+            if(!it->first.empty()){
+                iters.push_back(it);
+            }
+        }
+        std::sort(iters.begin(), iters.end(),
+                  [](const Mapping::const_iterator& it1, const Mapping::const_iterator& it2){
+                      return it1->second->indexInMapping() < it2->second->indexInMapping(); });
+
+        writeUnsigned(nodeData, iters.size());
+        for(auto& it : iters){
+            writeKey(it->first);
+            if(!writeNode(it->second)){
+                return false;
+            }
+        }
+
+    } else if(node->isListing()){
+        auto listing = node->toListing();
+        writeTag(ListingTag | (listing->isFlowStyle() ? FlowStyleBit : 0), node);
+
+        // The rows of a compact row listing are written as the elements of an ordinary listing
+        if(auto compact = dynamic_cast<const CompactRowListing*>(listing)){
+            const int n = compact->numRows();
+            writeUnsigned(nodeData, n);
+            for(int i=0; i < n; ++i){
+                if(!writeNode(&compact->row(i))){
+                    return false;
+                }
+            }
+        } else {
+            const int n = listing->size();
+            writeUnsigned(nodeData, n);
+            for(int i=0; i < n; ++i){
+                if(!writeNode(listing->at(i))){
+                    return false;
+                }
+            }
+        }
+    } else {
+        return false;
+    }
+
+    return true;
+}
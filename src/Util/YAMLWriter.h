@@ -33,6 +33,14 @@ public:
 
     void putNode(const ValueNode* node);
 
+    /**
+       These functions write the node in the binary format of value trees, which YAMLReader
+       reads directly without parsing the YAML text. Each distinct key of the mappings is
+       stored only once in the data. The key order of the mappings is preserved.
+    */
+    static bool writeBinary(const ValueNode* node, std::ostream& os);
+    static bool saveBinary(const ValueNode* node, const std::string& filename);
+
     void setIndentWidth(int n);
     int indentWidth() const;
     void setKeyOrderPreservationMode(bool on);
@@ -3,15 +3,94 @@
 */
 
 #include "../MultiValueSeq.h"
+#include "../MultiSE3Seq.h"
 #include "../ReferencedObjectSeq.h"
 #include "../ValueTree.h"
 #include "../YAMLWriter.h"
 #include "PyUtil.h"
+#include <pybind11/numpy.h>
 
 using namespace std;
 using namespace cnoid;
 namespace py = pybind11;
 
+namespace {
+
+typedef py::array_t<double, py::array::c_style | py::array::forcecast> InputArray;
+
+/*
+  The following arrays share the memory of a sequence, which is kept alive by the array objects.
+  The arrays become invalid when the sequence is resized.
+*/
+py::array getMultiValueSeqArrayView(py::object self)
+{
+    auto& seq = self.cast<MultiValueSeq&>();
+    seq.makeContiguous();
+    const py::ssize_t numParts = seq.numParts();
+    return py::array_t<double>(
+        { static_cast<py::ssize_t>(seq.numFrames()), numParts },
+        { static_cast<py::ssize_t>(numParts * sizeof(double)), static_cast<py::ssize_t>(sizeof(double)) },
+        seq.data(), self);
+}
+
+py::array getMultiSE3SeqElementArrayView(py::object self, bool isRotation)
+{
+    auto& seq = self.cast<MultiSE3Seq&>();
+    seq.makeContiguous();
+    SE3* top = seq.data();
+    py::ssize_t offset = 0;
+    if(!seq.empty()){
+        auto element = isRotation ? top->rotation().coeffs().data() : top->translation().data();
+        offset = reinterpret_cast<char*>(element) - reinterpret_cast<char*>(top);
+    }
+    const py::ssize_t numParts = seq.numParts();
+    const py::ssize_t elementSize = sizeof(SE3);
+    return py::array_t<double>(
+        { static_cast<py::ssize_t>(seq.numFrames()), numParts, static_cast<py::ssize_t>(isRotation ? 4 : 3) },
+        { numParts * elementSize, elementSize, static_cast<py::ssize_t>(sizeof(double)) },
+        reinterpret_cast<double*>(reinterpret_cast<char*>(top) + offset), self);
+}
+
+void checkArrayShape(const InputArray& values, int ndim, int lastDimSize)
+{
+    if(values.ndim() != ndim || (lastDimSize > 0 && values.shape(ndim - 1) != lastDimSize)){
+        PyErr_SetString(PyExc_ValueError, "The shape of the array is not supported");
+        throw py::error_already_set();
+    }
+}
+
+void setMultiValueSeqArray(MultiValueSeq& self, InputArray values)
+{
+    checkArrayShape(values, 2, 0);
+    const int numFrames = values.shape(0);
+    const int numParts = values.shape(1);
+    self.setDimension(numFrames, numParts);
+    for(int i=0; i < numFrames; ++i){
+        std::copy_n(values.data(i, 0), numParts, self.frame(i).begin());
+    }
+}
+
+/*
+  Each element of the array is given as [x, y, z, qx, qy, qz, qw], where (qx, qy, qz, qw) is
+  the quaternion of the rotation in the same order as the rotation array.
+*/
+void setMultiSE3SeqArray(MultiSE3Seq& self, InputArray values)
+{
+    checkArrayShape(values, 3, 7);
+    const int numFrames = values.shape(0);
+    const int numParts = values.shape(1);
+    self.setDimension(numFrames, numParts);
+    for(int i=0; i < numFrames; ++i){
+        auto frame = self.frame(i);
+        for(int j=0; j < numParts; ++j){
+            const double* v = values.data(i, j, 0);
+            frame[j].set(Vector3(v[0], v[1], v[2]), Quaternion(v[6], v[3], v[4], v[5]));
+        }
+    }
+}
+
+}
+
 namespace cnoid {
 
 void exportPySeqTypes(py::module& m)
@@ -106,6 +185,8 @@ void exportPySeqTypes(py::module& m)
         .def("saveAsPlainFormat",
              [](MultiValueSeq& self, const std::string& filename){
                  return self.saveAsPlainFormat(filename); })
+        .def_property_readonly("array", &getMultiValueSeqArrayView)
+        .def("setArray", &setMultiValueSeqArray)
         
         // deprecated
         .def("isEmpty", &MultiValueSeq::empty)
@@ -113,6 +194,17 @@ void exportPySeqTypes(py::module& m)
         .def("getPart", (MultiValueSeq::Part (MultiValueSeq::*)(int)) &MultiValueSeq::part)
         ;
 
+    py::class_<MultiSE3Seq, shared_ptr<MultiSE3Seq>, AbstractMultiSeq>(m, "MultiSE3Seq")
+        .def_property_readonly("empty", &MultiSE3Seq::empty)
+        .def("clear", &MultiSE3Seq::clear)
+        .def("pop_front", &MultiSE3Seq::pop_front, py::arg("n") = 1)
+        .def_property_readonly(
+            "translationArray", [](py::object self){ return getMultiSE3SeqElementArrayView(self, false); })
+        .def_property_readonly(
+            "rotationArray", [](py::object self){ return getMultiSE3SeqElementArrayView(self, true); })
+        .def("setArray", &setMultiSE3SeqArray)
+        ;
+
     py::class_<ReferencedObjectSeq, shared_ptr<ReferencedObjectSeq>, AbstractSeq>(m, "ReferencedObjectSeq")
         .def_property_readonly("clear", &ReferencedObjectSeq::clear)
         .def_property_readonly("empty", &ReferencedObjectSeq::empty)
@@ -5,9 +5,8 @@
 // This is neccessary because the implementation of VC++6.0 uses 'strlen()' in the function,
 // so that it becomes too slow for a string buffer which has long length.
 
-#ifndef _MSC_VER
+#include <fast_float/fast_float.h>
 #include <cstdlib>
-#endif
 
 namespace cnoid {
 
@@ -90,6 +89,62 @@ inline double strtod(const char* nptr, char** endptr) {
 }
 #endif
 
+/**
+   This function parses a floating point number in the same way as strtod and strtof, but the
+   number is parsed by the fast_float library, which is much faster than the standard functions.
+   The leading white spaces are not skipped. The standard function is used for the formats which
+   are not supported by the library such as the hexadecimal format.
+   \return The pointer next to the parsed number, or begin if no number is parsed.
+*/
+template<typename T> const char* parseFloat(const char* begin, const char* end, T& out_value)
+{
+    const char* p = begin;
+    if(p != end && *p == '+'){
+        // fast_float does not accept the plus sign
+        ++p;
+        if(p != end && (*p == '+' || *p == '-')){
+            return begin;
+        }
+    }
+    auto result = fast_float::from_chars(p, end, out_value);
+    if(result.ec == std::errc() && (result.ptr == end || (*result.ptr != 'x' && *result.ptr != 'X'))){
+        return result.ptr;
+    }
+    char* tail;
+    out_value = (sizeof(T) == sizeof(float)) ? cnoid::strtof(begin, &tail) : cnoid::strtod(begin, &tail);
+    return tail;
+}
+
+/**
+   This function parses an integer in the same way as strtol, but the decimal numbers which do not
+   start with zero are parsed directly without the overhead of the standard function.
+   \return The pointer next to the parsed number, or begin if no number is parsed.
+*/
+inline const char* parseInt(const char* begin, const char* end, long& out_value, int base = 10)
+{
+    const char* p = begin;
+    bool isNegative = false;
+    if(p != end && (*p == '+' || *p == '-')){
+        isNegative = (*p == '-');
+        ++p;
+    }
+    if(p != end && *p >= '1' && *p <= '9' && (base == 10 || base == 0)){
+        long long value = 0;
+        const char* digitsEnd = (end - p > 18) ? p + 18 : end;
+        while(p != digitsEnd && *p >= '0' && *p <= '9'){
+            value = value * 10 + (*p++ - '0');
+        }
+        if(p == end || *p < '0' || *p > '9'){
+            out_value = isNegative ? -value : value;
+            return p;
+        }
+    }
+    // The other cases including the octal and hexadecimal numbers and the overflow
+    char* tail;
+    out_value = std::strtol(begin, &tail, base);
+    return tail;
+}
+
 }
 
 #endif